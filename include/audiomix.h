@@ -0,0 +1,183 @@
+/*
+ * audiomix.h
+ *
+ * PCM resampling and mixing
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#ifndef __OPAL_AUDIOMIX_H
+#define __OPAL_AUDIOMIX_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include "openh323buildopts.h"
+#include "codecs.h"
+
+#include <vector>
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**Convert 16 bit mono PCM between sample rates, for example between a
+   narrowband device and a wideband codec. A polyphase windowed sinc filter
+   is used, so any ratio of rates works, 8000, 16000, 32000 and 48000 in
+   any combination are the usual ones. SSE2 is used for the filter where
+   the build allows it, the results are the same either way.
+
+   The resampler keeps the end of each block to filter the start of the
+   next, so use one per stream.
+
+   It can also be added to a codec as a filter.
+     codec->AddFilter(resampler.GetFilter());
+   The data is converted in place, so this is only possible where the
+   result fits in the buffer, for example converting decoded wideband audio
+   down for a narrowband sound device.
+  */
+class H323AudioResampler : public PObject
+{
+  PCLASSINFO(H323AudioResampler, PObject);
+
+  public:
+    /**Create a resampler between two rates in Hz.
+      */
+    H323AudioResampler(
+      unsigned inputRate,     ///< Rate of the samples given
+      unsigned outputRate,    ///< Rate of the samples produced
+      unsigned taps = 32      ///< Filter taps per output sample
+    );
+
+    /**Resample a block. Returns the number of samples written to output,
+       at most GetOutputCount(inputCount). Any more are dropped.
+      */
+    PINDEX Process(
+      const short * input,    ///< Samples at the input rate
+      PINDEX inputCount,      ///< Number of input samples
+      short * output,         ///< Buffer for samples at the output rate
+      PINDEX outputSize       ///< Size of output in samples
+    );
+
+    /**Get the largest number of samples Process() will produce.
+      */
+    PINDEX GetOutputCount(
+      PINDEX inputCount       ///< Number of input samples
+    ) const;
+
+    /**Clear the filter state, for example after a gap in the stream.
+      */
+    void Reset();
+
+    /**Get the notifier to add this resampler to a codec as a filter.
+      */
+    PNotifier GetFilter();
+
+    unsigned GetInputRate() const  { return inputRate; }
+    unsigned GetOutputRate() const { return outputRate; }
+
+  protected:
+    PDECLARE_NOTIFIER(H323Codec::FilterInfo, H323AudioResampler, OnFilter);
+
+    unsigned inputRate;
+    unsigned outputRate;
+    unsigned upFactor;      // L, phases in the filter
+    unsigned downFactor;    // M, input step in phases
+    unsigned taps;
+    unsigned phase;         // Phase of the next output sample
+
+    std::vector<short> coefficients;  // taps per phase, Q15, newest sample last
+    std::vector<short> work;          // history then this block
+    std::vector<short> filterOutput;  // for OnFilter
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**Mix 16 bit PCM streams of the same rate and block size, saturating
+   rather than wrapping. For a conference each leg is added once, then
+   each leg gets the mix of everyone else with GetMixMinus(), so there is
+   no copy of the other legs per leg. SSE2 is used where the build allows
+   it, the results are the same either way.
+  */
+class H323AudioMixer : public PObject
+{
+  PCLASSINFO(H323AudioMixer, PObject);
+
+  public:
+    /**Create a mixer for blocks of the given number of samples.
+      */
+    H323AudioMixer(
+      PINDEX samples          ///< Samples per block
+    );
+
+    /**Start a new block.
+      */
+    void Clear();
+
+    /**Add a stream's block to the mix.
+      */
+    void Add(
+      const short * input     ///< Block of GetSamples() samples
+    );
+
+    /**Get the mix of every stream added since Clear().
+      */
+    void GetMix(
+      short * output          ///< Buffer for GetSamples() samples
+    ) const;
+
+    /**Get the mix without one stream, that must have been added.
+      */
+    void GetMixMinus(
+      const short * own,      ///< Block the stream added
+      short * output          ///< Buffer for GetSamples() samples
+    ) const;
+
+    /**Get the number of streams added since Clear().
+      */
+    unsigned GetCount() const { return count; }
+
+    PINDEX GetSamples() const { return (PINDEX)total.size(); }
+
+    /**Mix a set of blocks in one pass.
+      */
+    static void Mix(
+      const short * const * inputs,   ///< Blocks to mix
+      unsigned inputCount,            ///< Number of blocks
+      short * output,                 ///< Buffer for the mix
+      PINDEX samples                  ///< Samples per block
+    );
+
+  protected:
+    std::vector<int> total;
+    unsigned         count;
+};
+
+
+#endif // __OPAL_AUDIOMIX_H
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -40,6 +40,7 @@
 
 #include "rtp.h"
 #include "transports.h"
+#include <ptclib/delaychan.h>
 
 
 class H245_OpenLogicalChannel;
@@ -57,6 +58,8 @@ class H323Connection;
 class H323Capability;
 class H323Codec;
 class H323_RTP_Session;
+class RTP_RedundantEncoder;
+class H323AVSync;
 
 
 
@@ -176,9 +179,19 @@ class H323Channel : public PObject
     virtual PBoolean Start() = 0;
 
     /**This is called to clean up any threads on connection termination.
+       StartTermination() is called first if it has not been already, then
+       the channel threads are waited for.
      */
     virtual void CleanUpOnTermination();
 
+    /**Break the channel threads out of their I/O without waiting for them.
+       A connection with several channels starts the termination of all of
+       them before calling CleanUpOnTermination() on each, so the threads
+       run down together and teardown takes as long as the slowest channel
+       rather than the sum of them all.
+     */
+    virtual void StartTermination();
+
     /**Indicate if background thread(s) are running.
      */
     virtual PBoolean IsRunning() const;
@@ -374,6 +387,7 @@ class H323Channel : public PObject
     PBoolean                   opened;
     PBoolean                   paused;
     PBoolean                   terminating;
+    PBoolean                   stopping;
     PBoolean                   mediaTunneled;
 
   private:
@@ -607,6 +621,79 @@ class H323_RealTimeChannel : public H323UnidirectionalChannel
 
 ///////////////////////////////////////////////////////////////////////////////
 
+/**This class relays the RTP packets received on one channel out of the RTP
+   session of a transmit channel, usually of another connection, without
+   decoding and encoding the media. It is shared by both channels so either
+   can end it, and is deleted when both have released it.
+ */
+class H323_RTPRelay : public PObject
+{
+  PCLASSINFO(H323_RTPRelay, PObject);
+
+  public:
+    /**Create a relay sending out of the target session with the payload
+       type the transmit channel negotiated.
+     */
+    H323_RTPRelay(
+      RTP_Session & target,                     ///< Session to send relayed packets
+      RTP_DataFrame::PayloadTypes payloadType,  ///< Payload type to send
+      DWORD timestampGap                        ///< Timestamp step at the join
+    );
+
+    /**Send a received packet out of the target session. The timestamp is
+       moved on from those the target already sent, the payload type is
+       replaced, and the target session assigns its own SSRC and sequence
+       number, leaving a gap where packets were lost on the way in.
+       Returns FALSE if the relay was stopped or the target failed.
+     */
+    PBoolean Forward(
+      RTP_DataFrame & frame   ///< Received packet, modified in place
+    );
+
+    /**Stop the relay, no more packets are sent to the target.
+     */
+    void Stop();
+
+    /**Indicate the relay has not been stopped.
+     */
+    PBoolean IsActive() const;
+
+    /**Release a channel's hold on the relay, deleting it on the last one.
+     */
+    void Release();
+
+    /**Ask the source of the relayed packets for an intra frame. Requests
+       made before the source next checks are merged into one.
+     */
+    void RequestUpdate();
+
+    /**Get and clear any intra frame request.
+     */
+    PBoolean TakeUpdateRequest();
+
+    /**Set if packets are sent out of the target. A target multicasting to
+       the same group as the source is not sent to, the group already has
+       the packets, but the relay still passes on its intra frame requests.
+     */
+    void SetForwarding(
+      PBoolean send   ///< Send packets out of the target
+    );
+
+  protected:
+    PMutex                      mutex;
+    RTP_Session               * target;
+    PBoolean                    forwarding;
+    RTP_DataFrame::PayloadTypes payloadType;
+    DWORD                       timestampGap;
+    DWORD                       timestampOffset;
+    WORD                        lastSequenceNumber;
+    DWORD                       syncSource;
+    PBoolean                    started;
+    PBoolean                    updateRequested;
+    unsigned                    references;
+};
+
+
 /**This class is for encpsulating the IETF Real Time Protocol interface.
  */
 class H323_RTPChannel : public H323_RealTimeChannel
@@ -635,6 +722,10 @@ class H323_RTPChannel : public H323_RealTimeChannel
      */
     virtual void CleanUpOnTermination();
 
+    /**Break the channel threads out of their I/O without waiting for them.
+     */
+    virtual void StartTermination();
+
     /**Indicate the session number of the channel.
        Return session for channel. This returns the session ID of the
        RTP_Session member variable.
@@ -743,19 +834,156 @@ class H323_RTPChannel : public H323_RealTimeChannel
 
     virtual PInt64 GetSilenceDuration() const;
 
+    /**Relay the RTP packets this receive channel gets out of the transmit
+       channel, without decoding and encoding them. Both channels must be
+       using the same media format, use H323Capabilities::PreferMatching()
+       on the capabilities of the second connection to make that likely.
+       While relaying the transmit channel stops sending its own media and
+       this channel stops writing to its codec. If a jitter buffer is in
+       use the relayed packets come out of it, so it is best disabled on
+       connections that only relay.
+
+       Pass NULL to stop relaying. Returns FALSE if this is not a receive
+       channel, the target is not a transmit channel or the formats differ.
+     */
+    PBoolean SetRelayTarget(
+      H323_RTPChannel * transmitter   ///< Channel to send the packets
+    );
+
+    /**Indicate packets are being relayed from or to this channel.
+     */
+    PBoolean IsRelaying() const;
+
+    /**Send the packets this transmit channel encodes out of another transmit
+       channel as well, so several legs share one encoder. Both must use the
+       same media format and the target must allow at least this channel's
+       bandwidth. The target stops sending, and for video stops encoding, its
+       own media until RemoveFanOutTargets() or its own SetRelayTarget() or
+       close. Fast picture updates requested by the legs are merged into one
+       for this channel's encoder.
+
+       Returns FALSE if either is not a transmit channel or they differ.
+     */
+    PBoolean AddFanOutTarget(
+      H323_RTPChannel * transmitter   ///< Channel to also send the packets
+    );
+
+    /**Stop sending this channel's packets out of other channels.
+     */
+    void RemoveFanOutTargets();
+
+    /**Get the number of channels this channel's packets are sent out of.
+     */
+    PINDEX GetFanOutCount() const;
+
+    /**Handle a miscellaneous command on this channel. Fast picture update
+       requests on a channel sending relayed packets go to their source.
+     */
+    virtual void OnMiscellaneousCommand(
+      const H245_MiscellaneousCommand_type & type  ///< Command to handle
+    );
+
+    /**Send frames already encoded in the channel media format, such as an
+       OpalWAVPromptChannel of a prompt cached in that format, in place of
+       reading and encoding audio by the codec. Each read of the source is
+       one codec frame time and is paced in real time by the channel. The
+       packets get the same timestamps and talk burst markers as encoded
+       ones, and when the source ends the channel goes silent until another
+       is set.
+
+       Pass NULL to go back to the codec. Returns FALSE if this is not an
+       audio transmit channel.
+     */
+    PBoolean SetEncodedSource(
+      PChannel * source,              ///< Channel of encoded frames
+      PBoolean autoDelete = TRUE      ///< Delete the source when done with it
+    );
+
+    /**Indicate frames are sent from an encoded source.
+     */
+    PBoolean HasEncodedSource() const { return encodedSource != NULL; }
+
+    /**Send RFC 2198 redundant packets carrying copies of the level packets
+       before each one, in the payload type given. This must be called before
+       the channel is opened, as the open tells the remote about it. A level
+       of zero sends plain packets.
+     */
+    void SetRedundancy(
+      PINDEX level,                             ///< Earlier payloads per packet
+      RTP_DataFrame::PayloadTypes payloadType   ///< Payload type of the packets
+    );
+
+    /**Get the number of earlier payloads each packet sent carries.
+     */
+    PINDEX GetRedundancyLevel() const;
+
+    /**Get the payload type of redundant packets sent.
+     */
+    RTP_DataFrame::PayloadTypes GetRedundancyPayloadType() const;
+
+    /**Get the RFC 6464 audio level of the last packet received that had
+       one, see H323EndPoint::SetAudioLevelExtension(). Returns FALSE if
+       none has.
+     */
+    PBoolean GetReceivedAudioLevel(
+      unsigned & level,   ///< Level in -dBov, 0 loudest to 127
+      PBoolean & voice    ///< Sender detected voice
+    ) const;
+
+    /**Do not decode received audio packets whose RFC 6464 audio level
+       says they are not voice, playing silence instead, as a mixer that
+       only mixes the talkers does. The default is disabled.
+     */
+    void SetSkipSilentDecode(
+      PBoolean skip       ///< Skip decoding packets without voice
+    ) { skipSilentDecode = skip; }
 
   protected:
+    void StopRelay();
+    PBoolean WaitForOwnMedia(PBoolean isAudio);
+    void SendFanOut(const RTP_DataFrame & frame);
+    void OnMediaActivity();
+    PBoolean ReadMedia(BYTE * buffer, unsigned & length, RTP_DataFrame & frame);
+    void HoldVideoForLipSync(H323AVSync & avSync, DWORD rtpTimestamp, PInt64 & holdEnd);
+
     RTP_Session      & rtpSession;
     H323_RTP_Session & rtpCallbacks;
 
+    H323_RTPRelay * relay;
+    PMutex          relayMutex;
+
+    PList<H323_RTPRelay> fanOut;
+    PMutex               fanOutMutex;
+
+    void RunFilters(RTP_DataFrame & frame, H323_INT param);
+
+    // The filters are read by the media thread without a lock. A change
+    // publishes a new list and retires the old one, which is deleted once
+    // no media thread is running filters.
     H323LIST(FilterList, PNotifier);
-    FilterList filters;
-    PMutex     filterMutex;
+    FilterList * volatile filterChain;    // NULL if no filters
+    PList<FilterList>     retiredFilters;
+    PAtomicInteger        filterReaders;
+    PMutex                filterMutex;    // Serialises changes
+
+    void PublishFilters(FilterList * newChain);
 
     PInt64 silenceStartTick;
 
+    RTP_RedundantEncoder * redundantEncoder;
+
+    PChannel     * encodedSource;
+    PBoolean       autoDeleteSource;
+    PBoolean       sourceChanged;
+    PMutex         sourceMutex;
+    PAdaptiveDelay sourceDelay;
+
     unsigned rec_written;
     PBoolean rec_ok;
+
+    unsigned receivedAudioLevel;    // Above 127 until one is received
+    PBoolean receivedVoice;
+    PBoolean skipSilentDecode;
 };
 
 
@@ -963,6 +1191,10 @@ class H323DataChannel : public H323UnidirectionalChannel
      */
     virtual void CleanUpOnTermination();
 
+    /**Break the channel threads out of their I/O without waiting for them.
+     */
+    virtual void StartTermination();
+
     /**Indicate the session number of the channel.
        Return session for channel. This returns the session ID of the
        RTP_Session member variable.
@@ -163,6 +163,11 @@ enum PluginCodec_Flags {
   PluginCodec_OtherPayloadMask       = 0x2000,
   PluginCodec_OtherPayload           = 0x2000,
 
+  // Audio codecs whose frames are all bytesPerFrame long may take any whole
+  // number of frames in one codecFunction call, for a packet of frames
+  PluginCodec_MultiFrameMask         = 0x10000,
+  PluginCodec_MultiFrame             = 0x10000,
+
   PluginCodec_BitsPerSamplePos       = 12,
   PluginCodec_BitsPerSampleMask      = 0xf000,
 };
@@ -199,6 +204,8 @@ struct PluginCodec_Definition;
 #define PLUGINCODEC_CONTROL_CODEC_EVENT           "event_codec"
 #define PLUGINCODEC_CONTROL_FLOW_OPTIONS          "to_flowcontrol_options"
 #define PLUGINCODEC_CONTROL_SET_FORMAT_OPTIONS    "set_format_options"
+#define PLUGINCODEC_CONTROL_RESET_CODEC           "reset_codec"
+#define PLUGINCODEC_CONTROL_SET_COMPLEXITY        "set_complexity"  // int, 0 cheapest to 10 best
 
 
 /* Log function, plug in gets a pointer to this function which allows
@@ -294,6 +301,8 @@ struct PluginCodec_Option {
 #define PLUGINCODEC_OPTION_INPUT_FORMAT               "InputFmt"
 #define PLUGINCODEC_OPTION_EMPHASIS_SPEED             "Emphasis Speed"
 #define PLUGINCODEC_OPTION_MAX_PAYLOAD                "Max Payload Size"
+#define PLUGINCODEC_OPTION_ENCODING_THREADS           "Encoding Threads"
+#define PLUGINCODEC_OPTION_INTRA_REFRESH              "Intra Refresh"
 
 // Events
 #define PLUGINCODEC_EVENT_FASTUPDATE             "on_fast_update"
@@ -43,6 +43,7 @@
 #include <channels.h>
 #include "openh323buildopts.h"
 #include <ptlib/video.h>
+#include "h323videoconv.h"
 
 /* The following classes have forward references to avoid including the VERY
    large header files for H225 and H245. If an application requires access
@@ -189,6 +190,15 @@ class H323Codec : public PObject
       long bitRateRestriction   ///< Bit rate limitation
     );
 
+    /**Process a report from the remote on the media the codec sends.
+       This is called on the transmit thread when an RTCP report on our
+       source has arrived since the last frame.
+       The default behaviour does nothing.
+     */
+    virtual void OnReceiverReport(
+      const RTP_Session::ReceiverReport & report  ///< Report on our source
+    );
+
     /**Process a miscellaneous command on the logical channel.
        The default behaviour does nothing.
      */
@@ -365,11 +375,17 @@ class H323Codec : public PObject
 
     H323Channel * GetLogicalChannel() { return logicalChannel; }
 
+    /**Set the histogram the codec records its processing time into, in
+       microseconds. The histogram is not deleted, NULL stops recording.
+      */
+    void SetProcessingHistogram(RTP_Histogram * histogram) { processingHistogram = histogram; }
+
   protected:
     Direction direction;
     OpalMediaFormat mediaFormat;
     
     H323Channel * logicalChannel; // sends messages from receive codec to tx codec.
+    RTP_Histogram * processingHistogram;
 
     PChannel * rawDataChannel;  // connection to the hardware for reading/writing data.
     PBoolean       deleteChannel;
@@ -443,7 +459,8 @@ class H323AudioCodec : public H323Codec
     enum SilenceDetectionMode {
       NoSilenceDetection,
       FixedSilenceDetection,
-      AdaptiveSilenceDetection
+      AdaptiveSilenceDetection,
+      SpectralSilenceDetection    ///< Noise floor tracked in two bands, else adaptive
     };
 
     /**Enable/Disable silence detection.
@@ -501,11 +518,92 @@ class H323AudioCodec : public H323Codec
       */
     virtual unsigned GetAverageSignalLevel();
 
+    /**Get the energy of the audio stream below and above a quarter of the
+       sample rate, for SpectralSilenceDetection. The bands are the sum and
+       the difference of adjacent samples, each sample quartered, and the
+       energy is the mean square of each.
+
+       The default behaviour returns FALSE, falling back to the adaptive
+       threshold on GetAverageSignalLevel().
+      */
+    virtual PBoolean GetSignalBandEnergy(
+      unsigned & lowBand,     ///< Mean square of the low band
+      unsigned & highBand     ///< Mean square of the high band
+    );
+
    /**SetRawDataHeld is called when the call has been held and the raw 
       data channel has been swapped out and released for another connection.
       */
     virtual PBoolean SetRawDataHeld(PBoolean hold);
 
+    /**Enable concealment of lost frames in the decoded audio.
+       Returns FALSE if the codec cannot do it, the default behaviour.
+      */
+    virtual PBoolean SetConcealment(
+      PBoolean /*enable*/   ///< Conceal lost frames
+    ) { return FALSE; }
+
+    /**Set the frames of a packet to be coded in one call to the codec.
+       An encoder then reads, and Read() returns, that many frames at a
+       time, GetFrameRate() covering them all. A decoder given a packet of
+       frames decodes up to that many together, still playing them out a
+       frame a Write() at a time.
+       Returns FALSE if the codec codes a frame a call, the default
+       behaviour.
+      */
+    virtual PBoolean SetFramesPerCall(
+      unsigned /*frames*/   ///< Frames in a packet
+    ) { return FALSE; }
+
+    /**Enable RFC 3389 comfort noise. An encoder gives silence descriptors
+       from GetSilenceDescriptor() while silent, a decoder plays noise from
+       those passed to OnSilenceDescriptor() until talk starts again.
+       Returns FALSE if the codec cannot do it, the default behaviour.
+      */
+    virtual PBoolean SetComfortNoise(
+      PBoolean /*enable*/   ///< Send or play comfort noise
+    ) { return FALSE; }
+
+    /**Get a silence descriptor due to be sent, after Read() returned a
+       silent frame. Returns FALSE if none is due, the default behaviour.
+      */
+    virtual PBoolean GetSilenceDescriptor(
+      BYTE * /*buffer*/,    ///< At least H323_COMFORTNOISE_MAX_SID bytes
+      PINDEX & /*length*/   ///< Length of the descriptor
+    ) { return FALSE; }
+
+    /**Take a received silence descriptor.
+       The default behaviour does nothing.
+      */
+    virtual void OnSilenceDescriptor(
+      const BYTE * /*sid*/, ///< RFC 3389 payload
+      PINDEX /*length*/     ///< Length of the payload
+    ) { }
+
+    /**Ask for the next decoded frame to be played a pitch period shorter,
+       so the jitter buffer delay comes down without a frame being lost.
+       Returns FALSE if the codec cannot do it, the default behaviour.
+      */
+    virtual PBoolean RequestSpeedUp() { return FALSE; }
+
+    /**Measure the level of each frame read, for the RFC 6464 audio level
+       header extension, see TakeAudioLevel(). The level silence detection
+       found for the frame is used when there is one.
+      */
+    void SetAudioLevelMeasure(
+      PBoolean enable   ///< Measure the level
+    ) { audioLevelMeasure = enable; }
+
+    /**Get the level of the audio read since the last call, the loudest
+       frame in -dBov from 0 to 127, and whether a talk burst was detected,
+       or with no silence detection, whether there was any sound. Returns
+       FALSE if no level was measured.
+      */
+    PBoolean TakeAudioLevel(
+      unsigned & level,   ///< Level in -dBov
+      PBoolean & voice    ///< Voice activity
+    );
+
 #ifdef H323_AEC	
 	/** Attach Acoustic Echo Cancellation.
 	*/
@@ -515,6 +613,8 @@ class H323AudioCodec : public H323Codec
 #endif
 
   protected:
+    void MeasureAudioLevel();
+
     unsigned samplesPerFrame;
 
     SilenceDetectionMode silenceDetectMode;
@@ -530,7 +630,14 @@ class H323AudioCodec : public H323Codec
     unsigned silenceMaximum;        // Maximum of frames below threshold
     unsigned signalFramesReceived;  // Frames of signal received
     unsigned silenceFramesReceived; // Frames of silence received
+    unsigned lowNoiseFloor;         // Low band energy of the background noise
+    unsigned highNoiseFloor;        // High band energy of the background noise
     PBoolean	 IsRawDataHeld;
+
+    PBoolean audioLevelMeasure;     // Measure levels for TakeAudioLevel()
+    unsigned lastSignalLevel;       // Average level DetectSilence() got for the frame, UINT_MAX if none
+    unsigned audioLevel;            // Loudest in -dBov since TakeAudioLevel(), above 127 if none
+    PBoolean audioVoice;            // Voice since TakeAudioLevel()
 };
 
 
@@ -543,6 +650,9 @@ class H323AudioCodec : public H323Codec
    functions as required for descibing a specific codec.
  */
 class H323Aec;
+class H323AudioConcealer;
+class H323ComfortNoiseEncoder;
+class H323ComfortNoiseGenerator;
 class H323FramedAudioCodec : public H323AudioCodec
 {
   PCLASSINFO(H323FramedAudioCodec, H323AudioCodec);
@@ -558,6 +668,8 @@ class H323FramedAudioCodec : public H323AudioCodec
       Direction direction       ///< Direction in which this instance runs
     );
 
+    ~H323FramedAudioCodec();
+
     /**Encode the data from the appropriate device.
        This will encode data for transmission. The exact size and description
        of the data placed in the buffer is codec dependent but should be less
@@ -607,6 +719,14 @@ class H323FramedAudioCodec : public H323AudioCodec
       */
     virtual unsigned GetAverageSignalLevel();
 
+    /**Get the energy of this frame below and above a quarter of the sample
+       rate.
+      */
+    virtual PBoolean GetSignalBandEnergy(
+      unsigned & lowBand,
+      unsigned & highBand
+    );
+
 
     /**Encode a sample block into the buffer specified.
        The samples have been read and are waiting in the readBuffer member
@@ -644,6 +764,69 @@ class H323FramedAudioCodec : public H323AudioCodec
     )
     { memset(buffer, 0, length); }
 
+    /**Indicate DecodeSilenceFrame() conceals a lost frame itself, in which
+       case SetConcealment() leaves it to do so.
+       The default behaviour returns FALSE.
+      */
+    virtual PBoolean HasDecoderConcealment() const { return FALSE; }
+
+    /**Indicate EncodeFrame() and DecodeFrames() can code several frames in
+       one call, for SetFramesPerCall().
+       The default behaviour returns FALSE.
+      */
+    virtual PBoolean HasMultiFrameCoding() const { return FALSE; }
+
+    /**Decode several whole frames from the buffer in one call, into the
+       samples given. Only called if HasMultiFrameCoding() is TRUE.
+       The default behaviour returns FALSE.
+      */
+    virtual PBoolean DecodeFrames(
+      const BYTE * /*buffer*/,  ///< Buffer holding the frames
+      unsigned /*frames*/,      ///< Number of frames in the buffer
+      short * /*pcm*/           ///< Buffer for frames*samplesPerFrame samples
+    ) { return FALSE; }
+
+    /**Enable concealment of lost frames with H323AudioConcealer, unless
+       the decoder has concealment of its own.
+      */
+    virtual PBoolean SetConcealment(
+      PBoolean enable       ///< Conceal lost frames
+    );
+
+    /**Ask for the next decoded frame to be played a pitch period shorter.
+       Returns FALSE if concealment is not enabled.
+      */
+    virtual PBoolean RequestSpeedUp();
+
+    /**Set the frames of a packet coded in one call, if the codec
+       HasMultiFrameCoding().
+      */
+    virtual PBoolean SetFramesPerCall(
+      unsigned frames       ///< Frames in a packet
+    );
+
+    /**Enable comfort noise with H323ComfortNoiseEncoder for an encoder and
+       H323ComfortNoiseGenerator for a decoder.
+      */
+    virtual PBoolean SetComfortNoise(
+      PBoolean enable       ///< Send or play comfort noise
+    );
+
+    /**Get a silence descriptor of the last frame read, if one is due.
+      */
+    virtual PBoolean GetSilenceDescriptor(
+      BYTE * buffer,
+      PINDEX & length
+    );
+
+    /**Take a received silence descriptor, played by Write() of a silent
+       frame until a frame is decoded.
+      */
+    virtual void OnSilenceDescriptor(
+      const BYTE * sid,
+      PINDEX length
+    );
+
 #ifdef H323_AEC	
     /** Attach Acoustic Echo Cancellation.
     */
@@ -656,6 +839,15 @@ class H323FramedAudioCodec : public H323AudioCodec
 #ifdef H323_AEC	
     H323Aec * aec;     // Acoustic Echo Canceller
 #endif
+    H323AudioConcealer * concealer;  // Conceals lost frames, NULL if disabled
+    PBoolean    speedUpPending;
+    H323ComfortNoiseEncoder * noiseEncoder;     // NULL if comfort noise disabled
+    H323ComfortNoiseGenerator * noiseGenerator;
+    PBoolean    silenceDescriptorDue;
+    unsigned    framesPerCall;          // Frames coded in one call
+    PShortArray decodedFrames;          // Decoded together, played a frame a Write()
+    const BYTE * decodedNext;           // Encoded frame the next of them came from
+    unsigned    decodedLeft;
     PShortArray sampleBuffer;
     unsigned    bytesPerFrame;
 
@@ -729,6 +921,9 @@ class H323StreamedAudioCodec : public H323FramedAudioCodec
 
 #ifdef H323_VIDEO
 
+class H323VideoSimulcast;
+class H323SimulcastReceiver;
+
 /**This class defines a codec class that will use the standard platform image
    output device.
 
@@ -850,6 +1045,12 @@ class H323VideoCodec : public H323Codec
     */
     virtual void OnLostPicture();
 
+    /**Process a received picture dropped as incomplete before it reached
+       the decoder, so that the decoder can ask for an intra frame.
+       The default does nothing.
+    */
+    virtual void OnIncompletePicture();
+
     /** Get width of video
      */ 
     virtual unsigned GetWidth() const { return frameWidth; }
@@ -967,7 +1168,83 @@ class H323VideoCodec : public H323Codec
     */
     virtual PBoolean SetSupportedFormats(std::list<PVideoFrameInfo> & info);
 
+    /**Have the encoder scale the grabbed pictures to a size, so the size
+       is kept whatever the grabber gives. 0 by 0, the default, encodes at
+       the size grabbed. Returns FALSE if the codec cannot encode the size.
+      */
+    virtual PBoolean SetEncodeFrameSize(
+      unsigned width,     ///< Width in pixels, even
+      unsigned height     ///< Height in pixels, even
+    );
+
+    /**Get the converter the codec scales pictures with, to select its
+       kernel.
+      */
+    H323VideoConverter & GetVideoConverter() { return videoConverter; }
+
+    /**Set the priority of the decoder in the decode budget of the
+       endpoint, see H323EndPoint::SetVideoDecodeBudget(). Decoders of a
+       higher priority shed pictures after those of a lower one. Default 0.
+      */
+    void SetDecodePriority(int priority) { decodePriority = priority; }
+
+    /**Get the priority of the decoder in the decode budget.
+      */
+    int GetDecodePriority() const { return decodePriority; }
+
+    /**Add a handler called with each picture the decoder produces, before
+       it is rendered. The picture is not copied, to keep it past the call
+       the handler copies the reference it is passed.
+
+       To use define:
+         PDECLARE_NOTIFIER(H323VideoFrameRef, YourClass, YourFunction);
+       and
+         void YourClass::YourFunction(H323VideoFrameRef & frame, INT)
+         {
+           queue.push_back(frame);   // Held until the queue drops it
+         }
+      */
+    void AddDecodedFrameHandler(
+      const PNotifier & handler
+    );
+
+    /**Remove a handler added with AddDecodedFrameHandler().
+      */
+    void RemoveDecodedFrameHandler(
+      const PNotifier & handler
+    );
+
+    /**Have the encoder send a layer of a simulcast, see
+       H323VideoSimulcast, rather than encode the pictures grabbed. Called
+       again to move to another layer, or with a NULL simulcast to encode
+       again. The simulcast must outlive its use by the codec. Returns
+       FALSE if the codec is a decoder or there is no such layer.
+      */
+    PBoolean SetSimulcastLayer(
+      H323VideoSimulcast * simulcast,     ///< Simulcast to send a layer of
+      PINDEX layer = 0,                   ///< Layer to send
+      unsigned maxTemporalId = UINT_MAX   ///< Highest SVC temporal layer sent
+    );
+
+    /**Encode a picture given rather than grabbed, as a layer of a
+       simulcast is, into RTP packets with their RTP headers. intra forces
+       an intra frame and is set if one was encoded.
+       The default returns FALSE, plugin codecs encode pictures.
+      */
+    virtual PBoolean EncodePicture(
+      const BYTE * picture,               ///< YUV420P picture
+      unsigned width,                     ///< Width in pixels
+      unsigned height,                    ///< Height in pixels
+      PBoolean & intra,                   ///< Intra frame forced, and sent
+      std::vector<PBYTEArray> & packets   ///< Packets to append to
+    );
+
   protected:
+    /**Pass a decoded picture to the handlers.
+      */
+    void OnDecodedFrame(
+      H323VideoFrameRef & frame
+    );
 
     int frameWidth;
     int frameHeight;
@@ -995,6 +1272,18 @@ class H323VideoCodec : public H323Codec
     int framesPerSec;
 
     PMutex  videoHandlerActive;    
+
+    unsigned           encodeWidth;
+    unsigned           encodeHeight;
+    H323VideoConverter videoConverter;
+    int                decodePriority;
+
+    H323LIST(DecodedFrameHandlerList, PNotifier);
+    DecodedFrameHandlerList decodedFrameHandlers;
+    PMutex                  decodedFrameMutex;
+
+    H323VideoSimulcast    * simulcast;
+    H323SimulcastReceiver * simulcastReceiver;
 };
 
 #endif // NO_H323_VIDEO
@@ -1022,6 +1311,22 @@ class H323_ALawCodec : public H323StreamedAudioCodec
     );
   //@}
 
+    /**Encode the whole frame with the H323_G711Block kernels.
+      */
+    virtual PBoolean EncodeFrame(
+      BYTE * buffer,    ///< Buffer into which encoded bytes are placed
+      unsigned & length ///< Actual length of encoded data buffer
+    );
+
+    /**Decode the whole frame with the H323_G711Block kernels.
+      */
+    virtual PBoolean DecodeFrame(
+      const BYTE * buffer,  ///< Buffer from which encoded data is found
+      unsigned length,      ///< Length of encoded data buffer
+      unsigned & written,   ///< Number of bytes used from data buffer
+      unsigned & samples    ///< Number of sample output from frame
+    );
+
     virtual int   Encode(short sample) const { return EncodeSample(sample); }
     virtual short Decode(int   sample) const { return DecodeSample(sample); }
 
@@ -1051,6 +1356,22 @@ class H323_muLawCodec : public H323StreamedAudioCodec
     );
   //@}
 
+    /**Encode the whole frame with the H323_G711Block kernels.
+      */
+    virtual PBoolean EncodeFrame(
+      BYTE * buffer,    ///< Buffer into which encoded bytes are placed
+      unsigned & length ///< Actual length of encoded data buffer
+    );
+
+    /**Decode the whole frame with the H323_G711Block kernels.
+      */
+    virtual PBoolean DecodeFrame(
+      const BYTE * buffer,  ///< Buffer from which encoded data is found
+      unsigned length,      ///< Length of encoded data buffer
+      unsigned & written,   ///< Number of bytes used from data buffer
+      unsigned & samples    ///< Number of sample output from frame
+    );
+
     virtual int   Encode(short sample) const { return EncodeSample(sample); }
     virtual short Decode(int   sample) const { return DecodeSample(sample); }
 
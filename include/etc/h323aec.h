@@ -48,8 +48,6 @@ extern "C" {
 #include <speex/speex_preprocess.h>
 }
 
-#include <map>
-
 class H323AEC {
 public:
     struct BufferFrame {
@@ -63,7 +61,13 @@ public:
     };
 };
 
-class H323_AECBuffer : public std::map< unsigned, H323AEC::BufferFrame >
+/** Far end reference frames, written by the thread playing the decoded audio
+  * and read by the thread encoding the recorded audio. The frames are kept
+  * in a ring of fixed slots with a single writer and a single reader, so
+  * neither thread takes a lock or allocates per frame. The reference read is
+  * the frame played the buffer size frames ago.
+  */
+class H323_AECBuffer
 {
 public:
     H323_AECBuffer();
@@ -78,10 +82,13 @@ public:
 protected:
 
     PINDEX m_bufferTime;
-    PMutex m_bufferMutex;
 
 private:
-    unsigned m_curPos;
+    PBYTEArray        m_frames;     // Ring of slots of m_frameBytes
+    unsigned          m_frameBytes;
+    unsigned          m_slotMask;
+    unsigned          m_delay;      // Frames the reference is held back
+    volatile unsigned m_in;         // Frames ever written, only Receive() changes it
 };
 
 
@@ -124,6 +131,21 @@ public:
 
   //@}
 
+  /**@@name Statistics */
+  //@{
+  /**Get the microseconds spent cancelling echo, on the recording thread.
+   */
+    PInt64 GetProcessingTime() const { return m_processingTime; }
+
+  /**Get the number of recorded frames echo was cancelled on.
+   */
+    PUInt64 GetFrameCount() const { return m_frameCount; }
+
+  /**Get the share of one CPU used, in tenths of a percent of real time.
+   */
+    unsigned GetLoad() const;
+  //@}
+
 protected:
 
   H323_AECBuffer           m_echoBuffer;
@@ -142,6 +164,9 @@ protected:
 
   unsigned m_tail;                           // Tail of echo to search
 
+  PInt64   m_processingTime;                 // Microseconds in the canceller
+  PUInt64  m_frameCount;                     // Frames cancelled
+
 };
 
 // End Of File ///////////////////////////////////////////////////////////////
@@ -0,0 +1,125 @@
+/*
+ * g711block.h
+ *
+ * Block G.711 A-law/u-law transcoding
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#ifndef __OPAL_G711BLOCK_H
+#define __OPAL_G711BLOCK_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include "openh323buildopts.h"
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**Convert whole blocks of samples between 16 bit linear PCM and G.711.
+   The results are bit exact with the per sample linear2alaw(),
+   alaw2linear(), linear2ulaw() and ulaw2linear() functions in g711.h.
+
+   The kernel used is selected once when the library is loaded. Decoding
+   is always a table lookup. Encoding uses AVX2 if the processor has it
+   and the compiler can target it, SSE2 on x86 builds that allow it, and
+   a table lookup otherwise. Define H323_G711_NO_SIMD to build without
+   the vector kernels.
+  */
+class H323_G711Block
+{
+  public:
+    enum Kernels {
+      ScalarKernel,   ///< Per sample reference functions
+      TableKernel,    ///< Lookup tables
+      SSE2Kernel,     ///< SSE2 encode, table decode
+      AVX2Kernel,     ///< AVX2 encode, table decode
+      NumKernels
+    };
+
+    /**Encode count linear samples to A-law.
+      */
+    static void EncodeALaw(
+      const short * from,   ///< Linear samples
+      BYTE * to,            ///< Buffer for count A-law bytes
+      unsigned count        ///< Number of samples
+    );
+
+    /**Decode count A-law bytes to linear samples.
+      */
+    static void DecodeALaw(
+      const BYTE * from,    ///< A-law bytes
+      short * to,           ///< Buffer for count linear samples
+      unsigned count        ///< Number of samples
+    );
+
+    /**Encode count linear samples to u-law.
+      */
+    static void EncodeuLaw(
+      const short * from,   ///< Linear samples
+      BYTE * to,            ///< Buffer for count u-law bytes
+      unsigned count        ///< Number of samples
+    );
+
+    /**Decode count u-law bytes to linear samples.
+      */
+    static void DecodeuLaw(
+      const BYTE * from,    ///< u-law bytes
+      short * to,           ///< Buffer for count linear samples
+      unsigned count        ///< Number of samples
+    );
+
+    /**Get the kernel in use.
+      */
+    static Kernels GetKernel();
+
+    /**Select the kernel to use, for example to compare them.
+       Returns FALSE if the kernel is not supported by this build or
+       processor.
+      */
+    static PBoolean SetKernel(
+      Kernels kernel    ///< Kernel to use
+    );
+
+    /**Indicate a kernel is supported by this build and processor.
+      */
+    static PBoolean IsKernelAvailable(
+      Kernels kernel    ///< Kernel to check
+    );
+
+    /**Get the name of a kernel.
+      */
+    static const char * GetKernelName(
+      Kernels kernel    ///< Kernel to name
+    );
+};
+
+
+#endif // __OPAL_G711BLOCK_H
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -37,6 +37,8 @@
 #include "h225ras.h"
 #include "h235auth.h"
 
+#include <map>
+
 #ifdef P_USE_PRAGMA
 #pragma interface
 #endif
@@ -50,6 +52,7 @@ class H225_H323_UU_PDU;
 class H225_AlternateGK;
 class H225_ArrayOf_AlternateGK;
 class H225_ArrayOf_ServiceControlSession;
+struct AdmissionRequestResponseInfo;
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -200,6 +203,104 @@ class H323Gatekeeper : public H225_RAS
       unsigned requestedBandwidth     ///< New bandwidth wanted in 0.1kbps
     );
 
+    /**A request to the gatekeeper made without waiting for its response.
+       It is passed to the notifier given to the Start...Request() function
+       that made it, with INT extra TRUE if the request was confirmed, and
+       deleted when the notifier returns.
+      */
+    class AsyncRequest : public PObject
+    {
+        PCLASSINFO(AsyncRequest, PObject);
+      public:
+        ~AsyncRequest();
+
+        /**Get the RAS message tag of the request.
+          */
+        unsigned GetTag() const;
+
+        /**Indicate the request was confirmed.
+          */
+        PBoolean IsConfirmed() const { return confirmed; }
+
+        /**Indicate no response was received before the retries ran out.
+          */
+        PBoolean IsTimedOut() const;
+
+        /**Get the reject reason of a rejected request.
+          */
+        unsigned GetRejectReason() const { return request != NULL ? request->rejectReason : UINT_MAX; }
+
+        /**Get the address returned by a LocationRequest.
+          */
+        const H323TransportAddress & GetAddress() const { return address; }
+
+        /**Get the bandwidth allocated by an AdmissionRequest or
+           BandwidthRequest in 0.1kbps.
+          */
+        unsigned GetBandwidth() const { return bandwidth; }
+
+      protected:
+        AsyncRequest(H323Gatekeeper & gatekeeper, const PNotifier & notifier);
+        PBoolean Start(void * responseInfo);
+        void Complete(PBoolean ok);
+        PDECLARE_NOTIFIER(PObject, AsyncRequest, OnCompleted);
+
+        H323Gatekeeper & gatekeeper;
+        H323RasPDU     * pdu;
+        Request        * request;
+        PNotifier        notifier;
+        PBoolean         confirmed;
+        H323TransportAddress address;
+        unsigned         bandwidth;
+        H323Connection * connection;
+        AdmissionRequestResponseInfo * admission;
+        PString          cacheKey;
+
+      friend class H323Gatekeeper;
+    };
+
+    /**Location request to gatekeeper, without waiting for the response.
+       Returns FALSE if the request could not be sent.
+     */
+    PBoolean StartLocationRequest(
+      const PStringList & aliases,    ///< Alias names we wish to find.
+      const PNotifier & notifier      ///< Called with the AsyncRequest
+    );
+
+    /**Admission request to gatekeeper, without waiting for the response.
+       The connection and the response parameters must remain valid until
+       the notifier is called. A pre-granted or remembered admission calls
+       the notifier before returning. When confirmed, the connection bandwidth and UUIEs
+       requested are set as by AdmissionRequest(). There is no reregistering
+       and retrying on a reject for not being registered, a reregistration
+       is started instead.
+       Returns FALSE if the request could not be made.
+     */
+    PBoolean StartAdmissionRequest(
+      H323Connection & connection,    ///< Connection we wish admitted.
+      AdmissionResponse & response,   ///< Response parameters to ARQ
+      const PNotifier & notifier      ///< Called with the AsyncRequest
+    );
+
+    /**Bandwidth request to gatekeeper, without waiting for the response.
+       The connection must remain valid until the notifier is called.
+       Returns FALSE if the request could not be sent.
+     */
+    PBoolean StartBandwidthRequest(
+      H323Connection & connection,    ///< Connection we wish to change.
+      unsigned requestedBandwidth,    ///< New bandwidth wanted in 0.1kbps
+      const PNotifier & notifier      ///< Called with the AsyncRequest
+    );
+
+    /**Disengage request to gatekeeper, without waiting for the response.
+       Returns FALSE if the request could not be sent.
+     */
+    PBoolean StartDisengageRequest(
+      const H323Connection & connection,  ///< Connection we wish disengaged.
+      unsigned reason,                    ///< Reason code for disengage
+      const PNotifier & notifier          ///< Called with the AsyncRequest
+    );
+
     /**Send an unsolicited info response to the gatekeeper.
      */
     void InfoRequestResponse();
@@ -292,6 +393,71 @@ class H323Gatekeeper : public H225_RAS
      * Start Discovery of Gatekeeper at given transport Address.
      */
     PBoolean StartDiscovery(const H323TransportAddress & address);
+
+    /**Set the time the result of an ARQ or LRQ is reused for later requests
+       for the same destination. An outgoing call to a destination admitted
+       within that time is not sent an ARQ, so the gatekeeper neither sees
+       nor approves it, and should only be used where the gatekeeper policy
+       allows calls without admission. Only admissions of direct routed
+       calls without tokens, alternate endpoints, service control or generic
+       data are reused. The results are forgotten on registering again.
+       The default of zero disables it.
+      */
+    void SetAdmissionCacheTime(
+      const PTimeInterval & time   ///< Time a result is reused
+    ) { admissionCacheTime = time; }
+
+    /**Get the time the result of an ARQ or LRQ is reused.
+      */
+    const PTimeInterval & GetAdmissionCacheTime() const { return admissionCacheTime; }
+
+    /**Forget the remembered results of ARQ and LRQ.
+      */
+    void ClearAdmissionCache();
+
+    /**Set the largest encoded size of an unsolicited IRR.
+       When set, the periodic IRR reporting all calls is split into as many
+       IRRs of at most this size as needed, sent spread over the reporting
+       interval rather than together, and IRRs for single calls made by
+       InfoRequestResponse(connection) are held briefly and sent together.
+       The default of zero sends all calls in one IRR, as many as fit in
+       the limit of 100 calls.
+      */
+    void SetInfoRequestBatchSize(
+      PINDEX size   ///< Largest IRR in bytes, zero disables
+    ) { infoRequestBatchSize = size; }
+
+    /**Get the largest encoded size of an unsolicited IRR.
+      */
+    PINDEX GetInfoRequestBatchSize() const { return infoRequestBatchSize; }
+
+    /**Probe the gatekeeper and its alternates in the background, sending a
+       GRQ to all of them at once every interval from a socket of its own.
+       A gatekeeper that misses the given number of probes in a row, or does
+       not answer a request, is marked down until it answers a probe again.
+       While the gatekeeper is marked down requests go straight to the
+       alternates that are up, instead of to each alternate in turn after
+       the timeouts and retries of every request. An interval of zero, the
+       default, stops probing.
+      */
+    void SetHealthProbing(
+      const PTimeInterval & interval,   ///< Time between probes, zero disables
+      unsigned missLimit = 3            ///< Probes missed to be marked down
+    );
+
+    /**Determine if a gatekeeper has been marked down by the probing, always
+       FALSE when not probing.
+      */
+    PBoolean IsGatekeeperDown(
+      const H323TransportAddress & address   ///< RAS address of gatekeeper
+    ) const;
+
+    /**Get the round trip time of the last probe a gatekeeper answered in
+       milliseconds, -1 if none has been.
+      */
+    PInt64 GetProbeRoundTrip(
+      const H323TransportAddress & address   ///< RAS address of gatekeeper
+    ) const;
   //@}
     
 	class AlternateInfo : public PObject {
@@ -344,6 +510,7 @@ class H323Gatekeeper : public H225_RAS
       H225_InfoRequestResponse & irr,
       H323RasPDU & response
     );
+    void SendInfoRequestResponseBatch();
 
     void SetAlternates(
       const H225_ArrayOf_AlternateGK & alts,
@@ -361,11 +528,57 @@ class H323Gatekeeper : public H225_RAS
     virtual PBoolean MakeRequest(
       Request & request
     );
+    virtual PBoolean StartRequest(
+      Request & request,
+      const PNotifier & completed
+    );
+    void BuildLocationRequest(
+      H323RasPDU & pdu,
+      unsigned seqNum,
+      const PStringList & aliases
+    );
+    void BuildAdmissionRequest(
+      H323RasPDU & pdu,
+      unsigned seqNum,
+      H323Connection & connection,
+      AdmissionResponse & response,
+      AdmissionRequestResponseInfo & info
+    );
+    void BuildDisengageRequest(
+      H323RasPDU & pdu,
+      unsigned seqNum,
+      const H323Connection & connection,
+      unsigned reason
+    );
+    void BuildBandwidthRequest(
+      H323RasPDU & pdu,
+      unsigned seqNum,
+      H323Connection & connection,
+      unsigned requestedBandwidth
+    );
+    PBoolean AdmitWithoutRequest(
+      H323Connection & connection,
+      AdmissionResponse & response,
+      PBoolean usePreGrantedARQ,
+      PString & cacheKey,
+      PBoolean & admitted
+    );
+    void RememberAdmission(
+      const PString & cacheKey,
+      const AdmissionRequestResponseInfo & info
+    );
     PBoolean MakeRequestWithReregister(
       Request & request,
       unsigned unregisteredTag
     );
 
+    void StopProbing();
+    void SendProbes(PInt64 now);
+    void OnProbeAnswer(unsigned sequenceNumber, PInt64 now);
+    void MarkGatekeeperDown(const H323TransportAddress & address);
+    PBoolean IsAnyAlternateUp() const;
+    PDECLARE_NOTIFIER(PThread, H323Gatekeeper, ProbeMain);
+
 
     // Gatekeeper registration state variables
     PBoolean     discoveryComplete;
@@ -388,6 +601,43 @@ class H323Gatekeeper : public H225_RAS
     } pregrantMakeCall, pregrantAnswerCall;
     H323TransportAddress gkRouteAddress;
 
+    struct CachedAdmission {
+      H225_AdmissionConfirm confirm;
+      PInt64                expiry;    // Tick the result is forgotten at
+    };
+    typedef std::map<PString, CachedAdmission> AdmissionCache;
+    struct CachedLocation {
+      H323TransportAddress address;
+      PInt64               expiry;
+    };
+    typedef std::map<PString, CachedLocation> LocationCache;
+
+    PTimeInterval  admissionCacheTime;
+    AdmissionCache admissionCache;       // By destination and requested address
+    LocationCache  locationCache;        // By destination aliases
+    PMutex         admissionCacheMutex;
+
+    struct ProbeState {
+      ProbeState() : sequenceNumber(0), sent(0), answered(0), roundTrip(-1), missed(0), down(FALSE) { }
+      unsigned sequenceNumber;   // Of the last probe sent
+      PInt64   sent;             // Ticks in milliseconds
+      PInt64   answered;
+      PInt64   roundTrip;
+      unsigned missed;           // Probes in a row not answered
+      PBoolean down;
+    };
+    typedef std::map<PString, ProbeState> ProbeStates;
+
+    PTimeInterval  probeInterval;
+    unsigned       probeMissLimit;
+    PUDPSocket   * probeSocket;
+    PThread      * probeThread;
+    PBoolean       probeStop;
+    unsigned       probeSequenceNumber;
+    ProbeStates    probes;               // By RAS address
+    PStringList    probeAlternates;      // RAS addresses of the alternates
+    mutable PMutex probeMutex;
+
     // Gatekeeper operation variables
     PBoolean       autoReregister;
     PBoolean       reregisterNow;
@@ -395,6 +645,11 @@ class H323Gatekeeper : public H225_RAS
     PBoolean       requiresDiscovery;
     PTimer     infoRequestRate;
     PBoolean       willRespondToIRR;
+    PINDEX         infoRequestBatchSize;
+    PStringList    infoRequestPending;   // Calls waiting for a batched IRR
+    PTimer         infoRequestBatchTimer;
+    PTimeInterval  infoRequestSpacing;   // Between the IRRs of a cycle
+    PMutex         infoRequestMutex;
     PThread  * monitor;
     PBoolean       monitorStop;
     PSyncPoint monitorTickle;
@@ -0,0 +1,252 @@
+/*
+ * gkcluster.h
+ *
+ * Registrations shared by a cluster of gatekeepers
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+
+#ifndef __OPAL_GKCLUSTER_H
+#define __OPAL_GKCLUSTER_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include "openh323buildopts.h"
+
+#include "transports.h"
+
+#include <map>
+#include <vector>
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**The registrations of a cluster of gatekeepers, so each node of the
+   cluster can locate the endpoints registered with any of them. A node
+   publishes the endpoints registered with it and looks up the others. Its
+   own endpoints are still found through its H323GatekeeperServer, the
+   store is asked only for aliases not registered locally.
+
+   This is an interface, a store is an implementation of it, such as
+   H323GossipRegistrationStore, or a descendant using a shared key value
+   database.
+  */
+class H323RegistrationStore : public PObject
+{
+  PCLASSINFO(H323RegistrationStore, PObject);
+
+  public:
+    /**An endpoint registration as the cluster shares it.
+      */
+    struct Registration {
+      Registration() : version(0) { }
+
+      PString                   identifier;       ///< Endpoint identifier, unique in the cluster
+      PString                   node;             ///< Node the endpoint is registered with
+      PInt64                    version;          ///< Milliseconds since 1970 it was published
+      PStringArray              aliases;
+      PStringArray              prefixes;         ///< Voice prefixes of a gateway
+      H323TransportAddressArray signalAddresses;
+      H323TransportAddressArray rasAddresses;
+    };
+
+    /**Another node of the cluster, to be given as an alternate gatekeeper.
+      */
+    struct Node {
+      PString              name;
+      H323TransportAddress rasAddress;
+      PINDEX               registrations;   ///< Endpoints registered with it
+    };
+
+    /**Create a store for the node of the cluster given.
+      */
+    H323RegistrationStore(
+      const PString & nodeName,                 ///< Name of this node, unique in the cluster
+      const H323TransportAddress & rasAddress   ///< RAS address endpoints are given for this node
+    );
+
+    /**Get the name of this node.
+      */
+    const PString & GetNodeName() const { return nodeName; }
+
+    /**Get the RAS address endpoints are given for this node.
+      */
+    const H323TransportAddress & GetRASAddress() const { return rasAddress; }
+
+    /**Add or replace an endpoint registered with this node.
+      */
+    virtual void Publish(
+      const Registration & registration   ///< Registration, node and version are set
+    ) = 0;
+
+    /**Remove an endpoint registered with this node.
+      */
+    virtual void Withdraw(
+      const PString & identifier          ///< Endpoint identifier
+    ) = 0;
+
+    /**Find the endpoint registered with another node with the alias given,
+       or, for a number, with the longest voice prefix of it. If several
+       have it the one published last is taken, an endpoint moved to
+       another node after a failure still having its old registration for a
+       while. Returns FALSE if no other node has it.
+      */
+    virtual PBoolean Locate(
+      const PString & alias,              ///< Alias to find
+      Registration & registration         ///< Registration found
+    ) = 0;
+
+    /**Get the other nodes of the cluster known to be running, the least
+       loaded first.
+      */
+    virtual void GetNodes(
+      std::vector<Node> & nodes           ///< Nodes found
+    ) = 0;
+
+  protected:
+    PString              nodeName;
+    H323TransportAddress rasAddress;
+};
+
+
+/**Registration store replicated between the nodes of a cluster by UDP
+   messages, each node sending every other node the changes to its own
+   endpoints as they happen. A node also announces itself every sync
+   interval, with the sequence number of its last change. Another node
+   that missed a change, or has just started, asks it for all of its
+   endpoints. A node not heard from for three intervals is taken to have
+   stopped and its endpoints are forgotten, they register with an
+   alternate, another node, again.
+
+   The messages are not authenticated, the nodes must be on a network
+   where only they can send to the cluster port.
+  */
+class H323GossipRegistrationStore : public H323RegistrationStore
+{
+  PCLASSINFO(H323GossipRegistrationStore, H323RegistrationStore);
+
+  public:
+    enum {
+      DefaultPort = 1730    ///< Default UDP port of the cluster messages
+    };
+
+    /**Create a store for the node of the cluster given.
+      */
+    H323GossipRegistrationStore(
+      const PString & nodeName,                 ///< Name of this node, unique in the cluster
+      const H323TransportAddress & rasAddress   ///< RAS address endpoints are given for this node
+    );
+
+    /**Destroy the store, closing it.
+      */
+    ~H323GossipRegistrationStore();
+
+    /**Start sending and receiving the cluster messages on the address given.
+      */
+    PBoolean Open(
+      const H323TransportAddress & address      ///< Local address of the cluster messages
+    );
+
+    /**Stop sending and receiving the cluster messages.
+      */
+    void Close();
+
+    /**Add another node of the cluster by the address of its messages.
+      */
+    void AddPeer(
+      const H323TransportAddress & address      ///< Address of the node's messages
+    );
+
+    /**Set the interval a node announces itself. Default five seconds.
+      */
+    void SetSyncInterval(
+      const PTimeInterval & interval
+    ) { syncInterval = interval; }
+
+    /**Get the interval a node announces itself.
+      */
+    const PTimeInterval & GetSyncInterval() const { return syncInterval; }
+
+    // Overrides from H323RegistrationStore
+    virtual void Publish(const Registration & registration);
+    virtual void Withdraw(const PString & identifier);
+    virtual PBoolean Locate(const PString & alias, Registration & registration);
+    virtual void GetNodes(std::vector<Node> & nodes);
+
+  protected:
+    struct Peer {
+      Peer() : port(0), sequence(0), lastHeard(0), synced(FALSE), nextPart(0), registrations(0) { }
+
+      PIPSocket::Address   address;           // Source of its messages
+      WORD                 port;
+      H323TransportAddress rasAddress;
+      unsigned             sequence;          // Its last change applied
+      PInt64               lastHeard;         // PTimer::Tick() milliseconds
+      PBoolean             synced;            // Has all of its endpoints
+      PINDEX               nextPart;          // Of the full sync being received
+      PINDEX               registrations;
+      std::map<PString, Registration> endpoints;
+    };
+
+    PDECLARE_NOTIFIER(PThread, H323GossipRegistrationStore, ReceiveMain);
+
+    void OnMessage(const PString & message, const PIPSocket::Address & address, WORD port);
+    void SendAnnouncement();
+    void SendAll(const PIPSocket::Address & address, WORD port);
+    void SendToPeers(const PString & message);
+    void SendTo(const PString & message, const PIPSocket::Address & address, WORD port);
+    void RemovePeer(const PString & name);
+    void AddIndex(const Registration & registration);
+    void RemoveIndex(const Registration & registration);
+    PString Encode(const Registration & registration) const;
+    PBoolean Decode(const PString & line, Registration & registration) const;
+
+    PUDPSocket   * socket;
+    PThread      * receiveThread;
+    PBoolean       running;
+    PTimeInterval  syncInterval;
+
+    H323TransportAddressArray peerAddresses;
+
+    PMutex   mutex;
+    unsigned sequence;        // Last change made to our own endpoints
+    std::map<PString, Registration> ownEndpoints;
+    std::map<PString, Peer>         peers;
+
+    // Aliases and prefixes of the endpoints of other nodes, to the node
+    // and endpoint identifier
+    typedef std::multimap<PString, std::pair<PString, PString> > IndexMap;
+    IndexMap byAlias;
+    IndexMap byPrefix;
+};
+
+
+#endif // __OPAL_GKCLUSTER_H
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,154 @@
+/*
+ * gkrelay.h
+ *
+ * Signalling relay for gatekeeper routed calls
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+
+#ifndef __OPAL_GKRELAY_H
+#define __OPAL_GKRELAY_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include "openh323buildopts.h"
+
+#include "transports.h"
+
+#include <set>
+
+class Q931;
+class H225_Setup_UUIE;
+class H323GatekeeperServer;
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**Relay of the call signalling of gatekeeper routed calls. The relay
+   accepts the H.225 call signalling connection of the caller, connects to
+   the called endpoint and forwards the TPKTs between the two as they are
+   read, in the buffer they were read into.
+
+   Only the SETUP is decoded, to find where the call goes and to give the
+   called leg its destCallSignalAddress and the relay as its
+   sourceCallSignalAddress. Every other message goes through untouched,
+   without being decoded or encoded again. A SETUP carrying H.235 tokens is
+   forwarded as received, changing it would fail their integrity check.
+
+   H.245, tunnelled or on its own connection, and the media go between the
+   endpoints. Calls needing more than this, such as H.245 or media routing,
+   are still terminated with an H323Connection on each leg.
+  */
+class H323SignallingRelay : public PObject
+{
+  PCLASSINFO(H323SignallingRelay, PObject);
+
+  public:
+  /**@name Construction */
+  //@{
+    /**Create a relay for the calls routed by the gatekeeper.
+      */
+    H323SignallingRelay(
+      H323GatekeeperServer & gatekeeper
+    );
+
+    /**Close the relay, ending every call relayed.
+      */
+    ~H323SignallingRelay();
+  //@}
+
+  /**@name Operations */
+  //@{
+    /**Listen for call signalling connections on the interface, such as
+       "tcp$*:1720". The signal address given to endpoints is the first
+       address of the interface.
+      */
+    PBoolean Open(
+      const H323TransportAddress & iface
+    );
+
+    /**Stop listening and end every call relayed.
+      */
+    void Close();
+
+    /**Get the call signalling address endpoints are sent to.
+      */
+    const H323TransportAddress & GetSignalAddress() const { return signalAddress; }
+
+    /**Get the number of calls being relayed.
+      */
+    PINDEX GetCallCount() const;
+
+    /**Get the number of calls relayed since opened.
+      */
+    unsigned GetTotalCalls() const { return totalCalls; }
+
+    /**Get the number of TPKTs forwarded as received.
+      */
+    PInt64 GetForwardedPDUs() const { return forwardedPDUs; }
+  //@}
+
+  /**@name Overrides */
+  //@{
+    /**Determine where a call goes. The default behaviour locates the first
+       destinationAddress alias that H323GatekeeperServer::LocateSignalAddress()
+       can, then uses the destCallSignalAddress if it is not the relay.
+       Returns FALSE to refuse the call, which is released with no route
+       to destination.
+      */
+    virtual PBoolean OnRouteCall(
+      const Q931 & q931,                  ///<  Q.931 of the SETUP
+      const H225_Setup_UUIE & setup,      ///<  SETUP of the caller
+      H323TransportAddress & destination  ///<  Address to connect to
+    );
+  //@}
+
+  protected:
+    class Call;
+    friend class Call;
+
+    PDECLARE_NOTIFIER(PThread, H323SignallingRelay, ListenMain);
+    void OnCallEnded(Call * call);
+
+    H323GatekeeperServer & gatekeeper;
+    PTCPSocket             listener;
+    H323TransportAddress   signalAddress;
+    PThread              * listenThread;
+
+    mutable PMutex   callsMutex;
+    std::set<Call *> calls;
+    PSyncPoint       callsEnded;
+    unsigned         totalCalls;
+    volatile PInt64  forwardedPDUs;
+};
+
+
+#endif // __OPAL_GKRELAY_H
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,250 @@
+/*
+ * gkroutetable.h
+ *
+ * Compiled, memory mapped routing and password tables
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+
+#ifndef __OPAL_GKROUTETABLE_H
+#define __OPAL_GKROUTETABLE_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include "openh323buildopts.h"
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**A table of string keys and values compiled into one file, which is
+   mapped into memory and read where it lies. Loading a table of ten
+   million entries costs what loading ten does: the file is mapped and its
+   header checked, nothing is parsed or copied, and every process mapping
+   the same file shares its pages.
+
+   The file holds a header, an array of entries sorted by key giving where
+   each key and value is, then the strings. Keys are found by a binary
+   search, or by their longest prefix for number routing. Compile() writes
+   a file from a dictionary or from a text file of key and value lines,
+   replacing the old file only once it is complete. A loaded table is
+   never changed, a new one is loaded in its place, see H323RouteTableFile.
+  */
+class H323RouteTable : public PObject
+{
+  PCLASSINFO(H323RouteTable, PObject);
+  public:
+    ~H323RouteTable();
+
+    /**Load a compiled table, mapping it into memory or reading it if it
+       cannot be mapped. The table must be given back by
+       H323RouteTableFile::Release(). Returns NULL if the file could not be
+       loaded or is not a compiled table.
+      */
+    static H323RouteTable * Load(
+      const PFilePath & filename
+    );
+
+    /**Compile a table file from a dictionary.
+      */
+    static PBoolean Compile(
+      const PStringToString & entries,    ///< Keys and values
+      const PFilePath & filename          ///< Compiled table to write
+    );
+
+    /**Compile a table file from a text file with an entry on each line,
+       its key then white space and its value, which may be empty. Blank
+       lines and lines starting with # are ignored, and of a key given
+       twice the last is kept.
+      */
+    static PBoolean Compile(
+      const PFilePath & source,           ///< Text file to read
+      const PFilePath & filename          ///< Compiled table to write
+    );
+
+    /**Get the file the table was loaded from.
+      */
+    const PFilePath & GetFilePath() const { return filename; }
+
+    /**Get the time the file was last modified when it was loaded.
+      */
+    const PTime & GetModified() const { return modified; }
+
+    /**Get the number of entries.
+      */
+    PINDEX GetSize() const { return count; }
+
+    /**Get the key of an entry, in key order.
+      */
+    PString GetKey(
+      PINDEX idx
+    ) const;
+
+    /**Get the value of an entry, in key order.
+      */
+    PString GetValue(
+      PINDEX idx
+    ) const;
+
+    /**Find the value of a key. Returns FALSE if the key is not in the
+       table.
+      */
+    PBoolean Find(
+      const PString & key,
+      PString & value
+    ) const;
+
+    /**Find the value of the longest key that key starts with, for instance
+       the route of the longest number prefix of a dialled number. Returns
+       FALSE if no key is a prefix of it.
+      */
+    PBoolean FindLongestPrefix(
+      const PString & key,
+      PString & value
+    ) const;
+
+    /**Indicate the table is read from the mapped file rather than a copy.
+      */
+    PBoolean IsMapped() const { return mapping != NULL; }
+
+  protected:
+    H323RouteTable(const PFilePath & filename);
+
+    PBoolean Open();
+    PBoolean Map();
+    void Unmap();
+    PINDEX Search(const char * key, PINDEX length) const;
+    PString GetString(PINDEX idx, PINDEX field) const;
+
+    PFilePath    filename;
+    PTime        modified;
+    PInt64       fileSize;      ///< With fileId tells a file replaced within a second
+    PUInt64      fileId;        ///< Inode of the file, zero if there is none
+    PINDEX       count;
+    const BYTE * entries;       ///< Sorted by key, EntrySize bytes each
+    const BYTE * strings;
+    PINDEX       stringsSize;
+    PBYTEArray   copy;          ///< The file read, if it could not be mapped
+
+    void       * mapping;       ///< File mapped into memory, NULL if not mapped
+    PINDEX       mappingSize;
+#ifdef _WIN32
+    HANDLE       mappingHandle;
+#endif
+
+    mutable PAtomicInteger references;
+    friend class H323RouteTableFile;
+};
+
+
+/**A compiled table file in use by many threads, which is loaded again
+   when the file changes without stopping them. Reload() loads the new
+   file beside the old one and swaps the two, holding a mutex only for the
+   swap, so lookups go on against the old table while the new one loads
+   and a lookup started on the old table finishes on it. The old table is
+   unmapped once the last lookup on it is done.
+
+   The new table is to be written by H323RouteTable::Compile(), which
+   renames the complete file over the old, so a table is never loaded half
+   written. Windows does not allow replacing a mapped file, there a new
+   file is compiled under another name and given to Open().
+  */
+class H323RouteTableFile : public PObject
+{
+  PCLASSINFO(H323RouteTableFile, PObject);
+  public:
+    H323RouteTableFile();
+
+    /**Release the table, lookups still using it keep it until they are
+       done.
+      */
+    ~H323RouteTableFile();
+
+    /**Load a compiled table file, replacing any table in use. An empty
+       filename closes the table. Returns FALSE, keeping the table in use,
+       if the file could not be loaded.
+      */
+    PBoolean Open(
+      const PFilePath & filename
+    );
+
+    /**Stop using the table.
+      */
+    void Close();
+
+    /**Indicate a table is loaded.
+      */
+    PBoolean IsOpen() const;
+
+    /**Load the file again if it has been modified since it was loaded.
+       The file is taken as changed if its modification time, size or, off
+       Windows, inode differ from the one loaded, as the time is only to the
+       second. Returns FALSE if it was changed and could not be loaded, the
+       table in use is kept.
+      */
+    PBoolean Reload();
+
+    /**Get the table in use, NULL if none. It must be given back by
+       Release().
+      */
+    const H323RouteTable * Acquire() const;
+
+    /**Give back a table from Acquire() or H323RouteTable::Load().
+      */
+    static void Release(
+      const H323RouteTable * table
+    );
+
+    /**Get the number of entries of the table in use.
+      */
+    PINDEX GetSize() const;
+
+    /**Find the value of a key in the table in use.
+      */
+    PBoolean Find(
+      const PString & key,
+      PString & value
+    ) const;
+
+    /**Find the value of the longest prefix of a key in the table in use.
+      */
+    PBoolean FindLongestPrefix(
+      const PString & key,
+      PString & value
+    ) const;
+
+  protected:
+    PFilePath        filename;
+    H323RouteTable * table;
+    mutable PMutex   mutex;     ///< The table pointer only, not lookups
+};
+
+
+#endif // __OPAL_GKROUTETABLE_H
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -44,9 +44,17 @@
 #include "h235auth.h"
 #include "h323pdu.h"
 #include "h323trans.h"
+#include "gkcluster.h"
+#include "gkrelay.h"
+#include "gkroutetable.h"
 
 #include <ptlib/safecoll.h>
 
+#include <algorithm>
+#include <map>
+#include <list>
+#include <vector>
+
 class PASN_Sequence;
 class PASN_Choice;
 
@@ -86,6 +94,23 @@ class H323GatekeeperRequest : public H323Transaction
     virtual PBoolean WritePDU(
       H323TransactionPDU & pdu
     );
+
+    /**Get the priority of the request during overload. Requests for calls
+       in progress come first, then lightweight RRQs, then full RRQs, with
+       discovery last.
+      */
+    virtual H323Transactor::RequestPriority GetPriority() const;
+
+    /**Reject a request turned away during overload as resourceUnavailable,
+       which an endpoint takes as a hint to try an alternate gatekeeper.
+       Requests with no such reason are ignored and retried.
+      */
+    virtual Response OnOverload();
+
+    /**Determine if the endpoint is registered and can receive a RIP.
+      */
+    virtual PBoolean CanSendEarlyRIP() const;
+
     PBoolean CheckCryptoTokens();
     PBoolean CheckGatekeeperIdentifier();
     PBoolean GetRegisteredEndPoint();
@@ -158,6 +183,17 @@ class H323GatekeeperRRQ : public H323GatekeeperRequest
       unsigned reasonCode
     );
 
+    virtual PBoolean WritePDU(
+      H323TransactionPDU & pdu
+    );
+
+    /**Determine if the answer to the RRQ may be cached, see
+       H323GatekeeperServer::SetKeepAliveCacheTime().
+      */
+    static PBoolean IsCacheableKeepAlive(
+      const H225_RegistrationRequest & rrq
+    );
+
     H225_RegistrationRequest & rrq;
     H225_RegistrationConfirm & rcf;
     H225_RegistrationReject  & rrj;
@@ -380,6 +416,15 @@ class H323GatekeeperCall : public PSafeObject
     /**Destroy the call, removing itself from the endpoint.
       */
     ~H323GatekeeperCall();
+
+    /**Change the identifier and direction of a call used only as the key
+       to search a list of calls, so one key may be reused for many searches.
+       This must not be used on a call that is in a list.
+      */
+    void SetSearchKey(
+      const OpalGloballyUniqueID & callIdentifier, ///< Unique call identifier
+      Direction direction                          ///< Direction of call
+    );
   //@}
 
   /**@name Overrides from PObject */
@@ -545,6 +590,12 @@ class H323GatekeeperCall : public PSafeObject
     const PTime & GetConnectedTime() const { return connectedTime; }
     const PTime & GetCallEndTime() const { return callEndTime; }
     H323Connection::CallEndReason GetCallEndReason() const { return callEndReason; }
+
+    /**Fill in the journal record of the call, see H323EndPoint::SetCallJournal().
+      */
+    virtual void GetCallRecord(
+      H323CallRecord & record   ///< Record to fill in
+    ) const;
   //@}
 
   protected:
@@ -577,6 +628,53 @@ class H323GatekeeperCall : public PSafeObject
 };
 
 
+/**A compact binary record of the registrations of a gatekeeper, so it can
+   restart without waiting for every endpoint to register again. Integers
+   are big endian, strings and byte blocks are preceded by their length.
+  */
+class H323GatekeeperSnapshot : public PObject
+{
+    PCLASSINFO(H323GatekeeperSnapshot, PObject);
+  public:
+    /**Create an empty snapshot to write to.
+      */
+    H323GatekeeperSnapshot();
+
+    /**Create a snapshot to read the data given.
+      */
+    H323GatekeeperSnapshot(
+      const PBYTEArray & data
+    );
+
+    void WriteUnsigned(DWORD value);
+    void WriteInt64(PInt64 value);
+    void WriteString(const PString & str);
+    void WriteStrings(const PStringArray & strs);
+    void WriteBytes(const BYTE * bytes, PINDEX length);
+
+    PBoolean ReadUnsigned(DWORD & value);
+    PBoolean ReadInt64(PInt64 & value);
+    PBoolean ReadString(PString & str);
+    PBoolean ReadStrings(PStringArray & strs);
+    PBoolean ReadBytes(PBYTEArray & bytes);
+
+    /**Get the data written, of GetSize() bytes.
+      */
+    const PBYTEArray & GetData() const { return data; }
+
+    /**Get the number of bytes written.
+      */
+    PINDEX GetSize() const { return size; }
+
+  protected:
+    void Append(const BYTE * bytes, PINDEX length);
+
+    PBYTEArray data;
+    PINDEX     size;
+    PINDEX     offset;    // Next byte to read
+};
+
+
 /**This class describes endpoints that are registered with a gatekeeper server.
    Note that a registered endpoint has no realationship in this software to a
    H323EndPoint class. This is purely a description of endpoints that are
@@ -711,6 +809,60 @@ class H323RegisteredEndPoint : public PSafeObject
       */
     virtual PBoolean OnTimeToLive();
 
+    /**Get the time until the time to live lapses.
+       The gatekeeper calls OnTimeToLive() no earlier than this after the
+       last RRQ or IRR from the endpoint. If there is no time to live an
+       interval for a periodic check is returned.
+      */
+    virtual PTimeInterval GetTimeToLiveRemaining() const;
+
+    /**Keep the encoded RCF sent for a keep alive RRQ, to answer the next
+       keep alive RRQs from the same address with while they are the same
+       RRQ but for the sequence number. It is kept for the time set by
+       H323GatekeeperServer::SetKeepAliveCacheTime(), or until the next full
+       registration.
+      */
+    virtual void SetKeepAliveResponse(
+      const PBYTEArray & rrq,                 ///< Encoded keep alive RRQ
+      unsigned seqNum,                        ///< Sequence number of the RRQ
+      const H323TransportAddress & address,   ///< Address the RRQ came from
+      const PBYTEArray & rcf                  ///< Encoded RCF sent for it
+    );
+
+    /**Get the RCF kept by SetKeepAliveResponse() for a keep alive RRQ,
+       with the sequence number of the RRQ. The registration is refreshed
+       as the full handling of the RRQ would. Returns FALSE if there is no
+       RCF kept for the RRQ.
+      */
+    virtual PBoolean GetKeepAliveResponse(
+      H323GatekeeperListener & listener,      ///< Listener the RRQ came on
+      const PBYTEArray & rrq,                 ///< Encoded keep alive RRQ
+      const H323TransportAddress & address,   ///< Address the RRQ came from
+      PBYTEArray & rcf                        ///< Encoded RCF to send
+    );
+
+    /**Write the registration to a gatekeeper snapshot. A descendant keeping
+       more state writes it after calling this.
+      */
+    virtual void OnSaveSnapshot(
+      H323GatekeeperSnapshot & snapshot
+    ) const;
+
+    /**Read the registration from a gatekeeper snapshot written by
+       OnSaveSnapshot(). Its time to live starts again, so an endpoint that
+       sends a lightweight RRQ within it is still registered. The password
+       of an H.235 endpoint is looked up again, passwords are not kept in
+       the snapshot.
+
+       Returns FALSE, and the endpoint must register again, if the snapshot
+       is older than its time to live or its password could not be found.
+      */
+    virtual PBoolean OnLoadSnapshot(
+      H323GatekeeperSnapshot & snapshot,
+      const PTimeInterval & age,          ///< Time since the snapshot was written
+      H323GatekeeperListener * listener   ///< Listener to send requests on until the next RRQ
+    );
+
 #ifdef H323_H248
 
     /**Get the current call credit for this endpoint.
@@ -762,6 +914,13 @@ class H323RegisteredEndPoint : public PSafeObject
       const PString & username = PString::Empty()
     );
 
+    /**Forget that the endpoint was authenticated, so the password is looked
+       up again by the next full RRQ. This must be called when the users
+       password is changed or removed, if SetAuthenticationCacheTime() is
+       used.
+      */
+    void ClearAuthenticationCache() { authenticatedUntil = 0; }
+
     /**Get the endpoint identifier assigned to the endpoint.
       */
     const PString & GetIdentifier() const { return identifier; }
@@ -917,6 +1076,12 @@ class H323RegisteredEndPoint : public PSafeObject
     unsigned                  h225Version;
     unsigned                  timeToLive;
     H235Authenticators        authenticators;
+    PString                   authenticatedAlias;   // Alias the password was found for
+    PInt64                    authenticatedUntil;   // PTimer::Tick() milliseconds, zero if not cached
+    PBYTEArray                keepAliveRequest;     // Last keep alive RRQ answered
+    H323TransportAddress      keepAliveAddress;
+    PBYTEArray                keepAliveResponse;    // Encoded RCF sent for it
+    PInt64                    keepAliveUntil;       // PTimer::Tick() milliseconds, zero if not cached
 
     PTime lastRegistration;
     PTime lastInfoResponse;
@@ -976,6 +1141,29 @@ class H323GatekeeperListener : public H225_RAS
       H323GatekeeperCall * call = NULL
     );
 
+    /**Send a LocationRequest (LRQ) for an alias to a neighbouring
+       gatekeeper and return without waiting for the answer.
+       The notifier is called with the request, and INT extra TRUE if an LCF
+       was received, when it completes. The located signal address is then
+       in located. The PDU and address must remain valid until the notifier
+       has been called, after which the caller deletes the request.
+       Returns NULL if the LRQ could not be sent.
+      */
+    Request * StartLocationRequest(
+      H323RasPDU & pdu,
+      const H323TransportAddress & neighbour,
+      const H225_AliasAddress & alias,
+      H323TransportAddress & located,
+      const PNotifier & completed
+    );
+
+    /**Stop waiting for the answer to a StartLocationRequest().
+       The notifier is still called, as if no answer was received.
+      */
+    void CancelLocationRequest(
+      Request & request
+    ) { CancelRequest(request); }
+
 #ifdef H323_H248
     /**Send an ServiceControlIndication (SCI) to endpoint.
       */
@@ -1086,6 +1274,78 @@ class H323GatekeeperListener : public H225_RAS
 };
 
 
+/**This class is a search for an alias the gatekeeper could not resolve
+   itself, made of every neighbouring gatekeeper and the H.501 peer element
+   at once. A LocationRequest goes to each neighbour from a gatekeeper
+   listener without waiting for the answers, and the peer element is asked
+   on a thread of its own. The first to locate the alias ends the search,
+   the LocationRequests still outstanding are cancelled and any later
+   answer is ignored.
+  */
+class H323GatekeeperNeighbourQuery : public PObject
+{
+    PCLASSINFO(H323GatekeeperNeighbourQuery, PObject);
+  public:
+    /**Create a search for an alias, with one reference held by the caller.
+      */
+    H323GatekeeperNeighbourQuery(
+      H323GatekeeperServer & server,
+      const H225_AliasAddress & alias
+    );
+
+    /**Send the queries and wait for the first to locate the alias, for all
+       of them to fail or for the timeout.
+      */
+    PBoolean Run(
+      H323GatekeeperListener * listener,           ///< Listener to send LRQs on
+      const H323TransportAddressArray & neighbours,  ///< Neighbouring gatekeepers
+      H323PeerElement * peerElement,               ///< Peer element, may be NULL
+      const PTimeInterval & timeout                ///< Longest time to wait
+    );
+
+    /**Release the caller's reference, the search deletes itself once the
+       peer element has also answered.
+      */
+    void Release();
+
+    /**Get the aliases of the located destination.
+      */
+    const H225_ArrayOf_AliasAddress & GetAliases() const { return aliases; }
+
+    /**Get the signal address of the located destination.
+      */
+    const H323TransportAddress & GetAddress() const { return address; }
+
+  protected:
+    ~H323GatekeeperNeighbourQuery();
+
+    PDECLARE_NOTIFIER(PObject, H323GatekeeperNeighbourQuery, OnLocationCompleted);
+#ifdef H323_H501
+    PDECLARE_NOTIFIER(PThread, H323GatekeeperNeighbourQuery, PeerElementMain);
+#endif
+
+    struct Neighbour {
+      H323RasPDU             pdu;
+      H323Transactor::Request * request;
+      H323TransportAddress   located;
+      PBoolean               completed;
+    };
+
+    H323GatekeeperServer & server;
+    H225_AliasAddress      alias;
+    H323PeerElement      * peerElement;
+    std::vector<Neighbour *> neighbours;
+    PINDEX                 outstanding;    ///< LRQs not yet completed
+    PBoolean               peerPending;    ///< Peer element not yet answered
+    PINDEX                 references;
+    PBoolean               found;
+    H225_ArrayOf_AliasAddress aliases;
+    H323TransportAddress   address;
+    PMutex                 mutex;
+    PSyncPoint             answered;
+};
+
+
 /**This class implements a basic gatekeeper server functionality.
    An instance of this class contains all of the state information and
    operations for a gatekeeper. Multiple gatekeeper listeners may be using
@@ -1200,6 +1460,41 @@ class H323GatekeeperServer : public H323TransactionServer
       H323GatekeeperRRQ & request
     );
 
+    /**Create a registered endpoint object being loaded from a snapshot.
+       The default behaviour creates a H323RegisteredEndPoint, a user
+       creating descendants in CreateRegisteredEndPoint() does here too.
+      */
+    virtual H323RegisteredEndPoint * CreateRestoredEndPoint(
+      const PString & identifier
+    );
+
+    /**Write all the registrations to the file given, replacing it once
+       complete so a crash while writing leaves the previous one.
+      */
+    PBoolean SaveRegistrations(
+      const PFilePath & filename
+    );
+
+    /**Load the registrations from a file written by SaveRegistrations().
+       This is done on start up, once the listeners are added, so endpoints
+       registered before a restart are accepted at once with a lightweight
+       RRQ instead of all registering again in full. Returns the number of
+       endpoints loaded.
+      */
+    PINDEX LoadRegistrations(
+      const PFilePath & filename
+    );
+
+    /**Set the file the registrations are written to every interval, and
+       when the gatekeeper is destroyed. While nothing is registered or
+       removed only the time in the file is updated. An empty filename
+       stops it.
+      */
+    void SetRegistrationSnapshot(
+      const PFilePath & filename,
+      const PTimeInterval & interval = PTimeInterval(0, 30)
+    );
+
     /**Create a new unique identifier for the registered endpoint.
        The returned identifier must be unique over the lifetime of this
        gatekeeper server.
@@ -1390,6 +1685,105 @@ class H323GatekeeperServer : public H323TransactionServer
       H323TransportAddress & address
     );
 
+    /**Locate the signal address of an alias, ignoring gatekeeper routing.
+       This finds registered endpoints, those of the cluster, and host names
+       if aliasCanBeHostName. It is used by TranslateAliasAddressToSignalAddress()
+       for calls that are not gatekeeper routed, and by the signalling relay.
+      */
+    virtual PBoolean LocateSignalAddress(
+      const H225_AliasAddress & alias,
+      H323TransportAddress & address
+    );
+
+    /**Locate an alias through the neighbouring gatekeepers and the H.501
+       peer element. This is called by TranslateAliasAddress() for an alias
+       that is not local.
+
+       The default behaviour asks all of them at once using a
+       H323GatekeeperNeighbourQuery and takes the first answer. An alias
+       none of them could locate is not asked for again until the negative
+       cache time has passed.
+      */
+    virtual PBoolean LocateThroughNeighbours(
+      const H225_AliasAddress & alias,
+      H225_ArrayOf_AliasAddress & aliases,
+      H323TransportAddress & address
+    );
+
+    /**Add a neighbouring gatekeeper to be sent a LocationRequest for aliases
+       this gatekeeper cannot resolve.
+      */
+    void AddNeighbour(
+      const H323TransportAddress & address
+    );
+
+    /**Remove a neighbouring gatekeeper.
+      */
+    PBoolean RemoveNeighbour(
+      const H323TransportAddress & address
+    );
+
+    /**Get the neighbouring gatekeepers.
+      */
+    H323TransportAddressArray GetNeighbours() const;
+
+    /**Set the time an alias no neighbour could locate is rejected without
+       asking the neighbours again. Zero disables the negative cache.
+      */
+    void SetNeighbourNegativeCacheTime(
+      const PTimeInterval & time
+    ) { neighbourNegativeCacheTime = time; }
+
+    /**Get the time an alias no neighbour could locate is rejected without
+       asking the neighbours again.
+      */
+    const PTimeInterval & GetNeighbourNegativeCacheTime() const { return neighbourNegativeCacheTime; }
+
+    /**Set a compiled route table, see H323RouteTable, of signal addresses
+       by alias or alias prefix. An alias no endpoint is registered with is
+       routed to the address of the longest key it starts with, before the
+       neighbours are asked. The file is loaded again by the monitor thread
+       within a second of it being replaced. An empty filename removes the
+       table. Returns FALSE if the file could not be loaded.
+      */
+    PBoolean SetRouteTable(
+      const PFilePath & filename
+    ) { return routeTable.Open(filename); }
+
+    /**Get the compiled route table.
+      */
+    H323RouteTableFile & GetRouteTable() { return routeTable; }
+
+    /**Set the registration store shared with the other gatekeepers of a
+       cluster. Endpoints registered here are published to it, aliases not
+       registered here are looked up in it before asking the neighbours,
+       and RCFs give the other nodes, the least loaded first, as alternate
+       gatekeepers. The store is owned by the gatekeeper and deleted with
+       it, or when replaced. Must be set before any endpoint registers.
+      */
+    void SetRegistrationStore(
+      H323RegistrationStore * store
+    );
+
+    /**Get the registration store shared with the other gatekeepers of a
+       cluster, NULL if not clustered.
+      */
+    H323RegistrationStore * GetRegistrationStore() const { return registrationStore; }
+
+    /**Set the relay of the call signalling of routed calls, making the
+       gatekeeper routed. Calls are sent to the relay address instead of
+       being terminated by the owner endpoint. The relay is owned by the
+       gatekeeper and deleted with it, or when replaced. NULL stops relaying
+       and routing through the gatekeeper.
+      */
+    void SetSignallingRelay(
+      H323SignallingRelay * relay
+    );
+
+    /**Get the relay of the call signalling of routed calls, NULL if none.
+      */
+    H323SignallingRelay * GetSignallingRelay() const { return signallingRelay; }
+
   //@}
 
   /**@name Policy operations */
@@ -1486,6 +1880,20 @@ class H323GatekeeperServer : public H323TransactionServer
       const PString & alias,
       PString & password
     ) const;
+
+    /**Set a compiled table, see H323RouteTable, of passwords by alias, used
+       by GetUsersPassword() for aliases not in the passwords set. The file
+       is loaded again by the monitor thread within a second of it being
+       replaced. An empty filename removes the table. Returns FALSE if the
+       file could not be loaded.
+      */
+    PBoolean SetPasswordTable(
+      const PFilePath & filename
+    ) { return passwordTable.Open(filename); }
+
+    /**Get the compiled password table.
+      */
+    H323RouteTableFile & GetPasswordTable() { return passwordTable; }
   //@}
 
 #ifdef H323_H501
@@ -1578,10 +1986,64 @@ class H323GatekeeperServer : public H323TransactionServer
       */
     PBoolean IsGatekeeperRouted() const { return isGatekeeperRouted; }
 
+    /**Get flag for registered endpoints making calls without an ARQ.
+      */
+    PBoolean IsMakeCallPreGrantedARQ() const { return makeCallPreGrantedARQ; }
+
+    /**Set flag for registered endpoints making calls without an ARQ.
+       The flag is given to endpoints in their next RCF. If gatekeeper
+       routed they are told to send the call via the gatekeeper.
+      */
+    void SetMakeCallPreGrantedARQ(PBoolean mode) { makeCallPreGrantedARQ = mode; }
+
+    /**Get flag for registered endpoints answering calls without an ARQ.
+      */
+    PBoolean IsAnswerCallPreGrantedARQ() const { return answerCallPreGrantedARQ; }
+
+    /**Set flag for registered endpoints answering calls without an ARQ.
+       The flag is given to endpoints in their next RCF.
+      */
+    void SetAnswerCallPreGrantedARQ(PBoolean mode) { answerCallPreGrantedARQ = mode; }
+
     /**Get flag for if H.235 authentication is required.
       */
     PBoolean IsRequiredH235() const { return requireH235; }
 
+    /**Set the time the password found for an endpoint is used for its full
+       RRQs without calling GetUsersPassword() again. The H.235 tokens of
+       every RRQ are still checked against the password. Zero, the default,
+       disables the cache.
+
+       With the cache on, a password changed or removed in the store is not
+       seen until the time runs out, so ClearAuthenticationCache() must be
+       called on the endpoint when its credentials change.
+      */
+    void SetAuthenticationCacheTime(
+      const PTimeInterval & time
+    ) { authenticationCacheTime = time; }
+
+    /**Get the time the password found for an endpoint is used without
+       looking it up again.
+      */
+    const PTimeInterval & GetAuthenticationCacheTime() const { return authenticationCacheTime; }
+
+    /**Set the time the RCF sent for a keep alive RRQ of an endpoint is used
+       for its next keep alive RRQs, such as the frequent ones of H.460.18
+       endpoints behind a NAT. A cached RCF is sent, with only the sequence
+       number changed, to an RRQ without H.235 tokens that is the same as
+       the one it was sent for, without a transaction being made for it. So
+       changes to the gatekeeper, such as its alternate gatekeepers, reach
+       endpoints that only send keep alive RRQs up to this time late. Zero
+       disables the cache.
+      */
+    void SetKeepAliveCacheTime(
+      const PTimeInterval & time
+    ) { keepAliveCacheTime = time; }
+
+    /**Get the time the RCF for a keep alive RRQ is used for the next ones.
+      */
+    const PTimeInterval & GetKeepAliveCacheTime() const { return keepAliveCacheTime; }
+
     /**Get the currently active registration count.
       */
     unsigned GetActiveRegistrations() const { return byIdentifier.GetSize(); }
@@ -1642,10 +2104,21 @@ class H323GatekeeperServer : public H323TransactionServer
 
     PDECLARE_NOTIFIER(PThread, H323GatekeeperServer, MonitorMain);
 
+    // Publish an endpoint registered here to the cluster
+    void PublishRegistration(
+      H323RegisteredEndPoint & ep
+    );
+
+    // Schedule OnTimeToLive() for an endpoint after the delay
+    void ScheduleTimeToLive(
+      const PString & identifier,
+      const PTimeInterval & delay
+    );
+
     // Configuration & policy variables
     PString  gatekeeperIdentifier;
     unsigned totalBandwidth;
-    unsigned usedBandwidth;
+    unsigned usedBandwidth;     // Changed only by H323_ATOMIC_CAS32
     unsigned defaultBandwidth;
     unsigned maximumBandwidth;
     unsigned defaultTimeToLive;
@@ -1661,11 +2134,16 @@ class H323GatekeeperServer : public H323TransactionServer
     PBoolean     aliasCanBeHostName;
     PBoolean     requireH235;
     PBoolean     disengageOnHearbeatFail;
+    PTimeInterval authenticationCacheTime;
+    PTimeInterval keepAliveCacheTime;
 
     PStringToString passwords;
+    H323RouteTableFile passwordTable;
 
     // Dynamic variables
-    PMutex         mutex;    // TODO: Needs fixing already declared in H323TransactionServer
+    H323ProfiledMutex mutex; // TODO: Needs fixing already declared in H323TransactionServer
+    PReadWriteMutex indexMutex;     // registration database
+    PMutex         callsMutex;      // adding calls and the call statistics
     time_t         identifierBase;
     unsigned       nextIdentifier;
     PThread      * monitorThread;  // TODO: Needs fixing already declared in H323TransactionServer
@@ -1676,18 +2154,62 @@ class H323GatekeeperServer : public H323TransactionServer
 
     H323PeerElement * peerElement;
 
+    // Neighbouring gatekeepers and the aliases none of them could locate,
+    // by alias with the PTimer::Tick() milliseconds the entry expires
+    H323TransportAddressArray neighbours;
+    PTimeInterval             neighbourNegativeCacheTime;
+    std::map<PString, PInt64> unlocatedAliases;
+    H323RouteTableFile        routeTable;
+    PINDEX                    neighbourPeerQueries;   // Peer element threads still running
+    mutable PMutex            neighbourMutex;
+    friend class H323GatekeeperNeighbourQuery;
+
+    H323RegistrationStore * registrationStore;
+    H323SignallingRelay   * signallingRelay;
+
+    // Registration snapshot, written by the monitor while changes are made
+    PFilePath      snapshotFile;
+    PTimeInterval  snapshotInterval;
+    PInt64         nextSnapshot;        // PTimer::Tick() milliseconds
+    unsigned       snapshotChanges;     // Registrations added or removed since
+    PMutex         snapshotMutex;
+
     PSafeDictionary<PString, H323RegisteredEndPoint> byIdentifier;
 
-    class StringMap : public PString {
-        PCLASSINFO(StringMap, PString);
-      public:
-        StringMap(const PString & from, const PString & id)
-          : PString(from), identifier(id) { }
-        PString identifier;
+    // Map of signal address or alias to endpoint identifier, addresses
+    // kept in binary so a lookup from a PDU formats no string
+    typedef std::multimap<H323TransportAddressKey, PString> AddressMap;
+    typedef std::multimap<PString, PString> IdentifierMap;
+    AddressMap    byAddress;
+    IdentifierMap byAlias;
+
+    // Character trie of voice prefixes, each node holding the endpoints
+    // registered with the prefix ending at that node
+    struct VoicePrefixNode {
+      ~VoicePrefixNode();
+      std::map<char, VoicePrefixNode *> children;
+      std::list<PString> identifiers;
+    };
+    VoicePrefixNode byVoicePrefix;
+
+    // Everything indexed for an endpoint, so it can be removed directly
+    struct RegistrationKeys {
+      std::vector<AddressMap::iterator> addresses;
+      std::vector<IdentifierMap::iterator> aliases;
+      std::vector<PString> prefixes;
     };
-    PSortedStringList byAddress;
-    PSortedStringList byAlias;
-    PSortedStringList byVoicePrefix;
+    std::map<PString, RegistrationKeys> byRegistration;
+
+    // Time to live checks due, by PTimer::Tick() milliseconds. An entry is
+    // only current if it matches the endpoint's slot, moving the slot
+    // leaves stale entries to be dropped when they come due.
+    std::multimap<PInt64, PString> timeToLiveSchedule;
+    std::map<PString, PInt64>      timeToLiveSlots;
+    PMutex                         timeToLiveMutex;
+
+    void AddVoicePrefix(const PString & prefix, const PString & identifier);
+    void RemoveVoicePrefix(const PString & prefix, const PString & identifier);
+    void RemoveRegistrationKeys(const PString & identifier);
 
     PSafeSortedList<H323GatekeeperCall> activeCalls;
 
@@ -68,8 +68,6 @@ private:
 
   PSyncPointAck  exitReceive;
   PBoolean threadClosed;
-
-  unsigned lastTimeStamp;
 };
 
 
@@ -120,9 +118,15 @@ public:
 
   PBoolean OnReadFrame(RTP_DataFrame & frame);
   PBoolean OnWriteFrame(RTP_DataFrame & frame);
+
+  /** Handle a received RTP packet, from the receiver thread or the media reactor
+    */
+  void OnReceivedPacket(RTP_DataFrame & packet);
     
 protected:
 
+  PDECLARE_NOTIFIER(RTP_DataFrame, OpalH224Handler, OnReactorPacket);
+
   RTP_Session * session;
 
   PBoolean canTransmit;
@@ -132,6 +136,9 @@ protected:
   PTime *transmitStartTime;
     
   OpalH224ReceiverThread *receiverThread;
+  PBoolean reactorReceive;       // received by the media reactor, no thread
+  H224_Frame *receiveFrame;
+  unsigned lastTimeStamp;
 
   PMutex handlersMutex;
   std::map<BYTE, H224_Handler*> m_h224Handlers;
@@ -323,6 +323,10 @@ const char * const OID_DH6144 = "0.0.8.235.0.4.77";
 const char * const OID_DH8192 = "0.0.8.235.0.4.78";
 #endif
 
+// Proprietary elliptic curve key agreement, preferred where both ends support it
+const char * const OID_ECDH_X25519 = "1.3.6.1.4.1.17090.3.1";
+const char * const OID_ECDH_P256   = "1.3.6.1.4.1.17090.3.2";
+
 const static struct {
     const char * parameterOID;
     unsigned     sz;
@@ -397,9 +401,13 @@ const static struct {
     { ID_AES256, OID_DH4096 },
     { ID_AES256, OID_DH2048 },
     { ID_AES256, OID_DH1536 },
+    { ID_AES256, OID_ECDH_X25519 },
+    { ID_AES256, OID_ECDH_P256 },
 #endif
     { ID_AES128, OID_DH1024 },
-    { ID_AES128, OID_DH512  }
+    { ID_AES128, OID_DH512  },
+    { ID_AES128, OID_ECDH_X25519 },
+    { ID_AES128, OID_ECDH_P256 }
 };
 
 #endif  // _H2351_H
@@ -44,6 +44,7 @@
 
 #include <ptlib.h>
 #include <ptlib/pluginmgr.h>
+#include <list>
 
 #ifdef H323_H235
 
@@ -59,6 +60,59 @@ struct H235_OIDiterator
 class H235_DiffieHellman;
 typedef std::map<PString, H235_DiffieHellman*, H235_OIDiterator> H235_DHMap;
 
+/**Pool of Diffie-Hellman key pairs generated in advance.
+   A low priority thread keeps up to the given depth of fresh key pairs for
+   each cached group, so call setup takes a ready key pair instead of
+   generating one on the signalling thread.
+  */
+class H2356_DHKeyPool : public PThread
+{
+    PCLASSINFO(H2356_DHKeyPool, PThread);
+  public:
+    struct Statistics {
+      Statistics() : m_ready(0), m_generated(0), m_taken(0), m_missed(0) { }
+
+      unsigned      m_ready;          ///< Key pairs waiting to be taken
+      unsigned      m_generated;      ///< Key pairs generated
+      unsigned      m_taken;          ///< Key pairs given to calls
+      unsigned      m_missed;         ///< Calls that found the pool empty
+      PTimeInterval m_generateTime;   ///< Total time spent generating
+    };
+
+    H2356_DHKeyPool(
+      const H235_DHMap & groups,      ///< Groups to generate key pairs for
+      unsigned depth                  ///< Key pairs to keep per group
+    );
+    ~H2356_DHKeyPool();
+
+    /**Take a key pair for the group, NULL if none is ready.
+       The caller owns the returned object.
+      */
+    H235_DiffieHellman * Take(const PString & dhOID);
+
+    /**Get the statistics for a group, FALSE if it is not pooled.
+      */
+    PBoolean GetStatistics(const PString & dhOID, Statistics & stats) const;
+
+  protected:
+    void Main();
+
+    struct Group {
+      Group() : m_parameters(NULL) { }
+
+      H235_DiffieHellman *             m_parameters;
+      std::list<H235_DiffieHellman *>  m_ready;
+      Statistics                       m_stats;
+    };
+    typedef std::map<PString, Group> GroupMap;
+
+    GroupMap       m_groups;
+    unsigned       m_depth;
+    PMutex         m_mutex;
+    PSyncPoint     m_refill;
+    PBoolean       m_stop;
+};
+
 class H2356_Authenticator : public H235Authenticator
 {
     PCLASSINFO(H2356_Authenticator, H235Authenticator);
@@ -87,6 +141,9 @@ class H2356_Authenticator : public H235Authenticator
     static void InitialiseCache(int cipherlength = 128, unsigned maxTokenLength = 1024);
     static void RemoveCache();
 
+    // get the key pool statistics for a DH group OID, FALSE if not pooled
+    static PBoolean GetKeyPoolStatistics(const PString & dhOID, H2356_DHKeyPool::Statistics & stats);
+
     PBoolean IsMatch(const PString & identifier) const; 
 
     virtual PBoolean PrepareTokens(
@@ -146,12 +203,14 @@ protected:
 private:
 
     static H235_DHMap                m_dhCachedMap;
+    static H2356_DHKeyPool *         m_dhKeyPool;
     H235_DHMap                       m_dhLocalMap;
 
     PBoolean                         m_enabled;
     PBoolean                         m_active;
     h235TokenState                   m_tokenState;
     PStringArray                     m_algOIDs;
+    PString                          m_dhOID;
       
 };
 
@@ -118,16 +118,19 @@ public:
     operator dh_st *() const { return dh; }
 
    /** Check Parameters */
-    PBoolean CheckParams() const;
+    virtual PBoolean CheckParams() const;
 
    /** SetRemotePublicKey */
     void SetRemoteKey(bignum_st * remKey);
 
    /** Generate Half Key */
-    PBoolean GenerateHalfKey();
+    virtual PBoolean GenerateHalfKey();
+
+   /** Replace any key pair with a newly generated one for the same parameters */
+    virtual PBoolean GenerateNewHalfKey();
 
    /** Compute Session key */
-    PBoolean ComputeSessionKey(PBYTEArray & SessionKey);
+    virtual PBoolean ComputeSessionKey(PBYTEArray & SessionKey);
 
    /** Get the Public Key */
     bignum_st * GetPublicKey() const;
@@ -145,7 +148,7 @@ public:
     PBoolean LoadedFromFile();
 
     /**Save Diffie-Hellman parameters to file. */
-    PBoolean Save(
+    virtual PBoolean Save(
       const PFilePath & keyFile,                 ///< Diffie-Hellman parameter file
       const PString & oid                        ///< OID section
     );
@@ -158,23 +161,23 @@ public:
 /**@name Encoding for the H245 Stream */
 //@{
     /** Encode Prime */
-      PBoolean Encode_P(PASN_BitString & p) const;
+      virtual PBoolean Encode_P(PASN_BitString & p) const;
     /** Decode Prime */
       void Decode_P(const PASN_BitString & p);
     /** Encode Generator */
-      PBoolean Encode_G(PASN_BitString & g) const;
+      virtual PBoolean Encode_G(PASN_BitString & g) const;
     /** Decode Generator */
       void Decode_G(const PASN_BitString & g);
     /** Encode Public Half Key */
-      void Encode_HalfKey(PASN_BitString & hk) const;
+      virtual void Encode_HalfKey(PASN_BitString & hk) const;
     /** decode Public Half Key */
       void Decode_HalfKey(const PASN_BitString & hk);
 
     /**Set the Half key received from remote. */
-    void SetRemoteHalfKey(const PASN_BitString & hk);
+    virtual void SetRemoteHalfKey(const PASN_BitString & hk);
 
     /**Set the Prime and Generator to that received from remote. */
-    void SetDHReceived(const PASN_BitString & p, const PASN_BitString & g);
+    virtual void SetDHReceived(const PASN_BitString & p, const PASN_BitString & g);
 //@}
 
 /**@name Miscellaneous */
@@ -196,6 +199,10 @@ public:
 //@}
 
   protected:
+    /**Create without Diffie-Hellman parameters, for other key agreements. */
+    H235_DiffieHellman(
+      int keySize                     /// Size of the public key in bytes
+    );
 
     PMutex vbMutex;                   /// Mutex
 
@@ -210,4 +217,55 @@ public:
 };
 
 
+///////////////////////////////////////////////////////////////////////////////////////
+/**Elliptic curve Diffie-Hellman key agreement.
+   This is a proprietary alternative to the H.235.6 finite field groups,
+   negotiated with the OID_ECDH_X25519 and OID_ECDH_P256 token OIDs. The
+   public key is carried as the halfkey of the token with no prime or
+   generator. Each copy generates its own key pair, which takes a few
+   microseconds.
+  */
+struct evp_pkey_st;
+class H235_EllipticCurveDH : public H235_DiffieHellman
+{
+  PCLASSINFO(H235_EllipticCurveDH, H235_DiffieHellman);
+public:
+    /**Create a key pair for the curve of the OID.
+      */
+    H235_EllipticCurveDH(
+      const PString & oid                 ///< OID_ECDH_X25519 or OID_ECDH_P256
+    );
+
+    /**Create a key pair for the same curve, not a copy of the key.
+      */
+    H235_EllipticCurveDH(
+      const H235_EllipticCurveDH & other
+    );
+
+    ~H235_EllipticCurveDH();
+
+    /**Indicate the OID is an elliptic curve supported by this build.
+      */
+    static PBoolean IsSupported(const PString & oid);
+
+    virtual PObject * Clone() const;
+    virtual PBoolean CheckParams() const;
+    virtual PBoolean GenerateHalfKey();
+    virtual PBoolean GenerateNewHalfKey();
+    virtual PBoolean ComputeSessionKey(PBYTEArray & SessionKey);
+    virtual PBoolean Save(const PFilePath & keyFile, const PString & oid);
+    virtual PBoolean Encode_P(PASN_BitString & p) const;
+    virtual PBoolean Encode_G(PASN_BitString & g) const;
+    virtual void Encode_HalfKey(PASN_BitString & hk) const;
+    virtual void SetRemoteHalfKey(const PASN_BitString & hk);
+    virtual void SetDHReceived(const PASN_BitString & p, const PASN_BitString & g);
+
+  protected:
+    int           m_keyType;          /// EVP_PKEY_X25519 or EVP_PKEY_EC
+    evp_pkey_st * m_key;              /// Local key pair
+    PBYTEArray    m_publicKey;        /// Encoded local public key
+    PBYTEArray    m_remotePublicKey;  /// Encoded remote public key
+};
+
+
 #endif // H_H235Support
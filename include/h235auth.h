@@ -302,6 +302,14 @@ PDECLARE_LIST(H235Authenticators, H235Authenticator)
     static void SetMaxTokenLength(PINDEX len);
     static PINDEX GetMaxTokenLength();
 
+    // number of DH key pairs generated in advance per group, 0 to disable
+    static void SetDHKeyPoolDepth(PINDEX depth);
+    static PINDEX GetDHKeyPoolDepth();
+
+    // offer the proprietary elliptic curve key agreements
+    static void SetEllipticCurveKeyAgreement(PBoolean enable);
+    static PBoolean GetEllipticCurveKeyAgreement();
+
     static PString & GetDHParameterFile();
     static void SetDHParameterFile(const PString & filePaths);
 
@@ -314,6 +322,8 @@ PDECLARE_LIST(H235Authenticators, H235Authenticator)
     static PINDEX m_encryptionPolicy;
     static PINDEX m_cipherLength;
     static PINDEX m_maxTokenLength;
+    static PINDEX m_dhKeyPoolDepth;
+    static PBoolean m_ellipticCurve;
     static PString m_dhFile;
     static DH_DataList m_dhData;
 #endif
@@ -584,10 +594,17 @@ class H2351_Authenticator : public H235Authenticator
     virtual void VerifyRandomNumber(bool value) { m_verifyRandomNumber = value; }
 
 protected:
+    const BYTE * GetSecretKey();
+
     PBoolean m_requireGeneralID;
     PBoolean m_checkSendersID;
     PBoolean m_fullQ931Checking;
     PBoolean m_verifyRandomNumber;
+
+    // SHA1 of the password, kept while the password is unchanged
+    PString  m_secretKeyPassword;
+    BYTE     m_secretKey[20];
+    PBoolean m_secretKeyValid;
 };
 
 typedef H2351_Authenticator H235AuthProcedure1;  // Backwards interoperability
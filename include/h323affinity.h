@@ -0,0 +1,161 @@
+/*
+ * h323affinity.h
+ *
+ * CPU affinity of media and signalling threads
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#ifndef __H323AFFINITY_H
+#define __H323AFFINITY_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include "openh323buildopts.h"
+
+#include <vector>
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**A set of CPUs a class of threads may run on.
+   The set is written as a list of CPU numbers and ranges, for example
+   "0-3,8,10-11", or as "node1" for every CPU of a NUMA node. Linux reads the
+   node from /sys/devices/system/node, Windows only pins to the first 64
+   CPUs and other platforms ignore the set.
+
+   Memory is not placed on a node explicitly. Linux allocates a page on the
+   node of the thread that first touches it, so the buffers a pinned thread
+   creates for its calls are local to the node it is pinned to.
+  */
+class H323CPUSet : public PObject
+{
+  PCLASSINFO(H323CPUSet, PObject);
+
+  public:
+  /**@name Construction */
+  //@{
+    /**Create an empty set, threads are left where the system puts them.
+      */
+    H323CPUSet();
+
+    /**Create a set from a list of CPUs.
+      */
+    H323CPUSet(
+      const PString & list   ///< CPU list or NUMA node
+    );
+  //@}
+
+  /**@name Operations */
+  //@{
+    /**Set the CPUs from a list of numbers and ranges, or a NUMA node.
+       Returns FALSE and leaves the set empty if the list could not be parsed.
+      */
+    PBoolean Parse(
+      const PString & list   ///< CPU list or NUMA node
+    );
+
+    /**Add a CPU to the set.
+      */
+    void Add(
+      unsigned cpu          ///< CPU number
+    );
+
+    /**Indicate the set has no CPUs, so nothing is pinned.
+      */
+    PBoolean IsEmpty() const { return cpus.empty(); }
+
+    /**Get the number of CPUs in the set.
+      */
+    PINDEX GetSize() const { return cpus.size(); }
+
+    /**Get a CPU of the set, in ascending order.
+      */
+    unsigned operator[](PINDEX index) const { return cpus[index]; }
+
+    /**Indicate the CPU is in the set.
+      */
+    PBoolean Contains(
+      unsigned cpu          ///< CPU number
+    ) const;
+
+    /**Pin the calling thread to every CPU of the set.
+       Does nothing and returns TRUE if the set is empty.
+      */
+    PBoolean ApplyToCurrentThread() const;
+
+    /**Pin the calling thread, one of a pool of workers, to a single CPU of
+       the set so the workers are spread one per CPU.
+       Does nothing and returns TRUE if the set is empty.
+      */
+    PBoolean ApplyToCurrentThread(
+      PINDEX worker         ///< Index of the worker in its pool
+    ) const;
+
+    /**Get the CPU a worker is pinned to by ApplyToCurrentThread(worker),
+       -1 if the set is empty.
+      */
+    int GetWorkerCPU(
+      PINDEX worker         ///< Index of the worker in its pool
+    ) const;
+
+    /**Print the set in the form Parse() reads.
+      */
+    virtual void PrintOn(ostream & strm) const;
+  //@}
+
+  /**@name Platform */
+  //@{
+    /**Get the CPUs of a NUMA node, empty if not known.
+      */
+    static H323CPUSet GetNodeCPUs(
+      unsigned node         ///< NUMA node number
+    );
+
+    /**Get the CPU the calling thread is running on, -1 if not known.
+      */
+    static int GetCurrentCPU();
+
+    /**Get the CPU that handled the last packet received on a socket, which
+       is the CPU servicing its network queue, -1 if not known.
+      */
+    static int GetSocketCPU(
+      int handle            ///< Socket handle
+    );
+  //@}
+
+  protected:
+    static PBoolean SetCurrentThread(const std::vector<unsigned> & cpus);
+
+    std::vector<unsigned> cpus;
+};
+
+
+#endif // __H323AFFINITY_H
+
+
+/////////////////////////////////////////////////////////////////////////////
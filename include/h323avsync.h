@@ -0,0 +1,136 @@
+/*
+ * h323avsync.h
+ *
+ * Lip sync of received audio and video from RTCP sender reports
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+
+#ifndef __H323_AVSYNC_H
+#define __H323_AVSYNC_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include "openh323buildopts.h"
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**Lip sync of the audio and video received on a connection. The RTCP
+   sender reports of each stream map its RTP timestamps to the wall clock
+   of the sender, which both streams share. The receive channels report
+   each frame as it is played, giving for each stream the delay from the
+   sender clock to the local media clock. The offset between the two
+   clocks is unknown but the same for both, so the difference of the
+   delays is the skew.
+
+   Only the stream that is ahead is held back, so lip sync costs no more
+   delay than the skew. When audio is ahead the audio jitter buffer
+   minimum is raised by the difference, see GetAudioDelay(), and when
+   video is ahead each picture is held until the media clock time where
+   audio sent with it is played, see GetVideoDeadline().
+
+   Nothing is adjusted until both streams have had a sender report.
+  */
+class H323AVSync : public PObject
+{
+  PCLASSINFO(H323AVSync, PObject);
+
+  public:
+    enum Stream {
+      Audio,
+      Video,
+      NumStreams
+    };
+
+    H323AVSync();
+
+    /**Record the RTP and NTP timestamps of a received sender report.
+      */
+    void OnSenderReport(
+      Stream stream,          ///< Stream the report was for
+      DWORD rtpTimestamp,     ///< RTP timestamp of the report
+      const PTime & ntpTime   ///< Sender wall clock time of the report
+    );
+
+    /**Record a frame being played, audio as it leaves the jitter buffer
+       and video as the picture goes to the decoder, before any hold.
+      */
+    void OnPlayout(
+      Stream stream,          ///< Stream played
+      DWORD rtpTimestamp,     ///< RTP timestamp of the frame
+      unsigned clockRate,     ///< RTP clock rate of the stream in Hz
+      PInt64 now              ///< Microseconds, H323MediaClock time played
+    );
+
+    /**Get the delay in milliseconds to add to the audio jitter buffer
+       minimum, zero if audio is not ahead of video.
+      */
+    unsigned GetAudioDelay() const;
+
+    /**Get the H323MediaClock time in microseconds a picture should be
+       decoded for it to show with its audio. Zero if it need not be held,
+       either as video is not ahead or there is no sender report yet.
+      */
+    PInt64 GetVideoDeadline(
+      DWORD rtpTimestamp,     ///< RTP timestamp of the picture
+      unsigned clockRate      ///< RTP clock rate of the stream in Hz
+    ) const;
+
+    /**Get the skew in milliseconds, positive if video is played later
+       than audio sent at the same time, before any adjustment.
+      */
+    int GetSkew() const;
+
+    /**Forget the reports and delays of both streams.
+      */
+    void Reset();
+
+  protected:
+    struct StreamState {
+      PBoolean haveReport;
+      DWORD    reportTimestamp;
+      PInt64   reportTime;    ///< Microseconds, sender wall clock
+      PBoolean haveDelay;
+      PInt64   delay;         ///< Microseconds, smoothed local minus sender time
+    };
+
+    PInt64 GetSenderTime(const StreamState & state, DWORD rtpTimestamp, unsigned clockRate) const;
+    void Adjust(PInt64 now);
+
+    StreamState streams[NumStreams];
+    unsigned    audioDelay;     ///< Milliseconds added to the audio jitter buffer
+    PInt64      lastAdjust;     ///< Microseconds
+    mutable PMutex mutex;
+};
+
+
+#endif // __H323_AVSYNC_H
+
+
+/////////////////////////////////////////////////////////////////////////////
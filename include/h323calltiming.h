@@ -0,0 +1,168 @@
+/*
+ * h323calltiming.h
+ *
+ * Timing of the call setup milestones
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#ifndef __H323_CALLTIMING_H
+#define __H323_CALLTIMING_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include "openh323buildopts.h"
+#include "rtphist.h"
+
+#include <vector>
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**Times at which a call passed each step of its setup, in milliseconds from
+   the start of the call, the MakeCall() or the arrival of the SETUP.
+   Only the first time a milestone is reached counts, so a second ALERTING
+   or a channel reopened later does not move it. Steps that happen more
+   than once, each logical channel acknowledged, are kept as events in the
+   order they happened.
+  */
+class H323CallTimeline : public PObject
+{
+  PCLASSINFO(H323CallTimeline, PObject);
+
+  public:
+    enum Milestone {
+      e_AddressResolved,        ///< Party name parsed and looked up
+      e_AdmissionRequested,     ///< ARQ sent
+      e_AdmissionConfirmed,     ///< ACF received
+      e_TransportConnected,     ///< Signalling channel connected
+      e_SetupBuilt,             ///< SETUP ready to send
+      e_SetupSent,
+      e_SetupReceived,
+      e_CallProceeding,         ///< CALL PROCEEDING sent or received
+      e_Alerting,               ///< ALERTING sent or received
+      e_Connect,                ///< CONNECT sent or received
+      e_CapabilityExchangeDone, ///< Our TerminalCapabilitySet acknowledged
+      e_MasterSlaveDone,
+      e_FirstChannelOpened,     ///< First OpenLogicalChannel acknowledged
+      e_FirstRTPSent,
+      e_FirstRTPReceived,
+      e_Established,
+      e_Cleared,
+      NumMilestones
+    };
+
+    H323CallTimeline();
+
+    /**Set the start of the call, for an outgoing call the time MakeCall()
+       was entered rather than the time the connection was created.
+      */
+    void SetStart(
+      const PTimeInterval & tick
+    );
+
+    /**Record a milestone as reached now, if not reached before.
+      */
+    void Mark(
+      Milestone milestone
+    );
+
+    /**Record a step that may happen more than once, now.
+      */
+    void AddEvent(
+      const PString & description
+    );
+
+    /**Get the milliseconds from the start to a milestone, -1 if not reached.
+      */
+    PInt64 GetTime(
+      Milestone milestone
+    ) const;
+
+    /**Get the milliseconds from the start to now.
+      */
+    PInt64 GetElapsed() const;
+
+    /**Output the milestones and events reached, in the order they happened.
+      */
+    virtual void PrintOn(ostream & strm) const;
+
+    static const char * GetMilestoneName(
+      Milestone milestone
+    );
+
+  protected:
+    PInt64 start;
+    PInt64 times[NumMilestones];
+    std::vector<std::pair<PInt64, PString> > events;
+    mutable PMutex mutex;
+
+  private:
+    H323CallTimeline(const H323CallTimeline &) { }
+    H323CallTimeline & operator=(const H323CallTimeline &) { return *this; }
+};
+
+
+/**Distributions over ended calls of the time to each milestone.
+   Calls are recorded as they are cleaned up, by any cleaner thread, and
+   may be read from any thread without holding up the recording.
+  */
+class H323CallTimingStats : public PObject
+{
+  PCLASSINFO(H323CallTimingStats, PObject);
+
+  public:
+    H323CallTimingStats();
+
+    /**Add the milestones a call reached.
+      */
+    void Record(
+      const H323CallTimeline & timeline
+    );
+
+    /**Get the distribution of the milliseconds to a milestone over the calls
+       that reached it.
+      */
+    void GetSnapshot(
+      H323CallTimeline::Milestone milestone,
+      RTP_Histogram::Snapshot & snapshot
+    ) const;
+
+    /**Output a line for each milestone reached by any call.
+      */
+    virtual void PrintOn(ostream & strm) const;
+
+  protected:
+    RTP_Histogram histograms[H323CallTimeline::NumMilestones];
+    PMutex        mutex;    ///< Keeps the cleaner threads to one writer at a time
+};
+
+
+#endif // __H323_CALLTIMING_H
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -46,6 +46,9 @@
 #include "channels.h"
 #include "mediafmt.h"
 
+#include <map>
+#include <vector>
+
 
 /* The following classes have forward references to avoid including the VERY
    large header files for H225 and H245. If an application requires access
@@ -73,6 +76,7 @@ class H245_H223LogicalChannelParameters;
 class H245_TerminalCapabilitySet;
 class H245_NonStandardParameter;
 class H323Connection;
+class H323CapabilityCostModel;
 class H323Capabilities;
 
 
@@ -595,9 +599,24 @@ class H323GenericCapabilityInfo
 	const H323GenericCapabilityInfo & obj
 	) const;
 
+    PBoolean BuildGenericPDU(
+      H245_GenericCapability & pdu,
+      const OpalMediaFormat & mediaFormat,
+      H323Capability::CommandType type
+    ) const;
+
 
     H245_CapabilityIdentifier * identifier;
     unsigned                    maxBitRate;
+
+    // Last PDU built for each command type, and what it was built from
+    struct CachedPDU {
+      CachedPDU() : pdu(NULL), revision(0), bitRate(0) { }
+      H245_GenericCapability * pdu;
+      unsigned                 revision;
+      unsigned                 bitRate;
+    };
+    mutable CachedPDU cachedPDU[H323Capability::e_ReqMode+1];
 };
 
     
@@ -2079,6 +2098,61 @@ class H323Capabilities : public PObject
     H323Capabilities & operator=(
       const H323Capabilities & original ///< Original capabilities to duplicate
     );
+
+    /**Destroy the capability set, releasing any snapshot it shares.
+      */
+    ~H323Capabilities();
+  //@}
+
+  /**@name Sharing */
+  //@{
+    /**Create a reference counted copy of a capability set for Share().
+       The snapshot must not be changed once it is shared, and is released
+       by its creator with ReleaseSnapshot().
+      */
+    static H323Capabilities * CreateSnapshot(
+      const H323Capabilities & original ///< Capabilities to copy
+    );
+
+    /**Release a reference to a snapshot, deleting it with the last one.
+      */
+    static void ReleaseSnapshot(
+      const H323Capabilities * snapshot ///< Snapshot from CreateSnapshot()
+    );
+
+    /**Replace the set with the capabilities of a snapshot, without cloning
+       them. The set holds a reference to the snapshot and only clones a
+       capability when it is changed, so many connections can use one copy
+       of the endpoint capabilities. Capabilities added to the set are owned
+       by it as usual, and removing a shared one only takes it out of this
+       set.
+
+       A capability got from operator[] or FindCapability() must be passed
+       through GetWritable() before it is changed.
+      */
+    void Share(
+      const H323Capabilities & snapshot ///< Snapshot from CreateSnapshot()
+    );
+
+    /**Indicate the set uses capabilities of a snapshot.
+      */
+    PBoolean IsShared() const { return shared != NULL; }
+
+    /**Get the snapshot the set shares, NULL if it is not shared or has had
+       a capability added, removed, reordered or made writable since.
+      */
+    const H323Capabilities * GetSnapshot() const { return sharedIntact ? shared : NULL; }
+
+    /**Get a capability of the set that may be changed. If it is shared it
+       is replaced in the set by a clone, which is returned.
+      */
+    H323Capability * GetWritable(
+      H323Capability * capability       ///< Capability of this set
+    );
+
+    /**Clone every shared capability so the set no longer uses the snapshot.
+      */
+    void MakeUnique();
   //@}
 
   /**@name Overrides from class PObject */
@@ -2399,6 +2473,28 @@ class H323Capabilities : public PObject
       const PStringArray & preferenceOrder  ///< New order
     );
 
+    /**Move the capabilities that are also in the other table ahead of the
+       rest, keeping their order. Used on one connection of a back to back
+       pair with the remote capabilities of the other, so both connections
+       are likely to agree on a format and the media can be relayed with
+       H323_RTPChannel::SetRelayTarget() instead of transcoded.
+
+       The capabilities are matched as for the FindCapability() function
+       taking a capability.
+      */
+    void PreferMatching(
+      const H323Capabilities & other   ///< Capabilities to prefer
+    );
+
+    /**Move the capabilities of least cost to the model ahead of the rest,
+       keeping the order of capabilities of equal cost. As with Reorder()
+       the capability numbers do not change.
+      */
+    void OrderByCost(
+      const H323CapabilityCostModel & model,  ///< Cost of each capability
+      const H323Connection & connection       ///< Connection the table is for
+    );
+
     /**Test if the capability is allowed.
       */
     PBoolean IsAllowed(
@@ -2431,8 +2527,166 @@ class H323Capabilities : public PObject
   //@}
 
   protected:
+    void ReplaceCapability(PINDEX index, H323Capability * capability);
+    void OrderSetByTable();
+    void InvalidateIndex();
+    void UpdateIndex() const;
+
     H323CapabilitiesList table;
     H323CapabilitiesSet  set;
+
+    const H323Capabilities * shared;    // Snapshot the table refers into, NULL if none
+    PBoolean                 sharedIntact; // Table is still exactly the snapshot
+    H323CapabilitiesList     owned;     // Capabilities of a shared table deleted with it
+    mutable PAtomicInteger   snapshotReferences;
+
+    /* Lookups into the table, built when first needed after a change. Each
+       holds the first capability in table order, as the linear search did. */
+    typedef std::map<unsigned, H323Capability *> NumberIndex;
+    typedef std::map<std::pair<int, unsigned>, H323Capability *> TypeIndex;   // UINT_MAX subtype is any
+    typedef std::map<PCaselessString, std::vector<H323Capability *> > NameIndex; // Matches of each wildcard
+
+    mutable PMutex      indexMutex;
+    mutable PINDEX      indexedSize;    // Table size the index was built for, P_MAX_INDEX if stale
+    mutable NumberIndex numberIndex;
+    mutable TypeIndex   typeIndex;
+    mutable NameIndex   nameIndex;
+};
+
+
+/**Cost of using a capability on a connection, consulted to order the local
+   capabilities before the TerminalCapabilitySet and fast start channels
+   are built, see H323EndPoint::SetCapabilityCostModel(). Lower costs go
+   first, equal costs keep the order set by the application.
+
+   The default model puts first the capabilities the other leg of a
+   gateway call also has, set with H323Connection::SetOtherLegCapabilities(),
+   as the media of those can be relayed without transcoding. Then, only
+   while the encoders are past the load threshold of the endpoint encode
+   budget, it orders the rest by the codec costs set with SetCodecCost().
+   A gateway may override GetCost() for a model of its own.
+  */
+class H323CapabilityCostModel : public PObject
+{
+    PCLASSINFO(H323CapabilityCostModel, PObject);
+  public:
+    H323CapabilityCostModel();
+
+    /**Set the processor cost of transcoding the formats matching a name,
+       which may have '*' wildcards as for H323Capabilities::Reorder(), in
+       any unit as long as it is the same for all. The first match of a
+       format is used. Formats with no cost set cost nothing.
+      */
+    void SetCodecCost(
+      const PString & formatName,   ///< Format name to match
+      unsigned cost                 ///< Cost of transcoding
+    );
+
+    /**Set the share of the encode budget past which the codec costs are
+       used, in percent. The default is 80.
+      */
+    void SetLoadThreshold(
+      unsigned percent
+    ) { loadThreshold = percent; }
+
+    /**Get the cost of the capability on the connection. The default returns
+       0 if the media can pass through, and otherwise 1, plus the codec cost
+       if IsUnderLoad().
+      */
+    virtual unsigned GetCost(
+      const H323Connection & connection,    ///< Connection the capability is for
+      const H323Capability & capability     ///< Capability to cost
+    ) const;
+
+    /**Determine if the media of the capability can be relayed to the other
+       leg without transcoding.
+      */
+    virtual PBoolean CanPassThrough(
+      const H323Connection & connection,    ///< Connection the capability is for
+      const H323Capability & capability     ///< Capability to check
+    ) const;
+
+    /**Determine if the encoders of the endpoint are past the load
+       threshold of the encode budget.
+      */
+    virtual PBoolean IsUnderLoad(
+      const H323Connection & connection     ///< Connection being ordered
+    ) const;
+
+    /**Get the codec cost of a format set with SetCodecCost().
+      */
+    unsigned GetCodecCost(
+      const PString & formatName
+    ) const;
+
+  protected:
+    struct CodecCost {
+      PStringArray wildcard;
+      unsigned     cost;
+    };
+    std::vector<CodecCost> codecCosts;
+    unsigned loadThreshold;
+    mutable PMutex mutex;
+};
+
+
+/**Remote capabilities decoded from a TerminalCapabilitySet, kept by the
+   endpoint so a later identical set from the same type of device is not
+   decoded again. A connection whose remote table is taken from the memo
+   also uses it to remember which capabilities it selected for each
+   session, so the next connection skips matching the two tables.
+
+   The memo is reference counted like a snapshot and is released with
+   H323Capabilities::ReleaseSnapshot().
+  */
+class H323CapabilityMemo : public H323Capabilities
+{
+    PCLASSINFO(H323CapabilityMemo, H323Capabilities);
+  public:
+    /// Capability numbers of the local and remote capability of each choice
+    typedef std::vector<std::pair<unsigned, unsigned> > Selection;
+
+  /**@name Construction */
+  //@{
+    /**Decode the remote capabilities as H323Capabilities does.
+      */
+    H323CapabilityMemo(
+      const H323Connection & connection,       ///< Connection with the local capabilities
+      const H245_TerminalCapabilitySet & pdu,  ///< PDU of the remote capabilities
+      const PBYTEArray & encoding              ///< PDU encoded without its sequence number
+    );
+  //@}
+
+  /**@name Operations */
+  //@{
+    /**Take another reference to the memo.
+      */
+    void AddReference() const { ++snapshotReferences; }
+
+    /**Get the encoding of the PDU the memo was decoded from.
+      */
+    const PBYTEArray & GetEncoding() const { return encoding; }
+
+    /**Get the capabilities selected for a session, in order of preference.
+       Returns FALSE if no connection has made the selection yet.
+      */
+    PBoolean GetSelection(
+      unsigned sessionID,         ///< Session of the selection
+      Selection & selection       ///< Choices made for the session
+    ) const;
+
+    /**Remember the capabilities selected for a session.
+      */
+    void SetSelection(
+      unsigned sessionID,         ///< Session of the selection
+      const Selection & selection ///< Choices made for the session
+    ) const;
+  //@}
+
+  protected:
+    PBYTEArray encoding;
+    mutable std::map<unsigned, Selection> selections;
+    mutable PMutex selectionMutex;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -3174,6 +3428,41 @@ class H323_IPProtocolCapability : public H323GenericControlCapability
 };
 #endif
 
+#ifdef H323_AUDIO_CODECS
+
+/**This class advertises RFC 3389 comfort noise, sent with the static CN
+   payload type in the RTP session of an 8kHz audio channel while the
+   talker is silent.
+ */
+class H323_ComfortNoiseCapability : public H323GenericControlCapability
+{
+  PCLASSINFO(H323_ComfortNoiseCapability, H323GenericControlCapability);
+
+  public:
+  /**@name Construction */
+  //@{
+    /**Create the comfort noise capability
+      */
+    H323_ComfortNoiseCapability();
+  //@}
+
+  /**@name Overrides from class PObject */
+  //@{
+    /**Create a copy of the object.
+      */
+    virtual PObject * Clone() const;
+  //@}
+
+  /**@name Identification functions */
+  //@{
+    /**Get the name of this class.
+     */
+    virtual PString GetFormatName() const;
+  //@}
+
+};
+#endif
+
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -0,0 +1,174 @@
+/*
+ * h323comfortnoise.h
+ *
+ * RFC 3389 comfort noise for 16 bit PCM audio
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#ifndef __H323COMFORTNOISE_H
+#define __H323COMFORTNOISE_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include "openh323buildopts.h"
+
+
+/* Reflection coefficients sent in a silence descriptor */
+#define H323_COMFORTNOISE_ORDER 4
+
+/* Largest silence descriptor, the level and the coefficients */
+#define H323_COMFORTNOISE_MAX_SID (1+H323_COMFORTNOISE_ORDER)
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**Silence descriptors of the background noise while a talker is silent.
+   The first silent frame after a talk burst gives a descriptor at once,
+   after which the frames are averaged and another is given when the level
+   moves 3dB from the last sent, but no sooner than 100ms, or 5 seconds
+   have passed.
+
+   A descriptor is the RFC 3389 payload: the level in -dBov, relative to a
+   full scale square wave, followed by the reflection coefficients of the
+   spectrum of the noise, each quantised in steps of 1/128 about 127.
+  */
+class H323ComfortNoiseEncoder : public PObject
+{
+  PCLASSINFO(H323ComfortNoiseEncoder, PObject);
+
+  public:
+  /**@name Construction */
+  //@{
+    /**Create an encoder for audio at the sample rate.
+      */
+    H323ComfortNoiseEncoder(
+      unsigned sampleRate = 8000   ///< Samples per second of the audio
+    );
+  //@}
+
+  /**@name Operations */
+  //@{
+    /**Pass a frame of audio found silent.
+       Returns TRUE if a silence descriptor is due, which is then got with
+       GetDescriptor().
+      */
+    PBoolean OnSilence(
+      const short * pcm,  ///< Samples of the silent frame
+      PINDEX samples      ///< Number of samples
+    );
+
+    /**Pass a frame of audio found to be talk, so the next silence sends a
+       descriptor at once.
+      */
+    void OnTalk();
+
+    /**Get the silence descriptor, returning its length.
+      */
+    PINDEX GetDescriptor(
+      BYTE * buffer       ///< At least H323_COMFORTNOISE_MAX_SID bytes
+    ) const;
+
+    /**Get the number of descriptors due so far.
+      */
+    DWORD GetDescriptorCount() const { return descriptorCount; }
+  //@}
+
+  protected:
+    double autocorrelation[H323_COMFORTNOISE_ORDER+1];
+    PBoolean averaging;             // Silent frames are averaged since the last talk
+    BYTE     sentLevel;             // Level in the last descriptor, in -dBov
+    BYTE     descriptor[H323_COMFORTNOISE_MAX_SID];
+    PINDEX   minInterval;           // Samples between descriptors, least and most
+    PINDEX   maxInterval;
+    PINDEX   sinceSent;             // Samples since the last descriptor
+    DWORD    descriptorCount;
+};
+
+
+/**Comfort noise played from received silence descriptors.
+   White noise goes through the all pole filter of the reflection
+   coefficients, at the level of the descriptor. A new level is ramped to
+   across a frame so there is no step in the noise.
+  */
+class H323ComfortNoiseGenerator : public PObject
+{
+  PCLASSINFO(H323ComfortNoiseGenerator, PObject);
+
+  public:
+  /**@name Construction */
+  //@{
+    H323ComfortNoiseGenerator();
+  //@}
+
+  /**@name Operations */
+  //@{
+    /**Take a received silence descriptor.
+       Returns FALSE if it is empty and ignored.
+      */
+    PBoolean OnDescriptor(
+      const BYTE * sid,   ///< RFC 3389 payload
+      PINDEX length       ///< Length of the payload
+    );
+
+    /**Fill a frame with comfort noise.
+      */
+    void Generate(
+      short * pcm,        ///< Buffer for the samples
+      PINDEX samples      ///< Number of samples
+    );
+
+    /**Stop until the next descriptor, as talk has started again.
+      */
+    void Stop() { active = FALSE; }
+
+    /**Indicate a descriptor was received since the last Stop().
+      */
+    PBoolean IsActive() const { return active; }
+
+    /**Get the number of descriptors received.
+      */
+    DWORD GetDescriptorCount() const { return descriptorCount; }
+  //@}
+
+  protected:
+    PBoolean active;
+    PBoolean started;               // Gain has been set by a descriptor
+    double   reflection[H323_COMFORTNOISE_ORDER];
+    unsigned order;
+    double   state[H323_COMFORTNOISE_ORDER+1];
+    double   gain;                  // Of the excitation, ramped to targetGain
+    double   targetGain;
+    DWORD    seed;
+    DWORD    descriptorCount;
+};
+
+
+#endif // __H323COMFORTNOISE_H
+
+
+/////////////////////////////////////////////////////////////////////////////
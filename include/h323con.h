@@ -52,6 +52,11 @@
 #include "transports.h"
 #include "channels.h"
 #include "guid.h"
+#include "h323calltiming.h"
+#include "h323journal.h"
+#include "h323timer.h"
+#include "h323lockprof.h"
+#include "h323avsync.h"
 
 #include "h225.h"
 
@@ -71,6 +76,12 @@ class H323AggregatedH2x5Handle : public PAggregatedHandle
 
     PBoolean OnRead();
     virtual PBoolean HandlePDU(PBoolean ok, PBYTEArray & pdu) = 0;
+
+    /**Handle the PDUs the transport had already read ahead when the handle
+       took it over. Called once, before the handle is added to the
+       aggregator, as the socket may have nothing more to read.
+      */
+    PBoolean HandleReadAhead();
     PTimeInterval GetTimeout()
     { return transport.GetReadTimeout(); }
 
@@ -80,6 +91,8 @@ class H323AggregatedH2x5Handle : public PAggregatedHandle
     H323Connection & connection;
     PBYTEArray pduBuffer;
     PINDEX pduDataLen;
+
+    PBoolean HandleBuffered();
 };
 
 #endif
@@ -135,8 +148,10 @@ class H245_GenericMessage;
 class H245_ArrayOf_GenericParameter;
 
 class H323SignalPDU;
+class H323SignallingHandle;
 class H323ControlPDU;
 class H323_RTP_UDP;
+class H323MediaActivity;
 
 class H235Authenticators;
 
@@ -145,6 +160,7 @@ class H245NegTerminalCapabilitySet;
 class H245NegLogicalChannels;
 class H245NegRequestMode;
 class H245NegRoundTripDelay;
+class H323PeerLiveness;
 
 #ifdef H323_H450
 
@@ -202,6 +218,8 @@ class H323Connection : public PObject
 
   friend class AggregatedH225Handle;
   friend class AggregatedH245Handle;
+  friend class ReactorH225Handle;
+  friend class ReactorH245Handle;
   public:
   /**@name Construction */
   //@{
@@ -278,6 +296,30 @@ class H323Connection : public PObject
      */
     void Unlock();
 
+    /**Lock connection for reading only.
+       Any number of threads may hold a read lock at once, it only excludes
+       a thread holding the connection with Lock(). It is meant for queries
+       of statistics, state and identity that do not change the connection,
+       and is normally got with H323EndPoint::FindConnectionWithReadLock().
+
+       A thread holding a read lock must not call Lock(), though a thread
+       holding Lock() may take a read lock.
+
+       Returns FALSE if the lock was not obtainable due to the connection being
+       shut down.
+     */
+    PBoolean LockReadOnly();
+
+    /**Try to lock connection for reading only.
+       Returns 0 if the lock was not obtainable due to the connection being
+       shut down, -1 if it was not available, and +1 if lock is obtained.
+     */
+    int TryLockReadOnly();
+
+    /**Release a lock got with LockReadOnly() or TryLockReadOnly().
+     */
+    void UnlockReadOnly();
+
     /**
       * called when an ARQ needs to be sent to a gatekeeper. This allows the connection
       * to change or check fields in the ARQ before it is sent.
@@ -436,6 +478,13 @@ class H323Connection : public PObject
        H323EndPoint during a clear call.
       */
     virtual void CleanUpOnCallEnd();
+
+    /**Break the threads of all the logical channels out of their I/O without
+       waiting for them, ahead of CleanUpOnCallEnd(). Used by
+       H323EndPoint::ClearAllCallsInBulk() so the media of every call runs
+       down at once.
+      */
+    void StartMediaTermination();
   //@}
 
 
@@ -466,6 +515,21 @@ class H323Connection : public PObject
      */
     virtual void HandleSignallingChannel();
 
+    /**Hand reading PDU's from the signalling channel to the endpoint
+       signalling reactor instead of HandleSignallingChannel().
+       Returns FALSE if there is no reactor or it cannot service the
+       transport, the calling thread must then read the channel itself.
+       This is an internal function and is unlikely to be used by applications.
+     */
+    PBoolean ReactorSignalChannel(
+      H323Transport * transport   ///< Signalling channel transport
+    );
+
+    /**Complete the signalling channel once no more PDU's will be read.
+       This is an internal function and is unlikely to be used by applications.
+     */
+    void EndHandleSignallingChannel();
+
     /**Handle the situation where the call signalling channel fails
         return TRUE to keep the call alive / False to drop the call
       */
@@ -1228,6 +1292,12 @@ class H323Connection : public PObject
       const H323ControlPDU & pdu
     );
 
+    /**Write a PDU already encoded to the control channel, as WriteControlPDU().
+      */
+    PBoolean WriteEncodedControlPDU(
+      const PBYTEArray & encoded
+    );
+
     /**Start control channel negotiations.
       */
     virtual PBoolean StartControlNegotiations(
@@ -1238,6 +1308,20 @@ class H323Connection : public PObject
      */
     virtual void HandleControlChannel();
 
+    /**Hand reading data on the control channel to the endpoint signalling
+       reactor instead of HandleControlChannel().
+       Returns FALSE if the reactor cannot service the transport, in which
+       case the calling thread must read the channel itself.
+     */
+    PBoolean ReactorControlChannel(
+      H323Transport * transport   ///< Control channel transport
+    );
+
+    /**Read data on the control channel until it is closed.
+       This is an internal function and is unlikely to be used by applications.
+     */
+    void ReadControlChannel();
+
     /**Handle incoming data on the control channel.
        This decodes the data stream into a PDU and calls HandleControlPDU().
 
@@ -1424,6 +1508,11 @@ class H323Connection : public PObject
       */
     virtual void OnSetLocalCapabilities();
 
+    /**Order the local capabilities by the endpoint capability cost model,
+       if it has one. Called after OnSetLocalCapabilities().
+      */
+    void OrderLocalCapabilitiesByCost();
+
     /**Call back to set the local UserInput capabilities.
        This is called just before the capabilties are required when a call
        is begun. It is called when a SETUP PDU is received or when one is
@@ -1488,6 +1577,13 @@ class H323Connection : public PObject
     /**Get the round trip delay over the control channel.
      */
     PTimeInterval GetRoundTripDelay() const;
+
+    /**Call back from the round trip delay procedure with the result of a
+       probe, so the calls to the same peer can share it.
+     */
+    void OnRoundTripDelayResult(
+      PBoolean alive     ///< Response received, FALSE if timed out
+    );
   //@}
 
   /**@name Logical Channel Management */
@@ -2330,10 +2426,14 @@ class H323Connection : public PObject
     };
 
   /** H.460.9 Queue statistics
+      The QoS measures of the session are copied into the record kept for
+      the session, so only its latest statistics wait for the next report.
     */
   void H4609QueueStats(const RTP_Session & session);
 
   /** H.460.9 dequeue statistics
+      Returns the statistics of the next session updated since last taken,
+      to be deleted by the caller, or NULL if there are no more.
     */
   H4609Statistics * H4609DequeueStats();
 
@@ -2744,6 +2844,11 @@ class H323Connection : public PObject
      */
     const PString & GetCallToken() const { return callToken; }
 
+    /**Get the small number that identifies this connection in H323HotTrace
+       events, unique within the process.
+     */
+    DWORD GetTraceTag() const { return traceTag; }
+
     /**Get the call reference for this connection.
      */
     unsigned GetCallReference() const { return callReference; }
@@ -2768,6 +2873,18 @@ class H323Connection : public PObject
       */
     void SetRemotePartyName(const PString & name);
 
+    /**Add another address the remote party can be called at, such as a
+       further SRV target. The call setup connects to the first of the
+       addresses to answer, see H323Transport::ConnectAny().
+      */
+    void AddAlternateSignalAddress(
+      const H323TransportAddress & address
+    ) { alternateSignalAddresses.AppendAddress(address); }
+
+    /**Get the other addresses the remote party can be called at.
+      */
+    const H323TransportAddressArray & GetAlternateSignalAddresses() const { return alternateSignalAddresses; }
+
     /**Set the local Display name
       */
     void SetDisplayName(const PString & name) { localDisplayName = name; }
@@ -2854,18 +2971,65 @@ class H323Connection : public PObject
      */
     const H323Capabilities & GetLocalCapabilities() const { return localCapabilities; }
 
-    /**Get the local capability table for this connection.
+    /**Get the local capability table for this connection, to be changed.
+       A table sharing the endpoint capabilities is given its own copy first.
      */
-    H323Capabilities * GetLocalCapabilitiesRef()  { return &localCapabilities; }
+    H323Capabilities * GetLocalCapabilitiesRef()  { localCapabilities.MakeUnique(); return &localCapabilities; }
 
     /**Get the remotes capability table for this connection.
      */
     const H323Capabilities & GetRemoteCapabilities() const { return remoteCapabilities; }
 
+    /**Set the capabilities of the other leg of a gateway call, usually its
+       remote capabilities, for the endpoint capability cost model to prefer
+       the formats that can pass through without transcoding. Set before the
+       local capabilities are sent.
+     */
+    void SetOtherLegCapabilities(const H323Capabilities & caps) { otherLegCapabilities = caps; }
+
+    /**Get the capabilities of the other leg of a gateway call, empty if
+       not set.
+     */
+    const H323Capabilities & GetOtherLegCapabilities() const { return otherLegCapabilities; }
+
+    /**Get the lip sync of the audio and video received, used by the
+       receive channels when H323EndPoint::SetLipSync() is enabled.
+     */
+    H323AVSync & GetAVSync() { return avSync; }
+
     /**Get the maximum audio jitter delay.
      */
     unsigned GetRemoteMaxAudioDelayJitter() const { return remoteMaxAudioDelayJitter; }
 
+    /**Determine if the remote said in its capability set it can receive
+       media sent to a multicast group.
+     */
+    PBoolean IsRemoteMulticastCapable() const { return remoteMulticastCapable; }
+
+    /**Determine if the remote said in its capability set it can receive
+       RFC 2198 redundant audio.
+     */
+    PBoolean IsRemoteAudioRedundancyCapable() const { return remoteAudioRedundancy; }
+
+    /**Determine if the remote said in its capability set it supports RTCP
+       video control, taken as asking for lost video packets again.
+     */
+    PBoolean IsRemoteVideoNackCapable() const { return remoteVideoNack; }
+
+    /**Send the media of a session to an IPv4 multicast group instead of the
+       remote, for announcement and broadcast channels. This is used for
+       transmit channels opened afterwards, and only if the remote can
+       receive multicast, otherwise the channel is unicast as usual. Several
+       calls sharing an encoder through H323_RTPChannel::AddFanOutTarget()
+       and sending to the same group have the encoded frames sent once.
+     */
+    void SetMulticastTransmit(
+      unsigned sessionID,                 ///< Session to send to the group
+      const H323TransportAddress & group, ///< Group and data port
+      BYTE ttl = 16,                      ///< Time to live of the packets
+      PBoolean loop = FALSE               ///< Packets sent are also read locally
+    );
+
     /**Get the signalling channel being used.
       */
     const H323Transport * GetSignallingChannel() const { return signallingChannel; }
@@ -2903,6 +3067,48 @@ class H323Connection : public PObject
       */
     PTime GetReverseMediaOpenTime() const { return reverseMediaOpenTime; }
 
+    /**Get the media state of the call written by its media threads for
+       the endpoint media watchdog, NULL if there is no no media timeout.
+      */
+    H323MediaActivity * GetMediaActivity() const { return mediaActivity; }
+
+    /**Get the times the call reached each step of its setup.
+      */
+    const H323CallTimeline & GetCallTimeline() const { return callTimeline; }
+
+    /**Set the start of the call setup, for a call made by the endpoint
+       the time it began making it.
+      */
+    void SetCallTimingStart(
+      const PTimeInterval & tick
+    ) { callTimeline.SetStart(tick); }
+
+    /**Record a step of the call setup as reached now, the first time only.
+      */
+    void MarkCallTiming(
+      H323CallTimeline::Milestone milestone
+    ) const { callTimeline.Mark(milestone); }
+
+    /**Record a step of the call setup that may happen more than once.
+      */
+    void AddCallTimingEvent(
+      const PString & description
+    ) const { callTimeline.AddEvent(description); }
+
+    /**Fill in the journal record of the call, see H323EndPoint::SetCallJournal().
+       The codecs and audio statistics are those of the channels as they
+       were closed. A descendant may change or add to the record.
+      */
+    virtual void GetCallRecord(
+      H323CallRecord & record   ///< Record to fill in
+    ) const;
+
+    /**Get the memory held by the connection object, its protocol procedures
+       and the supplementary services it has started. The total over all
+       connections is the h323_connection_bytes gauge of the endpoint.
+      */
+    PINDEX GetMemoryFootprint() const { return memoryFootprint; }
+
     /**Get the default maximum audio jitter delay parameter.
        Defaults to 50ms
      */
@@ -3350,10 +3556,20 @@ class H323Connection : public PObject
        the fast start algorithm.
     */
     virtual void InternalEstablishedConnectionCheck();
+
+    /**Call OnSelectLogicalChannels(), with H323EndPoint::EnableH245BurstOpen()
+       gathering the tunnelled H.245 it writes into one Facility. That only
+       matters when no PDU is carrying the tunnel, as from AnsweringCall() or
+       the check after HandleTunnelPDU(). Channels opened while handling a
+       tunnelled TCS or MSD are already gathered by HandleTunnelPDU().
+      */
+    void InternalSelectLogicalChannels();
     PBoolean DecodeFastStartCaps(const H225_ArrayOf_PASN_OctetString & fastStartCaps);
     PBoolean InternalEndSessionCheck(PPER_Stream & strm);
+    PBoolean SendControlPDU(const PBYTEArray & strm);
     void SetRemoteVersions(const H225_ProtocolIdentifier & id);
     void MonitorCallStatus();
+    PBoolean IsRoundTripDelayVouched(PInt64 now);
     PDECLARE_NOTIFIER(OpalRFC2833Info, H323Connection, OnUserInputInlineRFC2833);
     PDECLARE_NOTIFIER(H323Codec::FilterInfo, H323Connection, OnUserInputInBandDTMF);
 
@@ -3365,6 +3581,7 @@ class H323Connection : public PObject
     PBoolean                 gatekeeperRouted;
     unsigned             distinctiveRing;
     PString              callToken;
+    DWORD                traceTag;
     unsigned             callReference;
     OpalGloballyUniqueID callIdentifier;
     OpalGloballyUniqueID conferenceIdentifier;
@@ -3384,13 +3601,26 @@ class H323Connection : public PObject
     PString            remoteQ931Number;
     PBoolean           useQ931Display;
     PString            remotePartyAddress;
+    H323TransportAddressArray alternateSignalAddresses;
     PStringArray       remoteAliasNames;
 	PStringArray       remoteLanguages;
     PString            destExtraCallInfo;
     PString            remoteApplication;
     H323Capabilities   remoteCapabilities; // Capabilities remote system supports
+    H323Capabilities   otherLegCapabilities; // Of the other leg of a gateway call
+    H323AVSync         avSync;
+    const H323CapabilityMemo * remoteCapabilityMemo; // Endpoint memo remoteCapabilities was taken from
     unsigned           remoteMaxAudioDelayJitter;
-    PTimer             roundTripDelayTimer;
+    PBoolean           remoteMulticastCapable;
+    PBoolean           remoteAudioRedundancy;
+    PBoolean           remoteVideoNack;
+    struct MulticastTransmit {
+      MulticastTransmit() : ttl(16), loop(FALSE) { }
+      H323TransportAddress group;
+      BYTE                 ttl;
+      PBoolean             loop;
+    };
+    std::map<unsigned, MulticastTransmit> multicastTransmit; // Group to send to by session
     unsigned           minAudioJitterDelay;
     unsigned           maxAudioJitterDelay;
     unsigned           bandwidthAvailable;
@@ -3427,8 +3657,15 @@ class H323Connection : public PObject
     PTime         connectedTime;
     PTime         callEndTime;
     PTime         reverseMediaOpenTime;
+    mutable H323CallTimeline callTimeline;
+    H323CallRecord mediaRecord;   // Codecs and statistics of closed channels
+    PINDEX        memoryFootprint;
     PInt64        noMediaTimeOut;
+    H323MediaActivity * mediaActivity;
     PInt64        roundTripDelayRate;
+    PInt64        nextRoundTripDelay;   ///< Tick the next round trip delay is due
+    H323PeerLiveness * roundTripLiveness;
+    PString       roundTripPeer;
     CallEndReason callEndReason;
     unsigned      q931Cause;
     ReleaseSequence releaseSequence;
@@ -3464,7 +3701,7 @@ class H323Connection : public PObject
     PBoolean       endSessionNeeded;
     PBoolean       endSessionSent;
     PSyncPoint endSessionReceived;
-    PTimer     enforcedDurationLimit;
+    H323Timer  enforcedDurationLimit;
 
 #ifdef H323_H450
     // Used as part of a local call hold operation involving MOH
@@ -3515,8 +3752,24 @@ class H323Connection : public PObject
     H4504Handler                     * h4504handler;
     H4506Handler                     * h4506handler;
     H45011Handler                    * h45011handler;
+    PMutex                             h450Mutex;   ///< Creation of the above
+
+    /**Create the H.450 dispatcher and handlers. Most calls use no
+       supplementary service, so they are made on the first service used or
+       H.450 APDU received, and until then every service is idle. Both the
+       application and signalling threads may get here first, so it is done
+       under h450Mutex, and the dispatcher is set last.
+      */
+    void CreateH450Handlers();
 #endif
 
+    /**Count memory taken, or with a negative value released, by the
+       connection in its footprint and the endpoint metrics.
+      */
+    void AddMemoryFootprint(
+      PINDEX bytes
+    );
+
     OpalRFC2833                      * rfc2833handler;
 
 #ifdef H323_T120
@@ -3552,8 +3805,14 @@ class H323Connection : public PObject
   private:
     PChannel * SwapHoldMediaChannels(PChannel * newChannel,unsigned sessionId);
 
-    PTimedMutex outerMutex;
-    PTimedMutex innerMutex;
+    void WaitForReadLocks();
+
+    H323ProfiledMutex outerMutex;
+    H323ProfiledMutex innerMutex;
+    PMutex      readLockMutex;      // Protects readLockCount
+    PINDEX      readLockCount;      // Threads holding a read lock
+    PSyncPoint  readLocksReleased;
+    PINDEX      lockNesting;        // Depth of Lock() by the thread holding innerMutex
 
   public:
     PBoolean StartHandleControlChannel();
@@ -3565,6 +3824,10 @@ class H323Connection : public PObject
     PBoolean useRTPAggregation;
 #endif
 
+  protected:
+    H323SignallingHandle * signalHandle;
+    H323SignallingHandle * controlHandle;
+
 #ifdef H323_SIGNAL_AGGREGATE
   public:
     void AggregateSignalChannel(H323Transport * transport);
@@ -3599,7 +3862,13 @@ class H323Connection : public PObject
 #ifdef H323_H4609
     PBoolean m_h4609enabled;
     PBoolean m_h4609Final;
-    PQueue<H4609Statistics> m_h4609Stats;
+    struct H4609Record {
+      H4609Record() : updated(false) { }
+      H4609Statistics stats;
+      PBoolean        updated;          // Changed since last dequeued
+    };
+    std::map<unsigned, H4609Record> m_h4609Stats;   // Latest statistics by session
+    PMutex m_h4609Mutex;
 #endif
 
 #ifdef H323_H46018
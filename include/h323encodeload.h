@@ -0,0 +1,201 @@
+/*
+ * h323encodeload.h
+ *
+ * Encoder complexity governed by a processor budget
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+
+#ifndef __H323_ENCODELOAD_H
+#define __H323_ENCODELOAD_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include "openh323buildopts.h"
+
+#include <map>
+
+class H323EncodeLoad;
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**Processor time the plugin encoders of an endpoint may use together.
+   Each encoder reports the share of a processor it takes at its present
+   complexity. While the total is past the budget the most costly encoder
+   still above its floor steps its complexity down, one step a second, and
+   once the total has stayed under 80% of the budget for three seconds the
+   cheapest encoder below its ceiling steps back up, if its share at the
+   next step still fits.
+
+   Complexity runs from 0, the cheapest, to 10, the best the codec does,
+   and reaches the codec through the set_complexity control of the plugin.
+   Encoders of plugins without that control are not governed.
+  */
+class H323EncodeBudget : public PObject
+{
+  PCLASSINFO(H323EncodeBudget, PObject);
+
+  public:
+    enum {
+      MinComplexity = 0,
+      MaxComplexity = 10
+    };
+
+    H323EncodeBudget();
+
+    /**Set the budget in percent of one processor, so 200 is two. Zero,
+       the default, sets no budget and leaves the codecs as they are.
+      */
+    void SetBudget(unsigned percent);
+
+    /**Get the budget in percent of one processor.
+      */
+    unsigned GetBudget() const;
+
+    /**Set the complexity range the encoders of a media format are kept
+       in. Encoders start at the ceiling and never go under the floor,
+       whatever the load. The default is the full range.
+      */
+    void SetComplexityRange(
+      const PString & format,   ///< Media format name
+      unsigned floor,           ///< Least complexity, the quality floor
+      unsigned ceiling          ///< Most complexity, and the start
+    );
+
+    /**Get the complexity range for the encoders of a media format.
+      */
+    void GetComplexityRange(
+      const PString & format,   ///< Media format name
+      unsigned & floor,         ///< Least complexity
+      unsigned & ceiling        ///< Most complexity
+    ) const;
+
+    /**Record the load of an encoder, returning the complexity it is to
+       encode at from now.
+      */
+    unsigned Report(
+      const H323EncodeLoad * encoder,   ///< Encoder reporting
+      unsigned load,                    ///< Percent of a processor used
+      unsigned complexity,              ///< Complexity the load was at
+      unsigned floor,                   ///< Least complexity allowed
+      unsigned ceiling                  ///< Most complexity allowed
+    );
+
+    /**Remove an encoder from the budget.
+      */
+    void Remove(
+      const H323EncodeLoad * encoder
+    );
+
+    /**Get the total load reported in percent of one processor.
+      */
+    unsigned GetTotalLoad() const;
+
+  protected:
+    struct Entry {
+      unsigned load;
+      unsigned complexity;
+      unsigned floor;
+      unsigned ceiling;
+    };
+    typedef std::map<const H323EncodeLoad *, Entry> EntryMap;
+
+    struct Range {
+      unsigned floor;
+      unsigned ceiling;
+    };
+
+    unsigned budget;
+    EntryMap encoders;
+    std::map<PString, Range> ranges;
+    PInt64   lastChange;    ///< Milliseconds, last step of any encoder
+    PInt64   calmSince;     ///< Milliseconds, zero while not under 80%
+    mutable PMutex mutex;
+};
+
+
+/**Load of one encoder, measured over a second at a time and reported to
+   the budget, which answers with the complexity to use.
+  */
+class H323EncodeLoad : public PObject
+{
+  PCLASSINFO(H323EncodeLoad, PObject);
+
+  public:
+    H323EncodeLoad();
+    ~H323EncodeLoad();
+
+    /**Start measuring an encoder of a media format, at the ceiling of the
+       range the budget has for it.
+      */
+    void Open(
+      const PString & format,       ///< Media format name
+      H323EncodeBudget & budget     ///< Budget shared with other encoders
+    );
+
+    /**Stop, leaving the budget.
+      */
+    void Close();
+
+    /**Indicate Open() has been called.
+      */
+    PBoolean IsOpen() const { return budget != NULL; }
+
+    /**Add the time taken to encode a frame, returning TRUE if the
+       complexity is to change, see GetComplexity().
+      */
+    PBoolean AddEncodeTime(
+      PInt64 start,   ///< Microseconds, H323MediaClock time encoding started
+      PInt64 end      ///< Microseconds, H323MediaClock time encoding ended
+    );
+
+    /**Get the complexity the encoder is to use.
+      */
+    unsigned GetComplexity() const { return complexity; }
+
+    /**Get the load of the last second in percent of a processor.
+      */
+    unsigned GetLoad() const { return load; }
+
+  protected:
+    PString            format;
+    H323EncodeBudget * budget;
+    unsigned           floor;
+    unsigned           ceiling;
+    unsigned           complexity;
+    PInt64             periodStart;   ///< Microseconds
+    PInt64             encodeTime;    ///< Microseconds encoding in the period
+    unsigned           load;
+};
+
+
+#endif // __H323_ENCODELOAD_H
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -35,6 +35,10 @@
 
 #include "h323.h"
 #include "h323con.h"
+#include "h323metrics.h"
+#include "h323affinity.h"
+#include "h323videoload.h"
+#include "h323encodeload.h"
 
 #ifdef P_USE_PRAGMA
 #pragma interface
@@ -58,8 +62,17 @@
 #ifdef P_STUN
 #include <ptclib/pnat.h>
 class PSTUNClient;
+class H323NatDiscoveryCache;
 #endif
 
+#if P_DNS
+class H323DNSResolver;
+#endif
+
+class H323SignallingPool;
+class H323TLSSessionCache;
+class H323TLSHandshakePool;
+
 // Add H.224 Handlers
 #ifdef H323_H224
 #include <h224/h224.h>
@@ -71,6 +84,18 @@ class PSTUNClient;
 #endif
 
 class PHandleAggregator;
+class RTP_MediaReactor;
+class RTP_TransmitScheduler;
+class RTP_ReportScheduler;
+class OpalRFC2833Scheduler;
+class RTP_PortPool;
+class H323MediaWatchdog;
+class H323PeerLiveness;
+class H225TransportThreadPool;
+class H225CallThreadPool;
+class H323ProcessRelay;
+class H323SignallingReactor;
+class H323TimerService;
 
 /* The following classes have forward references to avoid including the VERY
    large header files for H225 and H245. If an application requires access
@@ -248,8 +273,74 @@ class H323EndPoint : public PObject
       */
     PBoolean SetVideoEncoder(unsigned frameWidth, unsigned frameHeight, unsigned frameRate);
 
+    /**Set whether the video encoders follow the loss and jitter the remote
+       reports in RTCP, lowering their bit rate and frame rate under
+       congestion and raising them back to the negotiated rate after.
+       This is on by default.
+      */
+    void SetVideoRateControl(PBoolean enable) { videoRateControl = enable; }
+
+    /**Get whether the video encoders follow the RTCP reports.
+      */
+    PBoolean GetVideoRateControl() const { return videoRateControl; }
+
+    /**Set the number of packets a video receive channel waits for a
+       missing packet of a picture, putting reordered packets back and
+       dropping pictures that stay incomplete, so the decoder only sees
+       whole pictures. Zero gives the packets to the decoder as received.
+       The default is 32.
+      */
+    void SetVideoReassemblyWindow(PINDEX packets) { videoReassemblyWindow = packets; }
+
+    /**Get the number of packets a video receive channel waits for a
+       missing packet of a picture.
+      */
+    PINDEX GetVideoReassemblyWindow() const { return videoReassemblyWindow; }
+
+    /**Set whether the video decoders shed pictures when they cannot keep
+       up, or are past the decode budget. They skip the pictures nothing
+       refers to, then all but intra pictures, until the load falls.
+       This is on by default.
+      */
+    void SetVideoLoadShedding(PBoolean enable) { videoLoadShedding = enable; }
+
+    /**Get whether the video decoders shed pictures under load.
+      */
+    PBoolean GetVideoLoadShedding() const { return videoLoadShedding; }
+
+    /**Set the processor time all the video decoders may use together, in
+       percent of one processor, so 200 is two. The decoders of the lowest
+       priority, see H323VideoCodec::SetDecodePriority(), and the most
+       costly among them shed pictures first. Zero, the default, sets no
+       budget.
+      */
+    void SetVideoDecodeBudget(unsigned percent) { videoDecodeBudget.SetBudget(percent); }
+
+    /**Get the budget shared by the video decoders.
+      */
+    H323VideoDecodeBudget & GetVideoDecodeBudget() { return videoDecodeBudget; }
+
 #endif
 
+    /**Set the processor time all the plugin encoders may use together, in
+       percent of one processor. Past it the most costly encoders step down
+       their complexity, within the range set by SetEncodeComplexityRange(),
+       and step back up when there is room. Only codecs with the
+       set_complexity plugin control take part. Zero, the default, sets no
+       budget and leaves the codecs at their own complexity.
+      */
+    void SetEncodeBudget(unsigned percent) { encodeBudget.SetBudget(percent); }
+
+    /**Set the complexity, from 0 to 10, the encoders of a media format are
+       kept in under the encode budget. They start at the ceiling.
+      */
+    void SetEncodeComplexityRange(const PString & format, unsigned floor, unsigned ceiling)
+    { encodeBudget.SetComplexityRange(format, floor, ceiling); }
+
+    /**Get the budget shared by the plugin encoders.
+      */
+    H323EncodeBudget & GetEncodeBudget() { return encodeBudget; }
+
     /**Add all matching capabilities in list.
        All capabilities that match the specified name are added. See the
        capabilities code for details on the matching algorithm.
@@ -418,12 +509,26 @@ class H323EndPoint : public PObject
       H323Transport * transport = NULL  ///< Transport over which to talk to gatekeeper.
     );
 
+    /**Make the endpoint the coordinator of worker processes, which use the
+       relay as their gatekeeper and so appear to the real one as this
+       endpoint. The endpoint owns the relay, set it before selecting the
+       gatekeeper. See H323ProcessRelay.
+      */
+    void SetProcessRelay(
+      H323ProcessRelay * relay    ///< Opened relay
+    );
+
+    /**Get the relay for the worker processes, NULL if none.
+      */
+    H323ProcessRelay * GetProcessRelay() const { return processRelay; }
+
     /**Create a gatekeeper.
        This allows the application writer to have the gatekeeper as a
        descendent of the H323Gatekeeper in order to add functionality to the
        base capabilities in the library.
 
-       The default creates an instance of the H323Gatekeeper class.
+       The default creates an instance of the H323Gatekeeper class, or of
+       the H323ProcessGatekeeper class if SetProcessRelay() has been called.
      */
     virtual H323Gatekeeper * CreateGatekeeper(
       H323Transport * transport  ///< Transport over which gatekeepers communicates.
@@ -808,6 +913,24 @@ class H323EndPoint : public PObject
       PStringList & addresses
     );
 
+#if P_DNS
+    /**Set how long the ENUM and SRV answers found by ResolveCallParty()
+       are kept, and how long a lookup that found nothing is remembered.
+       Zero for either turns that part of the cache off. The defaults are
+       five minutes and thirty seconds.
+      */
+    void SetDNSCacheTime(
+      const PTimeInterval & cacheTime,          ///< Time an answer found is kept
+      const PTimeInterval & negativeCacheTime   ///< Time an answer not found is kept
+    );
+
+    /**Get the resolver of the DNS lookups made for call parties.
+       Applications may start lookups on it ahead of a call so the call
+       resolves from the cache.
+      */
+    H323DNSResolver * GetDNSResolver();
+#endif
+
     /**Parse a party address into alias and transport components.
        An appropriate transport is determined from the remoteParty parameter.
        The general form for this parameter is [alias@][transport$]host[:port]
@@ -866,7 +989,39 @@ class H323EndPoint : public PObject
       PBoolean wait = TRUE   ///< Flag for wait for calls to e cleared.
     );
 
-    /**Determine if the connectionMutex will block
+    /**Clear all current connections as fast as possible, for a planned
+       shutdown or restart with many calls. The release complete of every
+       call is sent and the connections cleaned up on extra cleaner threads
+       in parallel, the media of all calls is stopped before any is cleaned,
+       and the end session of the remotes is not waited for.
+
+       If unregister is TRUE and the endpoint is registered, a URQ is sent
+       first and no DRQ is sent for each call, the gatekeeper ending them all
+       with the registration.
+
+       Returns FALSE if the calls were not all cleaned up within the time
+       given, they continue to be cleaned up in the background.
+      */
+    virtual PBoolean ClearAllCallsInBulk(
+      H323Connection::CallEndReason reason =
+                  H323Connection::EndedByLocalUser, ///< Reason for call clearing
+      const PTimeInterval & deadline = PMaxTimeInterval, ///< Time to wait for clean up
+      PBoolean unregister = TRUE,  ///< Send a URQ instead of a DRQ per call
+      PINDEX threads = 32          ///< Cleaner threads to use
+    );
+
+    /**Determine if calls are being cleared by ClearAllCallsInBulk().
+      */
+    PBoolean IsClearingInBulk() const { return bulkClearing; }
+
+    /**Determine if calls being cleared do not need a DRQ, as the endpoint
+       has unregistered for ClearAllCallsInBulk().
+      */
+    PBoolean IsDisengageSkipped() const { return bulkSkipDisengage; }
+
+    /**Determine if the connectionMutex will block.
+       HasConnection(), FindConnectionWithLock() and GetAllConnections()
+       only take a read lock of the connection table, so do not block on it.
       */
     virtual PBoolean WillConnectionMutexBlock();
 
@@ -891,6 +1046,19 @@ class H323EndPoint : public PObject
       const PString & token     ///< Token to identify connection
     );
 
+    /**Find a connection that uses the specified token, locked for reading.
+       This is as FindConnectionWithLock() but takes a read lock, so many
+       threads can query the same connection at once and only wait for a
+       thread that has the connection locked to change it.
+
+       Note the caller of this function MUST call the
+       H323Connection::UnlockReadOnly() function if this function returns a
+       non-NULL pointer, and must not change the connection.
+      */
+    H323Connection * FindConnectionWithReadLock(
+      const PString & token     ///< Token to identify connection
+    );
+
     /**Get all calls current on the endpoint.
       */
     PStringList GetAllConnections();
@@ -1276,6 +1444,22 @@ class H323EndPoint : public PObject
       */
     virtual void EncryptionCacheInitialise();
 
+    /**Set the depth of the Diffie-Hellman key pair pool.
+       When set before EncryptionCacheInitialise() a background thread keeps
+       this many fresh key pairs for each cached group, so each call gets its
+       own key pair without generating it during call setup. A call that
+       finds the pool empty uses the cached key pair. Default 0 disables it.
+      */
+    virtual void SetEncryptionKeyPoolDepth(unsigned depth);
+
+    /**Offer elliptic curve key agreement for media encryption.
+       X25519 and P-256 are offered as proprietary token OIDs alongside the
+       H.235.6 Diffie-Hellman groups and are chosen when the remote also
+       offers them. Other endpoints ignore them. Must be set before
+       EncryptionCacheInitialise(). Default FALSE.
+      */
+    virtual void SetEncryptionEllipticCurve(PBoolean enable);
+
     /**Remove Encryption cache
        Use this to remove the encryption information
       */
@@ -1379,6 +1563,99 @@ class H323EndPoint : public PObject
       const RTP_Session & session         ///< Session with statistics
     ) const;
 
+    /**Callback from an RTP channel as it ends, with the media timing
+       distributions of its session. Only the receive or transmit side,
+       depending on the channel, is used.
+
+       The default behaviour adds them to the endpoint totals.
+      */
+    virtual void OnRTPHistograms(
+      const RTP_Session::Histograms & histograms, ///< Distributions of the session
+      PBoolean receive                            ///< Channel was the receiver
+    );
+
+    /**Get the media timing distributions of all ended RTP channels, from
+       any thread. This does not look at calls still in progress, use
+       RTP_Session::GetHistograms() for those.
+      */
+    void GetRTPHistograms(
+      RTP_Session::Histograms & histograms  ///< Totals for the endpoint
+    ) const;
+
+    /**Clear the endpoint totals, for example at the start of a reporting
+       interval.
+      */
+    void ResetRTPHistograms();
+
+    /**Get the metrics registry of the endpoint. Exporters are added here,
+       for example
+         ep.GetMetrics().AddExporter(new H323StatsDExporter(server));
+         ep.GetMetrics().SetExportInterval(PTimeInterval(0, 10));
+       Reading it never locks the connections of the endpoint.
+      */
+    H323EndPointMetrics & GetMetrics() { return metrics; }
+
+    /**Set recording of the contention of the main library mutexes, the
+       connections mutex of the endpoint, the locks of each connection, the
+       jitter buffers, the H.460.19 multiplex table and the gatekeeper
+       server. The statistics are added to the metrics of this endpoint and
+       H323LockProfiler::PrintReport() writes them with the code addresses
+       of the longest waits and holds. Recording is for the whole process,
+       so only one endpoint may enable it. The default is disabled.
+      */
+    void SetLockProfiling(
+      PBoolean enable        ///< Record mutex contention
+    );
+
+    /**Get the distributions over ended calls of the time taken to reach
+       each step of the call setup, for example
+         RTP_Histogram::Snapshot connect;
+         ep.GetCallTimingStats().GetSnapshot(H323CallTimeline::e_Connect, connect);
+         PTRACE(2, "Connect " << connect);
+      */
+    const H323CallTimingStats & GetCallTimingStats() const { return callTimingStats; }
+
+    /**Set the time to establish a call above which OnSlowCallSetup() is
+       called for it as it is cleared. Zero, the default, never calls it.
+      */
+    void SetSlowCallSetupTime(
+      const PTimeInterval & interval
+    ) { slowCallSetupTime = interval; }
+
+    /**Get the time to establish a call above which OnSlowCallSetup() is called.
+      */
+    const PTimeInterval & GetSlowCallSetupTime() const { return slowCallSetupTime; }
+
+    /**Called as a call is cleared that took longer than the slow call setup
+       time to be established, or was never established within it.
+
+       The default behaviour outputs the timeline to the trace at level 2.
+      */
+    virtual void OnSlowCallSetup(
+      H323Connection & connection,          ///< Connection being cleared
+      const H323CallTimeline & timeline     ///< Steps of its setup
+    );
+
+    /**Set the journal the records of ended calls are queued to, those of
+       the connections of the endpoint and of its gatekeeper server. The
+       endpoint owns the journal, set it before calls are made or answered.
+       NULL, the default, keeps no journal.
+      */
+    void SetCallJournal(
+      H323CallJournal * journal   ///< Opened journal
+    );
+
+    /**Get the journal of ended calls, NULL if none.
+      */
+    H323CallJournal * GetCallJournal() const { return callJournal; }
+
+    /**Limit H323HotTrace to the events of one call, an empty token records
+       every call again. Returns FALSE if there is no such call.
+      */
+    PBoolean SetHotTraceCall(
+      const PString & token   ///< Token of the call to record
+    );
+
   //@}
 
   /**@name Indications */
@@ -1780,6 +2057,25 @@ class H323EndPoint : public PObject
       PBoolean mode ///< New default mode
     ) { disableH245inSetup = mode; }
 
+    /**Check if tunnelled OpenLogicalChannel requests are sent together.
+      */
+    PBoolean IsH245BurstOpenEnabled() const
+      { return enableH245BurstOpen; }
+
+    /**Set sending the OpenLogicalChannel requests in one tunnelled Facility
+       message, rather than one Facility each, when channels are selected
+       with no PDU carrying the tunnel: from AnsweringCall(), or in the
+       establishment check after the tunnelled H.245 of a PDU is handled.
+       Channels opened in answer to a tunnelled capability set or
+       master/slave determination are already sent together by
+       HandleTunnelPDU(), with or without this. Remotes known not to accept
+       several tunnelled H.245 messages in a Facility are still sent them
+       one at a time.
+      */
+    void EnableH245BurstOpen(
+      PBoolean mode ///< New default mode
+    ) { enableH245BurstOpen = mode; }
+
     /** Get the default H.245 QoS mode.
       */
     PBoolean IsH245QoSDisabled() const
@@ -1847,6 +2143,383 @@ class H323EndPoint : public PObject
       PBoolean mode ///< New default mode
     ) { canEnforceDurationLimit = mode; }
 
+    /**Set the number of media reactor threads.
+       When non-zero, RTP sessions that use a jitter buffer are serviced by a
+       fixed pool of event loop threads rather than a jitter thread each.
+       This must be set before the first call is made. A value of zero (the
+       default) disables the reactor.
+      */
+    void SetMediaReactorThreads(
+      PINDEX threads         ///< Number of reactor threads, zero disables
+    ) { mediaReactorThreads = threads; }
+
+    /**Get the number of media reactor threads.
+      */
+    PINDEX GetMediaReactorThreads() const
+    { return mediaReactorThreads; }
+
+    /**Get the media reactor used for RTP sessions.
+       Returns NULL if the reactor is disabled or not available on this platform.
+      */
+    RTP_MediaReactor * GetMediaReactor();
+
+    /**Set central transmit pacing of RTP channels.
+       When enabled, every outgoing audio and video channel is paced to the
+       frame period of its media format by a shared timer wheel instead of
+       relying on the codec read blocking for one frame time.
+       The default is disabled.
+      */
+    void SetTransmitPacing(
+      PBoolean enable        ///< Enable the transmit scheduler
+    ) { useTransmitPacing = enable; }
+
+    /**Get central transmit pacing of RTP channels.
+      */
+    PBoolean GetTransmitPacing() const
+    { return useTransmitPacing; }
+
+    /**Get the transmit scheduler used to pace RTP channels.
+       Returns NULL if transmit pacing is disabled.
+      */
+    RTP_TransmitScheduler * GetTransmitScheduler();
+
+    /**Get the timer service that runs the per call timers.
+       The H.245 negotiators, RFC 2833 handlers and signalling keep alives
+       use H323Timer instances serviced by this one timer wheel rather than
+       a PTimer each. The service is shared by all endpoints in the process.
+      */
+    H323TimerService & GetTimerService() const;
+
+    /**Set central sending of RTCP reports.
+       When enabled the sender and receiver reports of every RTP session are
+       sent by one thread, spread evenly over the report interval, instead of
+       from the media threads as packets pass through.
+       This must be set before the first call is made. The default is disabled.
+      */
+    void SetReportScheduling(
+      PBoolean enable        ///< Enable the report scheduler
+    ) { useReportScheduling = enable; }
+
+    /**Get central sending of RTCP reports.
+      */
+    PBoolean GetReportScheduling() const
+    { return useReportScheduling; }
+
+    /**Get the scheduler that sends RTCP reports for RTP sessions.
+       Returns NULL if report scheduling is disabled.
+      */
+    RTP_ReportScheduler * GetReportScheduler();
+
+    /**Get the scheduler timing the RFC 2833 events of every connection.
+      */
+    OpalRFC2833Scheduler * GetRFC2833Scheduler();
+
+    /**Set the number of datagrams moved per system call on RTP sockets.
+       Where the platform supports it (recvmmsg/sendmmsg on Linux) received
+       datagrams are drained in batches of this size and the packets of a
+       video frame are sent in one call. Zero (the default) disables it.
+      */
+    void SetRTPBatchSize(
+      PINDEX count           ///< Datagrams per system call, zero disables
+    ) { rtpBatchSize = count; }
+
+    /**Get the number of datagrams moved per system call on RTP sockets.
+      */
+    PINDEX GetRTPBatchSize() const
+    { return rtpBatchSize; }
+
+    /**Set acceptance of media sent to a multicast group.
+       When enabled the capability set says multicast can be received, and
+       a logical channel opened by the remote with a multicast media address
+       joins the group instead of being rejected. The default is disabled.
+      */
+    void SetMulticastReceive(
+      PBoolean enable        ///< Accept multicast media
+    ) { multicastReceive = enable; }
+
+    /**Get acceptance of media sent to a multicast group.
+      */
+    PBoolean IsMulticastReceiveEnabled() const
+    { return multicastReceive; }
+
+    /**Set the number of earlier audio payloads sent again in each packet.
+       When non-zero the capability set offers RFC 2198 redundant audio, and
+       audio channels to a remote offering it too carry copies of this many
+       packets before, up to four, so a lost packet is recovered from the
+       next without waiting for the jitter buffer. Zero (the default)
+       disables sending it, receiving it is always accepted when offered.
+      */
+    void SetAudioRedundancy(
+      PINDEX level           ///< Earlier payloads per packet, zero disables
+    ) { audioRedundancy = level; }
+
+    /**Get the number of earlier audio payloads sent again in each packet.
+      */
+    PINDEX GetAudioRedundancy() const
+    { return audioRedundancy; }
+
+    /**Set the dynamic RTP payload type of redundant audio packets sent.
+      */
+    void SetRedundancyPayloadType(
+      RTP_DataFrame::PayloadTypes type  ///< Payload type, default 121
+    ) { redundancyPayloadType = type; }
+
+    /**Get the dynamic RTP payload type of redundant audio packets sent.
+      */
+    RTP_DataFrame::PayloadTypes GetRedundancyPayloadType() const
+    { return redundancyPayloadType; }
+
+    /**Set the repair of lost video packets by retransmission.
+       When enabled the capability set offers RTCP video control, and video
+       sessions with a remote offering it too ask for lost packets with RTCP
+       generic NACKs (RFC 4585) and keep the packets sent to answer them with
+       RFC 4588 retransmissions. Disabled by default.
+      */
+    void SetVideoRetransmission(
+      PBoolean enable        ///< Enable retransmission of lost video packets
+    ) { videoRetransmission = enable; }
+
+    /**Determine if lost video packets are repaired by retransmission.
+      */
+    PBoolean IsVideoRetransmissionEnabled() const
+    { return videoRetransmission; }
+
+    /**Set the dynamic RTP payload type of video retransmissions. H.245 has
+       no way to say it, so both ends must be set the same.
+      */
+    void SetRetransmissionPayloadType(
+      RTP_DataFrame::PayloadTypes type  ///< Payload type, default 122
+    ) { retransmissionPayloadType = type; }
+
+    /**Get the dynamic RTP payload type of video retransmissions.
+      */
+    RTP_DataFrame::PayloadTypes GetRetransmissionPayloadType() const
+    { return retransmissionPayloadType; }
+
+    /**Set the number of RTP port pairs kept open ahead of use.
+       When non-zero, each local interface that media is opened on keeps
+       this many data and control socket pairs bound within the RTP port
+       range, with the type of service and buffer sizes set, so opening an
+       RTP session does not have to search the range. This must be set
+       before the first call is made. Zero (the default) disables the pool.
+      */
+    void SetRTPPortPoolSize(
+      PINDEX pairs           ///< Pairs kept per interface, zero disables
+    ) { rtpPortPoolSize = pairs; }
+
+    /**Get the number of RTP port pairs kept open ahead of use.
+      */
+    PINDEX GetRTPPortPoolSize() const
+    { return rtpPortPoolSize; }
+
+    /**Set the time an RTP port pair given back to the pool is held before
+       it is used again, so late packets of the old call are discarded.
+       The default is 5 seconds.
+      */
+    void SetRTPPortQuarantine(
+      const PTimeInterval & time   ///< Time a released pair is held
+    ) { rtpPortQuarantine = time; }
+
+    /**Get the time an RTP port pair given back to the pool is held.
+      */
+    const PTimeInterval & GetRTPPortQuarantine() const
+    { return rtpPortQuarantine; }
+
+    /**Get the pool RTP sessions take their sockets from.
+       Returns NULL if the pool is disabled.
+      */
+    RTP_PortPool * GetRTPPortPool();
+
+    /**Set the jitter buffer implementation used for audio channels.
+       The default is the original sorted list, RTP_Session::e_RingJitterBuffer
+       selects the lock free ring indexed by sequence number and
+       RTP_Session::e_AdaptiveJitterBuffer sets the delay from the measured
+       distribution of packet delays.
+      */
+    void SetJitterBufferEngine(
+      RTP_Session::JitterBufferEngine engine  ///< Jitter buffer implementation
+    ) { jitterBufferEngine = engine; }
+
+    /**Get the jitter buffer implementation used for audio channels.
+      */
+    RTP_Session::JitterBufferEngine GetJitterBufferEngine() const
+    { return jitterBufferEngine; }
+
+    /**Set lost frames of received audio to be concealed by repeating the
+       last pitch period, for codecs whose decoder has no concealment of its
+       own. With the adaptive jitter buffer engine the channel also shortens
+       decoded frames to bring the buffer delay down, instead of the buffer
+       dropping frames. The default is disabled.
+      */
+    void SetAudioConcealment(
+      PBoolean enable        ///< Conceal lost audio frames
+    ) { audioConcealment = enable; }
+
+    /**Get the flag for concealing lost frames of received audio.
+      */
+    PBoolean GetAudioConcealment() const
+    { return audioConcealment; }
+
+    /**Set lip sync of the audio and video received on each call, using
+       the RTCP sender reports of both. Whichever of the two is ahead is
+       held back, audio by raising its jitter buffer minimum and video by
+       holding each picture before decoding, see H323AVSync. The default
+       is disabled.
+      */
+    void SetLipSync(
+      PBoolean enable        ///< Synchronise received audio and video
+    ) { lipSync = enable; }
+
+    /**Get the flag for lip sync of received audio and video.
+      */
+    PBoolean GetLipSync() const
+    { return lipSync; }
+
+    /**Set RFC 3389 comfort noise for 8kHz audio, adding or removing the
+       comfort noise capability. While silence detection suppresses the
+       audio sent, silence descriptors of the background noise are sent
+       instead when the remote has the capability, and noise is played
+       from those received so the far end does not hear dead air. The
+       default is disabled.
+      */
+    void SetComfortNoise(
+      PBoolean enable        ///< Send and play comfort noise
+    );
+
+    /**Get the flag for RFC 3389 comfort noise.
+      */
+    PBoolean GetComfortNoise() const
+    { return comfortNoise; }
+
+    /**Set the RFC 6464 audio level header extension element ID. Audio
+       sent carries the level of each packet and whether it is voice, and
+       the level of audio received is read, see
+       H323_RTPChannel::GetReceivedAudioLevel(). There is no H.245
+       signalling of the extension so both ends must be configured with
+       the same ID, from 1 to 14. The default of zero is disabled.
+      */
+    void SetAudioLevelExtension(
+      unsigned id            ///< Header extension element ID
+    ) { audioLevelExtension = id <= 14 ? id : 0; }
+
+    /**Get the RFC 6464 audio level header extension element ID.
+      */
+    unsigned GetAudioLevelExtension() const
+    { return audioLevelExtension; }
+
+    /**Set the jitter buffers of audio channels to be fed by the channel
+       thread that plays them out, instead of a jitter thread or the media
+       reactor. This saves a thread per audio session and the wake up between
+       the socket read and the buffer insert. The default is disabled.
+      */
+    void SetJitterBufferPullMode(
+      PBoolean enable        ///< Pull received frames from the channel thread
+    ) { jitterBufferPullMode = enable; }
+
+    /**Get the flag for jitter buffers being fed by the channel thread.
+      */
+    PBoolean GetJitterBufferPullMode() const
+    { return jitterBufferPullMode; }
+
+    /**Set the number of threads accepting calls on each TCP listener.
+       More than one needs SO_REUSEPORT, each thread then gets its own socket
+       on the listening port and the kernel spreads new connections across
+       them. Must be set before the listeners are started. Default is one.
+      */
+    void SetSignallingAcceptors(
+      PINDEX count           ///< Accept threads per listener
+    ) { signallingAcceptors = count; }
+
+    /**Get the number of threads accepting calls on each TCP listener.
+      */
+    PINDEX GetSignallingAcceptors() const
+    { return signallingAcceptors; }
+
+    /**Set the flag for the TCP listeners sharing their port with other
+       processes through SO_REUSEPORT, for worker processes of a
+       H323ProcessRelay. Every process must set it before starting its
+       listeners, the kernel then spreads new connections across them.
+      */
+    void SetSharedListeners(
+      PBoolean shared        ///< Share the listening ports
+    ) { sharedListeners = shared; }
+
+    /**Get the flag for the TCP listeners sharing their port with other
+       processes.
+      */
+    PBoolean GetSharedListeners() const
+    { return sharedListeners; }
+
+    /**Set the number of signalling threads started ahead of incoming calls.
+       Accepted calls are handed to a waiting thread instead of creating one
+       on the accept path. Zero (the default) disables the pool.
+      */
+    void SetSignallingThreadPoolSize(
+      PINDEX count           ///< Threads kept waiting, zero disables
+    ) { signallingThreadPoolSize = count; }
+
+    /**Get the number of signalling threads started ahead of incoming calls.
+      */
+    PINDEX GetSignallingThreadPoolSize() const
+    { return signallingThreadPoolSize; }
+
+    /**Get the pool of signalling threads for incoming calls.
+       Returns NULL if the pool is disabled.
+      */
+    H225TransportThreadPool * GetSignallingThreadPool();
+
+    /**Set the number of threads making outgoing calls. MakeCall() then
+       queues the call to one of these instead of creating a thread for it.
+       Zero (the default) starts a thread for each call. Must be set before
+       the first call is made.
+      */
+    void SetOutgoingCallPoolSize(
+      PINDEX count           ///< Threads making calls, zero disables
+    ) { outgoingCallPoolSize = count; }
+
+    /**Get the number of threads making outgoing calls.
+      */
+    PINDEX GetOutgoingCallPoolSize() const
+    { return outgoingCallPoolSize; }
+
+    /**Set the number of outgoing calls that may wait for a thread of the
+       pool, further calls are cleared with EndedByLocalCongestion. Zero
+       (the default) queues every call.
+      */
+    void SetOutgoingCallQueueLimit(
+      PINDEX limit           ///< Calls waiting, zero for no limit
+    ) { outgoingCallQueueLimit = limit; }
+
+    /**Get the number of outgoing calls that may wait for a thread.
+      */
+    PINDEX GetOutgoingCallQueueLimit() const
+    { return outgoingCallQueueLimit; }
+
+    /**Get the pool of threads making outgoing calls.
+       Returns NULL if the pool is disabled.
+      */
+    H225CallThreadPool * GetOutgoingCallPool();
+
+    /**Set the number of signalling reactor threads.
+       When non-zero, the H.225 and H.245 channels of established calls are
+       read by a fixed pool of event loop threads rather than a thread each
+       for the life of the call. This must be set before the first call is
+       made. A value of zero (the default) disables the reactor.
+      */
+    void SetSignallingReactorThreads(
+      PINDEX threads         ///< Number of reactor threads, zero disables
+    ) { signallingReactorThreads = threads; }
+
+    /**Get the number of signalling reactor threads.
+      */
+    PINDEX GetSignallingReactorThreads() const
+    { return signallingReactorThreads; }
+
+    /**Get the signalling reactor used for H.225 and H.245 channels.
+       Returns NULL if the reactor is disabled or not available on this platform.
+      */
+    H323SignallingReactor * GetSignallingReactor();
+
 #ifdef H323_RTP_AGGREGATE
     /**Set the RTP aggregation size
       */
@@ -2003,6 +2676,27 @@ class H323EndPoint : public PObject
      */
     PBoolean CanAutoStartTransmitExtVideo() const { return autoStartTransmitExtVideo; }
 
+    /**Set the most frames a second H.239 content is encoded at, below the
+       rate negotiated. Zero encodes at the negotiated rate. The default
+       is 5.
+      */
+    void SetExtendedVideoFrameRate(unsigned rate) { extVideoFrameRate = rate; }
+
+    /**Get the most frames a second H.239 content is encoded at.
+      */
+    unsigned GetExtendedVideoFrameRate() const { return extVideoFrameRate; }
+
+    /**Set whether H.239 content pictures that have not changed are skipped.
+       A few are still encoded after each change so the encoder refines the
+       quality of the still picture, and one every 2 seconds. This is on by
+       default.
+      */
+    void SetExtendedVideoSkipUnchanged(PBoolean enable) { extVideoSkipUnchanged = enable; }
+
+    /**Get whether H.239 content pictures that have not changed are skipped.
+      */
+    PBoolean GetExtendedVideoSkipUnchanged() const { return extVideoSkipUnchanged; }
+
 #endif  // H323_H239
 #endif  // H323_VIDEO
 
@@ -2030,6 +2724,147 @@ class H323EndPoint : public PObject
      */
     const H323Capabilities & GetCapabilities() const { return capabilities; }
 
+    /**Set connections to share one copy of the endpoint capabilities, a
+       capability being cloned only when a connection changes it, instead of
+       every connection cloning the whole table. A connection class that
+       changes a capability of its local table must pass it through
+       H323Capabilities::GetWritable() first. Not used when H.235 media is
+       compiled in, as each connection then wraps the capabilities itself.
+       The default is disabled.
+      */
+    void SetCapabilitySharing(
+      PBoolean enable        ///< Share the capabilities between connections
+    ) { capabilitySharing = enable; }
+
+    /**Get the flag for connections sharing the endpoint capabilities.
+      */
+    PBoolean GetCapabilitySharing() const { return capabilitySharing; }
+
+    /**Set the model connections order their local capabilities by before
+       building the TerminalCapabilitySet and selecting fast start channels,
+       so formats that avoid transcoding, or cheap codecs while the box is
+       under load, are offered first. The model is not deleted by the
+       endpoint and must outlive its connections. NULL, the default, leaves
+       the order set by the application.
+      */
+    void SetCapabilityCostModel(
+      H323CapabilityCostModel * model   ///< Model to use, NULL for none
+    ) { capabilityCostModel = model; }
+
+    /**Get the model connections order their local capabilities by.
+      */
+    H323CapabilityCostModel * GetCapabilityCostModel() const { return capabilityCostModel; }
+
+    /**Set a capability table to share a snapshot of the endpoint capabilities.
+       The snapshot is made on the first call after the capabilities change.
+      */
+    void ShareCapabilities(
+      H323Capabilities & table   ///< Table to use the snapshot
+    ) const;
+
+    /**Set the number of remote capability sets remembered by the endpoint.
+       A TerminalCapabilitySet identical, apart from its sequence number,
+       to one received before is not decoded again, and the channels
+       selected for it are taken from the first connection that received
+       it. Only used for connections sharing the endpoint capabilities,
+       and the sets are forgotten when the endpoint capabilities change.
+       The default of zero disables it.
+      */
+    void SetCapabilityMemoSize(
+      PINDEX size            ///< Number of sets kept
+    ) { capabilityMemoSize = size; }
+
+    /**Get the number of remote capability sets remembered by the endpoint.
+      */
+    PINDEX GetCapabilityMemoSize() const { return capabilityMemoSize; }
+
+    /**Get the remote capabilities of a TerminalCapabilitySet, decoded
+       earlier or now. Returns NULL if the connection cannot use a memo, in
+       which case the caller decodes the set itself. The memo returned must
+       be released with H323Capabilities::ReleaseSnapshot().
+      */
+    H323CapabilityMemo * GetCapabilityMemo(
+      const H323Connection & connection,     ///< Connection receiving the set
+      const H245_TerminalCapabilitySet & pdu ///< Received set
+    ) const;
+
+    /**Set the number of encoded fast start proposals remembered by the
+       endpoint. The OpenLogicalChannel of a fast start RTP channel is the
+       same on every call bar the local media addresses, so it is encoded
+       once and later calls copy it with their addresses written in. Only
+       used for connections sharing the endpoint capabilities, and the
+       proposals are forgotten when the endpoint capabilities change.
+       Should not be used if the application adds per call parameters to
+       fast start channels other than those generic information and H.235
+       media encryption add, which are never remembered.
+       The default of zero disables it.
+      */
+    void SetFastStartMemoSize(
+      PINDEX size            ///< Number of proposals kept
+    ) { fastStartMemoSize = size; }
+
+    /**Get the number of encoded fast start proposals remembered.
+      */
+    PINDEX GetFastStartMemoSize() const { return fastStartMemoSize; }
+
+    /**Get the encoded fast start OpenLogicalChannel for a channel from one
+       remembered earlier, with the media addresses of the channel.
+       Returns FALSE if there is none, in which case the caller builds it.
+      */
+    PBoolean GetFastStartMemo(
+      const H323Connection & connection,     ///< Connection proposing the channel
+      const H323Channel & channel,           ///< Channel to propose
+      PBoolean reverse,                      ///< Channel is in the reverse parameters
+      PASN_OctetString & encoded             ///< Encoded OpenLogicalChannel
+    ) const;
+
+    /**Remember the fast start OpenLogicalChannel built for a channel.
+      */
+    void SetFastStartMemo(
+      const H323Connection & connection,     ///< Connection proposing the channel
+      const H323Channel & channel,           ///< Channel proposed
+      PBoolean reverse,                      ///< Channel is in the reverse parameters
+      const H245_OpenLogicalChannel & open,  ///< OpenLogicalChannel built
+      const PASN_OctetString & encoded       ///< Encoding of open
+    ) const;
+
+    /**Set the number of encoded TerminalCapabilitySets remembered by the
+       endpoint. The set a connection sends depends only on the endpoint
+       capabilities, which of them are usable on the connection and its
+       maximum audio jitter delay, so it is encoded once for each of these
+       and later connections copy it with their sequence number written in,
+       without building the PDU. Only used for connections sharing the
+       endpoint capabilities, and the sets are forgotten when the endpoint
+       capabilities change. H323Connection::OnSendCapabilitySet() is not
+       called for a remembered set, so any change it makes on the first
+       connection is sent by the later ones too.
+       The default of zero disables it.
+      */
+    void SetCapabilitySetMemoSize(
+      PINDEX size            ///< Number of sets kept
+    ) { capabilitySetMemoSize = size; }
+
+    /**Get the number of encoded TerminalCapabilitySets remembered.
+      */
+    PINDEX GetCapabilitySetMemoSize() const { return capabilitySetMemoSize; }
+
+    /**Get the encoded TerminalCapabilitySet for a connection from one
+       remembered earlier, with the sequence number of the connection.
+       Returns FALSE if there is none, in which case the caller builds it.
+      */
+    PBoolean GetCapabilitySetMemo(
+      const H323Connection & connection,     ///< Connection sending the set
+      unsigned sequenceNumber,               ///< Sequence number of the set
+      PBYTEArray & encoded                   ///< Encoded H.245 PDU
+    ) const;
+
+    /**Remember the TerminalCapabilitySet built for a connection.
+      */
+    void SetCapabilitySetMemo(
+      const H323Connection & connection,     ///< Connection sending the set
+      const H323ControlPDU & pdu             ///< PDU with the set built
+    ) const;
+
     /**Endpoint types.
      */
     enum TerminalTypes {
@@ -2181,6 +3016,17 @@ class H323EndPoint : public PObject
     PBoolean RegisteredWithH46017() const { return m_registeredWithH46017; }
     PBoolean TryingWithH46017() const { return m_tryingH46017; }
     H323Transport * GetH46017Transport() { return m_h46017Transport; }
+
+    /** Set the number of threads handling call signalling received over the
+        H.460.17 tunnel. Messages of one call are always handled in order,
+        messages of different calls in parallel. The default is 4.
+      */
+    void SetH46017SignalThreads(PINDEX threads) { m_h46017SignalThreads = threads; }
+
+    /** Get the number of threads handling call signalling received over the
+        H.460.17 tunnel.
+      */
+    PINDEX GetH46017SignalThreads() const { return m_h46017SignalThreads; }
 #endif
 
 #ifdef H323_H46018
@@ -2200,6 +3046,16 @@ class H323EndPoint : public PObject
     /** Whether H.460.18 is in Operation for this call
       */
     PBoolean H46018InOperation();
+
+    /** Keep a call signalling channel to the H.460.18 server opened ahead
+        of the next incoming call, so answering an SCI needs no TCP or TLS
+        handshake. By default no channel is opened before the SCI.
+      */
+    void SetH46018PreOpenSignalling(PBoolean enable) { m_h46018PreOpen = enable; }
+
+    /** Whether a call signalling channel is opened ahead of the SCI
+      */
+    PBoolean IsH46018PreOpenSignalling() const { return m_h46018PreOpen; }
 #endif
 
 #ifdef H323_H46019M
@@ -2218,6 +3074,16 @@ class H323EndPoint : public PObject
     /** Query whether we are using H.460.19 Multiplex Sending (H.460.19M Must be enabled)
       */
     PBoolean H46019MIsSending();
+
+    /** Set the number of threads reading the H.460.19 multiplex port.
+        More than one needs SO_REUSEPORT, each thread then gets its own
+        socket on the port. Must be set before the first call. Default is one.
+      */
+    void H46019MSetReadThreads(PINDEX count);
+
+    /** Get the number of threads reading the H.460.19 multiplex port.
+      */
+    PINDEX H46019MGetReadThreads() const;
 #endif
 
 #ifdef H323_H46023
@@ -2305,6 +3171,19 @@ class H323EndPoint : public PObject
       */
     virtual void IMSend(const PString & msg);
 
+    /** Send a message to a party over the session kept for that party.
+        The first message goes over a call already in progress with the
+        party that supports messaging, or else opens an IM session call
+        and waits for it to open. Later messages reuse the same session
+        until it is closed or the call ends, so no call is set up per
+        message. Returns false if no session could be started.
+      */
+    virtual PBoolean IMSendTo(const PString & party, const PString & msg);
+
+    /** Get the call token of the session kept for a party, empty if none
+      */
+    PString IMGetSession(const PString & party);
+
     /** An IM Message has been received
       */
     virtual void IMReceived(const PString & token, const PString & msg, PBoolean session = TRUE);
@@ -2319,6 +3198,7 @@ class H323EndPoint : public PObject
     virtual void IMClearConnection(const PString & token);
     virtual void IMSupport(const PString & token);
     virtual void IMSessionInvite(const PString & username);
+    virtual void IMSessionReady(const PString & token);
 
     // Call backs
     virtual PBoolean IMWriteEvent(PBoolean & state);
@@ -2557,6 +3437,30 @@ class H323EndPoint : public PObject
     PBoolean InitialiseTransportContext();
     PSSLContext * GetTransportContext();
 
+    /**Set the number of threads doing signalling TLS handshakes at once.
+       Accepted and connecting transports have their handshakes done by a
+       pool of up to this many threads, so a burst of new TLS calls takes
+       no more of the processors than that. Zero does each handshake on
+       the thread accepting or connecting. The default is 8.
+      */
+    void SetTLSHandshakeWorkers(
+      PINDEX count           ///< Handshakes at once, zero disables the pool
+    ) { tlsHandshakeWorkers = count; }
+
+    /**Get the number of threads doing signalling TLS handshakes at once.
+      */
+    PINDEX GetTLSHandshakeWorkers() const { return tlsHandshakeWorkers; }
+
+    /**Get the pool of threads doing signalling TLS handshakes.
+       Returns NULL if the pool is disabled.
+      */
+    H323TLSHandshakePool * GetTLSHandshakePool();
+
+    /**Get the TLS sessions kept to resume signalling handshakes with the
+       peers called before, NULL until the transport context is initialised.
+      */
+    H323TLSSessionCache * GetTLSSessionCache() const { return m_tlsSessionCache; }
+
     virtual void OnSecureSignallingChannel(bool /* isSecured */) {};
 #endif
 
@@ -2608,6 +3512,32 @@ class H323EndPoint : public PObject
       */
     virtual PBoolean STUNNatType(int /*type*/) { return FALSE; };
 
+    /**Set how long the NAT type and external address found by the NAT
+       methods are kept. Results are refreshed in the background before they
+       expire, so calls do not wait on STUN or UPnP round trips. Zero turns
+       the cache off. The default is one minute.
+      */
+    void SetNatDiscoveryCacheTime(
+      const PTimeInterval & ttl   ///< Time a result is kept
+    ) { natDiscoveryCacheTime = ttl; }
+
+    /**Get how long NAT discovery results are kept.
+      */
+    const PTimeInterval & GetNatDiscoveryCacheTime() const
+    { return natDiscoveryCacheTime; }
+
+    /**Get the cache of NAT discovery results, NULL if turned off.
+      */
+    H323NatDiscoveryCache * GetNatDiscoveryCache();
+
+    /**Get the external address of a NAT method, through the NAT discovery
+       cache if it is on.
+      */
+    PBoolean GetNatExternalAddress(
+      PNatMethod & method,                ///< NAT method
+      PIPSocket::Address & address        ///< Returned external address
+    );
+
     /** Retrieve the first available
         NAT Traversal Techniques
      */
@@ -2737,6 +3667,23 @@ class H323EndPoint : public PObject
       */
     const PTimeInterval & GetSignallingChannelConnectTimeout() const { return signallingChannelConnectTimeout; }
 
+    /**Get the time between starting connections to the addresses of a
+       call party that has several, see H323Transport::ConnectAny().
+      */
+    const PTimeInterval & GetSignallingConnectStagger() const { return signallingConnectStagger; }
+
+    /**Set the time between starting connections to the addresses of a
+       call party that has several. The default is 250 milliseconds.
+      */
+    void SetSignallingConnectStagger(const PTimeInterval & stagger) { signallingConnectStagger = stagger; }
+
+    /**Get the pool of signalling transports kept connected to frequent
+       peers, creating it if need be. Peers are added to the pool with
+       H323SignallingPool::AddPeer(), calls made direct to them then use a
+       transport that is already connected.
+      */
+    H323SignallingPool * GetSignallingPool();
+
     /**Get the default timeout for calling another endpoint.
      */
     const PTimeInterval & GetSignallingChannelCallTimeout() const { return signallingChannelCallTimeout; }
@@ -2781,6 +3728,26 @@ class H323EndPoint : public PObject
      */
     PBoolean ShouldClearCallOnRoundTripFail() const { return clearCallOnRoundTripFail; }
 
+    /**Set sharing of round trip delay results between calls to one peer.
+       When enabled a round trip delay response on any call to a remote
+       signalling address vouches for all calls to that address for one
+       round trip delay rate, and only one of them probes at a time. Calls
+       probe separately again once a probe of the address times out.
+       The default is enabled.
+      */
+    void SetRoundTripDelayPerPeer(
+      PBoolean enable        ///< Share round trip delay results
+    ) { roundTripDelayPerPeer = enable; }
+
+    /**Get sharing of round trip delay results between calls to one peer.
+      */
+    PBoolean GetRoundTripDelayPerPeer() const { return roundTripDelayPerPeer; }
+
+    /**Get the round trip delay liveness of the remote peers.
+       Returns NULL if round trip delay is not shared between calls.
+      */
+    H323PeerLiveness * GetPeerLiveness();
+
     /**Get the amount of time with no media that should cause call to clear
      */
     const PTimeInterval & GetNoMediaTimeout() const;
@@ -2789,6 +3756,12 @@ class H323EndPoint : public PObject
      */
     PBoolean SetNoMediaTimeout(PTimeInterval newInterval);
 
+    /**Get the watchdog clearing calls with no media for the no media
+       timeout, one thread for all calls. It is started by the first call
+       made with a timeout set.
+      */
+    H323MediaWatchdog * GetMediaWatchdog();
+
     /**Get the default timeout for GatekeeperRequest and Gatekeeper discovery.
      */
     const PTimeInterval & GetGatekeeperRequestTimeout() const { return gatekeeperRequestTimeout; }
@@ -2868,6 +3841,21 @@ class H323EndPoint : public PObject
      */
     PINDEX GetCleanerThreadStackSize() const { return cleanerThreadStackSize; }
 
+    /**Set the number of threads cleaning up cleared connections at once.
+       Each connection waits for all its channel threads to end as it is
+       cleaned up, so with one thread, the default, a large number of calls
+       cleared together are released one after another. The progress is
+       shown by the h323_calls_cleaning, h323_calls_cleaned_total and
+       h323_call_cleanup_milliseconds_total metrics.
+      */
+    void SetCleanerThreads(
+      PINDEX count           ///< Number of cleaner threads, at least one
+    );
+
+    /**Get the number of threads cleaning up cleared connections at once.
+      */
+    PINDEX GetCleanerThreads() const { return cleanerThreads; }
+
     /**Get the default stack size of listener threads.
      */
     PINDEX GetListenerThreadStackSize() const { return listenerThreadStackSize; }
@@ -2900,8 +3888,88 @@ class H323EndPoint : public PObject
       */
     PThread::Priority GetChannelThreadPriority() const { return channelThreadPriority; }
 
+    /**Classes of logical channel thread that can run at their own priority.
+      */
+    enum ChannelThreadClass {
+      AudioChannelThreads,
+      VideoChannelThreads,
+      ExtendedVideoChannelThreads,  ///< H.239 content
+      OtherChannelThreads,          ///< Data, fax and the rest
+      NumChannelThreadClasses
+    };
+
+    /**Set the priority of a class of logical channel threads created after
+       the call. All run at the highest priority but H.239 content, which
+       runs at normal priority so bursts of screen encoding do not hold up
+       the main video.
+      */
+    void SetChannelThreadPriority(
+      ChannelThreadClass threadClass,   ///< Class of channel thread
+      PThread::Priority priority        ///< Priority to run it at
+    );
+
+    /**Get the priority of a class of logical channel threads.
+      */
+    PThread::Priority GetChannelThreadPriority(
+      ChannelThreadClass threadClass    ///< Class of channel thread
+    ) const;
+
+    /**Classes of thread that can be pinned to a set of CPUs.
+      */
+    enum ThreadAffinityClass {
+      MediaThreads,         ///< Logical channel threads and media reactor workers
+      SignallingThreads,    ///< H.225 and H.245 threads and signalling reactor workers
+      RASThreads,           ///< RAS and other transactor listener threads
+      NumThreadAffinityClasses
+    };
+
+    /**Set the CPUs a class of threads runs on.
+       Media reactor workers are spread one per CPU of the set, all other
+       threads may run on any CPU of their set. An empty set (the default)
+       leaves the threads where the system puts them. The reactors take
+       their set when they are created, so this must be set before the
+       first call is made.
+      */
+    void SetThreadAffinity(
+      ThreadAffinityClass threads,   ///< Class of threads to pin
+      const H323CPUSet & cpus        ///< CPUs the threads may run on
+    ) { threadAffinity[threads] = cpus; }
+
+    /**Get the CPUs a class of threads runs on.
+      */
+    const H323CPUSet & GetThreadAffinity(
+      ThreadAffinityClass threads    ///< Class of threads
+    ) const { return threadAffinity[threads]; }
+
+    /**Set steering of RTP sessions to the media reactor worker pinned to the
+       CPU that receives their packets, see RTP_MediaReactor::SetSocketSteering().
+       The default is disabled.
+      */
+    void SetMediaSocketSteering(
+      PBoolean enable        ///< Steer sessions by receiving CPU
+    ) { mediaSocketSteering = enable; }
+
+    /**Get steering of RTP sessions to the CPU that receives their packets.
+      */
+    PBoolean GetMediaSocketSteering() const { return mediaSocketSteering; }
+
     H323ConnectionDict & GetConnections() { return connectionsActive; };
 
+    /**Add a connection created outside the endpoint to the active list.
+      */
+    void AddConnection(
+      const PString & token,
+      H323Connection * connection
+    );
+
+    /**Update the call and conference identifier indexes for a connection.
+       This must be called if either identifier of an active connection is
+       changed, so it can be found by FindConnectionWithLock() using them.
+      */
+    void OnConnectionIdentifiersChanged(
+      H323Connection & connection
+    );
+
     PBoolean EnableH225KeepAlive() const { return m_useH225KeepAlive; }
     PBoolean EnableH245KeepAlive() const { return m_useH245KeepAlive; }
 
@@ -2921,6 +3989,9 @@ class H323EndPoint : public PObject
     H323Gatekeeper * InternalCreateGatekeeper(H323Transport * transport);
     PBoolean InternalRegisterGatekeeper(H323Gatekeeper * gk, PBoolean discovered);
     H323Connection * FindConnectionWithoutLocks(const PString & token);
+    void IndexConnection(H323Connection * connection);
+    void UnindexConnection(H323Connection * connection);
+    void InvalidateCapabilitySnapshot() const;
     virtual H323Connection * InternalMakeCall(
       const PString & existingToken, /// Existing connection to be transferred
       const PString & callIdentity,  /// Call identity of the secondary call (if it exists)
@@ -2929,7 +4000,8 @@ class H323EndPoint : public PObject
       H323Transport * transport,     /// Transport to use for call.
       PString & token,               /// String to use/receive token for connection
       void * userData,               /// user data to pass to CreateConnection
-      PBoolean supplementary = false ///< Whether the call is a supplementary call
+      PBoolean supplementary = false, ///< Whether the call is a supplementary call
+      const PStringList & alternateParties = PStringList() ///< Other addresses of the party, raced at connect
     );
 
     // Configuration variables, commonly changed
@@ -2958,13 +4030,21 @@ class H323EndPoint : public PObject
     PString     videoChannelRecordDevice;
     PBoolean        autoStartReceiveVideo;
     PBoolean        autoStartTransmitVideo;
+    PBoolean        videoRateControl;
+    PINDEX          videoReassemblyWindow;
+    PBoolean        videoLoadShedding;
+    H323VideoDecodeBudget videoDecodeBudget;
 
 #ifdef H323_H239
     PBoolean        autoStartReceiveExtVideo;
     PBoolean        autoStartTransmitExtVideo;
+    unsigned        extVideoFrameRate;
+    PBoolean        extVideoSkipUnchanged;
 #endif // H323_H239
 #endif // H323_VIDEO
 
+    H323EncodeBudget encodeBudget;
+
 #ifdef H323_T38
     PBoolean        autoStartReceiveFax;
     PBoolean        autoStartTransmitFax;
@@ -2974,6 +4054,7 @@ class H323EndPoint : public PObject
     PBoolean        disableFastStart;
     PBoolean        disableH245Tunneling;
     PBoolean        disableH245inSetup;
+    PBoolean        enableH245BurstOpen;
     PBoolean        disableH245QoS;
     PBoolean        disableDetectInBandDTMF;
     PBoolean        disableRFC2833InBandDTMF;
@@ -2996,6 +4077,8 @@ class H323EndPoint : public PObject
     BYTE          rtpIpTypeofService;
     BYTE          tcpIpTypeofService;
     PTimeInterval signallingChannelConnectTimeout;
+    PTimeInterval signallingConnectStagger;
+    H323SignallingPool * signallingPool;
     PTimeInterval signallingChannelCallTimeout;
     PTimeInterval controlChannelStartTimeout;
     PTimeInterval endSessionTimeout;
@@ -3017,6 +4100,9 @@ class H323EndPoint : public PObject
 
     unsigned initialBandwidth;  // in 100s of bits/sev
     PBoolean     clearCallOnRoundTripFail;
+    PBoolean     roundTripDelayPerPeer;
+    PBoolean     lockProfiling;
+    H323PeerLiveness * peerLiveness;
 
     struct PortInfo {
       void Set(
@@ -3037,6 +4123,14 @@ class H323EndPoint : public PObject
 
 #ifdef P_STUN
     H323NatStrategy * natMethods;
+    PTimeInterval natDiscoveryCacheTime;
+    H323NatDiscoveryCache * natDiscoveryCache;
+#endif
+
+#if P_DNS
+    PTimeInterval dnsCacheTime;
+    PTimeInterval dnsNegativeCacheTime;
+    H323DNSResolver * dnsResolver;
 #endif
 
 #ifdef H323_H46019M
@@ -3103,27 +4197,108 @@ class H323EndPoint : public PObject
     PHandleAggregator * rtpAggregator;
 #endif
 
+    PINDEX mediaReactorThreads;
+    RTP_MediaReactor * mediaReactor;
+    PBoolean useTransmitPacing;
+    RTP_TransmitScheduler * transmitScheduler;
+    PBoolean useReportScheduling;
+    RTP_ReportScheduler * reportScheduler;
+    OpalRFC2833Scheduler * rfc2833Scheduler;
+    PINDEX rtpBatchSize;
+    PBoolean multicastReceive;
+    PINDEX audioRedundancy;
+    RTP_DataFrame::PayloadTypes redundancyPayloadType;
+    PBoolean videoRetransmission;
+    RTP_DataFrame::PayloadTypes retransmissionPayloadType;
+    PINDEX rtpPortPoolSize;
+    PTimeInterval rtpPortQuarantine;
+    RTP_PortPool * rtpPortPool;
+    H323MediaWatchdog * mediaWatchdog;
+    RTP_Session::JitterBufferEngine jitterBufferEngine;
+    PBoolean audioConcealment;
+    PBoolean lipSync;
+    PBoolean comfortNoise;
+    unsigned audioLevelExtension;
+    PBoolean jitterBufferPullMode;
+    RTP_Session::Histograms rtpHistograms;
+    PMutex                  rtpHistogramMutex;
+    H323EndPointMetrics     metrics;
+    H323CallTimingStats     callTimingStats;
+    PTimeInterval           slowCallSetupTime;
+    H323CallJournal       * callJournal;
+    PINDEX signallingAcceptors;
+    PBoolean sharedListeners;
+    H323ProcessRelay * processRelay;
+    PINDEX signallingThreadPoolSize;
+    H225TransportThreadPool * signallingThreadPool;
+    PINDEX outgoingCallPoolSize;
+    PINDEX outgoingCallQueueLimit;
+    H225CallThreadPool * outgoingCallPool;
+    PINDEX signallingReactorThreads;
+    H323SignallingReactor * signallingReactor;
+
 #ifdef H323_SIGNAL_AGGREGATE
     PINDEX signallingAggregationSize;
     PHandleAggregator * signallingAggregator;
 #endif
 
     PThread::Priority channelThreadPriority;
+    PThread::Priority channelClassPriority[NumChannelThreadClasses];
+    H323CPUSet        threadAffinity[NumThreadAffinityClasses];
+    PBoolean          mediaSocketSteering;
 
     // Dynamic variables
     H323ListenerList listeners;
     H323Capabilities capabilities;
+    PBoolean         capabilitySharing;
+    H323CapabilityCostModel * capabilityCostModel;
+    mutable H323Capabilities * capabilitySnapshot;   // Shared by connections, NULL until needed
+    mutable PMutex   capabilitySnapshotMutex;
+    PINDEX           capabilityMemoSize;
+    typedef std::multimap<unsigned, H323CapabilityMemo *> CapabilityMemoMap;
+    mutable CapabilityMemoMap capabilityMemos;  // By hash of the encoded set
+    PINDEX           fastStartMemoSize;
+    struct FastStartMemo {
+      PBYTEArray encoding;      // Empty if the channel cannot be remembered
+      PINDEX     mediaOffset;   // Of the mediaChannel address, P_MAX_INDEX if none
+      PINDEX     controlOffset; // Of the mediaControlChannel address
+    };
+    typedef std::map<PString, FastStartMemo> FastStartMemoMap;
+    mutable FastStartMemoMap fastStartMemos;    // By channel format, number and direction
+    PINDEX           capabilitySetMemoSize;
+    struct CapabilitySetMemo {
+      PBYTEArray encoding;      // Whole H.245 PDU
+      PINDEX     sequenceOffset; // Of the sequenceNumber byte
+    };
+    typedef std::map<PString, CapabilitySetMemo> CapabilitySetMemoMap;
+    mutable CapabilitySetMemoMap capabilitySetMemos;  // By usable capabilities and jitter delay
     H323Gatekeeper * gatekeeper;
     PString          gatekeeperPassword;
     PStringList      gkAuthenticatorOrder;
 
     H323ConnectionDict       connectionsActive;
 
-    PMutex                   connectionsMutex;
+    // Indexes of connectionsActive by binary call and conference identifier
+    typedef std::multimap<std::string, H323Connection *> ConnectionIdentifierIndex;
+    struct IndexedIdentifiers {
+      std::string callIdentifier;
+      std::string conferenceIdentifier;
+    };
+    ConnectionIdentifierIndex connectionsByCallId;
+    ConnectionIdentifierIndex connectionsByConferenceId;
+    std::map<H323Connection *, IndexedIdentifiers> connectionIdentifiers;
+
+    H323ProfiledMutex        connectionsMutex;
+    PReadWriteMutex          connectionsTableMutex;  // Read to look up connections, a writer also holds connectionsMutex
     PMutex                   noMediaMutex;
     PStringSet               connectionsToBeCleaned;
+    PStringSet               connectionsBeingCleaned;   // Taken by a cleaner thread
     H323ConnectionsCleaner * connectionsCleaner;
+    PINDEX                   cleanerThreads;
     PSyncPoint               connectionsAreCleaned;
+    PBoolean                 bulkClearing;
+    PBoolean                 bulkSkipDisengage;
+    H323Connection::CallEndReason bulkClearReason;
 
     // Call Authentication
     PString EPSecurityUserName;       /// Local UserName Authenticated Call
@@ -3141,10 +4316,12 @@ class H323EndPoint : public PObject
     PBoolean m_tryingH46017;
     PBoolean m_registeredWithH46017;
     H323Transport * m_h46017Transport;
+    PINDEX m_h46017SignalThreads;
 #endif
 
 #ifdef H323_H46018
     PBoolean m_h46018enabled;
+    PBoolean m_h46018PreOpen;
 #endif
 
 #ifdef H323_H46019M
@@ -3174,8 +4351,21 @@ class H323EndPoint : public PObject
     PBoolean m_IMsession;
     PBoolean m_IMwriteevent;
     PString m_IMmsg;
-    PStringList m_IMsessions;
-    PMutex m_IMmutex;
+    PMutex m_IMmutex;                   ///< Guards the flags of the next IM call and write events
+
+    PBoolean IMSendOnSession(const PString & token, const PString & msg);
+    void IMGetSessionTokens(PStringArray & tokens);
+
+    struct IMSessionInfo {
+      IMSessionInfo() : starting(false) { }
+      PString     peer;                 ///< Party the session is kept for
+      PBoolean    starting;             ///< IM session call not yet open
+      PStringList pending;              ///< Messages waiting for it to open
+    };
+    typedef std::map<PString, IMSessionInfo> IMSessionMap;
+    IMSessionMap               m_IMsessions;  ///< Sessions by call token
+    std::map<PString, PString> m_IMpeers;     ///< Session call token by party
+    PReadWriteMutex            m_IMsessionMutex;
 
     // Multipoint Text functions
     //short m_IMMultiMode;
@@ -3215,6 +4405,9 @@ class H323EndPoint : public PObject
     H323TransportSecurity m_transportSecurity;
 #ifdef H323_TLS
     PSSLContext * m_transportContext;
+    H323TLSSessionCache * m_tlsSessionCache;
+    PINDEX tlsHandshakeWorkers;
+    H323TLSHandshakePool * tlsHandshakePool;
 #endif
 
     void RegInvokeReRegistration();
@@ -42,6 +42,8 @@
 
 #include <ptclib/delaychan.h>
 #include <list>
+#include <deque>
+#include <map>
 
 //////////////////////////////////////////////////////////////////////////////////
 
@@ -396,9 +398,10 @@ public:
   }; 
 
   void BuildPROB();
-  void BuildRequest(opcodes code, const PString & filename, int filesize, int blocksize);
+  void BuildRequest(opcodes code, const PString & filename, int filesize, int blocksize, int windowsize = 0);
   void BuildData(int blockid, int size);
-  void BuildACK(int blockid,int filesize = 0);
+  void BuildACK(int blockid,int filesize = 0, int windowsize = 0);
+  void BuildSACK(int blockid, const PString & received);
   void BuildError(int errorcode,PString errmsg);
 
   H323FilePacket::opcodes GetPacketType() const;
@@ -415,6 +418,10 @@ public:
 
   // For ACK
   int GetACKBlockNo() const;
+  // for RRQ/WRQ and ACK of a request, zero if not offered
+  unsigned GetWindowSize() const;
+  // for ACK in window mode, a y or n for each block after the one following the ACK block
+  PString GetSACK() const;
 
   // for ERROR messages
   void GetErrorInformation(int & ErrCode, PString & ErrStr) const;
@@ -502,6 +509,11 @@ public:
   virtual void SetBlockSize(H323FileTransferCapability::blockSizes size);
   virtual void SetMaxBlockRate(unsigned rate);
 
+// Blocks sent before waiting for an acknowledgement, offered with each
+// request and used if the remote accepts it. 1 is the stop-and-wait transfer
+// of older versions.
+  virtual void SetWindowSize(unsigned blocks);
+
 // User override to get events
 
   virtual void OnStateChange(transferState newState) {};
@@ -520,6 +532,8 @@ public:
         { return (H323FileTransferCapability::blockSizes)blockSize; }
   unsigned GetBlockRate()  
         { return blockRate; }
+  unsigned GetWindowSize()  
+        { return windowSize; }
 
   PBoolean Start(H323Channel::Directions direction);
   PBoolean Stop(H323Channel::Directions direction);
@@ -533,6 +547,15 @@ protected:
 
   PBoolean TransmitFrame(H323FilePacket & buffer, PBoolean final);
   PBoolean ReceiveFrame(H323FilePacket & buffer, PBoolean & final);
+  PBoolean TransmitBlock(H323FilePacket & block);
+
+  // Window mode
+  void ResetWindow();
+  PBoolean ReadWindowBlock(H323FilePacket & block);
+  PBoolean TransmitWindow(PBoolean & done);
+  void OnWindowACK(const H323FilePacket & packet);
+  PBoolean OnWindowData(H323FilePacket & packet);
+  PBoolean BuildWindowACK(H323FilePacket & packet, PBoolean & complete);
 
   void ChangeState(transferState newState);
   void SetBlockState(receiveStates state);
@@ -583,6 +606,39 @@ private:
   unsigned curFileSize;                        ///< Current File being Transmitted size
   unsigned curBlockSize;                       ///< Block size of current transmittion
   unsigned curProgSize;						   ///< Current amount of data sent/received
+
+  // Window mode, blocks numbered from 1 for the whole file and sent as 1-99
+  struct WindowBlock {
+      H323FilePacket packet;
+      unsigned       size;                     ///< Data octets in the block
+      PInt64         sentTick;
+      PBoolean       retransmitted;
+      PBoolean       acked;                    ///< Selectively acknowledged
+  };
+  unsigned maxWindowSize;                      ///< Window offered
+  unsigned windowSize;                         ///< Window agreed, 1 for stop-and-wait
+  PMutex   windowMutex;                        ///< Protects the window between the threads
+  std::deque<WindowBlock> windowBlocks;        ///< Sent and not yet acknowledged, from windowBase
+  unsigned windowBase;                         ///< First block not acknowledged
+  unsigned windowNext;                         ///< Next block to send
+  unsigned windowLast;                         ///< Last block of the file, 0 until read
+  unsigned windowAcked;                        ///< Highest block acknowledged in order
+  PString  windowSACK;                         ///< Blocks acknowledged out of order
+  PBoolean windowLoss;                         ///< Blocks missing in a SACK
+  unsigned congestionWindow;
+  unsigned congestionThreshold;
+  unsigned congestionCount;                    ///< Blocks acknowledged since the window grew
+  PInt64   smoothedRTT;
+  unsigned windowTimeouts;
+  PBYTEArray readAhead;                        ///< File read in large chunks
+  PINDEX   readAheadPos;
+  PINDEX   readAheadLen;
+  unsigned readAheadTotal;                     ///< Octets taken into blocks
+  PBoolean readAheadEnd;
+  unsigned expectedBlock;                      ///< Receiver: next block to write
+  std::map<unsigned, PBYTEArray> windowPending;///< Receiver: blocks after a gap
+  unsigned blocksSinceACK;
+  PBoolean windowACKDue;
 };
 
 #endif
@@ -0,0 +1,205 @@
+/*
+ * h323hottrace.h
+ *
+ * Binary event tracing for the media and signalling paths
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#ifndef __OPAL_H323HOTTRACE_H
+#define __OPAL_H323HOTTRACE_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include "openh323buildopts.h"
+
+#include "ptlib_extras.h"
+
+#include <vector>
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**Tracer for the paths that run for every packet, where PTRACE is far too
+   slow to leave on. Each event is a fixed sized binary record written to a
+   ring buffer owned by the thread, so there is no formatting, allocation or
+   lock when recording. When disabled an event costs one test of a flag.
+
+   Events carry the trace tag of their call, see H323Connection::GetTraceTag(),
+   and recording can be limited to one call. The events are formatted
+   afterwards, from memory or from a file written by Save(), as Chrome trace
+   JSON that chrome://tracing and Perfetto load.
+
+   Build with H323_NO_HOTTRACE defined to remove the trace points entirely.
+  */
+class H323HotTrace
+{
+  public:
+    /**Trace points. New points are added before NumEvents, and named in
+       the table in h323hottrace.cxx.
+      */
+    enum EventId {
+      e_RTPTransmitFrame,     ///< Channel wrote a packet, arg is payload size
+      e_RTPReceiveFrame,      ///< Channel read a frame, arg is payload size
+      e_RTPReadData,          ///< Socket read a packet, arg is sequence number
+      e_SignalPDU,            ///< Handling an H.225 PDU, arg is Q.931 message type
+      e_JitterPlayout,        ///< Jitter buffer played a frame, arg is delay in ms
+      e_JitterLate,           ///< Jitter buffer discarded a late frame, arg is sequence number
+      NumEvents
+    };
+
+    enum Phase {
+      e_Instant,
+      e_Begin,
+      e_End
+    };
+
+    struct Event {
+      PUInt64 time;           ///< Microseconds since the epoch
+      DWORD   tag;            ///< Call trace tag, zero if not known
+      DWORD   arg;
+      DWORD   thread;         ///< Serial number of the recording thread
+      WORD    id;
+      WORD    phase;
+    };
+
+    /**Start recording. Buffers of eventsPerThread (rounded up to a power
+       of two) are allocated as threads first record, at most maxThreads
+       of them, after which the least recently used buffer is reused.
+      */
+    static void Enable(
+      unsigned eventsPerThread = 4096,
+      unsigned maxThreads = 256
+    );
+
+    /**Stop recording, the events recorded so far are kept.
+      */
+    static void Disable();
+
+    /**Discard all events recorded.
+      */
+    static void Clear();
+
+    /**Only record events of one call, zero records every call.
+      */
+    static void SetFilter(
+      DWORD tag
+    );
+
+    static PBoolean IsEnabled() { return enabled; }
+
+    /**Record an event, normally through the H323_HOTTRACE macros.
+      */
+    static void Record(
+      EventId id,
+      DWORD tag,
+      DWORD arg = 0,
+      Phase phase = e_Instant
+    ) {
+      if (enabled && (filter == 0 || filter == tag))
+        Write(id, tag, arg, phase);
+    }
+
+    /**Name a call trace tag, so dumps show the call token.
+      */
+    static void NameCall(
+      DWORD tag,
+      const PString & token
+    );
+
+    /**Get every event recorded, oldest first. Disable() first for a
+       consistent copy, events written during the copy may be torn.
+      */
+    static void GetEvents(
+      std::vector<Event> & events
+    );
+
+    /**Save the events recorded, with call and thread names, to a file.
+      */
+    static PBoolean Save(
+      const PFilePath & filename
+    );
+
+    /**Convert a file written by Save() to Chrome trace JSON.
+      */
+    static PBoolean ConvertToChromeTrace(
+      const PFilePath & filename,
+      ostream & strm
+    );
+
+    /**Write the events recorded as Chrome trace JSON.
+      */
+    static void WriteChromeTrace(
+      ostream & strm
+    );
+
+    /**Get the name of an event.
+      */
+    static const char * GetEventName(
+      unsigned id
+    );
+
+  protected:
+    static void Write(EventId id, DWORD tag, DWORD arg, Phase phase);
+
+    static volatile PBoolean enabled;
+    static volatile DWORD    filter;
+};
+
+
+/**Record a begin event on construction and the end on destruction.
+  */
+class H323HotTraceScope
+{
+  public:
+    H323HotTraceScope(H323HotTrace::EventId id, DWORD tag, DWORD arg = 0)
+      : m_id(id), m_tag(tag), m_arg(arg)
+    { H323HotTrace::Record(m_id, m_tag, m_arg, H323HotTrace::e_Begin); }
+
+    ~H323HotTraceScope()
+    { H323HotTrace::Record(m_id, m_tag, m_arg, H323HotTrace::e_End); }
+
+  protected:
+    H323HotTrace::EventId m_id;
+    DWORD                 m_tag;
+    DWORD                 m_arg;
+};
+
+
+#ifndef H323_NO_HOTTRACE
+#define H323_HOTTRACE(id, tag, arg) H323HotTrace::Record(H323HotTrace::id, (tag), (DWORD)(arg))
+#define H323_HOTTRACE_SCOPE(id, tag, arg) H323HotTraceScope hotTraceScope(H323HotTrace::id, (tag), (DWORD)(arg))
+#else
+#define H323_HOTTRACE(id, tag, arg)
+#define H323_HOTTRACE_SCOPE(id, tag, arg)
+#endif
+
+
+#endif // __OPAL_H323HOTTRACE_H
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,256 @@
+/*
+ * h323journal.h
+ *
+ * Asynchronous journal of call records
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+
+
+#ifndef __H323_JOURNAL_H
+#define __H323_JOURNAL_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include "openh323buildopts.h"
+#include "ptlib_extras.h"
+
+class H323EndPointMetrics;
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**Compact record of an ended call, as written to a H323CallJournal. It is
+   plain data, copied through the journal without allocation, so strings
+   are cut to the size of their fields.
+  */
+struct H323CallRecord
+{
+  enum {
+    AliasSize   = 64,
+    AddressSize = 64,
+    CodecSize   = 32
+  };
+
+  enum Source {
+    e_EndPoint,           ///< Call of a H323Connection
+    e_Gatekeeper          ///< Call admitted by a H323GatekeeperServer
+  };
+
+  H323CallRecord() { Clear(); }
+
+  void Clear();
+
+  /**Copy a string to a field, cut to fit with its terminator.
+    */
+  static void SetField(
+    char * field,
+    PINDEX size,
+    const PString & value
+  );
+
+  /**Set a time field from a PTime, zero if it is not valid.
+    */
+  static PInt64 GetTimestamp(
+    const PTime & time
+  );
+
+  /**Write the record as one line of tab separated fields.
+    */
+  void PrintOn(
+    ostream & strm
+  ) const;
+
+  BYTE   source;
+  BYTE   originating;         ///< Non-zero if the call was made, not answered
+  WORD   endReason;           ///< H323Connection::CallEndReason
+  BYTE   callIdentifier[16];
+  PInt64 setupTime;           ///< Microseconds since 1970, zero if not reached
+  PInt64 connectTime;
+  PInt64 endTime;
+  char   callingAlias[AliasSize];
+  char   calledAlias[AliasSize];
+  char   remoteAddress[AddressSize];
+  char   audioCodec[CodecSize];
+  char   videoCodec[CodecSize];
+  DWORD  packetsSent;         ///< Audio session totals
+  DWORD  packetsReceived;
+  DWORD  packetsLost;
+  DWORD  jitter;              ///< Average audio jitter in milliseconds
+  DWORD  bandwidth;           ///< Bandwidth granted by the gatekeeper, 100's of bits/sec
+};
+
+
+inline ostream & operator<<(ostream & strm, const H323CallRecord & record)
+{
+  record.PrintOn(strm);
+  return strm;
+}
+
+
+/**Journal of call records, taken from the threads clearing calls without a
+   lock or allocation and written in batches by a thread of its own. The
+   clearing thread never waits for the writing: when the queue is full the
+   record is dropped and counted.
+
+   The records are written as text lines to a file or any channel, such as
+   a TCP socket, or handed to OnWriteBatch() of a descendant that writes
+   them somewhere else, a database for example. Set on an endpoint with
+   H323EndPoint::SetCallJournal(), the calls of its connections and of its
+   gatekeeper server, if any, are journalled, and the metrics
+
+     h323_journal_records_total
+     h323_journal_dropped_total
+     h323_journal_write_failures_total
+     h323_journal_queued
+
+   are kept in the metrics of the endpoint.
+  */
+class H323CallJournal : public PObject
+{
+  PCLASSINFO(H323CallJournal, PObject);
+
+  public:
+  /**@name Construction */
+  //@{
+    /**Create a journal holding up to size records not yet written, rounded
+       up to a power of two, written batch records at a time.
+      */
+    H323CallJournal(
+      PINDEX size = 4096,
+      PINDEX batch = 64
+    );
+
+    ~H323CallJournal();
+  //@}
+
+  /**@name Operations */
+  //@{
+    /**Start writing records, appended to a text file.
+      */
+    PBoolean Open(
+      const PFilePath & filename
+    );
+
+    /**Start writing records to a channel, such as a connected TCP socket.
+      */
+    PBoolean Open(
+      PChannel * channel,
+      PBoolean autoDelete = TRUE
+    );
+
+    /**Start writing records, to OnWriteBatch() only.
+      */
+    PBoolean Open();
+
+    /**Write the records queued and stop.
+      */
+    void Close();
+
+    /**Set how long a record may wait for a batch to fill. The default is
+       one second.
+      */
+    void SetFlushInterval(
+      const PTimeInterval & interval
+    ) { flushInterval = interval; }
+
+    /**Set the metrics to count in, done by H323EndPoint::SetCallJournal().
+      */
+    void SetMetrics(
+      H323EndPointMetrics * metrics
+    );
+
+    /**Queue a record for writing, from any thread. Returns FALSE if the
+       queue is full and the record was dropped.
+      */
+    PBoolean Record(
+      const H323CallRecord & record
+    );
+  //@}
+
+  /**@name Statistics */
+  //@{
+    PINDEX GetQueued() const { return (PINDEX)queued; }
+    PInt64 GetWritten() const { return written; }
+    PInt64 GetDropped() const { return dropped; }
+    PInt64 GetWriteFailures() const { return writeFailures; }
+  //@}
+
+  /**@name Call backs */
+  //@{
+    /**Write a batch of records, on the thread of the journal. The default
+       writes them as text lines to the channel, if there is one.
+       Returns FALSE if they could not be written.
+      */
+    virtual PBoolean OnWriteBatch(
+      const H323CallRecord * records,
+      PINDEX count
+    );
+  //@}
+
+  protected:
+    struct Slot {
+      volatile unsigned sequence;   ///< Position when free, position+1 when full
+      H323CallRecord    record;
+    };
+
+    PBoolean StartThread();
+    PBoolean Dequeue(H323CallRecord & record);
+    void Drain(H323CallRecord * batch);
+
+    PDECLARE_NOTIFIER(PThread, H323CallJournal, WriterMain);
+
+    Slot            * slots;
+    unsigned          mask;
+    PINDEX            batchSize;
+    volatile unsigned enqueuePos;
+    unsigned          dequeuePos;   ///< Only the writer thread dequeues
+
+    PChannel        * channel;
+    PBoolean          autoDeleteChannel;
+    PTimeInterval     flushInterval;
+    PThread         * thread;
+    PSyncPoint        wakeUp;
+    volatile PBoolean running;
+
+    H323EndPointMetrics * metrics;
+    volatile PInt64   queued;
+    volatile PInt64   written;
+    volatile PInt64   dropped;
+    volatile PInt64   writeFailures;
+
+  private:
+    H323CallJournal(const H323CallJournal &);
+    H323CallJournal & operator=(const H323CallJournal &);
+};
+
+
+#endif // __H323_JOURNAL_H
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,127 @@
+/*
+ * h323liveness.h
+ *
+ * Round trip delay liveness shared by the calls to one peer
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+
+#ifndef __H323_LIVENESS_H
+#define __H323_LIVENESS_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include "openh323buildopts.h"
+
+#include <map>
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**Liveness of the remote signalling peers of the calls of an endpoint.
+   Each call sends an H.245 RoundTripDelayRequest every round trip delay
+   rate. Between two gateways carrying thousands of calls most of those
+   probes only tell again what the last one told, that the peer is alive.
+   Here a response to any call vouches for every call to the same peer
+   address for one interval, and only one call probes the peer at a time.
+
+   A call to a peer that no other call shares probes as before. Once a
+   probe of a peer times out the calls to it probe for themselves until one
+   of them has a response again, so each call still decides for itself if
+   its remote has gone.
+  */
+class H323PeerLiveness : public PObject
+{
+  PCLASSINFO(H323PeerLiveness, PObject);
+
+  public:
+    H323PeerLiveness();
+
+    /**A call to the peer started using the liveness.
+      */
+    void AddCall(
+      const PString & peer            ///< Remote signalling address of the call
+    );
+
+    /**A call to the peer ended.
+      */
+    void RemoveCall(
+      const PString & peer,           ///< Remote signalling address of the call
+      const PString & token           ///< Token of the call
+    );
+
+    /**The round trip delay of a call is due.
+       Returns TRUE if the call is to send its own probe, FALSE if another
+       call to the peer had a response within the interval or is probing.
+      */
+    PBoolean StartProbe(
+      const PString & peer,           ///< Remote signalling address of the call
+      const PString & token,          ///< Token of the call
+      PInt64 now,                     ///< Tick in milliseconds
+      PInt64 interval                 ///< Round trip delay rate in milliseconds
+    );
+
+    /**A probe of the peer had a response, or timed out.
+      */
+    void OnProbeResult(
+      const PString & peer,           ///< Remote signalling address of the call
+      const PString & token,          ///< Token of the call
+      PBoolean alive,                 ///< Response received
+      PInt64 now                      ///< Tick in milliseconds
+    );
+
+    /**Get the number of probes sent.
+      */
+    PUInt64 GetProbeCount() const { return probeCount; }
+
+    /**Get the number of probes not sent as another call vouched for the peer.
+      */
+    PUInt64 GetVouchedCount() const { return vouchedCount; }
+
+  protected:
+    struct Peer {
+      Peer() : calls(0), lastAlive(0), probeStart(0), failed(FALSE) { }
+
+      PINDEX   calls;
+      PInt64   lastAlive;    ///< Tick of latest response, zero if none
+      PString  prober;       ///< Token of the call probing, empty if none
+      PInt64   probeStart;
+      PBoolean failed;       ///< Latest probe timed out
+    };
+
+    std::map<PString, Peer> peers;
+    PUInt64 probeCount;
+    PUInt64 vouchedCount;
+    PMutex  mutex;
+};
+
+
+#endif // __H323_LIVENESS_H
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,146 @@
+/*
+ * h323lockprof.h
+ *
+ * Contention profiling of the library mutexes
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+
+#ifndef __H323_LOCKPROF_H
+#define __H323_LOCKPROF_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include "openh323buildopts.h"
+#include "ptlib_extras.h"
+
+class H323LockStats;
+class H323MetricsRegistry;
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**Mutex that records its contention when the H323LockProfiler is enabled.
+   It is used for the mutexes of the library suspected of contention, each
+   given a name. All mutexes with the same name, such as the buffer mutex
+   of every jitter buffer, add to the same statistics.
+
+   While the profiler is disabled Wait() and Signal() only test a flag
+   before doing what PTimedMutex does.
+  */
+class H323ProfiledMutex : public PTimedMutex
+{
+  PCLASSINFO(H323ProfiledMutex, PTimedMutex);
+
+  public:
+    /**Create the mutex. The name must be a string constant.
+      */
+    H323ProfiledMutex(
+      const char * name
+    );
+
+    virtual void Wait();
+    virtual PBoolean Wait(const PTimeInterval & timeout);
+    virtual void Signal();
+
+    const char * GetName() const { return name; }
+
+  protected:
+    void OnAcquired(PInt64 waitStart, void * site);
+
+    const char    * name;
+    H323LockStats * stats;
+
+    // Written only by the thread holding the mutex
+    PINDEX holdDepth;
+    PInt64 holdStart;
+    void * holdSite;
+
+  private:
+    H323ProfiledMutex(const H323ProfiledMutex &);
+    H323ProfiledMutex & operator=(const H323ProfiledMutex &);
+};
+
+
+/**Collects the statistics of every H323ProfiledMutex, by name.
+   For each name it counts acquisitions and contended acquisitions, totals
+   the time spent waiting, and keeps a histogram of the waits in powers of
+   two microseconds, all as metrics in a H323MetricsRegistry:
+
+     h323_lock_acquisitions_total{mutex="..."}
+     h323_lock_contended_total{mutex="..."}
+     h323_lock_wait_microseconds_total{mutex="..."}
+     h323_lock_waits_total{mutex="...",bucket="..."}
+     h323_lock_hold_max_microseconds{mutex="..."}
+
+   where bucket is the upper bound of the wait in microseconds, each bucket
+   only counting waits above the one before. The longest hold and longest
+   wait of each mutex, with the code address that took the mutex, are
+   written by PrintReport(), the address being resolved with addr2line or
+   the debugger.
+  */
+class H323LockProfiler
+{
+  public:
+    /**Start recording, with the metrics in the registry given. The registry
+       must outlive the recording, Disable() before deleting it.
+      */
+    static void Enable(
+      H323MetricsRegistry & registry
+    );
+
+    /**Stop recording. The statistics so far are kept.
+      */
+    static void Disable();
+
+    /**Determine if recording.
+      */
+    static PBoolean IsEnabled() { return enabled; }
+
+    /**Write the statistics of every mutex name, with the code addresses of
+       the longest hold and wait.
+      */
+    static void PrintReport(
+      ostream & strm
+    );
+
+    /**Get the statistics for a mutex name, creating them the first time.
+      */
+    static H323LockStats * GetStats(
+      const char * name
+    );
+
+  protected:
+    static volatile PBoolean enabled;
+};
+
+
+#endif // __H323_LOCKPROF_H
+
+
+/////////////////////////////////////////////////////////////////////////////
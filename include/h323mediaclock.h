@@ -0,0 +1,79 @@
+/*
+ * h323mediaclock.h
+ *
+ * Monotonic clock for media timing
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#ifndef __H323_MEDIACLOCK_H
+#define __H323_MEDIACLOCK_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include "openh323buildopts.h"
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**The clock all media timing is taken from: RTP timestamps made from real
+   time, packet arrival for the jitter calculations, playout delays and
+   pacing. It is monotonic at microsecond resolution and never stepped by a
+   change of the time of day. Reads are cheap: on Linux clock_gettime() of
+   CLOCK_MONOTONIC is answered in the vDSO from the TSC without entering
+   the kernel, on Windows the performance counter is read, and on OS X the
+   Mach absolute time.
+  */
+class H323MediaClock
+{
+  public:
+    /**Get the microseconds since an arbitrary start, the same for every
+       thread of the process.
+      */
+    static PInt64 GetMicroseconds();
+
+    /**Get the milliseconds since the same arbitrary start.
+      */
+    static PInt64 GetMilliseconds() { return GetMicroseconds()/1000; }
+
+    /**Get the time as PTimer::Tick() does, but from the media clock.
+      */
+    static PTimeInterval GetTick() { return PTimeInterval(GetMilliseconds()); }
+
+    /**Get the time in units of a media clock rate, 90000 for video, for
+       RTP timestamps. Only differences of the result are meaningful.
+      */
+    static DWORD GetTimestamp(
+      unsigned clockRate    ///< Units per second
+    ) { return (DWORD)(GetMicroseconds()*clockRate/1000000); }
+};
+
+
+#endif // __H323_MEDIACLOCK_H
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,162 @@
+/*
+ * h323mediawatch.h
+ *
+ * Detection of calls whose media has stopped
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#ifndef __H323_MEDIAWATCH_H
+#define __H323_MEDIAWATCH_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include "openh323buildopts.h"
+#include "ptlib_extras.h"
+
+#include <set>
+
+class H323EndPoint;
+class H323MediaWatchdog;
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**Media state of one call as seen by the H323MediaWatchdog.
+   The media threads of the call write it as they start, stop and pass
+   media, without a lock, and the watchdog only reads it.
+  */
+class H323MediaActivity
+{
+  public:
+    /**A media thread of the call started.
+      */
+    void ChannelStarted() { ++running; ++waiting; }
+
+    /**A media thread of the call ended.
+      */
+    void ChannelStopped(
+      PBoolean hadMedia     ///< OnMedia() was called for the channel
+    ) { if (!hadMedia) --waiting; --running; }
+
+    /**A media thread passed media, the first time for the channel or not.
+      */
+    void OnMedia(
+      PInt64 tick,          ///< Tick in milliseconds
+      PBoolean first        ///< First media of the channel
+    ) {
+      lastMedia = (DWORD)tick;
+      if (first) {
+        // The time must be seen before the channel stops counting as waiting
+        H323_MEMORY_BARRIER();
+        --waiting;
+      }
+    }
+
+    const PString & GetCallToken() const { return callToken; }
+
+  protected:
+    H323MediaActivity(const PString & token, const PTimeInterval & timeout);
+
+    /**Indicate no running channel, of at least one, had media for the timeout.
+       A channel that never had media does not count as silent.
+      */
+    PBoolean IsSilent(DWORD now) const;
+
+    PString        callToken;
+    DWORD          timeout;
+    PAtomicInteger running;     ///< Media threads of the call
+    PAtomicInteger waiting;     ///< Media threads yet to pass media
+    volatile DWORD lastMedia;   ///< Tick of the latest media of any thread
+
+  friend class H323MediaWatchdog;
+};
+
+
+/**One thread for the endpoint that clears the calls whose media has
+   stopped for the no media timeout.
+   Before this each connection looked at the silence of each of its
+   channels, under the connection lock, every time its signalling channel
+   read timed out. Here the media threads only note the time of their
+   latest media, and the thread scans the calls once a second reading those
+   times, taking no connection lock unless a call is to be cleared.
+  */
+class H323MediaWatchdog : public PObject
+{
+  PCLASSINFO(H323MediaWatchdog, PObject);
+
+  public:
+    /**Create the watchdog and start its thread.
+      */
+    H323MediaWatchdog(
+      H323EndPoint & endpoint,
+      const PTimeInterval & scanInterval = PTimeInterval(0, 1)
+    );
+
+    /**Stop the thread. All calls must have been removed before this.
+      */
+    ~H323MediaWatchdog();
+
+    /**Start watching a call, the activity returned is for its media threads.
+      */
+    H323MediaActivity * Register(
+      const PString & token,          ///< Token of the call
+      const PTimeInterval & timeout   ///< Silence after which it is cleared
+    );
+
+    /**Stop watching a call. Its media threads must have ended.
+      */
+    void Unregister(
+      H323MediaActivity * activity
+    );
+
+    /**Get the number of calls cleared for lack of media.
+      */
+    PUInt64 GetClearedCount() const { return clearedCount; }
+
+  protected:
+    class Thread;
+    friend class Thread;
+
+    void Main();
+
+    H323EndPoint & endpoint;
+    PTimeInterval  scanInterval;
+    std::set<H323MediaActivity *> calls;
+    PUInt64        clearedCount;
+    PBoolean       shutdown;
+
+    PMutex     mutex;           ///< Protects the calls
+    PSyncPoint wakeUp;
+    Thread   * thread;
+};
+
+
+#endif // __H323_MEDIAWATCH_H
+
+
+/////////////////////////////////////////////////////////////////////////////
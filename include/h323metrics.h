@@ -0,0 +1,384 @@
+/*
+ * h323metrics.h
+ *
+ * Endpoint metrics registry and exporters
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#ifndef __OPAL_H323METRICS_H
+#define __OPAL_H323METRICS_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include "openh323buildopts.h"
+#include <ptlib/sockets.h>
+
+#include "ptlib_extras.h"
+
+#include <map>
+#include <vector>
+
+
+class H323MetricsExporter;
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**A named value in a H323MetricsRegistry. Metrics are created by the
+   registry and live as long as it does, so a reference to one may be kept
+   and updated without any lookup.
+  */
+class H323Metric : public PObject
+{
+  PCLASSINFO(H323Metric, PObject);
+
+  public:
+    enum Type {
+      e_Counter,    ///< Only ever goes up
+      e_Gauge       ///< Current level, goes up and down
+    };
+
+    H323Metric(
+      Type type,
+      const PString & name,
+      const PString & help,
+      const PString & labels
+    );
+
+    /**Get the current value, from any thread.
+      */
+    virtual PInt64 GetValue() const = 0;
+
+    Type GetType() const             { return type; }
+    const PString & GetName() const  { return name; }
+    const PString & GetHelp() const  { return help; }
+    const PString & GetLabels() const { return labels; }
+
+  protected:
+    Type    type;
+    PString name;
+    PString help;
+    PString labels;
+};
+
+
+/**Counter that many threads add to at once. The count is split over a
+   number of cache lines chosen by the calling thread, so threads rarely
+   contend for the same line, and the shards are summed when it is read.
+  */
+class H323MetricCounter : public H323Metric
+{
+  PCLASSINFO(H323MetricCounter, H323Metric);
+
+  public:
+    enum { NumShards = 16 };
+
+    H323MetricCounter(
+      const PString & name,
+      const PString & help,
+      const PString & labels
+    );
+
+    /**Add to the counter, from any thread.
+      */
+    void Add(
+      PInt64 value = 1
+    ) { H323_ATOMIC_ADD64(&shards[GetShard()].value, value); }
+
+    virtual PInt64 GetValue() const;
+
+  protected:
+    static unsigned GetShard();
+
+    struct Shard {
+      volatile PInt64 value;
+      char            padding[64 - sizeof(PInt64)];
+    } shards[NumShards];
+};
+
+
+/**Gauge holding the current level of something.
+  */
+class H323MetricGauge : public H323Metric
+{
+  PCLASSINFO(H323MetricGauge, H323Metric);
+
+  public:
+    H323MetricGauge(
+      const PString & name,
+      const PString & help,
+      const PString & labels
+    );
+
+    /**Add to, or with a negative value subtract from, the gauge.
+      */
+    void Add(
+      PInt64 delta
+    ) { H323_ATOMIC_ADD64(&value, delta); }
+
+    /**Set the gauge, where the level is known rather than counted.
+      */
+    void Set(
+      PInt64 level
+    ) { value = level; H323_MEMORY_BARRIER(); }
+
+    virtual PInt64 GetValue() const { return value; }
+
+  protected:
+    volatile PInt64 value;
+};
+
+
+/**Value of a metric when the registry was read.
+  */
+struct H323MetricValue
+{
+  H323Metric::Type type;
+  PString          name;
+  PString          help;
+  PString          labels;
+  PInt64           value;
+};
+
+typedef std::vector<H323MetricValue> H323MetricValueList;
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**Registry of the counters and gauges of an endpoint. Reading the registry
+   only takes its own mutex, held while the list of metrics is walked, and
+   never locks any connection or the endpoint connections list, so it is
+   safe to scrape as often as wanted on a busy endpoint.
+
+   Exporters added to the registry are given the values every export
+   interval from the PTLib timer thread.
+  */
+class H323MetricsRegistry : public PObject
+{
+  PCLASSINFO(H323MetricsRegistry, PObject);
+
+  public:
+    H323MetricsRegistry();
+    ~H323MetricsRegistry();
+
+    /**Get a counter, creating it the first time. Labels are in Prometheus
+       form, for example reason="EndedByRemoteUser".
+      */
+    H323MetricCounter & GetCounter(
+      const PString & name,
+      const PString & help,
+      const PString & labels = PString::Empty()
+    );
+
+    /**Get a gauge, creating it the first time.
+      */
+    H323MetricGauge & GetGauge(
+      const PString & name,
+      const PString & help,
+      const PString & labels = PString::Empty()
+    );
+
+    /**Add a metric that works out its own value, the registry then owns
+       it. Returns FALSE, and deletes the metric, if one with the same name
+       and labels exists.
+      */
+    PBoolean AddMetric(
+      H323Metric * metric
+    );
+
+    /**Get the values of all metrics, sorted by name then labels.
+      */
+    void GetValues(
+      H323MetricValueList & values
+    ) const;
+
+    /**Add an exporter, the registry then owns it.
+      */
+    void AddExporter(
+      H323MetricsExporter * exporter
+    );
+
+    /**Set how often the exporters are given the values. Zero, the default,
+       stops export, exporters may still be called with Export().
+      */
+    void SetExportInterval(
+      const PTimeInterval & interval
+    );
+
+    /**Give every exporter the current values now.
+      */
+    void Export();
+
+  protected:
+    H323Metric * FindMetric(const PString & key) const;
+    PDECLARE_NOTIFIER(PTimer, H323MetricsRegistry, OnExportTimer);
+
+    typedef std::map<PString, H323Metric *> MetricMap;
+    MetricMap metrics;
+    PMutex    metricsMutex;
+
+    std::vector<H323MetricsExporter *> exporters;
+    PMutex exportMutex;
+    PTimer exportTimer;
+};
+
+
+/**Metrics kept by every H323EndPoint. Applications may add their own to
+   the same registry with GetCounter() and GetGauge().
+  */
+class H323EndPointMetrics : public H323MetricsRegistry
+{
+  PCLASSINFO(H323EndPointMetrics, H323MetricsRegistry);
+
+  public:
+    H323EndPointMetrics();
+
+    /**Count a call ending, by its H323Connection::CallEndReason.
+      */
+    void OnCallEnded(
+      const PString & reason
+    );
+
+    H323MetricCounter & callsTotal;
+    H323MetricGauge   & callsActive;
+    H323MetricGauge   & connectionBytes;
+    H323MetricGauge   & callsCleaning;
+    H323MetricCounter & callsCleanedTotal;
+    H323MetricCounter & callCleanUpTime;
+    H323MetricCounter & signalPDUsReceived;
+    H323MetricCounter & tlsHandshakes;
+    H323MetricCounter & tlsHandshakesResumed;
+    H323MetricCounter & tlsHandshakeTime;
+    H323MetricCounter & rtpPacketsSent;
+    H323MetricCounter & rtpOctetsSent;
+    H323MetricCounter & rtpPacketsReceived;
+    H323MetricCounter & rtpOctetsReceived;
+    H323MetricCounter & rtpPacketsLost;
+    H323MetricCounter & rtpPacketsTooLate;
+    H323MetricCounter & rtpBufferOverruns;
+    H323MetricCounter & rtpPacketsRecovered;
+    H323MetricCounter & gkRegistrationsTotal;
+    H323MetricGauge   & gkRegistrations;
+    H323MetricCounter & gkCallsTotal;
+    H323MetricGauge   & gkCalls;
+    H323MetricGauge   & transactionsQueued;
+    H323MetricCounter & transactionsShed;
+    H323MetricCounter & transactionsDelayed;
+    H323MetricCounter & transactionQueueTime;
+    H323MetricGauge   & outgoingCallsQueued;
+    H323MetricCounter & outgoingCallsRejected;
+    H323MetricCounter & outgoingCallQueueTime;
+    H323MetricCounter & journalRecords;
+    H323MetricCounter & journalDropped;
+    H323MetricCounter & journalWriteFailures;
+    H323MetricGauge   & journalQueued;
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**Base for the ways metrics leave the process.
+  */
+class H323MetricsExporter : public PObject
+{
+  PCLASSINFO(H323MetricsExporter, PObject);
+
+  public:
+    /**Export the values, called every export interval of the registry.
+      */
+    virtual void Export(
+      const H323MetricValueList & values
+    ) = 0;
+};
+
+
+/**Prometheus text exposition format. Each export formats the page, which
+   an application HTTP server returns from GetText() on a scrape. To format
+   on demand instead, call Format() with the registry values.
+  */
+class H323PrometheusExporter : public H323MetricsExporter
+{
+  PCLASSINFO(H323PrometheusExporter, H323MetricsExporter);
+
+  public:
+    virtual void Export(
+      const H323MetricValueList & values
+    );
+
+    /**Get the page made by the last export.
+      */
+    PString GetText() const;
+
+    /**Format values into the text exposition format.
+      */
+    static void Format(
+      ostream & strm,
+      const H323MetricValueList & values
+    );
+
+  protected:
+    PString text;
+    PMutex  textMutex;
+};
+
+
+/**Send the metrics to a StatsD server over UDP. Counters are sent as the
+   increase since the last export, gauges as their level. StatsD has no
+   labels, so label values are added to the name, for example
+   h323.calls_ended_total.EndedByRemoteUser.
+  */
+class H323StatsDExporter : public H323MetricsExporter
+{
+  PCLASSINFO(H323StatsDExporter, H323MetricsExporter);
+
+  public:
+    H323StatsDExporter(
+      const PIPSocket::Address & address,   ///< StatsD server
+      WORD port = 8125,                     ///< StatsD port
+      const PString & prefix = "h323"       ///< Prefix of every name
+    );
+
+    virtual void Export(
+      const H323MetricValueList & values
+    );
+
+  protected:
+    void Send(const PString & lines);
+
+    PIPSocket::Address address;
+    WORD               port;
+    PString            prefix;
+    PUDPSocket         socket;
+    std::map<PString, PInt64> lastCounts;
+};
+
+
+#endif // __OPAL_H323METRICS_H
+
+
+/////////////////////////////////////////////////////////////////////////////
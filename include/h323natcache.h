@@ -0,0 +1,165 @@
+/*
+ * h323natcache.h
+ *
+ * Cache of NAT discovery results
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+
+#ifndef __H323NATCACHE_H
+#define __H323NATCACHE_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include "openh323buildopts.h"
+
+#ifdef P_STUN
+
+#include <ptclib/pnat.h>
+#include <map>
+
+class H323EndPoint;
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**Endpoint wide cache of what the NAT methods have discovered.
+   Finding the external address or NAT type takes STUN or UPnP round trips,
+   which if made while a call is set up add to the post dial delay. The cache
+   keeps each result for a time to live and a thread refreshes the results of
+   the NAT methods in the background before they expire, so calls read them
+   from memory. A result older than its time to live, because the refresh
+   failed, is not used and the caller finds it again.
+
+   Results are kept by key. The results of a NAT method are kept under its
+   name and refreshed through the endpoint NAT method list, other results,
+   such as the H.460.23 NAT test against a STUN server, are set by their
+   owner and only expire.
+  */
+class H323NatDiscoveryCache : public PObject
+{
+  PCLASSINFO(H323NatDiscoveryCache, PObject);
+
+  public:
+  /**@name Construction */
+  //@{
+    /**Create the cache.
+      */
+    H323NatDiscoveryCache(
+      H323EndPoint & endpoint,            ///< Endpoint owning the NAT methods
+      const PTimeInterval & timeToLive    ///< Time a result is kept
+    );
+
+    /**Stop the refresh thread.
+      */
+    ~H323NatDiscoveryCache();
+  //@}
+
+  /**@name Operations */
+  //@{
+    /**Get the external address of a NAT method, from the cache if it is
+       known, otherwise from the method, which is then refreshed in the
+       background.
+      */
+    PBoolean GetExternalAddress(
+      PNatMethod & method,                ///< NAT method
+      PIPSocket::Address & address        ///< Returned external address
+    );
+
+    /**Get a result, FALSE if not known or expired.
+       natType is -1 if only the address is known.
+      */
+    PBoolean GetResult(
+      const PString & key,                ///< Key of the result
+      int & natType,                      ///< Returned NAT type
+      PIPSocket::Address & address        ///< Returned external address
+    );
+
+    /**Set a result.
+      */
+    void SetResult(
+      const PString & key,                ///< Key of the result
+      int natType,                        ///< NAT type, -1 if not known
+      const PIPSocket::Address & address, ///< External address
+      PBoolean refresh = FALSE            ///< Key is a NAT method to refresh the result from
+    );
+
+    /**Remove a result, for example when the server of a method changes.
+      */
+    void Invalidate(
+      const PString & key                 ///< Key of the result
+    );
+
+    /**Remove all results, for example when the network interfaces change.
+      */
+    void InvalidateAll();
+
+    /**Get the time a result is kept.
+      */
+    const PTimeInterval & GetTimeToLive() const { return timeToLive; }
+  //@}
+
+    /**Get the key a NAT method is cached under.
+      */
+    static PString GetMethodKey(
+      const PNatMethod & method           ///< NAT method
+    );
+
+  protected:
+    class Thread;
+    friend class Thread;
+
+    struct Entry {
+      int                natType;
+      PIPSocket::Address address;
+      PInt64             discovered;      ///< Tick the result was found
+      PInt64             refreshTime;     ///< Tick of the next background refresh
+      PBoolean           refresh;         ///< Refreshed from the NAT method of the same name
+    };
+    typedef std::map<PString, Entry> EntryMap;
+
+    void Main();
+    void Refresh(const PString & key, PBoolean withType);
+
+    H323EndPoint & endpoint;
+    PTimeInterval  timeToLive;
+    EntryMap       entries;
+    PBoolean       shutdown;
+
+    PMutex         mutex;
+    PSyncPoint     wakeUp;
+    Thread       * thread;
+};
+
+
+#endif // P_STUN
+
+#endif // __H323NATCACHE_H
+
+
+/////////////////////////////////////////////////////////////////////////////
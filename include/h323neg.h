@@ -40,6 +40,7 @@
 
 #include "h323pdu.h"
 #include "channels.h"
+#include "h323timer.h"
 
 
 
@@ -55,11 +56,11 @@ class H245Negotiator : public PObject
     H245Negotiator(H323EndPoint & endpoint, H323Connection & connection);
 
   protected:
-    PDECLARE_NOTIFIER(PTimer, H245Negotiator, HandleTimeout);
+    PDECLARE_NOTIFIER(H323Timer, H245Negotiator, HandleTimeout);
 
     H323EndPoint   & endpoint;
     H323Connection & connection;
-    PTimer           replyTimer;
+    H323Timer        replyTimer;
     PMutex           mutex;
 };
 
@@ -79,7 +80,7 @@ class H245NegMasterSlaveDetermination : public H245Negotiator
     PBoolean HandleAck(const H245_MasterSlaveDeterminationAck & pdu);
     PBoolean HandleReject(const H245_MasterSlaveDeterminationReject & pdu);
     PBoolean HandleRelease(const H245_MasterSlaveDeterminationRelease & pdu);
-    void HandleTimeout(PTimer &, INT);
+    void HandleTimeout(H323Timer &, INT);
 
     PBoolean IsMaster() const     { return status == e_DeterminedMaster; }
     PBoolean IsDetermined() const { return state == e_Idle && status != e_Indeterminate; }
@@ -128,7 +129,7 @@ class H245NegTerminalCapabilitySet : public H245Negotiator
     PBoolean HandleAck(const H245_TerminalCapabilitySetAck & pdu);
     PBoolean HandleReject(const H245_TerminalCapabilitySetReject & pdu);
     PBoolean HandleRelease(const H245_TerminalCapabilitySetRelease & pdu);
-    void HandleTimeout(PTimer &, INT);
+    void HandleTimeout(H323Timer &, INT);
 
     PBoolean HasSentCapabilities() const { return state == e_Sent; }
     PBoolean HasReceivedCapabilities() const { return receivedCapabilites; }
@@ -182,7 +183,7 @@ class H245NegLogicalChannel : public H245Negotiator
     virtual PBoolean HandleRequestCloseAck(const H245_RequestChannelCloseAck & pdu);
     virtual PBoolean HandleRequestCloseReject(const H245_RequestChannelCloseReject & pdu);
     virtual PBoolean HandleRequestCloseRelease(const H245_RequestChannelCloseRelease & pdu);
-    virtual void HandleTimeout(PTimer &, INT);
+    virtual void HandleTimeout(H323Timer &, INT);
 
     H323Channel * GetChannel();
 
@@ -268,6 +269,7 @@ class H245NegLogicalChannels : public H245Negotiator
     H245NegLogicalChannel & GetNegLogicalChannelAt(PINDEX i);
     H245NegLogicalChannel * FindNegLogicalChannel(unsigned channelNumber, PBoolean fromRemote);
     H323Channel * FindChannelBySession(unsigned rtpSessionId, PBoolean fromRemote);
+    void StartTerminationAll();
     void RemoveAll();
 
   protected:
@@ -291,7 +293,7 @@ class H245NegRequestMode : public H245Negotiator
     virtual PBoolean HandleAck(const H245_RequestModeAck & pdu);
     virtual PBoolean HandleReject(const H245_RequestModeReject & pdu);
     virtual PBoolean HandleRelease(const H245_RequestModeRelease & pdu);
-    virtual void HandleTimeout(PTimer &, INT);
+    virtual void HandleTimeout(H323Timer &, INT);
 
   protected:
     PBoolean awaitingResponse;
@@ -312,7 +314,7 @@ class H245NegRoundTripDelay : public H245Negotiator
     PBoolean StartRequest();
     PBoolean HandleRequest(const H245_RoundTripDelayRequest & pdu);
     PBoolean HandleResponse(const H245_RoundTripDelayResponse & pdu);
-    void HandleTimeout(PTimer &, INT);
+    void HandleTimeout(H323Timer &, INT);
 
     PTimeInterval GetRoundTripDelay() const { return roundTripTime; }
     PBoolean IsRemoteOffline() const { return retryCount == 0; }
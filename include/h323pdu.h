@@ -200,6 +200,11 @@ class H323SignalPDU : public H225_H323_UserInformation
      */
     void SetQ931(const Q931 & _q931pdu) { q931pdu = _q931pdu; }
 
+    /**Get the bytes of the Q.931 PDU as read, for authenticators that hash
+       the message as received. Empty if the PDU was not read.
+     */
+    const PBYTEArray & GetRawPDU() const { return rawPDU; }
+
     /**Build the Q.931 wrapper PDU for H.225 signalling PDU.
        This must be called after altering fields in the H.225 part of the PDU.
        If it has never been done, then the Write() functions will do so.
@@ -296,6 +301,7 @@ class H323SignalPDU : public H225_H323_UserInformation
     // Even though we generally deal with the H323 protocol (H225) it is
     // actually contained within a field of the Q931 protocol.
     Q931 q931pdu;
+    PBYTEArray rawPDU;
 };
 
 
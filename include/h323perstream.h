@@ -0,0 +1,139 @@
+/*
+ * h323perstream.h
+ *
+ * Word level ASN.1 PER stream
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+
+
+#ifndef __H323PERSTREAM_H
+#define __H323PERSTREAM_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include <ptclib/asner.h>
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**PER stream that moves bits a 64 bit word at a time. It is a PPER_Stream,
+   so it is passed to the generated ASN.1 codecs and to everything taking a
+   PPER_Stream unchanged.
+
+   The generated code reaches the stream through the virtual encode and
+   decode functions of PASN_Stream. Those for the types that make up most
+   of a PDU are overridden here: BOOLEAN, ENUMERATED, INTEGER with a range
+   of up to 65536 values, OCTET STRING with a length below 16384, and the
+   fixed size BIT STRING that is the optional field map of every SEQUENCE
+   with up to 16 optional fields. Bits are read by loading the eight bytes
+   at the read position as one word and shifting the field out, and written
+   by shifting the field into a word and storing the bytes it covers, where
+   PPER_Stream takes a bit or byte at a time. Aligned octet strings are
+   copied with one memcpy().
+
+   Anything else, including the extension additions of extensible types,
+   falls back to PPER_Stream, which shares the stream position. The result
+   is the same encoding bit for bit.
+  */
+class H323_PERStream : public PPER_Stream
+{
+  PCLASSINFO(H323_PERStream, PPER_Stream);
+
+  public:
+  /**@name Construction */
+  //@{
+    /**Create an empty stream for encoding.
+      */
+    H323_PERStream(
+      PBoolean aligned = TRUE
+    );
+
+    /**Create a stream for decoding the bytes given.
+      */
+    H323_PERStream(
+      const PBYTEArray & bytes,
+      PBoolean aligned = TRUE
+    );
+
+    /**Create a stream for decoding the bytes given.
+      */
+    H323_PERStream(
+      const BYTE * buf,
+      PINDEX size,
+      PBoolean aligned = TRUE
+    );
+
+    H323_PERStream & operator=(const PBYTEArray & bytes);
+  //@}
+
+  /**@name Overrides from PASN_Stream */
+  //@{
+    virtual PBoolean BooleanDecode(PASN_Boolean & value);
+    virtual void BooleanEncode(const PASN_Boolean & value);
+    virtual PBoolean IntegerDecode(PASN_Integer & value);
+    virtual void IntegerEncode(const PASN_Integer & value);
+    virtual PBoolean EnumerationDecode(PASN_Enumeration & value);
+    virtual void EnumerationEncode(const PASN_Enumeration & value);
+    virtual PBoolean OctetStringDecode(PASN_OctetString & value);
+    virtual void OctetStringEncode(const PASN_OctetString & value);
+    virtual PBoolean BitStringDecode(PASN_BitString & value);
+    virtual void BitStringEncode(const PASN_BitString & value);
+  //@}
+
+  /**@name Bit access */
+  //@{
+    /**Read up to 32 bits, most significant first. Returns FALSE, leaving
+       the position unchanged, if fewer bits remain.
+      */
+    PBoolean ReadBits(
+      unsigned nBits,
+      unsigned & value
+    );
+
+    /**Write the low nBits of value, up to 32, most significant first.
+      */
+    void WriteBits(
+      unsigned value,
+      unsigned nBits
+    );
+  //@}
+
+  protected:
+    PBoolean FastUnsignedDecode(unsigned lower, unsigned upper, unsigned & value);
+    void FastUnsignedEncode(unsigned value, unsigned lower, unsigned upper);
+    PBoolean FastLengthDecode(const PASN_ConstrainedObject & obj, unsigned & length);
+    PBoolean FastLengthEncode(const PASN_ConstrainedObject & obj, unsigned length);
+    void AlignWrite();
+};
+
+
+#endif // __H323PERSTREAM_H
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,137 @@
+/*
+ * h323plc.h
+ *
+ * Concealment and time scaling of decoded audio
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#ifndef __H323PLC_H
+#define __H323PLC_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include "openh323buildopts.h"
+
+#include <vector>
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**Concealment of lost frames and time compression for 16 bit PCM audio.
+   This sits between the decoder and the sound device of a codec whose
+   decoder has no concealment of its own. When a frame is missing the last
+   pitch period of the audio before the loss is repeated, fading out from
+   10ms to 60ms after the loss started, after the manner of ITU-T G.711
+   Appendix I. The first frame after a loss is cross faded from the
+   repeated audio so there is no click.
+
+   Shorten() takes one pitch period out of a decoded frame, cross fading
+   across the cut, if the frame is periodic enough or quiet enough for it
+   not to be heard. The jitter buffer uses it to bring its delay down
+   during a talk burst instead of dropping a whole frame.
+  */
+class H323AudioConcealer : public PObject
+{
+  PCLASSINFO(H323AudioConcealer, PObject);
+
+  public:
+  /**@name Construction */
+  //@{
+    /**Create a concealer for audio at the sample rate.
+      */
+    H323AudioConcealer(
+      unsigned sampleRate = 8000   ///< Samples per second of the audio
+    );
+  //@}
+
+  /**@name Operations */
+  //@{
+    /**Pass a frame decoded from a received packet.
+       If frames were concealed before it the start of the frame is cross
+       faded from the concealment, otherwise it is unchanged.
+      */
+    void OnDecoded(
+      short * pcm,        ///< Decoded samples, modified in place
+      PINDEX samples      ///< Number of samples
+    );
+
+    /**Fill a frame that was not received.
+      */
+    void Conceal(
+      short * pcm,        ///< Buffer for the samples
+      PINDEX samples      ///< Number of samples
+    );
+
+    /**Take one pitch period out of a decoded frame.
+       Returns the number of samples left, which is unchanged if the frame
+       could not be shortened without being heard. OnDecoded() should be
+       called on the frame first.
+      */
+    PINDEX Shorten(
+      short * pcm,        ///< Decoded samples, modified in place
+      PINDEX samples      ///< Number of samples
+    );
+
+    /**Forget the audio before a silence or a change of talker.
+      */
+    void Reset();
+
+    /**Get the number of frames filled by Conceal().
+      */
+    DWORD GetConcealedFrames() const { return concealedFrames; }
+
+    /**Get the number of frames shortened by Shorten().
+      */
+    DWORD GetShortenedFrames() const { return shortenedFrames; }
+  //@}
+
+  protected:
+    PINDEX FindPitch(const short * pcm, PINDEX length, PINDEX maxLag, double & correlation) const;
+    void AddHistory(const short * pcm, PINDEX samples);
+    short NextConcealed();
+
+    PINDEX minPitch;
+    PINDEX maxPitch;
+    PINDEX fadeStart;               // Samples concealed before fading out
+    PINDEX fadeLength;              // Samples over which concealment fades out
+
+    std::vector<short> history;     // Last decoded samples, oldest first
+    PINDEX historyFill;
+    std::vector<short> period;      // Pitch period being repeated
+    PINDEX periodPosition;
+    PINDEX concealedSamples;        // Since the loss started, 0 if none
+
+    DWORD concealedFrames;
+    DWORD shortenedFrames;
+};
+
+
+#endif // __H323PLC_H
+
+
+/////////////////////////////////////////////////////////////////////////////
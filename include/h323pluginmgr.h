@@ -64,6 +64,74 @@ class H323PluginCodecManager : public PPluginModuleManager
 
     static void CodecListing(const PString & matchStr, PStringList & listing);
 
+    /**Set the number of idle contexts kept for reuse per plugin codec.
+       A context is only kept if the codec has the
+       PLUGINCODEC_CONTROL_RESET_CODEC control and it succeeds, the reset
+       context must then behave as a newly created one. Zero, the default,
+       destroys every context with its codec.
+      */
+    static void SetCodecContextPoolSize(unsigned size);
+
+    /**Get the number of idle contexts kept for reuse per plugin codec.
+      */
+    static unsigned GetCodecContextPoolSize();
+
+    /**Create a context for a plugin codec, reusing an idle one if any.
+      */
+    static void * CreateCodecContext(const PluginCodec_Definition * codec);
+
+    /**Release a context created by CreateCodecContext(). It is reset and
+       kept for reuse if the pool has room, otherwise it is destroyed.
+      */
+    static void DestroyCodecContext(const PluginCodec_Definition * codec, void * context);
+
+    /**Destroy the idle contexts of a codec, or of every codec if NULL.
+      */
+    static void FlushCodecContexts(const PluginCodec_Definition * codec = NULL);
+
+    /**Set the number of threads each new video encoder may use. It is
+       passed to the plugin as the "Encoding Threads" option, plugins
+       that do not know it ignore it. Zero, the default, leaves the plugin
+       default of one thread.
+      */
+    static void SetVideoEncoderThreads(unsigned threads);
+
+    /**Get the number of threads each new video encoder may use.
+      */
+    static unsigned GetVideoEncoderThreads();
+
+    /**Set new video encoders to answer fast update requests with a
+       gradual intra refresh, coding a column of macroblocks intra in each
+       frame, instead of a whole intra frame. This spreads the cost of the
+       refresh over the key frame period. It is passed to the plugin as the
+       "Intra Refresh" option, plugins that do not know it send intra
+       frames. Default FALSE.
+      */
+    static void SetVideoIntraRefresh(PBoolean enable);
+
+    /**Get whether new video encoders use a gradual intra refresh.
+      */
+    static PBoolean GetVideoIntraRefresh();
+
+    /**Create and destroy a context of every registered plugin codec on
+       background threads, so a codec that loads libraries or builds tables
+       on first use has done so before the first call needs it. This is the
+       case for the FFmpeg based plugins when PTLIB_CODEC_LAZY_LOAD is set
+       in the environment, they then register their codecs without loading
+       libavcodec. With a context pool the contexts are kept for the first
+       calls. Returns at once, the PTLIB_CODEC_WARMUP_THREADS environment
+       variable does the same when the plugins are loaded.
+      */
+    static void WarmUpCodecs(unsigned threads = 1);
+
+    /**Get the definitions of the registered plugin codecs, each encoder
+       followed by its decoder. This is for tools driving the codecs
+       directly, such as the codecbench sample.
+      */
+    static void GetCodecDefinitions(
+      std::vector<const PluginCodec_Definition *> & codecs
+    );
+
     virtual void OnShutdown();
 
     static void Bootstrap();
@@ -0,0 +1,247 @@
+/*
+ * h323procgroup.h
+ *
+ * Endpoint processes sharing one gatekeeper registration
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+
+
+#ifndef __H323_PROCGROUP_H
+#define __H323_PROCGROUP_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include "openh323buildopts.h"
+#include "gkclient.h"
+
+#include <map>
+
+class H323ProcessGatekeeper;
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**Relay letting several endpoint processes on one host appear to the
+   gatekeeper as the single endpoint of a coordinator process.
+
+   The coordinator registers with the real gatekeeper as usual and runs the
+   relay on a loopback RAS port. Each worker process shares the call
+   signalling port with H323EndPoint::SetSharedListeners(), so the kernel
+   spreads incoming calls across them, and uses the relay as its gatekeeper
+   with H323EndPoint::UseGatekeeper(). The workers need nothing else, their
+   H323Gatekeeper is unchanged.
+
+   The relay answers the GRQ and RRQ of a worker itself, with the gatekeeper
+   and endpoint identifiers of the coordinator, and passes the ARQ, BRQ,
+   DRQ, LRQ and IRR of the workers on to the gatekeeper with sequence
+   numbers of the coordinator. Answers go back to the worker that asked,
+   and DRQ, BRQ and IRQ of the gatekeeper for a call go to the worker that
+   admitted it. A worker that stops sending its lightweight RRQ is taken
+   as gone, and its calls disengaged at the gatekeeper.
+
+   The requests are passed on with the H.235 tokens of the coordinator
+   instead of those of the worker, so the gatekeeper password is needed by
+   the coordinator only. An IRQ for all calls is answered by the coordinator,
+   without the calls of the workers.
+  */
+class H323ProcessRelay : public PObject
+{
+  PCLASSINFO(H323ProcessRelay, PObject);
+
+  public:
+    /**Create a relay for the coordinator endpoint.
+      */
+    H323ProcessRelay(
+      H323EndPoint & endpoint
+    );
+
+    /**Close the relay.
+      */
+    ~H323ProcessRelay();
+
+    /**Open the RAS port of the relay, 127.0.0.1 is used if the address
+       is for any interface. The workers are given this address for their gatekeeper.
+      */
+    PBoolean Open(
+      const H323TransportAddress & address
+    );
+
+    /**Close the port, forgetting the workers and their calls.
+      */
+    void Close();
+
+    /**Determine if the port is open.
+      */
+    PBoolean IsOpen() const { return readThread != NULL; }
+
+    /**Get the address of the relay for the workers.
+      */
+    H323TransportAddress GetAddress() const;
+
+    /**Set the time to live given to the workers in seconds, a worker not
+       heard from for twice as long is taken as gone. Default is 30.
+      */
+    void SetWorkerTimeToLive(
+      unsigned seconds
+    ) { workerTimeToLive = seconds; }
+
+    /**Get the number of workers registered.
+      */
+    PINDEX GetWorkerCount() const;
+
+    /**Get the number of calls of the workers admitted by the gatekeeper.
+      */
+    PINDEX GetCallCount() const;
+
+    /**Called by the gatekeeper of the coordinator as it is created or
+       deleted.
+      */
+    void SetGatekeeper(
+      H323ProcessGatekeeper * gatekeeper
+    );
+
+    /**Called by the gatekeeper of the coordinator with every PDU from the
+       gatekeeper. Returns TRUE if it was for a worker and has been passed on.
+      */
+    PBoolean OnGatekeeperPDU(
+      const H323RasPDU & pdu
+    );
+
+    /**Called as a worker registers for the first time.
+      */
+    virtual void OnWorkerRegistered(
+      const H323TransportAddress & worker
+    );
+
+    /**Called as a worker unregisters or is taken as gone, its calls have
+       been disengaged already.
+      */
+    virtual void OnWorkerRemoved(
+      const H323TransportAddress & worker
+    );
+
+  protected:
+    struct Worker {
+      Worker() : port(0), lastSeen(0) { }
+      PIPSocket::Address address;
+      WORD               port;
+      PInt64             lastSeen;      ///< Microseconds
+    };
+
+    struct Call {
+      Call() : callReference(0), answerCall(FALSE) { }
+      PString                   worker;
+      H225_ConferenceIdentifier conferenceID;
+      H225_CallIdentifier       callIdentifier;
+      unsigned                  callReference;
+      PBoolean                  answerCall;
+    };
+
+    /// Request on its way, to the gatekeeper or to a worker
+    struct Pending {
+      Pending() : sequenceNumber(0), started(0) { }
+      PString  worker;          ///< Empty if no one waits for the answer
+      PString  call;            ///< Call admitted by an ARQ
+      unsigned sequenceNumber;  ///< As the sender numbered it
+      PInt64   started;         ///< Microseconds
+    };
+
+    PDECLARE_NOTIFIER(PThread, H323ProcessRelay, ReadMain);
+    PDECLARE_NOTIFIER(PTimer, H323ProcessRelay, Supervise);
+
+    void OnWorkerPDU(H323RasPDU & pdu, const PIPSocket::Address & address, WORD port);
+    void OnWorkerRequest(H323RasPDU & pdu, const PString & worker);
+    PBoolean OnWorkerResponse(H323RasPDU & pdu);
+    void RemoveWorker(const PString & worker);
+    void Disengage(const Call & call);
+    PBoolean SendTo(H323RasPDU & pdu, const PIPSocket::Address & address, WORD port);
+    PBoolean SendToWorker(H323RasPDU & pdu, const PString & worker);
+
+    static PString GetCallKey(const H225_CallIdentifier & id);
+    static PASN_Integer * GetSequenceNumber(H323RasPDU & pdu);
+
+    H323EndPoint          & endpoint;
+    H323ProcessGatekeeper * gatekeeper;
+    unsigned                workerTimeToLive;
+
+    PUDPSocket   socket;
+    PThread    * readThread;
+    PTimer       supervisor;
+    unsigned     nextSequenceNumber;
+    volatile PBoolean shutdown;
+
+    mutable PMutex mutex;
+    std::map<PString, Worker>    workers;     ///< By worker address
+    std::map<PString, Call>      calls;       ///< By call identifier
+    std::map<unsigned, Pending>  toGatekeeper;  ///< By sequence number of the coordinator
+    std::map<unsigned, Pending>  toWorker;      ///< By sequence number of the relay
+};
+
+
+/**Gatekeeper client of the coordinator, handing the PDUs for the workers
+   to the H323ProcessRelay. Created by H323EndPoint::CreateGatekeeper()
+   once H323EndPoint::SetProcessRelay() has been called.
+  */
+class H323ProcessGatekeeper : public H323Gatekeeper
+{
+  PCLASSINFO(H323ProcessGatekeeper, H323Gatekeeper);
+
+  public:
+    H323ProcessGatekeeper(
+      H323EndPoint & endpoint,
+      H323Transport * transport,
+      H323ProcessRelay & relay
+    );
+
+    ~H323ProcessGatekeeper();
+
+    virtual PBoolean HandleTransaction(
+      const PASN_Object & rawPDU
+    );
+
+    /**Allocate a sequence number for a request passed on.
+      */
+    unsigned AllocateSequenceNumber() { return GetNextSequenceNumber(); }
+
+    /**Send a request or response of a worker to the gatekeeper, with the
+       endpoint identifier and H.235 tokens of the coordinator.
+      */
+    PBoolean ForwardPDU(
+      H323RasPDU & pdu
+    );
+
+  protected:
+    H323ProcessRelay & relay;
+};
+
+
+#endif // __H323_PROCGROUP_H
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,214 @@
+/*
+ * h323resolver.h
+ *
+ * Caching DNS resolver for call parties
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+
+#ifndef __H323RESOLVER_H
+#define __H323RESOLVER_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include "openh323buildopts.h"
+
+#if P_DNS
+
+#include <map>
+#include <list>
+#include <vector>
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**Endpoint wide resolver of the ENUM, SRV and MX lookups made to find a
+   call party. Each answer is cached, found or not, so a call to a domain or
+   E.164 number dialled before is resolved from memory instead of waiting on
+   the DNS server. Answers that were found are kept for the positive cache
+   time and answers that were not for the shorter negative cache time.
+
+   A lookup of a query already in flight waits for that query rather than
+   sending another. StartLookup() queues a query for a pool of worker
+   threads and calls a notifier with the answer, so queries started
+   together are sent in parallel and the caller need not wait. A cached
+   answer that is asked for again in the last quarter of its time is looked
+   up again in the background, so hot entries are renewed before they
+   expire.
+  */
+class H323DNSResolver : public PObject
+{
+  PCLASSINFO(H323DNSResolver, PObject);
+
+  public:
+    enum QueryType {
+      ENUMQuery,      ///< E.164 number to URL, name is the number, service the ENUM service
+      SRVQuery,       ///< URL to SRV targets, service the SRV prefix eg "_h323cs._tcp."
+      MXQuery,        ///< Domain to mail exchanger addresses, service unused
+      NumQueryTypes
+    };
+
+  /**@name Construction */
+  //@{
+    /**Create the resolver. No worker is started until the first
+       StartLookup().
+      */
+    H323DNSResolver(
+      const PTimeInterval & cacheTime,          ///< Time an answer found is kept
+      const PTimeInterval & negativeCacheTime,  ///< Time an answer not found is kept
+      PINDEX maxWorkers = 4                     ///< Queries sent at once by StartLookup()
+    );
+
+    /**Stop the workers. Queued queries are completed as not found.
+      */
+    ~H323DNSResolver();
+  //@}
+
+    /**A query started by StartLookup().
+      */
+    class Query : public PObject
+    {
+        PCLASSINFO(Query, PObject);
+      public:
+        QueryType   type;
+        PString     name;
+        PString     service;
+        PNotifier   notifier;
+        PStringList results;
+        PBoolean    found;
+    };
+
+  /**@name Operations */
+  //@{
+    /**Look up a query, from the cache if it was answered within the cache
+       time, otherwise waiting for the DNS server or for the same query in
+       flight.
+      */
+    PBoolean Lookup(
+      QueryType type,                 ///< Type of lookup
+      const PString & name,           ///< Number, URL or domain to look up
+      const PString & service,        ///< ENUM service or SRV prefix
+      PStringList & results           ///< Returned answers
+    );
+
+    /**Look up a query without waiting for the answer.
+       The notifier is called with the Query and INT extra TRUE if found, on
+       a worker thread or, for a cached answer, before this returns. The
+       Query is deleted after the notifier.
+      */
+    void StartLookup(
+      QueryType type,                 ///< Type of lookup
+      const PString & name,           ///< Number, URL or domain to look up
+      const PString & service,        ///< ENUM service or SRV prefix
+      const PNotifier & notifier      ///< Called with the answer
+    );
+
+    /**Remove every cached answer, for example when the DNS servers change.
+      */
+    void InvalidateAll();
+
+    /**Set the time answers found and not found are kept, zero for
+       either turns that part of the cache off.
+      */
+    void SetCacheTime(
+      const PTimeInterval & cacheTime,
+      const PTimeInterval & negativeCacheTime
+    );
+
+    /**Get the time an answer found is kept.
+      */
+    const PTimeInterval & GetCacheTime() const { return cacheTime; }
+
+    /**Get the time an answer not found is kept.
+      */
+    const PTimeInterval & GetNegativeCacheTime() const { return negativeCacheTime; }
+
+    /**Get the number of lookups answered from the cache.
+      */
+    PUInt64 GetCacheHits() const { return cacheHits; }
+
+    /**Get the number of lookups sent to the DNS server.
+      */
+    PUInt64 GetCacheMisses() const { return cacheMisses; }
+
+    /**Get the number of cached answers looked up again before they expired.
+      */
+    PUInt64 GetPrefetches() const { return prefetches; }
+  //@}
+
+  protected:
+    struct CacheEntry {
+      PStringList results;
+      PBoolean    found;
+      PInt64      expires;        ///< PTimer::Tick() milliseconds
+      PInt64      refreshTime;    ///< Looked up again if asked for after this
+      unsigned    hits;
+    };
+    typedef std::map<PString, CacheEntry> CacheMap;
+
+    // Queries in flight and the lookups waiting on each
+    typedef std::map<PString, std::list<Query *> > PendingMap;
+
+    struct Job {
+      QueryType type;
+      PString   name;
+      PString   service;
+    };
+
+    static PString MakeKey(QueryType type, const PString & name, const PString & service);
+    PBoolean FindCached(const PString & key, const Job & job, PStringList & results, PBoolean & found);
+    void Queue(const Job & job);
+    PBoolean Resolve(const Job & job, PStringList & results);
+    void Complete(const PString & key, PBoolean found, const PStringList & results);
+    PDECLARE_NOTIFIER(PThread, H323DNSResolver, WorkerMain);
+
+    PTimeInterval cacheTime;
+    PTimeInterval negativeCacheTime;
+    PINDEX        maxWorkers;
+
+    CacheMap      cache;
+    PendingMap    pending;
+    std::list<Job> queue;
+    PUInt64       cacheHits;
+    PUInt64       cacheMisses;
+    PUInt64       prefetches;
+
+    std::vector<PThread *> workers;
+    PINDEX        idleWorkers;
+    PBoolean      stopping;
+    PMutex        mutex;
+    PSemaphore    queued;
+};
+
+
+#endif // P_DNS
+
+#endif // __H323RESOLVER_H
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,171 @@
+/*
+ * h323sigpool.h
+ *
+ * Pool of connected signalling transports to frequent peers
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+
+#ifndef __H323SIGPOOL_H
+#define __H323SIGPOOL_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include "openh323buildopts.h"
+#include "transports.h"
+
+#include <list>
+#include <vector>
+
+class H323EndPoint;
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**Endpoint wide pool of signalling transports kept connected to configured
+   peers, such as a core softswitch most calls go to. A call made direct to
+   a peer takes a transport from the pool that has already made its TCP
+   connection, and its TLS handshake for a TLS address, so the Setup goes
+   out without waiting for either.
+
+   A thread connects transports in the background to keep each peer at its
+   pool size, and replaces them once they have been idle for the idle time
+   so the peer does not drop them first. A transport the peer has since
+   closed is noticed as readable when taken and is not used.
+  */
+class H323SignallingPool : public PObject
+{
+  PCLASSINFO(H323SignallingPool, PObject);
+
+  public:
+  /**@name Construction */
+  //@{
+    /**Create the pool, with no peers.
+      */
+    H323SignallingPool(
+      H323EndPoint & endpoint             ///< Endpoint creating the transports
+    );
+
+    /**Stop the thread and close every pooled transport.
+      */
+    ~H323SignallingPool();
+  //@}
+
+  /**@name Operations */
+  //@{
+    /**Keep transports connected to a peer, or change how many are kept.
+      */
+    void AddPeer(
+      const H323TransportAddress & address, ///< Call signalling address of the peer
+      PINDEX size = 1                       ///< Transports kept connected
+    );
+
+    /**Stop keeping transports to a peer, closing those kept.
+      */
+    void RemovePeer(
+      const H323TransportAddress & address  ///< Call signalling address of the peer
+    );
+
+    /**Take a connected transport to an address, NULL if the address is not
+       a peer or none is ready. The pool connects another in its place.
+      */
+    H323Transport * Acquire(
+      const H323TransportAddress & address  ///< Address being called
+    );
+
+    /**Set the time a transport is kept unused before it is replaced.
+       The default is 20 seconds.
+      */
+    void SetIdleTime(
+      const PTimeInterval & idle
+    ) { idleTime = idle; }
+
+    /**Get the time a transport is kept unused.
+      */
+    const PTimeInterval & GetIdleTime() const { return idleTime; }
+
+    /**Get the number of calls given a connected transport.
+      */
+    PUInt64 GetHits() const { return hits; }
+
+    /**Get the number of calls to a peer that found none ready.
+      */
+    PUInt64 GetMisses() const { return misses; }
+  //@}
+
+    /**Check whether an idle connected transport has been closed by the
+       peer, or has data on it that nothing asked for.
+      */
+    static PBoolean IsStale(
+      H323Transport & transport
+    );
+
+  protected:
+    /**Create a transport to a peer and connect it, NULL on failure.
+      */
+    virtual H323Transport * CreateTransport(
+      const H323TransportAddress & address
+    );
+
+    class Thread;
+    friend class Thread;
+
+    struct Warm {
+      H323Transport * transport;
+      PInt64          connected;      ///< Tick the transport connected
+    };
+
+    struct Peer {
+      H323TransportAddress address;
+      PINDEX               size;
+      PINDEX               connecting;
+      PInt64               retryTime;  ///< Tick before which no connect is tried
+      std::list<Warm>      warm;
+    };
+    typedef std::list<Peer> PeerList;
+
+    PeerList::iterator FindPeer(const H323TransportAddress & address);
+    void Main();
+
+    H323EndPoint & endpoint;
+    PTimeInterval  idleTime;
+    PeerList       peers;
+    PUInt64        hits;
+    PUInt64        misses;
+    PBoolean       shutdown;
+
+    PMutex         mutex;
+    PSyncPoint     wakeUp;
+    Thread       * thread;
+};
+
+
+#endif // __H323SIGPOOL_H
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,245 @@
+/*
+ * h323simulcast.h
+ *
+ * Simulcast of one captured video at several sizes and bit rates
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+
+#ifndef __H323_SIMULCAST_H
+#define __H323_SIMULCAST_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include "openh323buildopts.h"
+
+#ifdef H323_VIDEO
+
+#include "h323videoconv.h"
+#include <rtp.h>
+
+#include <deque>
+#include <vector>
+
+class H323VideoCodec;
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**A receiving leg of a simulcast, kept by the video encoder of the leg,
+   see H323VideoCodec::SetSimulcastLayer().
+  */
+class H323SimulcastReceiver
+{
+  public:
+    H323SimulcastReceiver();
+
+    /**Get the layer sent to the leg, P_MAX_INDEX if none.
+      */
+    PINDEX GetLayer() const { return layer; }
+
+  protected:
+    PINDEX     layer;
+    unsigned   maxTemporalId;
+    PUInt64    frameNumber;   ///< Last picture of the layer sent or skipped
+    PINDEX     packetIndex;   ///< Packets of it sent, zero once all are
+    PBoolean   waitIntra;     ///< Pictures skipped until an intra frame
+    PSyncPoint newFrame;
+
+  friend class H323VideoSimulcast;
+};
+
+
+/**One captured video encoded at several sizes and bit rates, the layers,
+   for the legs of a conference that each receive one of them. An MCU
+   gives each picture to Encode() once, the picture is scaled once to the
+   size of each layer by a H323VideoScaler and encoded once for each layer
+   that a leg receives. The video encoder of each leg then sends the
+   packets of its layer instead of encoding, see
+   H323VideoCodec::SetSimulcastLayer(), and a leg can be moved to another
+   layer, say when its bandwidth changes, without an encoder being opened.
+
+   With an H.264 SVC plugin encoding temporal layers, a leg can also be
+   given the highest temporal layer it is sent. The pictures of the layers
+   above it are dropped for that leg, which halves or quarters its frame
+   rate without encoding again. The temporal layer of a picture is taken
+   from the SVC NAL unit header extension of its packets, pictures
+   without one are in the base layer.
+
+   Each leg sends the pictures of its layer in order. A leg that falls
+   more than a few pictures behind skips to the next intra frame, which is
+   asked for, as it is for a leg starting on a layer.
+  */
+class H323VideoSimulcast : public PObject
+{
+  PCLASSINFO(H323VideoSimulcast, PObject);
+
+  public:
+    /**Create a simulcast taking the scaled pictures from a pool.
+      */
+    H323VideoSimulcast(
+      H323VideoFramePool & pool = H323VideoFramePool::GetDecoderPool()
+    );
+
+    /**Delete the encoders of the layers. The legs must have stopped
+       sending the layers.
+      */
+    ~H323VideoSimulcast();
+
+    /**Add a layer encoded by an encoder of the simulcast, made with
+       H323Capability::CreateCodec() for the Encoder direction and not
+       opened. The encoder is deleted with the simulcast. Layers are added
+       before Encode() is first called. Returns the index of the layer,
+       P_MAX_INDEX if the size is odd.
+      */
+    PINDEX AddLayer(
+      H323VideoCodec * encoder,   ///< Encoder of the layer
+      unsigned width,             ///< Width in pixels, even
+      unsigned height,            ///< Height in pixels, even
+      unsigned bitRate = 0        ///< Bit rate in bps, zero as the encoder is
+    );
+
+    /**Get the number of layers.
+      */
+    PINDEX GetLayerCount() const;
+
+    /**Get the size of a layer. Returns FALSE if there is no such layer.
+      */
+    PBoolean GetLayerSize(
+      PINDEX layer,               ///< Layer index
+      unsigned & width,           ///< Width in pixels
+      unsigned & height           ///< Height in pixels
+    ) const;
+
+    /**Encode a captured YUV420P picture on every layer a leg receives.
+      */
+    PBoolean Encode(
+      const H323VideoFrameRef & picture   ///< Picture to encode
+    );
+
+    /**Encode a captured YUV420P picture, copied into a buffer of the pool.
+      */
+    PBoolean Encode(
+      const BYTE * picture,       ///< Picture to encode
+      unsigned width,             ///< Width in pixels
+      unsigned height,            ///< Height in pixels
+      DWORD timestamp = 0         ///< RTP timestamp of the picture
+    );
+
+    /**Start a leg receiving a layer, or move it to another. It is sent the
+       pictures from the next intra frame on.
+      */
+    PBoolean Attach(
+      H323SimulcastReceiver & receiver,   ///< Receiving leg
+      PINDEX layer,                       ///< Layer to send it
+      unsigned maxTemporalId              ///< Highest temporal layer sent
+    );
+
+    /**Stop a leg receiving.
+      */
+    void Detach(
+      H323SimulcastReceiver & receiver    ///< Receiving leg
+    );
+
+    /**Read the next packet of the layer a leg receives, with its RTP
+       header, waiting for a picture to be encoded if the last one has been
+       sent. If none is within the timeout length is zero. Returns FALSE if
+       the leg is not receiving.
+      */
+    PBoolean ReadPacket(
+      H323SimulcastReceiver & receiver,   ///< Receiving leg
+      RTP_DataFrame & dst,                ///< Packet read
+      unsigned & length,                  ///< Length of its payload
+      const PTimeInterval & timeout       ///< Longest time to wait
+    );
+
+    /**Ask for an intra frame on the layer a leg receives, for a fast
+       update request of the leg.
+      */
+    void RequestIntra(
+      H323SimulcastReceiver & receiver    ///< Receiving leg
+    );
+
+    /**Get the scaler of the pictures, to select its kernel.
+      */
+    H323VideoScaler & GetScaler() { return scaler; }
+
+    /**Get the temporal layer of an H.264 SVC RTP payload, from the NAL
+       unit header extension of a prefix NAL unit, coded slice extension
+       or PACSI NAL unit, also at the start of a STAP-A or a starting
+       FU-A. Returns -1 if there is none.
+      */
+    static int GetH264TemporalId(
+      const BYTE * payload,       ///< RTP payload
+      PINDEX size                 ///< Size of the payload
+    );
+
+  protected:
+    struct Frame {
+      PUInt64  number;
+      PBoolean intra;
+      unsigned temporalId;
+      std::vector<PBYTEArray> packets;   ///< RTP packets, header included
+    };
+
+    struct Layer {
+      H323VideoCodec * encoder;
+      unsigned         width;
+      unsigned         height;
+      PBoolean         svc;              ///< H.264, may have temporal layers
+      PBoolean         intraRequested;
+      PUInt64          frameCount;
+      std::deque<Frame> frames;          ///< Last pictures encoded, oldest first
+      std::vector<H323SimulcastReceiver *> receivers;
+    };
+
+    const Frame * FindFrame(
+      Layer & layer,
+      H323SimulcastReceiver & receiver
+    );
+    void RemoveReceiver(
+      H323SimulcastReceiver & receiver
+    );
+    unsigned GetTemporalId(
+      const Frame & frame
+    ) const;
+
+    H323VideoFramePool & pool;
+    H323VideoScaler      scaler;
+    std::vector<Layer>   layers;
+    mutable PMutex       mutex;          ///< Layers and receivers
+    PMutex               encodeMutex;    ///< Encoders, one picture at a time
+};
+
+
+#endif // H323_VIDEO
+
+#endif // __H323_SIMULCAST_H
+
+
+/////////////////////////////////////////////////////////////////////////////
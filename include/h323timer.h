@@ -0,0 +1,231 @@
+/*
+ * h323timer.h
+ *
+ * Timer wheel service for signalling and media timers
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+
+
+#ifndef __H323TIMER_H
+#define __H323TIMER_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+
+class H323TimerService;
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**Timer run by the H323TimerService.
+   This is used in place of a PTimer by the per call objects of the library,
+   the H.245 negotiators, RFC 2833 handlers and keep alive threads, so that
+   thousands of calls do not put tens of thousands of timers on the PTLib
+   timer list.
+
+   The interface follows PTimer: assigning an interval starts a one shot
+   timer, assigning zero or calling Stop() cancels it, and the notifier is
+   called from the timer service thread when the timer expires. The
+   notifier is called with the H323Timer as its first parameter.
+  */
+class H323Timer : public PObject
+{
+  PCLASSINFO(H323Timer, PObject);
+
+  public:
+  /**@name Construction */
+  //@{
+    /**Create a stopped timer on the process wide timer service.
+      */
+    H323Timer();
+
+    /**Stop the timer, waiting for a notifier call in progress to return.
+      */
+    ~H323Timer();
+  //@}
+
+  /**@name Operations */
+  //@{
+    /**Start a one shot timer, zero stops the timer.
+      */
+    H323Timer & operator=(
+      DWORD milliseconds      ///< Time until the timer expires
+    );
+
+    /**Start a one shot timer, zero stops the timer.
+      */
+    H323Timer & operator=(
+      const PTimeInterval & interval  ///< Time until the timer expires
+    );
+
+    /**Start a timer that expires every interval until stopped.
+      */
+    void RunContinuous(
+      const PTimeInterval & interval  ///< Time between expiries
+    );
+
+    /**Stop the timer.
+       If wait is TRUE and the notifier is being called on another thread
+       this waits for it to return. The wait is skipped when called from
+       the notifier itself. Unlike PTimer the default is not to wait, as
+       the timers are mostly stopped holding the mutex their notifier takes.
+      */
+    void Stop(
+      PBoolean wait = FALSE   ///< Wait for a notifier call in progress
+    );
+
+    /**Determine if the timer is running.
+      */
+    PBoolean IsRunning() const;
+
+    /**Get the interval the timer was last started with.
+      */
+    PTimeInterval GetResetTime() const { return PTimeInterval(resetTime); }
+
+    /**Get the time remaining until the timer expires, zero if stopped.
+      */
+    PTimeInterval GetRemaining() const;
+
+    /**Set the function called when the timer expires.
+      */
+    void SetNotifier(
+      const PNotifier & func  ///< New notifier
+    ) { notifier = func; }
+
+    /**Get the function called when the timer expires.
+      */
+    const PNotifier & GetNotifier() const { return notifier; }
+  //@}
+
+  protected:
+    void Start(PInt64 milliseconds, PBoolean continuous);
+
+    H323TimerService & service;
+    PNotifier notifier;
+    PInt64    resetTime;   ///< Interval in milliseconds
+    PBoolean  continuous;
+    PInt64    expiry;      ///< Absolute tick of expiry
+
+    // Timer wheel linkage, protected by the service mutex
+    H323Timer * next;
+    H323Timer * prev;
+    H323Timer ** slot;
+
+  private:
+    H323Timer(const H323Timer &);
+    H323Timer & operator=(const H323Timer &);
+
+  friend class H323TimerService;
+};
+
+
+/**Timer service shared by all H323Timer instances.
+   Pending timers are kept in a three level hierarchical timer wheel with
+   one millisecond resolution, serviced by a single thread, so starting and
+   stopping a timer costs the same however many timers there are, and the
+   thread only walks the timers that are due.
+
+   There is one service per process, created on first use and available
+   from H323EndPoint::GetTimerService().
+  */
+class H323TimerService : public PObject
+{
+  PCLASSINFO(H323TimerService, PObject);
+
+  public:
+  /**@name Construction */
+  //@{
+    /**Create the service and start its thread.
+      */
+    H323TimerService(
+      PThread::Priority priority = PThread::HighPriority ///< Priority of the thread
+    );
+
+    /**Stop the service thread.
+       Any timers still pending are left stopped.
+      */
+    ~H323TimerService();
+
+    /**Get the process wide timer service.
+      */
+    static H323TimerService & Current();
+  //@}
+
+  /**@name Operations */
+  //@{
+    /**Get the number of timers running.
+      */
+    PINDEX GetPendingCount() const { return pendingCount; }
+
+    /**Get the total number of timer expiries.
+      */
+    PInt64 GetExpiryCount() const { return expiryCount; }
+  //@}
+
+  protected:
+    class Thread;
+    friend class Thread;
+    friend class H323Timer;
+
+    void Start(H323Timer & timer, PInt64 milliseconds, PBoolean continuous);
+    void Stop(H323Timer & timer, PBoolean wait);
+    void Insert(H323Timer & timer);
+    void Unlink(H323Timer & timer);
+    void Cascade(H323Timer ** slot);
+    void Advance(PInt64 now);
+    PInt64 GetNextExpiry() const;
+    void Main();
+
+    enum {
+      WheelBits  = 8,
+      WheelSlots = 1 << WheelBits,
+      WheelLevels = 3
+    };
+
+    H323Timer * wheel[WheelLevels][WheelSlots];
+    H323Timer * expired;
+    H323Timer * firing;
+    PInt64   currentTick;
+    PInt64   nextWake;
+    PINDEX   pendingCount;
+    PInt64   expiryCount;
+    PINDEX   stopWaiters;
+    PBoolean shutdown;
+
+    PMutex     mutex;
+    PSyncPoint wakeUp;
+    PSemaphore firingDone;
+    Thread   * thread;
+};
+
+
+#endif // __H323TIMER_H
+
+
+/////////////////////////////////////////////////////////////////////////////
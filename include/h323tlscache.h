@@ -0,0 +1,148 @@
+/*
+ * h323tlscache.h
+ *
+ * Cache of TLS sessions for resuming signalling handshakes
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+
+
+#ifndef __H323TLSCACHE_H
+#define __H323TLSCACHE_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include "openh323buildopts.h"
+
+#ifdef H323_TLS
+
+#include <map>
+
+typedef struct ssl_st SSL;
+typedef struct ssl_ctx_st SSL_CTX;
+typedef struct ssl_session_st SSL_SESSION;
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**Endpoint wide cache of the TLS sessions peers have given the endpoint,
+   kept by peer address. A signalling connection to a peer called before
+   offers the last session from that peer, a session ID for TLS 1.2 and a
+   ticket for TLS 1.3, so the handshake is resumed without the certificate
+   exchange and key agreement of a full handshake.
+
+   Sessions are stored as the peer issues them, including the tickets a
+   TLS 1.3 server sends after the handshake. A session the peer would not
+   resume is replaced by the one of the full handshake, and a failed
+   handshake drops the peer's session so the next call does not offer it.
+  */
+class H323TLSSessionCache : public PObject
+{
+  PCLASSINFO(H323TLSSessionCache, PObject);
+
+  public:
+  /**@name Construction */
+  //@{
+    /**Create an empty cache.
+      */
+    H323TLSSessionCache(
+      PINDEX maxPeers = 256           ///< Peers whose sessions are kept
+    );
+
+    /**Free every session kept.
+      */
+    ~H323TLSSessionCache();
+  //@}
+
+  /**@name Operations */
+  //@{
+    /**Set up a context to issue, resume and store sessions, for both the
+       server and the client side. Called as the context is created.
+      */
+    static void ConfigureContext(
+      SSL_CTX * context,              ///< Context of the endpoint
+      const PTimeInterval & lifetime  ///< Time an issued session may be resumed
+    );
+
+    /**Offer the session kept for a peer, if any, before a client handshake,
+       and have sessions the peer issues on the connection stored for it.
+      */
+    void PrepareClient(
+      SSL * ssl,                      ///< Connection about to handshake
+      const PString & peer            ///< Address of the peer
+    );
+
+    /**Note the outcome of a client handshake prepared by PrepareClient().
+      */
+    void OnClientHandshake(
+      SSL * ssl,                      ///< Connection that handshook
+      PBoolean ok                     ///< Handshake succeeded
+    );
+
+    /**Drop the session kept for a peer.
+      */
+    void Remove(
+      const PString & peer
+    );
+
+    /**Drop every session kept, for example when the certificates change.
+      */
+    void RemoveAll();
+
+    /**Get the number of client handshakes that offered a kept session.
+      */
+    PUInt64 GetOffered() const { return offered; }
+
+    /**Get the number of client handshakes the peer resumed.
+      */
+    PUInt64 GetResumed() const { return resumed; }
+  //@}
+
+  protected:
+    class Peer;
+
+    void Store(const PString & peer, SSL_SESSION * session);
+    static Peer * GetPeer(SSL * ssl);
+    static int OnNewSession(SSL * ssl, SSL_SESSION * session);
+
+    typedef std::map<PString, SSL_SESSION *> SessionMap;
+
+    PINDEX     maxPeers;
+    SessionMap sessions;
+    PUInt64    offered;
+    PUInt64    resumed;
+    PMutex     mutex;
+};
+
+
+#endif // H323_TLS
+
+#endif // __H323TLSCACHE_H
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -38,6 +38,14 @@
 #include "h235auth.h"
 
 #include <ptclib/asner.h>
+#include "h323perstream.h"
+
+#include <deque>
+#include <map>
+#include <vector>
+
+
+class H323Transaction;
 
 
 class H323TransactionPDU {
@@ -63,6 +71,11 @@ class H323TransactionPDU {
     virtual void DeletePDU() = 0;
 
     const H235Authenticators & GetAuthenticators() const { return authenticators; }
+
+    /**Get the bytes the PDU was read from, empty if it was not read.
+      */
+    const PBYTEArray & GetRawPDU() const { return rawPDU; }
+
     void SetAuthenticators(
       const H235Authenticators & auth
     ) { authenticators = auth; }
@@ -83,7 +96,7 @@ class H323TransactionPDU {
 
   protected:
     H235Authenticators authenticators;
-    PPER_Stream        rawPDU;
+    H323_PERStream     rawPDU;
 };
 
 
@@ -114,6 +127,25 @@ class H323Transactor : public PObject
     /**Destroy protocol handler.
      */
     ~H323Transactor();
+
+    /**Priority of a received request when the worker threads cannot keep
+       up, see SetOverloadLimit().
+      */
+    enum RequestPriority {
+      LowPriority,        ///<  Discovery, such as GRQ
+      NormalPriority,     ///<  New registrations, such as a full RRQ
+      HighPriority,       ///<  Refreshed registrations, such as a lightweight RRQ
+      UrgentPriority,     ///<  Calls in progress, such as ARQ and DRQ
+      NumPriorities
+    };
+
+    /**Worker a received request is queued for, see SetWorkerThreads().
+      */
+    enum RequestQueue {
+      OrderedQueue,       ///<  Worker of the address, in order with its other requests
+      ConcurrentQueue,    ///<  Least busy worker, such as a route lookup
+      BackgroundQueue     ///<  Background worker, such as a bulk table update
+    };
   //@}
 
   /**@name Overrides from PObject */
@@ -200,6 +232,96 @@ class H323Transactor : public PObject
     /**Get flag to check all crypto tokens on responses.
       */
     PBoolean GetCheckResponseCryptoTokens() { return checkResponseCryptoTokens; }
+
+    /**Set the number of worker threads handling received requests.
+       When non-zero the read thread only decodes each request and creates
+       its transaction, which is then handled by one of the workers.
+       Requests from the same address always go to the same worker so they
+       are handled in order. A value of zero (the default) handles requests
+       on the read thread. This must be set before the channel is started.
+
+       A request may instead be queued for the least busy worker, when its
+       order with other requests does not matter, or for a background
+       worker of low thread priority started on the first such request,
+       so a slow bulk request does not hold up the quick ones behind it.
+       See H323Transaction::GetQueue().
+      */
+    void SetWorkerThreads(
+      PINDEX count    ///<  Number of worker threads, zero disables
+    ) { workerThreads = count; }
+
+    /**Get the number of worker threads handling received requests.
+      */
+    PINDEX GetWorkerThreads() const { return workerThreads; }
+
+    /**Set the overload control of the worker threads. Requests are queued
+       for the workers by priority, so calls in progress are handled before
+       new registrations during a registration storm. Once the limit of
+       queued requests is reached the oldest request of a lower priority is
+       turned away, with a reject the remote may back off on, or if there
+       is none the new request is. Requests queued long enough that the
+       remote would retry are sent a RequestInProgress with the expected
+       wait.
+
+       This only applies with worker threads. A limit of zero, the default,
+       queues every request.
+      */
+    void SetOverloadLimit(
+      PINDEX limit,               ///<  Maximum requests queued, zero for no limit
+      const PTimeInterval & delayThreshold = PTimeInterval(1000)
+                                  ///<  Expected wait before sending a RequestInProgress
+    ) { overloadLimit = limit; ripThreshold = delayThreshold; }
+
+    /**Get the maximum number of requests queued for the worker threads.
+      */
+    PINDEX GetOverloadLimit() const { return overloadLimit; }
+
+    /**Get the number of requests waiting for a worker thread.
+      */
+    PINDEX GetQueuedRequests() const { return (PINDEX)queuedRequests; }
+
+    /**Get the number of requests turned away by overload control.
+      */
+    unsigned GetShedRequests() const { return shedRequests; }
+
+    /**Get the number of responses cached for retransmitted requests.
+      */
+    PINDEX GetResponseCacheSize() const { return responses.size(); }
+
+    /**Get the number of retransmitted requests answered from the cache.
+      */
+    unsigned GetResponseCacheHits() const { return responseCacheHits; }
+  //@}
+
+  /**@name Request handling */
+  //@{
+    /**Handle a transaction for a received request.
+       This is handled on a worker thread if there are any, otherwise
+       immediately. The transactor takes ownership of the transaction.
+      */
+    void HandleRequest(
+      H323Transaction * transaction
+    );
+
+    /**Write a response PDU to the addresses and cache it for requests that
+       are retried by the address the request came from.
+      */
+    PBoolean WriteResponse(
+      H323TransactionPDU & pdu,
+      const H323TransportAddressArray & addresses,
+      const H323TransportAddress & requestAddress
+    );
+
+    /**Write a response already encoded, such as one kept from an earlier
+       request, to the addresses and cache it as WriteResponse() above
+       does. OnSendingPDU() is not called, the data is sent as it is.
+      */
+    PBoolean WriteResponse(
+      const PBYTEArray & data,
+      unsigned seqNum,
+      const H323TransportAddressArray & addresses,
+      const H323TransportAddress & requestAddress
+    );
   //@}
 	
     class Request : public PObject
@@ -245,6 +367,12 @@ class H323Transactor : public PObject
         } responseResult;
 
         PBoolean    useAlternate;
+
+        // Set for requests started by StartRequest()
+        PNotifier   completed;
+        PBoolean    asynchronous;
+        unsigned    retry;
+        PBoolean    cancelled;
     };
 
   protected:
@@ -261,6 +389,33 @@ class H323Transactor : public PObject
     virtual PBoolean MakeRequest(
       Request & request
     );
+
+    /**Send a request and return without waiting for its response.
+       The request is retried and timed out as MakeRequest() does, but by a
+       thread of the transactor, so any number may be in flight at once.
+       When a response arrives or the retries are exhausted the notifier is
+       called, on that thread, with the request and INT extra TRUE if it was
+       confirmed. The request must remain valid until then.
+       Returns FALSE, without calling the notifier, if it could not be sent.
+      */
+    virtual PBoolean StartRequest(
+      Request & request,
+      const PNotifier & completed
+    );
+    PBoolean WriteAsyncRequest(
+      Request & request
+    );
+
+    /**Stop waiting for the response to a request from StartRequest().
+       The notifier is still called, from the transactor thread, as if no
+       response was received.
+      */
+    void CancelRequest(
+      Request & request
+    );
+    void StopAsyncRequests();
+    PDECLARE_NOTIFIER(PThread, H323Transactor, HandleAsyncRequests);
+
     PBoolean CheckForResponse(
       unsigned,
       unsigned,
@@ -283,6 +438,10 @@ class H323Transactor : public PObject
       const H323TransactionPDU & pdu
     );
 
+    class Response;
+    typedef std::map<PString, Response *> ResponseMap;
+    typedef std::multimap<PInt64, Response *> ResponseExpiryMap;
+
     class Response : public PString
     {
         PCLASSINFO(Response, PString);
@@ -291,13 +450,24 @@ class H323Transactor : public PObject
         ~Response();
 
         void SetPDU(const H323TransactionPDU & pdu);
+        void SetData(const PBYTEArray & data);
         PBoolean SendCachedResponse(H323Transport & transport);
 
-        PTime                lastUsedTime;
+        PTimeInterval        lastUsedTime;  // PTimer::Tick() when last used
         PTimeInterval        retirementAge;
         H323TransactionPDU * replyPDU;
+        PBYTEArray           replyData;     // Encoded reply if no replyPDU
+        ResponseExpiryMap::iterator expiry;
     };
 
+    Response * FindResponse(
+      const H323TransportAddress & addr,
+      unsigned seqNum
+    );
+    void ScheduleResponseRetirement(
+      Response & response
+    );
+
     // Configuration variables
     H323EndPoint  & endpoint;
     WORD            defaultLocalPort;
@@ -313,7 +483,67 @@ class H323Transactor : public PObject
     Request                         * lastRequest;
 
     PMutex                pduWriteMutex;
-    PSortedList<Response> responses;
+    ResponseMap           responses;
+    ResponseExpiryMap     responseExpiry;
+    unsigned              responseCacheHits;
+
+    class Worker : public PObject
+    {
+        PCLASSINFO(Worker, PObject);
+      public:
+        Worker(H323Transactor & transactor, const PString & name, PThread::Priority priority);
+        ~Worker();
+
+        void Queue(H323Transaction * transaction, RequestPriority priority);
+
+        /**Get the number queued at the priority or higher.
+          */
+        PINDEX GetQueued(RequestPriority priority);
+
+        /**Remove the oldest transaction queued at the priority, if any.
+          */
+        H323Transaction * Take(RequestPriority priority);
+
+      protected:
+        PDECLARE_NOTIFIER(PThread, Worker, Main);
+
+        struct Queued {
+          H323Transaction * transaction;
+          PInt64            time;       // H323MediaClock microseconds
+        };
+
+        H323Transactor        & transactor;
+        PMutex                  mutex;
+        PSemaphore              available;
+        std::deque<Queued>      queues[NumPriorities];
+        PBoolean                stopping;
+        PThread               * thread;
+    };
+
+    void StopWorkers();
+    void OnRequestHandled(
+      PInt64 waited,
+      PInt64 handled
+    );
+    void ShedRequest(
+      H323Transaction * transaction
+    );
+
+    PINDEX        workerThreads;
+    PList<Worker> workers;
+    Worker      * backgroundWorker;
+
+    PINDEX          overloadLimit;
+    PTimeInterval   ripThreshold;
+    volatile PInt64 queuedRequests;
+    volatile PInt64 handleTime;       ///< Average microseconds to handle a request
+    unsigned        shedRequests;
+
+    std::vector<Request *> asyncRequests;   ///< Started by StartRequest()
+    PMutex                 asyncMutex;
+    PSyncPoint             asyncWakeUp;
+    PThread              * asyncThread;
+    PBoolean               asyncStopping;
 };
 
 
@@ -366,6 +596,36 @@ class H323Transaction : public PObject
       unsigned reasonCode
     ) = 0;
 
+    /**Get the priority of the request when the transactor is overloaded.
+       The default is normal priority.
+      */
+    virtual H323Transactor::RequestPriority GetPriority() const;
+
+    /**Get the worker the request is queued for with worker threads. The
+       default is the worker of the address it came from.
+      */
+    virtual H323Transactor::RequestQueue GetQueue() const;
+
+    /**Set the reply to a request turned away by overload control. The
+       default ignores it, so the remote retries as if it was lost.
+      */
+    virtual Response OnOverload();
+
+    /**Determine if a RequestInProgress may be sent while the request is
+       still queued, before it is handled. The default is CanSendRIP().
+      */
+    virtual PBoolean CanSendEarlyRIP() const;
+
+    /**Send a RequestInProgress for the request.
+      */
+    PBoolean SendRIP(
+      unsigned delay    ///<  Milliseconds the remote is to wait
+    );
+
+    /**Send the reply from OnOverload(), the transaction is not handled.
+      */
+    void HandleOverload();
+
     PBoolean IsFastResponseRequired() const { return fastResponseRequired && canSendRIP; }
     PBoolean CanSendRIP() const { return canSendRIP; }
     H323TransportAddress GetReplyAddress() const { return replyAddresses[0]; }
@@ -374,11 +634,14 @@ class H323Transaction : public PObject
     H323Transactor & GetTransactor() const { return transactor; }
     H235Authenticator::ValidationResult GetAuthenticatorResult() const { return authenticatorResult; }
 
+    const H323TransportAddress & GetRequestAddress() const { return requestAddress; }
+
   protected:
     virtual Response OnHandlePDU() = 0;
     PDECLARE_NOTIFIER(PThread, H323Transaction, SlowHandler);
 
     H323Transactor         & transactor;
+    H323TransportAddress      requestAddress;
     H323TransportAddressArray replyAddresses;
     PBoolean                     fastResponseRequired;
     H323TransactionPDU     * request;
@@ -483,9 +746,62 @@ class H323TransactionServer : public PObject
     );
 
     PBoolean SetUpCallSignalAddresses(H225_ArrayOf_TransportAddress & addresses);
+
+    /**Set the number of worker threads each listener added afterwards
+       uses to handle received requests, see H323Transactor::SetWorkerThreads().
+      */
+    void SetListenerWorkerThreads(
+      PINDEX count    ///<  Number of worker threads, zero disables
+    ) { listenerWorkerThreads = count; }
+
+    /**Get the number of worker threads for each listener.
+      */
+    PINDEX GetListenerWorkerThreads() const { return listenerWorkerThreads; }
+
+    /**Set the overload limit each listener added afterwards uses, see
+       H323Transactor::SetOverloadLimit().
+      */
+    void SetListenerOverloadLimit(
+      PINDEX limit    ///<  Maximum requests queued, zero for no limit
+    ) { listenerOverloadLimit = limit; }
+
+    /**Get the overload limit for each listener.
+      */
+    PINDEX GetListenerOverloadLimit() const { return listenerOverloadLimit; }
+
+    /**Set the number of sockets, each with its own listener, that share the
+       port of each interface added afterwards, so RAS is spread over that
+       many threads and cores. Needs SO_REUSEPORT, without it one socket is
+       used.
+      */
+    void SetListenerSockets(
+      PINDEX count    ///<  Sockets per interface, one or less for one
+    ) { listenerSockets = count; }
+
+    /**Get the number of sockets for each interface.
+      */
+    PINDEX GetListenerSockets() const { return listenerSockets; }
+
+    /**Set the number of datagrams each listener added afterwards reads in
+       one system call, see H323TransportUDP::SetReadBatchSize().
+      */
+    void SetListenerReadBatch(
+      PINDEX count    ///<  Maximum datagrams per read, one or less disables
+    ) { listenerReadBatch = count; }
+
+    /**Get the number of datagrams read at once by each listener.
+      */
+    PINDEX GetListenerReadBatch() const { return listenerReadBatch; }
   //@}
 
   protected:
+    /**Add the listeners on one port, as many as SetListenerSockets() gave.
+      */
+    PBoolean AddSharedListeners(
+      const PIPSocket::Address & addr,
+      WORD port
+    );
+
     H323EndPoint & ownerEndPoint;
 
     PThread      * monitorThread;
@@ -495,6 +811,10 @@ class H323TransactionServer : public PObject
     H323LIST(ListenerList, H323Transactor);
     ListenerList listeners;
     PBoolean usingAllInterfaces;
+    PINDEX listenerWorkerThreads;
+    PINDEX listenerOverloadLimit;
+    PINDEX listenerSockets;
+    PINDEX listenerReadBatch;
 };
 
 
@@ -0,0 +1,142 @@
+/*
+ * h323videoassembler.h
+ *
+ * Reordering and reassembly of received video pictures
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#ifndef __H323_VIDEOASSEMBLER_H
+#define __H323_VIDEOASSEMBLER_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include "openh323buildopts.h"
+#include "rtp.h"
+
+#ifdef H323_VIDEO
+
+#include <map>
+#include <deque>
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**Reassembly of the RTP packets of received video into whole pictures.
+   Packets are put back in sequence order and held until every packet of a
+   picture, up to the one with the marker bit, has arrived. The picture is
+   then given out in order, so the decoder only sees whole pictures.
+
+   A picture whose marker is lost is complete when the first packet of the
+   next picture arrives with no gap before it. A picture still missing a
+   packet when packets a window later have arrived is dropped whole, along
+   with any of its packets that arrive after, and counted for the caller to
+   ask for an intra frame. Packets arriving after their picture was given
+   out or dropped are discarded.
+
+   There is no timer, pictures move on as packets arrive. An assembler is
+   not thread safe, it belongs to the receive thread of one channel.
+  */
+class H323VideoAssembler : public PObject
+{
+  PCLASSINFO(H323VideoAssembler, PObject);
+
+  public:
+    /**Create an assembler waiting for missing packets until a window of
+       later packets has arrived.
+      */
+    H323VideoAssembler(
+      PINDEX window = 32    ///< Packets to wait for a missing one
+    );
+
+    /**Add a received packet, which is copied.
+      */
+    void Push(
+      const RTP_DataFrame & frame   ///< Received video packet
+    );
+
+    /**Get the next packet of a whole picture, in sequence order.
+       Returns FALSE if no whole picture is waiting.
+      */
+    PBoolean Pop(
+      RTP_DataFrame & frame   ///< Packet given out
+    );
+
+    /**Get and clear the number of pictures dropped since last called.
+      */
+    unsigned TakeDroppedPictures();
+
+    /**Drop everything held and start again from the next packet.
+      */
+    void Reset();
+
+    /**Get the number of whole pictures given out.
+      */
+    DWORD GetPicturesCompleted() const { return picturesCompleted; }
+
+    /**Get the number of pictures dropped as incomplete.
+      */
+    DWORD GetPicturesDropped() const { return picturesDropped; }
+
+    /**Get the number of packets that arrived out of order and were put back.
+      */
+    DWORD GetPacketsReordered() const { return packetsReordered; }
+
+    /**Get the number of packets discarded as too late or duplicated.
+      */
+    DWORD GetPacketsDiscarded() const { return packetsDiscarded; }
+
+    virtual void PrintOn(ostream & strm) const;
+
+  protected:
+    void Assemble();
+    void DropOldest();
+
+    typedef std::map<DWORD, RTP_DataFrame> PacketMap;   ///< By extended sequence number
+
+    PINDEX    window;
+    PacketMap packets;
+    std::deque<RTP_DataFrame> ready;
+    PBoolean  started;
+    DWORD     nextSequence;         ///< Extended sequence of the next packet to give out
+    PBoolean  discarding;           ///< Late packets of a dropped picture are discarded
+    DWORD     discardTimestamp;
+    unsigned  droppedSinceTaken;
+
+    DWORD     picturesCompleted;
+    DWORD     picturesDropped;
+    DWORD     packetsReordered;
+    DWORD     packetsDiscarded;
+};
+
+
+#endif // H323_VIDEO
+
+#endif // __H323_VIDEOASSEMBLER_H
+
+
+/////////////////////////////////////////////////////////////////////////////
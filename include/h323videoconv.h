@@ -0,0 +1,209 @@
+/*
+ * h323videoconv.h
+ *
+ * Colour conversion and scaling of video pictures
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#ifndef __H323_VIDEOCONV_H
+#define __H323_VIDEOCONV_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include "openh323buildopts.h"
+
+#ifdef H323_VIDEO
+
+#include "h323videoframe.h"
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**Convert pictures to YUV420P and scale YUV420P pictures.
+   The results are the same whatever the kernel, the vector kernels follow
+   the scalar code bit for bit.
+
+   Scaling is bilinear, with a box filter for an exact halving of both
+   sides. The vertical blend of two lines and the halving use AVX2 if the
+   processor has it and the compiler can target it, SSE2 on x86 builds
+   that allow it and NEON on ARM builds that have it. The horizontal
+   interpolation is always scalar. Conversion from YUY2 and 32 bit RGB uses
+   SSE2 or NEON, 24 bit RGB only NEON. Define H323_VIDEO_NO_SIMD to build
+   without the vector kernels.
+
+   All sizes must be even. A converter is not thread safe, each codec
+   instance has its own.
+  */
+class H323VideoConverter : public PObject
+{
+  PCLASSINFO(H323VideoConverter, PObject);
+
+  public:
+    enum Kernels {
+      ScalarKernel,
+      SSE2Kernel,
+      AVX2Kernel,     ///< AVX2 scaling, SSE2 conversion
+      NEONKernel,
+      NumKernels
+    };
+
+    /**Create a converter using the best kernel for the processor.
+      */
+    H323VideoConverter();
+
+    /**Convert a picture to YUV420P of the same size.
+       Returns FALSE if the format is not supported or a size is odd.
+      */
+    PBoolean Convert(
+      const PString & srcFormat,  ///< PTLib colour format of the source
+      const BYTE * src,           ///< Source picture
+      unsigned width,             ///< Width in pixels
+      unsigned height,            ///< Height in pixels
+      BYTE * dst                  ///< Buffer for width*height*3/2 bytes
+    );
+
+    /**Scale a YUV420P picture.
+       Returns FALSE if a size is zero or odd.
+      */
+    PBoolean Scale(
+      const BYTE * src,           ///< Source picture
+      unsigned srcWidth,          ///< Source width in pixels
+      unsigned srcHeight,         ///< Source height in pixels
+      BYTE * dst,                 ///< Buffer for dstWidth*dstHeight*3/2 bytes
+      unsigned dstWidth,          ///< Width to scale to
+      unsigned dstHeight          ///< Height to scale to
+    );
+
+    /**Indicate Convert() supports a colour format.
+      */
+    static PBoolean IsFormatSupported(
+      const PString & format
+    );
+
+    /**Get the kernel in use.
+      */
+    Kernels GetKernel() const { return kernel; }
+
+    /**Select the kernel to use, for example to compare them.
+       Returns FALSE if the kernel is not supported by this build or
+       processor.
+      */
+    PBoolean SetKernel(
+      Kernels kernel    ///< Kernel to use
+    );
+
+    /**Get the fastest kernel supported by this build and processor.
+      */
+    static Kernels GetBestKernel();
+
+    /**Indicate a kernel is supported by this build and processor.
+      */
+    static PBoolean IsKernelAvailable(
+      Kernels kernel    ///< Kernel to check
+    );
+
+    /**Get the name of a kernel.
+      */
+    static const char * GetKernelName(
+      Kernels kernel    ///< Kernel to name
+    );
+
+    struct KernelFunctions;
+
+  protected:
+    void ScalePlane(
+      const BYTE * src, unsigned srcWidth, unsigned srcHeight,
+      BYTE * dst, unsigned dstWidth, unsigned dstHeight
+    );
+
+    Kernels                 kernel;
+    const KernelFunctions * functions;
+    PBYTEArray              lineBuffer;   ///< Vertically blended source line
+};
+
+
+/**Scaling of a picture shared by several encoders.
+   An MCU sending one picture to encoders that each need their own size
+   asks the scaler for the picture at each size. The picture is scaled once
+   for each size, and every encoder wanting that size shares the result,
+   until a new picture is given.
+  */
+class H323VideoScaler : public PObject
+{
+  PCLASSINFO(H323VideoScaler, PObject);
+
+  public:
+    /**Create a scaler taking the scaled pictures from a pool.
+      */
+    H323VideoScaler(
+      H323VideoFramePool & pool = H323VideoFramePool::GetDecoderPool()
+    );
+
+    /**Get a picture at a size, scaling it if not done yet for the picture.
+       The source is returned if already the size, a NULL reference if it
+       cannot be scaled.
+      */
+    H323VideoFrameRef Scale(
+      const H323VideoFrameRef & source,   ///< Picture to scale
+      unsigned width,                     ///< Width wanted
+      unsigned height                     ///< Height wanted
+    );
+
+    /**Drop the picture and the scaled copies of it.
+      */
+    void Reset();
+
+    /**Get the converter doing the scaling, to select its kernel.
+      */
+    H323VideoConverter & GetConverter() { return converter; }
+
+    /**Get the number of pictures scaled.
+      */
+    PUInt64 GetScaledCount() const { return scaledCount; }
+
+    /**Get the number of requests met by a picture already scaled.
+      */
+    PUInt64 GetSharedCount() const { return sharedCount; }
+
+  protected:
+    H323VideoFramePool & pool;
+    H323VideoConverter   converter;
+    H323VideoFrameRef    source;
+    std::vector<H323VideoFrameRef> scaled;   ///< Copies of the source at each size
+    PUInt64              scaledCount;
+    PUInt64              sharedCount;
+    PMutex               mutex;
+};
+
+
+#endif // H323_VIDEO
+
+#endif // __H323_VIDEOCONV_H
+
+
+/////////////////////////////////////////////////////////////////////////////
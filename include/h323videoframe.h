@@ -0,0 +1,224 @@
+/*
+ * h323videoframe.h
+ *
+ * Pooled buffers of decoded video pictures
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#ifndef __H323_VIDEOFRAME_H
+#define __H323_VIDEOFRAME_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include "openh323buildopts.h"
+
+#ifdef H323_VIDEO
+
+#include <map>
+#include <vector>
+
+class H323VideoFramePool;
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**Buffer a video decoder writes a picture to, and the YUV420P picture in
+   it once decoded. Frames are only made by an H323VideoFramePool and are
+   reached through H323VideoFrameRef, the buffer goes back to the pool when
+   the last reference is dropped.
+  */
+class H323VideoFrame : public PObject
+{
+  PCLASSINFO(H323VideoFrame, PObject);
+
+  public:
+    /**Get the width of the picture in pixels.
+      */
+    unsigned GetWidth() const { return width; }
+
+    /**Get the height of the picture in pixels.
+      */
+    unsigned GetHeight() const { return height; }
+
+    /**Get the RTP timestamp of the media the picture was decoded from.
+      */
+    DWORD GetTimestamp() const { return timestamp; }
+
+    /**Get the YUV420P picture, the Y plane followed by the U and V planes.
+      */
+    const BYTE * GetData() const { return buffer + dataOffset; }
+
+    /**Get the bytes in the picture.
+      */
+    PINDEX GetDataSize() const { return (PINDEX)(width*height*3/2); }
+
+    /**Get the whole buffer for the decoder to write to.
+      */
+    BYTE * GetBuffer() { return buffer; }
+
+    /**Get the size of the whole buffer.
+      */
+    PINDEX GetBufferSize() const { return bufferSize; }
+
+    /**Set where the decoder put the picture in the buffer.
+      */
+    void SetPicture(
+      PINDEX offset,        ///< Offset of the picture in the buffer
+      unsigned width,       ///< Width in pixels
+      unsigned height,      ///< Height in pixels
+      DWORD timestamp       ///< RTP timestamp of the media
+    );
+
+  protected:
+    H323VideoFrame(H323VideoFramePool & pool, PINDEX size);
+    ~H323VideoFrame();
+
+    H323VideoFramePool & pool;
+    BYTE         * buffer;
+    PINDEX         bufferSize;
+    PINDEX         dataOffset;
+    unsigned       width;
+    unsigned       height;
+    DWORD          timestamp;
+    PAtomicInteger references;
+
+  private:
+    H323VideoFrame(const H323VideoFrame & other) : PObject(other), pool(other.pool) { }
+    H323VideoFrame & operator=(const H323VideoFrame &) { return *this; }
+
+  friend class H323VideoFramePool;
+  friend class H323VideoFrameRef;
+};
+
+
+/**Counted reference to a decoded picture.
+   Copying the reference shares the picture, so a recorder or transcoder
+   given a picture keeps it, without copying, for as long as it holds the
+   reference. The picture must not be changed while it is shared.
+  */
+class H323VideoFrameRef : public PObject
+{
+  PCLASSINFO(H323VideoFrameRef, PObject);
+
+  public:
+    H323VideoFrameRef() : frame(NULL) { }
+    H323VideoFrameRef(const H323VideoFrameRef & other);
+    ~H323VideoFrameRef();
+
+    H323VideoFrameRef & operator=(const H323VideoFrameRef & other);
+
+    /**Compare the pictures referred to, equal if the same picture.
+      */
+    virtual Comparison Compare(const PObject & obj) const;
+
+    /**Drop the reference.
+      */
+    void Release();
+
+    /**Indicate there is no picture.
+      */
+    PBoolean IsNULL() const { return frame == NULL; }
+
+    /**Indicate this is the only reference to the picture, so it may be
+       written to.
+      */
+    PBoolean IsUnique() const { return frame != NULL && frame->references == 1; }
+
+    H323VideoFrame * operator->() const { return frame; }
+    H323VideoFrame & operator*() const  { return *frame; }
+
+  protected:
+    H323VideoFrameRef(H323VideoFrame * frame);
+
+    H323VideoFrame * frame;
+
+  friend class H323VideoFramePool;
+};
+
+
+/**Pool of picture buffers kept by size.
+   A decoder takes a buffer for each picture it passes downstream that is
+   still held from before, so pictures are not copied and, once the
+   pipeline has warmed up, buffers are not allocated either. A change of
+   resolution that changes the buffer size only takes buffers of the new
+   size, those of the old size are kept for another call.
+  */
+class H323VideoFramePool : public PObject
+{
+  PCLASSINFO(H323VideoFramePool, PObject);
+
+  public:
+    /**Create a pool keeping up to a number of free buffers of each size.
+      */
+    H323VideoFramePool(
+      PINDEX maxFree = 8
+    );
+
+    /**Free the buffers. All references must have been released.
+      */
+    ~H323VideoFramePool();
+
+    /**Get the pool used by the plugin video decoders.
+      */
+    static H323VideoFramePool & GetDecoderPool();
+
+    /**Take a buffer of at least the size, from the pool if one is free.
+      */
+    H323VideoFrameRef Acquire(
+      PINDEX size
+    );
+
+    /**Get the number of buffers allocated that are not in the pool.
+      */
+    PINDEX GetInUseCount() const;
+
+    /**Get the number of buffers ever allocated.
+      */
+    PUInt64 GetAllocatedCount() const { return allocatedCount; }
+
+  protected:
+    void Release(H323VideoFrame * frame);
+
+    typedef std::map<PINDEX, std::vector<H323VideoFrame *> > FreeMap;
+
+    PINDEX         maxFree;
+    FreeMap        freeFrames;     ///< Free buffers by size
+    PINDEX         inUse;
+    PUInt64        allocatedCount;
+    mutable PMutex mutex;
+
+  friend class H323VideoFrameRef;
+};
+
+
+#endif // H323_VIDEO
+
+#endif // __H323_VIDEOFRAME_H
+
+
+/////////////////////////////////////////////////////////////////////////////
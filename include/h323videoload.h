@@ -0,0 +1,233 @@
+/*
+ * h323videoload.h
+ *
+ * Shedding of video decoding under processor load
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#ifndef __H323_VIDEOLOAD_H
+#define __H323_VIDEOLOAD_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include "openh323buildopts.h"
+#include "rtp.h"
+
+#ifdef H323_VIDEO
+
+#include <map>
+
+class H323VideoDecodeLoad;
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**Processor time the video decoders of an endpoint may use together.
+   Each decoder reports the share of a processor it needs to decode every
+   picture. The decoders are ranked by priority, and by need within a
+   priority so the most costly degrade first, and those past the budget in
+   the ranking shed pictures until the others leave room.
+  */
+class H323VideoDecodeBudget : public PObject
+{
+  PCLASSINFO(H323VideoDecodeBudget, PObject);
+
+  public:
+    H323VideoDecodeBudget();
+
+    /**Set the budget in percent of one processor, so 200 is two. Zero,
+       the default, sets no budget, decoders only shed pictures when they
+       cannot keep up on their own.
+      */
+    void SetBudget(unsigned percent);
+
+    /**Get the budget in percent of one processor.
+      */
+    unsigned GetBudget() const;
+
+    /**Record the load of a decoder, returning TRUE if it is past the
+       budget.
+      */
+    PBoolean Report(
+      const H323VideoDecodeLoad * decoder,  ///< Decoder reporting
+      unsigned load,                        ///< Percent of a processor to decode everything
+      int priority                          ///< Higher degrades later
+    );
+
+    /**Remove a decoder from the budget.
+      */
+    void Remove(
+      const H323VideoDecodeLoad * decoder
+    );
+
+    /**Get the total load reported in percent of one processor.
+      */
+    unsigned GetTotalLoad() const;
+
+  protected:
+    struct Entry {
+      unsigned load;
+      int      priority;
+    };
+    typedef std::map<const H323VideoDecodeLoad *, Entry> EntryMap;
+
+    unsigned budget;
+    EntryMap decoders;
+    mutable PMutex mutex;
+};
+
+
+/**Decision on which received pictures a video decoder decodes.
+   The decoder times itself and sheds pictures when decoding takes over 90%
+   of the time between pictures, or its budget says so. It first skips the
+   pictures no other picture refers to, then everything but intra pictures,
+   the last picture decoded staying on screen until the next. It steps back
+   after three seconds under 60%, at the next intra picture, asking for one.
+   As the cost of intra pictures only overstates the load, intra only
+   decoding tries skipping less after 4 seconds, then 8 and up to 32.
+
+   Picture types are read from the RTP payload of H.264, RFC 2190 H.263 and
+   RFC 4629 H.263. Other formats are always decoded.
+  */
+class H323VideoDecodeLoad : public PObject
+{
+  PCLASSINFO(H323VideoDecodeLoad, PObject);
+
+  public:
+    enum Levels {
+      DecodeAll,
+      SkipNonReference,
+      DecodeIntraOnly
+    };
+
+    enum PictureTypes {
+      UnknownPicture,
+      IntraPicture,
+      ReferencePicture,
+      NonReferencePicture
+    };
+
+    H323VideoDecodeLoad();
+    ~H323VideoDecodeLoad();
+
+    /**Start deciding for a decoder of an RTP payload format.
+      */
+    void Open(
+      const PString & sdpFormat,            ///< SDP name of the payload format
+      H323VideoDecodeBudget * budget = NULL ///< Budget shared with other decoders
+    );
+
+    /**Stop, leaving the budget.
+      */
+    void Close();
+
+    /**Indicate Open() has been called.
+      */
+    PBoolean IsOpen() const { return format != UnknownFormat; }
+
+    /**Set the priority of the decoder in the budget, higher degrades later.
+      */
+    void SetPriority(int value) { priority = value; }
+
+    /**Decide whether to decode a packet, FALSE if it is to be skipped.
+      */
+    PBoolean StartPacket(
+      const RTP_DataFrame & frame   ///< Received packet
+    );
+
+    /**Add the time taken to decode a packet.
+      */
+    void AddDecodeTime(
+      PInt64 milliseconds
+    ) { decodeTime += milliseconds; }
+
+    /**Get and clear a wish for an intra picture, to decode everything again.
+      */
+    PBoolean TakeIntraRequest();
+
+    /**Get the current level of shedding.
+      */
+    Levels GetLevel() const { return level; }
+
+    /**Get the number of pictures not decoded.
+      */
+    DWORD GetPicturesSkipped() const { return picturesSkipped; }
+
+    /**Get the type of the picture an RTP packet is part of.
+      */
+    static PictureTypes GetPictureType(
+      const PString & sdpFormat,    ///< SDP name of the payload format
+      const RTP_DataFrame & frame   ///< Packet of the picture
+    );
+
+    virtual void PrintOn(ostream & strm) const;
+
+  protected:
+    enum Formats {
+      UnknownFormat,
+      OtherFormat,
+      H264Format,
+      H263Format,
+      H263PlusFormat
+    };
+
+    static Formats GetFormat(const PString & sdpFormat);
+    static PictureTypes GetPictureType(Formats format, const RTP_DataFrame & frame);
+    void Decide(PictureTypes type);
+    void Evaluate(PInt64 now);
+
+    Formats                 format;
+    H323VideoDecodeBudget * budget;
+    int                     priority;
+    Levels                  level;
+
+    PBoolean     started;
+    DWORD        pictureTimestamp;
+    PictureTypes pictureType;
+    PBoolean     decodePicture;
+    PBoolean     waitingForIntra;   ///< A skipped picture was referred to
+    PBoolean     intraRequested;
+
+    PInt64       periodStart;
+    PInt64       decodeTime;        ///< Milliseconds decoding in the period
+    unsigned     picturesSeen;
+    unsigned     picturesDecoded;
+    unsigned     load;              ///< Percent of a processor to decode everything
+    unsigned     calmPeriods;
+    unsigned     probePeriods;
+    unsigned     probeWait;
+    DWORD        picturesSkipped;
+};
+
+
+#endif // H323_VIDEO
+
+#endif // __H323_VIDEOLOAD_H
+
+
+/////////////////////////////////////////////////////////////////////////////
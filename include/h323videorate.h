@@ -0,0 +1,129 @@
+/*
+ * h323videorate.h
+ *
+ * Video rate control from the RTCP reports of the remote
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#ifndef __H323_VIDEORATE_H
+#define __H323_VIDEORATE_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include "openh323buildopts.h"
+#include "rtp.h"
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**Bit rate and frame rate for a video encoder, following the receiver
+   reports of the remote on the video sent.
+   This is the loss based half of Google congestion control, with the rise
+   of the reported jitter standing in for its delay based half as RTCP
+   gives no per packet timing. A loss over 10% cuts the rate by half the
+   loss, a jitter rising 30ms over its floor cuts it by 15%, a loss under
+   2% raises it by 8% a second and anything between holds it. The rate is
+   never raised the report after a cut, and stays between an eighth of the
+   maximum and the maximum. Below half the maximum the frame rate drops in
+   proportion, to no less than 5 frames a second, so the pictures keep
+   their quality as the rate falls.
+  */
+class H323VideoRateController : public PObject
+{
+  PCLASSINFO(H323VideoRateController, PObject);
+
+  public:
+    H323VideoRateController();
+
+    /**Start control at a rate, which is also the most it will rise to.
+      */
+    void Open(
+      unsigned maxBitRate,    ///< Bit rate in bits/s
+      unsigned frameTime      ///< Time between frames in 90kHz units
+    );
+
+    /**Indicate Open() has been called.
+      */
+    PBoolean IsOpen() const { return maxBitRate > 0; }
+
+    /**Set the most the rate may be, for a flow control from the remote.
+      */
+    void SetMaxBitRate(
+      unsigned bitRate        ///< Bit rate in bits/s
+    );
+
+    /**Adjust the rates for a report on the video sent.
+      */
+    void OnReceiverReport(
+      const RTP_Session::ReceiverReport & report
+    );
+
+    /**Get the rates to apply if they have moved since last applied.
+      */
+    PBoolean GetUpdate(
+      unsigned & bitRate,     ///< Bit rate in bits/s
+      unsigned & frameTime    ///< Time between frames in 90kHz units
+    );
+
+    /**Get the current bit rate in bits/s.
+      */
+    unsigned GetBitRate() const;
+
+    /**Get the current time between frames in 90kHz units.
+      */
+    unsigned GetFrameTime() const;
+
+    /**Get the time between frames at full rate in 90kHz units.
+      */
+    unsigned GetBaseFrameTime() const { return baseFrameTime; }
+
+    virtual void PrintOn(ostream & strm) const;
+
+  protected:
+    void UpdateFrameTime();
+
+    unsigned maxBitRate;
+    unsigned minBitRate;
+    unsigned baseFrameTime;
+    unsigned bitRate;
+    unsigned frameTime;
+    unsigned appliedBitRate;
+    unsigned appliedFrameTime;
+
+    PBoolean      holding;        ///< Cut at the last report
+    DWORD         jitterFloor;    ///< Lowest jitter seen, in ms
+    DWORD         lastJitter;
+    PTimeInterval lastReport;
+    mutable PMutex mutex;
+};
+
+
+#endif // __H323_VIDEORATE_H
+
+
+/////////////////////////////////////////////////////////////////////////////
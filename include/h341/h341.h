@@ -46,6 +46,66 @@
 
 #include <ptlib.h>
 #include <ptclib/psnmp.h>
+#include <map>
+
+/**The MIB values published by the agent at one time.
+   A snapshot is filled by H323_H341Server::OnBuildSnapshot() and is not
+   changed once published, so any number of requests may read it while the
+   next one is built. Values are kept in OID order for GetNext.
+  */
+class H323_H341Snapshot : public PObject
+{
+    PCLASSINFO(H323_H341Snapshot, PObject);
+  public:
+    H323_H341Snapshot();
+
+    /**Set the value of an object instance, eg "1.3.6.1.2.1.1.3.0".
+      */
+    void SetValue(
+      const PString & oid,
+      const PRFC1155_ObjectSyntax & value
+    );
+
+    /**Get the value of an object instance.
+      */
+    PBoolean GetValue(
+      const PString & oid,
+      PRFC1155_ObjectSyntax & value
+    ) const;
+
+    /**Get the first object instance after an OID in OID order.
+       Returns FALSE at the end of the MIB.
+      */
+    PBoolean GetNextValue(
+      const PString & oid,
+      PString & nextOid,
+      PRFC1155_ObjectSyntax & value
+    ) const;
+
+    /**Get the number of object instances.
+      */
+    PINDEX GetSize() const { return values.size(); }
+
+    /**Get the time the snapshot was built.
+      */
+    const PTime & GetTime() const { return time; }
+
+    /**Compare OIDs component by component, so 1.10 is after 1.9.
+      */
+    struct OIDLess {
+      bool operator()(const PString & oid1, const PString & oid2) const;
+    };
+
+  protected:
+    typedef std::map<PString, PRFC1155_ObjectSyntax, OIDLess> ValueMap;
+
+    ValueMap values;
+    PTime    time;
+
+    mutable PAtomicInteger references;
+    friend class H323_H341Server;
+};
+
 
 class H323_H341Server : public PSNMPServer
 {
@@ -73,8 +133,63 @@ class H323_H341Server : public PSNMPServer
 						                PSNMP::ErrorType & /*errCode*/) 
 	                                          { return FALSE; }
 
+    /**Answer a GetBulk request from the snapshot as RFC 3416 describes,
+       the first nonRepeaters variables get one successor and the rest up to
+       maxRepetitions. Only available once snapshots are started.
+      */
+    virtual PBoolean OnGetBulkRequest(
+      PINDEX reqID,
+      PINDEX nonRepeaters,
+      PINDEX maxRepetitions,
+      PSNMP::BindingList & vars,
+      PSNMP::ErrorType & errCode
+    );
+
+    /**Serve Get, GetNext and GetBulk from a snapshot of the MIB built every
+       interval by OnBuildSnapshot(), rather than calling OnRequest() for
+       each, so polling does not touch the objects being monitored. Set
+       requests still go to OnRequest().
+      */
+    void StartSnapshots(
+      const PTimeInterval & interval
+    );
+
+    /**Stop building snapshots, requests go to OnRequest() again.
+      */
+    void StopSnapshots();
+
+    /**Build and publish a snapshot now.
+      */
+    void PublishSnapshot();
+
+    /**Fill a new snapshot with the current values of the MIB.
+       Called on the snapshot thread, the default does nothing.
+      */
+    virtual void OnBuildSnapshot(
+      H323_H341Snapshot & /*snapshot*/
+    ) { }
+
+    /**Get the current snapshot, NULL if none has been published.
+       The snapshot must be given back with ReleaseSnapshot().
+      */
+    const H323_H341Snapshot * AcquireSnapshot() const;
+
+    /**Give back a snapshot from AcquireSnapshot().
+      */
+    static void ReleaseSnapshot(
+      const H323_H341Snapshot * snapshot
+    );
+
   protected:
+    PBoolean GetNextFromSnapshot(const H323_H341Snapshot & snapshot, PSNMP::BindingList & vars, PSNMP::ErrorType & errCode);
+    PDECLARE_NOTIFIER(PThread, H323_H341Server, SnapshotMain);
 
+    const H323_H341Snapshot * snapshot;     ///< Current snapshot, guarded by snapshotMutex
+    mutable PMutex snapshotMutex;
+    PTimeInterval  snapshotInterval;
+    PThread      * snapshotThread;
+    PSyncPoint     snapshotWakeUp;
+    PBoolean       snapshotStop;
 };
 
 #endif // _H323_H341
@@ -47,6 +47,8 @@
 #include <ptclib/pldap.h>
 #include <map>
 #include <list>
+#include <set>
+#include <vector>
 
 class H350_Session : public PLDAPSession
 {
@@ -78,6 +80,158 @@ class H350_Session : public PLDAPSession
 				 );
 };
 
+
+/**A client of an H.350 directory for looking up identities during calls.
+   Searches share a pool of sessions that are opened and bound once and
+   kept for later searches, so a lookup does not pay for a connection and a
+   bind each time. Results are cached for a time, keyed by the search, and
+   indexed by the commURI and h323Identity values they hold so a change to
+   a user's entry can remove them by InvalidateCommURI() or
+   InvalidateH323Identity().
+
+   StartSearch() queues a search for a worker thread, one for each session
+   of the pool, and calls a notifier with the results so the caller need
+   not wait for the directory.
+  */
+class H350_Client : public PObject
+{
+    PCLASSINFO(H350_Client, PObject);
+  public:
+    /**Create a client of a directory. No session is opened until the first
+       search.
+      */
+    H350_Client(
+      const PString & hostname,                 ///< Directory server, or domain of its SRV record
+      WORD port = 389,                          ///< Port if no SRV record
+      const PString & who = PString::Empty(),   ///< Bind DN, empty for anonymous
+      const PString & passwd = PString::Empty(),///< Bind password
+      PLDAPSession::AuthenticationMethod authMethod = PLDAPSession::AuthSimple,
+      PINDEX maxSessions = 4                    ///< Sessions in the pool
+    );
+
+    /**Stop the workers and close every session. Queued searches are
+       completed with no results.
+      */
+    ~H350_Client();
+
+    /**A search started by StartSearch().
+      */
+    class SearchRequest : public PObject
+    {
+        PCLASSINFO(SearchRequest, PObject);
+      public:
+        PString base;
+        PString filter;
+        PStringArray attributes;
+        PNotifier notifier;
+        H350_Session::LDAP_RecordList results;
+        int count;                  ///< Records found, as Search() returns
+    };
+
+    /**Search the directory, answering from the cache when a search with the
+       same base, filter and attributes was done within the cache time.
+       Returns the number of records found, as H350_Session::Search().
+      */
+    int Search(
+      const PString & base,
+      const PString & filter,
+      H350_Session::LDAP_RecordList & results,
+      const PStringArray & attributes = PStringList()
+    );
+
+    /**Search the directory without waiting for the answer.
+       The notifier is called with the SearchRequest and INT extra the
+       number of records found, on a worker thread or, for a cached result,
+       before this returns. The request is deleted after the notifier.
+      */
+    void StartSearch(
+      const PString & base,
+      const PString & filter,
+      const PNotifier & notifier,
+      const PStringArray & attributes = PStringList()
+    );
+
+    /**Remove the cached results holding a commURI.
+      */
+    void InvalidateCommURI(
+      const PString & uri
+    );
+
+    /**Remove the cached results holding an h323Identity alias.
+      */
+    void InvalidateH323Identity(
+      const PString & identity
+    );
+
+    /**Remove every cached result.
+      */
+    void InvalidateAll();
+
+    /**Set the time a result is cached, zero disables the cache.
+       The default is 60 seconds.
+      */
+    void SetCacheTime(
+      const PTimeInterval & time
+    ) { cacheTime = time; }
+
+    /**Get the time a result is cached.
+      */
+    const PTimeInterval & GetCacheTime() const { return cacheTime; }
+
+    /**Get the number of searches answered from the cache.
+      */
+    PUInt64 GetCacheHits() const { return cacheHits; }
+
+    /**Get the number of searches sent to the directory.
+      */
+    PUInt64 GetCacheMisses() const { return cacheMisses; }
+
+  protected:
+    H350_Session * AcquireSession();
+    void ReleaseSession(H350_Session * session);
+    void Invalidate(const PString & indexKey);
+    void RemoveCacheEntry(const PString & key);
+    PDECLARE_NOTIFIER(PThread, H350_Client, WorkerMain);
+
+    struct CacheEntry {
+      H350_Session::LDAP_RecordList results;
+      int                           count;
+      PInt64                        expires;     ///< PTimer::Tick() milliseconds
+      std::vector<PString>          indexKeys;
+    };
+    typedef std::map<PString, CacheEntry> CacheMap;
+
+    PString  hostname;
+    WORD     port;
+    PString  who;
+    PString  passwd;
+    PLDAPSession::AuthenticationMethod authMethod;
+    PINDEX   maxSessions;
+
+    // Sessions ready for a search, and the number open in all
+    std::list<H350_Session *> idleSessions;
+    PINDEX     openSessions;
+    PMutex     sessionMutex;
+    PSyncPoint sessionAvailable;
+
+    // Results by search, and the searches by commURI or h323Identity value
+    PTimeInterval cacheTime;
+    CacheMap   cache;
+    std::multimap<PString, PString> cacheIndex;
+    std::set<PString> emptyResults;    ///< Searches cached without records
+    PUInt64    cacheHits;
+    PUInt64    cacheMisses;
+    PMutex     cacheMutex;
+
+    std::list<SearchRequest *> queue;
+    std::vector<PThread *> workers;
+    PINDEX     idleWorkers;
+    PBoolean   stopping;
+    PMutex     queueMutex;
+    PSemaphore queued;
+};
+
+
 #define H350_Schema(cname)  \
 class cname##_schema : public PLDAPSchema \
 {   \
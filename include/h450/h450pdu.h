@@ -183,7 +183,8 @@ class H450xDispatcher : public PObject
       H323Connection & connection
     );
 
-    /**Add a handler for the op code.
+    /**Add a handler for the op code. Local op codes of every H.450 service
+       are below MaxOpCode, and a higher one is refused.
       */
     void AddOpCode(
       unsigned opcode,
@@ -255,10 +256,12 @@ class H450xDispatcher : public PObject
      */
     unsigned GetNextInvokeId() const { return ++nextInvokeId; }
 
+    enum { MaxOpCode = 256 };
+
   protected:
     H323Connection & connection;
     H450xHandlerList  handlers;
-    H450xHandlerDict  opcodeHandler;
+    H450xHandler    * opcodeHandler[MaxOpCode];  ///<  Handler by local opcode, NULL if unsupported
     mutable unsigned  nextInvokeId;             ///<  Next available invoke ID for H450 operations
 };
 
@@ -54,6 +54,7 @@
 #include <ptlib/pluginmgr.h>
 #include <ptclib/url.h>
 #include <map>
+#include <vector>
 #include "ptlib_extras.h"
 
 
@@ -153,7 +154,12 @@ class H460_FeatureID : public H225_GenericIdentifier
   //@{
     PObject * Clone() const;
 
+    /** Order by type and then by the number, OID or GUID, without building
+        the ID strings.
+    */
     PObject::Comparison Compare(const PObject & obj) const;
+
+    PINDEX HashFunction() const;
   //@}
 
 };
@@ -1044,6 +1050,60 @@ class H460_FeatureOID : public H460_Feature
 
 H323DICTIONARY(H460_Features, H460_FeatureID, H460_Feature);
 
+//////////////////////////////////////////////////////////////////////////////
+// Catalogue of the feature plugins
+
+/**The feature plugins of one feature type, as H460_Feature::FeatureList()
+   finds them, built once from the plugin manager. Loading a feature set
+   for each call then walks this array instead of looking up, validating
+   and parsing the name of every plugin again.
+   A catalogue is never changed once built. When plugins are loaded or
+   unloaded the catalogues are replaced, and those in use stay valid until
+   released.
+  */
+class H460_FeatureCatalogue : public PObject
+{
+    PCLASSINFO(H460_FeatureCatalogue, PObject);
+  public:
+    struct Entry {
+      PString        name;     ///< Plugin name
+      H460_FeatureID id;
+      PDevicePluginServiceDescriptor * descriptor;
+    };
+
+    /** Get the catalogue of a feature type, building it if needed.
+        Give it back with Release().
+      */
+    static const H460_FeatureCatalogue * Acquire(int type);
+
+    /** Give back a catalogue from Acquire().
+      */
+    static void Release(const H460_FeatureCatalogue * catalogue);
+
+    /** Build the catalogue of a feature type ahead of the first call.
+      */
+    static void Load(int type);
+
+    /** Discard the catalogues so they are built again from the plugins.
+        This is called when the plugin manager loads or unloads a plugin.
+      */
+    static void Refresh();
+
+    PINDEX GetSize() const { return entries.size(); }
+    const Entry & operator[](PINDEX i) const { return entries[i]; }
+
+    /** Create a new instance of a feature in the catalogue.
+      */
+    H460_Feature * CreateFeature(PINDEX i) const;
+
+  protected:
+    H460_FeatureCatalogue(int type, PPluginManager & pluginMgr);
+
+    int type;
+    std::vector<Entry> entries;
+    mutable PAtomicInteger references;
+};
+
 //////////////////////////////////////////////////////////////////////////////
 // FeatureSet Main Calling Class
 class H323EndPoint;
@@ -1163,7 +1223,16 @@ class H460_FeatureSet : public PObject
 
    PString PTracePDU(PINDEX id) const;
 
+   H460_Feature * FindFeature(const H460_FeatureID & id) const;
+   void IndexFeature(H460_Feature * feat);
+   void UnindexFeature(const H460_FeatureID & id);
+
    H460_Features  Features;
+
+   // Index of Features, standard features by number and the rest by ID,
+   // so look ups from the PDUs do not walk the dictionary
+   std::map<unsigned, H460_Feature *>       StdFeatureIndex;
+   std::map<H460_FeatureID, H460_Feature *> FeatureIndex;
    H323EndPoint * ep;
    H460_FeatureSet * baseSet;
 
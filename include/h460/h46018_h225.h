@@ -49,6 +49,13 @@
 #endif // _MSC_VER > 1000
 
 #include "h323pdu.h"
+#include "h323timer.h"
+#include "h323lockprof.h"
+
+#include <map>
+#include <vector>
+
+class RTP_DatagramBatch;
 
 class H46018SignalPDU  : public H323SignalPDU
 {
@@ -148,6 +155,11 @@ class H46018Transport  : public H323TransportTCP
     */
     virtual PBoolean Connect(const OpalGloballyUniqueID & callIdentifier);
 
+    /**Connect to the server ahead of an incoming call. InitialPDU() is
+       sent once the call is known.
+    */
+    PBoolean PreOpen() { return H323TransportTCP::Connect(); }
+
     /**Close the channel.(Don't do anything)
     */
     virtual PBoolean Close();
@@ -173,6 +185,84 @@ class H46018Transport  : public H323TransportTCP
 
 
 
+class H46019UDPSocket;
+
+/**Sends the H.460.19 keep-alive pings of all the media sockets of an endpoint.
+   The sockets are kept on a timer wheel of 100ms slots and a single thread
+   takes the sockets due in each slot and pings them in one batch, rather than
+   every socket having its own timer and start up thread. A socket that sent
+   media to its keep-alive address since its last ping is skipped, the media
+   having kept the pinhole open.
+  */
+class H46019KeepAlive : public PObject
+{
+    PCLASSINFO(H46019KeepAlive, PObject);
+
+  public:
+    H46019KeepAlive();
+    ~H46019KeepAlive();
+
+    /** Start pinging a socket, first with a few closely spaced pings to open the
+        pinhole and then every interval.
+      */
+    void AddSocket(
+        H46019UDPSocket & socket,   ///< Socket to ping
+        unsigned interval           ///< Time between pings in ms
+    );
+
+    /** Stop pinging a socket. On return the service is not inside a call to the
+        socket, so it may be deleted.
+      */
+    void RemoveSocket(
+        H46019UDPSocket & socket    ///< Socket to stop
+    );
+
+    /** Get the number of sockets being pinged.
+      */
+    PINDEX GetSocketCount() const { return m_sockets.size(); }
+
+    /** Get the number of pings sent, and skipped because media was flowing.
+      */
+    PUInt64 GetPingCount() const { return m_pingCount; }
+    PUInt64 GetSkipCount() const { return m_skipCount; }
+
+  protected:
+    class Thread;
+    friend class Thread;
+
+    struct Entry {
+        unsigned interval;     ///< Time between pings in ms
+        unsigned initial;      ///< Opening pings still to send
+        unsigned rounds;       ///< Turns of the wheel before the entry is due
+        unsigned generation;   ///< Matches the slot entry that is current
+    };
+
+    typedef std::map<H46019UDPSocket *, Entry> SocketMap;
+    typedef std::vector<std::pair<H46019UDPSocket *, unsigned> > Slot;
+    typedef std::vector<std::pair<H46019UDPSocket *, bool> > Batch;
+
+    void Main();
+    void Schedule(H46019UDPSocket * socket, Entry & entry, unsigned delay);
+    void Tick();
+
+    SocketMap          m_sockets;
+    std::vector<Slot>  m_wheel;
+    Slot               m_current;      ///< Reused for the slot being processed
+    Batch              m_dueBatch;     ///< Reused for the pings of each tick
+    unsigned           m_tick;         ///< Slot last processed
+    PInt64             m_tickTime;     ///< Time the next slot is due
+    unsigned           m_generation;
+    PUInt64            m_pingCount;
+    PUInt64            m_skipCount;
+    PBoolean           m_shutdown;
+
+    PMutex             m_mutex;        ///< Protects the wheel
+    PMutex             m_sendMutex;    ///< Held while the thread sends a batch
+    PSyncPoint         m_wakeUp;
+    Thread           * m_thread;
+};
+
+
 class H323EndPoint;
 class PNatMethod_H46019;
 class H46018Handler : public PObject  
@@ -189,6 +279,10 @@ class H46018Handler : public PObject
 
     H323EndPoint * GetEndPoint();
 
+    /** Get the service sending the keep-alive pings of the media sockets.
+      */
+    H46019KeepAlive & GetKeepAlive();
+
     PBoolean CreateH225Transport(const PASN_OctetString & information);
 
 #ifdef H323_H46019M
@@ -216,8 +310,19 @@ class H46018Handler : public PObject
     OpalGloballyUniqueID m_callId;
     PThread * SocketCreateThread;
     PDECLARE_NOTIFIER(PThread, H46018Handler, SocketThread);
+    H46018Transport * TakeSpareChannel(const H323TransportAddress & address);
+    void OpenSpareChannel(const H323TransportAddress & address, const H323TransportSecurity & security);
     PBoolean m_h46018inOperation;
 
+    // Call signalling channel opened ahead of the next SCI
+    PMutex               m_spareMutex;
+    H46018Transport    * m_spare;
+    H323TransportAddress m_spareAddress;
+    PInt64               m_spareOpened;
+
+    PMutex            m_keepAliveMutex;
+    H46019KeepAlive * m_keepAlive;
+
     H323TransportSecurity m_callSecurity;
 };
 
@@ -227,6 +332,58 @@ typedef std::map<unsigned, PUDPSocket*> muxSocketMap;
 typedef std::map<PString, unsigned> muxPortMap;
 
 class H46019MultiplexSocket;
+
+/**Multiplexed sessions indexed by multiplex ID for the read threads.
+   Find() takes no lock: each slot carries a sequence count that the writer
+   makes odd while changing it, and a reader retries if the count moved.
+   Insert(), Remove() and Clear() must be serialised by the caller. Removed
+   entries keep their ID so probe chains stay intact, the table is compacted
+   or grown into a new one when three quarters of the slots have been used.
+  */
+class H46019MultiplexTable
+{
+  public:
+    H46019MultiplexTable(PINDEX size = 256);
+    ~H46019MultiplexTable();
+
+    /** Find the socket for a multiplex ID, NULL if not registered
+      */
+    PUDPSocket * Find(unsigned id) const;
+
+    /** Add or replace the socket for a multiplex ID
+      */
+    void Insert(unsigned id, PUDPSocket * socket);
+
+    /** Remove a multiplex ID
+      */
+    void Remove(unsigned id);
+
+    /** Remove all multiplex IDs
+      */
+    void Clear();
+
+  protected:
+    struct Slot {
+        volatile DWORD        sequence;
+        volatile unsigned     id;
+        PUDPSocket * volatile socket;
+    };
+
+    struct Table {
+        Table(PINDEX size);
+        ~Table();
+        PINDEX  size;
+        PINDEX  used;
+        Slot *  slots;
+        Table * retired;
+    };
+
+    void Write(Slot & slot, unsigned id, PUDPSocket * socket);
+    void Rebuild();
+
+    Table * volatile table;
+    PINDEX           live;
+};
 #endif
 
 class PNatMethod_H46019  : public H323NatMethod
@@ -335,6 +492,17 @@ class PNatMethod_H46019  : public H323NatMethod
       */
     void StartMultiplexListener();
 
+    /** Set the number of threads reading the multiplexed RTP port.
+        More than one opens a socket per thread on the same port with
+        SO_REUSEPORT, so the kernel spreads the remote peers across them.
+        Must be set before the first multiplexed call. The default is one.
+      */
+    static void SetMultiplexReadThreads(PINDEX count);
+
+    /** Get the number of threads reading the multiplexed RTP port.
+      */
+    static PINDEX GetMultiplexReadThreads();
+
 #endif
 
     /**  OpenSocket
@@ -427,9 +595,19 @@ protected:
     static muxSocketMap                  rtpSocketMap;
     static muxPortMap                    rtpPortMap;
     static muxSocketMap                  rtcpSocketMap;
-    static PMutex                        muxMutex;
+    static H46019MultiplexTable          rtpSocketTable;
+    static H46019MultiplexTable          rtcpSocketTable;
+    static H323ProfiledMutex             muxMutex;
+    static PINDEX                        muxReadThreads;
+    static std::vector<PUDPSocket *>     muxShardSockets;
+    static std::vector<PThread *>        muxShardThreads;
+    static std::vector<std::pair<PThread *, PUDPSocket *> > muxRetiredShards;  // Closed, to be joined and deleted
     PThread *                            m_readThread;
     PDECLARE_NOTIFIER(PThread, PNatMethod_H46019, ReadThread);
+
+    void OpenMultiplexShards(const PIPSocket::Address & binding);
+    static void CloseMultiplexSockets();
+    static void JoinMultiplexShards();
 #endif
 
 };
@@ -447,10 +625,12 @@ protected:
 struct  H46019MultiPacket {
   PIPSocket::Address fromAddr;
   WORD               fromPort;
-  PBYTEArray         frame;
+  PBYTEArray         frame;           ///< Recycled buffer, may be larger than the packet
+  PINDEX             length;          ///< Length of packet in frame
 };
 
 typedef std::queue<H46019MultiPacket> H46019MultiQueue;
+typedef std::vector<PBYTEArray>       H46019MultiSpares;
 
 class H46019MultiplexSocket : public H323UDPSocket
 {
@@ -459,7 +639,7 @@ class H46019MultiplexSocket : public H323UDPSocket
   public:
     H46019MultiplexSocket();
 
-    H46019MultiplexSocket(bool rtp);
+    H46019MultiplexSocket(bool rtp, bool reusePort = false);
 
     ~H46019MultiplexSocket();
 
@@ -484,7 +664,11 @@ class H46019MultiplexSocket : public H323UDPSocket
     );
 
     /**Write a datagram to a remote computer.
-       @return PTrue if all the bytes were sucessfully written.
+       Every call sends through this socket, so datagrams written while
+       another thread is sending are queued and that thread sends them all
+       with one system call when its own send is done. The writer of a queued
+       datagram returns without waiting, a send error is only traced.
+       @return PTrue if all the bytes were sucessfully written or queued.
      */
     virtual PBoolean WriteTo(
       const void * buf,   ///< Data to be written as URGENT TCP data.
@@ -495,16 +679,33 @@ class H46019MultiplexSocket : public H323UDPSocket
 
     virtual PBoolean Close();
 
+    /**Get the number of system calls made to send, and datagrams sent.
+      */
+    void GetSendCounts(PUInt64 & calls, PUInt64 & datagrams) const;
+
     PString GetLocalAddress();
     PBoolean GetLocalAddress(Address & addr, WORD & port);
 
     PUDPSocket * & GetSubSocket()  { return m_subSocket; }
 
+  protected:
+    virtual PBoolean OpenSocket(int ipAdressFamily);
+
   private:
 
+    void CreateSendBatches();
+
     PUDPSocket              *  m_subSocket;
     MuxType                    m_plexType;
-    PMutex                     m_mutex;
+    PMutex                     m_mutex;       // Held while sending
+    bool                       m_reusePort;
+
+    PMutex                     m_queueMutex;  // Protects the queued batch and m_sending
+    RTP_DatagramBatch       *  m_queued;      // Datagrams waiting for the sending thread
+    RTP_DatagramBatch       *  m_flushing;    // Datagrams being sent
+    bool                       m_sending;     // A thread is sending the queued datagrams
+    PUInt64                    m_sendCalls;
+    PUInt64                    m_sendDatagrams;
 
 };
 #endif
@@ -567,6 +768,12 @@ class H46019UDPSocket : public H323UDPSocket
       */
     void SetTTL(unsigned val);
 
+    /** Called by the keep-alive service when a ping is due. An opening ping is
+        always sent, a later one only if no media was sent to the keep-alive
+        address since the last. Returns FALSE if the ping was skipped.
+      */
+    PBoolean OnKeepAlive(bool initial);
+
 #ifdef H323_H46019M
 
     /** Get Peer Address
@@ -677,6 +884,20 @@ class H46019UDPSocket : public H323UDPSocket
         BYTE        cui[20];    // SHA-1 is always 160 (20 Bytes)
     };
 
+    /** A remote address a direct media path may be found on. All candidates
+        are checked at once, paced one check per H46024_CHECK_PACE ms, and the
+        first to answer becomes the alternate address.
+      */
+    struct probe_candidate {
+        PIPSocket::Address addr;
+        WORD        port;
+        unsigned    muxID;
+        bool        annexB;     // Checked with RTP pings (Annex B) rather than RTCP probes (Annex A)
+        PINDEX      sent;       // Checks sent
+        PInt64      lastSent;   // Tick of the last check
+    };
+    typedef std::vector<probe_candidate> probe_candidates;
+
 
     /** Set Alternate Direct Address
       */
@@ -717,6 +938,7 @@ class H46019UDPSocket : public H323UDPSocket
 
  // H.460.19 Keepalives
     void InitialiseKeepAlive();    ///< Start the keepalive
+    void StopKeepAlive();          ///< Stop the keepalive
     void SendRTPPing(const PIPSocket::Address & ip, const WORD & port, unsigned id = 0);
     void SendRTCPPing();
     PBoolean SendRTCPFrame(RTP_ControlFrame & report, const PIPSocket::Address & ip, WORD port, unsigned id = 0);
@@ -733,6 +955,16 @@ class H46019UDPSocket : public H323UDPSocket
     PMutex probeMutex;
 #endif
 
+#if defined(H323_H46024A) || defined(H323_H46024B)
+    // Connectivity checks of the candidate direct paths
+    void AddCandidate(const Address & addr, WORD port, unsigned muxID, bool annexB);
+    PBoolean PromoteCandidate(const Address & addr, WORD port, bool annexB, bool anyPort = false);
+    void DropCandidates(bool annexB);
+    void StartChecks();
+    void SendCheck(const probe_candidate & candidate);
+    PMutex candidateMutex;
+#endif
+
 private:
     H46018Handler & m_Handler;
     unsigned m_Session;                        ///< Current Session ie 1-Audio 2-video
@@ -748,16 +980,14 @@ private:
     WORD keepseqno;                            ///< KeepAlive sequence number
     PTime * keepStartTime;                    ///< KeepAlive start time for TimeStamp.
 
-    PThread * initialKeep;                    ///< Initial keepalive thread.
-    PDECLARE_NOTIFIER(PThread, H46019UDPSocket, StartKeepAlives); ///< First keep alives handling
-
-    PDECLARE_NOTIFIER(PTimer, H46019UDPSocket, Ping);    ///< Timer to notify to poll for External IP
-    PTimer    Keep;                                        ///< Polling Timer
+    PBoolean keepActive;                      ///< Pinged by the keep-alive service.
+    PBoolean keepMedia;                       ///< Media sent to the keep-alive address since the last ping.
 
 #ifdef H323_H46019M
     unsigned         m_recvMultiplexID;             ///< Multiplex ID
     unsigned         m_sendMultiplexID;             ///< Multiplex ID
     H46019MultiQueue m_multQueue;                   ///< Incoming frame Queue
+    H46019MultiSpares m_multSpares;                 ///< Buffers recycled from the queue
     unsigned         m_multiBuffer;                 ///< Multiplex BufferSize
     PMutex           m_multiMutex;                  ///< MultiQueue mutex
     PBoolean         m_shutDown;                    ///< Shutdown
@@ -770,9 +1000,10 @@ private:
     PIPSocket::Address m_remAddr;  WORD m_remPort;            ///< Remote Address (address used when starting socket)
     PIPSocket::Address m_detAddr;  WORD m_detPort;            ///< detected remote Address (as detected from actual packets)
     PIPSocket::Address m_pendAddr;  WORD m_pendPort;        ///< detected pending RTCP Probe Address (as detected from actual packets)
-    PDECLARE_NOTIFIER(PTimer, H46019UDPSocket, Probe);        ///< Thread to probe for direct connection
-    PTimer m_Probe;                                            ///< Probe Timer
-    PINDEX m_probes;                                        ///< Probe count
+    PDECLARE_NOTIFIER(H323Timer, H46019UDPSocket, Probe);        ///< Thread to probe for direct connection
+    H323Timer m_Probe;                                         ///< Probe Timer
+    probe_candidates m_candidates;                            ///< Candidate direct paths being checked
+    PINDEX m_nextCandidate;                                    ///< Candidate to check next
     DWORD SSRC;                                                ///< Random number
 #endif
     PIPSocket::Address m_altAddr;  
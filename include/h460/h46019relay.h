@@ -0,0 +1,208 @@
+/*
+ * h46019relay.h
+ *
+ * H.460.19 multiplexed media relay
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+
+
+#ifndef __H323_H46019RELAY_H
+#define __H323_H46019RELAY_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include "openh323buildopts.h"
+
+#ifdef H323_H46018
+
+#include <ptlib/sockets.h>
+#include "ptlib_extras.h"
+
+#include <map>
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**Relay of the media of calls between H.460.19 multiplexed endpoints, for a
+   gatekeeper routing the media of traversal calls itself.
+
+   Every channel shares one RTP port and the RTCP port above it. Each leg of
+   a channel is given a multiplexID of the relay, which the endpoint of that
+   leg sends its media to. The address of the endpoint is learnt from the
+   first packet with that ID, as the endpoint is behind a NAT, and packets
+   are then forwarded to the other leg with the multiplexID it asked for.
+   Empty RTP keep-alives are answered by the latching only and not
+   forwarded.
+
+   A thread per socket reads and sends the datagrams in batches with
+   RTP_DatagramBatch, so a busy relay makes a few system calls for many
+   packets. Once both directions of a channel are known OnFlowEstablished()
+   is called, where an application may install a forwarding rule in the
+   kernel for the flow, such as nftables or an XDP program, and stop the
+   packets reaching the relay at all.
+  */
+class H46019MediaRelay : public PObject
+{
+  PCLASSINFO(H46019MediaRelay, PObject);
+
+  public:
+  /**@name Construction */
+  //@{
+    H46019MediaRelay();
+    ~H46019MediaRelay();
+  //@}
+
+  /**@name Operations */
+  //@{
+    /**Open the RTP socket on the port given and the RTCP socket on the
+       port above, and start relaying.
+      */
+    PBoolean Open(
+      const PIPSocket::Address & iface,   ///< Interface to listen on
+      WORD port                           ///< RTP port, RTCP is port+1
+    );
+
+    /**Stop relaying and remove every channel.
+      */
+    void Close();
+
+    /**Determine if the relay is open.
+      */
+    PBoolean IsOpen() const { return sockets[0] != NULL; }
+
+    /**Get the RTP port the endpoints send to.
+      */
+    WORD GetPort() const { return port; }
+
+    /**Add a channel between two endpoints. The remote IDs are the
+       multiplexIDs each endpoint gave to receive its media with. The local
+       IDs returned are the multiplexIDs each endpoint is to send with, to
+       be given to it in place of the other endpoint's.
+      */
+    PBoolean AddChannel(
+      unsigned remoteIdA,     ///< multiplexID endpoint A receives with
+      unsigned remoteIdB,     ///< multiplexID endpoint B receives with
+      unsigned & localIdA,    ///< multiplexID endpoint A sends with
+      unsigned & localIdB     ///< multiplexID endpoint B sends with
+    );
+
+    /**Remove the channel with a leg of the local ID given, both legs.
+      */
+    void RemoveChannel(
+      unsigned localId
+    );
+
+    /**Get the number of channels relayed.
+      */
+    PINDEX GetChannelCount() const;
+
+    /**Get the packets forwarded between the legs.
+      */
+    PInt64 GetForwardedPackets() const { return forwarded; }
+
+    /**Get the keep-alive packets received.
+      */
+    PInt64 GetKeepAlivePackets() const { return keepAlives; }
+
+    /**Get the packets dropped, for an unknown multiplexID, a source other
+       than the one latched or an other leg not yet heard from.
+      */
+    PInt64 GetDroppedPackets() const { return dropped; }
+  //@}
+
+  /**@name Call backs */
+  //@{
+    /**Called on the first packet forwarded in one direction of a channel,
+       and again if either endpoint is latched to a new address. The packets from the address with the local ID are sent to the other
+       address with the ID given. The default does nothing.
+      */
+    virtual void OnFlowEstablished(
+      PBoolean rtcp,                          ///< RTCP rather than RTP flow
+      unsigned localId,                       ///< multiplexID sent to the relay
+      const PIPSocket::Address & fromAddr,    ///< Endpoint sending
+      WORD fromPort,
+      const PIPSocket::Address & toAddr,      ///< Endpoint receiving
+      WORD toPort,
+      unsigned toId                           ///< multiplexID sent on with
+    );
+
+    /**Called when a channel is removed, for each leg of it that had a flow
+       established. The default does nothing.
+      */
+    virtual void OnFlowEnded(
+      PBoolean rtcp,
+      unsigned localId
+    );
+  //@}
+
+  protected:
+    struct Leg {
+      Leg();
+
+      unsigned peer;          ///< Local ID of the other leg
+      unsigned remoteId;      ///< multiplexID to send to this leg with
+
+      // Indexed by RTP and RTCP
+      PIPSocket::Address addr[2];
+      WORD     port[2];       ///< Zero until latched
+      PInt64   lastSeen[2];   ///< Microseconds
+      PBoolean established[2];
+    };
+
+    PBoolean Forward(PINDEX index, BYTE * buffer, PINDEX len, const PIPSocket::Address & addr, WORD port,
+                     PIPSocket::Address & toAddr, WORD & toPort);
+    unsigned NextLocalId();
+
+    PDECLARE_NOTIFIER(PThread, H46019MediaRelay, ReadThread);
+
+    WORD          port;
+    PUDPSocket  * sockets[2];
+    PThread     * threads[2];
+    volatile PBoolean shutdown;
+
+    mutable PMutex mutex;
+    std::map<unsigned, Leg> legs;
+    unsigned nextId;
+
+    volatile PInt64 forwarded;
+    volatile PInt64 keepAlives;
+    volatile PInt64 dropped;
+
+  private:
+    H46019MediaRelay(const H46019MediaRelay &);
+    H46019MediaRelay & operator=(const H46019MediaRelay &);
+};
+
+
+#endif // H323_H46018
+
+#endif // __H323_H46019RELAY_H
+
+
+/////////////////////////////////////////////////////////////////////////////
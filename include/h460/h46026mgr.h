@@ -40,6 +40,7 @@
 
 #include <h460/h46026.h>
 #include <queue>
+#include <deque>
 #include <vector>
 #include <map>
 
@@ -82,10 +83,14 @@ public:
         PInt64 packTime;
      };
 
-     int operator() ( const std::pair<PBYTEArray, MessageHeader>& p1,
-                      const std::pair<PBYTEArray, MessageHeader>& p2 ) {
-           return ((p1.second.priority >= p2.second.priority) && 
-                     (p1.second.packTime > p2.second.packTime));
+     // Lower priority value first, then oldest first. Must be a strict weak ordering.
+     bool operator() ( const std::pair<PBYTEArray, MessageHeader>& p1,
+                       const std::pair<PBYTEArray, MessageHeader>& p2 ) const {
+           if (p1.second.priority != p2.second.priority)
+               return p1.second.priority > p2.second.priority;
+           if (p1.second.packTime != p2.second.packTime)
+               return p1.second.packTime > p2.second.packTime;
+           return p1.second.id > p2.second.id;
      }
 
      PString PriorityAsString();
@@ -94,6 +99,59 @@ public:
 typedef std::priority_queue< std::pair<PBYTEArray, socketOrder::MessageHeader >, 
         std::vector< std::pair<PBYTEArray, socketOrder::MessageHeader> >, socketOrder > H46026SocketQueue;
 
+/* Scheduler of the messages waiting for the tunnel socket.
+   Each priority has its own FIFO and the FIFOs share the pipe by deficit round
+   robin, each getting a quantum of bytes per round in proportion to its weight,
+   so a burst of video can not hold audio back for longer than one round.
+   A priority may have a deadline; its messages still queued when it passes
+   are dropped rather than sent late.
+ */
+class H46026SocketScheduler {
+public:
+    typedef std::pair<PBYTEArray, socketOrder::MessageHeader> Message;
+
+    H46026SocketScheduler();
+
+    /* Set the share of the pipe a priority gets, at least 1 */
+    void SetWeight(int priority, unsigned weight);
+
+    /* Set how long a message of a priority may wait to be sent, 0 for no limit */
+    void SetDeadline(int priority, unsigned ms);
+    unsigned GetDeadline(int priority) const;
+
+    void Push(const Message & msg);
+    PBoolean IsEmpty() const { return m_count == 0; }
+    PINDEX GetSize() const { return m_count; }
+    PINDEX GetSize(int priority) const;
+
+    /* Next message to send. The queue must not be empty */
+    const Message & Front();
+    void Pop();
+
+    /* Age of the oldest message of a priority, -1 if none are queued */
+    PInt64 GetAge(int priority, PInt64 now) const;
+
+    /* Remove the messages of a priority older than maxAge ms, or all of them
+       if maxAge is negative. The header of each is appended to dropped.
+     */
+    PINDEX Drop(int priority, PInt64 now, PInt64 maxAge, std::vector<socketOrder::MessageHeader> & dropped);
+
+    void Clear();
+
+protected:
+    enum { NumPriorities = socketOrder::Priority_Low };
+    static int Index(int priority);
+    int Select();
+
+    std::deque<Message> m_queue[NumPriorities];
+    unsigned m_weight[NumPriorities];
+    unsigned m_deadline[NumPriorities];
+    PINDEX   m_deficit[NumPriorities];
+    PINDEX   m_count;
+    int      m_active;
+    PBoolean m_credited;
+};
+
 typedef std::map<int,H46026UDPBuffer*> H46026CallMap;
 typedef std::map<unsigned, H46026CallMap >  H46026RTPBuffer;
 
@@ -104,6 +162,7 @@ class H46026_MediaFrame  : public PBYTEArray
 public:
     H46026_MediaFrame();
     H46026_MediaFrame(const BYTE * data, PINDEX len);
+    H46026_MediaFrame(const PBYTEArray & data);   // Shares the buffer, no copy
 
     PBoolean GetMarker() const;
     void PrintInfo(ostream & strm) const;
@@ -129,8 +188,20 @@ public:
     };
 
     /* Set the pipe bandwidth Default is 384k */
+    /* This is the starting point when the bandwidth is estimated from SocketOutFeedback() */
     void SetPipeBandwidth(unsigned bps);
 
+    /* Get the pipe bandwidth, as set or as estimated */
+    unsigned GetPipeBandwidth() const;
+
+    /* Set the share of the pipe each priority gets when the queue is backed up */
+    void SetPriorityWeight(socketOrder::priority priority, unsigned weight);
+
+    /* Set how long a message of a priority may wait to be sent before it is dropped, 0 for no limit.
+       By default only video has a deadline, of two frame times.
+     */
+    void SetPriorityDeadline(socketOrder::priority priority, unsigned ms);
+
     /** Clear Buffers */
     /* Call this is clear the channel buffers at the end of a call */
     /* This MUST be called at the end of a call */
@@ -151,6 +222,11 @@ public:
      */
     virtual void FastUpdatePictureRequired(unsigned /*crv*/, PINDEX /*sessionId*/) {};
 
+    /* Data has been queued for the socket. Called from the thread that posted it,
+       for callers that drive SocketOut() from their own event loop.
+     */
+    virtual void OnSocketOutReady() {};
+
 
     /* Methods */
     /* Sending to the socket */
@@ -169,11 +245,35 @@ public:
             True: data has been copied and ready to send on the wire.
             False: there is no data or data is not ready.
         WARNING: This function does not block and returns immediately if false.
-        Best practise would be to call from a threaded loop and use PThread::Sleep
+        Use the timeout version, or OnSocketOutReady(), rather than polling.
      */
     PBoolean SocketOut(BYTE * data, PINDEX & len);
     PBoolean SocketOut(PBYTEArray & data, PINDEX & len);
 
+    /* Collect an incoming to send to the socket, waiting up to the timeout for
+       one to be queued and for the pipe bandwidth to allow it to be sent.
+       Returns false on timeout or if InterruptSocketOut() was called.
+     */
+    PBoolean SocketOut(BYTE * data, PINDEX & len, const PTimeInterval & timeout);
+
+    /* Collect several queued messages to send to the socket in one write, each
+       framed with its RFC1006 TPKT header. Taken in priority order until the
+       buffer is full or the batch uses up a few milliseconds of the pipe bandwidth.
+       Waits as the timeout version of SocketOut() does.
+     */
+    PBoolean SocketOutBatch(BYTE * data, PINDEX size, PINDEX & len, const PTimeInterval & timeout);
+
+    /* Wake a thread waiting in SocketOut() or SocketOutBatch(), to close the socket.
+     */
+    void InterruptSocketOut();
+
+    /* Report a write to the socket. backlog is the number of bytes the socket still
+       holds unsent after it, or P_MAX_INDEX if not known. The drain rate of the socket
+       estimates the pipe bandwidth, and sending is held back while the backlog is more
+       than a short time of the pipe so messages wait here where they can be scheduled.
+     */
+    void SocketOutFeedback(PINDEX written, PINDEX backlog);
+
     /* Receiving from the socket */
     /* Process an incoming message from the socket.
         Returns false if message could not be handled or decoded into Q931.
@@ -187,9 +287,12 @@ protected:
     PBoolean WriteQueue(const PBYTEArray & data, const socketOrder::MessageHeader & prior);
 
     PBoolean PackageFrame(PBoolean rtp, unsigned crv, PacketTypes id, PINDEX sessionId, H46026_UDPFrame & data);
+    PBoolean MediaFrameOut(unsigned crv, PacketTypes id, PINDEX sessionId, PBoolean rtp, const H46026_MediaFrame & msg);
     H46026UDPBuffer * GetRTPBuffer(unsigned crv, int sessionId);
 
     PBoolean ProcessQueue();
+    PBoolean WaitSocketOut(const PTimeInterval & timeout);
+    int PacketDelay(PINDEX size) const;
 
     unsigned NextPacketCounter();
 
@@ -199,11 +302,18 @@ private:
     PInt64                     m_currentPacketTime;
     unsigned                   m_pktCounter;
 
+    PInt64                     m_feedbackTime;
+    PINDEX                     m_feedbackWritten;
+    PINDEX                     m_feedbackBacklog;
+    PBoolean                   m_feedbackCongested;
+    std::vector<socketOrder::MessageHeader> m_dropped;
+
     H225_H323_UserInformation  m_uuie;
     H46026RTPBuffer            m_rtpBuffer;
     PMutex                     m_writeMutex;
-    H46026SocketQueue          m_socketQueue;
+    H46026SocketScheduler      m_socketQueue;
     PMutex                     m_queueMutex;
+    PSyncPoint                 m_socketOutReady;
 };
 
 
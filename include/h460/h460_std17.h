@@ -46,6 +46,8 @@
 #include <ptlib/plugin.h>
 #include <vector>
 #include <queue>
+#include <deque>
+#include <map>
 
 class H323EndPoint;
 class H323Connection;
@@ -109,6 +111,63 @@ private:
 class H46026Tunnel;
 #endif
 class H46017Handler;
+class H46017Transport;
+
+/**Dispatch of the call signalling received over a H.460.17 tunnel.
+   Every call of the endpoint shares the one tunnel, so handling each
+   message on the thread reading it would hold every call up behind the
+   slowest. Messages are queued per call and a small pool of workers takes
+   them, one message of a call at a time, so the messages of a call are
+   handled in order while a call that blocks only holds up its own worker.
+   Calls with messages waiting are served in turn.
+  */
+class H46017SignalDispatcher : public PObject
+{
+  PCLASSINFO(H46017SignalDispatcher, PObject);
+
+  public:
+    H46017SignalDispatcher(
+      H46017Transport & transport,    /// Transport the messages came in on
+      PINDEX workers                  /// Number of worker threads
+    );
+
+    ~H46017SignalDispatcher();
+
+    /**Queue a message for handling after those of the same call.
+      */
+    void Dispatch(
+      const H323SignalPDU & pdu       /// Message received
+    );
+
+    /**Stop the workers and drop the messages not yet handled.
+      */
+    void Close();
+
+    /**Get the number of messages waiting to be handled.
+      */
+    PINDEX GetQueuedCount() const;
+
+  protected:
+    PDECLARE_NOTIFIER(PThread, H46017SignalDispatcher, WorkerMain);
+
+    struct CallQueue {
+        CallQueue() : busy(false) { }
+        std::queue<H323SignalPDU> pdus;
+        bool busy;                      // A worker is handling a message of the call
+    };
+
+    H46017Transport & m_transport;
+    std::map<unsigned, CallQueue> m_calls;   // By call reference and direction
+    std::deque<unsigned> m_ready;            // Calls with a message and no worker
+    std::vector<PThread *> m_workers;
+    PINDEX m_queued;
+    PBoolean m_shutdown;
+
+    PMutex m_mutex;
+    PSemaphore m_available;
+};
+
+
 class H46017Transport  : public H323TransportTCP
 {
   PCLASSINFO(H46017Transport, H323TransportTCP);
@@ -215,6 +274,8 @@ class H46017Transport  : public H323TransportTCP
 
     PBoolean WriteTunnel(H323SignalPDU & msg);
 
+    friend class H46017SignalDispatcher;
+
      PMutex connectionsMutex;
      PMutex WriteMutex;
      PMutex shutdownMutex;
@@ -226,11 +287,8 @@ class H46017Transport  : public H323TransportTCP
      PBoolean   remoteShutDown;
      PBoolean    closeTransport;
 
-     PSyncPoint  msgRecd;
      PMutex signalMutex;
-     std::queue<H323SignalPDU>  recdpdu;
-     PThread * m_signalProcess;
-     PDECLARE_NOTIFIER(PThread, H46017Transport, SignalProcess);
+     H46017SignalDispatcher * m_dispatcher;
 
  #ifdef H323_H46026
      PBoolean   m_h46026tunnel;
@@ -369,7 +427,8 @@ class H46017RasTransport : public H323TransportUDP
 
   private:
     PSyncPoint  msgRecd;
-    PBYTEArray  recdpdu;
+    PMutex      recdMutex;
+    std::queue<PBYTEArray> recdpdu;   // Several may arrive in one tunnel message
 
     PBoolean    shutdown;
 
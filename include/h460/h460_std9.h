@@ -48,6 +48,7 @@
 
 
 class H4609_ArrayOf_RTCPMeasures;
+class H225_InfoRequestResponse;
 class H460_FeatureStd9 : public H460_FeatureStd
 {
     PCLASSINFO(H460_FeatureStd9,H460_FeatureStd);
@@ -78,6 +79,13 @@ public:
 	virtual PBoolean OnSendInfoRequestResponseMessage(H225_FeatureDescriptor & pdu);
     virtual PBoolean OnSendDisengagementRequestMessage(H225_FeatureDescriptor & pdu);
 
+    /** Merge the periodic reports each call put in an IRR carrying several
+        calls into one report listing all the calls, as the gatekeeper
+        expects. Final reports are left as they are since they do not say
+        which call they are for.
+      */
+    static void MergeReports(H225_InfoRequestResponse & irr);
+
 private:
 	PBoolean GenerateReport(H4609_ArrayOf_RTCPMeasures & report);
 	PBoolean WriteStatisticsReport(H460_FeatureStd & msg, PBoolean final);
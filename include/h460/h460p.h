@@ -51,6 +51,7 @@
 #include <transports.h>
 #include <list>
 #include <map>
+#include <set>
 
 class H323PresenceInstruction  :  public H460P_PresenceInstruction
 {
@@ -468,6 +469,138 @@ private:
 };
 
 
+//////////////////////////////////////////////////////////////////////////////////////////
+
+/** Presence state engine for a gatekeeper with many presentities.
+    The gatekeeper sets the state of each presentity and who watches it, a
+    watching endpoint or a neighbour gatekeeper, and asks the engine for
+    the presence elements waiting for a destination when it sends to it.
+
+    A change of state is held for the hold time, later changes replace it,
+    so a presentity flapping between states publishes at most once per hold
+    time and nothing at all if it ends where it was. A published state is
+    PER encoded once for its version. The element for a destination is the
+    destination's own prefix, a Notify to its alias or an Alert, encoded
+    once per destination, followed by those octets, so a change watched by
+    thousands of endpoints is encoded once and not once per watcher. Each
+    destination collects the presentities changed since it was last sent
+    to and only the latest version of each is sent.
+  */
+class H323PresenceEngine : public PObject
+{
+    PCLASSINFO(H323PresenceEngine, PObject);
+
+public:
+    H323PresenceEngine(const PTimeInterval & holdTime = PTimeInterval(500));
+    ~H323PresenceEngine();
+
+    /** Set the state of a presentity, published after the hold time.
+    */
+    void SetState(const H225_AliasAddress & presentity,     ///< Presentity alias
+                  const H323PresenceNotification & state    ///< New state
+                  );
+
+    /** Get the version of the published state, 0 if none yet.
+    */
+    unsigned GetVersion(const H225_AliasAddress & presentity) const;
+
+    /** Add or remove an endpoint watching a presentity. The alias is the one
+        the notifications are addressed to on the endpoint.
+    */
+    void AddWatcher(const H225_AliasAddress & presentity,
+                    const H225_EndpointIdentifier & ep,
+                    const H225_AliasAddress & alias);
+    void RemoveWatcher(const H225_AliasAddress & presentity,
+                    const H225_EndpointIdentifier & ep);
+
+    /** Add or remove a neighbour gatekeeper watching a presentity, sent
+        the changes as Alert messages.
+    */
+    void AddWatcher(const H225_AliasAddress & presentity,
+                    const H225_TransportAddress & gk);
+    void RemoveWatcher(const H225_AliasAddress & presentity,
+                    const H225_TransportAddress & gk);
+
+    /** Remove an endpoint from everything it watches, on unregistration.
+    */
+    void RemoveEndpoint(const H225_EndpointIdentifier & ep);
+
+    /** Remove a presentity and its watchers.
+    */
+    void RemovePresentity(const H225_AliasAddress & presentity);
+
+    /** Take the presence elements waiting for a destination, one per
+        presentity changed since the last call. Returns FALSE if none.
+    */
+    PBoolean BuildPresenceElement(const H225_EndpointIdentifier & ep,
+                    list<PASN_OctetString> & pdu);
+    PBoolean BuildPresenceElement(const H225_TransportAddress & gk,
+                    list<PASN_OctetString> & pdu);
+
+    /** Publish the changes that have been held for the hold time.
+        Called by the engine timer, may be called to publish sooner.
+    */
+    void Publish();
+
+    /** Get the number of states encoded and elements built.
+    */
+    PUInt64 GetEncodeCount() const { return m_encodeCount; }
+    PUInt64 GetElementCount() const { return m_elementCount; }
+
+protected:
+    /** Called, without the engine locked, when a destination first has
+        elements waiting, so the gatekeeper can send them. By default does nothing.
+    */
+    virtual void OnPending(const H225_EndpointIdentifier & /*ep*/) {}
+    virtual void OnPending(const H225_TransportAddress & /*gk*/) {}
+
+    struct Presentity {
+        Presentity() : m_version(0), m_pending(false), m_pendingSince(0) {}
+
+        H225_AliasAddress        m_alias;
+        H323PresenceNotification m_state;        ///< Published state
+        PBYTEArray               m_encoded;      ///< m_state PER encoded on its own
+        unsigned                 m_version;
+        H323PresenceNotification m_next;         ///< State held for the hold time
+        bool                     m_pending;
+        PInt64                   m_pendingSince;
+        std::set<PString>        m_endpoints;    ///< Watching destinations
+        std::set<PString>        m_gatekeepers;
+    };
+
+    struct Destination {
+        Destination() : m_watching(0) {}
+
+        H225_EndpointIdentifier  m_endpoint;
+        H225_TransportAddress    m_gatekeeper;
+        H225_AliasAddress        m_alias;        ///< Endpoint alias notified
+        PBYTEArray               m_prefix;       ///< Element up to the notification
+        std::set<PString>        m_waiting;      ///< Presentities changed since last taken
+        unsigned                 m_watching;
+    };
+
+    typedef std::map<PString, Presentity>  PresentityMap;
+    typedef std::map<PString, Destination> DestinationMap;
+
+    void Unwatch(Presentity & pres, const PString & key, DestinationMap & dests, bool endpoint);
+    PBoolean BuildElements(Destination & dest, bool endpoint, list<PASN_OctetString> & pdu);
+    void BuildElement(const Destination & dest, bool endpoint, const H323PresenceNotification * state, H460P_PresenceElement & element) const;
+
+    PDECLARE_NOTIFIER(PTimer, H323PresenceEngine, OnPublishTimer);
+
+    PTimeInterval    m_holdTime;
+    PresentityMap    m_presentities;
+    std::set<PString> m_pendingPresentities;
+    DestinationMap   m_endpoints;
+    DestinationMap   m_gatekeepers;
+    int              m_spliceChecked;   ///< 0 not yet, 1 prefix and state octets give the PDU, -1 they do not
+    PUInt64          m_encodeCount;
+    PUInt64          m_elementCount;
+    PTimer           m_publishTimer;
+    mutable PMutex   m_mutex;
+};
+
+
 #endif
 
 
@@ -39,6 +39,9 @@
 
 
 #include "rtp.h"
+#include "h323lockprof.h"
+
+#include <vector>
 
 class RTP_JitterBufferAnalyser;
 class RTP_AggregatedHandle;
@@ -63,13 +66,26 @@ class RTP_JitterBuffer : public PObject
 //    PINDEX GetSize() const { return bufferSize; }
     /**Set the maximum delay the jitter buffer will operate to.
       */
-    void SetDelay(
+    virtual void SetDelay(
       unsigned minJitterDelay, ///<  Minimum delay in RTP timestamp units
       unsigned maxJitterDelay  ///<  Maximum delay in RTP timestamp units
     );
 
     void UseImmediateReduction(PBoolean state) { doJitterReductionImmediately = state; }
 
+    /**Raise the minimum delay by an amount, in RTP timestamp units, to
+       play audio later for lip sync with video. The total is kept within
+       the maximum delay. Called by the thread reading the buffer, a later
+       SetDelay() clears it.
+      */
+    void SetSyncDelay(
+      DWORD delay              ///<  Delay added to the minimum
+    );
+
+    /**Get the delay added to the minimum for lip sync.
+      */
+    DWORD GetSyncDelay() const { return syncDelay; }
+
     /**Reset Firt write
 		This is used when redirecting media flows to ensure Jitter buffer is not exceeded.
       */
@@ -97,6 +113,20 @@ class RTP_JitterBuffer : public PObject
       */
     DWORD GetBufferOverruns() const { return bufferOverruns; }
 
+    /**Get number of received packets read into a recycled free frame.
+      */
+    DWORD GetFramePoolHits() const { return framePoolHits; }
+
+    /**Get number of received packets that found no free frame, the oldest
+       frame in the buffer was reused instead.
+      */
+    DWORD GetFramePoolMisses() const { return bufferOverruns; }
+
+    /**Get number of frames that had to be copied rather than swapped when
+       handed to the reader, because the readers frame was too small.
+      */
+    DWORD GetFrameCopies() const { return frameCopies; }
+
     /**Get maximum consecutive marker bits before buffer starts to ignore them.
       */
     DWORD GetMaxConsecutiveMarkerBits() const { return maxConsecutiveMarkerBits; }
@@ -115,15 +145,46 @@ class RTP_JitterBuffer : public PObject
 
     PDECLARE_NOTIFIER(PThread, RTP_JitterBuffer, JitterThreadMain);
 
+    /**Indicate the buffer is fed by a media reactor instead of its own thread.
+      */
+    void SetReactorDriven() { reactorDriven = TRUE; }
+
+    /**Indicate if the buffer is fed by a media reactor.
+      */
+    PBoolean IsReactorDriven() const { return reactorDriven; }
+
+    /**Read the frame waiting on the session into the buffer.
+       This is called from a media reactor thread when the data socket is
+       readable. Returns FALSE if the session has been aborted.
+      */
+    PBoolean OnReactorData();
+
+    /**Indicate the buffer is fed by the thread calling ReadData() instead of
+       its own thread. Each ReadData() then first pulls whatever is waiting
+       on the session into the buffer without blocking.
+      */
+    void SetPullDriven() { pullDriven = TRUE; }
+
+    /**Indicate if the buffer is fed by the thread calling ReadData().
+      */
+    PBoolean IsPullDriven() const { return pullDriven; }
+
+    /**The media reactor has stopped servicing the session.
+       Any subsequent ReadData() will return FALSE until SetDelay() is called.
+      */
+    void OnReactorClosed() { shuttingDown = TRUE; }
+
   protected:
     //virtual void Main();
 
     class Entry : public RTP_DataFrame
     {
       public:
+        Entry() : tick(0) { }
+
         Entry * next;
         Entry * prev;
-        PTimeInterval tick;
+        PInt64 tick;      ///< Arrival, microseconds of the media clock
     };
 
     RTP_Session & session;
@@ -136,23 +197,26 @@ class RTP_JitterBuffer : public PObject
     DWORD    currentJitterTime;
     DWORD    packetsTooLate;
     unsigned bufferOverruns;
+    DWORD    framePoolHits;
+    DWORD    frameCopies;
     unsigned consecutiveBufferOverruns;
     DWORD    consecutiveMarkerBits;
     PTimeInterval    consecutiveEarlyPacketStartTime;
     DWORD    lastWriteTimestamp;
-    PTimeInterval lastWriteTick;
+    PInt64   lastWriteTick;
     DWORD    jitterCalc;
     DWORD    targetJitterTime;
     unsigned jitterCalcPacketCount;
     PBoolean     doJitterReductionImmediately;
     PBoolean     doneFreeTrash;
+    DWORD        syncDelay;       ///< Part of minJitterTime added by SetSyncDelay()
 
     Entry * oldestFrame;
     Entry * newestFrame;
     Entry * freeFrames;
     Entry * currentWriteFrame;
 
-    PMutex bufferMutex;
+    H323ProfiledMutex bufferMutex;
     PBoolean   shuttingDown;
     PBoolean   preBuffering;
     PBoolean   doneFirstWrite;
@@ -162,14 +226,205 @@ class RTP_JitterBuffer : public PObject
     PThread * jitterThread;
     PINDEX    jitterStackSize;
 
+    PBoolean  reactorDriven;
+    PBoolean  reactorMarkerWarning;
+    PBoolean  pullDriven;
+
 #ifdef H323_RTP_AGGREGATE
     RTP_AggregatedHandle * aggregratedHandle;
 #endif
 
-    PBoolean Init(Entry * & currentReadFrame, PBoolean & markerWarning);
-    PBoolean PreRead(Entry * & currentReadFrame, PBoolean & markerWarning);
-    PBoolean OnRead(Entry * & currentReadFrame, PBoolean & markerWarning, PBoolean loop);
-    void DeInit(Entry * & currentReadFrame, PBoolean & markerWarning);
+    virtual PBoolean Init(Entry * & currentReadFrame, PBoolean & markerWarning);
+    virtual PBoolean PreRead(Entry * & currentReadFrame, PBoolean & markerWarning);
+    virtual PBoolean OnRead(Entry * & currentReadFrame, PBoolean & markerWarning, PBoolean loop);
+    void QueueFrame(Entry * currentReadFrame, PBoolean & markerWarning);
+    void CheckMarker(Entry * currentReadFrame, PBoolean & markerWarning);
+
+    /**Called with the buffer locked as each received frame is queued.
+      */
+    virtual void OnFrameArrival(Entry & /*frame*/) { }
+
+    /**Called with the buffer locked as each frame is played, to adjust
+       targetJitterTime. The default follows the largest recent jitter.
+      */
+    virtual void AdaptTarget(Entry & writeFrame);
+
+    virtual void DeInit(Entry * & currentReadFrame, PBoolean & markerWarning);
+    void HandOver(RTP_DataFrame & frame);
+    void StopReceive();
+    virtual RTP_Session::SendReceiveStatus ReceiveFrame(PBoolean poll);
+    PBoolean PullFrames();
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**Jitter buffer using a ring of frames indexed by RTP sequence number.
+   There is exactly one thread writing received frames into the ring (the
+   jitter thread, aggregator or media reactor) and one thread reading them
+   out for the codec, so each slot is handed between the two by a
+   published sequence tag rather than a mutex. Insertion and playout are
+   both O(1), late (out of window) packets are discarded rather than
+   sorted into a list.
+
+   The adaptive delay is the same as RTP_JitterBuffer, except that an
+   immediate reduction discards the oldest frames instead of the newest.
+   The ring size is fixed by the maximum delay given at construction, a
+   later SetDelay() cannot make it larger.
+  */
+class RTP_RingJitterBuffer : public RTP_JitterBuffer
+{
+  PCLASSINFO(RTP_RingJitterBuffer, RTP_JitterBuffer);
+
+  public:
+    RTP_RingJitterBuffer(
+      RTP_Session & session,   ///<  Associated RTP session to read data from
+      unsigned minJitterDelay, ///<  Minimum delay in RTP timestamp units
+      unsigned maxJitterDelay, ///<  Maximum delay in RTP timestamp units
+      PINDEX stackSize = 30000 ///<  Stack size for jitter thread
+    );
+    ~RTP_RingJitterBuffer();
+
+    virtual void SetDelay(
+      unsigned minJitterDelay, ///<  Minimum delay in RTP timestamp units
+      unsigned maxJitterDelay  ///<  Maximum delay in RTP timestamp units
+    );
+
+    virtual PBoolean ReadData(
+      DWORD timestamp,        ///<  Timestamp to read from buffer.
+      RTP_DataFrame & frame   ///<  Frame read from the RTP session
+    );
+
+  protected:
+    virtual PBoolean Init(Entry * & currentReadFrame, PBoolean & markerWarning);
+    virtual PBoolean PreRead(Entry * & currentReadFrame, PBoolean & markerWarning);
+    virtual PBoolean OnRead(Entry * & currentReadFrame, PBoolean & markerWarning, PBoolean loop);
+    virtual void DeInit(Entry * & currentReadFrame, PBoolean & markerWarning);
+    virtual RTP_Session::SendReceiveStatus ReceiveFrame(PBoolean poll);
+
+    void InsertFrame(Entry * currentReadFrame);
+    PBoolean FindOldest();
+    void ReleaseOldest();
+    Entry * SkipOldest();
+    void PlayOldest(RTP_DataFrame & frame);
+    void Flush();
+
+    // Ring slots, tags are zero when free or the sequence number of the frame
+    // with the full bit set. Only the receive side sets a tag, only the
+    // playout side clears it.
+    PINDEX           ringSize;
+    Entry         ** ring;
+    volatile DWORD * tags;
+    Entry          * spareFrame;
+
+    // Written by receive side
+    volatile DWORD    latestSequence;
+    volatile DWORD    latestTimestamp;
+    volatile PBoolean haveLatest;
+    volatile PBoolean flushRequest;
+    volatile DWORD    framesIn;
+
+    // Written by playout side
+    volatile DWORD    playoutSequence;
+    volatile PBoolean playoutValid;
+    volatile DWORD    framesOut;
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**Jitter buffer that sets its delay from the distribution of packet delays.
+   The delay of each received packet, relative to the fastest recent packet,
+   is counted in a histogram whose counts are halved at intervals so the
+   buffer follows changing network conditions. The target delay is the
+   delay within which 95 percent of packets arrived, plus one frame, so the
+   rate of packets too late to play stays about the same as the network
+   changes while the delay is no longer than it needs to be.
+
+   When the buffer holds more than the target during a talk burst the delay
+   is brought down a frame at a time rather than waiting for a silence.
+   OnReduceDelay() is called first, so an application that time stretches
+   the decoded audio can speed up playout itself instead of a frame being
+   dropped. With SetTimeStretch() the default asks the reader, through
+   TakeTimeStretchRequest(), to have the codec shorten a frame. Changes of target and reductions are recorded by the jitter
+   analyser when it is compiled in.
+  */
+class RTP_AdaptiveJitterBuffer : public RTP_JitterBuffer
+{
+  PCLASSINFO(RTP_AdaptiveJitterBuffer, RTP_JitterBuffer);
+
+  public:
+    RTP_AdaptiveJitterBuffer(
+      RTP_Session & session,   ///<  Associated RTP session to read data from
+      unsigned minJitterDelay, ///<  Minimum delay in RTP timestamp units
+      unsigned maxJitterDelay, ///<  Maximum delay in RTP timestamp units
+      PINDEX stackSize = 30000 ///<  Stack size for jitter thread
+    );
+
+    virtual PBoolean ReadData(
+      DWORD timestamp,        ///<  Timestamp to read from buffer.
+      RTP_DataFrame & frame   ///<  Frame read from the RTP session
+    );
+
+    /**Get the delay the buffer is adapting to, in RTP timestamp units.
+      */
+    DWORD GetTargetJitterTime() const { return targetJitterTime; }
+
+    /**Get the delay within which the percentile of packets arrived.
+      */
+    DWORD GetPercentileDelay() const { return percentileDelay; }
+
+    /**Get the number of frames dropped to bring the delay down.
+      */
+    DWORD GetDelayReductions() const { return delayReductions; }
+
+    /**Set the delay to be brought down by the reader speeding up playout,
+       rather than by dropping frames.
+      */
+    void SetTimeStretch(
+      PBoolean enable         ///<  Reader takes time stretch requests
+    ) { timeStretch = enable; }
+
+    /**Take a request to speed up playout, made since the last call.
+      */
+    PBoolean TakeTimeStretchRequest();
+
+    /**Get the number of requests to speed up playout.
+      */
+    DWORD GetTimeStretchRequests() const { return stretchRequests; }
+
+  protected:
+    virtual void OnFrameArrival(Entry & frame);
+    virtual void AdaptTarget(Entry & writeFrame);
+
+    /**Called when the buffer holds more than the target delay while frames
+       are being played. Return TRUE if the application has sped up playout
+       to take up the excess, FALSE to drop a frame.
+       The default behaviour makes a time stretch request if SetTimeStretch()
+       is enabled and the last one was taken, and otherwise returns FALSE.
+      */
+    virtual PBoolean OnReduceDelay(
+      DWORD excess            ///<  Delay over the target in RTP timestamp units
+    );
+
+    void ResetHistogram();
+
+    std::vector<DWORD> histogram;   // Packets by delay over the fastest
+    DWORD    histogramTotal;
+    DWORD    arrivals;              // Since the counts were last halved
+    int      minRelativeDelay;      // Arrival time less timestamp of the fastest packet
+    int      periodMinDelay;        // Of the packets since the counts were halved
+    PBoolean haveMinDelay;
+    DWORD    lastArrivalSequence;
+    DWORD    lastArrivalTimestamp;
+    PBoolean haveLastArrival;
+    DWORD    frameTime;             // Timestamp units per frame
+    DWORD    percentileDelay;
+    unsigned framesSinceReduction;
+    DWORD    delayReductions;
+    PBoolean timeStretch;
+    PBoolean stretchPending;
+    DWORD    stretchRequests;
 };
 
 #endif // __OPAL_JITTER_H
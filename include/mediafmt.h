@@ -38,6 +38,8 @@
 #include "rtp.h"
 
 #include <limits>
+#include <map>
+#include <vector>
 
 #ifdef min
 #undef min
@@ -51,6 +53,42 @@ class OpalMediaFormat;
 
 ///////////////////////////////////////////////////////////////////////////////
 
+/**Interned name of a media format option. The name is looked up once, when
+   the key is made, so getting an option by key on a per frame or per
+   capability path is an index into a table of the media format rather than
+   a search by name. Keys are meant to be static, eg
+
+     static const OpalMediaOptionKey MyOptionKey("My Option");
+
+   Names are compared without case, as OpalMediaOption does.
+  */
+class OpalMediaOptionKey
+{
+  public:
+    explicit OpalMediaOptionKey(
+      const char * name   ///<  Option name
+    );
+
+    /**Get the interned number of the name, never zero.
+      */
+    unsigned GetID() const { return id; }
+
+    /**Get the option name.
+      */
+    const char * GetName() const { return name; }
+
+    /**Get the interned number of a name, interning it the first time.
+      */
+    static unsigned Intern(
+      const PString & name
+    );
+
+  protected:
+    const char * name;
+    unsigned     id;
+};
+
+
 /**Base class for options attached to an OpalMediaFormat.
   */
 class OpalMediaOption : public PObject
@@ -97,6 +135,15 @@ class OpalMediaOption : public PObject
 
     const PString & GetName() const { return m_name; }
 
+    /**Get the interned number of the name, see OpalMediaOptionKey.
+      */
+    unsigned GetKeyID() const
+    {
+      if (m_keyID == 0)
+        m_keyID = OpalMediaOptionKey::Intern(m_name);
+      return m_keyID;
+    }
+
     bool IsReadOnly() const { return m_readOnly; }
     void SetReadOnly(bool readOnly) { m_readOnly = readOnly; }
 
@@ -131,6 +178,7 @@ class OpalMediaOption : public PObject
 
   protected:
     PCaselessString m_name;
+    mutable unsigned m_keyID;     ///< Interned on first use, zero before
     bool            m_readOnly;
     MergeType       m_merge;
     PCaselessString m_FMTPName;
@@ -456,6 +504,11 @@ class OpalMediaFormat : public PCaselessString
     static List GetRegisteredMediaFormats();
     static void GetRegisteredMediaFormats(List & list);
 
+    /**Get the interned number of the registered format of this name, see
+       OpalMediaFormatRegistry::GetID().
+      */
+    unsigned GetFormatID() const;
+
     friend class OpalStaticMediaFormat;
 
     /**This form of the constructor will register the full details of the
@@ -519,6 +572,22 @@ class OpalMediaFormat : public PCaselessString
       bool value              ///<  New value for option
     );
 
+    /**Get the option value of the specified key as a boolean, as
+       GetOptionBoolean() by name does but without searching.
+      */
+    bool GetOptionBoolean(
+      const OpalMediaOptionKey & key,   ///<  Option key
+      bool dflt = FALSE                 ///<  Default value if option not present
+    ) const;
+
+    /**Set the option value of the specified key as a boolean, as
+       SetOptionBoolean() by name does but without searching.
+      */
+    bool SetOptionBoolean(
+      const OpalMediaOptionKey & key,   ///<  Option key
+      bool value                        ///<  New value for option
+    );
+
     /**Get the option value of the specified name as an integer. The default
        value is returned if the option is not present.
       */
@@ -539,6 +608,22 @@ class OpalMediaFormat : public PCaselessString
       int value               ///<  New value for option
     );
 
+    /**Get the option value of the specified key as an integer, as
+       GetOptionInteger() by name does but without searching.
+      */
+    int GetOptionInteger(
+      const OpalMediaOptionKey & key,   ///<  Option key
+      int dflt = 0                      ///<  Default value if option not present
+    ) const;
+
+    /**Set the option value of the specified key as an integer, as
+       SetOptionInteger() by name does but without searching.
+      */
+    bool SetOptionInteger(
+      const OpalMediaOptionKey & key,   ///<  Option key
+      int value                         ///<  New value for option
+    );
+
     /**Get the option value of the specified name as a real. The default
        value is returned if the option is not present.
       */
@@ -641,7 +726,14 @@ class OpalMediaFormat : public PCaselessString
       * Remove all options
       */
     void RemoveAllOptions() 
-    { options.RemoveAll(); }
+    { options.RemoveAll(); optionTableValid = false; optionsRevision = NextOptionsRevision(); }
+
+    /**Get the revision of the options. It changes whenever an option is
+       set, added or removed, and no two formats with different options
+       have the same revision, so anything worked out from the options,
+       such as an encoded capability, can be kept until it changes.
+      */
+    unsigned GetOptionsRevision() const { return optionsRevision; }
     
     /**
       * Determine if media format has the specified option.
@@ -657,6 +749,15 @@ class OpalMediaFormat : public PCaselessString
       const PString & name
     ) const;
 
+    /**
+      * Get a pointer to the media format option of the key, from a table
+      * indexed by the key built on first use.
+      * Returns NULL if the option does not exist.
+      */
+    OpalMediaOption * FindOption(
+      const OpalMediaOptionKey & key
+    ) const;
+
 	OpalMediaOption & GetOption(PINDEX i) const
 	{ return options[i];  }
 
@@ -679,6 +780,14 @@ class OpalMediaFormat : public PCaselessString
     PSortedList<OpalMediaOption> options;
     time_t codecBaseTime;
 
+    // Options by key ID, valid until the options are added to or copied
+    void MakeOptionsUnique();
+    mutable std::vector<OpalMediaOption *> optionTable;
+    mutable bool optionTableValid;
+
+    static unsigned NextOptionsRevision();
+    unsigned optionsRevision;
+
 };
 
 #ifdef H323_VIDEO
@@ -718,6 +827,20 @@ class OpalVideoFormat : public OpalMediaFormat
     static const char * const EmphasisSpeedOption;
     static const char * const MaxPayloadSizeOption;
 
+    // Keys of the options above, for per frame use
+    static const OpalMediaOptionKey FrameWidthKey;
+    static const OpalMediaOptionKey FrameHeightKey;
+    static const OpalMediaOptionKey EncodingQualityKey;
+    static const OpalMediaOptionKey TargetBitRateKey;
+    static const OpalMediaOptionKey DynamicVideoQualityKey;
+    static const OpalMediaOptionKey AdaptivePacketDelayKey;
+    static const OpalMediaOptionKey NeedsJitterKey;
+    static const OpalMediaOptionKey MaxBitRateKey;
+    static const OpalMediaOptionKey MaxFrameSizeKey;
+    static const OpalMediaOptionKey FrameTimeKey;
+    static const OpalMediaOptionKey ClockRateKey;
+    static const OpalMediaOptionKey EmphasisSpeedKey;
+    static const OpalMediaOptionKey MaxPayloadSizeKey;
 };
 #endif
 // List of known media formats
@@ -808,6 +931,64 @@ extern char OpalGSM0610[];
 
 typedef PFactory<OpalMediaFormat, std::string> OpalMediaFormatFactory;
 
+
+/**Index of the formats registered in OpalMediaFormatFactory.
+   Looking a format up by name used to walk, and on newer PTLib copy, the
+   factory key list. The index holds the registered formats by name,
+   remembers the result of each partial name search, and gives every name
+   registered a number that stays the same for the life of the process, so
+   a format can be kept and compared as an integer.
+
+   Look ups share a read lock, the index is only locked for writing to be
+   rebuilt after Invalidate() or to remember a new search. Code that
+   registers or unregisters formats calls Invalidate().
+  */
+class OpalMediaFormatRegistry
+{
+  public:
+    enum { UnknownID = 0 };
+
+    /**Copy the registered format matching the name, exactly or the first in
+       name order containing it. Returns FALSE if there is none.
+      */
+    static PBoolean Find(
+      const PString & search,     ///<  Name to search for
+      PBoolean exact,             ///<  Flag for if search is to match name exactly
+      OpalMediaFormat & format    ///<  Copy of the registered format
+    );
+
+    /**Copy the registered format with the interned number.
+      */
+    static PBoolean Find(
+      unsigned id,                ///<  Number from GetID()
+      OpalMediaFormat & format    ///<  Copy of the registered format
+    );
+
+    /**Get the interned number of a registered format name, UnknownID if no
+       format of that name is registered.
+      */
+    static unsigned GetID(
+      const PString & name        ///<  Full name of media format
+    );
+
+    /**Get the name a number was interned for, empty if none.
+      */
+    static PString GetName(
+      unsigned id                 ///<  Number from GetID()
+    );
+
+    /**Get the registered formats in name order.
+      */
+    static void GetFormats(
+      OpalMediaFormat::List & list
+    );
+
+    /**Note the factory has changed, the index is rebuilt on the next look up.
+       This takes no lock so may be called with the factory locked.
+      */
+    static void Invalidate();
+};
+
 #define OPAL_MEDIA_FORMAT_DECLARE(classname, _fullName, _defaultSessionID, _rtpPayloadType, _needsJitter,_bandwidth, _frameSize, _frameTime, _timeUnits, _timeStamp) \
 class classname : public OpalMediaFormat \
 { \
@@ -817,6 +998,7 @@ class classname : public OpalMediaFormat \
         _frameSize, _frameTime, _timeUnits, _timeStamp){} \
 }; \
 OpalMediaFormatFactory::Worker<classname> classname##Factory(_fullName, true); \
+static const bool classname##Indexed = (OpalMediaFormatRegistry::Invalidate(), true); \
 
 
 #endif  // __OPAL_MEDIAFMT_H
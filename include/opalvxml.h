@@ -88,7 +88,59 @@ class G7231_File_Capability : public H323AudioCapability
 
 #ifdef P_VXML
 
-class PTextToSpeech;
+#include <ptclib/ptts.h>
+
+/**Prompts spoken by text to speech, rendered once and shared by every
+   session. The first request for a text in a voice renders it to a WAV
+   file in the cache directory, named from a hash of the text, voice and
+   text type, and later ones find the file there, also after a restart.
+   The file is then loaded by an OpalWAVPromptCache in the media format of
+   the session, so static menu text heard by thousands of callers is
+   synthesised and encoded once.
+  */
+class OpalVXMLPromptCache : public PObject
+{
+  PCLASSINFO(OpalVXMLPromptCache, PObject);
+
+  public:
+    /**Create a cache keeping the rendered files in the directory given.
+      */
+    OpalVXMLPromptCache(
+      const PDirectory & directory
+    );
+
+    /**Get the prompt of a text, rendering it with the engine the first
+       time. The prompt must be given back by OpalWAVPromptCache::Release().
+       Returns NULL if the text could not be rendered or loaded.
+      */
+    const OpalWAVPrompt * Acquire(
+      PTextToSpeech & tts,              ///< Engine to render with
+      const PString & text,             ///< Text to speak
+      PTextToSpeech::TextType type,     ///< Type of text
+      const PString & voice,            ///< Voice, empty for the engine default
+      const PString & format            ///< Media format wanted
+    );
+
+    /**Get the cache of loaded prompts, also used for prompt files.
+      */
+    OpalWAVPromptCache & GetWAVCache() { return wavCache; }
+
+    /**Get the directory of rendered files.
+      */
+    const PDirectory & GetDirectory() const { return directory; }
+
+  protected:
+    PFilePath GetFilePath(
+      const PString & text,
+      PTextToSpeech::TextType type,
+      const PString & voice
+    ) const;
+
+    PDirectory         directory;
+    OpalWAVPromptCache wavCache;
+    PMutex             renderMutex;
+};
+
 
 class OpalVXMLSession : public PVXMLSession 
 {
@@ -97,8 +149,48 @@ class OpalVXMLSession : public PVXMLSession
     OpalVXMLSession(H323Connection * _conn, PTextToSpeech * tts = NULL, PBoolean autoDelete = FALSE);
     PBoolean Close();
 
+    /**Play text from the prompt cache, if one is set, in the media format
+       of the VXML channel. Falls back to PVXMLSession when the text cannot
+       be rendered or converted to that format.
+      */
+    virtual PBoolean PlayText(
+      const PString & text,
+      PTextToSpeech::TextType type = PTextToSpeech::Default,
+      PINDEX repeat = 1,
+      PINDEX delay = 0
+    );
+
+    /**Play a prompt file from the prompt cache, if one is set, so it is
+       not read and converted again for every call. Temporary files to be
+       deleted after playing are not cached.
+      */
+    virtual PBoolean PlayFile(
+      const PString & fn,
+      PINDEX repeat = 1,
+      PINDEX delay = 0,
+      PBoolean autoDelete = FALSE
+    );
+
+    /**Set the cache of rendered prompts, shared with other sessions and
+       not deleted by the session. NULL renders every prompt again.
+      */
+    void SetPromptCache(
+      OpalVXMLPromptCache * cache
+    ) { promptCache = cache; }
+
+    /**Set the voice of text to speech, part of the prompt cache key.
+      */
+    void SetVoice(
+      const PString & voice
+    );
+
   protected:
+    PString GetChannelFormat();
+    PBoolean PlayPrompt(const OpalWAVPrompt * prompt, PINDEX repeat, PINDEX delay);
+
     H323Connection * conn;
+    OpalVXMLPromptCache * promptCache;
+    PString voice;
 };
 
 #endif
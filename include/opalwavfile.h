@@ -35,6 +35,8 @@
 
 #include <ptclib/pwavfile.h>
 
+#include <map>
+
 /**This class is similar to the PWavFile class found in the PWlib
    components library. However, it will tranparently convert all data
    to/from PCM format, allowing applications to be unconcerned with 
@@ -98,6 +100,168 @@ class OpalWAVFile : public PWAVFile
     );
 };
 
+
+
+/**A WAV file loaded once and held, converted to one format, for playing to
+   many channels at the same time. Prompts are got from an
+   OpalWAVPromptCache, which shares one between every caller asking for
+   the same file in the same format, and are not changed once loaded.
+
+   When the file already holds the format asked for, for example a uLaw
+   file wanted as G.711-uLaw-64k or a 16 bit PCM file wanted as PCM-16, the
+   data is not copied but read directly from the file mapped into memory.
+  */
+class OpalWAVPrompt : public PObject
+{
+  PCLASSINFO(OpalWAVPrompt, PObject);
+  public:
+    ~OpalWAVPrompt();
+
+    /**Get the media format the data is in, eg PCM-16 or G.711-uLaw-64k.
+      */
+    const PString & GetFormat() const { return format; }
+
+    /**Get the file the prompt was loaded from.
+      */
+    const PFilePath & GetFilePath() const { return filename; }
+
+    /**Get the data of the prompt.
+      */
+    const BYTE * GetData() const { return data; }
+
+    /**Get the number of bytes of data.
+      */
+    PINDEX GetSize() const { return size; }
+
+    /**Get the bytes of each encoded frame, zero for a sample based format
+       such as PCM or G.711 that may be cut anywhere.
+      */
+    PINDEX GetFrameSize() const { return frameSize; }
+
+    /**Get the sample rate of the audio.
+      */
+    unsigned GetSampleRate() const { return sampleRate; }
+
+    /**Indicate the data is read from the mapped file rather than a copy.
+      */
+    PBoolean IsMapped() const { return mapping != NULL; }
+
+  protected:
+    OpalWAVPrompt(const PFilePath & filename, const PString & format);
+
+    PBoolean Load();
+    PBoolean Map();
+    void Unmap();
+    PBoolean Convert(unsigned sourceFormat, const BYTE * source, PINDEX sourceSize);
+
+    PFilePath    filename;
+    PString      format;
+    const BYTE * data;
+    PINDEX       size;
+    PINDEX       frameSize;
+    unsigned     sampleRate;
+    PBYTEArray   converted;
+
+    void       * mapping;       ///< File mapped into memory, NULL if not mapped
+    PINDEX       mappingSize;
+#ifdef _WIN32
+    HANDLE       mappingHandle;
+#endif
+
+    mutable PAtomicInteger references;
+    friend class OpalWAVPromptCache;
+};
+
+
+/**A cache of prompts shared between the channels playing them.
+   The first Acquire() of a file in a format loads and converts it, later
+   ones return the same prompt, so a prompt heard by thousands of calls is
+   read and converted once.
+  */
+class OpalWAVPromptCache : public PObject
+{
+  PCLASSINFO(OpalWAVPromptCache, PObject);
+  public:
+    OpalWAVPromptCache();
+
+    /**Release every prompt. Prompts still acquired stay valid until
+       they are released.
+      */
+    ~OpalWAVPromptCache();
+
+    /**Get a prompt, loading it if not already cached.
+       The format is a media format name: PCM-16, G.711-uLaw-64k and
+       G.711-ALaw-64k are converted directly, others are encoded by the plug
+       in codec from PCM, frame by frame. The file may be 8 kHz mono PCM,
+       uLaw or aLaw. The prompt must be given back by Release().
+       Returns NULL if the file could not be loaded.
+      */
+    const OpalWAVPrompt * Acquire(
+      const PFilePath & filename,
+      const PString & format = "PCM-16"
+    );
+
+    /**Give back a prompt from Acquire().
+      */
+    static void Release(
+      const OpalWAVPrompt * prompt
+    );
+
+    /**Remove a file from the cache in every format, so it is loaded again
+       by the next Acquire(), eg after it is changed on disk.
+      */
+    void Remove(
+      const PFilePath & filename
+    );
+
+    /**Remove every prompt from the cache.
+      */
+    void RemoveAll();
+
+    /**Get the number of prompts cached.
+      */
+    PINDEX GetSize() const;
+
+  protected:
+    typedef std::map<PString, OpalWAVPrompt *> PromptMap;
+    PromptMap      prompts;     ///< By file name and format
+    mutable PMutex mutex;
+};
+
+
+/**Channel reading a cached prompt, for attaching to an audio codec in place
+   of an OpalWAVFile. Each channel keeps its own position in the shared
+   data.
+  */
+class OpalWAVPromptChannel : public PChannel
+{
+  PCLASSINFO(OpalWAVPromptChannel, PChannel);
+  public:
+    /**Create a channel reading a prompt, taking over the reference from
+       OpalWAVPromptCache::Acquire().
+      */
+    OpalWAVPromptChannel(
+      const OpalWAVPrompt * prompt,
+      PBoolean loop = FALSE          ///< Start again at the end rather than stop
+    );
+
+    ~OpalWAVPromptChannel();
+
+    virtual PBoolean Read(void * buf, PINDEX len);
+    virtual PBoolean Write(const void * buf, PINDEX len);
+    virtual PBoolean Close();
+    virtual PBoolean IsOpen() const { return prompt != NULL; }
+
+    /**Get the prompt being read.
+      */
+    const OpalWAVPrompt * GetPrompt() const { return prompt; }
+
+  protected:
+    const OpalWAVPrompt * prompt;
+    PINDEX   position;
+    PBoolean loop;
+};
+
 #endif // __OPALWAVFILE_H
 
 
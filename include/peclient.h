@@ -41,6 +41,8 @@
 
 #include <ptlib/safecoll.h>
 
+#include <map>
+
 
 class H323PeerElement;
 
@@ -117,6 +119,10 @@ class H501DescriptorUpdate : public H501Transaction
       unsigned reasonCode
     );
 
+    /**Apply updates on the background worker, behind no route lookups.
+      */
+    virtual H323Transactor::RequestQueue GetQueue() const;
+
     H501_DescriptorUpdate & du;
     H501_DescriptorUpdateAck & ack;
 
@@ -143,6 +149,11 @@ class H501AccessRequest : public H501Transaction
       unsigned reasonCode
     );
 
+    /**Look up routes on any worker, first when overloaded.
+      */
+    virtual H323Transactor::RequestPriority GetPriority() const;
+    virtual H323Transactor::RequestQueue GetQueue() const;
+
     H501_AccessRequest & arq;
     H501_AccessConfirmation & acf;
     H501_AccessRejection  & arj;
@@ -152,6 +163,33 @@ class H501AccessRequest : public H501Transaction
 };
 
 
+////////////////////////////////////////////////////////////////
+
+class H501DescriptorIDRequest : public H501Transaction
+{
+    PCLASSINFO(H501DescriptorIDRequest, H501Transaction);
+  public:
+    H501DescriptorIDRequest(
+      H323PeerElement & pe,
+      const H501PDU & pdu
+    );
+
+#if PTRACING
+    virtual const char * GetName() const;
+#endif
+    virtual void SetRejectReason(
+      unsigned reasonCode
+    );
+
+    H501_DescriptorIDRequest & drq;
+    H501_DescriptorIDConfirmation & dcf;
+    H501_DescriptorIDRejection  & drj;
+
+  protected:
+    virtual Response OnHandlePDU();
+};
+
+
 ////////////////////////////////////////////////////////////////
 
 class H323PeerElementDescriptor : public PSafeObject
@@ -159,7 +197,7 @@ class H323PeerElementDescriptor : public PSafeObject
   PCLASSINFO(H323PeerElementDescriptor, PSafeObject);
   public:
     H323PeerElementDescriptor(const OpalGloballyUniqueID & _descriptorID)
-      : descriptorID(_descriptorID), state(Dirty), creator(0)
+      : descriptorID(_descriptorID), state(Dirty), creator(0), version(0)
     { }
 
     Comparison Compare(const PObject & obj) const;
@@ -208,6 +246,7 @@ class H323PeerElementDescriptor : public PSafeObject
     PString gatekeeperID;
     PTime lastChanged;
     POrdinalKey creator;
+    PUInt64 version;      ///< Table version of the last local change, 0 if learned from a peer
 };
 
 
@@ -218,11 +257,11 @@ class H323PeerElementServiceRelationship : public PSafeObject
     PCLASSINFO(H323PeerElementServiceRelationship, PSafeObject);
   public:
     H323PeerElementServiceRelationship()
-      : ordinal(0)
+      : ordinal(0), descriptorVersion(0)
       { }
 
     H323PeerElementServiceRelationship(const OpalGloballyUniqueID & _serviceID)
-      : serviceID(_serviceID), ordinal(0)
+      : serviceID(_serviceID), ordinal(0), descriptorVersion(0)
       { }
 
     Comparison Compare(const PObject & obj) const
@@ -235,6 +274,7 @@ class H323PeerElementServiceRelationship : public PSafeObject
     PTime createdTime;
     PTime lastUpdateTime;
     PTime expireTime;
+    PUInt64 descriptorVersion;  ///< Table version the peer has been sent, 0 before the first full update
 };
 
 
@@ -278,6 +318,15 @@ class H323PeerElement : public H323_AnnexG
       RemoteServiceRelationshipOrdinal = 2
     };
 
+    /**Worker threads handling received requests, started with the peer
+       element. Access requests go to the least busy of them and
+       descriptor updates to a background worker, so route lookups are not
+       held up while a peer sends its descriptor table.
+      */
+    enum {
+      DefaultWorkerThreads = 2
+    };
+
   /**@name Overrides from PObject */
   //@{
     /**Print the name of the peer element.
@@ -377,6 +426,19 @@ class H323PeerElement : public H323_AnnexG
     PBoolean DeleteDescriptor(const H225_AliasAddress & alias, PBoolean now = FALSE);
     PBoolean DeleteDescriptor(const OpalGloballyUniqueID & descriptorID, PBoolean now = FALSE);
 
+    /**Find the descriptor in the local table routing an alias.
+       A specific pattern equal to the alias is found first, then the
+       wildcard pattern that is the longest leading part of an E.164 alias,
+       or for other aliases of the form user@domain the one naming the
+       domain or its nearest parent domain. Lookups are by index so take the
+       same time however many descriptors there are.
+      */
+    PSafePtr<H323PeerElementDescriptor> FindDescriptor(
+      const H225_AliasAddress & alias,    ///< Alias to route
+      PINDEX & templateIndex,             ///< Address template that matched
+      PSafetyMode mode = PSafeReadOnly    ///< Lock mode of the descriptor
+    );
+
     /** Request access to an alias
     */
     PBoolean AccessRequest(
@@ -410,9 +472,29 @@ class H323PeerElement : public H323_AnnexG
     /*********************************************************
       functions to send send descriptors to another peer element
       */
+
+    /**Mark a descriptor as changed and send the changes to every peer now.
+       The descriptor should not be locked by the caller.
+      */
     PBoolean UpdateDescriptor(H323PeerElementDescriptor * descriptor);
     PBoolean UpdateDescriptor(H323PeerElementDescriptor * descriptor, H501_UpdateInformation_updateType::Choices updateType);
 
+    /**Send every peer the descriptors changed or deleted since it was last
+       updated, several to a DescriptorUpdate. A peer of a new service
+       relationship is sent the whole table, less the descriptors it says
+       it already has in answer to a DescriptorIDRequest, as happens when
+       this peer element restarts. Returns FALSE if any peer could not be
+       updated, it is tried again by the monitor thread.
+      */
+    PBoolean SendDescriptorChanges();
+    Error SendDescriptorChangesByID(const OpalGloballyUniqueID & serviceID);
+
+    Error SendUpdateDescriptorsByID(const OpalGloballyUniqueID & serviceID, 
+                                     const H501_ArrayOf_UpdateInformation & updates);
+
+    Error SendDescriptorIDRequestByID(const OpalGloballyUniqueID & serviceID, 
+                                                            H501PDU & confirmPDU);
+
 
     Error SendUpdateDescriptorByID(const OpalGloballyUniqueID & serviceID, 
                                     H323PeerElementDescriptor * descriptor, 
@@ -447,6 +529,7 @@ class H323PeerElement : public H323_AnnexG
     virtual H323Transaction::Response OnServiceRequest(H501ServiceRequest & info);
     virtual H323Transaction::Response OnDescriptorUpdate(H501DescriptorUpdate & info);
     virtual H323Transaction::Response OnAccessRequest(H501AccessRequest & info);
+    virtual H323Transaction::Response OnDescriptorIDRequest(H501DescriptorIDRequest & info);
 
     PBoolean OnReceiveServiceRequest(const H501PDU & pdu, const H501_ServiceRequest & pduBody);
     PBoolean OnReceiveServiceConfirmation(const H501PDU & pdu, const H501_ServiceConfirmation & pduBody);
@@ -458,6 +541,9 @@ class H323PeerElement : public H323_AnnexG
     PBoolean OnReceiveAccessConfirmation (const H501PDU & pdu, const H501_AccessConfirmation & pduBody);
     PBoolean OnReceiveAccessRejection(const H501PDU & pdu,     const H501_AccessRejection & pduBody);
 
+    PBoolean OnReceiveDescriptorIDRequest(const H501PDU & pdu, const H501_DescriptorIDRequest & pduBody);
+    PBoolean OnReceiveDescriptorIDConfirmation(const H501PDU & pdu, const H501_DescriptorIDConfirmation & pduBody);
+
     class AliasKey : public H225_AliasAddress
     {
       public:
@@ -478,6 +564,11 @@ class H323PeerElement : public H323_AnnexG
                            H323PeerElementDescriptor * descriptor,
             H501_UpdateInformation_updateType::Choices updateType);
 
+    Error SendUpdateDescriptor(              H501PDU & pdu,  
+                          const H323TransportAddress & peer);
+
+    void MarkDescriptorChanged(H323PeerElementDescriptor & descriptor, H323PeerElementDescriptor::States state);
+
     PBoolean OnRemoteServiceRelationshipDisappeared(OpalGloballyUniqueID & serviceID, const H323TransportAddress & peer);
     void InternalRemoveServiceRelationship(const H323TransportAddress & peer);
     H323Transaction::Response HandleServiceRequest(H501ServiceRequest & info);
@@ -486,7 +577,9 @@ class H323PeerElement : public H323_AnnexG
     virtual H323PeerElementServiceRelationship * CreateServiceRelationship();
     virtual AliasKey                           * CreateAliasKey(const H225_AliasAddress & alias, const OpalGloballyUniqueID & id, PINDEX pos, PBoolean wild = FALSE);
 
-    void RemoveDescriptorInformation(const H501_ArrayOf_AddressTemplate & addressTemplates);
+    void AddDescriptorInformation(const OpalGloballyUniqueID & descriptorID, const H501_ArrayOf_AddressTemplate & addressTemplates);
+    void RemoveDescriptorInformation(const OpalGloballyUniqueID & descriptorID, const H501_ArrayOf_AddressTemplate & addressTemplates);
+    PBoolean ApplyDescriptorUpdate(const POrdinalKey & creator, const H501_UpdateInformation & update);
 
     PDECLARE_NOTIFIER(PThread, H323PeerElement, MonitorMain);
     PDECLARE_NOTIFIER(PThread, H323PeerElement, UpdateAllDescriptors);
@@ -518,12 +611,23 @@ class H323PeerElement : public H323_AnnexG
 
     PSafeSortedList<H323PeerElementDescriptor> descriptors;
 
-    PSORTED_LIST(AliasKeyList, H225_AliasAddress);
+    // every local change to the descriptor table takes the next version
+    PMutex descriptorVersionMutex;
+    PUInt64 descriptorTableVersion;
+    PBoolean descriptorUpdateRunning;
+
+    // Keys by alias type and text, wildcards without any leading '@' or '*.'
+    typedef std::multimap<PString, AliasKey *> AliasKeyIndex;
+
+    static PString GetAliasIndexKey(const H225_AliasAddress & alias, PBoolean wild = FALSE);
+    void AddAliasKey(AliasKeyIndex & index, const H225_AliasAddress & alias, const OpalGloballyUniqueID & id, PINDEX pos, PBoolean wild = FALSE);
+    static void RemoveAliasKey(AliasKeyIndex & index, const H225_AliasAddress & alias, const OpalGloballyUniqueID & id, PBoolean wild = FALSE);
+    const AliasKey * FindAliasKey(const H225_AliasAddress & alias) const;
 
     PMutex aliasMutex;
-    AliasKeyList transportAddressToDescriptorID;
-    AliasKeyList specificAliasToDescriptorID;
-    AliasKeyList wildcardAliasToDescriptorID;
+    AliasKeyIndex transportAddressToDescriptorID;
+    AliasKeyIndex specificAliasToDescriptorID;
+    AliasKeyIndex wildcardAliasToDescriptorID;
 };
 
 
@@ -42,6 +42,7 @@
 #define _PTLIB_EXTRAS_H
 
 #include "openh323buildopts.h"
+#include "h323mediaclock.h"
 
 #include <ptclib/delaychan.h>
 #include <algorithm>
@@ -58,6 +59,44 @@
 #define H323_INT P_INT_PTR
 #endif
 
+// Full memory barrier for data handed between threads without a mutex
+#if defined(_WIN32)
+#define H323_MEMORY_BARRIER() MemoryBarrier()
+#elif defined(__GNUC__)
+#define H323_MEMORY_BARRIER() __sync_synchronize()
+#else
+#define H323_MEMORY_BARRIER()
+#endif
+
+// Atomic add to a 64 bit value shared between threads
+#if defined(_WIN32)
+#define H323_ATOMIC_ADD64(ptr, value) InterlockedExchangeAdd64((volatile LONGLONG *)(ptr), (value))
+#elif defined(__GNUC__)
+#define H323_ATOMIC_ADD64(ptr, value) __sync_fetch_and_add((ptr), (value))
+#else
+#define H323_ATOMIC_ADD64(ptr, value) (*(ptr) += (value))
+#endif
+
+// Atomic compare and swap of a 32 bit value, evaluates to the value before
+#if defined(_WIN32)
+#define H323_ATOMIC_CAS32(ptr, oldValue, newValue) \
+          (unsigned)InterlockedCompareExchange((volatile LONG *)(ptr), (LONG)(newValue), (LONG)(oldValue))
+#elif defined(__GNUC__)
+#define H323_ATOMIC_CAS32(ptr, oldValue, newValue) __sync_val_compare_and_swap((ptr), (oldValue), (newValue))
+#else
+#define H323_ATOMIC_CAS32(ptr, oldValue, newValue) (*(ptr) == (oldValue) ? (*(ptr) = (newValue), (oldValue)) : *(ptr))
+#endif
+
+// Address the calling function returns to, to identify a call site
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define H323_RETURN_ADDRESS() _ReturnAddress()
+#elif defined(__GNUC__)
+#define H323_RETURN_ADDRESS() __builtin_return_address(0)
+#else
+#define H323_RETURN_ADDRESS() NULL
+#endif
+
 #ifndef H323_STLDICTIONARY
 
 #define H323Dictionary  PDictionary
@@ -840,7 +879,7 @@ public:
 
                 // fixed local render clock
                 if (m_RenderTimeStamp == 0)
-                    m_RenderTimeStamp = PTimer::Tick().GetMilliSeconds();
+                    m_RenderTimeStamp = H323MediaClock::GetMilliseconds();
 
                 PBoolean flow = false;
 
@@ -855,7 +894,7 @@ public:
                         delay = (m_buffer.top().first.m_timeStamp - lastTimeStamp)/(unsigned)m_calcClockRate;
                         if (delay <= 0 || delay > 200 || (lastTimeStamp > m_buffer.top().first.m_timeStamp)) {
                            delay = 0;
-                           m_RenderTimeStamp = PTimer::Tick().GetMilliSeconds();
+                           m_RenderTimeStamp = H323MediaClock::GetMilliseconds();
                            fup = true;
                         } 
                     }
@@ -890,7 +929,7 @@ public:
                             m_increaseBuffer=false;
                         }
                       m_RenderTimeStamp+=delay;
-                      PInt64 nowTime = PTimer::Tick().GetMilliSeconds();
+                      PInt64 nowTime = H323MediaClock::GetMilliseconds();
                       unsigned ldelay = (unsigned)((m_RenderTimeStamp > nowTime)? m_RenderTimeStamp - nowTime : 0);
                       if (ldelay > 200 || m_frameMarker > 5) ldelay = 0;
                       if (!ldelay)  m_RenderTimeStamp = nowTime;
@@ -920,18 +959,18 @@ public:
         if (m_exit)
             return false;
 
-        PInt64 now = PTimer::Tick().GetMilliSeconds();
+        PInt64 now = H323MediaClock::GetMilliseconds();
         // IF we haven't started or the clockrate goes out of bounds.
         if (!m_frameStartTime) {
             m_frameStartTime = time;
-            m_StartTimeStamp = PTimer::Tick().GetMilliSeconds();
+            m_StartTimeStamp = H323MediaClock::GetMilliseconds();
         } else if (marker && m_frameOutput) {
-            m_calcClockRate = (float)(time - m_frameStartTime)/(PTimer::Tick().GetMilliSeconds() - m_StartTimeStamp);
+            m_calcClockRate = (float)(time - m_frameStartTime)/(H323MediaClock::GetMilliseconds() - m_StartTimeStamp);
             if (m_calcClockRate > 100 || m_calcClockRate < 40 || (m_calcClockRate == numeric_limits<unsigned int>::infinity( ))) {
                 PTRACE(4,"RTPBUF\tErroneous ClockRate: Resetting...");
                 m_calcClockRate = 90;
                 m_frameStartTime = time;
-                m_StartTimeStamp = PTimer::Tick().GetMilliSeconds();
+                m_StartTimeStamp = H323MediaClock::GetMilliseconds();
             }
         }
             
@@ -131,6 +131,10 @@ class Q931 : public PObject
 
     PBoolean HasIE(InformationElementCodes ie) const;
     PBYTEArray GetIE(InformationElementCodes ie) const;
+    /**Get an information element without copying it, the pointer being
+       valid until the Q931 is next changed. Returns FALSE if absent.
+      */
+    PBoolean GetIE(InformationElementCodes ie, const BYTE * & data, PINDEX & length) const;
     void SetIE(InformationElementCodes ie, const PBYTEArray & userData);
     void RemoveIE(InformationElementCodes ie);
 
@@ -466,8 +470,20 @@ class Q931 : public PObject
     unsigned protocolDiscriminator;
     MsgTypes messageType;
 
-    H323DICTIONARY(InternalInformationElements, POrdinalKey, PBYTEArray);
-    InternalInformationElements informationElements;
+    void ClearIEs();
+    void CompactIEs();
+
+    // Information elements indexed by code, each a view into ieData. A
+    // decoded PDU copies its buffer there once, so parsing allocates
+    // nothing per element.
+    enum { NumIECodes = 256 };
+    struct InformationElement {
+      PINDEX offset;        ///< Into ieData, P_MAX_INDEX if absent
+      PINDEX length;
+    };
+    InformationElement informationElements[NumIECodes];
+    PBYTEArray ieData;
+    PINDEX     ieUsed;      ///< Bytes of ieData still viewed
 };
 
 
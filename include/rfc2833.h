@@ -35,6 +35,12 @@
 
 
 #include "rtp.h"
+#include "h323timer.h"
+
+#include <map>
+#include <vector>
+
+class OpalRFC2833Scheduler;
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -67,6 +73,8 @@ class OpalRFC2833 : public PObject {
       const PNotifier & receiveNotifier
     );
 
+    ~OpalRFC2833();
+
     virtual PBoolean SendTone(
       char tone,              ///<  DTMF tone code
       unsigned duration       ///<  Duration of tone in milliseconds
@@ -95,12 +103,40 @@ class OpalRFC2833 : public PObject {
     const PNotifier & GetReceiveHandler() const { return receiveHandler; }
     const PNotifier & GetTransmitHandler() const { return transmitHandler; }
 
+    /**Set the scheduler timing the events, in place of the timers of this
+       handler. NULL goes back to the timers.
+      */
+    void SetScheduler(
+      OpalRFC2833Scheduler * scheduler
+    );
+
+    /**Set the session events are sent on by the scheduler.
+       With a session and a scheduler, a tone starts on the next audio
+       packet and from then the scheduler sends it every 50ms, and three
+       times when it ends, while the audio packets are held back. Without
+       them each audio packet is replaced by the tone. Set to NULL before
+       the session is released.
+      */
+    void SetTransmitSession(
+      RTP_Session * session
+    );
+
+    /**Called by the scheduler when this handler is due.
+       Returns the tick next due, zero if nothing is pending.
+      */
+    virtual PInt64 OnScheduled(
+      PInt64 now
+    );
+
   protected:
+    void SetReceiveTimeout();
+    void WriteEvent(PInt64 now);
+
     PMutex mutex;
     PDECLARE_NOTIFIER(RTP_DataFrame, OpalRFC2833, ReceivedPacket);
     PDECLARE_NOTIFIER(RTP_DataFrame, OpalRFC2833, TransmitPacket);
-    PDECLARE_NOTIFIER(PTimer, OpalRFC2833, ReceiveTimeout);
-    PDECLARE_NOTIFIER(PTimer, OpalRFC2833, TransmitEnded);
+    PDECLARE_NOTIFIER(H323Timer, OpalRFC2833, ReceiveTimeout);
+    PDECLARE_NOTIFIER(H323Timer, OpalRFC2833, TransmitEnded);
 
     PNotifier receiveNotifier;
     PNotifier receiveHandler;
@@ -111,7 +147,7 @@ class OpalRFC2833 : public PObject {
     BYTE      receivedTone;
     unsigned  receivedDuration;
     unsigned  receiveTimestamp;
-    PTimer    receiveTimer;
+    H323Timer receiveTimer;
 
     enum {
       TransmitIdle,
@@ -120,7 +156,87 @@ class OpalRFC2833 : public PObject {
     }         transmitState;
     BYTE      transmitCode;
     unsigned  transmitTimestamp;
-    PTimer    transmitTimer;
+    H323Timer transmitTimer;
+
+    OpalRFC2833Scheduler * scheduler;
+    RTP_Session * transmitSession;
+    RTP_DataFrame transmitFrame;           ///< Event packet sent by the scheduler
+    PInt64    receiveDeadline;             ///< Tick the received tone times out, zero if none
+    PInt64    transmitStartTick;
+    PInt64    transmitEndTick;             ///< Tick SendTone() ends the tone, zero if none
+    PInt64    nextTransmitTick;
+    unsigned  transmitDuration;            ///< Frozen for the end packets
+    unsigned  endRepeats;
+};
+
+
+/**Timing of the RFC 2833 events of every call on one thread.
+   Each handler is kept ordered by the tick it is next due, for the timeout
+   of a received tone, the end of a tone given a duration and the repeats of
+   a tone being sent, so a call needs no timers of its own and events are
+   sent at their times whatever the audio thread is doing.
+  */
+class OpalRFC2833Scheduler : public PObject
+{
+  PCLASSINFO(OpalRFC2833Scheduler, PObject);
+
+  public:
+  /**@name Construction */
+  //@{
+    /**Create the scheduler and start its thread.
+      */
+    OpalRFC2833Scheduler(
+      PThread::Priority priority = PThread::HighestPriority ///< Priority of the thread
+    );
+
+    /**Stop the scheduler thread.
+       All handlers should have been removed before this is called.
+      */
+    ~OpalRFC2833Scheduler();
+  //@}
+
+  /**@name Operations */
+  //@{
+    /**Make a handler due no later than a tick, adding it if needed.
+      */
+    void Schedule(
+      OpalRFC2833 & handler,  ///< Handler to call
+      PInt64 due              ///< Tick to call it by
+    );
+
+    /**Remove a handler.
+       On return the scheduler thread is not inside any call to the handler,
+       so it may be deleted. Must not be called holding the handler mutex.
+      */
+    void Remove(
+      OpalRFC2833 & handler   ///< Handler to remove
+    );
+
+    /**Get the number of handlers scheduled and not removed.
+      */
+    PINDEX GetHandlerCount() const { return handlers.size(); }
+  //@}
+
+  protected:
+    class Thread;
+    friend class Thread;
+
+    void Main();
+    PBoolean Insert(OpalRFC2833 & handler, PInt64 due);
+
+    typedef std::multimap<PInt64, OpalRFC2833 *> DueMap;
+    typedef std::map<OpalRFC2833 *, DueMap::iterator> HandlerMap;
+
+    DueMap     dueHandlers;     ///< Handlers by tick they are due
+    HandlerMap handlers;        ///< Position of each handler in dueHandlers, end() if not due
+    std::vector<OpalRFC2833 *> dueBatch;          ///< Reused by the thread for each wake up
+    std::vector<std::pair<OpalRFC2833 *, PInt64> > nextDue;
+    PBoolean   shutdown;
+
+    PMutex     mutex;           ///< Protects the maps
+    PMutex     callMutex;       ///< Held while the thread calls a batch of handlers
+    PSyncPoint wakeUp;
+    Thread   * thread;
 };
 
 
@@ -41,8 +41,17 @@
 #include <ptlib/sockets.h>
 
 #include "ptlib_extras.h"
+#include "rtphist.h"
+#include "h323hottrace.h"
 
 class RTP_JitterBuffer;
+class RTP_MediaReactor;
+class RTP_ReportScheduler;
+class RTP_PortPool;
+class RTP_DatagramBatch;
+class RTP_RedundantDecoder;
+class RTP_RetransmitHistory;
+class RTP_NackGenerator;
 class PHandleAggregator;
 
 #ifdef P_STUN
@@ -83,7 +92,8 @@ class RTP_DataFrame : public PBYTEArray
 
     enum {
       ProtocolVersion = 2,
-      MinHeaderSize = 12
+      MinHeaderSize = 12,
+      OneByteExtensionProfile = 0xBEDE    ///< RFC 5285 one byte header extensions
     };
 
     enum PayloadTypes {
@@ -155,16 +165,59 @@ class RTP_DataFrame : public PBYTEArray
 
     int GetExtensionType() const; // -1 is no extension
     void   SetExtensionType(int type);
-    PINDEX GetExtensionSize() const;
+    PINDEX GetExtensionSize() const;  // In 32 bit words
     PBoolean   SetExtensionSize(PINDEX sz);
     BYTE * GetExtensionPtr() const;
 
+    /**Get an element of an RFC 5285 one byte header extension, NULL if the
+       frame has none with the ID.
+      */
+    const BYTE * GetHeaderExtension(
+      unsigned id,      ///< Element ID, 1 to 14
+      PINDEX & length   ///< Length of the element data
+    ) const;
+
+    /**Set an element of an RFC 5285 one byte header extension, replacing
+       one with the same ID and keeping the others. The payload is moved
+       after the extension. Fails if the frame has another type of
+       extension.
+      */
+    PBoolean SetHeaderExtension(
+      unsigned id,          ///< Element ID, 1 to 14
+      const BYTE * data,    ///< Element data
+      PINDEX length         ///< Length of the data, 1 to 16
+    );
+
+    /**Get the RFC 6464 client to mixer audio level, in -dBov from 0, the
+       loudest, to 127, and whether the sender detected voice.
+      */
+    PBoolean GetAudioLevel(
+      unsigned id,          ///< Header extension element ID
+      unsigned & level,     ///< Level in -dBov
+      PBoolean & voice      ///< Voice activity
+    ) const;
+
+    /**Set the RFC 6464 client to mixer audio level.
+      */
+    PBoolean SetAudioLevel(
+      unsigned id,          ///< Header extension element ID
+      unsigned level,       ///< Level in -dBov, 127 at most
+      PBoolean voice        ///< Voice activity
+    );
+
     PINDEX GetPayloadSize() const { return payloadSize; }
     PBoolean   SetPayloadSize(PINDEX sz);
     BYTE * GetPayloadPtr()     const { return (BYTE *)(theArray+GetHeaderSize()); }
 
     PBoolean IsValid() const;
 
+    /**Exchange the packet buffer of this frame with another frame.
+       Only the buffer references are swapped so no data is copied and no
+       memory allocated. This is used to hand frames between the jitter
+       buffer and the codec without copying.
+      */
+    void Swap(RTP_DataFrame & other);
+
   protected:
     PINDEX payloadSize;
 
@@ -233,7 +286,12 @@ class RTP_ControlFrame : public PBYTEArray
       e_ReceiverReport,
       e_SourceDescription,
       e_Goodbye,
-      e_ApplDefined
+      e_ApplDefined,
+      e_TransportFeedback   ///< RFC 4585 transport layer feedback
+    };
+
+    enum TransportFeedbackTypes {
+      e_GenericNACK = 1
     };
 
     unsigned GetPayloadType() const { return (BYTE)theArray[compoundOffset+1]; }
@@ -249,6 +307,21 @@ class RTP_ControlFrame : public PBYTEArray
 
     PINDEX GetCompoundSize() const { return compoundSize; }
 
+    /**Clear the frame to build a new compound packet, keeping the memory.
+      */
+    void Reset();
+
+    /**Set the size of a received compound packet held in the frame and
+       go back to its first packet. The memory is left as it is, so a frame
+       can be reused for every read without being resized.
+      */
+    void SetPacketSize(PINDEX size);
+
+    /**Get the size of the received compound packet, the whole frame if
+       SetPacketSize() has not been called.
+      */
+    PINDEX GetPacketSize() const { return packetSize > 0 ? packetSize : GetSize(); }
+
 #pragma pack(1)
     struct ReceiverReport {
       PUInt32b ssrc;      /* data source being reported */
@@ -311,6 +384,7 @@ class RTP_ControlFrame : public PBYTEArray
   protected:
     PINDEX compoundOffset;
     PINDEX compoundSize;
+    PINDEX packetSize;
 };
 
 /**This class is for encapsulating the Multiplexing of RTCP.
@@ -378,6 +452,14 @@ class RTP_Session : public PObject
 
   /**@name Operations */
   //@{
+    /**Jitter buffer implementations.
+      */
+    enum JitterBufferEngine {
+      e_ListJitterBuffer,   ///< Sorted list of frames under a mutex
+      e_RingJitterBuffer,   ///< Lock free ring indexed by sequence number
+      e_AdaptiveJitterBuffer ///< Delay from the percentile of packet delays
+    };
+
     /**Sets the size of the jitter buffer to be used by this RTP session.
        A session default to not having any jitter buffer enabled for reading
        and the ReadBufferedData() function simply calls ReadData(). Once a
@@ -386,11 +468,15 @@ class RTP_Session : public PObject
        
        If the jitterDelay paramter is zero, it destroys the jitter buffer
        attached to this RTP session.
+
+       The engine is only used when the jitter buffer is created, a later
+       call only adjusts the delay of the existing buffer.
       */
     void SetJitterBufferSize(
       unsigned minJitterDelay, ///<  Minimum jitter buffer delay in RTP timestamp units
       unsigned maxJitterDelay, ///<  Maximum jitter buffer delay in RTP timestamp units
-      PINDEX stackSize = 30000 ///<  Stack size for jitter thread
+      PINDEX stackSize = 30000, ///<  Stack size for jitter thread
+      JitterBufferEngine engine = e_ListJitterBuffer ///< Jitter buffer implementation
     );
 
     /**Get current size of the jitter buffer.
@@ -400,6 +486,27 @@ class RTP_Session : public PObject
       */
     unsigned GetJitterBufferSize() const;
 
+    /**Have the jitter buffer ask the reader to speed up playout, rather than
+       drop frames, to bring its delay down.
+       Returns FALSE if the jitter buffer engine cannot, only the adaptive
+       engine does.
+      */
+    PBoolean SetTimeStretch(
+      PBoolean enable   ///<  Reader takes time stretch requests
+    );
+
+    /**Take a request from the jitter buffer to speed up playout.
+      */
+    PBoolean TakeTimeStretchRequest();
+
+    /**Raise the jitter buffer minimum delay, in RTP timestamp units, for
+       lip sync. Called by the thread reading the jitter buffer. Does
+       nothing without a jitter buffer.
+      */
+    void SetJitterSyncDelay(
+      unsigned delay    ///<  Delay added to the minimum
+    );
+
     /**Modifies the QOS specifications for this RTP session*/
     virtual PBoolean ModifyQOS(RTP_QOS * )
     { return FALSE; }
@@ -449,10 +556,33 @@ class RTP_Session : public PObject
       RTP_ControlFrame & frame    ///<  Frame to write to the RTP session
     ) = 0;
 
+    /**Set queuing of written data frames.
+       When enabled, and supported by the session, data frames are collected
+       until one with the marker bit set (or the queue is full) and then
+       sent together. This is used for video where a frame spans many packets.
+      */
+    virtual void SetQueueWrites(
+      PBoolean /*queue*/    ///<  Queue data frames
+    ) { }
+
+    /**Get the number of data frames queued and not yet sent.
+      */
+    virtual PINDEX GetQueuedWrites() const { return 0; }
+
     /**Write the RTCP reports.
+       This is called from the media path and sends a report if one is due,
+       unless a report scheduler sends them for the session.
       */
     virtual PBoolean SendReport();
 
+    /**Build the RTCP compound report for the session in the frame and
+       write it. Returns TRUE without writing if nothing has been sent or
+       received yet.
+      */
+    PBoolean WriteReport(
+      RTP_ControlFrame & report   ///<  Frame to build the report in, reset first
+    );
+
     /**Close down the RTP session.
       */
     virtual void Close(
@@ -512,6 +642,16 @@ class RTP_Session : public PObject
                                     const ReceiverReportArray & reports);
     virtual bool AVSyncData(SenderReport & sender);
 
+    /**Get the latest report the remote made on the packets we send, if one
+       arrived since the sequence given, which is then updated. Start the
+       sequence at 0. This lets the transmit thread poll for the reports
+       the receive thread gets.
+      */
+    PBoolean GetLatestReceiverReport(
+      ReceiverReport & report,    ///< Report on our source
+      unsigned & sequence         ///< Sequence of the last report taken
+    );
+
     class SourceDescription : public PObject  {
         PCLASSINFO(SourceDescription, PObject);
       public:
@@ -531,6 +671,126 @@ class RTP_Session : public PObject
                                  const BYTE * data, PINDEX size);
   //@}
 
+  /**@name Media reactor support */
+  //@{
+    /**Set the media reactor used to service this session.
+       If set, the jitter buffer of the session is fed by one of the reactor
+       threads rather than a thread of its own.
+      */
+    void SetMediaReactor(
+      RTP_MediaReactor * reactor   ///<  Reactor to use, NULL for a dedicated thread
+    ) { mediaReactor = reactor; }
+
+    /**Get the media reactor used to service this session.
+      */
+    RTP_MediaReactor * GetMediaReactor() const { return mediaReactor; }
+
+    /**Set the scheduler that sends the RTCP reports of this session.
+       If set, SendReport() from the media path does nothing and the reports
+       go out from the scheduler thread. Set NULL to remove the session from
+       the scheduler, which a derived class must do in its destructor as the
+       scheduler calls WriteControl().
+      */
+    void SetReportScheduler(
+      RTP_ReportScheduler * scheduler   ///<  Scheduler to use, NULL to report from the media path
+    );
+
+    /**Get the scheduler that sends the RTCP reports of this session.
+      */
+    RTP_ReportScheduler * GetReportScheduler() const { return reportScheduler; }
+
+    /**Set the jitter buffer of the session to be fed by the thread reading it.
+       When set no thread or reactor services the socket, each call to
+       ReadBufferedData() first pulls whatever is waiting on the socket into
+       the jitter buffer without blocking. This takes precedence over a media
+       reactor and must be set before SetJitterBufferSize().
+      */
+    void SetJitterPullMode(
+      PBoolean mode    ///<  Pull frames from the reading thread
+    ) { jitterPullMode = mode; }
+
+    /**Get the flag for the jitter buffer being fed by the thread reading it.
+      */
+    PBoolean GetJitterPullMode() const { return jitterPullMode; }
+
+    /**Read a single data frame that is known to be waiting on the session,
+       without blocking.
+       The default behaviour calls ReadData() without looping.
+      */
+    virtual SendReceiveStatus ReadPendingData(
+      RTP_DataFrame & frame   ///<  Frame read from the RTP session
+    );
+
+    /**Read a data frame if one is waiting on the session, without blocking.
+       Any control frames waiting are processed. Returns e_IgnorePacket if
+       no data frame was waiting.
+       The default behaviour returns e_IgnorePacket.
+      */
+    virtual SendReceiveStatus PollData(
+      RTP_DataFrame & frame   ///<  Frame read from the RTP session
+    );
+
+    /**Set a handler called from a media reactor thread with each data frame
+       received, for a session with no jitter buffer whose packets are
+       handled as they arrive, eg H.224, so it needs no receive thread of
+       its own. The notifier gets the RTP_DataFrame and an extra of zero, or
+       of one once when the read side is closed. Pass a NULL notifier to stop,
+       on return the handler is not being called.
+       Returns FALSE if the session has no reactor or a jitter buffer, in
+       which case the caller reads the session from its own thread.
+      */
+    PBoolean SetReactorDataHandler(
+      const PNotifier & handler   ///<  Handler of received frames
+    );
+
+    /**Called from a media reactor thread when a socket of the session is
+       readable. Returns FALSE if the session is to be removed from the
+       reactor, eg on the read side being closed.
+       The default behaviour returns FALSE.
+      */
+    virtual PBoolean OnReactorEvent(
+      PBoolean dataReady    ///<  TRUE for the data socket, FALSE for control
+    );
+  //@}
+
+  /**@name Retransmission */
+  //@{
+    /**Keep the last packets sent to send again when the receiver reports
+       them lost with RTCP generic NACKs (RFC 4585). They are sent as RFC
+       4588 retransmissions of the payload type given, before the next
+       packet written, so from the thread sending on the session.
+       Must be set before the first packet is sent.
+      */
+    void SetRetransmission(
+      RTP_DataFrame::PayloadTypes payloadType,  ///<  Payload type of retransmissions
+      PINDEX depth = 512                        ///<  Packets kept
+    );
+
+    /**Ask for packets found lost with RTCP generic NACKs, and put back the
+       retransmissions of the payload type given as the packets they carry.
+       Must be set before the first packet is received.
+      */
+    void SetNackGeneration(
+      RTP_DataFrame::PayloadTypes payloadType   ///<  Payload type of retransmissions
+    );
+
+    /**Determine if packets are kept for retransmission.
+      */
+    PBoolean IsRetransmitting() const { return retransmitHistory != NULL; }
+
+    /**Determine if lost packets are asked for.
+      */
+    PBoolean IsGeneratingNacks() const { return nackGenerator != NULL; }
+
+    /**Get the number of packets sent again for the receiver.
+      */
+    unsigned GetPacketsRetransmitted() const;
+
+    /**Get the number of lost packets repaired by retransmissions.
+      */
+    unsigned GetPacketsRepaired() const;
+  //@}
+
   /**@name Member variable access */
   //@{
     /**Get the ID for the RTP session.
@@ -646,6 +906,15 @@ class RTP_Session : public PObject
       */
     DWORD GetOctetsSent() const { return octetsSent; }
 
+    /**Get the timestamp of the last packet sent in session.
+      */
+    DWORD GetLastSentTimestamp() const { return lastSentTimestamp; }
+
+    /**Leave a gap in the sequence numbers of sent packets, so a relayed
+       stream shows the receiver the packets lost before it was relayed.
+      */
+    void SkipSequenceNumbers(WORD count) { lastSentSequenceNumber += count; }
+
     /**Get total number of packets received in session.
       */
     DWORD GetPacketsReceived() const { return packetsReceived; }
@@ -666,6 +935,18 @@ class RTP_Session : public PObject
       */
     DWORD GetPacketsTooLate() const;
 
+    /**Get number of times the jitter buffer overran and discarded frames.
+      */
+    DWORD GetBufferOverruns() const;
+
+    /**Get number of received packets read into a recycled jitter buffer frame.
+      */
+    DWORD GetFramePoolHits() const;
+
+    /**Get number of received packets that found no free jitter buffer frame.
+      */
+    DWORD GetFramePoolMisses() const;
+
     /**Get average time between sent packets.
        This is averaged over the last txStatisticsInterval packets and is in
        milliseconds.
@@ -706,12 +987,93 @@ class RTP_Session : public PObject
        This is the calculated statistical variance of the interarrival
        time of received packets in milliseconds.
       */
-    DWORD GetAvgJitterTime() const { return jitterLevel>>7; }
+    DWORD GetAvgJitterTime() const { return rxStats.jitter/16000; }
 
     /**Get averaged jitter time for received packets.
-       This is the maximum value of jitterLevel for the session.
+       This is the maximum averaged jitter for the session.
+      */
+    DWORD GetMaxJitterTime() const { return rxStats.maximumJitter/16000; }
+
+    /**QoS measures of the session as H.460.9 reports them. The media
+       threads publish them at each statistics interval, so they are read
+       without a lock and are consistent with each other.
+      */
+    struct QoSMeasures {
+      DWORD packetsReceived;
+      DWORD octetsReceived;
+      DWORD packetsLost;
+      DWORD averageSendTime;     ///< ms between sent packets
+      DWORD maximumSendTime;     ///< ms between sent packets
+      DWORD averageReceiveTime;  ///< ms between received packets
+      DWORD jitter;              ///< Averaged jitter, ms
+      DWORD maximumJitter;       ///< ms
+      DWORD lossRate;            ///< Packets lost per packet received
+      DWORD throughput;          ///< Estimated received bytes per second
+    };
+
+    /**Get the QoS measures last published by the media threads.
+       Returns FALSE if nothing has been received yet.
       */
-    DWORD GetMaxJitterTime() const { return maximumJitterLevel>>7; }
+    PBoolean GetQoSMeasures(
+      QoSMeasures & measures
+    ) const;
+
+    /**Distributions of the media timing for the session, all in
+       microseconds, for the tail values that the averages above hide.
+      */
+    class Histograms : public PObject
+    {
+      PCLASSINFO(Histograms, PObject);
+      public:
+        RTP_Histogram::Snapshot jitter;       ///< Interarrival jitter of received packets
+        RTP_Histogram::Snapshot jitterBuffer; ///< Delay the jitter buffer was set to at playout
+        RTP_Histogram::Snapshot playout;      ///< Time from arrival to playout of each frame
+        RTP_Histogram::Snapshot encode;       ///< Time to encode each transmitted frame
+        RTP_Histogram::Snapshot decode;       ///< Time to decode each received frame
+
+        /**Add the receive or transmit distributions of another session.
+          */
+        void Merge(
+          const Histograms & other,
+          PBoolean receive,
+          PBoolean transmit
+        );
+
+        virtual void PrintOn(ostream & strm) const;
+    };
+
+    /**Get a copy of the distributions of the session. This does not lock the
+       session and may be called from any thread at any time.
+      */
+    void GetHistograms(
+      Histograms & histograms
+    ) const;
+
+    /**Get the distribution of the time to encode frames, recorded by the
+       transmitting codec.
+      */
+    RTP_Histogram & GetEncodeHistogram() { return encodeHistogram; }
+
+    /**Get the distribution of the time to decode frames, recorded by the
+       receiving codec.
+      */
+    RTP_Histogram & GetDecodeHistogram() { return decodeHistogram; }
+
+    /**Set the tag of the call using the session, for H323HotTrace events.
+      */
+    void SetTraceTag(DWORD tag) { traceTag = tag; }
+
+    /**Get the tag of the call using the session, for H323HotTrace events.
+      */
+    DWORD GetTraceTag() const { return traceTag; }
+
+    /**Record a frame being played out of the jitter buffer. This is called
+       from the thread reading the jitter buffer.
+      */
+    void OnPlayout(
+      DWORD playoutDelay,     ///< Microseconds since the frame arrived
+      DWORD bufferDelay       ///< Microseconds the jitter buffer is set to
+    );
 
     /**
       * return the timestamp at which the first packet of RTP data was received
@@ -763,8 +1125,8 @@ class RTP_Session : public PObject
     WORD          lastSentSequenceNumber;
     WORD          expectedSequenceNumber;
     DWORD         lastSentTimestamp;
-    PInt64        lastSentPacketTime;
-    PInt64        lastReceivedPacketTime;
+    PInt64        lastSentPacketTime;       ///< Milliseconds of the media clock
+    PInt64        lastReceivedPacketTime;   ///< Microseconds of the media clock
     WORD          lastRRSequenceNumber;
     PINDEX        consecutiveOutOfOrderPackets;
 
@@ -781,8 +1143,6 @@ class RTP_Session : public PObject
     DWORD averageReceiveTime;
     DWORD maximumReceiveTime;
     DWORD minimumReceiveTime;
-    DWORD jitterLevel;
-    DWORD maximumJitterLevel;
 
 	// Socket information
     PString locAddress;
@@ -794,20 +1154,75 @@ class RTP_Session : public PObject
     DWORD    averageSendTimeAccum;
     DWORD    maximumSendTimeAccum;
     DWORD    minimumSendTimeAccum;
-    DWORD    averageReceiveTimeAccum;
-    DWORD    maximumReceiveTimeAccum;
-    DWORD    minimumReceiveTimeAccum;
     DWORD    packetsLostSinceLastRR;
-    DWORD    lastTransitTime;
+
+    // Receive statistics of each packet, changed only by the receive thread
+    // in microseconds of the media clock. The values in milliseconds and
+    // 8kHz units are worked out from them when read, at each statistics
+    // interval and for receiver reports.
+    struct ReceiveStatistics {
+      PInt64 intervalSum;    ///< Between packets of this statistics interval
+      DWORD  intervalMax;
+      DWORD  intervalMin;
+      DWORD  lastInterval;
+      DWORD  jitter;         ///< Averaged interarrival jitter, times 16
+      DWORD  maximumJitter;  ///< Times 16
+    } rxStats;
+    void ResetReceiveInterval();
+    DWORD GetJitterLevel() const { return rxStats.jitter/125; }       ///< 8kHz units times 16
+    DWORD GetMaximumJitterLevel() const { return rxStats.maximumJitter/125; }
     PTime    firstDataReceivedTime;
 
+    // QoS measures published by each media thread, read lock free
+    void PublishSendQoS();
+    void PublishReceiveQoS();
+    struct SendQoS {
+      DWORD averageSendTime;
+      DWORD maximumSendTime;
+    } qosSend;
+    struct ReceiveQoS {
+      DWORD packetsReceived;
+      DWORD octetsReceived;
+      DWORD packetsLost;
+      DWORD averageReceiveTime;
+      DWORD jitterLevel;
+      DWORD maximumJitterLevel;
+    } qosReceive;
+    PAtomicInteger qosSendVersion;    ///< Odd while the send thread publishes
+    PAtomicInteger qosReceiveVersion; ///< Odd while the receive thread publishes
+
+    RTP_Histogram jitterHistogram;
+    RTP_Histogram jitterBufferHistogram;
+    RTP_Histogram playoutHistogram;
+    RTP_Histogram encodeHistogram;
+    RTP_Histogram decodeHistogram;
+    DWORD         traceTag;
+
     PMutex reportMutex;
     PTimer reportTimer;
+    PInt64 nextReportTime;    ///< Media clock microseconds reportTimer runs out
+    RTP_ControlFrame reportFrame;
+
+    RTP_RetransmitHistory * retransmitHistory;
+    RTP_NackGenerator     * nackGenerator;
+    RTP_ControlFrame        nackFrame;
+
+    RTP_MediaReactor * mediaReactor;
+    RTP_ReportScheduler * reportScheduler;
+    PBoolean           jitterPullMode;
+    PNotifier          reactorDataHandler;
+    RTP_DataFrame      reactorFrame;
 
     // Sync Information
     PBoolean avSyncData;
     SenderReport  rtpSync;
 
+    void StoreReceiverReports(const ReceiverReportArray & reports);
+
+    PMutex         receiverReportMutex;
+    ReceiverReport latestReceiverReport;    ///< Latest report on our source
+    unsigned       receiverReportSequence;
+
 #ifdef H323_RTP_AGGREGATE
     PHandleAggregator * aggregator;
 #endif
@@ -1031,6 +1446,14 @@ class RTP_UDP : public RTP_Session
       */
     virtual PBoolean WriteControl(RTP_ControlFrame & frame);
 
+    /**Set queuing of written data frames.
+      */
+    virtual void SetQueueWrites(PBoolean queue);
+
+    /**Get the number of data frames queued and not yet sent.
+      */
+    virtual PINDEX GetQueuedWrites() const;
+
     /**Close down the RTP session.
       */
     virtual void Close(
@@ -1040,6 +1463,18 @@ class RTP_UDP : public RTP_Session
     /**Get the session description name.
       */
     virtual PString GetLocalHostName();
+
+    /**Read a single data frame that is known to be waiting on the socket.
+      */
+    virtual SendReceiveStatus ReadPendingData(RTP_DataFrame & frame);
+
+    /**Read a data frame if one is waiting on the socket.
+      */
+    virtual SendReceiveStatus PollData(RTP_DataFrame & frame);
+
+    /**Service a readable socket from the media reactor.
+      */
+    virtual PBoolean OnReactorEvent(PBoolean dataReady);
   //@}
 
   /**@name QoS Settings */
@@ -1081,6 +1516,83 @@ class RTP_UDP : public RTP_Session
    /**Reopens an existing session in the given direction.
       */
     void Reopen(PBoolean isReading);
+
+    /**Set the number of datagrams moved per system call on the data socket.
+       This must be called before Open(). Zero (the default) disables batched
+       socket I/O, it is also not used on platforms without it or when the
+       sockets come from a NAT method.
+      */
+    void SetBatchSize(
+      PINDEX count    ///<  Datagrams per system call
+    ) { batchSize = count; }
+
+    /**Set the pool to take pre-opened sockets from.
+       This must be called before Open(). The pool is not used when the
+       sockets come from a NAT method or have a QoS specification, and if it
+       has no pair ready Open() binds its own sockets as before. Sockets taken
+       from the pool are given back to it when the session is deleted.
+      */
+    void SetPortPool(
+      RTP_PortPool * pool   ///<  Pool of socket pairs, NULL for none
+    ) { portPool = pool; }
+
+    /**Indicate the sockets were taken from the port pool.
+      */
+    PBoolean IsPooled() const { return pooledSockets; }
+
+    /**Send data and control packets to an IPv4 multicast group, control to
+       the port after the data port, instead of to the remote address.
+       Packets from the remote are still read as before. Returns FALSE if
+       the address is not a multicast group or the sockets are not open.
+      */
+    PBoolean SetMulticastTransmit(
+      const PIPSocket::Address & group, ///<  Multicast group to send to
+      WORD dataPort,                    ///<  Data port, control is one more
+      BYTE ttl = 16,                    ///<  Time to live of the packets
+      PBoolean loop = FALSE             ///<  Packets sent are also read locally
+    );
+
+    /**Determine if sending to a multicast group.
+      */
+    PBoolean IsMulticastTransmit() const { return multicastDataPort != 0; }
+
+    /**Get the multicast group sent to.
+      */
+    PIPSocket::Address GetMulticastGroup() const { return multicastGroup; }
+
+    /**Get the multicast data port sent to, zero if not sending to a group.
+      */
+    WORD GetMulticastDataPort() const { return multicastDataPort; }
+
+    /**Read packets sent to an IPv4 multicast group. The data and control
+       sockets are bound again to the ports of the group, on any interface,
+       and join the group on the local interface of the session. This must
+       be called before the session starts reading. Leaving the group is
+       done when the sockets are closed.
+      */
+    PBoolean JoinMulticast(
+      const PIPSocket::Address & group, ///<  Multicast group to read
+      WORD dataPort                     ///<  Data port, control is one more
+    );
+
+    /**Take apart RFC 2198 redundant packets of the payload type given as
+       they are read, recovering lost packets from the copies in the packets
+       after them. IllegalPayloadType stops it. This must be called before
+       the session starts reading.
+      */
+    void SetRedundantDecoding(
+      RTP_DataFrame::PayloadTypes payloadType   ///<  Payload type of redundant packets
+    );
+
+    /**Get the number of packets recovered from redundant copies.
+      */
+    unsigned GetRedundantRecoveredTotal() const;
+
+    /**Determine if the address is an IPv4 multicast group.
+      */
+    static PBoolean IsMulticastAddress(
+      const PIPSocket::Address & addr
+    ) { return addr.GetVersion() == 4 && (addr.Byte1() & 0xf0) == 0xe0; }
   //@}
 
   /**@name Member variable access */
@@ -1152,9 +1664,21 @@ class RTP_UDP : public RTP_Session
     PINDEX GetControlSocketHandle() const
     { return controlSocket != NULL ? controlSocket->GetHandle() : -1; }
 
+    /**Raise the receive or send buffer of a media socket to the size used
+       for RTP, if it is smaller.
+      */
+    static void SetMinBufferSize(
+      PUDPSocket & sock,    ///<  Socket to set
+      int buftype           ///<  SO_RCVBUF or SO_SNDBUF
+    );
+
   protected:
     SendReceiveStatus ReadDataPDU(RTP_DataFrame & frame);
     SendReceiveStatus ReadControlPDU();
+    PBoolean FlushData();
+    PBoolean SendData(RTP_DataFrame & frame);
+    void DeleteSockets();
+    PBoolean HasPendingData() const;
     SendReceiveStatus ReadDataOrControlPDU(
       PUDPSocket & socket,
       PBYTEArray & frame,
@@ -1171,12 +1695,29 @@ class RTP_UDP : public RTP_Session
 
     PIPSocket::Address remoteTransmitAddress;
 
+    PIPSocket::Address multicastGroup;
+    WORD               multicastDataPort;   // Zero when sending to the remote
+    PIPSocket::Address joinedGroup;
+
     PBoolean shutdownRead;
     PBoolean shutdownWrite;
 
     PUDPSocket * dataSocket;
     PUDPSocket * controlSocket;
 
+    RTP_PortPool     * portPool;
+    PBoolean           pooledSockets;
+    PIPSocket::Address pooledAddress;   // Interface the pooled pair was taken for
+
+    PINDEX              batchSize;
+    RTP_DatagramBatch * readBatch;
+    RTP_DatagramBatch * writeBatch;
+    PBoolean            queueWrites;
+    PINDEX              lastDataReadCount;
+    RTP_RedundantDecoder * redundantDecoder;
+    RTP_DataFrame       retransmitFrame;  // Reused for every retransmission sent
+    RTP_ControlFrame    controlFrame;   // Reused for every control packet read
+
     PBoolean appliedQOS;
     PBoolean enableGQOS;
 
@@ -0,0 +1,144 @@
+/*
+ * rtpbatch.h
+ *
+ * Batched UDP datagram I/O for RTP
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#ifndef __OPAL_RTPBATCH_H
+#define __OPAL_RTPBATCH_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include "openh323buildopts.h"
+
+#include <ptlib/sockets.h>
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**A batch of datagrams moved to or from a UDP socket in one system call.
+   On Linux the receive side drains up to the batch size of waiting
+   datagrams with recvmmsg() and hands them out one at a time, and the send
+   side collects datagrams and writes them all with sendmmsg(). Where these
+   calls are not available, or fail, every datagram falls back to the
+   normal PUDPSocket::ReadFrom() and PUDPSocket::WriteTo() so callers do not
+   need to know which is in use.
+
+   The batch talks to the socket handle directly, so it must only be used
+   with sockets that do not override ReadFrom()/WriteTo().
+  */
+class RTP_DatagramBatch : public PObject
+{
+  PCLASSINFO(RTP_DatagramBatch, PObject);
+
+  public:
+  /**@name Construction */
+  //@{
+    /**Create a batch of count datagrams of up to size bytes each.
+       A count of one or less creates a pass through to the socket.
+      */
+    RTP_DatagramBatch(
+      PINDEX count,          ///< Maximum datagrams per system call
+      PINDEX size = 2048     ///< Maximum size of a datagram
+    );
+
+    ~RTP_DatagramBatch();
+  //@}
+
+  /**@name Operations */
+  //@{
+    /**Indicate whether the platform supports batched datagram calls.
+      */
+    static PBoolean IsAvailable();
+
+    /**Read a datagram, from the batch if any are waiting, otherwise refill
+       the batch from the socket without blocking.
+      */
+    PBoolean ReadFrom(
+      PUDPSocket & socket,          ///< Socket to read
+      void * buf,                   ///< Buffer for datagram
+      PINDEX len,                   ///< Size of buffer
+      PIPSocket::Address & addr,    ///< Address datagram came from
+      WORD & port,                  ///< Port datagram came from
+      PINDEX & readCount            ///< Length of datagram
+    );
+
+    /**Indicate there are received datagrams waiting in the batch.
+      */
+    PBoolean HasPending() const { return readIndex < readCount; }
+
+    /**Get the maximum datagrams per system call.
+      */
+    PINDEX GetCount() const { return count; }
+
+    /**Add a datagram to the send batch.
+       Returns FALSE if the batch is full or the datagram too large, the
+       caller should then Flush() and send the datagram directly.
+      */
+    PBoolean Queue(
+      const void * buf,                 ///< Datagram to send
+      PINDEX len,                       ///< Length of datagram
+      const PIPSocket::Address & addr,  ///< Address to send to
+      WORD port                         ///< Port to send to
+    );
+
+    /**Send all queued datagrams.
+       Returns FALSE if a datagram could not be sent, the socket error is
+       then set as for PUDPSocket::WriteTo().
+      */
+    PBoolean Flush(
+      PUDPSocket & socket    ///< Socket to write
+    );
+
+    /**Get the number of datagrams queued for sending.
+      */
+    PINDEX GetQueued() const { return writeCount; }
+
+    /**Indicate the send batch is full.
+      */
+    PBoolean IsFull() const { return writeCount >= count; }
+  //@}
+
+  protected:
+    struct Native;
+
+    PINDEX   count;
+    PINDEX   size;
+    Native * readSide;
+    Native * writeSide;
+    PINDEX   readIndex;
+    PINDEX   readCount;
+    PINDEX   writeCount;
+};
+
+
+#endif // __OPAL_RTPBATCH_H
+
+
+/////////////////////////////////////////////////////////////////////////////
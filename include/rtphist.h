@@ -0,0 +1,158 @@
+/*
+ * rtphist.h
+ *
+ * Fixed bucket histograms for media statistics
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#ifndef __OPAL_RTPHIST_H
+#define __OPAL_RTPHIST_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include <openh323buildopts.h>
+
+#include "ptlib_extras.h"
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**Histogram of DWORD values, usually microseconds, with buckets of a fixed
+   relative size. Values below 16 have a bucket each, above that each power
+   of two is split into 16 buckets, so a percentile is within about 6% of
+   the true value over the whole DWORD range. The buckets are fixed, so it
+   never allocates and recording is a few instructions.
+
+   There must be only one thread recording into a histogram, for example
+   the receive thread of a session. Any other thread may take a snapshot at
+   any time without a lock, the snapshot may miss the values being recorded
+   at that moment but is otherwise consistent.
+  */
+class RTP_Histogram : public PObject
+{
+  PCLASSINFO(RTP_Histogram, PObject);
+
+  public:
+    enum {
+      SubBucketBits = 4,
+      SubBuckets    = 1 << SubBucketBits,
+      NumBuckets    = (32 - SubBucketBits + 1) * SubBuckets
+    };
+
+    /**Copy of a histogram, this is what percentiles are read from.
+      */
+    class Snapshot : public PObject
+    {
+      PCLASSINFO(Snapshot, PObject);
+
+      public:
+        Snapshot();
+
+        /**Add the values of another snapshot, for totals over sessions.
+          */
+        void Merge(
+          const Snapshot & other
+        );
+
+        /**Remove all values.
+          */
+        void Clear();
+
+        /**Get the value below which the given percentage of the values lie,
+           for example 99.9. This is the top of the bucket, so it is never
+           below the true value. Returns zero if there are no values.
+          */
+        DWORD GetPercentile(
+          double percent
+        ) const;
+
+        DWORD GetCount() const   { return count; }
+        DWORD GetMaximum() const { return maximum; }
+        DWORD GetMean() const    { return count > 0 ? (DWORD)(total/count) : 0; }
+
+        /**Output count, mean, p50, p90, p99, p99.9 and maximum.
+          */
+        virtual void PrintOn(ostream & strm) const;
+
+      protected:
+        DWORD   buckets[NumBuckets];
+        DWORD   count;
+        DWORD   maximum;
+        PUInt64 total;
+
+      friend class RTP_Histogram;
+    };
+
+    RTP_Histogram();
+
+    /**Record a value, from the one thread that writes this histogram.
+      */
+    void Record(
+      DWORD value
+    );
+
+    /**Copy the histogram, from any thread.
+      */
+    void GetSnapshot(
+      Snapshot & snapshot
+    ) const;
+
+    /**Get the microseconds elapsed since an earlier call, for timing
+       around a function. Pass zero to get the start time.
+      */
+    static PInt64 GetMicroseconds(
+      PInt64 start = 0
+    );
+
+    /**Get the bucket a value is counted in.
+      */
+    static PINDEX GetBucket(
+      DWORD value
+    );
+
+    /**Get the largest value counted in a bucket.
+      */
+    static DWORD GetBucketLimit(
+      PINDEX bucket
+    );
+
+  protected:
+    volatile DWORD buckets[NumBuckets];
+    volatile DWORD maximum;
+    volatile PUInt64 total;
+
+  private:
+    RTP_Histogram(const RTP_Histogram &) { }
+    RTP_Histogram & operator=(const RTP_Histogram &) { return *this; }
+};
+
+
+#endif // __OPAL_RTPHIST_H
+
+
+/////////////////////////////////////////////////////////////////////////////
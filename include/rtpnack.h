@@ -0,0 +1,206 @@
+/*
+ * rtpnack.h
+ *
+ * Generic NACK and RTX retransmission for RTP
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+
+#ifndef __OPAL_RTPNACK_H
+#define __OPAL_RTPNACK_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include "openh323buildopts.h"
+
+#include "rtp.h"
+
+#include <vector>
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**The recent packets sent on a session, kept to be sent again when the
+   receiver reports them lost with an RTCP generic NACK (RFC 4585). They
+   are sent again as RFC 4588 retransmission packets, with their own
+   payload type, SSRC and sequence numbers and the original sequence number
+   at the start of the payload.
+
+   Packets are stored and retransmissions taken by the thread sending on
+   the session, requests come from the thread reading its reports.
+  */
+class RTP_RetransmitHistory : public PObject
+{
+  PCLASSINFO(RTP_RetransmitHistory, PObject);
+
+  public:
+    /**Create a history of the last depth packets sent, retransmitted in
+       packets of the payload type given.
+      */
+    RTP_RetransmitHistory(
+      PINDEX depth,                           ///< Packets kept
+      RTP_DataFrame::PayloadTypes payloadType ///< Payload type of retransmissions
+    );
+
+    /**Keep a copy of a packet sent, with its sequence number assigned.
+      */
+    void Store(
+      const RTP_DataFrame & frame   ///< Packet sent
+    );
+
+    /**Ask for a packet to be sent again. Ignored if it is no longer kept
+       or was sent again very recently for an earlier request.
+      */
+    void Request(
+      WORD sequenceNumber   ///< Sequence number of the lost packet
+    );
+
+    /**Indicate retransmissions are waiting, checked without a lock.
+      */
+    PBoolean HasRequests() const { return requestCount > 0; }
+
+    /**Build the next retransmission waiting. Returns FALSE if none.
+      */
+    PBoolean TakeRetransmission(
+      RTP_DataFrame & frame   ///< Frame to receive the packet
+    );
+
+    RTP_DataFrame::PayloadTypes GetPayloadType() const { return payloadType; }
+
+    /**Get the number of packets asked for and the number sent again.
+      */
+    unsigned GetRequested() const { return requested; }
+    unsigned GetRetransmitted() const { return retransmitted; }
+
+  protected:
+    struct Entry {
+      Entry() : sequenceNumber(0), valid(FALSE), lastSent(0), frame(1500) { }
+      WORD          sequenceNumber;
+      PBoolean      valid;
+      PInt64        lastSent;     // Media clock microseconds of the last retransmission
+      RTP_DataFrame frame;
+    };
+
+    PMutex                      mutex;
+    std::vector<Entry>          entries;    // Indexed by sequence number modulo depth
+    std::vector<WORD>           requests;
+    volatile PINDEX             requestCount;
+    RTP_DataFrame::PayloadTypes payloadType;
+    DWORD                       syncSource;
+    WORD                        sequenceNumber;
+    unsigned                    requested;
+    unsigned                    retransmitted;
+};
+
+
+/**Tracks the packets lost on a session and builds the RTCP generic NACKs
+   asking for them (RFC 4585), and takes apart the RFC 4588
+   retransmissions that answer them. A loss is asked for at once and again
+   if not answered, a few times, until it is too old to be of use.
+
+   It belongs to the thread reading the session.
+  */
+class RTP_NackGenerator : public PObject
+{
+  PCLASSINFO(RTP_NackGenerator, PObject);
+
+  public:
+    enum {
+      MaxPending = 128,       ///< Most losses waiting for a retransmission
+      RetryInterval = 50000,  ///< Microseconds before asking again
+      MaxRequests = 3,        ///< Times a loss is asked for
+      MaxAge = 1000000        ///< Microseconds after which a loss is given up
+    };
+
+    /**Create a generator for retransmissions in the payload type given.
+      */
+    RTP_NackGenerator(
+      RTP_DataFrame::PayloadTypes payloadType ///< Payload type of retransmissions
+    );
+
+    /**A media packet arrived, no longer lost if it was.
+      */
+    void OnReceived(
+      WORD sequenceNumber,                    ///< Packet sequence number
+      RTP_DataFrame::PayloadTypes payloadType ///< Packet payload type
+    );
+
+    /**Packets were found missing.
+      */
+    void OnLost(
+      WORD firstSequence,   ///< First missing
+      unsigned count,       ///< Number missing
+      PInt64 now            ///< Media clock microseconds
+    );
+
+    /**Build a compound RTCP packet of an empty receiver report and a NACK
+       for the losses due to be asked for. Returns FALSE if none are due.
+      */
+    PBoolean BuildNack(
+      RTP_ControlFrame & frame,   ///< Frame to build in
+      DWORD senderSource,         ///< Our SSRC
+      DWORD mediaSource,          ///< SSRC of the stream with the losses
+      PInt64 now                  ///< Media clock microseconds
+    );
+
+    /**Turn a retransmission back into the packet it carries, with the media
+       source given. Returns FALSE if the packet was not waited for, or is
+       malformed, and should be dropped.
+      */
+    PBoolean OnRetransmission(
+      RTP_DataFrame & frame,  ///< Retransmission received, changed in place
+      DWORD mediaSource       ///< SSRC of the media stream
+    );
+
+    RTP_DataFrame::PayloadTypes GetPayloadType() const { return payloadType; }
+
+    /**Get the number of losses asked for and of those repaired.
+      */
+    unsigned GetRequested() const { return requested; }
+    unsigned GetRepaired() const { return repaired; }
+
+  protected:
+    struct Pending {
+      WORD     sequenceNumber;
+      PInt64   lost;        // Media clock microseconds found missing
+      PInt64   lastSent;    // Zero before the first NACK
+      unsigned sent;
+    };
+
+    RTP_DataFrame::PayloadTypes payloadType;
+    RTP_DataFrame::PayloadTypes mediaPayloadType;
+    std::vector<Pending>        pending;    // Oldest first
+    unsigned                    requested;
+    unsigned                    repaired;
+};
+
+
+#endif // __OPAL_RTPNACK_H
+
+
+/////////////////////////////////////////////////////////////////////////////
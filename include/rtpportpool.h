@@ -0,0 +1,172 @@
+/*
+ * rtpportpool.h
+ *
+ * Pool of pre-opened RTP socket pairs
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#ifndef __OPAL_RTPPORTPOOL_H
+#define __OPAL_RTPPORTPOOL_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include "openh323buildopts.h"
+#include <ptlib/sockets.h>
+
+#include <deque>
+#include <map>
+
+class H323EndPoint;
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**Pool of RTP data and control socket pairs bound ahead of use.
+   Without it every RTP session walks the endpoint RTP port range binding
+   an even and odd port, retrying on each port in use, and then sets the
+   type of service and buffer sizes. With it a thread keeps a number of
+   pairs per local interface already bound and configured, so opening a
+   session takes one from the pool.
+
+   A pair given back by a closed session is held in quarantine for a time
+   before it is handed out again, so late packets of the old call are not
+   taken as media of the new one, and anything received meanwhile is
+   discarded as it leaves quarantine. The sockets stay bound during that
+   time so no other session can take the ports.
+
+   Interfaces are added to the pool the first time a session asks for one,
+   or ahead of time by AddInterface().
+  */
+class RTP_PortPool : public PObject
+{
+  PCLASSINFO(RTP_PortPool, PObject);
+
+  public:
+  /**@name Construction */
+  //@{
+    /**Create the pool and start its thread.
+       Ports are taken from the endpoint RTP port range.
+      */
+    RTP_PortPool(
+      H323EndPoint & endpoint,            ///< Endpoint with the port range
+      PINDEX size,                        ///< Ready pairs kept per interface
+      const PTimeInterval & quarantine    ///< Time a released pair is held
+    );
+
+    /**Stop the pool thread and close every socket it holds.
+       All sessions should have given their pairs back before this is called.
+      */
+    ~RTP_PortPool();
+  //@}
+
+  /**@name Operations */
+  //@{
+    /**Start keeping pairs ready for a local interface.
+      */
+    void AddInterface(
+      const PIPSocket::Address & address  ///< Local interface address
+    );
+
+    /**Take a ready pair bound to the interface.
+       Returns FALSE if there is none, in which case the caller binds its
+       own sockets and the pool is topped up in the background.
+      */
+    PBoolean Acquire(
+      const PIPSocket::Address & address, ///< Local interface address
+      PUDPSocket * & dataSocket,          ///< Socket bound to the even port
+      PUDPSocket * & controlSocket        ///< Socket bound to the odd port
+    );
+
+    /**Give back a pair taken by Acquire().
+       The pool owns the sockets again on return.
+      */
+    void Release(
+      const PIPSocket::Address & address, ///< Interface the pair was taken for
+      PUDPSocket * dataSocket,            ///< Socket bound to the even port
+      PUDPSocket * controlSocket          ///< Socket bound to the odd port
+    );
+
+    /**Get the type of service byte set on the pooled sockets.
+      */
+    BYTE GetTypeOfService() const { return typeOfService; }
+
+    /**Get the number of ready pairs kept per interface.
+      */
+    PINDEX GetSize() const { return poolSize; }
+
+    /**Get the number of times Acquire() returned a pair.
+      */
+    PUInt64 GetHitCount() const { return hitCount; }
+
+    /**Get the number of times Acquire() found no pair ready.
+      */
+    PUInt64 GetMissCount() const { return missCount; }
+  //@}
+
+  protected:
+    class Thread;
+    friend class Thread;
+
+    void Main();
+    PBoolean OpenPair(const PIPSocket::Address & address, PUDPSocket * & data, PUDPSocket * & control);
+    static void Drain(PUDPSocket & socket);
+
+    struct SocketPair {
+      PUDPSocket * data;
+      PUDPSocket * control;
+      PInt64       released;   ///< Tick the pair was given back
+    };
+
+    struct Interface {
+      PIPSocket::Address     address;
+      std::deque<SocketPair> ready;
+      std::deque<SocketPair> quarantined;
+      PINDEX                 opening;   ///< Pairs the thread is binding
+    };
+
+    typedef std::map<PString, Interface> InterfaceMap;
+
+    H323EndPoint & endpoint;
+    PINDEX         poolSize;
+    PInt64         quarantineTime;
+    BYTE           typeOfService;
+    InterfaceMap   interfaces;          ///< Pairs by local interface address
+    PUInt64        hitCount;
+    PUInt64        missCount;
+    PBoolean       shutdown;
+
+    PMutex     mutex;                   ///< Protects the interfaces
+    PSyncPoint wakeUp;
+    Thread   * thread;
+};
+
+
+#endif // __OPAL_RTPPORTPOOL_H
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,138 @@
+/*
+ * rtpreactor.h
+ *
+ * Shared event driven RTP media reactor
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#ifndef __OPAL_RTPREACTOR_H
+#define __OPAL_RTPREACTOR_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include "openh323buildopts.h"
+#include "h323affinity.h"
+
+#include <vector>
+
+class RTP_Session;
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**A small fixed pool of event loop threads servicing many RTP sessions.
+   Each worker thread waits on the data and control sockets of the sessions
+   assigned to it (epoll on Linux, kqueue on the BSDs and Mac OS X) and
+   dispatches readable sockets to RTP_Session::OnReactorEvent(). This replaces
+   the per session jitter buffer thread, so a gateway carrying several hundred
+   calls only runs as many receive threads as the reactor was created with.
+
+   This is the replacement for the H323_RTP_AGGREGATE/PHandleAggregator
+   support which is tied to older versions of PTLib.
+  */
+class RTP_MediaReactor : public PObject
+{
+  PCLASSINFO(RTP_MediaReactor, PObject);
+
+  public:
+  /**@name Construction */
+  //@{
+    /**Create the reactor and start its worker threads.
+      */
+    RTP_MediaReactor(
+      PINDEX threadCount,                   ///< Number of event loop threads
+      PThread::Priority priority = PThread::HighestPriority, ///< Priority of the threads
+      PINDEX stackSize = 30000,             ///< Stack size of the threads
+      const H323CPUSet & affinity = H323CPUSet() ///< CPUs to spread the threads over, one each
+    );
+
+    /**Stop all worker threads.
+       Any sessions still registered are dropped without notification.
+      */
+    ~RTP_MediaReactor();
+  //@}
+
+  /**@name Operations */
+  //@{
+    /**Indicate whether the platform has an event mechanism the reactor can use.
+      */
+    static PBoolean IsAvailable();
+
+    /**Add a session to the least loaded worker thread.
+       If steering is on and the data socket has received, the session goes
+       to the worker pinned to the CPU servicing its network queue instead.
+       Returns FALSE if the session could not be serviced by the reactor, in
+       which case the caller should fall back to a dedicated thread.
+       Adding a session that is already registered does nothing.
+      */
+    PBoolean AddSession(
+      RTP_Session & session   ///< Session to service
+    );
+
+    /**Remove a session from the reactor.
+       On return the reactor is guaranteed not to be executing, or about to
+       execute, any call back into the session.
+      */
+    void RemoveSession(
+      RTP_Session & session   ///< Session to remove
+    );
+
+    /**Set steering of sessions to the worker pinned to the CPU that
+       receives their packets. This needs the workers pinned one per CPU, and
+       the RSS or RPS queues of the network card on the same CPUs.
+      */
+    void SetSocketSteering(
+      PBoolean enable        ///< Steer sessions by receiving CPU
+    ) { socketSteering = enable; }
+
+    /**Get the steering of sessions to the CPU that receives their packets.
+      */
+    PBoolean GetSocketSteering() const { return socketSteering; }
+
+    /**Get the number of worker threads in the reactor.
+      */
+    PINDEX GetThreadCount() const { return workers.size(); }
+
+    /**Get the number of sessions currently serviced by the reactor.
+      */
+    PINDEX GetSessionCount() const;
+  //@}
+
+  protected:
+    class Worker;
+    friend class Worker;
+
+    std::vector<Worker *> workers;
+    PMutex                mutex;
+    PBoolean              socketSteering;
+};
+
+
+#endif // __OPAL_RTPREACTOR_H
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,291 @@
+/*
+ * rtprecord.h
+ *
+ * Recording of RTP media to disk off the media threads
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#ifndef __RTP_RTPRECORD_H
+#define __RTP_RTPRECORD_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include "openh323buildopts.h"
+#include <ptclib/pwavfile.h>
+#include "rtp.h"
+
+#include <list>
+#include <vector>
+
+class RTP_RecordingWriter;
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**Recording of one RTP stream, attached as a filter on H323_RTPChannel in the
+   same way as OpalRtpToWavFile.
+   The filter, called on the media receive thread, only copies the packet
+   into a ring buffer of the recording. Nothing on that thread waits for the
+   disk or takes a lock: the buffer has a single writer, the media thread,
+   and a single reader, a thread of the RTP_RecordingWriter that writes whole
+   blocks to the file. If the disk falls so far behind that the buffer fills,
+   packets are dropped from the recording and counted, the call is not held
+   up.
+
+   The stream is written as a WAV file of the payload, for G.711 and L16
+   audio as OpalRtpToWavFile does, or in the rtpdump format of the rtptools
+   package, which keeps every RTP packet with its arrival time for any
+   payload type and is read by Wireshark, or in the capture format read by
+   RTP_CaptureReader.
+  */
+class RTP_Recording : public PObject
+{
+    PCLASSINFO(RTP_Recording, PObject);
+  public:
+    enum Format {
+      WAV,        ///< Payload only, first payload type seen
+      RTPDump,    ///< Whole RTP packets, rtpdump 1.0
+      Capture     ///< Payloads with their RTP fields and a time index, see RTP_CaptureReader
+    };
+
+    /**Create a recording to a file, added to the writer.
+       The file is not created until the first packet arrives.
+      */
+    RTP_Recording(
+      RTP_RecordingWriter & writer,   ///< Writer the file is written by
+      const PFilePath & filename,     ///< File to record to
+      Format format = WAV,            ///< Format of the file
+      PINDEX bufferSize = 1048576     ///< Bytes buffered for the writer, rounded up to a power of two
+    );
+
+    /**Close the recording if not already closed.
+      */
+    ~RTP_Recording();
+
+    /**Get the filter to add to the channel by H323_RTPChannel::AddFilter().
+      */
+    const PNotifier & GetReceiveHandler() const { return receiveHandler; }
+
+    /**Stop recording. What was buffered is written and the file is closed
+       before this returns. The filter must have been removed from the
+       channel, or the channel closed, first.
+      */
+    void Close();
+
+    /**Get the file being recorded to.
+      */
+    const PFilePath & GetFilePath() const { return filename; }
+
+    /**Get the format of the file.
+      */
+    Format GetFormat() const { return format; }
+
+    /**Get the number of packets not recorded because the buffer was full.
+      */
+    PUInt64 GetDroppedCount() const { return droppedCount; }
+
+  protected:
+    PDECLARE_NOTIFIER(RTP_DataFrame, RTP_Recording, ReceivedPacket);
+
+    PBoolean Push(const BYTE * header, PINDEX headerSize, const BYTE * data, PINDEX size);
+    PBoolean Flush(PBoolean all);
+    PBoolean OpenFile();
+    PBoolean WriteBlock(const BYTE * data, PINDEX size);
+    PBoolean WriteCaptureIndex();
+
+    RTP_RecordingWriter & writer;
+    PFilePath  filename;
+    Format     format;
+    PNotifier  receiveHandler;
+
+    // Touched only by the media thread
+    RTP_DataFrame::PayloadTypes payloadType;
+    PBYTEArray lastFrame;
+    PINDEX     lastPayloadSize;
+    PTime      startTime;     ///< Arrival of the first packet
+    PInt64     startTick;
+    PUInt64    streamBytes;   ///< Bytes pushed, the file position after the header
+    DWORD      nextIndexTime; ///< Arrival offset of the next capture index entry
+    std::vector<std::pair<DWORD, PUInt64> > captureIndex;
+
+    // Ring buffer, written by the media thread and read by one writer thread
+    PBYTEArray        ring;
+    unsigned          ringMask;
+    volatile unsigned ringIn;     ///< Bytes ever written, only the media thread changes it
+    volatile unsigned ringOut;    ///< Bytes ever read, only the writer changes it
+    PUInt64           droppedCount;
+
+    // Touched only by the writer thread holding the recording
+    PFile    * file;
+    PBYTEArray block;
+    PINDEX     blockFill;
+    PBoolean   failed;
+
+    // Guarded by the writer mutex
+    PBoolean   flushing;
+    PBoolean   closed;
+
+    friend class RTP_RecordingWriter;
+};
+
+
+/**Reader of a file recorded in the RTP_Recording::Capture format.
+   The file holds the RTP payloads as they arrived, with payload type,
+   marker, sequence number, timestamp, SSRC and arrival time, so recording
+   costs no codec. RenderToWAV() decodes it later with the plug in codecs.
+
+   The format, all fields big endian:
+     header  "H323CAP1", start time seconds and microseconds (32 bit each),
+             reserved (32 bit), index entry count (32 bit) and index file
+             offset (64 bit), zero if the recording was never closed
+     packet  payload length (16 bit), payload type with the marker in the
+             top bit, reserved, sequence number (16 bit), arrival milliseconds
+             since start (32 bit), timestamp and SSRC (32 bit each), payload
+     index   once a second of arrival time, arrival milliseconds (32 bit)
+             and the file offset of the first packet at or after it (64 bit)
+  */
+class RTP_CaptureReader : public PObject
+{
+    PCLASSINFO(RTP_CaptureReader, PObject);
+  public:
+    enum {
+      HeaderSize = 32,
+      PacketHeaderSize = 18,
+      IndexEntrySize = 12
+    };
+
+    RTP_CaptureReader();
+
+    /**Open a capture file and read its header and index.
+      */
+    PBoolean Open(
+      const PFilePath & filename
+    );
+
+    /**Close the file.
+      */
+    void Close();
+
+    /**Read the next packet. The RTP header fields of the frame are set from
+       the capture. Returns FALSE at the end of the recording.
+      */
+    PBoolean ReadPacket(
+      RTP_DataFrame & frame,   ///< Packet read
+      DWORD & arrival          ///< Milliseconds after the start it arrived
+    );
+
+    /**Move to the first packet arriving at or after a time from the start,
+       by the index or, for a recording never closed, by reading.
+      */
+    PBoolean Seek(
+      const PTimeInterval & offset
+    );
+
+    /**Decode the recording to a 16 bit PCM WAV file. Gaps in the RTP
+       timestamps, from lost packets or silence suppression, are filled with
+       silence. The media format is found from the payload type of the first
+       packet if not given, which only works for static payload types.
+      */
+    PBoolean RenderToWAV(
+      const PFilePath & wavFile,
+      const PString & mediaFormat = PString::Empty()
+    );
+
+    /**Get the time the first packet arrived.
+      */
+    const PTime & GetStartTime() const { return startTime; }
+
+    /**Indicate the file was closed properly and has an index.
+      */
+    PBoolean HasIndex() const { return !index.empty(); }
+
+  protected:
+    PFile   file;
+    PTime   startTime;
+    PUInt64 endOfPackets;       ///< File offset of the index, or the file size
+    std::vector<std::pair<DWORD, PUInt64> > index;
+};
+
+
+/**Pool of threads writing the recordings to disk.
+   Each thread in turn takes a recording with data waiting and moves it from
+   the recording buffer to the file in blocks of the block size, a multiple
+   of the disk sector, so the file system gets few large writes rather than
+   one per packet.
+  */
+class RTP_RecordingWriter : public PObject
+{
+    PCLASSINFO(RTP_RecordingWriter, PObject);
+  public:
+    /**Create the writer and start its threads.
+      */
+    RTP_RecordingWriter(
+      PINDEX threads = 2,                       ///< Threads writing to disk
+      PINDEX blockSize = 65536,                 ///< Bytes per write, rounded up to 4096
+      const PTimeInterval & flushInterval = PTimeInterval(200) ///< Time between looks at every recording
+    );
+
+    /**Stop the threads.
+       All recordings should have been closed before this is called.
+      */
+    ~RTP_RecordingWriter();
+
+    /**Get the bytes written to disk at a time.
+      */
+    PINDEX GetBlockSize() const { return blockSize; }
+
+    /**Get the number of recordings open.
+      */
+    PINDEX GetRecordingCount() const;
+
+  protected:
+    class Thread;
+    friend class Thread;
+    friend class RTP_Recording;
+
+    void Main();
+    void AddRecording(RTP_Recording & recording);
+    void RemoveRecording(RTP_Recording & recording);
+    void WakeUp() { wakeUp.Signal(); }
+
+    PINDEX        blockSize;
+    PTimeInterval flushInterval;
+    std::list<RTP_Recording *> recordings;
+    PBoolean      shutdown;
+
+    mutable PMutex mutex;       ///< Protects the list and the flushing flags
+    PSemaphore     wakeUp;
+    PSyncPoint     flushed;     ///< Signalled when a recording is given back
+    std::vector<Thread *> threads;
+};
+
+
+#endif // __RTP_RTPRECORD_H
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,175 @@
+/*
+ * rtpred.h
+ *
+ * RFC 2198 redundant audio for RTP
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+
+#ifndef __OPAL_RTPRED_H
+#define __OPAL_RTPRED_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include "openh323buildopts.h"
+
+#include "rtp.h"
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**Builds RFC 2198 redundant packets. Each packet sent carries the payload
+   given with copies of the payloads of up to the redundancy level packets
+   before it, so a receiver recovers a lost packet from the next one that
+   arrives instead of waiting for the jitter buffer to conceal it.
+
+   Earlier payloads too old for the 14 bit timestamp offset, or too long for
+   the 10 bit block length, are left out. All buffers are allocated up front
+   so encoding a packet does not allocate.
+  */
+class RTP_RedundantEncoder : public PObject
+{
+  PCLASSINFO(RTP_RedundantEncoder, PObject);
+
+  public:
+    enum {
+      MaxLevel = 4,         ///< Most earlier payloads carried by a packet
+      MaxBlockSize = 1023   ///< Largest payload the block header can describe
+    };
+
+    /**Create an encoder sending level earlier payloads in each packet, in
+       packets of the payload type negotiated for redundancy.
+      */
+    RTP_RedundantEncoder(
+      PINDEX level,                           ///< Earlier payloads per packet
+      RTP_DataFrame::PayloadTypes payloadType ///< Payload type of the packets
+    );
+
+    /**Build the redundant packet for a frame, which is left unchanged.
+       The packet returned is reused by the next call.
+      */
+    RTP_DataFrame & Encode(
+      const RTP_DataFrame & frame   ///< Frame to send
+    );
+
+    PINDEX GetLevel() const { return level; }
+    RTP_DataFrame::PayloadTypes GetPayloadType() const { return payloadType; }
+
+  protected:
+    struct Block {
+      Block() : payloadType(RTP_DataFrame::IllegalPayloadType), timestamp(0), size(0) { }
+      RTP_DataFrame::PayloadTypes payloadType;
+      DWORD      timestamp;
+      PINDEX     size;
+      PBYTEArray data;
+    };
+
+    PINDEX                      level;
+    RTP_DataFrame::PayloadTypes payloadType;
+    Block                       history[MaxLevel+1];  // Ring of the payloads last sent
+    PINDEX                      newest;
+    PINDEX                      count;
+    RTP_DataFrame               packet;
+};
+
+
+/**Takes apart RFC 2198 redundant packets ahead of the jitter buffer. The
+   primary payload is given on as the packet, and a redundant copy of an
+   earlier packet that has not arrived is kept and given on by the next
+   read as a packet of its own, with the sequence number it was sent with.
+   Packets arriving after their copy was recovered are dropped.
+
+   The sequence numbers of the copies follow from the usual use of RFC 2198
+   where every packet carries the payloads of the packets just before it.
+  */
+class RTP_RedundantDecoder : public PObject
+{
+  PCLASSINFO(RTP_RedundantDecoder, PObject);
+
+  public:
+    /**Create a decoder of packets of the payload type negotiated.
+      */
+    RTP_RedundantDecoder(
+      RTP_DataFrame::PayloadTypes payloadType ///< Payload type of redundant packets
+    );
+
+    /**Take apart a received packet, leaving its primary payload in it.
+       Packets of other payload types are left as they are. Returns FALSE if
+       the packet should be dropped, as malformed or already recovered.
+      */
+    PBoolean Decode(
+      RTP_DataFrame & frame   ///< Received packet
+    );
+
+    /**Indicate recovered packets are waiting.
+      */
+    PBoolean HasRecovered() const { return recoveredCount > 0; }
+
+    /**Take the oldest recovered packet waiting. The frame must have no
+       CSRC or extension header space in use that matters, it is rewritten.
+      */
+    PBoolean TakeRecovered(
+      RTP_DataFrame & frame   ///< Frame to receive the packet
+    );
+
+    /**Get the number of packets recovered from redundant copies.
+      */
+    unsigned GetRecoveredTotal() const { return recoveredTotal; }
+
+    RTP_DataFrame::PayloadTypes GetPayloadType() const { return payloadType; }
+
+  protected:
+    PBoolean MarkReceived(WORD sequenceNumber);
+    PBoolean WasReceived(WORD sequenceNumber) const;
+
+    struct Recovered {
+      Recovered() : payloadType(RTP_DataFrame::IllegalPayloadType), sequenceNumber(0), timestamp(0), syncSource(0), size(0) { }
+      RTP_DataFrame::PayloadTypes payloadType;
+      WORD       sequenceNumber;
+      DWORD      timestamp;
+      DWORD      syncSource;
+      PINDEX     size;
+      PBYTEArray data;
+    };
+
+    RTP_DataFrame::PayloadTypes payloadType;
+    Recovered  recovered[RTP_RedundantEncoder::MaxLevel];
+    PINDEX     recoveredCount;
+    unsigned   recoveredTotal;
+
+    // Packets seen, bit n of the mask is highestSequence-n
+    PBoolean   started;
+    WORD       highestSequence;
+    PUInt64    receivedMask;
+};
+
+
+#endif // __OPAL_RTPRED_H
+
+
+/////////////////////////////////////////////////////////////////////////////
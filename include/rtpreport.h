@@ -0,0 +1,140 @@
+/*
+ * rtpreport.h
+ *
+ * Central RTCP report scheduling
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#ifndef __OPAL_RTPREPORT_H
+#define __OPAL_RTPREPORT_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include "openh323buildopts.h"
+#include "rtp.h"
+
+#include <map>
+#include <vector>
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**Central sending of the RTCP reports of many RTP sessions.
+   Without it each session checks for a due report on every packet it sends
+   or receives, so reports go out from the media threads in whatever pattern
+   the traffic makes. With it a single thread keeps the sessions ordered by
+   when their next report is due and sends each at its time, using one
+   pre-allocated control frame for all of them.
+
+   A session is first due at a uniformly random point within its report
+   interval, so sessions added together do not report together, and after
+   each report the next is randomised over 0.5 to 1.5 times the interval as
+   RFC 3550 section 6.3.1 describes.
+  */
+class RTP_ReportScheduler : public PObject
+{
+  PCLASSINFO(RTP_ReportScheduler, PObject);
+
+  public:
+  /**@name Construction */
+  //@{
+    /**Create the scheduler and start its thread.
+      */
+    RTP_ReportScheduler(
+      PThread::Priority priority = PThread::NormalPriority ///< Priority of the thread
+    );
+
+    /**Stop the scheduler thread.
+       All sessions should have been removed before this is called.
+      */
+    ~RTP_ReportScheduler();
+  //@}
+
+  /**@name Operations */
+  //@{
+    /**Add a session to have its reports sent by the scheduler.
+       This is normally called by RTP_Session::SetReportScheduler().
+      */
+    void AddSession(
+      RTP_Session & session   ///< Session to report for
+    );
+
+    /**Remove a session.
+       On return the scheduler thread is not inside any call to the session,
+       so it may be deleted. This is normally called by
+       RTP_Session::SetReportScheduler().
+      */
+    void RemoveSession(
+      RTP_Session & session   ///< Session to remove
+    );
+
+    /**Get the number of sessions being reported for.
+      */
+    PINDEX GetSessionCount() const { return sessions.size(); }
+
+    /**Get the number of times a report fell due for a session.
+      */
+    PUInt64 GetReportCount() const { return reportCount; }
+  //@}
+
+    /**Get a randomised time to the next report, from 0.5 to 1.5 times the
+       interval divided by e-3/2 as RFC 3550 section 6.3.1 does, to make
+       up for the randomisation pulling reports earlier on average.
+      */
+    static PInt64 GetRandomisedInterval(
+      const PTimeInterval & interval   ///< Report interval of the session
+    );
+
+  protected:
+    class Thread;
+    friend class Thread;
+
+    void Main();
+    void Schedule(RTP_Session & session, PInt64 due);
+
+    typedef std::multimap<PInt64, RTP_Session *> DueMap;
+    typedef std::map<RTP_Session *, DueMap::iterator> SessionMap;
+
+    DueMap     dueSessions;     ///< Sessions by tick their report is due
+    SessionMap sessions;        ///< Position of each session in dueSessions
+    std::vector<RTP_Session *> dueBatch;  ///< Reused by the thread for each wake up
+    RTP_ControlFrame reportFrame;         ///< Reused for every report sent
+    PUInt64    reportCount;
+    PBoolean   shutdown;
+
+    PMutex     mutex;           ///< Protects the maps
+    PMutex     sendMutex;       ///< Held while the thread sends a batch of reports
+    PSyncPoint wakeUp;
+    Thread   * thread;
+};
+
+
+#endif // __OPAL_RTPREPORT_H
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,166 @@
+/*
+ * rtpsched.h
+ *
+ * Timer wheel based RTP transmit pacing
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#ifndef __OPAL_RTPSCHED_H
+#define __OPAL_RTPSCHED_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include "openh323buildopts.h"
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**Central transmit pacing for outgoing RTP channels.
+   Each transmitting channel registers a stream and, before every packet it
+   sends, waits for the next deadline of that stream. The
+   deadlines are absolute (start time plus a whole number of frame periods)
+   so pacing does not drift when a codec read returns early or late, and a
+   codec that returns a burst of buffered frames has them spread back out to
+   the frame rate.
+
+   All pending deadlines are kept in a two level hierarchical timer wheel
+   with one millisecond resolution, serviced by a single thread, so the cost
+   per stream is constant and no stream has to sleep on its own timer.
+  */
+class RTP_TransmitScheduler : public PObject
+{
+  PCLASSINFO(RTP_TransmitScheduler, PObject);
+
+  public:
+    /**A single paced stream.
+       Obtained from RTP_TransmitScheduler::Register() and released with
+       RTP_TransmitScheduler::Unregister().
+      */
+    class Stream {
+      public:
+        Stream(const PString & name);
+
+        const PString & GetName() const { return name; }
+        PINDEX GetLateCount() const { return lateCount; }
+
+      protected:
+        PString   name;
+        PInt64    deadline;    ///< Absolute tick of next send, zero if not started
+        PBoolean  registered;
+        PINDEX    lateCount;
+        PSyncPoint wakeUp;
+
+        // Timer wheel linkage, protected by the scheduler mutex
+        Stream * next;
+        Stream * prev;
+        Stream ** slot;
+
+      friend class RTP_TransmitScheduler;
+    };
+
+  /**@name Construction */
+  //@{
+    /**Create the scheduler and start its thread.
+      */
+    RTP_TransmitScheduler(
+      PThread::Priority priority = PThread::HighestPriority ///< Priority of the thread
+    );
+
+    /**Stop the scheduler thread.
+       Any stream still waiting is released immediately.
+      */
+    ~RTP_TransmitScheduler();
+  //@}
+
+  /**@name Operations */
+  //@{
+    /**Register a new stream with the scheduler.
+      */
+    Stream * Register(
+      const PString & name   ///< Name of stream for trace logs
+    );
+
+    /**Unregister and delete a stream.
+       This must be called from the thread that waits on the stream.
+      */
+    void Unregister(
+      Stream * stream        ///< Stream to remove
+    );
+
+    /**Wait until the next deadline for the stream.
+       The deadline advances by periodMs from the previous deadline. If the
+       stream has fallen more than a few periods behind it is resynchronised
+       to the current time rather than sending a burst to catch up.
+       Returns FALSE if the stream was unregistered or the scheduler is
+       shutting down.
+      */
+    PBoolean WaitDeadline(
+      Stream & stream,       ///< Stream to pace
+      unsigned periodMs      ///< Time from previous deadline in milliseconds
+    );
+
+    /**Get the number of streams registered.
+      */
+    PINDEX GetStreamCount() const { return streamCount; }
+  //@}
+
+  protected:
+    class Thread;
+    friend class Thread;
+
+    void Insert(Stream & stream);
+    void Unlink(Stream & stream);
+    void Advance(PInt64 now);
+    PInt64 GetNextExpiry() const;
+    void Main();
+
+    enum {
+      InnerBits  = 8,
+      InnerSlots = 1 << InnerBits,
+      OuterBits  = 6,
+      OuterSlots = 1 << OuterBits
+    };
+
+    Stream * inner[InnerSlots];
+    Stream * outer[OuterSlots];
+    PInt64   currentTick;
+    PInt64   nextWake;
+    PINDEX   pendingCount;
+    PINDEX   streamCount;
+    PBoolean shutdown;
+
+    PMutex     mutex;
+    PSyncPoint wakeUp;
+    Thread   * thread;
+};
+
+
+#endif // __OPAL_RTPSCHED_H
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,213 @@
+/*
+ * sigreactor.h
+ *
+ * Shared event driven H.225/H.245 signalling reactor
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#ifndef __OPAL_SIGREACTOR_H
+#define __OPAL_SIGREACTOR_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include "openh323buildopts.h"
+#include "h323affinity.h"
+
+#include <vector>
+
+class H323Transport;
+class H323Connection;
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**A signalling or control channel transport serviced by the signalling
+   reactor. The reactor reads whatever data is waiting on the transport,
+   splits it into TPKT frames and passes each one to HandlePDU(). The read
+   timeout of the transport is honoured by calling HandlePDU() with a
+   timeout error, exactly as the blocking read loop would see it.
+
+   The connection owns the handle and must remove it from the reactor
+   before deleting it or closing the transport.
+  */
+class H323SignallingHandle : public PObject
+{
+  PCLASSINFO(H323SignallingHandle, PObject);
+
+  public:
+  /**@name Construction */
+  //@{
+    /**Create a handle for the transport of a connection.
+      */
+    H323SignallingHandle(
+      H323Transport & transport,    ///< Transport to read
+      H323Connection & connection   ///< Connection the transport belongs to
+    );
+  //@}
+
+  /**@name Overrides */
+  //@{
+    /**Handle a received PDU. If ok is FALSE the read failed or timed out,
+       the transport error code indicates which.
+       Return FALSE to stop servicing the transport.
+      */
+    virtual PBoolean HandlePDU(
+      PBoolean ok,        ///< Read succeeded
+      PBYTEArray & pdu    ///< PDU without the TPKT header
+    ) = 0;
+
+    /**Called when the reactor stops servicing the transport because
+       HandlePDU() returned FALSE. Not called for RemoveHandle().
+      */
+    virtual void OnClose() { }
+  //@}
+
+  /**@name Operations */
+  //@{
+    /**Indicate the transport can be serviced by the reactor.
+       Only plain TCP transports qualify, TLS and the tunnelling transports
+       have their own read logic.
+      */
+    static PBoolean IsServiceable(
+      H323Transport & transport
+    );
+
+    /**Get the socket handle the reactor waits on.
+      */
+    int GetHandle() const;
+
+    /**Read the data waiting on the transport and dispatch complete PDUs.
+       Returns FALSE if the transport should no longer be serviced.
+      */
+    PBoolean OnReadable();
+
+    /**Dispatch the complete PDUs already in the receive buffer.
+       Returns FALSE if the transport should no longer be serviced.
+      */
+    PBoolean ProcessBuffer();
+
+    /**Indicate there is received data waiting to be processed.
+      */
+    PBoolean HasPending() const { return bufferLen > 0; }
+
+    /**Check the read timeout of the transport.
+       Returns FALSE if the transport should no longer be serviced.
+      */
+    PBoolean OnTick(
+      const PTimeInterval & now   ///< Current tick count
+    );
+
+    /**Get the connection the transport belongs to.
+      */
+    H323Connection & GetConnection() const { return connection; }
+  //@}
+
+  protected:
+    H323Transport  & transport;
+    H323Connection & connection;
+    PBYTEArray       buffer;
+    PINDEX           bufferLen;
+    PTimeInterval    lastActivity;
+};
+
+
+/**A small fixed pool of event loop threads servicing the H.225 and H.245
+   channels of many calls. Each worker waits on the sockets of the handles
+   assigned to it (epoll on Linux, kqueue on the BSDs and Mac OS X) and
+   dispatches readable sockets to H323SignallingHandle::OnReadable(). All the
+   handles of one connection go to the same worker, so the PDUs of a call are
+   still processed one at a time and in order.
+
+   This is the replacement for the H323_SIGNAL_AGGREGATE/PHandleAggregator
+   support which is tied to older versions of PTLib.
+  */
+class H323SignallingReactor : public PObject
+{
+  PCLASSINFO(H323SignallingReactor, PObject);
+
+  public:
+  /**@name Construction */
+  //@{
+    /**Create the reactor and start its worker threads.
+      */
+    H323SignallingReactor(
+      PINDEX threadCount,                   ///< Number of event loop threads
+      PINDEX stackSize = 30000,             ///< Stack size of the threads
+      const H323CPUSet & affinity = H323CPUSet() ///< CPUs the threads may run on
+    );
+
+    /**Stop all worker threads.
+       Any handles still registered are dropped without notification.
+      */
+    ~H323SignallingReactor();
+  //@}
+
+  /**@name Operations */
+  //@{
+    /**Indicate whether the platform has an event mechanism the reactor can use.
+      */
+    static PBoolean IsAvailable();
+
+    /**Add a handle to the worker already servicing its connection, or the
+       least loaded worker if there is none.
+       Returns FALSE if the handle could not be serviced by the reactor, in
+       which case the caller should fall back to a dedicated thread.
+      */
+    PBoolean AddHandle(
+      H323SignallingHandle & handle   ///< Handle to service
+    );
+
+    /**Remove a handle from the reactor.
+       On return the reactor is guaranteed not to be executing, or about to
+       execute, any call back into the handle.
+      */
+    void RemoveHandle(
+      H323SignallingHandle & handle   ///< Handle to remove
+    );
+
+    /**Get the number of worker threads in the reactor.
+      */
+    PINDEX GetThreadCount() const { return workers.size(); }
+
+    /**Get the number of handles currently serviced by the reactor.
+      */
+    PINDEX GetHandleCount() const;
+  //@}
+
+  protected:
+    class Worker;
+    friend class Worker;
+
+    std::vector<Worker *> workers;
+    PMutex                mutex;
+};
+
+
+#endif // __OPAL_SIGREACTOR_H
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -47,6 +47,98 @@ class MCS_DomainMCSPDU;
 
 ///////////////////////////////////////////////////////////////////////////////
 
+/**An MCS send data PDU, one of SDrq, SDin, USrq or USin, read in place
+   from the X.224 data TPDU carrying it. Its fields are taken from the
+   aligned PER encoding without decoding the whole MCS_DomainMCSPDU, and
+   its user data stays in the buffer the TPDU was read into, which is kept
+   for as long as the send data PDU is.
+
+   The TPDU can be written as it is to any number of transports, so the
+   user data of a channel is forwarded to every member of it without being
+   decoded or encoded again. A request is made into the indication sent
+   on by SetType(), which changes only the first byte of the MCS PDU.
+  */
+class OpalT120SendData : public PObject
+{
+    PCLASSINFO(OpalT120SendData, PObject);
+  public:
+    enum Types {
+      SendDataRequest          = 25,  ///< MCS_DomainMCSPDU::e_sdrq
+      SendDataIndication       = 26,  ///< MCS_DomainMCSPDU::e_sdin
+      UniformSendDataRequest   = 27,  ///< MCS_DomainMCSPDU::e_usrq
+      UniformSendDataIndication = 28  ///< MCS_DomainMCSPDU::e_usin
+    };
+
+    enum {
+      SegmentationBegin = 2,
+      SegmentationEnd   = 1,
+      MaxUserDataSize   = 16383      ///< Longest without a fragmented length
+    };
+
+    OpalT120SendData();
+
+    /**Parse the MCS PDU in an X.224 data TPDU. Returns FALSE if it is not
+       a send data PDU, or has user data too long for the single length
+       determinant read here, either of which the full decoder is for.
+      */
+    PBoolean Parse(
+      const X224 & x224
+    );
+
+    /**Build a send data PDU in an X.224 data TPDU. Returns FALSE if the
+       user data is longer than MaxUserDataSize.
+      */
+    PBoolean Build(
+      Types type,
+      unsigned initiator,         ///< MCS user ID, 1001 to 65535
+      unsigned channelId,
+      unsigned priority,          ///< 0 top to 3 low
+      unsigned segmentation,      ///< SegmentationBegin and SegmentationEnd bits
+      const BYTE * userData,
+      PINDEX userDataSize
+    );
+
+    /**Change the type of the PDU, other fields and user data unchanged.
+       The buffer is copied first if another PDU still refers to it.
+      */
+    void SetType(
+      Types type
+    );
+
+    /**Write the X.224 TPDU to a transport.
+      */
+    PBoolean Write(
+      H323Transport & transport
+    ) const;
+
+    Types GetType() const { return (Types)(tpdu[mcsOffset] >> 2); }
+    unsigned GetInitiator() const { return 1001 + Get16(mcsOffset+1); }
+    unsigned GetChannelId() const { return Get16(mcsOffset+3); }
+    unsigned GetDataPriority() const { return tpdu[mcsOffset+5] >> 6; }
+    unsigned GetSegmentation() const { return (tpdu[mcsOffset+5] >> 4)&3; }
+    const BYTE * GetUserData() const { return (const BYTE *)tpdu + userDataOffset; }
+    PINDEX GetUserDataSize() const { return tpdu.GetSize() - userDataOffset; }
+
+    /**Get the X.224 TPDU, length indicator first.
+      */
+    const PBYTEArray & GetTPDU() const { return tpdu; }
+
+    /**Get the MCS PDU where it is in the TPDU.
+      */
+    const BYTE * GetMCSPointer() const { return (const BYTE *)tpdu + mcsOffset; }
+    PINDEX GetMCSSize() const { return tpdu.GetSize() - mcsOffset; }
+
+    void PrintOn(ostream & strm) const;
+
+  protected:
+    unsigned Get16(PINDEX offset) const { return (tpdu[offset] << 8) | tpdu[offset+1]; }
+
+    PBYTEArray tpdu;
+    PINDEX     mcsOffset;
+    PINDEX     userDataOffset;
+};
+
+
 /**This class describes the T.120 protocol handler.
  */
 class OpalT120Protocol : public PObject
@@ -96,7 +188,25 @@ class OpalT120Protocol : public PObject
     virtual PBoolean HandleDomain(
       const MCS_DomainMCSPDU & pdu
     );
+
+    /**Handle incoming MCS send data PDU, read in place. Other domain PDUs
+       go to HandleDomain(). The default decodes it and calls
+       HandleDomain(), so a handler only of that sees every PDU.
+
+       If returns FALSE, then the reading loop should be terminated.
+      */
+    virtual PBoolean HandleSendData(
+      const OpalT120SendData & pdu
+    );
   //@}
+
+  protected:
+    /**Read the MCS PDUs after the X.224 connection, the connect PDUs and
+       then the domain PDUs, until a handler returns FALSE.
+      */
+    PBoolean HandlePDUs(
+      H323Transport & transport
+    );
 };
 
 
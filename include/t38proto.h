@@ -78,6 +78,17 @@ class OpalT38Protocol : public PObject
       const T38_IFPPacket & pdu
     );
 
+    /**Write an IFP packet already PER encoded to the T.38 connection.
+       The encoding is kept for the redundancy of the following packets so
+       nothing is encoded again. An application sending the same packets on
+       many connections, eg indicators, may encode each once and use this.
+      */
+    virtual PBoolean WriteEncodedPacket(
+      const BYTE * ifp,         ///< Encoded T38_IFPPacket
+      PINDEX size,              ///< Octets of the encoding
+      PINDEX maxRedundancy      ///< Earlier packets to send again after this one
+    );
+
     /**Write T.30 indicator packet to the T.38 connection.
       */
     virtual PBoolean WriteIndicator(
@@ -180,8 +191,23 @@ class OpalT38Protocol : public PObject
     unsigned lowSpeedRedundancy;
     unsigned highSpeedRedundancy;
 
+    PINDEX GetRedundancy(
+      const T38_IFPPacket & pdu
+    ) const;
+
     int               lastSentSequenceNumber;
-    H323List<PBYTEArray> redundantIFPs;
+
+    // Encoded IFPs last sent, newest at redundantIn-1, reused so sending allocates nothing
+    enum { MaxRedundantIFPs = 16 };
+    struct EncodedIFP {
+      PBYTEArray data;
+      PINDEX     size;
+    };
+    EncodedIFP  redundantIFPs[MaxRedundantIFPs];
+    unsigned    redundantIn;
+    PINDEX      redundantCount;
+    PBYTEArray  datagram;       ///< UDPTL packet assembled from the encodings
+    PMutex      writeMutex;
 };
 
 
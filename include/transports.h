@@ -41,8 +41,12 @@
 #include <ptlib/sockets.h>
 #include "ptlib_extras.h"
 
+#include <deque>
+
 #ifdef H323_TLS
 #include <ptclib/pssl.h>
+#include <list>
+#include <vector>
 #endif
 
 class H225_Setup_UUIE;
@@ -62,7 +66,54 @@ class H323Gatekeeper;
 
 ///////////////////////////////////////////////////////////////////////////////
 
+/**Compact binary form of an IP transport address, the address bytes and
+   port, for indexing and comparing addresses without formatting or parsing
+   their string form. A key that could not be made, such as from a host
+   name, is not valid and compares equal to every other such key.
+ */
+class H323TransportAddressKey
+{
+  public:
+    H323TransportAddressKey();
+    H323TransportAddressKey(const PIPSocket::Address & ip, WORD port);
+    H323TransportAddressKey(const H225_TransportAddress & pdu);
+    H323TransportAddressKey(const H245_TransportAddress & pdu);
+    H323TransportAddressKey(const H323TransportAddress & address);
+
+    /**Determine if the key holds an address.
+      */
+    bool IsValid() const { return length != 0; }
+
+    /**Get the IP address.
+      */
+    PIPSocket::Address GetIp() const;
+
+    /**Get the port, zero if the address has none.
+      */
+    WORD GetPort() const { return port; }
+
+    /**Get a hash of the address and port.
+      */
+    unsigned GetHash() const;
+
+    bool operator==(const H323TransportAddressKey & other) const;
+    bool operator!=(const H323TransportAddressKey & other) const { return !operator==(other); }
+    bool operator<(const H323TransportAddressKey & other) const;
+
+  protected:
+    void SetAddress(PINDEX size, const BYTE * bytes, WORD port);
+
+    BYTE length;      ///< 4 for IPv4, 16 for IPv6, 0 if not valid
+    BYTE bytes[16];
+    WORD port;
+};
+
+
 /**String representation of a transport address.
+   The IP address and port of an address made from a PDU, from binary
+   values or from a string holding a numeric address are also kept in
+   binary, so GetIpAndPort(), SetPDU() and IsEquivalent() need not parse
+   the string each time.
  */
 class H323TransportAddress : public PString
 {
@@ -149,12 +200,24 @@ class H323TransportAddress : public PString
       */
     void SetTLS(PBoolean isTLS);
 
+    /**Get the binary form of the address, not valid if the address is not
+       a numeric IP address.
+      */
+    H323TransportAddressKey GetKey() const;
+
   protected:
     void Validate();
+    void SetBinary(const PIPSocket::Address & ip, WORD port);
+    PBoolean GetBinary(PIPSocket::Address & ip, WORD & port) const;
 
   private:
     unsigned              m_version;
     PBoolean              m_tls;
+
+    // Binary form, in force while the string still shares its buffer with
+    // m_binaryOf, so any change made to the string in place drops it
+    H323TransportAddressKey m_binary;
+    PString               m_binaryOf;
 };
 
 
@@ -431,6 +494,16 @@ class H323Transport : public PIndirectChannel
       const H323TransportAddress & address
     ) { return SetRemoteAddress(address) && Connect(); }
 
+    /**Connect to the first of several addresses of the remote party that
+       answers, for example the targets of SRV records or the alternate
+       endpoints of an ACF, in order of preference.
+
+       The default behaviour tries each address in turn.
+      */
+    virtual PBoolean ConnectAny(
+      const H323TransportAddressArray & addresses
+    );
+
 
     /**Low level read from the channel.
      */
@@ -535,6 +608,16 @@ class H323Transport : public PIndirectChannel
       PBYTEArray & pdu   ///<  PDU read from transport
     ) = 0;
 
+    /**Move data that has been received but not yet returned by ReadPDU()
+       into the buffer at the offset, so another reader can take over the
+       transport. Returns the number of bytes moved.
+       The default behaviour returns zero as nothing is read ahead.
+      */
+    virtual PINDEX ExtractReadAhead(
+      PBYTEArray & /*buffer*/,  ///<  Buffer to append data to
+      PINDEX /*offset*/         ///<  Position in buffer for data
+    ) { return 0; }
+
     /**Extract a protocol data unit from the transport
        This is used by the aggregator to deblock the incoming data stream
        into valid PDUs.
@@ -561,6 +644,18 @@ class H323Transport : public PIndirectChannel
     virtual PBoolean WriteSignalPDU(
       const H323SignalPDU & /*pdu*/  /// PDU to write
     ) { return false; }
+
+    /**Write a transport header and the data following it as one write.
+       Where the transport can, the two are gathered by the system call
+       (writev/WSASend) so the data is not copied. The default behaviour
+       copies both into a single buffer and calls Write().
+      */
+    virtual PBoolean WriteFrame(
+      const BYTE * header,   ///<  Transport header
+      PINDEX headerLen,      ///<  Length of header
+      const BYTE * data,     ///<  Data following header
+      PINDEX dataLen         ///<  Length of data
+    );
   //@}
 
   /**@name Signalling Channel */
@@ -755,6 +850,239 @@ class H323TransportIP : public H323Transport
 ///////////////////////////////////////////////////////////////////////////////
 // Transport classes for TCP/IP
 
+/**This class is a TCP listening socket that may share its port with other
+   listening sockets through SO_REUSEPORT. The kernel then spreads incoming
+   connections across the sockets so each can be accepted on its own thread.
+ */
+class H323ListenerSocket : public PTCPSocket
+{
+  PCLASSINFO(H323ListenerSocket, PTCPSocket);
+
+  public:
+    H323ListenerSocket(
+      WORD port = 0,              ///<  TCP port to listen for connections
+      PBoolean reuse = FALSE      ///<  Share the port with other sockets
+    ) : PTCPSocket(port), reusePort(reuse) { }
+
+    /**Indicate whether the platform can share a listening port.
+      */
+    static PBoolean IsReusePortAvailable();
+
+    /**Set the socket to share its port, must be called before Listen().
+      */
+    void SetReusePort(PBoolean enable) { reusePort = enable; }
+
+  protected:
+    virtual PBoolean OpenSocket(int ipAdressFamily);
+
+    PBoolean reusePort;
+};
+
+
+class H225TransportThread;
+
+/**This class is a pool of signalling threads started ahead of incoming
+   calls, so the accept loop does not wait for a thread to be created.
+   Each thread handles one call, a replacement is started by the thread
+   taking the call rather than by the listener.
+ */
+class H225TransportThreadPool : public PObject
+{
+  PCLASSINFO(H225TransportThreadPool, PObject);
+
+  public:
+    /**Create a pool of the given number of waiting threads.
+      */
+    H225TransportThreadPool(
+      H323EndPoint & endpoint,    ///<  Endpoint instance for threads
+      PINDEX size                 ///<  Number of threads kept waiting
+    );
+
+    /**Wake and release all waiting threads.
+      */
+    ~H225TransportThreadPool();
+
+    /**Hand an accepted transport to a waiting thread.
+       Returns FALSE if no thread is waiting, the caller then starts its own.
+      */
+    PBoolean Dispatch(
+      H323Transport * transport   ///<  Transport awaiting its first PDU
+    );
+
+    /**Get the number of threads kept waiting.
+      */
+    PINDEX GetSize() const { return size; }
+
+  protected:
+    void Spawn();
+    H323Transport * WaitForTransport();
+
+    H323EndPoint & endpoint;
+    PINDEX         size;
+    PMutex         mutex;
+    PSemaphore     available;
+    PSyncPoint     stopped;
+    PQueue<H323Transport> waiting;
+    PINDEX         idle;
+    PINDEX         pooled;
+    PBoolean       closing;
+
+  friend class H225TransportThread;
+};
+
+
+class H225CallWorker;
+
+/**This class is a bounded pool of threads making outgoing calls, started
+   ahead of the calls, so MakeCall() queues the call instead of creating a
+   thread for it. A worker sends the SETUP, with the ARQ and connect that
+   go before it, then hands the signalling channel to the signalling
+   reactor and takes the next call. Without the reactor the worker stays
+   with its call as the signalling thread and a new worker joins the pool.
+
+   Calls beyond the queue limit are refused, MakeCall() then clears them
+   with EndedByLocalCongestion.
+ */
+class H225CallThreadPool : public PObject
+{
+  PCLASSINFO(H225CallThreadPool, PObject);
+
+  public:
+    /**Create a pool of the given number of threads.
+      */
+    H225CallThreadPool(
+      H323EndPoint & endpoint,    ///<  Endpoint instance for threads
+      PINDEX size,                ///<  Number of threads making calls
+      PINDEX queueLimit           ///<  Calls waiting for a thread, zero for no limit
+    );
+
+    /**Stop the threads once they finish the calls they are making.
+       Calls still queued are left to be cleared by the endpoint.
+      */
+    ~H225CallThreadPool();
+
+    /**Queue the SETUP of a call for a worker.
+       Returns FALSE if the pool is closing or the queue is full.
+      */
+    PBoolean Dispatch(
+      const PString & token,                ///<  Token of the connection
+      const PString & alias,                ///<  Alias to call
+      const H323TransportAddress & address  ///<  Address to call
+    );
+
+    /**Get the number of threads making calls.
+      */
+    PINDEX GetSize() const { return size; }
+
+    /**Get the number of calls waiting for a thread.
+      */
+    PINDEX GetQueued() const;
+
+  protected:
+    struct Call {
+      PString              token;
+      PString              alias;
+      H323TransportAddress address;
+      PTimeInterval        queued;
+    };
+
+    void Spawn();
+    PBoolean WaitForCall(Call & call);
+    void Detach();
+
+    H323EndPoint & endpoint;
+    PINDEX         size;
+    PINDEX         queueLimit;
+    mutable PMutex mutex;
+    PSemaphore     available;
+    PSyncPoint     stopped;
+    std::deque<Call> queue;
+    PINDEX         workers;     // Threads in the pool, not those kept by a call
+    PBoolean       closing;
+
+  friend class H225CallWorker;
+};
+
+
+#ifdef H323_TLS
+
+class H323TransportTCP;
+
+/**This class is a bounded pool of threads doing the TLS handshakes of
+   signalling channels, so the key exchange of a burst of new TLS calls
+   neither holds up the accept loop nor takes more of the processors than
+   the pool has threads, leaving the rest to calls in progress.
+
+   A listener hands each accepted TLS transport to the pool and goes back
+   to accepting; the transport is passed on to a signalling thread once its
+   handshake completes. A connecting transport has its handshake done by
+   the pool while the calling thread waits.
+ */
+class H323TLSHandshakePool : public PObject
+{
+  PCLASSINFO(H323TLSHandshakePool, PObject);
+
+  public:
+    /**Create a pool of up to the given number of threads, started as
+       handshakes are queued.
+      */
+    H323TLSHandshakePool(
+      H323EndPoint & endpoint,    ///<  Endpoint instance for threads
+      PINDEX maxWorkers           ///<  Handshakes done at once
+    );
+
+    /**Stop the threads. Accepted transports still queued are closed and
+       connects still queued fail.
+      */
+    ~H323TLSHandshakePool();
+
+    /**Queue the handshake of an accepted transport. The pool owns the
+       transport, which goes to a signalling thread after its handshake or
+       is deleted if the handshake fails or too many are queued.
+      */
+    void Accept(
+      H323Transport * transport   ///<  Transport awaiting its handshake
+    );
+
+    /**Do the handshake of a connecting transport on a pool thread,
+       waiting for it to complete.
+      */
+    PBoolean Connect(
+      H323TransportTCP & transport  ///<  Transport awaiting its handshake
+    );
+
+    /**Get the number of handshakes done at once.
+      */
+    PINDEX GetMaxWorkers() const { return maxWorkers; }
+
+    /**Get the number of handshakes waiting for a thread.
+      */
+    PINDEX GetQueued() const { return (PINDEX)queue.size(); }
+
+  protected:
+    struct Job {
+      H323Transport    * accepted;
+      H323TransportTCP * connecting;
+      PSyncPoint       * done;
+      PBoolean         * result;
+    };
+
+    void Queue(const Job & job);
+    PDECLARE_NOTIFIER(PThread, H323TLSHandshakePool, WorkerMain);
+
+    H323EndPoint & endpoint;
+    PINDEX         maxWorkers;
+    std::list<Job> queue;
+    std::vector<PThread *> workers;
+    PINDEX         idleWorkers;
+    PBoolean       stopping;
+    PMutex         mutex;
+    PSemaphore     queued;
+};
+
+#endif // H323_TLS
+
+
 /**This class manages H323 connections using TCP/IP transport.
  */
 class H323ListenerTCP : public H323Listener
@@ -824,10 +1152,27 @@ class H323ListenerTCP : public H323Listener
      */
     virtual void Main();
 
+    /**Accept a new incoming transport on one of the listening sockets.
+      */
+    H323Transport * AcceptFrom(
+      PTCPSocket & socket,           ///<  Listening socket to accept on
+      const PTimeInterval & timeout, ///<  Time to wait for incoming connection
+      PBoolean offload = FALSE       ///<  Pass a TLS transport to the handshake pool, returning NULL
+    );
+
+    /**Start the signalling thread for an accepted transport.
+      */
+    void StartTransport(
+      H323Transport * transport      ///<  Transport awaiting its first PDU
+    );
+
+    PDECLARE_NOTIFIER(PThread, H323ListenerTCP, AcceptorMain);
 
-    PTCPSocket listener;
+    H323ListenerSocket listener;
     PIPSocket::Address localAddress;
     PBoolean exclusiveListener;
+    PList<H323ListenerSocket> extraListeners;
+    PList<PThread> acceptors;
 };
 
 //////////////////////////////////////////////////////////////////////////////////
@@ -912,6 +1257,16 @@ class H323TransportTCP : public H323TransportIP
       */
     virtual PBoolean Connect();
 
+    /**Connect to the first of several addresses to answer. A connection is
+       started to each address in turn, the endpoint signalling connect
+       stagger apart or as soon as an earlier one fails, without waiting
+       for the earlier ones to time out. The first connection established
+       is used and the others are abandoned.
+      */
+    virtual PBoolean ConnectAny(
+      const H323TransportAddressArray & addresses
+    );
+
     /**This callback is executed when the OnOpen() function is called with
        open channels. It may be used by descendent channels to do any
        handshaking required by the protocol that channel embodies.
@@ -936,6 +1291,14 @@ class H323TransportTCP : public H323TransportIP
       PBYTEArray & pdu   ///<  PDU read from transport
     );
 
+    /**Move data that has been received but not yet returned by ReadPDU()
+       into the buffer at the offset.
+      */
+    PINDEX ExtractReadAhead(
+      PBYTEArray & buffer,
+      PINDEX offset
+    );
+
     /**Extract a protocol data unit from the transport
       */
     PBoolean ExtractPDU(
@@ -952,6 +1315,17 @@ class H323TransportTCP : public H323TransportIP
       const PBYTEArray & pdu  ///<  PDU to write
     );
 
+    /**Write a transport header and the data following it as one write.
+       On a plain TCP socket the two are gathered by a single writev()
+       (WSASend() on Windows) call, a TLS channel copies them.
+      */
+    virtual PBoolean WriteFrame(
+      const BYTE * header,
+      PINDEX headerLen,
+      const BYTE * data,
+      PINDEX dataLen
+    );
+
     /**Begin the opening of a control channel.
        This sets up the channel so that the remote endpoint can connect back
        to this endpoint.
@@ -992,10 +1366,15 @@ class H323TransportTCP : public H323TransportIP
       */
     virtual PBoolean FinaliseSecurity(PSocket * socket);
 
-    /**Do SSL Connect handshake
+    /**Do SSL Connect handshake, on the endpoint TLS handshake pool if it
+       has one.
       */
     virtual PBoolean SecureConnect();
 
+    /**Do SSL Connect handshake on the current thread.
+      */
+    PBoolean HandshakeConnect();
+
     /**Do SSL Accept handshake
       */
     virtual PBoolean SecureAccept();
@@ -1012,14 +1391,48 @@ class H323TransportTCP : public H323TransportIP
      */
     virtual PBoolean OnOpen();
 
+#ifdef H323_TLS
+    /**Note a TLS handshake in the session cache and metrics.
+     */
+    void OnSecureHandshake(ssl_st * tls, PBoolean client, PInt64 start, PBoolean ok);
+#endif
+
 
     PTCPSocket * h245listener;
+
+    // Data received beyond the PDU last returned by ReadPDU()
+    PBYTEArray readAhead;
+    PINDEX     readAheadStart;
+    PINDEX     readAheadLength;
 };
 
 
 ///////////////////////////////////////////////////////////////////////////////
 // Transport classes for UDP/IP
 
+class RTP_DatagramBatch;
+
+/**UDP socket that can share its port with other sockets, so several RAS
+   listeners on one port each take their own share of the requests. The
+   kernel hashes each remote address to one socket, so retransmissions of
+   a request reach the listener holding its response.
+  */
+class H323DatagramSocket : public PUDPSocket
+{
+  PCLASSINFO(H323DatagramSocket, PUDPSocket);
+
+  public:
+    H323DatagramSocket(
+      PBoolean reuse = FALSE      ///<  Share the port with other sockets
+    ) : reusePort(reuse) { }
+
+  protected:
+    virtual PBoolean OpenSocket(int ipAdressFamily);
+
+    PBoolean reusePort;
+};
+
+
 /**This class represents a particular H323 transport using UDP/IP.
  */
 class H323TransportUDP : public H323TransportIP
@@ -1033,7 +1446,8 @@ class H323TransportUDP : public H323TransportIP
       H323EndPoint & endpoint,                  ///<  H323 End Point object
       PIPSocket::Address binding = PIPSocket::GetDefaultIpAny(),  ///<  Local interface to listen on
       WORD localPort = 0,                       ///<  Local port to listen on
-      WORD remotePort = 0                       ///<  Remote port to connect on
+      WORD remotePort = 0,                      ///<  Remote port to connect on
+      PBoolean reusePort = FALSE                ///<  Share the local port with other sockets
     );
     ~H323TransportUDP();
 
@@ -1080,6 +1494,14 @@ class H323TransportUDP : public H323TransportIP
       PBYTEArray & pdu   ///<  PDU read from transport
     );
 
+    /**Set the number of datagrams ReadPDU() takes from the socket in one
+       system call, handing the rest out on the following calls. Used by
+       busy RAS listeners, a count of one or less reads one at a time.
+      */
+    void SetReadBatchSize(
+      PINDEX count    ///<  Maximum datagrams per read
+    );
+
     /**Extract a protocol data unit from the transport
       */
     PBoolean ExtractPDU(
@@ -1114,8 +1536,13 @@ class H323TransportUDP : public H323TransportIP
   protected:
     PromisciousModes     promiscuousReads;
     H323TransportAddress lastReceivedAddress;
+    PIPSocket::Address   lastReceivedIP;      // Same as lastReceivedAddress, for comparisons
+    WORD                 lastReceivedPort;
     PIPSocket::Address   lastReceivedInterface;
     WORD interfacePort;
+
+    RTP_DatagramBatch  * readBatch;
+    PBYTEArray           readBuffer;
 };
 
 
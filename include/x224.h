@@ -42,6 +42,11 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 /**This class embodies X.224 Class Zero Protocol Data Unit.
+
+   The TPDU is kept encoded, length indicator first, in one buffer. A
+   decoded TPDU refers to the buffer it was decoded from rather than
+   copying it, and its data is got as a pointer into that buffer, so data
+   can be handed up to the layer above without a copy.
   */
 class X224 : public PObject
 {
@@ -59,17 +64,44 @@ class X224 : public PObject
     void BuildConnectRequest();
     void BuildConnectConfirm();
     void BuildData(const PBYTEArray & data);
+    void BuildData(const BYTE * data, PINDEX size);
 
     void PrintOn(ostream & strm) const;
+
+    /**Decode a TPDU, sharing rawData rather than copying it.
+      */
     PBoolean Decode(const PBYTEArray & rawData);
+
+    /**Encode the TPDU, rawData is made to share the buffer of the TPDU.
+      */
     PBoolean Encode(PBYTEArray & rawData) const;
 
-    int GetCode() const { return header[0]; }
-    const PBYTEArray & GetData() const { return data; }
+    int GetCode() const { return pdu.GetSize() > 1 ? pdu[1] : 0; }
+
+    /**Get a copy of the data of the TPDU.
+      */
+    PBYTEArray GetData() const;
+
+    /**Get the data of the TPDU where it is in the buffer of the TPDU.
+      */
+    const BYTE * GetDataPointer() const { return (const BYTE *)pdu + dataOffset; }
+    PINDEX GetDataSize() const { return pdu.GetSize() - dataOffset; }
+
+    /**Get the encoded TPDU, length indicator first.
+      */
+    const PBYTEArray & GetPDU() const { return pdu; }
+
+  protected:
+    /**Get the buffer to read the next TPDU into. This is the buffer of the
+       last TPDU when nothing else still refers to it, so reading a stream
+       of TPDUs does not allocate one buffer per TPDU.
+      */
+    PBYTEArray & GetReadBuffer();
+
+    BYTE * SetHeader(BYTE code, PINDEX headerLength, PINDEX dataSize);
 
-  private:
-    PBYTEArray header;
-    PBYTEArray data;
+    PBYTEArray pdu;
+    PINDEX     dataOffset;
 };
 
 
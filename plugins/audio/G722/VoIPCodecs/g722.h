@@ -60,6 +60,11 @@ enum
     G722_PACKED = 0x0002
 };
 
+/*! Samples of history the QMF keeps between blocks */
+#define G722_QMF_HISTORY    22
+/*! Most sample pairs run through the QMF as one block, a 20ms frame */
+#define G722_QMF_PAIRS      160
+
 typedef struct
 {
     /*! TRUE if the operating in the special ITU test mode, with the band split filters
@@ -72,8 +77,9 @@ typedef struct
     /*! 6 for 48000kbps, 7 for 56000kbps, or 8 for 64000kbps. */
     int bits_per_sample;
 
-    /*! Signal history for the QMF */
-    int x[24];
+    /*! Signal history for the QMF, oldest first, and the block of input
+        samples after it */
+    int16_t x[G722_QMF_HISTORY + 2*G722_QMF_PAIRS];
 
     struct
     {
@@ -110,8 +116,9 @@ typedef struct
     /*! 6 for 48000kbps, 7 for 56000kbps, or 8 for 64000kbps. */
     int bits_per_sample;
 
-    /*! Signal history for the QMF */
-    int x[24];
+    /*! Signal history for the QMF, oldest first, and the block of band
+        sums and differences after it */
+    int16_t x[G722_QMF_HISTORY + 2*G722_QMF_PAIRS];
 
     struct
     {
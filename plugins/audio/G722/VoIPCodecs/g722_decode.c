@@ -49,6 +49,7 @@
 #include "telephony.h"
 #include "dc_restore.h"
 #include "g722.h"
+#include "g722_qmf.h"
 
 static void block4(g722_decode_state_t *s, int band, int d);
 
@@ -242,26 +243,21 @@ int g722_decode(g722_decode_state_t *s, int16_t amp[], const uint8_t g722_data[]
            1688,   1360,   1040,    728,
             432,    136,   -432,   -136
     };
-    static const int qmf_coeffs[12] =
-    {
-           3,  -11,   12,   32, -210,  951, 3876, -805,  362, -156,   53,  -11,
-    };
     int dlowt;
     int rlow;
     int ihigh;
     int dhigh;
     int rhigh;
-    int xout1;
-    int xout2;
+    int qmf_pairs;
     int wd1;
     int wd2;
     int wd3;
     int code;
     int outlen;
-    int i;
     int j;
 
     outlen = 0;
+    qmf_pairs = 0;
     rhigh = 0;
     for (j = 0;  j < len;  )
     {
@@ -380,23 +376,24 @@ int g722_decode(g722_decode_state_t *s, int16_t amp[], const uint8_t g722_data[]
             }
             else
             {
-                /* Apply the receive QMF */
-                memcpy(s->x, &s->x[2], 22*sizeof(s->x[0]));
-                s->x[22] = rlow + rhigh;
-                s->x[23] = rlow - rhigh;
-
-                xout1 = 0;
-                xout2 = 0;
-                for (i = 0;  i < 12;  i++)
+                /* Apply the receive QMF, to a block of sample pairs at a
+                   time. The limited bands sum and differ within 16 bits. */
+                s->x[G722_QMF_HISTORY + 2*qmf_pairs] = (int16_t) (rlow + rhigh);
+                s->x[G722_QMF_HISTORY + 2*qmf_pairs + 1] = (int16_t) (rlow - rhigh);
+                if (++qmf_pairs == G722_QMF_PAIRS)
                 {
-                    xout2 += s->x[2*i]*qmf_coeffs[i];
-                    xout1 += s->x[2*i + 1]*qmf_coeffs[11 - i];
+                    g722_qmf_synthesis(s->x, qmf_pairs, &amp[outlen]);
+                    outlen += 2*qmf_pairs;
+                    qmf_pairs = 0;
                 }
-                amp[outlen++] = (int16_t) (xout1 >> 12);
-                amp[outlen++] = (int16_t) (xout2 >> 12);
             }
         }
     }
+    if (qmf_pairs > 0)
+    {
+        g722_qmf_synthesis(s->x, qmf_pairs, &amp[outlen]);
+        outlen += 2*qmf_pairs;
+    }
     return outlen;
 }
 /*- End of function --------------------------------------------------------*/
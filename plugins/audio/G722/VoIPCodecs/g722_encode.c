@@ -49,6 +49,7 @@
 #include "telephony.h"
 #include "dc_restore.h"
 #include "g722.h"
+#include "g722_qmf.h"
 
 static void block4(g722_encode_state_t *s, int band, int d)
 {
@@ -222,10 +223,6 @@ int g722_encode(g722_encode_state_t *s, uint8_t g722_data[], const int16_t amp[]
     {
         -7408,  -1616,   7408,   1616
     };
-    static const int qmf_coeffs[12] =
-    {
-           3,  -11,   12,   32, -210,  951, 3876, -805,  362, -156,   53,  -11,
-    };
     static const int ihn[3] = {0, 1, 0};
     static const int ihp[3] = {0, 3, 2};
     static const int wh[3] = {0, -214, 798};
@@ -248,16 +245,19 @@ int g722_encode(g722_encode_state_t *s, uint8_t g722_data[], const int16_t amp[]
     /* Low and high band PCM from the QMF */
     int xlow;
     int xhigh;
+    int qmf_low[G722_QMF_PAIRS];
+    int qmf_high[G722_QMF_PAIRS];
+    int qmf_pairs;
+    int qmf_next;
     int g722_bytes;
-    /* Even and odd tap accumulators */
-    int sumeven;
-    int sumodd;
     int ihigh;
     int ilow;
     int code;
 
     g722_bytes = 0;
     xhigh = 0;
+    qmf_pairs = 0;
+    qmf_next = 0;
     for (j = 0;  j < len;  )
     {
         if (s->itu_test_mode)
@@ -273,22 +273,22 @@ int g722_encode(g722_encode_state_t *s, uint8_t g722_data[], const int16_t amp[]
             }
             else
             {
-                /* Apply the transmit QMF */
-                /* Shuffle the buffer down */
-                memcpy(s->x, &s->x[2], 22*sizeof(s->x[0]));
-                s->x[22] = amp[j++];
-                s->x[23] = amp[j++];
-    
-                /* Discard every other QMF output */
-                sumeven = 0;
-                sumodd = 0;
-                for (i = 0;  i < 12;  i++)
+                /* Apply the transmit QMF, to a block of sample pairs at
+                   a time. A trailing odd sample has no pair to go with. */
+                if (qmf_next >= qmf_pairs)
                 {
-                    sumodd += s->x[2*i]*qmf_coeffs[i];
-                    sumeven += s->x[2*i + 1]*qmf_coeffs[11 - i];
+                    qmf_pairs = (len - j) >> 1;
+                    if (qmf_pairs > G722_QMF_PAIRS)
+                        qmf_pairs = G722_QMF_PAIRS;
+                    if (qmf_pairs == 0)
+                        break;
+                    memcpy(&s->x[G722_QMF_HISTORY], &amp[j], 2*qmf_pairs*sizeof(s->x[0]));
+                    g722_qmf_analysis(s->x, qmf_pairs, qmf_low, qmf_high);
+                    qmf_next = 0;
                 }
-                xlow = (sumeven + sumodd) >> 13;
-                xhigh = (sumeven - sumodd) >> 13;
+                xlow = qmf_low[qmf_next];
+                xhigh = qmf_high[qmf_next++];
+                j += 2;
             }
         }
         /* Block 1L, SUBTRA */
@@ -0,0 +1,289 @@
+/*
+ * g722_qmf.c
+ *
+ * The G.722 QMF band split and band merge filters, over a block of sample
+ * pairs at a time so the 24 tap filter can be run as vectors. The SSE2
+ * kernel is chosen at run time by the processor, and gives exactly the
+ * integer sums of the scalar filter, which cannot overflow 32 bits.
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * $Id$
+ */
+
+/*! \file */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "inttypes.h"
+#include <memory.h>
+
+#include "g722.h"
+#include "g722_qmf.h"
+
+#ifndef G722_NO_SIMD
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__)) && \
+    (__GNUC__ >= 5 || defined(__clang__))
+#define G722_SSE2        1
+#define G722_SSE2_TARGET __attribute__((target("sse2")))
+#include <emmintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define G722_SSE2        1
+#define G722_SSE2_TARGET
+#include <emmintrin.h>
+#include <intrin.h>
+#endif
+#endif
+
+static const int qmf_coeffs[12] =
+{
+       3,  -11,   12,   32, -210,  951, 3876, -805,  362, -156,   53,  -11,
+};
+
+static void qmf_analysis_scalar(const int16_t x[], int first, int pairs, int xlow[], int xhigh[])
+{
+    const int16_t *w;
+    int sumeven;
+    int sumodd;
+    int i;
+    int n;
+
+    for (n = first;  n < pairs;  n++)
+    {
+        /* Discard every other QMF output */
+        w = &x[2*n];
+        sumeven = 0;
+        sumodd = 0;
+        for (i = 0;  i < 12;  i++)
+        {
+            sumodd += w[2*i]*qmf_coeffs[i];
+            sumeven += w[2*i + 1]*qmf_coeffs[11 - i];
+        }
+        xlow[n] = (sumeven + sumodd) >> 13;
+        xhigh[n] = (sumeven - sumodd) >> 13;
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static void qmf_synthesis_scalar(const int16_t x[], int first, int pairs, int16_t amp[])
+{
+    const int16_t *w;
+    int xout1;
+    int xout2;
+    int i;
+    int n;
+
+    for (n = first;  n < pairs;  n++)
+    {
+        w = &x[2*n];
+        xout1 = 0;
+        xout2 = 0;
+        for (i = 0;  i < 12;  i++)
+        {
+            xout2 += w[2*i]*qmf_coeffs[i];
+            xout1 += w[2*i + 1]*qmf_coeffs[11 - i];
+        }
+        amp[2*n] = (int16_t) (xout1 >> 12);
+        amp[2*n + 1] = (int16_t) (xout2 >> 12);
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+#if defined(G722_SSE2)
+
+/* The taps interleaved as they meet the signal, so one multiply-add of a
+   window of the signal gives the sum of each even and odd tap in turn. The
+   low band is the even taps plus the odd, the high band the odd less the
+   even, and the band merge takes the even and odd taps apart. */
+static const int16_t qmf_low_taps[24] =
+{
+       3,  -11,  -11,   53,   12, -156,   32,  362, -210, -805,  951, 3876,
+    3876,  951, -805, -210,  362,   32, -156,   12,   53,  -11,  -11,    3
+};
+static const int16_t qmf_high_taps[24] =
+{
+      -3,  -11,   11,   53,  -12, -156,  -32,  362,  210, -805, -951, 3876,
+   -3876,  951,  805, -210, -362,   32,  156,   12,  -53,  -11,   11,    3
+};
+static const int16_t qmf_even_taps[24] =
+{
+       3,    0,  -11,    0,   12,    0,   32,    0, -210,    0,  951,    0,
+    3876,    0, -805,    0,  362,    0, -156,    0,   53,    0,  -11,    0
+};
+static const int16_t qmf_odd_taps[24] =
+{
+       0,  -11,    0,   53,    0, -156,    0,  362,    0, -805,    0, 3876,
+       0,  951,    0, -210,    0,   32,    0,   12,    0,  -11,    0,    3
+};
+
+#if defined(_MSC_VER)
+static int cpu_has_sse2(void)
+{
+    int info[4];
+
+    __cpuid(info, 1);
+    return (info[3] & (1 << 26)) != 0;
+}
+#else
+static int cpu_has_sse2(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2") != 0;
+}
+#endif
+/*- End of function --------------------------------------------------------*/
+
+static int use_sse2(void)
+{
+    /* Racing threads all find the same answer */
+    static int sse2 = -1;
+
+    if (sse2 < 0)
+        sse2 = cpu_has_sse2();
+    return sse2;
+}
+/*- End of function --------------------------------------------------------*/
+
+/* Sums of groups of four 32 bit lanes, lane n of the result taking vector n */
+G722_SSE2_TARGET
+static __m128i hadd4_sse2(__m128i a, __m128i b, __m128i c, __m128i d)
+{
+    __m128i ab = _mm_add_epi32(_mm_unpacklo_epi32(a, b), _mm_unpackhi_epi32(a, b));
+    __m128i cd = _mm_add_epi32(_mm_unpacklo_epi32(c, d), _mm_unpackhi_epi32(c, d));
+
+    return _mm_add_epi32(_mm_unpacklo_epi64(ab, cd), _mm_unpackhi_epi64(ab, cd));
+}
+/*- End of function --------------------------------------------------------*/
+
+/* The 24 tap dot product of the window starting at w, in four lanes */
+G722_SSE2_TARGET
+static __m128i qmf_dot_sse2(const int16_t *w, __m128i t0, __m128i t1, __m128i t2)
+{
+    __m128i sum;
+
+    sum = _mm_madd_epi16(_mm_loadu_si128((const __m128i *) w), t0);
+    sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_loadu_si128((const __m128i *) (w + 8)), t1));
+    return _mm_add_epi32(sum, _mm_madd_epi16(_mm_loadu_si128((const __m128i *) (w + 16)), t2));
+}
+/*- End of function --------------------------------------------------------*/
+
+G722_SSE2_TARGET
+static int qmf_analysis_sse2(const int16_t x[], int pairs, int xlow[], int xhigh[])
+{
+    const __m128i l0 = _mm_loadu_si128((const __m128i *) qmf_low_taps);
+    const __m128i l1 = _mm_loadu_si128((const __m128i *) (qmf_low_taps + 8));
+    const __m128i l2 = _mm_loadu_si128((const __m128i *) (qmf_low_taps + 16));
+    const __m128i h0 = _mm_loadu_si128((const __m128i *) qmf_high_taps);
+    const __m128i h1 = _mm_loadu_si128((const __m128i *) (qmf_high_taps + 8));
+    const __m128i h2 = _mm_loadu_si128((const __m128i *) (qmf_high_taps + 16));
+    const int16_t *w;
+    __m128i low;
+    __m128i high;
+    int n;
+
+    /* Four pairs at a time, the rest left to the scalar filter */
+    for (n = 0;  n + 4 <= pairs;  n += 4)
+    {
+        w = &x[2*n];
+        low = hadd4_sse2(qmf_dot_sse2(w, l0, l1, l2),
+                         qmf_dot_sse2(w + 2, l0, l1, l2),
+                         qmf_dot_sse2(w + 4, l0, l1, l2),
+                         qmf_dot_sse2(w + 6, l0, l1, l2));
+        high = hadd4_sse2(qmf_dot_sse2(w, h0, h1, h2),
+                          qmf_dot_sse2(w + 2, h0, h1, h2),
+                          qmf_dot_sse2(w + 4, h0, h1, h2),
+                          qmf_dot_sse2(w + 6, h0, h1, h2));
+        _mm_storeu_si128((__m128i *) &xlow[n], _mm_srai_epi32(low, 13));
+        _mm_storeu_si128((__m128i *) &xhigh[n], _mm_srai_epi32(high, 13));
+    }
+    return n;
+}
+/*- End of function --------------------------------------------------------*/
+
+G722_SSE2_TARGET
+static int qmf_synthesis_sse2(const int16_t x[], int pairs, int16_t amp[])
+{
+    const __m128i e0 = _mm_loadu_si128((const __m128i *) qmf_even_taps);
+    const __m128i e1 = _mm_loadu_si128((const __m128i *) (qmf_even_taps + 8));
+    const __m128i e2 = _mm_loadu_si128((const __m128i *) (qmf_even_taps + 16));
+    const __m128i o0 = _mm_loadu_si128((const __m128i *) qmf_odd_taps);
+    const __m128i o1 = _mm_loadu_si128((const __m128i *) (qmf_odd_taps + 8));
+    const __m128i o2 = _mm_loadu_si128((const __m128i *) (qmf_odd_taps + 16));
+    const int16_t *w;
+    __m128i xout1;
+    __m128i xout2;
+    __m128i first;
+    __m128i second;
+    int n;
+
+    for (n = 0;  n + 4 <= pairs;  n += 4)
+    {
+        w = &x[2*n];
+        xout1 = hadd4_sse2(qmf_dot_sse2(w, o0, o1, o2),
+                           qmf_dot_sse2(w + 2, o0, o1, o2),
+                           qmf_dot_sse2(w + 4, o0, o1, o2),
+                           qmf_dot_sse2(w + 6, o0, o1, o2));
+        xout2 = hadd4_sse2(qmf_dot_sse2(w, e0, e1, e2),
+                           qmf_dot_sse2(w + 2, e0, e1, e2),
+                           qmf_dot_sse2(w + 4, e0, e1, e2),
+                           qmf_dot_sse2(w + 6, e0, e1, e2));
+        xout1 = _mm_srai_epi32(xout1, 12);
+        xout2 = _mm_srai_epi32(xout2, 12);
+
+        /* Interleave the outputs, and wrap them to 16 bits as the cast in
+           the scalar filter does, so the saturating pack leaves them be */
+        first = _mm_unpacklo_epi32(xout1, xout2);
+        second = _mm_unpackhi_epi32(xout1, xout2);
+        first = _mm_srai_epi32(_mm_slli_epi32(first, 16), 16);
+        second = _mm_srai_epi32(_mm_slli_epi32(second, 16), 16);
+        _mm_storeu_si128((__m128i *) &amp[2*n], _mm_packs_epi32(first, second));
+    }
+    return n;
+}
+/*- End of function --------------------------------------------------------*/
+
+#endif
+
+void g722_qmf_analysis(int16_t x[], int pairs, int xlow[], int xhigh[])
+{
+    int n;
+
+    n = 0;
+#if defined(G722_SSE2)
+    if (use_sse2())
+        n = qmf_analysis_sse2(x, pairs, xlow, xhigh);
+#endif
+    qmf_analysis_scalar(x, n, pairs, xlow, xhigh);
+
+    /* Shuffle the history down */
+    memmove(x, &x[2*pairs], G722_QMF_HISTORY*sizeof(x[0]));
+}
+/*- End of function --------------------------------------------------------*/
+
+void g722_qmf_synthesis(int16_t x[], int pairs, int16_t amp[])
+{
+    int n;
+
+    n = 0;
+#if defined(G722_SSE2)
+    if (use_sse2())
+        n = qmf_synthesis_sse2(x, pairs, amp);
+#endif
+    qmf_synthesis_scalar(x, n, pairs, amp);
+
+    memmove(x, &x[2*pairs], G722_QMF_HISTORY*sizeof(x[0]));
+}
+/*- End of function --------------------------------------------------------*/
+/*- End of file ------------------------------------------------------------*/
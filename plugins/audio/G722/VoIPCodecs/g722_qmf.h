@@ -0,0 +1,56 @@
+/*
+ * g722_qmf.h
+ *
+ * The G.722 QMF band split and band merge filters, over a block of sample
+ * pairs at a time.
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * $Id$
+ */
+
+/*! \file */
+
+#if !defined(_G722_QMF_H_)
+#define _G722_QMF_H_
+
+#include "g722.h"
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif
+
+/*! Split pairs of 16k samples/second audio into the low and high bands.
+    \param x The QMF signal, G722_QMF_HISTORY samples of history followed
+           by the 2*pairs new samples. The history is moved up to the last
+           of the new samples on return.
+    \param pairs The number of sample pairs, at most G722_QMF_PAIRS.
+    \param xlow The low band, one sample per pair.
+    \param xhigh The high band, one sample per pair. */
+void g722_qmf_analysis(int16_t x[], int pairs, int xlow[], int xhigh[]);
+
+/*! Merge the low and high bands into pairs of 16k samples/second audio.
+    \param x The QMF signal, G722_QMF_HISTORY samples of history followed
+           by the sum and difference of the reconstructed low and high band
+           for each new pair. The history is moved up on return.
+    \param pairs The number of sample pairs, at most G722_QMF_PAIRS.
+    \param amp The 2*pairs audio samples. */
+void g722_qmf_synthesis(int16_t x[], int pairs, int16_t amp[]);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
+/*- End of file ------------------------------------------------------------*/
@@ -0,0 +1,220 @@
+/*
+ * g722check.c
+ *
+ * Bit exact check of the G.722 encoder and decoder against test vectors
+ * of their output, and the time they take per 20ms frame.
+ *
+ *   g722check [-r repeats]
+ *
+ * The input is a synthetic wideband signal: a swept tone through both
+ * bands, noise, silence and full scale clipping. It is encoded at each
+ * rate and decoded again, fed in frames of varying size so the QMF
+ * history crosses every boundary, and the CRCs of the results must match
+ * those recorded from the reference implementation.
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * $Id$
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include "VoIPCodecs/inttypes.h"
+#include "VoIPCodecs/g722.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define SAMPLE_RATE   16000
+#define SECONDS       6
+#define SAMPLES       (SAMPLE_RATE*SECONDS)
+#define FRAME_SAMPLES 320
+
+static const struct {
+  int      rate;
+  int      options;
+  uint32_t encoded;     /* CRC32 of the G.722 data */
+  uint32_t decoded;     /* CRC32 of the PCM decoded from it */
+} Vectors[] = {
+  { 64000, 0,            0xadee54ba, 0xa73f59b0 },
+  { 56000, 0,            0xb3f08a61, 0x3664b734 },
+  { 48000, 0,            0x0c6f2ae3, 0x42a6d806 },
+  { 64000, G722_PACKED,  0xadee54ba, 0xa73f59b0 },
+  { 48000, G722_PACKED,  0x48192c73, 0x72b8a49e }
+};
+#define NUM_VECTORS (sizeof(Vectors)/sizeof(Vectors[0]))
+
+/* Uneven chunks, all whole sample pairs */
+static const int Chunks[] = { 320, 2, 158, 320, 24, 296, 320, 640, 46 };
+#define NUM_CHUNKS (sizeof(Chunks)/sizeof(Chunks[0]))
+
+
+static double Seconds(void)
+{
+#ifdef _WIN32
+  LARGE_INTEGER count, frequency;
+  QueryPerformanceCounter(&count);
+  QueryPerformanceFrequency(&frequency);
+  return (double)count.QuadPart/frequency.QuadPart;
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec/1e9;
+#endif
+}
+
+
+static uint32_t Crc32(uint32_t crc, const uint8_t * data, size_t length)
+{
+  int bit;
+  crc = ~crc;
+  while (length-- > 0) {
+    crc ^= *data++;
+    for (bit = 0; bit < 8; bit++)
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+  }
+  return ~crc;
+}
+
+
+static void Synthesise(int16_t * pcm)
+{
+  unsigned seed = 12345;
+  double phase = 0;
+  int i;
+
+  for (i = 0; i < SAMPLES; i++) {
+    double t = (double)i/SAMPLE_RATE;
+    double frequency = 50*pow(7900/50.0, fmod(t, 2.0)/2.0);
+    double sample, noise;
+
+    phase += 2*M_PI*frequency/SAMPLE_RATE;
+    seed = seed*1664525 + 1013904223;
+    noise = ((seed >> 16)/32768.0 - 1);
+
+    if (t < 4)
+      sample = 20000*sin(phase) + 2000*noise;
+    else if (t < 4.5)
+      sample = 0;
+    else if (t < 5)
+      sample = 40000*sin(phase);      /* clips */
+    else
+      sample = 32767*noise;
+
+    pcm[i] = (int16_t)(sample > 32767 ? 32767 : sample < -32768 ? -32768 : sample);
+  }
+}
+
+
+static int Encode(int rate, int options, const int16_t * pcm, uint8_t * g722)
+{
+  g722_encode_state_t * state = g722_encode_init(NULL, rate, options);
+  int in = 0, out = 0, chunk = 0;
+
+  while (in < SAMPLES) {
+    int length = Chunks[chunk++ % NUM_CHUNKS];
+    if (length > SAMPLES - in)
+      length = SAMPLES - in;
+    out += g722_encode(state, g722 + out, pcm + in, length);
+    in += length;
+  }
+
+  g722_encode_release(state);
+  return out;
+}
+
+
+static int Decode(int rate, int options, const uint8_t * g722, int length, int16_t * pcm)
+{
+  g722_decode_state_t * state = g722_decode_init(NULL, rate, options);
+  int in = 0, out = 0, chunk = 0;
+
+  while (in < length) {
+    int bytes = Chunks[chunk++ % NUM_CHUNKS]/2;
+    if (bytes > length - in)
+      bytes = length - in;
+    out += g722_decode(state, pcm + out, g722 + in, bytes);
+    in += bytes;
+  }
+
+  g722_decode_release(state);
+  return out;
+}
+
+
+int main(int argc, char * argv[])
+{
+  int16_t * pcm = (int16_t *)malloc(SAMPLES*sizeof(int16_t));
+  int16_t * decoded = (int16_t *)malloc(SAMPLES*2*sizeof(int16_t));
+  uint8_t * g722 = (uint8_t *)malloc(SAMPLES);
+  int i, r, repeats = 20, failed = 0;
+
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-r") == 0 && i+1 < argc)
+      repeats = atoi(argv[++i]);
+    else {
+      fprintf(stderr, "usage: %s [-r repeats]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  Synthesise(pcm);
+
+  for (i = 0; i < (int)NUM_VECTORS; i++) {
+    int length = Encode(Vectors[i].rate, Vectors[i].options, pcm, g722);
+    int samples = Decode(Vectors[i].rate, Vectors[i].options, g722, length, decoded);
+    uint32_t encoded = Crc32(0, g722, length);
+    uint32_t pcmCrc = Crc32(0, (const uint8_t *)decoded, samples*sizeof(int16_t));
+    int ok = encoded == Vectors[i].encoded && pcmCrc == Vectors[i].decoded;
+
+    printf("%5d%s encode %08x decode %08x  %s\n",
+           Vectors[i].rate/1000, Vectors[i].options & G722_PACKED ? "k packed" : "k       ",
+           (unsigned)encoded, (unsigned)pcmCrc, ok ? "ok" : "MISMATCH");
+    if (!ok)
+      failed = 1;
+  }
+
+  {
+    double encodeTime = 0, decodeTime = 0;
+    int length = 0;
+    for (r = 0; r < repeats; r++) {
+      double start = Seconds(), elapsed;
+      length = Encode(64000, 0, pcm, g722);
+      elapsed = Seconds() - start;
+      if (r == 0 || elapsed < encodeTime)
+        encodeTime = elapsed;
+
+      start = Seconds();
+      Decode(64000, 0, g722, length, decoded);
+      elapsed = Seconds() - start;
+      if (r == 0 || elapsed < decodeTime)
+        decodeTime = elapsed;
+    }
+    printf("64k encode %6.0f ns/frame, decode %6.0f ns/frame\n",
+           encodeTime*1e9*FRAME_SAMPLES/SAMPLES, decodeTime*1e9*FRAME_SAMPLES/SAMPLES);
+  }
+
+  free(pcm);
+  free(decoded);
+  free(g722);
+  return failed;
+}
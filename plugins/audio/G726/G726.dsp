@@ -132,6 +132,10 @@ SOURCE=.\g726\g726_40.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\g726\g726_batch.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\g726\g72x.c
 # End Source File
 # Begin Source File
@@ -200,3 +200,7 @@ g726_16_decoder(
 	}
 }
 
+const g726_rate g726_16_rate = {
+	2, qtab_723_16, 1, _dqlntab, _witab, 0, _fitab,
+	g726_16_encoder, g726_16_decoder
+};
@@ -178,3 +178,7 @@ g726_24_decoder(
 	}
 }
 
+const g726_rate g726_24_rate = {
+	3, qtab_723_24, 3, _dqlntab, _witab, 0, _fitab,
+	g726_24_encoder, g726_24_decoder
+};
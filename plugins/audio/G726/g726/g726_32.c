@@ -196,3 +196,7 @@ g726_32_decoder(
 	}
 }
 
+const g726_rate g726_32_rate = {
+	4, qtab_721, 7, _dqlntab, _witab, 5, _fitab,
+	g726_32_encoder, g726_32_decoder
+};
@@ -199,3 +199,7 @@ g726_40_decoder(
 	}
 }
 
+const g726_rate g726_40_rate = {
+	5, qtab_723_40, 15, _dqlntab, _witab, 0, _fitab,
+	g726_40_encoder, g726_40_decoder
+};
@@ -0,0 +1,583 @@
+/*
+ * g726_batch.c
+ *
+ * G.726 coding of many independent channels side by side.  Each sample
+ * of a channel depends on the whole predictor state left by the one
+ * before, so nothing within a channel can run in parallel, but eight
+ * channels can: the AVX2 kernel keeps the state of eight in the lanes of
+ * its vectors and advances them all a sample at a time, every branch of
+ * the single sample coder becoming a select.  The results are exactly
+ * those of g726_xx_encoder() and g726_xx_decoder() with linear PCM.
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * $Id$
+ */
+
+#include "g72x.h"
+
+#ifndef G726_NO_SIMD
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__)) && \
+    (__GNUC__ >= 5 || defined(__clang__))
+#define	G726_AVX2	1
+#define	G726_AVX2_TARGET	__attribute__((target("avx2")))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86)) && _MSC_VER >= 1700
+#define	G726_AVX2	1
+#define	G726_AVX2_TARGET
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+#endif
+
+/* Channels advanced together by the vector kernel */
+#define	LANES	8
+
+static void
+encode_scalar(
+	const g726_rate *rate,
+	g726_state *state_ptr,
+	const short *sample,
+	unsigned char *code,
+	int samples)
+{
+	int		n;
+
+	for (n = 0; n < samples; n++)
+		code[n] = (unsigned char)rate->encoder(sample[n],
+		    AUDIO_ENCODING_LINEAR, state_ptr);
+}
+
+static void
+decode_scalar(
+	const g726_rate *rate,
+	g726_state *state_ptr,
+	const unsigned char *code,
+	short *sample,
+	int samples)
+{
+	int		n;
+
+	/*
+	 * The decoders give sr << 2, which only the 32k one limits to 16
+	 * bits, the others keeping the low 16 bits here
+	 */
+	for (n = 0; n < samples; n++)
+		sample[n] = (short)rate->decoder(code[n],
+		    AUDIO_ENCODING_LINEAR, state_ptr);
+}
+
+
+#ifdef G726_AVX2
+
+#if defined(_MSC_VER)
+static int
+cpu_has_avx2(void)
+{
+	int		info[4];
+
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return (0);
+
+	/* AVX with the YMM state saved by the OS, then AVX2 itself */
+	__cpuid(info, 1);
+	if ((info[2] & (1 << 27 | 1 << 28)) != (1 << 27 | 1 << 28))
+		return (0);
+	if ((_xgetbv(0) & 6) != 6)
+		return (0);
+
+	__cpuidex(info, 7, 0);
+	return ((info[1] & (1 << 5)) != 0);
+}
+#else
+static int
+cpu_has_avx2(void)
+{
+	__builtin_cpu_init();
+	return (__builtin_cpu_supports("avx2") != 0);
+}
+#endif
+
+static int
+use_avx2(void)
+{
+	/* Racing threads all find the same answer */
+	static int	avx2 = -1;
+
+	if (avx2 < 0)
+		avx2 = cpu_has_avx2();
+	return (avx2);
+}
+
+/* The g726_state of eight channels, a lane each */
+typedef struct {
+	__m256i	yl, yu, dms, dml, ap;
+	__m256i	a[2], b[6], pk[2], dq[6], sr[2];
+	__m256i	td;
+} lanes_state;
+
+/* The tables of a rate as 32 bit words, for gathering by code word */
+typedef struct {
+	int	qtab[15];
+	int	dqlntab[32];
+	int	witab[32];
+	int	fitab[32];
+} lanes_tables;
+
+static void
+lanes_tables_init(
+	const g726_rate *rate,
+	lanes_tables *t)
+{
+	int		i;
+
+	for (i = 0; i < rate->qsize; i++)
+		t->qtab[i] = rate->qtab[i];
+	for (i = 0; i < 1 << rate->bits; i++) {
+		t->dqlntab[i] = rate->dqlntab[i];
+		t->witab[i] = rate->witab[i] << rate->wishift;
+		t->fitab[i] = rate->fitab[i];
+	}
+}
+
+#define	V(n)		_mm256_set1_epi32(n)
+#define	ADD(a, b)	_mm256_add_epi32(a, b)
+#define	SUB(a, b)	_mm256_sub_epi32(a, b)
+#define	AND(a, b)	_mm256_and_si256(a, b)
+#define	OR(a, b)	_mm256_or_si256(a, b)
+#define	XOR(a, b)	_mm256_xor_si256(a, b)
+#define	SRA(a, n)	_mm256_srai_epi32(a, n)
+#define	SLL(a, n)	_mm256_slli_epi32(a, n)
+#define	GT(a, b)	_mm256_cmpgt_epi32(a, b)
+#define	EQ(a, b)	_mm256_cmpeq_epi32(a, b)
+#define	MIN(a, b)	_mm256_min_epi32(a, b)
+#define	MAX(a, b)	_mm256_max_epi32(a, b)
+/* Lanes of b where the mask is set, otherwise of a */
+#define	SEL(m, a, b)	_mm256_blendv_epi8(a, b, m)
+
+/*
+ * quan(val, power2, 15) for 0 <= val < 2^24: the bit length of val, at
+ * most 15, read from the exponent of val as a float
+ */
+G726_AVX2_TARGET
+static __m256i
+lanes_quan_power2(
+	__m256i		val)
+{
+	__m256i		e;
+
+	e = _mm256_srli_epi32(_mm256_castps_si256(_mm256_cvtepi32_ps(val)), 23);
+	return (MIN(MAX(SUB(e, V(126)), V(0)), V(15)));
+}
+
+/* quan(val, table, size) for an ascending table */
+G726_AVX2_TARGET
+static __m256i
+lanes_quan(
+	__m256i		val,
+	const int	*table,
+	int		size)
+{
+	__m256i		i = V(size);
+	int		k;
+
+	/* Less the entries above val */
+	for (k = 0; k < size; k++)
+		i = ADD(i, GT(V(table[k]), val));
+	return (i);
+}
+
+G726_AVX2_TARGET
+static __m256i
+lanes_fmult(
+	__m256i		an,
+	__m256i		srn)
+{
+	__m256i		anmag, anexp, anmant, wanexp, wanmant, retval, sign;
+
+	anmag = SEL(GT(an, V(0)), AND(SUB(V(0), an), V(0x1FFF)), an);
+	anexp = SUB(lanes_quan_power2(anmag), V(6));
+	anmant = _mm256_sllv_epi32(_mm256_srav_epi32(anmag, MAX(anexp, V(0))),
+	    MAX(SUB(V(0), anexp), V(0)));
+	anmant = SEL(EQ(anmag, V(0)), anmant, V(32));
+	wanexp = SUB(ADD(anexp, AND(SRA(srn, 6), V(0xF))), V(13));
+
+	wanmant = SRA(ADD(_mm256_mullo_epi32(anmant, AND(srn, V(077))), V(0x30)), 4);
+	retval = SEL(GT(V(0), wanexp),
+	    AND(_mm256_sllv_epi32(wanmant, MAX(wanexp, V(0))), V(0x7FFF)),
+	    _mm256_srav_epi32(wanmant, SUB(V(0), wanexp)));
+
+	sign = SRA(XOR(an, srn), 31);
+	return (SUB(XOR(retval, sign), sign));
+}
+
+/*
+ * The estimated signal of predictor_zero() and predictor_pole(), and the
+ * step size of step_size()
+ */
+G726_AVX2_TARGET
+static void
+lanes_predict(
+	const lanes_state *s,
+	__m256i		*sez,
+	__m256i		*se,
+	__m256i		*y)
+{
+	__m256i		sezi, dif, al, mix;
+	int		i;
+
+	sezi = lanes_fmult(SRA(s->b[0], 2), s->dq[0]);
+	for (i = 1; i < 6; i++)
+		sezi = ADD(sezi, lanes_fmult(SRA(s->b[i], 2), s->dq[i]));
+	*sez = SRA(sezi, 1);
+	*se = SRA(ADD(ADD(sezi, lanes_fmult(SRA(s->a[1], 2), s->sr[1])),
+	    lanes_fmult(SRA(s->a[0], 2), s->sr[0])), 1);
+
+	mix = SRA(s->yl, 6);
+	dif = SUB(s->yu, mix);
+	al = SRA(s->ap, 2);
+	mix = ADD(mix, SRA(ADD(_mm256_mullo_epi32(dif, al),
+	    AND(GT(V(0), dif), V(0x3F))), 6));
+	*y = SEL(GT(V(256), s->ap), s->yu, mix);
+}
+
+/* The float format of the dq[] and sr[] history, for a magnitude */
+G726_AVX2_TARGET
+static __m256i
+lanes_float(
+	__m256i		mag)
+{
+	__m256i		exp = lanes_quan_power2(mag);
+
+	return (ADD(SLL(exp, 6), _mm256_srav_epi32(SLL(mag, 6), exp)));
+}
+
+/*
+ * reconstruct(), the reconstructed signal, and update() for code words i,
+ * returning the reconstructed signal sr
+ */
+G726_AVX2_TARGET
+static __m256i
+lanes_update(
+	const g726_rate *rate,
+	const lanes_tables *t,
+	lanes_state	*s,
+	__m256i		i,
+	__m256i		sez,
+	__m256i		se,
+	__m256i		y)
+{
+	__m256i		dql, dex, dqt, dq, sign, sr, dqsez, wi, fi;
+	__m256i		pk0, mag, ylint, ylfrac, thr2, dqthr, tr, keep;
+	__m256i		pks1, a2p, fa1, step, a1ul, nonzero, neg, alt;
+	int		cnt;
+
+	/* reconstruct() */
+	sign = GT(AND(i, V(1 << (rate->bits - 1))), V(0));
+	dql = ADD(_mm256_i32gather_epi32(t->dqlntab, i, 4), SRA(y, 2));
+	dex = AND(SRA(dql, 7), V(15));
+	dqt = ADD(V(128), AND(dql, V(127)));
+	dq = _mm256_srav_epi32(SLL(dqt, 7), SUB(V(14), dex));
+	dq = SEL(sign, dq, SUB(dq, V(0x8000)));
+	dq = SEL(GT(V(0), dql), dq, AND(sign, V(-0x8000)));
+
+	/* The reconstructed signal, and the pole prediction difference */
+	sr = SEL(GT(V(0), dq),
+	    ADD(se, dq),
+	    SUB(se, AND(dq, V(rate->bits == 5 ? 0x7FFF : 0x3FFF))));
+	dqsez = SUB(ADD(sr, sez), se);
+
+	wi = _mm256_i32gather_epi32(t->witab, i, 4);
+	fi = _mm256_i32gather_epi32(t->fitab, i, 4);
+
+	/* update(): the tone and transition detector */
+	pk0 = _mm256_srli_epi32(GT(V(0), dqsez), 31);
+	mag = AND(dq, V(0x7FFF));
+	ylint = SRA(s->yl, 15);
+	ylfrac = AND(SRA(s->yl, 10), V(0x1F));
+	thr2 = SEL(GT(ylint, V(9)),
+	    _mm256_sllv_epi32(ADD(V(32), ylfrac), ylint), V(31 << 10));
+	dqthr = SRA(ADD(thr2, SRA(thr2, 1)), 1);
+	tr = _mm256_andnot_si256(EQ(s->td, V(0)), GT(mag, dqthr));
+	keep = _mm256_andnot_si256(tr, V(-1));
+
+	/* Quantizer scale factor adaptation */
+	s->yu = MIN(MAX(ADD(y, SRA(SUB(wi, y), 5)), V(544)), V(5120));
+	s->yl = ADD(s->yl, ADD(s->yu, SRA(SUB(V(0), s->yl), 6)));
+
+	/* Adaptive predictor coefficients, all reset for a modem signal */
+	nonzero = _mm256_andnot_si256(EQ(dqsez, V(0)), V(-1));
+	pks1 = XOR(pk0, s->pk[0]);
+	a2p = SUB(s->a[1], SRA(s->a[1], 7));
+	fa1 = SEL(EQ(pks1, V(0)), s->a[0], SUB(V(0), s->a[0]));
+	step = SEL(GT(fa1, V(8191)), SRA(fa1, 5), V(0xFF));
+	step = SEL(GT(V(-8191), fa1), step, V(-0x100));
+	alt = XOR(pk0, s->pk[1]);
+	fa1 = ADD(a2p, step);
+	neg = SEL(EQ(alt, V(0)),
+	    SUB(fa1, V(0x80)), ADD(fa1, V(0x80)));
+	/* LIMC, the bounds depending on whether the signs alternate */
+	neg = SEL(GT(SEL(EQ(alt, V(0)), V(-12159), V(-12415)), fa1), neg, V(-12288));
+	neg = SEL(GT(fa1, SEL(EQ(alt, V(0)), V(12415), V(12159))), neg, V(12288));
+	a2p = SEL(nonzero, a2p, neg);
+	a2p = AND(a2p, keep);
+	s->a[1] = a2p;
+
+	s->a[0] = SUB(s->a[0], SRA(s->a[0], 8));
+	s->a[0] = ADD(s->a[0], AND(nonzero, SEL(EQ(pks1, V(0)), V(-192), V(192))));
+	a1ul = SUB(V(15360), a2p);
+	s->a[0] = MAX(MIN(s->a[0], a1ul), SUB(V(0), a1ul));
+	s->a[0] = AND(s->a[0], keep);
+
+	nonzero = _mm256_andnot_si256(EQ(mag, V(0)), V(-1));
+	for (cnt = 0; cnt < 6; cnt++) {
+		__m256i	b = SUB(s->b[cnt], SRA(s->b[cnt], rate->bits == 5 ? 9 : 8));
+		__m256i	differ = GT(V(0), XOR(dq, s->dq[cnt]));
+
+		b = ADD(b, AND(nonzero, SEL(differ, V(128), V(-128))));
+		s->b[cnt] = AND(b, keep);
+	}
+
+	/* FLOAT A, dq[0] as a signed short */
+	for (cnt = 5; cnt > 0; cnt--)
+		s->dq[cnt] = s->dq[cnt-1];
+	neg = GT(V(0), dq);
+	s->dq[0] = SEL(EQ(mag, V(0)),
+	    SUB(lanes_float(mag), AND(neg, V(0x400))),
+	    SEL(neg, V(0x20), V(-992)));
+
+	/* FLOAT B, sr[0] as an int, in which 0xFC20 is positive */
+	s->sr[1] = s->sr[0];
+	neg = GT(V(0), sr);
+	s->sr[0] = SUB(lanes_float(_mm256_abs_epi32(sr)), AND(neg, V(0x400)));
+	s->sr[0] = SEL(EQ(sr, V(0)), s->sr[0], V(0x20));
+	s->sr[0] = SEL(GT(V(-32767), sr), s->sr[0], V(0xFC20));
+
+	s->pk[1] = s->pk[0];
+	s->pk[0] = pk0;
+
+	/* TONE */
+	s->td = AND(_mm256_srli_epi32(GT(V(-11776), a2p), 31), keep);
+
+	/* Adaptation speed control */
+	s->dms = ADD(s->dms, SRA(SUB(fi, s->dms), 5));
+	s->dml = ADD(s->dml, SRA(SUB(SLL(fi, 2), s->dml), 7));
+
+	step = OR(GT(V(1536), y), EQ(s->td, V(1)));
+	step = OR(step, _mm256_andnot_si256(
+	    GT(SRA(s->dml, 3), _mm256_abs_epi32(SUB(SLL(s->dms, 2), s->dml))), V(-1)));
+	s->ap = ADD(s->ap, SEL(step,
+	    SRA(SUB(V(0), s->ap), 4), SRA(SUB(V(0x200), s->ap), 4)));
+	s->ap = SEL(tr, s->ap, V(256));
+
+	return (sr);
+}
+
+/* Gather a g726_state field of eight channels into lanes, and scatter it */
+#define	LOAD_LANES(field) \
+	_mm256_setr_epi32(st[0]->field, st[1]->field, st[2]->field, st[3]->field, \
+	    st[4]->field, st[5]->field, st[6]->field, st[7]->field)
+#define	STORE_LANES(v, field, type) { \
+	int	w[LANES]; \
+	_mm256_storeu_si256((__m256i *)w, v); \
+	for (c = 0; c < LANES; c++) \
+		st[c]->field = (type)w[c]; \
+}
+
+G726_AVX2_TARGET
+static void
+lanes_load(
+	lanes_state	*s,
+	g726_state * const st[])
+{
+	int		i;
+
+	s->yl = _mm256_setr_epi32((int)st[0]->yl, (int)st[1]->yl, (int)st[2]->yl,
+	    (int)st[3]->yl, (int)st[4]->yl, (int)st[5]->yl, (int)st[6]->yl,
+	    (int)st[7]->yl);
+	s->yu = LOAD_LANES(yu);
+	s->dms = LOAD_LANES(dms);
+	s->dml = LOAD_LANES(dml);
+	s->ap = LOAD_LANES(ap);
+	for (i = 0; i < 2; i++) {
+		s->a[i] = LOAD_LANES(a[i]);
+		s->pk[i] = LOAD_LANES(pk[i]);
+		s->sr[i] = LOAD_LANES(sr[i]);
+	}
+	for (i = 0; i < 6; i++) {
+		s->b[i] = LOAD_LANES(b[i]);
+		s->dq[i] = LOAD_LANES(dq[i]);
+	}
+	s->td = LOAD_LANES(td);
+}
+
+G726_AVX2_TARGET
+static void
+lanes_store(
+	const lanes_state *s,
+	g726_state * const st[])
+{
+	int		i, c;
+
+	STORE_LANES(s->yl, yl, long);
+	STORE_LANES(s->yu, yu, int);
+	STORE_LANES(s->dms, dms, int);
+	STORE_LANES(s->dml, dml, int);
+	STORE_LANES(s->ap, ap, int);
+	for (i = 0; i < 2; i++) {
+		STORE_LANES(s->a[i], a[i], int);
+		STORE_LANES(s->pk[i], pk[i], int);
+		STORE_LANES(s->sr[i], sr[i], int);
+	}
+	for (i = 0; i < 6; i++) {
+		STORE_LANES(s->b[i], b[i], int);
+		STORE_LANES(s->dq[i], dq[i], short);
+	}
+	STORE_LANES(s->td, td, int);
+}
+
+/*
+ * Eight channels from 'first', those past 'channels' being stand ins
+ * coding a copy of the first channel's state and input, and discarded.
+ */
+G726_AVX2_TARGET
+static void
+code_lanes_avx2(
+	const g726_rate *rate,
+	int		encode,
+	int		channels,
+	g726_state * const state[],
+	const short * const sample[],
+	unsigned char * const code[],
+	const unsigned char * const in_code[],
+	short * const out_sample[],
+	int		samples)
+{
+	lanes_tables	t;
+	lanes_state	s;
+	g726_state	spare;
+	g726_state	*st[LANES];
+	const short	*in[LANES];
+	const unsigned char *ic[LANES];
+	__m256i		sez, se, y, i, sl, d, sr;
+	__m256i		dqm, exp, dl, top;
+	int		w[LANES];
+	int		c, n;
+
+	lanes_tables_init(rate, &t);
+
+	spare = *state[0];
+	for (c = 0; c < LANES; c++) {
+		st[c] = c < channels ? state[c] : &spare;
+		if (encode)
+			in[c] = sample[c < channels ? c : 0];
+		else
+			ic[c] = in_code[c < channels ? c : 0];
+	}
+	lanes_load(&s, st);
+
+	for (n = 0; n < samples; n++) {
+		lanes_predict(&s, &sez, &se, &y);
+
+		if (encode) {
+			sl = _mm256_setr_epi32(in[0][n], in[1][n], in[2][n], in[3][n],
+			    in[4][n], in[5][n], in[6][n], in[7][n]);
+			d = SUB(SRA(sl, 2), se);
+
+			/* quantize(), the code word of 0 being its 1's complement */
+			dqm = _mm256_abs_epi32(d);
+			exp = lanes_quan_power2(SRA(dqm, 1));
+			dl = ADD(SLL(exp, 7),
+			    AND(_mm256_srav_epi32(SLL(dqm, 7), exp), V(0x7F)));
+			i = lanes_quan(SUB(dl, SRA(y, 2)), t.qtab, rate->qsize);
+			top = V((rate->qsize << 1) + 1);
+			i = SEL(GT(V(0), d), SEL(EQ(i, V(0)), i, top), SUB(top, i));
+
+			/* The 16k quantizer has no code for the zero region above 0 */
+			if (rate->bits == 2)
+				i = SEL(AND(EQ(i, V(3)), EQ(AND(d, V(0x8000)), V(0))), i, V(0));
+
+			_mm256_storeu_si256((__m256i *)w, i);
+			for (c = 0; c < channels; c++)
+				code[c][n] = (unsigned char)w[c];
+		}
+		else {
+			i = _mm256_setr_epi32(ic[0][n], ic[1][n], ic[2][n], ic[3][n],
+			    ic[4][n], ic[5][n], ic[6][n], ic[7][n]);
+			i = AND(i, V((1 << rate->bits) - 1));
+		}
+
+		sr = lanes_update(rate, &t, &s, i, sez, se, y);
+
+		if (!encode) {
+			sr = SLL(sr, 2);
+			if (rate->bits == 4)
+				sr = MAX(MIN(sr, V(32767)), V(-32768));
+			_mm256_storeu_si256((__m256i *)w, sr);
+			for (c = 0; c < channels; c++)
+				out_sample[c][n] = (short)w[c];
+		}
+	}
+
+	lanes_store(&s, st);
+}
+
+#endif	/* G726_AVX2 */
+
+
+int
+g726_encode_channels(
+	const g726_rate *rate,
+	int		channels,
+	g726_state * const state[],
+	const short * const sample[],
+	unsigned char * const code[],
+	int		samples)
+{
+	int		c = 0;
+
+#ifdef G726_AVX2
+	if (use_avx2()) {
+		for (; c < channels; c += LANES)
+			code_lanes_avx2(rate, 1, channels - c < LANES ? channels - c : LANES,
+			    state + c, sample + c, code + c, NULL, NULL, samples);
+	}
+#endif
+	for (; c < channels; c++)
+		encode_scalar(rate, state[c], sample[c], code[c], samples);
+	return (samples);
+}
+
+int
+g726_decode_channels(
+	const g726_rate *rate,
+	int		channels,
+	g726_state * const state[],
+	const unsigned char * const code[],
+	short * const sample[],
+	int		samples)
+{
+	int		c = 0;
+
+#ifdef G726_AVX2
+	if (use_avx2()) {
+		for (; c < channels; c += LANES)
+			code_lanes_avx2(rate, 0, channels - c < LANES ? channels - c : LANES,
+			    state + c, NULL, NULL, code + c, sample + c, samples);
+	}
+#endif
+	for (; c < channels; c++)
+		decode_scalar(rate, state[c], code[c], sample[c], samples);
+	return (samples);
+}
@@ -105,5 +105,48 @@ int g726_40_decoder(
 		int out_coding,
 		 g726_state *state_ptr);
 
+/*
+ * The code size and tables of a rate, and its single sample coders, for
+ * coding many independent channels side by side.
+ */
+typedef struct g726_rate_s {
+	int	bits;		/* Bits per code word. */
+	int *	qtab;		/* Quantization table, and its size. */
+	int	qsize;
+	short *	dqlntab;	/* Code word to normalized log magnitude. */
+	short *	witab;		/* Code word to scale factor multiplier, */
+	int	wishift;	/* and the shift it is scaled up by. */
+	short *	fitab;		/* Code word to speed control value. */
+	int	(*encoder)(int sample, int in_coding, g726_state *state_ptr);
+	int	(*decoder)(int code, int out_coding, g726_state *state_ptr);
+} g726_rate;
+
+extern const g726_rate g726_16_rate;
+extern const g726_rate g726_24_rate;
+extern const g726_rate g726_32_rate;
+extern const g726_rate g726_40_rate;
+
+/*
+ * Code 'samples' samples of each of 'channels' independent channels of
+ * linear PCM, one code word a byte, advancing the predictor state of the
+ * channels in vector lanes where the processor allows. The outputs are
+ * exactly those of the single sample coders, and the states are the same
+ * ones they use. Returns the number of samples.
+ */
+int g726_encode_channels(
+		const g726_rate *rate,
+		int channels,
+		g726_state * const state[],
+		const short * const sample[],
+		unsigned char * const code[],
+		int samples);
+int g726_decode_channels(
+		const g726_rate *rate,
+		int channels,
+		g726_state * const state[],
+		const unsigned char * const code[],
+		short * const sample[],
+		int samples);
+
 #endif /* !_G72X_H */
 
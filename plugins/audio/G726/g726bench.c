@@ -0,0 +1,251 @@
+/*
+ * g726bench.c
+ *
+ * Bit exact check and timing of coding many G.726 channels at once.  Each
+ * rate codes the same channels with the single sample coders and with
+ * g726_encode_channels() and g726_decode_channels(), which must give the
+ * same code words, samples and states, and the time per channel second
+ * is reported.
+ *
+ *   g726bench [-c channels] [-s seconds]
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * $Id$
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include "g726/g72x.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define SAMPLE_RATE    8000
+#define BLOCK_SAMPLES  160
+
+static const struct {
+  const char      * name;
+  const g726_rate * rate;
+} Rates[] = {
+  { "16k", &g726_16_rate },
+  { "24k", &g726_24_rate },
+  { "32k", &g726_32_rate },
+  { "40k", &g726_40_rate }
+};
+#define NUM_RATES (sizeof(Rates)/sizeof(Rates[0]))
+
+
+static double Seconds(void)
+{
+#ifdef _WIN32
+  LARGE_INTEGER count, frequency;
+  QueryPerformanceCounter(&count);
+  QueryPerformanceFrequency(&frequency);
+  return (double)count.QuadPart/frequency.QuadPart;
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec/1e9;
+#endif
+}
+
+
+/* A different mix of tone, noise, silence and clipping on each channel,
+   with a modem like tone burst to take the predictor through its resets */
+static void Synthesise(short * pcm, int samples, int channel)
+{
+  unsigned seed = 1 + channel*7919;
+  double phase = 0;
+  int i;
+
+  for (i = 0; i < samples; i++) {
+    double t = (double)i/SAMPLE_RATE + channel*0.37;
+    double frequency = 200 + 3000*fmod(t*0.25, 1.0);
+    double sample, noise;
+
+    phase += 2*M_PI*frequency/SAMPLE_RATE;
+    seed = seed*1664525 + 1013904223;
+    noise = ((seed >> 16)/32768.0 - 1);
+
+    switch ((int)fmod(t, 4.0)) {
+      case 0 :
+        sample = 12000*sin(phase) + 800*noise;
+        break;
+      case 1 :
+        sample = 0;
+        break;
+      case 2 :
+        sample = 45000*sin(2*M_PI*1800*t);    /* clips */
+        break;
+      default :
+        sample = 20000*noise;
+    }
+
+    pcm[i] = (short)(sample > 32767 ? 32767 : sample < -32768 ? -32768 : sample);
+  }
+}
+
+
+int main(int argc, char * argv[])
+{
+  int channels = 16, seconds = 10, samples, i, c, r, failed = 0;
+  short ** pcm;
+  unsigned char ** codes, ** batchCodes;
+  short ** decoded, ** batchDecoded;
+  g726_state * states, * batchStates;
+  g726_state ** state, ** batchState;
+
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-c") == 0 && i+1 < argc)
+      channels = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-s") == 0 && i+1 < argc)
+      seconds = atoi(argv[++i]);
+    else {
+      fprintf(stderr, "usage: %s [-c channels] [-s seconds]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (channels < 1 || seconds < 1) {
+    fprintf(stderr, "%s: no channels or time to code\n", argv[0]);
+    return 2;
+  }
+
+  samples = seconds*SAMPLE_RATE;
+  pcm = (short **)malloc(channels*sizeof(short *));
+  codes = (unsigned char **)malloc(channels*sizeof(unsigned char *));
+  batchCodes = (unsigned char **)malloc(channels*sizeof(unsigned char *));
+  decoded = (short **)malloc(channels*sizeof(short *));
+  batchDecoded = (short **)malloc(channels*sizeof(short *));
+  /* Zeroed so the padding compares equal too */
+  states = (g726_state *)calloc(channels, sizeof(g726_state));
+  batchStates = (g726_state *)calloc(channels, sizeof(g726_state));
+  state = (g726_state **)malloc(channels*sizeof(g726_state *));
+  batchState = (g726_state **)malloc(channels*sizeof(g726_state *));
+
+  for (c = 0; c < channels; c++) {
+    pcm[c] = (short *)malloc(samples*sizeof(short));
+    codes[c] = (unsigned char *)malloc(samples);
+    batchCodes[c] = (unsigned char *)malloc(samples);
+    decoded[c] = (short *)malloc(samples*sizeof(short));
+    batchDecoded[c] = (short *)malloc(samples*sizeof(short));
+    state[c] = &states[c];
+    batchState[c] = &batchStates[c];
+    Synthesise(pcm[c], samples, c);
+  }
+
+  printf("%d channels of %d seconds\n", channels, seconds);
+
+  for (r = 0; r < (int)NUM_RATES; r++) {
+    const g726_rate * rate = Rates[r].rate;
+    double start, single[2], batch[2];
+    int mismatch = 0;
+
+    /* The single sample coders, a block of each channel in turn */
+    start = Seconds();
+    for (c = 0; c < channels; c++) {
+      g726_init_state(state[c]);
+      for (i = 0; i < samples; i++)
+        codes[c][i] = (unsigned char)rate->encoder(pcm[c][i], AUDIO_ENCODING_LINEAR, state[c]);
+    }
+    single[0] = Seconds() - start;
+
+    start = Seconds();
+    for (c = 0; c < channels; c++) {
+      g726_init_state(state[c]);
+      for (i = 0; i < samples; i++)
+        decoded[c][i] = (short)rate->decoder(codes[c][i], AUDIO_ENCODING_LINEAR, state[c]);
+    }
+    single[1] = Seconds() - start;
+
+    /* All channels together, in 20ms blocks as a server would */
+    for (c = 0; c < channels; c++)
+      g726_init_state(batchState[c]);
+    start = Seconds();
+    for (i = 0; i < samples; i += BLOCK_SAMPLES) {
+      const short * in[256];
+      unsigned char * out[256];
+      int n = samples - i < BLOCK_SAMPLES ? samples - i : BLOCK_SAMPLES, first;
+      for (first = 0; first < channels; first += 256) {
+        int count = channels - first < 256 ? channels - first : 256;
+        for (c = 0; c < count; c++) {
+          in[c] = pcm[first+c] + i;
+          out[c] = batchCodes[first+c] + i;
+        }
+        g726_encode_channels(rate, count, batchState + first, in, out, n);
+      }
+    }
+    batch[0] = Seconds() - start;
+
+    for (c = 0; c < channels && !mismatch; c++)
+      mismatch = memcmp(codes[c], batchCodes[c], samples) != 0 ||
+                 memcmp(state[c], batchState[c], sizeof(g726_state)) != 0;
+
+    for (c = 0; c < channels; c++)
+      g726_init_state(batchState[c]);
+    start = Seconds();
+    for (i = 0; i < samples; i += BLOCK_SAMPLES) {
+      const unsigned char * in[256];
+      short * out[256];
+      int n = samples - i < BLOCK_SAMPLES ? samples - i : BLOCK_SAMPLES, first;
+      for (first = 0; first < channels; first += 256) {
+        int count = channels - first < 256 ? channels - first : 256;
+        for (c = 0; c < count; c++) {
+          in[c] = codes[first+c] + i;
+          out[c] = batchDecoded[first+c] + i;
+        }
+        g726_decode_channels(rate, count, batchState + first, in, out, n);
+      }
+    }
+    batch[1] = Seconds() - start;
+
+    for (c = 0; c < channels && !mismatch; c++)
+      mismatch = memcmp(decoded[c], batchDecoded[c], samples*sizeof(short)) != 0 ||
+                 memcmp(state[c], batchState[c], sizeof(g726_state)) != 0;
+
+    printf("%s encode %6.2f ms x%.2f, decode %6.2f ms x%.2f per channel second  %s\n",
+           Rates[r].name,
+           batch[0]*1e3/(channels*seconds), single[0]/batch[0],
+           batch[1]*1e3/(channels*seconds), single[1]/batch[1],
+           mismatch ? "MISMATCH" : "bit exact");
+    if (mismatch)
+      failed = 1;
+  }
+
+  for (c = 0; c < channels; c++) {
+    free(pcm[c]);
+    free(codes[c]);
+    free(batchCodes[c]);
+    free(decoded[c]);
+    free(batchDecoded[c]);
+  }
+  free(pcm);
+  free(codes);
+  free(batchCodes);
+  free(decoded);
+  free(batchDecoded);
+  free(states);
+  free(batchStates);
+  free(state);
+  free(batchState);
+  return failed;
+}
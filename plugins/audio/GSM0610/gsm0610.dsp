@@ -184,6 +184,12 @@ SOURCE=.\src\short_term.c
 # End Source File
 # Begin Source File
 
+SOURCE=src\simd.c
+# ADD CPP /w /W0 /I "./inc" /D NeedFunctionPrototypes=1 /D "WAV49"
+# SUBTRACT CPP /D "PLUGIN_CODEC_DLL_EXPORTS"
+# End Source File
+# Begin Source File
+
 SOURCE=src\table.c
 # ADD CPP /w /W0 /I "./inc" /D NeedFunctionPrototypes=1 /D "WAV49"
 # SUBTRACT CPP /D "PLUGIN_CODEC_DLL_EXPORTS"
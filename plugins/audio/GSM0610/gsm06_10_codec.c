@@ -365,7 +365,8 @@ static struct PluginCodec_Definition gsmCodecDefn[4] =
     PluginCodec_MediaTypeAudio |        // audio codec
     PluginCodec_InputTypeRaw |          // raw input data
     PluginCodec_OutputTypeRaw |         // raw output data
-    PluginCodec_RTPTypeExplicit,        // specified RTP type
+    PluginCodec_RTPTypeExplicit |       // specified RTP type
+    PluginCodec_MultiFrame,             // a packet of frames a call
 
     gsm0610,                            // text decription
     L16Desc,                            // source format
@@ -400,7 +401,8 @@ static struct PluginCodec_Definition gsmCodecDefn[4] =
     PluginCodec_MediaTypeAudio |        // audio codec
     PluginCodec_InputTypeRaw |          // raw input data
     PluginCodec_OutputTypeRaw |         // raw output data
-    PluginCodec_RTPTypeExplicit,        // dynamic RTP type
+    PluginCodec_RTPTypeExplicit |       // dynamic RTP type
+    PluginCodec_MultiFrame,             // a packet of frames a call
 
     gsm0610,                            // text decription
     gsm0610,                            // source format
@@ -0,0 +1,221 @@
+/*
+ * gsmbench.c
+ *
+ * Per frame benchmark of the GSM 06.10 encoder kernels.  Each kernel the
+ * processor has encodes the same audio, which must give exactly the bits
+ * of the scalar reference, and the time per frame is reported.
+ *
+ *   gsmbench [-n frames] [-r repeats] [file.sw]
+ *
+ * The audio is 8kHz 16 bit native endian samples from the file, or a
+ * synthetic voiced signal with pauses and noise if none is given.
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * $Id$
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include "gsm.h"
+
+#ifndef GSM_OPT_KERNEL
+#define GSM_OPT_KERNEL 7
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define SAMPLES_PER_FRAME 160
+#define BYTES_PER_FRAME   33
+
+static const char * const KernelNames[] = { "scalar", "sse2", "avx2" };
+#define NUM_KERNELS (sizeof(KernelNames)/sizeof(KernelNames[0]))
+
+
+static double Seconds(void)
+{
+#ifdef _WIN32
+  LARGE_INTEGER count, frequency;
+  QueryPerformanceCounter(&count);
+  QueryPerformanceFrequency(&frequency);
+  return (double)count.QuadPart/frequency.QuadPart;
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec/1e9;
+#endif
+}
+
+
+/* Voiced bursts of a gliding pitch through two formants, pauses of low
+   noise between them, and the odd full scale clip to exercise the scaling */
+static void Synthesise(gsm_signal * pcm, unsigned samples)
+{
+  unsigned seed = 1, i;
+  double phase = 0, f1 = 0, f2 = 0, f1d = 0, f2d = 0;
+
+  for (i = 0; i < samples; i++) {
+    double t = i/8000.0;
+    double pitch = 110 + 40*sin(2*M_PI*0.7*t);
+    double envelope = fmod(t, 1.5) < 1.1 ? 0.5 - 0.5*cos(2*M_PI*fmod(t, 1.5)/1.1) : 0;
+    double excitation, noise, sample;
+
+    phase += pitch/8000;
+    if (phase >= 1)
+      phase -= 1;
+    excitation = phase < 0.1 ? 1 : -0.11;
+
+    seed = seed*1664525 + 1013904223;
+    noise = ((seed >> 16)/32768.0 - 1)*0.02;
+
+    /* Two resonators, near 700Hz and 1200Hz */
+    f1 = f1 + 0.93*(excitation - f1) - f1d*0.55; f1d = f1d*0.6 + f1*0.4;
+    f2 = f2 + 0.85*(f1 - f2) - f2d*0.35;         f2d = f2d*0.5 + f2*0.5;
+
+    sample = (envelope*(f1 + 0.6*f2) + noise)*14000;
+    if (i % 40000 == 20000)
+      sample = (i & 1) ? 32767 : -32768;
+    pcm[i] = (gsm_signal)(sample > 32767 ? 32767 : sample < -32768 ? -32768 : sample);
+  }
+}
+
+
+int main(int argc, char * argv[])
+{
+  unsigned frames = 5000, repeats = 5, i, r, kernel;
+  const char * filename = NULL;
+  gsm_signal * pcm;
+  gsm_byte * reference, * encoded;
+  double referenceTime = 0;
+  int failed = 0;
+
+  for (i = 1; i < (unsigned)argc; i++) {
+    if (strcmp(argv[i], "-n") == 0 && i+1 < (unsigned)argc)
+      frames = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-r") == 0 && i+1 < (unsigned)argc)
+      repeats = atoi(argv[++i]);
+    else if (argv[i][0] != '-')
+      filename = argv[i];
+    else {
+      fprintf(stderr, "usage: %s [-n frames] [-r repeats] [file.sw]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  if (filename != NULL) {
+    FILE * file = fopen(filename, "rb");
+    long size;
+    if (file == NULL) {
+      perror(filename);
+      return 2;
+    }
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    frames = (unsigned)(size/(SAMPLES_PER_FRAME*2));
+    pcm = (gsm_signal *)malloc(frames*SAMPLES_PER_FRAME*2 + 1);
+    if (frames == 0 || fread(pcm, SAMPLES_PER_FRAME*2, frames, file) != frames) {
+      fprintf(stderr, "%s: no whole frames read\n", filename);
+      return 2;
+    }
+    fclose(file);
+  }
+  else {
+    pcm = (gsm_signal *)malloc(frames*SAMPLES_PER_FRAME*2 + 1);
+    Synthesise(pcm, frames*SAMPLES_PER_FRAME);
+  }
+
+  reference = (gsm_byte *)malloc(frames*BYTES_PER_FRAME);
+  encoded = (gsm_byte *)malloc(frames*BYTES_PER_FRAME);
+
+  printf("%u frames, best of %u runs\n", frames, repeats);
+
+  for (kernel = 0; kernel < NUM_KERNELS; kernel++) {
+    double best = 0;
+    int value = kernel;
+    unsigned mismatch = frames;
+
+    for (r = 0; r < repeats; r++) {
+      gsm state = gsm_create();
+      gsm_byte * out = kernel == 0 ? reference : encoded;
+      double start, elapsed;
+
+      /* A system libgsm has no kernels, and is benchmarked as the scalar one */
+      gsm_option(state, GSM_OPT_KERNEL, &value);
+      if (kernel > 0 && gsm_option(state, GSM_OPT_KERNEL, NULL) != (int)kernel) {
+        gsm_destroy(state);
+        break;
+      }
+
+      start = Seconds();
+      for (i = 0; i < frames; i++)
+        gsm_encode(state, pcm + i*SAMPLES_PER_FRAME, out + i*BYTES_PER_FRAME);
+      elapsed = Seconds() - start;
+      gsm_destroy(state);
+
+      if (r == 0 || elapsed < best)
+        best = elapsed;
+    }
+
+    if (r < repeats) {
+      printf("%-8s not available\n", KernelNames[kernel]);
+      continue;
+    }
+
+    if (kernel == 0)
+      referenceTime = best;
+    else {
+      for (i = 0; i < frames; i++) {
+        if (memcmp(reference + i*BYTES_PER_FRAME, encoded + i*BYTES_PER_FRAME, BYTES_PER_FRAME) != 0) {
+          mismatch = i;
+          failed = 1;
+          break;
+        }
+      }
+    }
+
+    printf("%-8s %8.0f ns/frame  x%.2f", KernelNames[kernel], best*1e9/frames, referenceTime/best);
+    if (kernel > 0) {
+      if (mismatch < frames)
+        printf("  MISMATCH at frame %u", mismatch);
+      else
+        printf("  bit exact");
+    }
+    printf("\n");
+  }
+
+  {
+    gsm state = gsm_create();
+    gsm_signal decoded[SAMPLES_PER_FRAME];
+    double start = Seconds();
+    for (i = 0; i < frames; i++)
+      gsm_decode(state, reference + i*BYTES_PER_FRAME, decoded);
+    printf("decode   %8.0f ns/frame\n", (Seconds() - start)*1e9/frames);
+    gsm_destroy(state);
+  }
+
+  free(pcm);
+  free(reference);
+  free(encoded);
+  return failed;
+}
@@ -54,6 +54,12 @@ typedef gsm_byte 		gsm_frame[33];		/* 33 * 8 bits	 */
 #define	GSM_OPT_WAV49		4
 #define	GSM_OPT_FRAME_INDEX	5
 #define	GSM_OPT_FRAME_CHAIN	6
+#define	GSM_OPT_KERNEL		7
+
+/* Encoder kernels for GSM_OPT_KERNEL, all giving the same bits */
+#define	GSM_KERNEL_SCALAR	0
+#define	GSM_KERNEL_SSE2		1
+#define	GSM_KERNEL_AVX2		2
 
 extern gsm  gsm_create 	GSM_P((void));
 extern void gsm_destroy GSM_P((gsm));	
@@ -39,6 +39,8 @@ struct gsm_state {
 	char		wav_fmt;	/* only used if WAV49 defined	*/
 	unsigned char	frame_index;	/*            odd/even chaining	*/
 	unsigned char	frame_chain;	/*   half-byte to carry forward	*/
+
+	char		kernel;		/* simd.c, GSM_KERNEL_...	*/
 };
 
 
@@ -138,6 +140,31 @@ extern word	gsm_asr  	P((word a, int n));
 
 */
 
+/*
+ *	Prototypes from simd.c
+ */
+extern int	gsm_kernel_available	P((int kernel));
+extern int	gsm_best_kernel		P((void));
+
+extern void	gsm_ltp_cross_correlation P((int kernel,
+		const word * wt,	/* [0..39]		IN	*/
+		const word * dp,	/* [-120..-1]		IN	*/
+		longword * L_result));	/* [0..80], lags 40..120 OUT	*/
+
+extern void	gsm_autocorrelation P((int kernel,
+		const word * s,		/* [0..159]		IN	*/
+		longword * L_ACF));	/* [0..8], undoubled	OUT	*/
+
+extern void	gsm_short_term_analysis P((int kernel,
+		word * u,		/* [0..7]		IN/OUT	*/
+		const word * rp,	/* [0..7]		IN	*/
+		int k_n,		/*   k_end - k_start	*/
+		word * s));		/* [0..n-1]		IN/OUT	*/
+
+extern void	gsm_weighting_filter P((int kernel,
+		const word * e,		/* [-5..-1][0..39][40..44] IN	*/
+		word * x));		/* [0..39]		OUT	*/
+
 /*
  *  More prototypes from implementations..
  */
@@ -41,6 +41,7 @@ gsm gsm_create P0()
 
 	memset((char *)r, 0, sizeof(*r));
 	r->nrp = 40;
+	r->kernel = gsm_best_kernel();
 
 	return r;
 }
@@ -24,7 +24,8 @@
 /* 4.2.4 */
 
 
-static void Autocorrelation P2((s, L_ACF),
+static void Autocorrelation P3((kernel, s, L_ACF),
+	int	   kernel,	/* GSM_KERNEL_...	IN	*/
 	word     * s,		/* [0..159]	IN/OUT  */
  	longword * L_ACF)	/* [0..8]	OUT     */
 /*
@@ -91,6 +92,13 @@ static void Autocorrelation P2((s, L_ACF),
 
 	/*  Compute the L_ACF[..].
 	 */
+# ifndef USE_FLOAT_MUL
+	if (kernel != GSM_KERNEL_SCALAR) {
+		gsm_autocorrelation( kernel, s, L_ACF );
+		for (k = 9; k--; L_ACF[k] <<= 1) ;
+	}
+	else
+# endif
 	{
 # ifdef	USE_FLOAT_MUL
 		register float * sp = float_s;
@@ -335,7 +343,7 @@ void Gsm_LPC_Analysis P3((S, s,LARc),
 	if (S->fast) Fast_Autocorrelation (s,	  L_ACF );
 	else
 #endif
-	Autocorrelation			  (s,	  L_ACF	);
+	Autocorrelation			  (S->kernel, s, L_ACF);
 	Reflection_coefficients		  (L_ACF, LARc	);
 	Transformation_to_Log_Area_Ratios (LARc);
 	Quantization_and_coding		  (LARc);
@@ -63,6 +63,11 @@ int gsm_option P3((r, opt, val), gsm r, int opt, int * val)
 #endif
 		break;
 
+	case GSM_OPT_KERNEL:
+		result = r->kernel;
+		if (val && gsm_kernel_available(*val)) r->kernel = *val;
+		break;
+
 	default:
 		break;
 	}
@@ -154,7 +154,10 @@ static void Cut_Calculation_of_the_LTP_parameters P5((st, d,dp,bc_out,Nc_out),
 
 #endif 	/* LTP_CUT */
 
-static void Calculation_of_the_LTP_parameters P4((d,dp,bc_out,Nc_out),
+static void Calculation_of_the_LTP_parameters P5((st, d,dp,bc_out,Nc_out),
+
+	struct gsm_state * st,
+
 	register word	* d,		/* [0..39]	IN	*/
 	register word	* dp,		/* [-120..-1]	IN	*/
 	word		* bc_out,	/* 		OUT	*/
@@ -201,7 +204,20 @@ static void Calculation_of_the_LTP_parameters P4((d,dp,bc_out,Nc_out),
 	L_max = 0;
 	Nc    = 40;	/* index for the maximum cross-correlation */
 
-	for (lambda = 40; lambda <= 120; lambda++) {
+	if (st->kernel != GSM_KERNEL_SCALAR) {
+
+		longword	L_xcorr[81];
+
+		gsm_ltp_cross_correlation( st->kernel, wt, dp, L_xcorr );
+		for (lambda = 40; lambda <= 120; lambda++) {
+			if (L_xcorr[lambda - 40] > L_max) {
+
+				Nc    = lambda;
+				L_max = L_xcorr[lambda - 40];
+			}
+		}
+	}
+	else for (lambda = 40; lambda <= 120; lambda++) {
 
 # undef STEP
 #		define STEP(k) 	(longword)wt[k] * dp[k - lambda]
@@ -469,7 +485,10 @@ static void Cut_Calculation_of_the_LTP_parameters P5((st, d,dp,bc_out,Nc_out),
 
 #endif /* LTP_CUT */
 
-static void Calculation_of_the_LTP_parameters P4((d,dp,bc_out,Nc_out),
+static void Calculation_of_the_LTP_parameters P5((st, d,dp,bc_out,Nc_out),
+
+	struct gsm_state * st,
+
 	register word	* d,		/* [0..39]	IN	*/
 	register word	* dp,		/* [-120..-1]	IN	*/
 	word		* bc_out,	/* 		OUT	*/
@@ -897,7 +916,7 @@ void Gsm_Long_Term_Predictor P7((S,d,dp,e,dpp,Nc,bc), 	/* 4x for 160 samples */
 			Cut_Calculation_of_the_LTP_parameters(S, d, dp, bc, Nc);
 		else
 #endif
-			Calculation_of_the_LTP_parameters(d, dp, bc, Nc);
+			Calculation_of_the_LTP_parameters(S, d, dp, bc, Nc);
 
 	Long_term_analysis_filtering( *bc, *Nc, dp, d, dpp, e );
 }
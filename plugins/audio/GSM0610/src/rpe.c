@@ -460,7 +460,10 @@ void Gsm_RPE_Encoding P5((S,e,xmaxc,Mc,xMc),
 	word	xM[13], xMp[13];
 	word	mant, exp;
 
-	Weighting_filter(e, x);
+	if (S->kernel != GSM_KERNEL_SCALAR)
+		gsm_weighting_filter(S->kernel, e, x);
+	else
+		Weighting_filter(e, x);
 	RPE_grid_selection(x, xM, Mc);
 
 	APCM_quantization(	xM, xMc, &mant, &exp, xmaxc);
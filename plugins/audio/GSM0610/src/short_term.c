@@ -203,6 +203,11 @@ static void Short_term_analysis_filtering P4((S,rp,k_n,s),
 	register word		di, zzz, ui, sav, rpi;
 	register longword 	ltmp;
 
+	if (S->kernel != GSM_KERNEL_SCALAR) {
+		gsm_short_term_analysis( S->kernel, u, rp, k_n, s );
+		return;
+	}
+
 	for (; k_n--; s++) {
 
 		di = sav = *s;
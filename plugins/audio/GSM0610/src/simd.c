@@ -0,0 +1,554 @@
+/*
+ * simd.c
+ *
+ * Vector kernels for the hot loops of the GSM 06.10 encoder, chosen at
+ * run time by the processor.  Every kernel gives exactly the results of
+ * the reference loops in long_term.c, gsm_lpc.c and rpe.c: the sums are
+ * the same integer sums, which cannot overflow 32 bits for the scaled
+ * signals these loops are given.
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * $Id$
+ */
+
+
+#include <stdio.h>
+#include <assert.h>
+
+#include "private.h"
+
+#include "gsm.h"
+#include "proto.h"
+
+#ifndef	GSM_NO_SIMD
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__)) && \
+    (__GNUC__ >= 5 || defined(__clang__))
+#	define	GSM_SSE2	1
+#	define	GSM_AVX2	1
+#	define	GSM_SSE2_TARGET	__attribute__((target("sse2")))
+#	define	GSM_AVX2_TARGET	__attribute__((target("avx2")))
+#	include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#	define	GSM_SSE2	1
+#	define	GSM_SSE2_TARGET
+#	include <emmintrin.h>
+#	include <intrin.h>
+#	if _MSC_VER >= 1700
+#		define	GSM_AVX2	1
+#		define	GSM_AVX2_TARGET
+#		include <immintrin.h>
+#	endif
+#endif
+#endif	/* GSM_NO_SIMD */
+
+
+/*
+ *  Processor support
+ */
+
+#if defined(GSM_SSE2) && defined(_MSC_VER)
+
+static int cpu_has_sse2 P0()
+{
+	int	info[4];
+	__cpuid(info, 1);
+	return (info[3] & (1 << 26)) != 0;
+}
+
+#ifdef	GSM_AVX2
+static int cpu_has_avx2 P0()
+{
+	int	info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return 0;
+
+	/* AVX with the YMM state saved by the OS, then AVX2 itself */
+	__cpuid(info, 1);
+	if ((info[2] & (1 << 27 | 1 << 28)) != (1 << 27 | 1 << 28)) return 0;
+	if ((_xgetbv(0) & 6) != 6) return 0;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+}
+#endif
+
+#elif defined(GSM_SSE2)
+
+static int cpu_has_sse2 P0()
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("sse2") != 0;
+}
+
+static int cpu_has_avx2 P0()
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") != 0;
+}
+
+#endif
+
+int gsm_kernel_available P1((kernel), int kernel)
+{
+	switch (kernel) {
+	case GSM_KERNEL_SCALAR:
+		return 1;
+#ifdef	GSM_SSE2
+	case GSM_KERNEL_SSE2:
+		return cpu_has_sse2();
+#endif
+#ifdef	GSM_AVX2
+	case GSM_KERNEL_AVX2:
+		return cpu_has_avx2();
+#endif
+	default:
+		return 0;
+	}
+}
+
+int gsm_best_kernel P0()
+{
+	int	kernel;
+
+	for (kernel = GSM_KERNEL_AVX2; kernel > GSM_KERNEL_SCALAR; kernel--)
+		if (gsm_kernel_available(kernel)) return kernel;
+	return GSM_KERNEL_SCALAR;
+}
+
+
+/*
+ *  Sums of groups of four 32 bit lanes, lane n of the result taking
+ *  vector n.
+ */
+
+#ifdef	GSM_SSE2
+
+GSM_SSE2_TARGET
+static __m128i hadd4_sse2(__m128i a, __m128i b, __m128i c, __m128i d)
+{
+	__m128i	ab = _mm_add_epi32(_mm_unpacklo_epi32(a, b), _mm_unpackhi_epi32(a, b));
+	__m128i	cd = _mm_add_epi32(_mm_unpacklo_epi32(c, d), _mm_unpackhi_epi32(c, d));
+	return _mm_add_epi32(_mm_unpacklo_epi64(ab, cd), _mm_unpackhi_epi64(ab, cd));
+}
+
+/* longword may be wider than 32 bits, so the lanes go out one by one */
+GSM_SSE2_TARGET
+static void store4_sse2(longword * out, __m128i a)
+{
+	int	lanes[4];
+	_mm_storeu_si128((__m128i *)lanes, a);
+	out[0] = lanes[0]; out[1] = lanes[1];
+	out[2] = lanes[2]; out[3] = lanes[3];
+}
+
+GSM_SSE2_TARGET
+static int hsum_sse2(__m128i a)
+{
+	a = _mm_add_epi32(a, _mm_shuffle_epi32(a, 0x4E));
+	a = _mm_add_epi32(a, _mm_shuffle_epi32(a, 0xB1));
+	return _mm_cvtsi128_si32(a);
+}
+
+#endif
+
+
+/*
+ *  4.2.11 LTP cross-correlation, L_result[lambda-40] being the sum of
+ *  wt[k] * dp[k - lambda] for k = 0..39, for lambda = 40..120.
+ */
+
+#ifdef	GSM_SSE2
+
+GSM_SSE2_TARGET
+static __m128i ltp_dot_sse2(const __m128i * w, const word * p)
+{
+	__m128i	sum;
+	sum = _mm_madd_epi16(w[0], _mm_loadu_si128((const __m128i *)(p)));
+	sum = _mm_add_epi32(sum, _mm_madd_epi16(w[1], _mm_loadu_si128((const __m128i *)(p +  8))));
+	sum = _mm_add_epi32(sum, _mm_madd_epi16(w[2], _mm_loadu_si128((const __m128i *)(p + 16))));
+	sum = _mm_add_epi32(sum, _mm_madd_epi16(w[3], _mm_loadu_si128((const __m128i *)(p + 24))));
+	sum = _mm_add_epi32(sum, _mm_madd_epi16(w[4], _mm_loadu_si128((const __m128i *)(p + 32))));
+	return sum;
+}
+
+GSM_SSE2_TARGET
+static void ltp_cross_correlation_sse2 P3((wt, dp, L_result),
+	const word	* wt,
+	const word	* dp,
+	longword	* L_result)
+{
+	__m128i		w[5], sums;
+	int		lambda, k;
+
+	for (k = 0; k < 5; k++) w[k] = _mm_loadu_si128((const __m128i *)(wt + 8*k));
+
+	for (lambda = 40; lambda + 3 <= 120; lambda += 4) {
+		sums = hadd4_sse2(ltp_dot_sse2(w, dp - lambda),
+				  ltp_dot_sse2(w, dp - lambda - 1),
+				  ltp_dot_sse2(w, dp - lambda - 2),
+				  ltp_dot_sse2(w, dp - lambda - 3));
+		store4_sse2(L_result + lambda - 40, sums);
+	}
+	for (; lambda <= 120; lambda++)
+		L_result[lambda - 40] = hsum_sse2(ltp_dot_sse2(w, dp - lambda));
+}
+
+#endif
+
+#ifdef	GSM_AVX2
+
+/* Two 16 sample halves of each lag in 256 bits, the last 8 in 128 bits */
+GSM_AVX2_TARGET
+static void ltp_cross_correlation_avx2 P3((wt, dp, L_result),
+	const word	* wt,
+	const word	* dp,
+	longword	* L_result)
+{
+	__m256i		w0  = _mm256_loadu_si256((const __m256i *)wt);
+	__m256i		w1  = _mm256_loadu_si256((const __m256i *)(wt + 16));
+	__m128i		w2  = _mm_loadu_si128((const __m128i *)(wt + 32));
+	__m256i		s[4];
+	__m128i		t[4], sums;
+	const word	* p;
+	int		lambda, j;
+
+	for (lambda = 40; lambda + 3 <= 120; lambda += 4) {
+		for (j = 0; j < 4; j++) {
+			p = dp - lambda - j;
+			s[j] = _mm256_add_epi32(
+				_mm256_madd_epi16(w0, _mm256_loadu_si256((const __m256i *)p)),
+				_mm256_madd_epi16(w1, _mm256_loadu_si256((const __m256i *)(p + 16))));
+			t[j] = _mm_add_epi32(
+				_mm_add_epi32(_mm256_castsi256_si128(s[j]), _mm256_extracti128_si256(s[j], 1)),
+				_mm_madd_epi16(w2, _mm_loadu_si128((const __m128i *)(p + 32))));
+		}
+		sums = hadd4_sse2(t[0], t[1], t[2], t[3]);
+		store4_sse2(L_result + lambda - 40, sums);
+	}
+	for (; lambda <= 120; lambda++) {
+		p = dp - lambda;
+		s[0] = _mm256_add_epi32(
+			_mm256_madd_epi16(w0, _mm256_loadu_si256((const __m256i *)p)),
+			_mm256_madd_epi16(w1, _mm256_loadu_si256((const __m256i *)(p + 16))));
+		t[0] = _mm_add_epi32(
+			_mm_add_epi32(_mm256_castsi256_si128(s[0]), _mm256_extracti128_si256(s[0], 1)),
+			_mm_madd_epi16(w2, _mm_loadu_si128((const __m128i *)(p + 32))));
+		L_result[lambda - 40] = hsum_sse2(t[0]);
+	}
+}
+
+#endif
+
+void gsm_ltp_cross_correlation P4((kernel, wt, dp, L_result),
+	int		kernel,
+	const word	* wt,		/* [0..39]		IN	*/
+	const word	* dp,		/* [-120..-1]		IN	*/
+	longword	* L_result)	/* [0..80]		OUT	*/
+{
+	int	lambda, k;
+
+	switch (kernel) {
+#ifdef	GSM_SSE2
+	case GSM_KERNEL_SSE2:
+		ltp_cross_correlation_sse2(wt, dp, L_result);
+		return;
+#endif
+#ifdef	GSM_AVX2
+	case GSM_KERNEL_AVX2:
+		ltp_cross_correlation_avx2(wt, dp, L_result);
+		return;
+#endif
+	default:
+		for (lambda = 40; lambda <= 120; lambda++) {
+			longword sum = 0;
+			for (k = 0; k <= 39; k++) sum += (longword)wt[k] * dp[k - lambda];
+			L_result[lambda - 40] = sum;
+		}
+	}
+}
+
+
+/*
+ *  4.2.4 Autocorrelation, L_ACF[k] being the sum of s[i] * s[i - k] for
+ *  i = k..159, for k = 0..8, before the doubling.  The signal is copied
+ *  after eight zeros so every lag is a full 160 sample product.
+ */
+
+#ifdef	GSM_SSE2
+
+GSM_SSE2_TARGET
+static __m128i acf_dot_sse2(const word * s, const word * p)
+{
+	__m128i	sum = _mm_setzero_si128();
+	int	i;
+	for (i = 0; i < 160; i += 8)
+		sum = _mm_add_epi32(sum, _mm_madd_epi16(
+			_mm_load_si128((const __m128i *)(s + i)),
+			_mm_loadu_si128((const __m128i *)(p + i))));
+	return sum;
+}
+
+GSM_SSE2_TARGET
+static void autocorrelation_sse2 P2((s, L_ACF),
+	const word	* s,
+	longword	* L_ACF)
+{
+	__m128i		padded[21];
+	word		* p = (word *)padded;
+	int		k;
+
+	_mm_store_si128(padded, _mm_setzero_si128());
+	for (k = 0; k < 160; k++) p[8 + k] = s[k];
+
+	store4_sse2(L_ACF, hadd4_sse2(acf_dot_sse2(p + 8, p + 8), acf_dot_sse2(p + 8, p + 7),
+				      acf_dot_sse2(p + 8, p + 6), acf_dot_sse2(p + 8, p + 5)));
+	store4_sse2(L_ACF + 4, hadd4_sse2(acf_dot_sse2(p + 8, p + 4), acf_dot_sse2(p + 8, p + 3),
+					  acf_dot_sse2(p + 8, p + 2), acf_dot_sse2(p + 8, p + 1)));
+	L_ACF[8] = hsum_sse2(acf_dot_sse2(p + 8, p));
+}
+
+#endif
+
+#ifdef	GSM_AVX2
+
+GSM_AVX2_TARGET
+static __m128i acf_dot_avx2(const word * s, const word * p)
+{
+	__m256i	sum = _mm256_setzero_si256();
+	int	i;
+	for (i = 0; i < 160; i += 16)
+		sum = _mm256_add_epi32(sum, _mm256_madd_epi16(
+			_mm256_load_si256((const __m256i *)(s + i)),
+			_mm256_loadu_si256((const __m256i *)(p + i))));
+	return _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+}
+
+/* Sixteen zeros in front keep the signal aligned for 256 bit loads */
+GSM_AVX2_TARGET
+static void autocorrelation_avx2 P2((s, L_ACF),
+	const word	* s,
+	longword	* L_ACF)
+{
+	__m256i		padded[11];
+	word		* p = (word *)padded;
+	int		k;
+
+	_mm256_store_si256(padded, _mm256_setzero_si256());
+	for (k = 0; k < 160; k++) p[16 + k] = s[k];
+
+	store4_sse2(L_ACF, hadd4_sse2(acf_dot_avx2(p + 16, p + 16), acf_dot_avx2(p + 16, p + 15),
+				      acf_dot_avx2(p + 16, p + 14), acf_dot_avx2(p + 16, p + 13)));
+	store4_sse2(L_ACF + 4, hadd4_sse2(acf_dot_avx2(p + 16, p + 12), acf_dot_avx2(p + 16, p + 11),
+					  acf_dot_avx2(p + 16, p + 10), acf_dot_avx2(p + 16, p + 9)));
+	L_ACF[8] = hsum_sse2(acf_dot_avx2(p + 16, p + 8));
+}
+
+#endif
+
+void gsm_autocorrelation P3((kernel, s, L_ACF),
+	int		kernel,
+	const word	* s,		/* [0..159]		IN	*/
+	longword	* L_ACF)	/* [0..8]		OUT	*/
+{
+	int	i, k;
+
+	switch (kernel) {
+#ifdef	GSM_SSE2
+	case GSM_KERNEL_SSE2:
+		autocorrelation_sse2(s, L_ACF);
+		return;
+#endif
+#ifdef	GSM_AVX2
+	case GSM_KERNEL_AVX2:
+		autocorrelation_avx2(s, L_ACF);
+		return;
+#endif
+	default:
+		for (k = 0; k <= 8; k++) {
+			longword sum = 0;
+			for (i = k; i <= 159; i++) sum += (longword)s[i] * s[i - k];
+			L_ACF[k] = sum;
+		}
+	}
+}
+
+
+/*
+ *  4.2.13 Weighting filter, x[k] for k = 0..39 from e[-5..44], eight
+ *  outputs to a vector.  The 32 bit products are built from their low
+ *  and high halves; the pack saturates as the clamp of the reference.
+ */
+
+#ifdef	GSM_SSE2
+
+GSM_SSE2_TARGET
+static void weighting_filter_sse2 P2((e, x),
+	const word	* e,
+	word		* x)
+{
+	static const short	H[11] = { -134, -374, 0, 2054, 5741, 8192, 5741, 2054, 0, -374, -134 };
+	__m128i			lo, hi, prodlo, prodhi, sample, coef;
+	int			k, i;
+
+	e -= 5;
+	for (k = 0; k < 40; k += 8) {
+		lo = hi = _mm_set1_epi32(8192 >> 1);
+		for (i = 0; i <= 10; i++) {
+			if (H[i] == 0) continue;
+			sample = _mm_loadu_si128((const __m128i *)(e + k + i));
+			coef   = _mm_set1_epi16(H[i]);
+			prodlo = _mm_mullo_epi16(sample, coef);
+			prodhi = _mm_mulhi_epi16(sample, coef);
+			lo = _mm_add_epi32(lo, _mm_unpacklo_epi16(prodlo, prodhi));
+			hi = _mm_add_epi32(hi, _mm_unpackhi_epi16(prodlo, prodhi));
+		}
+		_mm_storeu_si128((__m128i *)(x + k),
+			_mm_packs_epi32(_mm_srai_epi32(lo, 13), _mm_srai_epi32(hi, 13)));
+	}
+}
+
+#endif
+
+void gsm_weighting_filter P3((kernel, e, x),
+	int		kernel,
+	const word	* e,		/* signal [-5..0.39.44]	IN  */
+	word		* x)		/* signal [0..39]	OUT */
+{
+	static const short	H[11] = { -134, -374, 0, 2054, 5741, 8192, 5741, 2054, 0, -374, -134 };
+	longword		L_result;
+	int			k, i;
+
+	switch (kernel) {
+#ifdef	GSM_SSE2
+	case GSM_KERNEL_SSE2:
+	case GSM_KERNEL_AVX2:
+		weighting_filter_sse2(e, x);
+		return;
+#endif
+	default:
+		for (k = 0; k <= 39; k++) {
+			L_result = 8192 >> 1;
+			for (i = 0; i <= 10; i++) L_result += e[k + i - 5] * (longword)H[i];
+			L_result = SASR( L_result, 13 );
+			x[k] = (word) (L_result < MIN_WORD ? MIN_WORD
+				: (L_result > MAX_WORD ? MAX_WORD : L_result));
+		}
+	}
+}
+
+
+/*
+ *  4.2.10 Short term analysis filtering.  The eight lattice stages run
+ *  as a wavefront, lane i filtering sample t - i at step t, so each
+ *  step is one vector operation and a sample leaves lane 7 seven steps
+ *  after it enters lane 0.  Lanes outside the samples of the call leave
+ *  their u[i] alone.  |rp[i]| < 32768, so the rounded products never
+ *  overflow and GSM_ADD is a saturating add.
+ */
+
+#ifdef	GSM_SSE2
+
+/* GSM_MULT_R from the 32 bit product in halves, (hi << 1) plus the
+ * rounded top bit of lo.
+ */
+GSM_SSE2_TARGET
+static __m128i mult_r_sse2(__m128i a, __m128i b)
+{
+	__m128i	hi = _mm_mulhi_epi16(a, b);
+	__m128i	lo = _mm_mullo_epi16(a, b);
+	__m128i	round = _mm_srli_epi16(_mm_add_epi16(_mm_srli_epi16(lo, 14), _mm_set1_epi16(1)), 1);
+	return _mm_add_epi16(_mm_slli_epi16(hi, 1), round);
+}
+
+#define	SHORT_TERM_ANALYSIS(NAME, TARGET, MULT_R)				\
+TARGET										\
+static void NAME P4((u, rp, k_n, s),						\
+	word		* u,							\
+	const word	* rp,							\
+	int		k_n,							\
+	word		* s)							\
+{										\
+	__m128i	rpv   = _mm_loadu_si128((const __m128i *)rp);			\
+	__m128i	uv    = _mm_loadu_si128((const __m128i *)u);			\
+	__m128i	di    = _mm_setzero_si128();					\
+	__m128i	sav   = _mm_setzero_si128();					\
+	__m128i	valid = _mm_setzero_si128();					\
+	__m128i	ui;								\
+	int	t, x;								\
+										\
+	for (t = 0; t < k_n + 7; t++) {						\
+		x = t < k_n ? s[t] : 0;						\
+		di    = _mm_insert_epi16(_mm_slli_si128(di, 2), x, 0);		\
+		sav   = _mm_insert_epi16(_mm_slli_si128(sav, 2), x, 0);		\
+		valid = _mm_insert_epi16(_mm_slli_si128(valid, 2), t < k_n ? -1 : 0, 0); \
+										\
+		ui = uv;							\
+		uv = _mm_or_si128(_mm_and_si128(valid, sav), _mm_andnot_si128(valid, uv)); \
+										\
+		sav = _mm_adds_epi16(ui, MULT_R(rpv, di));			\
+		di  = _mm_adds_epi16(di, MULT_R(rpv, ui));			\
+										\
+		if (t >= 7) s[t - 7] = (word)_mm_extract_epi16(di, 7);		\
+	}									\
+										\
+	_mm_storeu_si128((__m128i *)u, uv);					\
+}
+
+SHORT_TERM_ANALYSIS(short_term_analysis_sse2, GSM_SSE2_TARGET, mult_r_sse2)
+
+#endif
+
+#ifdef	GSM_AVX2
+/* pmulhrsw rounds exactly as GSM_MULT_R */
+SHORT_TERM_ANALYSIS(short_term_analysis_avx2, GSM_AVX2_TARGET, _mm_mulhrs_epi16)
+#endif
+
+void gsm_short_term_analysis P5((kernel, u, rp, k_n, s),
+	int		kernel,
+	word		* u,		/* [0..7]		IN/OUT	*/
+	const word	* rp,		/* [0..7]		IN	*/
+	int		k_n,		/*   k_end - k_start	*/
+	word		* s)		/* [0..n-1]		IN/OUT	*/
+{
+	register int		i;
+	register word		di, zzz, ui, sav, rpi;
+	register longword 	ltmp;
+
+	switch (kernel) {
+#ifdef	GSM_SSE2
+	case GSM_KERNEL_SSE2:
+		short_term_analysis_sse2(u, rp, k_n, s);
+		return;
+#endif
+#ifdef	GSM_AVX2
+	case GSM_KERNEL_AVX2:
+		short_term_analysis_avx2(u, rp, k_n, s);
+		return;
+#endif
+	default:
+		for (; k_n--; s++) {
+			di = sav = *s;
+			for (i = 0; i < 8; i++) {
+				ui    = u[i];
+				rpi   = rp[i];
+				u[i]  = sav;
+				zzz   = GSM_MULT_R(rpi, di);
+				sav   = (word) GSM_ADD(   ui,  zzz);
+				zzz   = GSM_MULT_R(rpi, ui);
+				di    = (word) GSM_ADD(   di,  zzz );
+			}
+			*s = di;
+		}
+	}
+}
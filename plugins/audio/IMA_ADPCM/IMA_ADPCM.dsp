@@ -97,6 +97,12 @@ SOURCE=.\ima_adpcm.c
 # ADD CPP /D "PLUGIN_CODEC_DLL_EXPORTS"
 # SUBTRACT CPP /D "IMA_ADPCM_EXPORTS"
 # End Source File
+# Begin Source File
+
+SOURCE=.\adpcm.c
+# ADD CPP /D "PLUGIN_CODEC_DLL_EXPORTS"
+# SUBTRACT CPP /D "IMA_ADPCM_EXPORTS"
+# End Source File
 # End Group
 # End Target
 # End Project
@@ -0,0 +1,511 @@
+/*
+ * IMA ADPCM coder for the IMA-ADPCM plugin codec, and the coding of many
+ * independent channels side by side.  Within a channel each sample needs
+ * the predicted value and step index left by the one before, but eight
+ * channels can share the vector lanes of the AVX2 kernel, chosen at run
+ * time, which gives exactly the frames of the single channel coder.
+ *
+ * Copyright (C) 2004 Post Increment, All Rights Reserved
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * $Id$
+ */
+
+#include <string.h>
+
+#include "adpcm.h"
+
+#ifndef ADPCM_NO_SIMD
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__)) && \
+    (__GNUC__ >= 5 || defined(__clang__))
+#define ADPCM_AVX2        1
+#define ADPCM_AVX2_TARGET __attribute__((target("avx2")))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86)) && _MSC_VER >= 1700
+#define ADPCM_AVX2        1
+#define ADPCM_AVX2_TARGET
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+#endif
+
+/* Channels advanced together by the vector kernel, and the fewest worth
+   handing to it rather than the single channel coder */
+#define LANES     8
+#define MIN_LANES 3
+
+/* Intel ADPCM step variation table */
+static int indexTable[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+static int stepsizeTable[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+    19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+    130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+    5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+void adpcm_coder(short indata[], char outdata[], int len, struct adpcm_state *state)
+{
+    short *inp;                 /* Input buffer pointer */
+    signed char *outp;          /* output buffer pointer */
+    int val;                    /* Current input sample value */
+    int sign;                   /* Current adpcm sign bit */
+    int delta;                  /* Current adpcm output value */
+    int diff;                   /* Difference between val and valprev */
+    int step;                   /* Stepsize */
+    int valpred;                /* Predicted output value */
+    int vpdiff;                 /* Current change to valpred */
+    char index;                 /* Current step change index */
+    int outputbuffer = 0;       /* place to keep previous 4-bit value */
+    int bufferstep;             /* toggle between outputbuffer/output */
+
+    outp = (signed char *)outdata;
+    inp = indata;
+
+    //create header
+    valpred = *inp;
+    memcpy(outp, (char *)inp, 2);
+    inp++;
+    outp += sizeof(short);
+
+    index = state->index;
+    memcpy(outp, (char *)&index, 1);
+    outp++;
+    *outp = 0;
+    outp++;
+    //create header ends
+
+    len--;
+
+    step = stepsizeTable[(int)index];
+
+    bufferstep = 1;
+
+    for ( ; len > 0 ; len-- ) {
+        val = *inp++;
+
+        /* Step 1 - compute difference with previous value */
+        diff = val - valpred;
+        sign = (diff < 0) ? 8 : 0;
+        if ( sign ) diff = (-diff);
+
+        /* Step 2 - Divide and clamp */
+        /* Note:
+        ** This code *approximately* computes:
+        **    delta = diff*4/step;
+        **    vpdiff = (delta+0.5)*step/4;
+        ** but in shift step bits are dropped. The net result of this is
+        ** that even if you have fast mul/div hardware you cannot put it to
+        ** good use since the fixup would be too expensive.
+        */
+        delta = 0;
+        vpdiff = (step >> 3);
+
+        if ( diff >= step ) {
+            delta = 4;
+            diff -= step;
+            vpdiff += step;
+        }
+        step >>= 1;
+        if ( diff >= step  ) {
+            delta |= 2;
+            diff -= step;
+            vpdiff += step;
+        }
+        step >>= 1;
+        if ( diff >= step ) {
+            delta |= 1;
+            vpdiff += step;
+        }
+
+        /* Step 3 - Update previous value */
+        if ( sign )
+          valpred -= vpdiff;
+        else
+          valpred += vpdiff;
+
+        /* Step 4 - Clamp previous value to 16 bits */
+        if ( valpred > 32767 )
+          valpred = 32767;
+        else if ( valpred < -32768 )
+          valpred = -32768;
+
+        /* Step 5 - Assemble value, update index and step values */
+        delta |= sign;
+        index = (char)(index + indexTable[delta]);
+        if ( index < 0 ) index = 0;
+        if ( index > 88 ) index = 88;
+        step = stepsizeTable[(int)index];
+
+        /* Step 6 - Output value */
+        if ( bufferstep ) {
+            outputbuffer = (delta << 4) & 0xf0;
+        } else {
+            *outp++ = (char)((delta & 0x0f) | outputbuffer);
+        }
+        bufferstep = !bufferstep;
+    }
+
+    /* Output last step, if needed */
+    if ( !bufferstep )
+      *outp++ = (char)outputbuffer;
+
+    state->valprev = (short)valpred;
+    state->index = index;
+
+}
+
+void adpcm_decoder(char indata[], short outdata[], int len)
+{
+    signed char *inp;           /* Input buffer pointer */
+    short *outp;                /* output buffer pointer */
+    int sign;                   /* Current adpcm sign bit */
+    int delta;                  /* Current adpcm output value */
+    int step;                   /* Stepsize */
+    int valpred;                /* Predicted value */
+    int vpdiff;                 /* Current change to valpred */
+    int index;                  /* Current step change index */
+    int inputbuffer = 0;        /* place to keep next 4-bit value */
+    int bufferstep;             /* toggle between inputbuffer/input */
+    short first;                /* Sample in the header */
+
+    outp = outdata;
+    inp = (signed char *)indata;
+
+    //the header sample is the first output
+    memcpy((char *)&first, (char *)inp, 2);
+    valpred = first;
+    *outp++ = first;
+    inp += 2;
+    index = (int)(unsigned char)*inp;
+    if ( index > 88 ) index = 88;
+    inp += 2; //skip index
+
+    step = stepsizeTable[index];
+    len -= 4; //skip header
+
+    bufferstep = 0;
+
+    len *= 2;
+
+    for ( ; len > 0 ; len-- ) {
+        /* Step 1 - get the delta value */
+        if ( bufferstep ) {
+            delta = inputbuffer & 0xf;
+        } else {
+            inputbuffer = *inp++;
+            delta = (inputbuffer >> 4) & 0xf;
+        }
+        bufferstep = !bufferstep;
+
+        /* Step 2 - Find new index value (for later) */
+        index += indexTable[delta];
+        if ( index < 0 ) index = 0;
+        if ( index > 88 ) index = 88;
+
+        /* Step 3 - Separate sign and magnitude */
+        sign = delta & 8;
+        delta = delta & 7;
+        /* Step 4 - Compute difference and new predicted value */
+        /*
+        ** Computes 'vpdiff = (delta+0.5)*step/4', but see comment
+        ** in adpcm_coder.
+        */
+        vpdiff = step >> 3;
+        if ( delta & 4 ) vpdiff += step;
+        if ( delta & 2 ) vpdiff += step>>1;
+        if ( delta & 1 ) vpdiff += step>>2;
+
+        if ( sign )
+          valpred -= vpdiff;
+        else
+          valpred += vpdiff;
+
+        /* Step 5 - clamp output value */
+        if ( valpred > 32767 )
+          valpred = 32767;
+        else if ( valpred < -32768 )
+          valpred = -32768;
+
+        /* Step 6 - Update step value */
+        step = stepsizeTable[index];
+
+        /* Step 7 - Output value */
+        *outp++ = (short)valpred;
+    }
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+#ifdef ADPCM_AVX2
+
+#if defined(_MSC_VER)
+static int cpu_has_avx2(void)
+{
+    int info[4];
+
+    __cpuid(info, 0);
+    if ( info[0] < 7 )
+      return 0;
+
+    /* AVX with the YMM state saved by the OS, then AVX2 itself */
+    __cpuid(info, 1);
+    if ( (info[2] & (1 << 27 | 1 << 28)) != (1 << 27 | 1 << 28) )
+      return 0;
+    if ( (_xgetbv(0) & 6) != 6 )
+      return 0;
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+}
+#else
+static int cpu_has_avx2(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+}
+#endif
+
+static int use_avx2(void)
+{
+    /* Racing threads all find the same answer */
+    static int avx2 = -1;
+
+    if ( avx2 < 0 )
+      avx2 = cpu_has_avx2();
+    return avx2;
+}
+
+/* indexTable[delta], the step index change of a code */
+ADPCM_AVX2_TARGET
+static __m256i index_change(__m256i delta)
+{
+    __m256i magnitude = _mm256_and_si256(delta, _mm256_set1_epi32(7));
+    __m256i up = _mm256_slli_epi32(_mm256_sub_epi32(magnitude, _mm256_set1_epi32(3)), 1);
+
+    return _mm256_blendv_epi8(_mm256_set1_epi32(-1), up,
+                              _mm256_cmpgt_epi32(magnitude, _mm256_set1_epi32(3)));
+}
+
+/* The next step index and step size */
+ADPCM_AVX2_TARGET
+static __m256i next_index(__m256i index, __m256i delta, __m256i * step)
+{
+    index = _mm256_add_epi32(index, index_change(delta));
+    index = _mm256_min_epi32(_mm256_max_epi32(index, _mm256_setzero_si256()), _mm256_set1_epi32(88));
+    *step = _mm256_i32gather_epi32(stepsizeTable, index, 4);
+    return index;
+}
+
+/* Eight channels from the first, those past 'channels' being stand ins
+   coding a copy of the first channel, and discarded */
+ADPCM_AVX2_TARGET
+static void adpcm_coder_lanes(int channels,
+                              struct adpcm_state * const state[],
+                              const short * const indata[],
+                              char * const outdata[])
+{
+    const short *inp[LANES];
+    __m256i valpred, index, step, val, diff, sign, delta, vpdiff, mask, previous;
+    int w[LANES];
+    int c, n;
+
+    for ( c = 0; c < LANES; c++ )
+      inp[c] = indata[c < channels ? c : 0];
+
+    /* The headers, and the first sample as the prediction */
+    for ( c = 0; c < channels; c++ ) {
+      char index = state[c]->index;
+      memcpy(outdata[c], (const char *)inp[c], 2);
+      memcpy(outdata[c] + 2, &index, 1);
+      outdata[c][3] = 0;
+    }
+    valpred = _mm256_setr_epi32(inp[0][0], inp[1][0], inp[2][0], inp[3][0],
+                                inp[4][0], inp[5][0], inp[6][0], inp[7][0]);
+    index = _mm256_setr_epi32(state[0]->index,
+                              state[channels > 1 ? 1 : 0]->index,
+                              state[channels > 2 ? 2 : 0]->index,
+                              state[channels > 3 ? 3 : 0]->index,
+                              state[channels > 4 ? 4 : 0]->index,
+                              state[channels > 5 ? 5 : 0]->index,
+                              state[channels > 6 ? 6 : 0]->index,
+                              state[channels > 7 ? 7 : 0]->index);
+    step = _mm256_i32gather_epi32(stepsizeTable, index, 4);
+    previous = _mm256_setzero_si256();
+
+    for ( n = 1; n < ADPCM_FRAME_SAMPLES; n++ ) {
+        val = _mm256_setr_epi32(inp[0][n], inp[1][n], inp[2][n], inp[3][n],
+                                inp[4][n], inp[5][n], inp[6][n], inp[7][n]);
+
+        /* Step 1 - compute difference with previous value */
+        diff = _mm256_sub_epi32(val, valpred);
+        sign = _mm256_cmpgt_epi32(_mm256_setzero_si256(), diff);
+        diff = _mm256_abs_epi32(diff);
+
+        /* Step 2 - Divide and clamp, each bit a compare of the remainder */
+        vpdiff = _mm256_srai_epi32(step, 3);
+        mask = _mm256_xor_si256(_mm256_cmpgt_epi32(step, diff), _mm256_set1_epi32(-1));
+        delta = _mm256_and_si256(mask, _mm256_set1_epi32(4));
+        diff = _mm256_sub_epi32(diff, _mm256_and_si256(mask, step));
+        vpdiff = _mm256_add_epi32(vpdiff, _mm256_and_si256(mask, step));
+        step = _mm256_srai_epi32(step, 1);
+        mask = _mm256_xor_si256(_mm256_cmpgt_epi32(step, diff), _mm256_set1_epi32(-1));
+        delta = _mm256_or_si256(delta, _mm256_and_si256(mask, _mm256_set1_epi32(2)));
+        diff = _mm256_sub_epi32(diff, _mm256_and_si256(mask, step));
+        vpdiff = _mm256_add_epi32(vpdiff, _mm256_and_si256(mask, step));
+        step = _mm256_srai_epi32(step, 1);
+        mask = _mm256_xor_si256(_mm256_cmpgt_epi32(step, diff), _mm256_set1_epi32(-1));
+        delta = _mm256_or_si256(delta, _mm256_and_si256(mask, _mm256_set1_epi32(1)));
+        vpdiff = _mm256_add_epi32(vpdiff, _mm256_and_si256(mask, step));
+
+        /* Steps 3 and 4 - Update and clamp the previous value */
+        vpdiff = _mm256_sub_epi32(_mm256_xor_si256(vpdiff, sign), sign);
+        valpred = _mm256_add_epi32(valpred, vpdiff);
+        valpred = _mm256_min_epi32(_mm256_max_epi32(valpred, _mm256_set1_epi32(-32768)),
+                                   _mm256_set1_epi32(32767));
+
+        /* Step 5 - Assemble value, update index and step values */
+        delta = _mm256_or_si256(delta, _mm256_and_si256(sign, _mm256_set1_epi32(8)));
+        index = next_index(index, delta, &step);
+
+        /* Step 6 - Output value, the first of each pair in the high bits */
+        if ( n & 1 )
+          previous = _mm256_slli_epi32(delta, 4);
+        else {
+          _mm256_storeu_si256((__m256i *)w, _mm256_or_si256(previous, delta));
+          for ( c = 0; c < channels; c++ )
+            outdata[c][4 + (n-1)/2] = (char)w[c];
+        }
+    }
+
+    _mm256_storeu_si256((__m256i *)w, valpred);
+    for ( c = 0; c < channels; c++ )
+      state[c]->valprev = (short)w[c];
+    _mm256_storeu_si256((__m256i *)w, index);
+    for ( c = 0; c < channels; c++ )
+      state[c]->index = (char)w[c];
+}
+
+ADPCM_AVX2_TARGET
+static void adpcm_decoder_lanes(int channels,
+                                const char * const indata[],
+                                short * const outdata[])
+{
+    const signed char *inp[LANES];
+    __m256i valpred, index, step, delta, vpdiff, sign, bytes;
+    int w[LANES];
+    int c, n;
+
+    for ( c = 0; c < LANES; c++ )
+      inp[c] = (const signed char *)indata[c < channels ? c : 0];
+
+    /* The headers, the first sample being the first output */
+    for ( c = 0; c < LANES; c++ ) {
+      short first;
+      memcpy(&first, inp[c], 2);
+      w[c] = first;
+      if ( c < channels )
+        outdata[c][0] = first;
+    }
+    valpred = _mm256_loadu_si256((const __m256i *)w);
+    for ( c = 0; c < LANES; c++ )
+      w[c] = (unsigned char)inp[c][2];
+    index = _mm256_min_epi32(_mm256_loadu_si256((const __m256i *)w), _mm256_set1_epi32(88));
+    step = _mm256_i32gather_epi32(stepsizeTable, index, 4);
+    bytes = _mm256_setzero_si256();
+
+    for ( n = 1; n < ADPCM_FRAME_SAMPLES; n++ ) {
+        /* Step 1 - get the delta value, the high bits of a byte first */
+        if ( n & 1 ) {
+          int i = 4 + (n-1)/2;
+          bytes = _mm256_setr_epi32(inp[0][i], inp[1][i], inp[2][i], inp[3][i],
+                                    inp[4][i], inp[5][i], inp[6][i], inp[7][i]);
+          delta = _mm256_srai_epi32(bytes, 4);
+        }
+        else
+          delta = bytes;
+        delta = _mm256_and_si256(delta, _mm256_set1_epi32(0xf));
+
+        /* Step 4 - Compute difference and new predicted value, with the
+           step before step 2 and 6 change it */
+        vpdiff = _mm256_srai_epi32(step, 3);
+        vpdiff = _mm256_add_epi32(vpdiff, _mm256_and_si256(step,
+                   _mm256_cmpgt_epi32(_mm256_and_si256(delta, _mm256_set1_epi32(4)), _mm256_setzero_si256())));
+        vpdiff = _mm256_add_epi32(vpdiff, _mm256_and_si256(_mm256_srai_epi32(step, 1),
+                   _mm256_cmpgt_epi32(_mm256_and_si256(delta, _mm256_set1_epi32(2)), _mm256_setzero_si256())));
+        vpdiff = _mm256_add_epi32(vpdiff, _mm256_and_si256(_mm256_srai_epi32(step, 2),
+                   _mm256_cmpgt_epi32(_mm256_and_si256(delta, _mm256_set1_epi32(1)), _mm256_setzero_si256())));
+
+        sign = _mm256_cmpgt_epi32(_mm256_and_si256(delta, _mm256_set1_epi32(8)), _mm256_setzero_si256());
+        vpdiff = _mm256_sub_epi32(_mm256_xor_si256(vpdiff, sign), sign);
+        valpred = _mm256_add_epi32(valpred, vpdiff);
+
+        /* Step 5 - clamp output value */
+        valpred = _mm256_min_epi32(_mm256_max_epi32(valpred, _mm256_set1_epi32(-32768)),
+                                   _mm256_set1_epi32(32767));
+
+        /* Steps 2 and 6 - Find new index value and step */
+        index = next_index(index, delta, &step);
+
+        /* Step 7 - Output value */
+        _mm256_storeu_si256((__m256i *)w, valpred);
+        for ( c = 0; c < channels; c++ )
+          outdata[c][n] = (short)w[c];
+    }
+}
+
+#endif /* ADPCM_AVX2 */
+
+void adpcm_coder_channels(int channels,
+                          struct adpcm_state * const state[],
+                          const short * const indata[],
+                          char * const outdata[])
+{
+    int c = 0;
+
+#ifdef ADPCM_AVX2
+    if ( use_avx2() ) {
+      for ( ; channels - c >= MIN_LANES; c += LANES )
+        adpcm_coder_lanes(channels - c < LANES ? channels - c : LANES,
+                          state + c, indata + c, outdata + c);
+    }
+#endif
+    for ( ; c < channels; c++ )
+      adpcm_coder((short *)indata[c], outdata[c], ADPCM_FRAME_SAMPLES, state[c]);
+}
+
+void adpcm_decoder_channels(int channels,
+                            const char * const indata[],
+                            short * const outdata[])
+{
+    int c = 0;
+
+#ifdef ADPCM_AVX2
+    if ( use_avx2() ) {
+      for ( ; channels - c >= MIN_LANES; c += LANES )
+        adpcm_decoder_lanes(channels - c < LANES ? channels - c : LANES,
+                            indata + c, outdata + c);
+    }
+#endif
+    for ( ; c < channels; c++ )
+      adpcm_decoder((char *)indata[c], outdata[c], ADPCM_FRAME_BYTES);
+}
@@ -0,0 +1,53 @@
+/*
+ * IMA ADPCM coder for the IMA-ADPCM plugin codec
+ *
+ * Copyright (C) 2004 Post Increment, All Rights Reserved
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * $Id$
+ */
+
+#ifndef _ADPCM_H
+#define _ADPCM_H
+
+/* A frame is a header of the first sample and the step index, then four
+   bits for each of the rest */
+#define ADPCM_FRAME_SAMPLES	505
+#define ADPCM_FRAME_BYTES	256
+
+struct adpcm_state {
+  short valprev;        /* Previous output value */
+  char  index;          /* Index into stepsize table */
+};
+
+/* Code one frame, len being ADPCM_FRAME_SAMPLES */
+void adpcm_coder(short indata[], char outdata[], int len, struct adpcm_state *state);
+
+/* Decode one frame, len being ADPCM_FRAME_BYTES */
+void adpcm_decoder(char indata[], short outdata[], int len);
+
+/* Code a frame of each of many independent channels, advancing the coder
+   state of the channels in vector lanes where the processor allows. The
+   frames are exactly those of adpcm_coder(). */
+void adpcm_coder_channels(int channels,
+                          struct adpcm_state * const state[],
+                          const short * const indata[],
+                          char * const outdata[]);
+
+/* Decode a frame of each of many independent channels, exactly as
+   adpcm_decoder() does */
+void adpcm_decoder_channels(int channels,
+                            const char * const indata[],
+                            short * const outdata[]);
+
+#endif /* _ADPCM_H */
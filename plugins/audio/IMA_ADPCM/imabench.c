@@ -0,0 +1,224 @@
+/*
+ * imabench.c
+ *
+ * Bit exact check and timing of coding many IMA ADPCM channels at once.
+ * The same channels are coded a frame at a time with adpcm_coder() and
+ * adpcm_decoder(), and with adpcm_coder_channels() and
+ * adpcm_decoder_channels(), which must give the same frames, samples and
+ * states, and the time per channel second is reported.
+ *
+ *   imabench [-c channels] [-s seconds]
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * $Id$
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include "adpcm.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define SAMPLE_RATE    8000
+
+
+static double Seconds(void)
+{
+#ifdef _WIN32
+  LARGE_INTEGER count, frequency;
+  QueryPerformanceCounter(&count);
+  QueryPerformanceFrequency(&frequency);
+  return (double)count.QuadPart/frequency.QuadPart;
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec/1e9;
+#endif
+}
+
+
+/* A different mix of tone, noise, silence and clipping on each channel,
+   with a loud tone to take the step size to the top of the table */
+static void Synthesise(short * pcm, int samples, int channel)
+{
+  unsigned seed = 1 + channel*7919;
+  double phase = 0;
+  int i;
+
+  for (i = 0; i < samples; i++) {
+    double t = (double)i/SAMPLE_RATE + channel*0.37;
+    double frequency = 200 + 3000*fmod(t*0.25, 1.0);
+    double sample, noise;
+
+    phase += 2*M_PI*frequency/SAMPLE_RATE;
+    seed = seed*1664525 + 1013904223;
+    noise = ((seed >> 16)/32768.0 - 1);
+
+    switch ((int)fmod(t, 4.0)) {
+      case 0 :
+        sample = 12000*sin(phase) + 800*noise;
+        break;
+      case 1 :
+        sample = 0;
+        break;
+      case 2 :
+        sample = 45000*sin(2*M_PI*1800*t);    /* clips */
+        break;
+      default :
+        sample = 20000*noise;
+    }
+
+    pcm[i] = (short)(sample > 32767 ? 32767 : sample < -32768 ? -32768 : sample);
+  }
+}
+
+
+
+
+int main(int argc, char * argv[])
+{
+  int channels = 16, seconds = 10, frames, i, c, failed = 0;
+  short ** pcm, ** decoded, ** batchDecoded;
+  char ** codes, ** batchCodes;
+  struct adpcm_state * states, * batchStates;
+  double start, single[2], batch[2];
+  int mismatch = 0;
+
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-c") == 0 && i+1 < argc)
+      channels = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-s") == 0 && i+1 < argc)
+      seconds = atoi(argv[++i]);
+    else {
+      fprintf(stderr, "usage: %s [-c channels] [-s seconds]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (channels < 1 || seconds < 1) {
+    fprintf(stderr, "%s: no channels or time to code\n", argv[0]);
+    return 2;
+  }
+
+  frames = (seconds*SAMPLE_RATE + ADPCM_FRAME_SAMPLES - 1)/ADPCM_FRAME_SAMPLES;
+  pcm = (short **)malloc(channels*sizeof(short *));
+  codes = (char **)malloc(channels*sizeof(char *));
+  batchCodes = (char **)malloc(channels*sizeof(char *));
+  decoded = (short **)malloc(channels*sizeof(short *));
+  batchDecoded = (short **)malloc(channels*sizeof(short *));
+  states = (struct adpcm_state *)calloc(channels, sizeof(struct adpcm_state));
+  batchStates = (struct adpcm_state *)calloc(channels, sizeof(struct adpcm_state));
+
+  for (c = 0; c < channels; c++) {
+    pcm[c] = (short *)malloc(frames*ADPCM_FRAME_SAMPLES*sizeof(short));
+    codes[c] = (char *)malloc(frames*ADPCM_FRAME_BYTES);
+    batchCodes[c] = (char *)malloc(frames*ADPCM_FRAME_BYTES);
+    decoded[c] = (short *)malloc(frames*ADPCM_FRAME_SAMPLES*sizeof(short));
+    batchDecoded[c] = (short *)malloc(frames*ADPCM_FRAME_SAMPLES*sizeof(short));
+    Synthesise(pcm[c], frames*ADPCM_FRAME_SAMPLES, c);
+  }
+
+  printf("%d channels of %d frames\n", channels, frames);
+
+  /* The single channel coders, each channel in turn */
+  start = Seconds();
+  for (c = 0; c < channels; c++) {
+    for (i = 0; i < frames; i++)
+      adpcm_coder(pcm[c] + i*ADPCM_FRAME_SAMPLES, codes[c] + i*ADPCM_FRAME_BYTES,
+                  ADPCM_FRAME_SAMPLES, &states[c]);
+  }
+  single[0] = Seconds() - start;
+
+  start = Seconds();
+  for (c = 0; c < channels; c++) {
+    for (i = 0; i < frames; i++)
+      adpcm_decoder(codes[c] + i*ADPCM_FRAME_BYTES, decoded[c] + i*ADPCM_FRAME_SAMPLES,
+                    ADPCM_FRAME_BYTES);
+  }
+  single[1] = Seconds() - start;
+
+  /* A frame of all channels together, as a server would */
+  start = Seconds();
+  for (i = 0; i < frames; i++) {
+    struct adpcm_state * state[256];
+    const short * in[256];
+    char * out[256];
+    int first;
+    for (first = 0; first < channels; first += 256) {
+      int count = channels - first < 256 ? channels - first : 256;
+      for (c = 0; c < count; c++) {
+        state[c] = &batchStates[first+c];
+        in[c] = pcm[first+c] + i*ADPCM_FRAME_SAMPLES;
+        out[c] = batchCodes[first+c] + i*ADPCM_FRAME_BYTES;
+      }
+      adpcm_coder_channels(count, state, in, out);
+    }
+  }
+  batch[0] = Seconds() - start;
+
+  for (c = 0; c < channels && !mismatch; c++)
+    mismatch = memcmp(codes[c], batchCodes[c], frames*ADPCM_FRAME_BYTES) != 0 ||
+               memcmp(&states[c], &batchStates[c], sizeof(struct adpcm_state)) != 0;
+
+  start = Seconds();
+  for (i = 0; i < frames; i++) {
+    const char * in[256];
+    short * out[256];
+    int first;
+    for (first = 0; first < channels; first += 256) {
+      int count = channels - first < 256 ? channels - first : 256;
+      for (c = 0; c < count; c++) {
+        in[c] = codes[first+c] + i*ADPCM_FRAME_BYTES;
+        out[c] = batchDecoded[first+c] + i*ADPCM_FRAME_SAMPLES;
+      }
+      adpcm_decoder_channels(count, in, out);
+    }
+  }
+  batch[1] = Seconds() - start;
+
+  for (c = 0; c < channels && !mismatch; c++)
+    mismatch = memcmp(decoded[c], batchDecoded[c], frames*ADPCM_FRAME_SAMPLES*sizeof(short)) != 0;
+
+  printf("encode %6.2f ms x%.2f, decode %6.2f ms x%.2f per channel second  %s\n",
+         batch[0]*1e3*SAMPLE_RATE/((double)channels*frames*ADPCM_FRAME_SAMPLES), single[0]/batch[0],
+         batch[1]*1e3*SAMPLE_RATE/((double)channels*frames*ADPCM_FRAME_SAMPLES), single[1]/batch[1],
+         mismatch ? "MISMATCH" : "bit exact");
+  if (mismatch)
+    failed = 1;
+
+  for (c = 0; c < channels; c++) {
+    free(pcm[c]);
+    free(codes[c]);
+    free(batchCodes[c]);
+    free(decoded[c]);
+    free(batchDecoded[c]);
+  }
+  free(pcm);
+  free(codes);
+  free(batchCodes);
+  free(decoded);
+  free(batchDecoded);
+  free(states);
+  free(batchStates);
+  return failed;
+}
@@ -316,10 +316,34 @@ static int encoder_set_options (const struct PluginCodec_Definition * defn,
   return 1;
 }
 
+static int encoder_set_complexity (const struct PluginCodec_Definition * defn,
+                                                                void * context, 
+                                                          const char * name,
+                                                                void * parm,
+                                                            unsigned * parmLen)
+{
+  struct SILKEncoderControl * ctxt =  (struct SILKEncoderControl *)context;
+
+  if (ctxt == NULL || parm == NULL || parmLen == NULL || *parmLen != sizeof(int))
+    return -1;
+
+  /* SILK has three levels, 0 to 2, for 0 to 10 */
+  int complexity = *(int *)parm;
+  if (complexity < 4)
+    ctxt->control.complexity = 0;
+  else if (complexity < 8)
+    ctxt->control.complexity = 1;
+  else
+    ctxt->control.complexity = 2;
+
+  return 1;
+}
+
 static struct PluginCodec_ControlDefn SILKEncodeControls[] =
 {
   { PLUGINCODEC_CONTROL_GET_CODEC_OPTIONS, get_codec_options },
   { PLUGINCODEC_CONTROL_SET_CODEC_OPTIONS, encoder_set_options },
+  { PLUGINCODEC_CONTROL_SET_COMPLEXITY,    encoder_set_complexity },
   { NULL }
 };
 
@@ -302,6 +302,28 @@ static int encoder_set_vbr(
   return speex_encoder_ctl(context->coderState, SPEEX_SET_VBR, parm);
 }
 
+static int encoder_set_complexity(
+      const PluginCodec_Definition * codec, 
+      void * _context, 
+      const char * , 
+      void * parm, 
+      unsigned * parmLen)
+{
+  if (_context == NULL || parm == NULL || parmLen == NULL || *parmLen != sizeof(int))
+    return -1;
+
+  struct PluginSpeexContext * context = (struct PluginSpeexContext *)_context;
+
+  // Speex goes from 1 to 10
+  int complexity = *(int *)parm;
+  if (complexity < 1)
+    complexity = 1;
+  else if (complexity > 10)
+    complexity = 10;
+
+  return speex_encoder_ctl(context->coderState, SPEEX_SET_COMPLEXITY, &complexity) == 0 ? 1 : 0;
+}
+
 static int decoder_set_vbr(
       const PluginCodec_Definition * codec, 
       void * _context, 
@@ -317,16 +339,60 @@ static int decoder_set_vbr(
   return speex_decoder_ctl(context->coderState, SPEEX_SET_VBR, parm);
 }
 
+static int encoder_reset(
+      const PluginCodec_Definition * codec, 
+      void * _context, 
+      const char * , 
+      void * , 
+      unsigned * )
+{
+  if (_context == NULL)
+    return 0;
+
+  struct PluginSpeexContext * context = (struct PluginSpeexContext *)_context;
+
+  // back to the state create_encoder() leaves it in
+  int mode = (int)(long)(codec->userData);
+  int vbr = 0;
+  speex_encoder_ctl(context->coderState, SPEEX_RESET_STATE, NULL);
+  speex_encoder_ctl(context->coderState, SPEEX_SET_VBR,     &vbr);
+  speex_encoder_ctl(context->coderState, SPEEX_SET_QUALITY, &mode);
+  return 1;
+}
+
+static int decoder_reset(
+      const PluginCodec_Definition * , 
+      void * _context, 
+      const char * , 
+      void * , 
+      unsigned * )
+{
+  if (_context == NULL)
+    return 0;
+
+  struct PluginSpeexContext * context = (struct PluginSpeexContext *)_context;
+
+  // back to the state create_decoder() leaves it in
+  int vbr = 0;
+  int enh = 1;
+  speex_decoder_ctl(context->coderState, SPEEX_RESET_STATE, NULL);
+  speex_decoder_ctl(context->coderState, SPEEX_SET_VBR,     &vbr);
+  speex_decoder_ctl(context->coderState, SPEEX_SET_ENH,     &enh);
+  return 1;
+}
+
 static PluginCodec_ControlDefn sipDecoderControls[] = {
   { "valid_for_protocol",       valid_for_sip },
   { "get_codec_options",        coder_get_sip_options },
   { "set_vbr",                  decoder_set_vbr },
+  { "reset_codec",              decoder_reset },
   { NULL }
 };
 
 static PluginCodec_ControlDefn h323DecoderControls[] = {
   { "valid_for_protocol",       valid_for_h323 },
   { "set_vbr",                  decoder_set_vbr },
+  { "reset_codec",              decoder_reset },
   { NULL }
 };
 
@@ -334,12 +400,16 @@ static PluginCodec_ControlDefn sipEncoderControls[] = {
   { "valid_for_protocol",       valid_for_sip },
   { "get_codec_options",        coder_get_sip_options },
   { "set_vbr",                  encoder_set_vbr },
+  { "set_complexity",           encoder_set_complexity },
+  { "reset_codec",              encoder_reset },
   { NULL }
 };
 
 static PluginCodec_ControlDefn h323EncoderControls[] = {
   { "valid_for_protocol",       valid_for_h323 },
   { "set_vbr",                  encoder_set_vbr },
+  { "set_complexity",           encoder_set_complexity },
+  { "reset_codec",              encoder_reset },
   { NULL }
 };
 
@@ -181,24 +181,32 @@ static int codec_encoder(const struct PluginCodec_Definition * codec,
                                        unsigned * toLen,
                                    unsigned int * flag)
 {
+  unsigned frames, i;
+
   if (*fromLen < SAMPLES_PER_FRAME*2 || *toLen < BYTES_PER_FRAME)
     return 0;
 
+  // Without VAD every frame is the same length, so take all that fit
+  frames = *fromLen/(SAMPLES_PER_FRAME*2);
+  if (frames > *toLen/BYTES_PER_FRAME)
+    frames = *toLen/BYTES_PER_FRAME;
+
+  for (i = 0; i < frames; i++) {
 #ifdef _WIN32_WCE
-  {
     UWord8 buffer[BYTES_PER_FRAME+1];
-    if (E_IF_g729ab_encode(context, (Word16 *)from, buffer, toLen, 0) != 0)
+    unsigned len = BYTES_PER_FRAME+1;
+    if (E_IF_g729ab_encode(context, (Word16 *)from, buffer, &len, 0) != 0)
       return 0;
     memcpy(to, &buffer[1], BYTES_PER_FRAME);
-  }
 #else
-
-  va_g729a_encoder((short *)from, (unsigned char *)to);
-
+    va_g729a_encoder((short *)from, (unsigned char *)to);
 #endif
+    from = ((const short *)from) + SAMPLES_PER_FRAME;
+    to   = ((unsigned char *)to) + BYTES_PER_FRAME;
+  }
 
-  *fromLen = SAMPLES_PER_FRAME*2;
-  *toLen   = BYTES_PER_FRAME;
+  *fromLen = frames*SAMPLES_PER_FRAME*2;
+  *toLen   = frames*BYTES_PER_FRAME;
 
   return 1; 
 }
@@ -250,25 +258,31 @@ static int codec_decoder(const struct PluginCodec_Definition * codec,
                                        unsigned * toLen,
                                    unsigned int * flag)
 {
+  unsigned frames, i;
+
   if (*fromLen < BYTES_PER_FRAME || *toLen < SAMPLES_PER_FRAME*2)
     return 0;
 
+  frames = *fromLen/BYTES_PER_FRAME;
+  if (frames > *toLen/(SAMPLES_PER_FRAME*2))
+    frames = *toLen/(SAMPLES_PER_FRAME*2);
+
+  for (i = 0; i < frames; i++) {
 #ifdef _WIN32_WCE
-  {
     UWord8 buffer[BYTES_PER_FRAME+1];
     buffer[0] = 2;
     memcpy(&buffer[1], from, BYTES_PER_FRAME);
     if (D_IF_g729ab_decode(context, buffer, (Word16 *)to, 0) != 0)
       return 0;
-  }
 #else
-
-  va_g729a_decoder((unsigned char *)from, (short *)to, 0);
-
+    va_g729a_decoder((unsigned char *)from, (short *)to, 0);
 #endif
+    from = ((const unsigned char *)from) + BYTES_PER_FRAME;
+    to   = ((short *)to) + SAMPLES_PER_FRAME;
+  }
 
-  *fromLen = BYTES_PER_FRAME;
-  *toLen = SAMPLES_PER_FRAME*2;
+  *fromLen = frames*BYTES_PER_FRAME;
+  *toLen   = frames*SAMPLES_PER_FRAME*2;
 
   return 1;
 }
@@ -482,7 +496,8 @@ static struct PluginCodec_Definition CodecDefn[] =
     PluginCodec_MediaTypeAudio |        // audio codec
     PluginCodec_InputTypeRaw |          // raw input data
     PluginCodec_OutputTypeRaw |         // raw output data
-    PluginCodec_RTPTypeExplicit,        // explicit RTP type
+    PluginCodec_RTPTypeExplicit |       // explicit RTP type
+    PluginCodec_MultiFrame,             // a packet of frames a call
 
     g729Descr,                          // text decription
     L16Desc,
@@ -517,7 +532,8 @@ static struct PluginCodec_Definition CodecDefn[] =
     PluginCodec_MediaTypeAudio |        // audio codec
     PluginCodec_InputTypeRaw |          // raw input data
     PluginCodec_OutputTypeRaw |         // raw output data
-    PluginCodec_RTPTypeExplicit,        // explicit RTP type
+    PluginCodec_RTPTypeExplicit |       // explicit RTP type
+    PluginCodec_MultiFrame,             // a packet of frames a call
 
     g729Descr,                          // text decription
     g729MediaFmt,
@@ -552,7 +568,8 @@ static struct PluginCodec_Definition CodecDefn[] =
     PluginCodec_MediaTypeAudio |        // audio codec
     PluginCodec_InputTypeRaw |          // raw input data
     PluginCodec_OutputTypeRaw |         // raw output data
-    PluginCodec_RTPTypeExplicit,        // explicit RTP type
+    PluginCodec_RTPTypeExplicit |       // explicit RTP type
+    PluginCodec_MultiFrame,             // a packet of frames a call
 
     g729ADescr,                         // text decription
     L16Desc,
@@ -587,7 +604,8 @@ static struct PluginCodec_Definition CodecDefn[] =
     PluginCodec_MediaTypeAudio |        // audio codec
     PluginCodec_InputTypeRaw |          // raw input data
     PluginCodec_OutputTypeRaw |         // raw output data
-    PluginCodec_RTPTypeExplicit,        // explicit RTP type
+    PluginCodec_RTPTypeExplicit |       // explicit RTP type
+    PluginCodec_MultiFrame,             // a packet of frames a call
 
     g729ADescr,                         // text decription
     g729AMediaFmt,
@@ -270,6 +270,27 @@ static int set_codec_options(const struct PluginCodec_Definition * defn,
 }
 
 
+static int reset_codec(const struct PluginCodec_Definition * defn,
+                                                      void * context,
+                                                const char * name, 
+                                                      void * parm, 
+                                                  unsigned * parmLen)
+{
+  unsigned mode = defn->bitsPerSec != BITRATE_30MS ? 20 : 30;
+
+  if (context == NULL)
+    return 0;
+
+  /* back to the state create_encoder() or create_decoder() leaves it in */
+  if (defn->destFormat[0] == 'L')
+    initDecode(context, mode, 0);
+  else
+    initEncode(context, mode);
+
+  return 1;
+}
+
+
 static int to_normalised_options(const struct PluginCodec_Definition * defn,
                                                                 void * context,
                                                           const char * name, 
@@ -334,6 +355,7 @@ static int free_codec_options(const struct PluginCodec_Definition * defn,
 static struct PluginCodec_ControlDefn h323CoderControls[] = {
   { PLUGINCODEC_CONTROL_VALID_FOR_PROTOCOL, valid_for_h323 },
   { PLUGINCODEC_CONTROL_SET_CODEC_OPTIONS,  set_codec_options },
+  { PLUGINCODEC_CONTROL_RESET_CODEC,        reset_codec },
   { NULL }
 };
 
@@ -342,6 +364,7 @@ static struct PluginCodec_ControlDefn h323AndSIPCoderControls[] = {
   { PLUGINCODEC_CONTROL_FREE_CODEC_OPTIONS,    free_codec_options },
   { PLUGINCODEC_CONTROL_SET_CODEC_OPTIONS,     set_codec_options },
   { PLUGINCODEC_CONTROL_GET_CODEC_OPTIONS,     get_codec_options },
+  { PLUGINCODEC_CONTROL_RESET_CODEC,           reset_codec },
   { NULL }
 };
 
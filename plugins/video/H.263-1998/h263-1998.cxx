@@ -405,6 +405,13 @@ void H263_Base_EncoderContext::SetTSTO (unsigned tsto)
   CODEC_TRACER(tracer, "TSTO set to " << tsto);
 }
 
+void H263_Base_EncoderContext::SetEncodingThreads (unsigned threads)
+{
+  // the RFC2190 packetizer relies on the macroblock callbacks arriving in order
+  if (threads > 1)
+    TRACE_AND_LOG(tracer, 4, "Threaded encoding not supported, using one thread");
+}
+
 void H263_Base_EncoderContext::EnableAnnex (Annex annex)
 {
   switch (annex) {
@@ -882,6 +889,13 @@ void H263_RFC2429_EncoderContext::SetMaxRTPFrameSize (unsigned size)
   _txH263PFrame->SetMaxPayloadSize((uint16_t)size);
 }
 
+void H263_RFC2429_EncoderContext::SetEncodingThreads (unsigned threads)
+{
+  // libavcodec splits the picture into one slice per thread
+  _context->thread_count = threads > 0 ? threads : 1;
+  CODEC_TRACER(tracer, "thread_count set to " << _context->thread_count);
+}
+
 
 int H263_RFC2429_EncoderContext::EncodeFrames(const BYTE * src, unsigned & srcLen, BYTE * dst, unsigned & dstLen, unsigned int & flags)
 {
@@ -1423,10 +1437,25 @@ static int valid_for_protocol ( const struct PluginCodec_Definition *, void *, c
 
 /////////////////////////////////////////////////////////////////////////////
 
+// With PTLIB_CODEC_LAZY_LOAD set libavcodec is loaded by the first codec
+// created rather than when the plugin is loaded, Load() only does it once
+static bool LoadFFMPEGLibrary()
+{
+  if (!FFMPEGLibraryInstance.Load())
+    return false;
+
+  FFMPEGLibraryInstance.AvLogSetLevel(AV_LOG_DEBUG);
+  FFMPEGLibraryInstance.AvLogSetCallback(&logCallbackFFMPEG);
+  return true;
+}
+
 static void * create_encoder(const struct PluginCodec_Definition * codec)
 {
   H263_Base_EncoderContext * context;
 
+  if (!LoadFFMPEGLibrary())
+    return NULL;
+
   if (codec->rtpPayload == RTP_RFC2190_PAYLOAD)
     context = new H263_RFC2190_EncoderContext();
   else
@@ -1704,6 +1733,8 @@ static int encoder_set_options(const PluginCodec_Definition *,
       context->SetMaxKeyFramePeriod (atoi(option[1]));
     if (STRCMPI(option[0], PLUGINCODEC_OPTION_TEMPORAL_SPATIAL_TRADE_OFF) == 0)
        context->SetTSTO (atoi(option[1]));
+    if (STRCMPI(option[0], PLUGINCODEC_OPTION_ENCODING_THREADS) == 0)
+       context->SetEncodingThreads (atoi(option[1]));
 
     if (STRCMPI(option[0], "Annex D") == 0) {
       if (atoi(option[1]) == 1) {
@@ -1828,6 +1859,9 @@ static int encoder_get_output_data_size(const PluginCodec_Definition *, void *,
 
 static void * create_decoder(const struct PluginCodec_Definition * codec)
 {
+  if (!LoadFFMPEGLibrary())
+    return NULL;
+
   if (codec->rtpPayload == RTP_RFC2190_PAYLOAD)
     return new H263_RFC2190_DecoderContext();
   else
@@ -2337,15 +2371,12 @@ extern "C" {
       Trace::SetLevelUserPlane(0);
     }
 
-  if (!FFMPEGLibraryInstance.Load()) {
+  if (getenv("PTLIB_CODEC_LAZY_LOAD") == NULL && !LoadFFMPEGLibrary()) {
     *count = 0;
     TRACE(1, "H.263\tCodec\tDisabled");
     return NULL;
   }
 
-  FFMPEGLibraryInstance.AvLogSetLevel(AV_LOG_DEBUG);
-  FFMPEGLibraryInstance.AvLogSetCallback(&logCallbackFFMPEG);
-
     if (version < PLUGIN_CODEC_VERSION_OPTIONS) {
       *count = 0;
       TRACE(1, "H.263\tCodec\tDisabled - plugin version mismatch");
@@ -136,6 +136,7 @@ class H263_Base_EncoderContext
     void SetFrameWidth (unsigned width);
     void SetFrameHeight (unsigned height);
     void SetTSTO (unsigned tsto);
+    virtual void SetEncodingThreads (unsigned threads);
     void EnableAnnex (Annex annex);
     void DisableAnnex (Annex annex);
     bool OpenCodec();
@@ -199,6 +200,7 @@ class H263_RFC2429_EncoderContext : public H263_Base_EncoderContext
     bool Open();
     bool InitContext();
     void SetMaxRTPFrameSize (unsigned size);
+    void SetEncodingThreads (unsigned threads);
     int EncodeFrames(const BYTE * src, unsigned & srcLen, BYTE * dst, unsigned & dstLen, unsigned int & flags);
   protected:
     bool Init();
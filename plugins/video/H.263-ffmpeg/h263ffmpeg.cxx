@@ -1129,6 +1129,9 @@ int H263EncoderContext::EncodeFrames(const BYTE * src, unsigned & srcLen, BYTE *
 
 static void * create_encoder(const struct PluginCodec_Definition * /*codec*/)
 {
+  // loaded here rather than with the plugin when PTLIB_CODEC_LAZY_LOAD is set
+  if (!FFMPEGLibraryInstance.Load())
+    return NULL;
   return new H263EncoderContext;
 }
 
@@ -1423,6 +1426,8 @@ bool H263DecoderContext::DecodeFrames(const BYTE * src, unsigned & srcLen, BYTE
 
 static void * create_decoder(const struct PluginCodec_Definition *)
 {
+  if (!FFMPEGLibraryInstance.Load())
+    return NULL;
   return new H263DecoderContext;
 }
 
@@ -2296,7 +2301,8 @@ extern "C" {
   PLUGIN_CODEC_DLL_API struct PluginCodec_Definition * PLUGIN_CODEC_GET_CODEC_FN(unsigned * count, unsigned version)
   {
     // check version numbers etc
-    if (version < PLUGIN_CODEC_VERSION_OPTIONS || !FFMPEGLibraryInstance.Load()) {
+    if (version < PLUGIN_CODEC_VERSION_OPTIONS ||
+        (::getenv("PTLIB_CODEC_LAZY_LOAD") == NULL && !FFMPEGLibraryInstance.Load())) {
       *count = 0;
       return NULL;
     }
@@ -71,7 +71,8 @@ static void logCallbackX264 (void * /*priv*/, int level, const char *fmt, va_lis
 
 X264EncoderContext::X264EncoderContext()
 : _codec(NULL), _txH264Frame(NULL), _PFramesSinceLastIFrame(0),
-  _IFrameInterval(0), _frameCounter(0), _fastUpdateRequested(false)
+  _IFrameInterval(0), _frameCounter(0), _fastUpdateRequested(false),
+  _intraRefresh(false)
 {
     Initialise();
 }
@@ -103,7 +104,7 @@ bool X264EncoderContext::Initialise()
  
    X264_PARAM_DEFAULT(&_context);
 
-   // No multicore support
+   // One thread unless SetEncodingThreads() is called
    _context.i_threads           = 1;
    _context.b_sliced_threads    = 1;
    _context.b_deterministic     = 1;
@@ -121,6 +122,7 @@ bool X264EncoderContext::Initialise()
   // No automatic keyframe generation
   _context.i_keyint_max               = 90; // X264_KEYINT_MAX_INFINITE;
   _context.i_keyint_min               = 15; // X264_KEYINT_MAX_INFINITE;
+  _context.b_intra_refresh            = _intraRefresh;
 #endif
 
   // Enable logging
@@ -206,11 +208,13 @@ void X264EncoderContext::Uninitialise()
 {
   if (_codec != NULL)
   {
+      if (_txH264Frame) _txH264Frame->KeepPendingNALs();
       X264_ENCODER_CLOSE(_codec);
       TRACE(4, "H264\tEncoder\tClosed H.264 encoder, encoded " << _frameCounter << " Frames" );
       _codec = NULL;
   }
   if (_txH264Frame) delete _txH264Frame;
+  _txH264Frame = NULL;
 }
 
 void X264EncoderContext::SetMaxRTPFrameSize(unsigned size)
@@ -299,8 +303,11 @@ void X264EncoderContext::ApplyOptions()
 #if X264_DELAYLOAD
   return;  // We apply options when we do our first encode
 #else
-  if (_codec != NULL)
+  if (_codec != NULL) {
+    // The packets of the last frame may still be being sent
+    _txH264Frame->KeepPendingNALs();
     X264_ENCODER_CLOSE(_codec);
+  }
 
   _codec = X264_ENCODER_OPEN(&_context);
   if (_codec == NULL) {
@@ -322,6 +329,26 @@ void X264EncoderContext::SetMaxNALSize (unsigned size)
   _context.i_slice_max_size  = size;
 }
 
+void X264EncoderContext::SetEncodingThreads (unsigned threads)
+{
+  // sliced threads split each picture, so no frames of latency are added
+  _context.i_threads = threads > 0 ? threads : 1;
+  TRACE(4, "H264\tEncoder\tx264 encoder threads set to " << _context.i_threads);
+}
+
+void X264EncoderContext::SetIntraRefresh (bool enable)
+{
+#if X264_BUILD > 101
+  // a column of intra macroblocks sweeps the picture each key frame period,
+  // so the periodic key frames and fast updates cost no bitrate spike
+  _intraRefresh = enable;
+  _context.b_intra_refresh = enable ? 1 : 0;
+  TRACE(4, "H264\tEncoder\tx264 encoder intra refresh " << (enable ? "enabled" : "disabled"));
+#else
+  TRACE(2, "H264\tEncoder\tx264 build " << X264_BUILD << " has no intra refresh");
+#endif
+}
+
 int X264EncoderContext::EncodeFrames(const unsigned char * src, unsigned & srcLen, unsigned char * dst, unsigned & dstLen, unsigned int & flags)
 {
 
@@ -371,8 +398,10 @@ int X264EncoderContext::EncodeFrames(const unsigned char * src, unsigned & srcLe
   // if the incoming data has changed size, tell the encoder
   if (!_codec || (unsigned)_context.i_width != header->width || (unsigned)_context.i_height != header->height)
   {
-    if (_codec)
+    if (_codec) {
+        _txH264Frame->KeepPendingNALs();
         X264_ENCODER_CLOSE(_codec);
+    }
     _context.i_width = header->width;
     _context.i_height = header->height;
     _codec = X264_ENCODER_OPEN(&_context);
@@ -410,7 +439,15 @@ int X264EncoderContext::EncodeFrames(const unsigned char * src, unsigned & srcLe
   _inputFrame.img.i_stride[1] = 
   _inputFrame.img.i_stride[2] = (int) ( header->width / 2 );
   _inputFrame.img.plane[2] = (uint8_t *)(_inputFrame.img.plane[1] + (int)(_inputFrame.img.i_stride[1] *header->height/2));
-  _inputFrame.i_type = (wantIFrame || (flags & forceIFrame)) ? X264_TYPE_IDR : X264_TYPE_AUTO;
+  wantIFrame = wantIFrame || (flags & forceIFrame);
+#if X264_BUILD > 101
+  // Only the first frame must be an IDR, after that a refresh wave stands in
+  if (wantIFrame && _intraRefresh && _frameCounter > 0) {
+    X264_ENCODER_INTRA_REFRESH(_codec);
+    wantIFrame = false;
+  }
+#endif
+  _inputFrame.i_type = wantIFrame ? X264_TYPE_IDR : X264_TYPE_AUTO;
   _inputFrame.i_pts = _frameCounter;	// x264 needs a time reference
 
 #if X264_BUILD > 79
@@ -81,6 +81,9 @@ extern "C" {
   #if X264_BUILD >= 98
   #define X264_PICTURE_INIT x264_picture_init
   #endif
+  #if X264_BUILD > 101
+  #define X264_ENCODER_INTRA_REFRESH x264_encoder_intra_refresh
+  #endif
 #else
 #if defined(_WIN32) 
   #include "x264loader_win32.h"
@@ -97,6 +100,9 @@ extern "C" {
   #if X264_BUILD >= 98
   #define X264_PICTURE_INIT X264Lib.Xx264_picture_init
   #endif
+  #if X264_BUILD > 101
+  #define X264_ENCODER_INTRA_REFRESH X264Lib.Xx264_encoder_intra_refresh
+  #endif
 #endif
 
 class X264EncoderContext 
@@ -121,6 +127,8 @@ class X264EncoderContext
     void SetTSTO (unsigned tsto);
     void SetProfileLevel (unsigned profileLevel);
     void SetMaxNALSize (unsigned size);
+    void SetEncodingThreads (unsigned threads);
+    void SetIntraRefresh (bool enable);
     void ApplyOptions ();
 
 
@@ -135,6 +143,7 @@ class X264EncoderContext
     uint32_t _IFrameInterval; // confd frames between keyframes
     int _frameCounter;
     bool _fastUpdateRequested;
+    bool _intraRefresh; // answer fast updates with a refresh wave, not an IDR
 
 } ;
 
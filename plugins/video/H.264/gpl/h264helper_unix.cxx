@@ -280,6 +280,26 @@ int main(int argc, char *argv[])
           TRACE (1, "H264\tIPC\tCodec not created, yet");
         }
       break;
+    case SET_ENCODING_THREADS:
+        readStream(dlStream, (char*)&val, sizeof(val));
+        if (x264) {
+          x264->SetEncodingThreads (val);
+          writeStream(ulStream,(char*)&msg, sizeof(msg)); 
+          flushStream(ulStream);
+        } else {
+          TRACE (1, "H264\tIPC\tCodec not created, yet");
+        }
+      break;
+    case SET_INTRA_REFRESH:
+        readStream(dlStream, (char*)&val, sizeof(val));
+        if (x264) {
+          x264->SetIntraRefresh (val != 0);
+          writeStream(ulStream,(char*)&msg, sizeof(msg)); 
+          flushStream(ulStream);
+        } else {
+          TRACE (1, "H264\tIPC\tCodec not created, yet");
+        }
+      break;
 	default:
       break;
     }
@@ -369,6 +369,26 @@ int main(int argc, char *argv[])
             TRACE (1, "H264\tIPC\tCodec not created, yet");
           }
         break;
+      case SET_ENCODING_THREADS:
+          readStream(stream, (LPVOID)&val, sizeof(val));
+          if (x264) {
+            x264->SetEncodingThreads (val);
+            writeStream(stream,(LPCVOID)&msg, sizeof(msg)); 
+            flushStream(stream);
+          } else {
+            TRACE (1, "H264\tIPC\tCodec not created, yet");
+          }
+        break;
+      case SET_INTRA_REFRESH:
+          readStream(stream, (LPVOID)&val, sizeof(val));
+          if (x264) {
+            x264->SetIntraRefresh (val != 0);
+            writeStream(stream,(LPCVOID)&msg, sizeof(msg)); 
+            flushStream(stream);
+          } else {
+            TRACE (1, "H264\tIPC\tCodec not created, yet");
+          }
+        break;
       default:
         break;
     }
@@ -40,6 +40,9 @@ X264Library::X264Library()
 #if X264_BUILD >= 98
   Xx264_picture_init = NULL;
 #endif
+#if X264_BUILD > 101
+  Xx264_encoder_intra_refresh = NULL;
+#endif
 }
 
 X264Library::~X264Library()
@@ -131,6 +134,13 @@ bool X264Library::Load()
   }
 #endif
 
+#if X264_BUILD > 101
+  if (!GetFunction("x264_encoder_intra_refresh", (Function &)Xx264_encoder_intra_refresh)) {
+    TRACE (1, "H264\tDYNA\tFailed to load x264_encoder_intra_refresh");
+    return false;
+  }
+#endif
+
   if (!GetFunction("x264_encoder_close", (Function &)Xx264_encoder_close)) {
     TRACE (1, "H264\tDYNA\tFailed to load x264_encoder_close");
     return false;
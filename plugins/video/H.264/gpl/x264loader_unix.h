@@ -49,6 +49,9 @@ class X264Library
 #if X264_BUILD >= 98
     void (*Xx264_picture_init)(x264_picture_t *pic);
 #endif
+#if X264_BUILD > 101
+    void (*Xx264_encoder_intra_refresh)(x264_t *);
+#endif
 
   protected:
     bool Open(const char *name);
@@ -48,7 +48,7 @@ bool X264Library::Load()
     return true;
    
   char dllName [512];
-  snprintf(dllName, sizeof(dllName), "libX264-%d.dll", X264_BUILD);
+  snprintf(dllName, sizeof(dllName), "libX264-%d.dll", X264_BUILD);
 
   if ( !Open(dllName))  {
     TRACE (1, "H264\tDYNA\tFailed to load x264 library - codec disabled");
@@ -121,6 +121,13 @@ bool X264Library::Load()
   }
 #endif
 
+#if X264_BUILD > 101
+  if (!GetFunction("x264_encoder_intra_refresh", (Function &)Xx264_encoder_intra_refresh)) {
+    TRACE (1, "H264\tDYNA\tFailed to load x264_encoder_intra_refresh");
+    return false;
+  }
+#endif
+
   if (!GetFunction("x264_encoder_close", (Function &)Xx264_encoder_close)) {
     TRACE (1, "H264\tDYNA\tFailed to load x264_encoder_close");
     return false;
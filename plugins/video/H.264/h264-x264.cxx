@@ -284,6 +284,16 @@ void H264EncoderContext::SetMaxNALSize(unsigned size)
        H264EncCtxInstance.call(SET_MAX_NALSIZE, size);
 }
 
+void H264EncoderContext::SetEncodingThreads(unsigned threads)
+{
+  H264EncCtxInstance.call(SET_ENCODING_THREADS, threads);
+}
+
+void H264EncoderContext::SetIntraRefresh(bool enable)
+{
+  H264EncCtxInstance.call(SET_INTRA_REFRESH, enable ? 1 : 0);
+}
+
 void H264EncoderContext::SetEmphasisSpeed(bool speed)
 {
     emphasisSpeed = speed;
@@ -312,21 +322,33 @@ H264DecoderContext::H264DecoderContext()
   _context = NULL;
   _outputFrame = NULL;
 
+  _outputFrame = FFMPEGLibraryInstance.AvcodecAllocFrame();
+  if (_outputFrame == NULL) {
+    TRACE(1, "H264\tDecoder\tFailed to allocate frame for encoder");
+    return;
+  }
+
+  // Hardware decoders first, any that fail to open fall back to software
+  unsigned position = 0;
+  while ((_codec = FFMPEGLibraryInstance.AvcodecFindHardwareDecoder(H264_HW_DECODERS, position)) != NULL) {
+    if (OpenDecoder())
+      return;
+  }
+
   if ((_codec = FFMPEGLibraryInstance.AvcodecFindDecoder(CODEC_ID_H264)) == NULL) {
     TRACE(1, "H264\tDecoder\tCodec not found for decoder");
     return;
   }
 
+  OpenDecoder();
+}
+
+bool H264DecoderContext::OpenDecoder()
+{
   _context = FFMPEGLibraryInstance.AvcodecAllocContext(_codec);
   if (_context == NULL) {
     TRACE(1, "H264\tDecoder\tFailed to allocate context for decoder");
-    return;
-  }
-
-  _outputFrame = FFMPEGLibraryInstance.AvcodecAllocFrame();
-  if (_outputFrame == NULL) {
-    TRACE(1, "H264\tDecoder\tFailed to allocate frame for encoder");
-    return;
+    return false;
   }
 
     _context->pix_fmt             = PIX_FMT_YUV420P;
@@ -351,13 +373,14 @@ H264DecoderContext::H264DecoderContext()
     _context->flags2              += CODEC_FLAG2_FAST;
 
   if (FFMPEGLibraryInstance.AvcodecOpen(_context, _codec) < 0) {
-    TRACE(1, "H264\tDecoder\tFailed to open H.264 decoder");
-    return;
-  }
-  else
-  {
-    TRACE(1, "H264\tDecoder\tDecoder successfully opened");
+    TRACE(1, "H264\tDecoder\tFailed to open H.264 decoder " << _codec->name);
+    FFMPEGLibraryInstance.AvcodecFree(_context);
+    _context = NULL;
+    return false;
   }
+
+  TRACE(1, "H264\tDecoder\tDecoder " << _codec->name << " successfully opened");
+  return true;
 }
 
 H264DecoderContext::~H264DecoderContext()
@@ -381,7 +404,7 @@ H264DecoderContext::~H264DecoderContext()
 
 int H264DecoderContext::DecodeFrames(const u_char * src, unsigned & srcLen, u_char * dst, unsigned & dstLen, unsigned int & flags)
 {
-  if (!FFMPEGLibraryInstance.IsLoaded()) return 0;
+  if (!FFMPEGLibraryInstance.IsLoaded() || _context == NULL) return 0;
 
   // create RTP frame from source buffer
   RTPFrame srcRTP(src, srcLen);
@@ -478,7 +501,24 @@ int H264DecoderContext::DecodeFrames(const u_char * src, unsigned & srcLen, u_ch
   header->height = _context->height;
 
   int size = _context->width * _context->height;
-  if (_outputFrame->data[1] == _outputFrame->data[0] + size
+  if (_context->pix_fmt == PIX_FMT_NV12)
+  {
+    // hardware decoders return interleaved chroma
+    unsigned char *dstData = OPAL_VIDEO_FRAME_DATA_PTR(header);
+    for (int y = 0; y < _context->height; y++)
+      memcpy(dstData + y*_context->width, _outputFrame->data[0] + y*_outputFrame->linesize[0], _context->width);
+
+    unsigned char *dstU = dstData + size;
+    unsigned char *dstV = dstU + (size >> 2);
+    for (int y = 0; y < _context->height >> 1; y++) {
+      const unsigned char *srcUV = _outputFrame->data[1] + y*_outputFrame->linesize[1];
+      for (int x = 0; x < _context->width >> 1; x++) {
+        *dstU++ = *srcUV++;
+        *dstV++ = *srcUV++;
+      }
+    }
+  }
+  else if (_outputFrame->data[1] == _outputFrame->data[0] + size
       && _outputFrame->data[2] == _outputFrame->data[1] + (size >> 2))
   {
     memcpy(OPAL_VIDEO_FRAME_DATA_PTR(header), _outputFrame->data[0], frameBytes);
@@ -851,9 +891,25 @@ static int adjust_to_BitRate (unsigned & width, unsigned & height, unsigned & fr
 
 #endif  // _SIGNAL_ONLY
 
+#ifndef _SIGNAL_ONLY
+// With PTLIB_CODEC_LAZY_LOAD set libavcodec is loaded by the first codec
+// created rather than when the plugin is loaded, Load() only does it once
+static bool LoadFFMPEGLibrary()
+{
+  if (!FFMPEGLibraryInstance.Load())
+    return false;
+
+  FFMPEGLibraryInstance.AvLogSetLevel(AV_LOG_DEBUG);
+  FFMPEGLibraryInstance.AvLogSetCallback(&logCallbackFFMPEG);
+  return true;
+}
+#endif  // _SIGNAL_ONLY
+
 static void * create_encoder(const struct PluginCodec_Definition * /*codec*/)
 {
 #ifndef _SIGNAL_ONLY
+  if (!LoadFFMPEGLibrary())
+    return NULL;
   return new H264EncoderContext;
 #else
   return NULL;
@@ -1217,6 +1273,10 @@ static int encoder_set_options(
          context->SetTSTO (atoi(options[i+1]));
       if (STRCMPI(options[i], PLUGINCODEC_OPTION_EMPHASIS_SPEED) == 0)  
          context->SetEmphasisSpeed(atoi(options[i+1]));
+      if (STRCMPI(options[i], PLUGINCODEC_OPTION_ENCODING_THREADS) == 0)
+         context->SetEncodingThreads(atoi(options[i+1]));
+      if (STRCMPI(options[i], PLUGINCODEC_OPTION_INTRA_REFRESH) == 0)
+         context->SetIntraRefresh(atoi(options[i+1]) != 0);
       if (STRCMPI(options[i], PLUGINCODEC_OPTION_MAX_PAYLOAD) == 0)
           if (!maxNALSize || maxNALSize > (unsigned)atoi(options[i+1])) {
                 maxNALSize = atoi(options[i+1]);
@@ -1355,6 +1415,8 @@ static int encoder_get_output_data_size(const PluginCodec_Definition *, void *,
 static void * create_decoder(const struct PluginCodec_Definition *)
 {
 #ifndef _SIGNAL_ONLY
+  if (!LoadFFMPEGLibrary())
+    return NULL;
   return new H264DecoderContext;
 #else
   return NULL;
@@ -1521,15 +1583,12 @@ PLUGIN_CODEC_DLL_API struct PluginCodec_Definition * PLUGIN_CODEC_GET_CODEC_FN(u
     Trace::SetLevelUserPlane(0);
   }
 
-  if (!FFMPEGLibraryInstance.Load()) {
+  if (getenv("PTLIB_CODEC_LAZY_LOAD") == NULL && !LoadFFMPEGLibrary()) {
     *count = 0;
     TRACE(1, "H264\tCodec\tDisabled");
     return NULL;
   }
 
-  FFMPEGLibraryInstance.AvLogSetLevel(AV_LOG_DEBUG);
-  FFMPEGLibraryInstance.AvLogSetCallback(&logCallbackFFMPEG);
-
 #endif  // _SIGNAL_ONLY
 
   if (version < PLUGIN_CODEC_VERSION_OPTIONS) {
@@ -55,7 +55,7 @@
 
 #include "shared/h264frame.h"
 
-#if defined(H323_STATIC_H264)
+#if defined(H323_STATIC_H264) || defined(H264_INPROCESS_ENCODER)
 #include "h264pipe_static.h" 
 #else
 #ifdef WIN32
@@ -110,6 +110,9 @@ struct inputFormats
   unsigned r;
 };
 
+// libavcodec hardware decoders tried, in order, before the software decoder
+#define H264_HW_DECODERS "h264_cuvid,h264_qsv,h264_v4l2m2m,h264_mmal"
+
     // Settings
 static double minFPS   = 13.5;       // Minimum FPS allowed
 static double minSpeedFPS = 20;     // Minimum speed for Emphasis Speed
@@ -134,6 +137,8 @@ class H264EncoderContext
     void SetTSTO (unsigned tsto);
     void SetProfileLevel (unsigned profile, unsigned constraints, unsigned level);
     void SetMaxNALSize (unsigned size);
+    void SetEncodingThreads (unsigned threads);
+    void SetIntraRefresh (bool enable);
     void SetEmphasisSpeed (bool speed);
     void ApplyOptions ();
     void Lock ();
@@ -167,6 +172,8 @@ class H264DecoderContext
     int DecodeFrames(const u_char * src, unsigned & srcLen, u_char * dst, unsigned & dstLen, unsigned int & flags);
 
   protected:
+    bool OpenDecoder();
+
     CriticalSection _mutex;
 
     AVCodec* _codec;
@@ -37,17 +37,15 @@
  *
  */
 
-#ifdef _STATIC_LINK
+#if defined(_STATIC_LINK) || defined(H264_INPROCESS_ENCODER)
 #include "gpl/enc-ctx.h"
 
 #include "h264pipe_static.h"
 
 #include "../common/trace.h"
 
-X264EncoderContext H264EncCtx::x264;
-bool H264EncCtx::loaded=false;
-
 H264EncCtx::H264EncCtx()
+: x264(NULL), loaded(false)
 {
 
 }
@@ -67,14 +65,16 @@ bool H264EncCtx::InternalLoad()
    if (loaded)
        return true;
 
-   loaded = x264.Initialise();
+   x264 = new X264EncoderContext();
+   loaded = true;
    return loaded;
 }
 
 void H264EncCtx::InternalUnLoad()
 {
     if (loaded) {
-        x264.Uninitialise();
+        delete x264;
+        x264 = NULL;
         loaded =false;
     }
 }
@@ -90,7 +90,11 @@ void H264EncCtx::call(unsigned msg)
             break;
         case APPLY_OPTIONS:
             if (InternalLoad())
-                x264.ApplyOptions();
+                x264->ApplyOptions();
+            break;
+        case FASTUPDATE_REQUESTED:
+            if (InternalLoad())
+                x264->fastUpdateRequested();
             break;
         default:
             break;
@@ -104,22 +108,37 @@ void H264EncCtx::call(unsigned msg, unsigned value)
 
   switch (msg) {
     case SET_FRAME_WIDTH:
-        x264.SetFrameWidth(value);
+        x264->SetFrameWidth(value);
         break;
     case SET_FRAME_HEIGHT:
-        x264.SetFrameHeight(value);
+        x264->SetFrameHeight(value);
         break;
     case SET_FRAME_RATE:
-        x264.SetFrameRate(value);
+        x264->SetFrameRate(value);
         break;
     case SET_MAX_KEY_FRAME_PERIOD:
-        x264.SetMaxKeyFramePeriod(value);
+        x264->SetMaxKeyFramePeriod(value);
         break;
     case SET_TSTO:
-        x264.SetTSTO(value);
+        x264->SetTSTO(value);
         break;
     case SET_PROFILE_LEVEL:
-        x264.SetProfileLevel(value);
+        x264->SetProfileLevel(value);
+        break;
+    case SET_TARGET_BITRATE:
+        x264->SetTargetBitrate(value);
+        break;
+    case SET_MAX_FRAME_SIZE:
+        x264->SetMaxRTPFrameSize(value);
+        break;
+    case SET_MAX_NALSIZE:
+        x264->SetMaxNALSize(value);
+        break;
+    case SET_ENCODING_THREADS:
+        x264->SetEncodingThreads(value);
+        break;
+    case SET_INTRA_REFRESH:
+        x264->SetIntraRefresh(value != 0);
         break;
     default:
         break;
@@ -134,14 +153,14 @@ void H264EncCtx::call(unsigned msg , const u_char * src, unsigned & srcLen, u_ch
   switch (msg) {
     case ENCODE_FRAMES:
     case ENCODE_FRAMES_BUFFERED:
-        ret = x264.EncodeFrames( src,  srcLen, dst, dstLen, flags);
+        ret = x264->EncodeFrames( src,  srcLen, dst, dstLen, flags);
         break;
     default:
         break;
   } 
 }
 
-#endif // _STATIC_LINK
+#endif // _STATIC_LINK || H264_INPROCESS_ENCODER
 
 
 
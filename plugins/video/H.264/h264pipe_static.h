@@ -66,8 +66,9 @@ class H264EncCtx
      bool InternalLoad();
      void InternalUnLoad();
 
-     static X264EncoderContext x264;
-     static bool               loaded;
+     // one encoder per codec instance, created on first use
+     X264EncoderContext * x264;
+     bool                 loaded;
 
 };
 
@@ -26,7 +26,7 @@
  */
 
 
-#ifndef _STATIC_LINK
+#if !defined(_STATIC_LINK) && !defined(H264_INPROCESS_ENCODER)
 #include "h264pipe_win32.h"
 
 #ifdef _MSC_VER
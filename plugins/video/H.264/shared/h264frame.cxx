@@ -134,6 +134,11 @@ void H264Frame::SetMaxPayloadSize (uint16_t maxPayloadSize) {
 
 }
 
+// The NAL units are not copied, x264 keeps the payloads until the next
+// x264_encoder_encode(), which is not called until every RTP packet of the
+// frame has been taken by GetRTPFrame(). Each byte is then copied once,
+// into the RTP packet. An encoder closed before then, by new options or a
+// new frame size, must call KeepPendingNALs() first.
 void H264Frame::SetFromFrame (x264_nal_t *NALs, int numberOfNALs) {
   //int vopBufferLen;
   int currentNAL = 0;
@@ -144,9 +149,11 @@ void H264Frame::SetFromFrame (x264_nal_t *NALs, int numberOfNALs) {
       encodedNALS = _nalBuffer;
   }
 
-  uint8_t* currentPositionInFrame=(uint8_t*) _encodedFrame;
-  if (_NALs) free(_NALs);
-  _NALs = (h264_nal_t *)malloc(encodedNALS * sizeof(h264_nal_t));
+  if ((uint32_t)encodedNALS > _numberOfNALsReserved) {
+    if (_NALs) free(_NALs);
+    _NALs = (h264_nal_t *)malloc(encodedNALS * sizeof(h264_nal_t));
+    _numberOfNALsReserved = encodedNALS;
+  }
 
   _encodedFrameLen = 0;
   _numberOfNALsInFrame = 0;
@@ -159,19 +166,20 @@ void H264Frame::SetFromFrame (x264_nal_t *NALs, int numberOfNALs) {
     int currentNALLen;
 //   currentNALLen = X264_NAL_ENCODE(currentPositionInFrame, &vopBufferLen, 1, &NALs[currentNAL]);
     currentNALLen = NALs[currentNAL].i_payload;
-    memcpy(currentPositionInFrame,NALs[currentNAL].p_payload,currentNALLen);
+    const uint8_t* currentPositionInFrame = NALs[currentNAL].p_payload;
     if (currentNALLen > 0) 
     {
       _NALs[_numberOfNALsInFrame].length = currentNALLen;
       _NALs[_numberOfNALsInFrame].offset = _encodedFrameLen;
       _NALs[_numberOfNALsInFrame].type = NALs[currentNAL].i_type;
       uint32_t header = 0;
-      if (IsStartCode(currentPositionInFrame))
+      if (currentNALLen >= 4 && IsStartCode(currentPositionInFrame))
       {
 	header = currentPositionInFrame[2] == 1 ? 3 : 4;
       }
       _NALs[_numberOfNALsInFrame].length -= header;
       _NALs[_numberOfNALsInFrame].offset += header;
+      _NALs[_numberOfNALsInFrame].data = currentPositionInFrame + header;
       TRACE_UP(4, "H264\tEncap\tLoaded NAL unit #" << currentNAL << " - type " << NALs[currentNAL].i_type);
   //    TRACE (4, "H264\tEncap\tLoaded NAL unit #" << currentNAL << " - type " << NALs[currentNAL].i_type << " size " << currentNALLen );
 
@@ -188,7 +196,6 @@ void H264Frame::SetFromFrame (x264_nal_t *NALs, int numberOfNALs) {
 
       _numberOfNALsInFrame++;
       _encodedFrameLen += currentNALLen;
-      currentPositionInFrame += currentNALLen;
     } 
     else
     {
@@ -199,6 +206,42 @@ void H264Frame::SetFromFrame (x264_nal_t *NALs, int numberOfNALs) {
 }
 #endif
 
+void H264Frame::KeepPendingNALs ()
+{
+  if (_currentNAL >= _numberOfNALsInFrame)
+    return;
+
+  uint32_t pendingLen = 0;
+  uint32_t i;
+  for (i = _currentNAL; i < _numberOfNALsInFrame; i++)
+    pendingLen += _NALs[i].length;
+
+  if (pendingLen > MAX_FRAME_SIZE) {
+    TRACE(1, "H264\tENC\tPending NAL units of " << pendingLen << " bytes exceed the frame buffer, dropped");
+    _numberOfNALsInFrame = _currentNAL;
+    _currentNALFURemainingLen = 0;
+    _currentNALFURemainingDataPtr = NULL;
+    return;
+  }
+
+  // A fragmented NAL unit part sent goes on from the same place in the copy
+  uint32_t fuOffset = 0;
+  if (_currentNALFURemainingLen > 0 && _currentNALFURemainingDataPtr != NULL)
+    fuOffset = (uint32_t)(_currentNALFURemainingDataPtr - _NALs[_currentNAL].data);
+
+  uint32_t offset = 0;
+  for (i = _currentNAL; i < _numberOfNALsInFrame; i++) {
+    memcpy(_encodedFrame + offset, _NALs[i].data, _NALs[i].length);
+    _NALs[i].data = _encodedFrame + offset;
+    offset += _NALs[i].length;
+  }
+
+  if (_currentNALFURemainingDataPtr != NULL)
+    _currentNALFURemainingDataPtr = _NALs[_currentNAL].data + fuOffset;
+
+  TRACE_UP(4, "H264\tEncap\tKept " << (_numberOfNALsInFrame - _currentNAL) << " pending NAL units of " << pendingLen << " bytes");
+}
+
 bool H264Frame::GetRTPFrame(RTPFrame & frame, unsigned int & flags)
 {
   flags = 0;
@@ -206,7 +249,7 @@ bool H264Frame::GetRTPFrame(RTPFrame & frame, unsigned int & flags)
   if (_currentNAL < _numberOfNALsInFrame) 
   { 
     uint32_t curNALLen = _NALs[_currentNAL].length;
-    const uint8_t *curNALPtr = _encodedFrame + _NALs[_currentNAL].offset;
+    const uint8_t *curNALPtr = _NALs[_currentNAL].data;
     /*
      * We have 3 types of packets we can send:
      * fragmentation units - if the NAL is > max_payload_size
@@ -282,7 +325,7 @@ bool H264Frame::EncapsulateSTAP (RTPFrame & frame, unsigned int & flags) {
   uint8_t  maxNRI = 0;
   while (_currentNAL < highestNALNumberInSTAP) {
     curNALLen = _NALs[_currentNAL].length;
-    curNALPtr = _encodedFrame + _NALs[_currentNAL].offset;
+    curNALPtr = _NALs[_currentNAL].data;
 
     // store the nal length information
     frame.SetPayloadSize(frame.GetPayloadSize() + 2);
@@ -317,7 +360,7 @@ bool H264Frame::EncapsulateFU(RTPFrame & frame, unsigned int & flags) {
   if ((_currentNALFURemainingLen==0) || (_currentNALFURemainingDataPtr==NULL))
   {
     _currentNALFURemainingLen = _NALs[_currentNAL].length;
-    _currentNALFURemainingDataPtr = _encodedFrame + _NALs[_currentNAL].offset;
+    _currentNALFURemainingDataPtr = _NALs[_currentNAL].data;
     _currentNALFUHeader0 = (*_currentNALFURemainingDataPtr & 0x60) | 28;
     _currentNALFUHeader1 = *_currentNALFURemainingDataPtr & 0x1f;
     header[0] = _currentNALFUHeader0;
@@ -535,6 +578,7 @@ void H264Frame::AddDataToEncodedFrame (uint8_t *data, uint32_t dataLen, uint8_t
       _NALs[_numberOfNALsInFrame].offset = _encodedFrameLen + 4;
       _NALs[_numberOfNALsInFrame].length = dataLen + 1;
       _NALs[_numberOfNALsInFrame].type = header & 0x1f;
+      _NALs[_numberOfNALsInFrame].data = _encodedFrame + _encodedFrameLen + 4;
 
 
       _numberOfNALsInFrame++;
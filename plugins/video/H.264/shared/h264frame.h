@@ -173,6 +173,7 @@ typedef struct h264_nal_t
   uint32_t offset;
   uint32_t length;
   uint8_t  type;
+  const uint8_t * data;  // NAL unit without start code, in the encoder output when encoding
 } h264_nal_t;
 
 class H264Frame
@@ -185,6 +186,9 @@ public:
 #ifndef LICENCE_MPL
   void SetFromFrame (x264_nal_t *NALs, int numberOfNALs);
 #endif
+  // Copy the NAL units not yet packetized out of the encoder output, which
+  // is freed when the encoder is closed
+  void KeepPendingNALs ();
   void SetMaxPayloadSize (uint16_t maxPayloadSize);
   void SetTimestamp (uint64_t timestamp) 
   {
@@ -197,6 +201,8 @@ public:
   }
 
   bool SetFromRTPFrame (RTPFrame & frame, unsigned int & flags);
+  // The frame buffer holds received NAL units only, the NAL units to send
+  // are packetized straight from the encoder output
   uint8_t* GetFramePtr ()
   {
     return (_encodedFrame);
@@ -228,7 +234,7 @@ private:
   
   // for encapsulation
   uint32_t _currentNALFURemainingLen;
-  uint8_t* _currentNALFURemainingDataPtr;
+  const uint8_t* _currentNALFURemainingDataPtr;
   uint8_t  _currentNALFUHeader0;
   uint8_t  _currentNALFUHeader1;
 
@@ -48,6 +48,8 @@
 #define SET_PROFILE_LEVEL         13
 #define FASTUPDATE_REQUESTED	  14
 #define SET_MAX_NALSIZE           15
+#define SET_ENCODING_THREADS      16
+#define SET_INTRA_REFRESH         17
 
 
 #endif /* __PIPE_H__ */
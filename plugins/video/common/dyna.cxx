@@ -317,6 +317,11 @@ bool FFMPEGLibrary::Load(int ver)
     return false;
   }
 
+  if (!libAvcodec.GetFunction("avcodec_find_decoder_by_name", (DynaLink::Function &)Favcodec_find_decoder_by_name)) {
+    TRACE (1, _codecString << "\tDYNA\tFailed to load avcodec_find_decoder_by_name - hardware decoders disabled");
+    Favcodec_find_decoder_by_name = NULL;
+  }
+
 #if LIBAVCODEC_VERSION_MAJOR < 55
   if (!libAvcodec.GetFunction("avcodec_alloc_context", (DynaLink::Function &)Favcodec_alloc_context)) {
     TRACE (1, _codecString << "\tDYNA\tFailed to load avcodec_alloc_context");
@@ -498,6 +503,56 @@ AVCodec *FFMPEGLibrary::AvcodecFindDecoder(enum FF_CodecID id)
 #endif
 }
 
+AVCodec *FFMPEGLibrary::AvcodecFindDecoderByName(const char * name)
+{
+  WaitAndSignal m(processLock);
+
+#ifdef USE_DLL_AVCODEC
+  if (Favcodec_find_decoder_by_name == NULL)
+    return NULL;
+
+  WITH_ALIGNED_STACK({
+    AVCodec *res = Favcodec_find_decoder_by_name(name);
+    return res;
+  });
+#else
+    AVCodec *res = avcodec_find_decoder_by_name(name);
+    return res;
+#endif
+}
+
+AVCodec *FFMPEGLibrary::AvcodecFindHardwareDecoder(const char * names, unsigned & position)
+{
+  const char * env = ::getenv("PTLIB_CODECS_HWACCEL");
+  if (env != NULL)
+    names = env;
+
+  if (names == NULL || STRCMPI(names, "none") == 0)
+    return NULL;
+
+  size_t len = strlen(names);
+  while (position < len) {
+    const char * start = names + position;
+    const char * end = strchr(start, ',');
+    size_t nameLen = end != NULL ? (size_t)(end - start) : strlen(start);
+    position += (unsigned)nameLen + 1;
+
+    char name[64];
+    if (nameLen == 0 || nameLen >= sizeof(name))
+      continue;
+    memcpy(name, start, nameLen);
+    name[nameLen] = '\0';
+
+    AVCodec * codec = AvcodecFindDecoderByName(name);
+    if (codec != NULL) {
+      TRACE(4, _codecString << "\tDYNA\tFound hardware decoder " << name);
+      return codec;
+    }
+  }
+
+  return NULL;
+}
+
 AVCodecContext *FFMPEGLibrary::AvcodecAllocContext(AVCodec * codec)
 {
 
@@ -97,6 +97,10 @@ class FFMPEGLibrary
 
     AVCodec *AvcodecFindEncoder(enum FF_CodecID id);
     AVCodec *AvcodecFindDecoder(enum FF_CodecID id);
+    AVCodec *AvcodecFindDecoderByName(const char * name);
+    // Find the next available decoder in a comma separated list of names,
+    // starting at position. PTLIB_CODECS_HWACCEL overrides the list, "none" disables.
+    AVCodec *AvcodecFindHardwareDecoder(const char * names, unsigned & position);
     AVCodecContext *AvcodecAllocContext(AVCodec * codec = NULL);
     AVFrame *AvcodecAllocFrame(void);
     int AvcodecOpen(AVCodecContext *ctx, AVCodec *codec);
@@ -136,6 +140,7 @@ class FFMPEGLibrary
     void (*Favcodec_register)(AVCodec *format);
     AVCodec *(*Favcodec_find_encoder)(enum FF_CodecID id);
     AVCodec *(*Favcodec_find_decoder)(enum FF_CodecID id);
+    AVCodec *(*Favcodec_find_decoder_by_name)(const char * name);
 #if LIBAVCODEC_VERSION_MAJOR < 55
     AVCodecContext *(*Favcodec_alloc_context)(void);
 #else
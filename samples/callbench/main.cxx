@@ -0,0 +1,587 @@
+/*
+ * main.cxx
+ *
+ * H.323 call setup load generator and benchmark.
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#define H323_STATIC_LIB
+#endif
+
+#include "main.h"
+#include "../../version.h"
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#define new PNEW
+
+PCREATE_PROCESS(CallBenchProcess);
+
+
+// How long the generator waits for the last calls to clear
+#define DRAIN_TIMEOUT 30000
+
+// How often progress is shown, in milliseconds
+#define REPORT_INTERVAL 5000
+
+
+///////////////////////////////////////////////////////////////
+
+CallBenchProcess::CallBenchProcess()
+  : PProcess("H323Plus", "callbench", MAJOR_VERSION, MINOR_VERSION, BUILD_TYPE, BUILD_NUMBER)
+{
+  endpoint = NULL;
+}
+
+
+CallBenchProcess::~CallBenchProcess()
+{
+  delete endpoint;
+}
+
+
+void CallBenchProcess::Main()
+{
+  cout << GetName()
+       << " Version " << GetVersion(TRUE)
+       << " by " << GetManufacturer()
+       << " on " << GetOSClass() << ' ' << GetOSName()
+       << " (" << GetOSVersion() << '-' << GetOSHardware() << ")\n\n";
+
+  // Get and parse all of the command line arguments.
+  PArgList & args = GetArguments();
+  args.Parse(
+             "c-calls:"
+             "C-concurrent:"
+             "d-duration:"
+             "D-disable:"
+             "f-fast-enable."
+             "g-gatekeeper:"
+             "h-help."
+             "H-hold:"
+             "i-interface:"
+             "l-listen."
+#if PTRACING
+             "o-output:"
+#endif
+             "P-prefer:"
+             "p-password:"
+             "r-rate:"
+             "-rtp-ports:"
+             "T-h245tunneldisable."
+#ifdef H323_H235
+             "m-mediaenc:"
+#endif
+#if PTRACING
+             "t-trace."
+#endif
+             "x-listenport:"
+             "u-user:"
+          , FALSE);
+
+  if (args.HasOption('h') || (!args.HasOption('l') && args.GetCount() == 0)) {
+    cout << "Usage : " << GetName() << " [options] -l                 (answerer)\n"
+            "      : " << GetName() << " [options] [alias@]hostname   (generator, no gatekeeper)\n"
+            "      : " << GetName() << " [options] -g gk alias        (generator, with gatekeeper)\n"
+            "Options:\n"
+            "  -l --listen             : Answer calls instead of making them.\n"
+            "  -c --calls n            : Number of calls to make (default 100).\n"
+            "  -C --concurrent n       : Most calls in progress at once (default 10).\n"
+            "  -r --rate cps           : Calls started per second (default 10).\n"
+            "  -H --hold ms            : Clear calls after this long, 0 is never\n"
+            "                            (default 5000 making calls, 0 answering).\n"
+            "  -d --duration secs      : Answerer stops after this long (default forever).\n"
+            "  -g --gatekeeper host    : Register with gatekeeper, there is no discovery.\n"
+            "  -p --password pwd       : Set the H.235 password to use with the gatekeeper.\n"
+            "  -u --user name          : Set local alias name(s) (defaults to login name).\n"
+            "  -f --fast-enable        : Enable fast start.\n"
+            "  -T --h245tunneldisable  : Disable H245 tunnelling.\n"
+#ifdef H323_H235
+            "  -m --mediaenc           : Enable Media encryption (value max cipher 128, 192 or 256).\n"
+#endif
+            "  -D --disable codec      : Disable the specified codec (may be used multiple times)\n"
+            "  -P --prefer codec       : Prefer the specified codec (may be used multiple times)\n"
+            "  -i --interface ipnum    : Select interface to bind to.\n"
+            "  -x --listenport         : Listening port (default 1720 answering, none making calls).\n"
+            "     --rtp-ports base-max : RTP port range, allow four per call.\n"
+#if PTRACING
+            "  -t --trace              : Enable trace, use multiple times for more detail.\n"
+            "  -o --output             : File for trace output, default is stderr.\n"
+#endif
+            "  -h --help               : This help message.\n"
+            << endl;
+    return;
+  }
+
+#if PTRACING
+  PTrace::Initialise(args.GetOptionCount('t'),
+                     args.HasOption('o') ? (const char *)args.GetOptionString('o') : NULL,
+                     PTrace::DateAndTime | PTrace::TraceLevel | PTrace::FileAndLine);
+#endif
+
+  // Create the H.323 endpoint and initialize it
+  endpoint = new CallBenchEndPoint;
+  if (!endpoint->Initialise(args))
+    return;
+
+  if (args.HasOption('l'))
+    Answer(args);
+  else
+    Generate(args);
+}
+
+
+void CallBenchProcess::Generate(PArgList & args)
+{
+  unsigned calls = args.GetOptionString('c', "100").AsUnsigned();
+  unsigned concurrent = args.GetOptionString('C', "10").AsUnsigned();
+  double rate = args.GetOptionString('r', "10").AsReal();
+  if (calls == 0 || concurrent == 0 || rate <= 0) {
+    cerr << "Calls, concurrent calls and rate must be more than zero." << endl;
+    return;
+  }
+
+  cout << "Making " << calls << " calls to \"" << args[0] << "\" at "
+       << rate << " per second, at most " << concurrent << " at once" << endl;
+
+  PTimeInterval interval((PInt64)(1000.0/rate));
+  PTime startTime;
+  PInt64 startCPU = GetCPUMicroseconds();
+  PTime nextCall = startTime;
+  PTime nextReport = startTime + PTimeInterval(REPORT_INTERVAL);
+
+  // Calls are started on a fixed schedule. When the concurrency limit is
+  // reached the slot is missed rather than the schedule slipping, so the
+  // offered load stays at the rate asked for.
+  unsigned started = 0;
+  unsigned missed = 0;
+  while (started < calls) {
+    endpoint->ClearHeldCalls();
+
+    if (endpoint->GetActiveCalls() + endpoint->GetPendingCalls() < concurrent) {
+      endpoint->StartCall(args[0]);
+      started++;
+    }
+    else
+      missed++;
+
+    PTime now;
+    if (now >= nextReport) {
+      cout << "Started " << started << ", active " << endpoint->GetActiveCalls()
+           << ", setting up " << endpoint->GetPendingCalls() << endl;
+      nextReport += PTimeInterval(REPORT_INTERVAL);
+    }
+
+    nextCall += interval;
+    if (nextCall > now)
+      PThread::Sleep(nextCall - now);
+  }
+
+  // Wait for the last calls to finish, calls held forever only to be set up
+  PBoolean held = endpoint->GetHoldTime() > 0;
+  PTime drainEnd = PTime() + endpoint->GetHoldTime() + PTimeInterval(DRAIN_TIMEOUT);
+  while ((endpoint->GetPendingCalls() > 0 || (held && endpoint->GetActiveCalls() > 0)) && PTime() < drainEnd) {
+    endpoint->ClearHeldCalls();
+    PThread::Sleep(100);
+  }
+  endpoint->ClearAllCalls();
+
+  cout << "\nResults:\n";
+  if (missed > 0)
+    cout << "  Call slots missed at the concurrency limit: " << missed << '\n';
+  endpoint->PrintStatistics(cout, PTime() - startTime, GetCPUMicroseconds() - startCPU);
+}
+
+
+void CallBenchProcess::Answer(PArgList & args)
+{
+  PTimeInterval duration(0, args.GetOptionString('d').AsUnsigned());
+
+  cout << "Answering calls for \"" << endpoint->GetLocalUserName() << '"';
+  if (duration > 0)
+    cout << " for " << duration.GetSeconds() << " seconds";
+  cout << endl;
+
+  PTime startTime;
+  PInt64 startCPU = GetCPUMicroseconds();
+  PTime nextReport = startTime + PTimeInterval(REPORT_INTERVAL);
+
+  while (duration == 0 || PTime() - startTime < duration) {
+    endpoint->ClearHeldCalls();
+    PThread::Sleep(100);
+
+    if (PTime() >= nextReport) {
+      cout << '\n';
+      endpoint->PrintStatistics(cout, PTime() - startTime, GetCPUMicroseconds() - startCPU);
+      nextReport += PTimeInterval(REPORT_INTERVAL);
+    }
+  }
+
+  endpoint->ClearAllCalls();
+
+  cout << "\nResults:\n";
+  endpoint->PrintStatistics(cout, PTime() - startTime, GetCPUMicroseconds() - startCPU);
+}
+
+
+PInt64 CallBenchProcess::GetCPUMicroseconds()
+{
+#ifdef _WIN32
+  FILETIME created, exited, kernel, user;
+  if (!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user))
+    return 0;
+  PInt64 k = ((PInt64)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+  PInt64 u = ((PInt64)user.dwHighDateTime << 32) | user.dwLowDateTime;
+  return (k + u)/10;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+  return (PInt64)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)*1000000 +
+                  usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+#endif
+}
+
+
+///////////////////////////////////////////////////////////////
+
+CallBenchAudioChannel::CallBenchAudioChannel(unsigned sampleRate)
+  : bytesPerMillisecond(sampleRate*2/1000),
+    open(TRUE)
+{
+  if (bytesPerMillisecond == 0)
+    bytesPerMillisecond = 16;
+}
+
+
+PBoolean CallBenchAudioChannel::Read(void * buf, PINDEX len)
+{
+  if (!open)
+    return FALSE;
+
+  memset(buf, 0, len);
+  lastReadCount = len;
+  readDelay.Delay(len/bytesPerMillisecond);
+  return TRUE;
+}
+
+
+PBoolean CallBenchAudioChannel::Write(const void *, PINDEX len)
+{
+  if (!open)
+    return FALSE;
+
+  lastWriteCount = len;
+  writeDelay.Delay(len/bytesPerMillisecond);
+  return TRUE;
+}
+
+
+PBoolean CallBenchAudioChannel::Close()
+{
+  open = FALSE;
+  return TRUE;
+}
+
+
+///////////////////////////////////////////////////////////////
+
+CallBenchEndPoint::CallBenchEndPoint()
+  : pending(0),
+    notStarted(0),
+    attempted(0),
+    succeeded(0),
+    failed(0),
+    maxActive(0)
+{
+}
+
+
+PBoolean CallBenchEndPoint::Initialise(PArgList & args)
+{
+  PBoolean answering = args.HasOption('l');
+
+  // Get local username, multiple uses of -u indicates additional aliases
+  if (args.HasOption('u')) {
+    PStringArray aliases = args.GetOptionString('u').Tokenise(" ,;\n");
+    SetLocalUserName(aliases[0]);
+    for (PINDEX i = 1; i < aliases.GetSize(); i++)
+      AddAliasName(aliases[i]);
+  }
+
+  // Load the base featureSet
+  LoadBaseFeatureSet();
+
+  DisableFastStart(!args.HasOption('f'));
+  DisableH245Tunneling(args.HasOption('T'));
+
+  holdTime = args.GetOptionString('H', answering ? "0" : "5000").AsUnsigned();
+
+  if (args.HasOption("rtp-ports")) {
+    PStringArray ports = args.GetOptionString("rtp-ports").Tokenise("-");
+    if (ports.GetSize() != 2 || ports[0].AsUnsigned() >= ports[1].AsUnsigned()) {
+      cerr << "RTP ports should be base-max." << endl;
+      return FALSE;
+    }
+    SetRtpIpPorts(ports[0].AsUnsigned(), ports[1].AsUnsigned());
+  }
+
+  // Audio only, the media comes from CallBenchAudioChannel
+  AddAllCapabilities(0, P_MAX_INDEX, "*");
+  RemoveCapability(H323Capability::e_Video);
+  AddAllUserInputCapabilities(0, P_MAX_INDEX);
+
+  RemoveCapabilities(args.GetOptionString('D').Tokenise(','));
+  ReorderCapabilities(args.GetOptionString('P').Tokenise(','));
+
+#ifdef H323_H235
+  if (args.HasOption('m')) {
+    H235MediaCipher ncipher = encypt128;
+#ifdef H323_H235_AES256
+    unsigned cipher = args.GetOptionString('m').AsInteger();
+    if (cipher >= encypt192) ncipher = encypt192;
+    if (cipher >= encypt256) ncipher = encypt256;
+    unsigned maxtoken = 2048;
+#else
+    unsigned maxtoken = 1024;
+#endif
+    SetH235MediaEncryption(encyptRequest, ncipher, maxtoken);
+#ifdef H323_H235_AES256
+    if (ncipher > encypt128)
+      EncryptionCacheInitialise();
+#endif
+  }
+#endif
+
+  cout << "Local username: " << GetLocalUserName() << "\n"
+       << "FastConnect is " << (IsFastStartDisabled() ? "Dis" : "En") << "abled\n"
+       << "H245Tunnelling is " << (IsH245TunnelingDisabled() ? "Dis" : "En") << "abled\n"
+#ifdef H323_H235
+       << "Media encryption is " << (args.HasOption('m') ? "En" : "Dis") << "abled\n"
+#endif
+       << "Hold time: " << holdTime.GetMilliSeconds() << " ms\n"
+       << "Codecs (in preference order):\n" << setprecision(2) << GetCapabilities() << endl;
+
+  // The generator only listens when asked, so it can share a host with the answerer
+  PString iface = args.GetOptionString('i');
+  PString listenPort = args.GetOptionString('x');
+  if (listenPort.IsEmpty() && answering)
+    listenPort = "1720";
+
+  if (!listenPort) {
+    H323ListenerTCP * listener = new H323ListenerTCP(*this, PIPSocket::Address(iface), (WORD)listenPort.AsUnsigned());
+    if (!StartListener(listener)) {
+      cerr << "Could not open H.323 listener port " << listenPort << " on \""
+           << (iface.IsEmpty() ? PString("*") : iface) << '"' << endl;
+      return FALSE;
+    }
+  }
+
+  if (args.HasOption('p')) {
+    SetGatekeeperPassword(args.GetOptionString('p'));
+    SetEPCredentials(GetLocalUserName(), args.GetOptionString('p'));
+  }
+
+  // No discovery, so runs without a gatekeeper are not slowed by it
+  if (args.HasOption('g')) {
+    H323TransportUDP * rasChannel;
+    if (iface.IsEmpty())
+      rasChannel = new H323TransportUDP(*this);
+    else
+      rasChannel = new H323TransportUDP(*this, PIPSocket::Address(iface));
+
+    PString gkName = args.GetOptionString('g');
+    if (SetGatekeeper(gkName, rasChannel))
+      cout << "Gatekeeper set: " << *gatekeeper << endl;
+    else {
+      cerr << "Error registering with gatekeeper at \"" << gkName << '"' << endl;
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+
+PBoolean CallBenchEndPoint::StartCall(const PString & destination)
+{
+  // Calls are counted as their connection is created, so this only has
+  // to count calls that never got that far.
+  PString token;
+  if (MakeCall(destination, token) != NULL)
+    return TRUE;
+
+  PWaitAndSignal mutex(statsMutex);
+  notStarted++;
+  return FALSE;
+}
+
+
+void CallBenchEndPoint::ClearHeldCalls()
+{
+  if (holdTime == 0)
+    return;
+
+  PStringList expired;
+  {
+    PWaitAndSignal mutex(statsMutex);
+    PTime now;
+    for (std::map<PString, PTime>::iterator it = established.begin(); it != established.end(); ++it) {
+      if (now - it->second >= holdTime)
+        expired.AppendString(it->first);
+    }
+  }
+
+  for (PINDEX i = 0; i < expired.GetSize(); i++)
+    ClearCall(expired[i]);
+}
+
+
+unsigned CallBenchEndPoint::GetActiveCalls() const
+{
+  PWaitAndSignal mutex(statsMutex);
+  return established.size();
+}
+
+
+unsigned CallBenchEndPoint::GetPendingCalls() const
+{
+  PWaitAndSignal mutex(statsMutex);
+  return pending;
+}
+
+
+void CallBenchEndPoint::PrintStatistics(ostream & strm, const PTimeInterval & elapsed, PInt64 cpuMicroseconds) const
+{
+  PWaitAndSignal mutex(statsMutex);
+
+  RTP_Histogram::Snapshot setup;
+  setupHistogram.GetSnapshot(setup);
+
+  double seconds = elapsed.GetMilliSeconds()/1000.0;
+  strm << setprecision(3)
+       << "  Elapsed:                 " << seconds << " s\n"
+       << "  Calls attempted:         " << attempted << '\n'
+       << "  Calls not started:       " << notStarted << '\n'
+       << "  Calls established:       " << succeeded << '\n'
+       << "  Calls failed:            " << failed << '\n';
+
+  for (std::map<H323Connection::CallEndReason, unsigned>::const_iterator it = failures.begin(); it != failures.end(); ++it)
+    strm << "    " << it->first << ": " << it->second << '\n';
+
+  strm << "  Established per second:  " << (seconds > 0 ? succeeded/seconds : 0.0) << '\n'
+       << "  Most calls at once:      " << maxActive << '\n'
+       << "  Calls in progress:       " << established.size() << " established, " << pending << " setting up\n"
+       << "  Setup latency (ms):      p50=" << setup.GetPercentile(50)/1000.0
+       << " p90=" << setup.GetPercentile(90)/1000.0
+       << " p99=" << setup.GetPercentile(99)/1000.0
+       << " max=" << setup.GetMaximum()/1000.0 << '\n'
+       << "  CPU time:                " << cpuMicroseconds/1000 << " ms, "
+       << (seconds > 0 ? cpuMicroseconds/(seconds*10000.0) : 0.0) << "% of one core\n"
+       << "  CPU per call:            " << (attempted > 0 ? cpuMicroseconds/(attempted*1000.0) : 0.0) << " ms" << endl;
+}
+
+
+H323Connection * CallBenchEndPoint::CreateConnection(unsigned callReference)
+{
+  PWaitAndSignal mutex(statsMutex);
+  attempted++;
+  pending++;
+  return new CallBenchConnection(*this, callReference);
+}
+
+
+H323Connection::AnswerCallResponse
+                   CallBenchEndPoint::OnAnswerCall(H323Connection &,
+                                                   const PString &,
+                                                   const H323SignalPDU &,
+                                                   H323SignalPDU &)
+{
+  return H323Connection::AnswerCallNow;
+}
+
+
+void CallBenchEndPoint::OnConnectionEstablished(H323Connection & connection, const PString & token)
+{
+  CallBenchConnection & call = (CallBenchConnection &)connection;
+
+  PWaitAndSignal mutex(statsMutex);
+
+  if (call.isEstablished)
+    return;
+  call.isEstablished = TRUE;
+
+  setupHistogram.Record((DWORD)RTP_Histogram::GetMicroseconds(call.setupStart));
+
+  pending--;
+  succeeded++;
+  established[token] = PTime();
+  if (established.size() > maxActive)
+    maxActive = established.size();
+}
+
+
+void CallBenchEndPoint::OnConnectionCleared(H323Connection & connection, const PString & token)
+{
+  CallBenchConnection & call = (CallBenchConnection &)connection;
+
+  PWaitAndSignal mutex(statsMutex);
+
+  // Cleared before it was established, so the call failed
+  if (!call.isEstablished) {
+    pending--;
+    failed++;
+    failures[connection.GetCallEndReason()]++;
+  }
+
+  established.erase(token);
+}
+
+
+///////////////////////////////////////////////////////////////
+
+CallBenchConnection::CallBenchConnection(CallBenchEndPoint & ep, unsigned callReference)
+  : H323Connection(ep, callReference),
+    setupStart(RTP_Histogram::GetMicroseconds()),
+    isEstablished(FALSE)
+{
+}
+
+
+PBoolean CallBenchEndPoint::OpenAudioChannel(H323Connection &,
+                                             PBoolean,
+                                             unsigned,
+                                             H323AudioCodec & codec)
+{
+  codec.SetSilenceDetectionMode(H323AudioCodec::NoSilenceDetection);
+  return codec.AttachChannel(new CallBenchAudioChannel(codec.GetMediaFormat().GetTimeUnits()*1000));
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
@@ -0,0 +1,154 @@
+/*
+ * main.h
+ *
+ * H.323 call setup load generator and benchmark.
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#ifndef _CallBench_MAIN_H
+#define _CallBench_MAIN_H
+
+#include <h323.h>
+#include <rtphist.h>
+
+#include <map>
+
+#if PTLIB_VER < 2130
+#if !defined(P_USE_STANDARD_CXX_BOOL) && !defined(P_USE_INTEGER_BOOL)
+    typedef int PBoolean;
+#endif
+#endif
+
+
+/**Audio channel standing in for a sound card, so many calls can carry
+   media at once. Reads return silence and writes are discarded, both paced
+   in real time like a sound card.
+  */
+class CallBenchAudioChannel : public PChannel
+{
+  PCLASSINFO(CallBenchAudioChannel, PChannel);
+
+  public:
+    CallBenchAudioChannel(unsigned sampleRate);
+
+    virtual PBoolean Read(void * buf, PINDEX len);
+    virtual PBoolean Write(const void * buf, PINDEX len);
+    virtual PBoolean Close();
+    virtual PBoolean IsOpen() const { return open; }
+
+  protected:
+    unsigned       bytesPerMillisecond;
+    PAdaptiveDelay readDelay;
+    PAdaptiveDelay writeDelay;
+    PBoolean       open;
+};
+
+
+class CallBenchEndPoint : public H323EndPoint
+{
+  PCLASSINFO(CallBenchEndPoint, H323EndPoint);
+
+  public:
+    CallBenchEndPoint();
+
+    // overrides from H323EndPoint
+    virtual H323Connection * CreateConnection(unsigned callReference);
+    virtual H323Connection::AnswerCallResponse OnAnswerCall(H323Connection &, const PString &, const H323SignalPDU &, H323SignalPDU &);
+    virtual void OnConnectionEstablished(H323Connection & connection, const PString & token);
+    virtual void OnConnectionCleared(H323Connection & connection, const PString & clearedCallToken);
+    virtual PBoolean OpenAudioChannel(H323Connection & connection, PBoolean isEncoding, unsigned bufferSize, H323AudioCodec & codec);
+
+    // New functions
+    PBoolean Initialise(PArgList &);
+
+    /**Start a call, the setup latency is from here to the call being
+       established.
+      */
+    PBoolean StartCall(const PString & destination);
+
+    const PTimeInterval & GetHoldTime() const { return holdTime; }
+
+    /**Clear calls that have been established longer than the hold time.
+      */
+    void ClearHeldCalls();
+
+    unsigned GetActiveCalls() const;
+    unsigned GetPendingCalls() const;
+
+    void PrintStatistics(ostream & strm, const PTimeInterval & elapsed, PInt64 cpuMicroseconds) const;
+
+  protected:
+    PTimeInterval holdTime;
+
+    mutable PMutex statsMutex;
+    std::map<PString, PTime> established;   // Call token to time established, until cleared
+    RTP_Histogram setupHistogram;           // Setup latency in microseconds
+    unsigned pending;
+    unsigned notStarted;
+    unsigned attempted;
+    unsigned succeeded;
+    unsigned failed;
+    unsigned maxActive;
+    std::map<H323Connection::CallEndReason, unsigned> failures;
+};
+
+
+class CallBenchConnection : public H323Connection
+{
+    PCLASSINFO(CallBenchConnection, H323Connection);
+
+  public:
+    CallBenchConnection(CallBenchEndPoint &, unsigned);
+
+    PInt64   setupStart;      // Microseconds, when the connection was created
+    PBoolean isEstablished;
+};
+
+
+class CallBenchProcess : public PProcess
+{
+  PCLASSINFO(CallBenchProcess, PProcess)
+
+  public:
+    CallBenchProcess();
+    ~CallBenchProcess();
+
+    void Main();
+
+    /**Get the CPU time used by every thread of the process.
+      */
+    static PInt64 GetCPUMicroseconds();
+
+  protected:
+    void Generate(PArgList & args);
+    void Answer(PArgList & args);
+
+    CallBenchEndPoint * endpoint;
+};
+
+
+#endif  // _CallBench_MAIN_H
+
+
+// End of File ///////////////////////////////////////////////////////////////
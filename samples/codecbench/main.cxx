@@ -0,0 +1,785 @@
+/*
+ * main.cxx
+ *
+ * Benchmark and conformance run of the plugin codecs.
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#define H323_STATIC_LIB
+#endif
+
+#include "main.h"
+#include "../../version.h"
+
+#include <math.h>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#define new PNEW
+
+PCREATE_PROCESS(CodecBenchProcess);
+
+
+///////////////////////////////////////////////////////////////
+
+static const struct {
+  const char * name;
+  unsigned     width;
+  unsigned     height;
+} FrameSizes[] = {
+  { "SQCIF",  128,   96 },
+  { "QCIF",   176,  144 },
+  { "CIF",    352,  288 },
+  { "4CIF",   704,  576 },
+  { "720p",  1280,  720 },
+  { "1080p", 1920, 1080 }
+};
+
+// Packets a video encoder may give for one picture before it is failed
+static const unsigned MaxPacketsPerPicture = 1000;
+
+// Video RTP timestamp units per picture, 30 frames a second
+static const unsigned FrameTime = 3000;
+
+
+// Heap in use by the process, the plugins allocate with malloc() too
+static PInt64 GetHeapBytes()
+{
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2,33)
+  struct mallinfo2 info = mallinfo2();
+  return (PInt64)info.uordblks + info.hblkhd;
+#elif defined(__GLIBC__)
+  struct mallinfo info = mallinfo();
+  return (PInt64)(unsigned)info.uordblks + (unsigned)info.hblkhd;
+#else
+  return -1;
+#endif
+}
+
+
+static PluginCodec_ControlDefn * GetControl(const PluginCodec_Definition * codec, const char * name)
+{
+  PluginCodec_ControlDefn * control = codec->codecControls;
+  if (control == NULL)
+    return NULL;
+
+  while (control->name != NULL) {
+    if (strcasecmp(control->name, name) == 0)
+      return control;
+    control++;
+  }
+
+  return NULL;
+}
+
+
+static PBoolean SetOptions(const PluginCodec_Definition * codec, void * context, const PStringArray & options)
+{
+  PluginCodec_ControlDefn * control = GetControl(codec, PLUGINCODEC_CONTROL_SET_CODEC_OPTIONS);
+  if (control == NULL)
+    return FALSE;
+
+  char ** list = options.ToCharArray();
+  unsigned len = sizeof(list);
+  int ok = (*control->control)(codec, context, PLUGINCODEC_CONTROL_SET_CODEC_OPTIONS, list, &len);
+  free(list);
+  return ok != 0;
+}
+
+
+// SNR of decoded audio, at the codec delay that gives the best
+static double AudioSNR(const short * source, const short * decoded, unsigned count, unsigned maxDelay)
+{
+  double best = 0;
+
+  for (unsigned delay = 0; delay <= maxDelay && delay < count; delay++) {
+    double signal = 0, noise = 0;
+    for (unsigned i = delay; i < count; i++) {
+      double s = source[i-delay];
+      double d = decoded[i] - s;
+      signal += s*s;
+      noise += d*d;
+    }
+
+    double snr = noise > 0 ? 10*log10(signal/noise) : 99;
+    if (delay == 0 || snr > best)
+      best = snr;
+  }
+
+  return best;
+}
+
+
+static double LumaPSNR(const BYTE * source, const BYTE * decoded, unsigned size)
+{
+  double error = 0;
+  for (unsigned i = 0; i < size; i++) {
+    int d = source[i] - decoded[i];
+    error += d*d;
+  }
+
+  return error > 0 ? 10*log10(255.0*255.0*size/error) : 99;
+}
+
+
+static void InitRTP(BYTE * packet)
+{
+  memset(packet, 0, PluginCodec_RTP_MinHeaderSize);
+  packet[0] = 0x80;
+}
+
+
+// Microseconds the plugin took, -1 if it failed
+static PInt64 EncodePicture(const PluginCodec_Definition * codec, void * context,
+                            const PBYTEArray & input, PBYTEArray & packet, unsigned packetSize,
+                            PBoolean intra, unsigned index, WORD & sequence,
+                            std::vector<PBYTEArray> & packets, PString & error)
+{
+  PInt64 elapsed = 0;
+
+  for (unsigned count = 0; count < MaxPacketsPerPicture; count++) {
+    InitRTP(packet.GetPointer());
+    unsigned fromLen = input.GetSize();
+    unsigned toLen = packetSize;
+    unsigned flags = count == 0 && intra ? PluginCodec_CoderForceIFrame : 0;
+
+    PInt64 start = PTime().GetTimestamp();
+    int ok = (codec->codecFunction)(codec, context, (const BYTE *)input, &fromLen, packet.GetPointer(), &toLen, &flags);
+    elapsed += PTime().GetTimestamp() - start;
+
+    if (!ok) {
+      error = "encode failed";
+      return -1;
+    }
+
+    if (toLen > packetSize) {
+      error = psprintf("encoder gave %u byte packet", toLen);
+      return -1;
+    }
+
+    if (toLen > PluginCodec_RTP_MinHeaderSize) {
+      PluginCodec_RTP_SetSequenceNumber(packet.GetPointer(), sequence);
+      PluginCodec_RTP_SetTimestamp(packet.GetPointer(), index*FrameTime);
+      sequence++;
+      packets.push_back(PBYTEArray((const BYTE *)packet, toLen));
+    }
+
+    if ((flags & PluginCodec_ReturnCoderLastFrame) != 0)
+      return elapsed;
+  }
+
+  error = "encoder gave no last packet";
+  return -1;
+}
+
+
+// Microseconds the plugin took, -1 if it failed. The pictures decoded are
+// counted, picture is set to the last.
+static PInt64 DecodePacket(const PluginCodec_Definition * codec, void * context,
+                           const PBYTEArray & packet, PBYTEArray & output,
+                           unsigned & pictures, const PluginCodec_Video_FrameHeader * & picture,
+                           PString & error)
+{
+  PInt64 elapsed = 0;
+  const BYTE * from = (const BYTE *)packet;
+  unsigned fromLen = packet.GetSize();
+
+  for (;;) {
+    unsigned toLen = output.GetSize();
+    unsigned flags = 0;
+
+    PInt64 start = PTime().GetTimestamp();
+    int ok = (codec->codecFunction)(codec, context, from, &fromLen, output.GetPointer(), &toLen, &flags);
+    elapsed += PTime().GetTimestamp() - start;
+
+    if (!ok) {
+      error = "decode failed";
+      return -1;
+    }
+
+    if ((flags & PluginCodec_ReturnCoderLastFrame) == 0 || toLen <= PluginCodec_RTP_MinHeaderSize)
+      return elapsed;
+
+    picture = (const PluginCodec_Video_FrameHeader *)((const BYTE *)output + PluginCodec_RTP_MinHeaderSize);
+    pictures++;
+
+    if ((flags & PluginCodec_ReturnCoderMoreFrame) == 0)
+      return elapsed;
+
+    from = NULL;
+    fromLen = 0;
+  }
+}
+
+
+///////////////////////////////////////////////////////////////
+
+CodecBenchResult::CodecBenchResult()
+  : width(0),
+    height(0),
+    frames(0),
+    createTime(0),
+    contextBytes(-1),
+    encodeTime(0),
+    decodeTime(0),
+    encodedBytes(0),
+    quality(0),
+    result("ok")
+{
+}
+
+
+///////////////////////////////////////////////////////////////
+
+CodecBenchProcess::CodecBenchProcess()
+  : PProcess("H323Plus", "codecbench", MAJOR_VERSION, MINOR_VERSION, BUILD_TYPE, BUILD_NUMBER)
+{
+}
+
+
+void CodecBenchProcess::Main()
+{
+  cout << GetName()
+       << " Version " << GetVersion(TRUE)
+       << " by " << GetManufacturer()
+       << " on " << GetOSClass() << ' ' << GetOSName()
+       << " (" << GetOSVersion() << '-' << GetOSHardware() << ")\n\n";
+
+  // Get and parse all of the command line arguments.
+  PArgList & args = GetArguments();
+  args.Parse(
+             "b-bitrate:"
+             "c-codec:"
+             "d-plugins:"
+             "h-help."
+             "n-frames:"
+             "r-results:"
+             "s-sizes:"
+#if PTRACING
+             "o-output:"
+             "t-trace."
+#endif
+          , FALSE);
+
+  if (args.HasOption('h')) {
+    cout << "Usage : " << GetName() << " [options]\n"
+            "Options:\n"
+            "  -n --frames n           : Frames encoded and decoded in each run (default 200).\n"
+            "  -c --codec text         : Only the codecs with text in their name or format.\n"
+            "  -s --sizes list         : Video frame sizes to run, from SQCIF, QCIF, CIF, 4CIF,\n"
+            "                            720p and 1080p separated by commas (default every\n"
+            "                            size the codec supports).\n"
+            "  -b --bitrate bps        : Video bit rate (default 0.1 bits a pixel at 30fps).\n"
+            "  -d --plugins dir        : Load the plugins in dir as well.\n"
+            "  -r --results file       : Write the results to file as CSV, - for stdout.\n"
+#if PTRACING
+            "  -t --trace              : Enable trace, use multiple times for more detail.\n"
+            "  -o --output             : File for trace output, default is stderr.\n"
+#endif
+            "  -h --help               : This help message.\n"
+            << endl;
+    return;
+  }
+
+#if PTRACING
+  PTrace::Initialise(args.GetOptionCount('t'),
+                     args.HasOption('o') ? (const char *)args.GetOptionString('o') : NULL,
+                     PTrace::DateAndTime | PTrace::TraceLevel | PTrace::FileAndLine);
+#endif
+
+  if (args.HasOption('d'))
+    PPluginManager::GetPluginManager().LoadPluginDirectory(args.GetOptionString('d'));
+
+  // Make sure the plug in codecs are loaded
+  H323PluginCodecManager::Bootstrap();
+
+  std::vector<const PluginCodec_Definition *> codecs;
+  H323PluginCodecManager::GetCodecDefinitions(codecs);
+  if (codecs.empty()) {
+    cerr << "No plugin codecs loaded" << endl;
+    return;
+  }
+
+  frames = args.GetOptionString('n', "200").AsUnsigned();
+  if (frames == 0)
+    frames = 1;
+  bitRate = args.GetOptionString('b').AsUnsigned();
+  codecMatch = args.GetOptionString('c').ToLower();
+  if (args.HasOption('s'))
+    sizes = args.GetOptionString('s').Tokenise(",", FALSE);
+
+  cout << "Frames:     " << frames << '\n';
+  if (GetHeapBytes() < 0)
+    cout << "Context memory is not measured on this platform\n";
+  cout << '\n'
+       << setw(28) << left << "Codec"
+       << setw(20) << "Format"
+       << setw(10) << "Size" << right
+       << setw(10) << "create us"
+       << setw(10) << "context K"
+       << setw(12) << "encode ns"
+       << setw(12) << "decode ns"
+       << setw(9)  << "bytes"
+       << setw(7)  << "dB"
+       << "  result\n";
+
+  // The codecs come in pairs, each encoder followed by its decoder
+  for (size_t i = 0; i+1 < codecs.size(); i += 2) {
+    const PluginCodec_Definition * encoder = codecs[i];
+    const PluginCodec_Definition * decoder = codecs[i+1];
+
+    if (!codecMatch.IsEmpty() &&
+        (PString(encoder->descr) + ' ' + encoder->destFormat).ToLower().Find(codecMatch) == P_MAX_INDEX)
+      continue;
+
+    switch (encoder->flags & PluginCodec_MediaTypeMask) {
+      case PluginCodec_MediaTypeAudio :
+      case PluginCodec_MediaTypeAudioStreamed :
+        RunAudio(encoder, decoder);
+        break;
+
+      case PluginCodec_MediaTypeVideo :
+      case PluginCodec_MediaTypeExtended :
+        for (PINDEX s = 0; s < PARRAYSIZE(FrameSizes); s++) {
+          if (!sizes.IsEmpty() && sizes.GetStringsIndex(FrameSizes[s].name) == P_MAX_INDEX)
+            continue;
+          if ((encoder->parm.video.maxFrameWidth > 0 && FrameSizes[s].width > encoder->parm.video.maxFrameWidth) ||
+              (encoder->parm.video.maxFrameHeight > 0 && FrameSizes[s].height > encoder->parm.video.maxFrameHeight))
+            continue;
+          RunVideo(encoder, decoder, FrameSizes[s].width, FrameSizes[s].height);
+        }
+        break;
+    }
+  }
+
+  if (args.HasOption('r') && !WriteCSV(args.GetOptionString('r')))
+    cerr << "Could not write " << args.GetOptionString('r') << endl;
+}
+
+
+PBoolean CodecBenchProcess::Open(const PluginCodec_Definition * encoder,
+                                 const PluginCodec_Definition * decoder,
+                                 void * & encoderContext,
+                                 void * & decoderContext,
+                                 CodecBenchResult & result)
+{
+  // Directly, not through the context pool, for the cost of a new context
+  PInt64 start = PTime().GetTimestamp();
+  encoderContext = (*encoder->createCodec)(encoder);
+  decoderContext = (*decoder->createCodec)(decoder);
+  result.createTime = PTime().GetTimestamp() - start;
+
+  if (encoderContext != NULL && decoderContext != NULL)
+    return TRUE;
+
+  result.result = encoderContext == NULL ? "encoder not created" : "decoder not created";
+  Close(encoder, decoder, encoderContext, decoderContext);
+  return FALSE;
+}
+
+
+void CodecBenchProcess::Close(const PluginCodec_Definition * encoder,
+                              const PluginCodec_Definition * decoder,
+                              void * encoderContext,
+                              void * decoderContext)
+{
+  if (encoderContext != NULL)
+    (*encoder->destroyCodec)(encoder, encoderContext);
+  if (decoderContext != NULL)
+    (*decoder->destroyCodec)(decoder, decoderContext);
+}
+
+
+void CodecBenchProcess::RunAudio(const PluginCodec_Definition * encoder, const PluginCodec_Definition * decoder)
+{
+  CodecBenchResult result;
+  result.codec = encoder->descr;
+  result.format = encoder->destFormat;
+  result.media = "audio";
+  result.frames = frames;
+
+  unsigned samplesPerFrame = encoder->parm.audio.samplesPerFrame;
+  unsigned bytesPerFrame = encoder->parm.audio.bytesPerFrame;
+  if ((encoder->flags & (PluginCodec_InputTypeMask|PluginCodec_OutputTypeMask)) != 0 ||
+      samplesPerFrame == 0 || bytesPerFrame == 0) {
+    result.result = "not raw framed audio, skipped";
+    PrintResult(result);
+    return;
+  }
+
+  // Everything the run needs is allocated before the heap is measured
+  std::vector<short> pcm;
+  MakeAudioVector(encoder->sampleRate, samplesPerFrame*frames, pcm);
+  PBYTEArray encoded(bytesPerFrame*frames);
+  std::vector<unsigned> lengths(frames);
+  std::vector<short> decoded(samplesPerFrame*frames);
+  BYTE * out = encoded.GetPointer();
+
+  PInt64 heap = GetHeapBytes();
+
+  void * encoderContext, * decoderContext;
+  if (!Open(encoder, decoder, encoderContext, decoderContext, result)) {
+    PrintResult(result);
+    return;
+  }
+
+  // One frame through both for anything made on first use
+  unsigned fromLen = samplesPerFrame*2;
+  unsigned toLen = bytesPerFrame;
+  unsigned flags = 0;
+  (encoder->codecFunction)(encoder, encoderContext, &pcm[0], &fromLen, out, &toLen, &flags);
+  fromLen = toLen;
+  toLen = samplesPerFrame*2;
+  flags = 0;
+  (decoder->codecFunction)(decoder, decoderContext, out, &fromLen, &decoded[0], &toLen, &flags);
+
+  if (heap >= 0)
+    result.contextBytes = GetHeapBytes() - heap;
+
+  // Start again for the timed run, so the decoder is in step
+  Close(encoder, decoder, encoderContext, decoderContext);
+  CodecBenchResult ignored;
+  if (!Open(encoder, decoder, encoderContext, decoderContext, ignored)) {
+    result.result = ignored.result;
+    PrintResult(result);
+    return;
+  }
+
+  unsigned total = 0;
+  PInt64 start = PTime().GetTimestamp();
+  for (unsigned i = 0; i < frames; i++) {
+    fromLen = samplesPerFrame*2;
+    lengths[i] = bytesPerFrame;
+    flags = 0;
+    if (!(encoder->codecFunction)(encoder, encoderContext, &pcm[i*samplesPerFrame], &fromLen,
+                                  out + i*bytesPerFrame, &lengths[i], &flags) && result.result == "ok")
+      result.result = psprintf("encode failed on frame %u", i);
+    total += lengths[i];
+  }
+  result.encodeTime = (PTime().GetTimestamp() - start)*1000.0/frames;
+  result.encodedBytes = (double)total/frames;
+
+  for (unsigned i = 0; i < frames && result.result == "ok"; i++) {
+    if (lengths[i] > bytesPerFrame)
+      result.result = psprintf("encoder gave %u bytes of at most %u", lengths[i], bytesPerFrame);
+  }
+
+  if (result.result == "ok") {
+    std::vector<unsigned> samples(frames);
+    start = PTime().GetTimestamp();
+    for (unsigned i = 0; i < frames; i++) {
+      fromLen = lengths[i];
+      samples[i] = samplesPerFrame*2;
+      flags = 0;
+      if (!(decoder->codecFunction)(decoder, decoderContext, out + i*bytesPerFrame, &fromLen,
+                                    &decoded[i*samplesPerFrame], &samples[i], &flags) && result.result == "ok")
+        result.result = psprintf("decode failed on frame %u", i);
+    }
+    result.decodeTime = (PTime().GetTimestamp() - start)*1000.0/frames;
+
+    for (unsigned i = 0; i < frames && result.result == "ok"; i++) {
+      if (samples[i] != samplesPerFrame*2)
+        result.result = psprintf("decoder gave %u samples of %u", samples[i]/2, samplesPerFrame);
+    }
+
+    if (result.result == "ok")
+      result.quality = AudioSNR(&pcm[0], &decoded[0], samplesPerFrame*frames, samplesPerFrame*2);
+  }
+
+  Close(encoder, decoder, encoderContext, decoderContext);
+  PrintResult(result);
+}
+
+
+void CodecBenchProcess::RunVideo(const PluginCodec_Definition * encoder,
+                                 const PluginCodec_Definition * decoder,
+                                 unsigned width,
+                                 unsigned height)
+{
+  CodecBenchResult result;
+  result.codec = encoder->descr;
+  result.format = encoder->destFormat;
+  result.media = "video";
+  result.width = width;
+  result.height = height;
+  result.frames = frames;
+
+  if ((encoder->flags & PluginCodec_OutputTypeMask) != PluginCodec_OutputTypeRTP) {
+    result.result = "encoder output not RTP, skipped";
+    PrintResult(result);
+    return;
+  }
+
+  unsigned pictureSize = width*height*3/2;
+  unsigned headerSize = PluginCodec_RTP_MinHeaderSize + sizeof(PluginCodec_Video_FrameHeader);
+
+  // The encoder is given an RTP packet holding a frame header and the picture
+  PBYTEArray input(headerSize + pictureSize);
+  InitRTP(input.GetPointer());
+  PluginCodec_Video_FrameHeader * header = (PluginCodec_Video_FrameHeader *)(input.GetPointer() + PluginCodec_RTP_MinHeaderSize);
+  header->x = header->y = 0;
+  header->width = width;
+  header->height = height;
+  BYTE * picture = OPAL_VIDEO_FRAME_DATA_PTR(header);
+
+  unsigned packetSize = PluginCodec_RTP_MaxPacketSize;
+  PBYTEArray packet(packetSize);
+  PBYTEArray output(headerSize + pictureSize + 1024);
+  PBYTEArray source(pictureSize);
+  std::vector<PBYTEArray> packets;
+  std::vector<size_t> pictureEnds;
+  packets.reserve(frames*4);
+  pictureEnds.reserve(frames);
+
+  PStringArray options;
+  options.AppendString(PLUGINCODEC_OPTION_FRAME_WIDTH);
+  options.AppendString(PString(width));
+  options.AppendString(PLUGINCODEC_OPTION_FRAME_HEIGHT);
+  options.AppendString(PString(height));
+  options.AppendString(PLUGINCODEC_OPTION_MAX_RX_FRAME_WIDTH);
+  options.AppendString(PString(width));
+  options.AppendString(PLUGINCODEC_OPTION_MAX_RX_FRAME_HEIGHT);
+  options.AppendString(PString(height));
+  options.AppendString(PLUGINCODEC_OPTION_FRAME_TIME);
+  options.AppendString(PString(FrameTime));
+  unsigned bps = bitRate > 0 ? bitRate : width*height*3;
+  options.AppendString(PLUGINCODEC_OPTION_TARGET_BIT_RATE);
+  options.AppendString(PString(bps));
+  options.AppendString(PLUGINCODEC_OPTION_MAX_BIT_RATE);
+  options.AppendString(PString(bps));
+
+  PString error;
+  WORD sequence = 0;
+  unsigned pictures = 0;
+  const PluginCodec_Video_FrameHeader * decodedPicture = NULL;
+
+  PInt64 heap = GetHeapBytes();
+
+  void * encoderContext, * decoderContext;
+  if (!Open(encoder, decoder, encoderContext, decoderContext, result)) {
+    PrintResult(result);
+    return;
+  }
+
+  SetOptions(encoder, encoderContext, options);
+  SetOptions(decoder, decoderContext, options);
+
+  // One picture through both for anything made on first use, at this size
+  MakeVideoPicture(width, height, 0, picture);
+  if (EncodePicture(encoder, encoderContext, input, packet, packetSize, TRUE, 0, sequence, packets, error) >= 0) {
+    for (size_t p = 0; p < packets.size() && error.IsEmpty(); p++)
+      DecodePacket(decoder, decoderContext, packets[p], output, pictures, decodedPicture, error);
+  }
+  packets.clear();
+
+  if (heap >= 0)
+    result.contextBytes = GetHeapBytes() - heap;
+
+  // Start again for the timed run, so the decoder is in step
+  Close(encoder, decoder, encoderContext, decoderContext);
+  CodecBenchResult ignored;
+  if (!Open(encoder, decoder, encoderContext, decoderContext, ignored)) {
+    result.result = ignored.result;
+    PrintResult(result);
+    return;
+  }
+
+  SetOptions(encoder, encoderContext, options);
+  SetOptions(decoder, decoderContext, options);
+
+  error.MakeEmpty();
+  sequence = 0;
+  PInt64 encodeTime = 0;
+  PINDEX total = 0;
+  for (unsigned i = 0; i < frames && error.IsEmpty(); i++) {
+    MakeVideoPicture(width, height, i, picture);
+    PInt64 elapsed = EncodePicture(encoder, encoderContext, input, packet, packetSize, i == 0, i, sequence, packets, error);
+    if (elapsed < 0)
+      error = psprintf("%s on picture %u", (const char *)error, i);
+    else
+      encodeTime += elapsed;
+    pictureEnds.push_back(packets.size());
+  }
+  result.encodeTime = encodeTime*1000.0/frames;
+
+  for (size_t p = 0; p < packets.size(); p++)
+    total += packets[p].GetSize() - PluginCodec_RTP_MinHeaderSize;
+  result.encodedBytes = (double)total/frames;
+
+  // Each decoded picture is compared with the picture it was encoded from
+  PInt64 decodeTime = 0;
+  double psnr = 0;
+  pictures = 0;
+  for (size_t p = 0; p < packets.size() && error.IsEmpty(); p++) {
+    unsigned before = pictures;
+    PInt64 elapsed = DecodePacket(decoder, decoderContext, packets[p], output, pictures, decodedPicture, error);
+    if (elapsed < 0)
+      break;
+    decodeTime += elapsed;
+    if (pictures == before)
+      continue;
+
+    if (decodedPicture->width != width || decodedPicture->height != height) {
+      error = psprintf("decoder gave %ux%u picture", decodedPicture->width, decodedPicture->height);
+      break;
+    }
+
+    MakeVideoPicture(width, height, pictures-1, source.GetPointer());
+    psnr += LumaPSNR(source, OPAL_VIDEO_FRAME_DATA_PTR(decodedPicture), width*height);
+  }
+
+  if (error.IsEmpty() && pictures < frames)
+    error = psprintf("decoder gave %u pictures of %u", pictures, frames);
+
+  result.decodeTime = decodeTime*1000.0/frames;
+  if (pictures > 0)
+    result.quality = psnr/pictures;
+  if (!error.IsEmpty())
+    result.result = error;
+
+  Close(encoder, decoder, encoderContext, decoderContext);
+  PrintResult(result);
+}
+
+
+void CodecBenchProcess::MakeAudioVector(unsigned sampleRate, unsigned samples, std::vector<short> & pcm)
+{
+  pcm.resize(samples);
+
+  DWORD noise = 12345;
+  double phase = 0;
+
+  for (unsigned i = 0; i < samples; i++) {
+    double t = (double)i/sampleRate;
+
+    // Syllables four times a second, every fourth one a pause
+    double syllable = fmod(t*4, 4);
+    double envelope = syllable < 3 ? sin(M_PI*fmod(syllable, 1)) : 0;
+
+    // Pitch gliding between 120Hz and 220Hz, with two formant-ish harmonics
+    double pitch = 170 + 50*sin(2*M_PI*0.7*t);
+    phase += 2*M_PI*pitch/sampleRate;
+    double voice = 0.6*sin(phase) + 0.25*sin(3*phase) + 0.15*sin(7*phase);
+
+    noise = noise*1103515245 + 12345;
+    double hiss = ((int)((noise >> 16) & 0x7fff) - 16384)/16384.0;
+
+    pcm[i] = (short)(12000*envelope*voice + 200*hiss);
+  }
+}
+
+
+void CodecBenchProcess::MakeVideoPicture(unsigned width, unsigned height, unsigned index, BYTE * yuv)
+{
+  BYTE * y = yuv;
+  BYTE * u = yuv + width*height;
+  BYTE * v = u + width*height/4;
+
+  // A box crossing the picture in five seconds at 30 frames a second
+  unsigned box = height/4;
+  unsigned boxX = (index*(width-box)/150) % (width-box);
+  unsigned boxY = height/2 - box/2;
+
+  for (unsigned row = 0; row < height; row++) {
+    for (unsigned col = 0; col < width; col++) {
+      unsigned value = (col*160/width + row*64/height + index) & 0xff;
+      if (((col/8 + row/8) & 1) != 0)
+        value = (value + 24) & 0xff;
+      if (col >= boxX && col < boxX+box && row >= boxY && row < boxY+box)
+        value = 235;
+      *y++ = (BYTE)value;
+    }
+  }
+
+  for (unsigned row = 0; row < height/2; row++) {
+    for (unsigned col = 0; col < width/2; col++) {
+      *u++ = (BYTE)(64 + col*128/(width/2));
+      *v++ = (BYTE)(192 - row*128/(height/2));
+    }
+  }
+}
+
+
+void CodecBenchProcess::PrintResult(const CodecBenchResult & result)
+{
+  results.push_back(result);
+
+  PString size = result.width > 0 ? psprintf("%ux%u", result.width, result.height) : PString("-");
+
+  cout << setw(28) << left << result.codec.Left(27)
+       << setw(20) << result.format.Left(19)
+       << setw(10) << size << right
+       << setw(10) << result.createTime;
+  if (result.contextBytes >= 0)
+    cout << setw(10) << (result.contextBytes+1023)/1024;
+  else
+    cout << setw(10) << "n/a";
+  cout << setprecision(0) << setiosflags(ios::fixed)
+       << setw(12) << result.encodeTime
+       << setw(12) << result.decodeTime
+       << setw(9)  << result.encodedBytes
+       << setprecision(1)
+       << setw(7)  << result.quality
+       << resetiosflags(ios::fixed)
+       << "  " << result.result << endl;
+}
+
+
+PBoolean CodecBenchProcess::WriteCSV(const PString & filename)
+{
+  PTextFile file;
+  if (filename != "-" && !file.Open(filename, PFile::WriteOnly))
+    return FALSE;
+
+  ostream & strm = filename == "-" ? cout : (ostream &)file;
+
+  strm << "codec,format,media,width,height,frames,create_us,context_bytes,"
+          "encode_ns_per_frame,decode_ns_per_frame,encoded_bytes_per_frame,quality_db,result\n";
+
+  for (size_t i = 0; i < results.size(); i++) {
+    const CodecBenchResult & r = results[i];
+    PString result = r.result;
+    result.Replace("\"", "'", TRUE);
+    strm << '"' << r.codec << "\",\"" << r.format << "\"," << r.media << ','
+         << r.width << ',' << r.height << ',' << r.frames << ','
+         << r.createTime << ',' << r.contextBytes << ','
+         << setprecision(0) << setiosflags(ios::fixed)
+         << r.encodeTime << ',' << r.decodeTime << ','
+         << setprecision(1)
+         << r.encodedBytes << ',' << r.quality << ','
+         << resetiosflags(ios::fixed)
+         << '"' << result << "\"\n";
+  }
+
+  strm << flush;
+  return TRUE;
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
@@ -0,0 +1,113 @@
+/*
+ * main.h
+ *
+ * Benchmark and conformance run of the plugin codecs.
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#ifndef _CodecBench_MAIN_H
+#define _CodecBench_MAIN_H
+
+#include <h323.h>
+#include <h323pluginmgr.h>
+
+#include <vector>
+
+#if PTLIB_VER < 2130
+#if !defined(P_USE_STANDARD_CXX_BOOL) && !defined(P_USE_INTEGER_BOOL)
+    typedef int PBoolean;
+#endif
+#endif
+
+
+/**The measurements of one encoder and decoder pair, at one frame size for
+   video.
+  */
+struct CodecBenchResult
+{
+  CodecBenchResult();
+
+  PString  codec;         // Description of the encoder
+  PString  format;        // Encoded media format
+  PString  media;         // audio or video
+  unsigned width;         // Frame size, zero for audio
+  unsigned height;
+  unsigned frames;        // Frames encoded and decoded
+  PInt64   createTime;    // Microseconds to create the encoder and decoder
+  PInt64   contextBytes;  // Heap the pair holds once a frame is through, -1 if unknown
+  double   encodeTime;    // Nanoseconds per frame
+  double   decodeTime;
+  double   encodedBytes;  // Per frame
+  double   quality;       // dB, SNR for audio and luma PSNR for video
+  PString  result;        // "ok" or why the pair does not conform
+};
+
+
+class CodecBenchProcess : public PProcess
+{
+  PCLASSINFO(CodecBenchProcess, PProcess)
+
+  public:
+    CodecBenchProcess();
+
+    void Main();
+
+  protected:
+    /**Create an encoder and decoder, timing it. Returns FALSE if either
+       cannot be created.
+      */
+    PBoolean Open(const PluginCodec_Definition * encoder, const PluginCodec_Definition * decoder,
+                  void * & encoderContext, void * & decoderContext, CodecBenchResult & result);
+    void Close(const PluginCodec_Definition * encoder, const PluginCodec_Definition * decoder,
+               void * encoderContext, void * decoderContext);
+
+    void RunAudio(const PluginCodec_Definition * encoder, const PluginCodec_Definition * decoder);
+    void RunVideo(const PluginCodec_Definition * encoder, const PluginCodec_Definition * decoder,
+                  unsigned width, unsigned height);
+
+    /**Make the audio test vector: voiced syllables with a moving pitch,
+       pauses and a little noise, the same for every run.
+      */
+    static void MakeAudioVector(unsigned sampleRate, unsigned samples, std::vector<short> & pcm);
+
+    /**Make a YUV420P picture of the video test vector: gradients, a
+       moving box and some texture, the same for every run.
+      */
+    static void MakeVideoPicture(unsigned width, unsigned height, unsigned index, BYTE * yuv);
+
+    void PrintResult(const CodecBenchResult & result);
+    PBoolean WriteCSV(const PString & filename);
+
+    PString  codecMatch;
+    PStringArray sizes;
+    unsigned frames;
+    unsigned bitRate;
+    std::vector<CodecBenchResult> results;
+};
+
+
+#endif  // _CodecBench_MAIN_H
+
+
+// End of File ///////////////////////////////////////////////////////////////
@@ -0,0 +1,1395 @@
+/*
+ * main.cxx
+ *
+ * Replay of captured H.323 signalling and media against an endpoint.
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#define H323_STATIC_LIB
+#endif
+
+#include "main.h"
+#include "../../version.h"
+
+#include <algorithm>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#define new PNEW
+
+PCREATE_PROCESS(PcapReplayProcess);
+
+
+// How often progress is shown, in milliseconds
+#define REPORT_INTERVAL 5000
+
+// An event sent later than this, in microseconds, counts as late
+#define LATE_THRESHOLD 2000
+
+// Largest captured packet accepted, anything larger is a corrupt file
+#define MAX_SNAPLEN 262144
+
+// Differing signalling flows listed without --verbose
+#define MAX_DIFFERENCES 10
+
+
+static const PIPSocket::Address & Loopback()
+{
+  static PIPSocket::Address loopback(127, 0, 0, 1);
+  return loopback;
+}
+
+
+static PString FlowEnd(const PIPSocket::Address & addr, WORD port)
+{
+  return addr.AsString() + ':' + PString(PString::Unsigned, port);
+}
+
+
+static PString FormatMessages(const std::vector<PString> & messages)
+{
+  if (messages.empty())
+    return "(none)";
+
+  PStringStream strm;
+  for (size_t i = 0; i < messages.size(); i++) {
+    if (i > 0)
+      strm << ' ';
+    strm << messages[i];
+  }
+  return strm;
+}
+
+
+// Messages that move the call state. Facility, Information and the like are
+// not compared, how many of them there are depends on timing.
+static PBoolean IsCallStateMessage(Q931::MsgTypes type)
+{
+  switch (type) {
+    case Q931::AlertingMsg :
+    case Q931::CallProceedingMsg :
+    case Q931::ConnectMsg :
+    case Q931::ConnectAckMsg :
+    case Q931::SetupMsg :
+    case Q931::SetupAckMsg :
+    case Q931::DisconnectMsg :
+    case Q931::ReleaseMsg :
+    case Q931::ReleaseCompleteMsg :
+      return TRUE;
+    default :
+      return FALSE;
+  }
+}
+
+
+static PBoolean IsRASRequest(unsigned tag)
+{
+  switch (tag) {
+    case H225_RasMessage::e_gatekeeperRequest :
+    case H225_RasMessage::e_registrationRequest :
+    case H225_RasMessage::e_unregistrationRequest :
+    case H225_RasMessage::e_admissionRequest :
+    case H225_RasMessage::e_bandwidthRequest :
+    case H225_RasMessage::e_disengageRequest :
+    case H225_RasMessage::e_locationRequest :
+    case H225_RasMessage::e_infoRequestResponse :
+    case H225_RasMessage::e_resourcesAvailableIndicate :
+      return TRUE;
+    default :
+      return FALSE;
+  }
+}
+
+
+///////////////////////////////////////////////////////////////
+
+PcapReplayProcess::PcapReplayProcess()
+  : PProcess("H323Plus", "pcapreplay", MAJOR_VERSION, MINOR_VERSION, BUILD_TYPE, BUILD_NUMBER)
+{
+  endpoint = NULL;
+  signalPort = 1720;
+  rasPort = 1719;
+  rtpTargetPort = 0;
+  packetCount = 0;
+  tcpOther = 0;
+  udpOther = 0;
+  rasRequests = 0;
+  rasSocket = NULL;
+  rasTargetPort = 0;
+  rasReader = NULL;
+  rasSent = 0;
+  rasUndecodable = 0;
+  lateEvents = 0;
+  maxLateness = 0;
+  shuttingDown = FALSE;
+}
+
+
+PcapReplayProcess::~PcapReplayProcess()
+{
+  Shutdown();
+
+  for (size_t i = 0; i < signalFlows.size(); i++)
+    delete signalFlows[i];
+  for (size_t i = 0; i < mediaFlows.size(); i++)
+    delete mediaFlows[i];
+  delete rasSocket;
+  delete endpoint;
+}
+
+
+void PcapReplayProcess::Main()
+{
+  cout << GetName()
+       << " Version " << GetVersion(TRUE)
+       << " by " << GetManufacturer()
+       << " on " << GetOSClass() << ' ' << GetOSName()
+       << " (" << GetOSVersion() << '-' << GetOSHardware() << ")\n\n";
+
+  // Get and parse all of the command line arguments.
+  PArgList & args = GetArguments();
+  args.Parse(
+             "d-drain:"
+             "h-help."
+             "i-interface:"
+#if PTRACING
+             "o-output:"
+#endif
+             "p-signal-port:"
+             "-ras:"
+             "-ras-port:"
+             "r-reject."
+             "-rtp-target:"
+             "s-speed:"
+             "T-h245tunneldisable."
+#if PTRACING
+             "t-trace."
+#endif
+             "v-verbose."
+             "x-listenport:"
+          , FALSE);
+
+  if (args.HasOption('h') || args.GetCount() == 0) {
+    cout << "Usage : " << GetName() << " [options] capture.pcap\n"
+            "Replays the call signalling, RAS and RTP of a capture against this tool's\n"
+            "own endpoint over loopback, and checks the endpoint answers each call the\n"
+            "way the captured endpoint did. Nothing is sent to an address in the capture.\n"
+            "Options:\n"
+            "  -s --speed n            : Replay n times faster than captured, 0 is as\n"
+            "                            fast as possible (default 1).\n"
+            "  -d --drain ms           : Wait for answers after the last packet (default 2000).\n"
+            "  -p --signal-port n      : Call signalling port in the capture (default 1720).\n"
+            "  -r --reject             : Endpoint rejects calls instead of answering them.\n"
+            "  -T --h245tunneldisable  : Disable H245 tunnelling.\n"
+            "  -x --listenport n       : Endpoint listener port (default any free port).\n"
+            "  -i --interface ipnum    : Interface for the endpoint and RAS (default 127.0.0.1).\n"
+            "     --ras host[:port]    : Send the RAS requests to this gatekeeper, with the\n"
+            "                            addresses in them changed to this tool's. Requests\n"
+            "                            with H.235 tokens will fail their authentication.\n"
+            "     --ras-port n         : RAS port in the capture (default 1719).\n"
+            "     --rtp-target host:port : Send every RTP flow here instead of to a\n"
+            "                            local receiver measuring loss and jitter.\n"
+            "  -v --verbose            : List every flow in the results.\n"
+#if PTRACING
+            "  -t --trace              : Enable trace, use multiple times for more detail.\n"
+            "  -o --output             : File for trace output, default is stderr.\n"
+#endif
+            "  -h --help               : This help message.\n"
+            << endl;
+    return;
+  }
+
+#if PTRACING
+  PTrace::Initialise(args.GetOptionCount('t'),
+                     args.HasOption('o') ? (const char *)args.GetOptionString('o') : NULL,
+                     PTrace::DateAndTime | PTrace::TraceLevel | PTrace::FileAndLine);
+#endif
+
+  signalPort = (WORD)args.GetOptionString('p', "1720").AsUnsigned();
+  rasPort = (WORD)args.GetOptionString("ras-port", "1719").AsUnsigned();
+
+  if (!Load(args[0]))
+    return;
+
+  // Create the H.323 endpoint and initialize it
+  endpoint = new PcapReplayEndPoint;
+  if (!endpoint->Initialise(args))
+    return;
+
+  if (args.HasOption("ras") && !OpenRAS(args.GetOptionString("ras")))
+    return;
+
+  if (args.HasOption("rtp-target")) {
+    H323TransportAddress target(args.GetOptionString("rtp-target"));
+    if (!target.GetIpAndPort(rtpTarget, rtpTargetPort) || rtpTargetPort == 0) {
+      cerr << "RTP target should be host:port." << endl;
+      return;
+    }
+  }
+
+  Replay(args);
+}
+
+
+PBoolean PcapReplayProcess::Load(const PFilePath & filename)
+{
+  PcapReader reader;
+  if (!reader.Open(filename))
+    return FALSE;
+
+  PcapPacket packet;
+  PInt64 firstTime = 0;
+  while (reader.ReadPacket(packet)) {
+    if (packetCount++ == 0)
+      firstTime = packet.time;
+
+    // Captures from several interfaces may be slightly out of order
+    PInt64 when = packet.time > firstTime ? packet.time - firstTime : 0;
+
+    if (packet.protocol == 6)
+      LoadTCP(packet, when);
+    else
+      LoadUDP(packet, when);
+  }
+
+  // A packet captured before the one ahead of it is still sent after it
+  std::stable_sort(events.begin(), events.end());
+
+  PINDEX damaged = 0;
+  for (size_t i = 0; i < signalFlows.size(); i++) {
+    if (signalFlows[i]->IsDamaged())
+      damaged++;
+  }
+
+  cout << "Capture " << filename << ":\n"
+       << "  Packets:                 " << packetCount << ", "
+       << reader.GetSkippedCount() << " not IPv4 TCP or UDP skipped\n"
+       << "  Call signalling flows:   " << signalFlows.size() << ", "
+       << damaged << " with segments missing or not TPKT\n"
+       << "  Other TCP segments:      " << tcpOther << " (H.245 or other, not replayed)\n"
+       << "  RAS requests:            " << rasRequests << '\n'
+       << "  RTP and RTCP flows:      " << mediaFlows.size() << '\n'
+       << "  Other UDP packets:       " << udpOther << '\n'
+       << "  Events to replay:        " << events.size() << '\n';
+  if (!events.empty())
+    cout << "  Duration:                " << events.back().time/1000000.0 << " s\n";
+  cout << endl;
+
+  if (events.empty()) {
+    cerr << "Nothing to replay in the capture." << endl;
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+
+void PcapReplayProcess::LoadTCP(const PcapPacket & packet, PInt64 when)
+{
+  if (packet.srcPort != signalPort && packet.dstPort != signalPort) {
+    if (!packet.payload.IsEmpty())
+      tcpOther++;
+    return;
+  }
+
+  PString src = FlowEnd(packet.srcAddr, packet.srcPort);
+  PString dst = FlowEnd(packet.dstAddr, packet.dstPort);
+  PString key = src < dst ? src + ' ' + dst : dst + ' ' + src;
+
+  PINDEX index;
+  std::map<PString, PINDEX>::iterator it = signalIndex.find(key);
+  if (it != signalIndex.end())
+    index = it->second;
+  else {
+    index = signalFlows.size();
+    signalIndex[key] = index;
+    signalFlows.push_back(new SignalFlow(key));
+  }
+
+  SignalFlow & flow = *signalFlows[index];
+
+  // The client is the side that opened the connection, or failing a SYN in
+  // the capture the side sending to the signalling port.
+  if (!flow.known) {
+    PBoolean senderIsClient;
+    if ((packet.tcpFlags & PcapPacket::TCP_SYN) != 0)
+      senderIsClient = (packet.tcpFlags & PcapPacket::TCP_ACK) == 0;
+    else
+      senderIsClient = packet.dstPort == signalPort;
+
+    flow.known = TRUE;
+    flow.clientAddr = senderIsClient ? packet.srcAddr : packet.dstAddr;
+    flow.clientPort = senderIsClient ? packet.srcPort : packet.dstPort;
+    flow.name = senderIsClient ? src + " > " + dst : dst + " > " + src;
+  }
+
+  PBoolean fromClient = packet.srcAddr == flow.clientAddr && packet.srcPort == flow.clientPort;
+
+  PList<PBYTEArray> tpkts;
+  flow.AddSegment(fromClient ? flow.client : flow.server, packet, tpkts);
+
+  for (PINDEX i = 0; i < tpkts.GetSize(); i++) {
+    if (fromClient) {
+      ReplayEvent event;
+      event.time = when;
+      event.kind = ReplayEvent::e_Signal;
+      event.flow = index;
+      event.data = tpkts[i];
+      events.push_back(event);
+    }
+    else if (tpkts[i].GetSize() > 4) {
+      Q931 q931;
+      if (q931.Decode(PBYTEArray((const BYTE *)tpkts[i] + 4, tpkts[i].GetSize() - 4)) &&
+          IsCallStateMessage(q931.GetMessageType()))
+        flow.expected.push_back(q931.GetMessageTypeName());
+    }
+  }
+}
+
+
+void PcapReplayProcess::LoadUDP(const PcapPacket & packet, PInt64 when)
+{
+  const PBYTEArray & data = packet.payload;
+
+  if (packet.srcPort == rasPort || packet.dstPort == rasPort ||
+      packet.srcPort == 1718 || packet.dstPort == 1718) {
+    PPER_Stream strm(data);
+    H323RasPDU pdu;
+    if (!pdu.Decode(strm)) {
+      udpOther++;
+      return;
+    }
+
+    if (IsRASRequest(pdu.GetTag()) && (packet.dstPort == rasPort || packet.dstPort == 1718)) {
+      ReplayEvent event;
+      event.time = when;
+      event.kind = ReplayEvent::e_RAS;
+      event.flow = 0;
+      event.data = data;
+      events.push_back(event);
+      rasRequests++;
+    }
+    else
+      rasCaptured[pdu.GetTagName()]++;
+    return;
+  }
+
+  // RTP and RTCP are both version 2 with at least a twelve byte header
+  if (data.GetSize() < 12 || (data[0] & 0xc0) != 0x80) {
+    udpOther++;
+    return;
+  }
+
+  PString key = FlowEnd(packet.srcAddr, packet.srcPort) + " > " + FlowEnd(packet.dstAddr, packet.dstPort);
+
+  PINDEX index;
+  std::map<PString, PINDEX>::iterator it = mediaIndex.find(key);
+  if (it != mediaIndex.end())
+    index = it->second;
+  else {
+    index = mediaFlows.size();
+    mediaIndex[key] = index;
+    mediaFlows.push_back(new MediaFlow(key));
+  }
+
+  ReplayEvent event;
+  event.time = when;
+  event.kind = ReplayEvent::e_RTP;
+  event.flow = index;
+  event.data = data;
+  events.push_back(event);
+}
+
+
+PBoolean PcapReplayProcess::OpenRAS(const PString & target)
+{
+  H323TransportAddress address(target, 1719);
+  if (!address.GetIpAndPort(rasTargetAddr, rasTargetPort)) {
+    cerr << "Could not resolve RAS target \"" << target << '"' << endl;
+    return FALSE;
+  }
+
+  rasSocket = new PUDPSocket;
+  if (!rasSocket->Listen(endpoint->GetInterface(), 0, 0)) {
+    cerr << "Could not open RAS socket on " << endpoint->GetInterface() << endl;
+    return FALSE;
+  }
+  rasSocket->SetSendAddress(rasTargetAddr, rasTargetPort);
+
+  rasReader = PThread::Create(PCREATE_NOTIFIER(ReadRAS), 0,
+                              PThread::NoAutoDeleteThread,
+                              PThread::NormalPriority,
+                              "RAS Replay");
+
+  cout << "Sending RAS requests to " << rasTargetAddr << ':' << rasTargetPort << endl;
+  return TRUE;
+}
+
+
+void PcapReplayProcess::Replay(PArgList & args)
+{
+  double speed = args.GetOptionString('s', "1").AsReal();
+  if (speed < 0) {
+    cerr << "Speed must not be negative." << endl;
+    return;
+  }
+
+  PTimeInterval drain = args.GetOptionString('d', "2000").AsUnsigned();
+
+  for (size_t i = 0; i < mediaFlows.size(); i++) {
+    MediaFlow & flow = *mediaFlows[i];
+    flow.socket = new PUDPSocket;
+
+    if (rtpTargetPort != 0) {
+      flow.socket->Listen(endpoint->GetInterface(), 0, 0);
+      flow.socket->SetSendAddress(rtpTarget, rtpTargetPort);
+      continue;
+    }
+
+    PIPSocket::Address addr;
+    WORD port;
+    flow.receiver = new PUDPSocket;
+    if (!flow.receiver->Listen(Loopback(), 0, 0) ||
+        !flow.receiver->GetLocalAddress(addr, port) ||
+        !flow.socket->Listen(Loopback(), 0, 0)) {
+      cerr << "Could not open RTP sockets for " << flow.name << endl;
+      return;
+    }
+    flow.socket->SetSendAddress(Loopback(), port);
+    flow.reader = PThread::Create(PCREATE_NOTIFIER(ReadRTP), (H323_INT)i,
+                                  PThread::NoAutoDeleteThread,
+                                  PThread::HighPriority,
+                                  "RTP Replay:%x");
+  }
+
+  cout << "Replaying " << events.size() << " packets to "
+       << endpoint->GetInterface() << ':' << endpoint->GetListenerPort();
+  if (speed > 0)
+    cout << " at " << speed << " times captured speed" << endl;
+  else
+    cout << " as fast as possible" << endl;
+
+  PTime startTime;
+  PInt64 startCPU = GetCPUMicroseconds();
+  PInt64 start = RTP_Histogram::GetMicroseconds();
+  PInt64 nextReport = (PInt64)REPORT_INTERVAL*1000;
+
+  for (size_t i = 0; i < events.size(); i++) {
+    const ReplayEvent & event = events[i];
+
+    PInt64 due = speed > 0 ? (PInt64)(event.time/speed) : 0;
+    PInt64 elapsed = RTP_Histogram::GetMicroseconds(start);
+    if (due > elapsed + 1000)
+      PThread::Sleep(PTimeInterval((due - elapsed)/1000));
+    else if (speed > 0 && elapsed - due > LATE_THRESHOLD) {
+      lateEvents++;
+      if (elapsed - due > maxLateness)
+        maxLateness = elapsed - due;
+    }
+
+    switch (event.kind) {
+      case ReplayEvent::e_Signal :
+        SendSignal(event);
+        break;
+      case ReplayEvent::e_RAS :
+        SendRAS(event);
+        break;
+      case ReplayEvent::e_RTP :
+        SendRTP(event, start + due);
+        break;
+    }
+
+    if (elapsed >= nextReport) {
+      cout << "Sent " << i << " of " << events.size() << " packets, "
+           << endpoint->GetAllConnections().GetSize() << " calls" << endl;
+      nextReport += (PInt64)REPORT_INTERVAL*1000;
+    }
+  }
+
+  PThread::Sleep(drain);
+
+  unsigned remaining = endpoint->GetAllConnections().GetSize();
+  PTimeInterval elapsed = PTime() - startTime;
+  PInt64 cpuMicroseconds = GetCPUMicroseconds() - startCPU;
+
+  Shutdown();
+
+  cout << "\nResults:\n";
+  if (remaining > 0)
+    cout << "  Calls up after the drain: " << remaining << " (cleared at the end)\n";
+  PrintStatistics(cout, elapsed, cpuMicroseconds, args.HasOption('v'));
+}
+
+
+void PcapReplayProcess::SendSignal(const ReplayEvent & event)
+{
+  SignalFlow & flow = *signalFlows[event.flow];
+  if (flow.failed)
+    return;
+
+  if (flow.socket == NULL) {
+    flow.socket = new PTCPSocket(endpoint->GetListenerPort());
+    if (!flow.socket->Connect(endpoint->GetInterface())) {
+      PTRACE(2, "Replay\tCould not connect for " << flow.name << ": " << flow.socket->GetErrorText());
+      flow.failed = TRUE;
+      return;
+    }
+    flow.reader = PThread::Create(PCREATE_NOTIFIER(ReadSignal), (H323_INT)event.flow,
+                                  PThread::NoAutoDeleteThread,
+                                  PThread::NormalPriority,
+                                  "Replay:%x");
+  }
+
+  {
+    PWaitAndSignal m(flow.mutex);
+    flow.lastSent = RTP_Histogram::GetMicroseconds();
+  }
+
+  if (!flow.socket->Write(event.data, event.data.GetSize())) {
+    PTRACE(2, "Replay\tWrite failed for " << flow.name << ": " << flow.socket->GetErrorText());
+    flow.failed = TRUE;
+  }
+}
+
+
+void PcapReplayProcess::SendRAS(const ReplayEvent & event)
+{
+  if (rasSocket == NULL)
+    return;
+
+  PPER_Stream strm(event.data);
+  H323RasPDU pdu;
+  if (!pdu.Decode(strm)) {
+    rasUndecodable++;
+    return;
+  }
+
+  RewriteRAS(pdu);
+
+  PPER_Stream rewritten;
+  pdu.Encode(rewritten);
+  rewritten.CompleteEncoding();
+
+  {
+    PWaitAndSignal m(rasMutex);
+    rasPending[pdu.GetSequenceNumber()] = RTP_Histogram::GetMicroseconds();
+  }
+
+  if (rasSocket->Write(rewritten.GetPointer(), rewritten.GetSize()))
+    rasSent++;
+}
+
+
+void PcapReplayProcess::RewriteRAS(H323RasPDU & pdu) const
+{
+  // Every address a gatekeeper could send to is changed to this tool's, so
+  // nothing goes to the hosts in the capture.
+  PIPSocket::Address localAddr;
+  WORD localPort = 0;
+  rasSocket->GetLocalAddress(localAddr, localPort);
+  H323TransportAddress ras(endpoint->GetInterface(), localPort);
+  H323TransportAddress signal(endpoint->GetInterface(), endpoint->GetListenerPort());
+
+  switch (pdu.GetTag()) {
+    case H225_RasMessage::e_gatekeeperRequest : {
+      H225_GatekeeperRequest & grq = pdu;
+      ras.SetPDU(grq.m_rasAddress);
+      break;
+    }
+
+    case H225_RasMessage::e_registrationRequest : {
+      H225_RegistrationRequest & rrq = pdu;
+      for (PINDEX i = 0; i < rrq.m_rasAddress.GetSize(); i++)
+        ras.SetPDU(rrq.m_rasAddress[i]);
+      for (PINDEX i = 0; i < rrq.m_callSignalAddress.GetSize(); i++)
+        signal.SetPDU(rrq.m_callSignalAddress[i]);
+      break;
+    }
+
+    case H225_RasMessage::e_admissionRequest : {
+      H225_AdmissionRequest & arq = pdu;
+      if (arq.HasOptionalField(H225_AdmissionRequest::e_destCallSignalAddress))
+        signal.SetPDU(arq.m_destCallSignalAddress);
+      if (arq.HasOptionalField(H225_AdmissionRequest::e_srcCallSignalAddress))
+        signal.SetPDU(arq.m_srcCallSignalAddress);
+      break;
+    }
+
+    case H225_RasMessage::e_locationRequest : {
+      H225_LocationRequest & lrq = pdu;
+      ras.SetPDU(lrq.m_replyAddress);
+      break;
+    }
+
+    case H225_RasMessage::e_infoRequestResponse : {
+      H225_InfoRequestResponse & irr = pdu;
+      ras.SetPDU(irr.m_rasAddress);
+      for (PINDEX i = 0; i < irr.m_callSignalAddress.GetSize(); i++)
+        signal.SetPDU(irr.m_callSignalAddress[i]);
+      break;
+    }
+
+    default :
+      break;
+  }
+}
+
+
+void PcapReplayProcess::SendRTP(const ReplayEvent & event, PInt64 due)
+{
+  MediaFlow & flow = *mediaFlows[event.flow];
+  if (flow.socket == NULL)
+    return;
+
+  const PBYTEArray & data = event.data;
+
+  // RTCP packet types are 200 to 204, where RTP has the marker and type
+  if (flow.receiver != NULL && (data[1] < 200 || data[1] > 204)) {
+    PWaitAndSignal m(flow.mutex);
+    flow.scheduled[(WORD)((data[2] << 8) | data[3])] = due;
+  }
+
+  if (flow.socket->Write(data, data.GetSize()))
+    flow.sent++;
+}
+
+
+void PcapReplayProcess::ReadSignal(PThread &, H323_INT index)
+{
+  SignalFlow & flow = *signalFlows[index];
+
+  BYTE header[4];
+  while (flow.socket->ReadBlock(header, sizeof(header))) {
+    PINDEX length = (header[2] << 8) | header[3];
+    if (header[0] != 3 || length < 4)
+      break;
+
+    PBYTEArray payload;
+    if (length > 4 && !flow.socket->ReadBlock(payload.GetPointer(length - 4), length - 4))
+      break;
+
+    PInt64 now = RTP_Histogram::GetMicroseconds();
+
+    Q931 q931;
+    PBoolean decoded = length > 4 && q931.Decode(payload);
+
+    PInt64 sent;
+    {
+      PWaitAndSignal m(flow.mutex);
+      flow.messages++;
+      if (decoded && IsCallStateMessage(q931.GetMessageType()))
+        flow.received.push_back(q931.GetMessageTypeName());
+      sent = flow.lastSent;
+      flow.lastSent = 0;
+    }
+
+    // Only the first answer to each PDU sent counts for the latency
+    if (sent != 0) {
+      PWaitAndSignal m(latencyMutex);
+      signalLatency.Record((DWORD)(now - sent));
+    }
+  }
+}
+
+
+void PcapReplayProcess::ReadRAS(PThread &, H323_INT)
+{
+  BYTE buffer[4096];
+  while (rasSocket->Read(buffer, sizeof(buffer))) {
+    PInt64 now = RTP_Histogram::GetMicroseconds();
+
+    PPER_Stream strm(buffer, rasSocket->GetLastReadCount());
+    H323RasPDU pdu;
+    if (!pdu.Decode(strm))
+      continue;
+
+    PWaitAndSignal m(rasMutex);
+    rasResponses[pdu.GetTagName()]++;
+
+    // A RequestInProgress is not the answer, the confirm or reject follows
+    if (pdu.GetTag() == H225_RasMessage::e_requestInProgress)
+      continue;
+
+    std::map<unsigned, PInt64>::iterator it = rasPending.find(pdu.GetSequenceNumber());
+    if (it != rasPending.end()) {
+      rasLatency.Record((DWORD)(now - it->second));
+      rasPending.erase(it);
+    }
+  }
+}
+
+
+void PcapReplayProcess::ReadRTP(PThread &, H323_INT index)
+{
+  MediaFlow & flow = *mediaFlows[index];
+
+  BYTE buffer[2048];
+  while (flow.receiver->Read(buffer, sizeof(buffer))) {
+    PInt64 now = RTP_Histogram::GetMicroseconds();
+    PINDEX length = flow.receiver->GetLastReadCount();
+
+    PWaitAndSignal m(flow.mutex);
+    flow.received++;
+
+    if (length < 12 || (buffer[1] >= 200 && buffer[1] <= 204))
+      continue;
+
+    std::map<WORD, PInt64>::iterator it = flow.scheduled.find((WORD)((buffer[2] << 8) | buffer[3]));
+    if (it == flow.scheduled.end())
+      continue;
+
+    // Transit from when the packet was due to when it arrived, so this is
+    // the jitter the replay itself adds to the captured timing.
+    PInt64 transit = now - it->second;
+    flow.scheduled.erase(it);
+
+    if (flow.lastTransit >= 0) {
+      double difference = (double)(transit - flow.lastTransit);
+      if (difference < 0)
+        difference = -difference;
+      flow.jitter += (difference - flow.jitter)/16;
+    }
+    flow.lastTransit = transit;
+  }
+}
+
+
+void PcapReplayProcess::Shutdown()
+{
+  if (shuttingDown)
+    return;
+  shuttingDown = TRUE;
+
+  // Closing the sockets ends the reading threads
+  for (size_t i = 0; i < signalFlows.size(); i++) {
+    SignalFlow & flow = *signalFlows[i];
+    if (flow.socket != NULL)
+      flow.socket->Close();
+    if (flow.reader != NULL) {
+      flow.reader->WaitForTermination();
+      delete flow.reader;
+      flow.reader = NULL;
+    }
+  }
+
+  for (size_t i = 0; i < mediaFlows.size(); i++) {
+    MediaFlow & flow = *mediaFlows[i];
+    if (flow.receiver != NULL)
+      flow.receiver->Close();
+    if (flow.reader != NULL) {
+      flow.reader->WaitForTermination();
+      delete flow.reader;
+      flow.reader = NULL;
+    }
+  }
+
+  if (rasSocket != NULL)
+    rasSocket->Close();
+  if (rasReader != NULL) {
+    rasReader->WaitForTermination();
+    delete rasReader;
+    rasReader = NULL;
+  }
+
+  if (endpoint != NULL)
+    endpoint->ClearAllCalls();
+}
+
+
+void PcapReplayProcess::PrintStatistics(ostream & strm, const PTimeInterval & elapsed, PInt64 cpuMicroseconds, PBoolean verbose)
+{
+  double seconds = elapsed.GetMilliSeconds()/1000.0;
+  strm << setprecision(3)
+       << "  Elapsed:                 " << seconds << " s\n"
+       << "  CPU time:                " << cpuMicroseconds/1000 << " ms, "
+       << (seconds > 0 ? cpuMicroseconds/(seconds*10000.0) : 0.0) << "% of one core\n";
+
+  if (lateEvents > 0)
+    strm << "  Packets sent late:       " << lateEvents << ", at most "
+         << maxLateness/1000.0 << " ms, try a lower speed\n";
+
+  PINDEX replayed = 0, matched = 0, sameOutcome = 0, differed = 0, damaged = 0, failed = 0;
+  PStringStream differences, flows;
+  for (size_t i = 0; i < signalFlows.size(); i++) {
+    SignalFlow & flow = *signalFlows[i];
+    if (flow.socket == NULL && !flow.failed)
+      continue;
+
+    replayed++;
+    if (flow.failed)
+      failed++;
+    else if (flow.IsDamaged())
+      damaged++;
+    else if (flow.received == flow.expected)
+      matched++;
+    else {
+      if (!flow.received.empty() && !flow.expected.empty() && flow.received.back() == flow.expected.back())
+        sameOutcome++;
+      else
+        differed++;
+
+      if (verbose || (sameOutcome + differed) <= MAX_DIFFERENCES)
+        differences << "    " << flow.name << "\n"
+                    << "      captured: " << FormatMessages(flow.expected) << "\n"
+                    << "      replayed: " << FormatMessages(flow.received) << "\n";
+    }
+
+    if (verbose)
+      flows << "    " << flow.name << ": " << flow.messages << " messages, "
+           << FormatMessages(flow.received) << '\n';
+  }
+
+  RTP_Histogram::Snapshot signal;
+  {
+    PWaitAndSignal m(latencyMutex);
+    signalLatency.GetSnapshot(signal);
+  }
+
+  strm << "  Signalling flows:        " << replayed << " replayed, "
+       << matched << " answered as captured, "
+       << sameOutcome << " with the same final message, "
+       << differed << " differing\n"
+       << flows;
+  if (damaged > 0 || failed > 0)
+    strm << "  Not compared:            " << damaged << " incomplete in the capture, "
+         << failed << " could not be sent\n";
+  if (!differences.IsEmpty())
+    strm << "  Differences in call state messages:\n" << differences;
+  strm << "  Signalling latency (ms): p50=" << signal.GetPercentile(50)/1000.0
+       << " p90=" << signal.GetPercentile(90)/1000.0
+       << " p99=" << signal.GetPercentile(99)/1000.0
+       << " max=" << signal.GetMaximum()/1000.0 << '\n';
+
+  endpoint->PrintStatistics(strm);
+
+  if (rasSocket != NULL) {
+    RTP_Histogram::Snapshot ras;
+    rasLatency.GetSnapshot(ras);
+
+    strm << "  RAS requests sent:       " << rasSent << " of " << rasRequests;
+    if (rasUndecodable > 0)
+      strm << ", " << rasUndecodable << " undecodable";
+    strm << '\n';
+    for (std::map<PString, unsigned>::const_iterator it = rasResponses.begin(); it != rasResponses.end(); ++it)
+      strm << "    " << it->first << ": " << it->second << " replayed\n";
+    for (std::map<PString, unsigned>::const_iterator it = rasCaptured.begin(); it != rasCaptured.end(); ++it)
+      strm << "    " << it->first << ": " << it->second << " captured\n";
+    strm << "  RAS latency (ms):        p50=" << ras.GetPercentile(50)/1000.0
+         << " p90=" << ras.GetPercentile(90)/1000.0
+         << " p99=" << ras.GetPercentile(99)/1000.0
+         << " max=" << ras.GetMaximum()/1000.0 << '\n';
+  }
+  else if (rasRequests > 0)
+    strm << "  RAS requests:            " << rasRequests << " not sent, no --ras target\n";
+
+  if (!mediaFlows.empty()) {
+    PINDEX sent = 0, received = 0;
+    double totalJitter = 0, maxJitter = 0;
+    for (size_t i = 0; i < mediaFlows.size(); i++) {
+      MediaFlow & flow = *mediaFlows[i];
+      sent += flow.sent;
+      received += flow.received;
+      totalJitter += flow.jitter;
+      if (flow.jitter > maxJitter)
+        maxJitter = flow.jitter;
+      if (verbose && rtpTargetPort == 0)
+        strm << "    " << flow.name << ": sent " << flow.sent << ", lost " << (flow.sent - flow.received)
+             << ", jitter " << flow.jitter/1000.0 << " ms\n";
+    }
+
+    strm << "  RTP packets sent:        " << sent << " in " << mediaFlows.size() << " flows\n";
+    if (rtpTargetPort == 0)
+      strm << "  RTP packets lost:        " << (sent - received) << '\n'
+           << "  RTP replay jitter (ms):  mean=" << totalJitter/mediaFlows.size()/1000.0
+           << " max=" << maxJitter/1000.0 << '\n';
+  }
+
+  strm << endl;
+}
+
+
+PInt64 PcapReplayProcess::GetCPUMicroseconds()
+{
+#ifdef _WIN32
+  FILETIME created, exited, kernel, user;
+  if (!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user))
+    return 0;
+  PInt64 k = ((PInt64)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+  PInt64 u = ((PInt64)user.dwHighDateTime << 32) | user.dwLowDateTime;
+  return (k + u)/10;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+  return (PInt64)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)*1000000 +
+                  usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+#endif
+}
+
+
+///////////////////////////////////////////////////////////////
+
+PcapPacket::PcapPacket()
+  : time(0),
+    protocol(0),
+    srcPort(0),
+    dstPort(0),
+    tcpSeq(0),
+    tcpFlags(0)
+{
+}
+
+
+PcapReader::PcapReader()
+  : swapped(FALSE),
+    nanoseconds(FALSE),
+    linkType(0),
+    skipped(0)
+{
+}
+
+
+PBoolean PcapReader::Open(const PFilePath & filename)
+{
+  if (!file.Open(filename, PFile::ReadOnly)) {
+    cerr << "Could not open " << filename << ": " << file.GetErrorText() << endl;
+    return FALSE;
+  }
+
+  BYTE header[24];
+  if (!file.Read(header, sizeof(header)) || file.GetLastReadCount() != sizeof(header)) {
+    cerr << filename << " is too short to be a capture." << endl;
+    return FALSE;
+  }
+
+  DWORD magic = header[0] | (header[1] << 8) | (header[2] << 16) | ((DWORD)header[3] << 24);
+  switch (magic) {
+    case 0xa1b2c3d4 :
+      break;
+    case 0xa1b23c4d :
+      nanoseconds = TRUE;
+      break;
+    case 0xd4c3b2a1 :
+      swapped = TRUE;
+      break;
+    case 0x4d3cb2a1 :
+      swapped = TRUE;
+      nanoseconds = TRUE;
+      break;
+    case 0x0a0d0d0a :
+      cerr << filename << " is pcapng, save it as pcap first, for example with\n"
+              "  editcap -F pcap " << filename << " capture.pcap" << endl;
+      return FALSE;
+    default :
+      cerr << filename << " is not a pcap capture." << endl;
+      return FALSE;
+  }
+
+  linkType = Get32(header+20) & 0xffff;
+  switch (linkType) {
+    case 0 :    // BSD loopback
+    case 1 :    // Ethernet
+    case 12 :   // Raw IP
+    case 101 :  // Raw IP
+    case 113 :  // Linux cooked
+    case 276 :  // Linux cooked v2
+      return TRUE;
+  }
+
+  cerr << filename << " has link type " << linkType << ", which is not supported." << endl;
+  return FALSE;
+}
+
+
+DWORD PcapReader::Get32(const BYTE * ptr) const
+{
+  if (swapped)
+    return ((DWORD)ptr[0] << 24) | (ptr[1] << 16) | (ptr[2] << 8) | ptr[3];
+  return ((DWORD)ptr[3] << 24) | (ptr[2] << 16) | (ptr[1] << 8) | ptr[0];
+}
+
+
+PBoolean PcapReader::ReadPacket(PcapPacket & packet)
+{
+  PBYTEArray data;
+
+  for (;;) {
+    BYTE record[16];
+    if (!file.Read(record, sizeof(record)) || file.GetLastReadCount() != sizeof(record))
+      return FALSE;
+
+    DWORD seconds = Get32(record);
+    DWORD fraction = Get32(record+4);
+    DWORD captured = Get32(record+8);
+    if (captured > MAX_SNAPLEN) {
+      cerr << "Capture is corrupt, a packet has " << captured << " bytes." << endl;
+      return FALSE;
+    }
+
+    if (captured == 0) {
+      skipped++;
+      continue;
+    }
+
+    if (!file.Read(data.GetPointer(captured), captured) || file.GetLastReadCount() != (PINDEX)captured)
+      return FALSE;
+
+    packet.time = (PInt64)seconds*1000000 + (nanoseconds ? fraction/1000 : fraction);
+
+    const BYTE * ptr = data;
+    PINDEX length = captured;
+    WORD etherType = 0x0800;
+
+    switch (linkType) {
+      case 0 :
+        // Address family in the byte order of the capturing host
+        if (length < 4 || !((ptr[0] == 2 && ptr[3] == 0) || (ptr[0] == 0 && ptr[3] == 2)))
+          etherType = 0;
+        ptr += 4;
+        length -= 4;
+        break;
+
+      case 1 :
+        if (length < 14) {
+          etherType = 0;
+          break;
+        }
+        etherType = (WORD)((ptr[12] << 8) | ptr[13]);
+        ptr += 14;
+        length -= 14;
+        while ((etherType == 0x8100 || etherType == 0x88a8) && length >= 4) {
+          etherType = (WORD)((ptr[2] << 8) | ptr[3]);
+          ptr += 4;
+          length -= 4;
+        }
+        break;
+
+      case 113 :
+        if (length < 16) {
+          etherType = 0;
+          break;
+        }
+        etherType = (WORD)((ptr[14] << 8) | ptr[15]);
+        ptr += 16;
+        length -= 16;
+        break;
+
+      case 276 :
+        if (length < 20) {
+          etherType = 0;
+          break;
+        }
+        etherType = (WORD)((ptr[0] << 8) | ptr[1]);
+        ptr += 20;
+        length -= 20;
+        break;
+    }
+
+    if (etherType == 0x0800 && length > 0 && DecodeIP(ptr, length, packet))
+      return TRUE;
+
+    skipped++;
+  }
+}
+
+
+PBoolean PcapReader::DecodeIP(const BYTE * ptr, PINDEX length, PcapPacket & packet)
+{
+  if (length < 20 || (ptr[0] >> 4) != 4)
+    return FALSE;
+
+  PINDEX headerLength = (ptr[0] & 0x0f)*4;
+  PINDEX totalLength = (ptr[2] << 8) | ptr[3];
+  if (headerLength < 20 || totalLength < headerLength || totalLength > length)
+    return FALSE;
+
+  // Fragments are not reassembled, signalling and media are rarely fragmented
+  if ((((ptr[6] << 8) | ptr[7]) & 0x3fff) != 0)
+    return FALSE;
+
+  packet.protocol = ptr[9];
+  packet.srcAddr = PIPSocket::Address(ptr[12], ptr[13], ptr[14], ptr[15]);
+  packet.dstAddr = PIPSocket::Address(ptr[16], ptr[17], ptr[18], ptr[19]);
+
+  const BYTE * transport = ptr + headerLength;
+  PINDEX transportLength = totalLength - headerLength;
+
+  if (packet.protocol == 6) {
+    if (transportLength < 20)
+      return FALSE;
+    PINDEX offset = (transport[12] >> 4)*4;
+    if (offset < 20 || offset > transportLength)
+      return FALSE;
+    packet.srcPort = (WORD)((transport[0] << 8) | transport[1]);
+    packet.dstPort = (WORD)((transport[2] << 8) | transport[3]);
+    packet.tcpSeq = ((DWORD)transport[4] << 24) | (transport[5] << 16) | (transport[6] << 8) | transport[7];
+    packet.tcpFlags = transport[13];
+    packet.payload = PBYTEArray(transport + offset, transportLength - offset);
+    return TRUE;
+  }
+
+  if (packet.protocol == 17) {
+    if (transportLength < 8)
+      return FALSE;
+    PINDEX udpLength = (transport[4] << 8) | transport[5];
+    if (udpLength < 8 || udpLength > transportLength)
+      return FALSE;
+    packet.srcPort = (WORD)((transport[0] << 8) | transport[1]);
+    packet.dstPort = (WORD)((transport[2] << 8) | transport[3]);
+    packet.tcpSeq = 0;
+    packet.tcpFlags = 0;
+    packet.payload = PBYTEArray(transport + 8, udpLength - 8);
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+
+///////////////////////////////////////////////////////////////
+
+SignalFlow::SignalFlow(const PString & flowName)
+  : name(flowName),
+    known(FALSE),
+    clientPort(0),
+    notTPKT(FALSE),
+    socket(NULL),
+    reader(NULL),
+    messages(0),
+    lastSent(0),
+    failed(FALSE)
+{
+}
+
+
+SignalFlow::~SignalFlow()
+{
+  delete reader;
+  delete socket;
+}
+
+
+void SignalFlow::AddSegment(Direction & dir, const PcapPacket & packet, PList<PBYTEArray> & tpkts)
+{
+  if ((packet.tcpFlags & PcapPacket::TCP_SYN) != 0) {
+    dir.started = TRUE;
+    dir.nextSeq = packet.tcpSeq + 1;
+    return;
+  }
+
+  PINDEX length = packet.payload.GetSize();
+  if (length == 0 || dir.lost || notTPKT)
+    return;
+
+  if (!dir.started) {
+    dir.started = TRUE;
+    dir.nextSeq = packet.tcpSeq;
+  }
+
+  // Sequence numbers wrap, so the difference is taken as signed
+  int offset = (int)(packet.tcpSeq - dir.nextSeq);
+  if (offset > 0) {
+    // A segment the capture missed, whatever follows cannot be framed
+    dir.lost = TRUE;
+    return;
+  }
+
+  PINDEX start = -offset;
+  if (start >= length)
+    return;   // Retransmission of data already seen
+
+  PINDEX oldSize = dir.buffer.GetSize();
+  memcpy(dir.buffer.GetPointer(oldSize + length - start) + oldSize, (const BYTE *)packet.payload + start, length - start);
+  dir.nextSeq = packet.tcpSeq + length;
+
+  for (;;) {
+    PINDEX size = dir.buffer.GetSize();
+    if (size < 4)
+      break;
+
+    PINDEX tpktLength = (dir.buffer[2] << 8) | dir.buffer[3];
+    if (dir.buffer[0] != 3 || tpktLength < 4) {
+      notTPKT = TRUE;
+      break;
+    }
+    if (size < tpktLength)
+      break;
+
+    tpkts.Append(new PBYTEArray(dir.buffer, tpktLength));
+    memmove(dir.buffer.GetPointer(), (const BYTE *)dir.buffer + tpktLength, size - tpktLength);
+    dir.buffer.SetSize(size - tpktLength);
+  }
+}
+
+
+MediaFlow::MediaFlow(const PString & flowName)
+  : name(flowName),
+    socket(NULL),
+    receiver(NULL),
+    reader(NULL),
+    sent(0),
+    received(0),
+    lastTransit(-1),
+    jitter(0)
+{
+}
+
+
+MediaFlow::~MediaFlow()
+{
+  delete reader;
+  delete receiver;
+  delete socket;
+}
+
+
+///////////////////////////////////////////////////////////////
+
+PcapReplayEndPoint::PcapReplayEndPoint()
+  : iface(Loopback()),
+    listenerPort(0),
+    answer(H323Connection::AnswerCallNow),
+    created(0),
+    established(0)
+{
+}
+
+
+PBoolean PcapReplayEndPoint::Initialise(PArgList & args)
+{
+  // Load the base featureSet
+  LoadBaseFeatureSet();
+
+  // Fast start channels would carry the media addresses of the capture
+  DisableFastStart(TRUE);
+  DisableH245Tunneling(args.HasOption('T'));
+
+  if (args.HasOption('r'))
+    answer = H323Connection::AnswerCallDenied;
+
+  // All the codecs, so the capabilities exchanged look like a real endpoint
+  AddAllCapabilities(0, P_MAX_INDEX, "*");
+  AddAllUserInputCapabilities(0, P_MAX_INDEX);
+
+  if (args.HasOption('i'))
+    iface = PIPSocket::Address(args.GetOptionString('i'));
+
+  H323ListenerTCP * listener = new H323ListenerTCP(*this, iface, (WORD)args.GetOptionString('x').AsUnsigned());
+  if (!StartListener(listener)) {
+    cerr << "Could not open H.323 listener on " << iface << endl;
+    return FALSE;
+  }
+
+  PIPSocket::Address addr;
+  if (!listener->GetTransportAddress().GetIpAndPort(addr, listenerPort)) {
+    cerr << "Could not get the H.323 listener port" << endl;
+    return FALSE;
+  }
+
+  cout << "Endpoint listening on " << iface << ':' << listenerPort
+       << ", calls are " << (answer == H323Connection::AnswerCallNow ? "answered" : "rejected") << '\n'
+       << "H245Tunnelling is " << (IsH245TunnelingDisabled() ? "Dis" : "En") << "abled\n" << endl;
+
+  return TRUE;
+}
+
+
+void PcapReplayEndPoint::PrintStatistics(ostream & strm) const
+{
+  PWaitAndSignal mutex(statsMutex);
+
+  strm << "  Calls created:           " << created << '\n'
+       << "  Calls established:       " << established << '\n';
+
+  for (std::map<H323Connection::CallEndReason, unsigned>::const_iterator it = cleared.begin(); it != cleared.end(); ++it)
+    strm << "    " << it->first << ": " << it->second << '\n';
+}
+
+
+H323Connection * PcapReplayEndPoint::CreateConnection(unsigned callReference)
+{
+  PWaitAndSignal mutex(statsMutex);
+  created++;
+  return new PcapReplayConnection(*this, callReference);
+}
+
+
+H323Connection::AnswerCallResponse
+                   PcapReplayEndPoint::OnAnswerCall(H323Connection &,
+                                                    const PString &,
+                                                    const H323SignalPDU &,
+                                                    H323SignalPDU &)
+{
+  return answer;
+}
+
+
+void PcapReplayEndPoint::OnConnectionEstablished(H323Connection &, const PString &)
+{
+  PWaitAndSignal mutex(statsMutex);
+  established++;
+}
+
+
+void PcapReplayEndPoint::OnConnectionCleared(H323Connection & connection, const PString &)
+{
+  PWaitAndSignal mutex(statsMutex);
+  cleared[connection.GetCallEndReason()]++;
+}
+
+
+///////////////////////////////////////////////////////////////
+
+PcapReplayConnection::PcapReplayConnection(PcapReplayEndPoint & ep, unsigned callReference)
+  : H323Connection(ep, callReference)
+{
+}
+
+
+PBoolean PcapReplayConnection::StartControlChannel(const H225_TransportAddress &)
+{
+  // The H.245 address is one in the capture
+  PTRACE(3, "Replay\tNot connecting separate H.245 channel of replayed call");
+  return FALSE;
+}
+
+
+H323Channel * PcapReplayConnection::CreateRealTimeLogicalChannel(const H323Capability &,
+                                                                 H323Channel::Directions,
+                                                                 unsigned,
+                                                                 const H245_H2250LogicalChannelParameters *,
+                                                                 RTP_QOS *)
+{
+  // The media addresses are ones in the capture
+  PTRACE(3, "Replay\tNot opening media channel of replayed call");
+  return NULL;
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
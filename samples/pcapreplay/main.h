@@ -0,0 +1,311 @@
+/*
+ * main.h
+ *
+ * Replay of captured H.323 signalling and media against an endpoint.
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#ifndef _PcapReplay_MAIN_H
+#define _PcapReplay_MAIN_H
+
+#include <h323.h>
+#include <rtphist.h>
+
+#include <map>
+#include <vector>
+
+#if PTLIB_VER < 2130
+#if !defined(P_USE_STANDARD_CXX_BOOL) && !defined(P_USE_INTEGER_BOOL)
+    typedef int PBoolean;
+#endif
+#endif
+
+
+/**An IPv4 TCP or UDP packet read from a capture.
+  */
+class PcapPacket
+{
+  public:
+    PcapPacket();
+
+    enum {
+      TCP_FIN = 0x01,
+      TCP_SYN = 0x02,
+      TCP_RST = 0x04,
+      TCP_ACK = 0x10
+    };
+
+    PInt64             time;      // Microseconds since the epoch
+    BYTE               protocol;  // IP protocol, 6 or 17
+    PIPSocket::Address srcAddr;
+    WORD               srcPort;
+    PIPSocket::Address dstAddr;
+    WORD               dstPort;
+    DWORD              tcpSeq;
+    BYTE               tcpFlags;
+    PBYTEArray         payload;
+};
+
+
+/**Reader of the classic libpcap file format, in microsecond or nanosecond
+   resolution and either byte order. Only IPv4 over Ethernet (with VLAN
+   tags), Linux cooked, BSD loopback and raw IP captures are understood,
+   other packets, and IP fragments, are skipped.
+  */
+class PcapReader
+{
+  public:
+    PcapReader();
+
+    PBoolean Open(const PFilePath & filename);
+
+    /**Read the next TCP or UDP packet, FALSE at the end of the file.
+      */
+    PBoolean ReadPacket(PcapPacket & packet);
+
+    PINDEX GetSkippedCount() const { return skipped; }
+
+  protected:
+    DWORD Get32(const BYTE * ptr) const;
+    PBoolean DecodeIP(const BYTE * ptr, PINDEX len, PcapPacket & packet);
+
+    PFile    file;
+    PBoolean swapped;
+    PBoolean nanoseconds;
+    DWORD    linkType;
+    PINDEX   skipped;
+};
+
+
+/**One packet to send during the replay, at its time in the capture.
+  */
+struct ReplayEvent
+{
+  enum Kind {
+    e_Signal,   // TPKT from the client of a call signalling flow
+    e_RAS,      // RAS request
+    e_RTP       // RTP or RTCP packet
+  };
+
+  PInt64     time;    // Microseconds from the start of the capture
+  Kind       kind;
+  PINDEX     flow;
+  PBYTEArray data;
+
+  bool operator<(const ReplayEvent & other) const { return time < other.time; }
+};
+
+
+/**A call signalling TCP connection of the capture. The client half is sent
+   to the replay endpoint, the Q.931 messages of the server half are what
+   the endpoint is expected to answer.
+  */
+class SignalFlow
+{
+  public:
+    SignalFlow(const PString & name);
+    ~SignalFlow();
+
+    struct Direction {
+      Direction() : started(FALSE), lost(FALSE), nextSeq(0) { }
+
+      PBoolean   started;
+      PBoolean   lost;      // Segment missing from the capture, rest ignored
+      DWORD      nextSeq;
+      PBYTEArray buffer;
+    };
+
+    /**Add the payload of a segment, returning the TPKTs it completed.
+      */
+    void AddSegment(Direction & dir, const PcapPacket & packet, PList<PBYTEArray> & tpkts);
+
+    PString   name;
+    PBoolean  known;        // Client side determined
+    PIPSocket::Address clientAddr;
+    WORD      clientPort;
+    Direction client;
+    Direction server;
+    PBoolean  notTPKT;
+
+    PBoolean IsDamaged() const { return client.lost || server.lost || notTPKT; }
+
+    std::vector<PString> expected;  // Call state messages the captured server sent
+
+    // Replay state
+    PTCPSocket * socket;
+    PThread    * reader;
+    PMutex       mutex;
+    std::vector<PString> received;  // Call state messages the endpoint sent
+    PINDEX       messages;      // Q.931 messages of any type the endpoint sent
+    PInt64       lastSent;      // Microseconds, zero once answered
+    PBoolean     failed;
+};
+
+
+/**A UDP flow of RTP or RTCP packets, replayed to a local receiver or to a
+   target given on the command line.
+  */
+class MediaFlow
+{
+  public:
+    MediaFlow(const PString & name);
+    ~MediaFlow();
+
+    PString     name;
+    PUDPSocket * socket;
+    PUDPSocket * receiver;
+    PThread    * reader;
+    PINDEX      sent;
+    PINDEX      received;
+    PInt64      lastTransit;  // Microseconds, -1 before the first packet
+    double      jitter;       // Microseconds, as RFC 3550 does it
+    PMutex      mutex;
+    std::map<WORD, PInt64> scheduled;  // Sequence number to time it was due
+};
+
+
+class PcapReplayEndPoint : public H323EndPoint
+{
+  PCLASSINFO(PcapReplayEndPoint, H323EndPoint);
+
+  public:
+    PcapReplayEndPoint();
+
+    // overrides from H323EndPoint
+    virtual H323Connection * CreateConnection(unsigned callReference);
+    virtual H323Connection::AnswerCallResponse OnAnswerCall(H323Connection &, const PString &, const H323SignalPDU &, H323SignalPDU &);
+    virtual void OnConnectionEstablished(H323Connection & connection, const PString & token);
+    virtual void OnConnectionCleared(H323Connection & connection, const PString & clearedCallToken);
+
+    // New functions
+    PBoolean Initialise(PArgList &);
+
+    WORD GetListenerPort() const { return listenerPort; }
+    const PIPSocket::Address & GetInterface() const { return iface; }
+
+    void PrintStatistics(ostream & strm) const;
+
+  protected:
+    PIPSocket::Address iface;
+    WORD listenerPort;
+    H323Connection::AnswerCallResponse answer;
+
+    mutable PMutex statsMutex;
+    unsigned created;
+    unsigned established;
+    std::map<H323Connection::CallEndReason, unsigned> cleared;
+};
+
+
+/**Connection that never opens a channel or connection to an address taken
+   from the capture, so a replay cannot send anything off the host.
+  */
+class PcapReplayConnection : public H323Connection
+{
+    PCLASSINFO(PcapReplayConnection, H323Connection);
+
+  public:
+    PcapReplayConnection(PcapReplayEndPoint &, unsigned);
+
+    virtual PBoolean StartControlChannel(const H225_TransportAddress & h245Address);
+    virtual H323Channel * CreateRealTimeLogicalChannel(const H323Capability & capability,
+                                                       H323Channel::Directions dir,
+                                                       unsigned sessionID,
+                                                       const H245_H2250LogicalChannelParameters * param,
+                                                       RTP_QOS * rtpqos = NULL);
+};
+
+
+class PcapReplayProcess : public PProcess
+{
+  PCLASSINFO(PcapReplayProcess, PProcess)
+
+  public:
+    PcapReplayProcess();
+    ~PcapReplayProcess();
+
+    void Main();
+
+    /**Get the CPU time used by every thread of the process.
+      */
+    static PInt64 GetCPUMicroseconds();
+
+  protected:
+    PBoolean Load(const PFilePath & filename);
+    void LoadTCP(const PcapPacket & packet, PInt64 when);
+    void LoadUDP(const PcapPacket & packet, PInt64 when);
+    PBoolean OpenRAS(const PString & target);
+    void RewriteRAS(H323RasPDU & pdu) const;
+    void Replay(PArgList & args);
+    void SendSignal(const ReplayEvent & event);
+    void SendRAS(const ReplayEvent & event);
+    void SendRTP(const ReplayEvent & event, PInt64 due);
+    void Shutdown();
+    void PrintStatistics(ostream & strm, const PTimeInterval & elapsed, PInt64 cpuMicroseconds, PBoolean verbose);
+
+    PDECLARE_NOTIFIER(PThread, PcapReplayProcess, ReadSignal);
+    PDECLARE_NOTIFIER(PThread, PcapReplayProcess, ReadRAS);
+    PDECLARE_NOTIFIER(PThread, PcapReplayProcess, ReadRTP);
+
+    PcapReplayEndPoint * endpoint;
+
+    WORD signalPort;
+    WORD rasPort;
+    PIPSocket::Address rtpTarget;
+    WORD rtpTargetPort;
+
+    std::vector<ReplayEvent>      events;
+    std::vector<SignalFlow *>     signalFlows;
+    std::vector<MediaFlow *>      mediaFlows;
+    std::map<PString, PINDEX>     signalIndex;  // Flow name to index
+    std::map<PString, PINDEX>     mediaIndex;
+    PINDEX packetCount;
+    PINDEX tcpOther;
+    PINDEX udpOther;
+    PINDEX rasRequests;
+    std::map<PString, unsigned> rasCaptured;  // Response type in the capture to count
+
+    PUDPSocket       * rasSocket;
+    PIPSocket::Address rasTargetAddr;
+    WORD               rasTargetPort;
+    PThread          * rasReader;
+    PMutex             rasMutex;
+    std::map<unsigned, PInt64> rasPending;    // Sequence number to time sent
+    std::map<PString, unsigned> rasResponses; // Response type to count
+    PINDEX             rasSent;
+    PINDEX             rasUndecodable;
+
+    mutable PMutex latencyMutex;
+    RTP_Histogram signalLatency;  // Microseconds from a PDU sent to the answer
+    RTP_Histogram rasLatency;
+    PINDEX lateEvents;
+    PInt64 maxLateness;
+    PBoolean shuttingDown;
+};
+
+
+#endif  // _PcapReplay_MAIN_H
+
+
+// End of File ///////////////////////////////////////////////////////////////
@@ -0,0 +1,775 @@
+/*
+ * main.cxx
+ *
+ * ASN.1 PER encode and decode benchmark for H.225 and H.245 PDUs.
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#define H323_STATIC_LIB
+#endif
+
+#include "main.h"
+#include "../../version.h"
+
+#include <h501.h>
+#include <h323perstream.h>
+#include <new>
+#include <stdlib.h>
+
+
+///////////////////////////////////////////////////////////////
+
+// Allocations are counted by replacing the global operator new, which
+// PTLib already does itself when built with memory checking.
+#if !PMEMORY_CHECK
+
+#define PERBENCH_COUNT_ALLOCATIONS 1
+
+#ifdef _MSC_VER
+static __declspec(thread) unsigned long allocationCount;
+#else
+static __thread unsigned long allocationCount;
+#endif
+
+void * operator new(size_t size)
+{
+  allocationCount++;
+  void * ptr = malloc(size > 0 ? size : 1);
+  if (ptr == NULL)
+    throw std::bad_alloc();
+  return ptr;
+}
+
+
+void * operator new[](size_t size)
+{
+  allocationCount++;
+  void * ptr = malloc(size > 0 ? size : 1);
+  if (ptr == NULL)
+    throw std::bad_alloc();
+  return ptr;
+}
+
+
+void operator delete(void * ptr) throw()
+{
+  free(ptr);
+}
+
+
+void operator delete[](void * ptr) throw()
+{
+  free(ptr);
+}
+
+#define GetAllocationCount() allocationCount
+
+#else
+
+#define GetAllocationCount() 0UL
+
+#endif // !PMEMORY_CHECK
+
+
+#define new PNEW
+
+PCREATE_PROCESS(PerBenchProcess);
+
+
+///////////////////////////////////////////////////////////////
+
+template <class PDU> static PASN_Object * CreatePDU()
+{
+  return new PDU;
+}
+
+
+template <class PDU> static void AddPDU(PerBenchCorpus & corpus, const char * name, const PDU & pdu)
+{
+  PerBenchPDU entry;
+  entry.name = name;
+  entry.create = CreatePDU<PDU>;
+
+  PPER_Stream strm;
+  pdu.Encode(strm);
+  strm.CompleteEncoding();
+  entry.encoded = strm;
+
+  corpus.push_back(entry);
+}
+
+
+static const struct {
+  const char *               extension;
+  PerBenchPDU::CreateFunction create;
+} CorpusTypes[] = {
+  { ".h225", CreatePDU<H225_H323_UserInformation> },
+  { ".ras",  CreatePDU<H225_RasMessage> },
+  { ".h245", CreatePDU<H245_MultimediaSystemControlMessage> },
+  { ".h501", CreatePDU<H501_Message> }
+};
+
+
+static void SetVendor(H225_VendorIdentifier & vendor)
+{
+  vendor.m_vendor.m_t35CountryCode = 9;
+  vendor.m_vendor.m_t35Extension = 0;
+  vendor.m_vendor.m_manufacturerCode = 61;
+  vendor.IncludeOptionalField(H225_VendorIdentifier::e_productId);
+  vendor.m_productId = PString("H323Plus");
+  vendor.IncludeOptionalField(H225_VendorIdentifier::e_versionId);
+  vendor.m_versionId = PString("1.28.0");
+}
+
+
+static void AddFeature(H225_ArrayOf_FeatureDescriptor & features, unsigned feature, unsigned parameters)
+{
+  PINDEX last = features.GetSize();
+  features.SetSize(last+1);
+  H225_FeatureDescriptor & desc = features[last];
+
+  desc.m_id.SetTag(H225_GenericIdentifier::e_standard);
+  (PASN_Integer &)desc.m_id = feature;
+
+  if (parameters == 0)
+    return;
+
+  desc.IncludeOptionalField(H225_GenericData::e_parameters);
+  desc.m_parameters.SetSize(parameters);
+  for (unsigned i = 0; i < parameters; i++) {
+    H225_EnumeratedParameter & param = desc.m_parameters[i];
+    param.m_id.SetTag(H225_GenericIdentifier::e_standard);
+    (PASN_Integer &)param.m_id = i+1;
+    param.IncludeOptionalField(H225_EnumeratedParameter::e_content);
+    param.m_content.SetTag(H225_Content::e_number32);
+    (PASN_Integer &)param.m_content = 1000*(i+1);
+  }
+}
+
+
+static void SetAudio(H245_DataType & dataType, unsigned tag)
+{
+  dataType.SetTag(H245_DataType::e_audioData);
+  H245_AudioCapability & audio = dataType;
+  audio.SetTag(tag);
+  (PASN_Integer &)audio = 20;
+}
+
+
+static void AddFastStartChannel(H225_ArrayOf_PASN_OctetString & fastStart, unsigned channel, unsigned audioTag, PBoolean transmit)
+{
+  H245_OpenLogicalChannel open;
+  open.m_forwardLogicalChannelNumber = channel;
+
+  H245_OpenLogicalChannel_forwardLogicalChannelParameters & fwd = open.m_forwardLogicalChannelParameters;
+
+  if (transmit) {
+    SetAudio(fwd.m_dataType, audioTag);
+    fwd.m_multiplexParameters.SetTag(H245_OpenLogicalChannel_forwardLogicalChannelParameters_multiplexParameters::e_h2250LogicalChannelParameters);
+    H245_H2250LogicalChannelParameters & param = fwd.m_multiplexParameters;
+    param.m_sessionID = 1;
+    param.IncludeOptionalField(H245_H2250LogicalChannelParameters::e_mediaControlChannel);
+    H323TransportAddress("ip$192.168.1.10:5001").SetPDU(param.m_mediaControlChannel);
+  }
+  else {
+    fwd.m_dataType.SetTag(H245_DataType::e_nullData);
+    fwd.m_multiplexParameters.SetTag(H245_OpenLogicalChannel_forwardLogicalChannelParameters_multiplexParameters::e_none);
+
+    open.IncludeOptionalField(H245_OpenLogicalChannel::e_reverseLogicalChannelParameters);
+    H245_OpenLogicalChannel_reverseLogicalChannelParameters & rev = open.m_reverseLogicalChannelParameters;
+    SetAudio(rev.m_dataType, audioTag);
+    rev.IncludeOptionalField(H245_OpenLogicalChannel_reverseLogicalChannelParameters::e_multiplexParameters);
+    rev.m_multiplexParameters.SetTag(H245_OpenLogicalChannel_reverseLogicalChannelParameters_multiplexParameters::e_h2250LogicalChannelParameters);
+    H245_H2250LogicalChannelParameters & param = rev.m_multiplexParameters;
+    param.m_sessionID = 1;
+    param.IncludeOptionalField(H245_H2250LogicalChannelParameters::e_mediaChannel);
+    H323TransportAddress("ip$192.168.1.10:5000").SetPDU(param.m_mediaChannel);
+    param.IncludeOptionalField(H245_H2250LogicalChannelParameters::e_mediaControlChannel);
+    H323TransportAddress("ip$192.168.1.10:5001").SetPDU(param.m_mediaControlChannel);
+  }
+
+  PINDEX last = fastStart.GetSize();
+  fastStart.SetSize(last+1);
+  fastStart[last].EncodeSubType(open);
+}
+
+
+static void BuildSetup(PerBenchCorpus & corpus)
+{
+  H225_H323_UserInformation uu;
+  H225_H323_UU_PDU & uupdu = uu.m_h323_uu_pdu;
+  uupdu.m_h323_message_body.SetTag(H225_H323_UU_PDU_h323_message_body::e_setup);
+  uupdu.IncludeOptionalField(H225_H323_UU_PDU::e_h245Tunneling);
+  uupdu.m_h245Tunneling = TRUE;
+
+  H225_Setup_UUIE & setup = uupdu.m_h323_message_body;
+  setup.m_protocolIdentifier.SetValue("0.0.8.2250.0.6");
+
+  PStringArray source;
+  source.AppendString("alice");
+  source.AppendString("1001");
+  setup.IncludeOptionalField(H225_Setup_UUIE::e_sourceAddress);
+  H323SetAliasAddresses(source, setup.m_sourceAddress);
+
+  setup.m_sourceInfo.IncludeOptionalField(H225_EndpointType::e_vendor);
+  SetVendor(setup.m_sourceInfo.m_vendor);
+  setup.m_sourceInfo.IncludeOptionalField(H225_EndpointType::e_terminal);
+
+  setup.IncludeOptionalField(H225_Setup_UUIE::e_destinationAddress);
+  setup.m_destinationAddress.SetSize(1);
+  H323SetAliasAddress(PString("bob"), setup.m_destinationAddress[0]);
+
+  setup.IncludeOptionalField(H225_Setup_UUIE::e_destCallSignalAddress);
+  H323TransportAddress("ip$192.168.1.20:1720").SetPDU(setup.m_destCallSignalAddress);
+  setup.IncludeOptionalField(H225_Setup_UUIE::e_sourceCallSignalAddress);
+  H323TransportAddress("ip$192.168.1.10:1720").SetPDU(setup.m_sourceCallSignalAddress);
+
+  setup.m_conferenceID = OpalGUID();
+  setup.m_conferenceGoal.SetTag(H225_Setup_UUIE_conferenceGoal::e_create);
+  setup.m_callType.SetTag(H225_CallType::e_pointToPoint);
+  setup.IncludeOptionalField(H225_Setup_UUIE::e_callIdentifier);
+  setup.m_callIdentifier.m_guid = OpalGUID();
+  setup.m_mediaWaitForConnect = FALSE;
+  setup.m_canOverlapSend = FALSE;
+
+  // G.711 u-law, A-law and G.729, each proposed to transmit and receive
+  static const unsigned Codecs[] = {
+    H245_AudioCapability::e_g711Ulaw64k,
+    H245_AudioCapability::e_g711Alaw64k,
+    H245_AudioCapability::e_g729
+  };
+  setup.IncludeOptionalField(H225_Setup_UUIE::e_fastStart);
+  unsigned channel = 101;
+  for (PINDEX i = 0; i < PARRAYSIZE(Codecs); i++) {
+    AddFastStartChannel(setup.m_fastStart, channel++, Codecs[i], TRUE);
+    AddFastStartChannel(setup.m_fastStart, channel++, Codecs[i], FALSE);
+  }
+
+  // H.460.18 and H.460.19 as a NAT traversal client sends them
+  setup.IncludeOptionalField(H225_Setup_UUIE::e_supportedFeatures);
+  AddFeature(setup.m_supportedFeatures, 18, 0);
+  AddFeature(setup.m_supportedFeatures, 19, 2);
+
+  AddPDU(corpus, "Setup with fastStart", uu);
+}
+
+
+static void SetGenericCapability(H245_GenericCapability & cap, const char * oid, unsigned maxBitRate, unsigned param, unsigned value)
+{
+  cap.m_capabilityIdentifier.SetTag(H245_CapabilityIdentifier::e_standard);
+  ((PASN_ObjectId &)cap.m_capabilityIdentifier).SetValue(oid);
+  cap.IncludeOptionalField(H245_GenericCapability::e_maxBitRate);
+  cap.m_maxBitRate = maxBitRate;
+
+  cap.IncludeOptionalField(H245_GenericCapability::e_collapsing);
+  cap.m_collapsing.SetSize(1);
+  H245_GenericParameter & gp = cap.m_collapsing[0];
+  gp.m_parameterIdentifier.SetTag(H245_ParameterIdentifier::e_standard);
+  (PASN_Integer &)gp.m_parameterIdentifier = param;
+  gp.m_parameterValue.SetTag(H245_ParameterValue::e_unsignedMin);
+  (PASN_Integer &)gp.m_parameterValue = value;
+}
+
+
+static void BuildCapabilitySet(PerBenchCorpus & corpus)
+{
+  H245_MultimediaSystemControlMessage msg;
+  msg.SetTag(H245_MultimediaSystemControlMessage::e_request);
+  H245_RequestMessage & request = msg;
+  request.SetTag(H245_RequestMessage::e_terminalCapabilitySet);
+  H245_TerminalCapabilitySet & tcs = request;
+
+  tcs.m_sequenceNumber = 1;
+  tcs.m_protocolIdentifier.SetValue("0.0.8.245.0.13");
+
+  tcs.IncludeOptionalField(H245_TerminalCapabilitySet::e_multiplexCapability);
+  tcs.m_multiplexCapability.SetTag(H245_MultiplexCapability::e_h2250Capability);
+  H245_H2250Capability & h225_0 = tcs.m_multiplexCapability;
+  h225_0.m_maximumAudioDelayJitter = 250;
+  h225_0.m_receiveMultipointCapability.m_mediaDistributionCapability.SetSize(1);
+  h225_0.m_transmitMultipointCapability.m_mediaDistributionCapability.SetSize(1);
+  h225_0.m_receiveAndTransmitMultipointCapability.m_mediaDistributionCapability.SetSize(1);
+  h225_0.m_t120DynamicPortCapability = TRUE;
+
+  // Audio entries are 1 to 14, video 15 to 27 and user input 28 to 30,
+  // close to what a video endpoint with a full set of codecs sends.
+  static const unsigned AudioCapabilities[] = {
+    H245_AudioCapability::e_g711Ulaw64k,
+    H245_AudioCapability::e_g711Alaw64k,
+    H245_AudioCapability::e_g722_64k,
+    H245_AudioCapability::e_g728,
+    H245_AudioCapability::e_g729,
+    H245_AudioCapability::e_g729AnnexA,
+    H245_AudioCapability::e_g729wAnnexB,
+    H245_AudioCapability::e_g729AnnexAwAnnexB
+  };
+  static const struct {
+    const char * oid;
+    unsigned     maxBitRate;
+  } GenericAudio[] = {
+    { "0.0.7.7221.1.0",   240 },   // G.722.1 24k
+    { "0.0.7.7221.1.0",   320 },   // G.722.1 32k
+    { "0.0.7.7221.1.1.0", 480 },   // G.722.1C
+    { "0.0.7.7222.1.0",   238 },   // G.722.2
+    { "0.0.8.245.1.1.1",  640 }    // G.711.1
+  };
+  static const unsigned H264Levels[] = { 29, 36, 43, 50, 57, 64, 71, 78, 85 };
+  static const unsigned UserInput[] = {
+    H245_UserInputCapability::e_basicString,
+    H245_UserInputCapability::e_dtmf,
+    H245_UserInputCapability::e_hookflash
+  };
+
+  PINDEX count = 0;
+  tcs.IncludeOptionalField(H245_TerminalCapabilitySet::e_capabilityTable);
+  tcs.m_capabilityTable.SetSize(30);
+
+  H245_AlternativeCapabilitySet audioSet, videoSet, userInputSet;
+
+  for (PINDEX i = 0; i < PARRAYSIZE(AudioCapabilities); i++) {
+    H245_CapabilityTableEntry & entry = tcs.m_capabilityTable[count++];
+    entry.m_capabilityTableEntryNumber = count;
+    entry.IncludeOptionalField(H245_CapabilityTableEntry::e_capability);
+    entry.m_capability.SetTag(H245_Capability::e_receiveAudioCapability);
+    H245_AudioCapability & audio = entry.m_capability;
+    audio.SetTag(AudioCapabilities[i]);
+    (PASN_Integer &)audio = 20;
+    audioSet.SetSize(audioSet.GetSize()+1);
+    audioSet[audioSet.GetSize()-1] = count;
+  }
+
+  {
+    H245_CapabilityTableEntry & entry = tcs.m_capabilityTable[count++];
+    entry.m_capabilityTableEntryNumber = count;
+    entry.IncludeOptionalField(H245_CapabilityTableEntry::e_capability);
+    entry.m_capability.SetTag(H245_Capability::e_receiveAudioCapability);
+    H245_AudioCapability & audio = entry.m_capability;
+    audio.SetTag(H245_AudioCapability::e_g7231);
+    H245_AudioCapability_g7231 & g7231 = audio;
+    g7231.m_maxAl_sduAudioFrames = 1;
+    g7231.m_silenceSuppression = FALSE;
+    audioSet.SetSize(audioSet.GetSize()+1);
+    audioSet[audioSet.GetSize()-1] = count;
+  }
+
+  for (PINDEX i = 0; i < PARRAYSIZE(GenericAudio); i++) {
+    H245_CapabilityTableEntry & entry = tcs.m_capabilityTable[count++];
+    entry.m_capabilityTableEntryNumber = count;
+    entry.IncludeOptionalField(H245_CapabilityTableEntry::e_capability);
+    entry.m_capability.SetTag(H245_Capability::e_receiveAudioCapability);
+    H245_AudioCapability & audio = entry.m_capability;
+    audio.SetTag(H245_AudioCapability::e_genericAudioCapability);
+    SetGenericCapability(audio, GenericAudio[i].oid, GenericAudio[i].maxBitRate, 1, GenericAudio[i].maxBitRate*100);
+    audioSet.SetSize(audioSet.GetSize()+1);
+    audioSet[audioSet.GetSize()-1] = count;
+  }
+
+  {
+    H245_CapabilityTableEntry & entry = tcs.m_capabilityTable[count++];
+    entry.m_capabilityTableEntryNumber = count;
+    entry.IncludeOptionalField(H245_CapabilityTableEntry::e_capability);
+    entry.m_capability.SetTag(H245_Capability::e_receiveVideoCapability);
+    H245_VideoCapability & video = entry.m_capability;
+    video.SetTag(H245_VideoCapability::e_h261VideoCapability);
+    H245_H261VideoCapability & h261 = video;
+    h261.IncludeOptionalField(H245_H261VideoCapability::e_qcifMPI);
+    h261.m_qcifMPI = 1;
+    h261.IncludeOptionalField(H245_H261VideoCapability::e_cifMPI);
+    h261.m_cifMPI = 1;
+    h261.m_maxBitRate = 3840;
+    videoSet.SetSize(videoSet.GetSize()+1);
+    videoSet[videoSet.GetSize()-1] = count;
+  }
+
+  {
+    H245_CapabilityTableEntry & entry = tcs.m_capabilityTable[count++];
+    entry.m_capabilityTableEntryNumber = count;
+    entry.IncludeOptionalField(H245_CapabilityTableEntry::e_capability);
+    entry.m_capability.SetTag(H245_Capability::e_receiveVideoCapability);
+    H245_VideoCapability & video = entry.m_capability;
+    video.SetTag(H245_VideoCapability::e_h263VideoCapability);
+    H245_H263VideoCapability & h263 = video;
+    h263.IncludeOptionalField(H245_H263VideoCapability::e_sqcifMPI);
+    h263.m_sqcifMPI = 1;
+    h263.IncludeOptionalField(H245_H263VideoCapability::e_qcifMPI);
+    h263.m_qcifMPI = 1;
+    h263.IncludeOptionalField(H245_H263VideoCapability::e_cifMPI);
+    h263.m_cifMPI = 1;
+    h263.IncludeOptionalField(H245_H263VideoCapability::e_cif4MPI);
+    h263.m_cif4MPI = 2;
+    h263.m_maxBitRate = 7680;
+    videoSet.SetSize(videoSet.GetSize()+1);
+    videoSet[videoSet.GetSize()-1] = count;
+  }
+
+  for (PINDEX i = 0; i < PARRAYSIZE(H264Levels); i++) {
+    H245_CapabilityTableEntry & entry = tcs.m_capabilityTable[count++];
+    entry.m_capabilityTableEntryNumber = count;
+    entry.IncludeOptionalField(H245_CapabilityTableEntry::e_capability);
+    entry.m_capability.SetTag(H245_Capability::e_receiveVideoCapability);
+    H245_VideoCapability & video = entry.m_capability;
+    video.SetTag(H245_VideoCapability::e_genericVideoCapability);
+    SetGenericCapability(video, "0.0.8.241.0.0.1", 20480, 42, H264Levels[i]);
+    videoSet.SetSize(videoSet.GetSize()+1);
+    videoSet[videoSet.GetSize()-1] = count;
+  }
+
+  for (PINDEX i = 0; i < PARRAYSIZE(UserInput); i++) {
+    H245_CapabilityTableEntry & entry = tcs.m_capabilityTable[count++];
+    entry.m_capabilityTableEntryNumber = count;
+    entry.IncludeOptionalField(H245_CapabilityTableEntry::e_capability);
+    entry.m_capability.SetTag(H245_Capability::e_receiveUserInputCapability);
+    ((H245_UserInputCapability &)entry.m_capability).SetTag(UserInput[i]);
+    userInputSet.SetSize(userInputSet.GetSize()+1);
+    userInputSet[userInputSet.GetSize()-1] = count;
+  }
+
+  PAssert(count == 30, PLogicError);
+
+  tcs.IncludeOptionalField(H245_TerminalCapabilitySet::e_capabilityDescriptors);
+  tcs.m_capabilityDescriptors.SetSize(1);
+  H245_CapabilityDescriptor & desc = tcs.m_capabilityDescriptors[0];
+  desc.m_capabilityDescriptorNumber = 0;
+  desc.IncludeOptionalField(H245_CapabilityDescriptor::e_simultaneousCapabilities);
+  desc.m_simultaneousCapabilities.SetSize(3);
+  desc.m_simultaneousCapabilities[0] = audioSet;
+  desc.m_simultaneousCapabilities[1] = videoSet;
+  desc.m_simultaneousCapabilities[2] = userInputSet;
+
+  AddPDU(corpus, "TerminalCapabilitySet (30)", msg);
+}
+
+
+static void BuildRegistrationRequest(PerBenchCorpus & corpus)
+{
+  H225_RasMessage ras;
+  ras.SetTag(H225_RasMessage::e_registrationRequest);
+  H225_RegistrationRequest & rrq = ras;
+
+  rrq.m_requestSeqNum = 1234;
+  rrq.m_protocolIdentifier.SetValue("0.0.8.2250.0.6");
+  rrq.m_discoveryComplete = FALSE;
+
+  rrq.m_callSignalAddress.SetSize(1);
+  H323TransportAddress("ip$192.168.1.10:1720").SetPDU(rrq.m_callSignalAddress[0]);
+  rrq.m_rasAddress.SetSize(1);
+  H323TransportAddress("ip$192.168.1.10:1719").SetPDU(rrq.m_rasAddress[0]);
+
+  rrq.m_terminalType.IncludeOptionalField(H225_EndpointType::e_vendor);
+  SetVendor(rrq.m_terminalType.m_vendor);
+  rrq.m_terminalType.IncludeOptionalField(H225_EndpointType::e_terminal);
+
+  PStringArray aliases;
+  aliases.AppendString("alice");
+  aliases.AppendString("1001");
+  rrq.IncludeOptionalField(H225_RegistrationRequest::e_terminalAlias);
+  H323SetAliasAddresses(aliases, rrq.m_terminalAlias);
+
+  SetVendor(rrq.m_endpointVendor);
+
+  rrq.IncludeOptionalField(H225_RegistrationRequest::e_timeToLive);
+  rrq.m_timeToLive = 300;
+  rrq.IncludeOptionalField(H225_RegistrationRequest::e_keepAlive);
+  rrq.m_keepAlive = FALSE;
+  rrq.IncludeOptionalField(H225_RegistrationRequest::e_willSupplyUUIEs);
+  rrq.m_willSupplyUUIEs = FALSE;
+  rrq.IncludeOptionalField(H225_RegistrationRequest::e_multipleCalls);
+  rrq.m_multipleCalls = FALSE;
+  rrq.IncludeOptionalField(H225_RegistrationRequest::e_maintainConnection);
+  rrq.m_maintainConnection = FALSE;
+
+  // H.460.9, .18, .19, .23, .24 and presence, as a full featured client
+  rrq.IncludeOptionalField(H225_RegistrationRequest::e_featureSet);
+  rrq.m_featureSet.m_replacementFeatureSet = FALSE;
+  rrq.m_featureSet.IncludeOptionalField(H225_FeatureSet::e_supportedFeatures);
+  AddFeature(rrq.m_featureSet.m_supportedFeatures, 9, 0);
+  AddFeature(rrq.m_featureSet.m_supportedFeatures, 18, 0);
+  AddFeature(rrq.m_featureSet.m_supportedFeatures, 19, 2);
+  AddFeature(rrq.m_featureSet.m_supportedFeatures, 23, 4);
+  AddFeature(rrq.m_featureSet.m_supportedFeatures, 24, 1);
+  AddFeature(rrq.m_featureSet.m_supportedFeatures, 26, 0);
+
+  AddPDU(corpus, "RRQ with H.460", ras);
+}
+
+
+///////////////////////////////////////////////////////////////
+
+PerBenchProcess::PerBenchProcess()
+  : PProcess("H323Plus", "perbench", MAJOR_VERSION, MINOR_VERSION, BUILD_TYPE, BUILD_NUMBER)
+{
+}
+
+
+void PerBenchProcess::Main()
+{
+  cout << GetName()
+       << " Version " << GetVersion(TRUE)
+       << " by " << GetManufacturer()
+       << " on " << GetOSClass() << ' ' << GetOSName()
+       << " (" << GetOSVersion() << '-' << GetOSHardware() << ")\n\n";
+
+  // Get and parse all of the command line arguments.
+  PArgList & args = GetArguments();
+  args.Parse(
+             "c-corpus:"
+             "h-help."
+             "n-iterations:"
+             "s-stream:"
+#if PTRACING
+             "o-output:"
+             "t-trace."
+#endif
+             "w-write:"
+          , FALSE);
+
+  if (args.HasOption('h')) {
+    cout << "Usage : " << GetName() << " [options]\n"
+            "Options:\n"
+            "  -n --iterations n       : Times each PDU is encoded and decoded (default 10000).\n"
+            "  -c --corpus dir         : Use the captured PDUs in dir, named *.h225, *.ras, *.h245\n"
+            "                            or *.h501, instead of the built in corpus.\n"
+            "  -s --stream type        : PER stream to time, ptlib for PPER_Stream or word for\n"
+            "                            H323_PERStream (default word).\n"
+            "  -w --write dir          : Write the built in corpus to dir and exit.\n"
+#if PTRACING
+            "  -t --trace              : Enable trace, use multiple times for more detail.\n"
+            "  -o --output             : File for trace output, default is stderr.\n"
+#endif
+            "  -h --help               : This help message.\n"
+            << endl;
+    return;
+  }
+
+#if PTRACING
+  PTrace::Initialise(args.GetOptionCount('t'),
+                     args.HasOption('o') ? (const char *)args.GetOptionString('o') : NULL,
+                     PTrace::DateAndTime | PTrace::TraceLevel | PTrace::FileAndLine);
+#endif
+
+  PerBenchCorpus corpus;
+  if (args.HasOption('c')) {
+    if (!LoadCorpus(args.GetOptionString('c'), corpus))
+      return;
+  }
+  else
+    BuildCorpus(corpus);
+
+  if (args.HasOption('w')) {
+    SaveCorpus(args.GetOptionString('w'), corpus);
+    return;
+  }
+
+  unsigned iterations = args.GetOptionString('n', "10000").AsUnsigned();
+  if (iterations == 0)
+    iterations = 1;
+
+  PString stream = args.GetOptionString('s', "word");
+  if (stream != "ptlib" && stream != "word") {
+    cerr << "Unknown PER stream " << stream << endl;
+    return;
+  }
+
+  cout << "Iterations: " << iterations << '\n'
+       << "Stream:     " << (stream == "ptlib" ? "PPER_Stream" : "H323_PERStream") << '\n';
+#ifndef PERBENCH_COUNT_ALLOCATIONS
+  cout << "Allocations are not counted in builds with memory checking\n";
+#endif
+  cout << '\n'
+       << setw(30) << left << "PDU" << right
+       << setw(7)  << "bytes"
+       << setw(12) << "encode ns"
+       << setw(10) << "allocs"
+       << setw(12) << "decode ns"
+       << setw(10) << "allocs" << '\n';
+
+  for (size_t i = 0; i < corpus.size(); i++) {
+    if (stream == "ptlib")
+      Run<PPER_Stream>(corpus[i], iterations);
+    else
+      Run<H323_PERStream>(corpus[i], iterations);
+  }
+}
+
+
+void PerBenchProcess::BuildCorpus(PerBenchCorpus & corpus)
+{
+  BuildSetup(corpus);
+  BuildCapabilitySet(corpus);
+  BuildRegistrationRequest(corpus);
+}
+
+
+PBoolean PerBenchProcess::LoadCorpus(const PDirectory & dir, PerBenchCorpus & corpus)
+{
+  PDirectory scan = dir;
+  if (!scan.Open()) {
+    cerr << "Could not open corpus directory " << dir << endl;
+    return FALSE;
+  }
+
+  do {
+    PFilePath path = scan + scan.GetEntryName();
+    PString type = path.GetType();
+    PINDEX t;
+    for (t = 0; t < PARRAYSIZE(CorpusTypes); t++) {
+      if (type *= CorpusTypes[t].extension)
+        break;
+    }
+    if (t >= PARRAYSIZE(CorpusTypes))
+      continue;
+
+    PFile file;
+    if (!file.Open(path, PFile::ReadOnly)) {
+      cerr << "Could not open " << path << endl;
+      continue;
+    }
+
+    PerBenchPDU entry;
+    entry.name = path.GetFileName();
+    entry.create = CorpusTypes[t].create;
+    if (!file.Read(entry.encoded.GetPointer((PINDEX)file.GetLength()), (PINDEX)file.GetLength())) {
+      cerr << "Could not read " << path << endl;
+      continue;
+    }
+    corpus.push_back(entry);
+  } while (scan.Next());
+
+  if (corpus.empty()) {
+    cerr << "No PDUs found in " << dir << endl;
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+
+PBoolean PerBenchProcess::SaveCorpus(const PDirectory & dir, const PerBenchCorpus & corpus)
+{
+  if (!dir.Exists() && !dir.Create()) {
+    cerr << "Could not create " << dir << endl;
+    return FALSE;
+  }
+
+  for (size_t i = 0; i < corpus.size(); i++) {
+    const PerBenchPDU & entry = corpus[i];
+
+    const char * extension = NULL;
+    for (PINDEX t = 0; t < PARRAYSIZE(CorpusTypes); t++) {
+      if (CorpusTypes[t].create == entry.create)
+        extension = CorpusTypes[t].extension;
+    }
+
+    PString name = entry.name;
+    name.Replace(" ", "_", TRUE);
+    name.Replace("(", "", TRUE);
+    name.Replace(")", "", TRUE);
+    name.Replace(".", "", TRUE);
+
+    PFile file;
+    PFilePath path = dir + name + extension;
+    if (!file.Open(path, PFile::WriteOnly) || !file.Write(entry.encoded, entry.encoded.GetSize())) {
+      cerr << "Could not write " << path << endl;
+      return FALSE;
+    }
+    cout << "Wrote " << path << endl;
+  }
+
+  return TRUE;
+}
+
+
+template <class Stream> void PerBenchProcess::Run(const PerBenchPDU & pdu, unsigned iterations)
+{
+  cout << setw(30) << left << pdu.name << right << setw(7) << pdu.encoded.GetSize() << flush;
+
+  // Decode once for the PDU to encode, checking it comes back the same
+  PASN_Object * obj = pdu.create();
+  Stream original(pdu.encoded);
+  if (!obj->Decode(original)) {
+    cout << "  decode failed" << endl;
+    delete obj;
+    return;
+  }
+
+  Stream check;
+  obj->Encode(check);
+  check.CompleteEncoding();
+  PBoolean same = check.GetSize() == pdu.encoded.GetSize() &&
+                  memcmp(check.GetPointer(), pdu.encoded, pdu.encoded.GetSize()) == 0;
+
+  // Warm the caches and the allocator before timing
+  unsigned warmup = iterations/10 + 1;
+  for (unsigned i = 0; i < warmup; i++) {
+    Stream strm;
+    obj->Encode(strm);
+    strm.CompleteEncoding();
+  }
+
+  unsigned long allocations = GetAllocationCount();
+  PInt64 start = PTime().GetTimestamp();
+  for (unsigned i = 0; i < iterations; i++) {
+    Stream strm;
+    obj->Encode(strm);
+    strm.CompleteEncoding();
+  }
+  PInt64 encodeTime = PTime().GetTimestamp() - start;
+  unsigned long encodeAllocations = GetAllocationCount() - allocations;
+
+  delete obj;
+
+  // Each decode is into a new PDU, as the signalling channels do
+  for (unsigned i = 0; i < warmup; i++) {
+    Stream strm(pdu.encoded);
+    PASN_Object * decoded = pdu.create();
+    decoded->Decode(strm);
+    delete decoded;
+  }
+
+  allocations = GetAllocationCount();
+  start = PTime().GetTimestamp();
+  for (unsigned i = 0; i < iterations; i++) {
+    Stream strm(pdu.encoded);
+    PASN_Object * decoded = pdu.create();
+    decoded->Decode(strm);
+    delete decoded;
+  }
+  PInt64 decodeTime = PTime().GetTimestamp() - start;
+  unsigned long decodeAllocations = GetAllocationCount() - allocations;
+
+  cout << setw(12) << encodeTime*1000/iterations
+       << setw(10) << setprecision(1) << setiosflags(ios::fixed) << (double)encodeAllocations/iterations
+       << setw(12) << decodeTime*1000/iterations
+       << setw(10) << (double)decodeAllocations/iterations
+       << resetiosflags(ios::fixed);
+  if (!same)
+    cout << "  (re-encoding differs)";
+  cout << endl;
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
@@ -0,0 +1,93 @@
+/*
+ * main.h
+ *
+ * ASN.1 PER encode and decode benchmark for H.225 and H.245 PDUs.
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#ifndef _PerBench_MAIN_H
+#define _PerBench_MAIN_H
+
+#include <h323.h>
+
+#include <vector>
+
+#if PTLIB_VER < 2130
+#if !defined(P_USE_STANDARD_CXX_BOOL) && !defined(P_USE_INTEGER_BOOL)
+    typedef int PBoolean;
+#endif
+#endif
+
+
+/**A PDU of the corpus, kept encoded so every run decodes the same bytes.
+  */
+struct PerBenchPDU
+{
+  typedef PASN_Object * (*CreateFunction)();
+
+  PString        name;
+  CreateFunction create;    // Makes an empty PDU of the right type to decode into
+  PBYTEArray     encoded;
+};
+
+typedef std::vector<PerBenchPDU> PerBenchCorpus;
+
+
+class PerBenchProcess : public PProcess
+{
+  PCLASSINFO(PerBenchProcess, PProcess)
+
+  public:
+    PerBenchProcess();
+
+    void Main();
+
+  protected:
+    /**Build the standard corpus: a Setup with fast start, a
+       TerminalCapabilitySet with 30 capabilities and an RRQ with H.460
+       features.
+      */
+    void BuildCorpus(PerBenchCorpus & corpus);
+
+    /**Load captured PDUs from a directory. The extension of each file gives
+       its type: .h225 for H.225 user information, .ras for RAS, .h245 for
+       H.245 and .h501 for H.501, holding the PER encoded bytes.
+      */
+    PBoolean LoadCorpus(const PDirectory & dir, PerBenchCorpus & corpus);
+
+    /**Write the corpus to a directory in the form LoadCorpus() reads.
+      */
+    PBoolean SaveCorpus(const PDirectory & dir, const PerBenchCorpus & corpus);
+
+    /**Time encoding and decoding a PDU with the PER stream class given,
+       PPER_Stream or H323_PERStream.
+      */
+    template <class Stream> void Run(const PerBenchPDU & pdu, unsigned iterations);
+};
+
+
+#endif  // _PerBench_MAIN_H
+
+
+// End of File ///////////////////////////////////////////////////////////////
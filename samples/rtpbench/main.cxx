@@ -0,0 +1,515 @@
+/*
+ * main.cxx
+ *
+ * RTP media path benchmark.
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#define H323_STATIC_LIB
+#endif
+
+#include "main.h"
+#include "../../version.h"
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#define new PNEW
+
+PCREATE_PROCESS(RTPBenchProcess);
+
+
+// First port tried for the sessions, each stream takes four
+#define BASE_PORT 20000
+
+// How long after sending stops the receivers keep reading, to empty the jitter buffers
+#define DRAIN_TIME 1000
+
+
+///////////////////////////////////////////////////////////////
+
+RTPBenchStream::RTPBenchStream()
+  : sender(NULL),
+    receiver(NULL),
+    sendTimestamp(0),
+    readTimestamp(0),
+    sent(0),
+    injectedLoss(0),
+    delivered(0)
+{
+}
+
+
+RTPBenchStream::~RTPBenchStream()
+{
+  delete sender;
+  delete receiver;
+}
+
+
+///////////////////////////////////////////////////////////////
+
+RTPBenchSender::RTPBenchSender(RTPBenchProcess & b)
+  : PThread(10000, NoAutoDeleteThread, HighestPriority, "RTPBench:Send"),
+    bench(b)
+{
+}
+
+
+void RTPBenchSender::Main()
+{
+  PAdaptiveDelay delay;
+  PInt64 nextFrame = PTime().GetTimestamp();
+
+  while (bench.IsSending()) {
+    PInt64 now = PTime().GetTimestamp();
+    if (now >= nextFrame) {
+      SendFrames(now);
+      nextFrame += bench.GetFrameTime()*1000;
+    }
+
+    // Frames held back for jitter, due by now
+    while (!delayed.empty() && delayed.begin()->first <= now) {
+      RTPBenchStream * stream = delayed.begin()->second.first;
+      RTP_DataFrame * frame = delayed.begin()->second.second;
+      stream->sender->WriteData(*frame);
+      delete frame;
+      delayed.erase(delayed.begin());
+    }
+
+    delay.Delay(delayed.empty() ? (int)((nextFrame - now + 999)/1000) : 1);
+  }
+
+  for (DelayedFrames::iterator it = delayed.begin(); it != delayed.end(); ++it)
+    delete it->second.second;
+  delayed.clear();
+}
+
+
+void RTPBenchSender::SendFrames(PInt64 now)
+{
+  for (size_t i = 0; i < streams.size(); i++) {
+    RTPBenchStream & stream = *streams[i];
+
+    RTP_DataFrame * frame = new RTP_DataFrame(bench.GetPayloadSize());
+    frame->SetPayloadType(RTP_DataFrame::PCMU);
+    frame->SetTimestamp(stream.sendTimestamp);
+    stream.sendTimestamp += bench.GetFrameSamples();
+
+    // The send time goes in the payload to measure the latency
+    memset(frame->GetPayloadPtr(), 0xff, bench.GetPayloadSize());
+    memcpy(frame->GetPayloadPtr(), &now, sizeof(now));
+
+    // Sequence numbers are given out even to lost frames, so the receiver sees the gap
+    if (!stream.sender->PreWriteData(*frame)) {
+      delete frame;
+      continue;
+    }
+    stream.sent++;
+
+    if (bench.GetLossPercent() > 0 && PRandom::Number()%100 < bench.GetLossPercent()) {
+      stream.injectedLoss++;
+      delete frame;
+    }
+    else if (bench.GetJitterTime() > 0)
+      delayed.insert(DelayedFrames::value_type(now + (PRandom::Number()%(bench.GetJitterTime()*1000)),
+                                               std::make_pair(&stream, frame)));
+    else {
+      stream.sender->WriteData(*frame);
+      delete frame;
+    }
+  }
+}
+
+
+///////////////////////////////////////////////////////////////
+
+RTPBenchReceiver::RTPBenchReceiver(RTPBenchProcess & b)
+  : PThread(10000, NoAutoDeleteThread, HighestPriority, "RTPBench:Receive"),
+    bench(b)
+{
+}
+
+
+void RTPBenchReceiver::Main()
+{
+  RTP_TransmitScheduler::Stream * paced = NULL;
+  if (bench.GetScheduler() != NULL)
+    paced = bench.GetScheduler()->Register(GetThreadName());
+
+  PAdaptiveDelay delay;
+  RTP_DataFrame frame;
+  PBYTEArray pcm(bench.GetPayloadSize());
+
+  while (!bench.IsStopping()) {
+    for (size_t i = 0; i < streams.size(); i++) {
+      RTPBenchStream & stream = *streams[i];
+
+      if (!stream.receiver->ReadBufferedData(stream.readTimestamp, frame))
+        continue;
+      stream.readTimestamp += bench.GetFrameSamples();
+
+      // Pass through codec, the payload is copied out as the PCM output
+      PINDEX size = frame.GetPayloadSize();
+      if (size < (PINDEX)sizeof(PInt64))
+        continue;
+      if (size > pcm.GetSize())
+        size = pcm.GetSize();
+      memcpy(pcm.GetPointer(), frame.GetPayloadPtr(), size);
+
+      PInt64 sent;
+      memcpy(&sent, (const BYTE *)pcm, sizeof(sent));
+      latency.Record((DWORD)RTP_Histogram::GetMicroseconds(sent));
+      stream.delivered++;
+    }
+
+    // Paced as the sound device would be, one frame per frame time
+    if (paced != NULL)
+      bench.GetScheduler()->WaitDeadline(*paced, bench.GetFrameTime());
+    else
+      delay.Delay(bench.GetFrameTime());
+  }
+
+  if (paced != NULL)
+    bench.GetScheduler()->Unregister(paced);
+}
+
+
+///////////////////////////////////////////////////////////////
+
+RTPBenchProcess::RTPBenchProcess()
+  : PProcess("H323Plus", "rtpbench", MAJOR_VERSION, MINOR_VERSION, BUILD_TYPE, BUILD_NUMBER),
+    frameTime(20),
+    payloadSize(160),
+    lossPercent(0),
+    jitterTime(0),
+    minJitterBuffer(40),
+    maxJitterBuffer(200),
+    engine(RTP_Session::e_ListJitterBuffer),
+    batchSize(0),
+    pullMode(FALSE),
+    reactor(NULL),
+    scheduler(NULL),
+    sending(TRUE),
+    stopping(FALSE)
+{
+}
+
+
+void RTPBenchProcess::Main()
+{
+  cout << GetName()
+       << " Version " << GetVersion(TRUE)
+       << " by " << GetManufacturer()
+       << " on " << GetOSClass() << ' ' << GetOSName()
+       << " (" << GetOSVersion() << '-' << GetOSHardware() << ")\n\n";
+
+  // Get and parse all of the command line arguments.
+  PArgList & args = GetArguments();
+  args.Parse(
+             "b-batch:"
+             "d-duration:"
+             "e-engine:"
+             "f-frame:"
+             "h-help."
+             "j-jitter:"
+             "-jitter-buffer:"
+             "l-loss:"
+             "m-mode:"
+#if PTRACING
+             "o-output:"
+#endif
+             "p-payload:"
+             "r-reactor-threads:"
+             "s-streams:"
+             "S-scheduler."
+#if PTRACING
+             "t-trace."
+#endif
+             "w-workers:"
+          , FALSE);
+
+  if (args.HasOption('h')) {
+    cout << "Usage : " << GetName() << " [options]\n"
+            "Options:\n"
+            "  -s --streams n          : Number of streams (default 100).\n"
+            "  -d --duration secs      : Time to send for (default 10).\n"
+            "  -m --mode mode          : What fills the jitter buffers: thread (a thread\n"
+            "                            per stream, the default), reactor or pull.\n"
+            "  -r --reactor-threads n  : Threads in the media reactor (default 4).\n"
+            "  -w --workers n          : Threads reading the jitter buffers, 0 is one per\n"
+            "                            stream as H323_RTPChannel does (default 0).\n"
+            "  -S --scheduler          : Pace the readers with the transmit scheduler.\n"
+            "  -e --engine engine      : Jitter buffer engine, list (default), ring or adaptive.\n"
+            "     --jitter-buffer min-max : Jitter buffer delay in ms (default 40-200).\n"
+            "  -b --batch n            : Datagrams per socket call, 0 disables (default 0).\n"
+            "  -l --loss percent       : Frames to drop before sending (default 0).\n"
+            "  -j --jitter ms          : Most time a frame is held back before sending (default 0).\n"
+            "  -f --frame ms           : Milliseconds of audio per frame (default 20).\n"
+            "  -p --payload bytes      : Payload size (default 160).\n"
+#if PTRACING
+            "  -t --trace              : Enable trace, use multiple times for more detail.\n"
+            "  -o --output             : File for trace output, default is stderr.\n"
+#endif
+            "  -h --help               : This help message.\n"
+            << endl;
+    return;
+  }
+
+#if PTRACING
+  PTrace::Initialise(args.GetOptionCount('t'),
+                     args.HasOption('o') ? (const char *)args.GetOptionString('o') : NULL,
+                     PTrace::DateAndTime | PTrace::TraceLevel | PTrace::FileAndLine);
+#endif
+
+  PINDEX streamCount = args.GetOptionString('s', "100").AsUnsigned();
+  PTimeInterval duration(0, args.GetOptionString('d', "10").AsUnsigned());
+  PINDEX workerCount = args.GetOptionString('w', "0").AsUnsigned();
+  frameTime = args.GetOptionString('f', "20").AsUnsigned();
+  payloadSize = args.GetOptionString('p', "160").AsUnsigned();
+  lossPercent = args.GetOptionString('l', "0").AsUnsigned();
+  jitterTime = args.GetOptionString('j', "0").AsUnsigned();
+  batchSize = args.GetOptionString('b', "0").AsUnsigned();
+
+  if (streamCount == 0 || frameTime == 0 || payloadSize < (PINDEX)sizeof(PInt64) || lossPercent > 100) {
+    cerr << "Illegal streams, frame time, payload size or loss specified." << endl;
+    return;
+  }
+
+  if (args.HasOption("jitter-buffer")) {
+    PStringArray delays = args.GetOptionString("jitter-buffer").Tokenise("-");
+    minJitterBuffer = delays[0].AsUnsigned();
+    maxJitterBuffer = delays.GetSize() > 1 ? delays[1].AsUnsigned() : minJitterBuffer;
+    if (minJitterBuffer == 0 || minJitterBuffer > maxJitterBuffer) {
+      cerr << "Jitter buffer should be min-max milliseconds." << endl;
+      return;
+    }
+  }
+
+  PCaselessString engineName = args.GetOptionString('e', "list");
+  if (engineName == "ring")
+    engine = RTP_Session::e_RingJitterBuffer;
+  else if (engineName == "adaptive")
+    engine = RTP_Session::e_AdaptiveJitterBuffer;
+  else if (engineName != "list") {
+    cerr << "Jitter buffer engine should be list, ring or adaptive." << endl;
+    return;
+  }
+
+  PCaselessString mode = args.GetOptionString('m', "thread");
+  if (mode == "reactor") {
+    if (!RTP_MediaReactor::IsAvailable()) {
+      cerr << "Media reactor is not available on this platform." << endl;
+      return;
+    }
+    reactor = new RTP_MediaReactor(args.GetOptionString('r', "4").AsUnsigned());
+  }
+  else if (mode == "pull")
+    pullMode = TRUE;
+  else if (mode != "thread") {
+    cerr << "Mode should be thread, reactor or pull." << endl;
+    return;
+  }
+
+  if (args.HasOption('S'))
+    scheduler = new RTP_TransmitScheduler;
+
+  // Sessions are opened without a NAT method, the connection is not used
+  H323EndPoint endpoint;
+  H323Connection connection(endpoint, 1);
+
+  cout << "Opening " << streamCount << " streams over loopback..." << flush;
+
+  std::vector<RTPBenchStream *> streams;
+  WORD port = BASE_PORT;
+  for (PINDEX i = 0; i < streamCount; i++) {
+    RTPBenchStream * stream = new RTPBenchStream;
+    streams.push_back(stream);
+    if (!OpenStream(*stream, connection, port)) {
+      cerr << "\nCould not open stream " << i << ", out of ports at " << port << endl;
+      sending = FALSE;
+      stopping = TRUE;
+      break;
+    }
+  }
+
+  RTPBenchSender sender(*this);
+  std::vector<RTPBenchReceiver *> receivers;
+
+  if (!stopping) {
+    cout << " done\n"
+         << "Mode: " << mode;
+    if (reactor != NULL)
+      cout << " with " << reactor->GetThreadCount() << " threads";
+    cout << ", " << (workerCount > 0 ? PString(PString::Unsigned, workerCount) : PString("one per stream")) << " readers"
+         << (scheduler != NULL ? " paced by the scheduler" : "")
+         << ", " << engineName << " jitter buffer " << minJitterBuffer << '-' << maxJitterBuffer << " ms";
+    if (batchSize > 0)
+      cout << ", batches of " << batchSize;
+    cout << "\nFrames of " << frameTime << " ms, " << payloadSize << " bytes, "
+         << lossPercent << "% loss, up to " << jitterTime << " ms jitter\n"
+         << "Sending for " << duration.GetSeconds() << " seconds" << endl;
+
+    // Readers share the streams out evenly
+    PINDEX readers = workerCount > 0 ? workerCount : streamCount;
+    for (PINDEX r = 0; r < readers; r++)
+      receivers.push_back(new RTPBenchReceiver(*this));
+    for (PINDEX i = 0; i < streamCount; i++) {
+      sender.AddStream(streams[i]);
+      receivers[i%readers]->AddStream(streams[i]);
+    }
+  }
+
+  PTime startTime;
+  PInt64 startCPU = GetCPUMicroseconds();
+
+  if (!stopping) {
+    for (size_t r = 0; r < receivers.size(); r++)
+      receivers[r]->Resume();
+    sender.Resume();
+
+    PThread::Sleep(duration);
+  }
+
+  // Stop sending then let the jitter buffers play out what they hold
+  if (!stopping) {
+    sending = FALSE;
+    sender.WaitForTermination();
+    PThread::Sleep(DRAIN_TIME + maxJitterBuffer + jitterTime);
+  }
+
+  stopping = TRUE;
+  for (size_t r = 0; r < receivers.size(); r++)
+    receivers[r]->WaitForTermination();
+
+  PTimeInterval elapsed = PTime() - startTime;
+  PInt64 cpu = GetCPUMicroseconds() - startCPU;
+
+  RTP_Histogram::Snapshot latency;
+  for (size_t r = 0; r < receivers.size(); r++) {
+    RTP_Histogram::Snapshot snapshot;
+    receivers[r]->GetLatency().GetSnapshot(snapshot);
+    latency.Merge(snapshot);
+    delete receivers[r];
+  }
+
+  PUInt64 sent = 0, injectedLoss = 0, delivered = 0, tooLate = 0, overruns = 0;
+  for (size_t i = 0; i < streams.size(); i++) {
+    RTPBenchStream & stream = *streams[i];
+    sent += stream.sent;
+    injectedLoss += stream.injectedLoss;
+    delivered += stream.delivered;
+    if (stream.receiver != NULL) {
+      tooLate += stream.receiver->GetPacketsTooLate();
+      overruns += stream.receiver->GetBufferOverruns();
+    }
+    delete streams[i];
+  }
+
+  delete reactor;
+  delete scheduler;
+
+  double seconds = elapsed.GetMilliSeconds()/1000.0;
+  double cpuSeconds = cpu/1000000.0;
+  PUInt64 dropped = sent - injectedLoss > delivered ? sent - injectedLoss - delivered : 0;
+
+  cout << "\nResults:\n" << setprecision(3)
+       << "  Elapsed:                 " << seconds << " s\n"
+       << "  Frames sent:             " << sent << '\n'
+       << "  Frames lost (injected):  " << injectedLoss << '\n'
+       << "  Frames delivered:        " << delivered << '\n'
+       << "  Frames dropped:          " << dropped << " (" << tooLate << " too late, " << overruns << " overruns)\n"
+       << "  Delivered per second:    " << (seconds > 0 ? delivered/seconds : 0.0) << '\n'
+       << "  CPU time:                " << cpuSeconds << " s, "
+       << (seconds > 0 ? cpuSeconds*100/seconds : 0.0) << "% of one core\n"
+       << "  Delivered per core second: " << (cpuSeconds > 0 ? delivered/cpuSeconds : 0.0) << '\n'
+       << "  Latency (ms):            p50=" << latency.GetPercentile(50)/1000.0
+       << " p90=" << latency.GetPercentile(90)/1000.0
+       << " p99=" << latency.GetPercentile(99)/1000.0
+       << " max=" << latency.GetMaximum()/1000.0 << endl;
+}
+
+
+PBoolean RTPBenchProcess::OpenStream(RTPBenchStream & stream, H323Connection & connection, WORD & port)
+{
+  PIPSocket::Address loopback(127, 0, 0, 1);
+
+  stream.sender = new RTP_UDP(
+#ifdef H323_RTP_AGGREGATE
+                              NULL,
+#endif
+                              1);
+  stream.receiver = new RTP_UDP(
+#ifdef H323_RTP_AGGREGATE
+                                NULL,
+#endif
+                                1);
+
+  stream.sender->SetBatchSize(batchSize);
+  stream.receiver->SetBatchSize(batchSize);
+
+  if (!stream.sender->Open(loopback, port, 0xfffd, 0, connection))
+    return FALSE;
+  port = (WORD)(stream.sender->GetLocalDataPort() + 2);
+
+  if (!stream.receiver->Open(loopback, port, 0xfffd, 0, connection))
+    return FALSE;
+  port = (WORD)(stream.receiver->GetLocalDataPort() + 2);
+
+  stream.sender->SetRemoteSocketInfo(loopback, stream.receiver->GetLocalDataPort(), TRUE);
+  stream.receiver->SetRemoteSocketInfo(loopback, stream.sender->GetLocalDataPort(), TRUE);
+
+  // As H323_RTPChannel sets up a receiving audio channel
+  stream.receiver->SetMediaReactor(reactor);
+  stream.receiver->SetJitterPullMode(pullMode);
+  stream.receiver->SetJitterBufferSize(minJitterBuffer*8, maxJitterBuffer*8, 30000, engine);
+
+  return TRUE;
+}
+
+
+PInt64 RTPBenchProcess::GetCPUMicroseconds()
+{
+#ifdef _WIN32
+  FILETIME created, exited, kernel, user;
+  if (!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user))
+    return 0;
+  PInt64 k = ((PInt64)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+  PInt64 u = ((PInt64)user.dwHighDateTime << 32) | user.dwLowDateTime;
+  return (k + u)/10;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+  return (PInt64)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)*1000000 +
+                  usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+#endif
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
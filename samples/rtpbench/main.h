@@ -0,0 +1,166 @@
+/*
+ * main.h
+ *
+ * RTP media path benchmark.
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#ifndef _RTPBench_MAIN_H
+#define _RTPBench_MAIN_H
+
+#include <h323.h>
+#include <rtphist.h>
+#include <rtpreactor.h>
+#include <rtpsched.h>
+
+#include <map>
+#include <vector>
+
+#if PTLIB_VER < 2130
+#if !defined(P_USE_STANDARD_CXX_BOOL) && !defined(P_USE_INTEGER_BOOL)
+    typedef int PBoolean;
+#endif
+#endif
+
+
+class RTPBenchProcess;
+
+
+/**One media stream, a sending and a receiving session joined over loopback.
+  */
+class RTPBenchStream
+{
+  public:
+    RTPBenchStream();
+    ~RTPBenchStream();
+
+    RTP_UDP * sender;
+    RTP_UDP * receiver;
+
+    DWORD    sendTimestamp;     // Sending thread only
+    DWORD    readTimestamp;     // Receiving thread only
+    unsigned sent;
+    unsigned injectedLoss;
+    unsigned delivered;
+};
+
+
+/**Thread sending the frames of a set of streams, adding loss and jitter.
+  */
+class RTPBenchSender : public PThread
+{
+  PCLASSINFO(RTPBenchSender, PThread);
+
+  public:
+    RTPBenchSender(RTPBenchProcess & bench);
+
+    void AddStream(RTPBenchStream * stream) { streams.push_back(stream); }
+
+    virtual void Main();
+
+  protected:
+    void SendFrames(PInt64 now);
+
+    RTPBenchProcess & bench;
+    std::vector<RTPBenchStream *> streams;
+
+    // Frames held back to add jitter, by time to send in microseconds
+    typedef std::multimap<PInt64, std::pair<RTPBenchStream *, RTP_DataFrame *> > DelayedFrames;
+    DelayedFrames delayed;
+};
+
+
+/**Thread reading a set of streams through their jitter buffers and a pass
+   through codec, in the way each H323_RTPChannel receive thread does for
+   its one stream.
+  */
+class RTPBenchReceiver : public PThread
+{
+  PCLASSINFO(RTPBenchReceiver, PThread);
+
+  public:
+    RTPBenchReceiver(RTPBenchProcess & bench);
+
+    void AddStream(RTPBenchStream * stream) { streams.push_back(stream); }
+
+    virtual void Main();
+
+    const RTP_Histogram & GetLatency() const { return latency; }
+
+  protected:
+    RTPBenchProcess & bench;
+    std::vector<RTPBenchStream *> streams;
+    RTP_Histogram latency;   // Send to codec output, in microseconds
+};
+
+
+class RTPBenchProcess : public PProcess
+{
+  PCLASSINFO(RTPBenchProcess, PProcess)
+
+  public:
+    RTPBenchProcess();
+
+    void Main();
+
+    PBoolean IsSending() const  { return sending; }
+    PBoolean IsStopping() const { return stopping; }
+
+    unsigned GetFrameTime() const    { return frameTime; }
+    unsigned GetFrameSamples() const { return frameTime*8; }
+    PINDEX   GetPayloadSize() const  { return payloadSize; }
+    unsigned GetLossPercent() const  { return lossPercent; }
+    unsigned GetJitterTime() const   { return jitterTime; }
+
+    RTP_TransmitScheduler * GetScheduler() const { return scheduler; }
+
+    /**Get the CPU time used by every thread of the process.
+      */
+    static PInt64 GetCPUMicroseconds();
+
+  protected:
+    PBoolean OpenStream(RTPBenchStream & stream, H323Connection & connection, WORD & port);
+
+    unsigned frameTime;          // Milliseconds of audio per frame
+    PINDEX   payloadSize;
+    unsigned lossPercent;
+    unsigned jitterTime;         // Most milliseconds a frame is held back
+    unsigned minJitterBuffer;    // Milliseconds
+    unsigned maxJitterBuffer;
+    RTP_Session::JitterBufferEngine engine;
+    PINDEX   batchSize;
+    PBoolean pullMode;
+
+    RTP_MediaReactor      * reactor;
+    RTP_TransmitScheduler * scheduler;
+
+    volatile PBoolean sending;
+    volatile PBoolean stopping;
+};
+
+
+#endif  // _RTPBench_MAIN_H
+
+
+// End of File ///////////////////////////////////////////////////////////////
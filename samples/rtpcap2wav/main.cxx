@@ -0,0 +1,133 @@
+/*
+ * main.cxx
+ *
+ * Render recordings in the RTP capture format to WAV files.
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#define H323_STATIC_LIB
+#endif
+
+#include "main.h"
+#include "../../version.h"
+
+#define new PNEW
+
+PCREATE_PROCESS(RTPCap2WavProcess);
+
+
+///////////////////////////////////////////////////////////////
+
+RTPCap2WavProcess::RTPCap2WavProcess()
+  : PProcess("H323Plus", "rtpcap2wav", MAJOR_VERSION, MINOR_VERSION, BUILD_TYPE, BUILD_NUMBER)
+{
+}
+
+
+void RTPCap2WavProcess::Main()
+{
+  // Get and parse all of the command line arguments.
+  PArgList & args = GetArguments();
+  args.Parse(
+             "f-format:"
+             "h-help."
+             "l-list."
+#if PTRACING
+             "o-output:"
+             "t-trace."
+#endif
+          , FALSE);
+
+  if (args.HasOption('h') || args.GetCount() < (args.HasOption('l') ? 1 : 2)) {
+    cout << "Usage : " << GetName() << " [options] capture [wavfile]\n"
+            "Options:\n"
+            "  -f --format name        : Media format of the payload, needed for dynamic\n"
+            "                            payload types (default from the payload type).\n"
+            "  -l --list               : List the packets instead of rendering.\n"
+#if PTRACING
+            "  -t --trace              : Enable trace, use multiple times for more detail.\n"
+            "  -o --output             : File for trace output, default is stderr.\n"
+#endif
+            "  -h --help               : This help message.\n"
+            << endl;
+    return;
+  }
+
+#if PTRACING
+  PTrace::Initialise(args.GetOptionCount('t'),
+                     args.HasOption('o') ? (const char *)args.GetOptionString('o') : NULL,
+                     PTrace::DateAndTime | PTrace::TraceLevel | PTrace::FileAndLine);
+#endif
+
+  RTP_CaptureReader reader;
+  if (!reader.Open(args[0])) {
+    cerr << "Could not open capture " << args[0] << endl;
+    return;
+  }
+
+  cout << "Capture started " << reader.GetStartTime().AsString()
+       << (reader.HasIndex() ? "" : ", no index, recording was not closed") << endl;
+
+  if (args.HasOption('l')) {
+    List(reader);
+    return;
+  }
+
+  // Make sure the plug in codecs are loaded
+  H323PluginCodecManager::Bootstrap();
+
+  if (!reader.RenderToWAV(args[1], args.GetOptionString('f'))) {
+    cerr << "Could not render " << args[0] << " to " << args[1] << endl;
+    return;
+  }
+
+  cout << "Rendered " << args[0] << " to " << args[1] << endl;
+}
+
+
+void RTPCap2WavProcess::List(RTP_CaptureReader & reader)
+{
+  RTP_DataFrame frame;
+  DWORD arrival;
+  unsigned count = 0;
+
+  while (reader.ReadPacket(frame, arrival)) {
+    cout << setw(10) << arrival << "ms"
+         << " pt=" << frame.GetPayloadType()
+         << " seq=" << frame.GetSequenceNumber()
+         << " ts=" << frame.GetTimestamp()
+         << " ssrc=" << hex << frame.GetSyncSource() << dec
+         << " size=" << frame.GetPayloadSize()
+         << (frame.GetMarker() ? " M" : "") << '\n';
+    count++;
+  }
+
+  cout << count << " packets" << endl;
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
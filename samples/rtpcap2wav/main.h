@@ -0,0 +1,62 @@
+/*
+ * main.h
+ *
+ * Render recordings in the RTP capture format to WAV files.
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#ifndef _RTPCap2Wav_MAIN_H
+#define _RTPCap2Wav_MAIN_H
+
+#include <h323.h>
+#include <h323pluginmgr.h>
+#include <rtprecord.h>
+
+#if PTLIB_VER < 2130
+#if !defined(P_USE_STANDARD_CXX_BOOL) && !defined(P_USE_INTEGER_BOOL)
+    typedef int PBoolean;
+#endif
+#endif
+
+
+class RTPCap2WavProcess : public PProcess
+{
+  PCLASSINFO(RTPCap2WavProcess, PProcess)
+
+  public:
+    RTPCap2WavProcess();
+
+    void Main();
+
+  protected:
+    /**Print the packets of a capture, one per line.
+      */
+    void List(RTP_CaptureReader & reader);
+};
+
+
+#endif  // _RTPCap2Wav_MAIN_H
+
+
+// End of File ///////////////////////////////////////////////////////////////
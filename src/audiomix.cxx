@@ -0,0 +1,334 @@
+/*
+ * audiomix.cxx
+ *
+ * PCM resampling and mixing
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "audiomix.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#include "audiomix.h"
+
+#include <math.h>
+
+#ifndef H323_AUDIOMIX_NO_SIMD
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define H323_AUDIOMIX_SSE2 1
+#include <emmintrin.h>
+#endif
+#endif // H323_AUDIOMIX_NO_SIMD
+
+#define new PNEW
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+static inline short Saturate(int value)
+{
+  if (value > 32767)
+    return 32767;
+  if (value < -32768)
+    return -32768;
+  return (short)value;
+}
+
+
+static unsigned GreatestCommonDivisor(unsigned a, unsigned b)
+{
+  while (b != 0) {
+    unsigned r = a % b;
+    a = b;
+    b = r;
+  }
+  return a;
+}
+
+
+// Dot product of count samples and Q15 coefficients, count a multiple of 8
+static inline int FilterTaps(const short * samples, const short * coefficients, unsigned count)
+{
+#ifdef H323_AUDIOMIX_SSE2
+  __m128i sum = _mm_setzero_si128();
+  for (unsigned i = 0; i < count; i += 8) {
+    __m128i s = _mm_loadu_si128((const __m128i *)(samples+i));
+    __m128i c = _mm_loadu_si128((const __m128i *)(coefficients+i));
+    sum = _mm_add_epi32(sum, _mm_madd_epi16(s, c));
+  }
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1,0,3,2)));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2,3,0,1)));
+  return _mm_cvtsi128_si32(sum);
+#else
+  int sum = 0;
+  for (unsigned i = 0; i < count; i++)
+    sum += samples[i]*coefficients[i];
+  return sum;
+#endif
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323AudioResampler::H323AudioResampler(unsigned inRate, unsigned outRate, unsigned tapCount)
+  : inputRate(inRate),
+    outputRate(outRate),
+    phase(0)
+{
+  if (inputRate == 0)
+    inputRate = 8000;
+  if (outputRate == 0)
+    outputRate = inputRate;
+
+  unsigned gcd = GreatestCommonDivisor(inputRate, outputRate);
+  upFactor = outputRate/gcd;
+  downFactor = inputRate/gcd;
+
+  // Whole SIMD registers per phase
+  taps = tapCount < 8 ? 8 : (tapCount+7)&~7u;
+
+  // Windowed sinc low pass at the lower Nyquist rate, less a transition band
+  unsigned length = taps*upFactor;
+  double cutoff = 0.45/(upFactor > downFactor ? upFactor : downFactor);
+  double centre = (length-1)/2.0;
+  std::vector<double> prototype(length);
+  for (unsigned j = 0; j < length; j++) {
+    double x = j - centre;
+    double sinc = x == 0 ? 2*cutoff : sin(2*M_PI*cutoff*x)/(M_PI*x);
+    double window = 0.42 - 0.5*cos(2*M_PI*(j+0.5)/length) + 0.08*cos(4*M_PI*(j+0.5)/length);
+    prototype[j] = sinc*window;
+  }
+
+  // Each phase has unity gain, stored oldest sample first
+  coefficients.resize(upFactor*taps);
+  for (unsigned p = 0; p < upFactor; p++) {
+    double sum = 0;
+    for (unsigned m = 0; m < taps; m++)
+      sum += prototype[p + m*upFactor];
+    for (unsigned m = 0; m < taps; m++) {
+      double c = prototype[p + m*upFactor]*32768.0/sum;
+      coefficients[p*taps + taps-1-m] = Saturate((int)floor(c+0.5));
+    }
+  }
+
+  work.assign(taps-1, 0);
+
+  PTRACE(4, "AudioMix\tResampler " << inputRate << " to " << outputRate
+         << " Hz, " << upFactor << '/' << downFactor << " with " << taps << " taps");
+}
+
+
+PINDEX H323AudioResampler::GetOutputCount(PINDEX inputCount) const
+{
+  PINDEX end = inputCount*upFactor;
+  if (end <= (PINDEX)phase)
+    return 0;
+  return (end - phase + downFactor - 1)/downFactor;
+}
+
+
+PINDEX H323AudioResampler::Process(const short * input, PINDEX inputCount, short * output, PINDEX outputSize)
+{
+  if (inputCount <= 0)
+    return 0;
+
+  // Equal rates are a copy
+  if (upFactor == downFactor) {
+    PINDEX count = PMIN(inputCount, outputSize);
+    if (output != input)
+      memmove(output, input, count*sizeof(short));
+    return count;
+  }
+
+  // Append the block to the end of the last one
+  work.resize(taps-1 + inputCount);
+  memcpy(&work[taps-1], input, inputCount*sizeof(short));
+
+  PINDEX count = 0;
+  PINDEX end = inputCount*upFactor;
+  PINDEX t = phase;
+  while (t < end) {
+    PINDEX i = t/upFactor;
+    unsigned p = (unsigned)(t - i*upFactor);
+    if (count < outputSize)
+      output[count++] = Saturate((FilterTaps(&work[i], &coefficients[p*taps], taps) + 16384) >> 15);
+    t += downFactor;
+  }
+  phase = (unsigned)(t - end);
+
+  // Keep the newest samples for the next block
+  memmove(&work[0], &work[inputCount], (taps-1)*sizeof(short));
+  work.resize(taps-1);
+
+  return count;
+}
+
+
+void H323AudioResampler::Reset()
+{
+  phase = 0;
+  work.assign(taps-1, 0);
+}
+
+
+PNotifier H323AudioResampler::GetFilter()
+{
+  return PCREATE_NOTIFIER(OnFilter);
+}
+
+
+void H323AudioResampler::OnFilter(H323Codec::FilterInfo & info, H323_INT)
+{
+  PINDEX samples = info.bufferLength/sizeof(short);
+  filterOutput.resize(GetOutputCount(samples)+1);
+
+  PINDEX count = Process((const short *)info.buffer, samples, &filterOutput[0], (PINDEX)filterOutput.size());
+  if (count*(PINDEX)sizeof(short) > info.bufferSize) {
+    PTRACE(2, "AudioMix\tResampled block of " << count << " samples truncated to buffer");
+    count = info.bufferSize/sizeof(short);
+  }
+
+  memcpy(info.buffer, &filterOutput[0], count*sizeof(short));
+  info.bufferLength = count*sizeof(short);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+#ifdef H323_AUDIOMIX_SSE2
+// Sign extend the low and high four samples of a register
+#define WIDEN_LO(v) _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16)
+#define WIDEN_HI(v) _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16)
+#endif
+
+
+H323AudioMixer::H323AudioMixer(PINDEX samples)
+  : total(samples > 0 ? samples : 0, 0),
+    count(0)
+{
+}
+
+
+void H323AudioMixer::Clear()
+{
+  total.assign(total.size(), 0);
+  count = 0;
+}
+
+
+void H323AudioMixer::Add(const short * input)
+{
+  PINDEX samples = GetSamples();
+  int * sum = samples > 0 ? &total[0] : NULL;
+  PINDEX i = 0;
+
+#ifdef H323_AUDIOMIX_SSE2
+  for (; i+8 <= samples; i += 8) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(input+i));
+    __m128i lo = _mm_loadu_si128((const __m128i *)(sum+i));
+    __m128i hi = _mm_loadu_si128((const __m128i *)(sum+i+4));
+    _mm_storeu_si128((__m128i *)(sum+i),   _mm_add_epi32(lo, WIDEN_LO(v)));
+    _mm_storeu_si128((__m128i *)(sum+i+4), _mm_add_epi32(hi, WIDEN_HI(v)));
+  }
+#endif
+
+  for (; i < samples; i++)
+    sum[i] += input[i];
+
+  count++;
+}
+
+
+void H323AudioMixer::GetMix(short * output) const
+{
+  PINDEX samples = GetSamples();
+  const int * sum = samples > 0 ? &total[0] : NULL;
+  PINDEX i = 0;
+
+#ifdef H323_AUDIOMIX_SSE2
+  for (; i+8 <= samples; i += 8) {
+    __m128i lo = _mm_loadu_si128((const __m128i *)(sum+i));
+    __m128i hi = _mm_loadu_si128((const __m128i *)(sum+i+4));
+    _mm_storeu_si128((__m128i *)(output+i), _mm_packs_epi32(lo, hi));
+  }
+#endif
+
+  for (; i < samples; i++)
+    output[i] = Saturate(sum[i]);
+}
+
+
+void H323AudioMixer::GetMixMinus(const short * own, short * output) const
+{
+  PINDEX samples = GetSamples();
+  const int * sum = samples > 0 ? &total[0] : NULL;
+  PINDEX i = 0;
+
+#ifdef H323_AUDIOMIX_SSE2
+  for (; i+8 <= samples; i += 8) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(own+i));
+    __m128i lo = _mm_sub_epi32(_mm_loadu_si128((const __m128i *)(sum+i)),   WIDEN_LO(v));
+    __m128i hi = _mm_sub_epi32(_mm_loadu_si128((const __m128i *)(sum+i+4)), WIDEN_HI(v));
+    _mm_storeu_si128((__m128i *)(output+i), _mm_packs_epi32(lo, hi));
+  }
+#endif
+
+  for (; i < samples; i++)
+    output[i] = Saturate(sum[i] - own[i]);
+}
+
+
+void H323AudioMixer::Mix(const short * const * inputs, unsigned inputCount, short * output, PINDEX samples)
+{
+  PINDEX i = 0;
+
+#ifdef H323_AUDIOMIX_SSE2
+  for (; i+8 <= samples; i += 8) {
+    __m128i lo = _mm_setzero_si128();
+    __m128i hi = _mm_setzero_si128();
+    for (unsigned n = 0; n < inputCount; n++) {
+      __m128i v = _mm_loadu_si128((const __m128i *)(inputs[n]+i));
+      lo = _mm_add_epi32(lo, WIDEN_LO(v));
+      hi = _mm_add_epi32(hi, WIDEN_HI(v));
+    }
+    _mm_storeu_si128((__m128i *)(output+i), _mm_packs_epi32(lo, hi));
+  }
+#endif
+
+  for (; i < samples; i++) {
+    int sum = 0;
+    for (unsigned n = 0; n < inputCount; n++)
+      sum += inputs[n][i];
+    output[i] = Saturate(sum);
+  }
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -41,6 +41,13 @@
 #include "h323pdu.h"
 #include "h323ep.h"
 #include "h323rtp.h"
+#include "h323mediawatch.h"
+#include "rtpsched.h"
+#include "rtpred.h"
+#include "h323videoassembler.h"
+#include "h323comfortnoise.h"
+#include "h323mediaclock.h"
+#include "h323avsync.h"
 #include <ptclib/random.h>
 #include <ptclib/delaychan.h>
 
@@ -50,6 +57,7 @@
 
 #define MAX_PAYLOAD_TYPE_MISMATCHES 8
 #define RTP_TRACE_DISPLAY_RATE 16000 // 2 seconds
+#define LIP_SYNC_FRESH_READ 5000     // Microseconds after a hold a read is taken as waiting for it
 
 
 class H323LogicalChannelThread : public PThread
@@ -59,6 +67,7 @@ class H323LogicalChannelThread : public PThread
     H323LogicalChannelThread(H323EndPoint & endpoint, H323Channel & channel, PBoolean rx);
     void Main();
   private:
+    H323EndPoint & endpoint;
     H323Channel & channel;
     PBoolean receiver;
 };
@@ -88,13 +97,32 @@ ostream & operator<<(ostream & out, H323Channel::Directions dir)
 
 /////////////////////////////////////////////////////////////////////////////
 
-H323LogicalChannelThread::H323LogicalChannelThread(H323EndPoint & endpoint,
+static H323EndPoint::ChannelThreadClass GetChannelThreadClass(const H323Channel & channel)
+{
+  const H323Capability & capability = channel.GetCapability();
+#ifdef H323_H239
+  if (PIsDescendant(&capability, H323CodecExtendedVideoCapability))
+    return H323EndPoint::ExtendedVideoChannelThreads;
+#endif
+  switch (capability.GetMainType()) {
+    case H323Capability::e_Audio :
+      return H323EndPoint::AudioChannelThreads;
+    case H323Capability::e_Video :
+      return H323EndPoint::VideoChannelThreads;
+    default :
+      return H323EndPoint::OtherChannelThreads;
+  }
+}
+
+
+H323LogicalChannelThread::H323LogicalChannelThread(H323EndPoint & ep,
                                                    H323Channel & c,
                                                    PBoolean rx)
-  : PThread(endpoint.GetChannelThreadStackSize(),
+  : PThread(ep.GetChannelThreadStackSize(),
             NoAutoDeleteThread,
-            endpoint.GetChannelThreadPriority(),
+            ep.GetChannelThreadPriority(GetChannelThreadClass(c)),
             rx ? "LogChanRx:%0x" : "LogChanTx:%0x"),
+    endpoint(ep),
     channel(c)
 {
   PTRACE(4, "LogChan\tStarting logical channel thread " << this);
@@ -106,6 +134,9 @@ H323LogicalChannelThread::H323LogicalChannelThread(H323EndPoint & endpoint,
 void H323LogicalChannelThread::Main()
 {
   PTRACE(4, "LogChan\tStarted logical channel thread " << this);
+
+  endpoint.GetThreadAffinity(H323EndPoint::MediaThreads).ApplyToCurrentThread();
+
   if (receiver)
     channel.Receive();
   else
@@ -185,6 +216,7 @@ H323Channel::H323Channel(H323Connection & conn, const H323Capability & cap)
   receiveThread = NULL;
   transmitThread = NULL;
   terminating = FALSE;
+  stopping = FALSE;
   opened = FALSE;
   paused = FALSE;
 
@@ -229,12 +261,9 @@ void H323Channel::CleanUpOnTermination()
 
   PTRACE(3, "LogChan\tCleaning up " << number);
 
-  terminating = TRUE;
+  StartTermination();
 
-  // If we have a codec, then close it, this allows the transmitThread to be
-  // broken out of any I/O block on reading the codec.
-  if (codec != NULL)
-    codec->Close();
+  terminating = TRUE;
 
   // If we have a receiver thread, wait for it to die.
   if (receiveThread != NULL) {
@@ -261,6 +290,22 @@ void H323Channel::CleanUpOnTermination()
 }
 
 
+void H323Channel::StartTermination()
+{
+  if (!opened || stopping)
+    return;
+
+  PTRACE(4, "LogChan\tStopping " << number);
+
+  stopping = TRUE;
+
+  // If we have a codec, then close it, this allows the transmitThread to be
+  // broken out of any I/O block on reading the codec.
+  if (codec != NULL)
+    codec->Close();
+}
+
+
 PBoolean H323Channel::IsRunning() const
 {
   if (receiveThread  != NULL && !receiveThread ->IsTerminated())
@@ -660,6 +705,31 @@ PBoolean H323_RealTimeChannel::SetDynamicRTPPayloadType(int newType)
 }
 
 
+/////////////////////////////////////////////////////////////////////////////
+
+// Counts a media thread as running for the media watchdog while in scope
+class MediaActivityScope
+{
+  public:
+    MediaActivityScope(H323MediaActivity * _activity, const PInt64 & _silenceStartTick)
+      : activity(_activity), silenceStartTick(_silenceStartTick)
+    {
+      if (activity != NULL)
+        activity->ChannelStarted();
+    }
+
+    ~MediaActivityScope()
+    {
+      if (activity != NULL)
+        activity->ChannelStopped(silenceStartTick != 0);
+    }
+
+  protected:
+    H323MediaActivity * activity;
+    const PInt64      & silenceStartTick;
+};
+
+
 /////////////////////////////////////////////////////////////////////////////
 
 H323_RTPChannel::H323_RTPChannel(H323Connection & conn,
@@ -668,9 +738,15 @@ H323_RTPChannel::H323_RTPChannel(H323Connection & conn,
                                  RTP_Session & r)
   : H323_RealTimeChannel(conn, cap, direction),
     rtpSession(r),
-    rtpCallbacks(*(H323_RTP_Session *)r.GetUserData()), silenceStartTick(0),
-    rec_written(0), rec_ok(false)
+    rtpCallbacks(*(H323_RTP_Session *)r.GetUserData()), filterChain(NULL),
+    filterReaders(0), silenceStartTick(0), redundantEncoder(NULL),
+    encodedSource(NULL), autoDeleteSource(FALSE), sourceChanged(FALSE),
+    rec_written(0), rec_ok(false), receivedAudioLevel(UINT_MAX),
+    receivedVoice(FALSE), skipSilentDecode(FALSE)
 {
+  relay = NULL;
+  fanOut.DisallowDeleteObjects();
+
   PTRACE(3, "H323RTP\t" << (receiver ? "Receiver" : "Transmitter")
          << " created using session " << GetSessionID());
 }
@@ -678,6 +754,25 @@ H323_RTPChannel::H323_RTPChannel(H323Connection & conn,
 
 H323_RTPChannel::~H323_RTPChannel()
 {
+  StopRelay();
+  RemoveFanOutTargets();
+  SetEncodedSource(NULL);
+  delete filterChain;
+  delete redundantEncoder;
+
+  RTP_Session::Histograms histograms;
+  rtpSession.GetHistograms(histograms);
+  endpoint.OnRTPHistograms(histograms, receiver);
+
+  if (receiver) {
+    H323EndPointMetrics & metrics = endpoint.GetMetrics();
+    metrics.rtpPacketsLost.Add(rtpSession.GetPacketsLost());
+    metrics.rtpPacketsTooLate.Add(rtpSession.GetPacketsTooLate());
+    metrics.rtpBufferOverruns.Add(rtpSession.GetBufferOverruns());
+    if (PIsDescendant(&rtpSession, RTP_UDP))
+      metrics.rtpPacketsRecovered.Add(((RTP_UDP &)rtpSession).GetRedundantRecoveredTotal());
+  }
+
   // Finished with the RTP session, this will delete the session if it is no
   // longer referenced by any logical channels.
   connection.ReleaseSession(GetSessionID());
@@ -691,12 +786,27 @@ void H323_RTPChannel::CleanUpOnTermination()
 
   PTRACE(3, "H323RTP\tCleaning up RTP " << number);
 
-  // Break any I/O blocks and wait for the thread that uses this object to
-  // terminate before we allow it to be deleted.
+  // Wait for the thread that uses this object to terminate before we allow
+  // it to be deleted.
+  StartTermination();
+  H323Channel::CleanUpOnTermination();
+}
+
+
+void H323_RTPChannel::StartTermination()
+{
+  if (terminating || stopping)
+    return;
+
+  // Make sure no other channel is still relaying through this session
+  StopRelay();
+  RemoveFanOutTargets();
+
+  // Break any I/O blocks of the thread that uses this object
   if ((receiver ? receiveThread : transmitThread) != NULL)
     rtpSession.Close(receiver);
 
-  H323Channel::CleanUpOnTermination();
+  H323Channel::StartTermination();
 }
 
 
@@ -730,6 +840,9 @@ PBoolean H323_RTPChannel::Open()
   }
 
   codec->AttachLogicalChannel((H323Channel*)this);
+  rtpSession.SetTraceTag(connection.GetTraceTag());
+  codec->SetProcessingHistogram(receiver ? &rtpSession.GetDecodeHistogram()
+                                         : &rtpSession.GetEncodeHistogram());
 
   // Open the codec
   if (!codec->Open(connection)) {
@@ -787,14 +900,59 @@ PBoolean H323_RTPChannel::OnReceivedAckAltPDU(const H245_ArrayOf_GenericInformat
 
 PBoolean H323_RTPChannel::ReadFrame(DWORD & rtpTimestamp, RTP_DataFrame & frame)
 {
-  return rtpSession.ReadBufferedData(rtpTimestamp, frame);
+  if (!rtpSession.ReadBufferedData(rtpTimestamp, frame))
+    return FALSE;
+
+  // An empty frame is the jitter buffer filling a gap
+  PINDEX size = frame.GetPayloadSize();
+  H323_HOTTRACE(e_RTPReceiveFrame, rtpSession.GetTraceTag(), size);
+  if (size > 0) {
+    endpoint.GetMetrics().rtpPacketsReceived.Add();
+    endpoint.GetMetrics().rtpOctetsReceived.Add(size);
+  }
+  return TRUE;
 }
 
 PBoolean H323_RTPChannel::WriteFrame(RTP_DataFrame & frame)
 {
-  return rtpSession.PreWriteData(frame) && rtpSession.WriteData(frame);
+  PINDEX size = frame.GetPayloadSize();
+  H323_HOTTRACE(e_RTPTransmitFrame, rtpSession.GetTraceTag(), size);
+
+  // The frame itself is left plain for the channels sharing the encoder
+  RTP_DataFrame & packet = redundantEncoder != NULL && size > 0 ? redundantEncoder->Encode(frame) : frame;
+  if (!rtpSession.PreWriteData(packet) || !rtpSession.WriteData(packet))
+    return FALSE;
+
+  endpoint.GetMetrics().rtpPacketsSent.Add();
+  endpoint.GetMetrics().rtpOctetsSent.Add(size);
+  return TRUE;
+}
+
+void H323_RTPChannel::SetRedundancy(PINDEX level, RTP_DataFrame::PayloadTypes type)
+{
+  delete redundantEncoder;
+  redundantEncoder = NULL;
+
+  if (level > 0 && !receiver) {
+    redundantEncoder = new RTP_RedundantEncoder(level, type);
+    PTRACE(3, "H323RTP\tSending " << redundantEncoder->GetLevel()
+           << " redundant payloads per packet in payload type " << type);
+  }
+}
+
+
+PINDEX H323_RTPChannel::GetRedundancyLevel() const
+{
+  return redundantEncoder != NULL ? redundantEncoder->GetLevel() : 0;
+}
+
+
+RTP_DataFrame::PayloadTypes H323_RTPChannel::GetRedundancyPayloadType() const
+{
+  return redundantEncoder != NULL ? redundantEncoder->GetPayloadType() : RTP_DataFrame::IllegalPayloadType;
 }
 
+
 #if PTRACING
 class CodecReadAnalyser
 {
@@ -804,7 +962,7 @@ class CodecReadAnalyser
     void AddSample(DWORD timestamp)
       {
         if (count < MaxSamples) {
-          tick[count] = PTimer::Tick();
+          tick[count] = H323MediaClock::GetTick();
           rtp[count] = timestamp;
           count++;
         }
@@ -836,6 +994,64 @@ class CodecReadAnalyser
 #endif
 
 
+PBoolean H323_RTPChannel::SetEncodedSource(PChannel * source, PBoolean autoDelete)
+{
+  if (source != NULL && (receiver || codec == NULL || !codec->GetMediaFormat().NeedsJitterBuffer())) {
+    PTRACE(2, "H323RTP\tEncoded source only for audio transmit channels");
+    return FALSE;
+  }
+
+  PChannel * old;
+  PBoolean oldAutoDelete;
+
+  sourceMutex.Wait();
+  old = encodedSource;
+  oldAutoDelete = autoDeleteSource;
+  encodedSource = source;
+  autoDeleteSource = autoDelete;
+  sourceChanged = TRUE;
+  sourceMutex.Signal();
+
+  if (old != NULL && oldAutoDelete)
+    delete old;
+
+  PTRACE(3, "H323RTP\t" << (source != NULL ? "Sending from encoded source" : "Sending from codec"));
+  return TRUE;
+}
+
+
+PBoolean H323_RTPChannel::ReadMedia(BYTE * buffer, unsigned & length, RTP_DataFrame & frame)
+{
+  sourceMutex.Wait();
+
+  if (encodedSource == NULL) {
+    sourceMutex.Signal();
+    return codec->Read(buffer, length, frame);
+  }
+
+  if (sourceChanged) {
+    sourceDelay.Restart();
+    sourceChanged = FALSE;
+  }
+
+  // One codec frame time of encoded data, the source keeps whole frames
+  const OpalMediaFormat & mediaFormat = codec->GetMediaFormat();
+  unsigned frameTime = mediaFormat.GetFrameTime() > 0 ? mediaFormat.GetFrameTime() : 1;
+  length = mediaFormat.GetFrameSize()*codec->GetFrameRate()/frameTime;
+  if (!encodedSource->Read(buffer, length))
+    length = 0;  // Ended, send silence
+  else
+    length = encodedSource->GetLastReadCount();
+
+  sourceMutex.Signal();
+
+  // The codec is paced by its raw channel, the source by the clock
+  unsigned timeUnits = mediaFormat.GetTimeUnits() > 0 ? mediaFormat.GetTimeUnits() : 1;
+  sourceDelay.Delay(codec->GetFrameRate()/timeUnits);
+  return !terminating;
+}
+
+
 void H323_RTPChannel::Transmit()
 {
   if (terminating) {
@@ -843,6 +1059,8 @@ void H323_RTPChannel::Transmit()
     return;
   }
 
+  MediaActivityScope activityScope(connection.GetMediaActivity(), silenceStartTick);
+
   if (!codec) {
     PTRACE(3, "H323RTP\tTransmit thread terminated No Codec!");
     return;
@@ -860,6 +1078,14 @@ void H323_RTPChannel::Transmit()
   unsigned maxFrameSize = isAudio ? maxSampleSize*maxSampleTime : 2000;
   RTP_DataFrame frame(framesInPacket*maxFrameSize);
 
+  // A codec that can encode the whole packet in one Read()
+  unsigned framesPerRead = 1;
+  if (isAudio && framesInPacket > 1 && PIsDescendant(codec, H323AudioCodec) &&
+      ((H323AudioCodec *)codec)->SetFramesPerCall(framesInPacket)) {
+    PTRACE(3, "H323RTP\tTransmit " << mediaFormat << " encoding " << framesInPacket << " frames a call");
+    framesPerRead = framesInPacket;
+  }
+
   rtpPayloadType = GetRTPPayloadType();
   if (rtpPayloadType == RTP_DataFrame::IllegalPayloadType) {
      PTRACE(1, "H323RTP\tReceive " << mediaFormat << " thread ended (illegal payload type)");
@@ -881,7 +1107,41 @@ void H323_RTPChannel::Transmit()
   DWORD rtpTimestamp = PRandom();
   DWORD nextTimestamp = 0;
 #ifndef H323_FIXED_VIDEOCLOCK
-  PInt64 lastFrameTime = 0;
+  DWORD lastFrameClock = 0;
+  PBoolean haveFrameClock = FALSE;
+#endif
+  RTP_Session::ReceiverReport receiverReport;
+  unsigned receiverReportSequence = 0;
+
+  // Optionally pace the packets from the shared transmit scheduler
+  RTP_TransmitScheduler * scheduler = endpoint.GetTransmitScheduler();
+  RTP_TransmitScheduler::Stream * paceStream = NULL;
+  if (scheduler != NULL)
+    paceStream = scheduler->Register(mediaFormat);
+  unsigned timeUnits = mediaFormat.GetTimeUnits() > 0 ? mediaFormat.GetTimeUnits() : 1;
+  DWORD pacedTimestamp = rtpTimestamp;
+
+  // Video packets of a frame can be sent together where the session batches
+  if (!isAudio)
+    rtpSession.SetQueueWrites(TRUE);
+
+  // Audio levels in a header extension, kept in the frame between packets
+  // so the payload is read after it
+  unsigned audioLevelId = isAudio && PIsDescendant(codec, H323AudioCodec) ? endpoint.GetAudioLevelExtension() : 0;
+  if (audioLevelId != 0) {
+    ((H323AudioCodec *)codec)->SetAudioLevelMeasure(TRUE);
+    frame.SetAudioLevel(audioLevelId, 127, FALSE);
+    frame.SetMinSize(frame.GetHeaderSize() + framesInPacket*maxFrameSize);
+  }
+
+#ifdef H323_AUDIO_CODECS
+  // Silence is described to a remote that can play comfort noise
+  PBoolean comfortNoise = isAudio && endpoint.GetComfortNoise() &&
+                          connection.GetRemoteCapabilities().FindCapability("Comfort Noise") != NULL &&
+                          PIsDescendant(codec, H323AudioCodec) &&
+                          ((H323AudioCodec *)codec)->SetComfortNoise(TRUE);
+  RTP_DataFrame sidFrame(H323_COMFORTNOISE_MAX_SID);
+  sidFrame.SetPayloadType(RTP_DataFrame::CN);
 #endif
 
 #if PTRACING
@@ -897,7 +1157,7 @@ void H323_RTPChannel::Transmit()
      That is for GSM codec say with a single frame, this function will take
      20 milliseconds to complete.
    */
-  while (codec->Read(frame.GetPayloadPtr()+frameOffset, length, frame)) {
+  while (WaitForOwnMedia(isAudio) && ReadMedia(frame.GetPayloadPtr()+frameOffset, length, frame)) {
     // Calculate the timestamp and real time to take in processing
     if(isAudio)
     {
@@ -906,17 +1166,24 @@ void H323_RTPChannel::Transmit()
     else
     {
        if(frame.GetMarker()) {
+          // Reports on the video sent steer the codec rate between frames
+          if (rtpSession.GetLatestReceiverReport(receiverReport, receiverReportSequence))
+             codec->OnReceiverReport(receiverReport);
+
           // Video uses a 90khz clock. Note that framerate should really be a float.
 #ifdef H323_FIXED_VIDEOCLOCK
            nextTimestamp = rtpTimestamp + 90000/codec->GetFrameRate();
 #else
-           PInt64 nowTime = PTimer::Tick().GetMilliSeconds();
-           if (lastFrameTime == 0) {
+           // Whole 90kHz ticks of the media clock, so frame times are not
+           // rounded to the millisecond and the rounding never accumulates
+           DWORD nowClock = H323MediaClock::GetTimestamp(90000);
+           if (!haveFrameClock) {
               nextTimestamp = rtpTimestamp + 90000/codec->GetFrameRate();
+              haveFrameClock = TRUE;
            } else {
-              nextTimestamp = rtpTimestamp + (DWORD)(90000.0*((float)(nowTime-lastFrameTime))/1000.0);
+              nextTimestamp = rtpTimestamp + (nowClock - lastFrameClock);
            }
-           lastFrameTime = nowTime;
+           lastFrameClock = nowClock;
 #endif
        }
     }
@@ -956,7 +1223,7 @@ void H323_RTPChannel::Transmit()
     if (length == 0)
       frame.SetTimestamp(rtpTimestamp);
     else {
-      silenceStartTick = PTimer::Tick().GetMilliSeconds();
+      OnMediaActivity();
 
       // If first read frame in packet, set timestamp for it
       if (frameOffset == 0)
@@ -975,7 +1242,7 @@ void H323_RTPChannel::Transmit()
            codec that does variable length frames should never return more
            than one frame per Read() call or confusion will result.
          */
-        frameCount += (length + maxFrameSize - 1)/maxFrameSize;
+        frameCount += framesPerRead*((length + maxFrameSize - 1)/maxFrameSize);
       }
     }
 
@@ -993,23 +1260,52 @@ void H323_RTPChannel::Transmit()
       sendPacket = TRUE;
     }
 
-    if (isAudio) {
-        filterMutex.Wait();
-        for (PINDEX i = 0; i < filters.GetSize(); i++)
-          filters[i](frame, (H323_INT)&sendPacket);
-        filterMutex.Signal();
-    }
+    if (isAudio)
+      RunFilters(frame, (H323_INT)&sendPacket);
 
     if (sendPacket || (silent && frame.GetPayloadSize() > 0)) {
-      // Send the frame of coded data we have so far to RTP transport
-      if (!WriteFrame(frame))
+      // Hold the packet until its deadline, audio by its timestamp and
+      // video by the codec frame rate at the end of each frame
+      if (paceStream != NULL) {
+        unsigned period = 0;
+        if (isAudio) {
+          period = (frame.GetTimestamp() - pacedTimestamp)/timeUnits;
+          pacedTimestamp += period*timeUnits;
+        }
+        else if (frame.GetMarker() && codec->GetFrameRate() > 0)
+          period = 1000/codec->GetFrameRate();
+        if (period > 0 && !scheduler->WaitDeadline(*paceStream, period))
+          break;
+      }
+
+      // Send the frame of coded data we have so far to RTP transport,
+      // unless packets from another channel are being relayed out instead
+      PBoolean written;
+      relayMutex.Wait();
+      if (relay != NULL && !relay->IsActive()) {
+        relay->Release();
+        relay = NULL;
+      }
+      if (relay == NULL && audioLevelId != 0) {
+        unsigned level = 127;
+        PBoolean voice = FALSE;
+        ((H323AudioCodec *)codec)->TakeAudioLevel(level, voice);
+        frame.SetAudioLevel(audioLevelId, level, voice);
+      }
+      written = relay != NULL || WriteFrame(frame);
+      relayMutex.Signal();
+      if (!written)
          break;
 
+      // Channels sharing this encoder get the same packet
+      SendFanOut(frame);
+
       // video frames produce many packets per frame especially at
       // higher resolutions and can easily overload the link if sent
-      // without delay
+      // without delay, when batching the delay is between batches
       if (!isAudio) {
-         PThread::Sleep(5);
+         if (rtpSession.GetQueuedWrites() == 0)
+           PThread::Sleep(5);
          if (frame.GetMarker())
              rtpTimestamp = nextTimestamp;
       }
@@ -1023,10 +1319,34 @@ void H323_RTPChannel::Transmit()
       frameCount = 0;
     }
 
+#ifdef H323_AUDIO_CODECS
+    PINDEX sidLength;
+    if (comfortNoise && length == 0 && !paused &&
+        ((H323AudioCodec *)codec)->GetSilenceDescriptor(sidFrame.GetPayloadPtr(), sidLength)) {
+      sidFrame.SetPayloadSize(sidLength);
+      sidFrame.SetTimestamp(rtpTimestamp);
+
+      PBoolean written;
+      relayMutex.Wait();
+      written = relay != NULL || WriteFrame(sidFrame);
+      relayMutex.Signal();
+      if (!written)
+        break;
+
+      SendFanOut(sidFrame);
+    }
+#endif
+
     if (terminating)
       break;
   }
 
+  if (paceStream != NULL)
+    scheduler->Unregister(paceStream);
+
+  if (!isAudio)
+    rtpSession.SetQueueWrites(FALSE);
+
 #if PTRACING
   if (PTrace::GetLevel() >= 5) {
       PTRACE_IF(5, codecReadAnalysis != NULL, "Codec read timing:\n" << *codecReadAnalysis);
@@ -1077,6 +1397,8 @@ void H323_RTPChannel::Receive()
     return;
   }
 
+  MediaActivityScope activityScope(connection.GetMediaActivity(), silenceStartTick);
+
   if (!codec) {
     PTRACE(3, "H323RTP\tReceive thread terminated No Codec!");
     return;
@@ -1090,7 +1412,8 @@ void H323_RTPChannel::Receive()
   if (mediaFormat.NeedsJitterBuffer() && endpoint.UseJitterBuffer())
     rtpSession.SetJitterBufferSize(connection.GetMinAudioJitterDelay()*mediaFormat.GetTimeUnits(),
                                    connection.GetMaxAudioJitterDelay()*mediaFormat.GetTimeUnits(),
-                                   endpoint.GetJitterThreadStackSize());
+                                   endpoint.GetJitterThreadStackSize(),
+                                   endpoint.GetJitterBufferEngine());
 
   rtpPayloadType = GetRTPPayloadType();
   if (rtpPayloadType == RTP_DataFrame::IllegalPayloadType) {
@@ -1110,22 +1433,162 @@ void H323_RTPChannel::Receive()
   PBoolean isAudio = codec->GetMediaFormat().NeedsJitterBuffer();
   PBoolean allowRtpPayloadChange = isAudio;
 
+  // Conceal lost frames, and shorten frames when the jitter buffer asks
+  PBoolean timeStretch = FALSE;
+  if (isAudio && endpoint.GetAudioConcealment() && PIsDescendant(codec, H323AudioCodec) &&
+      ((H323AudioCodec *)codec)->SetConcealment(TRUE))
+    timeStretch = rtpSession.SetTimeStretch(TRUE);
+
+  // Decode a packet of frames in one call where the codec can
+  PBoolean batchDecode = isAudio && PIsDescendant(codec, H323AudioCodec) &&
+                         ((H323AudioCodec *)codec)->SetFramesPerCall(capability->GetRxFramesInPacket());
+  PTRACE_IF(3, batchDecode, "H323RTP\tReceive " << mediaFormat << " decoding up to " << capability->GetRxFramesInPacket() << " frames a call");
+
+#ifdef H323_VIDEO
+  // Video goes to the decoder a whole picture at a time
+  PINDEX reassemblyWindow = endpoint.GetVideoReassemblyWindow();
+  PBoolean reassemble = !isAudio && reassemblyWindow > 0 && PIsDescendant(codec, H323VideoCodec);
+  H323VideoAssembler assembler(reassemblyWindow);
+  RTP_DataFrame picturePacket;
+#endif
+
+#ifdef H323_AUDIO_CODECS
+  // Silence descriptors are played as comfort noise when advertised
+  PBoolean comfortNoise = isAudio && endpoint.GetComfortNoise() && PIsDescendant(codec, H323AudioCodec) &&
+                          ((H323AudioCodec *)codec)->SetComfortNoise(TRUE);
+#endif
+
+  unsigned audioLevelId = isAudio ? endpoint.GetAudioLevelExtension() : 0;
+
+  // Lip sync between the main audio and video sessions of the call
+  H323AVSync * avSync = NULL;
+  if (endpoint.GetLipSync() &&
+      GetSessionID() == (isAudio ? (unsigned)RTP_Session::DefaultAudioSessionID : (unsigned)RTP_Session::DefaultVideoSessionID))
+    avSync = &connection.GetAVSync();
+  RTP_Session::SenderReport avReport;
+  unsigned audioClockRate = mediaFormat.GetTimeUnits()*1000;
+  unsigned audioSyncDelay = 0;
+  PInt64 videoHoldEnd = 0;
+
   // UniDirectional Channel NAT support
   SendUniChannelBackProbe();
 
   RTP_DataFrame frame;
   while (ReadFrame(rtpTimestamp, frame)) {
 
-    if (isAudio) {
-      filterMutex.Wait();
-      for (PINDEX i = 0; i < filters.GetSize(); i++)
-        filters[i](frame, 0);
-      filterMutex.Signal();
+    if (isAudio)
+      RunFilters(frame, 0);
+
+    // Packets without an audio level are decoded whatever the setting
+    PBoolean silentPacket = FALSE;
+    unsigned level;
+    PBoolean voice;
+    if (audioLevelId != 0 && frame.GetAudioLevel(audioLevelId, level, voice)) {
+      receivedAudioLevel = level;
+      receivedVoice = voice;
+      silentPacket = skipSilentDecode && !voice;
     }
 
     int payloadSize = frame.GetPayloadSize();
     rtpTimestamp = frame.GetTimestamp();
 
+    if (avSync != NULL) {
+      if (rtpSession.AVSyncData(avReport))
+        avSync->OnSenderReport(isAudio ? H323AVSync::Audio : H323AVSync::Video,
+                               avReport.rtpTimestamp, avReport.realTimestamp);
+
+      if (isAudio) {
+        // Frames come out of the jitter buffer as they are played
+        if (payloadSize > 0)
+          avSync->OnPlayout(H323AVSync::Audio, rtpTimestamp, audioClockRate, H323MediaClock::GetMicroseconds());
+
+        unsigned delay = avSync->GetAudioDelay();
+        if (delay != audioSyncDelay) {
+          rtpSession.SetJitterSyncDelay(delay*mediaFormat.GetTimeUnits());
+          audioSyncDelay = delay;
+        }
+      }
+    }
+
+#ifdef H323_AUDIO_CODECS
+    // A silence descriptor is a frame of silence, never a payload mismatch
+    if (isAudio && payloadSize > 0 && frame.GetPayloadType() == RTP_DataFrame::CN &&
+        rtpPayloadType != RTP_DataFrame::CN) {
+      OnMediaActivity();
+      if (comfortNoise)
+        ((H323AudioCodec *)codec)->OnSilenceDescriptor(frame.GetPayloadPtr(), payloadSize);
+
+      rec_written = 0;
+      rec_ok = codec->Write(NULL, 0, frame, rec_written);
+
+      if (terminating)
+        break;
+
+      if (!rec_ok) {
+        connection.CloseLogicalChannelNumber(number);
+        break;
+      }
+      continue;
+    }
+#endif
+
+    // Relayed packets bypass the codec, other payload types such as
+    // RFC2833 are still handled here
+    if (payloadSize > 0 && frame.GetPayloadType() == rtpPayloadType) {
+      PBoolean relayed = FALSE;
+      PBoolean update = FALSE;
+      relayMutex.Wait();
+      if (relay != NULL) {
+        relayed = relay->Forward(frame);
+        update = relayed && relay->TakeUpdateRequest();
+        if (!relayed) {
+          PTRACE(2, "H323RTP\tRelay ended, decoding " << mediaFormat << " again");
+          relay->Release();
+          relay = NULL;
+        }
+      }
+      relayMutex.Signal();
+      if (update) {
+        PTRACE(4, "H323RTP\tRequesting fast update for relayed " << mediaFormat);
+        connection.SendLogicalChannelMiscCommand(*this, H245_MiscellaneousCommand_type::e_videoFastUpdatePicture);
+      }
+      if (relayed) {
+        OnMediaActivity();
+        if (terminating)
+          break;
+        continue;
+      }
+    }
+
+#ifdef H323_VIDEO
+    if (reassemble && payloadSize > 0 && frame.GetPayloadType() == rtpPayloadType) {
+      OnMediaActivity();
+      consecutiveMismatches = 0;
+
+      assembler.Push(frame);
+      if (assembler.TakeDroppedPictures() > 0)
+        ((H323VideoCodec *)codec)->OnIncompletePicture();
+
+      rec_ok = TRUE;
+      while (rec_ok && assembler.Pop(picturePacket)) {
+        if (avSync != NULL)
+          HoldVideoForLipSync(*avSync, picturePacket.GetTimestamp(), videoHoldEnd);
+        rec_written = 0;
+        rec_ok = codec->Write(picturePacket.GetPayloadPtr(), paused ? 0 : picturePacket.GetPayloadSize(),
+                              picturePacket, rec_written);
+      }
+
+      if (terminating)
+        break;
+
+      if (!rec_ok) {
+        connection.CloseLogicalChannelNumber(number);
+        break;
+      }
+      continue;
+    }
+#endif
+
 #if 0  // Enable if you want A/V sync information  - SH
     RTP_Session::SenderReport avData;
     if (rtpSession.AVSyncData(avData))
@@ -1145,7 +1608,7 @@ void H323_RTPChannel::Receive()
       rec_ok = codec->Write(NULL, 0, frame, rec_written);
       rtpTimestamp += codecFrameRate;
     } else {
-      silenceStartTick = PTimer::Tick().GetMilliSeconds();
+      OnMediaActivity();
 
       if (frame.GetPayloadType() == rtpPayloadType) {
         PTRACE_IF(2, consecutiveMismatches > 0,
@@ -1165,6 +1628,12 @@ void H323_RTPChannel::Receive()
       }
 
       if (consecutiveMismatches == 0) {
+        if (timeStretch && rtpSession.TakeTimeStretchRequest())
+          ((H323AudioCodec *)codec)->RequestSpeedUp();
+
+        if (avSync != NULL && !isAudio)
+          HoldVideoForLipSync(*avSync, rtpTimestamp, videoHoldEnd);
+
         const BYTE * ptr = frame.GetPayloadPtr();
         while (rec_ok && payloadSize > 0) {
           /* Now write data to the codec, it is expected that the Write()
@@ -1173,7 +1642,7 @@ void H323_RTPChannel::Receive()
              20 milliseconds to complete. It is very important that this occurs
              for audio codecs or the jitter buffer will not operate correctly.
            */
-          rec_ok = codec->Write(ptr, paused ? 0 : payloadSize, frame, rec_written);
+          rec_ok = codec->Write(ptr, paused || silentPacket ? 0 : payloadSize, frame, rec_written);
           rtpTimestamp += codecFrameRate;
           payloadSize -= rec_written != 0 ? rec_written : payloadSize;
           ptr += rec_written;
@@ -1191,25 +1660,95 @@ void H323_RTPChannel::Receive()
     }
   }
 
+#ifdef H323_VIDEO
+  PTRACE_IF(3, reassemble, "H323RTP\tReceive " << mediaFormat << " reassembly: " << assembler);
+#endif
   PTRACE(2, "H323RTP\tReceive " << mediaFormat << " thread ended");
 }
 
 
+void H323_RTPChannel::RunFilters(RTP_DataFrame & frame, H323_INT param)
+{
+  if (filterChain == NULL)
+    return;
+
+  ++filterReaders;
+  FilterList * chain = filterChain;
+  if (chain != NULL) {
+    for (PINDEX i = 0; i < chain->GetSize(); i++)
+      (*chain)[i](frame, param);
+  }
+  --filterReaders;
+}
+
+
+void H323_RTPChannel::PublishFilters(FilterList * newChain)
+{
+  FilterList * oldChain = filterChain;
+
+  // The new list must be complete before the media thread can see it
+  H323_MEMORY_BARRIER();
+  filterChain = newChain;
+  H323_MEMORY_BARRIER();
+
+  if (oldChain != NULL)
+    retiredFilters.Append(oldChain);
+
+  // A media thread running filters now may still be in a retired list,
+  // any that starts later sees the new one
+  if (filterReaders == 0)
+    retiredFilters.RemoveAll();
+}
+
+
 void H323_RTPChannel::AddFilter(const PNotifier & filterFunction)
 {
-  filterMutex.Wait();
-  filters.Append(new PNotifier(filterFunction));
-  filterMutex.Signal();
+  PWaitAndSignal m(filterMutex);
+
+  FilterList * newChain = new FilterList;
+  if (filterChain != NULL) {
+    for (PINDEX i = 0; i < filterChain->GetSize(); i++)
+      newChain->Append(new PNotifier((*filterChain)[i]));
+  }
+  newChain->Append(new PNotifier(filterFunction));
+
+  PublishFilters(newChain);
 }
 
 
 void H323_RTPChannel::RemoveFilter(const PNotifier & filterFunction)
 {
-  filterMutex.Wait();
-  PINDEX idx = filters.GetValuesIndex(filterFunction);
-  if (idx != P_MAX_INDEX)
-    filters.RemoveAt(idx);
-  filterMutex.Signal();
+  PWaitAndSignal m(filterMutex);
+
+  if (filterChain == NULL)
+    return;
+
+  PINDEX idx = filterChain->GetValuesIndex(filterFunction);
+  if (idx == P_MAX_INDEX)
+    return;
+
+  FilterList * newChain = NULL;
+  if (filterChain->GetSize() > 1) {
+    newChain = new FilterList;
+    for (PINDEX i = 0; i < filterChain->GetSize(); i++) {
+      if (i != idx)
+        newChain->Append(new PNotifier((*filterChain)[i]));
+    }
+  }
+
+  PublishFilters(newChain);
+}
+
+
+void H323_RTPChannel::OnMediaActivity()
+{
+  PInt64 now = PTimer::Tick().GetMilliSeconds();
+
+  H323MediaActivity * activity = connection.GetMediaActivity();
+  if (activity != NULL)
+    activity->OnMedia(now, silenceStartTick == 0);
+
+  silenceStartTick = now;
 }
 
 
@@ -1222,6 +1761,369 @@ PInt64 H323_RTPChannel::GetSilenceDuration() const
 }
 
 
+PBoolean H323_RTPChannel::SetRelayTarget(H323_RTPChannel * transmitter)
+{
+  StopRelay();
+
+  if (transmitter == NULL)
+    return TRUE;
+
+  if (!receiver || transmitter->receiver) {
+    PTRACE(1, "H323RTP\tRelay must be from a receive to a transmit channel");
+    return FALSE;
+  }
+
+  if (capability->GetFormatName() != transmitter->GetCapability().GetFormatName()) {
+    PTRACE(1, "H323RTP\tCannot relay " << capability->GetFormatName()
+           << " to " << transmitter->GetCapability().GetFormatName());
+    return FALSE;
+  }
+
+  H323Codec * transmitCodec = transmitter->GetCodec();
+  H323_RTPRelay * newRelay = new H323_RTPRelay(transmitter->rtpSession,
+                                               transmitter->GetRTPPayloadType(),
+                                               transmitCodec != NULL ? transmitCodec->GetFrameRate() : 0);
+
+  // The transmitter may still be the target of an earlier relay
+  transmitter->StopRelay();
+  transmitter->relayMutex.Wait();
+  transmitter->relay = newRelay;
+  transmitter->relayMutex.Signal();
+
+  relayMutex.Wait();
+  relay = newRelay;
+  relayMutex.Signal();
+
+  PTRACE(3, "H323RTP\tRelaying " << capability->GetFormatName() << " from session "
+         << GetSessionID() << " to session " << transmitter->GetSessionID());
+  return TRUE;
+}
+
+
+PBoolean H323_RTPChannel::IsRelaying() const
+{
+  PWaitAndSignal m(relayMutex);
+  return relay != NULL && relay->IsActive();
+}
+
+
+void H323_RTPChannel::StopRelay()
+{
+  relayMutex.Wait();
+  H323_RTPRelay * oldRelay = relay;
+  relay = NULL;
+  relayMutex.Signal();
+
+  if (oldRelay != NULL) {
+    oldRelay->Stop();
+    oldRelay->Release();
+  }
+}
+
+
+PBoolean H323_RTPChannel::AddFanOutTarget(H323_RTPChannel * transmitter)
+{
+  if (transmitter == NULL || transmitter == this || receiver || transmitter->receiver) {
+    PTRACE(1, "H323RTP\tFan out must be from a transmit to another transmit channel");
+    return FALSE;
+  }
+
+  if (capability->GetFormatName() != transmitter->GetCapability().GetFormatName()) {
+    PTRACE(1, "H323RTP\tCannot fan out " << capability->GetFormatName()
+           << " to " << transmitter->GetCapability().GetFormatName());
+    return FALSE;
+  }
+
+  H323Codec * sourceCodec = GetCodec();
+  H323Codec * targetCodec = transmitter->GetCodec();
+  if (sourceCodec != NULL && targetCodec != NULL &&
+      targetCodec->GetMediaFormat().GetBandwidth() < sourceCodec->GetMediaFormat().GetBandwidth()) {
+    PTRACE(1, "H323RTP\tCannot fan out " << capability->GetFormatName() << " at "
+           << sourceCodec->GetMediaFormat().GetBandwidth() << " to a channel allowing "
+           << targetCodec->GetMediaFormat().GetBandwidth());
+    return FALSE;
+  }
+
+  H323_RTPRelay * leg = new H323_RTPRelay(transmitter->rtpSession,
+                                          transmitter->GetRTPPayloadType(),
+                                          targetCodec != NULL ? targetCodec->GetFrameRate() : 0);
+  leg->RequestUpdate();   // the new leg needs an intra frame to start
+
+  // Both sending to one group, the packets of this channel reach the receivers of both
+  if (PIsDescendant(&rtpSession, RTP_UDP) && PIsDescendant(&transmitter->rtpSession, RTP_UDP)) {
+    const RTP_UDP & source = (const RTP_UDP &)rtpSession;
+    const RTP_UDP & target = (const RTP_UDP &)transmitter->rtpSession;
+    if (source.IsMulticastTransmit() && target.IsMulticastTransmit() &&
+        source.GetMulticastGroup() == target.GetMulticastGroup() &&
+        source.GetMulticastDataPort() == target.GetMulticastDataPort()) {
+      PTRACE(3, "H323RTP\tSession " << transmitter->GetSessionID() << " shares multicast group "
+             << source.GetMulticastGroup() << ':' << source.GetMulticastDataPort() << ", not sent to");
+      leg->SetForwarding(FALSE);
+    }
+  }
+
+  // The target may already be fed by another source
+  transmitter->StopRelay();
+  transmitter->relayMutex.Wait();
+  transmitter->relay = leg;
+  transmitter->relayMutex.Signal();
+
+  fanOutMutex.Wait();
+  fanOut.Append(leg);
+  fanOutMutex.Signal();
+
+  PTRACE(3, "H323RTP\tFanning out " << capability->GetFormatName() << " from session "
+         << GetSessionID() << " to session " << transmitter->GetSessionID());
+  return TRUE;
+}
+
+
+void H323_RTPChannel::RemoveFanOutTargets()
+{
+  fanOutMutex.Wait();
+  PList<H323_RTPRelay> legs;
+  legs.DisallowDeleteObjects();
+  while (fanOut.GetSize() > 0)
+    legs.Append(fanOut.RemoveAt(0));
+  fanOutMutex.Signal();
+
+  for (PINDEX i = 0; i < legs.GetSize(); i++) {
+    legs[i].Stop();
+    legs[i].Release();
+  }
+}
+
+
+PINDEX H323_RTPChannel::GetFanOutCount() const
+{
+  PWaitAndSignal m(fanOutMutex);
+  return fanOut.GetSize();
+}
+
+
+void H323_RTPChannel::OnMiscellaneousCommand(const H245_MiscellaneousCommand_type & type)
+{
+  if (type.GetTag() == H245_MiscellaneousCommand_type::e_videoFastUpdatePicture) {
+    relayMutex.Wait();
+    PBoolean relayed = relay != NULL && relay->IsActive();
+    if (relayed)
+      relay->RequestUpdate();
+    relayMutex.Signal();
+    if (relayed) {
+      PTRACE(4, "H323RTP\tFast update on channel " << number << " passed to relay source");
+      return;
+    }
+  }
+
+  H323_RealTimeChannel::OnMiscellaneousCommand(type);
+}
+
+
+void H323_RTPChannel::HoldVideoForLipSync(H323AVSync & avSync, DWORD rtpTimestamp, PInt64 & holdEnd)
+{
+  PInt64 now = H323MediaClock::GetMicroseconds();
+
+  // A packet read right after a hold may have been waiting in the socket,
+  // so only those read fresh give the delay of the video
+  if (now - holdEnd > LIP_SYNC_FRESH_READ)
+    avSync.OnPlayout(H323AVSync::Video, rtpTimestamp, 90000, now);
+
+  // Packets of a picture share its deadline, only the first waits
+  PInt64 deadline = avSync.GetVideoDeadline(rtpTimestamp, 90000);
+  if (deadline > now) {
+    PThread::Sleep((unsigned)((deadline - now)/1000));
+    holdEnd = H323MediaClock::GetMicroseconds();
+  }
+}
+
+
+PBoolean H323_RTPChannel::GetReceivedAudioLevel(unsigned & level, PBoolean & voice) const
+{
+  // Written by the receive thread alone, a torn read costs one packet
+  unsigned lastLevel = receivedAudioLevel;
+  if (lastLevel > 127)
+    return FALSE;
+
+  level = lastLevel;
+  voice = receivedVoice;
+  return TRUE;
+}
+
+
+PBoolean H323_RTPChannel::WaitForOwnMedia(PBoolean isAudio)
+{
+  // A video leg fed by another channel's encoder does not encode at all
+  if (isAudio || !IsRelaying())
+    return TRUE;
+
+  PTRACE(3, "H323RTP\tTransmit " << capability->GetFormatName() << " fed by another encoder");
+  while (IsRelaying()) {
+    if (terminating)
+      return FALSE;
+    PThread::Sleep(20);
+  }
+
+  // Resume from an intra frame
+  PTRACE(3, "H323RTP\tTransmit " << capability->GetFormatName() << " encoding again");
+  H245_MiscellaneousCommand_type update;
+  update.SetTag(H245_MiscellaneousCommand_type::e_videoFastUpdatePicture);
+  codec->OnMiscellaneousCommand(update);
+  return !terminating;
+}
+
+
+void H323_RTPChannel::SendFanOut(const RTP_DataFrame & frame)
+{
+  PWaitAndSignal m(fanOutMutex);
+
+  if (fanOut.IsEmpty())
+    return;
+
+  PINDEX size = frame.GetHeaderSize() + frame.GetPayloadSize();
+  PBoolean update = FALSE;
+
+  PINDEX i = 0;
+  while (i < fanOut.GetSize()) {
+    H323_RTPRelay & leg = fanOut[i];
+
+    // Each leg rewrites the header for its own session
+    RTP_DataFrame copy(0);
+    copy.SetMinSize(size);
+    memcpy(copy.GetPointer(), (const BYTE *)frame, size);
+    copy.SetPayloadSize(frame.GetPayloadSize());
+
+    if (leg.Forward(copy)) {
+      if (leg.TakeUpdateRequest())
+        update = TRUE;
+      i++;
+    }
+    else {
+      PTRACE(3, "H323RTP\tFan out leg of " << capability->GetFormatName() << " ended");
+      fanOut.RemoveAt(i);
+      leg.Release();
+    }
+  }
+
+  // All the legs asking since the last packet get one intra frame
+  if (update) {
+    PTRACE(4, "H323RTP\tFast update for " << capability->GetFormatName() << " requested by fan out legs");
+    H245_MiscellaneousCommand_type command;
+    command.SetTag(H245_MiscellaneousCommand_type::e_videoFastUpdatePicture);
+    codec->OnMiscellaneousCommand(command);
+  }
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323_RTPRelay::H323_RTPRelay(RTP_Session & session,
+                             RTP_DataFrame::PayloadTypes type,
+                             DWORD gap)
+  : target(&session),
+    forwarding(TRUE),
+    payloadType(type),
+    timestampGap(gap),
+    timestampOffset(0),
+    lastSequenceNumber(0),
+    syncSource(0),
+    started(FALSE),
+    updateRequested(FALSE),
+    references(2)   // held by the sending and the receiving channel
+{
+}
+
+
+PBoolean H323_RTPRelay::Forward(RTP_DataFrame & frame)
+{
+  PWaitAndSignal m(mutex);
+
+  if (target == NULL)
+    return FALSE;
+
+  if (!forwarding)
+    return TRUE;
+
+  WORD sequenceNumber = frame.GetSequenceNumber();
+  if (started) {
+    WORD gap = (WORD)(sequenceNumber - lastSequenceNumber);
+    if (gap == 0 || gap >= 0x8000)
+      return TRUE;  // Duplicate or late, drop it
+    if (frame.GetSyncSource() != syncSource || gap > 100)
+      started = FALSE;  // New source stream, join it again
+    else if (gap > 1)
+      target->SkipSequenceNumbers((WORD)(gap-1));
+  }
+
+  if (!started) {
+    // Carry on from the last timestamp the target sent, and mark the jump
+    timestampOffset = target->GetLastSentTimestamp() + timestampGap - frame.GetTimestamp();
+    syncSource = frame.GetSyncSource();
+    frame.SetMarker(TRUE);
+    started = TRUE;
+  }
+
+  lastSequenceNumber = sequenceNumber;
+  frame.SetTimestamp(frame.GetTimestamp() + timestampOffset);
+  frame.SetPayloadType(payloadType);
+
+  if (!target->PreWriteData(frame) || !target->WriteData(frame)) {
+    target = NULL;
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+
+void H323_RTPRelay::Stop()
+{
+  PWaitAndSignal m(mutex);
+  target = NULL;
+}
+
+
+PBoolean H323_RTPRelay::IsActive() const
+{
+  PWaitAndSignal m(mutex);
+  return target != NULL;
+}
+
+
+void H323_RTPRelay::SetForwarding(PBoolean send)
+{
+  PWaitAndSignal m(mutex);
+  forwarding = send;
+  started = FALSE;  // Join the stream again if sending resumes
+}
+
+
+void H323_RTPRelay::RequestUpdate()
+{
+  PWaitAndSignal m(mutex);
+  updateRequested = TRUE;
+}
+
+
+PBoolean H323_RTPRelay::TakeUpdateRequest()
+{
+  PWaitAndSignal m(mutex);
+  PBoolean requested = updateRequested;
+  updateRequested = FALSE;
+  return requested;
+}
+
+
+void H323_RTPRelay::Release()
+{
+  mutex.Wait();
+  PBoolean last = --references == 0;
+  mutex.Signal();
+
+  if (last)
+    delete this;
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
 
 H323_ExternalRTPChannel::H323_ExternalRTPChannel(H323Connection & connection,
@@ -1519,14 +2421,25 @@ void H323DataChannel::CleanUpOnTermination()
 
   PTRACE(3, "LogChan\tCleaning up data channel " << number);
 
-  // Break any I/O blocks and wait for the thread that uses this object to
-  // terminate before we allow it to be deleted.
+  // Wait for the thread that uses this object to terminate before we allow
+  // it to be deleted.
+  StartTermination();
+  H323UnidirectionalChannel::CleanUpOnTermination();
+}
+
+
+void H323DataChannel::StartTermination()
+{
+  if (terminating || stopping)
+    return;
+
+  // Break any I/O blocks of the thread that uses this object
   if (listener != NULL)
     listener->Close();
   if (transport != NULL)
     transport->Close();
 
-  H323UnidirectionalChannel::CleanUpOnTermination();
+  H323UnidirectionalChannel::StartTermination();
 }
 
 
@@ -45,6 +45,11 @@
 #include "channels.h"
 #include "h323pdu.h"
 #include "h323con.h"
+#include "g711block.h"
+#include "h323plc.h"
+#include "h323comfortnoise.h"
+#include "h323mediaclock.h"
+#include "h323simulcast.h"
 
 #ifdef H323_AEC
 #include <etc/h323aec.h>
@@ -54,6 +59,15 @@ extern "C" {
 #include "g711.h"
 };
 
+#ifndef H323_CODECS_NO_SIMD
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define H323_CODECS_SSE2 1
+#include <emmintrin.h>
+#endif
+#endif // H323_CODECS_NO_SIMD
+
+#include <math.h>
+
 #define new PNEW
 
 /////////////////////////////////////////////////////////////////////////////
@@ -62,6 +76,7 @@ H323Codec::H323Codec(const OpalMediaFormat & fmt, Direction dir)
   : mediaFormat(fmt)
 {
   logicalChannel = NULL;
+  processingHistogram = NULL;
   direction = dir;
 
   lastSequenceNumber = 1;
@@ -98,6 +113,11 @@ void H323Codec::OnFlowControl(long PTRACE_PARAM(bitRateRestriction))
 }
 
 
+void H323Codec::OnReceiverReport(const RTP_Session::ReceiverReport & /*report*/)
+{
+}
+
+
 void H323Codec::OnMiscellaneousCommand(const H245_MiscellaneousCommand_type & PTRACE_PARAM(type))
 {
   PTRACE(3, "Codec\tOnMiscellaneousCommand: " << type.GetTagName());
@@ -271,7 +291,8 @@ H323VideoCodec::H323VideoCodec(const OpalMediaFormat & fmt, Direction dir)
     videoBitRateControlModes(None), bitRateHighLimit(0), oldLength(0), oldTime(0), newTime(0),
     targetFrameTimeMs(0), frameBytes(0), sumFrameTimeMs(0), sumAdjFrameTimeMs(0), sumFrameBytes(0),
     videoQMax(0), videoQMin(0), videoQuality(0), frameStartTime(0), grabInterval(0), frameNum(0),
-    packetNum(0), oldPacketNum(0), framesPerSec(0)
+    packetNum(0), oldPacketNum(0), framesPerSec(0), encodeWidth(0), encodeHeight(0), decodePriority(0),
+    simulcast(NULL), simulcastReceiver(NULL)
 {
 
 }
@@ -281,6 +302,8 @@ H323VideoCodec::~H323VideoCodec()
 {
   Close();    //The close operation may delete the rawDataChannel.
 
+  delete simulcastReceiver;
+
   //mediaFormat.RemoveAllOptions();
 }
 
@@ -382,6 +405,12 @@ void H323VideoCodec::OnLostPicture()
 }
 
 
+void H323VideoCodec::OnIncompletePicture()
+{
+  PTRACE(4, "Codec\tOnIncompletePicture()");
+}
+
+
 void H323VideoCodec::OnMiscellaneousIndication(const H245_MiscellaneousIndication_type & type)
 {
   switch (type.GetTag()) {
@@ -434,14 +463,97 @@ void H323VideoCodec::OnVideoNotDecodedMBs(unsigned PTRACE_PARAM(firstMB),
 }
 
 
+PBoolean H323VideoCodec::SetEncodeFrameSize(unsigned width, unsigned height)
+{
+  if (((width | height) & 1) != 0 || (width == 0) != (height == 0))
+    return FALSE;
+
+  PWaitAndSignal mutex(videoHandlerActive);
+  encodeWidth = width;
+  encodeHeight = height;
+  PTRACE(4, "Codec\tEncoding at " << width << 'x' << height << " using "
+         << H323VideoConverter::GetKernelName(videoConverter.GetKernel()) << " scaling");
+  return TRUE;
+}
+
+
+void H323VideoCodec::AddDecodedFrameHandler(const PNotifier & handler)
+{
+  decodedFrameMutex.Wait();
+  decodedFrameHandlers.Append(new PNotifier(handler));
+  decodedFrameMutex.Signal();
+}
+
+
+void H323VideoCodec::RemoveDecodedFrameHandler(const PNotifier & handler)
+{
+  decodedFrameMutex.Wait();
+  PINDEX idx = decodedFrameHandlers.GetValuesIndex(handler);
+  if (idx != P_MAX_INDEX)
+    decodedFrameHandlers.RemoveAt(idx);
+  decodedFrameMutex.Signal();
+}
+
+
+void H323VideoCodec::OnDecodedFrame(H323VideoFrameRef & frame)
+{
+  PWaitAndSignal m(decodedFrameMutex);
+  for (PINDEX i = 0; i < decodedFrameHandlers.GetSize(); i++)
+    decodedFrameHandlers[i](frame, 0);
+}
+
+
 void H323VideoCodec::Close()
 {
   PWaitAndSignal mutex1(videoHandlerActive);
 
+  if (simulcast != NULL) {
+    simulcast->Detach(*simulcastReceiver);
+    simulcast = NULL;
+  }
+
   CloseRawDataChannel();
 }
 
 
+PBoolean H323VideoCodec::SetSimulcastLayer(H323VideoSimulcast * newSimulcast, PINDEX layer, unsigned maxTemporalId)
+{
+  if (direction != Encoder)
+    return FALSE;
+
+  PWaitAndSignal mutex(videoHandlerActive);
+
+  if (simulcast != NULL && simulcast != newSimulcast) {
+    simulcast->Detach(*simulcastReceiver);
+    simulcast = NULL;
+    PTRACE(3, "Codec\tEncoding again, no longer sending a simulcast layer");
+  }
+
+  if (newSimulcast == NULL)
+    return TRUE;
+
+  if (simulcastReceiver == NULL)
+    simulcastReceiver = new H323SimulcastReceiver;
+
+  if (!newSimulcast->Attach(*simulcastReceiver, layer, maxTemporalId))
+    return FALSE;
+
+  simulcast = newSimulcast;
+  PTRACE(3, "Codec\tSending simulcast layer " << layer);
+  return TRUE;
+}
+
+
+PBoolean H323VideoCodec::EncodePicture(const BYTE * /*picture*/,
+                                       unsigned /*width*/,
+                                       unsigned /*height*/,
+                                       PBoolean & /*intra*/,
+                                       std::vector<PBYTEArray> & /*packets*/)
+{
+  return FALSE;
+}
+
+
 PBoolean H323VideoCodec::SetMaxBitRate(unsigned bitRate)
 {
   PTRACE(1,"Set bitRateHighLimit for video to " << bitRate << " bps");
@@ -513,7 +625,13 @@ H323AudioCodec::H323AudioCodec(const OpalMediaFormat & fmt, Direction dir)
 
   IsRawDataHeld = FALSE;
 
+  audioLevelMeasure = FALSE;
+  lastSignalLevel = UINT_MAX;
+  audioLevel = UINT_MAX;
+  audioVoice = FALSE;
+
   // Initialise the adaptive threshold variables.
+  lowNoiseFloor = highNoiseFloor = 0;
   SetSilenceDetectionMode(AdaptiveSilenceDetection);
 }
 
@@ -583,13 +701,14 @@ void H323AudioCodec::SetSilenceDetectionMode(SilenceDetectionMode mode,
   // This is the period over which the adaptive algorithm operates
   adaptiveThresholdFrames = (adaptivePeriod+samplesPerFrame-1)/samplesPerFrame;
 
-  if (mode != AdaptiveSilenceDetection) {
+  if (mode != AdaptiveSilenceDetection && mode != SpectralSilenceDetection) {
     levelThreshold = threshold;
     return;
   }
 
   // Initials threshold levels
   levelThreshold = 0;
+  lowNoiseFloor = highNoiseFloor = 0;
 
   // Initialise the adaptive threshold variables.
   signalMinimum = UINT_MAX;
@@ -602,23 +721,67 @@ void H323AudioCodec::SetSilenceDetectionMode(SilenceDetectionMode mode,
 }
 
 
+// Lowest band energy taken as signal, an RMS of 10 in the quartered samples
+#define MINIMUM_BAND_ENERGY 100
+
+static PBoolean BandAboveNoiseFloor(unsigned energy, unsigned & floor)
+{
+  // Signal is 6dB over the floor
+  PBoolean above = energy > MINIMUM_BAND_ENERGY && energy/4 > floor;
+
+  // The floor falls quickly to quieter frames and creeps up by under 2dB a
+  // second at 20ms frames, so talk does not lift it far
+  if (energy < floor)
+    floor -= (floor - energy)/2;
+  else
+    floor += floor/128 + 1;
+
+  return above;
+}
+
+
 PBoolean H323AudioCodec::DetectSilence()
 {
+  lastSignalLevel = UINT_MAX;
+
   // Can never have silence if NoSilenceDetection
   if (silenceDetectMode == NoSilenceDetection)
     return FALSE;
 
-  // Can never have average signal level that high, this indicates that the
-  // hardware cannot do silence detection.
-  unsigned level = GetAverageSignalLevel();
-  if (level == UINT_MAX)
-    return FALSE;
+  unsigned level = 0;
+  PBoolean haveSignal;
+  unsigned lowEnergy, highEnergy;
+  PBoolean spectral = silenceDetectMode == SpectralSilenceDetection &&
+                      GetSignalBandEnergy(lowEnergy, highEnergy);
+  if (spectral) {
+    if (lowNoiseFloor == 0 && highNoiseFloor == 0) {
+      // Bootstrap condition, use first frame as the noise floor
+      lowNoiseFloor = lowEnergy+1;
+      highNoiseFloor = highEnergy+1;
+      return TRUE;
+    }
 
-  // Convert to a logarithmic scale - use uLaw which is complemented
-  level = linear2ulaw(level) ^ 0xff;
+    // Voiced speech lifts the low band, fricatives the high band, while
+    // steady noise stays at its floor in both
+    PBoolean lowSignal = BandAboveNoiseFloor(lowEnergy, lowNoiseFloor);
+    PBoolean highSignal = BandAboveNoiseFloor(highEnergy, highNoiseFloor);
+    haveSignal = lowSignal || highSignal;
+  }
+  else {
+    // Can never have average signal level that high, this indicates that the
+    // hardware cannot do silence detection.
+    level = GetAverageSignalLevel();
+    if (level == UINT_MAX)
+      return FALSE;
 
-  // Now if signal level above threshold we are "talking"
-  PBoolean haveSignal = level > levelThreshold;
+    lastSignalLevel = level;
+
+    // Convert to a logarithmic scale - use uLaw which is complemented
+    level = linear2ulaw(level) ^ 0xff;
+
+    // Now if signal level above threshold we are "talking"
+    haveSignal = level > levelThreshold;
+  }
 
   // If no change ie still talking or still silent, resent frame counter
   if (inTalkBurst == haveSignal)
@@ -640,7 +803,7 @@ PBoolean H323AudioCodec::DetectSilence()
     }
   }
 
-  if (silenceDetectMode == FixedSilenceDetection)
+  if (spectral || silenceDetectMode == FixedSilenceDetection)
     return !inTalkBurst;
 
   if (levelThreshold == 0) {
@@ -716,11 +879,50 @@ PBoolean H323AudioCodec::DetectSilence()
 }
 
 
+void H323AudioCodec::MeasureAudioLevel()
+{
+  unsigned average = lastSignalLevel != UINT_MAX ? lastSignalLevel : GetAverageSignalLevel();
+  if (average == UINT_MAX)
+    return;
+
+  // RFC 6464 levels are of the RMS, the mean magnitude of a sine is 0.9 of it
+  double rms = average*1.11;
+  unsigned level = rms < 1 ? 127 : (unsigned)(-20*log10(rms/32768) + 0.5);
+  if (level > 127)
+    level = 127;
+
+  if (level < audioLevel)
+    audioLevel = level;
+
+  if (silenceDetectMode == NoSilenceDetection ? level < 127 : inTalkBurst)
+    audioVoice = TRUE;
+}
+
+
+PBoolean H323AudioCodec::TakeAudioLevel(unsigned & level, PBoolean & voice)
+{
+  if (audioLevel > 127)
+    return FALSE;
+
+  level = audioLevel;
+  voice = audioVoice;
+  audioLevel = UINT_MAX;
+  audioVoice = FALSE;
+  return TRUE;
+}
+
+
 unsigned H323AudioCodec::GetAverageSignalLevel()
 {
   return UINT_MAX;
 }
 
+
+PBoolean H323AudioCodec::GetSignalBandEnergy(unsigned & /*lowBand*/, unsigned & /*highBand*/)
+{
+  return FALSE;
+}
+
 PBoolean H323AudioCodec::SetRawDataHeld(PBoolean hold) {
 
   PTimedMutex m;
@@ -737,6 +939,9 @@ H323FramedAudioCodec::H323FramedAudioCodec(const OpalMediaFormat & fmt, Directio
 #ifdef H323_AEC
     aec(NULL),
 #endif
+    concealer(NULL), speedUpPending(FALSE),
+    noiseEncoder(NULL), noiseGenerator(NULL), silenceDescriptorDue(FALSE),
+    framesPerCall(1), decodedNext(NULL), decodedLeft(0),
     sampleBuffer(samplesPerFrame), bytesPerFrame(mediaFormat.GetFrameSize()),
     readBytes(samplesPerFrame*2), writeBytes(samplesPerFrame*2), cntBytes(0)
 {
@@ -744,6 +949,127 @@ H323FramedAudioCodec::H323FramedAudioCodec(const OpalMediaFormat & fmt, Directio
 }
 
 
+H323FramedAudioCodec::~H323FramedAudioCodec()
+{
+  delete concealer;
+  delete noiseEncoder;
+  delete noiseGenerator;
+}
+
+
+PBoolean H323FramedAudioCodec::SetConcealment(PBoolean enable)
+{
+  PWaitAndSignal mutex(rawChannelMutex);
+
+  if (!enable) {
+    delete concealer;
+    concealer = NULL;
+    return TRUE;
+  }
+
+  if (direction != Decoder || HasDecoderConcealment())
+    return FALSE;
+
+  if (concealer == NULL) {
+    concealer = new H323AudioConcealer(mediaFormat.GetTimeUnits()*1000);
+    PTRACE(3, "Codec\tConcealing lost frames of " << mediaFormat);
+  }
+  return TRUE;
+}
+
+
+PBoolean H323FramedAudioCodec::RequestSpeedUp()
+{
+  PWaitAndSignal mutex(rawChannelMutex);
+
+  if (concealer == NULL)
+    return FALSE;
+
+  speedUpPending = TRUE;
+  return TRUE;
+}
+
+
+PBoolean H323FramedAudioCodec::SetFramesPerCall(unsigned frames)
+{
+  PWaitAndSignal mutex(rawChannelMutex);
+
+  if (frames < 2 || framesPerCall != 1 || !HasMultiFrameCoding())
+    return FALSE;
+
+  framesPerCall = frames;
+
+  if (direction == Encoder) {
+    // A read is then the whole packet, the deadbands counted in reads
+    samplesPerFrame *= frames;
+    readBytes = samplesPerFrame*2;
+    bytesPerFrame *= frames;
+    sampleBuffer.SetSize(samplesPerFrame);
+    signalDeadbandFrames = (signalDeadbandFrames+frames-1)/frames;
+    silenceDeadbandFrames = (silenceDeadbandFrames+frames-1)/frames;
+    adaptiveThresholdFrames = (adaptiveThresholdFrames+frames-1)/frames;
+  }
+  else
+    decodedFrames.SetSize(samplesPerFrame*frames);
+
+  PTRACE(3, "Codec\tCoding " << frames << " frames a call for " << mediaFormat);
+  return TRUE;
+}
+
+
+PBoolean H323FramedAudioCodec::SetComfortNoise(PBoolean enable)
+{
+  PWaitAndSignal mutex(rawChannelMutex);
+
+  if (!enable) {
+    delete noiseEncoder;
+    noiseEncoder = NULL;
+    delete noiseGenerator;
+    noiseGenerator = NULL;
+    silenceDescriptorDue = FALSE;
+    return TRUE;
+  }
+
+  // The static CN payload type has an 8kHz clock
+  if (mediaFormat.GetTimeUnits() != 8)
+    return FALSE;
+
+  if (direction == Encoder) {
+    if (noiseEncoder == NULL)
+      noiseEncoder = new H323ComfortNoiseEncoder(8000);
+  }
+  else {
+    if (noiseGenerator == NULL)
+      noiseGenerator = new H323ComfortNoiseGenerator;
+  }
+
+  PTRACE(3, "Codec\tComfort noise enabled for " << mediaFormat);
+  return TRUE;
+}
+
+
+PBoolean H323FramedAudioCodec::GetSilenceDescriptor(BYTE * buffer, PINDEX & length)
+{
+  PWaitAndSignal mutex(rawChannelMutex);
+
+  if (noiseEncoder == NULL || !silenceDescriptorDue)
+    return FALSE;
+
+  silenceDescriptorDue = FALSE;
+  length = noiseEncoder->GetDescriptor(buffer);
+  return TRUE;
+}
+
+
+void H323FramedAudioCodec::OnSilenceDescriptor(const BYTE * sid, PINDEX length)
+{
+  PWaitAndSignal mutex(rawChannelMutex);
+
+  if (noiseGenerator != NULL)
+    noiseGenerator->OnDescriptor(sid, length);
+}
+
+
 PBoolean H323FramedAudioCodec::Read(BYTE * buffer, unsigned & length, RTP_DataFrame &)
 {
   PWaitAndSignal mutex(rawChannelMutex);
@@ -786,14 +1112,30 @@ PBoolean H323FramedAudioCodec::Read(BYTE * buffer, unsigned & length, RTP_DataFr
   }
   cntBytes = 0;
 
-  if (DetectSilence()) {
+  PBoolean silent = DetectSilence();
+
+  if (audioLevelMeasure)
+    MeasureAudioLevel();
+
+  if (silent) {
+    if (noiseEncoder != NULL)
+      silenceDescriptorDue = noiseEncoder->OnSilence(sampleBuffer, samplesPerFrame);
     length = 0;
     return TRUE;
   }
 
+  if (noiseEncoder != NULL)
+    noiseEncoder->OnTalk();
+
   // Default length is the frame size
   length = bytesPerFrame;
-  return EncodeFrame(buffer, length);
+  if (processingHistogram == NULL)
+    return EncodeFrame(buffer, length);
+
+  PInt64 start = RTP_Histogram::GetMicroseconds();
+  PBoolean ok = EncodeFrame(buffer, length);
+  processingHistogram->Record((DWORD)RTP_Histogram::GetMicroseconds(start));
+  return ok;
 }
 
 WORD lastSequence=0;
@@ -816,7 +1158,7 @@ PBoolean H323FramedAudioCodec::Write(const BYTE * buffer,
   // Prepare AVSync Information
   rtpInformation.m_frameLost = (lastSequence > 0) ? rtpFrame.GetSequenceNumber() -lastSequence-1 : 0;
         lastSequence = rtpFrame.GetSequenceNumber();
-        rtpInformation.m_recvTime = PTimer::Tick().GetMilliSeconds();
+        rtpInformation.m_recvTime = H323MediaClock::GetMilliseconds();
         rtpInformation.m_timeStamp = rtpFrame.GetTimestamp();
         rtpInformation.m_clockRate = GetFrameRate();
         CalculateRTPSendTime(rtpInformation.m_timeStamp, rtpInformation.m_clockRate, rtpInformation.m_sendTime);
@@ -834,19 +1176,65 @@ PBoolean H323FramedAudioCodec::Write(const BYTE * buffer,
 #endif
 
   if (length != 0) {
+    unsigned frames = length/bytesPerFrame;
+    if (frames > framesPerCall)
+      frames = framesPerCall;
     if (length > bytesPerFrame)
       length = bytesPerFrame;
     written = bytesPerFrame;
 
-    // Decode the data
-    if (!DecodeFrame(buffer, length, written, writeBytes)) {
-      written = length;
-      length = 0;
+    // The rest of a packet decoded together comes a frame at a time
+    if (decodedLeft > 0 && buffer == decodedNext) {
+      memcpy(sampleBuffer.GetPointer(), decodedFrames.GetPointer() + (framesPerCall-decodedLeft)*samplesPerFrame, writeBytes);
+      decodedNext += bytesPerFrame;
+      decodedLeft--;
+    }
+    else {
+      decodedLeft = 0;
+
+      // Decode the data
+      PInt64 start = processingHistogram != NULL ? RTP_Histogram::GetMicroseconds() : 0;
+      if (frames > 1 && writeBytes == samplesPerFrame*2 && DecodeFrames(buffer, frames, decodedFrames.GetPointer())) {
+        memcpy(sampleBuffer.GetPointer(), decodedFrames.GetPointer(), writeBytes);
+        // Frames are taken from the end of the batch so a short one lines up
+        decodedLeft = frames-1;
+        if (frames < framesPerCall)
+          memmove(decodedFrames.GetPointer() + (framesPerCall-frames+1)*samplesPerFrame,
+                  decodedFrames.GetPointer() + samplesPerFrame, decodedLeft*writeBytes);
+        decodedNext = buffer + bytesPerFrame;
+      }
+      else if (!DecodeFrame(buffer, length, written, writeBytes)) {
+        written = length;
+        length = 0;
+      }
+      if (processingHistogram != NULL)
+        processingHistogram->Record((DWORD)RTP_Histogram::GetMicroseconds(start));
+    }
+  }
+  else
+    decodedLeft = 0;
+
+  unsigned outputBytes = writeBytes;
+  if (length == 0) {
+    // A silence descriptor since the last talk means the silence is meant
+    if (noiseGenerator != NULL && noiseGenerator->IsActive())
+      noiseGenerator->Generate(sampleBuffer.GetPointer(), writeBytes/2);
+    else if (concealer != NULL)
+      concealer->Conceal(sampleBuffer.GetPointer(), writeBytes/2);
+    else
+      DecodeSilenceFrame(sampleBuffer.GetPointer(), writeBytes);
+  }
+  else {
+    if (noiseGenerator != NULL)
+      noiseGenerator->Stop();
+    if (concealer != NULL) {
+      concealer->OnDecoded(sampleBuffer.GetPointer(), writeBytes/2);
+      if (speedUpPending) {
+        speedUpPending = FALSE;
+        outputBytes = concealer->Shorten(sampleBuffer.GetPointer(), writeBytes/2)*2;
+      }
     }
   }
-
-  if (length == 0)
-    DecodeSilenceFrame(sampleBuffer.GetPointer(), writeBytes);
 
   // Write as 16bit PCM to sound channel
   if (IsRawDataHeld) {		// If Connection om Hold
@@ -856,10 +1244,10 @@ PBoolean H323FramedAudioCodec::Write(const BYTE * buffer,
 #ifdef H323_AEC
       if (aec != NULL) {
          PTRACE(6,"AEC\tReceive " << writeBytes);
-         aec->Receive((BYTE *)sampleBuffer.GetPointer(), writeBytes);
+         aec->Receive((BYTE *)sampleBuffer.GetPointer(), outputBytes);
       }
 #endif
-      if (!WriteRaw(sampleBuffer.GetPointer(), writeBytes, &rtpInformation))
+      if (!WriteRaw(sampleBuffer.GetPointer(), outputBytes, &rtpInformation))
           return FALSE;
   }
       return TRUE;
@@ -874,21 +1262,78 @@ unsigned H323FramedAudioCodec::GetAverageSignalLevel()
       return 0;
 
   // Calculate the average signal level of this frame
+  const short * pcm = sampleBuffer;
+  unsigned i = 0;
   int sum = 0;
 
-  const short * pcm = sampleBuffer;
-  const short * end = pcm + samplesPerFrame;
-  while (pcm != end) {
-    if (*pcm < 0)
-      sum -= *pcm++;
-    else
-      sum += *pcm++;
+#ifdef H323_CODECS_SSE2
+  __m128i total = _mm_setzero_si128();
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i ones = _mm_set1_epi16(1);
+  for (; i+8 <= samplesPerFrame; i += 8) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(pcm+i));
+    // -32768 saturates to 32767, one off the scalar sum
+    __m128i magnitude = _mm_max_epi16(v, _mm_subs_epi16(zero, v));
+    total = _mm_add_epi32(total, _mm_madd_epi16(magnitude, ones));
   }
+  total = _mm_add_epi32(total, _mm_shuffle_epi32(total, _MM_SHUFFLE(1,0,3,2)));
+  total = _mm_add_epi32(total, _mm_shuffle_epi32(total, _MM_SHUFFLE(2,3,0,1)));
+  sum = _mm_cvtsi128_si32(total);
+#endif
+
+  for (; i < samplesPerFrame; i++)
+    sum += pcm[i] < 0 ? -pcm[i] : pcm[i];
 
   return sum/samplesPerFrame;
 }
 
 
+PBoolean H323FramedAudioCodec::GetSignalBandEnergy(unsigned & lowBand, unsigned & highBand)
+{
+  if (samplesPerFrame < 2)
+    return FALSE;
+
+  // Sum and difference of each pair of adjacent samples in the frame
+  const short * pcm = sampleBuffer;
+  unsigned i = 1;
+  PUInt64 low = 0;
+  PUInt64 high = 0;
+
+#ifdef H323_CODECS_SSE2
+  __m128i lowTotal = _mm_setzero_si128();
+  __m128i highTotal = _mm_setzero_si128();
+  const __m128i zero = _mm_setzero_si128();
+  for (; i+8 <= samplesPerFrame; i += 8) {
+    __m128i a = _mm_srai_epi16(_mm_loadu_si128((const __m128i *)(pcm+i)), 2);
+    __m128i b = _mm_srai_epi16(_mm_loadu_si128((const __m128i *)(pcm+i-1)), 2);
+    __m128i s = _mm_add_epi16(a, b);
+    __m128i d = _mm_sub_epi16(a, b);
+    // Pairs of squares are under 2^30, widened to 64 bits to sum a frame
+    __m128i ss = _mm_madd_epi16(s, s);
+    __m128i dd = _mm_madd_epi16(d, d);
+    lowTotal  = _mm_add_epi64(lowTotal,  _mm_add_epi64(_mm_unpacklo_epi32(ss, zero), _mm_unpackhi_epi32(ss, zero)));
+    highTotal = _mm_add_epi64(highTotal, _mm_add_epi64(_mm_unpacklo_epi32(dd, zero), _mm_unpackhi_epi32(dd, zero)));
+  }
+  PUInt64 lanes[2];
+  _mm_storeu_si128((__m128i *)lanes, lowTotal);
+  low = lanes[0] + lanes[1];
+  _mm_storeu_si128((__m128i *)lanes, highTotal);
+  high = lanes[0] + lanes[1];
+#endif
+
+  for (; i < samplesPerFrame; i++) {
+    int a = pcm[i] >> 2;
+    int b = pcm[i-1] >> 2;
+    low  += (a + b)*(a + b);
+    high += (a - b)*(a - b);
+  }
+
+  lowBand  = (unsigned)(low/(samplesPerFrame-1));
+  highBand = (unsigned)(high/(samplesPerFrame-1));
+  return TRUE;
+}
+
+
 PBoolean H323FramedAudioCodec::DecodeFrame(const BYTE * buffer,
                                        unsigned length,
                                        unsigned & written,
@@ -1229,6 +1674,25 @@ short H323_ALawCodec::DecodeSample(int sample)
 }
 
 
+PBoolean H323_ALawCodec::EncodeFrame(BYTE * buffer, unsigned &)
+{
+  H323_G711Block::EncodeALaw(sampleBuffer, buffer, samplesPerFrame);
+  return TRUE;
+}
+
+
+PBoolean H323_ALawCodec::DecodeFrame(const BYTE * buffer,
+                                  unsigned length,
+                                  unsigned & written,
+                                  unsigned & decodedBytes)
+{
+  H323_G711Block::DecodeALaw(buffer, sampleBuffer.GetPointer(samplesPerFrame), length);
+  written = length;
+  decodedBytes = length*2;
+  return TRUE;
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
 
 H323_muLawCodec::H323_muLawCodec(Direction dir,
@@ -1256,6 +1720,25 @@ short H323_muLawCodec::DecodeSample(int sample)
 }
 
 
+PBoolean H323_muLawCodec::EncodeFrame(BYTE * buffer, unsigned &)
+{
+  H323_G711Block::EncodeuLaw(sampleBuffer, buffer, samplesPerFrame);
+  return TRUE;
+}
+
+
+PBoolean H323_muLawCodec::DecodeFrame(const BYTE * buffer,
+                                  unsigned length,
+                                  unsigned & written,
+                                  unsigned & decodedBytes)
+{
+  H323_G711Block::DecodeuLaw(buffer, sampleBuffer.GetPointer(samplesPerFrame), length);
+  written = length;
+  decodedBytes = length*2;
+  return TRUE;
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
 
 #endif // NO_H323_AUDIO_CODECS
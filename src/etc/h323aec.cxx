@@ -43,6 +43,8 @@
 
 #ifdef H323_AEC
 #include "etc/h323aec.h"
+#include "rtphist.h"
+#include "ptlib_extras.h"
 
 #if _WIN32
 #pragma comment(lib, H323_AEC_LIB)
@@ -67,7 +69,7 @@ H323AEC::BufferFrame::~BufferFrame()
 }
 
 H323_AECBuffer::H323_AECBuffer()
-: m_bufferTime(0), m_curPos(0)
+: m_bufferTime(0), m_frameBytes(0), m_slotMask(0), m_delay(0), m_in(0)
 {
 
 }
@@ -79,75 +81,78 @@ H323_AECBuffer::~H323_AECBuffer()
 
 void H323_AECBuffer::Initialise(PINDEX size, PINDEX byteSize, PINDEX clockRate)
 {
-    PWaitAndSignal m(m_bufferMutex);
-
     m_bufferTime = size * (byteSize/(clockRate/1000)/2);
 
-    for (PINDEX i=0; i < size; ++i)
-        (*this)[i] = *new H323AEC::BufferFrame(byteSize);
+    // Twice the delay, so the writer is a whole delay ahead of the slot
+    // being read before it could overwrite it
+    unsigned slots = 1;
+    while (slots < 2*(unsigned)size)
+        slots <<= 1;
+
+    m_frameBytes = byteSize;
+    m_slotMask = slots-1;
+    m_delay = size;
+    m_in = 0;
+    m_frames.SetSize(slots*byteSize);
+    memset(m_frames.GetPointer(), 0, m_frames.GetSize());
 }
 
 void H323_AECBuffer::ShutDown()
 {
-    PWaitAndSignal m(m_bufferMutex);
-
-    if (this->empty()) 
-        return;
-
-    std::map<unsigned, H323AEC::BufferFrame>::iterator it;
-    for (it= this->begin(); it!= this->end(); ++it)
-        this->erase(it++);
+    m_delay = 0;
+    m_frames.SetSize(0);
 }
 
 PBoolean H323_AECBuffer::Send(BYTE * buffer, unsigned & length)
 {
-    PWaitAndSignal m(m_bufferMutex);
-
-    if (this->empty()) {
+    if (m_delay == 0) {
         PTRACE(6,"AEC\tEmpty!");
         return false;
     }
 
-    const H323AEC::BufferFrame & entry = (*this)[m_curPos];
+    unsigned in = m_in;
+    H323_MEMORY_BARRIER();
 
-    if (entry.receiveTime == 0) {
+    if (in < m_delay) {
         PTRACE(6,"AEC\tFilling AEC Buffer");
         return false;
     }
 
-    if (length != (unsigned)entry.frame.GetSize()) {
-        PTRACE(3,"AEC\tSend buffer size " << length << " does not match receive " << entry.frame.GetSize());
+    if (length != m_frameBytes) {
+        PTRACE(3,"AEC\tSend buffer size " << length << " does not match receive " << m_frameBytes);
         return false;
     }
 
-    memcpy(buffer, (const void *)entry.frame, length);
-    PTRACE(6,"AEC\tPlay Pos " << m_curPos << " " << entry.receiveTime << " " << PTimer::Tick().GetMilliSeconds() - entry.echoTime);
+    unsigned pos = (in - m_delay) & m_slotMask;
+    memcpy(buffer, m_frames.GetPointer() + pos*m_frameBytes, length);
+
+    // The writer may have lapped the slot while it was copied
+    H323_MEMORY_BARRIER();
+    if (m_in - in > m_slotMask - m_delay) {
+        PTRACE(6,"AEC\tReference overwritten at " << pos);
+        return false;
+    }
+
+    PTRACE(6,"AEC\tPlay Pos " << pos << " of " << in);
     return true;
 }
 
 void H323_AECBuffer::Receive(BYTE * buffer, unsigned & length)
 {
-    PWaitAndSignal m(m_bufferMutex);
-
-    if (this->empty()) 
+    if (m_delay == 0) 
         return;
 
-    H323AEC::BufferFrame & entry = (*this)[m_curPos];
-    entry.receiveTime = PTimer::Tick().GetMilliSeconds();
-    entry.echoTime = entry.receiveTime + m_bufferTime;
-    memcpy(entry.frame.GetPointer(), buffer, length);
+    if (length != m_frameBytes) {
+        PTRACE(6,"AEC\tReceive size " << length << " does not match " << m_frameBytes);
+        return;
+    }
 
-    m_curPos++;
-    if (m_curPos >= this->size())
-        m_curPos = 0;
-
-#if 0  // debugging
-    PTRACE(6,"AEC\tPosition " << m_curPos);
-    std::map<unsigned, H323AEC::BufferFrame>::const_iterator r = this->begin();
-    for (r = this->begin(); r != this->end(); ++r)
-        PTRACE(6,"AEC\t" << r->first << " " << r->second.receiveTime);
-#endif
+    unsigned in = m_in;
+    memcpy(m_frames.GetPointer() + (in & m_slotMask)*m_frameBytes, buffer, length);
 
+    // Publish the frame only once it is all written
+    H323_MEMORY_BARRIER();
+    m_in = in+1;
 }
 
 
@@ -157,7 +162,7 @@ void H323_AECBuffer::Receive(BYTE * buffer, unsigned & length)
 H323Aec::H323Aec(int _clock, int _sampletime, int _buffers)
   :  m_echoState(NULL), m_preprocessState(NULL), m_clockrate(_clock), m_samplesFrame(_sampletime*(m_clockrate/1000)), m_BufferBytes(2*m_samplesFrame),
      m_echo_buf((spx_int16_t *)malloc(m_BufferBytes)), m_ref_buf((spx_int16_t *)malloc(m_BufferBytes)), m_temp_buf((spx_int16_t *)malloc(m_BufferBytes)),
-     m_tail(TAIL * m_samplesFrame)
+     m_tail(TAIL * m_samplesFrame), m_processingTime(0), m_frameCount(0)
 {
 
     m_buffer.Initialise( _buffers, m_BufferBytes, _clock);
@@ -186,6 +191,8 @@ H323Aec::H323Aec(int _clock, int _sampletime, int _buffers)
 
 H323Aec::~H323Aec()
 {
+    PTRACE(3, "AEC\tDeleted AEC after " << m_frameCount << " frames, load " << GetLoad()/10 << '.' << GetLoad()%10 << '%');
+
     m_buffer.ShutDown();
 
     free(m_echo_buf);
@@ -220,15 +227,28 @@ void H323Aec::Send(BYTE * buffer, unsigned & length)
 
   memcpy(m_ref_buf,buffer,length);
 
+  PInt64 start = RTP_Histogram::GetMicroseconds();
+
   speex_echo_cancellation(m_echoState, m_ref_buf,
                           m_echo_buf, m_temp_buf);
 
   speex_preprocess_run(m_preprocessState, m_temp_buf);
 
+  m_processingTime += RTP_Histogram::GetMicroseconds(start);
+  m_frameCount++;
+
   memcpy(buffer,m_temp_buf,length);
 
 }
 
+unsigned H323Aec::GetLoad() const
+{
+  PInt64 realTime = (PInt64)m_frameCount * m_samplesFrame * 1000000 / m_clockrate;
+  if (realTime == 0)
+      return 0;
+  return (unsigned)(m_processingTime * 1000 / realTime);
+}
+
 #endif // H323_AEC
 
 
@@ -0,0 +1,435 @@
+/*
+ * g711block.cxx
+ *
+ * Block G.711 A-law/u-law transcoding
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "g711block.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#include "g711block.h"
+
+#ifndef H323_G711_NO_SIMD
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define H323_G711_SSE2 1
+#include <emmintrin.h>
+#if (defined(__GNUC__) && __GNUC__ >= 5) || defined(__clang__)
+#define H323_G711_AVX2 1
+#include <immintrin.h>
+#endif
+#endif
+#endif // H323_G711_NO_SIMD
+
+extern "C" {
+  unsigned char linear2ulaw(int pcm_val);
+  int ulaw2linear(unsigned char u_val);
+  unsigned char linear2alaw(int pcm_val);
+  int alaw2linear(unsigned char u_val);
+};
+
+#define new PNEW
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+// A-law only uses the top 13 bits of a sample and u-law the top 14 bits,
+// so the encode tables are indexed by the sample shifted down by 3 and 2.
+static BYTE  ALawEncodeTable[0x2000];
+static BYTE  uLawEncodeTable[0x4000];
+static short ALawDecodeTable[256];
+static short uLawDecodeTable[256];
+
+// Starts on the reference functions so anything transcoded before the
+// tables are built is still correct.
+static volatile int g711Kernel = H323_G711Block::ScalarKernel;
+
+#define ALAW_INDEX(s) (((unsigned short)(s)) >> 3)
+#define ULAW_INDEX(s) (((unsigned short)(s)) >> 2)
+
+
+static void ALawEncodeTable_(const short * from, BYTE * to, unsigned count)
+{
+  while (count >= 4) {
+    to[0] = ALawEncodeTable[ALAW_INDEX(from[0])];
+    to[1] = ALawEncodeTable[ALAW_INDEX(from[1])];
+    to[2] = ALawEncodeTable[ALAW_INDEX(from[2])];
+    to[3] = ALawEncodeTable[ALAW_INDEX(from[3])];
+    from += 4;
+    to += 4;
+    count -= 4;
+  }
+  while (count-- > 0)
+    *to++ = ALawEncodeTable[ALAW_INDEX(*from++)];
+}
+
+
+static void uLawEncodeTable_(const short * from, BYTE * to, unsigned count)
+{
+  while (count >= 4) {
+    to[0] = uLawEncodeTable[ULAW_INDEX(from[0])];
+    to[1] = uLawEncodeTable[ULAW_INDEX(from[1])];
+    to[2] = uLawEncodeTable[ULAW_INDEX(from[2])];
+    to[3] = uLawEncodeTable[ULAW_INDEX(from[3])];
+    from += 4;
+    to += 4;
+    count -= 4;
+  }
+  while (count-- > 0)
+    *to++ = uLawEncodeTable[ULAW_INDEX(*from++)];
+}
+
+
+static void DecodeTable_(const short * table, const BYTE * from, short * to, unsigned count)
+{
+  while (count >= 4) {
+    to[0] = table[from[0]];
+    to[1] = table[from[1]];
+    to[2] = table[from[2]];
+    to[3] = table[from[3]];
+    from += 4;
+    to += 4;
+    count -= 4;
+  }
+  while (count-- > 0)
+    *to++ = table[*from++];
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+// The vector encoders follow the reference functions lane by lane. The
+// segment and quantisation bits are the exponent and top four mantissa
+// bits of the magnitude converted to single precision float, so after
+// removing the exponent bias they can be taken straight from the float.
+
+#ifdef H323_G711_SSE2
+
+static inline __m128i Log2Code8_SSE2(__m128i magnitude, short bias)
+{
+  __m128i low  = _mm_unpacklo_epi16(magnitude, _mm_setzero_si128());
+  __m128i high = _mm_unpackhi_epi16(magnitude, _mm_setzero_si128());
+  low  = _mm_srli_epi32(_mm_castps_si128(_mm_cvtepi32_ps(low)), 19);
+  high = _mm_srli_epi32(_mm_castps_si128(_mm_cvtepi32_ps(high)), 19);
+  return _mm_sub_epi16(_mm_packs_epi32(low, high), _mm_set1_epi16(bias));
+}
+
+
+static inline __m128i ALawEncode8_SSE2(__m128i sample)
+{
+  __m128i pcm = _mm_srai_epi16(sample, 3);
+  __m128i negative = _mm_cmplt_epi16(pcm, _mm_setzero_si128());
+  __m128i magnitude = _mm_xor_si128(pcm, negative);   // -pcm-1 when negative
+
+  // Segment 0 is linear, the rest are segment 1 at an exponent of 5
+  __m128i logarithmic = _mm_cmpgt_epi16(magnitude, _mm_set1_epi16(0x1F));
+  __m128i aval = _mm_or_si128(_mm_and_si128(logarithmic, Log2Code8_SSE2(magnitude, (127+4) << 4)),
+                              _mm_andnot_si128(logarithmic, _mm_srli_epi16(magnitude, 1)));
+  __m128i mask = _mm_xor_si128(_mm_set1_epi16(0xD5), _mm_and_si128(negative, _mm_set1_epi16(0x80)));
+  return _mm_xor_si128(aval, mask);
+}
+
+
+static inline __m128i uLawEncode8_SSE2(__m128i sample)
+{
+  __m128i pcm = _mm_srai_epi16(sample, 2);
+  __m128i negative = _mm_cmplt_epi16(pcm, _mm_setzero_si128());
+  __m128i magnitude = _mm_sub_epi16(_mm_xor_si128(pcm, negative), negative);
+  magnitude = _mm_min_epi16(magnitude, _mm_set1_epi16(8159));
+  magnitude = _mm_add_epi16(magnitude, _mm_set1_epi16(0x84 >> 2));
+
+  // The biased magnitude is segment 0 at an exponent of 5, segment 8 is
+  // out of range and clamps to the largest code
+  __m128i uval = _mm_min_epi16(Log2Code8_SSE2(magnitude, (127+5) << 4), _mm_set1_epi16(0x7F));
+  __m128i mask = _mm_xor_si128(_mm_set1_epi16(0xFF), _mm_and_si128(negative, _mm_set1_epi16(0x80)));
+  return _mm_xor_si128(uval, mask);
+}
+
+
+static void ALawEncodeSSE2(const short * from, BYTE * to, unsigned count)
+{
+  while (count >= 16) {
+    __m128i low  = ALawEncode8_SSE2(_mm_loadu_si128((const __m128i *)from));
+    __m128i high = ALawEncode8_SSE2(_mm_loadu_si128((const __m128i *)(from+8)));
+    _mm_storeu_si128((__m128i *)to, _mm_packus_epi16(low, high));
+    from += 16;
+    to += 16;
+    count -= 16;
+  }
+  ALawEncodeTable_(from, to, count);
+}
+
+
+static void uLawEncodeSSE2(const short * from, BYTE * to, unsigned count)
+{
+  while (count >= 16) {
+    __m128i low  = uLawEncode8_SSE2(_mm_loadu_si128((const __m128i *)from));
+    __m128i high = uLawEncode8_SSE2(_mm_loadu_si128((const __m128i *)(from+8)));
+    _mm_storeu_si128((__m128i *)to, _mm_packus_epi16(low, high));
+    from += 16;
+    to += 16;
+    count -= 16;
+  }
+  uLawEncodeTable_(from, to, count);
+}
+
+#endif // H323_G711_SSE2
+
+
+#ifdef H323_G711_AVX2
+
+#define H323_G711_AVX2_TARGET __attribute__((target("avx2")))
+
+H323_G711_AVX2_TARGET
+static inline __m256i Log2Code16_AVX2(__m256i magnitude, short bias)
+{
+  // Unpack and pack both work within each 128 bit lane so the order holds
+  __m256i low  = _mm256_unpacklo_epi16(magnitude, _mm256_setzero_si256());
+  __m256i high = _mm256_unpackhi_epi16(magnitude, _mm256_setzero_si256());
+  low  = _mm256_srli_epi32(_mm256_castps_si256(_mm256_cvtepi32_ps(low)), 19);
+  high = _mm256_srli_epi32(_mm256_castps_si256(_mm256_cvtepi32_ps(high)), 19);
+  return _mm256_sub_epi16(_mm256_packs_epi32(low, high), _mm256_set1_epi16(bias));
+}
+
+
+H323_G711_AVX2_TARGET
+static inline __m256i ALawEncode16_AVX2(__m256i sample)
+{
+  __m256i pcm = _mm256_srai_epi16(sample, 3);
+  __m256i negative = _mm256_cmpgt_epi16(_mm256_setzero_si256(), pcm);
+  __m256i magnitude = _mm256_xor_si256(pcm, negative);
+
+  __m256i logarithmic = _mm256_cmpgt_epi16(magnitude, _mm256_set1_epi16(0x1F));
+  __m256i aval = _mm256_or_si256(_mm256_and_si256(logarithmic, Log2Code16_AVX2(magnitude, (127+4) << 4)),
+                                 _mm256_andnot_si256(logarithmic, _mm256_srli_epi16(magnitude, 1)));
+  __m256i mask = _mm256_xor_si256(_mm256_set1_epi16(0xD5), _mm256_and_si256(negative, _mm256_set1_epi16(0x80)));
+  return _mm256_xor_si256(aval, mask);
+}
+
+
+H323_G711_AVX2_TARGET
+static inline __m256i uLawEncode16_AVX2(__m256i sample)
+{
+  __m256i pcm = _mm256_srai_epi16(sample, 2);
+  __m256i negative = _mm256_cmpgt_epi16(_mm256_setzero_si256(), pcm);
+  __m256i magnitude = _mm256_sub_epi16(_mm256_xor_si256(pcm, negative), negative);
+  magnitude = _mm256_min_epi16(magnitude, _mm256_set1_epi16(8159));
+  magnitude = _mm256_add_epi16(magnitude, _mm256_set1_epi16(0x84 >> 2));
+
+  __m256i uval = _mm256_min_epi16(Log2Code16_AVX2(magnitude, (127+5) << 4), _mm256_set1_epi16(0x7F));
+  __m256i mask = _mm256_xor_si256(_mm256_set1_epi16(0xFF), _mm256_and_si256(negative, _mm256_set1_epi16(0x80)));
+  return _mm256_xor_si256(uval, mask);
+}
+
+
+// The pack works within each 128 bit lane, so the middle quarters swap back
+#define G711_PACK_AVX2(low, high) \
+  _mm256_permute4x64_epi64(_mm256_packus_epi16(low, high), 0xD8)
+
+H323_G711_AVX2_TARGET
+static void ALawEncodeAVX2(const short * from, BYTE * to, unsigned count)
+{
+  while (count >= 32) {
+    __m256i low  = ALawEncode16_AVX2(_mm256_loadu_si256((const __m256i *)from));
+    __m256i high = ALawEncode16_AVX2(_mm256_loadu_si256((const __m256i *)(from+16)));
+    _mm256_storeu_si256((__m256i *)to, G711_PACK_AVX2(low, high));
+    from += 32;
+    to += 32;
+    count -= 32;
+  }
+  ALawEncodeSSE2(from, to, count);
+}
+
+
+H323_G711_AVX2_TARGET
+static void uLawEncodeAVX2(const short * from, BYTE * to, unsigned count)
+{
+  while (count >= 32) {
+    __m256i low  = uLawEncode16_AVX2(_mm256_loadu_si256((const __m256i *)from));
+    __m256i high = uLawEncode16_AVX2(_mm256_loadu_si256((const __m256i *)(from+16)));
+    _mm256_storeu_si256((__m256i *)to, G711_PACK_AVX2(low, high));
+    from += 32;
+    to += 32;
+    count -= 32;
+  }
+  uLawEncodeSSE2(from, to, count);
+}
+
+
+static bool HasAVX2()
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") != 0;
+}
+
+#endif // H323_G711_AVX2
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+static struct G711BlockInitialiser
+{
+  G711BlockInitialiser()
+  {
+    unsigned i;
+    for (i = 0; i < sizeof(ALawEncodeTable); i++)
+      ALawEncodeTable[i] = linear2alaw((short)(i << 3));
+    for (i = 0; i < sizeof(uLawEncodeTable); i++)
+      uLawEncodeTable[i] = linear2ulaw((short)(i << 2));
+    for (i = 0; i < 256; i++) {
+      ALawDecodeTable[i] = (short)alaw2linear((unsigned char)i);
+      uLawDecodeTable[i] = (short)ulaw2linear((unsigned char)i);
+    }
+
+    g711Kernel = H323_G711Block::TableKernel;
+    for (int k = H323_G711Block::NumKernels-1; k > H323_G711Block::TableKernel; k--) {
+      if (H323_G711Block::IsKernelAvailable((H323_G711Block::Kernels)k)) {
+        g711Kernel = k;
+        break;
+      }
+    }
+  }
+} g711BlockInitialiser;
+
+
+void H323_G711Block::EncodeALaw(const short * from, BYTE * to, unsigned count)
+{
+  switch (g711Kernel) {
+    case ScalarKernel :
+      while (count-- > 0)
+        *to++ = linear2alaw(*from++);
+      break;
+#ifdef H323_G711_SSE2
+    case SSE2Kernel :
+      ALawEncodeSSE2(from, to, count);
+      break;
+#endif
+#ifdef H323_G711_AVX2
+    case AVX2Kernel :
+      ALawEncodeAVX2(from, to, count);
+      break;
+#endif
+    default :
+      ALawEncodeTable_(from, to, count);
+  }
+}
+
+
+void H323_G711Block::DecodeALaw(const BYTE * from, short * to, unsigned count)
+{
+  if (g711Kernel == ScalarKernel) {
+    while (count-- > 0)
+      *to++ = (short)alaw2linear(*from++);
+  }
+  else
+    DecodeTable_(ALawDecodeTable, from, to, count);
+}
+
+
+void H323_G711Block::EncodeuLaw(const short * from, BYTE * to, unsigned count)
+{
+  switch (g711Kernel) {
+    case ScalarKernel :
+      while (count-- > 0)
+        *to++ = linear2ulaw(*from++);
+      break;
+#ifdef H323_G711_SSE2
+    case SSE2Kernel :
+      uLawEncodeSSE2(from, to, count);
+      break;
+#endif
+#ifdef H323_G711_AVX2
+    case AVX2Kernel :
+      uLawEncodeAVX2(from, to, count);
+      break;
+#endif
+    default :
+      uLawEncodeTable_(from, to, count);
+  }
+}
+
+
+void H323_G711Block::DecodeuLaw(const BYTE * from, short * to, unsigned count)
+{
+  if (g711Kernel == ScalarKernel) {
+    while (count-- > 0)
+      *to++ = (short)ulaw2linear(*from++);
+  }
+  else
+    DecodeTable_(uLawDecodeTable, from, to, count);
+}
+
+
+H323_G711Block::Kernels H323_G711Block::GetKernel()
+{
+  return (Kernels)g711Kernel;
+}
+
+
+PBoolean H323_G711Block::SetKernel(Kernels kernel)
+{
+  if (!IsKernelAvailable(kernel))
+    return FALSE;
+
+  g711Kernel = kernel;
+  PTRACE(3, "G711\tUsing " << GetKernelName(kernel) << " kernel");
+  return TRUE;
+}
+
+
+PBoolean H323_G711Block::IsKernelAvailable(Kernels kernel)
+{
+  switch (kernel) {
+    case ScalarKernel :
+    case TableKernel :
+      return TRUE;
+#ifdef H323_G711_SSE2
+    case SSE2Kernel :
+      return TRUE;
+#endif
+#ifdef H323_G711_AVX2
+    case AVX2Kernel :
+      return HasAVX2();
+#endif
+    default :
+      return FALSE;
+  }
+}
+
+
+const char * H323_G711Block::GetKernelName(Kernels kernel)
+{
+  static const char * const names[NumKernels] = { "scalar", "table", "SSE2", "AVX2" };
+  return kernel < NumKernels ? names[kernel] : "unknown";
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -54,8 +54,18 @@
 #include "h460/h460_std17.h"
 #endif
 
+#ifdef H323_H4609
+#include "h460/h460_std9.h"
+#endif
+
 #define new PNEW
 
+/* Most calls reported in one IRR, to keep message size reasonable */
+#define IRR_MAX_CALLS 100
+
+/* Time IRRs for single calls are held to be sent together */
+#define IRR_COALESCE_TIME 200
+
 
 static PTimeInterval AdjustTimeout(unsigned seconds)
 {
@@ -91,10 +101,18 @@ H323Gatekeeper::H323Gatekeeper(H323EndPoint & ep, H323Transport * trans)
 
   timeToLive.SetNotifier(PCREATE_NOTIFIER(TickleMonitor));
   infoRequestRate.SetNotifier(PCREATE_NOTIFIER(TickleMonitor));
+  infoRequestBatchTimer.SetNotifier(PCREATE_NOTIFIER(TickleMonitor));
 
   willRespondToIRR = FALSE;
+  infoRequestBatchSize = 0;
   monitorStop = FALSE;
 
+  probeMissLimit = 3;
+  probeSocket = NULL;
+  probeThread = NULL;
+  probeStop = FALSE;
+  probeSequenceNumber = 0;
+
   monitor = PThread::Create(PCREATE_NOTIFIER(MonitorMain), 0,
                             PThread::NoAutoDeleteThread,
                             PThread::NormalPriority,
@@ -110,6 +128,8 @@ H323Gatekeeper::H323Gatekeeper(H323EndPoint & ep, H323Transport * trans)
 
 H323Gatekeeper::~H323Gatekeeper()
 {
+  StopProbing();
+
   if (monitor != NULL) {
     monitorStop = TRUE;
     monitorTickle.Signal();
@@ -438,6 +458,8 @@ PBoolean H323Gatekeeper::RegistrationRequest(PBoolean autoReg)
     rrq.IncludeOptionalField(H225_RegistrationRequest::e_keepAlive);
     rrq.m_keepAlive = TRUE;
   }
+  else
+    ClearAdmissionCache();
 
   // After doing full register, do lightweight reregisters from now on
   discoveryComplete = FALSE;
@@ -818,23 +840,9 @@ PBoolean H323Gatekeeper::OnReceiveUnregistrationReject(const H225_Unregistration
 }
 
 
-PBoolean H323Gatekeeper::LocationRequest(const PString & alias,
-                                     H323TransportAddress & address)
-{
-  PStringList aliases;
-  aliases.AppendString(alias);
-  return LocationRequest(aliases, address);
-}
-
-
-PBoolean H323Gatekeeper::LocationRequest(const PStringList & aliases,
-                                     H323TransportAddress & address)
+void H323Gatekeeper::BuildLocationRequest(H323RasPDU & pdu, unsigned seqNum, const PStringList & aliases)
 {
-  if (PAssertNULL(transport) == NULL)
-    return FALSE;
-
-  H323RasPDU pdu;
-  H225_LocationRequest & lrq = pdu.BuildLocationRequest(GetNextSequenceNumber());
+  H225_LocationRequest & lrq = pdu.BuildLocationRequest(seqNum);
 
   H323SetAliasAddresses(aliases, lrq.m_destinationInfo);
 
@@ -852,8 +860,45 @@ PBoolean H323Gatekeeper::LocationRequest(const PStringList & aliases,
     lrq.IncludeOptionalField(H225_LocationRequest::e_gatekeeperIdentifier);
     lrq.m_gatekeeperIdentifier = gatekeeperIdentifier;
   }
+}
+
+
+PBoolean H323Gatekeeper::LocationRequest(const PString & alias,
+                                     H323TransportAddress & address)
+{
+  PStringList aliases;
+  aliases.AppendString(alias);
+  return LocationRequest(aliases, address);
+}
+
+
+PBoolean H323Gatekeeper::LocationRequest(const PStringList & aliases,
+                                     H323TransportAddress & address)
+{
+  if (PAssertNULL(transport) == NULL)
+    return FALSE;
+
+  PString cacheKey;
+  if (admissionCacheTime > 0) {
+    PStringStream strm;
+    strm << setfill('\n') << aliases;
+    cacheKey = strm;
+    PWaitAndSignal m(admissionCacheMutex);
+    LocationCache::iterator it = locationCache.find(cacheKey);
+    if (it != locationCache.end()) {
+      if (it->second.expiry > PTimer::Tick().GetMilliSeconds()) {
+        address = it->second.address;
+        PTRACE(4, "RAS\tUsing remembered LCF for " << setfill(',') << aliases << setfill(' '));
+        return TRUE;
+      }
+      locationCache.erase(it);
+    }
+  }
 
-  Request request(lrq.m_requestSeqNum, pdu);
+  H323RasPDU pdu;
+  BuildLocationRequest(pdu, GetNextSequenceNumber(), aliases);
+
+  Request request(pdu.GetSequenceNumber(), pdu);
   request.responseInfo = &address;
   if (!MakeRequest(request))
     return FALSE;
@@ -861,7 +906,17 @@ PBoolean H323Gatekeeper::LocationRequest(const PStringList & aliases,
   // sanity check the address - some Gks return address 0.0.0.0 and port 0
   PIPSocket::Address ipAddr;
   WORD port = 0;
-  return address.GetIpAndPort(ipAddr, port) && (port != 0);
+  if (!address.GetIpAndPort(ipAddr, port) || port == 0)
+    return FALSE;
+
+  if (!cacheKey.IsEmpty()) {
+    PWaitAndSignal m(admissionCacheMutex);
+    CachedLocation & cached = locationCache[cacheKey];
+    cached.address = address;
+    cached.expiry = PTimer::Tick().GetMilliSeconds() + admissionCacheTime.GetMilliSeconds();
+  }
+
+  return TRUE;
 }
 
 
@@ -885,43 +940,31 @@ struct AdmissionRequestResponseInfo {
   AdmissionRequestResponseInfo(
     H323Gatekeeper::AdmissionResponse & r,
     H323Connection & c
-  ) : param(r), connection(c), allocatedBandwidth(0), uuiesRequested(0) { }
+  ) : param(r), connection(c), allocatedBandwidth(0), uuiesRequested(0), cacheable(FALSE) { }
 
   H323Gatekeeper::AdmissionResponse & param;
   H323Connection & connection;
   unsigned allocatedBandwidth;
   unsigned uuiesRequested;
+  PBoolean cacheable;
+  H225_AdmissionConfirm confirm;    // Copy of the ACF if cacheable
   PString      accessTokenOID1;
   PString      accessTokenOID2;
 };
 
 
-PBoolean H323Gatekeeper::AdmissionRequest(H323Connection & connection,
-                                      AdmissionResponse & response,
-                                      PBoolean ignorePreGrantedARQ)
+static unsigned GetUUIEsRequested(const H225_UUIEsRequested & pdu);
+
+
+void H323Gatekeeper::BuildAdmissionRequest(H323RasPDU & pdu,
+                                           unsigned seqNum,
+                                           H323Connection & connection,
+                                           AdmissionResponse & response,
+                                           AdmissionRequestResponseInfo & info)
 {
   PBoolean answeringCall = connection.HadAnsweredCall();
 
-  if (!ignorePreGrantedARQ) {
-    switch (answeringCall ? pregrantAnswerCall : pregrantMakeCall) {
-      case RequireARQ :
-        break;
-      case PregrantARQ :
-        return TRUE;
-      case PreGkRoutedARQ :
-        if (gkRouteAddress.IsEmpty()) {
-          response.rejectReason = UINT_MAX;
-          return FALSE;
-        }
-        if (response.transportAddress != NULL)
-          *response.transportAddress = gkRouteAddress;
-        response.gatekeeperRouted = TRUE;
-        return TRUE;
-    }
-  }
-
-  H323RasPDU pdu;
-  H225_AdmissionRequest & arq = pdu.BuildAdmissionRequest(GetNextSequenceNumber());
+  H225_AdmissionRequest & arq = pdu.BuildAdmissionRequest(seqNum);
 
   arq.m_callType.SetTag(H225_CallType::e_pointToPoint);
   arq.m_endpointIdentifier = endpointIdentifier;
@@ -980,7 +1023,6 @@ PBoolean H323Gatekeeper::AdmissionRequest(H323Connection & connection,
   connection.SetCallLinkage(pdu);
 #endif
 
-  AdmissionRequestResponseInfo info(response, connection);
   info.accessTokenOID1 = connection.GetGkAccessTokenOID();
   PINDEX comma = info.accessTokenOID1.Find(',');
   if (comma == P_MAX_INDEX)
@@ -992,9 +1034,6 @@ PBoolean H323Gatekeeper::AdmissionRequest(H323Connection & connection,
 
   connection.OnSendARQ(arq);
 
-  Request request(arq.m_requestSeqNum, pdu);
-  request.responseInfo = &info;
-
   if (!authenticators.IsEmpty()) {
     pdu.Prepare(arq.m_tokens, H225_AdmissionRequest::e_tokens,
                 arq.m_cryptoTokens, H225_AdmissionRequest::e_cryptoTokens);
@@ -1016,6 +1055,104 @@ PBoolean H323Gatekeeper::AdmissionRequest(H323Connection & connection,
       pdu.SetAuthenticators(adjustedAuthenticators);
     }
   }
+}
+
+
+PBoolean H323Gatekeeper::AdmitWithoutRequest(H323Connection & connection,
+                                             AdmissionResponse & response,
+                                             PBoolean usePreGrantedARQ,
+                                             PString & cacheKey,
+                                             PBoolean & admitted)
+{
+  PBoolean answeringCall = connection.HadAnsweredCall();
+
+  if (usePreGrantedARQ) {
+    switch (answeringCall ? pregrantAnswerCall : pregrantMakeCall) {
+      case RequireARQ :
+        break;
+      case PregrantARQ :
+        admitted = TRUE;
+        return TRUE;
+      case PreGkRoutedARQ :
+        admitted = !gkRouteAddress.IsEmpty();
+        if (!admitted) {
+          response.rejectReason = UINT_MAX;
+          return TRUE;
+        }
+        if (response.transportAddress != NULL)
+          *response.transportAddress = gkRouteAddress;
+        response.gatekeeperRouted = TRUE;
+        return TRUE;
+    }
+  }
+
+  // A repeat call to a destination admitted a moment ago is admitted again
+  if (!answeringCall && admissionCacheTime > 0) {
+    cacheKey = connection.GetRemotePartyName() + '\n' +
+               (response.transportAddress != NULL ? *response.transportAddress : PString()) + '\n' +
+               PString(PString::Unsigned, connection.GetBandwidthRequired());
+
+    PWaitAndSignal m(admissionCacheMutex);
+    AdmissionCache::iterator it = admissionCache.find(cacheKey);
+    if (it != admissionCache.end()) {
+      if (it->second.expiry > PTimer::Tick().GetMilliSeconds()) {
+        const H225_AdmissionConfirm & acf = it->second.confirm;
+        if (response.transportAddress != NULL)
+          *response.transportAddress = acf.m_destCallSignalAddress;
+        response.endpointCount = 1;
+        response.gatekeeperRouted = FALSE;
+        if (response.aliasAddresses != NULL && acf.HasOptionalField(H225_AdmissionConfirm::e_destinationInfo))
+          *response.aliasAddresses = acf.m_destinationInfo;
+        if (response.destExtraCallInfo != NULL && acf.HasOptionalField(H225_AdmissionConfirm::e_destExtraCallInfo))
+          *response.destExtraCallInfo = acf.m_destExtraCallInfo;
+        connection.SetBandwidthAvailable(acf.m_bandWidth);
+        connection.SetUUIEsRequested(acf.HasOptionalField(H225_AdmissionConfirm::e_uuiesRequested)
+                                                ? GetUUIEsRequested(acf.m_uuiesRequested) : 0);
+        PTRACE(3, "RAS\tUsing remembered ACF for " << connection.GetRemotePartyName());
+        admitted = TRUE;
+        return TRUE;
+      }
+      admissionCache.erase(it);
+    }
+  }
+
+  return FALSE;
+}
+
+
+void H323Gatekeeper::RememberAdmission(const PString & cacheKey, const AdmissionRequestResponseInfo & info)
+{
+  if (cacheKey.IsEmpty() || !info.cacheable)
+    return;
+
+  PWaitAndSignal m(admissionCacheMutex);
+  CachedAdmission & cached = admissionCache[cacheKey];
+  cached.confirm = info.confirm;
+  cached.expiry = PTimer::Tick().GetMilliSeconds() + admissionCacheTime.GetMilliSeconds();
+}
+
+
+PBoolean H323Gatekeeper::AdmissionRequest(H323Connection & connection,
+                                      AdmissionResponse & response,
+                                      PBoolean ignorePreGrantedARQ)
+{
+  connection.MarkCallTiming(H323CallTimeline::e_AdmissionRequested);
+
+  PString cacheKey;
+  PBoolean admitted;
+  if (AdmitWithoutRequest(connection, response, !ignorePreGrantedARQ, cacheKey, admitted)) {
+    if (admitted)
+      connection.MarkCallTiming(H323CallTimeline::e_AdmissionConfirmed);
+    return admitted;
+  }
+
+  H323RasPDU pdu;
+  AdmissionRequestResponseInfo info(response, connection);
+  BuildAdmissionRequest(pdu, GetNextSequenceNumber(), connection, response, info);
+  H225_AdmissionRequest & arq = pdu;
+
+  Request request(arq.m_requestSeqNum, pdu);
+  request.responseInfo = &info;
 
   if (!MakeRequest(request)) {
     response.rejectReason = request.rejectReason;
@@ -1076,10 +1213,21 @@ PBoolean H323Gatekeeper::AdmissionRequest(H323Connection & connection,
   connection.SetBandwidthAvailable(info.allocatedBandwidth);
   connection.SetUUIEsRequested(info.uuiesRequested);
 
+  RememberAdmission(cacheKey, info);
+
+  connection.MarkCallTiming(H323CallTimeline::e_AdmissionConfirmed);
   return TRUE;
 }
 
 
+void H323Gatekeeper::ClearAdmissionCache()
+{
+  PWaitAndSignal m(admissionCacheMutex);
+  admissionCache.clear();
+  locationCache.clear();
+}
+
+
 void H323Gatekeeper::OnSendAdmissionRequest(H225_AdmissionRequest & /*arq*/)
 {
   // Override default function as it sets crypto tokens and this is really
@@ -1202,6 +1350,17 @@ PBoolean H323Gatekeeper::OnReceiveAdmissionConfirm(const H225_AdmissionConfirm &
   if (acf.HasOptionalField(H225_AdmissionConfirm::e_language))
       H323GetLanguages(*info.param.languageSupport, acf.m_language);
 
+  // Only a plain direct admission is the same for the next call
+  info.cacheable = !info.param.gatekeeperRouted &&
+                   !acf.HasOptionalField(H225_AdmissionConfirm::e_tokens) &&
+                   !acf.HasOptionalField(H225_AdmissionConfirm::e_cryptoTokens) &&
+                   !acf.HasOptionalField(H225_AdmissionConfirm::e_alternateEndpoints) &&
+                   !acf.HasOptionalField(H225_AdmissionConfirm::e_serviceControl) &&
+                   !acf.HasOptionalField(H225_AdmissionConfirm::e_genericData) &&
+                   !acf.HasOptionalField(H225_AdmissionConfirm::e_featureSet);
+  if (info.cacheable)
+    info.confirm = acf;
+
   return TRUE;
 }
 
@@ -1246,10 +1405,12 @@ static void SetRasUsageInformation(const H323Connection & connection,
 }
 
 
-PBoolean H323Gatekeeper::DisengageRequest(const H323Connection & connection, unsigned reason)
+void H323Gatekeeper::BuildDisengageRequest(H323RasPDU & pdu,
+                                           unsigned seqNum,
+                                           const H323Connection & connection,
+                                           unsigned reason)
 {
-  H323RasPDU pdu;
-  H225_DisengageRequest & drq = pdu.BuildDisengageRequest(GetNextSequenceNumber());
+  H225_DisengageRequest & drq = pdu.BuildDisengageRequest(seqNum);
 
   drq.m_endpointIdentifier = endpointIdentifier;
   drq.m_conferenceID = connection.GetConferenceIdentifier();
@@ -1278,8 +1439,15 @@ PBoolean H323Gatekeeper::DisengageRequest(const H323Connection & connection, uns
   }
 
   connection.OnSendDRQ(drq);
+}
+
 
-  Request request(drq.m_requestSeqNum, pdu);
+PBoolean H323Gatekeeper::DisengageRequest(const H323Connection & connection, unsigned reason)
+{
+  H323RasPDU pdu;
+  BuildDisengageRequest(pdu, GetNextSequenceNumber(), connection, reason);
+
+  Request request(pdu.GetSequenceNumber(), pdu);
   return MakeRequestWithReregister(request, H225_DisengageRejectReason::e_notRegistered);
 }
 
@@ -1319,11 +1487,12 @@ PBoolean H323Gatekeeper::OnReceiveDisengageRequest(const H225_DisengageRequest &
 }
 
 
-PBoolean H323Gatekeeper::BandwidthRequest(H323Connection & connection,
-                                      unsigned requestedBandwidth)
+void H323Gatekeeper::BuildBandwidthRequest(H323RasPDU & pdu,
+                                           unsigned seqNum,
+                                           H323Connection & connection,
+                                           unsigned requestedBandwidth)
 {
-  H323RasPDU pdu;
-  H225_BandwidthRequest & brq = pdu.BuildBandwidthRequest(GetNextSequenceNumber());
+  H225_BandwidthRequest & brq = pdu.BuildBandwidthRequest(seqNum);
 
   brq.m_endpointIdentifier = endpointIdentifier;
   brq.m_conferenceID = connection.GetConferenceIdentifier();
@@ -1332,8 +1501,16 @@ PBoolean H323Gatekeeper::BandwidthRequest(H323Connection & connection,
   brq.m_bandWidth = requestedBandwidth;
   brq.IncludeOptionalField(H225_BandwidthRequest::e_usageInformation);
   SetRasUsageInformation(connection, brq.m_usageInformation);
+}
 
-  Request request(brq.m_requestSeqNum, pdu);
+
+PBoolean H323Gatekeeper::BandwidthRequest(H323Connection & connection,
+                                      unsigned requestedBandwidth)
+{
+  H323RasPDU pdu;
+  BuildBandwidthRequest(pdu, GetNextSequenceNumber(), connection, requestedBandwidth);
+
+  Request request(pdu.GetSequenceNumber(), pdu);
 
   unsigned allocatedBandwidth;
   request.responseInfo = &allocatedBandwidth;
@@ -1346,6 +1523,148 @@ PBoolean H323Gatekeeper::BandwidthRequest(H323Connection & connection,
 }
 
 
+PBoolean H323Gatekeeper::StartLocationRequest(const PStringList & aliases,
+                                          const PNotifier & notifier)
+{
+  if (transport == NULL)
+    return FALSE;
+
+  AsyncRequest * async = new AsyncRequest(*this, notifier);
+  BuildLocationRequest(*async->pdu, GetNextSequenceNumber(), aliases);
+  return async->Start(&async->address);
+}
+
+
+PBoolean H323Gatekeeper::StartAdmissionRequest(H323Connection & connection,
+                                           AdmissionResponse & response,
+                                           const PNotifier & notifier)
+{
+  AsyncRequest * async = new AsyncRequest(*this, notifier);
+
+  PString cacheKey;
+  PBoolean admitted;
+  if (AdmitWithoutRequest(connection, response, TRUE, cacheKey, admitted)) {
+    async->Complete(admitted);
+    return TRUE;
+  }
+
+  async->connection = &connection;
+  async->cacheKey = cacheKey;
+  async->admission = new AdmissionRequestResponseInfo(response, connection);
+  BuildAdmissionRequest(*async->pdu, GetNextSequenceNumber(), connection, response, *async->admission);
+  return async->Start(async->admission);
+}
+
+
+PBoolean H323Gatekeeper::StartBandwidthRequest(H323Connection & connection,
+                                           unsigned requestedBandwidth,
+                                           const PNotifier & notifier)
+{
+  AsyncRequest * async = new AsyncRequest(*this, notifier);
+  async->connection = &connection;
+  BuildBandwidthRequest(*async->pdu, GetNextSequenceNumber(), connection, requestedBandwidth);
+  return async->Start(&async->bandwidth);
+}
+
+
+PBoolean H323Gatekeeper::StartDisengageRequest(const H323Connection & connection,
+                                           unsigned reason,
+                                           const PNotifier & notifier)
+{
+  AsyncRequest * async = new AsyncRequest(*this, notifier);
+  BuildDisengageRequest(*async->pdu, GetNextSequenceNumber(), connection, reason);
+  return async->Start(NULL);
+}
+
+
+H323Gatekeeper::AsyncRequest::AsyncRequest(H323Gatekeeper & gk, const PNotifier & notify)
+  : gatekeeper(gk),
+    pdu(new H323RasPDU),
+    request(NULL),
+    notifier(notify),
+    confirmed(FALSE),
+    bandwidth(0),
+    connection(NULL),
+    admission(NULL)
+{
+}
+
+
+H323Gatekeeper::AsyncRequest::~AsyncRequest()
+{
+  delete request;
+  delete pdu;
+  delete admission;
+}
+
+
+unsigned H323Gatekeeper::AsyncRequest::GetTag() const
+{
+  return pdu->GetTag();
+}
+
+
+PBoolean H323Gatekeeper::AsyncRequest::IsTimedOut() const
+{
+  return request != NULL && request->responseResult == Request::NoResponseReceived;
+}
+
+
+PBoolean H323Gatekeeper::AsyncRequest::Start(void * responseInfo)
+{
+  request = new Request(pdu->GetSequenceNumber(), *pdu);
+  request->responseInfo = responseInfo;
+
+  if (gatekeeper.StartRequest(*request, PCREATE_NOTIFIER(OnCompleted)))
+    return TRUE;
+
+  delete this;
+  return FALSE;
+}
+
+
+void H323Gatekeeper::AsyncRequest::OnCompleted(PObject &, H323_INT ok)
+{
+  switch (pdu->GetTag()) {
+    case H225_RasMessage::e_admissionRequest :
+      if (ok) {
+        connection->SetBandwidthAvailable(admission->allocatedBandwidth);
+        connection->SetUUIEsRequested(admission->uuiesRequested);
+        bandwidth = admission->allocatedBandwidth;
+        gatekeeper.RememberAdmission(cacheKey, *admission);
+      }
+      else {
+        admission->param.rejectReason = request->responseResult == Request::RejectReceived
+                                                        ? request->rejectReason : UINT_MAX;
+        if (request->responseResult == Request::RejectReceived &&
+            (request->rejectReason == H225_AdmissionRejectReason::e_callerNotRegistered ||
+             request->rejectReason == H225_AdmissionRejectReason::e_invalidEndpointIdentifier) &&
+            gatekeeper.autoReregister) {
+          // Let the monitor thread reregister rather than block this one
+          gatekeeper.reregisterNow = TRUE;
+          gatekeeper.monitorTickle.Signal();
+        }
+      }
+      break;
+
+    case H225_RasMessage::e_bandwidthRequest :
+      if (ok)
+        connection->SetBandwidthAvailable(bandwidth);
+      break;
+  }
+
+  Complete(ok != 0);
+}
+
+
+void H323Gatekeeper::AsyncRequest::Complete(PBoolean ok)
+{
+  confirmed = ok;
+  notifier(*this, ok);
+  delete this;
+}
+
+
 PBoolean H323Gatekeeper::OnReceiveBandwidthConfirm(const H225_BandwidthConfirm & bcf)
 {
   if (!H225_RAS::OnReceiveBandwidthConfirm(bcf))
@@ -1428,6 +1747,12 @@ PBoolean H323Gatekeeper::SendUnsolicitedIRR(H225_InfoRequestResponse & irr,
 {
   irr.m_unsolicited = TRUE;
 
+#ifdef H323_H4609
+  // Calls reported together send one QoS report
+  if (irr.m_perCallInfo.GetSize() > 1)
+    H460_FeatureStd9::MergeReports(irr);
+#endif
+
   if (willRespondToIRR) {
     PTRACE(4, "RAS\tSending unsolicited IRR and awaiting acknowledgement");
     Request request(irr.m_requestSeqNum, response);
@@ -1446,7 +1771,7 @@ static void AddInfoRequestResponseCall(H225_InfoRequestResponse & irr,
   irr.IncludeOptionalField(H225_InfoRequestResponse::e_perCallInfo);
 
   PINDEX sz = irr.m_perCallInfo.GetSize();
-  if (sz > 100) // don't include more than 100 calls in IRR to keep message size reasonable
+  if (sz > IRR_MAX_CALLS)
     return;
   if (!irr.m_perCallInfo.SetSize(sz+1))
     return;
@@ -1520,12 +1845,95 @@ static PBoolean AddAllInfoRequestResponseCall(H225_InfoRequestResponse & irr,
 }
 
 
+static PINDEX GetEncodedSize(const PASN_Object & obj)
+{
+  PPER_Stream strm;
+  obj.Encode(strm);
+  strm.CompleteEncoding();
+  return strm.GetSize();
+}
+
+
+void H323Gatekeeper::SendInfoRequestResponseBatch()
+{
+  H323RasPDU response;
+  H225_InfoRequestResponse & irr = BuildInfoRequestResponse(response, GetNextSequenceNumber());
+  PINDEX size = GetEncodedSize(irr);
+
+  // The mutex is not held while a connection is locked, as connections may
+  // call InfoRequestResponse() with their lock held
+  while (irr.m_perCallInfo.GetSize() <= IRR_MAX_CALLS) {
+    infoRequestMutex.Wait();
+    if (infoRequestPending.IsEmpty()) {
+      infoRequestMutex.Signal();
+      break;
+    }
+    PString token = infoRequestPending[0];
+    infoRequestPending.RemoveAt(0);
+    infoRequestMutex.Signal();
+
+    H323Connection * connection = endpoint.FindConnectionWithLock(token);
+    if (connection == NULL)
+      continue;
+
+    PINDEX sz = irr.m_perCallInfo.GetSize();
+    AddInfoRequestResponseCall(irr, *connection);
+    PINDEX callSize = GetEncodedSize(irr.m_perCallInfo[sz]);
+    if (sz > 0 && size + callSize > infoRequestBatchSize) {
+      // Leave it for the next IRR
+      irr.m_perCallInfo.SetSize(sz);
+      connection->Unlock();
+      infoRequestMutex.Wait();
+      infoRequestPending.InsertAt(0, new PString(token));
+      infoRequestMutex.Signal();
+      break;
+    }
+
+    size += callSize;
+    connection->OnSendIRR(irr);
+    connection->Unlock();
+  }
+
+  PINDEX calls = irr.m_perCallInfo.GetSize();
+  if (calls == 0)
+    return;
+
+  infoRequestMutex.Wait();
+  PINDEX left = infoRequestPending.GetSize();
+  if (left > 0) {
+    // Spread the IRRs of a cycle over the first half of the reporting interval
+    if (infoRequestSpacing == 0) {
+      PINDEX batches = (left + calls - 1)/calls;
+      if (infoRequestRate.GetResetTime() > 0)
+        infoRequestSpacing = infoRequestRate.GetResetTime()/(2*batches);
+      if (infoRequestSpacing < IRR_COALESCE_TIME)
+        infoRequestSpacing = IRR_COALESCE_TIME;
+    }
+    infoRequestBatchTimer = infoRequestSpacing;
+  }
+  infoRequestMutex.Signal();
+
+  PTRACE(4, "RAS\tSending batched IRR of " << calls << " calls, " << size << " bytes, " << left << " calls left");
+  SendUnsolicitedIRR(irr, response);
+}
+
+
 void H323Gatekeeper::InfoRequestResponse()
 {
   PStringList tokens = endpoint.GetAllConnections();
   if (tokens.IsEmpty())
     return;
 
+  if (infoRequestBatchSize > 0) {
+    infoRequestMutex.Wait();
+    infoRequestPending = tokens;
+    infoRequestSpacing = 0;
+    infoRequestBatchTimer.Stop();
+    infoRequestMutex.Signal();
+    SendInfoRequestResponseBatch();
+    return;
+  }
+
   H323RasPDU response;
   H225_InfoRequestResponse & irr = BuildInfoRequestResponse(response, GetNextSequenceNumber());
 
@@ -1536,6 +1944,15 @@ void H323Gatekeeper::InfoRequestResponse()
 
 void H323Gatekeeper::InfoRequestResponse(const H323Connection & connection)
 {
+  if (infoRequestBatchSize > 0) {
+    PWaitAndSignal mutex(infoRequestMutex);
+    if (infoRequestPending.GetStringsIndex(connection.GetCallToken()) == P_MAX_INDEX)
+      infoRequestPending.AppendString(connection.GetCallToken());
+    if (!infoRequestBatchTimer.IsRunning())
+      infoRequestBatchTimer = IRR_COALESCE_TIME;
+    return;
+  }
+
   H323RasPDU response;
   H225_InfoRequestResponse & irr = BuildInfoRequestResponse(response, GetNextSequenceNumber());
 
@@ -1727,6 +2144,12 @@ void H323Gatekeeper::MonitorMain(PThread &, H323_INT)
       InfoRequestResponse();
       infoRequestRate.Reset();
     }
+
+    infoRequestMutex.Wait();
+    PBoolean batchDue = !infoRequestBatchTimer.IsRunning() && !infoRequestPending.IsEmpty();
+    infoRequestMutex.Signal();
+    if (batchDue)
+      SendInfoRequestResponseBatch();
   }
 
   PTRACE(3, "RAS\tBackground thread ended");
@@ -1762,6 +2185,11 @@ void H323Gatekeeper::SetAlternates(const H225_ArrayOf_AlternateGK & alts, PBoole
 
   if (alternates.GetSize() > 0)
       alternatePermanent = permanent;
+
+  PWaitAndSignal mutex(probeMutex);
+  probeAlternates.RemoveAll();
+  for (i = 0; i < alternates.GetSize(); i++)
+    probeAlternates.AppendString(H323TransportAddress(alternates[i].rasAddress));
 }
 
 void H323Gatekeeper::SetAssignedGatekeeper(const H225_AlternateGK & gk)
@@ -1847,7 +2275,11 @@ PBoolean H323Gatekeeper::MakeRequest(Request & request)
 
   PINDEX alt = 0;
   for (;;) {
-    if (!request.useAlternate && H225_RAS::MakeRequest(request)) {
+    // Do not wait for a gatekeeper the probes found down when an alternate is up
+    PBoolean skipDown = !request.useAlternate &&
+                        IsGatekeeperDown(transport->GetRemoteAddress()) && IsAnyAlternateUp();
+
+    if (!request.useAlternate && !skipDown && H225_RAS::MakeRequest(request)) {
       if (!alternatePermanent &&
             (transport->GetRemoteAddress() != tempAddr ||
              gatekeeperIdentifier != tempIdentifier))
@@ -1856,6 +2288,13 @@ PBoolean H323Gatekeeper::MakeRequest(Request & request)
       return TRUE;
     }
 
+    if (skipDown) {
+      PTRACE(3, "RAS\tGatekeeper " << transport->GetRemoteAddress() << " is down, trying alternates at once");
+      request.responseResult = Request::TryAlternate;
+    }
+    else if (request.responseResult == Request::NoResponseReceived)
+      MarkGatekeeperDown(transport->GetRemoteAddress());
+
     if (request.responseResult != Request::NoResponseReceived &&
         request.responseResult != Request::TryAlternate) {
       // try alternate in those cases and see if it's successful
@@ -1890,18 +2329,29 @@ PBoolean H323Gatekeeper::MakeRequest(Request & request)
       }
 
       altInfo = &alternates[alt++];
-      if (transport) {
-        transport->GetLocalAddress().GetIpAndPort(localAddress,localPort);
-        transport->CleanUpOnTermination();
-        delete transport;
+
+      // Requests started by StartRequest() write from another thread
+      H323Transport * oldTransport;
+      pduWriteMutex.Wait();
+      oldTransport = transport;
+      transport = NULL;
+      pduWriteMutex.Signal();
+
+      if (oldTransport) {
+        oldTransport->GetLocalAddress().GetIpAndPort(localAddress,localPort);
+        oldTransport->CleanUpOnTermination();
+        delete oldTransport;
       }
 
+      pduWriteMutex.Wait();
       transport = new H323TransportUDP(endpoint,localAddress,localPort);
       transport->SetRemoteAddress (altInfo->rasAddress);
       transport->Connect();
+      pduWriteMutex.Signal();
       gatekeeperIdentifier = altInfo->gatekeeperIdentifier;
       StartChannel();
-    } while (altInfo->registrationState == AlternateInfo::RegistrationFailed);
+    } while (altInfo->registrationState == AlternateInfo::RegistrationFailed ||
+             (IsGatekeeperDown(H323TransportAddress(altInfo->rasAddress)) && IsAnyAlternateUp()));
 
     if (altInfo->registrationState == AlternateInfo::NeedToRegister) {
       altInfo->registrationState = AlternateInfo::RegistrationFailed;
@@ -1927,6 +2377,222 @@ PBoolean H323Gatekeeper::MakeRequest(Request & request)
   }
 }
 
+
+void H323Gatekeeper::SetHealthProbing(const PTimeInterval & interval, unsigned missLimit)
+{
+  StopProbing();
+
+  probeInterval = interval;
+  probeMissLimit = PMAX(missLimit, 1U);
+  if (interval == 0 || transport == NULL)
+    return;
+
+  // Bound to the interface of the RAS transport, but not to its port
+  PIPSocket::Address localIP;
+  WORD localPort = 0;
+  transport->GetLocalAddress().GetIpAndPort(localIP, localPort, "udp");
+
+  probeSocket = new PUDPSocket;
+  if (!probeSocket->Listen(localIP, 0, 0)) {
+    PTRACE(1, "RAS\tCould not open gatekeeper probe socket: " << probeSocket->GetErrorText());
+    delete probeSocket;
+    probeSocket = NULL;
+    return;
+  }
+
+  // The timeout only lets the thread send the next probes and see the stop
+  probeSocket->SetReadTimeout(100);
+  probeStop = FALSE;
+
+  probeThread = PThread::Create(PCREATE_NOTIFIER(ProbeMain), 0,
+                                PThread::NoAutoDeleteThread,
+                                PThread::NormalPriority,
+                                "GkProbe:%x");
+}
+
+
+void H323Gatekeeper::StopProbing()
+{
+  if (probeThread != NULL) {
+    probeStop = TRUE;
+    probeSocket->Close();
+    probeThread->WaitForTermination();
+    delete probeThread;
+    probeThread = NULL;
+  }
+
+  delete probeSocket;
+  probeSocket = NULL;
+
+  PWaitAndSignal mutex(probeMutex);
+  probes.clear();
+}
+
+
+PBoolean H323Gatekeeper::IsGatekeeperDown(const H323TransportAddress & address) const
+{
+  PWaitAndSignal mutex(probeMutex);
+
+  ProbeStates::const_iterator it = probes.find(address);
+  return it != probes.end() && it->second.down;
+}
+
+
+PInt64 H323Gatekeeper::GetProbeRoundTrip(const H323TransportAddress & address) const
+{
+  PWaitAndSignal mutex(probeMutex);
+
+  ProbeStates::const_iterator it = probes.find(address);
+  return it != probes.end() ? it->second.roundTrip : -1;
+}
+
+
+PBoolean H323Gatekeeper::IsAnyAlternateUp() const
+{
+  PWaitAndSignal mutex(probeMutex);
+
+  // Only those answering probes, an alternate not probed yet is not known up
+  for (PINDEX i = 0; i < probeAlternates.GetSize(); i++) {
+    ProbeStates::const_iterator it = probes.find(probeAlternates[i]);
+    if (it != probes.end() && !it->second.down && it->second.answered != 0)
+      return TRUE;
+  }
+  return FALSE;
+}
+
+
+void H323Gatekeeper::MarkGatekeeperDown(const H323TransportAddress & address)
+{
+  PWaitAndSignal mutex(probeMutex);
+
+  if (probeThread == NULL)
+    return;
+
+  ProbeState & state = probes[address];
+  if (!state.down) {
+    PTRACE(2, "RAS\tGatekeeper " << address << " did not answer a request, marked down");
+    state.down = TRUE;
+  }
+}
+
+
+void H323Gatekeeper::ProbeMain(PThread &, H323_INT)
+{
+  PTRACE(3, "RAS\tGatekeeper probing started every " << probeInterval);
+
+  PInt64 nextProbe = 0;
+  BYTE buffer[2048];
+
+  while (!probeStop) {
+    PInt64 now = PTimer::Tick().GetMilliSeconds();
+    if (now >= nextProbe) {
+      SendProbes(now);
+      nextProbe = now + probeInterval.GetMilliSeconds();
+    }
+
+    PIPSocket::Address address;
+    WORD port;
+    if (!probeSocket->ReadFrom(buffer, sizeof(buffer), address, port))
+      continue;
+
+    PPER_Stream strm(buffer, probeSocket->GetLastReadCount());
+    H323RasPDU pdu;
+    if (!pdu.Decode(strm))
+      continue;
+
+    // A reject also shows the gatekeeper is alive
+    if (pdu.GetTag() == H225_RasMessage::e_gatekeeperConfirm ||
+        pdu.GetTag() == H225_RasMessage::e_gatekeeperReject)
+      OnProbeAnswer(pdu.GetSequenceNumber(), PTimer::Tick().GetMilliSeconds());
+  }
+
+  PTRACE(3, "RAS\tGatekeeper probing ended");
+}
+
+
+void H323Gatekeeper::SendProbes(PInt64 now)
+{
+  PStringList targets;
+
+  pduWriteMutex.Wait();
+  if (transport != NULL)
+    targets.AppendString(transport->GetRemoteAddress());
+  pduWriteMutex.Signal();
+
+  PWaitAndSignal mutex(probeMutex);
+
+  for (PINDEX i = 0; i < probeAlternates.GetSize(); i++) {
+    if (targets.GetStringsIndex(probeAlternates[i]) == P_MAX_INDEX)
+      targets.AppendString(probeAlternates[i]);
+  }
+
+  PIPSocket::Address localIP;
+  WORD localPort = 0;
+  probeSocket->GetLocalAddress(localIP, localPort);
+
+  for (PINDEX i = 0; i < targets.GetSize(); i++) {
+    ProbeState & state = probes[targets[i]];
+
+    if (state.sent > state.answered && ++state.missed >= probeMissLimit && !state.down) {
+      PTRACE(2, "RAS\tGatekeeper " << targets[i] << " missed " << state.missed << " probes, marked down");
+      state.down = TRUE;
+    }
+
+    probeSequenceNumber = probeSequenceNumber%65535 + 1;
+    state.sequenceNumber = probeSequenceNumber;
+    state.sent = now;
+
+    H323RasPDU pdu;
+    H225_GatekeeperRequest & grq = pdu.BuildGatekeeperRequest(state.sequenceNumber);
+    endpoint.SetEndpointTypeInfo(grq.m_endpointType);
+    H323TransportAddress(localIP, localPort).SetPDU(grq.m_rasAddress);
+
+    PPER_Stream strm;
+    pdu.Encode(strm);
+    strm.CompleteEncoding();
+
+    PIPSocket::Address ip;
+    WORD port = H225_RAS::DefaultRasUdpPort;
+    if (H323TransportAddress(targets[i]).GetIpAndPort(ip, port, "udp"))
+      probeSocket->WriteTo(strm.GetPointer(), strm.GetSize(), ip, port);
+  }
+}
+
+
+void H323Gatekeeper::OnProbeAnswer(unsigned sequenceNumber, PInt64 now)
+{
+  PWaitAndSignal mutex(probeMutex);
+
+  for (ProbeStates::iterator it = probes.begin(); it != probes.end(); ++it) {
+    ProbeState & state = it->second;
+    if (state.sequenceNumber == sequenceNumber && state.answered < state.sent) {
+      state.answered = now;
+      state.roundTrip = now - state.sent;
+      state.missed = 0;
+      if (state.down) {
+        PTRACE(2, "RAS\tGatekeeper " << it->first << " answered probe, marked up");
+        state.down = FALSE;
+      }
+      return;
+    }
+  }
+}
+
+
+PBoolean H323Gatekeeper::StartRequest(Request & request, const PNotifier & completed)
+{
+  if (transport == NULL)
+    return FALSE;
+
+  /* Set authenticators if not already set by caller. The requestMutex is
+     not taken as it is held by MakeRequest() until its response arrives */
+  if (request.requestPDU.GetAuthenticators().IsEmpty())
+    request.requestPDU.SetAuthenticators(authenticators);
+
+  return H225_RAS::StartRequest(request, completed);
+}
+
+
 H323Gatekeeper::AlternateInfo::AlternateInfo()
 :  priority(0), registrationState(NoRegistrationNeeded)
 {
@@ -0,0 +1,580 @@
+/*
+ * gkcluster.cxx
+ *
+ * Registrations shared by a cluster of gatekeepers
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "gkcluster.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#include "gkcluster.h"
+
+#include <algorithm>
+
+#define new PNEW
+
+
+static const char ClusterMagic[] = "H323GKC";
+static const PINDEX MaxMessageSize = 1200;    // Full syncs are split to stay below this
+static const PINDEX PeerSyncsMissed = 3;      // Announcements missed before a node is dropped
+
+
+static PString ClusterEscape(const PString & str)
+{
+  PString escaped;
+  for (PINDEX i = 0; i < str.GetLength(); i++) {
+    char c = str[i];
+    switch (c) {
+      case '%' :  escaped += "%25"; break;
+      case '\t' : escaped += "%09"; break;
+      case '\n' : escaped += "%0A"; break;
+      case ' ' :  escaped += "%20"; break;
+      default :   escaped += c;
+    }
+  }
+  return escaped;
+}
+
+
+static PString ClusterUnescape(const PString & str)
+{
+  PString unescaped;
+  for (PINDEX i = 0; i < str.GetLength(); i++) {
+    if (str[i] == '%' && i+2 < str.GetLength()) {
+      unescaped += (char)str.Mid(i+1, 2).AsUnsigned(16);
+      i += 2;
+    }
+    else
+      unescaped += str[i];
+  }
+  return unescaped;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323RegistrationStore::H323RegistrationStore(const PString & name, const H323TransportAddress & ras)
+  : nodeName(name),
+    rasAddress(ras)
+{
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323GossipRegistrationStore::H323GossipRegistrationStore(const PString & name, const H323TransportAddress & ras)
+  : H323RegistrationStore(name, ras),
+    socket(NULL),
+    receiveThread(NULL),
+    running(FALSE),
+    syncInterval(0, 5),
+    sequence(0)
+{
+}
+
+
+H323GossipRegistrationStore::~H323GossipRegistrationStore()
+{
+  Close();
+}
+
+
+PBoolean H323GossipRegistrationStore::Open(const H323TransportAddress & address)
+{
+  Close();
+
+  PIPSocket::Address ip;
+  WORD port = DefaultPort;
+  if (!address.GetIpAndPort(ip, port)) {
+    PTRACE(1, "GkCluster\tInvalid cluster address " << address);
+    return FALSE;
+  }
+
+  socket = new PUDPSocket;
+  if (!socket->Listen(ip, 0, port, PSocket::CanReuseAddress)) {
+    PTRACE(1, "GkCluster\tCould not listen on " << address << ": " << socket->GetErrorText());
+    delete socket;
+    socket = NULL;
+    return FALSE;
+  }
+
+  running = TRUE;
+  receiveThread = PThread::Create(PCREATE_NOTIFIER(ReceiveMain), 0,
+                                  PThread::NoAutoDeleteThread,
+                                  PThread::NormalPriority,
+                                  "GkCluster");
+
+  PTRACE(3, "GkCluster\tNode " << nodeName << " listening on " << address);
+  return TRUE;
+}
+
+
+void H323GossipRegistrationStore::Close()
+{
+  if (socket == NULL)
+    return;
+
+  running = FALSE;
+  socket->Close();
+  if (receiveThread != NULL) {
+    PAssert(receiveThread->WaitForTermination(10000), "Cluster receive thread did not terminate!");
+    delete receiveThread;
+    receiveThread = NULL;
+  }
+
+  delete socket;
+  socket = NULL;
+}
+
+
+void H323GossipRegistrationStore::AddPeer(const H323TransportAddress & address)
+{
+  PWaitAndSignal m(mutex);
+  peerAddresses.AppendAddress(address);
+}
+
+
+void H323GossipRegistrationStore::Publish(const Registration & registration)
+{
+  PWaitAndSignal m(mutex);
+
+  Registration & own = ownEndpoints[registration.identifier];
+  own = registration;
+  own.node = nodeName;
+  own.version = PTime().GetTimestamp()/1000;
+
+  PStringStream message;
+  message << ClusterMagic << " U " << ClusterEscape(nodeName) << '\n'
+          << ++sequence << '\n'
+          << Encode(own);
+  SendToPeers(message);
+}
+
+
+void H323GossipRegistrationStore::Withdraw(const PString & identifier)
+{
+  PWaitAndSignal m(mutex);
+
+  if (ownEndpoints.erase(identifier) == 0)
+    return;
+
+  PStringStream message;
+  message << ClusterMagic << " W " << ClusterEscape(nodeName) << '\n'
+          << ++sequence << '\n'
+          << ClusterEscape(identifier);
+  SendToPeers(message);
+}
+
+
+PBoolean H323GossipRegistrationStore::Locate(const PString & alias, Registration & registration)
+{
+  PWaitAndSignal m(mutex);
+
+  const Registration * found = NULL;
+
+  // An alias, or failing that the longest voice prefix of it
+  std::pair<IndexMap::const_iterator, IndexMap::const_iterator> range = byAlias.equal_range(alias);
+  for (PINDEX length = alias.GetLength(); range.first == range.second && length > 0; length--)
+    range = byPrefix.equal_range(alias.Left(length));
+
+  for (IndexMap::const_iterator it = range.first; it != range.second; ++it) {
+    std::map<PString, Peer>::const_iterator peer = peers.find(it->second.first);
+    if (peer == peers.end())
+      continue;
+    std::map<PString, Registration>::const_iterator ep = peer->second.endpoints.find(it->second.second);
+    if (ep != peer->second.endpoints.end() && (found == NULL || ep->second.version > found->version))
+      found = &ep->second;
+  }
+
+  if (found == NULL)
+    return FALSE;
+
+  registration = *found;
+  return TRUE;
+}
+
+
+static bool CompareNodeLoad(const H323RegistrationStore::Node & a, const H323RegistrationStore::Node & b)
+{
+  return a.registrations < b.registrations;
+}
+
+
+void H323GossipRegistrationStore::GetNodes(std::vector<Node> & nodes)
+{
+  PWaitAndSignal m(mutex);
+
+  nodes.clear();
+  for (std::map<PString, Peer>::const_iterator it = peers.begin(); it != peers.end(); ++it) {
+    if (it->second.rasAddress.IsEmpty())
+      continue;
+    Node node;
+    node.name = it->first;
+    node.rasAddress = it->second.rasAddress;
+    node.registrations = it->second.registrations;
+    nodes.push_back(node);
+  }
+
+  std::stable_sort(nodes.begin(), nodes.end(), CompareNodeLoad);
+}
+
+
+void H323GossipRegistrationStore::ReceiveMain(PThread &, H323_INT)
+{
+  PTRACE(4, "GkCluster\tReceive thread started");
+
+  PInt64 nextAnnouncement = 0;
+  PBYTEArray buffer(65536);
+
+  while (running) {
+    PInt64 now = PTimer::Tick().GetMilliSeconds();
+    if (now >= nextAnnouncement) {
+      SendAnnouncement();
+      nextAnnouncement = now + syncInterval.GetMilliSeconds();
+    }
+
+    socket->SetReadTimeout(PTimeInterval(nextAnnouncement - now));
+
+    PIPSocket::Address address;
+    WORD port;
+    if (socket->ReadFrom(buffer.GetPointer(), buffer.GetSize(), address, port)) {
+      PINDEX count = socket->GetLastReadCount();
+      OnMessage(PString((const char *)(const BYTE *)buffer, count), address, port);
+    }
+    else if (socket->GetErrorCode(PChannel::LastReadError) != PChannel::Timeout &&
+             socket->GetErrorCode(PChannel::LastReadError) != PChannel::Unavailable) {
+      // Closed, or a hard error the next read will also have
+      if (running)
+        PThread::Sleep(100);
+    }
+  }
+
+  PTRACE(4, "GkCluster\tReceive thread ended");
+}
+
+
+void H323GossipRegistrationStore::OnMessage(const PString & message, const PIPSocket::Address & address, WORD port)
+{
+  PStringArray lines = message.Lines();
+  if (lines.IsEmpty())
+    return;
+
+  PStringArray header = lines[0].Tokenise(' ', FALSE);
+  if (header.GetSize() < 3 || header[0] != ClusterMagic) {
+    PTRACE(2, "GkCluster\tIgnoring message from " << address << ':' << port);
+    return;
+  }
+
+  PString name = ClusterUnescape(header[2]);
+  if (name == nodeName)
+    return;   // Our own message through a multicast or mistaken peer address
+
+  PWaitAndSignal m(mutex);
+
+  Peer & peer = peers[name];
+  peer.address = address;
+  peer.port = port;
+  peer.lastHeard = PTimer::Tick().GetMilliSeconds();
+
+  switch (header[1][0]) {
+    case 'A' :    // Announcement: sequence ras registrations
+      if (lines.GetSize() >= 2) {
+        PStringArray fields = lines[1].Tokenise(' ', FALSE);
+        if (fields.GetSize() >= 3) {
+          peer.rasAddress = ClusterUnescape(fields[1]);
+          peer.registrations = fields[2].AsUnsigned();
+          if (!peer.synced || fields[0].AsUnsigned() != peer.sequence) {
+            PTRACE(3, "GkCluster\tNode " << name << " out of step, asking for its endpoints");
+            SendTo(PString(ClusterMagic) + " S " + ClusterEscape(nodeName) + '\n', address, port);
+          }
+        }
+      }
+      break;
+
+    case 'S' :    // Asked for all our endpoints
+      SendAll(address, port);
+      break;
+
+    case 'U' :    // Endpoint published
+    case 'W' :    // Endpoint withdrawn
+      if (lines.GetSize() >= 3 && peer.synced) {
+        unsigned seq = lines[1].AsUnsigned();
+        if (seq <= peer.sequence)
+          break;    // Repeated or late
+
+        if (seq != peer.sequence+1) {
+          // Missed a change, the next announcement asks for everything
+          PTRACE(3, "GkCluster\tMissed changes from node " << name << ", at " << peer.sequence << " got " << seq);
+          peer.synced = FALSE;
+          break;
+        }
+        peer.sequence = seq;
+
+        if (header[1][0] == 'U') {
+          Registration registration;
+          if (Decode(lines[2], registration)) {
+            registration.node = name;
+            std::map<PString, Registration>::iterator old = peer.endpoints.find(registration.identifier);
+            if (old != peer.endpoints.end())
+              RemoveIndex(old->second);
+            peer.endpoints[registration.identifier] = registration;
+            AddIndex(registration);
+          }
+        }
+        else {
+          std::map<PString, Registration>::iterator old = peer.endpoints.find(ClusterUnescape(lines[2]));
+          if (old != peer.endpoints.end()) {
+            RemoveIndex(old->second);
+            peer.endpoints.erase(old);
+          }
+        }
+      }
+      break;
+
+    case 'F' :    // Part of all endpoints: sequence part last
+      if (lines.GetSize() >= 2) {
+        PStringArray fields = lines[1].Tokenise(' ', FALSE);
+        if (fields.GetSize() < 3)
+          break;
+
+        PINDEX part = fields[1].AsUnsigned();
+        if (part == 0) {
+          for (std::map<PString, Registration>::iterator it = peer.endpoints.begin(); it != peer.endpoints.end(); ++it)
+            RemoveIndex(it->second);
+          peer.endpoints.clear();
+          peer.synced = FALSE;
+        }
+        else if (part != peer.nextPart)
+          break;    // Lost a part, the next announcement asks again
+        peer.nextPart = part+1;
+
+        for (PINDEX i = 2; i < lines.GetSize(); i++) {
+          Registration registration;
+          if (Decode(lines[i], registration)) {
+            registration.node = name;
+            peer.endpoints[registration.identifier] = registration;
+            AddIndex(registration);
+          }
+        }
+
+        if (fields[2].AsUnsigned() != 0) {
+          peer.sequence = fields[0].AsUnsigned();
+          peer.synced = TRUE;
+          PTRACE(3, "GkCluster\tNode " << name << " has " << peer.endpoints.size() << " endpoints");
+        }
+      }
+      break;
+
+    default :
+      PTRACE(2, "GkCluster\tUnknown message " << header[1] << " from node " << name);
+  }
+}
+
+
+void H323GossipRegistrationStore::SendAnnouncement()
+{
+  PWaitAndSignal m(mutex);
+
+  // Forget the nodes that stopped, their endpoints register elsewhere
+  PInt64 expired = PTimer::Tick().GetMilliSeconds() - PeerSyncsMissed*syncInterval.GetMilliSeconds();
+  std::vector<PString> stopped;
+  for (std::map<PString, Peer>::const_iterator it = peers.begin(); it != peers.end(); ++it) {
+    if (it->second.lastHeard < expired)
+      stopped.push_back(it->first);
+  }
+  for (size_t i = 0; i < stopped.size(); i++)
+    RemovePeer(stopped[i]);
+
+  PStringStream message;
+  message << ClusterMagic << " A " << ClusterEscape(nodeName) << '\n'
+          << sequence << ' ' << ClusterEscape(rasAddress) << ' ' << ownEndpoints.size();
+  SendToPeers(message);
+}
+
+
+void H323GossipRegistrationStore::SendAll(const PIPSocket::Address & address, WORD port)
+{
+  // Called with the mutex held, so the parts are one consistent set
+  PString header = PString(ClusterMagic) + " F " + ClusterEscape(nodeName) + '\n';
+  PINDEX part = 0;
+  PString body;
+
+  std::map<PString, Registration>::const_iterator it = ownEndpoints.begin();
+  for (;;) {
+    PString line;
+    if (it != ownEndpoints.end())
+      line = Encode(it->second);
+
+    if (it == ownEndpoints.end() || (!body.IsEmpty() && body.GetLength() + line.GetLength() > MaxMessageSize)) {
+      PStringStream message;
+      message << header << sequence << ' ' << part++ << ' ' << (it == ownEndpoints.end() ? 1 : 0) << '\n' << body;
+      SendTo(message, address, port);
+      body = PString::Empty();
+      if (it == ownEndpoints.end())
+        break;
+    }
+
+    body += line + '\n';
+    ++it;
+  }
+
+  PTRACE(4, "GkCluster\tSent " << ownEndpoints.size() << " endpoints in " << part << " parts to " << address << ':' << port);
+}
+
+
+void H323GossipRegistrationStore::SendToPeers(const PString & message)
+{
+  for (PINDEX i = 0; i < peerAddresses.GetSize(); i++) {
+    PIPSocket::Address ip;
+    WORD port = DefaultPort;
+    if (peerAddresses[i].GetIpAndPort(ip, port))
+      SendTo(message, ip, port);
+  }
+}
+
+
+void H323GossipRegistrationStore::SendTo(const PString & message, const PIPSocket::Address & address, WORD port)
+{
+  if (socket == NULL || !running)
+    return;
+
+  if (!socket->WriteTo((const char *)message, message.GetLength(), address, port)) {
+    PTRACE(2, "GkCluster\tCould not send to " << address << ':' << port << ": " << socket->GetErrorText(PChannel::LastWriteError));
+  }
+}
+
+
+void H323GossipRegistrationStore::RemovePeer(const PString & name)
+{
+  std::map<PString, Peer>::iterator peer = peers.find(name);
+  if (peer == peers.end())
+    return;
+
+  PTRACE(2, "GkCluster\tNode " << name << " stopped, forgetting its " << peer->second.endpoints.size() << " endpoints");
+
+  for (std::map<PString, Registration>::iterator it = peer->second.endpoints.begin(); it != peer->second.endpoints.end(); ++it)
+    RemoveIndex(it->second);
+  peers.erase(peer);
+}
+
+
+void H323GossipRegistrationStore::AddIndex(const Registration & registration)
+{
+  std::pair<PString, PString> key(registration.node, registration.identifier);
+  PINDEX i;
+  for (i = 0; i < registration.aliases.GetSize(); i++)
+    byAlias.insert(IndexMap::value_type(registration.aliases[i], key));
+  for (i = 0; i < registration.prefixes.GetSize(); i++)
+    byPrefix.insert(IndexMap::value_type(registration.prefixes[i], key));
+}
+
+
+static void RemoveIndexEntry(std::multimap<PString, std::pair<PString, PString> > & index,
+                             const PString & entry, const PString & node, const PString & identifier)
+{
+  typedef std::multimap<PString, std::pair<PString, PString> >::iterator iterator;
+  std::pair<iterator, iterator> range = index.equal_range(entry);
+  while (range.first != range.second) {
+    if (range.first->second.first == node && range.first->second.second == identifier)
+      index.erase(range.first++);
+    else
+      ++range.first;
+  }
+}
+
+
+void H323GossipRegistrationStore::RemoveIndex(const Registration & registration)
+{
+  PINDEX i;
+  for (i = 0; i < registration.aliases.GetSize(); i++)
+    RemoveIndexEntry(byAlias, registration.aliases[i], registration.node, registration.identifier);
+  for (i = 0; i < registration.prefixes.GetSize(); i++)
+    RemoveIndexEntry(byPrefix, registration.prefixes[i], registration.node, registration.identifier);
+}
+
+
+PString H323GossipRegistrationStore::Encode(const Registration & registration) const
+{
+  // identifier version then a tagged field each for the aliases and addresses
+  PStringStream line;
+  line << ClusterEscape(registration.identifier) << '\t' << registration.version;
+
+  PINDEX i;
+  for (i = 0; i < registration.aliases.GetSize(); i++)
+    line << "\ta:" << ClusterEscape(registration.aliases[i]);
+  for (i = 0; i < registration.prefixes.GetSize(); i++)
+    line << "\tp:" << ClusterEscape(registration.prefixes[i]);
+  for (i = 0; i < registration.signalAddresses.GetSize(); i++)
+    line << "\ts:" << ClusterEscape(registration.signalAddresses[i]);
+  for (i = 0; i < registration.rasAddresses.GetSize(); i++)
+    line << "\tr:" << ClusterEscape(registration.rasAddresses[i]);
+
+  return line;
+}
+
+
+PBoolean H323GossipRegistrationStore::Decode(const PString & line, Registration & registration) const
+{
+  PStringArray fields = line.Tokenise('\t', FALSE);
+  if (fields.GetSize() < 2)
+    return FALSE;
+
+  registration.identifier = ClusterUnescape(fields[0]);
+  registration.version = fields[1].AsInt64();
+
+  for (PINDEX i = 2; i < fields.GetSize(); i++) {
+    if (fields[i].GetLength() < 2 || fields[i][1] != ':')
+      continue;
+
+    PString value = ClusterUnescape(fields[i].Mid(2));
+    switch (fields[i][0]) {
+      case 'a' :
+        registration.aliases.AppendString(value);
+        break;
+      case 'p' :
+        registration.prefixes.AppendString(value);
+        break;
+      case 's' :
+        registration.signalAddresses.AppendAddress(value);
+        break;
+      case 'r' :
+        registration.rasAddresses.AppendAddress(value);
+        break;
+    }
+  }
+
+  return registration.signalAddresses.GetSize() > 0;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
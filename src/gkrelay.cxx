@@ -0,0 +1,473 @@
+/*
+ * gkrelay.cxx
+ *
+ * Signalling relay for gatekeeper routed calls
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "gkrelay.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#include "gkrelay.h"
+
+#include "gkserver.h"
+#include "h323pdu.h"
+#include "h323perstream.h"
+
+#define new PNEW
+
+
+static const PTimeInterval SetupTimeout(0, 10);     // For the SETUP once connected
+static const PTimeInterval ConnectTimeout(0, 5);    // To the called endpoint
+static const PTimeInterval ReadTimeout(0, 10);      // For the rest of a TPKT once started
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+/**The two call signalling connections of one relayed call, serviced by one
+   thread waiting on both.
+  */
+class H323SignallingRelay::Call : public PObject
+{
+    PCLASSINFO(Call, PObject);
+  public:
+    Call(H323SignallingRelay & relay, PTCPSocket * caller);
+    ~Call();
+
+    void Start();
+    void Close();
+
+  protected:
+    PDECLARE_NOTIFIER(PThread, Call, Main);
+    PBoolean ReadTPKT(PTCPSocket & socket, PBYTEArray & buffer, PINDEX & length);
+    PBoolean Forward(PTCPSocket & from, PTCPSocket & to, PBYTEArray & buffer, PBoolean & released);
+    PBoolean RelaySetup(PBYTEArray & buffer, PINDEX length);
+    PBoolean WriteTPKT(PTCPSocket & socket, const PBYTEArray & data);
+    void Release(const Q931 & q931, const H225_Setup_UUIE & setup, Q931::CauseValues cause);
+
+    H323SignallingRelay & relay;
+    PTCPSocket          * caller;
+    PTCPSocket          * called;
+    PBoolean              closing;
+    PMutex                mutex;
+};
+
+
+static int GetMessageType(const BYTE * tpkt, PINDEX length)
+{
+  // Protocol discriminator and call reference length follow the TPKT header
+  if (length < 7)
+    return -1;
+
+  PINDEX offset = 6 + (tpkt[5] & 0x0f);
+  return offset < length ? tpkt[offset] : -1;
+}
+
+
+H323SignallingRelay::Call::Call(H323SignallingRelay & r, PTCPSocket * socket)
+  : relay(r),
+    caller(socket),
+    called(NULL),
+    closing(FALSE)
+{
+}
+
+
+H323SignallingRelay::Call::~Call()
+{
+  delete caller;
+  delete called;
+}
+
+
+void H323SignallingRelay::Call::Start()
+{
+  PThread::Create(PCREATE_NOTIFIER(Main), 0,
+                  PThread::AutoDeleteThread,
+                  PThread::NormalPriority,
+                  "GkRelay:%x");
+}
+
+
+void H323SignallingRelay::Call::Close()
+{
+  PWaitAndSignal m(mutex);
+
+  closing = TRUE;
+  caller->Close();
+  if (called != NULL)
+    called->Close();
+}
+
+
+void H323SignallingRelay::Call::Main(PThread &, H323_INT)
+{
+  PTRACE(4, "GkRelay\tStarted relay of call from " << caller->GetPeerAddress());
+
+  // One buffer for each direction, every TPKT is read into it and written from it
+  PBYTEArray callerBuffer(1024);
+  PBYTEArray calledBuffer(1024);
+  PINDEX length;
+
+  caller->SetReadTimeout(SetupTimeout);
+  if (ReadTPKT(*caller, callerBuffer, length) && RelaySetup(callerBuffer, length)) {
+    caller->SetReadTimeout(ReadTimeout);
+    called->SetReadTimeout(ReadTimeout);
+
+    PBoolean released = FALSE;
+    while (!released) {
+      int selection = PSocket::Select(*caller, *called);
+      if (selection >= 0)
+        break;
+
+      if ((selection == -1 || selection == -3) && !Forward(*caller, *called, callerBuffer, released))
+        break;
+
+      if (!released && (selection == -2 || selection == -3) && !Forward(*called, *caller, calledBuffer, released))
+        break;
+    }
+  }
+
+  PTRACE(4, "GkRelay\tEnded relay of call from " << caller->GetPeerAddress());
+
+  // Deletes this
+  relay.OnCallEnded(this);
+}
+
+
+PBoolean H323SignallingRelay::Call::ReadTPKT(PTCPSocket & socket, PBYTEArray & buffer, PINDEX & length)
+{
+  if (!socket.ReadBlock(buffer.GetPointer(4), 4))
+    return FALSE;
+
+  if (buffer[0] != 3) {
+    PTRACE(2, "GkRelay\tNot a TPKT from " << socket.GetPeerAddress());
+    return FALSE;
+  }
+
+  length = ((PINDEX)buffer[2] << 8) | buffer[3];
+  if (length < 4)
+    return FALSE;
+
+  return length == 4 || socket.ReadBlock(buffer.GetPointer(length) + 4, length - 4);
+}
+
+
+PBoolean H323SignallingRelay::Call::WriteTPKT(PTCPSocket & socket, const PBYTEArray & data)
+{
+  PINDEX length = data.GetSize() + 4;
+  if (length > 0xffff)
+    return FALSE;
+
+  PBYTEArray tpkt(length);
+  tpkt[0] = 3;
+  tpkt[1] = 0;
+  tpkt[2] = (BYTE)(length >> 8);
+  tpkt[3] = (BYTE)length;
+  memcpy(tpkt.GetPointer() + 4, data, data.GetSize());
+  return socket.Write(tpkt, length);
+}
+
+
+PBoolean H323SignallingRelay::Call::Forward(PTCPSocket & from,
+                                           PTCPSocket & to,
+                                           PBYTEArray & buffer,
+                                           PBoolean & released)
+{
+  PINDEX length;
+  if (!ReadTPKT(from, buffer, length))
+    return FALSE;
+
+  released = GetMessageType(buffer, length) == Q931::ReleaseCompleteMsg;
+
+  if (!to.Write(buffer, length))
+    return FALSE;
+
+  H323_ATOMIC_ADD64(&relay.forwardedPDUs, 1);
+  return TRUE;
+}
+
+
+PBoolean H323SignallingRelay::Call::RelaySetup(PBYTEArray & buffer, PINDEX length)
+{
+  Q931 q931;
+  if (GetMessageType(buffer, length) != Q931::SetupMsg ||
+      !q931.Decode(PBYTEArray((const BYTE *)buffer + 4, length - 4)) ||
+      !q931.HasIE(Q931::UserUserIE)) {
+    PTRACE(2, "GkRelay\tFirst message from " << caller->GetPeerAddress() << " is not a SETUP");
+    return FALSE;
+  }
+
+  const BYTE * userUser;
+  PINDEX userUserLength;
+  q931.GetIE(Q931::UserUserIE, userUser, userUserLength);
+
+  H225_H323_UserInformation uuie;
+  H323_PERStream strm(userUser, userUserLength);
+  if (!uuie.Decode(strm) ||
+      uuie.m_h323_uu_pdu.m_h323_message_body.GetTag() != H225_H323_UU_PDU_h323_message_body::e_setup) {
+    PTRACE(2, "GkRelay\tCould not decode SETUP from " << caller->GetPeerAddress());
+    return FALSE;
+  }
+
+  H225_Setup_UUIE & setup = uuie.m_h323_uu_pdu.m_h323_message_body;
+
+  H323TransportAddress destination;
+  if (!relay.OnRouteCall(q931, setup, destination)) {
+    PTRACE(2, "GkRelay\tNo route for call from " << caller->GetPeerAddress());
+    Release(q931, setup, Q931::NoRouteToDestination);
+    return FALSE;
+  }
+
+  PIPSocket::Address ip;
+  WORD port = H323EndPoint::DefaultTcpPort;
+  if (!destination.GetIpAndPort(ip, port)) {
+    PTRACE(2, "GkRelay\tCannot relay call to " << destination);
+    Release(q931, setup, Q931::NoRouteToDestination);
+    return FALSE;
+  }
+
+  PTCPSocket * socket = new PTCPSocket(port);
+  socket->SetReadTimeout(ConnectTimeout);
+  if (!socket->Connect(ip)) {
+    PTRACE(2, "GkRelay\tCould not connect to " << destination << ": " << socket->GetErrorText());
+    delete socket;
+    Release(q931, setup, Q931::DestinationOutOfOrder);
+    return FALSE;
+  }
+
+  {
+    PWaitAndSignal m(mutex);
+    called = socket;
+    if (closing)
+      return FALSE;
+  }
+
+  PTRACE(3, "GkRelay\tRelaying call from " << caller->GetPeerAddress() << " to " << destination);
+
+  // Changing the SETUP would fail the integrity check of its tokens
+  if (setup.HasOptionalField(H225_Setup_UUIE::e_cryptoTokens) && setup.m_cryptoTokens.GetSize() > 0)
+    return called->Write(buffer, length);
+
+  destination.SetPDU(setup.m_destCallSignalAddress);
+  setup.IncludeOptionalField(H225_Setup_UUIE::e_destCallSignalAddress);
+
+  PIPSocket::Address localIP;
+  WORD localPort = H323EndPoint::DefaultTcpPort;
+  relay.GetSignalAddress().GetIpAndPort(localIP, localPort);
+  called->GetLocalAddress(localIP);
+  H323TransportAddress(localIP, localPort).SetPDU(setup.m_sourceCallSignalAddress);
+  setup.IncludeOptionalField(H225_Setup_UUIE::e_sourceCallSignalAddress);
+
+  H323_PERStream encoded;
+  uuie.Encode(encoded);
+  encoded.CompleteEncoding();
+  q931.SetIE(Q931::UserUserIE, encoded);
+
+  PBYTEArray data;
+  return q931.Encode(data) && WriteTPKT(*called, data);
+}
+
+
+void H323SignallingRelay::Call::Release(const Q931 & setupQ931,
+                                        const H225_Setup_UUIE & setup,
+                                        Q931::CauseValues cause)
+{
+  H225_H323_UserInformation uuie;
+  uuie.m_h323_uu_pdu.m_h323_message_body.SetTag(H225_H323_UU_PDU_h323_message_body::e_releaseComplete);
+  H225_ReleaseComplete_UUIE & release = uuie.m_h323_uu_pdu.m_h323_message_body;
+  release.m_protocolIdentifier = setup.m_protocolIdentifier;
+  release.IncludeOptionalField(H225_ReleaseComplete_UUIE::e_callIdentifier);
+  release.m_callIdentifier = setup.m_callIdentifier;
+
+  H323_PERStream strm;
+  uuie.Encode(strm);
+  strm.CompleteEncoding();
+
+  Q931 q931;
+  q931.BuildReleaseComplete(setupQ931.GetCallReference(), TRUE);
+  q931.SetCause(cause);
+  q931.SetIE(Q931::UserUserIE, strm);
+
+  PBYTEArray data;
+  if (q931.Encode(data))
+    WriteTPKT(*caller, data);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323SignallingRelay::H323SignallingRelay(H323GatekeeperServer & gk)
+  : gatekeeper(gk),
+    listenThread(NULL),
+    totalCalls(0),
+    forwardedPDUs(0)
+{
+}
+
+
+H323SignallingRelay::~H323SignallingRelay()
+{
+  Close();
+}
+
+
+PBoolean H323SignallingRelay::Open(const H323TransportAddress & iface)
+{
+  Close();
+
+  PIPSocket::Address ip;
+  WORD port = H323EndPoint::DefaultTcpPort;
+  if (!iface.GetIpAndPort(ip, port)) {
+    PTRACE(1, "GkRelay\tCannot listen on " << iface);
+    return FALSE;
+  }
+
+  if (!listener.Listen(ip, 100, port, PSocket::CanReuseAddress)) {
+    PTRACE(1, "GkRelay\tCould not listen on " << iface << ": " << listener.GetErrorText());
+    return FALSE;
+  }
+
+  if (ip.IsAny())
+    PIPSocket::GetHostAddress(ip);
+  signalAddress = H323TransportAddress(ip, listener.GetPort());
+
+  listenThread = PThread::Create(PCREATE_NOTIFIER(ListenMain), 0,
+                                 PThread::NoAutoDeleteThread,
+                                 PThread::NormalPriority,
+                                 "GkRelay Listener");
+
+  PTRACE(3, "GkRelay\tRelaying call signalling on " << signalAddress);
+  return TRUE;
+}
+
+
+void H323SignallingRelay::Close()
+{
+  listener.Close();
+
+  if (listenThread != NULL) {
+    PAssert(listenThread->WaitForTermination(10000), "Relay listener did not terminate");
+    delete listenThread;
+    listenThread = NULL;
+  }
+
+  for (;;) {
+    callsMutex.Wait();
+    if (calls.empty()) {
+      callsMutex.Signal();
+      break;
+    }
+    for (std::set<Call *>::iterator it = calls.begin(); it != calls.end(); ++it)
+      (*it)->Close();
+    callsMutex.Signal();
+
+    callsEnded.Wait(1000);
+  }
+}
+
+
+PINDEX H323SignallingRelay::GetCallCount() const
+{
+  PWaitAndSignal m(callsMutex);
+  return calls.size();
+}
+
+
+PBoolean H323SignallingRelay::OnRouteCall(const Q931 & q931,
+                                          const H225_Setup_UUIE & setup,
+                                          H323TransportAddress & destination)
+{
+  if (setup.HasOptionalField(H225_Setup_UUIE::e_destinationAddress)) {
+    for (PINDEX i = 0; i < setup.m_destinationAddress.GetSize(); i++) {
+      if (gatekeeper.LocateSignalAddress(setup.m_destinationAddress[i], destination))
+        return TRUE;
+    }
+  }
+
+  PString number;
+  if (q931.GetCalledPartyNumber(number)) {
+    H225_AliasAddress alias;
+    H323SetAliasAddress(number, alias, H225_AliasAddress::e_dialedDigits);
+    if (gatekeeper.LocateSignalAddress(alias, destination))
+      return TRUE;
+  }
+
+  if (setup.HasOptionalField(H225_Setup_UUIE::e_destCallSignalAddress)) {
+    destination = H323TransportAddress(setup.m_destCallSignalAddress);
+    if (!destination.IsEquivalent(signalAddress))
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+
+void H323SignallingRelay::ListenMain(PThread &, H323_INT)
+{
+  while (listener.IsOpen()) {
+    PTCPSocket * socket = new PTCPSocket;
+    if (!socket->Accept(listener)) {
+      PTRACE_IF(2, listener.IsOpen(), "GkRelay\tAccept failed: " << socket->GetErrorText());
+      delete socket;
+      if (listener.IsOpen())
+        PThread::Sleep(10);
+      continue;
+    }
+
+    Call * call = new Call(*this, socket);
+
+    callsMutex.Wait();
+    calls.insert(call);
+    totalCalls++;
+    callsMutex.Signal();
+
+    call->Start();
+  }
+}
+
+
+void H323SignallingRelay::OnCallEnded(Call * call)
+{
+  callsMutex.Wait();
+  calls.erase(call);
+  PBoolean last = calls.empty();
+  callsMutex.Signal();
+
+  delete call;
+
+  if (last)
+    callsEnded.Signal();
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,573 @@
+/*
+ * gkroutetable.cxx
+ *
+ * Compiled, memory mapped routing and password tables
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "gkroutetable.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#include "gkroutetable.h"
+
+#include <map>
+#include <string>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define new PNEW
+
+
+/* The compiled file is, in little endian 32 bit words:
+
+     magic "H323RTB1", entry count, header size, strings offset, file size
+     entries: key offset, key length, value offset, value length
+     strings: the keys and values, offsets are from the start of these
+
+   Entries are sorted by the bytes of their keys, a shorter key before a
+   longer one it is a prefix of. */
+static const char    TableMagic[8] = { 'H', '3', '2', '3', 'R', 'T', 'B', '1' };
+static const PINDEX  HeaderSize = 24;
+static const PINDEX  EntrySize = 16;
+
+
+static DWORD GetWord(const BYTE * ptr)
+{
+  return ptr[0] | (ptr[1] << 8) | (ptr[2] << 16) | ((DWORD)ptr[3] << 24);
+}
+
+
+static void PutWord(BYTE * ptr, DWORD value)
+{
+  ptr[0] = (BYTE)value;
+  ptr[1] = (BYTE)(value >> 8);
+  ptr[2] = (BYTE)(value >> 16);
+  ptr[3] = (BYTE)(value >> 24);
+}
+
+
+static int CompareKeys(const char * key1, PINDEX length1, const char * key2, PINDEX length2)
+{
+  int result = memcmp(key1, key2, length1 < length2 ? length1 : length2);
+  if (result != 0)
+    return result;
+  return length1 < length2 ? -1 : (length1 > length2 ? 1 : 0);
+}
+
+
+/* The inode of a file, which a file renamed over it never shares, zero
+   where there is none. */
+static PUInt64 GetFileId(const PFilePath & filename)
+{
+#ifndef _WIN32
+  struct stat info;
+  if (stat(filename, &info) == 0)
+    return (PUInt64)info.st_ino;
+#endif
+  return 0;
+}
+
+
+typedef std::map<std::string, std::string> TableEntries;
+
+static PBoolean WriteTable(const TableEntries & entries, const PFilePath & filename)
+{
+  PINDEX stringsSize = 0;
+  for (TableEntries::const_iterator it = entries.begin(); it != entries.end(); ++it)
+    stringsSize += (PINDEX)(it->first.size() + it->second.size());
+
+  PINDEX stringsOffset = HeaderSize + (PINDEX)entries.size()*EntrySize;
+  PINDEX fileSize = stringsOffset + stringsSize;
+
+  PBYTEArray data(fileSize);
+  BYTE * ptr = data.GetPointer();
+  memcpy(ptr, TableMagic, sizeof(TableMagic));
+  PutWord(ptr+8, (DWORD)entries.size());
+  PutWord(ptr+12, HeaderSize);
+  PutWord(ptr+16, stringsOffset);
+  PutWord(ptr+20, fileSize);
+
+  BYTE * entry = ptr + HeaderSize;
+  BYTE * strings = ptr + stringsOffset;
+  PINDEX offset = 0;
+  for (TableEntries::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+    PutWord(entry, offset);
+    PutWord(entry+4, (DWORD)it->first.size());
+    memcpy(strings+offset, it->first.data(), it->first.size());
+    offset += (PINDEX)it->first.size();
+
+    PutWord(entry+8, offset);
+    PutWord(entry+12, (DWORD)it->second.size());
+    memcpy(strings+offset, it->second.data(), it->second.size());
+    offset += (PINDEX)it->second.size();
+
+    entry += EntrySize;
+  }
+
+  // Written beside the old table and renamed over it, so a table is never
+  // loaded half written
+  PFilePath tmpname = filename + ".tmp";
+  PFile file;
+  if (!file.Open(tmpname, PFile::WriteOnly, PFile::Create|PFile::Truncate) ||
+      !file.Write(data, fileSize) ||
+      !file.Close()) {
+    PTRACE(2, "RouteTable\tCould not write " << tmpname << ": " << file.GetErrorText());
+    PFile::Remove(tmpname);
+    return FALSE;
+  }
+
+  if (!PFile::Rename(tmpname, filename.GetFileName(), TRUE)) {
+    PTRACE(2, "RouteTable\tCould not replace " << filename);
+    PFile::Remove(tmpname);
+    return FALSE;
+  }
+
+  PTRACE(3, "RouteTable\tCompiled " << entries.size() << " entries to " << filename);
+  return TRUE;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323RouteTable::H323RouteTable(const PFilePath & _filename)
+  : filename(_filename),
+    modified(0),
+    fileSize(0),
+    fileId(0),
+    count(0),
+    entries(NULL),
+    strings(NULL),
+    stringsSize(0),
+    mapping(NULL),
+    mappingSize(0),
+#ifdef _WIN32
+    mappingHandle(NULL),
+#endif
+    references(1)
+{
+}
+
+
+H323RouteTable::~H323RouteTable()
+{
+  Unmap();
+}
+
+
+H323RouteTable * H323RouteTable::Load(const PFilePath & filename)
+{
+  H323RouteTable * table = new H323RouteTable(filename);
+  if (table->Open())
+    return table;
+
+  delete table;
+  return NULL;
+}
+
+
+PBoolean H323RouteTable::Compile(const PStringToString & dictionary, const PFilePath & filename)
+{
+  TableEntries entries;
+  for (PINDEX i = 0; i < dictionary.GetSize(); i++) {
+    const PString & key = dictionary.GetKeyAt(i);
+    const PString & value = dictionary.GetDataAt(i);
+    entries[std::string((const char *)key, key.GetLength())] = std::string((const char *)value, value.GetLength());
+  }
+
+  return WriteTable(entries, filename);
+}
+
+
+PBoolean H323RouteTable::Compile(const PFilePath & source, const PFilePath & filename)
+{
+  PTextFile file;
+  if (!file.Open(source, PFile::ReadOnly)) {
+    PTRACE(2, "RouteTable\tCould not open " << source << ": " << file.GetErrorText());
+    return FALSE;
+  }
+
+  TableEntries entries;
+  PString line;
+  while (file.ReadLine(line)) {
+    line = line.Trim();
+    if (line.IsEmpty() || line[0] == '#')
+      continue;
+
+    PINDEX space = line.FindOneOf(" \t");
+    PString key = line.Left(space);
+    PString value = space != P_MAX_INDEX ? line.Mid(space+1).Trim() : PString::Empty();
+    entries[std::string((const char *)key, key.GetLength())] = std::string((const char *)value, value.GetLength());
+  }
+
+  return WriteTable(entries, filename);
+}
+
+
+PBoolean H323RouteTable::Open()
+{
+  PFileInfo info;
+  if (!PFile::GetInfo(filename, info)) {
+    PTRACE(2, "RouteTable\tCould not find " << filename);
+    return FALSE;
+  }
+  modified = info.modified;
+  fileSize = info.size;
+  fileId = GetFileId(filename);
+
+  // Read the whole file if it cannot be mapped
+  const BYTE * file;
+  PINDEX fileSize;
+  if (Map()) {
+    file = (const BYTE *)mapping;
+    fileSize = mappingSize;
+  }
+  else {
+    PFile in;
+    if (!in.Open(filename, PFile::ReadOnly)) {
+      PTRACE(2, "RouteTable\tCould not open " << filename << ": " << in.GetErrorText());
+      return FALSE;
+    }
+    fileSize = (PINDEX)in.GetLength();
+    if (!in.Read(copy.GetPointer(fileSize), fileSize) || in.GetLastReadCount() != fileSize) {
+      PTRACE(2, "RouteTable\tCould not read " << filename);
+      return FALSE;
+    }
+    file = copy;
+  }
+
+  // Only the header is checked, the entries are checked as they are read
+  if (fileSize < HeaderSize || memcmp(file, TableMagic, sizeof(TableMagic)) != 0) {
+    PTRACE(2, "RouteTable\tNot a compiled table: " << filename);
+    return FALSE;
+  }
+
+  DWORD entryCount = GetWord(file+8);
+  DWORD entriesOffset = GetWord(file+12);
+  DWORD stringsOffset = GetWord(file+16);
+  if (GetWord(file+20) != (DWORD)fileSize ||
+      entriesOffset < (DWORD)HeaderSize ||
+      entriesOffset > stringsOffset ||
+      stringsOffset > (DWORD)fileSize ||
+      entryCount > (stringsOffset - entriesOffset)/EntrySize) {
+    PTRACE(2, "RouteTable\tCompiled table truncated or damaged: " << filename);
+    return FALSE;
+  }
+
+  count = (PINDEX)entryCount;
+  entries = file + entriesOffset;
+  strings = file + stringsOffset;
+  stringsSize = fileSize - (PINDEX)stringsOffset;
+
+  PTRACE(3, "RouteTable\tLoaded " << count << " entries from " << filename
+         << (IsMapped() ? ", mapped" : ", read"));
+  return TRUE;
+}
+
+
+PBoolean H323RouteTable::Map()
+{
+#ifdef _WIN32
+  HANDLE handle = CreateFile(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (handle == INVALID_HANDLE_VALUE)
+    return FALSE;
+
+  mappingSize = (PINDEX)GetFileSize(handle, NULL);
+  mappingHandle = CreateFileMapping(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+  CloseHandle(handle);
+  if (mappingHandle == NULL)
+    return FALSE;
+
+  mapping = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+  if (mapping == NULL) {
+    CloseHandle(mappingHandle);
+    mappingHandle = NULL;
+    return FALSE;
+  }
+#else
+  int fd = ::open(filename, O_RDONLY);
+  if (fd < 0)
+    return FALSE;
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size == 0) {
+    ::close(fd);
+    return FALSE;
+  }
+
+  mappingSize = (PINDEX)info.st_size;
+  void * ptr = mmap(NULL, mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (ptr == MAP_FAILED)
+    return FALSE;
+  mapping = ptr;
+#endif
+
+  return TRUE;
+}
+
+
+void H323RouteTable::Unmap()
+{
+  if (mapping == NULL)
+    return;
+
+#ifdef _WIN32
+  UnmapViewOfFile(mapping);
+  CloseHandle(mappingHandle);
+  mappingHandle = NULL;
+#else
+  munmap(mapping, mappingSize);
+#endif
+
+  mapping = NULL;
+  mappingSize = 0;
+}
+
+
+PString H323RouteTable::GetString(PINDEX idx, PINDEX field) const
+{
+  if (idx >= count)
+    return PString::Empty();
+
+  const BYTE * entry = entries + idx*EntrySize + field*8;
+  DWORD offset = GetWord(entry);
+  DWORD length = GetWord(entry+4);
+  if (offset > (DWORD)stringsSize || length > (DWORD)stringsSize - offset)
+    return PString::Empty();
+
+  return PString((const char *)strings + offset, (PINDEX)length);
+}
+
+
+PString H323RouteTable::GetKey(PINDEX idx) const
+{
+  return GetString(idx, 0);
+}
+
+
+PString H323RouteTable::GetValue(PINDEX idx) const
+{
+  return GetString(idx, 1);
+}
+
+
+PINDEX H323RouteTable::Search(const char * key, PINDEX length) const
+{
+  PINDEX low = 0;
+  PINDEX high = count;
+
+  while (low < high) {
+    PINDEX middle = low + (high - low)/2;
+    const BYTE * entry = entries + middle*EntrySize;
+    DWORD offset = GetWord(entry);
+    DWORD entryLength = GetWord(entry+4);
+    if (offset > (DWORD)stringsSize || entryLength > (DWORD)stringsSize - offset)
+      return P_MAX_INDEX;
+
+    int result = CompareKeys(key, length, (const char *)strings + offset, (PINDEX)entryLength);
+    if (result == 0)
+      return middle;
+    if (result < 0)
+      high = middle;
+    else
+      low = middle+1;
+  }
+
+  return P_MAX_INDEX;
+}
+
+
+PBoolean H323RouteTable::Find(const PString & key, PString & value) const
+{
+  PINDEX idx = Search(key, key.GetLength());
+  if (idx == P_MAX_INDEX)
+    return FALSE;
+
+  value = GetValue(idx);
+  return TRUE;
+}
+
+
+PBoolean H323RouteTable::FindLongestPrefix(const PString & key, PString & value) const
+{
+  for (PINDEX length = key.GetLength(); length > 0; length--) {
+    PINDEX idx = Search(key, length);
+    if (idx != P_MAX_INDEX) {
+      value = GetValue(idx);
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323RouteTableFile::H323RouteTableFile()
+  : table(NULL)
+{
+}
+
+
+H323RouteTableFile::~H323RouteTableFile()
+{
+  Close();
+}
+
+
+PBoolean H323RouteTableFile::Open(const PFilePath & newFilename)
+{
+  if (newFilename.IsEmpty()) {
+    Close();
+    return TRUE;
+  }
+
+  // Loaded without the lock, lookups go on with the old table meanwhile
+  H323RouteTable * newTable = H323RouteTable::Load(newFilename);
+  if (newTable == NULL)
+    return FALSE;
+
+  mutex.Wait();
+  H323RouteTable * oldTable = table;
+  table = newTable;
+  filename = newFilename;
+  mutex.Signal();
+
+  Release(oldTable);
+  return TRUE;
+}
+
+
+void H323RouteTableFile::Close()
+{
+  mutex.Wait();
+  H323RouteTable * oldTable = table;
+  table = NULL;
+  filename = PString::Empty();
+  mutex.Signal();
+
+  Release(oldTable);
+}
+
+
+PBoolean H323RouteTableFile::IsOpen() const
+{
+  PWaitAndSignal m(mutex);
+  return table != NULL;
+}
+
+
+PBoolean H323RouteTableFile::Reload()
+{
+  const H323RouteTable * current = Acquire();
+  if (current == NULL)
+    return TRUE;
+
+  PFilePath path = current->GetFilePath();
+  PTime loaded = current->GetModified();
+  PInt64 loadedSize = current->fileSize;
+  PUInt64 loadedId = current->fileId;
+  Release(current);
+
+  // The time is to the second only, so a table compiled twice within one
+  // second is told apart by its size, or by the new inode of the renamed file
+  PFileInfo info;
+  if (!PFile::GetInfo(path, info))
+    return TRUE;
+  if (info.modified == loaded && info.size == loadedSize && GetFileId(path) == loadedId)
+    return TRUE;
+
+  PTRACE(3, "RouteTable\tReloading " << path << ", modified " << info.modified);
+  return Open(path);
+}
+
+
+const H323RouteTable * H323RouteTableFile::Acquire() const
+{
+  PWaitAndSignal m(mutex);
+
+  if (table != NULL)
+    ++table->references;
+  return table;
+}
+
+
+void H323RouteTableFile::Release(const H323RouteTable * table)
+{
+  if (table != NULL && --table->references == 0)
+    delete table;
+}
+
+
+PINDEX H323RouteTableFile::GetSize() const
+{
+  const H323RouteTable * current = Acquire();
+  if (current == NULL)
+    return 0;
+
+  PINDEX size = current->GetSize();
+  Release(current);
+  return size;
+}
+
+
+PBoolean H323RouteTableFile::Find(const PString & key, PString & value) const
+{
+  const H323RouteTable * current = Acquire();
+  if (current == NULL)
+    return FALSE;
+
+  PBoolean found = current->Find(key, value);
+  Release(current);
+  return found;
+}
+
+
+PBoolean H323RouteTableFile::FindLongestPrefix(const PString & key, PString & value) const
+{
+  const H323RouteTable * current = Acquire();
+  if (current == NULL)
+    return FALSE;
+
+  PBoolean found = current->FindLongestPrefix(key, value);
+  Release(current);
+  return found;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
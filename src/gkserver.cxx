@@ -45,6 +45,9 @@
 const char AnswerCallStr[] = "-Answer";
 const char OriginateCallStr[] = "-Originate";
 
+// Where the requestSeqNum of an aligned PER encoded RRQ and RCF is
+static const PINDEX KeepAliveSequenceOffset = 2;
+
 
 #define new PNEW
 
@@ -79,6 +82,58 @@ PBoolean H323GatekeeperRequest::WritePDU(H323TransactionPDU & pdu)
 }
 
 
+H323Transactor::RequestPriority H323GatekeeperRequest::GetPriority() const
+{
+  switch (request->GetChoice().GetTag()) {
+    case H225_RasMessage::e_gatekeeperRequest :
+      return H323Transactor::LowPriority;
+
+    case H225_RasMessage::e_registrationRequest :
+      if (((const H225_RegistrationRequest &)request->GetChoice().GetObject()).m_keepAlive)
+        return H323Transactor::HighPriority;
+      return H323Transactor::NormalPriority;
+  }
+
+  return H323Transactor::UrgentPriority;
+}
+
+
+H323GatekeeperRequest::Response H323GatekeeperRequest::OnOverload()
+{
+  switch (request->GetChoice().GetTag()) {
+    case H225_RasMessage::e_gatekeeperRequest :
+      SetRejectReason(H225_GatekeeperRejectReason::e_resourceUnavailable);
+      return Reject;
+
+    case H225_RasMessage::e_registrationRequest :
+      SetRejectReason(H225_RegistrationRejectReason::e_resourceUnavailable);
+      return Reject;
+
+    case H225_RasMessage::e_admissionRequest :
+      SetRejectReason(H225_AdmissionRejectReason::e_resourceUnavailable);
+      return Reject;
+
+    case H225_RasMessage::e_bandwidthRequest :
+      SetRejectReason(H225_BandRejectReason::e_insufficientResources);
+      return Reject;
+
+    case H225_RasMessage::e_locationRequest :
+      SetRejectReason(H225_LocationRejectReason::e_resourceUnavailable);
+      return Reject;
+  }
+
+  return Ignore;
+}
+
+
+PBoolean H323GatekeeperRequest::CanSendEarlyRIP() const
+{
+  PSafePtr<H323RegisteredEndPoint> ep =
+            rasChannel.GetGatekeeper().FindEndPointByIdentifier(GetEndpointIdentifier(), PSafeReadOnly);
+  return ep != NULL && ep->CanReceiveRIP();
+}
+
+
 PBoolean H323GatekeeperRequest::CheckGatekeeperIdentifier()
 {
   PString pduGkid = GetGatekeeperIdentifier();
@@ -319,6 +374,37 @@ void H323GatekeeperRRQ::SetRejectReason(unsigned reasonCode)
 }
 
 
+PBoolean H323GatekeeperRRQ::WritePDU(H323TransactionPDU & pdu)
+{
+  if (!H323GatekeeperRequest::WritePDU(pdu))
+    return FALSE;
+
+  // Keep the RCF of a keep alive to answer the next ones with
+  if (&pdu == confirm && endpoint != NULL &&
+      rasChannel.GetGatekeeper().GetKeepAliveCacheTime() > 0 &&
+      IsCacheableKeepAlive(rrq) &&
+      !rcf.HasOptionalField(H225_RegistrationConfirm::e_tokens) &&
+      !rcf.HasOptionalField(H225_RegistrationConfirm::e_cryptoTokens)) {
+    H323_PERStream strm;
+    pdu.GetPDU().Encode(strm);
+    strm.CompleteEncoding();
+    endpoint->SetKeepAliveResponse(request->GetRawPDU(), rrq.m_requestSeqNum, requestAddress, strm);
+  }
+
+  return TRUE;
+}
+
+
+PBoolean H323GatekeeperRRQ::IsCacheableKeepAlive(const H225_RegistrationRequest & rrq)
+{
+  // Tokens differ every time and must be checked
+  return rrq.m_keepAlive &&
+         rrq.HasOptionalField(H225_RegistrationRequest::e_endpointIdentifier) &&
+         !rrq.HasOptionalField(H225_RegistrationRequest::e_tokens) &&
+         !rrq.HasOptionalField(H225_RegistrationRequest::e_cryptoTokens);
+}
+
+
 H323GatekeeperRequest::Response H323GatekeeperRRQ::OnHandlePDU()
 {
   H323GatekeeperRequest::Response response = rasChannel.OnRegistration(*this);
@@ -797,6 +883,13 @@ H323GatekeeperCall::~H323GatekeeperCall()
 }
 
 
+void H323GatekeeperCall::SetSearchKey(const OpalGloballyUniqueID & id, Direction dir)
+{
+  callIdentifier = id;
+  direction = dir;
+}
+
+
 PObject::Comparison H323GatekeeperCall::Compare(const PObject & obj) const
 {
   // Do not have to lock the object as these fields should never change for
@@ -1179,7 +1272,7 @@ H323GatekeeperRequest::Response H323GatekeeperCall::OnInfoResponse(H323Gatekeepe
 {
   PTRACE_BLOCK("H323GatekeeperCall::OnInfoResponse");
 
-  PTRACE(2, "RAS\tIRR received for call " << *this);
+  PTRACE(4, "RAS\tIRR received for call " << *this);
 
   if (!LockReadWrite()) {
     PTRACE(1, "RAS\tIRR rejected, lock failed on call " << *this);
@@ -1409,6 +1502,37 @@ PString H323GatekeeperCall::GetDestinationAddress() const
 }
 
 
+void H323GatekeeperCall::GetCallRecord(H323CallRecord & record) const
+{
+  record.Clear();
+
+  if (!LockReadOnly()) {
+    PTRACE(1, "RAS\tGetCallRecord lock failed on call " << *this);
+    return;
+  }
+
+  record.source = H323CallRecord::e_Gatekeeper;
+  record.originating = !IsAnsweringCall();
+  record.endReason = (WORD)callEndReason;
+  memcpy(record.callIdentifier, (const BYTE *)callIdentifier, sizeof(record.callIdentifier));
+  record.setupTime = H323CallRecord::GetTimestamp(callStartTime);
+  record.connectTime = H323CallRecord::GetTimestamp(connectedTime);
+  record.endTime = H323CallRecord::GetTimestamp(callEndTime);
+  if (record.endTime == 0)
+    record.endTime = PTime().GetTimestamp();
+  record.bandwidth = bandwidthUsed;
+
+  H323CallRecord::SetField(record.callingAlias, sizeof(record.callingAlias),
+                           srcNumber.IsEmpty() && !srcAliases.IsEmpty() ? srcAliases[0] : srcNumber);
+  H323CallRecord::SetField(record.calledAlias, sizeof(record.calledAlias),
+                           dstNumber.IsEmpty() && !dstAliases.IsEmpty() ? dstAliases[0] : dstNumber);
+  H323CallRecord::SetField(record.remoteAddress, sizeof(record.remoteAddress),
+                           IsAnsweringCall() ? srcHost : dstHost);
+
+  UnlockReadOnly();
+}
+
+
 void H323GatekeeperCall::SetUsageInfo(const H225_RasUsageInformation & usage)
 {
   PTime now;
@@ -1462,6 +1586,135 @@ PBoolean H323GatekeeperCall::TranslateAliasAddress(
   return gatekeeper.TranslateAliasAddress(alias, aliases, address, gkRouted, this);
 }
 
+/////////////////////////////////////////////////////////////////////////////
+
+H323GatekeeperSnapshot::H323GatekeeperSnapshot()
+  : data(1024),
+    size(0),
+    offset(0)
+{
+}
+
+
+H323GatekeeperSnapshot::H323GatekeeperSnapshot(const PBYTEArray & bytes)
+  : data(bytes),
+    size(bytes.GetSize()),
+    offset(0)
+{
+}
+
+
+void H323GatekeeperSnapshot::WriteUnsigned(DWORD value)
+{
+  BYTE bytes[4];
+  bytes[0] = (BYTE)(value >> 24);
+  bytes[1] = (BYTE)(value >> 16);
+  bytes[2] = (BYTE)(value >> 8);
+  bytes[3] = (BYTE)value;
+  Append(bytes, 4);
+}
+
+
+void H323GatekeeperSnapshot::WriteInt64(PInt64 value)
+{
+  WriteUnsigned((DWORD)(value >> 32));
+  WriteUnsigned((DWORD)value);
+}
+
+
+void H323GatekeeperSnapshot::WriteString(const PString & str)
+{
+  WriteBytes((const BYTE *)(const char *)str, str.GetLength());
+}
+
+
+void H323GatekeeperSnapshot::WriteStrings(const PStringArray & strs)
+{
+  WriteUnsigned(strs.GetSize());
+  for (PINDEX i = 0; i < strs.GetSize(); i++)
+    WriteString(strs[i]);
+}
+
+
+void H323GatekeeperSnapshot::WriteBytes(const BYTE * bytes, PINDEX length)
+{
+  WriteUnsigned(length);
+  Append(bytes, length);
+}
+
+
+void H323GatekeeperSnapshot::Append(const BYTE * bytes, PINDEX length)
+{
+  if (size + length > data.GetSize())
+    data.SetSize((size + length)*2);
+
+  memcpy(data.GetPointer() + size, bytes, length);
+  size += length;
+}
+
+
+PBoolean H323GatekeeperSnapshot::ReadUnsigned(DWORD & value)
+{
+  if (offset + 4 > size)
+    return FALSE;
+
+  const BYTE * ptr = (const BYTE *)data + offset;
+  value = ((DWORD)ptr[0] << 24) | ((DWORD)ptr[1] << 16) | ((DWORD)ptr[2] << 8) | ptr[3];
+  offset += 4;
+  return TRUE;
+}
+
+
+PBoolean H323GatekeeperSnapshot::ReadInt64(PInt64 & value)
+{
+  DWORD high, low;
+  if (!ReadUnsigned(high) || !ReadUnsigned(low))
+    return FALSE;
+
+  value = ((PInt64)high << 32) | low;
+  return TRUE;
+}
+
+
+PBoolean H323GatekeeperSnapshot::ReadString(PString & str)
+{
+  DWORD length;
+  if (!ReadUnsigned(length) || length > (DWORD)(size - offset))
+    return FALSE;
+
+  str = PString((const char *)(const BYTE *)data + offset, length);
+  offset += length;
+  return TRUE;
+}
+
+
+PBoolean H323GatekeeperSnapshot::ReadStrings(PStringArray & strs)
+{
+  DWORD count;
+  if (!ReadUnsigned(count) || count > (DWORD)(size - offset)/4)
+    return FALSE;
+
+  strs.SetSize(count);
+  for (PINDEX i = 0; i < (PINDEX)count; i++) {
+    if (!ReadString(strs[i]))
+      return FALSE;
+  }
+  return TRUE;
+}
+
+
+PBoolean H323GatekeeperSnapshot::ReadBytes(PBYTEArray & bytes)
+{
+  DWORD length;
+  if (!ReadUnsigned(length) || length > (DWORD)(size - offset))
+    return FALSE;
+
+  bytes = PBYTEArray((const BYTE *)data + offset, length);
+  offset += length;
+  return TRUE;
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
 
 H323RegisteredEndPoint::H323RegisteredEndPoint(H323GatekeeperServer & gk,
@@ -1475,7 +1728,9 @@ H323RegisteredEndPoint::H323RegisteredEndPoint(H323GatekeeperServer & gk,
     canEnforceDurationLimit(FALSE),
     h225Version(0),
     timeToLive(0),
-    authenticators(gk.GetOwnerEndPoint().CreateAuthenticators())
+    authenticators(gk.GetOwnerEndPoint().CreateAuthenticators()),
+    authenticatedUntil(0),
+    keepAliveUntil(0)
 {
   activeCalls.DisallowDeleteObjects();
 
@@ -1631,6 +1886,9 @@ H323GatekeeperRequest::Response H323RegisteredEndPoint::OnRegistration(H323Gatek
     return info.CheckCryptoTokens() ? H323GatekeeperRequest::Confirm
                                     : H323GatekeeperRequest::Reject;
 
+  // The RCF may change with a full registration
+  keepAliveUntil = 0;
+
   if (info.rrq.HasOptionalField(H225_RegistrationRequest::e_endpointIdentifier)) {
     // Make sure addresses are a superset of previous registration
     if (!IsTransportAddressSuperset(info.rrq.m_rasAddress, rasAddresses) ||
@@ -1649,8 +1907,11 @@ H323GatekeeperRequest::Response H323RegisteredEndPoint::OnRegistration(H323Gatek
     return response;
 
   // Final check, the H.235 security
-  if (!info.CheckCryptoTokens())
+  if (!info.CheckCryptoTokens()) {
+    // The cached password may be stale, look it up again next time
+    authenticatedUntil = 0;
     return H323GatekeeperRequest::Reject;
+  }
 
   PINDEX i;
 
@@ -1813,12 +2074,27 @@ H323GatekeeperRequest::Response H323RegisteredEndPoint::OnFullRegistration(H323G
 
 H323GatekeeperRequest::Response H323RegisteredEndPoint::OnSecureRegistration(H323GatekeeperRRQ & info)
 {
+  // A repeated RRQ within the cache time uses the password already set, the
+  // tokens are still checked against it before the RCF
+  PInt64 now = PTimer::Tick().GetMilliSeconds();
+  if (authenticatedUntil > now && aliases.GetValuesIndex(authenticatedAlias) != P_MAX_INDEX) {
+    PTRACE(4, "RAS\tUsing cached H.235 security for user " << authenticatedAlias);
+    return H323GatekeeperRequest::Confirm;
+  }
+
+  authenticatedUntil = 0;
+
   for (PINDEX i = 0; i < aliases.GetSize(); i++) {
     PString password;
     if (gatekeeper.GetUsersPassword(aliases[i], password, *this)) {
       PTRACE(3, "RAS\tFound user " << aliases[i] << " for H.235 security.");
       if (!password)
         SetPassword(password, aliases[i]);
+      // Also kept for a snapshot to look the password up again
+      authenticatedAlias = aliases[i];
+      if (gatekeeper.GetAuthenticationCacheTime() > 0) {
+        authenticatedUntil = now + gatekeeper.GetAuthenticationCacheTime().GetMilliSeconds();
+      }
       return H323GatekeeperRequest::Confirm;
     }
   }
@@ -1929,6 +2205,11 @@ H323GatekeeperRequest::Response H323RegisteredEndPoint::OnInfoResponse(H323Gatek
     return H323GatekeeperRequest::Reject;
   }
 
+  PTRACE(4, "RAS\tIRR with " << info.irr.m_perCallInfo.GetSize() << " calls from endpoint " << *this);
+
+  // A batched IRR may report hundreds of calls, so one key is used to search for all of them
+  H323GatekeeperCall search(gatekeeper, OpalGloballyUniqueID(), H323GatekeeperCall::UnknownDirection);
+
   for (PINDEX i = 0; i < info.irr.m_perCallInfo.GetSize(); i++) {
     H225_InfoRequestResponse_perCallInfo_subtype & perCallInfo = info.irr.m_perCallInfo[i];
 
@@ -1942,7 +2223,7 @@ H323GatekeeperRequest::Response H323RegisteredEndPoint::OnInfoResponse(H323Gatek
     else
       callDirection = H323GatekeeperCall::AnsweringCall;
 
-    H323GatekeeperCall search(gatekeeper, perCallInfo.m_callIdentifier.m_guid, callDirection);
+    search.SetSearchKey(perCallInfo.m_callIdentifier.m_guid, callDirection);
 
     PINDEX idx = activeCalls.GetValuesIndex(search);
     if (idx != P_MAX_INDEX) {
@@ -2009,6 +2290,170 @@ PBoolean H323RegisteredEndPoint::OnTimeToLive()
   return response;
 }
 
+
+static PBoolean HasKeepAliveSequence(const PBYTEArray & pdu, unsigned seqNum)
+{
+  // The constrained 1..65535 integer is encoded as two bytes of seqNum-1
+  return pdu.GetSize() > KeepAliveSequenceOffset+1 &&
+         pdu[KeepAliveSequenceOffset] == (BYTE)((seqNum-1) >> 8) &&
+         pdu[KeepAliveSequenceOffset+1] == (BYTE)(seqNum-1);
+}
+
+
+void H323RegisteredEndPoint::SetKeepAliveResponse(const PBYTEArray & rrq,
+                                                  unsigned seqNum,
+                                                  const H323TransportAddress & address,
+                                                  const PBYTEArray & rcf)
+{
+  if (!LockReadWrite())
+    return;
+
+  // Only kept if the sequence number is where it is replaced
+  if (HasKeepAliveSequence(rrq, seqNum) && HasKeepAliveSequence(rcf, seqNum)) {
+    keepAliveRequest = PBYTEArray((const BYTE *)rrq, rrq.GetSize());
+    keepAliveAddress = address;
+    keepAliveResponse = PBYTEArray((const BYTE *)rcf, rcf.GetSize());
+    keepAliveUntil = PTimer::Tick().GetMilliSeconds() + gatekeeper.GetKeepAliveCacheTime().GetMilliSeconds();
+  }
+  else
+    keepAliveUntil = 0;
+
+  UnlockReadWrite();
+}
+
+
+PBoolean H323RegisteredEndPoint::GetKeepAliveResponse(H323GatekeeperListener & listener,
+                                                  const PBYTEArray & rrq,
+                                                  const H323TransportAddress & address,
+                                                  PBYTEArray & rcf)
+{
+  if (!LockReadWrite())
+    return FALSE;
+
+  PINDEX size = rrq.GetSize();
+  PBoolean found = keepAliveUntil > PTimer::Tick().GetMilliSeconds() &&
+                   address == keepAliveAddress &&
+                   size == keepAliveRequest.GetSize() &&
+                   memcmp((const BYTE *)rrq, (const BYTE *)keepAliveRequest, KeepAliveSequenceOffset) == 0 &&
+                   memcmp((const BYTE *)rrq + KeepAliveSequenceOffset+2,
+                          (const BYTE *)keepAliveRequest + KeepAliveSequenceOffset+2,
+                          size - KeepAliveSequenceOffset-2) == 0;
+  if (found) {
+    rasChannel = &listener;
+    lastRegistration = PTime();
+
+    rcf = PBYTEArray((const BYTE *)keepAliveResponse, keepAliveResponse.GetSize());
+    rcf[KeepAliveSequenceOffset] = rrq[KeepAliveSequenceOffset];
+    rcf[KeepAliveSequenceOffset+1] = rrq[KeepAliveSequenceOffset+1];
+  }
+
+  UnlockReadWrite();
+  return found;
+}
+
+
+PTimeInterval H323RegisteredEndPoint::GetTimeToLiveRemaining() const
+{
+  if (timeToLive == 0)
+    return PTimeInterval(0, 60);
+
+  // Same margin as CheckTimeSince()
+  PTime last = lastRegistration > lastInfoResponse ? lastRegistration : lastInfoResponse;
+  PTimeInterval remaining = PTimeInterval(0, timeToLive+10) - (PTime() - last);
+  return remaining > 0 ? remaining : PTimeInterval(0);
+}
+
+
+static void WriteSnapshotAddresses(H323GatekeeperSnapshot & snapshot, const H323TransportAddressArray & addresses)
+{
+  snapshot.WriteUnsigned(addresses.GetSize());
+  for (PINDEX i = 0; i < addresses.GetSize(); i++)
+    snapshot.WriteString(addresses[i]);
+}
+
+
+static PBoolean ReadSnapshotAddresses(H323GatekeeperSnapshot & snapshot, H323TransportAddressArray & addresses)
+{
+  PStringArray strs;
+  if (!snapshot.ReadStrings(strs))
+    return FALSE;
+
+  addresses.RemoveAll();
+  for (PINDEX i = 0; i < strs.GetSize(); i++)
+    addresses.AppendAddress(H323TransportAddress(strs[i]));
+  return TRUE;
+}
+
+
+void H323RegisteredEndPoint::OnSaveSnapshot(H323GatekeeperSnapshot & snapshot) const
+{
+  snapshot.WriteStrings(aliases);
+  snapshot.WriteStrings(voicePrefixes);
+  WriteSnapshotAddresses(snapshot, rasAddresses);
+  WriteSnapshotAddresses(snapshot, signalAddresses);
+  snapshot.WriteString(applicationInfo);
+  snapshot.WriteUnsigned(protocolVersion);
+  snapshot.WriteUnsigned(h225Version);
+  snapshot.WriteUnsigned(timeToLive);
+  snapshot.WriteUnsigned((isBehindNAT ? 1 : 0) |
+                         (canDisplayAmountString ? 2 : 0) |
+                         (canEnforceDurationLimit ? 4 : 0));
+  snapshot.WriteString(authenticatedAlias);
+}
+
+
+PBoolean H323RegisteredEndPoint::OnLoadSnapshot(H323GatekeeperSnapshot & snapshot,
+                                                const PTimeInterval & age,
+                                                H323GatekeeperListener * listener)
+{
+  PString info;
+  DWORD version, h225, ttl, flags;
+  if (!snapshot.ReadStrings(aliases) ||
+      !snapshot.ReadStrings(voicePrefixes) ||
+      !ReadSnapshotAddresses(snapshot, rasAddresses) ||
+      !ReadSnapshotAddresses(snapshot, signalAddresses) ||
+      !snapshot.ReadString(info) ||
+      !snapshot.ReadUnsigned(version) ||
+      !snapshot.ReadUnsigned(h225) ||
+      !snapshot.ReadUnsigned(ttl) ||
+      !snapshot.ReadUnsigned(flags) ||
+      !snapshot.ReadString(authenticatedAlias)) {
+    PTRACE(2, "RAS\tSnapshot record of endpoint " << identifier << " is damaged");
+    return FALSE;
+  }
+
+  applicationInfo = info;
+  protocolVersion = version;
+  h225Version = h225;
+  timeToLive = ttl;
+  isBehindNAT = (flags & 1) != 0;
+  canDisplayAmountString = (flags & 2) != 0;
+  canEnforceDurationLimit = (flags & 4) != 0;
+
+  if (timeToLive > 0 && age >= PTimeInterval(0, timeToLive)) {
+    PTRACE(3, "RAS\tSnapshot of endpoint " << identifier << " is older than its time to live");
+    return FALSE;
+  }
+
+  if (!authenticatedAlias) {
+    PString password;
+    if (gatekeeper.GetUsersPassword(authenticatedAlias, password, *this)) {
+      if (!password)
+        SetPassword(password, authenticatedAlias);
+    }
+    else if (gatekeeper.IsRequiredH235()) {
+      PTRACE(2, "RAS\tNo password for user " << authenticatedAlias << " of restored endpoint " << identifier);
+      return FALSE;
+    }
+  }
+
+  rasChannel = listener;
+  lastRegistration = PTime();
+
+  PTRACE(3, "RAS\tRestored registered endpoint " << identifier << " from snapshot");
+  return TRUE;
+}
+
 #ifdef H323_H248
 
 PString H323RegisteredEndPoint::GetCallCreditAmount() const
@@ -2160,8 +2605,7 @@ PBoolean H323GatekeeperListener::OnReceiveGatekeeperRequest(const H323RasPDU & p
   PTRACE_BLOCK("H323GatekeeperListener::OnReceiveGatekeeperRequest");
 
   H323GatekeeperGRQ * info = new H323GatekeeperGRQ(*this, pdu);
-  if (!info->HandlePDU())
-    delete info;
+  HandleRequest(info);
 
   return FALSE;
 }
@@ -2205,13 +2649,24 @@ H323GatekeeperRequest::Response H323GatekeeperListener::OnRegistration(H323Gatek
 
 
 PBoolean H323GatekeeperListener::OnReceiveRegistrationRequest(const H323RasPDU & pdu,
-                                                          const H225_RegistrationRequest & /*rrq*/)
+                                                          const H225_RegistrationRequest & rrq)
 {
   PTRACE_BLOCK("H323GatekeeperListener::OnReceiveRegistrationRequest");
 
+  // A keep alive the same as the last one is answered with the same RCF
+  if (gatekeeper.GetKeepAliveCacheTime() > 0 && H323GatekeeperRRQ::IsCacheableKeepAlive(rrq)) {
+    PSafePtr<H323RegisteredEndPoint> ep = gatekeeper.FindEndPointByIdentifier(rrq.m_endpointIdentifier);
+    H323TransportAddress address = transport->GetLastReceivedAddress();
+    PBYTEArray rcf;
+    if (ep != NULL && ep->GetKeepAliveResponse(*this, pdu.GetRawPDU(), address, rcf)) {
+      PTRACE(4, "RAS\tRRQ keep alive from " << *ep << " answered with cached RCF");
+      WriteResponse(rcf, rrq.m_requestSeqNum, ep->GetRASAddresses(), address);
+      return FALSE;
+    }
+  }
+
   H323GatekeeperRRQ * info = new H323GatekeeperRRQ(*this, pdu);
-  if (!info->HandlePDU())
-    delete info;
+  HandleRequest(info);
 
   return FALSE;
 }
@@ -2242,8 +2697,7 @@ PBoolean H323GatekeeperListener::OnReceiveUnregistrationRequest(const H323RasPDU
   PTRACE_BLOCK("H323GatekeeperListener::OnReceiveUnregistrationRequest");
 
   H323GatekeeperURQ * info = new H323GatekeeperURQ(*this, pdu);
-  if (!info->HandlePDU())
-    delete info;
+  HandleRequest(info);
 
   return FALSE;
 }
@@ -2318,8 +2772,7 @@ PBoolean H323GatekeeperListener::OnReceiveAdmissionRequest(const H323RasPDU & pd
   PTRACE_BLOCK("H323GatekeeperListener::OnReceiveAdmissionRequest");
 
   H323GatekeeperARQ * info = new H323GatekeeperARQ(*this, pdu);
-  if (!info->HandlePDU())
-    delete info;
+  HandleRequest(info);
 
   return FALSE;
 }
@@ -2402,8 +2855,7 @@ PBoolean H323GatekeeperListener::OnReceiveDisengageRequest(const H323RasPDU & pd
   PTRACE_BLOCK("H323GatekeeperListener::OnReceiveDisengageRequest");
 
   H323GatekeeperDRQ * info = new H323GatekeeperDRQ(*this, pdu);
-  if (!info->HandlePDU())
-    delete info;
+  HandleRequest(info);
 
   return FALSE;
 }
@@ -2454,8 +2906,7 @@ PBoolean H323GatekeeperListener::OnReceiveBandwidthRequest(const H323RasPDU & pd
   PTRACE_BLOCK("H323GatekeeperListener::OnReceiveBandwidthRequest");
 
   H323GatekeeperBRQ * info = new H323GatekeeperBRQ(*this, pdu);
-  if (!info->HandlePDU())
-    delete info;
+  HandleRequest(info);
 
   return FALSE;
 }
@@ -2509,8 +2960,7 @@ PBoolean H323GatekeeperListener::OnReceiveLocationRequest(const H323RasPDU & pdu
   PTRACE_BLOCK("H323GatekeeperListener::OnReceiveLocationRequest");
 
   H323GatekeeperLRQ * info = new H323GatekeeperLRQ(*this, pdu);
-  if (!info->HandlePDU())
-    delete info;
+  HandleRequest(info);
 
   return FALSE;
 }
@@ -2541,6 +2991,36 @@ PBoolean H323GatekeeperListener::InfoRequest(H323RegisteredEndPoint & ep,
   return MakeRequest(request);
 }
 
+
+H323Transactor::Request * H323GatekeeperListener::StartLocationRequest(H323RasPDU & pdu,
+                                                                      const H323TransportAddress & neighbour,
+                                                                      const H225_AliasAddress & alias,
+                                                                      H323TransportAddress & located,
+                                                                      const PNotifier & completed)
+{
+  PTRACE(3, "RAS\tLocation request for " << H323GetAliasAddressString(alias) << " to neighbour " << neighbour);
+
+  H225_LocationRequest & lrq = pdu.BuildLocationRequest(GetNextSequenceNumber());
+
+  lrq.m_destinationInfo.SetSize(1);
+  lrq.m_destinationInfo[0] = alias;
+
+  transport->SetUpTransportPDU(lrq.m_replyAddress, TRUE);
+
+  if (!gatekeeperIdentifier) {
+    lrq.IncludeOptionalField(H225_LocationRequest::e_gatekeeperIdentifier);
+    lrq.m_gatekeeperIdentifier = gatekeeperIdentifier;
+  }
+
+  Request * request = new Request(lrq.m_requestSeqNum, pdu, neighbour);
+  request->responseInfo = &located;
+  if (StartRequest(*request, completed))
+    return request;
+
+  delete request;
+  return NULL;
+}
+
 #ifdef H323_H248
 
 PBoolean H323GatekeeperListener::ServiceControlIndication(H323RegisteredEndPoint & ep,
@@ -2606,8 +3086,7 @@ PBoolean H323GatekeeperListener::OnReceiveInfoRequestResponse(const H323RasPDU &
 
   info->irr.m_unsolicited = unsolicited;
 
-  if (!info->HandlePDU())
-    delete info;
+  HandleRequest(info);
 
   return !unsolicited;
 }
@@ -2635,57 +3114,256 @@ void H323GatekeeperListener::OnReceiveFeatureSet(unsigned pduType, const H225_Fe
 
 /////////////////////////////////////////////////////////////////////////////
 
-H323GatekeeperServer::H323GatekeeperServer(H323EndPoint & ep)
-  : H323TransactionServer(ep)
-{
-  totalBandwidth = UINT_MAX;      // Unlimited total bandwidth
-  usedBandwidth = 0;              // None used so far
-  defaultBandwidth = 2560;        // Enough for bidirectional G.711 and 64k H.261
-  maximumBandwidth = 200000;      // 10baseX LAN bandwidth
-  defaultTimeToLive = 3600;       // One hour, zero disables
-  defaultInfoResponseRate = 60;   // One minute, zero disables
-  overwriteOnSameSignalAddress = TRUE;
-  canHaveDuplicateAlias = FALSE;
-  canHaveDuplicatePrefix = FALSE;
-  canOnlyCallRegisteredEP = FALSE;
-  canOnlyAnswerRegisteredEP = FALSE;
-  answerCallPreGrantedARQ = FALSE;
-  makeCallPreGrantedARQ = FALSE;
-  isGatekeeperRouted = FALSE;
-  aliasCanBeHostName = TRUE;
-  requireH235 = FALSE;
-  disengageOnHearbeatFail = TRUE;
-
-  identifierBase = time(NULL);
-  nextIdentifier = 1;
+/////////////////////////////////////////////////////////////////////////////
 
-  peakRegistrations = 0;
-  totalRegistrations = 0;
-  rejectedRegistrations = 0;
-  peakCalls = 0;
-  totalCalls = 0;
-  rejectedCalls = 0;
+H323GatekeeperNeighbourQuery::H323GatekeeperNeighbourQuery(H323GatekeeperServer & svr,
+                                                           const H225_AliasAddress & searchAlias)
+  : server(svr),
+    alias(searchAlias),
+    peerElement(NULL),
+    outstanding(0),
+    peerPending(FALSE),
+    references(1),
+    found(FALSE)
+{
+}
 
-  monitorThread = PThread::Create(PCREATE_NOTIFIER(MonitorMain), 0,
-                                  PThread::NoAutoDeleteThread,
-                                  PThread::NormalPriority,
-                                  "GkSrv Monitor");
 
-#ifdef H323_H501
-  peerElement = NULL;
-#endif
+H323GatekeeperNeighbourQuery::~H323GatekeeperNeighbourQuery()
+{
+  for (size_t i = 0; i < neighbours.size(); i++) {
+    delete neighbours[i]->request;
+    delete neighbours[i];
+  }
 }
 
 
-H323GatekeeperServer::~H323GatekeeperServer()
+PBoolean H323GatekeeperNeighbourQuery::Run(H323GatekeeperListener * listener,
+                                           const H323TransportAddressArray & neighbourAddresses,
+                                           H323PeerElement * pe,
+                                           const PTimeInterval & timeout)
 {
-  monitorExit.Signal();
-  PAssert(monitorThread->WaitForTermination(10000), "Gatekeeper monitor thread did not terminate!");
-  delete monitorThread;
+  PTimeInterval start = PTimer::Tick();
 
-#ifdef H323_H501
-  delete peerElement;
-#endif
+  mutex.Wait();
+
+  // Held while sending so no answer is handled before its request is recorded
+  if (listener != NULL) {
+    for (PINDEX i = 0; i < neighbourAddresses.GetSize(); i++) {
+      Neighbour * neighbour = new Neighbour;
+      neighbour->completed = FALSE;
+      neighbour->request = listener->StartLocationRequest(neighbour->pdu, neighbourAddresses[i], alias,
+                                                          neighbour->located, PCREATE_NOTIFIER(OnLocationCompleted));
+      if (neighbour->request == NULL) {
+        delete neighbour;
+        continue;
+      }
+      neighbours.push_back(neighbour);
+      outstanding++;
+    }
+  }
+
+#ifdef H323_H501
+  if (pe != NULL) {
+    peerElement = pe;
+    peerPending = TRUE;
+    references++;
+    {
+      PWaitAndSignal m(server.neighbourMutex);
+      server.neighbourPeerQueries++;
+    }
+    PThread::Create(PCREATE_NOTIFIER(PeerElementMain), 0,
+                    PThread::AutoDeleteThread,
+                    PThread::NormalPriority,
+                    "GkNeighbour:%x");
+  }
+#endif
+
+  // Wait for the first answer, or every query to fail
+  while (!found && (outstanding > 0 || peerPending)) {
+    PTimeInterval left = timeout - (PTimer::Tick() - start);
+    if (left <= 0)
+      break;
+    mutex.Signal();
+    answered.Wait(left);
+    mutex.Wait();
+  }
+
+  for (size_t i = 0; i < neighbours.size(); i++) {
+    if (!neighbours[i]->completed)
+      listener->CancelLocationRequest(*neighbours[i]->request);
+  }
+
+  PBoolean located = found;
+
+  // Cancelled requests still complete, and must before they are deleted
+  while (outstanding > 0) {
+    mutex.Signal();
+    answered.Wait();
+    mutex.Wait();
+  }
+
+  mutex.Signal();
+
+  PTRACE(3, "RAS\tNeighbour query for " << H323GetAliasAddressString(alias) << ' '
+         << (located ? "located at " + address.AsString() : PString("failed")));
+  return located;
+}
+
+
+void H323GatekeeperNeighbourQuery::Release()
+{
+  mutex.Wait();
+  PBoolean last = --references == 0;
+  mutex.Signal();
+
+  if (last)
+    delete this;
+}
+
+
+void H323GatekeeperNeighbourQuery::OnLocationCompleted(PObject & obj, H323_INT ok)
+{
+  PWaitAndSignal m(mutex);
+
+  for (size_t i = 0; i < neighbours.size(); i++) {
+    Neighbour & neighbour = *neighbours[i];
+    if (neighbour.request != &obj)
+      continue;
+
+    neighbour.completed = TRUE;
+    outstanding--;
+
+    if (ok && !found) {
+      found = TRUE;
+      address = neighbour.located;
+      aliases.SetSize(1);
+      aliases[0] = alias;
+      PTRACE(4, "RAS\tNeighbour answered first for " << H323GetAliasAddressString(alias));
+    }
+    break;
+  }
+
+  answered.Signal();
+}
+
+
+#ifdef H323_H501
+
+void H323GatekeeperNeighbourQuery::PeerElementMain(PThread &, H323_INT)
+{
+  H225_ArrayOf_AliasAddress peerAliases;
+  H225_AliasAddress transportAlias;
+  PBoolean ok = peerElement->AccessRequest(alias, peerAliases, transportAlias);
+
+  mutex.Wait();
+  peerPending = FALSE;
+  if (ok && !found) {
+    found = TRUE;
+    // if AccessRequest returns OK, but no aliases, then all of the aliases
+    // must have been wildcards. In this case, add the original aliase back into the list
+    if (peerAliases.GetSize() == 0) {
+      PTRACE(1, "RAS\tAdding original alias to the top of the alias list");
+      peerAliases.SetSize(1);
+      peerAliases[0] = alias;
+    }
+    aliases = peerAliases;
+    address = H323GetAliasAddressString(transportAlias);
+    PTRACE(4, "RAS\tPeer element answered first for " << H323GetAliasAddressString(alias));
+  }
+  answered.Signal();
+  mutex.Signal();
+
+  {
+    PWaitAndSignal m(server.neighbourMutex);
+    server.neighbourPeerQueries--;
+  }
+
+  Release();
+}
+
+#endif // H323_H501
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323GatekeeperServer::H323GatekeeperServer(H323EndPoint & ep)
+  : H323TransactionServer(ep),
+    mutex("H323GatekeeperServer::mutex")
+{
+  totalBandwidth = UINT_MAX;      // Unlimited total bandwidth
+  usedBandwidth = 0;              // None used so far
+  defaultBandwidth = 2560;        // Enough for bidirectional G.711 and 64k H.261
+  maximumBandwidth = 200000;      // 10baseX LAN bandwidth
+  defaultTimeToLive = 3600;       // One hour, zero disables
+  defaultInfoResponseRate = 60;   // One minute, zero disables
+  overwriteOnSameSignalAddress = TRUE;
+  canHaveDuplicateAlias = FALSE;
+  canHaveDuplicatePrefix = FALSE;
+  canOnlyCallRegisteredEP = FALSE;
+  canOnlyAnswerRegisteredEP = FALSE;
+  answerCallPreGrantedARQ = FALSE;
+  makeCallPreGrantedARQ = FALSE;
+  isGatekeeperRouted = FALSE;
+  aliasCanBeHostName = TRUE;
+  requireH235 = FALSE;
+  disengageOnHearbeatFail = TRUE;
+  authenticationCacheTime = 0;  // Disabled unless set
+  keepAliveCacheTime = PTimeInterval(0, 0, 5);       // Five minutes, zero disables
+  neighbourNegativeCacheTime = PTimeInterval(0, 10);  // Ten seconds, zero disables
+  neighbourPeerQueries = 0;
+  registrationStore = NULL;
+  signallingRelay = NULL;
+  nextSnapshot = 0;
+  snapshotChanges = 0;
+
+  identifierBase = time(NULL);
+  nextIdentifier = 1;
+
+  peakRegistrations = 0;
+  totalRegistrations = 0;
+  rejectedRegistrations = 0;
+  peakCalls = 0;
+  totalCalls = 0;
+  rejectedCalls = 0;
+
+  monitorThread = PThread::Create(PCREATE_NOTIFIER(MonitorMain), 0,
+                                  PThread::NoAutoDeleteThread,
+                                  PThread::NormalPriority,
+                                  "GkSrv Monitor");
+
+#ifdef H323_H501
+  peerElement = NULL;
+#endif
+}
+
+
+H323GatekeeperServer::~H323GatekeeperServer()
+{
+  monitorExit.Signal();
+  PAssert(monitorThread->WaitForTermination(10000), "Gatekeeper monitor thread did not terminate!");
+  delete monitorThread;
+
+  if (!snapshotFile.IsEmpty())
+    SaveRegistrations(snapshotFile);
+
+  delete signallingRelay;
+
+#ifdef H323_H501
+  // Neighbour queries still waiting on the peer element must finish first
+  for (;;) {
+    neighbourMutex.Wait();
+    PINDEX running = neighbourPeerQueries;
+    neighbourMutex.Signal();
+    if (running == 0)
+      break;
+    PThread::Sleep(100);
+  }
+
+  delete peerElement;
+#endif
+
+  delete registrationStore;
 }
 
 
@@ -2741,6 +3419,24 @@ H323GatekeeperRequest::Response H323GatekeeperServer::OnRegistration(H323Gatekee
     info.rcf.m_preGrantedARQ.m_irrFrequencyInCall = defaultInfoResponseRate;
   }
 
+  // The other nodes of a cluster, least loaded first, take over on failure
+  if (registrationStore != NULL) {
+    std::vector<H323RegistrationStore::Node> nodes;
+    registrationStore->GetNodes(nodes);
+    if (!nodes.empty()) {
+      info.rcf.IncludeOptionalField(H225_RegistrationConfirm::e_alternateGatekeeper);
+      info.rcf.m_alternateGatekeeper.SetSize(nodes.size());
+      for (i = 0; i < (PINDEX)nodes.size(); i++) {
+        H225_AlternateGK & alternate = info.rcf.m_alternateGatekeeper[i];
+        nodes[i].rasAddress.SetPDU(alternate.m_rasAddress);
+        alternate.IncludeOptionalField(H225_AlternateGK::e_gatekeeperIdentifier);
+        alternate.m_gatekeeperIdentifier = gatekeeperIdentifier;
+        alternate.m_needToRegister = TRUE;
+        alternate.m_priority = i < 127 ? i : 127;
+      }
+    }
+  }
+
   if (info.rrq.m_keepAlive) {
     if (info.endpoint != NULL)
       return info.endpoint->OnRegistration(info);
@@ -2880,6 +3576,7 @@ H323GatekeeperRequest::Response H323GatekeeperServer::OnUnregistration(H323Gatek
 
     // if no aliases left, then remove the endpoint
     if (info.endpoint->GetAliasCount() > 0) {
+      PublishRegistration(*info.endpoint);
 #ifdef H323_H501
       if (peerElement != NULL)
         peerElement->AddDescriptor(info.endpoint->GetDescriptorID(),
@@ -2912,7 +3609,7 @@ void H323GatekeeperServer::AddEndPoint(H323RegisteredEndPoint * ep)
 
   PINDEX i;
 
-  mutex.Wait();
+  indexMutex.StartWrite();
 
   if (byIdentifier.FindWithLock(ep->GetIdentifier(), PSafeReference) != ep) {
     byIdentifier.SetAt(ep->GetIdentifier(), ep);
@@ -2920,59 +3617,173 @@ void H323GatekeeperServer::AddEndPoint(H323RegisteredEndPoint * ep)
     if (byIdentifier.GetSize() > peakRegistrations)
       peakRegistrations = byIdentifier.GetSize();
     totalRegistrations++;
+
+    ownerEndPoint.GetMetrics().gkRegistrationsTotal.Add();
+    ownerEndPoint.GetMetrics().gkRegistrations.Set(byIdentifier.GetSize());
   }
 
-  for (i = 0; i < ep->GetSignalAddressCount(); i++)
-    byAddress.Append(new StringMap(ep->GetSignalAddress(i), ep->GetIdentifier()));
+  // A repeated full registration replaces everything indexed before
+  const PString & identifier = ep->GetIdentifier();
+  RemoveRegistrationKeys(identifier);
+  RegistrationKeys & keys = byRegistration[identifier];
 
-  for (i = 0; i < ep->GetAliasCount(); i++) {
-    PString alias = ep->GetAlias(i);
-    byAlias.Append(new StringMap(ep->GetAlias(i), ep->GetIdentifier()));
+  for (i = 0; i < ep->GetSignalAddressCount(); i++) {
+    // Only numeric addresses have a key, an endpoint registers no others
+    H323TransportAddressKey key = ep->GetSignalAddress(i).GetKey();
+    if (key.IsValid())
+      keys.addresses.push_back(byAddress.insert(AddressMap::value_type(key, identifier)));
   }
 
-  for (i = 0; i < ep->GetPrefixCount(); i++)
-    byVoicePrefix.Append(new StringMap(ep->GetPrefix(i), ep->GetIdentifier()));
+  for (i = 0; i < ep->GetAliasCount(); i++)
+    keys.aliases.push_back(byAlias.insert(IdentifierMap::value_type(ep->GetAlias(i), identifier)));
 
-  mutex.Signal();
+  for (i = 0; i < ep->GetPrefixCount(); i++) {
+    PString prefix = ep->GetPrefix(i);
+    AddVoicePrefix(prefix, identifier);
+    keys.prefixes.push_back(prefix);
+  }
+
+  indexMutex.EndWrite();
+
+  ScheduleTimeToLive(identifier, ep->GetAliasCount() > 0 ? ep->GetTimeToLiveRemaining() : PTimeInterval(0));
+
+  PublishRegistration(*ep);
+
+  snapshotMutex.Wait();
+  snapshotChanges++;
+  snapshotMutex.Signal();
 }
 
 
-PBoolean H323GatekeeperServer::RemoveEndPoint(H323RegisteredEndPoint * ep)
+void H323GatekeeperServer::PublishRegistration(H323RegisteredEndPoint & ep)
 {
-  PTRACE(3, "RAS\tRemoving registered endpoint: " << *ep);
+  if (registrationStore == NULL)
+    return;
 
-  // clear all calls in the endpoint
-  while (ep->GetCallCount() > 0)
-    RemoveCall(&ep->GetCall(0));
+  H323RegistrationStore::Registration registration;
+  registration.identifier = ep.GetIdentifier();
+  registration.aliases = ep.GetAliases();
+  registration.aliases.MakeUnique();
+  for (PINDEX i = 0; i < ep.GetPrefixCount(); i++)
+    registration.prefixes.AppendString(ep.GetPrefix(i));
+  registration.signalAddresses = ep.GetSignalAddresses();
+  registration.signalAddresses.MakeUnique();
+  registration.rasAddresses = ep.GetRASAddresses();
+  registration.rasAddresses.MakeUnique();
+  registrationStore->Publish(registration);
+}
 
-  // remove any aliases from the endpoint
-  while (ep->GetAliasCount() > 0)
-    ep->RemoveAlias(ep->GetAlias(0));
 
-  PWaitAndSignal wait(mutex);
+void H323GatekeeperServer::SetRegistrationStore(H323RegistrationStore * store)
+{
+  delete registrationStore;
+  registrationStore = store;
+}
 
-  PINDEX i;
 
-  // remove prefixes belonging to this endpoint
-  for (i = 0; i < byVoicePrefix.GetSize(); i++) {
-    StringMap & prefixMap = (StringMap &)*byVoicePrefix.GetAt(i);
-    if (prefixMap.identifier == ep->GetIdentifier())
-      byVoicePrefix.RemoveAt(i);
+void H323GatekeeperServer::SetSignallingRelay(H323SignallingRelay * relay)
+{
+  delete signallingRelay;
+  signallingRelay = relay;
+  isGatekeeperRouted = relay != NULL;
+}
+
+
+void H323GatekeeperServer::ScheduleTimeToLive(const PString & identifier, const PTimeInterval & delay)
+{
+  PInt64 due = (PTimer::Tick() + delay).GetMilliSeconds();
+
+  PWaitAndSignal wait(timeToLiveMutex);
+  timeToLiveSlots[identifier] = due;
+  timeToLiveSchedule.insert(std::multimap<PInt64, PString>::value_type(due, identifier));
+}
+
+
+H323GatekeeperServer::VoicePrefixNode::~VoicePrefixNode()
+{
+  for (std::map<char, VoicePrefixNode *>::iterator it = children.begin(); it != children.end(); ++it)
+    delete it->second;
+}
+
+
+void H323GatekeeperServer::AddVoicePrefix(const PString & prefix, const PString & identifier)
+{
+  VoicePrefixNode * node = &byVoicePrefix;
+  for (PINDEX i = 0; i < prefix.GetLength(); i++) {
+    VoicePrefixNode * & child = node->children[prefix[i]];
+    if (child == NULL)
+      child = new VoicePrefixNode;
+    node = child;
   }
 
-  // remove aliases belonging to this endpoint
-  for (i = 0; i < byAlias.GetSize(); i++) {
-    StringMap & aliasMap = (StringMap &)*byAlias.GetAt(i);
-    if (aliasMap.identifier == ep->GetIdentifier())
-      byAlias.RemoveAt(i);
+  node->identifiers.push_back(identifier);
+}
+
+
+void H323GatekeeperServer::RemoveVoicePrefix(const PString & prefix, const PString & identifier)
+{
+  std::vector<VoicePrefixNode *> path;
+  path.reserve(prefix.GetLength() + 1);
+
+  VoicePrefixNode * node = &byVoicePrefix;
+  path.push_back(node);
+  for (PINDEX i = 0; i < prefix.GetLength(); i++) {
+    std::map<char, VoicePrefixNode *>::iterator child = node->children.find(prefix[i]);
+    if (child == node->children.end())
+      return;
+    node = child->second;
+    path.push_back(node);
   }
 
-  // remove call signalling addresses
-  for (i = 0; i < byAddress.GetSize(); i++) {
-    StringMap & aliasMap = (StringMap &)*byAddress.GetAt(i);
-    if (aliasMap.identifier == ep->GetIdentifier())
-      byAddress.RemoveAt(i);
+  std::list<PString>::iterator it = std::find(node->identifiers.begin(), node->identifiers.end(), identifier);
+  if (it == node->identifiers.end())
+    return;
+  node->identifiers.erase(it);
+
+  // Prune the branch back to the last node still in use
+  for (PINDEX i = prefix.GetLength(); i > 0; i--) {
+    node = path[i];
+    if (!node->identifiers.empty() || !node->children.empty())
+      break;
+    path[i-1]->children.erase(prefix[i-1]);
+    delete node;
   }
+}
+
+
+void H323GatekeeperServer::RemoveRegistrationKeys(const PString & identifier)
+{
+  std::map<PString, RegistrationKeys>::iterator reg = byRegistration.find(identifier);
+  if (reg == byRegistration.end())
+    return;
+
+  RegistrationKeys & keys = reg->second;
+  size_t i;
+
+  for (i = 0; i < keys.addresses.size(); i++)
+    byAddress.erase(keys.addresses[i]);
+
+  for (i = 0; i < keys.aliases.size(); i++)
+    byAlias.erase(keys.aliases[i]);
+
+  for (i = 0; i < keys.prefixes.size(); i++)
+    RemoveVoicePrefix(keys.prefixes[i], identifier);
+
+  byRegistration.erase(reg);
+}
+
+
+PBoolean H323GatekeeperServer::RemoveEndPoint(H323RegisteredEndPoint * ep)
+{
+  PTRACE(3, "RAS\tRemoving registered endpoint: " << *ep);
+
+  // clear all calls in the endpoint
+  while (ep->GetCallCount() > 0)
+    RemoveCall(&ep->GetCall(0));
+
+  // remove any aliases from the endpoint
+  while (ep->GetAliasCount() > 0)
+    ep->RemoveAlias(ep->GetAlias(0));
 
   // remove the descriptor
 #ifdef H323_H501
@@ -2980,9 +3791,27 @@ PBoolean H323GatekeeperServer::RemoveEndPoint(H323RegisteredEndPoint * ep)
     peerElement->DeleteDescriptor(ep->GetDescriptorID());
 #endif
 
+  timeToLiveMutex.Wait();
+  timeToLiveSlots.erase(ep->GetIdentifier());
+  timeToLiveMutex.Signal();
+
+  if (registrationStore != NULL)
+    registrationStore->Withdraw(ep->GetIdentifier());
+
+  snapshotMutex.Wait();
+  snapshotChanges++;
+  snapshotMutex.Signal();
+
+  PWriteWaitAndSignal wait(indexMutex);
+
+  // remove prefixes, aliases and call signalling addresses of this endpoint
+  RemoveRegistrationKeys(ep->GetIdentifier());
+
   // remove the endpoint from the list of active endpoints
   // ep is deleted by this
-  return byIdentifier.RemoveAt(ep->GetIdentifier());
+  PBoolean removed = byIdentifier.RemoveAt(ep->GetIdentifier());
+  ownerEndPoint.GetMetrics().gkRegistrations.Set(byIdentifier.GetSize());
+  return removed;
 }
 
 
@@ -2991,27 +3820,30 @@ void H323GatekeeperServer::RemoveAlias(H323RegisteredEndPoint & ep,
 {
   PTRACE(3, "RAS\tRemoving registered endpoint alias: " << alias);
 
-  mutex.Wait();
+  indexMutex.StartWrite();
 
-  PINDEX pos = byAlias.GetValuesIndex(alias);
-  if (pos != P_MAX_INDEX) {
+  std::map<PString, RegistrationKeys>::iterator reg = byRegistration.find(ep.GetIdentifier());
+  if (reg != byRegistration.end()) {
     // Allow for possible multiple aliases
-    while (pos < byAlias.GetSize()) {
-      StringMap & aliasMap = (StringMap &)byAlias[pos];
-      if (aliasMap != alias)
-        break;
-
-      if (aliasMap.identifier == ep.GetIdentifier())
-        byAlias.RemoveAt(pos);
+    std::vector<IdentifierMap::iterator> & aliases = reg->second.aliases;
+    for (size_t i = 0; i < aliases.size(); ) {
+      if (aliases[i]->first == alias) {
+        byAlias.erase(aliases[i]);
+        aliases.erase(aliases.begin() + i);
+      }
       else
-        pos++;
+        i++;
     }
   }
 
+  indexMutex.EndWrite();
+
   if (ep.ContainsAlias(alias))
     ep.RemoveAlias(alias);
 
-  mutex.Signal();
+  // Endpoints left with no aliases are removed by the monitor
+  if (ep.GetAliasCount() == 0)
+    ScheduleTimeToLive(ep.GetIdentifier(), 0);
 }
 
 
@@ -3021,10 +3853,174 @@ H323RegisteredEndPoint * H323GatekeeperServer::CreateRegisteredEndPoint(H323Gate
 }
 
 
+H323RegisteredEndPoint * H323GatekeeperServer::CreateRestoredEndPoint(const PString & identifier)
+{
+  return new H323RegisteredEndPoint(*this, identifier);
+}
+
+
+// The time written follows the magic string and its length
+static const char SnapshotMagic[] = "H323GKS1";
+static const PINDEX SnapshotTimeOffset = 4 + sizeof(SnapshotMagic) - 1;
+
+PBoolean H323GatekeeperServer::SaveRegistrations(const PFilePath & filename)
+{
+  H323GatekeeperSnapshot snapshot;
+  snapshot.WriteString(SnapshotMagic);
+  snapshot.WriteInt64(PTime().GetTimestamp()/1000);
+  snapshot.WriteString(gatekeeperIdentifier);
+
+  PINDEX count = 0;
+  for (PSafePtr<H323RegisteredEndPoint> ep = GetFirstEndPoint(PSafeReadOnly); ep != NULL; ep++) {
+    if (ep->GetAliasCount() == 0)
+      continue;
+
+    H323GatekeeperSnapshot record;
+    ep->OnSaveSnapshot(record);
+    snapshot.WriteString(ep->GetIdentifier());
+    snapshot.WriteBytes(record.GetData(), record.GetSize());
+    count++;
+  }
+
+  // An empty identifier ends the records
+  snapshot.WriteString(PString::Empty());
+
+  PFilePath tmpname = filename + ".tmp";
+  PFile file;
+  if (!file.Open(tmpname, PFile::WriteOnly, PFile::Create|PFile::Truncate) ||
+      !file.Write(snapshot.GetData(), snapshot.GetSize()) ||
+      !file.Close()) {
+    PTRACE(2, "RAS\tCould not write registration snapshot " << tmpname << ": " << file.GetErrorText());
+    PFile::Remove(tmpname);
+    return FALSE;
+  }
+
+  if (!PFile::Rename(tmpname, filename.GetFileName(), TRUE)) {
+    PTRACE(2, "RAS\tCould not replace registration snapshot " << filename);
+    PFile::Remove(tmpname);
+    return FALSE;
+  }
+
+  PTRACE(4, "RAS\tWrote " << count << " registrations to snapshot " << filename);
+  return TRUE;
+}
+
+
+PINDEX H323GatekeeperServer::LoadRegistrations(const PFilePath & filename)
+{
+  PFile file;
+  if (!file.Open(filename, PFile::ReadOnly)) {
+    PTRACE(2, "RAS\tCould not open registration snapshot " << filename << ": " << file.GetErrorText());
+    return 0;
+  }
+
+  PBYTEArray data((PINDEX)file.GetLength());
+  if (!file.Read(data.GetPointer(), data.GetSize()) || file.GetLastReadCount() != data.GetSize()) {
+    PTRACE(2, "RAS\tCould not read registration snapshot " << filename);
+    return 0;
+  }
+
+  H323GatekeeperSnapshot snapshot(data);
+  PString magic, gkid;
+  PInt64 written;
+  if (!snapshot.ReadString(magic) || magic != SnapshotMagic ||
+      !snapshot.ReadInt64(written) || !snapshot.ReadString(gkid)) {
+    PTRACE(2, "RAS\tFile " << filename << " is not a registration snapshot");
+    return 0;
+  }
+
+  // Endpoints send the identifier of the gatekeeper they registered with
+  if (gkid != gatekeeperIdentifier) {
+    PTRACE(2, "RAS\tRegistration snapshot is of gatekeeper " << gkid << ", not " << gatekeeperIdentifier);
+    return 0;
+  }
+
+  PInt64 age = PTime().GetTimestamp()/1000 - written;
+  if (age < 0)
+    age = 0;
+
+  H323GatekeeperListener * listener = NULL;
+  {
+    PWaitAndSignal m(H323TransactionServer::mutex);
+    for (PINDEX i = 0; i < H323TransactionServer::listeners.GetSize(); i++) {
+      if (PIsDescendant(&H323TransactionServer::listeners[i], H323GatekeeperListener)) {
+        listener = (H323GatekeeperListener *)&H323TransactionServer::listeners[i];
+        break;
+      }
+    }
+  }
+
+  PINDEX loaded = 0;
+  PINDEX dropped = 0;
+  for (;;) {
+    PString identifier;
+    PBYTEArray bytes;
+    if (!snapshot.ReadString(identifier)) {
+      PTRACE(2, "RAS\tRegistration snapshot " << filename << " is truncated");
+      break;
+    }
+    if (identifier.IsEmpty())
+      break;
+    if (!snapshot.ReadBytes(bytes)) {
+      PTRACE(2, "RAS\tRegistration snapshot " << filename << " is truncated");
+      break;
+    }
+
+    // Registered again, in full, since the snapshot was written
+    if (FindEndPointByIdentifier(identifier, PSafeReference) != NULL)
+      continue;
+
+    H323RegisteredEndPoint * ep = CreateRestoredEndPoint(identifier);
+    if (ep == NULL)
+      continue;
+
+    H323GatekeeperSnapshot record(bytes);
+    if (!ep->OnLoadSnapshot(record, age, listener) || ep->GetAliasCount() == 0) {
+      delete ep;
+      dropped++;
+      continue;
+    }
+
+    AddEndPoint(ep);
+    loaded++;
+  }
+
+  PTRACE(3, "RAS\tLoaded " << loaded << " registrations from snapshot " << filename
+         << " written " << PTimeInterval(age) << " ago, " << dropped << " dropped");
+  return loaded;
+}
+
+
+void H323GatekeeperServer::SetRegistrationSnapshot(const PFilePath & filename,
+                                                   const PTimeInterval & interval)
+{
+  PWaitAndSignal m(snapshotMutex);
+  snapshotFile = filename;
+  snapshotInterval = interval;
+  nextSnapshot = PTimer::Tick().GetMilliSeconds() + interval.GetMilliSeconds();
+  snapshotChanges = 1;
+}
+
+
+static PBoolean TouchRegistrationSnapshot(const PFilePath & filename)
+{
+  PFile file;
+  if (!file.Open(filename, PFile::ReadWrite, PFile::MustExist) || !file.SetPosition(SnapshotTimeOffset))
+    return FALSE;
+
+  H323GatekeeperSnapshot time;
+  time.WriteInt64(PTime().GetTimestamp()/1000);
+  return file.Write(time.GetData(), time.GetSize()) && file.Close();
+}
+
+
 PString H323GatekeeperServer::CreateEndPointIdentifier()
 {
   PStringStream id;
   PWaitAndSignal wait(mutex);
+  // Unique in a cluster too, with the node name
+  if (registrationStore != NULL)
+    id << registrationStore->GetNodeName() << ':';
   id << hex << identifierBase << ':' << nextIdentifier++;
   return id;
 }
@@ -3040,28 +4036,41 @@ PSafePtr<H323RegisteredEndPoint> H323GatekeeperServer::FindEndPointByIdentifier(
 PSafePtr<H323RegisteredEndPoint> H323GatekeeperServer::FindEndPointBySignalAddresses(
                             const H225_ArrayOf_TransportAddress & addresses, PSafetyMode mode)
 {
-  PWaitAndSignal wait(mutex);
+  PString identifier;
 
-  for (PINDEX i = 0; i < addresses.GetSize(); i++) {
-    PINDEX pos = byAddress.GetValuesIndex(H323TransportAddress(addresses[i]));
-    if (pos != P_MAX_INDEX)
-      return FindEndPointByIdentifier(((StringMap &)byAddress[pos]).identifier, mode);
+  {
+    PReadWaitAndSignal wait(indexMutex);
+    for (PINDEX i = 0; i < addresses.GetSize(); i++) {
+      AddressMap::const_iterator it = byAddress.find(H323TransportAddressKey(addresses[i]));
+      if (it != byAddress.end()) {
+        identifier = it->second;
+        break;
+      }
+    }
   }
 
-  return (H323RegisteredEndPoint *)NULL;
+  if (identifier.IsEmpty())
+    return (H323RegisteredEndPoint *)NULL;
+
+  return FindEndPointByIdentifier(identifier, mode);
 }
 
 
 PSafePtr<H323RegisteredEndPoint> H323GatekeeperServer::FindEndPointBySignalAddress(
                                      const H323TransportAddress & address, PSafetyMode mode)
 {
-  PWaitAndSignal wait(mutex);
+  PString identifier;
 
-  PINDEX pos = byAddress.GetValuesIndex(address);
-  if (pos != P_MAX_INDEX)
-    return FindEndPointByIdentifier(((StringMap &)byAddress[pos]).identifier, mode);
+  {
+    PReadWaitAndSignal wait(indexMutex);
+    H323TransportAddressKey key = address.GetKey();
+    AddressMap::const_iterator it = key.IsValid() ? byAddress.find(key) : byAddress.end();
+    if (it == byAddress.end())
+      return (H323RegisteredEndPoint *)NULL;
+    identifier = it->second;
+  }
 
-  return (H323RegisteredEndPoint *)NULL;
+  return FindEndPointByIdentifier(identifier, mode);
 }
 
 
@@ -3075,14 +4084,19 @@ PSafePtr<H323RegisteredEndPoint> H323GatekeeperServer::FindEndPointByAliasAddres
 PSafePtr<H323RegisteredEndPoint> H323GatekeeperServer::FindEndPointByAliasString(
                                                   const PString & alias, PSafetyMode mode)
 {
+  PString identifier;
+
   {
-    PWaitAndSignal wait(mutex);
-    PINDEX pos = byAlias.GetValuesIndex(alias);
+    PReadWaitAndSignal wait(indexMutex);
+    IdentifierMap::const_iterator it = byAlias.find(alias);
 
-    if (pos != P_MAX_INDEX)
-      return FindEndPointByIdentifier(((StringMap &)byAlias[pos]).identifier, mode);
+    if (it != byAlias.end())
+      identifier = it->second;
   }
 
+  if (!identifier)
+    return FindEndPointByIdentifier(identifier, mode);
+
   return FindEndPointByPrefixString(alias, mode);
 }
 
@@ -3090,18 +4104,25 @@ PSafePtr<H323RegisteredEndPoint> H323GatekeeperServer::FindEndPointByAliasString
 PSafePtr<H323RegisteredEndPoint> H323GatekeeperServer::FindEndPointByPartialAlias(
                                                   const PString & alias, PSafetyMode mode)
 {
-  PWaitAndSignal wait(mutex);
-  PINDEX pos = byAlias.GetNextStringsIndex(alias);
+  PString identifier;
 
-  if (pos != P_MAX_INDEX) {
-    StringMap & possible = (StringMap &)byAlias[pos];
-    if (possible.NumCompare(alias) == EqualTo) {
-      PTRACE(4, "RAS\tPartial endpoint search for "
-                "\"" << alias << "\" found \"" << possible << '"');
-      return FindEndPointByIdentifier(possible.identifier, mode);
+  {
+    PReadWaitAndSignal wait(indexMutex);
+    IdentifierMap::const_iterator it = byAlias.lower_bound(alias);
+
+    if (it != byAlias.end()) {
+      const PString & possible = it->first;
+      if (possible.NumCompare(alias) == EqualTo) {
+        PTRACE(4, "RAS\tPartial endpoint search for "
+                  "\"" << alias << "\" found \"" << possible << '"');
+        identifier = it->second;
+      }
     }
   }
 
+  if (!identifier)
+    return FindEndPointByIdentifier(identifier, mode);
+
   PTRACE(4, "RAS\tPartial endpoint search for \"" << alias << "\" failed");
   return (H323RegisteredEndPoint *)NULL;
 }
@@ -3110,18 +4131,27 @@ PSafePtr<H323RegisteredEndPoint> H323GatekeeperServer::FindEndPointByPartialAlia
 PSafePtr<H323RegisteredEndPoint> H323GatekeeperServer::FindEndPointByPrefixString(
                                                   const PString & prefix, PSafetyMode mode)
 {
-  PWaitAndSignal wait(mutex);
+  PString identifier;
 
-  if (byVoicePrefix.IsEmpty())
-    return (H323RegisteredEndPoint *)NULL;
+  {
+    PReadWaitAndSignal wait(indexMutex);
 
-  for (PINDEX len = prefix.GetLength(); len > 0; len--) {
-    PINDEX pos = byVoicePrefix.GetValuesIndex(prefix.Left(len));
-    if (pos != P_MAX_INDEX)
-      return FindEndPointByIdentifier(((StringMap &)byVoicePrefix[pos]).identifier, mode);
+    // Walk the trie as far as the number goes, keeping the longest match
+    const VoicePrefixNode * node = &byVoicePrefix;
+    for (PINDEX i = 0; i < prefix.GetLength(); i++) {
+      std::map<char, VoicePrefixNode *>::const_iterator child = node->children.find(prefix[i]);
+      if (child == node->children.end())
+        break;
+      node = child->second;
+      if (!node->identifiers.empty())
+        identifier = node->identifiers.front();
+    }
   }
 
-  return (H323RegisteredEndPoint *)NULL;
+  if (identifier.IsEmpty())
+    return (H323RegisteredEndPoint *)NULL;
+
+  return FindEndPointByIdentifier(identifier, mode);
 }
 
 
@@ -3179,7 +4209,7 @@ H323GatekeeperRequest::Response H323GatekeeperServer::OnAdmission(H323Gatekeeper
     response = newCall->OnAdmission(info);
 
     if (response != H323GatekeeperRequest::Reject) {
-      mutex.Wait();
+      callsMutex.Wait();
 
       info.endpoint->AddCall(newCall);
       oldCall = activeCalls.Append(newCall);
@@ -3188,8 +4218,11 @@ H323GatekeeperRequest::Response H323GatekeeperServer::OnAdmission(H323Gatekeeper
         peakCalls = activeCalls.GetSize();
       totalCalls++;
 
+      ownerEndPoint.GetMetrics().gkCallsTotal.Add();
+      ownerEndPoint.GetMetrics().gkCalls.Set(activeCalls.GetSize());
+
       PTRACE(2, "RAS\tAdded new call (total=" << activeCalls.GetSize() << ") " << *newCall);
-      mutex.Signal();
+      callsMutex.Signal();
 
       AddCall(oldCall);
     } else {
@@ -3225,6 +4258,11 @@ H323GatekeeperRequest::Response H323GatekeeperServer::OnDisengage(H323Gatekeeper
   OpalGloballyUniqueID callIdentifier = info.drq.m_callIdentifier.m_guid;
   PSafePtr<H323GatekeeperCall> call = FindCall(callIdentifier, info.drq.m_answeredCall);
   if (call == NULL) {
+    // A call made or answered without an ARQ was never known to us
+    if (info.drq.m_answeredCall ? answerCallPreGrantedARQ : makeCallPreGrantedARQ) {
+      PTRACE(3, "RAS\tDRQ accepted for pre-granted call with ID " << callIdentifier);
+      return H323GatekeeperRequest::Confirm;
+    }
     info.SetRejectReason(H225_DisengageRejectReason::e_requestToDropOther);
     PTRACE(2, "RAS\tDRQ rejected, no call with ID " << callIdentifier);
     return H323GatekeeperRequest::Reject;
@@ -3272,7 +4310,7 @@ PBoolean H323GatekeeperServer::GetUsersPassword(const PString & alias,
 PBoolean H323GatekeeperServer::GetUsersPassword(const PString & alias, PString & password) const
 {
   if (!passwords.Contains(alias))
-    return FALSE;
+    return passwordTable.Find(alias, password);
 
   password = passwords(alias);
   return TRUE;
@@ -3282,26 +4320,34 @@ PBoolean H323GatekeeperServer::GetUsersPassword(const PString & alias, PString &
 unsigned H323GatekeeperServer::AllocateBandwidth(unsigned newBandwidth,
                                                  unsigned oldBandwidth)
 {
-  PWaitAndSignal wait(mutex);
-
   // If first request for bandwidth, then only give them a maximum of the
   // configured default bandwidth
   if (oldBandwidth == 0 && newBandwidth > defaultBandwidth)
     newBandwidth = defaultBandwidth;
 
-  // If then are asking for more than we have in total, drop it down to whatevers left
-  if (newBandwidth > oldBandwidth && (newBandwidth - oldBandwidth) > (totalBandwidth - usedBandwidth))
-    newBandwidth = totalBandwidth - usedBandwidth - oldBandwidth;
+  /* The total is updated with a compare and swap rather than under a mutex,
+     so admissions do not queue on each other. If another allocation changed
+     it between reading and updating, the adjustment is done again. */
+  unsigned requested = newBandwidth;
+  unsigned used;
+  do {
+    used = usedBandwidth;
+    newBandwidth = requested;
+
+    // If then are asking for more than we have in total, drop it down to whatevers left
+    if (newBandwidth > oldBandwidth && (newBandwidth - oldBandwidth) > (totalBandwidth - used))
+      newBandwidth = totalBandwidth - used - oldBandwidth;
 
-  // If greater than the absolute maximum configured for any endpoint, clamp it
-  if (newBandwidth > maximumBandwidth)
-    newBandwidth = maximumBandwidth;
+    // If greater than the absolute maximum configured for any endpoint, clamp it
+    if (newBandwidth > maximumBandwidth)
+      newBandwidth = maximumBandwidth;
 
-  // Finally have adjusted new bandwidth, allocate it!
-  usedBandwidth += (newBandwidth - oldBandwidth);
+    // Finally have adjusted new bandwidth, allocate it!
+  } while (H323_ATOMIC_CAS32(&usedBandwidth, used, used + (newBandwidth - oldBandwidth)) != used);
 
   PTRACE(3, "RAS\tBandwidth allocation: +" << newBandwidth << " -" << oldBandwidth
-         << " used=" << usedBandwidth << " left=" << (totalBandwidth - usedBandwidth));
+         << " used=" << (used + newBandwidth - oldBandwidth)
+         << " left=" << (totalBandwidth - used - newBandwidth + oldBandwidth));
   return newBandwidth;
 }
 
@@ -3311,11 +4357,19 @@ void H323GatekeeperServer::RemoveCall(H323GatekeeperCall * call)
   if (PAssertNULL(call) == NULL)
     return;
 
+  H323CallJournal * journal = ownerEndPoint.GetCallJournal();
+  if (journal != NULL) {
+    H323CallRecord record;
+    call->GetCallRecord(record);
+    journal->Record(record);
+  }
+
   call->SetBandwidthUsed(0);
   PAssert(call->GetEndPoint().RemoveCall(call), PLogicError);
 
   PTRACE(2, "RAS\tRemoved call (total=" << (activeCalls.GetSize()-1) << ") id=" << *call);
   PAssert(activeCalls.Remove(call), PLogicError);
+  ownerEndPoint.GetMetrics().gkCalls.Set(activeCalls.GetSize());
 }
 
 
@@ -3410,45 +4464,160 @@ PBoolean H323GatekeeperServer::TranslateAliasAddress(const H225_AliasAddress & a
                                                  PBoolean & /*isGKRouted*/,
                                                  H323GatekeeperCall * /*call*/)
 {
-  if (!TranslateAliasAddressToSignalAddress(alias, address)) {
+  if (!TranslateAliasAddressToSignalAddress(alias, address))
+    return LocateThroughNeighbours(alias, aliases, address);
+
+  PSafePtr<H323RegisteredEndPoint> ep = FindEndPointBySignalAddress(address, PSafeReadOnly);
+  if (ep != NULL)
+    H323SetAliasAddresses(ep->GetAliases(), aliases);
+  else {
+    H323RegistrationStore::Registration registration;
+    if (registrationStore != NULL && registrationStore->Locate(H323GetAliasAddressString(alias), registration))
+      H323SetAliasAddresses(registration.aliases, aliases);
+  }
+
+  return TRUE;
+}
+
+PBoolean H323GatekeeperServer::LocateThroughNeighbours(const H225_AliasAddress & alias,
+                                                     H225_ArrayOf_AliasAddress & aliases,
+                                                     H323TransportAddress & address)
+{
+  H323PeerElement * pe = NULL;
 #ifdef H323_H501
-    H225_AliasAddress transportAlias;
-    if ((peerElement != NULL) && (peerElement->AccessRequest(alias, aliases, transportAlias))) {
-      // if AccessRequest returns OK, but no aliases, then all of the aliases
-      // must have been wildcards. In this case, add the original aliase back into the list
-      if (aliases.GetSize() == 0) {
-        PTRACE(1, "RAS\tAdding original alias to the top of the alias list");
-        aliases.SetSize(1);
-        aliases[0] = alias;
+  pe = peerElement;
+#endif
+
+  PString key = H323GetAliasAddressString(alias);
+  H323TransportAddressArray neighbourAddresses;
+  PInt64 now = PTimer::Tick().GetMilliSeconds();
+  {
+    PWaitAndSignal m(neighbourMutex);
+    neighbourAddresses = neighbours;
+    neighbourAddresses.MakeUnique();
+
+    std::map<PString, PInt64>::iterator it = unlocatedAliases.find(key);
+    if (it != unlocatedAliases.end()) {
+      if (it->second > now) {
+        PTRACE(4, "RAS\tNeighbours recently could not locate " << key);
+        return FALSE;
       }
-      address = H323GetAliasAddressString(transportAlias);
-      return TRUE;
+      unlocatedAliases.erase(it);
     }
-#endif
+  }
+
+  if (neighbourAddresses.IsEmpty() && pe == NULL)
     return FALSE;
+
+  H323GatekeeperListener * listener = NULL;
+  if (!neighbourAddresses.IsEmpty()) {
+    PWaitAndSignal m(H323TransactionServer::mutex);
+    for (PINDEX i = 0; i < H323TransactionServer::listeners.GetSize(); i++) {
+      if (PIsDescendant(&H323TransactionServer::listeners[i], H323GatekeeperListener)) {
+        listener = (H323GatekeeperListener *)&H323TransactionServer::listeners[i];
+        break;
+      }
+    }
   }
 
-  PSafePtr<H323RegisteredEndPoint> ep = FindEndPointBySignalAddress(address, PSafeReadOnly);
-  if (ep != NULL)
-    H323SetAliasAddresses(ep->GetAliases(), aliases);
+  // Each query retries on its own, so give the slowest all of its tries
+  PTimeInterval timeout = ownerEndPoint.GetRasRequestTimeout() * ownerEndPoint.GetRasRequestRetries();
 
-  return TRUE;
+  H323GatekeeperNeighbourQuery * query = new H323GatekeeperNeighbourQuery(*this, alias);
+  PBoolean located = query->Run(listener, neighbourAddresses, pe, timeout);
+  if (located) {
+    aliases = query->GetAliases();
+    address = query->GetAddress();
+  }
+  query->Release();
+
+  if (!located && neighbourNegativeCacheTime > 0) {
+    PWaitAndSignal m(neighbourMutex);
+    now = PTimer::Tick().GetMilliSeconds();
+
+    // Drop the expired entries before the cache grows large
+    if (unlocatedAliases.size() >= 1000) {
+      std::map<PString, PInt64>::iterator it = unlocatedAliases.begin();
+      while (it != unlocatedAliases.end()) {
+        if (it->second <= now)
+          unlocatedAliases.erase(it++);
+        else
+          ++it;
+      }
+    }
+
+    unlocatedAliases[key] = now + neighbourNegativeCacheTime.GetMilliSeconds();
+  }
+
+  return located;
+}
+
+
+void H323GatekeeperServer::AddNeighbour(const H323TransportAddress & address)
+{
+  PWaitAndSignal m(neighbourMutex);
+
+  for (PINDEX i = 0; i < neighbours.GetSize(); i++) {
+    if (neighbours[i] == address)
+      return;
+  }
+
+  neighbours.AppendAddress(address);
+  unlocatedAliases.clear();
+  PTRACE(3, "RAS\tAdded neighbour gatekeeper " << address);
+}
+
+
+PBoolean H323GatekeeperServer::RemoveNeighbour(const H323TransportAddress & address)
+{
+  PWaitAndSignal m(neighbourMutex);
+
+  for (PINDEX i = 0; i < neighbours.GetSize(); i++) {
+    if (neighbours[i] == address) {
+      neighbours.RemoveAt(i);
+      PTRACE(3, "RAS\tRemoved neighbour gatekeeper " << address);
+      return TRUE;
+    }
+  }
+
+  return FALSE;
 }
 
+
+H323TransportAddressArray H323GatekeeperServer::GetNeighbours() const
+{
+  PWaitAndSignal m(neighbourMutex);
+  H323TransportAddressArray copy = neighbours;
+  copy.MakeUnique();
+  return copy;
+}
+
+
 PBoolean H323GatekeeperServer::TranslateAliasAddressToSignalAddress(const H225_AliasAddress & alias,
                                                                 H323TransportAddress & address)
 {
-  PWaitAndSignal wait(mutex);
-
   PString aliasString = H323GetAliasAddressString(alias);
 
   if (isGatekeeperRouted) {
-    const H323ListenerList & listeners = ownerEndPoint.GetListeners();
-    address = listeners[0].GetTransportAddress();
+    if (signallingRelay != NULL)
+      address = signallingRelay->GetSignalAddress();
+    else {
+      const H323ListenerList & listeners = ownerEndPoint.GetListeners();
+      address = listeners[0].GetTransportAddress();
+    }
     PTRACE(2, "RAS\tTranslating alias " << aliasString << " to " << address << ", gatekeeper routed");
     return TRUE;
   }
 
+  return LocateSignalAddress(alias, address);
+}
+
+
+PBoolean H323GatekeeperServer::LocateSignalAddress(const H225_AliasAddress & alias,
+                                                   H323TransportAddress & address)
+{
+  PString aliasString = H323GetAliasAddressString(alias);
+
   PSafePtr<H323RegisteredEndPoint> ep = FindEndPointByAliasAddress(alias, PSafeReadOnly);
   if (ep != NULL) {
     address = ep->GetSignalAddress(0);
@@ -3456,6 +4625,20 @@ PBoolean H323GatekeeperServer::TranslateAliasAddressToSignalAddress(const H225_A
     return TRUE;
   }
 
+  H323RegistrationStore::Registration registration;
+  if (registrationStore != NULL && registrationStore->Locate(aliasString, registration)) {
+    address = registration.signalAddresses[0];
+    PTRACE(2, "RAS\tTranslating alias " << aliasString << " to " << address << ", registered with node " << registration.node);
+    return TRUE;
+  }
+
+  PString route;
+  if (routeTable.FindLongestPrefix(aliasString, route)) {
+    address = route;
+    PTRACE(2, "RAS\tTranslating alias " << aliasString << " to " << address << ", route table");
+    return TRUE;
+  }
+
   if (!aliasCanBeHostName)
     return FALSE;
 
@@ -3489,11 +4672,10 @@ PBoolean H323GatekeeperServer::CheckAliasAddressPolicy(const H323RegisteredEndPo
                                                    const H225_AdmissionRequest & arq,
                                                    const H225_AliasAddress & alias)
 {
-  PWaitAndSignal wait(mutex);
-
   if (arq.m_answerCall ? canOnlyAnswerRegisteredEP : canOnlyCallRegisteredEP) {
     PSafePtr<H323RegisteredEndPoint> ep = FindEndPointByAliasAddress(alias);
-    if (ep == NULL)
+    H323RegistrationStore::Registration registration;
+    if (ep == NULL && (registrationStore == NULL || !registrationStore->Locate(H323GetAliasAddressString(alias), registration)))
       return FALSE;
   }
 
@@ -3505,11 +4687,10 @@ PBoolean H323GatekeeperServer::CheckAliasStringPolicy(const H323RegisteredEndPoi
                                                   const H225_AdmissionRequest & arq,
                                                   const PString & alias)
 {
-  PWaitAndSignal wait(mutex);
-
   if (arq.m_answerCall ? canOnlyAnswerRegisteredEP : canOnlyCallRegisteredEP) {
     PSafePtr<H323RegisteredEndPoint> ep = FindEndPointByAliasString(alias);
-    if (ep == NULL)
+    H323RegistrationStore::Registration registration;
+    if (ep == NULL && (registrationStore == NULL || !registrationStore->Locate(alias, registration)))
       return FALSE;
   }
 
@@ -3569,15 +4750,48 @@ void H323GatekeeperServer::MonitorMain(PThread &, H323_INT)
   while (!monitorExit.Wait(1000)) {
     PTRACE(6, "RAS\tAging registered endpoints");
 
-    for (PSafePtr<H323RegisteredEndPoint> ep = GetFirstEndPoint(PSafeReference); ep != NULL; ep++) {
-      if (!ep->OnTimeToLive()) {
-        PTRACE(2, "RAS\tRemoving expired endpoint " << *ep);
-        RemoveEndPoint(ep);
+    // Collect the endpoints whose time to live check has come due
+    std::vector<PString> due;
+    PInt64 now = PTimer::Tick().GetMilliSeconds();
+
+    timeToLiveMutex.Wait();
+    while (!timeToLiveSchedule.empty() && timeToLiveSchedule.begin()->first <= now) {
+      std::multimap<PInt64, PString>::iterator entry = timeToLiveSchedule.begin();
+      std::map<PString, PInt64>::iterator slot = timeToLiveSlots.find(entry->second);
+      if (slot != timeToLiveSlots.end() && slot->second == entry->first) {
+        due.push_back(entry->second);
+        timeToLiveSlots.erase(slot);
       }
+      timeToLiveSchedule.erase(entry);
+    }
+    timeToLiveMutex.Signal();
+
+    for (size_t i = 0; i < due.size(); i++) {
+      PSafePtr<H323RegisteredEndPoint> ep = FindEndPointByIdentifier(due[i], PSafeReference);
+      if (ep == NULL)
+        continue;
+
       if (ep->GetAliasCount() == 0) {
         PTRACE(2, "RAS\tRemoving endpoint " << *ep << " with no aliases");
         RemoveEndPoint(ep);
+        continue;
       }
+
+      // A lightweight RRQ or IRR since it was scheduled moves it on
+      PTimeInterval remaining = ep->GetTimeToLiveRemaining();
+      if (remaining > 0) {
+        ScheduleTimeToLive(due[i], remaining);
+        continue;
+      }
+
+      if (!ep->OnTimeToLive()) {
+        PTRACE(2, "RAS\tRemoving expired endpoint " << *ep);
+        RemoveEndPoint(ep);
+        continue;
+      }
+
+      remaining = ep->GetTimeToLiveRemaining();
+      ScheduleTimeToLive(due[i], remaining > 1000 ? remaining : PTimeInterval(1000));
     }
 
     byIdentifier.DeleteObjectsToBeRemoved();
@@ -3590,6 +4804,27 @@ void H323GatekeeperServer::MonitorMain(PThread &, H323_INT)
     }
 
     activeCalls.DeleteObjectsToBeRemoved();
+
+    // Tables compiled again since they were loaded are swapped in
+    passwordTable.Reload();
+    routeTable.Reload();
+
+    snapshotMutex.Wait();
+    PFilePath filename = snapshotFile;
+    PBoolean snapshotDue = !filename.IsEmpty() && now >= nextSnapshot;
+    unsigned changes = snapshotChanges;
+    if (snapshotDue) {
+      nextSnapshot = now + snapshotInterval.GetMilliSeconds();
+      snapshotChanges = 0;
+    }
+    snapshotMutex.Signal();
+
+    // With nothing changed the records are still right, only their age is not
+    if (snapshotDue && (changes > 0 || !TouchRegistrationSnapshot(filename)) && !SaveRegistrations(filename)) {
+      snapshotMutex.Wait();
+      snapshotChanges++;
+      snapshotMutex.Signal();
+    }
   }
 }
 
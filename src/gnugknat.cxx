@@ -251,9 +251,7 @@ PBoolean GNUGKTransport::HandleGNUGKSignallingChannelPDU(PThread * thread)
         }
 
         PTRACE(3, "GNUGK\tCreated new connection: " << token);
-        connectionsMutex.Wait();
-        endpoint.GetConnections().SetAt(token, connection);
-        connectionsMutex.Signal();
+        endpoint.AddConnection(token, connection);
 
         connection->AttachSignalChannel(token, this, TRUE);
  
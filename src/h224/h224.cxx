@@ -329,12 +329,19 @@ OpalH224Handler::OpalH224Handler(H323Channel::Directions dir,
 
   CreateHandlers(connection);
   receiverThread = NULL;
+  reactorReceive = FALSE;
+  receiveFrame = new H224_Frame();
+  lastTimeStamp = 0;
     
 }
 
 OpalH224Handler::~OpalH224Handler()
 {
+    if (reactorReceive)
+      StopReceive();
+
     DeleteHandlers();
+    delete receiveFrame;
 }
 
 void OpalH224Handler::CreateHandlers(H323Connection & connection)
@@ -400,10 +407,18 @@ void OpalH224Handler::StopTransmit()
 
 void OpalH224Handler::StartReceive()
 {
-  if(receiverThread != NULL) {
+  if(receiverThread != NULL || reactorReceive) {
     PTRACE(5, "H.224 handler is already receiving");
     return;
   }
+
+  // H.224 packets are rare, so rather than a thread blocked on the session
+  // for the whole call let a thread of the media reactor handle them
+  if(session != NULL && session->SetReactorDataHandler(PCREATE_NOTIFIER(OnReactorPacket))) {
+    PTRACE(4, "H224\tReceiving by media reactor");
+    reactorReceive = TRUE;
+    return;
+  }
     
   receiverThread = CreateH224ReceiverThread();
   receiverThread->Resume();
@@ -411,6 +426,11 @@ void OpalH224Handler::StartReceive()
 
 void OpalH224Handler::StopReceive()
 {
+  if(reactorReceive) {
+    session->SetReactorDataHandler(PNotifier());
+    reactorReceive = FALSE;
+  }
+
   if(receiverThread != NULL) {
     receiverThread->Close();
   }
@@ -723,11 +743,37 @@ PBoolean OpalH224Handler::OnWriteFrame(RTP_DataFrame & frame)
         return true;
 }
 
+void OpalH224Handler::OnReceivedPacket(RTP_DataFrame & packet)
+{
+  if (!OnReadFrame(packet))
+    return;
+
+  unsigned timestamp = packet.GetTimestamp();
+  if (timestamp == lastTimeStamp)
+    return;
+
+  if (!receiveFrame->Decode(packet.GetPayloadPtr(), packet.GetPayloadSize()) ||
+      !OnReceivedFrame(*receiveFrame)) {
+         PTRACE(3, "Decoding of H.224 frame failed");
+  }
+  lastTimeStamp = timestamp;
+}
+
+void OpalH224Handler::OnReactorPacket(RTP_DataFrame & packet, H323_INT closed)
+{
+  if (closed) {
+    PTRACE(4, "H224\tReactor receive closed");
+    return;
+  }
+
+  OnReceivedPacket(packet);
+}
+
 ////////////////////////////////////
 
 OpalH224ReceiverThread::OpalH224ReceiverThread(OpalH224Handler *theH224Handler, RTP_Session & session)
 : PThread(10000, AutoDeleteThread, NormalPriority, "H.224 Receiver Thread"),
-  h224Handler(theH224Handler), rtpSession(session), threadClosed(true), lastTimeStamp(0)
+  h224Handler(theH224Handler), rtpSession(session), threadClosed(true)
 {
 
 }
@@ -740,7 +786,6 @@ OpalH224ReceiverThread::~OpalH224ReceiverThread()
 void OpalH224ReceiverThread::Main()
 {
   RTP_DataFrame packet = RTP_DataFrame(300);
-  H224_Frame h224Frame = H224_Frame(); 
   unsigned timestamp = 0; 
 
   threadClosed = false;
@@ -750,18 +795,8 @@ void OpalH224ReceiverThread::Main()
     if(!rtpSession.ReadBufferedData(timestamp, packet)) 
         break;
 
-    if (!h224Handler->OnReadFrame(packet))
-        continue;
- 
+    h224Handler->OnReceivedPacket(packet);
     timestamp = packet.GetTimestamp();
-    if (timestamp == lastTimeStamp)
-        continue;
-
-    if (!h224Frame.Decode(packet.GetPayloadPtr(), packet.GetPayloadSize()) ||
-        !h224Handler->OnReceivedFrame(h224Frame)) {
-           PTRACE(3, "Decoding of H.224 frame failed");
-    }
-    lastTimeStamp = timestamp;
   }
 
   threadClosed = true;
@@ -163,6 +163,142 @@ void LoadH235_DHMap(H235_DHMap & dhmap, H235_DHMap & dhcache, H235Authenticators
       }
     }
 
+    // Proprietary elliptic curves, only used when the remote offers them too
+    if (H235Authenticators::GetEllipticCurveKeyAgreement()) {
+      static const char * const curves[] = { OID_ECDH_X25519, OID_ECDH_P256 };
+      for (PINDEX i = 0; i < PARRAYSIZE(curves); ++i) {
+        if (H235_EllipticCurveDH::IsSupported(curves[i]) && dhmap.find(curves[i]) == dhmap.end()) {
+           dhmap.insert(pair<PString, H235_DiffieHellman*>(curves[i], new H235_EllipticCurveDH(curves[i])));
+           PTRACE(6, "H2356\tEC KeyPair " << curves[i] << " loaded.");
+        }
+      }
+    }
+
+}
+
+// get the cipher length of an algorithm OID
+static unsigned GetAlgorithmCipherLength(const PString & alg)
+{
+#ifdef H323_H235_AES256
+    if (alg == ID_AES256)
+        return 256;
+    if (alg == ID_AES192)
+        return 192;
+#endif
+    return 128;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+H2356_DHKeyPool::H2356_DHKeyPool(const H235_DHMap & groups, unsigned depth)
+  : PThread(0, NoAutoDeleteThread, LowPriority, "H235 KeyPool"),
+    m_depth(depth),
+    m_stop(false)
+{
+    // Key pairs loaded from file are fixed, elliptic curve copies make their own
+    for (H235_DHMap::const_iterator i = groups.begin(); i != groups.end(); ++i) {
+        if (i->second && !i->second->LoadFile() && !PIsDescendant(i->second, H235_EllipticCurveDH))
+            m_groups[i->first].m_parameters = (H235_DiffieHellman *)i->second->Clone();
+    }
+
+    PTRACE(3, "H2356\tKey pool of " << m_depth << " for " << m_groups.size() << " groups");
+    Resume();
+}
+
+H2356_DHKeyPool::~H2356_DHKeyPool()
+{
+    m_stop = true;
+    m_refill.Signal();
+    PAssert(WaitForTermination(10000), "H235 key pool thread did not terminate");
+
+    for (GroupMap::iterator g = m_groups.begin(); g != m_groups.end(); ++g) {
+        while (!g->second.m_ready.empty()) {
+            delete g->second.m_ready.front();
+            g->second.m_ready.pop_front();
+        }
+        delete g->second.m_parameters;
+    }
+}
+
+H235_DiffieHellman * H2356_DHKeyPool::Take(const PString & dhOID)
+{
+    PWaitAndSignal m(m_mutex);
+
+    GroupMap::iterator g = m_groups.find(dhOID);
+    if (g == m_groups.end())
+        return NULL;
+
+    Group & group = g->second;
+    m_refill.Signal();
+
+    if (group.m_ready.empty()) {
+        group.m_stats.m_missed++;
+        PTRACE(3, "H2356\tKey pool for " << dhOID << " empty, call uses cached key pair");
+        return NULL;
+    }
+
+    H235_DiffieHellman * dh = group.m_ready.front();
+    group.m_ready.pop_front();
+    group.m_stats.m_taken++;
+    return dh;
+}
+
+PBoolean H2356_DHKeyPool::GetStatistics(const PString & dhOID, Statistics & stats) const
+{
+    PWaitAndSignal m(m_mutex);
+
+    GroupMap::const_iterator g = m_groups.find(dhOID);
+    if (g == m_groups.end())
+        return false;
+
+    stats = g->second.m_stats;
+    stats.m_ready = (unsigned)g->second.m_ready.size();
+    return true;
+}
+
+void H2356_DHKeyPool::Main()
+{
+    PTRACE(4, "H2356\tStarted key pool thread");
+
+    while (!m_stop) {
+        // Refill the emptiest group first
+        PString dhOID;
+        H235_DiffieHellman * dh = NULL;
+        {
+            PWaitAndSignal m(m_mutex);
+            GroupMap::iterator best = m_groups.end();
+            for (GroupMap::iterator g = m_groups.begin(); g != m_groups.end(); ++g) {
+                if (g->second.m_ready.size() < m_depth &&
+                    (best == m_groups.end() || g->second.m_ready.size() < best->second.m_ready.size()))
+                    best = g;
+            }
+            if (best != m_groups.end()) {
+                dhOID = best->first;
+                dh = (H235_DiffieHellman *)best->second.m_parameters->Clone();
+            }
+        }
+
+        if (dh == NULL) {
+            m_refill.Wait();
+            continue;
+        }
+
+        PTime start;
+        if (!dh->GenerateNewHalfKey()) {
+            PTRACE(1, "H2356\tKey pool failed to generate key pair for " << dhOID);
+            delete dh;
+            m_refill.Wait(10000);
+            continue;
+        }
+
+        PWaitAndSignal m(m_mutex);
+        Group & group = m_groups[dhOID];
+        group.m_ready.push_back(dh);
+        group.m_stats.m_generated++;
+        group.m_stats.m_generateTime += PTime() - start;
+    }
+
+    PTRACE(4, "H2356\tStopped key pool thread");
 }
 
 /////////////////////////////////////////////////////////////////////////////////////
@@ -176,6 +312,7 @@ static PFactory<H235Authenticator>::Worker<H2356_Authenticator> factoryH2356_Aut
 #endif
 
 H235_DHMap H2356_Authenticator::m_dhCachedMap;
+H2356_DHKeyPool * H2356_Authenticator::m_dhKeyPool = NULL;
 
 H2356_Authenticator::H2356_Authenticator()
 : m_tokenState(e_clearNone)
@@ -188,6 +325,16 @@ H2356_Authenticator::H2356_Authenticator()
     m_algOIDs.SetSize(0);
     if (m_enabled) {
         LoadH235_DHMap(m_dhLocalMap, m_dhCachedMap, H235Authenticators::GetDHDataList(), H235Authenticators::GetDHParameterFile(), H235Authenticators::GetMaxCipherLength(), H235Authenticators::GetMaxTokenLength());
+        if (m_dhKeyPool) {
+            // use fresh key pairs rather than the cached ones where ready
+            for (H235_DHMap::iterator i = m_dhLocalMap.begin(); i != m_dhLocalMap.end(); ++i) {
+                H235_DiffieHellman * dh = m_dhKeyPool->Take(i->first);
+                if (dh) {
+                    delete i->second;
+                    i->second = dh;
+                }
+            }
+        }
         InitialiseSecurity(); // make sure m_algOIDs gets filled
     }
 }
@@ -219,14 +366,24 @@ PBoolean H2356_Authenticator::GetAuthenticationCapabilities(H235Authenticator::C
 void H2356_Authenticator::InitialiseCache(int cipherlength, unsigned maxTokenLength)
 {
    LoadH235_DHMap(m_dhCachedMap, m_dhCachedMap, H235Authenticators::GetDHDataList(), H235Authenticators::GetDHParameterFile(), cipherlength, maxTokenLength);
+
+   if (m_dhKeyPool == NULL && H235Authenticators::GetDHKeyPoolDepth() > 0)
+       m_dhKeyPool = new H2356_DHKeyPool(m_dhCachedMap, H235Authenticators::GetDHKeyPoolDepth());
 }
 
 void H2356_Authenticator::RemoveCache()
 {
+   delete m_dhKeyPool;
+   m_dhKeyPool = NULL;
    DeleteObjectsInMap(m_dhCachedMap);
    m_dhCachedMap.clear();
 }
 
+PBoolean H2356_Authenticator::GetKeyPoolStatistics(const PString & dhOID, H2356_DHKeyPool::Statistics & stats)
+{
+   return m_dhKeyPool != NULL && m_dhKeyPool->GetStatistics(dhOID, stats);
+}
+
 PBoolean H2356_Authenticator::IsMatch(const PString & identifier) const
 {
     PStringArray ids;
@@ -323,36 +480,39 @@ H235Authenticator::ValidationResult H2356_Authenticator::ValidateTokens(const PA
 
     PString selectOID;
     H235_DHMap::iterator it;
-    for (PINDEX i = 0; i < tokens.GetSize(); ++i) {
-        for (it = m_dhLocalMap.begin(); it != m_dhLocalMap.end(); ++it) {
-            const H235_ClearToken & token = tokens[i];
-            PString tokenOID = token.m_tokenOID.AsString();
-            if (it->first == tokenOID) {
-                if (it->second != NULL) {
-                    if (token.HasOptionalField(H235_ClearToken::e_dhkey)) {  // For keysize up to and including 2048
-                        const H235_DHset & dh = token.m_dhkey;
-                        it->second->SetRemoteHalfKey(dh.m_halfkey);
-                        if (!m_tokenState && dh.m_modSize.GetSize() > 0)  	// replace p and g if included and received first
-                            it->second->SetDHReceived(dh.m_modSize,dh.m_generator);
-
-                    } else if (token.HasOptionalField(H235_ClearToken::e_dhkeyext)) {  // For keysize greater then 2048
-                        const H235_DHsetExt & dh = token.m_dhkeyext;
-                        it->second->SetRemoteHalfKey(dh.m_halfkey);
-                        if (!m_tokenState && dh.HasOptionalField(H235_DHsetExt::e_modSize) &&   // replace p and g if included if received first
-                                             dh.HasOptionalField(H235_DHsetExt::e_generator))
-                            it->second->SetDHReceived(dh.m_modSize,dh.m_generator);
-
-                    } else {
-                        PTRACE(2, "H2356\tERROR DH Parameters missing " << it->first << " skipping.");
-                        continue;
+    // Elliptic curves first when both sides have them, then in the remote's order
+    for (int pass = 0; pass < 2 && selectOID.IsEmpty(); ++pass) {
+        for (PINDEX i = 0; i < tokens.GetSize(); ++i) {
+            for (it = m_dhLocalMap.begin(); it != m_dhLocalMap.end(); ++it) {
+                const H235_ClearToken & token = tokens[i];
+                PString tokenOID = token.m_tokenOID.AsString();
+                if (it->first == tokenOID) {
+                    if (it->second != NULL && (pass > 0 || PIsDescendant(it->second, H235_EllipticCurveDH))) {
+                        if (token.HasOptionalField(H235_ClearToken::e_dhkey)) {  // For keysize up to and including 2048
+                            const H235_DHset & dh = token.m_dhkey;
+                            it->second->SetRemoteHalfKey(dh.m_halfkey);
+                            if (!m_tokenState && dh.m_modSize.GetSize() > 0)  	// replace p and g if included and received first
+                                it->second->SetDHReceived(dh.m_modSize,dh.m_generator);
+
+                        } else if (token.HasOptionalField(H235_ClearToken::e_dhkeyext)) {  // For keysize greater then 2048
+                            const H235_DHsetExt & dh = token.m_dhkeyext;
+                            it->second->SetRemoteHalfKey(dh.m_halfkey);
+                            if (!m_tokenState && dh.HasOptionalField(H235_DHsetExt::e_modSize) &&   // replace p and g if included if received first
+                                                 dh.HasOptionalField(H235_DHsetExt::e_generator))
+                                it->second->SetDHReceived(dh.m_modSize,dh.m_generator);
+
+                        } else {
+                            PTRACE(2, "H2356\tERROR DH Parameters missing " << it->first << " skipping.");
+                            continue;
+                        }
+                        selectOID = it->first;
+                        PTRACE(4, "H2356\tSetting Encryption Algorithm for call " << selectOID);
                     }
-                    selectOID = it->first;
-                    PTRACE(4, "H2356\tSetting Encryption Algorithm for call " << selectOID);
                 }
+                if (!selectOID) break;
             }
             if (!selectOID) break;
         }
-        if (!selectOID) break;
     }
 
     if (!selectOID) {
@@ -441,9 +601,11 @@ void H2356_Authenticator::InitialiseSecurity()
   if (dhOID.IsEmpty())
       return;
 
+  m_dhOID = dhOID;
   m_algOIDs.SetSize(0);
   for (PINDEX i=0; i<PARRAYSIZE(H235_Algorithms); ++i) {
-      if (PString(H235_Algorithms[i].DHparameters) == dhOID)
+      if (PString(H235_Algorithms[i].DHparameters) == dhOID &&
+          GetAlgorithmCipherLength(H235_Algorithms[i].algorithm) <= (unsigned)H235Authenticators::GetMaxCipherLength())
            m_algOIDs.AppendString(H235_Algorithms[i].algorithm);
   }
 
@@ -463,7 +625,8 @@ PBoolean H2356_Authenticator::GetMediaSessionInfo(PString & algorithmOID, PBYTEA
       return false;
   }
 
-  PString DhOID = GetDhOIDFromAlg(m_algOIDs[0]);
+  // several groups may share an algorithm, so use the one selected
+  PString DhOID = m_dhOID.IsEmpty() ? GetDhOIDFromAlg(m_algOIDs[0]) : m_dhOID;
   H235_DHMap::const_iterator l = m_dhLocalMap.find(DhOID);
   if (l != m_dhLocalMap.end()) {
      algorithmOID = m_algOIDs[0];
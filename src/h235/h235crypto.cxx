@@ -613,38 +613,31 @@ PINDEX H235CryptoEngine::EncryptInPlace(const BYTE * inData, PINDEX inLength, BY
         return inLength;
     }
 
-    // max ciphertext len for a n bytes of plaintext is n + BLOCK_SIZE -1 bytes
-    int outSize = 0;
-    int inSize =  inLength + m_enc_blockSize;
-
     SetIV(m_iv, ivSequence, m_enc_ivLength);
     EVP_EncryptInit_ex(m_encryptCtx, NULL, NULL, NULL, m_iv);
-    m_encryptHelper.Reset();
 
-    rtpPadding = (inLength % m_enc_blockSize > 0);
-    EVP_CIPHER_CTX_set_padding(m_encryptCtx, rtpPadding ? 1 : 0);
+    // The whole blocks go through the cipher in one call straight into the
+    // output, only a partial last block is copied to add the RTP padding.
+    // This gives the same result as EVP_EncryptUpdate()/EVP_EncryptFinal_ex()
+    // with padding enabled for partial blocks.
+    int tail = inLength % m_enc_blockSize;
+    int whole = inLength - tail;
+    rtpPadding = (tail > 0);
 
-    if (!rtpPadding && (inLength % m_enc_blockSize > 0)) {
-        // use cyphertext stealing
-        if (!m_encryptHelper.EncryptUpdateCTS(m_encryptCtx, outData, &inSize, inData, inLength)) {
-            PTRACE(1, "H235\tEVP_EncryptUpdate_cts() failed");
-        }
-        if (!m_encryptHelper.EncryptFinalCTS(m_encryptCtx, outData + inSize, &outSize)) {
-            PTRACE(1, "H235\tEVP_EncryptFinal_cts() failed");
-        }
-    } else {
-        /* update ciphertext, ciphertext_len is filled with the length of ciphertext generated,
-         *len is the size of plaintext in bytes */
-        if (!EVP_EncryptUpdate(m_encryptCtx, outData, &inSize, inData, inLength)) {
-            PTRACE(1, "H235\tEVP_EncryptUpdate() failed");
-        }
+    if (whole > 0 && !EVP_Cipher(m_encryptCtx, outData, inData, whole)) {
+        PTRACE(1, "H235\tEVP_Cipher() failed");
+    }
 
-        // update ciphertext with the final remaining bytes, if any use RTP padding
-        if (!EVP_EncryptFinal_ex(m_encryptCtx, outData + inSize, &outSize)) {
-            PTRACE(1, "H235\tEVP_EncryptFinal_ex() failed");
-        }
+    if (!rtpPadding)
+        return whole;
+
+    unsigned char block[EVP_MAX_BLOCK_LENGTH];
+    memcpy(block, inData + whole, tail);
+    memset(block + tail, m_enc_blockSize - tail, m_enc_blockSize - tail);
+    if (!EVP_Cipher(m_encryptCtx, outData + whole, block, m_enc_blockSize)) {
+        PTRACE(1, "H235\tEVP_Cipher() failed on padded block");
     }
-    return inSize + outSize;
+    return whole + m_enc_blockSize;
 }
 
 PBYTEArray H235CryptoEngine::Decrypt(const PBYTEArray & _data, unsigned char * ivSequence, bool & rtpPadding)
@@ -691,19 +684,15 @@ PBYTEArray H235CryptoEngine::Decrypt(const PBYTEArray & _data, unsigned char * i
 
 PINDEX H235CryptoEngine::DecryptInPlace(const BYTE * inData, PINDEX inLength, BYTE * outData, unsigned char * ivSequence, bool & rtpPadding)
 {
-
-    /* plaintext will always be equal to or lesser than length of ciphertext*/
-    int outSize = 0;
-    int inSize =  inLength;
-
     SetIV(m_iv, ivSequence, m_dec_ivLength);
     EVP_DecryptInit_ex(m_decryptCtx, NULL, NULL, NULL, m_iv);
-    m_decryptHelper.Reset();
-
-    EVP_CIPHER_CTX_set_padding(m_decryptCtx, rtpPadding ? 1 : 0);
 
     if (!rtpPadding && inLength % m_dec_blockSize > 0) {
         // use cyphertext stealing
+        int outSize = 0;
+        int inSize =  inLength;
+        m_decryptHelper.Reset();
+        EVP_CIPHER_CTX_set_padding(m_decryptCtx, 0);
         if (!m_decryptHelper.DecryptUpdateCTS(m_decryptCtx, outData, &inSize, inData, inLength)) {
             PTRACE(1, "H235\tDecryptUpdateCTS() failed");
 			return 0;	// no usable payload
@@ -712,18 +701,36 @@ PINDEX H235CryptoEngine::DecryptInPlace(const BYTE * inData, PINDEX inLength, BY
             PTRACE(1, "H235\tDecryptFinalCTS() failed");
 			return 0;	// no usable payload
         }
-    } else {
-        if (!m_decryptHelper.DecryptUpdate(m_decryptCtx, outData, &inSize, inData, inLength)) {
-            PTRACE(1, "H235\tDecryptUpdate() failed");
-			return 0;	// no usable payload
-        }
-        if (!m_decryptHelper.DecryptFinalRelaxed(m_decryptCtx, outData + inSize, &outSize)) {
-            PTRACE(1, "H235\tDecryptFinalRelaxed() failed - incorrect padding ?");
-			return 0;	// no usable payload
+        return inSize + outSize;
+    }
+
+    if (inLength == 0)
+        return 0;
+
+    if (inLength % m_dec_blockSize > 0) {
+        PTRACE(1, "H235\tDecrypt error: wrong final block length");
+        return 0;	// no usable payload
+    }
+
+    // Whole blocks, so decrypt in one call straight into the output
+    if (!EVP_Cipher(m_decryptCtx, outData, inData, inLength)) {
+        PTRACE(1, "H235\tEVP_Cipher() failed");
+        return 0;	// no usable payload
+    }
+
+    int outSize = inLength;
+    if (rtpPadding) {
+        // Only the pad count is checked, see DecryptFinalRelaxed()
+        int n = outData[outSize - 1];
+        if (n == 0 || n > m_dec_blockSize) {
+            PTRACE(1, "H235\tDecrypt error: bad decrypt - incorrect padding ?");
+            return 0;	// no usable payload
         }
+        outSize -= n;
     }
+
 	rtpPadding = false;	// we return the real length of the decrypted data without padding
-    return inSize + outSize;
+    return outSize;
 }
 
 PBYTEArray H235CryptoEngine::GenerateRandomKey()
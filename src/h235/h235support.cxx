@@ -53,8 +53,22 @@ extern "C" {
 #include <openssl/dh.h>
 #include <openssl/pem.h>
 #include <openssl/bn.h>
+#include <openssl/evp.h>
+#include <openssl/ec.h>
 };
 
+// X25519 and raw public key encoding need OpenSSL 1.1.1
+#if (OPENSSL_VERSION_NUMBER >= 0x10101000L) && !defined(LIBRESSL_VERSION_NUMBER)
+#define H235_ECDH_SUPPORTED 1
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#define H235_GetEncodedPublicKey EVP_PKEY_get1_encoded_public_key
+#define H235_SetEncodedPublicKey EVP_PKEY_set1_encoded_public_key
+#else
+#define H235_GetEncodedPublicKey EVP_PKEY_get1_tls_encodedpoint
+#define H235_SetEncodedPublicKey EVP_PKEY_set1_tls_encodedpoint
+#endif
+#endif
+
 #if (OPENSSL_VERSION_NUMBER < 0x10100000L) || defined(LIBRESSL_VERSION_NUMBER)
 
 inline void DH_get0_pqg(const DH *dh,
@@ -146,6 +160,11 @@ H235_DiffieHellman::H235_DiffieHellman(const PConfig  & dhFile, const PString &
   }
 }
 
+H235_DiffieHellman::H235_DiffieHellman(int keySize)
+: dh(NULL), m_remKey(NULL), m_toSend(false), m_wasReceived(false), m_wasDHReceived(false), m_keySize(keySize), m_loadFromFile(false)
+{
+}
+
 H235_DiffieHellman::H235_DiffieHellman(const PFilePath & dhPKCS3)
 : dh(NULL), m_remKey(NULL), m_toSend(true), m_wasReceived(false), m_wasDHReceived(false), m_keySize(0), m_loadFromFile(false)
 {
@@ -458,6 +477,41 @@ PBoolean H235_DiffieHellman::GenerateHalfKey()
   return TRUE;
 }
 
+PBoolean H235_DiffieHellman::GenerateNewHalfKey()
+{
+  PWaitAndSignal m(vbMutex);
+
+  if (dh == NULL)
+    return FALSE;
+
+  // DH_generate_key() keeps an existing private key, so start from the parameters only
+  DH * fresh = DH_new();
+  if (fresh == NULL) {
+    PTRACE(1, "H235_DH\tFailed to allocate DH");
+    return FALSE;
+  }
+
+  const BIGNUM *p = NULL, *q = NULL, *g = NULL;
+  DH_get0_pqg(dh, &p, &q, &g);
+  if (p == NULL || g == NULL || !DH_set0_pqg(fresh, BN_dup(p), q ? BN_dup(q) : NULL, BN_dup(g))) {
+    PTRACE(1, "H235_DH\tERROR copying DH parameters");
+    DH_free(fresh);
+    return FALSE;
+  }
+
+  if (!DH_generate_key(fresh)) {
+      char buf[256];
+      ERR_error_string(ERR_get_error(), buf);
+      PTRACE(1, "H235_DH\tERROR generating DH halfkey " << buf);
+      DH_free(fresh);
+      return FALSE;
+  }
+
+  DH_free(dh);
+  dh = fresh;
+  return TRUE;
+}
+
 void H235_DiffieHellman::SetDHReceived(const PASN_BitString & p, const PASN_BitString & g)
 {
     PTRACE(4, "H235\tReplacing local DH parameters with those of remote");
@@ -695,5 +749,203 @@ void H235_DiffieHellman::Generate(PINDEX keyLength, PINDEX keyGenerator, PString
 }
 
 
+////////////////////////////////////////////////////////////////////////////////////
+// Elliptic curve Diffie Hellman
+
+#ifdef H235_ECDH_SUPPORTED
+#define H235_ECDH_X25519  EVP_PKEY_X25519
+#define H235_ECDH_P256    EVP_PKEY_EC
+#else
+#define H235_ECDH_X25519  1
+#define H235_ECDH_P256    2
+#endif
+
+static int KeyTypeFromOID(const PString & oid)
+{
+  if (oid == OID_ECDH_X25519)
+    return H235_ECDH_X25519;
+  if (oid == OID_ECDH_P256)
+    return H235_ECDH_P256;
+  return 0;
+}
+
+H235_EllipticCurveDH::H235_EllipticCurveDH(const PString & oid)
+: H235_DiffieHellman(0), m_keyType(KeyTypeFromOID(oid)), m_key(NULL)
+{
+  GenerateHalfKey();
+}
+
+H235_EllipticCurveDH::H235_EllipticCurveDH(const H235_EllipticCurveDH & other)
+: H235_DiffieHellman(0), m_keyType(other.m_keyType), m_key(NULL)
+{
+  GenerateHalfKey();
+}
+
+H235_EllipticCurveDH::~H235_EllipticCurveDH()
+{
+#ifdef H235_ECDH_SUPPORTED
+  if (m_key)
+    EVP_PKEY_free(m_key);
+#endif
+}
+
+PBoolean H235_EllipticCurveDH::IsSupported(const PString & oid)
+{
+#ifdef H235_ECDH_SUPPORTED
+  return KeyTypeFromOID(oid) != 0;
+#else
+  return false;
+#endif
+}
+
+PObject * H235_EllipticCurveDH::Clone() const
+{
+  return new H235_EllipticCurveDH(*this);
+}
+
+PBoolean H235_EllipticCurveDH::CheckParams() const
+{
+  return m_keyType != 0;
+}
+
+PBoolean H235_EllipticCurveDH::GenerateHalfKey()
+{
+  if (m_key)
+    return true;
+
+  return GenerateNewHalfKey();
+}
+
+PBoolean H235_EllipticCurveDH::GenerateNewHalfKey()
+{
+#ifdef H235_ECDH_SUPPORTED
+  PWaitAndSignal m(vbMutex);
+
+  if (m_keyType == 0)
+    return FALSE;
+
+  EVP_PKEY * key = NULL;
+  EVP_PKEY_CTX * ctx = EVP_PKEY_CTX_new_id(m_keyType, NULL);
+  PBoolean ok = ctx != NULL && EVP_PKEY_keygen_init(ctx) > 0 &&
+               (m_keyType != EVP_PKEY_EC || EVP_PKEY_CTX_set_ec_paramgen_curve_nid(ctx, NID_X9_62_prime256v1) > 0) &&
+               EVP_PKEY_keygen(ctx, &key) > 0;
+  if (ctx)
+    EVP_PKEY_CTX_free(ctx);
+
+  unsigned char * data = NULL;
+  size_t len = ok ? H235_GetEncodedPublicKey(key, &data) : 0;
+  if (len == 0) {
+    char buf[256];
+    ERR_error_string(ERR_get_error(), buf);
+    PTRACE(1, "H235_DH\tERROR generating EC key pair " << buf);
+    if (key)
+      EVP_PKEY_free(key);
+    return FALSE;
+  }
+
+  m_publicKey = PBYTEArray(data, (PINDEX)len);
+  OPENSSL_free(data);
+
+  if (m_key)
+    EVP_PKEY_free(m_key);
+  m_key = key;
+  m_keySize = (int)len;
+  return TRUE;
+#else
+  PTRACE(1, "H235_DH\tElliptic curve key agreement not supported by this OpenSSL");
+  return FALSE;
+#endif
+}
+
+PBoolean H235_EllipticCurveDH::ComputeSessionKey(PBYTEArray & SessionKey)
+{
+  SessionKey.SetSize(0);
+  if (m_remotePublicKey.IsEmpty()) {
+    PTRACE(2, "H235_DH\tERROR Generating Shared EC DH: No remote key!");
+    return false;
+  }
+
+#ifdef H235_ECDH_SUPPORTED
+  PWaitAndSignal m(vbMutex);
+
+  if (m_key == NULL)
+    return false;
+
+  EVP_PKEY * peer = NULL;
+  if (m_keyType == EVP_PKEY_X25519)
+    peer = EVP_PKEY_new_raw_public_key(EVP_PKEY_X25519, NULL, m_remotePublicKey, m_remotePublicKey.GetSize());
+  else {
+    // setting the encoded point checks it is on the curve
+    peer = EVP_PKEY_new();
+    if (peer != NULL && (EVP_PKEY_copy_parameters(peer, m_key) <= 0 ||
+                         H235_SetEncodedPublicKey(peer, m_remotePublicKey, m_remotePublicKey.GetSize()) <= 0)) {
+      EVP_PKEY_free(peer);
+      peer = NULL;
+    }
+  }
+
+  if (peer == NULL) {
+    PTRACE(2, "H235_DH\tERROR Invalid remote EC public key");
+    return false;
+  }
+
+  size_t len = 0;
+  EVP_PKEY_CTX * ctx = EVP_PKEY_CTX_new(m_key, NULL);
+  PBoolean ok = ctx != NULL && EVP_PKEY_derive_init(ctx) > 0 &&
+                EVP_PKEY_derive_set_peer(ctx, peer) > 0 &&
+                EVP_PKEY_derive(ctx, NULL, &len) > 0 &&
+                EVP_PKEY_derive(ctx, SessionKey.GetPointer((PINDEX)len), &len) > 0;
+  if (ctx)
+    EVP_PKEY_CTX_free(ctx);
+  EVP_PKEY_free(peer);
+
+  if (!ok) {
+    PTRACE(2, "H235_DH\tERROR Generating Shared EC DH!");
+    SessionKey.SetSize(0);
+    return false;
+  }
+
+  SessionKey.SetSize((PINDEX)len);
+  return true;
+#else
+  return false;
+#endif
+}
+
+PBoolean H235_EllipticCurveDH::Save(const PFilePath & /*keyFile*/, const PString & /*oid*/)
+{
+  // Key pairs are per call, there are no parameters to save
+  return false;
+}
+
+PBoolean H235_EllipticCurveDH::Encode_P(PASN_BitString & /*p*/) const
+{
+  return false;
+}
+
+PBoolean H235_EllipticCurveDH::Encode_G(PASN_BitString & /*g*/) const
+{
+  return false;
+}
+
+void H235_EllipticCurveDH::Encode_HalfKey(PASN_BitString & hk) const
+{
+  PWaitAndSignal m(vbMutex);
+  hk.SetData(m_publicKey.GetSize()*8, m_publicKey);
+}
+
+void H235_EllipticCurveDH::SetRemoteHalfKey(const PASN_BitString & hk)
+{
+  PWaitAndSignal m(vbMutex);
+  m_remotePublicKey = PBYTEArray(hk.GetDataPointer(), (hk.GetSize()+7)/8);
+  m_wasReceived = !m_remotePublicKey.IsEmpty();
+}
+
+void H235_EllipticCurveDH::SetDHReceived(const PASN_BitString & /*p*/, const PASN_BitString & /*g*/)
+{
+  // The curve is fixed by the OID
+}
+
+
 #endif  // H323_H235
 
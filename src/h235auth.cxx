@@ -343,6 +343,8 @@ PBoolean H235Authenticator::GetAlgorithmDetails(const PString & /*algorithm*/,
 PINDEX   H235Authenticators::m_encryptionPolicy = 0;   // Default Encryption is disabled must be one of the H235MediaPolicy values
 PINDEX   H235Authenticators::m_cipherLength = 128;     // Ciphers above 128 must be expressly enabled.
 PINDEX   H235Authenticators::m_maxTokenLength = 1024;  // Tokens longer than 1024 bits must be expressly enabled.
+PINDEX   H235Authenticators::m_dhKeyPoolDepth = 0;     // DH key pairs are not generated in advance unless enabled.
+PBoolean H235Authenticators::m_ellipticCurve = false;  // Proprietary elliptic curve key agreement must be expressly enabled.
 PString  H235Authenticators::m_dhFile=PString();
 H235Authenticators::DH_DataList H235Authenticators::m_dhData;
 #endif
@@ -700,6 +702,26 @@ void H235Authenticators::SetMaxTokenLength(PINDEX len)
     m_maxTokenLength = len;
 }
 
+PINDEX H235Authenticators::GetDHKeyPoolDepth()
+{
+    return m_dhKeyPoolDepth;
+}
+
+void H235Authenticators::SetDHKeyPoolDepth(PINDEX depth)
+{
+    m_dhKeyPoolDepth = depth;
+}
+
+PBoolean H235Authenticators::GetEllipticCurveKeyAgreement()
+{
+    return m_ellipticCurve;
+}
+
+void H235Authenticators::SetEllipticCurveKeyAgreement(PBoolean enable)
+{
+    m_ellipticCurve = enable;
+}
+
 void H235Authenticators::SetEncryptionPolicy(PINDEX policy)
 {
     m_encryptionPolicy = policy;
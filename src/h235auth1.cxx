@@ -147,14 +147,19 @@ static void truncate(unsigned char*    d1,    /* data to be truncated */
     d2[i] = d1[i];
 }
 
-/* Function to compute the digest */
+/* Function to compute the digest, of the data with the HASH_SIZE bytes
+   at the gap taken as zero, so a PDU is hashed as encoded or received
+   without clearing its hash field first */
 static void hmac_sha (const unsigned char*    k,      /* secret key */
                       int      lk,              /* length of the key in bytes */
                       const unsigned char*    d,      /* data */
                       int      ld,              /* length of data in bytes */
+                      int      gap,             /* offset of the hash field in the data */
                       char*    out,             /* output buffer, at least "t" bytes */
                       int      t)
 {
+        static const unsigned char zeros[HASH_SIZE] = { 0 };
+
         EvpMdContext ictx, octx;
         unsigned char isha[SHA_DIGESTSIZE], osha[SHA_DIGESTSIZE];
         unsigned char key[SHA_DIGESTSIZE];
@@ -184,7 +189,9 @@ static void hmac_sha (const unsigned char*    k,      /* secret key */
         for (i = lk ; i < SHA_BLOCKSIZE ; ++i) buf[i] = 0x36;
 
         EVP_DigestUpdate(ictx, buf, SHA_BLOCKSIZE);
-        EVP_DigestUpdate(ictx, d, ld) ;
+        EVP_DigestUpdate(ictx, d, gap);
+        EVP_DigestUpdate(ictx, zeros, HASH_SIZE);
+        EVP_DigestUpdate(ictx, d + gap + HASH_SIZE, ld - gap - HASH_SIZE);
 
         EVP_DigestFinal_ex(ictx, isha, NULL);
 
@@ -237,6 +244,7 @@ H2351_Authenticator::H2351_Authenticator()
   //m_fullQ931Checking = true; // H.235.1 clause 13.2 requires full Q.931 checking
   m_fullQ931Checking = false; // remain compatible with old versions for now
   m_verifyRandomNumber = true; // switch off check for possible bug in ASN decoder
+  m_secretKeyValid = false;
 }
 
 
@@ -257,6 +265,17 @@ const char * H2351_Authenticator::GetName() const
   return "H.235.1";
 }
 
+
+const BYTE * H2351_Authenticator::GetSecretKey()
+{
+  if (!m_secretKeyValid || m_secretKeyPassword != password) {
+    SHA1(password, password.GetLength(), m_secretKey);
+    m_secretKeyPassword = password;
+    m_secretKeyValid = true;
+  }
+  return m_secretKey;
+}
+
 PStringArray H2351_Authenticator::GetAuthenticatorNames()
 {
     return PStringArray("Std1");
@@ -370,24 +389,19 @@ PBoolean H2351_Authenticator::Finalise(PBYTEArray & rawPDU)
     return FALSE;
   }
 
-  // Zero out the search pattern
-  memset(&rawPDU[foundat], 0, HASH_SIZE);
-
  /*******
   *
-  * generate a HMAC-SHA1 key over the hole message
-  * and save it in at (step 3) located position.
+  * generate a HMAC-SHA1 key over the hole message, with the search
+  * pattern as zeros, and save it in at (step 3) located position.
   * in the asn1 packet.
   */
 
   char key[HASH_SIZE];
 
   /** make a SHA1 hash before send to the hmac_sha1 */
-  unsigned char secretkey[20];
+  const BYTE * secretkey = GetSecretKey();
 
-  SHA1(password, password.GetLength(), secretkey);
-
-  hmac_sha(secretkey, 20, rawPDU.GetPointer(), rawPDU.GetSize(), key, HASH_SIZE);
+  hmac_sha(secretkey, 20, rawPDU.GetPointer(), rawPDU.GetSize(), foundat, key, HASH_SIZE);
 
   memcpy(&rawPDU[foundat], key, HASH_SIZE);
 
@@ -540,40 +554,23 @@ H235Authenticator::ValidationResult H2351_Authenticator::ValidateCryptoToken(
   const unsigned char *data = crHashed.m_token.m_hash.GetDataPointer();
   memcpy(RV, data, HASH_SIZE);
 
-  unsigned char secretkey[20];
-  SHA1(password, password.GetLength(), secretkey);
+  const BYTE * secretkey = GetSecretKey();
 
 
   /****
   * step 4
-  * lookup the variable int the orginal ASN1 packet
-  * and set it to 0.
+  * lookup the variable int the orginal ASN1 packet, the received bytes
+  * are hashed as they are with it taken as 0.
   */
-  PINDEX foundat = 0;
-  bool found = false;
+  PBoolean found = FALSE;
 
   const BYTE * asnPtr = rawPDU;
   PINDEX asnLen = rawPDU.GetSize();
-  while (foundat < asnLen - HASH_SIZE) {
-    for (PINDEX i = foundat; i <= asnLen - HASH_SIZE; i++) {
-      if (memcmp(asnPtr+i, data, HASH_SIZE) == 0) { // i'v found it !
-        foundat = i;
-        found = true;
-        break;
-      }
-    }
-
-    if (!found) {
-      if (foundat != 0)
-        break;
-
-      PTRACE(2, "H235RAS\tH2351_Authenticator could not locate embedded hash!");
-      return e_Error;
-    }
+  for (PINDEX foundat = 0; foundat <= asnLen - HASH_SIZE; foundat++) {
+    if (asnPtr[foundat] != data[0] || memcmp(asnPtr+foundat, data, HASH_SIZE) != 0)
+      continue;
 
-    found = false;
-
-    memset((BYTE *)asnPtr+foundat, 0, HASH_SIZE);
+    found = TRUE;
 
     /****
     * step 5
@@ -582,7 +579,7 @@ H235Authenticator::ValidationResult H2351_Authenticator::ValidateCryptoToken(
     */
 
     char key[HASH_SIZE];
-    hmac_sha(secretkey, 20, asnPtr, asnLen, key, HASH_SIZE);
+    hmac_sha(secretkey, 20, asnPtr, asnLen, foundat, key, HASH_SIZE);
 
     /****
     * step 6
@@ -597,9 +594,12 @@ H235Authenticator::ValidationResult H2351_Authenticator::ValidateCryptoToken(
       return e_OK;
     }
 
-    // Put it back and look for another
-    memcpy((BYTE *)asnPtr+foundat, data, HASH_SIZE);
-    foundat++;
+    // The same bytes may occur elsewhere, look for another
+  }
+
+  if (!found) {
+    PTRACE(2, "H235RAS\tH2351_Authenticator could not locate embedded hash!");
+    return e_Error;
   }
 
   PTRACE(1, "H235RAS\tH2351_Authenticator hash does not match.");
@@ -39,6 +39,10 @@
 #include "h323ep.h"
 #include "h323neg.h"
 #include "h323rtp.h"
+#include "h323mediawatch.h"
+#include "h323liveness.h"
+#include "h323mediaclock.h"
+#include "sigreactor.h"
 
 #ifdef H323_H450
 #include "h450/h4501.h"
@@ -94,6 +98,9 @@
 
 const PTimeInterval MonitorCallStatusTime(0, 10); // Seconds
 
+// Alternate endpoints of an ACF raced with the first by the call setup
+#define H323_MAX_ALTERNATE_ENDPOINTS 7
+
 #define new PNEW
 
 #ifdef H323_SIGNAL_AGGREGATE
@@ -178,6 +185,58 @@ class AggregatedH245Handle : public H323AggregatedH2x5Handle
 
 #endif
 
+class ReactorH225Handle : public H323SignallingHandle
+{
+  PCLASSINFO(ReactorH225Handle, H323SignallingHandle)
+  public:
+    ReactorH225Handle(H323Transport & _transport, H323Connection & _connection)
+      : H323SignallingHandle(_transport, _connection)
+    {
+    }
+
+    PBoolean HandlePDU(PBoolean ok, PBYTEArray & dataPDU)
+    {
+      H323SignalPDU pdu;
+      if (ok) {
+        ok = pdu.ProcessReadData(transport, dataPDU);
+        // skip keep-alives
+        if (ok && pdu.GetQ931().GetMessageType() == 0)
+          return TRUE;
+      }
+      return connection.HandleReceivedSignalPDU(ok, pdu);
+    }
+
+    void OnClose()
+    {
+      connection.EndHandleSignallingChannel();
+    }
+};
+
+
+class ReactorH245Handle : public H323SignallingHandle
+{
+  PCLASSINFO(ReactorH245Handle, H323SignallingHandle)
+  public:
+    ReactorH245Handle(H323Transport & _transport, H323Connection & _connection)
+      : H323SignallingHandle(_transport, _connection)
+    {
+    }
+
+    PBoolean HandlePDU(PBoolean ok, PBYTEArray & pdu)
+    {
+      PPER_Stream strm(pdu);
+      PBoolean result = connection.HandleReceivedControlPDU(ok, strm);
+      connection.MonitorCallStatus();
+      return result;
+    }
+
+    void OnClose()
+    {
+      connection.EndHandleControlChannel();
+      PTRACE(2, "H245\tControl channel closed.");
+    }
+};
+
 /////////////////////////////////////////////////////////////////////////////
 
 #if PTRACING
@@ -352,12 +411,12 @@ static void ReceiveFeatureSet(const H323Connection * connection, unsigned code,
 
 template <typename PDUType>
 static PBoolean ReceiveAuthenticatorPDU(const H323Connection * connection,
-                                   const PDUType & pdu, unsigned code)
+                                   const PDUType & pdu, unsigned code,
+                                   const PBYTEArray & rawPDU)
 {
 
 PBoolean AuthResult = FALSE;
 H235Authenticators authenticators = connection->GetEPAuthenticators();
-PBYTEArray strm;
 
   if (!pdu.HasOptionalField(PDUType::e_tokens) && !pdu.HasOptionalField(PDUType::e_cryptoTokens)) {
         PTRACE(2, "H235EP\tReceived unsecured EPAuthentication message (no crypto tokens),"
@@ -372,7 +431,7 @@ PBYTEArray strm;
   } else {
 
     H235Authenticator::ValidationResult result = authenticators.ValidateSignalPDU(code,
-                                                    pdu.m_tokens, pdu.m_cryptoTokens,strm);
+                                                    pdu.m_tokens, pdu.m_cryptoTokens, rawPDU);
       if (result == H235Authenticator::e_Failed) {
           PTRACE(4, "H235EP\tSecurity Failure!");
           return false;
@@ -404,14 +463,20 @@ H323Connection::H323Connection(H323EndPoint & ep,
     localAliasNames(ep.GetAliasNames()),
     localPartyName(ep.GetLocalUserName()),
 	localLanguages(ep.GetLocalLanguages()),
+#ifdef H323_H235
     localCapabilities(ep.GetCapabilities()),
+#endif
     gkAccessTokenOID(ep.GetGkAccessTokenOID()),
     alertingTime(0),
     connectedTime(0),
     callEndTime(0),
     reverseMediaOpenTime(0),
+    memoryFootprint(0),
     noMediaTimeOut(ep.GetNoMediaTimeout().GetMilliSeconds()),
+    mediaActivity(NULL),
     roundTripDelayRate(ep.GetRoundTripDelayRate().GetMilliSeconds()),
+    nextRoundTripDelay(0),
+    roundTripLiveness(NULL),
     releaseSequence(ReleaseSequenceUnknown)
     ,EPAuthenticators(ep.CreateEPAuthenticators())
 #ifdef H323_H239
@@ -420,9 +485,26 @@ H323Connection::H323Connection(H323EndPoint & ep,
 #ifdef H323_H460
     ,features(ep.GetFeatureSet())
 #endif
+    ,outerMutex("H323Connection::outerMutex")
+    ,innerMutex("H323Connection::innerMutex")
 {
   localAliasNames.MakeUnique();
 
+  remoteCapabilityMemo = NULL;
+
+#ifndef H323_H235
+  if (ep.GetCapabilitySharing())
+    ep.ShareCapabilities(localCapabilities);
+  else
+    localCapabilities = ep.GetCapabilities();
+#endif
+
+  endpoint.GetMetrics().callsTotal.Add();
+  endpoint.GetMetrics().callsActive.Add(1);
+
+  static PAtomicInteger lastTraceTag;
+  traceTag = (DWORD)++lastTraceTag;
+
   callAnswered = FALSE;
   gatekeeperRouted = FALSE;
   distinctiveRing = 0;
@@ -470,6 +552,9 @@ H323Connection::H323Connection(H323EndPoint & ep,
   callEndReason = NumCallEndReasons;
   q931Cause = Q931::ErrorInCauseIE;
 
+  readLockCount = 0;
+  lockNesting = 0;
+
   bandwidthAvailable = endpoint.GetInitialBandwidth();
 
   useQ931Display = endpoint.UseQ931Display();
@@ -527,8 +612,11 @@ H323Connection::H323Connection(H323EndPoint & ep,
 
   doH245QoS = !ep.IsH245QoSDisabled();
 
+  remoteVideoNack = FALSE;
 #ifdef H323_AUDIO_CODECS
   remoteMaxAudioDelayJitter = 0;
+  remoteMulticastCapable = FALSE;
+  remoteAudioRedundancy = FALSE;
   minAudioJitterDelay = endpoint.GetMinAudioJitterDelay();
   maxAudioJitterDelay = endpoint.GetMaxAudioJitterDelay();
 #endif
@@ -552,19 +640,28 @@ H323Connection::H323Connection(H323EndPoint & ep,
   logicalChannels = new H245NegLogicalChannels(endpoint, *this);
   requestModeProcedure = new H245NegRequestMode(endpoint, *this);
   roundTripDelayProcedure = new H245NegRoundTripDelay(endpoint, *this);
+  AddMemoryFootprint(sizeof(H323Connection) +
+                     sizeof(H245NegMasterSlaveDetermination) +
+                     sizeof(H245NegTerminalCapabilitySet) +
+                     sizeof(H245NegLogicalChannels) +
+                     sizeof(H245NegRequestMode) +
+                     sizeof(H245NegRoundTripDelay));
 
 #ifdef H323_H450
-  h450dispatcher = new H450xDispatcher(*this);
-  h4502handler = new H4502Handler(*this, *h450dispatcher);
-  h4503handler = new H4503Handler(*this, *h450dispatcher);
-  h4504handler = new H4504Handler(*this, *h450dispatcher);
-  h4506handler = new H4506Handler(*this, *h450dispatcher);
-  h45011handler = new H45011Handler(*this, *h450dispatcher);
+  // Made by CreateH450Handlers() when first needed
+  h450dispatcher = NULL;
+  h4502handler = NULL;
+  h4503handler = NULL;
+  h4504handler = NULL;
+  h4506handler = NULL;
+  h45011handler = NULL;
 #endif
 
   rfc2833InBandDTMF = !ep.RFC2833InBandDTMFDisabled();
-  if (rfc2833InBandDTMF)
+  if (rfc2833InBandDTMF) {
     rfc2833handler = new OpalRFC2833(PCREATE_NOTIFIER(OnUserInputInlineRFC2833));
+    rfc2833handler->SetScheduler(ep.GetRFC2833Scheduler());
+  }
   else
     rfc2833handler = NULL;
 
@@ -593,6 +690,9 @@ H323Connection::H323Connection(H323EndPoint & ep,
 #ifdef H323_RTP_AGGREGATE
   useRTPAggregation        = (options & RTPAggregationMask)        != RTPAggregationDisable;
 #endif
+  signalHandle = NULL;
+  controlHandle = NULL;
+
 #ifdef H323_SIGNAL_AGGREGATE
   signalAggregator = NULL;
   controlAggregator = NULL;
@@ -654,12 +754,20 @@ H323Connection::H323Connection(H323EndPoint & ep,
 
 H323Connection::~H323Connection()
 {
+  endpoint.GetMetrics().callsActive.Add(-1);
+  AddMemoryFootprint(-memoryFootprint);
+
+  H323Capabilities::ReleaseSnapshot(remoteCapabilityMemo);
 
   delete masterSlaveDeterminationProcedure;
   delete capabilityExchangeProcedure;
   delete logicalChannels;
+  if (mediaActivity != NULL)
+    endpoint.GetMediaWatchdog()->Unregister(mediaActivity);
   delete requestModeProcedure;
   delete roundTripDelayProcedure;
+  if (roundTripLiveness != NULL)
+    roundTripLiveness->RemoveCall(roundTripPeer, callToken);
 #ifdef H323_AEC
   delete aec;
 #endif
@@ -686,15 +794,6 @@ H323Connection::~H323Connection()
 #endif
 #ifdef H323_H460
   delete features;
-#ifdef H323_H4609
-  if (m_h4609Stats.GetSize() > 0) {
-    H4609Statistics * stat = m_h4609Stats.Dequeue();
-    while (stat) {
-        delete stat;
-        stat = m_h4609Stats.Dequeue();
-    }
-  }
-#endif
 #endif
 #ifdef P_STUN
     m_NATSockets.clear();
@@ -720,6 +819,7 @@ PBoolean H323Connection::Lock()
   }
 
   innerMutex.Wait();
+  WaitForReadLocks();
   return TRUE;
 }
 
@@ -735,14 +835,85 @@ int H323Connection::TryLock()
   }
 
   innerMutex.Wait();
+  WaitForReadLocks();
   return 1;
 }
 
 
 void H323Connection::Unlock()
 {
+  lockNesting--;
+  innerMutex.Signal();
+  outerMutex.Signal();
+}
+
+
+void H323Connection::WaitForReadLocks()
+{
+  // Called holding innerMutex, so no more read locks can be taken. A nested
+  // Lock() already waited, and any read lock since is by the same thread.
+  if (lockNesting++ > 0)
+    return;
+
+  for (;;) {
+    readLockMutex.Wait();
+    PBoolean none = readLockCount == 0;
+    readLockMutex.Signal();
+    if (none)
+      return;
+    readLocksReleased.Wait();
+  }
+}
+
+
+PBoolean H323Connection::LockReadOnly()
+{
+  outerMutex.Wait();
+
+  if (connectionState == ShuttingDownConnection) {
+    outerMutex.Signal();
+    return FALSE;
+  }
+
+  // The mutexes are only held while counting, so readers do not exclude each other
+  innerMutex.Wait();
+  readLockMutex.Wait();
+  readLockCount++;
+  readLockMutex.Signal();
+  innerMutex.Signal();
+  outerMutex.Signal();
+  return TRUE;
+}
+
+
+int H323Connection::TryLockReadOnly()
+{
+  if (!outerMutex.Wait(0))
+    return -1;
+
+  if (connectionState == ShuttingDownConnection) {
+    outerMutex.Signal();
+    return 0;
+  }
+
+  innerMutex.Wait();
+  readLockMutex.Wait();
+  readLockCount++;
+  readLockMutex.Signal();
   innerMutex.Signal();
   outerMutex.Signal();
+  return 1;
+}
+
+
+void H323Connection::UnlockReadOnly()
+{
+  readLockMutex.Wait();
+  PBoolean last = --readLockCount == 0;
+  readLockMutex.Signal();
+
+  if (last)
+    readLocksReleased.Signal();
 }
 
 
@@ -773,7 +944,8 @@ void H323Connection::SetCallEndReason(CallEndReason reason, PSyncPoint * sync)
   rcPDU.BuildReleaseComplete(*this);
 
 #ifdef H323_H450
-  h450dispatcher->AttachToReleaseComplete(rcPDU);
+  if (h450dispatcher != NULL)
+    h450dispatcher->AttachToReleaseComplete(rcPDU);
 #endif
 
   PBoolean sendingReleaseComplete = OnSendReleaseComplete(rcPDU);
@@ -812,6 +984,8 @@ void H323Connection::CleanUpOnCallEnd()
 {
   PTRACE(3, "H323\tConnection " << callToken << " closing: connectionState=" << connectionState);
 
+  MarkCallTiming(H323CallTimeline::e_Cleared);
+
   /* The following double mutex is designed to guarentee that there is no
      deadlock or access of deleted object with a random thread that may have
      just called Lock() at the instant we are trying to get rid of the
@@ -822,6 +996,7 @@ void H323Connection::CleanUpOnCallEnd()
   connectionState = ShuttingDownConnection;
   outerMutex.Signal();
   innerMutex.Wait();
+  WaitForReadLocks();
 
   // Unblock sync points
   digitsWaitFlag.Signal();
@@ -830,8 +1005,11 @@ void H323Connection::CleanUpOnCallEnd()
   masterSlaveDeterminationProcedure->Stop();
   capabilityExchangeProcedure->Stop();
 
-  // Clean up any fast start "pending" channels we may have running.
+  // Clean up any fast start "pending" channels we may have running, all of
+  // them are stopped before waiting on any so they run down together.
   PINDEX i;
+  for (i = 0; i < fastStartChannels.GetSize(); i++)
+    fastStartChannels[i].StartTermination();
   for (i = 0; i < fastStartChannels.GetSize(); i++)
     fastStartChannels[i].CleanUpOnTermination();
   fastStartChannels.RemoveAll();
@@ -839,7 +1017,8 @@ void H323Connection::CleanUpOnCallEnd()
   // Dispose of all the logical channels
   logicalChannels->RemoveAll();
 
-  if (endSessionNeeded) {
+  // Remotes are not waited for while clearing every call in bulk
+  if (endSessionNeeded && !endpoint.IsClearingInBulk()) {
     // Calculate time since we sent the end session command so we do not actually
     // wait for returned endSession if it has already been that long
     PTimeInterval waitTime = endpoint.GetEndSessionTimeout();
@@ -859,6 +1038,18 @@ void H323Connection::CleanUpOnCallEnd()
     }
   }
 
+  // Stop the reactor reading the channels before their sockets are closed
+  if (controlHandle != NULL) {
+    endpoint.GetSignallingReactor()->RemoveHandle(*controlHandle);
+    delete controlHandle;
+    controlHandle = NULL;
+  }
+  if (signalHandle != NULL) {
+    endpoint.GetSignallingReactor()->RemoveHandle(*signalHandle);
+    delete signalHandle;
+    signalHandle = NULL;
+  }
+
   // Wait for control channel to be cleaned up (thread ended).
   if (controlChannel != NULL)
     controlChannel->CleanUpOnTermination();
@@ -877,8 +1068,9 @@ void H323Connection::CleanUpOnCallEnd()
     endpoint.GetSignallingAggregator()->RemoveHandle(signalAggregator);
 #endif
 
-  // Check for gatekeeper and do disengage if have one
-  if (mustSendDRQ) {
+  // Check for gatekeeper and do disengage if have one, unless the whole
+  // registration goes with a URQ
+  if (mustSendDRQ && !endpoint.IsDisengageSkipped()) {
     H323Gatekeeper * gatekeeper = endpoint.GetGatekeeper();
     if (gatekeeper != NULL)
       gatekeeper->DisengageRequest(*this, H225_DisengageReason::e_normalDrop);
@@ -887,6 +1079,12 @@ void H323Connection::CleanUpOnCallEnd()
   PTRACE(1, "H323\tConnection " << callToken << " terminated.");
 }
 
+void H323Connection::StartMediaTermination()
+{
+  logicalChannels->StartTerminationAll();
+}
+
+
 void H323Connection::AttachSignalChannel(const PString & token,
                                          H323Transport * channel,
                                          PBoolean answeringCall)
@@ -903,6 +1101,10 @@ void H323Connection::AttachSignalChannel(const PString & token,
 
   // Set our call token for identification in endpoint dictionary
   callToken = token;
+  H323HotTrace::NameCall(traceTag, callToken);
+
+  if (noMediaTimeOut > 0 && mediaActivity == NULL)
+    mediaActivity = endpoint.GetMediaWatchdog()->Register(callToken, noMediaTimeOut);
 
   SetAuthenticationConnection();
 }
@@ -932,6 +1134,27 @@ void H323Connection::ChangeSignalChannel(H323Transport * channel)
 }
 
 
+static void MarkSignalTiming(const H323Connection & connection, const Q931 & q931)
+{
+  switch (q931.GetMessageType()) {
+    case Q931::SetupMsg :
+      connection.MarkCallTiming(H323CallTimeline::e_SetupReceived);
+      break;
+    case Q931::CallProceedingMsg :
+      connection.MarkCallTiming(H323CallTimeline::e_CallProceeding);
+      break;
+    case Q931::AlertingMsg :
+      connection.MarkCallTiming(H323CallTimeline::e_Alerting);
+      break;
+    case Q931::ConnectMsg :
+      connection.MarkCallTiming(H323CallTimeline::e_Connect);
+      break;
+    default :
+      break;
+  }
+}
+
+
 PBoolean H323Connection::WriteSignalPDU(H323SignalPDU & pdu)
 {
   lastPDUWasH245inSETUP = FALSE;
@@ -971,6 +1194,8 @@ PBoolean H323Connection::WriteSignalPDU(H323SignalPDU & pdu)
 
   if (!success)
     ClearCall(EndedByTransportFail);
+  else if (pdu.GetQ931().GetMessageType() != Q931::SetupMsg)
+    MarkSignalTiming(*this, pdu.GetQ931());
 
   return success;
 }
@@ -990,6 +1215,28 @@ void H323Connection::HandleSignallingChannel()
       break;
   }
 
+  EndHandleSignallingChannel();
+}
+
+PBoolean H323Connection::ReactorSignalChannel(H323Transport * transport)
+{
+  H323SignallingReactor * reactor = endpoint.GetSignallingReactor();
+  if (reactor == NULL || signalHandle != NULL || !H323SignallingHandle::IsServiceable(*transport))
+    return FALSE;
+
+  H323SignallingHandle * handle = new ReactorH225Handle(*transport, *this);
+  if (!reactor->AddHandle(*handle)) {
+    delete handle;
+    return FALSE;
+  }
+
+  signalHandle = handle;
+  PTRACE(2, "H225\tReading PDUs in reactor: callRef=" << callReference);
+  return TRUE;
+}
+
+void H323Connection::EndHandleSignallingChannel()
+{
   // If we are the only link to the far end then indicate that we have
   // received endSession even if we hadn't, because we are now never going
   // to get one so there is no point in having CleanUpOnCallEnd wait.
@@ -1067,17 +1314,22 @@ PBoolean CallEstablishmentMessage(const Q931 & q931)
 
 PBoolean H323Connection::HandleSignalPDU(H323SignalPDU & pdu)
 {
+  endpoint.GetMetrics().signalPDUsReceived.Add();
+
   // Process the PDU.
   const Q931 & q931 = pdu.GetQ931();
+  H323_HOTTRACE_SCOPE(e_SignalPDU, traceTag, q931.GetMessageType());
 
   PTRACE(3, "H225\tHandling PDU: " << q931.GetMessageTypeName()
                     << " callRef=" << q931.GetCallReference());
 
+  MarkSignalTiming(*this, q931);
+
   if (!Lock()) {
     // Continue to look for endSession/releaseComplete pdus
     if (pdu.m_h323_uu_pdu.m_h245Tunneling) {
       for (PINDEX i = 0; i < pdu.m_h323_uu_pdu.m_h245Control.GetSize(); i++) {
-        PPER_Stream strm = pdu.m_h323_uu_pdu.m_h245Control[i].GetValue();
+        H323_PERStream strm = pdu.m_h323_uu_pdu.m_h245Control[i].GetValue();
         if (!InternalEndSessionCheck(strm))
           break;
       }
@@ -1103,6 +1355,7 @@ PBoolean H323Connection::HandleSignalPDU(H323SignalPDU & pdu)
 #ifdef H323_H450
   // Check for presence of supplementary services
   if (pdu.m_h323_uu_pdu.HasOptionalField(H225_H323_UU_PDU::e_h4501SupplementaryService)) {
+    CreateH450Handlers();
     if (!h450dispatcher->HandlePDU(pdu)) { // Process H4501SupplementaryService APDU
       Unlock();
       return FALSE;
@@ -1250,7 +1503,7 @@ void H323Connection::HandleTunnelPDU(H323SignalPDU * txPDU)
     capabilityExchangeProcedure->Stop();
   } else {
     for (i = 0; i < h245TunnelRxPDU->m_h323_uu_pdu.m_h245Control.GetSize(); i++) {
-      PPER_Stream strm = h245TunnelRxPDU->m_h323_uu_pdu.m_h245Control[i].GetValue();
+      H323_PERStream strm = h245TunnelRxPDU->m_h323_uu_pdu.m_h245Control[i].GetValue();
       HandleControlData(strm);
     }
   }
@@ -1263,7 +1516,7 @@ void H323Connection::HandleTunnelPDU(H323SignalPDU * txPDU)
 
     if (setup.HasOptionalField(H225_Setup_UUIE::e_parallelH245Control)) {
       for (i = 0; i < setup.m_parallelH245Control.GetSize(); i++) {
-        PPER_Stream strm = setup.m_parallelH245Control[i].GetValue();
+        H323_PERStream strm = setup.m_parallelH245Control[i].GetValue();
         HandleControlData(strm);
       }
 
@@ -1280,10 +1533,22 @@ void H323Connection::HandleTunnelPDU(H323SignalPDU * txPDU)
 }
 
 
-static PBoolean BuildFastStartList(const H323Channel & channel,
+static PBoolean BuildFastStartList(const H323Connection & connection,
+                               const H323Channel & channel,
                                H225_ArrayOf_PASN_OctetString & array,
                                H323Channel::Directions reverseDirection)
 {
+  H323EndPoint & endpoint = connection.GetEndPoint();
+  PBoolean reverse = channel.GetDirection() == reverseDirection;
+  PINDEX last = array.GetSize();
+
+  PASN_OctetString remembered;
+  if (endpoint.GetFastStartMemo(connection, channel, reverse, remembered)) {
+    array.SetSize(last+1);
+    array[last] = remembered;
+    return TRUE;
+  }
+
   H245_OpenLogicalChannel open;
   const H323Capability & capability = channel.GetCapability();
 
@@ -1305,9 +1570,9 @@ static PBoolean BuildFastStartList(const H323Channel & channel,
     return FALSE;
 
   PTRACE(4, "H225\tBuild fastStart:\n  " << setprecision(2) << open);
-  PINDEX last = array.GetSize();
   array.SetSize(last+1);
   array[last].EncodeSubType(open);
+  endpoint.SetFastStartMemo(connection, channel, reverse, open, array[last]);
 
   PTRACE(3, "H225\tBuilt fastStart for " << capability);
   return TRUE;
@@ -1324,6 +1589,26 @@ void H323Connection::OnCleared()
 }
 
 
+void H323Connection::GetCallRecord(H323CallRecord & record) const
+{
+  record = mediaRecord;
+
+  record.source = H323CallRecord::e_EndPoint;
+  record.originating = !callAnswered;
+  record.endReason = (WORD)callEndReason;
+  memcpy(record.callIdentifier, (const BYTE *)callIdentifier, sizeof(record.callIdentifier));
+  record.setupTime = H323CallRecord::GetTimestamp(setupTime);
+  record.connectTime = H323CallRecord::GetTimestamp(connectedTime);
+  record.endTime = H323CallRecord::GetTimestamp(callEndTime);
+
+  const PString & calling = callAnswered ? remotePartyName : localPartyName;
+  const PString & called = callAnswered ? localPartyName : remotePartyName;
+  H323CallRecord::SetField(record.callingAlias, sizeof(record.callingAlias), calling);
+  H323CallRecord::SetField(record.calledAlias, sizeof(record.calledAlias), called);
+  H323CallRecord::SetField(record.remoteAddress, sizeof(record.remoteAddress), remotePartyAddress);
+}
+
+
 void H323Connection::SetRemoteVersions(const H225_ProtocolIdentifier & protocolIdentifier)
 {
   if (protocolIdentifier.GetSize() < 6)
@@ -1416,7 +1701,7 @@ PBoolean H323Connection::OnReceivedSignalSetup(const H323SignalPDU & setupPDU)
 
   /// Do Authentication of Incoming Call before anything else
   if (!ReceiveAuthenticatorPDU<H225_Setup_UUIE>(this,setup,
-                            H225_H323_UU_PDU_h323_message_body::e_setup)) {
+                            H225_H323_UU_PDU_h323_message_body::e_setup, setupPDU.GetRawPDU())) {
      if (GetEndPoint().GetEPSecurityPolicy() == H323EndPoint::SecRequired) {
         PTRACE(4, "H235EP\tAuthentication Failed. Ending Call");
         AuthenticationFailed = TRUE;
@@ -1461,6 +1746,7 @@ PBoolean H323Connection::OnReceivedSignalSetup(const H323SignalPDU & setupPDU)
   if (setup.HasOptionalField(H225_Setup_UUIE::e_callIdentifier))
     callIdentifier = setup.m_callIdentifier.m_guid;
   conferenceIdentifier = setup.m_conferenceID;
+  endpoint.OnConnectionIdentifiersChanged(*this);
   SetRemoteApplication(setup.m_sourceInfo);
 
   // Determine the remote parties name/number/address as best we can
@@ -1503,8 +1789,10 @@ PBoolean H323Connection::OnReceivedSignalSetup(const H323SignalPDU & setupPDU)
   mediaWaitForConnect = setup.m_mediaWaitForConnect;
 
   // Get the local capabilities before fast start or tunnelled TCS is handled
-   if (!nonCallConnection)
+   if (!nonCallConnection) {
       OnSetLocalCapabilities();
+      OrderLocalCapabilitiesByCost();
+   }
 
   // Send back a H323 Call Proceeding PDU in case OnIncomingCall() takes a while
   PTRACE(3, "H225\tSending call proceeding PDU");
@@ -1702,6 +1990,7 @@ PBoolean H323Connection::OnReceiveCallIndependentSupplementaryService(const H323
 #ifdef H323_H450
     if (pdu.m_h323_uu_pdu.HasOptionalField(H225_H323_UU_PDU::e_h4501SupplementaryService)) {
         PTRACE(2,"CON\tReceived H.450 Call Independent Supplementary Service");
+        CreateH450Handlers();
         return h450dispatcher->HandlePDU(pdu);
     }
 #endif
@@ -1764,7 +2053,7 @@ PBoolean H323Connection::OnReceivedCallProceeding(const H323SignalPDU & pdu)
   SetRemoteApplication(call.m_destinationInfo);
 
   if (!ReceiveAuthenticatorPDU<H225_CallProceeding_UUIE>(this,call,
-                 H225_H323_UU_PDU_h323_message_body::e_callProceeding)) {
+                 H225_H323_UU_PDU_h323_message_body::e_callProceeding, pdu.GetRawPDU())) {
 //          don't do anything
   }
 
@@ -1825,7 +2114,7 @@ PBoolean H323Connection::OnReceivedAlerting(const H323SignalPDU & pdu)
   SetRemoteApplication(alert.m_destinationInfo);
 
   if (!ReceiveAuthenticatorPDU<H225_Alerting_UUIE>(this,alert,
-                         H225_H323_UU_PDU_h323_message_body::e_alerting)){
+                         H225_H323_UU_PDU_h323_message_body::e_alerting, pdu.GetRawPDU())){
 //          don't do anything
   }
 
@@ -1885,7 +2174,7 @@ PBoolean H323Connection::OnReceivedSignalConnect(const H323SignalPDU & pdu)
   }
 
    if (!ReceiveAuthenticatorPDU<H225_Connect_UUIE>(this,connect,
-                         H225_H323_UU_PDU_h323_message_body::e_connect)) {
+                         H225_H323_UU_PDU_h323_message_body::e_connect, pdu.GetRawPDU())) {
 //          don't do anything
    }
 
@@ -1900,7 +2189,8 @@ PBoolean H323Connection::OnReceivedSignalConnect(const H323SignalPDU & pdu)
 
 #ifdef H323_H450
   // Are we involved in a transfer with a non H.450.2 compatible transferred-to endpoint?
-  if (h4502handler->GetState() == H4502Handler::e_ctAwaitSetupResponse &&
+  if (h4502handler != NULL &&
+      h4502handler->GetState() == H4502Handler::e_ctAwaitSetupResponse &&
       h4502handler->IsctTimerRunning())
   {
     PTRACE(4, "H4502\tRemote Endpoint does not support H.450.2.");
@@ -1976,7 +2266,7 @@ PBoolean H323Connection::OnReceivedFacility(const H323SignalPDU & pdu)
   const H225_Facility_UUIE & fac = pdu.m_h323_uu_pdu.m_h323_message_body;
 
   if (!ReceiveAuthenticatorPDU<H225_Facility_UUIE>(this,fac,
-                            H225_H323_UU_PDU_h323_message_body::e_facility)) {
+                            H225_H323_UU_PDU_h323_message_body::e_facility, pdu.GetRawPDU())) {
 //          don't do anything
   }
 
@@ -2141,7 +2431,8 @@ void H323Connection::OnReceivedReleaseComplete(const H323SignalPDU & pdu)
 
 #ifdef H323_H450
       // Are we involved in a transfer with a non H.450.2 compatible transferred-to endpoint?
-      if (h4502handler->GetState() == H4502Handler::e_ctAwaitSetupResponse &&
+      if (h4502handler != NULL &&
+          h4502handler->GetState() == H4502Handler::e_ctAwaitSetupResponse &&
           h4502handler->IsctTimerRunning())
       {
         PTRACE(4, "H4502\tThe Remote Endpoint has rejected our transfer request and does not support H.450.2.");
@@ -2374,7 +2665,8 @@ void H323Connection::AnsweringCall(AnswerCallResponse response)
           HandleTunnelPDU(alertingPDU);
 
 #ifdef H323_H450
-          h450dispatcher->AttachToAlerting(*alertingPDU);
+          if (h450dispatcher != NULL)
+            h450dispatcher->AttachToAlerting(*alertingPDU);
 #endif
 
           WriteSignalPDU(*alertingPDU);
@@ -2392,7 +2684,8 @@ void H323Connection::AnsweringCall(AnswerCallResponse response)
         HandleTunnelPDU(alertingPDU);
 
 #ifdef H323_H450
-        h450dispatcher->AttachToAlerting(*alertingPDU);
+        if (h450dispatcher != NULL)
+          h450dispatcher->AttachToAlerting(*alertingPDU);
 #endif
 
         // commented out by CRS: no need to check for lack of fastStart channels
@@ -2429,7 +2722,8 @@ void H323Connection::AnsweringCall(AnswerCallResponse response)
         HandleTunnelPDU(alertingPDU);
 
 #ifdef H323_H450
-        h450dispatcher->AttachToAlerting(*alertingPDU);
+        if (h450dispatcher != NULL)
+          h450dispatcher->AttachToAlerting(*alertingPDU);
 #endif
         WriteSignalPDU(*alertingPDU);
         alertingTime = PTime();
@@ -2456,7 +2750,8 @@ void H323Connection::AnsweringCall(AnswerCallResponse response)
         connectionState = HasExecutedSignalConnect;
 
 #ifdef H323_H450
-        h450dispatcher->AttachToConnect(*connectPDU);
+        if (h450dispatcher != NULL)
+          h450dispatcher->AttachToConnect(*connectPDU);
 #endif
         if (!nonCallConnection) {
             if (h245Tunneling) {
@@ -2517,7 +2812,8 @@ H323Connection::CallEndReason H323Connection::SendSignalSetup(const PString & al
   H225_Setup_UUIE & setup = setupPDU.BuildSetup(*this, address);
 
 #ifdef H323_H450
-  h450dispatcher->AttachToSetup(setupPDU);
+  if (h450dispatcher != NULL)
+    h450dispatcher->AttachToSetup(setupPDU);
 #endif
 
   // Save the identifiers generated by BuildSetup
@@ -2531,18 +2827,23 @@ H323Connection::CallEndReason H323Connection::SendSignalSetup(const PString & al
   PStringList callLanguages;
   if (gatekeeper != NULL) {
     H323Gatekeeper::AdmissionResponse response;
-    response.transportAddress = &gatekeeperRoute;
+    H323TransportAddress routes[H323_MAX_ALTERNATE_ENDPOINTS+1];
+    routes[0] = gatekeeperRoute;
+    response.transportAddress = routes;
     response.aliasAddresses = &newAliasAddresses;
     response.languageSupport = &callLanguages;
     if (!gkAccessTokenOID)
       response.accessTokenData = &gkAccessTokenData;
+    else // Without a token to keep for each, alternate endpoints can be taken
+      response.endpointCount = PARRAYSIZE(routes);
     while (!gatekeeper->AdmissionRequest(*this, response, alias.IsEmpty())) {
       PTRACE(1, "H225\tGatekeeper refused admission: "
              << (response.rejectReason == UINT_MAX
                   ? PString("Transport error")
                   : H225_AdmissionRejectReason(response.rejectReason).GetTagName()));
 #ifdef H323_H450
-      h4502handler->onReceivedAdmissionReject(H4501_GeneralErrorList::e_notAvailable);
+      if (h4502handler != NULL)
+        h4502handler->onReceivedAdmissionReject(H4501_GeneralErrorList::e_notAvailable);
 #endif
 
       switch (response.rejectReason) {
@@ -2572,11 +2873,16 @@ H323Connection::CallEndReason H323Connection::SendSignalSetup(const PString & al
       }
     }
     mustSendDRQ = TRUE;
+    gatekeeperRoute = routes[0];
     if (response.gatekeeperRouted) {
       setup.IncludeOptionalField(H225_Setup_UUIE::e_endpointIdentifier);
       setup.m_endpointIdentifier = gatekeeper->GetEndpointIdentifier();
       gatekeeperRouted = TRUE;
     }
+    else {
+      for (PINDEX i = 1; i < response.endpointCount && i < (PINDEX)PARRAYSIZE(routes); i++)
+        alternateSignalAddresses.AppendAddress(routes[i]);
+    }
   }
 
   // Update the field e_destinationAddress in the SETUP PDU to reflect the new
@@ -2646,9 +2952,20 @@ H323Connection::CallEndReason H323Connection::SendSignalSetup(const PString & al
       PBoolean connectFailed = false;
       if (!signallingChannel->IsOpen()) {
         signallingChannel->SetWriteTimeout(100);
-        connectFailed = !signallingChannel->Connect();
+        if (gatekeeperRouted || alternateSignalAddresses.IsEmpty())
+          connectFailed = !signallingChannel->Connect();
+        else {
+          // Race the other addresses of the party rather than wait on each
+          H323TransportAddressArray candidates(gatekeeperRoute);
+          for (PINDEX i = 0; i < alternateSignalAddresses.GetSize(); i++)
+            candidates.AppendAddress(alternateSignalAddresses[i]);
+          connectFailed = !signallingChannel->ConnectAny(candidates);
+        }
       }
 
+      if (!connectFailed)
+        MarkCallTiming(H323CallTimeline::e_TransportConnected);
+
       // See if transport connect failed, abort if so.
       if (connectFailed) {
         connectionState = NoConnectionActive;
@@ -2702,6 +3019,7 @@ if (setup.m_conferenceGoal.GetTag() == H225_Setup_UUIE_conferenceGoal::e_create)
 
   // Get the local capabilities before fast start is handled
   OnSetLocalCapabilities();
+  OrderLocalCapabilitiesByCost();
 
   // Adjust the local userInput capabilities.
   OnSetLocalUserInputCapabilities();
@@ -2715,7 +3033,7 @@ if (setup.m_conferenceGoal.GetTag() == H225_Setup_UUIE_conferenceGoal::e_create)
   if (!fastStartChannels.IsEmpty()) {
     PTRACE(3, "H225\tFast start begun by local endpoint");
     for (PINDEX i = 0; i < fastStartChannels.GetSize(); i++)
-      BuildFastStartList(fastStartChannels[i], setup.m_fastStart, H323Channel::IsReceiver);
+      BuildFastStartList(*this, fastStartChannels[i], setup.m_fastStart, H323Channel::IsReceiver);
     if (setup.m_fastStart.GetSize() > 0)
       setup.IncludeOptionalField(H225_Setup_UUIE::e_fastStart);
   }
@@ -2744,6 +3062,8 @@ if (setup.m_conferenceGoal.GetTag() == H225_Setup_UUIE_conferenceGoal::e_create)
   if (!OnSendSignalSetup(setupPDU))
     return EndedByNoAccept;
 
+  MarkCallTiming(H323CallTimeline::e_SetupBuilt);
+
   setupPDU.GetQ931().GetCalledPartyNumber(remotePartyNumber);
 
   //fastStartState = FastStartDisabled;
@@ -2777,6 +3097,8 @@ if (setup.m_conferenceGoal.GetTag() == H225_Setup_UUIE_conferenceGoal::e_create)
   if (!WriteSignalPDU(setupPDU))
     return EndedByTransportFail;
 
+  MarkCallTiming(H323CallTimeline::e_SetupSent);
+
   // WriteSignalPDU always resets lastPDUWasH245inSETUP.
   // So set it here if required
   if (set_lastPDUWasH245inSETUP)
@@ -2963,7 +3285,7 @@ PBoolean H323Connection::SendFastStartAcknowledge(H225_ArrayOf_PASN_OctetString
   PTRACE(3, "H225\tAccepting fastStart for " << fastStartChannels.GetSize() << " channels");
 
   for (i = 0; i < fastStartChannels.GetSize(); i++)
-    BuildFastStartList(fastStartChannels[i], array, H323Channel::IsTransmitter);
+    BuildFastStartList(*this, fastStartChannels[i], array, H323Channel::IsTransmitter);
 
   // Have moved open channels to logicalChannels structure, remove all others.
   fastStartChannels.RemoveAll();
@@ -3150,7 +3472,7 @@ PBoolean H323Connection::WriteControlPDU(const H323ControlPDU & pdu)
 {
   PWaitAndSignal m(controlMutex);
 
-  PPER_Stream strm;
+  H323_PERStream strm;
   pdu.Encode(strm);
   strm.CompleteEncoding();
 
@@ -3159,6 +3481,34 @@ PBoolean H323Connection::WriteControlPDU(const H323ControlPDU & pdu)
                    (controlChannel == NULL) ? H323TransportAddress("") : controlChannel->GetRemoteAddress()
                   );
 
+  return SendControlPDU(strm);
+}
+
+
+PBoolean H323Connection::WriteEncodedControlPDU(const PBYTEArray & encoded)
+{
+  PWaitAndSignal m(controlMutex);
+
+#if PTRACING
+  if (PTrace::CanTrace(3)) {
+    // Only decoded to be traced
+    PPER_Stream strm(encoded);
+    H323ControlPDU pdu;
+    if (pdu.Decode(strm)) {
+      H323TraceDumpPDU("H245", TRUE, encoded, pdu, pdu, 0,
+                       (controlChannel == NULL) ? H323TransportAddress("") : controlChannel->GetLocalAddress(),
+                       (controlChannel == NULL) ? H323TransportAddress("") : controlChannel->GetRemoteAddress()
+                      );
+    }
+  }
+#endif
+
+  return SendControlPDU(encoded);
+}
+
+
+PBoolean H323Connection::SendControlPDU(const PBYTEArray & strm)
+{
   if (!h245Tunneling) {
     if (controlChannel == NULL) {
       PTRACE(1, "H245\tWrite PDU fail: no control channel.");
@@ -3324,15 +3674,45 @@ void H323Connection::EndHandleControlChannel()
     endSessionReceived.Signal();
 }
 
+PBoolean H323Connection::ReactorControlChannel(H323Transport * transport)
+{
+  H323SignallingReactor * reactor = endpoint.GetSignallingReactor();
+  if (reactor == NULL || controlHandle != NULL || !H323SignallingHandle::IsServiceable(*transport))
+    return FALSE;
+
+  // Start negotiations before reading, exactly as HandleControlChannel() does
+  if (!OnStartHandleControlChannel())
+    return TRUE;
+
+  MonitorCallStatus();
+
+  H323SignallingHandle * handle = new ReactorH245Handle(*transport, *this);
+  if (reactor->AddHandle(*handle)) {
+    controlHandle = handle;
+    PTRACE(2, "H245\tReading PDUs in reactor");
+    return TRUE;
+  }
+
+  // Negotiations have started, so carry on reading on the calling thread
+  delete handle;
+  ReadControlChannel();
+  return TRUE;
+}
+
 void H323Connection::HandleControlChannel()
 {
   if (!OnStartHandleControlChannel())
     return;
 
+  ReadControlChannel();
+}
+
+void H323Connection::ReadControlChannel()
+{
   PBoolean ok = TRUE;
   while (ok) {
     MonitorCallStatus();
-    PPER_Stream strm;
+    H323_PERStream strm;
     PBoolean readStatus = controlChannel->ReadPDU(strm);
     ok = HandleReceivedControlPDU(readStatus, strm);
   }
@@ -3782,6 +4162,13 @@ PBoolean H323Connection::OnH245_JitterIndication(
 }
 
 
+void H323Connection::AddMemoryFootprint(PINDEX bytes)
+{
+  memoryFootprint += bytes;
+  endpoint.GetMetrics().connectionBytes.Add(bytes);
+}
+
+
 H323Channel * H323Connection::GetLogicalChannel(unsigned number, PBoolean fromRemote) const
 {
   return logicalChannels->FindChannel(number, fromRemote);
@@ -3795,6 +4182,31 @@ H323Channel * H323Connection::FindChannel(unsigned rtpSessionId, PBoolean fromRe
 
 #ifdef H323_H450
 
+void H323Connection::CreateH450Handlers()
+{
+  PWaitAndSignal m(h450Mutex);
+
+  if (h450dispatcher != NULL)
+    return;
+
+  PTRACE(4, "H450\tCreating supplementary service handlers for call " << callToken);
+  // Set the dispatcher only once its handlers are, it is what others test
+  H450xDispatcher * dispatcher = new H450xDispatcher(*this);
+  h4502handler = new H4502Handler(*this, *dispatcher);
+  h4503handler = new H4503Handler(*this, *dispatcher);
+  h4504handler = new H4504Handler(*this, *dispatcher);
+  h4506handler = new H4506Handler(*this, *dispatcher);
+  h45011handler = new H45011Handler(*this, *dispatcher);
+  h450dispatcher = dispatcher;
+  AddMemoryFootprint(sizeof(H450xDispatcher) +
+                     sizeof(H4502Handler) +
+                     sizeof(H4503Handler) +
+                     sizeof(H4504Handler) +
+                     sizeof(H4506Handler) +
+                     sizeof(H45011Handler));
+}
+
+
 void H323Connection::TransferCall(const PString & remoteParty,
                                   const PString & callIdentity)
 {
@@ -3802,6 +4214,7 @@ void H323Connection::TransferCall(const PString & remoteParty,
   // transferring endpoint shall first retrieve the call before Call Transfer is invoked.
   if (!callIdentity.IsEmpty() && IsLocalHold())
     RetrieveCall();
+  CreateH450Handlers();
   h4502handler->TransferCall(remoteParty, callIdentity);
 }
 
@@ -3812,6 +4225,7 @@ void H323Connection::OnReceivedInitiateReturnError()
 
 void H323Connection::ConsultationTransfer(const PString & primaryCallToken)
 {
+  CreateH450Handlers();
   h4502handler->ConsultationTransfer(primaryCallToken);
 }
 
@@ -3819,12 +4233,16 @@ void H323Connection::ConsultationTransfer(const PString & primaryCallToken)
 void H323Connection::HandleConsultationTransfer(const PString & callIdentity,
                                                 H323Connection& incoming)
 {
+  CreateH450Handlers();
   h4502handler->HandleConsultationTransfer(callIdentity, incoming);
 }
 
 
 PBoolean H323Connection::IsTransferringCall() const
 {
+  if (h4502handler == NULL)
+    return FALSE;
+
   switch (h4502handler->GetState()) {
     case H4502Handler::e_ctAwaitIdentifyResponse :
     case H4502Handler::e_ctAwaitInitiateResponse :
@@ -3839,6 +4257,9 @@ PBoolean H323Connection::IsTransferringCall() const
 
 PBoolean H323Connection::IsTransferredCall() const
 {
+   if (h4502handler == NULL)
+     return FALSE;
+
    return (h4502handler->GetInvokeId() != 0 &&
            h4502handler->GetState() == H4502Handler::e_ctIdle) ||
            h4502handler->isConsultationTransferSuccess();
@@ -3848,31 +4269,36 @@ PBoolean H323Connection::IsTransferredCall() const
 void H323Connection::HandleTransferCall(const PString & token,
                                         const PString & identity)
 {
-  if (!token.IsEmpty() || !identity)
+  if (!token.IsEmpty() || !identity) {
+    CreateH450Handlers();
     h4502handler->AwaitSetupResponse(token, identity);
+  }
 }
 
 
 int H323Connection::GetCallTransferInvokeId()
 {
-  return h4502handler->GetInvokeId();
+  return h4502handler != NULL ? h4502handler->GetInvokeId() : 0;
 }
 
 
 void H323Connection::HandleCallTransferFailure(const int returnError)
 {
+  CreateH450Handlers();
   h4502handler->HandleCallTransferFailure(returnError);
 }
 
 
 void H323Connection::SetAssociatedCallToken(const PString& token)
 {
+  CreateH450Handlers();
   h4502handler->SetAssociatedCallToken(token);
 }
 
 
 void H323Connection::OnConsultationTransferSuccess(H323Connection& /*secondaryCall*/)
 {
+   CreateH450Handlers();
    h4502handler->SetConsultationTransferSuccess();
 }
 
@@ -3886,6 +4312,7 @@ void H323Connection::GetCallLinkage(const H225_AdmissionRequest& /*arq*/)
 
 void H323Connection::HoldCall(PBoolean localHold)
 {
+  CreateH450Handlers();
   h4504handler->HoldCall(localHold);
   holdAudioMediaChannel = SwapHoldMediaChannels(holdAudioMediaChannel,RTP_Session::DefaultAudioSessionID);
   holdVideoMediaChannel = SwapHoldMediaChannels(holdVideoMediaChannel,RTP_Session::DefaultVideoSessionID);
@@ -3898,6 +4325,10 @@ PBoolean H323Connection::GetRedirectingNumber(
     int &originaldivReason,
     int &divReason)
 {
+  // Diversion information only comes in an H.450.3 APDU
+  if (h4503handler == NULL)
+    return FALSE;
+
   return h4503handler->GetRedirectingNumber(originalCalledNr,lastDivertingNr,
                                          divCounter,originaldivReason,divReason);
 }
@@ -4036,24 +4467,25 @@ PChannel * H323Connection::OnCallRetrieve(PBoolean /*IsEncoder*/,
 
 PBoolean H323Connection::IsLocalHold() const
 {
-  return h4504handler->GetState() == H4504Handler::e_ch_NE_Held;
+  return h4504handler != NULL && h4504handler->GetState() == H4504Handler::e_ch_NE_Held;
 }
 
 
 PBoolean H323Connection::IsRemoteHold() const
 {
-  return h4504handler->GetState() == H4504Handler::e_ch_RE_Held;
+  return h4504handler != NULL && h4504handler->GetState() == H4504Handler::e_ch_RE_Held;
 }
 
 
 PBoolean H323Connection::IsCallOnHold() const
 {
-  return h4504handler->GetState() != H4504Handler::e_ch_Idle;
+  return h4504handler != NULL && h4504handler->GetState() != H4504Handler::e_ch_Idle;
 }
 
 
 void H323Connection::IntrudeCall(unsigned capabilityLevel)
 {
+  CreateH450Handlers();
   h45011handler->IntrudeCall(capabilityLevel);
 }
 
@@ -4061,38 +4493,45 @@ void H323Connection::IntrudeCall(unsigned capabilityLevel)
 void H323Connection::HandleIntrudeCall(const PString & token,
                                        const PString & identity)
 {
-  if (!token.IsEmpty() || !identity)
+  if (!token.IsEmpty() || !identity) {
+    CreateH450Handlers();
     h45011handler->AwaitSetupResponse(token, identity);
+  }
 }
 
 
 PBoolean H323Connection::GetRemoteCallIntrusionProtectionLevel(const PString & intrusionCallToken,
                                                            unsigned intrusionCICL)
 {
+  CreateH450Handlers();
   return h45011handler->GetRemoteCallIntrusionProtectionLevel(intrusionCallToken, intrusionCICL);
 }
 
 
 void H323Connection::SetIntrusionImpending()
 {
+  CreateH450Handlers();
   h45011handler->SetIntrusionImpending();
 }
 
 
 void H323Connection::SetForcedReleaseAccepted()
 {
+  CreateH450Handlers();
   h45011handler->SetForcedReleaseAccepted();
 }
 
 
 void H323Connection::SetIntrusionNotAuthorized()
 {
+  CreateH450Handlers();
   h45011handler->SetIntrusionNotAuthorized();
 }
 
 
 void H323Connection::SendCallWaitingIndication(const unsigned nbOfAddWaitingCalls)
 {
+  CreateH450Handlers();
   h4506handler->AttachToAlerting(*alertingPDU, nbOfAddWaitingCalls);
 }
 
@@ -4173,12 +4612,27 @@ PBoolean H323Connection::OnReceivedCapabilitySet(const H323Capabilities & remote
 
     const H245_H2250Capability & h225_0 = *muxCap;
     remoteMaxAudioDelayJitter = h225_0.m_maximumAudioDelayJitter;
+    remoteMulticastCapable = h225_0.m_receiveMultipointCapability.m_multicastCapability;
+    remoteVideoNack = h225_0.m_rtcpVideoControlCapability;
+
+    remoteAudioRedundancy = FALSE;
+    if (h225_0.HasOptionalField(H245_H2250Capability::e_redundancyEncodingCapability)) {
+      for (PINDEX i = 0; i < h225_0.m_redundancyEncodingCapability.GetSize(); i++) {
+        if (h225_0.m_redundancyEncodingCapability[i].m_redundancyEncodingMethod.GetTag() ==
+                                        H245_RedundancyEncodingMethod::e_rtpAudioRedundancyEncoding)
+          remoteAudioRedundancy = TRUE;
+      }
+    }
   }
 
   // save this time as being when the reverse media channel was opened
   if (!reverseMediaOpenTime.IsValid())
     reverseMediaOpenTime = PTime();
 
+  // Any memo of the previous set no longer describes the remote table
+  H323Capabilities::ReleaseSnapshot(remoteCapabilityMemo);
+  remoteCapabilityMemo = NULL;
+
   if (remoteCaps.GetSize() == 0) {
     // Received empty TCS, so close all transmit channels
     for (PINDEX i = 0; i < logicalChannels->GetSize(); i++) {
@@ -4193,12 +4647,20 @@ PBoolean H323Connection::OnReceivedCapabilitySet(const H323Capabilities & remote
 
     // If we had received a TCS=0 previously, or we have a remoteCapabilities which
     // was "faked" from the fast start data, overwrite it, don't merge it.
-    if (transmitterSidePaused || !capabilityExchangeProcedure->HasReceivedCapabilities())
+    PBoolean replace = transmitterSidePaused || !capabilityExchangeProcedure->HasReceivedCapabilities();
+    if (replace)
       remoteCapabilities.RemoveAll();
 
     if (!remoteCapabilities.Merge(remoteCaps))
       return FALSE;
 
+    // A table copied whole from an endpoint memo can use the selections remembered in it
+    if (replace) {
+      remoteCapabilityMemo = dynamic_cast<const H323CapabilityMemo *>(&remoteCaps);
+      if (remoteCapabilityMemo != NULL)
+        remoteCapabilityMemo->AddReference();
+    }
+
     if (transmitterSidePaused) {
       transmitterSidePaused = FALSE;
       connectionState = HasExecutedSignalConnect;
@@ -4238,9 +4700,9 @@ void H323Connection::SetInitialBandwidth(H323Capability::MainTypes captype, int
 #ifdef H323_VIDEO
   for (PINDEX i=0; i< localCapabilities.GetSize(); ++i) {
     if (localCapabilities[i].GetMainType() == captype) {
-      OpalMediaFormat & fmt = localCapabilities[i].GetWritableMediaFormat();
-      if (fmt.GetOptionInteger(OpalVideoFormat::MaxBitRateOption) > bitRate)
-             fmt.SetOptionInteger(OpalVideoFormat::MaxBitRateOption,bitRate);
+      OpalMediaFormat & fmt = localCapabilities.GetWritable(&localCapabilities[i])->GetWritableMediaFormat();
+      if (fmt.GetOptionInteger(OpalVideoFormat::MaxBitRateKey) > bitRate)
+             fmt.SetOptionInteger(OpalVideoFormat::MaxBitRateKey,bitRate);
     }
   }
 #endif
@@ -4251,9 +4713,9 @@ void H323Connection::SetMaxPayloadSize(H323Capability::MainTypes captype, int si
 #ifdef H323_VIDEO
   for (PINDEX i=0; i< localCapabilities.GetSize(); ++i) {
     if (localCapabilities[i].GetMainType() == captype) {
-      OpalMediaFormat & fmt = localCapabilities[i].GetWritableMediaFormat();
+      OpalMediaFormat & fmt = localCapabilities.GetWritable(&localCapabilities[i])->GetWritableMediaFormat();
       if (fmt.HasOption(OpalVideoFormat::MaxPayloadSizeOption)) {
-             fmt.SetOptionInteger(OpalVideoFormat::MaxPayloadSizeOption,size);
+             fmt.SetOptionInteger(OpalVideoFormat::MaxPayloadSizeKey,size);
   //           if (fmt.HasOption("Generic Parameter 9"))   // for H.264....
   //               fmt.SetOptionInteger("Generic Parameter 9",size);
       }
@@ -4267,9 +4729,9 @@ void H323Connection::SetEmphasisSpeed(H323Capability::MainTypes captype, bool sp
 #ifdef H323_VIDEO
   for (PINDEX i=0; i< localCapabilities.GetSize(); ++i) {
     if (localCapabilities[i].GetMainType() == captype) {
-      OpalMediaFormat & fmt = localCapabilities[i].GetWritableMediaFormat();
+      OpalMediaFormat & fmt = localCapabilities.GetWritable(&localCapabilities[i])->GetWritableMediaFormat();
       if (fmt.HasOption(OpalVideoFormat::EmphasisSpeedOption))
-          fmt.SetOptionBoolean(OpalVideoFormat::EmphasisSpeedOption,speed);
+          fmt.SetOptionBoolean(OpalVideoFormat::EmphasisSpeedKey,speed);
     }
   }
 #endif
@@ -4280,6 +4742,13 @@ void H323Connection::OnSetLocalCapabilities()
 {
 }
 
+void H323Connection::OrderLocalCapabilitiesByCost()
+{
+  H323CapabilityCostModel * model = endpoint.GetCapabilityCostModel();
+  if (model != NULL)
+    localCapabilities.OrderByCost(*model, *this);
+}
+
 void H323Connection::OnSetLocalUserInputCapabilities()
 {
     if (!rfc2833InBandDTMF)
@@ -4319,6 +4788,37 @@ PTimeInterval H323Connection::GetRoundTripDelay() const
 }
 
 
+void H323Connection::OnRoundTripDelayResult(PBoolean alive)
+{
+  if (roundTripLiveness != NULL)
+    roundTripLiveness->OnProbeResult(roundTripPeer, callToken, alive, H323MediaClock::GetMilliseconds());
+}
+
+
+PBoolean H323Connection::IsRoundTripDelayVouched(PInt64 now)
+{
+  if (!masterSlaveDeterminationProcedure->IsDetermined() ||
+      !capabilityExchangeProcedure->HasSentCapabilities())
+    return FALSE;
+
+  if (roundTripLiveness == NULL) {
+    H323Transport * transport = controlChannel != NULL ? controlChannel : signallingChannel;
+    PIPSocket::Address ip;
+    if (transport == NULL || !transport->GetRemoteAddress().GetIpAddress(ip))
+      return FALSE;
+
+    roundTripLiveness = endpoint.GetPeerLiveness();
+    if (roundTripLiveness == NULL)
+      return FALSE;
+
+    roundTripPeer = ip.AsString();
+    roundTripLiveness->AddCall(roundTripPeer);
+  }
+
+  return !roundTripLiveness->StartProbe(roundTripPeer, callToken, now, roundTripDelayRate);
+}
+
+
 void H323Connection::InternalEstablishedConnectionCheck()
 {
   PTRACE(3, "H323\tInternalEstablishedConnectionCheck: "
@@ -4341,7 +4841,7 @@ void H323Connection::InternalEstablishedConnectionCheck()
     // If we are early starting, start channels as soon as possible instead of
     // waiting for connect PDU
     if (earlyStart && FindChannel(RTP_Session::DefaultAudioSessionID, FALSE) == NULL)
-      OnSelectLogicalChannels();
+      InternalSelectLogicalChannels();
   }
 
 #ifdef H323_T120
@@ -4373,16 +4873,17 @@ void H323Connection::InternalEstablishedConnectionCheck()
        connectionState == AwaitingSignalConnect &&
        FindChannel(RTP_Session::DefaultAudioSessionID, TRUE) != NULL &&
        FindChannel(RTP_Session::DefaultAudioSessionID, FALSE) == NULL)
-    OnSelectLogicalChannels();
+    InternalSelectLogicalChannels();
 
   if (connectionState != HasExecutedSignalConnect)
     return;
 
   // Check if we have already got a transmitter running, select one if not
   if (FindChannel(RTP_Session::DefaultAudioSessionID, FALSE) == NULL)
-    OnSelectLogicalChannels();
+    InternalSelectLogicalChannels();
 
   connectionState = EstablishedConnection;
+  MarkCallTiming(H323CallTimeline::e_Established);
 
   if (signallingChannel)
       signallingChannel->SetCallEstablished();
@@ -4407,6 +4908,37 @@ static void StartFastStartChannel(H323LogicalChannelList & fastStartChannels,
 #endif
 
 
+void H323Connection::InternalSelectLogicalChannels()
+{
+  /* The OpenLogicalChannel requests do not wait for each other's ack, so
+     when tunnelling they can all go in one Facility rather than one each.
+     Only needed with no PDU carrying the tunnel, as from AnsweringCall(), a
+     tunnelled TCS or MSD has HandleTunnelPDU() gather them already. Not done
+     to Cisco IOS which cannot accept multiple tunnelled H.245 PDUs in a
+     Facility. */
+  if (!endpoint.IsH245BurstOpenEnabled() || !h245Tunneling || h245TunnelTxPDU != NULL ||
+      remoteApplication.Find("Cisco IOS") != P_MAX_INDEX) {
+    OnSelectLogicalChannels();
+    return;
+  }
+
+  H323SignalPDU burstPDU;
+  burstPDU.BuildFacility(*this, TRUE);
+  h245TunnelTxPDU = &burstPDU;
+
+  OnSelectLogicalChannels();
+
+  h245TunnelTxPDU = NULL;
+
+  PINDEX count = burstPDU.m_h323_uu_pdu.m_h245Control.GetSize();
+  if (count == 0)
+    return;
+
+  PTRACE(3, "H245\tSending " << count << " tunnelled H.245 PDUs in one Facility");
+  WriteSignalPDU(burstPDU);
+}
+
+
 void H323Connection::OnSelectLogicalChannels()
 {
   PTRACE(2, "H245\tDefault OnSelectLogicalChannels, " << fastStartState);
@@ -4493,20 +5025,35 @@ void H323Connection::SelectDefaultLogicalChannel(unsigned sessionID)
   if (FindChannel (sessionID, FALSE))
     return;
 
-  for (PINDEX i = 0; i < localCapabilities.GetSize(); i++) {
-    H323Capability & localCapability = localCapabilities[i];
-    if (localCapability.GetDefaultSessionID() == sessionID) {
-      H323Capability * remoteCapability = remoteCapabilities.FindCapability(localCapability);
-      if (remoteCapability != NULL) {
-        PTRACE(3, "H323\tSelecting " << *remoteCapability);
+  // Pairs of local and remote capability in order of preference, worked out
+  // by the first connection to get the same set from the remote
+  H323CapabilityMemo::Selection selection;
+  if (remoteCapabilityMemo == NULL || !remoteCapabilityMemo->GetSelection(sessionID, selection)) {
+    for (PINDEX i = 0; i < localCapabilities.GetSize(); i++) {
+      H323Capability & localCapability = localCapabilities[i];
+      if (localCapability.GetDefaultSessionID() == sessionID) {
+        H323Capability * remoteCapability = remoteCapabilities.FindCapability(localCapability);
+        if (remoteCapability != NULL)
+          selection.push_back(H323CapabilityMemo::Selection::value_type(localCapability.GetCapabilityNumber(),
+                                                                          remoteCapability->GetCapabilityNumber()));
+      }
+    }
+    if (remoteCapabilityMemo != NULL)
+      remoteCapabilityMemo->SetSelection(sessionID, selection);
+  }
 
-        MergeCapabilities(sessionID, localCapability, remoteCapability);
+  for (size_t i = 0; i < selection.size(); i++) {
+    H323Capability * localCapability = localCapabilities.FindCapability(selection[i].first);
+    H323Capability * remoteCapability = remoteCapabilities.FindCapability(selection[i].second);
+    if (localCapability != NULL && remoteCapability != NULL) {
+      PTRACE(3, "H323\tSelecting " << *remoteCapability);
 
-        if (OpenLogicalChannel(*remoteCapability, sessionID, H323Channel::IsTransmitter))
-          break;
-        PTRACE(2, "H323\tOnSelectLogicalChannels, OpenLogicalChannel failed: "
-               << *remoteCapability);
-      }
+      MergeCapabilities(sessionID, *localCapability, remoteCapability);
+
+      if (OpenLogicalChannel(*remoteCapability, sessionID, H323Channel::IsTransmitter))
+        break;
+      PTRACE(2, "H323\tOnSelectLogicalChannels, OpenLogicalChannel failed: "
+             << *remoteCapability);
     }
   }
 }
@@ -4520,10 +5067,10 @@ PBoolean H323Connection::MergeCapabilities(unsigned sessionID, const H323Capabil
 
    if (remoteFormat.Merge(localFormat)) {
 #ifdef H323_VIDEO
-       unsigned maxBitRate = remoteFormat.GetOptionInteger(OpalVideoFormat::MaxBitRateOption);
-       unsigned targetBitRate = remoteFormat.GetOptionInteger(OpalVideoFormat::TargetBitRateOption);
+       unsigned maxBitRate = remoteFormat.GetOptionInteger(OpalVideoFormat::MaxBitRateKey);
+       unsigned targetBitRate = remoteFormat.GetOptionInteger(OpalVideoFormat::TargetBitRateKey);
        if (targetBitRate > maxBitRate)
-          remoteFormat.SetOptionInteger(OpalVideoFormat::TargetBitRateOption, maxBitRate);
+          remoteFormat.SetOptionInteger(OpalVideoFormat::TargetBitRateKey, maxBitRate);
 #endif
 #if PTRACING
       PTRACE(6, "H323\tCapability Merge: ");
@@ -4807,6 +5354,7 @@ H323Channel * H323Connection::CreateLogicalChannel(const H245_OpenLogicalChannel
     return NULL; // If codec not supported, return error
   }
 
+  capability = localCapabilities.GetWritable(capability);
   if (!capability->OnReceivedPDU(*dataType, direction == H323Channel::IsReceiver)) {
     errorCode = H245_OpenLogicalChannelReject_cause::e_dataTypeNotSupported;
     PTRACE(2, "H323\tCreateLogicalChannel - data type not supported");
@@ -4881,9 +5429,11 @@ H323Channel * H323Connection::CreateRealTimeLogicalChannel(const H323Capability
 #ifdef H323_H46026
      H46026IsMediaTunneled() ||
 #endif
-     !param || !param->HasOptionalField(H245_H2250LogicalChannelParameters::e_mediaControlChannel)) {
+     !param || !param->HasOptionalField(H245_H2250LogicalChannelParameters::e_mediaControlChannel) ||
+     param->m_mediaControlChannel.GetTag() == H245_TransportAddress::e_multicastAddress) {
         // Make a fake transmprt address from the connection so gets initialised with
-        // the transport type (IP, IPX, multicast etc).
+        // the transport type (IP, IPX, multicast etc). A multicast group is joined
+        // later, when the channel reads the addresses of the open.
         H245_TransportAddress addr;
         GetControlChannel().SetUpTransportPDU(addr, H323Transport::UseLocalTSAP);
         session = UseSession(sessionID, addr, dir, rtpqos);
@@ -4894,7 +5444,44 @@ H323Channel * H323Connection::CreateRealTimeLogicalChannel(const H323Capability
   if (session == NULL)
     return NULL;
 
-  return new H323_RTPChannel(*this, capability, dir, *session);
+  if (dir == H323Channel::IsTransmitter) {
+    std::map<unsigned, MulticastTransmit>::const_iterator mc = multicastTransmit.find(sessionID);
+    if (mc != multicastTransmit.end()) {
+      PIPSocket::Address group;
+      WORD port = 0;
+      if (!remoteMulticastCapable)
+        PTRACE(2, "H323\tRemote cannot receive multicast, session " << sessionID << " sent unicast");
+      else if (PIsDescendant(session, RTP_UDP) && mc->second.group.GetIpAndPort(group, port))
+        ((RTP_UDP *)session)->SetMulticastTransmit(group, port, mc->second.ttl, mc->second.loop);
+    }
+  }
+
+  H323_RTPChannel * channel = new H323_RTPChannel(*this, capability, dir, *session);
+
+  if (dir == H323Channel::IsTransmitter && capability.GetMainType() == H323Capability::e_Audio &&
+      endpoint.GetAudioRedundancy() > 0 && remoteAudioRedundancy)
+    channel->SetRedundancy(endpoint.GetAudioRedundancy(), endpoint.GetRedundancyPayloadType());
+
+  // Both directions of a video session share it, each sets up its half
+  if (capability.GetMainType() == H323Capability::e_Video && endpoint.IsVideoRetransmissionEnabled() && remoteVideoNack) {
+    if (dir == H323Channel::IsTransmitter) {
+      if (!session->IsRetransmitting())
+        session->SetRetransmission(endpoint.GetRetransmissionPayloadType());
+    }
+    else if (!session->IsGeneratingNacks())
+      session->SetNackGeneration(endpoint.GetRetransmissionPayloadType());
+  }
+
+  return channel;
+}
+
+
+void H323Connection::SetMulticastTransmit(unsigned sessionID, const H323TransportAddress & group, BYTE ttl, PBoolean loop)
+{
+  MulticastTransmit & mc = multicastTransmit[sessionID];
+  mc.group = group;
+  mc.ttl = ttl;
+  mc.loop = loop;
 }
 
 
@@ -4964,8 +5551,10 @@ PBoolean H323Connection::OnStartLogicalChannel(H323Channel & channel)
           codec->AddFilter(PCREATE_NOTIFIER(OnUserInputInBandDTMF));
       }
     }
-    else if (rfc2833InBandDTMF && rfc2833handler)
+    else if (rfc2833InBandDTMF && rfc2833handler) {
       rtp.AddFilter(rfc2833handler->GetTransmitHandler());
+      rfc2833handler->SetTransmitSession(GetSession(channel.GetSessionID()));
+    }
   }
 
 #ifdef H323_H239
@@ -4992,8 +5581,8 @@ PBoolean H323Connection::OnInitialFlowRestriction(H323Channel & channel)
     if (codec == NULL) return true;
 
     const OpalMediaFormat & fmt = codec->GetMediaFormat();
-    unsigned maxBitRate = fmt.GetOptionInteger(OpalVideoFormat::MaxBitRateOption);
-    unsigned targetBitRate = fmt.GetOptionInteger(OpalVideoFormat::TargetBitRateOption);
+    unsigned maxBitRate = fmt.GetOptionInteger(OpalVideoFormat::MaxBitRateKey);
+    unsigned targetBitRate = fmt.GetOptionInteger(OpalVideoFormat::TargetBitRateKey);
 
     if (targetBitRate < maxBitRate) {
         return SendLogicalChannelFlowControl(channel,targetBitRate/100);
@@ -5058,6 +5647,11 @@ PBoolean H323Connection::OnClosingLogicalChannel(H323Channel & /*channel*/)
 
 void H323Connection::OnClosedLogicalChannel(const H323Channel & channel)
 {
+  // The scheduler must not send tones on a session about to be released
+  if (rfc2833handler && !channel.GetNumber().IsFromRemote() &&
+      channel.GetSessionID() == OpalMediaFormat::DefaultAudioSessionID)
+    rfc2833handler->SetTransmitSession(NULL);
+
 #ifdef H323_H239
   if ((channel.GetCapability().GetMainType() == H323Capability::e_Video) &&
       (channel.GetCapability().GetSubType() == H245_VideoCapability::e_extendedVideoCapability)) {
@@ -5066,6 +5660,22 @@ void H323Connection::OnClosedLogicalChannel(const H323Channel & channel)
   }
 #endif
 
+  // Keep what the call journal wants of the media before the channel goes
+  unsigned sessionID = channel.GetSessionID();
+  if (sessionID == OpalMediaFormat::DefaultAudioSessionID) {
+    if (mediaRecord.audioCodec[0] == '\0')
+      H323CallRecord::SetField(mediaRecord.audioCodec, sizeof(mediaRecord.audioCodec), channel.GetCapability().GetFormatName());
+    RTP_Session * session = GetSession(sessionID);
+    if (session != NULL) {
+      mediaRecord.packetsSent = session->GetPacketsSent();
+      mediaRecord.packetsReceived = session->GetPacketsReceived();
+      mediaRecord.packetsLost = session->GetPacketsLost();
+      mediaRecord.jitter = session->GetAvgJitterTime();
+    }
+  }
+  else if (sessionID == OpalMediaFormat::DefaultVideoSessionID && mediaRecord.videoCodec[0] == '\0')
+    H323CallRecord::SetField(mediaRecord.videoCodec, sizeof(mediaRecord.videoCodec), channel.GetCapability().GetFormatName());
+
   endpoint.OnClosedLogicalChannel(*this, channel);
 }
 
@@ -5664,6 +6274,9 @@ RTP_Session * H323Connection::UseSession(unsigned sessionID,
                   );
 
   udp_session->SetUserData(new H323_RTP_UDP(*this, *udp_session, rtpqos));
+  udp_session->SetMediaReactor(endpoint.GetMediaReactor());
+  udp_session->SetJitterPullMode(endpoint.GetJitterBufferPullMode());
+  udp_session->SetReportScheduler(endpoint.GetReportScheduler());
   rtpSessions.AddSession(udp_session);
   return udp_session;
 }
@@ -6456,33 +7069,47 @@ void H323Connection::H4609QueueStats(const RTP_Session & session)
    if (!m_h4609enabled)
        return;
 
-    H4609Statistics * stat = new H4609Statistics();
-    stat->sendRTPaddr  = H323TransportAddress(session.GetLocalTransportAddress());
-    stat->recvRTPaddr  = H323TransportAddress(session.GetRemoteTransportAddress());
+    RTP_Session::QoSMeasures qos;
+    if (!session.GetQoSMeasures(qos))
+        return;
+
+    PWaitAndSignal m(m_h4609Mutex);
+
+    // One record per session, overwritten until the next report takes it
+    H4609Record & record = m_h4609Stats[session.GetSessionID()];
+    H4609Statistics * stat = &record.stats;
+    if (stat->sendRTPaddr.IsEmpty()) {
+        stat->sendRTPaddr  = H323TransportAddress(session.GetLocalTransportAddress());
+        stat->recvRTPaddr  = H323TransportAddress(session.GetRemoteTransportAddress());
+    }
 //     stat->sendRTCPaddr = H323TransportAddress();
 //   stat->recvRTCPaddr = H323TransportAddress();
     stat->sessionid = session.GetSessionID();
-    stat->meanEndToEndDelay = session.GetAverageSendTime();
-    stat->worstEndToEndDelay = session.GetMaximumSendTime();
-    stat->packetsReceived = session.GetPacketsReceived();
-    stat->accumPacketLost = session.GetPacketsLost();
-    stat->packetLossRate = session.GetPacketsLost() / session.GetPacketsReceived();
+    stat->meanEndToEndDelay = qos.averageSendTime;
+    stat->worstEndToEndDelay = qos.maximumSendTime;
+    stat->packetsReceived = qos.packetsReceived;
+    stat->accumPacketLost = qos.packetsLost;
+    stat->packetLossRate = qos.lossRate;
     stat->fractionLostRate = stat->packetLossRate * 100;
-    stat->meanJitter = session.GetAvgJitterTime();
-    stat->worstJitter = session.GetMaxJitterTime();
-    if (session.GetPacketsReceived() > 0 && session.GetAverageReceiveTime() > 0)
-      stat->bandwidth  = (unsigned)((session.GetOctetsReceived()/session.GetPacketsReceived()/session.GetAverageReceiveTime())*1000);
-
-    m_h4609Stats.Enqueue(stat);
+    stat->meanJitter = qos.jitter;
+    stat->worstJitter = qos.maximumJitter;
+    stat->bandwidth  = qos.throughput;
+    record.updated = true;
 }
 
 
 H323Connection::H4609Statistics * H323Connection::H4609DequeueStats()
 {
-    if (m_h4609Stats.GetSize() == 0)
-        return NULL;
+    PWaitAndSignal m(m_h4609Mutex);
+
+    for (std::map<unsigned, H4609Record>::iterator it = m_h4609Stats.begin(); it != m_h4609Stats.end(); ++it) {
+        if (it->second.updated) {
+            it->second.updated = false;
+            return new H4609Statistics(it->second.stats);
+        }
+    }
 
-    return (m_h4609Stats.Dequeue());
+    return NULL;
 }
 
 void H323Connection::H4609EnableStats()
@@ -6937,7 +7564,7 @@ void H323Connection::SendLogicalChannelMiscCommand(H323Channel & channel,
 
 void H323Connection::SetEnforcedDurationLimit(unsigned seconds)
 {
-  enforcedDurationLimit.SetInterval(0, seconds);
+  enforcedDurationLimit = PTimeInterval(0, seconds);
 }
 
 
@@ -6946,29 +7573,19 @@ void H323Connection::MonitorCallStatus()
   if (!Lock())
     return;
 
-  if (roundTripDelayTimer > 0 && !roundTripDelayTimer.IsRunning()) {
-    roundTripDelayTimer.SetInterval(roundTripDelayRate);
-    StartRoundTripDelay();
-  }
-
-  if (noMediaTimeOut > 0) {
-    PBoolean oneRunning = FALSE;
-    PBoolean allSilent = TRUE;
-    for (PINDEX i = 0; i < logicalChannels->GetSize(); i++) {
-        H323Channel * channel = logicalChannels->GetChannelAt(i);
-        if (channel && channel->IsRunning()) {
-            oneRunning = TRUE;
-            if (channel->GetSilenceDuration() < noMediaTimeOut) {
-                allSilent = FALSE;
-                break;
-            }
-        }
+  if (roundTripDelayRate > 0) {
+    PInt64 now = H323MediaClock::GetMilliseconds();
+    if (now >= nextRoundTripDelay) {
+      nextRoundTripDelay = now + roundTripDelayRate;
+      // Another call to the same peer may have shown it is alive
+      if (!IsRoundTripDelayVouched(now))
+        StartRoundTripDelay();
     }
-    if (oneRunning && allSilent)
-      ClearCall(EndedByTransportFail);
   }
 
-  if (enforcedDurationLimit.GetResetTime() > 0 && enforcedDurationLimit == 0)
+  // The no media timeout is checked by the endpoint media watchdog
+
+  if (enforcedDurationLimit.GetResetTime() > 0 && !enforcedDurationLimit.IsRunning())
     ClearCall(EndedByDurationLimit);
 
   Unlock();
@@ -7261,6 +7878,7 @@ const H323TransportSecurity & H323Connection::GetTransportSecurity() const
 void H323Connection::AggregateSignalChannel(H323Transport * transport)
 {
   signalAggregator = new AggregatedH225Handle(*transport, *this);
+  signalAggregator->HandleReadAhead();
   endpoint.GetSignallingAggregator()->AddHandle(signalAggregator);
 }
 
@@ -7270,6 +7888,7 @@ void H323Connection::AggregateControlChannel(H323Transport * transport)
     return;
 
   controlAggregator = new AggregatedH245Handle(*transport, *this);
+  controlAggregator->HandleReadAhead();
   endpoint.GetSignallingAggregator()->AddHandle(controlAggregator);
 }
 
@@ -7279,7 +7898,8 @@ H323AggregatedH2x5Handle::H323AggregatedH2x5Handle(H323Transport & _transport, H
     transport(_transport),
     connection(_connection)
 {
-  pduDataLen = 0;
+  // Take over anything ReadPDU() had already received
+  pduDataLen = transport.ExtractReadAhead(pduBuffer, 0);
 }
 
 H323AggregatedH2x5Handle::~H323AggregatedH2x5Handle()
@@ -7293,6 +7913,19 @@ PAggregatorFDList_t H323AggregatedH2x5Handle::GetFDs()
   return list;
 }
 
+PBoolean H323AggregatedH2x5Handle::HandleReadAhead()
+{
+  if (pduDataLen == 0)
+    return TRUE;
+
+  if (pduBuffer[0] != 0x03) {
+    PTRACE(1, "Error");
+    return FALSE;
+  }
+
+  return HandleBuffered();
+}
+
 PBoolean H323AggregatedH2x5Handle::OnRead()
 {
   //
@@ -7347,44 +7980,52 @@ PBoolean H323AggregatedH2x5Handle::OnRead()
 
       // update pdu size for new data that was read
       pduDataLen += numRead;
+      ok = HandleBuffered();
+    }
+  }
 
-      while (pduDataLen > 0) {
 
-        // convert data to PDU. If PDU is invalid, return error
-        PINDEX pduLen = pduDataLen;
-        if (!transport.ExtractPDU(pduBuffer, pduLen)) {
-          ok = FALSE;
-          break;
-        }
+  return ok;
+}
 
-        // if PDU is not yet complete, then no error but stop looping
-        else if (pduLen <= 0) {
-          ok = TRUE;
-          break;
-        }
+PBoolean H323AggregatedH2x5Handle::HandleBuffered()
+{
+  PBoolean ok = TRUE;
 
-        // otherwise process the data
-        else {
-          transport.SetErrorValues(PChannel::NoError, 0, PChannel::LastReadError);
-          {
-            // create the new PDU
-            PBYTEArray dataPDU((const BYTE *)pduBuffer+4, pduLen-4, FALSE);
-            ok = HandlePDU(ok, dataPDU);
-          }
+  while (pduDataLen > 0) {
 
-          // remove processed data
-          if (pduLen == pduDataLen)
-            pduDataLen = 0;
-          else {
-            pduDataLen -= pduLen;
-            memcpy(pduBuffer.GetPointer(), pduBuffer.GetPointer() + pduLen, pduDataLen);
-          }
-        }
+    // convert data to PDU. If PDU is invalid, return error
+    PINDEX pduLen = pduDataLen;
+    if (!transport.ExtractPDU(pduBuffer, pduLen)) {
+      ok = FALSE;
+      break;
+    }
+
+    // if PDU is not yet complete, then no error but stop looping
+    else if (pduLen <= 0) {
+      ok = TRUE;
+      break;
+    }
+
+    // otherwise process the data
+    else {
+      transport.SetErrorValues(PChannel::NoError, 0, PChannel::LastReadError);
+      {
+        // create the new PDU
+        PBYTEArray dataPDU((const BYTE *)pduBuffer+4, pduLen-4, FALSE);
+        ok = HandlePDU(ok, dataPDU);
+      }
+
+      // remove processed data
+      if (pduLen == pduDataLen)
+        pduDataLen = 0;
+      else {
+        pduDataLen -= pduLen;
+        memmove(pduBuffer.GetPointer(), pduBuffer.GetPointer() + pduLen, pduDataLen);
       }
     }
   }
 
-
   return ok;
 }
 
@@ -0,0 +1,244 @@
+/*
+ * h323affinity.cxx
+ *
+ * CPU affinity of media and signalling threads
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "h323affinity.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#include "h323affinity.h"
+
+#include <algorithm>
+
+#if defined(P_LINUX)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+#endif
+
+#define new PNEW
+
+/* Highest CPU number accepted in a list */
+#define AFFINITY_MAX_CPU 1023
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323CPUSet::H323CPUSet()
+{
+}
+
+
+H323CPUSet::H323CPUSet(const PString & list)
+{
+  Parse(list);
+}
+
+
+PBoolean H323CPUSet::Parse(const PString & list)
+{
+  cpus.clear();
+
+  PString str = list.Trim();
+  if (str.IsEmpty())
+    return TRUE;
+
+  if (str.NumCompare("node", 4, 0) == PObject::EqualTo) {
+    PString node = str.Mid(4);
+    if (node.IsEmpty() || node.FindSpan("0123456789") != P_MAX_INDEX)
+      return FALSE;
+    *this = GetNodeCPUs(node.AsUnsigned());
+    return !IsEmpty();
+  }
+
+  PStringArray ranges = str.Tokenise(",", FALSE);
+  for (PINDEX i = 0; i < ranges.GetSize(); i++) {
+    PString range = ranges[i].Trim();
+    PINDEX dash = range.Find('-');
+    PString first = dash != P_MAX_INDEX ? range.Left(dash).Trim() : range;
+    PString last = dash != P_MAX_INDEX ? range.Mid(dash+1).Trim() : range;
+    if (first.IsEmpty() || last.IsEmpty() ||
+        first.FindSpan("0123456789") != P_MAX_INDEX || last.FindSpan("0123456789") != P_MAX_INDEX) {
+      PTRACE(2, "Affinity\tIllegal CPU list \"" << list << '"');
+      cpus.clear();
+      return FALSE;
+    }
+
+    unsigned from = first.AsUnsigned();
+    unsigned to = last.AsUnsigned();
+    if (from > to || to > AFFINITY_MAX_CPU) {
+      PTRACE(2, "Affinity\tIllegal CPU range \"" << range << '"');
+      cpus.clear();
+      return FALSE;
+    }
+
+    for (unsigned cpu = from; cpu <= to; cpu++)
+      Add(cpu);
+  }
+
+  return TRUE;
+}
+
+
+void H323CPUSet::Add(unsigned cpu)
+{
+  std::vector<unsigned>::iterator it = std::lower_bound(cpus.begin(), cpus.end(), cpu);
+  if (it == cpus.end() || *it != cpu)
+    cpus.insert(it, cpu);
+}
+
+
+PBoolean H323CPUSet::Contains(unsigned cpu) const
+{
+  return std::binary_search(cpus.begin(), cpus.end(), cpu);
+}
+
+
+PBoolean H323CPUSet::ApplyToCurrentThread() const
+{
+  if (cpus.empty())
+    return TRUE;
+  return SetCurrentThread(cpus);
+}
+
+
+PBoolean H323CPUSet::ApplyToCurrentThread(PINDEX worker) const
+{
+  if (cpus.empty())
+    return TRUE;
+  return SetCurrentThread(std::vector<unsigned>(1, cpus[worker%cpus.size()]));
+}
+
+
+int H323CPUSet::GetWorkerCPU(PINDEX worker) const
+{
+  return cpus.empty() ? -1 : (int)cpus[worker%cpus.size()];
+}
+
+
+void H323CPUSet::PrintOn(ostream & strm) const
+{
+  size_t i = 0;
+  while (i < cpus.size()) {
+    size_t j = i;
+    while (j+1 < cpus.size() && cpus[j+1] == cpus[j]+1)
+      j++;
+    if (i > 0)
+      strm << ',';
+    strm << cpus[i];
+    if (j > i)
+      strm << '-' << cpus[j];
+    i = j+1;
+  }
+}
+
+
+H323CPUSet H323CPUSet::GetNodeCPUs(unsigned node)
+{
+  H323CPUSet set;
+
+#if defined(P_LINUX)
+  PTextFile file(psprintf("/sys/devices/system/node/node%u/cpulist", node), PFile::ReadOnly);
+  PString list;
+  if (file.IsOpen() && file.ReadLine(list))
+    set.Parse(list);
+  PTRACE_IF(2, set.IsEmpty(), "Affinity\tNo CPUs found for NUMA node " << node);
+#else
+  PTRACE(2, "Affinity\tNUMA nodes not supported on this platform");
+#endif
+
+  return set;
+}
+
+
+int H323CPUSet::GetCurrentCPU()
+{
+#if defined(P_LINUX)
+  return sched_getcpu();
+#elif defined(_WIN32)
+  return (int)GetCurrentProcessorNumber();
+#else
+  return -1;
+#endif
+}
+
+
+int H323CPUSet::GetSocketCPU(int handle)
+{
+#if defined(P_LINUX) && defined(SO_INCOMING_CPU)
+  int cpu = -1;
+  socklen_t len = sizeof(cpu);
+  if (handle >= 0 && getsockopt(handle, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len) == 0)
+    return cpu;
+#endif
+  return -1;
+}
+
+
+PBoolean H323CPUSet::SetCurrentThread(const std::vector<unsigned> & list)
+{
+#if defined(P_LINUX)
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  for (size_t i = 0; i < list.size(); i++) {
+    if (list[i] < CPU_SETSIZE)
+      CPU_SET(list[i], &mask);
+  }
+
+  int err = pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask);
+  if (err != 0) {
+    PTRACE(2, "Affinity\tCould not pin thread " << PThread::Current()->GetThreadName() << ", error=" << err);
+    return FALSE;
+  }
+#elif defined(_WIN32)
+  DWORD_PTR mask = 0;
+  for (size_t i = 0; i < list.size(); i++) {
+    if (list[i] < sizeof(mask)*8)
+      mask |= (DWORD_PTR)1 << list[i];
+  }
+
+  if (mask == 0 || SetThreadAffinityMask(GetCurrentThread(), mask) == 0) {
+    PTRACE(2, "Affinity\tCould not pin thread " << PThread::Current()->GetThreadName() << ", error=" << ::GetLastError());
+    return FALSE;
+  }
+#else
+  PTRACE(3, "Affinity\tThread affinity not supported on this platform");
+  return FALSE;
+#endif
+
+  PTRACE(4, "Affinity\tPinned thread " << PThread::Current()->GetThreadName() << " to " << list.size() << " CPUs");
+  return TRUE;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -325,16 +325,16 @@ PBoolean H323_AnnexG::OnReceiveDescriptorIDRequest(const H501PDU & PTRACE_PARAM(
   return FALSE;
 }
 
-PBoolean H323_AnnexG::OnReceiveDescriptorIDConfirmation(const H501PDU & PTRACE_PARAM(pdu), const H501_DescriptorIDConfirmation & /*pdu*/)
+PBoolean H323_AnnexG::OnReceiveDescriptorIDConfirmation(const H501PDU & pdu, const H501_DescriptorIDConfirmation & /*pdu*/)
 {
   PTRACE(3, "AnnexG\tOnReceiveDescriptorIDConfirmation - seq: " << pdu.m_common.m_sequenceNumber);
-  return FALSE;
+  return CheckForResponse(H501_MessageBody::e_descriptorIDRequest, pdu.m_common.m_sequenceNumber);
 }
 
-PBoolean H323_AnnexG::OnReceiveDescriptorIDRejection(const H501PDU & PTRACE_PARAM(pdu), const H501_DescriptorIDRejection & /*pdu*/)
+PBoolean H323_AnnexG::OnReceiveDescriptorIDRejection(const H501PDU & pdu, const H501_DescriptorIDRejection & pduBody)
 {
   PTRACE(3, "AnnexG\tOnReceiveDescriptorIDRejection - seq: " << pdu.m_common.m_sequenceNumber);
-  return FALSE;
+  return CheckForResponse(H501_MessageBody::e_descriptorIDRequest, pdu.m_common.m_sequenceNumber, &pduBody.m_reason);
 }
 
 PBoolean H323_AnnexG::OnReceiveDescriptorUpdate(const H501PDU & PTRACE_PARAM(pdu), const H501_DescriptorUpdate & /*pdu*/)
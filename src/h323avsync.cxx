@@ -0,0 +1,188 @@
+/*
+ * h323avsync.cxx
+ *
+ * Lip sync of received audio and video from RTCP sender reports
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "h323avsync.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#include "h323avsync.h"
+
+#define new PNEW
+
+
+static const PInt64   AdjustPeriod = 1000000;  // Microseconds between changes of the audio delay
+static const PInt64   Tolerance    = 20000;    // Microseconds of skew left alone
+static const PInt64   MaxHold      = 1000000;  // Microseconds either stream is held at most
+static const unsigned Smoothing    = 16;       // Weight of the old delay to a new sample
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323AVSync::H323AVSync()
+{
+  Reset();
+}
+
+
+void H323AVSync::Reset()
+{
+  PWaitAndSignal m(mutex);
+
+  for (PINDEX i = 0; i < NumStreams; i++) {
+    streams[i].haveReport = FALSE;
+    streams[i].reportTimestamp = 0;
+    streams[i].reportTime = 0;
+    streams[i].haveDelay = FALSE;
+    streams[i].delay = 0;
+  }
+  audioDelay = 0;
+  lastAdjust = 0;
+}
+
+
+void H323AVSync::OnSenderReport(Stream stream, DWORD rtpTimestamp, const PTime & ntpTime)
+{
+  PWaitAndSignal m(mutex);
+
+  StreamState & state = streams[stream];
+  state.haveReport = TRUE;
+  state.reportTimestamp = rtpTimestamp;
+  state.reportTime = ntpTime.GetTimestamp();
+}
+
+
+PInt64 H323AVSync::GetSenderTime(const StreamState & state, DWORD rtpTimestamp, unsigned clockRate) const
+{
+  // Signed, frames may be played from before the report
+  int elapsed = (int)(rtpTimestamp - state.reportTimestamp);
+  return state.reportTime + (PInt64)elapsed*1000000/clockRate;
+}
+
+
+void H323AVSync::OnPlayout(Stream stream, DWORD rtpTimestamp, unsigned clockRate, PInt64 now)
+{
+  if (clockRate == 0)
+    return;
+
+  PWaitAndSignal m(mutex);
+
+  StreamState & state = streams[stream];
+  if (!state.haveReport)
+    return;
+
+  PInt64 delay = now - GetSenderTime(state, rtpTimestamp, clockRate);
+  if (state.haveDelay)
+    state.delay += (delay - state.delay)/Smoothing;
+  else {
+    state.delay = delay;
+    state.haveDelay = TRUE;
+  }
+
+  if (stream == Audio)
+    Adjust(now);
+}
+
+
+void H323AVSync::Adjust(PInt64 now)
+{
+  if (!streams[Audio].haveDelay || !streams[Video].haveDelay)
+    return;
+
+  if (now - lastAdjust < AdjustPeriod)
+    return;
+  lastAdjust = now;
+
+  // The audio delay includes what was added, so this settles where audio
+  // is played as late as video, or no later than it already was
+  PInt64 skew = streams[Video].delay - streams[Audio].delay;
+  if (skew > -Tolerance && skew < Tolerance)
+    return;
+
+  PInt64 delay = (PInt64)audioDelay*1000 + skew;
+  if (delay < 0)
+    delay = 0;
+  else if (delay > MaxHold)
+    delay = MaxHold;
+
+  unsigned newDelay = (unsigned)(delay/1000);
+  if (newDelay != audioDelay) {
+    PTRACE(3, "AVSync\tAudio delay for lip sync changed from " << audioDelay << "ms to " << newDelay << "ms");
+    audioDelay = newDelay;
+  }
+}
+
+
+unsigned H323AVSync::GetAudioDelay() const
+{
+  PWaitAndSignal m(mutex);
+  return audioDelay;
+}
+
+
+PInt64 H323AVSync::GetVideoDeadline(DWORD rtpTimestamp, unsigned clockRate) const
+{
+  if (clockRate == 0)
+    return 0;
+
+  PWaitAndSignal m(mutex);
+
+  const StreamState & video = streams[Video];
+  const StreamState & audio = streams[Audio];
+  if (!video.haveReport || !audio.haveDelay || !video.haveDelay)
+    return 0;
+
+  // Held to where audio sent at the same time plays, when that is later
+  PInt64 lag = audio.delay - video.delay;
+  if (lag < Tolerance)
+    return 0;
+
+  if (lag > MaxHold)
+    lag = MaxHold;
+
+  return GetSenderTime(video, rtpTimestamp, clockRate) + video.delay + lag;
+}
+
+
+int H323AVSync::GetSkew() const
+{
+  PWaitAndSignal m(mutex);
+
+  if (!streams[Audio].haveDelay || !streams[Video].haveDelay)
+    return 0;
+
+  return (int)((streams[Video].delay - streams[Audio].delay + (PInt64)audioDelay*1000)/1000);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
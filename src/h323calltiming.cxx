@@ -0,0 +1,203 @@
+/*
+ * h323calltiming.cxx
+ *
+ * Timing of the call setup milestones
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "h323calltiming.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#include "h323calltiming.h"
+
+#include <algorithm>
+
+#define new PNEW
+
+
+static const char * const MilestoneNames[H323CallTimeline::NumMilestones] = {
+  "AddressResolved",
+  "AdmissionRequested",
+  "AdmissionConfirmed",
+  "TransportConnected",
+  "SetupBuilt",
+  "SetupSent",
+  "SetupReceived",
+  "CallProceeding",
+  "Alerting",
+  "Connect",
+  "CapabilityExchangeDone",
+  "MasterSlaveDone",
+  "FirstChannelOpened",
+  "FirstRTPSent",
+  "FirstRTPReceived",
+  "Established",
+  "Cleared"
+};
+
+
+static bool LessTime(const std::pair<PInt64, PString> & a, const std::pair<PInt64, PString> & b)
+{
+  return a.first < b.first;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323CallTimeline::H323CallTimeline()
+  : start(PTimer::Tick().GetMilliSeconds())
+{
+  for (PINDEX i = 0; i < NumMilestones; i++)
+    times[i] = -1;
+}
+
+
+void H323CallTimeline::SetStart(const PTimeInterval & tick)
+{
+  PWaitAndSignal m(mutex);
+
+  // Milestones already reached keep their tick
+  PInt64 delta = start - tick.GetMilliSeconds();
+  start = tick.GetMilliSeconds();
+  for (PINDEX i = 0; i < NumMilestones; i++) {
+    if (times[i] >= 0)
+      times[i] += delta;
+  }
+  for (size_t i = 0; i < events.size(); i++)
+    events[i].first += delta;
+}
+
+
+void H323CallTimeline::Mark(Milestone milestone)
+{
+  PWaitAndSignal m(mutex);
+
+  if (times[milestone] < 0)
+    times[milestone] = PTimer::Tick().GetMilliSeconds() - start;
+}
+
+
+void H323CallTimeline::AddEvent(const PString & description)
+{
+  PWaitAndSignal m(mutex);
+
+  events.push_back(std::pair<PInt64, PString>(PTimer::Tick().GetMilliSeconds() - start, description));
+}
+
+
+PInt64 H323CallTimeline::GetTime(Milestone milestone) const
+{
+  PWaitAndSignal m(mutex);
+  return times[milestone];
+}
+
+
+PInt64 H323CallTimeline::GetElapsed() const
+{
+  PWaitAndSignal m(mutex);
+  return PTimer::Tick().GetMilliSeconds() - start;
+}
+
+
+const char * H323CallTimeline::GetMilestoneName(Milestone milestone)
+{
+  return milestone < NumMilestones ? MilestoneNames[milestone] : "<unknown>";
+}
+
+
+void H323CallTimeline::PrintOn(ostream & strm) const
+{
+  std::vector<std::pair<PInt64, PString> > lines;
+
+  {
+    PWaitAndSignal m(mutex);
+    for (PINDEX i = 0; i < NumMilestones; i++) {
+      if (times[i] >= 0)
+        lines.push_back(std::pair<PInt64, PString>(times[i], MilestoneNames[i]));
+    }
+    lines.insert(lines.end(), events.begin(), events.end());
+  }
+
+  // Milestones reached at the same time stay in protocol order
+  std::stable_sort(lines.begin(), lines.end(), LessTime);
+
+  PInt64 previous = 0;
+  for (size_t i = 0; i < lines.size(); i++) {
+    strm << setw(8) << lines[i].first << "ms +" << setw(6) << left << (lines[i].first - previous)
+         << right << ' ' << lines[i].second << '\n';
+    previous = lines[i].first;
+  }
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323CallTimingStats::H323CallTimingStats()
+{
+}
+
+
+void H323CallTimingStats::Record(const H323CallTimeline & timeline)
+{
+  PInt64 times[H323CallTimeline::NumMilestones];
+  for (PINDEX i = 0; i < H323CallTimeline::NumMilestones; i++)
+    times[i] = timeline.GetTime((H323CallTimeline::Milestone)i);
+
+  PWaitAndSignal m(mutex);
+
+  for (PINDEX i = 0; i < H323CallTimeline::NumMilestones; i++) {
+    if (times[i] >= 0)
+      histograms[i].Record(times[i] < (PInt64)0xffffffff ? (DWORD)times[i] : 0xffffffff);
+  }
+}
+
+
+void H323CallTimingStats::GetSnapshot(H323CallTimeline::Milestone milestone,
+                                      RTP_Histogram::Snapshot & snapshot) const
+{
+  histograms[milestone].GetSnapshot(snapshot);
+}
+
+
+void H323CallTimingStats::PrintOn(ostream & strm) const
+{
+  RTP_Histogram::Snapshot snapshot;
+  for (PINDEX i = 0; i < H323CallTimeline::NumMilestones; i++) {
+    histograms[i].GetSnapshot(snapshot);
+    if (snapshot.GetCount() > 0)
+      strm << setw(22) << left << H323CallTimeline::GetMilestoneName((H323CallTimeline::Milestone)i)
+           << right << ' ' << snapshot << '\n';
+  }
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -62,6 +62,9 @@ DEFINE_G711_CAPABILITY(H323_G711uLaw64Capability, H323_G711Capability::muLaw, "G
 
 #define new PNEW
 
+/* Most wildcard names kept matched against a capability table */
+#define H323_CAPABILITY_NAME_CACHE 32
+
 
 #if PTRACING
 ostream & operator<<(ostream & o , H323Capability::MainTypes t)
@@ -650,17 +653,45 @@ H323GenericCapabilityInfo::H323GenericCapabilityInfo(const H323GenericCapability
 H323GenericCapabilityInfo::~H323GenericCapabilityInfo()
 {
   delete identifier;
+  for (PINDEX i = 0; i <= H323Capability::e_ReqMode; i++)
+    delete cachedPDU[i].pdu;
 }
 
 
 PBoolean H323GenericCapabilityInfo::OnSendingGenericPDU(H245_GenericCapability & pdu,
                                                     const OpalMediaFormat & mediaFormat,
                                                     H323Capability::CommandType type) const
+{
+  // Sent in every TCS and OLC, so only built again when the options change
+  CachedPDU & cached = cachedPDU[type];
+  if (cached.pdu != NULL &&
+      cached.revision == mediaFormat.GetOptionsRevision() &&
+      cached.bitRate == maxBitRate) {
+    pdu = *cached.pdu;
+    return TRUE;
+  }
+
+  if (!BuildGenericPDU(pdu, mediaFormat, type))
+    return FALSE;
+
+  if (cached.pdu == NULL)
+    cached.pdu = new H245_GenericCapability(pdu);
+  else
+    *cached.pdu = pdu;
+  cached.revision = mediaFormat.GetOptionsRevision();
+  cached.bitRate = maxBitRate;
+  return TRUE;
+}
+
+
+PBoolean H323GenericCapabilityInfo::BuildGenericPDU(H245_GenericCapability & pdu,
+                                                const OpalMediaFormat & mediaFormat,
+                                                H323Capability::CommandType type) const
 {
   pdu.m_capabilityIdentifier = *identifier;
 
 #ifdef H323_VIDEO
-  unsigned pbitRate = mediaFormat.GetOptionInteger(OpalVideoFormat::MaxBitRateOption)/100;
+  unsigned pbitRate = mediaFormat.GetOptionInteger(OpalVideoFormat::MaxBitRateKey)/100;
   unsigned bitRate = maxBitRate != 0 ? maxBitRate : pbitRate;
   if (pbitRate < bitRate)
         bitRate = pbitRate;
@@ -766,7 +797,7 @@ PBoolean H323GenericCapabilityInfo::OnReceivedGenericPDU(OpalMediaFormat & media
   if (pdu.HasOptionalField(H245_GenericCapability::e_maxBitRate)) {
     maxBitRate = pdu.m_maxBitRate;
 #ifdef H323_VIDEO
-    mediaFormat.SetOptionInteger(OpalVideoFormat::MaxBitRateOption, maxBitRate*100);
+    mediaFormat.SetOptionInteger(OpalVideoFormat::MaxBitRateKey, maxBitRate*100);
 #else
     mediaFormat.SetOptionInteger(maxBitRate, maxBitRate*100);
 #endif
@@ -2633,6 +2664,30 @@ PString H323_IPProtocolCapability::GetFormatName() const
 
 #endif  // H323_IPV6
 
+////////////////////////////////////////////////////////////////////////////
+
+#ifdef H323_AUDIO_CODECS
+
+static const char * ComfortNoiseOID = "1.3.6.1.4.1.17090.1.3";  // RFC 3389 Comfort Noise
+
+H323_ComfortNoiseCapability::H323_ComfortNoiseCapability()
+: H323GenericControlCapability(ComfortNoiseOID)
+{
+}
+
+PObject * H323_ComfortNoiseCapability::Clone() const
+{
+  return new H323_ComfortNoiseCapability(*this);
+}
+
+
+PString H323_ComfortNoiseCapability::GetFormatName() const
+{
+  return "Comfort Noise";
+}
+
+#endif  // H323_AUDIO_CODECS
+
 /////////////////////////////////////////////////////////////////////////////
 
 H323DataCapability::H323DataCapability(unsigned rate)
@@ -3209,12 +3264,20 @@ PBoolean H323CapabilitiesSet::SetSize(PINDEX newSize)
 
 
 H323Capabilities::H323Capabilities()
+  : shared(NULL),
+    sharedIntact(FALSE),
+    snapshotReferences(1),
+    indexedSize(P_MAX_INDEX)
 {
 }
 
 
 H323Capabilities::H323Capabilities(const H323Connection & connection,
                                    const H245_TerminalCapabilitySet & pdu)
+  : shared(NULL),
+    sharedIntact(FALSE),
+    snapshotReferences(1),
+    indexedSize(P_MAX_INDEX)
 {
   const H323Capabilities & localCapabilities = connection.GetLocalCapabilities();
 
@@ -3246,12 +3309,9 @@ H323Capabilities::H323Capabilities(const H323Connection & connection,
       for (PINDEX middle = 0; middle < middleSize; middle++) {
         H245_AlternativeCapabilitySet & alt = desc.m_simultaneousCapabilities[middle];
         for (PINDEX inner = 0; inner < alt.GetSize(); inner++) {
-          for (PINDEX cap = 0; cap < table.GetSize(); cap++) {
-            if (table[cap].GetCapabilityNumber() == alt[inner]) {
-              set[outer][middle].Append(&table[cap]);
-              break;
-            }
-          }
+          H323Capability * capability = FindCapability(alt[inner]);
+          if (capability != NULL)
+            set[outer][middle].Append(capability);
         }
       }
     }
@@ -3260,11 +3320,23 @@ H323Capabilities::H323Capabilities(const H323Connection & connection,
 
 
 H323Capabilities::H323Capabilities(const H323Capabilities & original)
+  : PObject(original),
+    shared(NULL),
+    sharedIntact(FALSE),
+    snapshotReferences(1),
+    indexedSize(P_MAX_INDEX)
 {
   operator=(original);
 }
 
 
+H323Capabilities::~H323Capabilities()
+{
+  if (shared != NULL)
+    ReleaseSnapshot(shared);
+}
+
+
 H323Capabilities & H323Capabilities::operator=(const H323Capabilities & original)
 {
   RemoveAll();
@@ -3288,6 +3360,142 @@ H323Capabilities & H323Capabilities::operator=(const H323Capabilities & original
 }
 
 
+H323Capabilities * H323Capabilities::CreateSnapshot(const H323Capabilities & original)
+{
+  return new H323Capabilities(original);
+}
+
+
+void H323Capabilities::ReleaseSnapshot(const H323Capabilities * snapshot)
+{
+  if (snapshot != NULL && --snapshot->snapshotReferences == 0)
+    delete snapshot;
+}
+
+
+void H323Capabilities::Share(const H323Capabilities & snapshot)
+{
+  if (&snapshot == shared)
+    return;
+
+  // A set that is itself sharing may have changed some capabilities, so copy it
+  if (snapshot.shared != NULL) {
+    operator=(snapshot);
+    return;
+  }
+
+  ++snapshot.snapshotReferences;
+  RemoveAll();
+  shared = &snapshot;
+  table.DisallowDeleteObjects();
+
+  for (PINDEX i = 0; i < snapshot.table.GetSize(); i++)
+    table.Append(&snapshot.table[i]);
+  InvalidateIndex();
+  sharedIntact = TRUE;
+
+  PINDEX outerSize = snapshot.set.GetSize();
+  set.SetSize(outerSize);
+  for (PINDEX outer = 0; outer < outerSize; outer++) {
+    PINDEX middleSize = snapshot.set[outer].GetSize();
+    set[outer].SetSize(middleSize);
+    for (PINDEX middle = 0; middle < middleSize; middle++) {
+      PINDEX innerSize = snapshot.set[outer][middle].GetSize();
+      for (PINDEX inner = 0; inner < innerSize; inner++)
+        set[outer][middle].Append(&snapshot.set[outer][middle][inner]);
+    }
+  }
+}
+
+
+void H323Capabilities::ReplaceCapability(PINDEX index, H323Capability * capability)
+{
+  H323Capability * old = &table[index];
+  table.SetAt(index, capability);
+  InvalidateIndex();
+
+  for (PINDEX outer = 0; outer < set.GetSize(); outer++) {
+    for (PINDEX middle = 0; middle < set[outer].GetSize(); middle++) {
+      H323CapabilitiesList & list = set[outer][middle];
+      for (PINDEX inner = 0; inner < list.GetSize(); inner++) {
+        if (&list[inner] == old)
+          list.SetAt(inner, capability);
+      }
+    }
+  }
+}
+
+
+H323Capability * H323Capabilities::GetWritable(H323Capability * capability)
+{
+  if (shared == NULL || capability == NULL || owned.GetObjectsIndex(capability) != P_MAX_INDEX)
+    return capability;
+
+  PINDEX index = table.GetObjectsIndex(capability);
+  if (index == P_MAX_INDEX)
+    return capability;
+
+  H323Capability * copy = (H323Capability *)capability->Clone();
+  ReplaceCapability(index, copy);
+  owned.Append(copy);
+
+  PTRACE(4, "H323\tCopied shared capability " << *copy);
+  return copy;
+}
+
+
+void H323Capabilities::MakeUnique()
+{
+  if (shared == NULL)
+    return;
+
+  for (PINDEX i = 0; i < table.GetSize(); i++)
+    GetWritable(&table[i]);
+
+  // Every capability is now owned, so the table can delete them again
+  owned.DisallowDeleteObjects();
+  owned.RemoveAll();
+  owned.AllowDeleteObjects();
+  table.AllowDeleteObjects();
+
+  ReleaseSnapshot(shared);
+  shared = NULL;
+}
+
+
+void H323Capabilities::InvalidateIndex()
+{
+  PWaitAndSignal mutex(indexMutex);
+  indexedSize = P_MAX_INDEX;
+  sharedIntact = FALSE;
+}
+
+
+void H323Capabilities::UpdateIndex() const
+{
+  // Called with indexMutex held. Capabilities appended directly to the table
+  // change its size, so are picked up as well as those given to Add().
+  if (indexedSize == table.GetSize())
+    return;
+
+  numberIndex.clear();
+  typeIndex.clear();
+  nameIndex.clear();
+
+  // insert() leaves an existing entry alone, so the first in the table is kept
+  for (PINDEX i = 0; i < table.GetSize(); i++) {
+    H323Capability * capability = &table[i];
+    int mainType = capability->GetMainType();
+    numberIndex.insert(NumberIndex::value_type(capability->GetCapabilityNumber(), capability));
+    typeIndex.insert(TypeIndex::value_type(TypeIndex::key_type(mainType, capability->GetSubType()), capability));
+    typeIndex.insert(TypeIndex::value_type(TypeIndex::key_type(mainType, UINT_MAX), capability));
+  }
+
+  indexedSize = table.GetSize();
+  PTRACE(5, "H323\tIndexed " << indexedSize << " capabilities");
+}
+
+
 void H323Capabilities::PrintOn(ostream & strm) const
 {
   int indent = (int)strm.precision()-1;
@@ -3434,6 +3642,9 @@ void H323Capabilities::Add(H323Capability * capability)
 
   capability->SetCapabilityNumber(MergeCapabilityNumber(table, capability->GetCapabilityNumber()));
   table.Append(capability);
+  if (shared != NULL)
+    owned.Append(capability);
+  InvalidateIndex();
 
   OpalMediaFormat::DebugOptionList(capability->GetMediaFormat());
 }
@@ -3444,6 +3655,9 @@ H323Capability * H323Capabilities::Copy(const H323Capability & capability)
   H323Capability * newCapability = (H323Capability *)capability.Clone();
   newCapability->SetCapabilityNumber(MergeCapabilityNumber(table, capability.GetCapabilityNumber()));
   table.Append(newCapability);
+  if (shared != NULL)
+    owned.Append(newCapability);
+  InvalidateIndex();
 
   PTRACE(3, "H323\tAdded capability: " << *newCapability);
   return newCapability;
@@ -3503,6 +3717,11 @@ void H323Capabilities::Remove(H323Capability * capability)
      RemoveSecure(capabilityNumber);
 #endif
   table.Remove(capability);
+  InvalidateIndex();
+
+  // A shared capability is only taken out of this set
+  if (shared != NULL)
+    owned.Remove(capability);
 }
 
 
@@ -3531,38 +3750,60 @@ void H323Capabilities::RemoveAll()
 {
   table.RemoveAll();
   set.RemoveAll();
+  InvalidateIndex();
+
+  if (shared != NULL) {
+    owned.RemoveAll();
+    table.AllowDeleteObjects();
+    ReleaseSnapshot(shared);
+    shared = NULL;
+  }
 }
 
 
 H323Capability * H323Capabilities::FindCapability(unsigned capabilityNumber) const
 {
-  PTRACE(4, "H323\tFindCapability: " << capabilityNumber);
+  PWaitAndSignal mutex(indexMutex);
+  UpdateIndex();
 
-  for (PINDEX i = 0; i < table.GetSize(); i++) {
-    if (table[i].GetCapabilityNumber() == capabilityNumber) {
-      PTRACE(3, "H323\tFound capability: " << table[i]);
-      return &table[i];
-    }
+  NumberIndex::const_iterator it = numberIndex.find(capabilityNumber);
+  if (it == numberIndex.end()) {
+    PTRACE(5, "H323\tFindCapability: " << capabilityNumber << " not found");
+    return NULL;
   }
 
-  return NULL;
+  PTRACE(5, "H323\tFound capability: " << *it->second);
+  return it->second;
 }
 
 
 H323Capability * H323Capabilities::FindCapability(const PString & formatName,
                               H323Capability::CapabilityDirection direction) const
 {
-  PTRACE(4, "H323\tFindCapability: \"" << formatName << '"');
+  PWaitAndSignal mutex(indexMutex);
+  UpdateIndex();
 
-  PStringArray wildcard = formatName.Tokenise('*', FALSE);
+  NameIndex::iterator it = nameIndex.find(formatName);
+  if (it == nameIndex.end()) {
+    // First use of this name, match it against the whole table once
+    if (nameIndex.size() >= H323_CAPABILITY_NAME_CACHE)
+      nameIndex.clear();
 
-  for (PINDEX i = 0; i < table.GetSize(); i++) {
-    PCaselessString str = table[i].GetFormatName();
-    if (MatchWildcard(str, wildcard) &&
-          (direction == H323Capability::e_Unknown ||
-           table[i].GetCapabilityDirection() == direction)) {
-      PTRACE(3, "H323\tFound capability: " << table[i]);
-      return &table[i];
+    PStringArray wildcard = formatName.Tokenise('*', FALSE);
+    it = nameIndex.insert(NameIndex::value_type(formatName, std::vector<H323Capability *>())).first;
+    for (PINDEX i = 0; i < table.GetSize(); i++) {
+      PCaselessString str = table[i].GetFormatName();
+      if (MatchWildcard(str, wildcard))
+        it->second.push_back(&table[i]);
+    }
+    PTRACE(4, "H323\tFindCapability: \"" << formatName << "\" matches " << it->second.size());
+  }
+
+  const std::vector<H323Capability *> & matches = it->second;
+  for (size_t i = 0; i < matches.size(); i++) {
+    if (direction == H323Capability::e_Unknown || matches[i]->GetCapabilityDirection() == direction) {
+      PTRACE(5, "H323\tFound capability: " << *matches[i]);
+      return matches[i];
     }
   }
 
@@ -3664,7 +3905,19 @@ H323Capability * H323Capabilities::FindCapability(const H245_Capability & cap) c
       return FindCapability(H323Capability::e_UserInput, SignalToneRFC2833_SubType);
 
     case H245_Capability::e_genericControlCapability :
+    {
+      // Several generic controls may be held, told apart by identifier
+      const H245_GenericCapability & gen = cap;
+      if (gen.m_capabilityIdentifier.GetTag() == H245_CapabilityIdentifier::e_standard) {
+        const PASN_ObjectId & id = gen.m_capabilityIdentifier;
+        PString oid = id.AsString();
+        for (PINDEX i = 0; i < table.GetSize(); i++) {
+          if (table[i].GetMainType() == H323Capability::e_GenericControl && table[i].GetIdentifier() == oid)
+            return &table[i];
+        }
+      }
       return FindCapability(H323Capability::e_GenericControl);
+    }
 
     case H245_Capability::e_conferenceCapability :
       return FindCapability(H323Capability::e_ConferenceControl);
@@ -3928,20 +4181,17 @@ H323Capability * H323Capabilities::FindCapability(H323Capability::MainTypes main
 H323Capability * H323Capabilities::FindCapability(H323Capability::MainTypes mainType,
                                                   unsigned subType) const
 {
-  if (subType != UINT_MAX) {
-     PTRACE(4, "H323\tFindCapability: " << mainType << " subtype=" << subType);
-  }
+  PWaitAndSignal mutex(indexMutex);
+  UpdateIndex();
 
-  for (PINDEX i = 0; i < table.GetSize(); i++) {
-    H323Capability & capability = table[i];
-    if (capability.GetMainType() == mainType &&
-                        (subType == UINT_MAX || capability.GetSubType() == subType)) {
-      PTRACE(3, "H323\tFound capability: " << capability);
-      return &capability;
-    }
+  TypeIndex::const_iterator it = typeIndex.find(TypeIndex::key_type(mainType, subType));
+  if (it == typeIndex.end()) {
+    PTRACE(5, "H323\tFindCapability: " << mainType << " subtype=" << subType << " not found");
+    return NULL;
   }
 
-  return NULL;
+  PTRACE(5, "H323\tFound capability: " << *it->second);
+  return it->second;
 }
 
 PBoolean H323Capabilities::RemoveCapability(H323Capability::MainTypes capabilityType)
@@ -3975,7 +4225,7 @@ PBoolean H323Capabilities::SetVideoEncoder(unsigned frameWidth, unsigned frameHe
        for (PINDEX i = 0; i < table.GetSize(); i++) {
      H323Capability & capability = table[i];
       if (capability.GetMainType() == H323Capability::e_Video)
-         capability.SetCustomEncode(frameWidth,frameHeight,frameRate);
+         GetWritable(&capability)->SetCustomEncode(frameWidth,frameHeight,frameRate);
     }
     return true;
 }
@@ -4021,7 +4271,7 @@ PBoolean H323Capabilities::SetVideoFrameSize(H323Capability::CapabilityFrameSize
     for (PINDEX i = 0; i < table.GetSize(); i++) {
         H323Capability & capability = table[i];
         if (capability.GetMainType() == H323Capability::e_Video)
-                 capability.SetMaxFrameSize(frameSize,frameUnits);
+                 GetWritable(&capability)->SetMaxFrameSize(frameSize,frameUnits);
     }
     return TRUE;
 }
@@ -4041,6 +4291,8 @@ void H323Capabilities::BuildPDU(const H323Connection & connection,
 
   H245_H2250Capability & h225_0 = pdu.m_multiplexCapability;
   PINDEX rtpPacketizationCount = 0;
+  PBoolean audioRedundancy = connection.GetEndPoint().GetAudioRedundancy() > 0;
+  PINDEX redundancyCount = 0;
 
   PINDEX count = 0;
   for (PINDEX i = 0; i < tableSize; i++) {
@@ -4064,9 +4316,23 @@ void H323Capabilities::BuildPDU(const H323Connection & connection,
         if (test == rtpPacketizationCount)
           rtpPacketizationCount++;
       }
+
+      // RFC 2198 redundancy with copies in the same encoding
+      if (audioRedundancy && capability.GetMainType() == H323Capability::e_Audio && redundancyCount < 256) {
+        h225_0.m_redundancyEncodingCapability.SetSize(redundancyCount+1);
+        H245_RedundancyEncodingCapability & redundancy = h225_0.m_redundancyEncodingCapability[redundancyCount++];
+        redundancy.m_redundancyEncodingMethod.SetTag(H245_RedundancyEncodingMethod::e_rtpAudioRedundancyEncoding);
+        redundancy.m_primaryEncoding = capability.GetCapabilityNumber();
+        redundancy.IncludeOptionalField(H245_RedundancyEncodingCapability::e_secondaryEncoding);
+        redundancy.m_secondaryEncoding.SetSize(1);
+        redundancy.m_secondaryEncoding[0] = capability.GetCapabilityNumber();
+      }
     }
   }
 
+  if (redundancyCount > 0)
+    h225_0.IncludeOptionalField(H245_H2250Capability::e_redundancyEncodingCapability);
+
   // Have some mediaPacketizations to include.
   if (rtpPacketizationCount > 0) {
     h225_0.m_mediaPacketizationCapability.m_rtpPayloadType.SetSize(rtpPacketizationCount);
@@ -4163,6 +4429,13 @@ void H323Capabilities::Reorder(const PStringArray & preferenceOrder)
     }
   }
 
+  OrderSetByTable();
+}
+
+
+// Put the capabilities of each simultaneous list in table order
+void H323Capabilities::OrderSetByTable()
+{
   for (PINDEX outer = 0; outer < set.GetSize(); outer++) {
     for (PINDEX middle = 0; middle < set[outer].GetSize(); middle++) {
       H323CapabilitiesList & list = set[outer][middle];
@@ -4177,7 +4450,120 @@ void H323Capabilities::Reorder(const PStringArray & preferenceOrder)
     }
   }
 
-  table.AllowDeleteObjects();
+  // A shared table never deletes its capabilities
+  if (shared == NULL)
+    table.AllowDeleteObjects();
+
+  InvalidateIndex();
+}
+
+
+void H323Capabilities::PreferMatching(const H323Capabilities & other)
+{
+  PStringArray preferred;
+  for (PINDEX i = 0; i < table.GetSize(); i++) {
+    if (other.FindCapability(table[i]) != NULL)
+      preferred.AppendString(table[i].GetFormatName());
+  }
+
+  PTRACE(4, "H323\tPreferring " << preferred.GetSize() << " capabilities in common");
+  Reorder(preferred);
+}
+
+
+void H323Capabilities::OrderByCost(const H323CapabilityCostModel & model, const H323Connection & connection)
+{
+  PINDEX count = table.GetSize();
+  if (count < 2)
+    return;
+
+  std::vector<std::pair<unsigned, PINDEX> > costs(count);
+  for (PINDEX i = 0; i < count; i++)
+    costs[i] = std::pair<unsigned, PINDEX>(model.GetCost(connection, table[i]), i);
+
+  // Stable on the original position, so equal costs keep their order
+  std::sort(costs.begin(), costs.end());
+
+  PINDEX moved = 0;
+  for (PINDEX i = 0; i < count; i++) {
+    if (costs[i].second != i)
+      moved++;
+  }
+
+  if (moved == 0)
+    return;
+
+  PTRACE(4, "H323\tOrdering capabilities by cost, " << moved << " moved");
+
+  std::vector<H323Capability *> ordered(count);
+  for (PINDEX i = 0; i < count; i++)
+    ordered[i] = &table[costs[i].second];
+
+  table.DisallowDeleteObjects();
+  while (table.GetSize() > 0)
+    table.RemoveAt(0);
+  for (PINDEX i = 0; i < count; i++)
+    table.Append(ordered[i]);
+
+  OrderSetByTable();
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323CapabilityCostModel::H323CapabilityCostModel()
+  : loadThreshold(80)
+{
+}
+
+
+void H323CapabilityCostModel::SetCodecCost(const PString & formatName, unsigned cost)
+{
+  PWaitAndSignal m(mutex);
+
+  CodecCost entry;
+  entry.wildcard = formatName.Tokenise('*', FALSE);
+  entry.cost = cost;
+  codecCosts.push_back(entry);
+}
+
+
+unsigned H323CapabilityCostModel::GetCodecCost(const PString & formatName) const
+{
+  PWaitAndSignal m(mutex);
+
+  for (std::vector<CodecCost>::const_iterator it = codecCosts.begin(); it != codecCosts.end(); ++it) {
+    if (MatchWildcard(formatName, it->wildcard))
+      return it->cost;
+  }
+  return 0;
+}
+
+
+unsigned H323CapabilityCostModel::GetCost(const H323Connection & connection, const H323Capability & capability) const
+{
+  if (CanPassThrough(connection, capability))
+    return 0;
+
+  if (!IsUnderLoad(connection))
+    return 1;
+
+  return 1 + GetCodecCost(capability.GetFormatName());
+}
+
+
+PBoolean H323CapabilityCostModel::CanPassThrough(const H323Connection & connection, const H323Capability & capability) const
+{
+  const H323Capabilities & otherLeg = connection.GetOtherLegCapabilities();
+  return otherLeg.GetSize() > 0 && otherLeg.FindCapability(capability) != NULL;
+}
+
+
+PBoolean H323CapabilityCostModel::IsUnderLoad(const H323Connection & connection) const
+{
+  const H323EncodeBudget & budget = connection.GetEndPoint().GetEncodeBudget();
+  unsigned limit = budget.GetBudget();
+  return limit > 0 && budget.GetTotalLoad()*100 >= limit*loadThreshold;
 }
 
 
@@ -4253,6 +4639,36 @@ const H323CapabilitiesSet & H323Capabilities::GetSet() const
 
 /////////////////////////////////////////////////////////////////////////////
 
+H323CapabilityMemo::H323CapabilityMemo(const H323Connection & connection,
+                                       const H245_TerminalCapabilitySet & pdu,
+                                       const PBYTEArray & tcs)
+  : H323Capabilities(connection, pdu),
+    encoding(tcs)
+{
+}
+
+
+PBoolean H323CapabilityMemo::GetSelection(unsigned sessionID, Selection & selection) const
+{
+  PWaitAndSignal mutex(selectionMutex);
+
+  std::map<unsigned, Selection>::const_iterator it = selections.find(sessionID);
+  if (it == selections.end())
+    return FALSE;
+
+  selection = it->second;
+  return TRUE;
+}
+
+
+void H323CapabilityMemo::SetSelection(unsigned sessionID, const Selection & selection) const
+{
+  PWaitAndSignal mutex(selectionMutex);
+  selections[sessionID] = selection;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
 #ifndef PASN_NOPRINTON
 
 
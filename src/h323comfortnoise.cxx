@@ -0,0 +1,254 @@
+/*
+ * h323comfortnoise.cxx
+ *
+ * RFC 3389 comfort noise for 16 bit PCM audio
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "h323comfortnoise.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#include "h323comfortnoise.h"
+
+#include <math.h>
+
+#define new PNEW
+
+/* Mean square of a full scale square wave, 0 dBov */
+#define CN_OVERLOAD (32767.0*32767.0)
+
+/* Lowest level sent, which is no noise at all */
+#define CN_MIN_LEVEL 127
+
+/* Move in level that sends a new descriptor */
+#define CN_LEVEL_CHANGE 3
+
+/* Weight of each silent frame in the average */
+#define CN_AVERAGE 8
+
+
+static BYTE QuantiseReflection(double k)
+{
+  int n = 127 + (int)floor(k*128 + 0.5);
+  return (BYTE)(n < 0 ? 0 : n > 254 ? 254 : n);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323ComfortNoiseEncoder::H323ComfortNoiseEncoder(unsigned sampleRate)
+  : averaging(FALSE),
+    sentLevel(CN_MIN_LEVEL),
+    minInterval(sampleRate/10),
+    maxInterval(sampleRate*5),
+    sinceSent(0),
+    descriptorCount(0)
+{
+  for (PINDEX i = 0; i <= H323_COMFORTNOISE_ORDER; i++)
+    autocorrelation[i] = 0;
+  memset(descriptor, 0, sizeof(descriptor));
+  descriptor[0] = CN_MIN_LEVEL;
+}
+
+
+PBoolean H323ComfortNoiseEncoder::OnSilence(const short * pcm, PINDEX samples)
+{
+  if (samples <= H323_COMFORTNOISE_ORDER)
+    return FALSE;
+
+  double frame[H323_COMFORTNOISE_ORDER+1];
+  for (PINDEX lag = 0; lag <= H323_COMFORTNOISE_ORDER; lag++) {
+    double sum = 0;
+    for (PINDEX i = lag; i < samples; i++)
+      sum += (double)pcm[i]*pcm[i-lag];
+    frame[lag] = sum/(samples-lag);
+  }
+
+  PBoolean due;
+  if (averaging) {
+    for (PINDEX lag = 0; lag <= H323_COMFORTNOISE_ORDER; lag++)
+      autocorrelation[lag] += (frame[lag] - autocorrelation[lag])/CN_AVERAGE;
+    sinceSent += samples;
+    due = FALSE;
+  }
+  else {
+    // The end of a talk burst starts from this frame alone
+    for (PINDEX lag = 0; lag <= H323_COMFORTNOISE_ORDER; lag++)
+      autocorrelation[lag] = frame[lag];
+    averaging = TRUE;
+    due = TRUE;
+  }
+
+  int level = CN_MIN_LEVEL;
+  if (autocorrelation[0] >= 1) {
+    level = (int)floor(10*log10(CN_OVERLOAD/autocorrelation[0]) + 0.5);
+    if (level < 0)
+      level = 0;
+    else if (level > CN_MIN_LEVEL)
+      level = CN_MIN_LEVEL;
+  }
+
+  if (!due) {
+    int change = level - sentLevel;
+    due = (sinceSent >= minInterval && (change >= CN_LEVEL_CHANGE || change <= -CN_LEVEL_CHANGE)) ||
+          sinceSent >= maxInterval;
+    if (!due)
+      return FALSE;
+  }
+
+  // Levinson-Durbin for the reflection coefficients, with a touch of white
+  // noise so a pure tone or digital silence stays stable
+  double error = autocorrelation[0]*1.0001;
+  double a[H323_COMFORTNOISE_ORDER+1] = { 1 };
+  double k[H323_COMFORTNOISE_ORDER] = { 0 };
+  if (error > 0) {
+    for (PINDEX i = 1; i <= H323_COMFORTNOISE_ORDER; i++) {
+      double sum = autocorrelation[i];
+      for (PINDEX j = 1; j < i; j++)
+        sum += a[j]*autocorrelation[i-j];
+      k[i-1] = -sum/error;
+
+      double previous[H323_COMFORTNOISE_ORDER+1];
+      memcpy(previous, a, sizeof(a));
+      for (PINDEX j = 1; j < i; j++)
+        a[j] = previous[j] + k[i-1]*previous[i-j];
+      a[i] = k[i-1];
+
+      error *= 1 - k[i-1]*k[i-1];
+      if (error <= 0)
+        break;
+    }
+  }
+
+  descriptor[0] = (BYTE)level;
+  for (PINDEX i = 0; i < H323_COMFORTNOISE_ORDER; i++)
+    descriptor[i+1] = QuantiseReflection(k[i]);
+
+  sentLevel = (BYTE)level;
+  sinceSent = 0;
+  descriptorCount++;
+
+  PTRACE(5, "CN\tSilence descriptor level -" << level << "dBov");
+  return TRUE;
+}
+
+
+void H323ComfortNoiseEncoder::OnTalk()
+{
+  averaging = FALSE;
+}
+
+
+PINDEX H323ComfortNoiseEncoder::GetDescriptor(BYTE * buffer) const
+{
+  memcpy(buffer, descriptor, H323_COMFORTNOISE_MAX_SID);
+  return H323_COMFORTNOISE_MAX_SID;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323ComfortNoiseGenerator::H323ComfortNoiseGenerator()
+  : active(FALSE),
+    started(FALSE),
+    order(0),
+    gain(0),
+    targetGain(0),
+    seed(0x12345678),
+    descriptorCount(0)
+{
+  for (PINDEX i = 0; i < H323_COMFORTNOISE_ORDER; i++)
+    reflection[i] = 0;
+  for (PINDEX i = 0; i <= H323_COMFORTNOISE_ORDER; i++)
+    state[i] = 0;
+}
+
+
+PBoolean H323ComfortNoiseGenerator::OnDescriptor(const BYTE * sid, PINDEX length)
+{
+  if (sid == NULL || length < 1)
+    return FALSE;
+
+  // Coefficients past our order are left out, the shorter filter is still
+  // stable and near enough for noise
+  order = length-1 < H323_COMFORTNOISE_ORDER ? length-1 : H323_COMFORTNOISE_ORDER;
+  double prediction = 1;
+  for (unsigned i = 0; i < order; i++) {
+    reflection[i] = ((int)sid[i+1] - 127)/128.0;
+    prediction *= 1 - reflection[i]*reflection[i];
+  }
+
+  // The filter gains the excitation by the inverse of the prediction error,
+  // and uniform noise on -1 to 1 has a mean square of a third
+  unsigned level = sid[0] & 0x7f;
+  double meanSquare = level >= CN_MIN_LEVEL ? 0 : CN_OVERLOAD*pow(10.0, -(double)level/10);
+  targetGain = sqrt(meanSquare*prediction*3);
+
+  if (!started) {
+    gain = targetGain;
+    for (PINDEX i = 0; i <= H323_COMFORTNOISE_ORDER; i++)
+      state[i] = 0;
+    started = TRUE;
+  }
+
+  active = TRUE;
+  descriptorCount++;
+  PTRACE(5, "CN\tReceived silence descriptor level -" << level << "dBov, order " << order);
+  return TRUE;
+}
+
+
+void H323ComfortNoiseGenerator::Generate(short * pcm, PINDEX samples)
+{
+  if (samples <= 0)
+    return;
+
+  double step = (targetGain - gain)/samples;
+  for (PINDEX n = 0; n < samples; n++) {
+    gain += step;
+
+    seed = seed*1664525 + 1013904223;
+    double f = gain*((double)(seed >> 16)/32768.0 - 1.0);
+
+    // All pole lattice, state[i] holding the backward error of stage i
+    for (unsigned i = order; i > 0; i--) {
+      f -= reflection[i-1]*state[i-1];
+      state[i] = state[i-1] + reflection[i-1]*f;
+    }
+    state[0] = f;
+
+    pcm[n] = (short)(f > 32767 ? 32767 : f < -32768 ? -32768 : f);
+  }
+  gain = targetGain;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,272 @@
+/*
+ * h323encodeload.cxx
+ *
+ * Encoder complexity governed by a processor budget
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "h323encodeload.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#include "h323encodeload.h"
+#include "h323mediaclock.h"
+
+#define new PNEW
+
+
+static const PInt64   EvaluatePeriod = 1000000;  // Microseconds
+static const PInt64   StepInterval   = 1000;     // Milliseconds between steps of any encoder
+static const PInt64   CalmTime       = 3000;     // Milliseconds under CalmPercent before stepping up
+static const unsigned CalmPercent    = 80;
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323EncodeBudget::H323EncodeBudget()
+  : budget(0),
+    lastChange(0),
+    calmSince(0)
+{
+}
+
+
+void H323EncodeBudget::SetBudget(unsigned percent)
+{
+  PWaitAndSignal m(mutex);
+  budget = percent;
+  PTRACE(3, "EncodeLoad\tEncode budget set to " << percent << '%');
+}
+
+
+unsigned H323EncodeBudget::GetBudget() const
+{
+  PWaitAndSignal m(mutex);
+  return budget;
+}
+
+
+void H323EncodeBudget::SetComplexityRange(const PString & format, unsigned floor, unsigned ceiling)
+{
+  PWaitAndSignal m(mutex);
+
+  Range & range = ranges[format];
+  range.ceiling = PMIN(ceiling, (unsigned)MaxComplexity);
+  range.floor = PMIN(floor, range.ceiling);
+}
+
+
+void H323EncodeBudget::GetComplexityRange(const PString & format, unsigned & floor, unsigned & ceiling) const
+{
+  PWaitAndSignal m(mutex);
+
+  std::map<PString, Range>::const_iterator it = ranges.find(format);
+  if (it != ranges.end()) {
+    floor = it->second.floor;
+    ceiling = it->second.ceiling;
+  }
+  else {
+    floor = MinComplexity;
+    ceiling = MaxComplexity;
+  }
+}
+
+
+unsigned H323EncodeBudget::Report(const H323EncodeLoad * encoder,
+                                  unsigned load,
+                                  unsigned complexity,
+                                  unsigned floor,
+                                  unsigned ceiling)
+{
+  PWaitAndSignal m(mutex);
+
+  Entry & entry = encoders[encoder];
+  entry.load = load;
+  entry.complexity = complexity;
+  entry.floor = floor;
+  entry.ceiling = ceiling;
+
+  if (budget == 0)
+    return complexity;
+
+  unsigned total = 0;
+  for (EntryMap::const_iterator it = encoders.begin(); it != encoders.end(); ++it)
+    total += it->second.load;
+
+  // One step at a time for all encoders, so the next is judged on its effect
+  PInt64 now = H323MediaClock::GetMilliseconds();
+  PBoolean stepped = now - lastChange < StepInterval;
+
+  if (total > budget) {
+    calmSince = 0;
+    if (stepped)
+      return complexity;
+
+    // The most costly that can still give way
+    EntryMap::const_iterator costliest = encoders.end();
+    for (EntryMap::const_iterator it = encoders.begin(); it != encoders.end(); ++it) {
+      if (it->second.complexity > it->second.floor &&
+          (costliest == encoders.end() || it->second.load > costliest->second.load))
+        costliest = it;
+    }
+
+    if (costliest == encoders.end() || costliest->first != encoder)
+      return complexity;
+
+    lastChange = now;
+    PTRACE(3, "EncodeLoad\tTotal " << total << "% over budget of " << budget
+           << "%, encoder at " << load << "% down to complexity " << complexity-1);
+    return entry.complexity = complexity-1;
+  }
+
+  if (total*100 >= budget*CalmPercent) {
+    calmSince = 0;
+    return complexity;
+  }
+
+  if (calmSince == 0)
+    calmSince = now;
+  if (stepped || now - calmSince < CalmTime)
+    return complexity;
+
+  // The cheapest that gave way, if it fits at the next step
+  EntryMap::const_iterator cheapest = encoders.end();
+  for (EntryMap::const_iterator it = encoders.begin(); it != encoders.end(); ++it) {
+    if (it->second.complexity < it->second.ceiling &&
+        (cheapest == encoders.end() || it->second.load < cheapest->second.load))
+      cheapest = it;
+  }
+
+  if (cheapest == encoders.end() || cheapest->first != encoder)
+    return complexity;
+
+  // Taking the cost as growing with the complexity from one step above zero
+  unsigned next = load*(complexity+2)/(complexity+1);
+  if ((total - load + next)*100 >= budget*CalmPercent)
+    return complexity;
+
+  lastChange = now;
+  calmSince = now;
+  PTRACE(3, "EncodeLoad\tTotal " << total << "% under budget of " << budget
+         << "%, encoder at " << load << "% up to complexity " << complexity+1);
+  return entry.complexity = complexity+1;
+}
+
+
+void H323EncodeBudget::Remove(const H323EncodeLoad * encoder)
+{
+  PWaitAndSignal m(mutex);
+  encoders.erase(encoder);
+}
+
+
+unsigned H323EncodeBudget::GetTotalLoad() const
+{
+  PWaitAndSignal m(mutex);
+
+  unsigned total = 0;
+  for (EntryMap::const_iterator it = encoders.begin(); it != encoders.end(); ++it)
+    total += it->second.load;
+  return total;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323EncodeLoad::H323EncodeLoad()
+  : budget(NULL),
+    floor(H323EncodeBudget::MinComplexity),
+    ceiling(H323EncodeBudget::MaxComplexity),
+    complexity(H323EncodeBudget::MaxComplexity),
+    periodStart(0),
+    encodeTime(0),
+    load(0)
+{
+}
+
+
+H323EncodeLoad::~H323EncodeLoad()
+{
+  Close();
+}
+
+
+void H323EncodeLoad::Open(const PString & formatName, H323EncodeBudget & encodeBudget)
+{
+  Close();
+
+  format = formatName;
+  budget = &encodeBudget;
+  budget->GetComplexityRange(format, floor, ceiling);
+  complexity = ceiling;
+  periodStart = 0;
+  encodeTime = 0;
+  load = 0;
+
+  PTRACE(4, "EncodeLoad\t" << format << " encoder governed, complexity "
+         << floor << " to " << ceiling);
+}
+
+
+void H323EncodeLoad::Close()
+{
+  if (budget == NULL)
+    return;
+
+  budget->Remove(this);
+  budget = NULL;
+}
+
+
+PBoolean H323EncodeLoad::AddEncodeTime(PInt64 start, PInt64 end)
+{
+  if (budget == NULL)
+    return FALSE;
+
+  if (periodStart == 0)
+    periodStart = start;
+
+  encodeTime += end - start;
+
+  PInt64 elapsed = end - periodStart;
+  if (elapsed < EvaluatePeriod)
+    return FALSE;
+
+  load = (unsigned)(encodeTime*100/elapsed);
+  periodStart = end;
+  encodeTime = 0;
+
+  unsigned previous = complexity;
+  complexity = budget->Report(this, load, complexity, floor, ceiling);
+  return complexity != previous;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
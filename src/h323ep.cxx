@@ -142,8 +142,24 @@
 #define IPTOS_LOWDELAY 0x10
 #endif
 
+#include "rtpreactor.h"
+#include "rtpsched.h"
+#include "h323timer.h"
+#include "rtpreport.h"
+#include "rfc2833.h"
+#include "rtpportpool.h"
+#include "h323mediawatch.h"
+#include "h323liveness.h"
+#include "sigreactor.h"
+#include "h323natcache.h"
+#include "h323resolver.h"
+#include "h323sigpool.h"
+#include "h323tlscache.h"
+#include "h323procgroup.h"
+
 #include "opalglobalstatics.cxx"
 #include <algorithm>
+#include <vector>
 
 //////////////////////////////////////////////////////////////////////////////////////
 
@@ -282,6 +298,9 @@ H323_TLSContext::H323_TLSContext()
     PString cipherList = "ALL:!ADH:!LOW:!EXP:!MD5:!RC4:!ECDH:!ECDSA:@STRENGTH";
     SetCipherList(cipherList);
     SSL_CTX_set_info_callback(m_context, tls_info_cb);
+
+    // Resume sessions with peers for an hour, by session ID or ticket
+    H323TLSSessionCache::ConfigureContext(m_context, PTimeInterval(0, 0, 60));
 }
 
 PBoolean H323_TLSContext::UseCAFile(const PFilePath & caFile)
@@ -524,6 +543,23 @@ class H225CallThread : public PThread
 };
 
 
+// Thread of a H225CallThreadPool, sending the SETUP of queued calls
+class H225CallWorker : public PThread
+{
+  PCLASSINFO(H225CallWorker, PThread)
+
+  public:
+    H225CallWorker(H323EndPoint & endpoint, H225CallThreadPool & pool);
+
+  protected:
+    void Main();
+    PBoolean MakeCall(const H225CallThreadPool::Call & call);
+
+    H323EndPoint       & endpoint;
+    H225CallThreadPool & pool;
+};
+
+
 class H323ConnectionsCleaner : public PThread
 {
   PCLASSINFO(H323ConnectionsCleaner, PThread)
@@ -532,7 +568,9 @@ class H323ConnectionsCleaner : public PThread
     H323ConnectionsCleaner(H323EndPoint & endpoint);
     ~H323ConnectionsCleaner();
 
-    void Signal() { wakeupFlag.Signal(); }
+    void Signal();
+    void SetSize(PINDEX count);
+    PBoolean IsCleanerThread(PThread * thread);
 
   protected:
     void Main();
@@ -540,6 +578,10 @@ class H323ConnectionsCleaner : public PThread
     H323EndPoint & endpoint;
     PBoolean           stopFlag;
     PSyncPoint     wakeupFlag;
+
+    // Further threads cleaning up connections at the same time as this one
+    std::vector<H323ConnectionsCleaner *> helpers;
+    PMutex         helpersMutex;
 };
 
 
@@ -607,6 +649,8 @@ void H225CallThread::Main()
 {
   PTRACE(3, "H225\tStarted call thread");
 
+  connection.GetEndPoint().GetThreadAffinity(H323EndPoint::SignallingThreads).ApplyToCurrentThread();
+
   if (connection.Lock()) {
     H323Connection::CallEndReason reason = connection.SendSignalSetup(alias, address);
 
@@ -625,12 +669,207 @@ void H225CallThread::Main()
         return;
       }
 #endif
-      connection.HandleSignallingChannel();
+      if (!connection.ReactorSignalChannel(&transport))
+        connection.HandleSignallingChannel();
     }
   }
 }
 
 
+/////////////////////////////////////////////////////////////////////////////
+
+H225CallWorker::H225CallWorker(H323EndPoint & ep, H225CallThreadPool & p)
+  : PThread(ep.GetSignallingThreadStackSize(),
+            AutoDeleteThread,
+            NormalPriority,
+            "H225 Caller:%0x"),
+    endpoint(ep),
+    pool(p)
+{
+  Resume();
+}
+
+
+void H225CallWorker::Main()
+{
+  endpoint.GetThreadAffinity(H323EndPoint::SignallingThreads).ApplyToCurrentThread();
+
+  H225CallThreadPool::Call call;
+  while (pool.WaitForCall(call)) {
+    if (!MakeCall(call))
+      return;
+  }
+}
+
+
+PBoolean H225CallWorker::MakeCall(const H225CallThreadPool::Call & call)
+{
+  // The call may have been cleared while it was queued
+  H323Connection * connection = endpoint.FindConnectionWithLock(call.token);
+  if (connection == NULL) {
+    PTRACE(3, "H225\tCall " << call.token << " cleared before it was made");
+    return TRUE;
+  }
+
+  PTRACE(3, "H225\tMaking queued call " << call.token);
+
+  H323Transport * transport = connection->GetSignallingChannel();
+  H323Connection::CallEndReason reason = connection->SendSignalSetup(call.alias, call.address);
+
+  // Aborted calls are unlocked already, and being cleared
+  if (reason == H323Connection::EndedByCallerAbort)
+    return TRUE;
+
+  // Everything is done with the connection locked, as it is not kept from
+  // being deleted by this thread being attached to its transport
+  if (reason != H323Connection::NumCallEndReasons || transport == NULL) {
+    connection->ClearCall(reason != H323Connection::NumCallEndReasons ? reason : H323Connection::EndedByTransportFail);
+    connection->Unlock();
+    return TRUE;
+  }
+
+#ifdef H323_SIGNAL_AGGREGATE
+  if (endpoint.GetSignallingAggregator() != NULL) {
+    connection->AggregateSignalChannel(transport);
+    connection->Unlock();
+    return TRUE;
+  }
+#endif
+
+  if (connection->ReactorSignalChannel(transport)) {
+    connection->Unlock();
+    return TRUE;
+  }
+
+  // Stay with the call to read its signalling, cleaned up with the transport
+  transport->AttachThread(this);
+  SetNoAutoDelete();
+  pool.Detach();
+  connection->Unlock();
+
+  connection->HandleSignallingChannel();
+  return FALSE;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H225CallThreadPool::H225CallThreadPool(H323EndPoint & ep, PINDEX sz, PINDEX limit)
+  : endpoint(ep),
+    size(sz),
+    queueLimit(limit),
+    available(0, P_MAX_INDEX),
+    workers(0),
+    closing(FALSE)
+{
+  PWaitAndSignal m(mutex);
+  for (PINDEX i = 0; i < size; i++)
+    Spawn();
+
+  PTRACE(3, "H225\tStarted pool of " << size << " outgoing call threads");
+}
+
+
+H225CallThreadPool::~H225CallThreadPool()
+{
+  mutex.Wait();
+  closing = TRUE;
+  endpoint.GetMetrics().outgoingCallsQueued.Add(-(PInt64)queue.size());
+  queue.clear();
+  PINDEX wake = workers;
+  PBoolean wait = workers > 0;
+  mutex.Signal();
+
+  while (wake-- > 0)
+    available.Signal();
+
+  // Threads making a call finish it first, they all reference the pool
+  if (wait)
+    stopped.Wait();
+}
+
+
+PBoolean H225CallThreadPool::Dispatch(const PString & token,
+                                      const PString & alias,
+                                      const H323TransportAddress & address)
+{
+  {
+    PWaitAndSignal m(mutex);
+    if (closing)
+      return FALSE;
+
+    if (queueLimit > 0 && (PINDEX)queue.size() >= queueLimit) {
+      PTRACE(2, "H225\tOutgoing call queue full, refusing " << token);
+      endpoint.GetMetrics().outgoingCallsRejected.Add();
+      return FALSE;
+    }
+
+    Call call;
+    call.token = token;
+    call.alias = alias;
+    call.address = address;
+    call.queued = PTimer::Tick();
+    queue.push_back(call);
+  }
+
+  endpoint.GetMetrics().outgoingCallsQueued.Add(1);
+  available.Signal();
+  return TRUE;
+}
+
+
+PINDEX H225CallThreadPool::GetQueued() const
+{
+  PWaitAndSignal m(mutex);
+  return queue.size();
+}
+
+
+void H225CallThreadPool::Spawn()
+{
+  // Must be called with the mutex held
+  workers++;
+  new H225CallWorker(endpoint, *this);
+}
+
+
+PBoolean H225CallThreadPool::WaitForCall(Call & call)
+{
+  available.Wait();
+
+  mutex.Wait();
+  if (closing) {
+    PBoolean last = --workers == 0;
+    mutex.Signal();
+    if (last)
+      stopped.Signal();
+    return FALSE;
+  }
+
+  call = queue.front();
+  queue.pop_front();
+  mutex.Signal();
+
+  endpoint.GetMetrics().outgoingCallsQueued.Add(-1);
+  endpoint.GetMetrics().outgoingCallQueueTime.Add((PTimer::Tick() - call.queued).GetMilliSeconds());
+  return TRUE;
+}
+
+
+void H225CallThreadPool::Detach()
+{
+  // The worker now belongs to its call, replace it
+  mutex.Wait();
+  PBoolean last = --workers == 0 && closing;
+  if (!closing)
+    Spawn();
+  mutex.Signal();
+
+  if (last)
+    stopped.Signal();
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
 
 H323ConnectionsCleaner::H323ConnectionsCleaner(H323EndPoint & ep)
@@ -647,12 +886,55 @@ H323ConnectionsCleaner::H323ConnectionsCleaner(H323EndPoint & ep)
 
 H323ConnectionsCleaner::~H323ConnectionsCleaner()
 {
+  SetSize(1);
+
   stopFlag = TRUE;
   wakeupFlag.Signal();
   PAssert(WaitForTermination(10000), "Cleaner thread did not terminate");
 }
 
 
+void H323ConnectionsCleaner::Signal()
+{
+  PWaitAndSignal mutex(helpersMutex);
+
+  wakeupFlag.Signal();
+  for (size_t i = 0; i < helpers.size(); i++)
+    helpers[i]->wakeupFlag.Signal();
+}
+
+
+void H323ConnectionsCleaner::SetSize(PINDEX count)
+{
+  PWaitAndSignal mutex(helpersMutex);
+
+  while ((PINDEX)helpers.size()+1 < count)
+    helpers.push_back(new H323ConnectionsCleaner(endpoint));
+
+  while (!helpers.empty() && (PINDEX)helpers.size()+1 > count) {
+    delete helpers.back();
+    helpers.pop_back();
+  }
+
+  PTRACE(4, "H323\tCleaning up connections on " << helpers.size()+1 << " threads");
+}
+
+
+PBoolean H323ConnectionsCleaner::IsCleanerThread(PThread * thread)
+{
+  if (thread == this)
+    return TRUE;
+
+  PWaitAndSignal mutex(helpersMutex);
+  for (size_t i = 0; i < helpers.size(); i++) {
+    if (thread == helpers[i])
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+
 void H323ConnectionsCleaner::Main()
 {
   PTRACE(3, "H323\tStarted cleaner thread");
@@ -680,6 +962,8 @@ H323EndPoint::H323EndPoint()
 #endif
 #endif
     signallingChannelConnectTimeout(0, 10, 0), // seconds
+    signallingConnectStagger(250),          // Milliseconds
+    signallingPool(NULL),
     signallingChannelCallTimeout(0, 0, 1),  // Minutes
     controlChannelStartTimeout(0, 0, 2),    // Minutes
     endSessionTimeout(0, 3),                // Seconds
@@ -708,7 +992,7 @@ H323EndPoint::H323EndPoint()
     callIntrusionT6(0,10),                   // Seconds
     nextH450CallIdentity(0)
 #endif
-
+    ,connectionsMutex("H323EndPoint::connectionsMutex")
 {
   PString username = PProcess::Current().GetUserName();
   if (username.IsEmpty())
@@ -727,9 +1011,14 @@ H323EndPoint::H323EndPoint()
 
 #ifdef H323_VIDEO
   autoStartReceiveVideo = autoStartTransmitVideo = TRUE;
+  videoRateControl = TRUE;
+  videoReassemblyWindow = 32;
+  videoLoadShedding = TRUE;
 
 #ifdef H323_H239
   autoStartReceiveExtVideo = autoStartTransmitExtVideo = FALSE;
+  extVideoFrameRate = 5;
+  extVideoSkipUnchanged = TRUE;
 #endif
 #endif
 
@@ -746,6 +1035,7 @@ H323EndPoint::H323EndPoint()
   disableFastStart = true;
   disableH245Tunneling = false;
   disableH245inSetup = true;
+  enableH245BurstOpen = false;
   disableH245QoS = true;
   disableDetectInBandDTMF = false;
   disableRFC2833InBandDTMF = false;
@@ -770,6 +1060,9 @@ H323EndPoint::H323EndPoint()
   rewriteParsePartyName = true;
   initialBandwidth = 100000; // Standard 10base LAN in 100's of bits/sec
   clearCallOnRoundTripFail = FALSE;
+  roundTripDelayPerPeer = TRUE;
+  peerLiveness = NULL;
+  lockProfiling = FALSE;
 
   t35CountryCode   = defaultT35CountryCode;   // Country code for Australia
   t35Extension     = defaultT35Extension;
@@ -784,6 +1077,14 @@ H323EndPoint::H323EndPoint()
 
 #ifdef P_STUN
   natMethods = new H323NatStrategy();
+  natDiscoveryCacheTime = PTimeInterval(0, 60);
+  natDiscoveryCache = NULL;
+#endif
+
+#if P_DNS
+  dnsCacheTime = PTimeInterval(0, 300);
+  dnsNegativeCacheTime = PTimeInterval(0, 30);
+  dnsResolver = NULL;
 #endif
 
 #ifdef H323_H46019M
@@ -842,7 +1143,52 @@ H323EndPoint::H323EndPoint()
   rtpAggregator = NULL;
 #endif
 
+  mediaReactorThreads = 0;
+  mediaReactor = NULL;
+  useTransmitPacing = FALSE;
+  transmitScheduler = NULL;
+  useReportScheduling = FALSE;
+  reportScheduler = NULL;
+  rfc2833Scheduler = NULL;
+  rtpBatchSize = 0;
+  multicastReceive = FALSE;
+  audioRedundancy = 0;
+  redundancyPayloadType = (RTP_DataFrame::PayloadTypes)121;
+  videoRetransmission = FALSE;
+  retransmissionPayloadType = (RTP_DataFrame::PayloadTypes)122;
+  rtpPortPoolSize = 0;
+  rtpPortQuarantine = PTimeInterval(0, 5);
+  rtpPortPool = NULL;
+  mediaWatchdog = NULL;
+  jitterBufferEngine = RTP_Session::e_ListJitterBuffer;
+  capabilitySharing = FALSE;
+  capabilityCostModel = NULL;
+  capabilitySnapshot = NULL;
+  capabilityMemoSize = 0;
+  fastStartMemoSize = 0;
+  capabilitySetMemoSize = 0;
+  audioConcealment = FALSE;
+  lipSync = FALSE;
+  comfortNoise = FALSE;
+  audioLevelExtension = 0;
+  jitterBufferPullMode = FALSE;
+  signallingAcceptors = 1;
+  sharedListeners = FALSE;
+  processRelay = NULL;
+  signallingThreadPoolSize = 0;
+  signallingThreadPool = NULL;
+  outgoingCallPoolSize = 0;
+  outgoingCallQueueLimit = 0;
+  outgoingCallPool = NULL;
+  signallingReactorThreads = 0;
+  signallingReactor = NULL;
+  callJournal = NULL;
+
   channelThreadPriority     = PThread::HighestPriority;
+  for (PINDEX i = 0; i < NumChannelThreadClasses; i++)
+    channelClassPriority[i] = channelThreadPriority;
+  channelClassPriority[ExtendedVideoChannelThreads] = PThread::NormalPriority;
+  mediaSocketSteering       = FALSE;
 
   gatekeeper = NULL;
   RegThread = NULL;
@@ -854,6 +1200,10 @@ H323EndPoint::H323EndPoint()
 #endif
 
   connectionsCleaner = new H323ConnectionsCleaner(*this);
+  cleanerThreads = 1;
+  bulkClearing = FALSE;
+  bulkSkipDisengage = FALSE;
+  bulkClearReason = H323Connection::EndedByLocalUser;
 
   srand((unsigned)time(NULL)+clock());
 
@@ -869,10 +1219,12 @@ H323EndPoint::H323EndPoint()
   m_tryingH46017 = false;           // set to true when attempting H.460.17
   m_registeredWithH46017 = false;   // set to true when gatekeeper accepts it
   m_h46017Transport = NULL;
+  m_h46017SignalThreads = 4;        // workers for the tunnelled call signalling
 #endif
 
 #ifdef H323_H46018
   m_h46018enabled = true;
+  m_h46018PreOpen = false;
 #endif
 
 #ifdef H323_H46019M
@@ -932,6 +1284,9 @@ H323EndPoint::H323EndPoint()
 
 #ifdef H323_TLS
   m_transportContext = NULL;
+  m_tlsSessionCache = NULL;
+  tlsHandshakeWorkers = 8;
+  tlsHandshakePool = NULL;
 #endif
 
 #ifdef H323_FRAMEBUFFER
@@ -970,6 +1325,10 @@ H323EndPoint::~H323EndPoint()
   // And shut down the gatekeeper (if there was one)
   RemoveGatekeeper();
 
+  // The workers lose theirs with it
+  delete processRelay;
+  processRelay = NULL;
+
 #ifdef H323_GNUGK
   delete gnugk;
 #endif
@@ -977,19 +1336,52 @@ H323EndPoint::~H323EndPoint()
   // Shut down the listeners as soon as possible to avoid race conditions
   listeners.RemoveAll();
 
+#ifdef H323_TLS
+  // Handshakes still running hand their transports to the signalling threads
+  connectionsMutex.Wait();
+  tlsHandshakeWorkers = 0;
+  connectionsMutex.Signal();
+  delete tlsHandshakePool;
+  tlsHandshakePool = NULL;
+#endif
+
+  // No more calls can be accepted, so release the waiting signalling threads
+  delete signallingThreadPool;
+
   // Clear any pending calls on this endpoint
   ClearAllCalls();
 
+  // Queued calls were cleared, the callers finish what they are making
+  delete outgoingCallPool;
+  outgoingCallPool = NULL;
+
   // Shut down the cleaner thread
   delete connectionsCleaner;
+  connectionsCleaner = NULL;
 
   // Clean up any connections that the cleaner thread missed
   CleanUpConnections();
 
+  // Writes the records of those connections before it goes
+  delete callJournal;
+
+  // All RTP sessions and channels are gone, so the media threads can be stopped
+  delete mediaReactor;
+  delete transmitScheduler;
+  delete reportScheduler;
+  delete rfc2833Scheduler;
+  delete rtpPortPool;
+  delete mediaWatchdog;
+  delete peerLiveness;
+  SetLockProfiling(FALSE);
+  delete signallingReactor;
+  InvalidateCapabilitySnapshot();
+
 #ifdef H323_TLS
   if (m_transportContext) {
     delete m_transportContext;
   }
+  delete m_tlsSessionCache;
   // OpenSSL Cleanup
   EVP_cleanup();
   CRYPTO_cleanup_all_ex_data();
@@ -1000,9 +1392,17 @@ H323EndPoint::~H323EndPoint()
 #endif
 
 #ifdef P_STUN
+  // Refreshes through the NAT methods, so goes first
+  delete natDiscoveryCache;
   delete natMethods;
 #endif
 
+#if P_DNS
+  delete dnsResolver;
+#endif
+
+  delete signallingPool;
+
 #ifdef H323_H460P
   delete presenceHandler;
 #endif
@@ -1117,14 +1517,438 @@ void H323EndPoint::SetH221NonStandardInfo(H225_H221NonStandard & info) const
 }
 
 
+void H323EndPoint::ShareCapabilities(H323Capabilities & table) const
+{
+  PWaitAndSignal mutex(capabilitySnapshotMutex);
+
+  if (capabilitySnapshot == NULL) {
+    capabilitySnapshot = H323Capabilities::CreateSnapshot(capabilities);
+    PTRACE(4, "H323\tCreated shared snapshot of " << capabilities.GetSize() << " capabilities");
+  }
+
+  table.Share(*capabilitySnapshot);
+}
+
+
+void H323EndPoint::InvalidateCapabilitySnapshot() const
+{
+  PWaitAndSignal mutex(capabilitySnapshotMutex);
+
+  // Connections keep the old snapshot, new ones get the changed capabilities
+  H323Capabilities::ReleaseSnapshot(capabilitySnapshot);
+  capabilitySnapshot = NULL;
+
+  // The remembered sets were decoded against the old capabilities
+  for (CapabilityMemoMap::iterator it = capabilityMemos.begin(); it != capabilityMemos.end(); ++it)
+    H323Capabilities::ReleaseSnapshot(it->second);
+  capabilityMemos.clear();
+
+  // As were the fast start proposals and capability sets
+  fastStartMemos.clear();
+  capabilitySetMemos.clear();
+}
+
+
+H323CapabilityMemo * H323EndPoint::GetCapabilityMemo(const H323Connection & connection,
+                                                     const H245_TerminalCapabilitySet & pdu) const
+{
+  if (capabilityMemoSize == 0)
+    return NULL;
+
+  const H323Capabilities * snapshot = connection.GetLocalCapabilities().GetSnapshot();
+  if (snapshot == NULL)
+    return NULL;
+
+  // The same device sends the same set on every call, bar the sequence number
+  H245_TerminalCapabilitySet tcs = pdu;
+  tcs.m_sequenceNumber = 0;
+  PPER_Stream strm;
+  tcs.Encode(strm);
+  strm.CompleteEncoding();
+  PBYTEArray encoding = strm;
+
+  // FNV-1a, sets with the same hash are told apart by their encoding
+  unsigned hash = 2166136261U;
+  for (PINDEX i = 0; i < encoding.GetSize(); i++)
+    hash = (hash ^ encoding[i]) * 16777619U;
+
+  {
+    PWaitAndSignal mutex(capabilitySnapshotMutex);
+    if (snapshot != capabilitySnapshot)
+      return NULL;
+
+    CapabilityMemoMap::iterator it = capabilityMemos.lower_bound(hash);
+    for (; it != capabilityMemos.end() && it->first == hash; ++it) {
+      if (it->second->GetEncoding() == encoding) {
+        it->second->AddReference();
+        PTRACE(4, "H323\tUsing remembered capability set " << std::hex << hash << std::dec);
+        return it->second;
+      }
+    }
+  }
+
+  // Decode without the lock, another connection may be doing the same
+  H323CapabilityMemo * memo = new H323CapabilityMemo(connection, pdu, encoding);
+
+  PWaitAndSignal mutex(capabilitySnapshotMutex);
+  if (snapshot != capabilitySnapshot) {
+    // Still usable by this connection, but not kept
+    return memo;
+  }
+
+  if ((PINDEX)capabilityMemos.size() >= capabilityMemoSize) {
+    PTRACE(3, "H323\tForgetting " << capabilityMemos.size() << " remembered capability sets");
+    for (CapabilityMemoMap::iterator it = capabilityMemos.begin(); it != capabilityMemos.end(); ++it)
+      H323Capabilities::ReleaseSnapshot(it->second);
+    capabilityMemos.clear();
+  }
+
+  memo->AddReference();
+  capabilityMemos.insert(CapabilityMemoMap::value_type(hash, memo));
+  PTRACE(4, "H323\tRemembering capability set " << std::hex << hash << std::dec << ", " << memo->GetSize() << " capabilities");
+  return memo;
+}
+
+
+static PString FastStartMemoKey(const H323Connection & connection, const H323Channel & channel, PBoolean reverse)
+{
+  PStringStream key;
+  key << channel.GetCapability().GetFormatName() << ':'
+      << channel.GetNumber() << ':'
+      << channel.GetSessionID() << ':'
+      << (int)channel.GetDirection() << ':'
+      << reverse << ':'
+      << (int)channel.GetRTPPayloadType() << ':'
+      << connection.H245QoSEnabled();
+
+#ifdef H323_AUDIO_CODECS
+  H323Codec * codec = channel.GetCodec();
+  if (codec != NULL && PIsDescendant(codec, H323AudioCodec))
+    key << ':' << (int)((H323AudioCodec *)codec)->GetSilenceDetectionMode();
+#endif
+
+  return key;
+}
+
+
+static PBoolean GetFastStartAddress(const H323Connection & connection, const H323Channel & channel,
+                                    PIPSocket::Address & address, WORD & dataPort, WORD & controlPort)
+{
+  if (!PIsDescendant(&channel, H323_RTPChannel))
+    return FALSE;
+
+  RTP_Session * session = connection.GetSession(channel.GetSessionID());
+  if (session == NULL || !PIsDescendant(session, RTP_UDP))
+    return FALSE;
+
+  RTP_UDP & rtp = *(RTP_UDP *)session;
+  address = rtp.GetLocalAddress();
+  dataPort = rtp.GetLocalDataPort();
+  controlPort = rtp.GetLocalControlPort();
+  return address.GetVersion() == 4 && dataPort > 0;
+}
+
+
+static void PutFastStartAddress(BYTE * ptr, const PIPSocket::Address & address, WORD port)
+{
+  for (PINDEX i = 0; i < 4; i++)
+    ptr[i] = address[i];
+  ptr[4] = (BYTE)(port >> 8);
+  ptr[5] = (BYTE)port;
+}
+
+
+static PBoolean IsFastStartAddress(const H245_TransportAddress & pdu, const PIPSocket::Address & address, WORD port)
+{
+  if (pdu.GetTag() != H245_TransportAddress::e_unicastAddress)
+    return FALSE;
+  const H245_UnicastAddress & unicast = pdu;
+  if (unicast.GetTag() != H245_UnicastAddress::e_iPAddress)
+    return FALSE;
+  const H245_UnicastAddress_iPAddress & ip = unicast;
+  return ip.m_network.GetSize() == 4 &&
+         PIPSocket::Address(4, ip.m_network.GetValue()) == address &&
+         (WORD)ip.m_tsapIdentifier == port;
+}
+
+
+static void FlipFastStartAddress(H245_TransportAddress & pdu)
+{
+  H245_UnicastAddress_iPAddress & ip = (H245_UnicastAddress &)pdu;
+  PBYTEArray network = ip.m_network.GetValue();
+  for (PINDEX i = 0; i < network.GetSize(); i++)
+    network[i] ^= 0xff;
+  ip.m_network.SetValue(network);
+  ip.m_tsapIdentifier = (WORD)ip.m_tsapIdentifier ^ 0xffff;
+}
+
+
+PBoolean H323EndPoint::GetFastStartMemo(const H323Connection & connection,
+                                        const H323Channel & channel,
+                                        PBoolean reverse,
+                                        PASN_OctetString & encoded) const
+{
+  if (fastStartMemoSize == 0)
+    return FALSE;
+
+  const H323Capabilities * snapshot = connection.GetLocalCapabilities().GetSnapshot();
+  if (snapshot == NULL)
+    return FALSE;
+
+  PIPSocket::Address address;
+  WORD dataPort, controlPort;
+  if (!GetFastStartAddress(connection, channel, address, dataPort, controlPort))
+    return FALSE;
+
+  PString key = FastStartMemoKey(connection, channel, reverse);
+
+  PBYTEArray encoding;
+  {
+    PWaitAndSignal mutex(capabilitySnapshotMutex);
+    if (snapshot != capabilitySnapshot)
+      return FALSE;
+
+    FastStartMemoMap::const_iterator it = fastStartMemos.find(key);
+    if (it == fastStartMemos.end() || it->second.encoding.IsEmpty())
+      return FALSE;
+
+    encoding = it->second.encoding;
+    encoding.MakeUnique();
+    if (it->second.mediaOffset != P_MAX_INDEX)
+      PutFastStartAddress(encoding.GetPointer()+it->second.mediaOffset, address, dataPort);
+    PutFastStartAddress(encoding.GetPointer()+it->second.controlOffset, address, controlPort);
+  }
+
+  encoded.SetValue(encoding);
+  PTRACE(4, "H225\tUsing remembered fastStart for " << channel.GetCapability());
+  return TRUE;
+}
+
+
+void H323EndPoint::SetFastStartMemo(const H323Connection & connection,
+                                    const H323Channel & channel,
+                                    PBoolean reverse,
+                                    const H245_OpenLogicalChannel & open,
+                                    const PASN_OctetString & encoded) const
+{
+  if (fastStartMemoSize == 0)
+    return;
+
+  const H323Capabilities * snapshot = connection.GetLocalCapabilities().GetSnapshot();
+  if (snapshot == NULL)
+    return;
+
+  PIPSocket::Address address;
+  WORD dataPort, controlPort;
+  if (!GetFastStartAddress(connection, channel, address, dataPort, controlPort))
+    return;
+
+  FastStartMemo memo;
+  memo.mediaOffset = P_MAX_INDEX;
+  memo.controlOffset = P_MAX_INDEX;
+
+  /* Only the addresses are written in for later calls, so anything else that
+     may differ from call to call stops the channel being remembered, as does
+     an encoding in which the addresses cannot be found where expected. */
+  const H245_OpenLogicalChannel_forwardLogicalChannelParameters_multiplexParameters & forwardMux =
+                open.m_forwardLogicalChannelParameters.m_multiplexParameters;
+  const H245_OpenLogicalChannel_reverseLogicalChannelParameters_multiplexParameters & reverseMux =
+                open.m_reverseLogicalChannelParameters.m_multiplexParameters;
+  PBoolean inForward = forwardMux.GetTag() == H245_OpenLogicalChannel_forwardLogicalChannelParameters_multiplexParameters::e_h2250LogicalChannelParameters;
+  PBoolean inReverse = open.HasOptionalField(H245_OpenLogicalChannel::e_reverseLogicalChannelParameters) &&
+                       reverseMux.GetTag() == H245_OpenLogicalChannel_reverseLogicalChannelParameters_multiplexParameters::e_h2250LogicalChannelParameters;
+
+  if (!open.HasOptionalField(H245_OpenLogicalChannel::e_genericInformation) &&
+      !open.HasOptionalField(H245_OpenLogicalChannel::e_encryptionSync) &&
+      inForward != inReverse) {
+    const H245_H2250LogicalChannelParameters & param = inForward
+                ? (const H245_H2250LogicalChannelParameters &)forwardMux
+                : (const H245_H2250LogicalChannelParameters &)reverseMux;
+    PBoolean hasMedia = param.HasOptionalField(H245_H2250LogicalChannelParameters::e_mediaChannel);
+
+    if (param.HasOptionalField(H245_H2250LogicalChannelParameters::e_mediaControlChannel) &&
+        IsFastStartAddress(param.m_mediaControlChannel, address, controlPort) &&
+        (!hasMedia || IsFastStartAddress(param.m_mediaChannel, address, dataPort))) {
+      // Encode again with every address byte changed to find where they are
+      H245_OpenLogicalChannel flipped = open;
+      H245_H2250LogicalChannelParameters & flippedParam = inForward
+                ? (H245_H2250LogicalChannelParameters &)flipped.m_forwardLogicalChannelParameters.m_multiplexParameters
+                : (H245_H2250LogicalChannelParameters &)flipped.m_reverseLogicalChannelParameters.m_multiplexParameters;
+      if (hasMedia)
+        FlipFastStartAddress(flippedParam.m_mediaChannel);
+      FlipFastStartAddress(flippedParam.m_mediaControlChannel);
+
+      PASN_OctetString flippedEncoded;
+      flippedEncoded.EncodeSubType(flipped);
+
+      const PBYTEArray & original = encoded.GetValue();
+      const PBYTEArray & changed = flippedEncoded.GetValue();
+      std::vector<PINDEX> offsets;
+      if (original.GetSize() == changed.GetSize()) {
+        for (PINDEX i = 0; i < original.GetSize(); i++) {
+          if (original[i] != changed[i])
+            offsets.push_back(i);
+        }
+      }
+
+      // mediaChannel comes before mediaControlChannel, each as 4 address and 2 port bytes
+      PINDEX count = hasMedia ? 2 : 1;
+      PBoolean found = (PINDEX)offsets.size() == count*6;
+      for (PINDEX a = 0; found && a < count; a++) {
+        BYTE expected[6];
+        PutFastStartAddress(expected, address, hasMedia && a == 0 ? dataPort : controlPort);
+        for (PINDEX i = 0; found && i < 6; i++)
+          found = offsets[a*6+i] == offsets[a*6]+i && original[offsets[a*6+i]] == expected[i];
+      }
+
+      if (found) {
+        memo.encoding = original;
+        if (hasMedia)
+          memo.mediaOffset = offsets[0];
+        memo.controlOffset = offsets[(count-1)*6];
+      }
+    }
+  }
+
+  PString key = FastStartMemoKey(connection, channel, reverse);
+
+  PWaitAndSignal mutex(capabilitySnapshotMutex);
+  if (snapshot != capabilitySnapshot)
+    return;
+
+  if ((PINDEX)fastStartMemos.size() >= fastStartMemoSize) {
+    PTRACE(3, "H323\tForgetting " << fastStartMemos.size() << " remembered fastStart proposals");
+    fastStartMemos.clear();
+  }
+
+  fastStartMemos[key] = memo;
+  PTRACE(4, "H225\t" << (memo.encoding.IsEmpty() ? "Cannot remember" : "Remembering")
+         << " fastStart for " << channel.GetCapability());
+}
+
+
+static PString CapabilitySetMemoKey(const H323Connection & connection)
+{
+  // BuildTerminalCapabilitySet() takes these from the connection, the rest
+  // of the set is the shared endpoint capabilities
+  const H323Capabilities & caps = connection.GetLocalCapabilities();
+  PStringStream key;
+  key << connection.GetMaxAudioJitterDelay() << ':'
+      << (connection.GetEndPoint().IsMulticastReceiveEnabled() ? 'm' : 'u')
+      << (connection.GetEndPoint().GetAudioRedundancy() > 0 ? 'r' : 'n')
+      << (connection.GetEndPoint().IsVideoRetransmissionEnabled() ? 'v' : 'n') << ':';
+  for (PINDEX i = 0; i < caps.GetSize(); i++)
+    key << (caps[i].IsUsable(connection) ? '1' : '0');
+  return key;
+}
+
+
+PBoolean H323EndPoint::GetCapabilitySetMemo(const H323Connection & connection,
+                                            unsigned sequenceNumber,
+                                            PBYTEArray & encoded) const
+{
+  if (capabilitySetMemoSize == 0)
+    return FALSE;
+
+  const H323Capabilities * snapshot = connection.GetLocalCapabilities().GetSnapshot();
+  if (snapshot == NULL)
+    return FALSE;
+
+  PString key = CapabilitySetMemoKey(connection);
+
+  PWaitAndSignal mutex(capabilitySnapshotMutex);
+  if (snapshot != capabilitySnapshot)
+    return FALSE;
+
+  CapabilitySetMemoMap::const_iterator it = capabilitySetMemos.find(key);
+  if (it == capabilitySetMemos.end())
+    return FALSE;
+
+  encoded = it->second.encoding;
+  encoded.MakeUnique();
+  encoded[it->second.sequenceOffset] = (BYTE)sequenceNumber;
+  PTRACE(4, "H245\tUsing remembered TerminalCapabilitySet of " << encoded.GetSize() << " bytes");
+  return TRUE;
+}
+
+
+void H323EndPoint::SetCapabilitySetMemo(const H323Connection & connection,
+                                        const H323ControlPDU & pdu) const
+{
+  if (capabilitySetMemoSize == 0)
+    return;
+
+  const H323Capabilities * snapshot = connection.GetLocalCapabilities().GetSnapshot();
+  if (snapshot == NULL)
+    return;
+
+  {
+    PWaitAndSignal mutex(capabilitySnapshotMutex);
+    if (snapshot != capabilitySnapshot)
+      return;
+  }
+
+  PPER_Stream strm;
+  pdu.Encode(strm);
+  strm.CompleteEncoding();
+
+  // Encode again with the sequence number changed to find where it is
+  H323ControlPDU flipped = pdu;
+  H245_RequestMessage & request = flipped;
+  H245_TerminalCapabilitySet & tcs = request;
+  unsigned sequenceNumber = tcs.m_sequenceNumber;
+  tcs.m_sequenceNumber = sequenceNumber ^ 0xff;
+  PPER_Stream flippedStrm;
+  flipped.Encode(flippedStrm);
+  flippedStrm.CompleteEncoding();
+
+  PINDEX offset = P_MAX_INDEX;
+  if (strm.GetSize() == flippedStrm.GetSize()) {
+    for (PINDEX i = 0; i < strm.GetSize(); i++) {
+      if (strm[i] != flippedStrm[i]) {
+        if (offset != P_MAX_INDEX || strm[i] != (BYTE)sequenceNumber) {
+          offset = P_MAX_INDEX;
+          break;
+        }
+        offset = i;
+      }
+    }
+  }
+
+  if (offset == P_MAX_INDEX) {
+    PTRACE(3, "H245\tCannot remember TerminalCapabilitySet, sequence number not found");
+    return;
+  }
+
+  PString key = CapabilitySetMemoKey(connection);
+
+  PWaitAndSignal mutex(capabilitySnapshotMutex);
+  if (snapshot != capabilitySnapshot)
+    return;
+
+  if ((PINDEX)capabilitySetMemos.size() >= capabilitySetMemoSize) {
+    PTRACE(3, "H323\tForgetting " << capabilitySetMemos.size() << " remembered capability sets sent");
+    capabilitySetMemos.clear();
+  }
+
+  CapabilitySetMemo & memo = capabilitySetMemos[key];
+  memo.encoding = strm;
+  memo.sequenceOffset = offset;
+  PTRACE(4, "H245\tRemembering TerminalCapabilitySet of " << strm.GetSize() << " bytes");
+}
+
+
 H323Capability * H323EndPoint::FindCapability(const H245_Capability & cap) const
 {
+  // The caller may change the capability
+  InvalidateCapabilitySnapshot();
   return capabilities.FindCapability(cap);
 }
 
 
 H323Capability * H323EndPoint::FindCapability(const H245_DataType & dataType) const
 {
+  InvalidateCapabilitySnapshot();
   return capabilities.FindCapability(dataType);
 }
 
@@ -1132,12 +1956,14 @@ H323Capability * H323EndPoint::FindCapability(const H245_DataType & dataType) co
 H323Capability * H323EndPoint::FindCapability(H323Capability::MainTypes mainType,
                                               unsigned subType) const
 {
+  InvalidateCapabilitySnapshot();
   return capabilities.FindCapability(mainType, subType);
 }
 
 
 void H323EndPoint::AddCapability(H323Capability * capability)
 {
+  InvalidateCapabilitySnapshot();
   capabilities.Add(capability);
 }
 
@@ -1146,23 +1972,45 @@ PINDEX H323EndPoint::SetCapability(PINDEX descriptorNum,
                                    PINDEX simultaneousNum,
                                    H323Capability * capability)
 {
+  InvalidateCapabilitySnapshot();
   return capabilities.SetCapability(descriptorNum, simultaneousNum, capability);
 }
 
 PBoolean H323EndPoint::RemoveCapability(H323Capability::MainTypes capabilityType)
 {
+    InvalidateCapabilitySnapshot();
     return capabilities.RemoveCapability(capabilityType);
 }
 
+void H323EndPoint::SetComfortNoise(PBoolean enable)
+{
+  comfortNoise = enable;
+
+#ifdef H323_AUDIO_CODECS
+  H323_ComfortNoiseCapability capability;
+  PBoolean present = capabilities.FindCapability(capability.GetFormatName()) != NULL;
+  if (enable == present)
+    return;
+
+  InvalidateCapabilitySnapshot();
+  if (enable)
+    capabilities.SetCapability(0, P_MAX_INDEX, new H323_ComfortNoiseCapability);
+  else
+    capabilities.Remove(capability.GetFormatName());
+#endif
+}
+
 #ifdef H323_VIDEO
 PBoolean H323EndPoint::SetVideoEncoder(unsigned frameWidth, unsigned frameHeight, unsigned frameRate)
 {
+    InvalidateCapabilitySnapshot();
     return capabilities.SetVideoEncoder(frameWidth, frameHeight, frameRate);
 }
 
 PBoolean H323EndPoint::SetVideoFrameSize(H323Capability::CapabilityFrameSize frameSize,
                           int frameUnits)
 {
+    InvalidateCapabilitySnapshot();
     return capabilities.SetVideoFrameSize(frameSize,frameUnits);
 }
 #endif
@@ -1171,6 +2019,7 @@ PINDEX H323EndPoint::AddAllCapabilities(PINDEX descriptorNum,
                                         PINDEX simultaneous,
                                         const PString & name)
 {
+    InvalidateCapabilitySnapshot();
     PINDEX reply = capabilities.AddAllCapabilities(descriptorNum, simultaneous, name);
 #ifdef H323_VIDEO
 #ifdef H323_H239
@@ -1184,6 +2033,7 @@ PINDEX H323EndPoint::AddAllCapabilities(PINDEX descriptorNum,
 void H323EndPoint::AddAllUserInputCapabilities(PINDEX descriptorNum,
                                                PINDEX simultaneous)
 {
+  InvalidateCapabilitySnapshot();
   H323_UserInputCapability::AddAllCapabilities(capabilities, descriptorNum, simultaneous);
 }
 
@@ -1231,6 +2081,7 @@ PBoolean H323EndPoint::CloseExtendedVideoSession(
 void H323EndPoint::AddAllExtendedVideoCapabilities(PINDEX descriptorNum,
                                                    PINDEX simultaneous)
 {
+  InvalidateCapabilitySnapshot();
   H323ExtendedVideoCapability::AddAllCapabilities(capabilities, descriptorNum, simultaneous);
 }
 #endif  // H323_H239
@@ -1238,6 +2089,7 @@ void H323EndPoint::AddAllExtendedVideoCapabilities(PINDEX descriptorNum,
 
 void H323EndPoint::RemoveCapabilities(const PStringArray & codecNames)
 {
+  InvalidateCapabilitySnapshot();
 #if PTLIB_VER > 2130
   capabilities.Remove("dummy", codecNames);
 #else
@@ -1248,6 +2100,7 @@ void H323EndPoint::RemoveCapabilities(const PStringArray & codecNames)
 
 void H323EndPoint::ReorderCapabilities(const PStringArray & preferenceOrder)
 {
+  InvalidateCapabilitySnapshot();
   capabilities.Reorder(preferenceOrder);
 }
 
@@ -1363,10 +2216,20 @@ PBoolean H323EndPoint::InternalRegisterGatekeeper(H323Gatekeeper * gk, PBoolean
 
 H323Gatekeeper * H323EndPoint::CreateGatekeeper(H323Transport * transport)
 {
+  if (processRelay != NULL)
+    return new H323ProcessGatekeeper(*this, transport, *processRelay);
+
   return new H323Gatekeeper(*this, transport);
 }
 
 
+void H323EndPoint::SetProcessRelay(H323ProcessRelay * relay)
+{
+  delete processRelay;
+  processRelay = relay;
+}
+
+
 PBoolean H323EndPoint::IsRegisteredWithGatekeeper() const
 {
   if (gatekeeper == NULL)
@@ -1720,6 +2583,16 @@ void H323EndPoint::EncryptionCacheInitialise()
   }
 }
 
+void H323EndPoint::SetEncryptionKeyPoolDepth(unsigned depth)
+{
+  H235Authenticators::SetDHKeyPoolDepth(depth);
+}
+
+void H323EndPoint::SetEncryptionEllipticCurve(PBoolean enable)
+{
+  H235Authenticators::SetEllipticCurveKeyAgreement(enable);
+}
+
 void H323EndPoint::EncryptionCacheRemove()
 {
   H2356_Authenticator::RemoveCache();
@@ -1853,6 +2726,9 @@ H323Connection * H323EndPoint::MakeCall(const PString & remoteParty,
 
   H323Connection * connection = NULL;
   for (PINDEX i = 0; i < Addresses.GetSize(); i++) {
+       PStringList alternates;
+       for (PINDEX j = i+1; j < Addresses.GetSize(); j++)
+         alternates.AppendString(Addresses[j]);
        connection = InternalMakeCall(PString::Empty(),
                                      PString::Empty(),
                                      UINT_MAX,
@@ -1860,7 +2736,8 @@ H323Connection * H323EndPoint::MakeCall(const PString & remoteParty,
                                      transport,
                                      token,
                                      userData,
-                                     supplementary
+                                     supplementary,
+                                     alternates
                                      );
     if (connection != NULL) {
         connection->Unlock();
@@ -1885,13 +2762,18 @@ H323Connection * H323EndPoint::MakeCallLocked(const PString & remoteParty,
 
   H323Connection * connection = NULL;
   for (PINDEX i = 0; i < Addresses.GetSize(); i++) {
+      PStringList alternates;
+      for (PINDEX j = i+1; j < Addresses.GetSize(); j++)
+        alternates.AppendString(Addresses[j]);
       connection = InternalMakeCall(PString::Empty(),
                              PString::Empty(),
                              UINT_MAX,
                              Addresses[i],
                              transport,
                              token,
-                             userData);
+                             userData,
+                             FALSE,
+                             alternates);
      if (connection != NULL)
             break;
   }
@@ -1907,11 +2789,14 @@ H323Connection * H323EndPoint::InternalMakeCall(const PString & trasferFromToken
                                                 H323Transport * transport,
                                                 PString & newToken,
                                                 void * userData,
-                                                PBoolean supplementary
+                                                PBoolean supplementary,
+                                                const PStringList & alternateParties
                                                 )
 {
   PTRACE(2, "H323\tMaking call to: " << remoteParty);
 
+  PTimeInterval callStart = PTimer::Tick();
+
   PString alias;
   H323TransportAddress address;
   if (!ParsePartyName(remoteParty, alias, address)) {
@@ -1932,8 +2817,13 @@ H323Connection * H323EndPoint::InternalMakeCall(const PString & trasferFromToken
       transport = gatekeeper->GetTransport().GetRemoteAddress().CreateTransport(*this);
 
     // assume address is an IP address/hostname
-    else
-      transport = address.CreateTransport(*this);
+    else {
+      // A transport already connected to a pooled peer skips the handshakes
+      if (signallingPool != NULL)
+        transport = signallingPool->Acquire(address);
+      if (transport == NULL)
+        transport = address.CreateTransport(*this);
+    }
 
     if (transport == NULL) {
       PTRACE(1, "H323\tInvalid transport in \"" << remoteParty << '"');
@@ -1962,7 +2852,9 @@ H323Connection * H323EndPoint::InternalMakeCall(const PString & trasferFromToken
       adjustedToken = newToken + "-replaced";
       adjustedToken.sprintf("-%u", ++tieBreaker);
     } while (connectionsActive.Contains(adjustedToken));
+    connectionsTableMutex.StartWrite();
     connectionsActive.SetAt(adjustedToken, connectionsActive.RemoveAt(newToken));
+    connectionsTableMutex.EndWrite();
     connectionsToBeCleaned += adjustedToken;
     PTRACE(3, "H323\tOverwriting call " << newToken << ", renamed to " << adjustedToken);
   }
@@ -1973,7 +2865,9 @@ H323Connection * H323EndPoint::InternalMakeCall(const PString & trasferFromToken
     PTRACE(2, "H323\tCreateConnection returned NULL");
     if (!adjustedToken.IsEmpty())  {
         connectionsMutex.Wait();
+        connectionsTableMutex.StartWrite();
         connectionsActive.SetAt(newToken, connectionsActive.RemoveAt(adjustedToken));
+        connectionsTableMutex.EndWrite();
         connectionsToBeCleaned -= adjustedToken;
         PTRACE(3, "H323\tOverwriting call " << adjustedToken << ", renamed to " << newToken);
         connectionsMutex.Signal();
@@ -1981,6 +2875,17 @@ H323Connection * H323EndPoint::InternalMakeCall(const PString & trasferFromToken
     return NULL;
   }
   connection->SetRemotePartyName(remoteParty);
+  connection->SetCallTimingStart(callStart);
+
+  // The other addresses the party resolved to are raced with this one
+  for (PINDEX i = 0; i < alternateParties.GetSize(); i++) {
+    PString alternateAlias;
+    H323TransportAddress alternateAddress;
+    if (ParsePartyName(alternateParties[i], alternateAlias, alternateAddress))
+      connection->AddAlternateSignalAddress(alternateAddress);
+  }
+  if (!address.IsEmpty())
+    connection->MarkCallTiming(H323CallTimeline::e_AddressResolved);
 
   if (supplementary)
       connection->SetNonCallConnection();
@@ -1988,8 +2893,10 @@ H323Connection * H323EndPoint::InternalMakeCall(const PString & trasferFromToken
   (void)connection->Lock();
 
   connectionsMutex.Wait();
+  connectionsTableMutex.StartWrite();
   connectionsActive.SetAt(newToken, connection);
-
+  IndexConnection(connection);
+  connectionsTableMutex.EndWrite();
   connectionsMutex.Signal();
 
   connection->AttachSignalChannel(newToken, transport, FALSE);
@@ -2012,7 +2919,13 @@ H323Connection * H323EndPoint::InternalMakeCall(const PString & trasferFromToken
       connection->ClearCall(reason);
   } else
 #endif
+  {
+    H225CallThreadPool * callPool = GetOutgoingCallPool();
+    if (callPool == NULL)
       new H225CallThread(*this, *connection, *transport, alias, address);
+    else if (!callPool->Dispatch(newToken, alias, address))
+      connection->ClearCall(H323Connection::EndedByLocalCongestion);
+  }
 
   return connection;
 }
@@ -2088,8 +3001,36 @@ static PBoolean FindRoutes(const PString & domain, WORD port, std::vector<Lookup
   return routes.size() != 0;
 }
 */
+
+void H323EndPoint::SetDNSCacheTime(const PTimeInterval & cacheTime, const PTimeInterval & negativeCacheTime)
+{
+  PWaitAndSignal m(connectionsMutex);
+  dnsCacheTime = cacheTime;
+  dnsNegativeCacheTime = negativeCacheTime;
+  if (dnsResolver != NULL)
+    dnsResolver->SetCacheTime(cacheTime, negativeCacheTime);
+}
+
+H323DNSResolver * H323EndPoint::GetDNSResolver()
+{
+  PWaitAndSignal m(connectionsMutex);
+  if (dnsResolver == NULL)
+    dnsResolver = new H323DNSResolver(dnsCacheTime, dnsNegativeCacheTime);
+
+  return dnsResolver;
+}
+
 #endif
 
+H323SignallingPool * H323EndPoint::GetSignallingPool()
+{
+  PWaitAndSignal m(connectionsMutex);
+  if (signallingPool == NULL)
+    signallingPool = new H323SignallingPool(*this);
+
+  return signallingPool;
+}
+
 PBoolean H323EndPoint::ResolveCallParty(const PString & _remoteParty, PStringList & addresses)
 {
   PString remoteParty = _remoteParty;
@@ -2117,8 +3058,9 @@ PBoolean H323EndPoint::ResolveCallParty(const PString & _remoteParty, PStringLis
             break;
     }
     if (i >= number.GetLength()) {
-        PString str;
-        if (PDNS::ENUMLookup(number, "E2U+h323", str)) {
+        PStringList enumResult;
+        if (GetDNSResolver()->Lookup(H323DNSResolver::ENUMQuery, number, "E2U+h323", enumResult)) {
+            PString str = enumResult[0];
             str.Replace("+","");
             if ((str.Find("//1") != P_MAX_INDEX) &&
                  (str.Find('@') != P_MAX_INDEX)) {
@@ -2153,7 +3095,7 @@ PBoolean H323EndPoint::ResolveCallParty(const PString & _remoteParty, PStringLis
        PBoolean found = FALSE;
 
        if (!found) str.RemoveAll();
-       if (!found && (PDNS::LookupSRV(number,"_h323cs._tcp.",str))) {
+       if (!found && GetDNSResolver()->Lookup(H323DNSResolver::SRVQuery, number, "_h323cs._tcp.", str)) {
            for (PINDEX i=0; i<str.GetSize(); i++) {
              PString dom = str[i].Mid(str[i].Find('@')+1);
              if (dom.Left(7) == "0.0.0.0") {
@@ -2622,7 +3564,7 @@ PBoolean H323EndPoint::ClearCallSynchronous(const PString & token,
                                         H323Connection::CallEndReason reason,
                                         PSyncPoint * sync)
 {
-  if (PThread::Current() == connectionsCleaner)
+  if (connectionsCleaner == NULL || connectionsCleaner->IsCleanerThread(PThread::Current()))
     sync = NULL;
 
   /*The hugely multi-threaded nature of the H323Connection objects means that
@@ -2651,12 +3593,14 @@ PBoolean H323EndPoint::ClearCallSynchronous(const PString & token,
     // Add this to the set of connections being cleaned, if not in already
     if (!connectionsToBeCleaned.Contains(connection->GetCallToken()))
       connectionsToBeCleaned += connection->GetCallToken();
+    metrics.callsCleaning.Set(connectionsToBeCleaned.GetSize());
 
     // Now set reason for the connection close
     connection->SetCallEndReason(reason, sync);
 
     // Signal the background threads that there is some stuff to process.
-    connectionsCleaner->Signal();
+    if (connectionsCleaner != NULL)
+      connectionsCleaner->Signal();
   }
 
   if (sync != NULL)
@@ -2687,6 +3631,7 @@ void H323EndPoint::ClearAllCalls(H323Connection::CallEndReason reason,
     // Now set reason for the connection close
     connection.SetCallEndReason(reason, NULL);
   }
+  metrics.callsCleaning.Set(connectionsToBeCleaned.GetSize());
 
   // Signal the background threads that there is some stuff to process.
   connectionsCleaner->Signal();
@@ -2701,6 +3646,68 @@ void H323EndPoint::ClearAllCalls(H323Connection::CallEndReason reason,
     connectionsAreCleaned.Wait();
 }
 
+
+PBoolean H323EndPoint::ClearAllCallsInBulk(H323Connection::CallEndReason reason,
+                                           const PTimeInterval & deadline,
+                                           PBoolean unregister,
+                                           PINDEX threads)
+{
+  PTime start;
+
+  // The gatekeeper ends every call with the registration
+  PBoolean unregistered = FALSE;
+  if (unregister && gatekeeper != NULL && gatekeeper->IsRegistered())
+    unregistered = gatekeeper->UnregistrationRequest(H225_UnregRequestReason::e_maintenance);
+
+  connectionsMutex.Wait();
+
+  PINDEX count = connectionsActive.GetSize();
+  PTRACE(2, "H323\tClearing " << count << " calls in bulk" << (unregistered ? " after URQ" : ""));
+  if (count == 0) {
+    connectionsMutex.Signal();
+    return TRUE;
+  }
+
+  bulkClearing = TRUE;
+  bulkSkipDisengage = unregistered;
+  bulkClearReason = reason;
+
+  // Stop the media of every call before any is cleaned up, the release
+  // complete is sent by the cleaner threads, see CleanUpConnections()
+  PINDEX i;
+  for (i = 0; i < count; i++) {
+    H323Connection & connection = connectionsActive.GetDataAt(i);
+    connectionsToBeCleaned += connection.GetCallToken();
+    connection.StartMediaTermination();
+  }
+  metrics.callsCleaning.Set(connectionsToBeCleaned.GetSize());
+
+  if (threads > count)
+    threads = count;
+  if (threads > cleanerThreads)
+    connectionsCleaner->SetSize(threads);
+
+  while (connectionsAreCleaned.Wait(0))
+    ;
+
+  connectionsCleaner->Signal();
+
+  connectionsMutex.Signal();
+
+  PBoolean cleaned = connectionsAreCleaned.Wait(deadline);
+
+  if (cleaned) {
+    connectionsCleaner->SetSize(cleanerThreads);
+    PTRACE(2, "H323\tCleared " << count << " calls in bulk in " << (PTime() - start));
+  }
+  else {
+    PTRACE(1, "H323\tCalls not all cleared in bulk within " << deadline);
+  }
+
+  return cleaned;
+}
+
+
 void H323EndPoint::CleanUpConnections()
 {
   PTRACE(3, "H323\tCleaning up connections");
@@ -2709,28 +3716,73 @@ void H323EndPoint::CleanUpConnections()
   connectionsMutex.Wait();
 
   // Continue cleaning up until no more connections to clean
-  while (connectionsToBeCleaned.GetSize() > 0) {
-    // Just get the first entry in the set of tokens to clean up.
-    PString token = connectionsToBeCleaned.GetKeyAt(0);
+  for (;;) {
+    // Get the first entry in the set of tokens to clean up that no other
+    // cleaner thread has taken, there are at most as many as threads.
+    PString token;
+    for (PINDEX i = 0; i < connectionsToBeCleaned.GetSize(); i++) {
+      if (!connectionsBeingCleaned.Contains(connectionsToBeCleaned.GetKeyAt(i))) {
+        token = connectionsToBeCleaned.GetKeyAt(i);
+        break;
+      }
+    }
+    if (token.IsEmpty())
+      break;
+
+    connectionsBeingCleaned += token;
     H323Connection & connection = connectionsActive[token];
+    PTimeInterval cleanUpStart = PTimer::Tick();
+    PBoolean releaseNeeded = bulkClearing;
 
     // Unlock the structures here so does not block other uses of ClearCall()
     // for the possibly long time it takes to CleanUpOnCallEnd().
     connectionsMutex.Signal();
 
+    // Released here so the calls cleared in bulk are released in parallel
+    if (releaseNeeded)
+      connection.SetCallEndReason(bulkClearReason, NULL);
+
     // Clean up the connection, waiting for all threads to terminate
     connection.CleanUpOnCallEnd();
     connection.OnCleared();
 
+    if (callJournal != NULL) {
+      H323CallRecord record;
+      connection.GetCallRecord(record);
+      callJournal->Record(record);
+    }
+#ifdef H323_H460IM
+    IMClearConnection(token);
+#endif
+
+    PStringStream reason;
+    reason << connection.GetCallEndReason();
+    metrics.OnCallEnded(reason);
+
+    const H323CallTimeline & timeline = connection.GetCallTimeline();
+    callTimingStats.Record(timeline);
+    if (slowCallSetupTime > 0) {
+      PInt64 established = timeline.GetTime(H323CallTimeline::e_Established);
+      PInt64 cleared = timeline.GetTime(H323CallTimeline::e_Cleared);
+      if (established > slowCallSetupTime.GetMilliSeconds() ||
+          (established < 0 && cleared > slowCallSetupTime.GetMilliSeconds()))
+        OnSlowCallSetup(connection, timeline);
+    }
+
     // Get the lock again as we remove the connection from our database
     connectionsMutex.Wait();
 
     // Remove the token from the set of connections to be cleaned up
     connectionsToBeCleaned -= token;
+    connectionsBeingCleaned -= token;
+    metrics.callsCleaning.Set(connectionsToBeCleaned.GetSize());
 
     // And remove the connection instance itself from the dictionary which will
     // cause its destructor to be called.
+    connectionsTableMutex.StartWrite();
     H323Connection * connectionToDelete = connectionsActive.RemoveAt(token);
+    UnindexConnection(connectionToDelete);
+    connectionsTableMutex.EndWrite();
 
     // Unlock the structures yet again to avoid possible race conditions when
     // deleting the connection as well as the delte of a conncetion descendent
@@ -2743,17 +3795,37 @@ void H323EndPoint::CleanUpConnections()
     // Argument to 'delete' is a constant address (x), which is not memory allocated by 'new'
     delete connectionToDelete;
 
+    metrics.callsCleanedTotal.Add();
+    metrics.callCleanUpTime.Add((PTimer::Tick() - cleanUpStart).GetMilliSeconds());
+
     // Get the lock again as we continue around the loop
     connectionsMutex.Wait();
   }
 
+  // The last thread to finish tells anyone waiting that all are cleaned
+  PBoolean finished = connectionsBeingCleaned.IsEmpty();
+
+  // Calls cleared later are cleared as usual again
+  if (finished && connectionsToBeCleaned.IsEmpty()) {
+    bulkClearing = FALSE;
+    bulkSkipDisengage = FALSE;
+  }
+
   // Finished with loop, unlock the connections database.
   connectionsMutex.Signal();
 
   // Signal thread that may be waiting on ClearAllCalls()
-  connectionsAreCleaned.Signal();
+  if (finished)
+    connectionsAreCleaned.Signal();
 }
 
+void H323EndPoint::SetCleanerThreads(PINDEX count)
+{
+  cleanerThreads = PMAX(count, 1);
+  connectionsCleaner->SetSize(cleanerThreads);
+}
+
+
 PBoolean H323EndPoint::WillConnectionMutexBlock()
 {
     return !connectionsMutex.Try();
@@ -2761,22 +3833,22 @@ PBoolean H323EndPoint::WillConnectionMutexBlock()
 
 PBoolean H323EndPoint::HasConnection(const PString & token)
 {
-  PWaitAndSignal wait(connectionsMutex);
+  PReadWaitAndSignal wait(connectionsTableMutex);
 
   return FindConnectionWithoutLocks(token) != NULL;
 }
 
 H323Connection * H323EndPoint::FindConnectionWithLock(const PString & token)
 {
-  PWaitAndSignal mutex(connectionsMutex);
+  PReadWaitAndSignal mutex(connectionsTableMutex);
 
   /*We have a very yucky polling loop here as a semi permanant measure.
-    Why? We cannot call Lock() inside the connectionsMutex critical section as
+    Why? We cannot call Lock() inside the connectionsTableMutex read lock as
     it will cause a deadlock with something like a RELEASE-COMPLETE coming in
     on separate thread. But if we put it outside there is a small window where
     the connection could get deleted before the Lock() test is done.
     The solution is to attempt to get the mutex while inside the
-    connectionsMutex but not block. That means a polling loop. There is
+    connectionsTableMutex but not block. That means a polling loop. There is
     probably a way to do this properly with mutexes but I don't have time to
     figure it out.
    */
@@ -2788,11 +3860,34 @@ H323Connection * H323EndPoint::FindConnectionWithLock(const PString & token)
       case 1 :
         return connection;
     }
-    // Could not get connection lock, unlock the endpoint lists so a thread
-    // that has the connection lock gets a chance at the endpoint lists.
-    connectionsMutex.Signal();
+    // Could not get connection lock, unlock the endpoint lists so a thread
+    // that has the connection lock gets a chance at the endpoint lists.
+    connectionsTableMutex.EndRead();
+    PThread::Sleep(20);
+    connectionsTableMutex.StartRead();
+  }
+
+  return NULL;
+}
+
+
+H323Connection * H323EndPoint::FindConnectionWithReadLock(const PString & token)
+{
+  PReadWaitAndSignal mutex(connectionsTableMutex);
+
+  // As FindConnectionWithLock(), the read lock may be held by a thread
+  // waiting for the connection table.
+  H323Connection * connection;
+  while ((connection = FindConnectionWithoutLocks(token)) != NULL) {
+    switch (connection->TryLockReadOnly()) {
+      case 0 :
+        return NULL;
+      case 1 :
+        return connection;
+    }
+    connectionsTableMutex.EndRead();
     PThread::Sleep(20);
-    connectionsMutex.Wait();
+    connectionsTableMutex.StartRead();
   }
 
   return NULL;
@@ -2808,33 +3903,106 @@ H323Connection * H323EndPoint::FindConnectionWithoutLocks(const PString & token)
   if (conn_ptr != NULL)
     return conn_ptr;
 
-  PINDEX i;
-  for (i = 0; i < connectionsActive.GetSize(); i++) {
-    H323Connection & conn = connectionsActive.GetDataAt(i);
-    if (conn.GetCallIdentifier().AsString() == token)
-      return &conn;
+  // Not a call token, try it as a call then conference identifier
+  OpalGloballyUniqueID guid(token);
+  if (guid.IsNULL() || guid.AsString() != token)
+    return NULL;
+
+  std::string key((const char *)(const BYTE *)guid, guid.GetSize());
+
+  std::pair<ConnectionIdentifierIndex::iterator, ConnectionIdentifierIndex::iterator> range;
+  ConnectionIdentifierIndex::iterator it;
+
+  range = connectionsByCallId.equal_range(key);
+  for (it = range.first; it != range.second; ++it) {
+    if (it->second->GetCallIdentifier() == guid)
+      return it->second;
   }
 
-  for (i = 0; i < connectionsActive.GetSize(); i++) {
-    H323Connection & conn = connectionsActive.GetDataAt(i);
-    if (conn.GetConferenceIdentifier().AsString() == token)
-      return &conn;
+  range = connectionsByConferenceId.equal_range(key);
+  for (it = range.first; it != range.second; ++it) {
+    if (it->second->GetConferenceIdentifier() == guid)
+      return it->second;
   }
 
   return NULL;
 }
 
 
+void H323EndPoint::IndexConnection(H323Connection * connection)
+{
+  UnindexConnection(connection);
+
+  const OpalGloballyUniqueID & callId = connection->GetCallIdentifier();
+  const OpalGloballyUniqueID & confId = connection->GetConferenceIdentifier();
+
+  IndexedIdentifiers & ids = connectionIdentifiers[connection];
+  ids.callIdentifier.assign((const char *)(const BYTE *)callId, callId.GetSize());
+  ids.conferenceIdentifier.assign((const char *)(const BYTE *)confId, confId.GetSize());
+
+  connectionsByCallId.insert(ConnectionIdentifierIndex::value_type(ids.callIdentifier, connection));
+  connectionsByConferenceId.insert(ConnectionIdentifierIndex::value_type(ids.conferenceIdentifier, connection));
+}
+
+
+static void RemoveFromIndex(std::multimap<std::string, H323Connection *> & index,
+                            const std::string & key,
+                            H323Connection * connection)
+{
+  std::pair<std::multimap<std::string, H323Connection *>::iterator,
+            std::multimap<std::string, H323Connection *>::iterator> range = index.equal_range(key);
+  for (std::multimap<std::string, H323Connection *>::iterator it = range.first; it != range.second; ++it) {
+    if (it->second == connection) {
+      index.erase(it);
+      return;
+    }
+  }
+}
+
+
+void H323EndPoint::UnindexConnection(H323Connection * connection)
+{
+  std::map<H323Connection *, IndexedIdentifiers>::iterator ids = connectionIdentifiers.find(connection);
+  if (ids == connectionIdentifiers.end())
+    return;
+
+  RemoveFromIndex(connectionsByCallId, ids->second.callIdentifier, connection);
+  RemoveFromIndex(connectionsByConferenceId, ids->second.conferenceIdentifier, connection);
+  connectionIdentifiers.erase(ids);
+}
+
+
+void H323EndPoint::AddConnection(const PString & token, H323Connection * connection)
+{
+  PWaitAndSignal mutex(connectionsMutex);
+  PWriteWaitAndSignal table(connectionsTableMutex);
+
+  connectionsActive.SetAt(token, connection);
+  IndexConnection(connection);
+}
+
+
+void H323EndPoint::OnConnectionIdentifiersChanged(H323Connection & connection)
+{
+  PWaitAndSignal mutex(connectionsMutex);
+  PWriteWaitAndSignal table(connectionsTableMutex);
+
+  // Only connections in the active list are indexed
+  if (connectionIdentifiers.find(&connection) != connectionIdentifiers.end())
+    IndexConnection(&connection);
+}
+
+
 PStringList H323EndPoint::GetAllConnections()
 {
   PStringList tokens;
 
-  connectionsMutex.Wait();
+  connectionsTableMutex.StartRead();
 
   for (PINDEX i = 0; i < connectionsActive.GetSize(); i++)
     tokens.AppendString(connectionsActive.GetKeyAt(i));
 
-  connectionsMutex.Signal();
+  connectionsTableMutex.EndRead();
 
   return tokens;
 }
@@ -2949,12 +4117,12 @@ void H323EndPoint::OnConnectionEstablished(H323Connection & /*connection*/,
 
 PBoolean H323EndPoint::IsConnectionEstablished(const PString & token)
 {
-  H323Connection * connection = FindConnectionWithLock(token);
+  H323Connection * connection = FindConnectionWithReadLock(token);
   if (connection == NULL)
     return FALSE;
 
   PBoolean established = connection->IsEstablished();
-  connection->Unlock();
+  connection->UnlockReadOnly();
   return established;
 }
 
@@ -2973,6 +4141,13 @@ void H323EndPoint::OnConnectionCleared(H323Connection & /*connection*/,
 }
 
 
+void H323EndPoint::OnSlowCallSetup(H323Connection & PTRACE_PARAM(connection),
+                                   const H323CallTimeline & PTRACE_PARAM(timeline))
+{
+  PTRACE(2, "H323\tSlow setup of call " << connection.GetCallToken() << ":\n" << timeline);
+}
+
+
 PString H323EndPoint::BuildConnectionToken(const H323Transport & transport,
                                            unsigned callReference,
                                            PBoolean fromRemote)
@@ -2996,9 +4171,9 @@ H323Connection * H323EndPoint::OnIncomingConnection(H323Transport * transport,
   unsigned callReference = setupPDU.GetQ931().GetCallReference();
   PString token = BuildConnectionToken(*transport, callReference, TRUE);
 
-  connectionsMutex.Wait();
+  connectionsTableMutex.StartRead();
   H323Connection * connection = connectionsActive.GetAt(token);
-  connectionsMutex.Signal();
+  connectionsTableMutex.EndRead();
 
   if (connection == NULL) {
     connection = CreateConnection(callReference, NULL, transport, &setupPDU);
@@ -3010,7 +4185,10 @@ H323Connection * H323EndPoint::OnIncomingConnection(H323Transport * transport,
     PTRACE(3, "H323\tCreated new connection: " << token);
 
     connectionsMutex.Wait();
+    connectionsTableMutex.StartWrite();
     connectionsActive.SetAt(token, connection);
+    IndexConnection(connection);
+    connectionsTableMutex.EndWrite();
     connectionsMutex.Signal();
   }
 
@@ -3185,6 +4363,50 @@ void H323EndPoint::OnRTPFinalStatistics(const H323Connection & /*connection*/,
 {
 }
 
+void H323EndPoint::OnRTPHistograms(const RTP_Session::Histograms & histograms, PBoolean receive)
+{
+  PWaitAndSignal mutex(rtpHistogramMutex);
+  rtpHistograms.Merge(histograms, receive, !receive);
+}
+
+void H323EndPoint::GetRTPHistograms(RTP_Session::Histograms & histograms) const
+{
+  PWaitAndSignal mutex(rtpHistogramMutex);
+  histograms = rtpHistograms;
+}
+
+void H323EndPoint::ResetRTPHistograms()
+{
+  PWaitAndSignal mutex(rtpHistogramMutex);
+  rtpHistograms = RTP_Session::Histograms();
+}
+
+void H323EndPoint::SetCallJournal(H323CallJournal * journal)
+{
+  delete callJournal;
+  callJournal = journal;
+  if (callJournal != NULL)
+    callJournal->SetMetrics(&metrics);
+}
+
+
+PBoolean H323EndPoint::SetHotTraceCall(const PString & token)
+{
+  if (token.IsEmpty()) {
+    H323HotTrace::SetFilter(0);
+    return TRUE;
+  }
+
+  H323Connection * connection = FindConnectionWithReadLock(token);
+  if (connection == NULL)
+    return FALSE;
+
+  H323HotTrace::NameCall(connection->GetTraceTag(), token);
+  H323HotTrace::SetFilter(connection->GetTraceTag());
+  connection->UnlockReadOnly();
+  return TRUE;
+}
+
 
 void H323EndPoint::OnUserInputString(H323Connection & /*connection*/,
                                      const PString & /*value*/)
@@ -3710,7 +4932,36 @@ void H323EndPoint::SetSTUNServer(const PString & server)
     PTRACE(2, "H323\tSTUN server \"" << server << "\" replies " << stun->GetNatTypeName());
 
     STUNNatType((int)stun->GetNatType());
+
+    // The test just made found the external address, keep it for the calls
+    PIPSocket::Address externalAddress;
+    H323NatDiscoveryCache * cache = GetNatDiscoveryCache();
+    if (cache != NULL && stun->GetExternalAddress(externalAddress))
+      cache->SetResult("STUN", (int)stun->GetNatType(), externalAddress, TRUE);
   }
+  else if (natDiscoveryCache != NULL)
+    natDiscoveryCache->Invalidate("STUN");
+}
+
+H323NatDiscoveryCache * H323EndPoint::GetNatDiscoveryCache()
+{
+  PWaitAndSignal m(connectionsMutex);
+  if (natDiscoveryCacheTime == 0)
+    return NULL;
+
+  if (natDiscoveryCache == NULL)
+    natDiscoveryCache = new H323NatDiscoveryCache(*this, natDiscoveryCacheTime);
+
+  return natDiscoveryCache;
+}
+
+PBoolean H323EndPoint::GetNatExternalAddress(PNatMethod & method, PIPSocket::Address & address)
+{
+  H323NatDiscoveryCache * cache = GetNatDiscoveryCache();
+  if (cache != NULL)
+    return cache->GetExternalAddress(method, address);
+
+  return method.GetExternalAddress(address);
 }
 
 #endif // P_STUN
@@ -3762,7 +5013,7 @@ void H323EndPoint::InternalTranslateTCPAddress(PIPSocket::Address & localAddr, c
   if (localAddr.IsRFC1918() && !remoteAddr.IsRFC1918()) {
       if (!connection) {
         PNatMethod * stun = GetNatMethods().GetMethodByName("STUN");
-        if (stun && stun->IsAvailable(remoteAddr) && stun->GetExternalAddress(localAddr)) {
+        if (stun && stun->IsAvailable(remoteAddr) && GetNatExternalAddress(*stun, localAddr)) {
            PTRACE(2,"EP\tSTUN set localIP as " << localAddr);
         } else {
             const H323NatList & list = natMethods->GetNATList();
@@ -3772,7 +5023,7 @@ void H323EndPoint::InternalTranslateTCPAddress(PIPSocket::Address & localAddr, c
 #else
                   PString name = list[i].GetName();
 #endif
-                  if (list[i].IsAvailable(remoteAddr) && list[i].GetExternalAddress(localAddr)) {
+                  if (list[i].IsAvailable(remoteAddr) && GetNatExternalAddress(list[i], localAddr)) {
                      PTRACE(2,"EP\tNATMethod " << name
                          << " rewrite localIP as " << localAddr);
                      break;
@@ -3966,6 +5217,10 @@ void H323EndPoint::LoadBaseFeatureSet()
 #ifdef H323_H460
   features.AttachEndPoint(this);
   features.LoadFeatureSet(H460_Feature::FeatureBase);
+
+  // Catalogue the plugins now so the first call does not wait for it
+  H460_FeatureCatalogue::Load(H460_Feature::FeatureRas);
+  H460_FeatureCatalogue::Load(H460_Feature::FeatureSignal);
 #endif
 }
 
@@ -4054,6 +5309,16 @@ PBoolean H323EndPoint::H46019MIsSending()
 {
     return (m_h46019Menabled && m_h46019Msend);
 }
+
+void H323EndPoint::H46019MSetReadThreads(PINDEX count)
+{
+    PNatMethod_H46019::SetMultiplexReadThreads(count);
+}
+
+PINDEX H323EndPoint::H46019MGetReadThreads() const
+{
+    return PNatMethod_H46019::GetMultiplexReadThreads();
+}
 #endif  // H323_H46019M
 
 #ifdef H323_H46023
@@ -4280,10 +5545,23 @@ PBoolean H323EndPoint::InitialiseTransportContext()
     }
 
     // VLD found memory leak in PTLIB v2.12 and prior version of PSSLContext - SH
+    m_tlsSessionCache = new H323TLSSessionCache();
     m_transportContext = new H323_TLSContext();
     return true;
 }
 
+H323TLSHandshakePool * H323EndPoint::GetTLSHandshakePool()
+{
+    PWaitAndSignal m(connectionsMutex);
+    if (tlsHandshakeWorkers == 0)
+        return NULL;
+
+    if (tlsHandshakePool == NULL)
+        tlsHandshakePool = new H323TLSHandshakePool(*this, tlsHandshakeWorkers);
+
+    return tlsHandshakePool;
+}
+
 PSSLContext * H323EndPoint::GetTransportContext()
 {
     return m_transportContext;
@@ -4318,9 +5596,134 @@ H323TransportSecurity * H323EndPoint::GetTransportSecurity() {
 
 void H323EndPoint::IMSupport(const PString & token)
 {
-    PWaitAndSignal m(m_IMmutex);
+    PWriteWaitAndSignal m(m_IMsessionMutex);
+
+    m_IMsessions[token];
+}
+
+void H323EndPoint::IMGetSessionTokens(PStringArray & tokens)
+{
+    PReadWaitAndSignal m(m_IMsessionMutex);
+
+    tokens.SetSize(m_IMsessions.size());
+    PINDEX i = 0;
+    for (IMSessionMap::const_iterator it = m_IMsessions.begin(); it != m_IMsessions.end(); ++it)
+        tokens[i++] = it->first;
+}
+
+PString H323EndPoint::IMGetSession(const PString & party)
+{
+    {
+        PReadWaitAndSignal m(m_IMsessionMutex);
+        std::map<PString, PString>::const_iterator it = m_IMpeers.find(party);
+        if (it != m_IMpeers.end())
+            return it->second;
+    }
+
+    // Not used yet for this party, look for a call with it that supports messaging.
+    // The connections are locked without the session lock held.
+    PStringArray tokens;
+    IMGetSessionTokens(tokens);
+    for (PINDEX i = 0; i < tokens.GetSize(); i++) {
+        H323Connection * connection = FindConnectionWithLock(tokens[i]);
+        if (connection == NULL)
+            continue;
+        PBoolean match = connection->GetRemotePartyNumber() == party ||
+                         connection->GetRemotePartyName() == party ||
+                         connection->GetRemotePartyAddress() == party;
+        connection->Unlock();
+
+        if (match) {
+            PWriteWaitAndSignal m(m_IMsessionMutex);
+            IMSessionMap::iterator it = m_IMsessions.find(tokens[i]);
+            if (it != m_IMsessions.end()) {
+                it->second.peer = party;
+                m_IMpeers[party] = tokens[i];
+                return tokens[i];
+            }
+        }
+    }
+
+    return PString();
+}
+
+PBoolean H323EndPoint::IMSendOnSession(const PString & token, const PString & msg)
+{
+    H323Connection * connection = FindConnectionWithLock(token);
+    if (connection == NULL)
+        return false;
+
+    // An IM call takes messages once the session is open, any other call once messaging is supported
+    PBoolean ready = connection->IMCall() ? connection->IMSession() : connection->IMSupport();
+    if (ready) {
+        connection->SetIMMsg(msg);
+        IMWriteFacility(connection);
+    }
+    connection->Unlock();
 
-    m_IMsessions.AppendString(token);
+    return ready;
+}
+
+PBoolean H323EndPoint::IMSendTo(const PString & party, const PString & msg)
+{
+    if (!m_IMenabled || msg.IsEmpty())
+        return false;
+
+    PString token = IMGetSession(party);
+    for (int attempt = 0; !token.IsEmpty() && attempt < 2; attempt++) {
+        if (IMSendOnSession(token, msg))
+            return true;
+
+        PWriteWaitAndSignal m(m_IMsessionMutex);
+        IMSessionMap::iterator it = m_IMsessions.find(token);
+        if (it == m_IMsessions.end())
+            break;
+        if (it->second.starting) {
+            it->second.pending.AppendString(msg);
+            PTRACE(4, "IM\tQueued message to " << party << " until session " << token << " opens");
+            return true;
+        }
+        // Else it may have opened while the lock was free, try once more
+    }
+
+    PTRACE(3, "IM\tOpening session to " << party);
+    if (!IMMakeCall(party, true, token))
+        return false;
+
+    PWriteWaitAndSignal m(m_IMsessionMutex);
+    IMSessionInfo & info = m_IMsessions[token];
+    info.peer = party;
+    info.starting = true;
+    info.pending.AppendString(msg);
+    m_IMpeers[party] = token;
+    return true;
+}
+
+void H323EndPoint::IMSessionReady(const PString & token)
+{
+    // Holding the connection while the queue is sent keeps later messages behind it
+    H323Connection * connection = FindConnectionWithLock(token);
+    if (connection == NULL)
+        return;
+
+    PStringList pending;
+    {
+        PWriteWaitAndSignal m(m_IMsessionMutex);
+        IMSessionMap::iterator it = m_IMsessions.find(token);
+        if (it != m_IMsessions.end()) {
+            it->second.starting = false;
+            pending = it->second.pending;
+            it->second.pending = PStringList();
+        }
+    }
+
+    PTRACE_IF(4, !pending.IsEmpty(), "IM\tSession " << token << " open, sending " << pending.GetSize() << " queued messages");
+    for (PINDEX i = 0; i < pending.GetSize(); i++) {
+        connection->SetIMMsg(pending[i]);
+        IMWriteFacility(connection);
+    }
+
+    connection->Unlock();
 }
 
 void H323EndPoint::IMReceived(const PString & token, const PString & msg, PBoolean session)
@@ -4368,17 +5771,17 @@ PBoolean H323EndPoint::IMMakeCall(const PString & number, PBoolean session, PStr
 
 void H323EndPoint::IMSend(const PString & msg)
 {
-    PWaitAndSignal m(m_IMmutex);
-
     if (!m_IMenabled)
         return;
 
     if (msg.GetLength() == 0)
         return;
 
-    for (PINDEX i = 0; i < m_IMsessions.GetSize(); i++)
+    PStringArray tokens;
+    IMGetSessionTokens(tokens);
+    for (PINDEX i = 0; i < tokens.GetSize(); i++)
     {
-        H323Connection * connection = FindConnectionWithLock(m_IMsessions[i]);
+        H323Connection * connection = FindConnectionWithLock(tokens[i]);
         if (connection != NULL) {
             if (connection->IMSession()) {
                 connection->SetIMMsg(msg);
@@ -4391,8 +5794,6 @@ void H323EndPoint::IMSend(const PString & msg)
 
 void H323EndPoint::IMOpenSession(const PString & token)
 {
-    PWaitAndSignal m(m_IMmutex);
-
     H323Connection * connection = FindConnectionWithLock(token);
     if (connection != NULL) {
         if (!connection->IMSupport())
@@ -4410,41 +5811,41 @@ void H323EndPoint::IMOpenSession(const PString & token)
 
 void H323EndPoint::IMCloseSession()
 {
-    PWaitAndSignal m(m_IMmutex);
-
-    for (PINDEX i = 0; i < m_IMsessions.GetSize(); i++)
+    PStringArray tokens;
+    IMGetSessionTokens(tokens);
+    for (PINDEX i = 0; i < tokens.GetSize(); i++)
     {
-        H323Connection * connection = FindConnectionWithLock(m_IMsessions[i]);
+        H323Connection * connection = FindConnectionWithLock(tokens[i]);
         if (connection != NULL) {
             if (connection->IMSession()) {
                 connection->SetIMSession(false);
                 IMWriteFacility(connection);
-                connection->Unlock();
             }
+            connection->Unlock();
         }
     }
 }
 
 void H323EndPoint::IMClearConnection(const PString & token)
 {
-    PWaitAndSignal m(m_IMmutex);
+    PWriteWaitAndSignal m(m_IMsessionMutex);
 
-    for (PINDEX i = 0; i < m_IMsessions.GetSize(); i++)
-    {
-        if (m_IMsessions[i] == token)
-#if PTLIB_VER >= 2110
-            m_IMsessions.Remove(&token);
-#else
-            m_IMsessions.RemoveAt(i);
-#endif
-    }
+    IMSessionMap::iterator it = m_IMsessions.find(token);
+    if (it == m_IMsessions.end())
+        return;
+
+    PTRACE_IF(2, !it->second.pending.IsEmpty(), "IM\tSession " << token << " ended with "
+              << it->second.pending.GetSize() << " messages unsent");
+
+    std::map<PString, PString>::iterator peer = m_IMpeers.find(it->second.peer);
+    if (peer != m_IMpeers.end() && peer->second == token)
+        m_IMpeers.erase(peer);
+    m_IMsessions.erase(it);
 }
 
 
 void H323EndPoint::IMSessionOpen(const PString & token)
 {
-    PWaitAndSignal m(m_IMmutex);
-
     H323Connection * connection = FindConnectionWithLock(token);
 
     PString addr = PString();
@@ -4477,9 +5878,11 @@ void H323EndPoint::IMWrite(PBoolean start)
 
     m_IMwriteevent = true;
 
-    for (PINDEX i = 0; i < m_IMsessions.GetSize(); i++)
+    PStringArray tokens;
+    IMGetSessionTokens(tokens);
+    for (PINDEX i = 0; i < tokens.GetSize(); i++)
     {
-        H323Connection * connection = FindConnectionWithLock(m_IMsessions[i]);
+        H323Connection * connection = FindConnectionWithLock(tokens[i]);
         if (connection != NULL) {
             if (connection->IMSession())
                 IMWriteFacility(connection);
@@ -4784,6 +6187,152 @@ PBoolean H323EndPoint::HandleUnsolicitedInformation(const H323SignalPDU & )
   return FALSE;
 }
 
+RTP_MediaReactor * H323EndPoint::GetMediaReactor()
+{
+  PWaitAndSignal m(connectionsMutex);
+  if (mediaReactorThreads == 0 || !RTP_MediaReactor::IsAvailable())
+    return NULL;
+
+  if (mediaReactor == NULL) {
+    mediaReactor = new RTP_MediaReactor(mediaReactorThreads, channelThreadPriority, jitterThreadStackSize,
+                                        threadAffinity[MediaThreads]);
+    mediaReactor->SetSocketSteering(mediaSocketSteering);
+  }
+
+  return mediaReactor;
+}
+
+H225TransportThreadPool * H323EndPoint::GetSignallingThreadPool()
+{
+  PWaitAndSignal m(connectionsMutex);
+  if (signallingThreadPoolSize == 0)
+    return NULL;
+
+  if (signallingThreadPool == NULL)
+    signallingThreadPool = new H225TransportThreadPool(*this, signallingThreadPoolSize);
+
+  return signallingThreadPool;
+}
+
+H225CallThreadPool * H323EndPoint::GetOutgoingCallPool()
+{
+  PWaitAndSignal m(connectionsMutex);
+  if (outgoingCallPoolSize == 0)
+    return NULL;
+
+  if (outgoingCallPool == NULL)
+    outgoingCallPool = new H225CallThreadPool(*this, outgoingCallPoolSize, outgoingCallQueueLimit);
+
+  return outgoingCallPool;
+}
+
+H323SignallingReactor * H323EndPoint::GetSignallingReactor()
+{
+  PWaitAndSignal m(connectionsMutex);
+  if (signallingReactorThreads == 0 || !H323SignallingReactor::IsAvailable())
+    return NULL;
+
+  if (signallingReactor == NULL)
+    signallingReactor = new H323SignallingReactor(signallingReactorThreads, signallingThreadStackSize,
+                                                  threadAffinity[SignallingThreads]);
+
+  return signallingReactor;
+}
+
+RTP_TransmitScheduler * H323EndPoint::GetTransmitScheduler()
+{
+  PWaitAndSignal m(connectionsMutex);
+  if (!useTransmitPacing)
+    return NULL;
+
+  if (transmitScheduler == NULL)
+    transmitScheduler = new RTP_TransmitScheduler(channelThreadPriority);
+
+  return transmitScheduler;
+}
+
+H323TimerService & H323EndPoint::GetTimerService() const
+{
+  return H323TimerService::Current();
+}
+
+void H323EndPoint::SetChannelThreadPriority(ChannelThreadClass threadClass, PThread::Priority priority)
+{
+  if (threadClass < NumChannelThreadClasses)
+    channelClassPriority[threadClass] = priority;
+}
+
+PThread::Priority H323EndPoint::GetChannelThreadPriority(ChannelThreadClass threadClass) const
+{
+  return threadClass < NumChannelThreadClasses ? channelClassPriority[threadClass] : channelThreadPriority;
+}
+
+RTP_ReportScheduler * H323EndPoint::GetReportScheduler()
+{
+  PWaitAndSignal m(connectionsMutex);
+  if (!useReportScheduling)
+    return NULL;
+
+  if (reportScheduler == NULL)
+    reportScheduler = new RTP_ReportScheduler;
+
+  return reportScheduler;
+}
+
+OpalRFC2833Scheduler * H323EndPoint::GetRFC2833Scheduler()
+{
+  PWaitAndSignal m(connectionsMutex);
+  if (rfc2833Scheduler == NULL)
+    rfc2833Scheduler = new OpalRFC2833Scheduler;
+
+  return rfc2833Scheduler;
+}
+
+RTP_PortPool * H323EndPoint::GetRTPPortPool()
+{
+  PWaitAndSignal m(connectionsMutex);
+  if (rtpPortPoolSize == 0)
+    return NULL;
+
+  if (rtpPortPool == NULL)
+    rtpPortPool = new RTP_PortPool(*this, rtpPortPoolSize, rtpPortQuarantine);
+
+  return rtpPortPool;
+}
+
+H323MediaWatchdog * H323EndPoint::GetMediaWatchdog()
+{
+  PWaitAndSignal m(connectionsMutex);
+  if (mediaWatchdog == NULL)
+    mediaWatchdog = new H323MediaWatchdog(*this);
+
+  return mediaWatchdog;
+}
+
+void H323EndPoint::SetLockProfiling(PBoolean enable)
+{
+  if (enable == lockProfiling)
+    return;
+
+  lockProfiling = enable;
+  if (enable)
+    H323LockProfiler::Enable(metrics);
+  else
+    H323LockProfiler::Disable();
+}
+
+H323PeerLiveness * H323EndPoint::GetPeerLiveness()
+{
+  PWaitAndSignal m(connectionsMutex);
+  if (!roundTripDelayPerPeer)
+    return NULL;
+
+  if (peerLiveness == NULL)
+    peerLiveness = new H323PeerLiveness;
+
+  return peerLiveness;
+}
+
 #ifdef H323_RTP_AGGREGATE
 PHandleAggregator * H323EndPoint::GetRTPAggregator()
 {
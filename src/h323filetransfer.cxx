@@ -50,10 +50,21 @@
 
 #include <h323pdu.h>
 
+#include <vector>
+
 
 static const char * FileTransferOID = "1.3.6.1.4.1.17090.1.2";
 static const char * FileTransferListOID = "1.3.6.1.4.1.17090.1.2.1";
 
+/* Largest window, less than half the 99 block numbers so they are never ambiguous */
+#define FT_MAX_WINDOW 32
+
+/* Octets read from the file at a time in window mode */
+#define FT_READ_AHEAD 262144
+
+/* Retransmission timeouts in a row before a window transfer fails */
+#define FT_MAX_TIMEOUTS 10
+
 static struct  {
    int blocksize;
    int identifier;
@@ -897,6 +908,9 @@ H323FileTransferHandler::H323FileTransferHandler(H323Connection & connection,
   curProgSize = 0;
   rtpPayloadType = (RTP_DataFrame::PayloadTypes)101;
   responseTimeOut = 1500;
+  maxWindowSize = 16;
+  windowSize = 1;
+  ResetWindow();
 
   transmitRunning = FALSE;
   receiveRunning = FALSE;
@@ -970,6 +984,15 @@ void H323FileTransferHandler::SetMaxBlockRate(unsigned rate)
     msBetweenBlocks = (int)((1.000/((double)rate))*1000);
 }
 
+void H323FileTransferHandler::SetWindowSize(unsigned blocks)
+{
+    if (blocks < 1)
+        blocks = 1;
+    if (blocks > FT_MAX_WINDOW)
+        blocks = FT_MAX_WINDOW;
+    maxWindowSize = blocks;
+}
+
 void H323FileTransferHandler::ChangeState(transferState newState)
 {
    PWaitAndSignal m(stateMutex);
@@ -1046,6 +1069,348 @@ PBoolean Segment(PBYTEArray & lastBlock, const int size, int & segment, PBYTEArr
     return FALSE;
 }
 
+static int WireBlock(unsigned block)
+{
+    // Blocks are numbered 1-99 on the wire
+    return block == 0 ? 0 : (int)((block-1)%99)+1;
+}
+
+static unsigned AbsoluteBlock(int wire, unsigned reference)
+{
+    // The block with the wire number nearest to the reference
+    if (wire <= 0)
+        return 0;
+
+    unsigned shifted = reference + 99;
+    int diff = (wire - WireBlock(shifted) + 99) % 99;
+    if (diff > 49)
+        diff -= 99;
+
+    int block = (int)shifted + diff - 99;
+    return block > 0 ? (unsigned)block : 0;
+}
+
+PBoolean H323FileTransferHandler::TransmitBlock(H323FilePacket & block)
+{
+    if (blockSize <= H323FileTransferCapability::e_1428)
+        return TransmitFrame(block, TRUE);
+
+    int offset = 0;
+    PBoolean final = FALSE;
+    while (!final) {
+        H323FilePacket segment;
+        final = Segment(block, H323FileTransferCapability::e_1428, offset, segment);
+        if (!TransmitFrame(segment, final))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+void H323FileTransferHandler::ResetWindow()
+{
+    PWaitAndSignal m(windowMutex);
+
+    windowBlocks.clear();
+    windowBase = 1;
+    windowNext = 1;
+    windowLast = 0;
+    windowAcked = 0;
+    windowSACK = PString();
+    windowLoss = FALSE;
+    congestionWindow = 2;
+    congestionThreshold = maxWindowSize;
+    congestionCount = 0;
+    smoothedRTT = 0;
+    windowTimeouts = 0;
+    readAheadPos = 0;
+    readAheadLen = 0;
+    readAheadTotal = 0;
+    readAheadEnd = FALSE;
+    expectedBlock = 1;
+    windowPending.clear();
+    blocksSinceACK = 0;
+    windowACKDue = FALSE;
+    curProgSize = 0;
+}
+
+PBoolean H323FileTransferHandler::ReadWindowBlock(H323FilePacket & block)
+{
+    if (windowLast != 0 && windowNext > windowLast)
+        return FALSE;
+
+    if (readAhead.GetSize() == 0)
+        readAhead.SetSize(PMAX(FT_READ_AHEAD, (PINDEX)(2*blockSize*maxWindowSize)));
+
+    unsigned size = blockSize;
+    if (curFileSize - readAheadTotal < size)
+        size = curFileSize - readAheadTotal;
+
+    block.BuildData(WireBlock(windowNext), size);
+
+    // Blocks are cut from large reads of the file
+    unsigned got = 0;
+    while (got < size) {
+        if (readAheadPos >= readAheadLen) {
+            if (readAheadEnd || curFile == NULL)
+                break;
+            PINDEX len = readAhead.GetSize();
+            curFile->Read(readAhead.GetPointer(), len);
+            readAheadLen = len;
+            readAheadPos = 0;
+            if (len < readAhead.GetSize())
+                readAheadEnd = TRUE;
+            if (len == 0)
+                break;
+        }
+        unsigned count = PMIN((unsigned)(readAheadLen - readAheadPos), size - got);
+        memcpy(block.GetDataPtr() + got, readAhead.GetPointer() + readAheadPos, count);
+        readAheadPos += count;
+        got += count;
+    }
+
+    if (got < size) {
+        PTRACE(2, "FT\tFile " << curFileName << " shorter than " << curFileSize << " octets");
+        block.SetSize(4+got);
+    }
+
+    readAheadTotal += got;
+    if (readAheadTotal >= curFileSize || got < size)
+        windowLast = windowNext;
+
+    return TRUE;
+}
+
+PBoolean H323FileTransferHandler::TransmitWindow(PBoolean & done)
+{
+    PInt64 now = PTimer::Tick().GetMilliSeconds();
+    std::vector<H323FilePacket> retransmit;
+    std::vector<H323FilePacket> transmit;
+    unsigned acked = 0;
+    PInt64 timeout;
+    PINDEX gap;
+
+    windowMutex.Wait();
+
+    // Slide the window over the blocks acknowledged in order
+    while (!windowBlocks.empty() && windowBase <= windowAcked) {
+        WindowBlock & block = windowBlocks.front();
+        if (!block.retransmitted) {
+            PInt64 sample = now - block.sentTick;
+            smoothedRTT = smoothedRTT == 0 ? sample : (7*smoothedRTT + sample)/8;
+        }
+        curProgSize += block.size;
+        windowBlocks.pop_front();
+        windowBase++;
+        acked++;
+    }
+
+    // Then mark the ones acknowledged out of order
+    for (PINDEX i = 0; i < windowSACK.GetLength(); i++) {
+        size_t index = windowAcked + 2 + i - windowBase;
+        if (windowSACK[i] == 'y' && index < windowBlocks.size())
+            windowBlocks[index].acked = TRUE;
+    }
+
+    if (acked > 0) {
+        windowTimeouts = 0;
+        // Slow start up to the threshold, then one block per window
+        if (congestionWindow < congestionThreshold)
+            congestionWindow += acked;
+        else if ((congestionCount += acked) >= congestionWindow) {
+            congestionWindow++;
+            congestionCount = 0;
+        }
+        if (congestionWindow > windowSize)
+            congestionWindow = windowSize;
+    }
+
+    timeout = smoothedRTT == 0 ? responseTimeOut : PMIN(PMAX(2*smoothedRTT + 50, 200), 3000);
+
+    if (windowLoss) {
+        // Resend the gaps before the last block the receiver has, once
+        size_t last = 0;
+        for (size_t i = 0; i < windowBlocks.size(); i++) {
+            if (windowBlocks[i].acked)
+                last = i;
+        }
+        for (size_t i = 0; i < last; i++) {
+            WindowBlock & block = windowBlocks[i];
+            if (!block.acked && !block.retransmitted) {
+                block.retransmitted = TRUE;
+                block.sentTick = now;
+                retransmit.push_back(block.packet);
+            }
+        }
+        if (!retransmit.empty()) {
+            congestionThreshold = PMAX(congestionWindow/2, 2);
+            congestionWindow = congestionThreshold;
+            congestionCount = 0;
+            PTRACE(4, "FT\tResending " << retransmit.size() << " blocks, window " << congestionWindow);
+        }
+        windowLoss = FALSE;
+    }
+    else if (acked == 0 && !windowBlocks.empty() && now - windowBlocks.front().sentTick > timeout) {
+        if (++windowTimeouts > FT_MAX_TIMEOUTS) {
+            windowMutex.Signal();
+            PTRACE(2, "FT\tNo acknowledgement of block " << windowBase);
+            return FALSE;
+        }
+        WindowBlock & block = windowBlocks.front();
+        block.retransmitted = TRUE;
+        block.sentTick = now;
+        retransmit.push_back(block.packet);
+        congestionThreshold = PMAX(congestionWindow/2, 2);
+        congestionWindow = 2;
+        congestionCount = 0;
+        PTRACE(4, "FT\tTimeout on block " << windowBase << ", window " << congestionWindow);
+    }
+
+    // Fill the window with new blocks
+    while (windowBlocks.size() < congestionWindow) {
+        WindowBlock block;
+        if (!ReadWindowBlock(block.packet))
+            break;
+        block.size = block.packet.GetDataSize();
+        block.sentTick = now;
+        block.retransmitted = FALSE;
+        block.acked = FALSE;
+        windowBlocks.push_back(block);
+        windowNext++;
+        transmit.push_back(block.packet);
+    }
+
+    done = windowLast != 0 && windowBase > windowLast;
+
+    // Spread the window over the round trip rather than sending it in a burst
+    gap = msBetweenBlocks;
+    if (smoothedRTT > 0 && smoothedRTT/congestionWindow > gap)
+        gap = (PINDEX)(smoothedRTT/congestionWindow);
+
+    windowMutex.Signal();
+
+    if (acked > 0)
+        OnFileProgress(curFileName, WireBlock(windowBase-1), curProgSize, TRUE);
+
+    if (done)
+        return TRUE;
+
+    for (size_t i = 0; i < retransmit.size(); i++) {
+        if (!TransmitBlock(retransmit[i]))
+            return FALSE;
+    }
+
+    for (size_t i = 0; i < transmit.size(); i++) {
+        if (gap > 0)
+            sendwait.Delay(gap);
+        PTRACE(5,"FT\t" << DataPacketAnalysis(true,transmit[i],true));
+        if (!TransmitBlock(transmit[i]))
+            return FALSE;
+    }
+
+    nextFrame.Wait((PINDEX)timeout);
+    return TRUE;
+}
+
+void H323FileTransferHandler::OnWindowACK(const H323FilePacket & packet)
+{
+    PWaitAndSignal m(windowMutex);
+
+    unsigned acked = AbsoluteBlock(packet.GetACKBlockNo(), windowAcked);
+    if (acked < windowAcked || acked >= windowNext) {
+        PTRACE(6,"FT\tIgnoring ACK " << packet.GetACKBlockNo() << " outside window " << windowBase << '-' << windowNext);
+        return;
+    }
+
+    windowAcked = acked;
+    windowSACK = packet.GetSACK();
+    windowLoss = windowSACK.Find('y') != P_MAX_INDEX;
+}
+
+PBoolean H323FileTransferHandler::OnWindowData(H323FilePacket & packet)
+{
+    PBoolean written = FALSE;
+
+    {
+        PWaitAndSignal m(windowMutex);
+
+        unsigned block = AbsoluteBlock(packet.GetBlockNo(), expectedBlock);
+        unsigned offset = (block-1)*blockSize;
+        unsigned size = 0;
+        if (block > 0 && offset < curFileSize)
+            size = PMIN(blockSize, curFileSize - offset);
+
+        // Segments of a lost packet run into the next block so the size is wrong
+        if (block == 0 || (offset >= curFileSize && !(block == 1 && curFileSize == 0)) ||
+            packet.GetDataSize() != size) {
+            PTRACE(4,"FT\tDiscarded block " << packet.GetBlockNo() << " of " << packet.GetDataSize() << " octets");
+            windowACKDue = TRUE;
+            return TRUE;
+        }
+
+        if (block < expectedBlock || block >= expectedBlock + windowSize) {
+            // Already written, the acknowledgement was lost
+            windowACKDue = TRUE;
+            return TRUE;
+        }
+
+        if (block > expectedBlock) {
+            // Hold until the gap is filled, and report it at once
+            windowPending[block] = PBYTEArray(packet.GetDataPtr(), size);
+            windowACKDue = TRUE;
+            return TRUE;
+        }
+
+        curFile->Write(packet.GetDataPtr(), size);
+        curProgSize += size;
+        expectedBlock++;
+        blocksSinceACK++;
+
+        std::map<unsigned, PBYTEArray>::iterator it;
+        while ((it = windowPending.find(expectedBlock)) != windowPending.end()) {
+            curFile->Write((const BYTE *)it->second, it->second.GetSize());
+            curProgSize += it->second.GetSize();
+            windowPending.erase(it);
+            expectedBlock++;
+            blocksSinceACK++;
+        }
+
+        // Acknowledge twice a window
+        if (blocksSinceACK >= (windowSize+1)/2 || curProgSize >= curFileSize)
+            windowACKDue = TRUE;
+        written = TRUE;
+    }
+
+    if (written)
+        OnFileProgress(curFileName, packet.GetBlockNo(), curProgSize, FALSE);
+
+    return windowACKDue;
+}
+
+PBoolean H323FileTransferHandler::BuildWindowACK(H323FilePacket & packet, PBoolean & complete)
+{
+    PWaitAndSignal m(windowMutex);
+
+    complete = curProgSize >= curFileSize;
+    if (!windowACKDue && !complete)
+        return FALSE;
+
+    unsigned acked = expectedBlock-1;
+    if (complete)
+        acked = PMAX(1, (curFileSize + blockSize - 1)/blockSize);
+
+    PString received;
+    if (!windowPending.empty()) {
+        unsigned last = windowPending.rbegin()->first;
+        for (unsigned block = expectedBlock+1; block <= last; block++)
+            received += windowPending.find(block) != windowPending.end() ? 'y' : 'n';
+    }
+
+    packet.BuildSACK(WireBlock(acked), received);
+    windowACKDue = FALSE;
+    blocksSinceACK = 0;
+    return TRUE;
+}
+
 void H323FileTransferHandler::Transmit(PThread &, H323_INT)
 {
     PBoolean success = TRUE;
@@ -1115,6 +1480,7 @@ void H323FileTransferHandler::Transmit(PThread &, H323_INT)
                             curFileSize = f->m_Filesize;
                             delete curFile;
                             curFile = new H323FileIOChannel(p,read);
+                            ResetWindow();
                             if (curFile->IsError(ioerr)) {
                                 OnFileOpenError(p,ioerr);
                                 ChangeState(e_error);
@@ -1124,11 +1490,11 @@ void H323FileTransferHandler::Transmit(PThread &, H323_INT)
                         }
                      }
                      if (!read) {
-                       packet.BuildRequest(H323FilePacket::e_RRQ ,f->m_Filename, f->m_Filesize, blockSize);
+                       packet.BuildRequest(H323FilePacket::e_RRQ ,f->m_Filename, f->m_Filesize, blockSize, maxWindowSize);
                        final = TRUE;
                        waitforResponse = TRUE;
                      } else {
-                       packet.BuildRequest(H323FilePacket::e_WRQ ,f->m_Filename, f->m_Filesize, blockSize);
+                       packet.BuildRequest(H323FilePacket::e_WRQ ,f->m_Filename, f->m_Filesize, blockSize, maxWindowSize);
                        final = TRUE;
                        waitforResponse = TRUE;
                      }
@@ -1150,12 +1516,29 @@ void H323FileTransferHandler::Transmit(PThread &, H323_INT)
            case e_sending:
                // Signal we are ready to send file
                if (blockState == recReady) {
-                    packet.BuildACK(0,curFileSize);
+                    packet.BuildACK(0,curFileSize,windowSize);
                    final = TRUE;
                    SetBlockState(recOK);
                    break;
                }
 
+               if (windowSize > 1) {
+                   PBoolean done = FALSE;
+                   if (!TransmitWindow(done)) {
+                       OnFileError(curFileName, WireBlock(windowBase), TRUE);
+                       ChangeState(e_error);
+                   } else if (done) {
+                       OnFileComplete(curFileName);
+                       delete curFile;
+                       curFile = NULL;
+                       curFileName = PString();
+                       waitforResponse = FALSE;
+                       SetBlockState(recComplete);
+                       ChangeState(e_waiting);
+                   }
+                   continue;
+               }
+
                 if (blockState != recPartial) {
                     if (blockState == recOK) {
                         if (lastFrame) {
@@ -1211,11 +1594,38 @@ void H323FileTransferHandler::Transmit(PThread &, H323_INT)
            case e_receiving:
                // Signal we are ready to receive file.
                if (blockState == recReady) {
-                    packet.BuildACK(0);
+                    packet.BuildACK(0,0,windowSize);
                    final = TRUE;
                    SetBlockState(recOK);
                    break;
-               } else if (sentBlock == lastBlockNo) {
+               }
+
+               if (windowSize > 1) {
+                   PBoolean complete = FALSE;
+                   if (!BuildWindowACK(packet, complete)) {
+                       // Acknowledge again if nothing arrives, in case the last was lost
+                       if (!nextFrame.Wait(responseTimeOut/3)) {
+                           PWaitAndSignal m(windowMutex);
+                           windowACKDue = expectedBlock > 1 || !windowPending.empty();
+                       }
+                       continue;
+                   }
+                   final = TRUE;
+                   if (complete) {
+                       // Nothing confirms the last acknowledgement so send it three times
+                       TransmitFrame(packet, TRUE);
+                       TransmitFrame(packet, TRUE);
+                       SetBlockState(recComplete);
+                       lastBlockNo = 0;
+                       curProgSize = 0;
+                       curFile->Close();
+                       ChangeState(e_waiting);
+                       waitforResponse = FALSE;
+                   }
+                   break;
+               }
+
+               if (sentBlock == lastBlockNo) {
                    nextFrame.Wait(responseTimeOut);
                }
 
@@ -1348,6 +1758,7 @@ void H323FileTransferHandler::Receive(PThread &, H323_INT)
                    curFileName = packet.GetFileName();
                    curFileSize = packet.GetFileSize();
                    curBlockSize = packet.GetBlockSize();
+                   windowSize = PMAX(1, PMIN(packet.GetWindowSize(), maxWindowSize));
                    delete curFile;
                    curFile = new H323FileIOChannel(p, FALSE);
                    if (curFile->IsError(ioerr)) {
@@ -1355,12 +1766,14 @@ void H323FileTransferHandler::Receive(PThread &, H323_INT)
                         ChangeState(e_error);
                         break;
                    }
+                   ResetWindow();
                    SetBlockState(recReady);
                    ChangeState(e_receiving);
                    OnFileStart(p, curFileSize,FALSE);  // Notify to start receive
                    shutdownTimer.SetInterval(0);
                } else if (ptype == H323FilePacket::e_RRQ) {
                    p = filelist.GetSaveDirectory() + PDIR_SEPARATOR + packet.GetFileName();
+                   windowSize = PMAX(1, PMIN(packet.GetWindowSize(), maxWindowSize));
                    delete curFile;
                    curFile = new H323FileIOChannel(p,TRUE);
                    if (curFile->IsError(ioerr)) {
@@ -1369,12 +1782,14 @@ void H323FileTransferHandler::Receive(PThread &, H323_INT)
                         break;
                    }
                    curFileSize = curFile->GetFileSize();
+                   ResetWindow();
                    SetBlockState(recReady);
                    ChangeState(e_sending);
                    OnFileStart(p, curFileSize,TRUE);  // Notify to start send
                    shutdownTimer.SetInterval(0);
                } else if ((ptype == H323FilePacket::e_ACK) && (packet.GetACKBlockNo() == 0)) {
-                   // We have received acknowledgement
+                   // We have received acknowledgement, with the window if accepted
+                   windowSize = PMAX(1, PMIN(packet.GetWindowSize(), maxWindowSize));
                    int size = packet.GetFileSize();
                    if (size > 0) {
                         curFileSize = size;
@@ -1390,6 +1805,7 @@ void H323FileTransferHandler::Receive(PThread &, H323_INT)
                             ChangeState(e_error);
                             break;
                         }
+                       ResetWindow();
                        SetBlockState(recOK);
                        ChangeState(e_receiving);
                        OnFileStart(curFileName, curFileSize, false);  // Notify to start receive
@@ -1404,7 +1820,10 @@ void H323FileTransferHandler::Receive(PThread &, H323_INT)
 
                break;
            case e_receiving:
-               if (ptype == H323FilePacket::e_DATA) {
+               if (ptype == H323FilePacket::e_DATA && windowSize > 1) {
+                   if (OnWindowData(packet))
+                       nextFrame.Signal();
+               } else if (ptype == H323FilePacket::e_DATA) {
                    PBoolean OKtoWrite = FALSE;
                    int blockNo = 0;
                    if ((packet.GetDataSize() == blockSize) ||  // We have complete block
@@ -1446,7 +1865,9 @@ void H323FileTransferHandler::Receive(PThread &, H323_INT)
                if (ptype == H323FilePacket::e_ACK) {
                     if (packet.GetACKBlockNo() == 0)  // Control ACKs = 0 so ignore.
                         continue;
-                    if (packet.GetACKBlockNo() == lastBlockNo) {
+                    if (windowSize > 1)
+                        OnWindowACK(packet);
+                    else if (packet.GetACKBlockNo() == lastBlockNo) {
                         curProgSize = curProgSize + lastBlockSize;
                         OnFileProgress(curFileName, lastBlockNo, curProgSize, TRUE);
                         SetBlockState(recOK);
@@ -1497,11 +1918,15 @@ void H323FilePacket::BuildPROB()
   Attach(header,header.GetSize());
 }
 
-void H323FilePacket::BuildRequest(opcodes code, const PString & filename, int filesize, int blocksize)
+void H323FilePacket::BuildRequest(opcodes code, const PString & filename, int filesize, int blocksize, int windowsize)
 {
    PString fn = filename;
    fn.Replace("0","*",true);
-   PString header = opStr[code] + fn + "0octet0blksize0" + PString(blocksize)
+   // The window goes before blksize, where older versions do not look
+   PString window;
+   if (windowsize > 1)
+       window = "windowsize0" + PString(windowsize) + "0";
+   PString header = opStr[code] + fn + "0octet0" + window + "blksize0" + PString(blocksize)
                         + "0tsize0" + PString(filesize) + "0";
    attach(header);
 
@@ -1521,7 +1946,7 @@ void H323FilePacket::BuildData(int blockid, int size)
    memcpy(theArray, (const char *)data, data.GetSize());
 }
 
-void H323FilePacket::BuildACK(int blockid, int filesize)
+void H323FilePacket::BuildACK(int blockid, int filesize, int windowsize)
 {
    PString blkstr;
    if (blockid < 10)
@@ -1531,11 +1956,23 @@ void H323FilePacket::BuildACK(int blockid, int filesize)
 
    PString header = opStr[e_ACK] + blkstr;
 
+   if (windowsize > 1)
+       header = header + "0windowsize0" + PString(windowsize) + "0";
    if (filesize > 0)
        header = header + "0tsize0" + PString(filesize) + "0";
    attach(header);
 }
 
+void H323FilePacket::BuildSACK(int blockid, const PString & received)
+{
+   BuildACK(blockid);
+
+   if (!received.IsEmpty()) {
+       PString header = PString(theArray, GetSize()) + "0sack0" + received + "0";
+       attach(header);
+   }
+}
+
 void H323FilePacket::BuildError(int errorcode,PString errmsg)
 {
    PString blkerr;
@@ -1581,6 +2018,49 @@ unsigned H323FilePacket::GetFileSize() const
   return data.Mid(i,l).AsUnsigned();
 }
 
+unsigned H323FilePacket::GetWindowSize() const
+{
+  if ((GetPacketType() != e_RRQ) &&
+       (GetPacketType() != e_WRQ) &&
+       (GetPacketType() != e_ACK))
+          return 0;
+
+  PString data(theArray, GetSize());
+
+  PINDEX i = data.Find("windowsize0");
+  if (i == P_MAX_INDEX)
+      return 0;
+
+  // The digits run into the 0 separator after the value
+  i += 11;
+  PINDEX j = i;
+  while (j < data.GetLength() && isdigit(data[j]))
+      j++;
+  if (j - i < 2)
+      return 0;
+
+  return data.Mid(i, j-i-1).AsUnsigned();
+}
+
+PString H323FilePacket::GetSACK() const
+{
+  if (GetPacketType() != e_ACK)
+          return PString();
+
+  PString data(theArray, GetSize());
+
+  PINDEX i = data.Find("0sack0");
+  if (i == P_MAX_INDEX)
+      return PString();
+
+  i += 6;
+  PINDEX j = data.Find('0', i);
+  if (j == P_MAX_INDEX)
+      j = data.GetLength();
+
+  return data.Mid(i, j-i);
+}
+
 unsigned H323FilePacket::GetBlockSize() const
 {
   if ((GetPacketType() != e_RRQ) &&
@@ -0,0 +1,417 @@
+/*
+ * h323hottrace.cxx
+ *
+ * Binary event tracing for the media and signalling paths
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "h323hottrace.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#include "h323hottrace.h"
+
+#include <algorithm>
+#include <map>
+
+#if defined(_MSC_VER)
+#define H323_THREAD_LOCAL __declspec(thread)
+#else
+#define H323_THREAD_LOCAL __thread
+#endif
+
+#define new PNEW
+
+
+static const char HotTraceMagic[8] = { 'H', '3', '2', '3', 'H', 'T', '1', '\n' };
+
+static const char * const EventNames[H323HotTrace::NumEvents] = {
+  "RTPTransmitFrame",
+  "RTPReceiveFrame",
+  "RTPReadData",
+  "SignalPDU",
+  "JitterPlayout",
+  "JitterLate"
+};
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+struct HotTraceBuffer {
+  std::vector<H323HotTrace::Event> events;
+  DWORD              mask;
+  volatile DWORD     next;
+  volatile PUInt64   lastWrite;
+  PThreadIdentifier  owner;
+  DWORD              serial;
+};
+
+typedef std::map<DWORD, PString> NameMap;
+
+struct HotTraceState {
+  HotTraceState() : eventsPerThread(4096), maxThreads(256), lastSerial(0) { }
+
+  PMutex                     mutex;
+  std::vector<HotTraceBuffer *> buffers;
+  unsigned                   eventsPerThread;
+  unsigned                   maxThreads;
+  DWORD                      lastSerial;
+  NameMap                    callNames;
+  NameMap                    threadNames;
+};
+
+static HotTraceState & GetState()
+{
+  static HotTraceState state;
+  return state;
+}
+
+static H323_THREAD_LOCAL HotTraceBuffer * threadBuffer = NULL;
+
+
+static HotTraceBuffer * ClaimBuffer()
+{
+  HotTraceState & state = GetState();
+  PWaitAndSignal mutex(state.mutex);
+
+  HotTraceBuffer * buffer = NULL;
+  if (state.buffers.size() < state.maxThreads) {
+    buffer = new HotTraceBuffer;
+    unsigned size = 64;
+    while (size < state.eventsPerThread)
+      size <<= 1;
+    buffer->events.resize(size);
+    buffer->mask = size-1;
+    buffer->next = 0;
+    state.buffers.push_back(buffer);
+  }
+  else {
+    // Take over the buffer of the thread that recorded least recently,
+    // most likely one that has ended.
+    buffer = state.buffers[0];
+    for (size_t i = 1; i < state.buffers.size(); i++) {
+      if (state.buffers[i]->lastWrite < buffer->lastWrite)
+        buffer = state.buffers[i];
+    }
+  }
+
+  buffer->lastWrite = PTime().GetTimestamp();
+  buffer->serial = ++state.lastSerial;
+  buffer->owner = PThread::GetCurrentThreadId();
+  H323_MEMORY_BARRIER();
+
+  PThread * thread = PThread::Current();
+  state.threadNames[buffer->serial] = thread != NULL ? thread->GetThreadName() : PString(PString::Unsigned, buffer->serial);
+
+  return buffer;
+}
+
+
+static void WriteJSONString(ostream & strm, const PString & str)
+{
+  strm << '"';
+  for (PINDEX i = 0; i < str.GetLength(); i++) {
+    char c = str[i];
+    if (c == '"' || c == '\\')
+      strm << '\\' << c;
+    else if ((unsigned char)c < ' ')
+      strm << ' ';
+    else
+      strm << c;
+  }
+  strm << '"';
+}
+
+
+static void WriteTrace(ostream & strm,
+                       const std::vector<H323HotTrace::Event> & events,
+                       const NameMap & callNames,
+                       const NameMap & threadNames)
+{
+  strm << "{\"traceEvents\":[";
+
+  PBoolean first = TRUE;
+  for (NameMap::const_iterator it = threadNames.begin(); it != threadNames.end(); ++it) {
+    strm << (first ? "\n" : ",\n")
+         << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << it->first << ",\"args\":{\"name\":";
+    WriteJSONString(strm, it->second);
+    strm << "}}";
+    first = FALSE;
+  }
+
+  PUInt64 start = events.empty() ? 0 : events[0].time;
+  for (size_t i = 0; i < events.size(); i++) {
+    const H323HotTrace::Event & event = events[i];
+    static const char * const Phases[] = { "i\",\"s\":\"t", "B", "E" };
+
+    strm << (first ? "\n" : ",\n")
+         << "{\"name\":\"" << H323HotTrace::GetEventName(event.id)
+         << "\",\"cat\":\"h323\",\"ph\":\"" << Phases[event.phase < 3 ? event.phase : 0]
+         << "\",\"ts\":" << (event.time - start)
+         << ",\"pid\":1,\"tid\":" << event.thread
+         << ",\"args\":{\"arg\":" << event.arg;
+    if (event.tag != 0) {
+      strm << ",\"call\":";
+      NameMap::const_iterator name = callNames.find(event.tag);
+      if (name != callNames.end())
+        WriteJSONString(strm, name->second);
+      else
+        strm << event.tag;
+    }
+    strm << "}}";
+    first = FALSE;
+  }
+
+  strm << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+
+static bool EventBefore(const H323HotTrace::Event & a, const H323HotTrace::Event & b)
+{
+  return a.time < b.time;
+}
+
+
+static PBoolean WriteNames(PFile & file, const NameMap & names)
+{
+  DWORD count = (DWORD)names.size();
+  if (!file.Write(&count, sizeof(count)))
+    return FALSE;
+  for (NameMap::const_iterator it = names.begin(); it != names.end(); ++it) {
+    DWORD header[2] = { it->first, (DWORD)it->second.GetLength() };
+    if (!file.Write(header, sizeof(header)) || !file.Write((const char *)it->second, header[1]))
+      return FALSE;
+  }
+  return TRUE;
+}
+
+
+static PBoolean ReadNames(PFile & file, NameMap & names)
+{
+  DWORD count;
+  if (!file.Read(&count, sizeof(count)) || file.GetLastReadCount() != sizeof(count))
+    return FALSE;
+  while (count-- > 0) {
+    DWORD header[2];
+    if (!file.Read(header, sizeof(header)) || file.GetLastReadCount() != sizeof(header) || header[1] > 0xffff)
+      return FALSE;
+    PString name;
+    char * ptr = name.GetPointer(header[1]+1);
+    if (!file.Read(ptr, header[1]) || file.GetLastReadCount() != (PINDEX)header[1])
+      return FALSE;
+    ptr[header[1]] = '\0';
+    name.MakeMinimumSize();
+    names[header[0]] = name;
+  }
+  return TRUE;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+volatile PBoolean H323HotTrace::enabled = FALSE;
+volatile DWORD    H323HotTrace::filter = 0;
+
+
+void H323HotTrace::Enable(unsigned eventsPerThread, unsigned maxThreads)
+{
+  HotTraceState & state = GetState();
+  {
+    PWaitAndSignal mutex(state.mutex);
+    state.eventsPerThread = eventsPerThread > 0 ? eventsPerThread : 1;
+    state.maxThreads = maxThreads > 0 ? maxThreads : 1;
+  }
+
+  H323_MEMORY_BARRIER();
+  enabled = TRUE;
+  PTRACE(3, "HotTrace\tEnabled, " << eventsPerThread << " events for up to " << maxThreads << " threads");
+}
+
+
+void H323HotTrace::Disable()
+{
+  enabled = FALSE;
+  H323_MEMORY_BARRIER();
+  PTRACE(3, "HotTrace\tDisabled");
+}
+
+
+void H323HotTrace::Clear()
+{
+  HotTraceState & state = GetState();
+  PWaitAndSignal mutex(state.mutex);
+
+  for (size_t i = 0; i < state.buffers.size(); i++)
+    state.buffers[i]->next = 0;
+  state.callNames.clear();
+}
+
+
+void H323HotTrace::SetFilter(DWORD tag)
+{
+  filter = tag;
+  H323_MEMORY_BARRIER();
+}
+
+
+void H323HotTrace::NameCall(DWORD tag, const PString & token)
+{
+  if (!enabled || tag == 0)
+    return;
+
+  HotTraceState & state = GetState();
+  PWaitAndSignal mutex(state.mutex);
+  PString & name = state.callNames[tag];
+  name = token;
+  name.MakeUnique();
+}
+
+
+void H323HotTrace::Write(EventId id, DWORD tag, DWORD arg, Phase phase)
+{
+  HotTraceBuffer * buffer = threadBuffer;
+  if (buffer == NULL || buffer->owner != PThread::GetCurrentThreadId())
+    threadBuffer = buffer = ClaimBuffer();
+
+  PUInt64 now = PTime().GetTimestamp();
+
+  DWORD next = buffer->next;
+  Event & event = buffer->events[next & buffer->mask];
+  event.time = now;
+  event.tag = tag;
+  event.arg = arg;
+  event.thread = buffer->serial;
+  event.id = (WORD)id;
+  event.phase = (WORD)phase;
+
+  buffer->next = next+1;
+  buffer->lastWrite = now;
+}
+
+
+void H323HotTrace::GetEvents(std::vector<Event> & events)
+{
+  events.clear();
+
+  HotTraceState & state = GetState();
+  PWaitAndSignal mutex(state.mutex);
+
+  for (size_t i = 0; i < state.buffers.size(); i++) {
+    const HotTraceBuffer & buffer = *state.buffers[i];
+    DWORD next = buffer.next;
+    DWORD count = next < buffer.events.size() ? next : (DWORD)buffer.events.size();
+    for (DWORD n = next - count; n != next; n++)
+      events.push_back(buffer.events[n & buffer.mask]);
+  }
+
+  std::stable_sort(events.begin(), events.end(), EventBefore);
+}
+
+
+PBoolean H323HotTrace::Save(const PFilePath & filename)
+{
+  std::vector<Event> events;
+  GetEvents(events);
+
+  NameMap callNames, threadNames;
+  {
+    HotTraceState & state = GetState();
+    PWaitAndSignal mutex(state.mutex);
+    callNames = state.callNames;
+    threadNames = state.threadNames;
+  }
+
+  PFile file(filename, PFile::WriteOnly);
+  if (!file.IsOpen()) {
+    PTRACE(2, "HotTrace\tCould not create " << filename << ": " << file.GetErrorText());
+    return FALSE;
+  }
+
+  DWORD count = (DWORD)events.size();
+  if (!file.Write(HotTraceMagic, sizeof(HotTraceMagic)) ||
+      !file.Write(&count, sizeof(count)) ||
+      (count > 0 && !file.Write(&events[0], count*sizeof(Event))) ||
+      !WriteNames(file, callNames) ||
+      !WriteNames(file, threadNames)) {
+    PTRACE(2, "HotTrace\tCould not write " << filename << ": " << file.GetErrorText());
+    return FALSE;
+  }
+
+  PTRACE(3, "HotTrace\tSaved " << count << " events to " << filename);
+  return TRUE;
+}
+
+
+PBoolean H323HotTrace::ConvertToChromeTrace(const PFilePath & filename, ostream & strm)
+{
+  PFile file(filename, PFile::ReadOnly);
+  if (!file.IsOpen())
+    return FALSE;
+
+  char magic[sizeof(HotTraceMagic)];
+  DWORD count;
+  if (!file.Read(magic, sizeof(magic)) || memcmp(magic, HotTraceMagic, sizeof(magic)) != 0 ||
+      !file.Read(&count, sizeof(count)) || file.GetLastReadCount() != sizeof(count)) {
+    PTRACE(2, "HotTrace\tFile " << filename << " is not a saved trace");
+    return FALSE;
+  }
+
+  std::vector<Event> events(count);
+  if (count > 0 && (!file.Read(&events[0], count*sizeof(Event)) ||
+                    file.GetLastReadCount() != (PINDEX)(count*sizeof(Event))))
+    return FALSE;
+
+  NameMap callNames, threadNames;
+  if (!ReadNames(file, callNames) || !ReadNames(file, threadNames))
+    return FALSE;
+
+  WriteTrace(strm, events, callNames, threadNames);
+  return TRUE;
+}
+
+
+void H323HotTrace::WriteChromeTrace(ostream & strm)
+{
+  std::vector<Event> events;
+  GetEvents(events);
+
+  HotTraceState & state = GetState();
+  PWaitAndSignal mutex(state.mutex);
+  WriteTrace(strm, events, state.callNames, state.threadNames);
+}
+
+
+const char * H323HotTrace::GetEventName(unsigned id)
+{
+  return id < NumEvents ? EventNames[id] : "Unknown";
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
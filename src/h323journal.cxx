@@ -0,0 +1,342 @@
+/*
+ * h323journal.cxx
+ *
+ * Asynchronous journal of call records
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "h323journal.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#include "h323journal.h"
+#include "h323con.h"
+#include "h323metrics.h"
+
+#include <vector>
+
+#define new PNEW
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+void H323CallRecord::Clear()
+{
+  memset(this, 0, sizeof(*this));
+}
+
+
+void H323CallRecord::SetField(char * field, PINDEX size, const PString & value)
+{
+  PINDEX len = PMIN(value.GetLength(), size-1);
+  memcpy(field, (const char *)value, len);
+  field[len] = '\0';
+}
+
+
+PInt64 H323CallRecord::GetTimestamp(const PTime & time)
+{
+  return time.IsValid() && time.GetTimeInSeconds() > 0 ? time.GetTimestamp() : 0;
+}
+
+
+static void PrintTime(ostream & strm, PInt64 time)
+{
+  if (time == 0)
+    strm << '-';
+  else
+    strm << PTime((time_t)(time/1000000), (long)(time%1000000)).AsString(PTime::LongISO8601, PTime::UTC);
+}
+
+
+static void PrintField(ostream & strm, const char * field)
+{
+  strm << '\t';
+  if (*field == '\0')
+    strm << '-';
+  else
+    strm << field;
+}
+
+
+void H323CallRecord::PrintOn(ostream & strm) const
+{
+  strm << (source == e_Gatekeeper ? 'G' : 'E') << '\t'
+       << (originating ? "out" : "in") << '\t';
+
+  for (PINDEX i = 0; i < (PINDEX)sizeof(callIdentifier); i++)
+    strm << hex << setfill('0') << setw(2) << (unsigned)callIdentifier[i];
+  strm << dec << setfill(' ') << '\t';
+
+  PrintTime(strm, setupTime);
+  strm << '\t';
+  PrintTime(strm, connectTime);
+  strm << '\t';
+  PrintTime(strm, endTime);
+  strm << '\t' << (H323Connection::CallEndReason)endReason;
+
+  PrintField(strm, callingAlias);
+  PrintField(strm, calledAlias);
+  PrintField(strm, remoteAddress);
+  PrintField(strm, audioCodec);
+  PrintField(strm, videoCodec);
+
+  strm << '\t' << packetsSent
+       << '\t' << packetsReceived
+       << '\t' << packetsLost
+       << '\t' << jitter
+       << '\t' << bandwidth;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323CallJournal::H323CallJournal(PINDEX size, PINDEX batch)
+  : batchSize(batch > 0 ? batch : 1),
+    enqueuePos(0),
+    dequeuePos(0),
+    channel(NULL),
+    autoDeleteChannel(FALSE),
+    flushInterval(0, 1),
+    thread(NULL),
+    running(FALSE),
+    metrics(NULL),
+    queued(0),
+    written(0),
+    dropped(0),
+    writeFailures(0)
+{
+  unsigned count = 2;
+  while ((PINDEX)count < size && count < 0x40000000)
+    count <<= 1;
+  mask = count-1;
+
+  slots = new Slot[count];
+  for (unsigned i = 0; i < count; i++)
+    slots[i].sequence = i;
+}
+
+
+H323CallJournal::~H323CallJournal()
+{
+  Close();
+  delete [] slots;
+}
+
+
+PBoolean H323CallJournal::Open(const PFilePath & filename)
+{
+  PTextFile * file = new PTextFile;
+  if (!file->Open(filename, PFile::WriteOnly, PFile::Create) || !file->SetPosition(0, PFile::End)) {
+    PTRACE(1, "H323\tCould not open call journal " << filename << ": " << file->GetErrorText());
+    delete file;
+    return FALSE;
+  }
+
+  return Open(file, TRUE);
+}
+
+
+PBoolean H323CallJournal::Open(PChannel * newChannel, PBoolean autoDelete)
+{
+  Close();
+
+  channel = newChannel;
+  autoDeleteChannel = autoDelete;
+  return StartThread();
+}
+
+
+PBoolean H323CallJournal::Open()
+{
+  Close();
+  return StartThread();
+}
+
+
+PBoolean H323CallJournal::StartThread()
+{
+  running = TRUE;
+  thread = PThread::Create(PCREATE_NOTIFIER(WriterMain), 0,
+                           PThread::NoAutoDeleteThread,
+                           PThread::LowPriority,
+                           "CallJournal");
+
+  PTRACE(3, "H323\tCall journal started, " << mask+1 << " records queued at most");
+  return TRUE;
+}
+
+
+void H323CallJournal::Close()
+{
+  if (thread != NULL) {
+    running = FALSE;
+    wakeUp.Signal();
+    PAssert(thread->WaitForTermination(10000), "Call journal writer did not terminate");
+    delete thread;
+    thread = NULL;
+  }
+
+  if (channel != NULL) {
+    if (autoDeleteChannel)
+      delete channel;
+    channel = NULL;
+  }
+}
+
+
+void H323CallJournal::SetMetrics(H323EndPointMetrics * newMetrics)
+{
+  metrics = newMetrics;
+  if (metrics != NULL)
+    metrics->journalQueued.Set(queued);
+}
+
+
+PBoolean H323CallJournal::Record(const H323CallRecord & record)
+{
+  if (!running)
+    return FALSE;
+
+  // Bounded queue after Dmitry Vyukov, each slot's sequence says whose turn it is
+  Slot * slot;
+  unsigned pos = enqueuePos;
+  for (;;) {
+    slot = &slots[pos & mask];
+    unsigned sequence = slot->sequence;
+    H323_MEMORY_BARRIER();
+    int diff = (int)(sequence - pos);
+    if (diff == 0) {
+      unsigned previous = H323_ATOMIC_CAS32(&enqueuePos, pos, pos+1);
+      if (previous == pos)
+        break;
+      pos = previous;
+    }
+    else if (diff < 0) {
+      // Full, the writer is behind, the caller must not wait for it
+      H323_ATOMIC_ADD64(&dropped, 1);
+      if (metrics != NULL)
+        metrics->journalDropped.Add();
+      return FALSE;
+    }
+    else
+      pos = enqueuePos;
+  }
+
+  slot->record = record;
+  H323_MEMORY_BARRIER();
+  slot->sequence = pos+1;
+
+  if (metrics != NULL)
+    metrics->journalQueued.Add(1);
+
+  // Wake the writer once a batch is ready, otherwise it flushes on its interval
+  if (H323_ATOMIC_ADD64(&queued, 1) == batchSize-1)
+    wakeUp.Signal();
+
+  return TRUE;
+}
+
+
+PBoolean H323CallJournal::Dequeue(H323CallRecord & record)
+{
+  Slot & slot = slots[dequeuePos & mask];
+  if (slot.sequence != dequeuePos+1)
+    return FALSE;
+
+  H323_MEMORY_BARRIER();
+  record = slot.record;
+  H323_MEMORY_BARRIER();
+  slot.sequence = dequeuePos + mask + 1;
+  dequeuePos++;
+  return TRUE;
+}
+
+
+PBoolean H323CallJournal::OnWriteBatch(const H323CallRecord * records, PINDEX count)
+{
+  if (channel == NULL)
+    return TRUE;
+
+  PStringStream text;
+  for (PINDEX i = 0; i < count; i++)
+    text << records[i] << '\n';
+
+  return channel->WriteString(text);
+}
+
+
+void H323CallJournal::Drain(H323CallRecord * batch)
+{
+  for (;;) {
+    PINDEX count = 0;
+    while (count < batchSize && Dequeue(batch[count]))
+      count++;
+    if (count == 0)
+      return;
+
+    H323_ATOMIC_ADD64(&queued, -count);
+    if (metrics != NULL)
+      metrics->journalQueued.Add(-count);
+
+    if (OnWriteBatch(batch, count)) {
+      H323_ATOMIC_ADD64(&written, count);
+      if (metrics != NULL)
+        metrics->journalRecords.Add(count);
+    }
+    else {
+      PTRACE(2, "H323\tCall journal could not write " << count << " records");
+      H323_ATOMIC_ADD64(&writeFailures, 1);
+      if (metrics != NULL)
+        metrics->journalWriteFailures.Add();
+    }
+
+    if (count < batchSize)
+      return;
+  }
+}
+
+
+void H323CallJournal::WriterMain(PThread &, H323_INT)
+{
+  std::vector<H323CallRecord> batch(batchSize);
+
+  while (running) {
+    wakeUp.Wait(flushInterval);
+    Drain(&batch[0]);
+  }
+
+  // Whatever was recorded before Close() is still written
+  Drain(&batch[0]);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
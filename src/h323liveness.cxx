@@ -0,0 +1,133 @@
+/*
+ * h323liveness.cxx
+ *
+ * Round trip delay liveness shared by the calls to one peer
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "h323liveness.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#include "h323liveness.h"
+
+#define new PNEW
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323PeerLiveness::H323PeerLiveness()
+  : probeCount(0),
+    vouchedCount(0)
+{
+}
+
+
+void H323PeerLiveness::AddCall(const PString & peer)
+{
+  PWaitAndSignal m(mutex);
+  peers[peer].calls++;
+}
+
+
+void H323PeerLiveness::RemoveCall(const PString & peer, const PString & token)
+{
+  PWaitAndSignal m(mutex);
+
+  std::map<PString, Peer>::iterator it = peers.find(peer);
+  if (it == peers.end())
+    return;
+
+  // Let another call take over a probe this one had outstanding
+  if (it->second.prober == token)
+    it->second.prober = PString::Empty();
+
+  if (--it->second.calls <= 0)
+    peers.erase(it);
+}
+
+
+PBoolean H323PeerLiveness::StartProbe(const PString & peer, const PString & token, PInt64 now, PInt64 interval)
+{
+  PWaitAndSignal m(mutex);
+
+  std::map<PString, Peer>::iterator it = peers.find(peer);
+  if (it == peers.end())
+    return TRUE;
+
+  Peer & state = it->second;
+
+  if (!state.failed) {
+    if (state.lastAlive != 0 && now - state.lastAlive < interval) {
+      vouchedCount++;
+      return FALSE;
+    }
+
+    // A probe by another call still has time to be answered
+    if (!state.prober.IsEmpty() && state.prober != token && now - state.probeStart < interval) {
+      vouchedCount++;
+      return FALSE;
+    }
+
+    state.prober = token;
+    state.probeStart = now;
+  }
+
+  probeCount++;
+  return TRUE;
+}
+
+
+void H323PeerLiveness::OnProbeResult(const PString & peer, const PString & token, PBoolean alive, PInt64 now)
+{
+  PWaitAndSignal m(mutex);
+
+  std::map<PString, Peer>::iterator it = peers.find(peer);
+  if (it == peers.end())
+    return;
+
+  Peer & state = it->second;
+
+  if (state.prober == token)
+    state.prober = PString::Empty();
+
+  if (alive) {
+    PTRACE_IF(3, state.failed, "H245\tPeer " << peer << " answered round trip delay, probes shared again");
+    state.lastAlive = now;
+    state.failed = FALSE;
+  }
+  else {
+    PTRACE_IF(3, !state.failed, "H245\tPeer " << peer << " did not answer round trip delay, calls probe separately");
+    state.failed = TRUE;
+  }
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,342 @@
+/*
+ * h323lockprof.cxx
+ *
+ * Contention profiling of the library mutexes
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "h323lockprof.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#include "h323lockprof.h"
+#include "h323metrics.h"
+
+#include <map>
+
+#define new PNEW
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+/**Statistics of all the mutexes with one name. Updated by many threads
+   holding different mutexes of that name, so with atomic operations.
+  */
+class H323LockStats
+{
+  public:
+    enum {
+      NumBuckets = 22     ///< Waits up to 1us, 2us ... 2^20us, then longer
+    };
+
+    H323LockStats(const PString & name);
+
+    void OnAcquired(PInt64 waited, void * site);
+    void OnReleased(PInt64 held, void * site);
+    void Register(H323MetricsRegistry & registry);
+    void PrintOn(ostream & strm) const;
+
+  protected:
+    static void RaiseMax(volatile unsigned & max, void * volatile & maxSite, PInt64 value, void * site);
+
+    PString           name;
+    volatile PInt64   acquisitions;
+    volatile PInt64   contended;
+    volatile PInt64   waitTime;
+    volatile PInt64   buckets[NumBuckets];
+    volatile unsigned maxWait;
+    void * volatile   maxWaitSite;
+    volatile unsigned maxHold;
+    void * volatile   maxHoldSite;
+};
+
+
+/**Metric reading a value of the lock statistics, which outlive it.
+  */
+class H323LockMetric : public H323Metric
+{
+  PCLASSINFO(H323LockMetric, H323Metric);
+
+  public:
+    H323LockMetric(Type type, const PString & name, const PString & help, const PString & labels,
+                   const volatile PInt64 & value)
+      : H323Metric(type, name, help, labels), value64(&value), value32(NULL) { }
+
+    H323LockMetric(Type type, const PString & name, const PString & help, const PString & labels,
+                   const volatile unsigned & value)
+      : H323Metric(type, name, help, labels), value64(NULL), value32(&value) { }
+
+    virtual PInt64 GetValue() const
+    {
+      return value64 != NULL ? *value64 : (PInt64)*value32;
+    }
+
+  protected:
+    const volatile PInt64   * value64;
+    const volatile unsigned * value32;
+};
+
+
+H323LockStats::H323LockStats(const PString & lockName)
+  : name(lockName),
+    acquisitions(0),
+    contended(0),
+    waitTime(0),
+    maxWait(0),
+    maxWaitSite(NULL),
+    maxHold(0),
+    maxHoldSite(NULL)
+{
+  for (PINDEX i = 0; i < NumBuckets; i++)
+    buckets[i] = 0;
+}
+
+
+void H323LockStats::RaiseMax(volatile unsigned & max, void * volatile & maxSite, PInt64 value, void * site)
+{
+  unsigned newMax = value < 0xffffffff ? (unsigned)value : 0xffffffff;
+  unsigned oldMax = max;
+  while (newMax > oldMax) {
+    unsigned previous = H323_ATOMIC_CAS32(&max, oldMax, newMax);
+    if (previous == oldMax) {
+      maxSite = site;
+      return;
+    }
+    oldMax = previous;
+  }
+}
+
+
+void H323LockStats::OnAcquired(PInt64 waited, void * site)
+{
+  H323_ATOMIC_ADD64(&acquisitions, 1);
+  if (waited < 0)
+    return;
+
+  H323_ATOMIC_ADD64(&contended, 1);
+  H323_ATOMIC_ADD64(&waitTime, waited);
+
+  PINDEX bucket = 0;
+  while (bucket < NumBuckets-1 && waited > ((PInt64)1 << bucket))
+    bucket++;
+  H323_ATOMIC_ADD64(&buckets[bucket], 1);
+
+  RaiseMax(maxWait, maxWaitSite, waited, site);
+}
+
+
+void H323LockStats::OnReleased(PInt64 held, void * site)
+{
+  RaiseMax(maxHold, maxHoldSite, held, site);
+}
+
+
+void H323LockStats::Register(H323MetricsRegistry & registry)
+{
+  PString label = "mutex=\"" + name + '"';
+
+  registry.AddMetric(new H323LockMetric(H323Metric::e_Counter, "h323_lock_acquisitions_total",
+                                        "Acquisitions of the mutex", label, acquisitions));
+  registry.AddMetric(new H323LockMetric(H323Metric::e_Counter, "h323_lock_contended_total",
+                                        "Acquisitions of the mutex that had to wait", label, contended));
+  registry.AddMetric(new H323LockMetric(H323Metric::e_Counter, "h323_lock_wait_microseconds_total",
+                                        "Time spent waiting for the mutex", label, waitTime));
+  registry.AddMetric(new H323LockMetric(H323Metric::e_Gauge, "h323_lock_hold_max_microseconds",
+                                        "Longest time the mutex was held", label, maxHold));
+
+  for (PINDEX i = 0; i < NumBuckets; i++) {
+    PString bound = i < NumBuckets-1 ? PString(PString::Unsigned, 1 << i) : PString("+Inf");
+    registry.AddMetric(new H323LockMetric(H323Metric::e_Counter, "h323_lock_waits_total",
+                                          "Waits for the mutex up to the bucket bound in microseconds",
+                                          label + ",bucket=\"" + bound + '"', buckets[i]));
+  }
+}
+
+
+void H323LockStats::PrintOn(ostream & strm) const
+{
+  strm << name << ": acquired=" << acquisitions
+       << " contended=" << contended
+       << " wait=" << waitTime << "us"
+       << " maxWait=" << maxWait << "us at " << maxWaitSite
+       << " maxHold=" << maxHold << "us at " << maxHoldSite
+       << '\n';
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+volatile PBoolean H323LockProfiler::enabled = FALSE;
+
+typedef std::map<PString, H323LockStats *> H323LockStatsMap;
+
+static PMutex & GetProfilerMutex()
+{
+  static PMutex mutex;
+  return mutex;
+}
+
+static H323LockStatsMap & GetStatsMap()
+{
+  static H323LockStatsMap statsMap;
+  return statsMap;
+}
+
+static H323MetricsRegistry * profilerRegistry = NULL;
+
+
+void H323LockProfiler::Enable(H323MetricsRegistry & registry)
+{
+  PWaitAndSignal m(GetProfilerMutex());
+
+  profilerRegistry = &registry;
+  H323LockStatsMap & statsMap = GetStatsMap();
+  for (H323LockStatsMap::iterator it = statsMap.begin(); it != statsMap.end(); ++it)
+    it->second->Register(registry);
+
+  enabled = TRUE;
+  PTRACE(3, "H323\tLock profiling enabled");
+}
+
+
+void H323LockProfiler::Disable()
+{
+  PWaitAndSignal m(GetProfilerMutex());
+
+  enabled = FALSE;
+  profilerRegistry = NULL;
+  PTRACE(3, "H323\tLock profiling disabled");
+}
+
+
+void H323LockProfiler::PrintReport(ostream & strm)
+{
+  PWaitAndSignal m(GetProfilerMutex());
+
+  H323LockStatsMap & statsMap = GetStatsMap();
+  for (H323LockStatsMap::const_iterator it = statsMap.begin(); it != statsMap.end(); ++it)
+    it->second->PrintOn(strm);
+}
+
+
+H323LockStats * H323LockProfiler::GetStats(const char * name)
+{
+  PWaitAndSignal m(GetProfilerMutex());
+
+  H323LockStats * & stats = GetStatsMap()[name];
+  if (stats == NULL) {
+    // Never deleted, mutexes and metrics keep pointers to it
+    stats = new H323LockStats(name);
+    if (profilerRegistry != NULL)
+      stats->Register(*profilerRegistry);
+  }
+  return stats;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323ProfiledMutex::H323ProfiledMutex(const char * mutexName)
+  : name(mutexName),
+    stats(NULL),
+    holdDepth(0),
+    holdStart(0),
+    holdSite(NULL)
+{
+}
+
+
+void H323ProfiledMutex::Wait()
+{
+  if (!H323LockProfiler::IsEnabled()) {
+    PTimedMutex::Wait();
+    return;
+  }
+
+  void * site = H323_RETURN_ADDRESS();
+
+  PInt64 waitStart = 0;
+  if (!PTimedMutex::Wait(0)) {
+    waitStart = H323MediaClock::GetMicroseconds();
+    PTimedMutex::Wait();
+  }
+
+  OnAcquired(waitStart, site);
+}
+
+
+PBoolean H323ProfiledMutex::Wait(const PTimeInterval & timeout)
+{
+  if (!H323LockProfiler::IsEnabled())
+    return PTimedMutex::Wait(timeout);
+
+  void * site = H323_RETURN_ADDRESS();
+
+  PInt64 waitStart = 0;
+  if (!PTimedMutex::Wait(0)) {
+    if (timeout == 0)
+      return FALSE;
+    waitStart = H323MediaClock::GetMicroseconds();
+    if (!PTimedMutex::Wait(timeout))
+      return FALSE;
+  }
+
+  OnAcquired(waitStart, site);
+  return TRUE;
+}
+
+
+void H323ProfiledMutex::Signal()
+{
+  // Counted from the outermost profiled Wait(), also if disabled since
+  if (holdDepth > 0 && --holdDepth == 0 && stats != NULL)
+    stats->OnReleased(H323MediaClock::GetMicroseconds() - holdStart, holdSite);
+
+  PTimedMutex::Signal();
+}
+
+
+void H323ProfiledMutex::OnAcquired(PInt64 waitStart, void * site)
+{
+  PInt64 now = H323MediaClock::GetMicroseconds();
+
+  if (stats == NULL)
+    stats = H323LockProfiler::GetStats(name);
+
+  stats->OnAcquired(waitStart != 0 ? now - waitStart : -1, site);
+
+  if (holdDepth++ == 0) {
+    holdStart = now;
+    holdSite = site;
+  }
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
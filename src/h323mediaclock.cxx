@@ -0,0 +1,104 @@
+/*
+ * h323mediaclock.cxx
+ *
+ * Monotonic clock for media timing
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "h323mediaclock.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#include "h323mediaclock.h"
+
+#if defined(__APPLE__)
+#include <mach/mach_time.h>
+#elif !defined(_WIN32)
+#include <time.h>
+#endif
+
+#define new PNEW
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+#if defined(_WIN32)
+
+PInt64 H323MediaClock::GetMicroseconds()
+{
+  // Racing threads all find the same answer
+  static LONGLONG frequency = 0;
+  if (frequency == 0) {
+    LARGE_INTEGER f;
+    QueryPerformanceFrequency(&f);
+    frequency = f.QuadPart;
+  }
+
+  LARGE_INTEGER count;
+  QueryPerformanceCounter(&count);
+
+  // In two parts so the count times a million cannot overflow
+  return count.QuadPart/frequency*1000000 + count.QuadPart%frequency*1000000/frequency;
+}
+
+#elif defined(__APPLE__)
+
+PInt64 H323MediaClock::GetMicroseconds()
+{
+  // Racing threads all find the same answer
+  static mach_timebase_info_data_t timebase = { 0, 0 };
+  if (timebase.denom == 0)
+    mach_timebase_info(&timebase);
+
+  return (PInt64)(mach_absolute_time()*timebase.numer/timebase.denom/1000);
+}
+
+#elif defined(CLOCK_MONOTONIC)
+
+PInt64 H323MediaClock::GetMicroseconds()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (PInt64)now.tv_sec*1000000 + now.tv_nsec/1000;
+}
+
+#else
+
+PInt64 H323MediaClock::GetMicroseconds()
+{
+  // No monotonic clock finer than the timer tick
+  return PTimer::Tick().GetMilliSeconds()*1000;
+}
+
+#endif
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,190 @@
+/*
+ * h323mediawatch.cxx
+ *
+ * Detection of calls whose media has stopped
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "h323mediawatch.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#include "h323mediawatch.h"
+#include "h323ep.h"
+
+#include <vector>
+
+#define new PNEW
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323MediaActivity::H323MediaActivity(const PString & token, const PTimeInterval & interval)
+  : callToken(token),
+    timeout((DWORD)interval.GetMilliSeconds()),
+    running(0),
+    waiting(0),
+    lastMedia(0)
+{
+}
+
+
+PBoolean H323MediaActivity::IsSilent(DWORD now) const
+{
+  if (running <= 0 || waiting > 0)
+    return FALSE;
+
+  H323_MEMORY_BARRIER();
+
+  // Unsigned difference so the tick wrapping every 49 days does not matter
+  return (DWORD)(now - lastMedia) >= timeout;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+class H323MediaWatchdog::Thread : public PThread
+{
+    PCLASSINFO(Thread, PThread);
+  public:
+    Thread(H323MediaWatchdog & _watchdog)
+      : PThread(10000, NoAutoDeleteThread, NormalPriority, "Media Watchdog"),
+        watchdog(_watchdog)
+    {
+      Resume();
+    }
+
+    void Main()
+    {
+      watchdog.Main();
+    }
+
+  protected:
+    H323MediaWatchdog & watchdog;
+};
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323MediaWatchdog::H323MediaWatchdog(H323EndPoint & ep, const PTimeInterval & interval)
+  : endpoint(ep),
+    scanInterval(interval),
+    clearedCount(0),
+    shutdown(FALSE)
+{
+  thread = new Thread(*this);
+
+  PTRACE(3, "H323\tMedia watchdog started, scanning every " << scanInterval);
+}
+
+
+H323MediaWatchdog::~H323MediaWatchdog()
+{
+  mutex.Wait();
+  shutdown = TRUE;
+  mutex.Signal();
+
+  wakeUp.Signal();
+  thread->WaitForTermination();
+  delete thread;
+
+  PAssert(calls.empty(), "Media watchdog deleted with calls");
+
+  PTRACE(3, "H323\tMedia watchdog ended, " << clearedCount << " calls cleared");
+}
+
+
+H323MediaActivity * H323MediaWatchdog::Register(const PString & token, const PTimeInterval & timeout)
+{
+  H323MediaActivity * activity = new H323MediaActivity(token, timeout);
+
+  PWaitAndSignal m(mutex);
+  calls.insert(activity);
+
+  PTRACE(4, "H323\tMedia watchdog watching " << token << ", timeout " << timeout);
+  return activity;
+}
+
+
+void H323MediaWatchdog::Unregister(H323MediaActivity * activity)
+{
+  if (activity == NULL)
+    return;
+
+  mutex.Wait();
+  calls.erase(activity);
+  mutex.Signal();
+
+  delete activity;
+}
+
+
+void H323MediaWatchdog::Main()
+{
+  PTRACE(4, "H323\tMedia watchdog thread started");
+
+  std::vector<PString> silent;
+
+  for (;;) {
+    silent.clear();
+
+    mutex.Wait();
+
+    if (shutdown) {
+      mutex.Signal();
+      break;
+    }
+
+    DWORD now = (DWORD)PTimer::Tick().GetMilliSeconds();
+    for (std::set<H323MediaActivity *>::iterator it = calls.begin(); it != calls.end(); ++it) {
+      if ((*it)->IsSilent(now)) {
+        silent.push_back((*it)->GetCallToken());
+        // Not cleared twice while the call is being cleaned up
+        (*it)->timeout = 0xffffffff;
+      }
+    }
+
+    mutex.Signal();
+
+    // Calls are cleared without the lock as clearing waits on the connection
+    for (size_t i = 0; i < silent.size(); i++) {
+      PTRACE(2, "H323\tNo media on call " << silent[i] << ", clearing");
+      if (endpoint.ClearCall(silent[i], H323Connection::EndedByTransportFail))
+        clearedCount++;
+    }
+
+    wakeUp.Wait(scanInterval);
+  }
+
+  PTRACE(4, "H323\tMedia watchdog thread ended");
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
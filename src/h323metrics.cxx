@@ -0,0 +1,379 @@
+/*
+ * h323metrics.cxx
+ *
+ * Endpoint metrics registry and exporters
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "h323metrics.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#include "h323metrics.h"
+
+#define new PNEW
+
+
+// Largest StatsD datagram, fits an Ethernet MTU with IPv6 and UDP headers
+#define STATSD_MAX_DATAGRAM 1432
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323Metric::H323Metric(Type t, const PString & n, const PString & h, const PString & l)
+  : type(t),
+    name(n),
+    help(h),
+    labels(l)
+{
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323MetricCounter::H323MetricCounter(const PString & name, const PString & help, const PString & labels)
+  : H323Metric(e_Counter, name, help, labels)
+{
+  for (PINDEX i = 0; i < NumShards; i++)
+    shards[i].value = 0;
+}
+
+
+PInt64 H323MetricCounter::GetValue() const
+{
+  PInt64 total = 0;
+  for (PINDEX i = 0; i < NumShards; i++)
+    total += shards[i].value;
+  return total;
+}
+
+
+unsigned H323MetricCounter::GetShard()
+{
+  // Thread identifiers are often stack addresses with the same low bits,
+  // so mix them all into the top bits.
+  PUInt64 id = (PUInt64)PThread::GetCurrentThreadId();
+  id *= PUInt64(0x9E3779B97F4A7C15ULL);
+  return (unsigned)(id >> 60) & (NumShards-1);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323MetricGauge::H323MetricGauge(const PString & name, const PString & help, const PString & labels)
+  : H323Metric(e_Gauge, name, help, labels),
+    value(0)
+{
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323MetricsRegistry::H323MetricsRegistry()
+{
+  exportTimer.SetNotifier(PCREATE_NOTIFIER(OnExportTimer));
+}
+
+
+H323MetricsRegistry::~H323MetricsRegistry()
+{
+  exportTimer.Stop();
+
+  exportMutex.Wait();
+  for (size_t i = 0; i < exporters.size(); i++)
+    delete exporters[i];
+  exporters.clear();
+  exportMutex.Signal();
+
+  for (MetricMap::iterator it = metrics.begin(); it != metrics.end(); ++it)
+    delete it->second;
+}
+
+
+H323Metric * H323MetricsRegistry::FindMetric(const PString & key) const
+{
+  MetricMap::const_iterator it = metrics.find(key);
+  return it != metrics.end() ? it->second : NULL;
+}
+
+
+H323MetricCounter & H323MetricsRegistry::GetCounter(const PString & name, const PString & help, const PString & labels)
+{
+  PString key = name + '{' + labels + '}';
+
+  PWaitAndSignal mutex(metricsMutex);
+
+  H323Metric * metric = FindMetric(key);
+  if (metric == NULL) {
+    metric = new H323MetricCounter(name, help, labels);
+    metrics[key] = metric;
+  }
+
+  PAssert(metric->GetType() == H323Metric::e_Counter, "Metric " + name + " is not a counter");
+  return *(H323MetricCounter *)metric;
+}
+
+
+H323MetricGauge & H323MetricsRegistry::GetGauge(const PString & name, const PString & help, const PString & labels)
+{
+  PString key = name + '{' + labels + '}';
+
+  PWaitAndSignal mutex(metricsMutex);
+
+  H323Metric * metric = FindMetric(key);
+  if (metric == NULL) {
+    metric = new H323MetricGauge(name, help, labels);
+    metrics[key] = metric;
+  }
+
+  PAssert(metric->GetType() == H323Metric::e_Gauge, "Metric " + name + " is not a gauge");
+  return *(H323MetricGauge *)metric;
+}
+
+
+PBoolean H323MetricsRegistry::AddMetric(H323Metric * metric)
+{
+  PString key = metric->GetName() + '{' + metric->GetLabels() + '}';
+
+  PWaitAndSignal mutex(metricsMutex);
+
+  if (FindMetric(key) != NULL) {
+    delete metric;
+    return FALSE;
+  }
+
+  metrics[key] = metric;
+  return TRUE;
+}
+
+
+void H323MetricsRegistry::GetValues(H323MetricValueList & values) const
+{
+  PWaitAndSignal mutex(metricsMutex);
+
+  values.resize(metrics.size());
+  size_t i = 0;
+  for (MetricMap::const_iterator it = metrics.begin(); it != metrics.end(); ++it, ++i) {
+    H323MetricValue & value = values[i];
+    value.type = it->second->GetType();
+    value.name = it->second->GetName();
+    value.help = it->second->GetHelp();
+    value.labels = it->second->GetLabels();
+    value.value = it->second->GetValue();
+  }
+}
+
+
+void H323MetricsRegistry::AddExporter(H323MetricsExporter * exporter)
+{
+  if (exporter == NULL)
+    return;
+
+  PWaitAndSignal mutex(exportMutex);
+  exporters.push_back(exporter);
+}
+
+
+void H323MetricsRegistry::SetExportInterval(const PTimeInterval & interval)
+{
+  if (interval > 0)
+    exportTimer.RunContinuous(interval);
+  else
+    exportTimer.Stop();
+}
+
+
+void H323MetricsRegistry::Export()
+{
+  H323MetricValueList values;
+  GetValues(values);
+
+  PWaitAndSignal mutex(exportMutex);
+  for (size_t i = 0; i < exporters.size(); i++)
+    exporters[i]->Export(values);
+}
+
+
+void H323MetricsRegistry::OnExportTimer(PTimer &, H323_INT)
+{
+  Export();
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323EndPointMetrics::H323EndPointMetrics()
+  : callsTotal(GetCounter("h323_calls_total", "Calls created")),
+    callsActive(GetGauge("h323_calls_active", "Calls in progress")),
+    connectionBytes(GetGauge("h323_connection_bytes", "Memory held by connection objects, their protocol procedures and supplementary services")),
+    callsCleaning(GetGauge("h323_calls_cleaning", "Cleared calls waiting for or in clean up")),
+    callsCleanedTotal(GetCounter("h323_calls_cleaned_total", "Cleared calls cleaned up and deleted")),
+    callCleanUpTime(GetCounter("h323_call_cleanup_milliseconds_total", "Time spent cleaning up cleared calls")),
+    signalPDUsReceived(GetCounter("h323_signal_pdus_received_total", "H.225 call signalling PDUs received")),
+    tlsHandshakes(GetCounter("h323_tls_handshakes_total", "Signalling TLS handshakes completed")),
+    tlsHandshakesResumed(GetCounter("h323_tls_handshakes_resumed_total", "Signalling TLS handshakes that resumed a session")),
+    tlsHandshakeTime(GetCounter("h323_tls_handshake_milliseconds_total", "Time spent in signalling TLS handshakes")),
+    rtpPacketsSent(GetCounter("h323_rtp_packets_sent_total", "RTP packets sent")),
+    rtpOctetsSent(GetCounter("h323_rtp_octets_sent_total", "RTP payload octets sent")),
+    rtpPacketsReceived(GetCounter("h323_rtp_packets_received_total", "RTP packets received")),
+    rtpOctetsReceived(GetCounter("h323_rtp_octets_received_total", "RTP payload octets received")),
+    rtpPacketsLost(GetCounter("h323_rtp_packets_lost_total", "RTP packets lost, counted as each channel ends")),
+    rtpPacketsTooLate(GetCounter("h323_rtp_packets_too_late_total", "RTP packets too late for the jitter buffer, counted as each channel ends")),
+    rtpBufferOverruns(GetCounter("h323_rtp_jitter_overruns_total", "Jitter buffer overruns, counted as each channel ends")),
+    rtpPacketsRecovered(GetCounter("h323_rtp_packets_recovered_total", "RTP packets recovered from redundant copies, counted as each channel ends")),
+    gkRegistrationsTotal(GetCounter("h323_gk_registrations_total", "Gatekeeper endpoint registrations")),
+    gkRegistrations(GetGauge("h323_gk_registrations", "Endpoints registered with the gatekeeper")),
+    gkCallsTotal(GetCounter("h323_gk_calls_total", "Calls admitted by the gatekeeper")),
+    gkCalls(GetGauge("h323_gk_calls", "Calls in progress through the gatekeeper")),
+    transactionsQueued(GetGauge("h323_transactions_queued", "RAS and H.501 requests waiting for a worker thread")),
+    transactionsShed(GetCounter("h323_transactions_shed_total", "RAS and H.501 requests turned away by overload control")),
+    transactionsDelayed(GetCounter("h323_transactions_delayed_total", "Queued requests sent a RequestInProgress")),
+    transactionQueueTime(GetCounter("h323_transaction_queue_milliseconds_total", "Time requests waited for a worker thread")),
+    outgoingCallsQueued(GetGauge("h323_outgoing_calls_queued", "Outgoing calls waiting for a thread of the call pool")),
+    outgoingCallsRejected(GetCounter("h323_outgoing_calls_rejected_total", "Outgoing calls refused as the call pool queue was full")),
+    outgoingCallQueueTime(GetCounter("h323_outgoing_call_queue_milliseconds_total", "Time outgoing calls waited for a thread of the call pool")),
+    journalRecords(GetCounter("h323_journal_records_total", "Call records written by the call journal")),
+    journalDropped(GetCounter("h323_journal_dropped_total", "Call records dropped as the call journal queue was full")),
+    journalWriteFailures(GetCounter("h323_journal_write_failures_total", "Batches of call records the call journal could not write")),
+    journalQueued(GetGauge("h323_journal_queued", "Call records waiting to be written by the call journal"))
+{
+}
+
+
+void H323EndPointMetrics::OnCallEnded(const PString & reason)
+{
+  GetCounter("h323_calls_ended_total", "Calls ended, by reason", "reason=\"" + reason + '"').Add();
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+void H323PrometheusExporter::Export(const H323MetricValueList & values)
+{
+  PStringStream strm;
+  Format(strm, values);
+
+  PWaitAndSignal mutex(textMutex);
+  text = strm;
+}
+
+
+PString H323PrometheusExporter::GetText() const
+{
+  PWaitAndSignal mutex(textMutex);
+  PString s = text;
+  s.MakeUnique();
+  return s;
+}
+
+
+void H323PrometheusExporter::Format(ostream & strm, const H323MetricValueList & values)
+{
+  // Values are sorted by name, so each family is together
+  for (size_t i = 0; i < values.size(); i++) {
+    const H323MetricValue & value = values[i];
+    if (i == 0 || value.name != values[i-1].name) {
+      strm << "# HELP " << value.name << ' ' << value.help << '\n'
+           << "# TYPE " << value.name << (value.type == H323Metric::e_Counter ? " counter" : " gauge") << '\n';
+    }
+    strm << value.name;
+    if (!value.labels)
+      strm << '{' << value.labels << '}';
+    strm << ' ' << value.value << '\n';
+  }
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323StatsDExporter::H323StatsDExporter(const PIPSocket::Address & addr, WORD p, const PString & pre)
+  : address(addr),
+    port(p),
+    prefix(pre)
+{
+}
+
+
+void H323StatsDExporter::Export(const H323MetricValueList & values)
+{
+  PString lines;
+
+  for (size_t i = 0; i < values.size(); i++) {
+    const H323MetricValue & value = values[i];
+
+    // Label values become name components, reason="x" is .x
+    PString name = prefix.IsEmpty() ? value.name : (prefix + '.' + value.name);
+    PINDEX quote = 0;
+    while ((quote = value.labels.Find('"', quote)) != P_MAX_INDEX) {
+      PINDEX end = value.labels.Find('"', quote+1);
+      if (end == P_MAX_INDEX)
+        break;
+      name += '.' + value.labels(quote+1, end-1);
+      quote = end+1;
+    }
+
+    PStringStream line;
+    if (value.type == H323Metric::e_Counter) {
+      PString key = value.name + '{' + value.labels + '}';
+      PInt64 delta = value.value - lastCounts[key];
+      lastCounts[key] = value.value;
+      if (delta == 0)
+        continue;
+      line << name << ':' << delta << "|c\n";
+    }
+    else
+      line << name << ':' << value.value << "|g\n";
+
+    if (lines.GetLength() + line.GetLength() > STATSD_MAX_DATAGRAM) {
+      Send(lines);
+      lines = PString::Empty();
+    }
+    lines += line;
+  }
+
+  if (!lines)
+    Send(lines);
+}
+
+
+void H323StatsDExporter::Send(const PString & lines)
+{
+  if (!socket.IsOpen() && !socket.Listen(PIPSocket::Address::GetAny(address.GetVersion()))) {
+    PTRACE(2, "Metrics\tCould not open StatsD socket: " << socket.GetErrorText());
+    return;
+  }
+
+  if (!socket.WriteTo((const char *)lines, lines.GetLength(), address, port)) {
+    PTRACE(3, "Metrics\tStatsD send to " << address << ':' << port << " failed: " << socket.GetErrorText());
+  }
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,286 @@
+/*
+ * h323natcache.cxx
+ *
+ * Cache of NAT discovery results
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "h323natcache.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#ifdef P_STUN
+
+#include "h323ep.h"
+#include "h323natcache.h"
+
+#include <ptclib/pstun.h>
+
+#define new PNEW
+
+/* Time after a failed background refresh before it is tried again (ms) */
+#define NATCACHE_RETRY_TIME 10000
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+class H323NatDiscoveryCache::Thread : public PThread
+{
+    PCLASSINFO(Thread, PThread);
+  public:
+    Thread(H323NatDiscoveryCache & c)
+      : PThread(10000, NoAutoDeleteThread, LowPriority, "NAT Discovery"),
+        cache(c)
+    {
+      Resume();
+    }
+
+    void Main()
+    {
+      cache.Main();
+    }
+
+  protected:
+    H323NatDiscoveryCache & cache;
+};
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323NatDiscoveryCache::H323NatDiscoveryCache(H323EndPoint & ep, const PTimeInterval & ttl)
+  : endpoint(ep),
+    timeToLive(ttl),
+    shutdown(FALSE)
+{
+  thread = new Thread(*this);
+
+  PTRACE(3, "NATCache\tCreated NAT discovery cache, time to live " << timeToLive);
+}
+
+
+H323NatDiscoveryCache::~H323NatDiscoveryCache()
+{
+  mutex.Wait();
+  shutdown = TRUE;
+  mutex.Signal();
+
+  wakeUp.Signal();
+  thread->WaitForTermination();
+  delete thread;
+
+  PTRACE(3, "NATCache\tDeleted NAT discovery cache");
+}
+
+
+PString H323NatDiscoveryCache::GetMethodKey(const PNatMethod & method)
+{
+#if PTLIB_VER >= 2130
+  return method.GetMethodName();
+#else
+  return method.GetName();
+#endif
+}
+
+
+PBoolean H323NatDiscoveryCache::GetExternalAddress(PNatMethod & method, PIPSocket::Address & address)
+{
+  PString key = GetMethodKey(method);
+
+  int natType;
+  if (GetResult(key, natType, address))
+    return TRUE;
+
+  // Not known yet, find it now and keep it fresh from then on
+  if (!method.GetExternalAddress(address))
+    return FALSE;
+
+  SetResult(key, -1, address, TRUE);
+  return TRUE;
+}
+
+
+PBoolean H323NatDiscoveryCache::GetResult(const PString & key, int & natType, PIPSocket::Address & address)
+{
+  PWaitAndSignal m(mutex);
+
+  EntryMap::const_iterator it = entries.find(key);
+  if (it == entries.end())
+    return FALSE;
+
+  if (PTimer::Tick().GetMilliSeconds() - it->second.discovered >= timeToLive.GetMilliSeconds()) {
+    PTRACE(4, "NATCache\tResult for " << key << " expired");
+    return FALSE;
+  }
+
+  natType = it->second.natType;
+  address = it->second.address;
+  return TRUE;
+}
+
+
+void H323NatDiscoveryCache::SetResult(const PString & key, int natType, const PIPSocket::Address & address, PBoolean refresh)
+{
+  PWaitAndSignal m(mutex);
+
+  PInt64 now = PTimer::Tick().GetMilliSeconds();
+
+  EntryMap::iterator it = entries.find(key);
+  if (it == entries.end()) {
+    it = entries.insert(EntryMap::value_type(key, Entry())).first;
+    it->second.natType = -1;
+    it->second.refresh = FALSE;
+  }
+
+  Entry & entry = it->second;
+  if (natType >= 0)
+    entry.natType = natType;
+  entry.address = address;
+  entry.discovered = now;
+  entry.refresh = entry.refresh || refresh;
+  entry.refreshTime = now + timeToLive.GetMilliSeconds()*3/4;
+
+  PTRACE(4, "NATCache\tResult for " << key << " is " << address
+         << (entry.natType >= 0 ? psprintf(" NAT type %i", entry.natType) : PString()));
+
+  // The thread may be waiting for a later refresh
+  if (entry.refresh)
+    wakeUp.Signal();
+}
+
+
+void H323NatDiscoveryCache::Invalidate(const PString & key)
+{
+  PWaitAndSignal m(mutex);
+  entries.erase(key);
+}
+
+
+void H323NatDiscoveryCache::InvalidateAll()
+{
+  PWaitAndSignal m(mutex);
+  entries.clear();
+}
+
+
+void H323NatDiscoveryCache::Refresh(const PString & key, PBoolean withType)
+{
+  PIPSocket::Address address;
+  int natType = -1;
+  PBoolean found = FALSE;
+
+  PNatMethod * method = endpoint.GetNatMethods().GetMethodByName(key);
+  if (method != NULL) {
+    // Round trips made here, not by a call
+    found = method->GetExternalAddress(address, 0);
+    if (found && withType && key == "STUN")
+      natType = ((PSTUNClient *)method)->GetNatType(TRUE);
+  }
+
+  PWaitAndSignal m(mutex);
+
+  EntryMap::iterator it = entries.find(key);
+  if (it == entries.end())
+    return;
+
+  if (method == NULL) {
+    PTRACE(4, "NATCache\tNAT method " << key << " removed");
+    entries.erase(it);
+    return;
+  }
+
+  if (!found) {
+    PTRACE(3, "NATCache\tCould not refresh " << key);
+    it->second.refreshTime = PTimer::Tick().GetMilliSeconds() + NATCACHE_RETRY_TIME;
+    return;
+  }
+
+  PInt64 now = PTimer::Tick().GetMilliSeconds();
+  PTRACE_IF(2, it->second.address != address, "NATCache\tExternal address of " << key
+            << " changed from " << it->second.address << " to " << address);
+  if (natType >= 0)
+    it->second.natType = natType;
+  it->second.address = address;
+  it->second.discovered = now;
+  it->second.refreshTime = now + timeToLive.GetMilliSeconds()*3/4;
+}
+
+
+void H323NatDiscoveryCache::Main()
+{
+  PTRACE(4, "NATCache\tRefresh thread started");
+
+  for (;;) {
+    PInt64 now = PTimer::Tick().GetMilliSeconds();
+    PInt64 next = -1;
+    PString due;
+    PBoolean withType = FALSE;
+
+    mutex.Wait();
+
+    if (shutdown) {
+      mutex.Signal();
+      break;
+    }
+
+    for (EntryMap::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+      if (!it->second.refresh)
+        continue;
+      if (it->second.refreshTime <= now) {
+        due = it->first;
+        withType = it->second.natType >= 0;
+        break;
+      }
+      if (next < 0 || it->second.refreshTime < next)
+        next = it->second.refreshTime;
+    }
+
+    mutex.Signal();
+
+    // One at a time with the lock released, the round trips may take seconds
+    if (!due.IsEmpty()) {
+      Refresh(due, withType);
+      continue;
+    }
+
+    if (next < 0)
+      wakeUp.Wait();
+    else if (next > now)
+      wakeUp.Wait(PTimeInterval(next - now));
+  }
+
+  PTRACE(4, "NATCache\tRefresh thread ended");
+}
+
+
+#endif // P_STUN
+
+
+/////////////////////////////////////////////////////////////////////////////
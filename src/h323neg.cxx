@@ -56,7 +56,7 @@ H245Negotiator::H245Negotiator(H323EndPoint & end, H323Connection & conn)
 }
 
 
-void H245Negotiator::HandleTimeout(PTimer &, H323_INT)
+void H245Negotiator::HandleTimeout(H323Timer &, H323_INT)
 {
 }
 
@@ -183,6 +183,7 @@ PBoolean H245NegMasterSlaveDetermination::HandleIncoming(const H245_MasterSlaveD
     reply.BuildMasterSlaveDeterminationAck(newStatus == e_DeterminedMaster);
     state = e_Incoming;
     status = newStatus;
+    connection.MarkCallTiming(H323CallTimeline::e_MasterSlaveDone);
   }
   else if (state == e_Outgoing) {
     retryCount++;
@@ -237,6 +238,8 @@ PBoolean H245NegMasterSlaveDetermination::HandleAck(const H245_MasterSlaveDeterm
     return connection.OnControlProtocolError(H323Connection::e_MasterSlaveDetermination,
                                              "Master/Slave mismatch");
 
+  connection.MarkCallTiming(H323CallTimeline::e_MasterSlaveDone);
+
   return TRUE;
 }
 
@@ -289,7 +292,7 @@ PBoolean H245NegMasterSlaveDetermination::HandleRelease(const H245_MasterSlaveDe
 }
 
 
-void H245NegMasterSlaveDetermination::HandleTimeout(PTimer &, INT)
+void H245NegMasterSlaveDetermination::HandleTimeout(H323Timer &, INT)
 {
   PWaitAndSignal wait(mutex);
 
@@ -355,8 +358,15 @@ PBoolean H245NegTerminalCapabilitySet::Start(PBoolean renegotiate, PBoolean empt
 
   PTRACE(3, "H245\tSending TerminalCapabilitySet: outSeq=" << outSequenceNumber);
 
+  // Connections sharing the endpoint capabilities send the same set
+  PBYTEArray encoded;
+  if (!empty && endpoint.GetCapabilitySetMemo(connection, outSequenceNumber, encoded))
+    return connection.WriteEncodedControlPDU(encoded);
+
   H323ControlPDU pdu;
   connection.OnSendCapabilitySet(pdu.BuildTerminalCapabilitySet(connection, outSequenceNumber, empty));
+  if (!empty)
+    endpoint.SetCapabilitySetMemo(connection, pdu);
   return connection.WriteControlPDU(pdu);
 }
 
@@ -399,20 +409,31 @@ PBoolean H245NegTerminalCapabilitySet::HandleIncoming(const H245_TerminalCapabil
   // give application a chance to inspect / modify received H.245 capabilities
   connection.OnReceivedCapabilitySet(pdu);
 
-#ifdef H323_H235
-  H235Capabilities remoteCapabilities(connection, pdu);
-#else
-  H323Capabilities remoteCapabilities(connection, pdu);
-#endif
-
   const H245_MultiplexCapability * muxCap = NULL;
   if (pdu.HasOptionalField(H245_TerminalCapabilitySet::e_multiplexCapability))
     muxCap = &pdu.m_multiplexCapability;
 
   H323ControlPDU reject;
-  if (connection.OnReceivedCapabilitySet(remoteCapabilities, muxCap,
-                    reject.BuildTerminalCapabilitySetReject(inSequenceNumber,
-                            H245_TerminalCapabilitySetReject_cause::e_unspecified))) {
+  H245_TerminalCapabilitySetReject & rejectPDU = reject.BuildTerminalCapabilitySetReject(inSequenceNumber,
+                            H245_TerminalCapabilitySetReject_cause::e_unspecified);
+
+  // A set the endpoint has decoded before is used as it is
+  PBoolean accepted;
+  H323CapabilityMemo * memo = connection.GetEndPoint().GetCapabilityMemo(connection, pdu);
+  if (memo != NULL) {
+    accepted = connection.OnReceivedCapabilitySet(*memo, muxCap, rejectPDU);
+    H323Capabilities::ReleaseSnapshot(memo);
+  }
+  else {
+#ifdef H323_H235
+    H235Capabilities remoteCapabilities(connection, pdu);
+#else
+    H323Capabilities remoteCapabilities(connection, pdu);
+#endif
+    accepted = connection.OnReceivedCapabilitySet(remoteCapabilities, muxCap, rejectPDU);
+  }
+
+  if (accepted) {
     receivedCapabilites = TRUE;
     H323ControlPDU ack;
     ack.BuildTerminalCapabilitySetAck(inSequenceNumber);
@@ -444,6 +465,7 @@ PBoolean H245NegTerminalCapabilitySet::HandleAck(const H245_TerminalCapabilitySe
   replyTimer.Stop();
   state = e_Sent;
   PTRACE(2, "H245\tTerminalCapabilitySet Sent.");
+  connection.MarkCallTiming(H323CallTimeline::e_CapabilityExchangeDone);
   return TRUE;
 }
 
@@ -484,7 +506,7 @@ PBoolean H245NegTerminalCapabilitySet::HandleRelease(const H245_TerminalCapabili
 }
 
 
-void H245NegTerminalCapabilitySet::HandleTimeout(PTimer &, INT)
+void H245NegTerminalCapabilitySet::HandleTimeout(H323Timer &, INT)
 {
   replyTimer.Stop();
   PWaitAndSignal wait(mutex);
@@ -772,6 +794,9 @@ PBoolean H245NegLogicalChannel::HandleOpenAck(const H245_OpenLogicalChannelAck &
       if (!channel->OnReceivedAckPDU(pdu))
         return CloseWhileLocked();
 
+      connection.MarkCallTiming(H323CallTimeline::e_FirstChannelOpened);
+      connection.AddCallTimingEvent("OpenLogicalChannelAck " + channel->GetCapability().GetFormatName());
+
       // If extended Video channel, then send Channel Active
       if (channel->GetCapability().GetMainType() == H323Capability::e_Video &&
 		 channel->GetCapability().GetSubType() == H245_VideoCapability::e_extendedVideoCapability) {
@@ -988,7 +1013,7 @@ PBoolean H245NegLogicalChannel::HandleRequestCloseRelease(const H245_RequestChan
 }
 
 
-void H245NegLogicalChannel::HandleTimeout(PTimer &, INT)
+void H245NegLogicalChannel::HandleTimeout(H323Timer &, INT)
 {
   mutex.Wait();
 
@@ -1310,11 +1335,31 @@ H323Channel * H245NegLogicalChannels::FindChannelBySession(unsigned rtpSessionId
 }
 
 
-void H245NegLogicalChannels::RemoveAll()
+void H245NegLogicalChannels::StartTerminationAll()
 {
   PWaitAndSignal wait(mutex);
 
   for (PINDEX i = 0; i < channels.GetSize(); i++) {
+    H245NegLogicalChannel & neg = channels.GetDataAt(i);
+    neg.mutex.Wait();
+    H323Channel * channel = neg.GetChannel();
+    if (channel != NULL)
+      channel->StartTermination();
+    neg.mutex.Signal();
+  }
+}
+
+
+void H245NegLogicalChannels::RemoveAll()
+{
+  PWaitAndSignal wait(mutex);
+
+  // Break every channel out of its I/O first, so waiting for the threads of
+  // one channel does not hold up the shutdown of the others.
+  StartTerminationAll();
+
+  PINDEX i;
+  for (i = 0; i < channels.GetSize(); i++) {
     H245NegLogicalChannel & neg = channels.GetDataAt(i);
     neg.mutex.Wait();
     H323Channel * channel = neg.GetChannel();
@@ -1468,7 +1513,7 @@ PBoolean H245NegRequestMode::HandleRelease(const H245_RequestModeRelease & /*pdu
 }
 
 
-void H245NegRequestMode::HandleTimeout(PTimer &, INT)
+void H245NegRequestMode::HandleTimeout(H323Timer &, INT)
 {
   PTRACE(3, "H245\tTimeout on request mode: outSeq=" << outSequenceNumber
          << (awaitingResponse ? " awaitingResponse" : " idle"));
@@ -1548,21 +1593,25 @@ PBoolean H245NegRoundTripDelay::HandleResponse(const H245_RoundTripDelayResponse
     awaitingResponse = FALSE;
     roundTripTime = tripEndTime - tripStartTime;
     retryCount = 3;
+    connection.OnRoundTripDelayResult(TRUE);
   }
 
   return TRUE;
 }
 
 
-void H245NegRoundTripDelay::HandleTimeout(PTimer &, INT)
+void H245NegRoundTripDelay::HandleTimeout(H323Timer &, INT)
 {
   PWaitAndSignal wait(mutex);
 
   PTRACE(3, "H245\tTimeout on round trip delay: seq=" << sequenceNumber
          << (awaitingResponse ? " awaitingResponse" : " idle"));
 
-  if (awaitingResponse && retryCount > 0)
-    retryCount--;
+  if (awaitingResponse) {
+    if (retryCount > 0)
+      retryCount--;
+    connection.OnRoundTripDelayResult(FALSE);
+  }
   awaitingResponse = FALSE;
 
   connection.OnControlProtocolError(H323Connection::e_RoundTripDelay, "Timeout");
@@ -722,7 +722,10 @@ void H323SignalPDU::LoadTunneledQ931(const Q931 & q931)
 {
   SetQ931(q931);
 
-  PPER_Stream strm = q931pdu.GetIE(Q931::UserUserIE);
+  const BYTE * userUser;
+  PINDEX userUserLength;
+  q931pdu.GetIE(Q931::UserUserIE, userUser, userUserLength);
+  H323_PERStream strm(userUser, userUserLength);
   if (!Decode(strm)) {
     PTRACE(1, "H225\tRead error: PER decode failure in Q.931 User-User Information Element,");
     m_h323_uu_pdu.m_h323_message_body.SetTag(H225_H323_UU_PDU_h323_message_body::e_empty);
@@ -1182,7 +1185,7 @@ H225_Notify_UUIE & H323SignalPDU::BuildNotify(const H323Connection & connection)
 void H323SignalPDU::BuildQ931()
 {
   // Encode the H225 PDu into the Q931 PDU as User-User data
-  PPER_Stream strm;
+  H323_PERStream strm;
   Encode(strm);
   strm.CompleteEncoding();
   q931pdu.SetIE(Q931::UserUserIE, strm);
@@ -1238,6 +1241,10 @@ PBoolean H323SignalPDU::ProcessReadData(H323Transport & transport, const PBYTEAr
     return FALSE;
   }
 
+  // Shares the buffer, kept for validating integrity tokens over the
+  // message as it was received
+  rawPDU = rawData;
+
   if (!q931pdu.HasIE(Q931::UserUserIE)) {
     m_h323_uu_pdu.m_h323_message_body.SetTag(H225_H323_UU_PDU_h323_message_body::e_empty);
     PTRACE(1, "H225\tNo Q931 User-User Information Element,"
@@ -1248,7 +1255,10 @@ PBoolean H323SignalPDU::ProcessReadData(H323Transport & transport, const PBYTEAr
     return TRUE;
   }
 
-  PPER_Stream strm = q931pdu.GetIE(Q931::UserUserIE);
+  const BYTE * userUser;
+  PINDEX userUserLength;
+  q931pdu.GetIE(Q931::UserUserIE, userUser, userUserLength);
+  H323_PERStream strm(userUser, userUserLength);
   if (!Decode(strm)) {
     PTRACE(1, "H225\tRead error: PER decode failure in Q.931 User-User Information Element,"
               "\nRaw PDU:\n" << hex << setfill('0')
@@ -1659,10 +1669,12 @@ H245_TerminalCapabilitySet &
   cap.m_multiplexCapability.SetTag(H245_MultiplexCapability::e_h2250Capability);
   H245_H2250Capability & h225_0 = cap.m_multiplexCapability;
   h225_0.m_maximumAudioDelayJitter = connection.GetMaxAudioJitterDelay();
+  h225_0.m_receiveMultipointCapability.m_multicastCapability = connection.GetEndPoint().IsMulticastReceiveEnabled();
   h225_0.m_receiveMultipointCapability.m_mediaDistributionCapability.SetSize(1);
   h225_0.m_transmitMultipointCapability.m_mediaDistributionCapability.SetSize(1);
   h225_0.m_receiveAndTransmitMultipointCapability.m_mediaDistributionCapability.SetSize(1);
   h225_0.m_t120DynamicPortCapability = TRUE;
+  h225_0.m_rtcpVideoControlCapability = connection.GetEndPoint().IsVideoRetransmissionEnabled();
 
   // Set the table of capabilities
   connection.GetLocalCapabilities().BuildPDU(connection, cap);
@@ -0,0 +1,504 @@
+/*
+ * h323perstream.cxx
+ *
+ * Word level ASN.1 PER stream
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "h323perstream.h"
+#endif
+
+#include "h323perstream.h"
+
+#define new PNEW
+
+// Largest length written in the two byte form of X.691 10.9.3.7
+#define MaxShortLength 0x4000
+
+// Largest range of the fast constrained whole number, a 16 bit field
+#define MaxFastRange 0x10000
+
+// Largest fixed size bit string that is not octet aligned, X.691 15.8
+#define MaxUnalignedBits 16
+
+
+static unsigned CountBits(unsigned range)
+{
+  if (range == 0)
+    return sizeof(unsigned)*8;
+
+  unsigned nBits = 0;
+  while (nBits < sizeof(unsigned)*8 && range > (unsigned)(1 << nBits))
+    nBits++;
+  return nBits;
+}
+
+
+// The eight bytes from ptr as a big endian word, zero past the end
+static inline PUInt64 LoadWord(const BYTE * ptr, PINDEX avail)
+{
+  if (avail >= 8)
+    return ((PUInt64)ptr[0] << 56) | ((PUInt64)ptr[1] << 48) |
+           ((PUInt64)ptr[2] << 40) | ((PUInt64)ptr[3] << 32) |
+           ((PUInt64)ptr[4] << 24) | ((PUInt64)ptr[5] << 16) |
+           ((PUInt64)ptr[6] <<  8) |  (PUInt64)ptr[7];
+
+  PUInt64 word = 0;
+  for (PINDEX i = 0; i < avail; i++)
+    word |= (PUInt64)ptr[i] << (56 - 8*i);
+  return word;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323_PERStream::H323_PERStream(PBoolean aligned)
+  : PPER_Stream(aligned)
+{
+}
+
+
+H323_PERStream::H323_PERStream(const PBYTEArray & bytes, PBoolean aligned)
+  : PPER_Stream(bytes, aligned)
+{
+}
+
+
+H323_PERStream::H323_PERStream(const BYTE * buf, PINDEX size, PBoolean aligned)
+  : PPER_Stream(buf, size, aligned)
+{
+}
+
+
+H323_PERStream & H323_PERStream::operator=(const PBYTEArray & bytes)
+{
+  PPER_Stream::operator=(bytes);
+  return *this;
+}
+
+
+PBoolean H323_PERStream::ReadBits(unsigned nBits, unsigned & value)
+{
+  if (nBits == 0) {
+    value = 0;
+    return TRUE;
+  }
+
+  PINDEX avail = GetSize() - byteOffset;
+  if (nBits > 32 || avail <= 0 || (PINDEX)nBits > avail*8 - (8 - bitOffset))
+    return FALSE;
+
+  unsigned used = 8 - bitOffset;
+  PUInt64 word = LoadWord((const BYTE *)theArray + byteOffset, avail);
+  value = (unsigned)((word << used) >> (64 - nBits));
+
+  used += nBits;
+  byteOffset += used >> 3;
+  bitOffset = 8 - (used & 7);
+  return TRUE;
+}
+
+
+void H323_PERStream::WriteBits(unsigned value, unsigned nBits)
+{
+  PAssert(byteOffset != P_MAX_INDEX && nBits <= 32, PLogicError);
+
+  if (nBits == 0)
+    return;
+
+  if (byteOffset+8 >= GetSize())
+    SetSize(byteOffset+64);
+
+  if (nBits < 32)
+    value &= (1u << nBits) - 1;
+
+  unsigned used = 8 - bitOffset;
+  PUInt64 word = (PUInt64)value << (64 - used - nBits);
+
+  // The first byte may hold earlier bits, the rest are past the end
+  BYTE * ptr = (BYTE *)theArray + byteOffset;
+  unsigned nBytes = (used + nBits + 7) >> 3;
+  ptr[0] |= (BYTE)(word >> 56);
+  for (unsigned i = 1; i < nBytes; i++)
+    ptr[i] = (BYTE)(word >> (56 - 8*i));
+
+  used += nBits;
+  byteOffset += used >> 3;
+  bitOffset = 8 - (used & 7);
+}
+
+
+void H323_PERStream::AlignWrite()
+{
+  if (bitOffset != 8) {
+    bitOffset = 8;
+    byteOffset++;
+  }
+}
+
+
+// X.691 10.5 for a range of at most 65536, as PPER_Stream::UnsignedDecode()
+PBoolean H323_PERStream::FastUnsignedDecode(unsigned lower, unsigned upper, unsigned & value)
+{
+  if (lower == upper) {
+    value = lower;
+    return TRUE;
+  }
+
+  unsigned range = (upper - lower) + 1;
+  unsigned nBits = CountBits(range);
+
+  if (aligned && range > 255) {   // 10.5.7.2 and 10.5.7.3
+    nBits = nBits > 8 ? 16 : 8;
+    ByteAlign();
+  }
+
+  if (!ReadBits(nBits, value))
+    return FALSE;
+
+  value += lower;
+  if (value > upper)
+    value = upper;
+  return TRUE;
+}
+
+
+void H323_PERStream::FastUnsignedEncode(unsigned value, unsigned lower, unsigned upper)
+{
+  if (lower == upper)
+    return;
+
+  unsigned range = (upper - lower) + 1;
+  unsigned nBits = CountBits(range);
+
+  if (value < lower)
+    value = 0;
+  else
+    value -= lower;
+
+  if (aligned && range > 255) {
+    nBits = nBits > 8 ? 16 : 8;
+    AlignWrite();
+  }
+
+  WriteBits(value, nBits);
+}
+
+
+// X.691 10.9 as PASN_ConstrainedObject::ConstrainedLengthDecode(), FALSE
+// for the extension and fragmented forms left to PPER_Stream
+PBoolean H323_PERStream::FastLengthDecode(const PASN_ConstrainedObject & obj, unsigned & length)
+{
+  if (obj.IsExtendable()) {
+    unsigned extended;
+    if (!ReadBits(1, extended) || extended != 0)
+      return FALSE;
+  }
+
+  unsigned upper = obj.IsConstrained() ? obj.GetUpperLimit() : UINT_MAX;
+  if (upper < MaxFastRange)   // 10.9.3.3
+    return FastUnsignedDecode(obj.GetLowerLimit(), upper, length);
+
+  // 10.9.3.5 to 10.9.3.7
+  ByteAlign();
+  unsigned first;
+  if (!ReadBits(8, first))
+    return FALSE;
+
+  if ((first & 0x80) == 0)
+    length = first;
+  else if ((first & 0x40) == 0) {
+    unsigned second;
+    if (!ReadBits(8, second))
+      return FALSE;
+    length = ((first & 0x3f) << 8) | second;
+  }
+  else
+    return FALSE;
+
+  if (length > upper)
+    length = upper;
+  return TRUE;
+}
+
+
+PBoolean H323_PERStream::FastLengthEncode(const PASN_ConstrainedObject & obj, unsigned length)
+{
+  if (obj.IsExtendable())
+    return FALSE;
+
+  unsigned upper = obj.IsConstrained() ? obj.GetUpperLimit() : UINT_MAX;
+  if (upper < MaxFastRange) {
+    FastUnsignedEncode(length, obj.GetLowerLimit(), upper);
+    return TRUE;
+  }
+
+  if (length >= MaxShortLength)
+    return FALSE;
+
+  AlignWrite();
+  if (length < 128)
+    WriteBits(length, 8);
+  else
+    WriteBits(0x8000 | length, 16);
+  return TRUE;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+PBoolean H323_PERStream::BooleanDecode(PASN_Boolean & value)
+{
+  unsigned bit;
+  if (!ReadBits(1, bit))
+    return FALSE;
+
+  value.SetValue(bit != 0);
+  return TRUE;
+}
+
+
+void H323_PERStream::BooleanEncode(const PASN_Boolean & value)
+{
+  WriteBits(value.GetValue() ? 1 : 0, 1);
+}
+
+
+PBoolean H323_PERStream::IntegerDecode(PASN_Integer & value)
+{
+  if (!value.IsConstrained() || value.GetLowerLimit() < 0 ||
+          value.GetUpperLimit() - value.GetLowerLimit() >= MaxFastRange)
+    return PPER_Stream::IntegerDecode(value);
+
+  PINDEX savedByteOffset = byteOffset;
+  unsigned savedBitOffset = bitOffset;
+
+  if (value.IsExtendable()) {
+    unsigned extended;
+    if (!ReadBits(1, extended))
+      return FALSE;
+    if (extended != 0) {
+      byteOffset = savedByteOffset;
+      bitOffset = savedBitOffset;
+      return PPER_Stream::IntegerDecode(value);
+    }
+  }
+
+  unsigned decoded;
+  if (!FastUnsignedDecode(value.GetLowerLimit(), value.GetUpperLimit(), decoded))
+    return FALSE;
+
+  value.SetValue(decoded);
+  return TRUE;
+}
+
+
+void H323_PERStream::IntegerEncode(const PASN_Integer & value)
+{
+  unsigned lower = value.GetLowerLimit();
+  unsigned upper = value.GetUpperLimit();
+  if (!value.IsConstrained() || value.GetLowerLimit() < 0 || upper - lower >= MaxFastRange) {
+    PPER_Stream::IntegerEncode(value);
+    return;
+  }
+
+  unsigned number = value.GetValue();
+  if (value.IsExtendable()) {
+    if (number < lower || number > upper) {
+      PPER_Stream::IntegerEncode(value);
+      return;
+    }
+    WriteBits(0, 1);
+  }
+
+  FastUnsignedEncode(number, lower, upper);
+}
+
+
+PBoolean H323_PERStream::EnumerationDecode(PASN_Enumeration & value)
+{
+  if (value.GetMaximum() >= MaxFastRange)
+    return PPER_Stream::EnumerationDecode(value);
+
+  PINDEX savedByteOffset = byteOffset;
+  unsigned savedBitOffset = bitOffset;
+
+  if (value.IsExtendable()) {
+    unsigned extended;
+    if (!ReadBits(1, extended))
+      return FALSE;
+    if (extended != 0) {
+      byteOffset = savedByteOffset;
+      bitOffset = savedBitOffset;
+      return PPER_Stream::EnumerationDecode(value);
+    }
+  }
+
+  unsigned decoded;
+  if (!FastUnsignedDecode(0, value.GetMaximum(), decoded))
+    return FALSE;
+
+  value.SetValue(decoded);
+  return TRUE;
+}
+
+
+void H323_PERStream::EnumerationEncode(const PASN_Enumeration & value)
+{
+  unsigned number = value.GetValue();
+  if (value.GetMaximum() >= MaxFastRange || (value.IsExtendable() && number > value.GetMaximum())) {
+    PPER_Stream::EnumerationEncode(value);
+    return;
+  }
+
+  if (value.IsExtendable())
+    WriteBits(0, 1);
+
+  FastUnsignedEncode(number, 0, value.GetMaximum());
+}
+
+
+PBoolean H323_PERStream::OctetStringDecode(PASN_OctetString & value)
+{
+  if (!aligned)
+    return PPER_Stream::OctetStringDecode(value);
+
+  PINDEX savedByteOffset = byteOffset;
+  unsigned savedBitOffset = bitOffset;
+
+  unsigned nBytes;
+  if (!FastLengthDecode(value, nBytes) || nBytes > (unsigned)PASN_Object::GetMaximumStringSize()) {
+    byteOffset = savedByteOffset;
+    bitOffset = savedBitOffset;
+    return PPER_Stream::OctetStringDecode(value);
+  }
+
+  if (nBytes == 0) {
+    value.SetValue(NULL, 0);
+    return TRUE;
+  }
+
+  // A fixed size of one or two octets is not aligned, X.691 16.6
+  if (value.IsConstrained() && (unsigned)value.GetLowerLimit() == value.GetUpperLimit() && nBytes <= 2) {
+    unsigned bytes;
+    if (!ReadBits(8*nBytes, bytes))
+      return FALSE;
+    BYTE buffer[2];
+    buffer[0] = (BYTE)(nBytes == 2 ? bytes >> 8 : bytes);
+    buffer[1] = (BYTE)bytes;
+    value.SetValue(buffer, nBytes);
+    return TRUE;
+  }
+
+  ByteAlign();
+  if (byteOffset + (PINDEX)nBytes > GetSize())
+    return FALSE;
+
+  value.SetValue((const BYTE *)theArray + byteOffset, nBytes);
+  byteOffset += nBytes;
+  return TRUE;
+}
+
+
+void H323_PERStream::OctetStringEncode(const PASN_OctetString & value)
+{
+  PINDEX nBytes = value.GetSize();
+  if (!aligned || !FastLengthEncode(value, nBytes)) {
+    PPER_Stream::OctetStringEncode(value);
+    return;
+  }
+
+  if (nBytes == 0)
+    return;
+
+  const BYTE * data = value;
+  if (value.IsConstrained() && (unsigned)value.GetLowerLimit() == value.GetUpperLimit() && nBytes <= 2) {
+    WriteBits(nBytes == 2 ? (data[0] << 8) | data[1] : data[0], 8*nBytes);
+    return;
+  }
+
+  AlignWrite();
+  if (byteOffset+nBytes >= GetSize())
+    SetSize(byteOffset+nBytes+64);
+  memcpy((BYTE *)theArray + byteOffset, data, nBytes);
+  byteOffset += nBytes;
+}
+
+
+// A fixed size bit string of up to 16 bits, as the optional field map that
+// every SEQUENCE preamble decodes, X.691 15.8 and 18.2
+static PBoolean IsSmallFixedBitString(const PASN_BitString & value)
+{
+  return !value.IsExtendable() && value.IsConstrained() &&
+         (unsigned)value.GetLowerLimit() == value.GetUpperLimit() &&
+         value.GetUpperLimit() <= MaxUnalignedBits;
+}
+
+
+PBoolean H323_PERStream::BitStringDecode(PASN_BitString & value)
+{
+  if (!IsSmallFixedBitString(value))
+    return PPER_Stream::BitStringDecode(value);
+
+  unsigned nBits = value.GetUpperLimit();
+  unsigned bits;
+  if (!ReadBits(nBits, bits))
+    return FALSE;
+
+  // The first bit is the most significant of the first byte
+  bits <<= MaxUnalignedBits - nBits;
+  BYTE data[2];
+  data[0] = (BYTE)(bits >> 8);
+  data[1] = (BYTE)bits;
+  return value.SetData(nBits, data, (nBits+7)/8);
+}
+
+
+void H323_PERStream::BitStringEncode(const PASN_BitString & value)
+{
+  if (!IsSmallFixedBitString(value) || value.GetSize() != value.GetUpperLimit()) {
+    PPER_Stream::BitStringEncode(value);
+    return;
+  }
+
+  unsigned nBits = value.GetSize();
+  if (nBits == 0)
+    return;
+
+  const BYTE * data = value.GetDataPointer();
+  unsigned bits = data[0] << 8;
+  if (nBits > 8)
+    bits |= data[1];
+  WriteBits(bits >> (MaxUnalignedBits - nBits), nBits);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,217 @@
+/*
+ * h323plc.cxx
+ *
+ * Concealment and time scaling of decoded audio
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "h323plc.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#include "h323plc.h"
+
+#include <math.h>
+
+#define new PNEW
+
+/* Pitch periods searched for, 2.5ms to 15ms */
+#define PLC_MIN_PITCH_HZ 400
+#define PLC_MAX_PITCH_MS 15
+
+/* Concealment is at full level for 10ms then fades to nothing at 60ms */
+#define PLC_FADE_START_MS 10
+#define PLC_FADE_END_MS   60
+
+/* Normalised correlation of the periods either side of a cut for Shorten() */
+#define PLC_SHORTEN_CORRELATION 0.8
+
+/* Mean square level below which a frame is shortened regardless of pitch */
+#define PLC_SHORTEN_QUIET (100.0*100.0)
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323AudioConcealer::H323AudioConcealer(unsigned sampleRate)
+  : minPitch(sampleRate/PLC_MIN_PITCH_HZ),
+    maxPitch(sampleRate*PLC_MAX_PITCH_MS/1000),
+    fadeStart(sampleRate*PLC_FADE_START_MS/1000),
+    fadeLength(sampleRate*(PLC_FADE_END_MS-PLC_FADE_START_MS)/1000),
+    history(maxPitch*2),
+    period(maxPitch),
+    concealedFrames(0),
+    shortenedFrames(0)
+{
+  Reset();
+}
+
+
+void H323AudioConcealer::Reset()
+{
+  historyFill = 0;
+  periodPosition = 0;
+  concealedSamples = 0;
+}
+
+
+PINDEX H323AudioConcealer::FindPitch(const short * pcm, PINDEX length, PINDEX maxLag, double & correlation) const
+{
+  // The last maxLag samples are compared with those each lag before them
+  const short * end = pcm + length;
+  PINDEX best = 0;
+  correlation = 0;
+
+  for (PINDEX lag = minPitch; lag <= maxLag; lag++) {
+    double cross = 0, energy = 0, lagEnergy = 0;
+    for (const short * p = end - maxLag; p < end; p++) {
+      cross += (double)p[0]*p[-lag];
+      energy += (double)p[0]*p[0];
+      lagEnergy += (double)p[-lag]*p[-lag];
+    }
+    if (energy <= 0 || lagEnergy <= 0)
+      continue;
+    double normalised = cross/sqrt(energy*lagEnergy);
+    if (normalised > correlation) {
+      correlation = normalised;
+      best = lag;
+    }
+  }
+
+  return best;
+}
+
+
+void H323AudioConcealer::AddHistory(const short * pcm, PINDEX samples)
+{
+  PINDEX size = history.size();
+  if (samples >= size) {
+    memcpy(&history[0], pcm + samples - size, size*sizeof(short));
+    historyFill = size;
+    return;
+  }
+
+  PINDEX keep = historyFill + samples > size ? size - samples : historyFill;
+  memmove(&history[0], &history[historyFill - keep], keep*sizeof(short));
+  memcpy(&history[keep], pcm, samples*sizeof(short));
+  historyFill = keep + samples;
+}
+
+
+short H323AudioConcealer::NextConcealed()
+{
+  int sample = period[periodPosition];
+  if (++periodPosition >= (PINDEX)period.size())
+    periodPosition = 0;
+
+  PINDEX faded = concealedSamples - fadeStart;
+  if (faded >= fadeLength)
+    return 0;
+  concealedSamples++;
+  if (faded > 0)
+    sample = sample*(fadeLength - faded)/fadeLength;
+  return (short)sample;
+}
+
+
+void H323AudioConcealer::Conceal(short * pcm, PINDEX samples)
+{
+  if (concealedSamples == 0) {
+    // Start of a loss, find the period to repeat from the audio before it
+    double correlation;
+    PINDEX pitch = historyFill >= (PINDEX)history.size() ? FindPitch(&history[0], historyFill, maxPitch, correlation) : 0;
+    if (pitch == 0) {
+      // Nothing heard yet, or nothing periodic, so play silence
+      memset(pcm, 0, samples*sizeof(short));
+      return;
+    }
+
+    period.assign(history.begin() + historyFill - pitch, history.begin() + historyFill);
+    periodPosition = 0;
+
+    PTRACE(5, "PLC\tConcealing loss with pitch period " << pitch << " samples");
+  }
+
+  for (PINDEX i = 0; i < samples; i++)
+    pcm[i] = NextConcealed();
+
+  concealedFrames++;
+}
+
+
+void H323AudioConcealer::OnDecoded(short * pcm, PINDEX samples)
+{
+  if (concealedSamples > 0) {
+    // Fade in from the concealment over a quarter of its period
+    PINDEX overlap = period.size()/4;
+    if (overlap > samples)
+      overlap = samples;
+    for (PINDEX i = 0; i < overlap; i++)
+      pcm[i] = (short)((NextConcealed()*(overlap - i) + pcm[i]*i)/overlap);
+    concealedSamples = 0;
+  }
+
+  AddHistory(pcm, samples);
+}
+
+
+PINDEX H323AudioConcealer::Shorten(short * pcm, PINDEX samples)
+{
+  PINDEX maxLag = samples/2;
+  if (maxLag > maxPitch)
+    maxLag = maxPitch;
+  if (maxLag < minPitch)
+    return samples;
+
+  double level = 0;
+  for (PINDEX i = 0; i < samples; i++)
+    level += (double)pcm[i]*pcm[i];
+  level /= samples;
+
+  double correlation;
+  PINDEX lag = FindPitch(pcm, samples, maxLag, correlation);
+  if (level < PLC_SHORTEN_QUIET) {
+    if (lag == 0)
+      lag = maxLag;
+  }
+  else if (lag == 0 || correlation < PLC_SHORTEN_CORRELATION)
+    return samples;
+
+  // Cross fade the first period into the second, then close up the rest
+  for (PINDEX i = 0; i < lag; i++)
+    pcm[i] = (short)((pcm[i]*(lag - i) + pcm[i+lag]*i)/lag);
+  memmove(pcm + lag, pcm + 2*lag, (samples - 2*lag)*sizeof(short));
+
+  shortenedFrames++;
+  PTRACE(5, "PLC\tShortened frame by " << lag << " samples, correlation " << correlation);
+  return samples - lag;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -42,8 +42,15 @@
 #include <h245.h>
 #include <rtp.h>
 #include <mediafmt.h>
+#include <g711block.h>
+#include <h323videorate.h>
+#include <h323videoload.h>
+#include <h323mediaclock.h>
+#include <h323simulcast.h>
 #include <openh323buildopts.h>
 
+#include <map>
+
 #define H323CAP_TAG_PREFIX    "h323"
 static const char GET_CODEC_OPTIONS_CONTROL[]       = "get_codec_options";
 static const char FREE_CODEC_OPTIONS_CONTROL[]      = "free_codec_options";
@@ -53,6 +60,8 @@ static const char SET_CODEC_CUSTOMISED_OPTIONS[]    = "to_customised_options";
 static const char SET_CODEC_FLOWCONTROL_OPTIONS[]   = "to_flowcontrol_options";
 static const char EVENT_CODEC_CONTROL[]             = "event_codec";
 static const char SET_CODEC_FORMAT_OPTIONS[]        = "set_format_options";
+static const char RESET_CODEC_CONTROL[]             = "reset_codec";
+static const char SET_COMPLEXITY_CONTROL[]          = "set_complexity";
 
 #ifdef H323_VIDEO
 
@@ -111,7 +120,40 @@ inline static bool IsValidMPI(int mpi) {
   return (mpi > 0) && (mpi < 5);
 }
 
+// MPI options in the bit order of H323VideoPluginCapability::CompareKey::sizes
+enum {
+  SQCIFSizeBit = 1,
+  QCIFSizeBit  = 2,
+  CIFSizeBit   = 4,
+  CIF4SizeBit  = 8,
+  CIF16SizeBit = 16,
+  NumSizeBits  = 5
+};
+
+static const OpalMediaOptionKey mpiKeys[NumSizeBits] = {
+  OpalMediaOptionKey(sqcifMPI_tag),
+  OpalMediaOptionKey(qcifMPI_tag),
+  OpalMediaOptionKey(cifMPI_tag),
+  OpalMediaOptionKey(cif4MPI_tag),
+  OpalMediaOptionKey(cif16MPI_tag)
+};
+
+// Order by picture sizes, the same if any in common, otherwise less if the
+// other has a size this has not
+static PObject::Comparison CompareSizes(unsigned sizes, unsigned otherSizes)
+{
+  if ((sizes & otherSizes) != 0)
+    return PObject::EqualTo;
+
+  if ((otherSizes & ~sizes) != 0)
+    return PObject::LessThan;
+
+  return PObject::GreaterThan;
+}
+
 #define FASTPICTUREINTERVAL  1000
+#define SIMULCAST_READ_TIMEOUT  100   // Milliseconds a leg waits for a picture
+#define MAX_PACKETS_PER_PICTURE 1000
 
 #endif // H323_VIDEO
 
@@ -123,15 +165,12 @@ class OpalPluginCodec : public OpalFactoryCodec {
     OpalPluginCodec(PluginCodec_Definition * _codecDefn)
       : codecDefn(_codecDefn)
     {
-      if (codecDefn->createCodec == NULL)
-        context = NULL;
-      else
-        context = (codecDefn->createCodec)(codecDefn);
+      context = H323PluginCodecManager::CreateCodecContext(codecDefn);
     }
 
     ~OpalPluginCodec()
     {
-      (codecDefn->destroyCodec)(codecDefn, context);
+      H323PluginCodecManager::DestroyCodecContext(codecDefn, context);
     }
 
     const struct PluginCodec_Definition * GetDefinition()
@@ -197,13 +236,6 @@ class OpalPluginCodec : public OpalFactoryCodec {
 
 #ifdef H323_AUDIO_CODECS
 
-extern "C" {
-  unsigned char linear2ulaw(int pcm_val);
-  int ulaw2linear(unsigned char u_val);
-  unsigned char linear2alaw(int pcm_val);
-  int alaw2linear(unsigned char u_val);
-};
-
 #define DECLARE_FIXED_CODEC(name, format, bps, frameTime, samples, bytes, fpp, maxfpp, payload, sdp) \
 class name##_Base : public OpalFactoryCodec { \
   PCLASSINFO(name##_Base, OpalFactoryCodec) \
@@ -260,8 +292,7 @@ int OpalG711ALaw64k_Encoder::Encode(const void * _from, unsigned * fromLen, void
   unsigned count = *fromLen / 2;
   *toLen         = count;
 
-  while (count-- > 0)
-    *to++ = linear2alaw(*from++);
+  H323_G711Block::EncodeALaw(from, to, count);
 
   return 1;
 }
@@ -277,8 +308,7 @@ int OpalG711ALaw64k_Decoder::Encode(const void * _from, unsigned * fromLen, void
   unsigned count = *fromLen;
   *toLen         = count * 2;
 
-  while (count-- > 0)
-    *to++ = (short)alaw2linear(*from++);
+  H323_G711Block::DecodeALaw(from, to, count);
 
   return 1;
 }
@@ -296,8 +326,7 @@ int OpalG711ALaw64k20_Encoder::Encode(const void * _from, unsigned * fromLen, vo
   unsigned count = *fromLen / 2;
   *toLen         = count;
 
-  while (count-- > 0)
-    *to++ = linear2alaw(*from++);
+  H323_G711Block::EncodeALaw(from, to, count);
 
   return 1;
 }
@@ -313,8 +342,7 @@ int OpalG711ALaw64k20_Decoder::Encode(const void * _from, unsigned * fromLen, vo
   unsigned count = *fromLen;
   *toLen         = count * 2;
 
-  while (count-- > 0)
-    *to++ = (short)alaw2linear(*from++);
+  H323_G711Block::DecodeALaw(from, to, count);
 
   return 1;
 }
@@ -332,8 +360,7 @@ int OpalG711uLaw64k_Encoder::Encode(const void * _from, unsigned * fromLen, void
   unsigned count = *fromLen / 2;
   *toLen         = count;
 
-  while (count-- > 0)
-    *to++ = linear2ulaw(*from++);
+  H323_G711Block::EncodeuLaw(from, to, count);
 
   return 1;
 }
@@ -349,8 +376,7 @@ int OpalG711uLaw64k_Decoder::Encode(const void * _from, unsigned * fromLen, void
   unsigned count = *fromLen;
   *toLen         = count * 2;
 
-  while (count-- > 0)
-    *to++ = (short)ulaw2linear(*from++);
+  H323_G711Block::DecodeuLaw(from, to, count);
 
   return 1;
 }
@@ -368,8 +394,7 @@ int OpalG711uLaw64k20_Encoder::Encode(const void * _from, unsigned * fromLen, vo
   unsigned count = *fromLen / 2;
   *toLen         = count;
 
-  while (count-- > 0)
-    *to++ = linear2ulaw(*from++);
+  H323_G711Block::EncodeuLaw(from, to, count);
 
   return 1;
 }
@@ -385,8 +410,7 @@ int OpalG711uLaw64k20_Decoder::Encode(const void * _from, unsigned * fromLen, vo
   unsigned count = *fromLen;
   *toLen         = count * 2;
 
-  while (count-- > 0)
-    *to++ = (short)ulaw2linear(*from++);
+  H323_G711Block::DecodeuLaw(from, to, count);
 
   return 1;
 }
@@ -514,6 +538,27 @@ static PBoolean SetCodecControl(const PluginCodec_Definition * codec,
 {
   return SetCodecControl(codec, context, name, parm, PString(PString::Signed, value));
 }
+
+// Complexity from H323EncodeBudget::MinComplexity to MaxComplexity
+static PBoolean SetCodecComplexity(const PluginCodec_Definition * codec, void * context, unsigned complexity)
+{
+  PluginCodec_ControlDefn * ctl = GetCodecControl(codec, SET_COMPLEXITY_CONTROL);
+  if (ctl == NULL || context == NULL)
+    return FALSE;
+
+  int value = complexity;
+  unsigned len = sizeof(value);
+  return (*ctl->control)(codec, context, SET_COMPLEXITY_CONTROL, &value, &len) > 0;
+}
+
+// Govern the complexity of an encoder if there is a budget and the codec has the control
+static void OpenEncodeLoad(H323EncodeLoad & encodeLoad, const PluginCodec_Definition * codec,
+                           const OpalMediaFormat & mediaFormat, H323Connection & connection)
+{
+  H323EncodeBudget & budget = connection.GetEndPoint().GetEncodeBudget();
+  if (budget.GetBudget() > 0 && codec != NULL && GetCodecControl(codec, SET_COMPLEXITY_CONTROL) != NULL)
+    encodeLoad.Open(mediaFormat, budget);
+}
 #endif
 
 #ifdef H323_VIDEO
@@ -884,10 +929,12 @@ class OpalPluginAudioMediaFormat : public OpalMediaFormat
       SetDefaultAudioOptions(*this);
       // manually register the new singleton type, as we do not have a concrete type
       OpalMediaFormatFactory::Register(*this, this);
+      OpalMediaFormatRegistry::Invalidate();
     }
     ~OpalPluginAudioMediaFormat()
     {
       OpalMediaFormatFactory::Unregister(*this);
+      OpalMediaFormatRegistry::Invalidate();
     }
     PluginCodec_Definition * encoderCodec;
 };
@@ -953,10 +1000,12 @@ class OpalPluginVideoMediaFormat : public OpalVideoFormat
 
       // manually register the new singleton type, as we do not have a concrete type
       OpalMediaFormatFactory::Register(*this, this);
+      OpalMediaFormatRegistry::Invalidate();
     }
     ~OpalPluginVideoMediaFormat()
     {
       OpalMediaFormatFactory::Unregister(*this);
+      OpalMediaFormatRegistry::Invalidate();
     }
 
     PObject * Clone() const
@@ -1100,7 +1149,7 @@ static bool UpdatePluginOptions(const PluginCodec_Definition * codec, void * con
         mediaFormat.SetOptionInteger(key,val);
       }
 #ifdef H323_VIDEO
-      mediaFormat.SetBandwidth(mediaFormat.GetOptionInteger(OpalVideoFormat::MaxBitRateOption));
+      mediaFormat.SetBandwidth(mediaFormat.GetOptionInteger(OpalVideoFormat::MaxBitRateKey));
 #endif
 
       free(_options);
@@ -1122,32 +1171,84 @@ class H323PluginFramedAudioCodec : public H323FramedAudioCodec
   PCLASSINFO(H323PluginFramedAudioCodec, H323FramedAudioCodec);
   public:
     H323PluginFramedAudioCodec(const OpalMediaFormat & fmtName, Direction direction, PluginCodec_Definition * _codec)
-      : H323FramedAudioCodec(fmtName, direction), codec(_codec)
+      : H323FramedAudioCodec(fmtName, direction), context(NULL), codec(_codec), txQuality(0), txQualitySet(FALSE)
+    { }
+
+    ~H323PluginFramedAudioCodec()
+    { CloseContext(); }
+
+    // The plugin context is made on the first frame coded, so channels that
+    // never carry media, or only carry it one way, cost no codec state
+    PBoolean OpenContext()
+    {
+      if (context != NULL || codec == NULL || codec->createCodec == NULL)
+        return TRUE;
+
+      context = H323PluginCodecManager::CreateCodecContext(codec);
+      if (context == NULL) {
+        PTRACE(1, "H323PLUGIN\tCould not create " << codec->descr << " codec context");
+        return FALSE;
+      }
+
+      PTRACE(5, "H323PLUGIN\tCreated " << codec->descr << " codec context on first media");
+      UpdatePluginOptions(codec,context,GetWritableMediaFormat());
+      if (txQualitySet)
+        SetCodecControl(codec, context, SET_CODEC_OPTIONS_CONTROL, "set_quality", txQuality);
+      if (encodeLoad.IsOpen())
+        SetCodecComplexity(codec, context, encodeLoad.GetComplexity());
+      return TRUE;
+    }
+
+    void CloseContext()
     {
-      if (codec && codec->createCodec) {
-         context = (*codec->createCodec)(codec);
-         UpdatePluginOptions(codec,context,GetWritableMediaFormat());
-      } else context = NULL;
+      if (context == NULL)
+        return;
+      H323PluginCodecManager::DestroyCodecContext(codec, context);
+      context = NULL;
     }
 
-    ~H323PluginFramedAudioCodec()
-    { if (codec != NULL && codec->destroyCodec != NULL) (*codec->destroyCodec)(codec, context); }
+    virtual PBoolean Open(H323Connection & connection)
+    {
+      if (direction == Encoder)
+        OpenEncodeLoad(encodeLoad, codec, mediaFormat, connection);
+      return H323FramedAudioCodec::Open(connection);
+    }
+
+    virtual PBoolean SetRawDataHeld(PBoolean hold)
+    {
+      if (!H323FramedAudioCodec::SetRawDataHeld(hold))
+        return FALSE;
+
+      // Nothing is coded while held, the codec starts afresh on retrieve
+      if (hold) {
+        PWaitAndSignal mutex(rawChannelMutex);
+        if (context != NULL) {
+          PTRACE(5, "H323PLUGIN\tReleased " << codec->descr << " codec context on hold");
+          CloseContext();
+        }
+      }
+      return TRUE;
+    }
 
     PBoolean EncodeFrame(
       BYTE * buffer,        /// Buffer into which encoded bytes are placed
       unsigned int & toLen  /// Actual length of encoded data buffer
     )
     {
-      if (codec == NULL || direction != Encoder)
+      if (codec == NULL || direction != Encoder || !OpenContext())
         return FALSE;
 
-      unsigned int fromLen = codec->parm.audio.samplesPerFrame*2;
-      toLen                = codec->parm.audio.bytesPerFrame;
+      unsigned int fromLen = codec->parm.audio.samplesPerFrame*2*framesPerCall;
+      toLen                = codec->parm.audio.bytesPerFrame*framesPerCall;
       unsigned flags = 0;
-      return (codec->codecFunction)(codec, context,
+      PInt64 encodeStart = encodeLoad.IsOpen() ? H323MediaClock::GetMicroseconds() : 0;
+      PBoolean ok = (codec->codecFunction)(codec, context,
                                  (const unsigned char *)sampleBuffer.GetPointer(), &fromLen,
                                  buffer, &toLen,
                                  &flags) != 0;
+      if (encodeLoad.IsOpen() && encodeLoad.AddEncodeTime(encodeStart, H323MediaClock::GetMicroseconds()))
+        SetCodecComplexity(codec, context, encodeLoad.GetComplexity());
+      return ok;
     };
 
     PBoolean DecodeFrame(
@@ -1157,7 +1258,7 @@ class H323PluginFramedAudioCodec : public H323FramedAudioCodec
       unsigned & bytesDecoded /// Number of bytes output from frame
     )
     {
-      if (codec == NULL || direction != Decoder)
+      if (codec == NULL || direction != Decoder || !OpenContext())
         return FALSE;
       unsigned flags = 0;
       if ((codec->codecFunction)(codec, context,
@@ -1170,12 +1271,30 @@ class H323PluginFramedAudioCodec : public H323FramedAudioCodec
       return TRUE;
     }
 
+    PBoolean DecodeFrames(
+      const BYTE * buffer,    /// Buffer holding the frames
+      unsigned frames,        /// Number of frames in the buffer
+      short * pcm             /// Buffer for the decoded samples
+    )
+    {
+      if (codec == NULL || direction != Decoder || !OpenContext())
+        return FALSE;
+      unsigned fromLen = codec->parm.audio.bytesPerFrame*frames;
+      unsigned toLen = codec->parm.audio.samplesPerFrame*2*frames;
+      unsigned expected = toLen;
+      unsigned flags = 0;
+      return (codec->codecFunction)(codec, context,
+                                 buffer, &fromLen,
+                                 (unsigned char *)pcm, &toLen,
+                                 &flags) != 0 && toLen == expected;
+    }
+
     void DecodeSilenceFrame(
       void * buffer,        /// Buffer from which encoded data is found
       unsigned length       /// Length of encoded data buffer
     )
     {
-      if ((codec->flags & PluginCodec_DecodeSilence) == 0)
+      if ((codec->flags & PluginCodec_DecodeSilence) == 0 || !OpenContext())
         memset(buffer, 0, length);
       else {
         unsigned flags = PluginCodec_CoderSilenceFrame;
@@ -1186,12 +1305,28 @@ class H323PluginFramedAudioCodec : public H323FramedAudioCodec
       }
     }
 
+    virtual PBoolean HasDecoderConcealment() const
+    { return (codec->flags & PluginCodec_DecodeSilence) != 0; }
+
+    virtual PBoolean HasMultiFrameCoding() const
+    { return (codec->flags & PluginCodec_MultiFrame) != 0; }
+
     virtual void SetTxQualityLevel(int qlevel)
-    { SetCodecControl(codec, context, SET_CODEC_OPTIONS_CONTROL, "set_quality", qlevel); }
+    {
+      // Kept for a context made later
+      PWaitAndSignal mutex(rawChannelMutex);
+      txQuality = qlevel;
+      txQualitySet = TRUE;
+      if (context != NULL)
+        SetCodecControl(codec, context, SET_CODEC_OPTIONS_CONTROL, "set_quality", qlevel);
+    }
 
   protected:
     void * context;
     PluginCodec_Definition * codec;
+    int txQuality;
+    PBoolean txQualitySet;
+    H323EncodeLoad encodeLoad;
 };
 
 //////////////////////////////////////////////////////////////////////////////
@@ -1210,15 +1345,57 @@ class H323StreamedPluginAudioCodec : public H323StreamedAudioCodec
       unsigned bits,             /// Bits per sample
       PluginCodec_Definition * _codec
     )
-      : H323StreamedAudioCodec(fmtName, direction, samplesPerFrame, bits), codec(_codec)
-    { if (codec != NULL && codec->createCodec != NULL) context = (*codec->createCodec)(codec); else context = NULL; }
+      : H323StreamedAudioCodec(fmtName, direction, samplesPerFrame, bits), context(NULL), codec(_codec),
+        txQuality(0), txQualitySet(FALSE)
+    { }
 
     ~H323StreamedPluginAudioCodec()
-    { if (codec != NULL && codec->destroyCodec != NULL) (*codec->destroyCodec)(codec, context); }
+    { CloseContext(); }
+
+    // Made on the first sample coded, as for the framed codecs
+    PBoolean OpenContext() const
+    {
+      if (context != NULL || codec == NULL || codec->createCodec == NULL)
+        return TRUE;
+
+      context = H323PluginCodecManager::CreateCodecContext(codec);
+      if (context == NULL) {
+        PTRACE(1, "H323PLUGIN\tCould not create " << codec->descr << " codec context");
+        return FALSE;
+      }
+
+      PTRACE(5, "H323PLUGIN\tCreated " << codec->descr << " codec context on first media");
+      if (txQualitySet)
+        SetCodecControl(codec, context, SET_CODEC_OPTIONS_CONTROL, "set_quality", txQuality);
+      return TRUE;
+    }
+
+    void CloseContext()
+    {
+      if (context == NULL)
+        return;
+      H323PluginCodecManager::DestroyCodecContext(codec, context);
+      context = NULL;
+    }
+
+    virtual PBoolean SetRawDataHeld(PBoolean hold)
+    {
+      if (!H323StreamedAudioCodec::SetRawDataHeld(hold))
+        return FALSE;
+
+      if (hold) {
+        PWaitAndSignal mutex(rawChannelMutex);
+        if (context != NULL) {
+          PTRACE(5, "H323PLUGIN\tReleased " << codec->descr << " codec context on hold");
+          CloseContext();
+        }
+      }
+      return TRUE;
+    }
 
     int Encode(short sample) const
     {
-      if (codec == NULL || direction != Encoder)
+      if (codec == NULL || direction != Encoder || !OpenContext())
         return 0;
       unsigned int fromLen = sizeof(sample);
       int to;
@@ -1233,7 +1410,7 @@ class H323StreamedPluginAudioCodec : public H323StreamedAudioCodec
 
     short Decode(int sample) const
     {
-      if (codec == NULL || direction != Decoder)
+      if (codec == NULL || direction != Decoder || !OpenContext())
         return 0;
       unsigned fromLen = sizeof(sample);
       short to;
@@ -1247,11 +1424,19 @@ class H323StreamedPluginAudioCodec : public H323StreamedAudioCodec
     }
 
     virtual void SetTxQualityLevel(int qlevel)
-    { SetCodecControl(codec, context, SET_CODEC_OPTIONS_CONTROL, "set_quality", qlevel); }
+    {
+      PWaitAndSignal mutex(rawChannelMutex);
+      txQuality = qlevel;
+      txQualitySet = TRUE;
+      if (context != NULL)
+        SetCodecControl(codec, context, SET_CODEC_OPTIONS_CONTROL, "set_quality", qlevel);
+    }
 
   protected:
-    void * context;
+    mutable void * context;
     PluginCodec_Definition * codec;
+    int txQuality;
+    PBoolean txQualitySet;
 };
 
 #endif //  NO_H323_AUDIO_CODECS
@@ -1374,6 +1559,15 @@ class H323PluginVideoCodec : public H323VideoCodec
       void * mark                 ///< WaterMark
     );
 
+    // The buffer to decode into, a new one from the pool if the last
+    // picture is still held by a decoded frame handler
+    BYTE * GetDecodeBuffer()
+    {
+      if (!decodedFrame.IsUnique())
+        decodedFrame = H323VideoFramePool::GetDecoderPool().Acquire(bufferSize);
+      return decodedFrame->GetBuffer();
+    }
+
     virtual unsigned GetFrameRate() const
     {  return targetFrameTimeMs ? 90000/targetFrameTimeMs : 30;  }
 
@@ -1397,7 +1591,7 @@ class H323PluginVideoCodec : public H323VideoCodec
     { SetCodecControl(codec, context, SET_CODEC_OPTIONS_CONTROL, "set_background_fill", fillLevel); }
 
     virtual unsigned GetMaxBitRate() const
-    { return mediaFormat.GetOptionInteger(OpalVideoFormat::MaxBitRateOption); }
+    { return mediaFormat.GetOptionInteger(OpalVideoFormat::MaxBitRateKey); }
 
     virtual PBoolean SetMaxBitRate(unsigned bitRate);
 
@@ -1413,26 +1607,36 @@ class H323PluginVideoCodec : public H323VideoCodec
     void SetVideoMode(int mode);
 
     // The following require implementation in the plugin codec
-    virtual void OnFastUpdatePicture() {
-      EventCodecControl(codec, context, "on_fast_update", "");
-      sendIntra = true;
-    }
+    virtual void OnFastUpdatePicture();
 
     virtual void OnFlowControl(long bitRateRestriction);
 
     virtual PBoolean SetSupportedFormats(std::list<PVideoFrameInfo> & info);
 
+    virtual PBoolean SetEncodeFrameSize(unsigned width, unsigned height);
+
+    virtual PBoolean EncodePicture(const BYTE * picture, unsigned width, unsigned height,
+                                   PBoolean & intra, std::vector<PBYTEArray> & packets);
+
+    virtual void OnReceiverReport(const RTP_Session::ReceiverReport & report);
+
     virtual void OnLostPartialPicture()
     { EventCodecControl(codec, context, "on_lost_partial", ""); }
 
     virtual void OnLostPicture()
     { EventCodecControl(codec, context, "on_lost_picture", ""); }
 
+    // Asked for at most once an interval by WriteInternal()
+    virtual void OnIncompletePicture()
+    { if (direction == Decoder) sendIntra = true; }
+
   protected:
     void *       context;
     PluginCodec_Definition * codec;
     int          bufferSize;
-    RTP_DataFrame bufferRTP;
+    RTP_DataFrame bufferRTP;            ///< Encoded frames
+    H323VideoFrameRef decodedFrame;     ///< Decoded picture
+    PBYTEArray   grabBuffer;            ///< Grabbed picture to be scaled
     int          maxWidth;
     int          maxHeight;
 
@@ -1443,11 +1647,13 @@ class H323PluginVideoCodec : public H323VideoCodec
     long         flowRequest;
     PBoolean     lastPacketSent;
     bool         sendIntra;
+    PAtomicInteger fastUpdateRequests;  ///< Fast updates waiting for an intra frame
 
     PInt64  lastFrameTick;
     PInt64  nowFrameTick;
     PInt64  lastFUPTick;
     PInt64  nowFUPTick;
+    PInt64  lastIntraTick;
 
     // Regular used variables
     int          outputDataSize;
@@ -1456,6 +1662,18 @@ class H323PluginVideoCodec : public H323VideoCodec
     unsigned int flags;
     int          pluginRetVal;
 
+    PBoolean     rateControlEnabled;
+    H323VideoRateController rateControl;
+    PBoolean     intraRefresh;
+    H323VideoDecodeLoad decodeLoad;
+    H323EncodeLoad encodeLoad;
+
+    PBoolean     contentVideo;          ///< Encoding H.239 content
+    unsigned     contentFrameTime;      ///< Least time between content frames in 90kHz units
+    PBoolean     contentSkipUnchanged;
+    PBYTEArray   contentPicture;        ///< Last content picture grabbed
+    unsigned     contentRefines;        ///< Frames sent since the content last changed
+
 #ifdef H323_FRAMEBUFFER
     H323PluginFrameBuffer  m_frameBuffer;
 #endif
@@ -1466,20 +1684,20 @@ static bool SetFlowControl(const PluginCodec_Definition * codec, void * context,
     if (context == NULL)
         return false;
 
-    if (mediaFormat.GetOptionInteger(OpalVideoFormat::MaxBitRateOption) < (bitRate*100)) {
+    if (mediaFormat.GetOptionInteger(OpalVideoFormat::MaxBitRateKey) < (bitRate*100)) {
         PTRACE(3,"H323\tFlow Control request exceeds codec limits Ignored! Max: "
-          << mediaFormat.GetOptionInteger(OpalVideoFormat::MaxBitRateOption) << " Req: " << bitRate*100);
+          << mediaFormat.GetOptionInteger(OpalVideoFormat::MaxBitRateKey) << " Req: " << bitRate*100);
         return false;
     }
 
-    if (mediaFormat.GetOptionInteger(OpalVideoFormat::TargetBitRateOption) == (bitRate*100)) {
+    if (mediaFormat.GetOptionInteger(OpalVideoFormat::TargetBitRateKey) == (bitRate*100)) {
         PTRACE(3,"H323\tFlow Control request ignored already doing " << bitRate*100);
         return false;
     }
 
     PluginCodec_ControlDefn * ctl = GetCodecControl(codec, SET_CODEC_FLOWCONTROL_OPTIONS);
     if (ctl != NULL) {
-      mediaFormat.SetOptionInteger(OpalVideoFormat::TargetBitRateOption,(int)bitRate * 100);
+      mediaFormat.SetOptionInteger(OpalVideoFormat::TargetBitRateKey,(int)bitRate * 100);
       PStringArray strlist(mediaFormat.GetOptionCount()*2);
       for (PINDEX i = 0; i < mediaFormat.GetOptionCount(); i++) {
         const OpalMediaOption & option = mediaFormat.GetOption(i);
@@ -1510,9 +1728,9 @@ static bool SetFlowControl(const PluginCodec_Definition * codec, void * context,
 static bool SetCustomLevel(const PluginCodec_Definition * codec, OpalMediaFormat & mediaFormat, unsigned width, unsigned height, unsigned rate)
 {
 
-    mediaFormat.SetOptionInteger(OpalVideoFormat::FrameWidthOption,width);
-    mediaFormat.SetOptionInteger(OpalVideoFormat::FrameHeightOption,height);
-    mediaFormat.SetOptionInteger(OpalVideoFormat::FrameTimeOption, (int)(OpalMediaFormat::VideoTimeUnits * 1000 * 100 * rate / 2997));
+    mediaFormat.SetOptionInteger(OpalVideoFormat::FrameWidthKey,width);
+    mediaFormat.SetOptionInteger(OpalVideoFormat::FrameHeightKey,height);
+    mediaFormat.SetOptionInteger(OpalVideoFormat::FrameTimeKey, (int)(OpalMediaFormat::VideoTimeUnits * 1000 * 100 * rate / 2997));
 
     PluginCodec_ControlDefn * ctl = GetCodecControl(codec, SET_CODEC_CUSTOMISED_OPTIONS);
     if (ctl != NULL) {
@@ -1529,8 +1747,8 @@ static bool SetCustomLevel(const PluginCodec_Definition * codec, OpalMediaFormat
             const char * key = _options[0];
             int val = atoi(_options[1]);
             if (strcasecmp(key, OpalVideoFormat::TargetBitRateOption) == 0) {
-                mediaFormat.SetOptionInteger(OpalVideoFormat::TargetBitRateOption,val);
-                mediaFormat.SetOptionInteger(OpalVideoFormat::MaxBitRateOption,val);
+                mediaFormat.SetOptionInteger(OpalVideoFormat::TargetBitRateKey,val);
+                mediaFormat.SetOptionInteger(OpalVideoFormat::MaxBitRateKey,val);
             } else if (strcasecmp(key, "Generic Parameter 42") == 0)
                 mediaFormat.SetOptionInteger("Generic Parameter 42",val);
             else if (strcasecmp(key, "Generic Parameter 10") == 0)
@@ -1596,15 +1814,23 @@ bool OpalPluginCodec::CodecControl(const char * name, void * parm, unsigned int
 H323PluginVideoCodec::H323PluginVideoCodec(const OpalMediaFormat & fmt, Direction direction, PluginCodec_Definition * _codec, const H323Capability * cap)
     : H323VideoCodec(fmt, direction), context(NULL), codec(_codec),
       bufferSize(sizeof(PluginCodec_Video_FrameHeader) + (PLUGIN_MAX_WIDTH * PLUGIN_MAX_HEIGHT * 3)/2 + PLUGIN_RTP_HEADER_SIZE), bufferRTP(bufferSize-PLUGIN_RTP_HEADER_SIZE, TRUE),
-      maxWidth(fmt.GetOptionInteger(OpalVideoFormat::FrameWidthOption)), maxHeight(fmt.GetOptionInteger(OpalVideoFormat::FrameHeightOption)),
-      bytesPerFrame((maxHeight * maxWidth * 3)/2), lastFrameTimeRTP(0), targetFrameTimeMs(fmt.GetOptionInteger(OpalVideoFormat::FrameTimeOption)),
-      flowRequest(0), lastPacketSent(true), sendIntra(true), lastFrameTick(0), nowFrameTick(0), lastFUPTick(0), nowFUPTick(0), outputDataSize(MAX_MTU_SIZE),
-      fromLen(0), toLen(0), flags(0), pluginRetVal(0)
+      maxWidth(fmt.GetOptionInteger(OpalVideoFormat::FrameWidthKey)), maxHeight(fmt.GetOptionInteger(OpalVideoFormat::FrameHeightKey)),
+      bytesPerFrame((maxHeight * maxWidth * 3)/2), lastFrameTimeRTP(0), targetFrameTimeMs(fmt.GetOptionInteger(OpalVideoFormat::FrameTimeKey)),
+      flowRequest(0), lastPacketSent(true), sendIntra(true), fastUpdateRequests(0), lastFrameTick(0), nowFrameTick(0), lastFUPTick(0), nowFUPTick(0),
+      lastIntraTick(0), outputDataSize(MAX_MTU_SIZE), fromLen(0), toLen(0), flags(0), pluginRetVal(0), rateControlEnabled(FALSE), intraRefresh(FALSE),
+      contentVideo(FALSE), contentFrameTime(0), contentSkipUnchanged(FALSE), contentRefines(0)
 {
-    if (codec && codec->createCodec) {
-        context = (*codec->createCodec)(codec);
+    context = H323PluginCodecManager::CreateCodecContext(codec);
+
+    // sent first, the media format options that follow leave it in place
+    unsigned threads = H323PluginCodecManager::GetVideoEncoderThreads();
+    if (direction == Encoder && threads > 0 && codec && codec->createCodec)
+        SetCodecControl(codec, context, SET_CODEC_OPTIONS_CONTROL, PLUGINCODEC_OPTION_ENCODING_THREADS, threads);
+    if (direction == Encoder && H323PluginCodecManager::GetVideoIntraRefresh() && codec && codec->createCodec)
+        intraRefresh = SetCodecControl(codec, context, SET_CODEC_OPTIONS_CONTROL, PLUGINCODEC_OPTION_INTRA_REFRESH, 1);
+
+    if (codec && codec->createCodec)
         UpdatePluginOptions(codec,context,GetWritableMediaFormat());
-    } else context = NULL;
 
     if (cap) {
         OpalMediaFormat & capFmt = PRemoveConst(H323Capability, cap)->GetWritableMediaFormat();
@@ -1632,16 +1858,15 @@ H323PluginVideoCodec::~H323PluginVideoCodec()
     // memory leak
     bufferRTP.SetSize(0);
 
-    if (codec != NULL && codec->destroyCodec != NULL)
-        (*codec->destroyCodec)(codec, context);
+    H323PluginCodecManager::DestroyCodecContext(codec, context);
 }
 
 PBoolean H323PluginVideoCodec::SetMaxBitRate(unsigned bitRate)
 {
     if (SetFlowControl(codec,context,mediaFormat,bitRate/100)) {
-         frameWidth = mediaFormat.GetOptionInteger(OpalVideoFormat::FrameWidthOption);
-         frameHeight =  mediaFormat.GetOptionInteger(OpalVideoFormat::FrameHeightOption);
-         targetFrameTimeMs = mediaFormat.GetOptionInteger(OpalVideoFormat::FrameTimeOption);
+         frameWidth = mediaFormat.GetOptionInteger(OpalVideoFormat::FrameWidthKey);
+         frameHeight =  mediaFormat.GetOptionInteger(OpalVideoFormat::FrameHeightKey);
+         targetFrameTimeMs = mediaFormat.GetOptionInteger(OpalVideoFormat::FrameTimeKey);
          mediaFormat.SetBandwidth(bitRate);
          return true;
     }
@@ -1650,13 +1875,13 @@ PBoolean H323PluginVideoCodec::SetMaxBitRate(unsigned bitRate)
 
 void H323PluginVideoCodec::SetEmphasisSpeed(bool speed)
 {
-  mediaFormat.SetOptionBoolean(OpalVideoFormat::EmphasisSpeedOption, speed);
+  mediaFormat.SetOptionBoolean(OpalVideoFormat::EmphasisSpeedKey, speed);
   //UpdatePluginOptions(codec, context, mediaFormat);
 }
 
 void H323PluginVideoCodec::SetMaxPayloadSize(int maxSize)
 {
-  mediaFormat.SetOptionInteger(OpalVideoFormat::MaxPayloadSizeOption, (int)maxSize);
+  mediaFormat.SetOptionInteger(OpalVideoFormat::MaxPayloadSizeKey, (int)maxSize);
   UpdatePluginOptions(codec, context, mediaFormat);
 }
 
@@ -1664,11 +1889,11 @@ PStringArray LoadInputDeviceOptions(const OpalMediaFormat & fmt)
 {
      PStringArray list;
      list += OpalVideoFormat::FrameHeightOption;
-     list += PString(fmt.GetOptionInteger(OpalVideoFormat::FrameHeightOption));
+     list += PString(fmt.GetOptionInteger(OpalVideoFormat::FrameHeightKey));
      list += OpalVideoFormat::FrameWidthOption;
-     list += PString(fmt.GetOptionInteger(OpalVideoFormat::FrameWidthOption));
+     list += PString(fmt.GetOptionInteger(OpalVideoFormat::FrameWidthKey));
      list += OpalVideoFormat::FrameTimeOption;
-     list += PString(fmt.GetOptionInteger(OpalVideoFormat::FrameTimeOption));
+     list += PString(fmt.GetOptionInteger(OpalVideoFormat::FrameTimeKey));
      return list;
 }
 
@@ -1680,7 +1905,79 @@ void H323PluginVideoCodec::OnFlowControl(long bitRateRestriction)
   }
 
   flowRequest = bitRateRestriction;
+  rateControl.SetMaxBitRate((unsigned)bitRateRestriction*100);
+
+}
 
+void H323PluginVideoCodec::OnFastUpdatePicture()
+{
+  if (simulcast != NULL) {
+    simulcast->RequestIntra(*simulcastReceiver);
+    return;
+  }
+
+  // Passed on to the plugin when the intra frame is sent, see Read()
+  ++fastUpdateRequests;
+  sendIntra = true;
+}
+
+void H323PluginVideoCodec::OnReceiverReport(const RTP_Session::ReceiverReport & report)
+{
+  if (rateControlEnabled)
+    rateControl.OnReceiverReport(report);
+}
+
+PBoolean H323PluginVideoCodec::SetEncodeFrameSize(unsigned width, unsigned height)
+{
+  if (width*height > PLUGIN_MAX_WIDTH*PLUGIN_MAX_HEIGHT) {
+    PTRACE(2, "PLUGIN\tCannot encode at " << width << 'x' << height << ", larger than the frame buffer");
+    return FALSE;
+  }
+
+  return H323VideoCodec::SetEncodeFrameSize(width, height);
+}
+
+PBoolean H323PluginVideoCodec::EncodePicture(const BYTE * picture, unsigned width, unsigned height,
+                                             PBoolean & intra, std::vector<PBYTEArray> & packets)
+{
+  PWaitAndSignal mutex(videoHandlerActive);
+
+  if (direction != Encoder || width*height > PLUGIN_MAX_WIDTH*PLUGIN_MAX_HEIGHT)
+    return FALSE;
+
+  if (!SetFrameSize(width, height))
+    return FALSE;
+
+  PluginCodec_Video_FrameHeader * frameHeader = (PluginCodec_Video_FrameHeader *)bufferRTP.GetPayloadPtr();
+  memcpy(OPAL_VIDEO_FRAME_DATA_PTR(frameHeader), picture, width*height*3/2);
+
+  RTP_DataFrame dst(outputDataSize);
+  PBoolean forceIntra = intra;
+
+  // The plugin is called for the same picture until it gives the last packet
+  for (PINDEX count = 0; count < MAX_PACKETS_PER_PICTURE; count++) {
+    dst.SetMinSize(outputDataSize);
+    fromLen = bufferSize;
+    toLen = outputDataSize;
+    flags = count == 0 && forceIntra ? PluginCodec_CoderForceIFrame : 0;
+
+    if ((codec->codecFunction)(codec, context, bufferRTP.GetPointer(), &fromLen, dst.GetPointer(), &toLen, &flags) == 0) {
+      PTRACE(3, "PLUGIN\tError encoding picture from plugin " << codec->descr);
+      return FALSE;
+    }
+
+    if ((flags & PluginCodec_ReturnCoderIFrame) != 0)
+      intra = TRUE;
+
+    if (toLen > (unsigned)dst.GetHeaderSize())
+      packets.push_back(PBYTEArray(dst.GetPointer(), toLen));
+
+    if ((flags & PluginCodec_ReturnCoderLastFrame) != 0)
+      return TRUE;
+  }
+
+  PTRACE(2, "PLUGIN\tPlugin " << codec->descr << " gave no last packet for a picture");
+  return FALSE;
 }
 
 PBoolean H323PluginVideoCodec::SetSupportedFormats(std::list<PVideoFrameInfo> & info)
@@ -1740,6 +2037,10 @@ PBoolean H323PluginVideoCodec::Read(BYTE * /*buffer*/, unsigned & length, RTP_Da
         return FALSE;
     }
 
+    // Sending a layer of a simulcast, encoded once for every leg on it
+    if (simulcast != NULL)
+        return simulcast->ReadPacket(*simulcastReceiver, dst, length, SIMULCAST_READ_TIMEOUT);
+
     if (rawDataChannel == NULL) {
         PTRACE(1, "PLUGIN\tNo channel to grab from, close down video transmission thread");
         return FALSE;
@@ -1807,6 +2108,15 @@ PBoolean H323PluginVideoCodec::Read(BYTE * /*buffer*/, unsigned & length, RTP_Da
         }
 #endif
 
+        // Grabbed at another size than to encode, scaled into the frame
+        unsigned grabWidth  = frameHeader->width;
+        unsigned grabHeight = frameHeader->height;
+        PBoolean scaling = encodeWidth > 0 && (grabWidth != encodeWidth || grabHeight != encodeHeight);
+        if (scaling) {
+            frameHeader->width  = encodeWidth;
+            frameHeader->height = encodeHeight;
+        }
+
         if (!SetFrameSize(frameHeader->width, frameHeader->height)) {
             PTRACE(1, "PLUGIN\tFailed to resize, close down video transmission thread");
             videoIn->EnableAccess();
@@ -1814,7 +2124,8 @@ PBoolean H323PluginVideoCodec::Read(BYTE * /*buffer*/, unsigned & length, RTP_Da
         }
 
         unsigned char * data = OPAL_VIDEO_FRAME_DATA_PTR(frameHeader);
-        if (!rawDataChannel->Read(data, bytesPerFrame)) {
+        BYTE * grabbed = scaling ? grabBuffer.GetPointer(grabWidth*grabHeight*3/2) : data;
+        if (!rawDataChannel->Read(grabbed, bytesPerFrame)) {
             PTRACE(3, "PLUGIN\tFailed to read data from video grabber");
             videoIn->EnableAccess();
             length=0;
@@ -1824,9 +2135,64 @@ PBoolean H323PluginVideoCodec::Read(BYTE * /*buffer*/, unsigned & length, RTP_Da
 
         videoIn->EnableAccess();
 
+        if (scaling && !videoConverter.Scale(grabbed, grabWidth, grabHeight, data, encodeWidth, encodeHeight)) {
+            PTRACE(1, "PLUGIN\tCannot scale " << grabWidth << 'x' << grabHeight << " grab, close down video transmission thread");
+            return FALSE;
+        }
+
         RenderFrame(data, NULL);
 
         nowFrameTick = PTimer::Tick().GetMilliSeconds();
+
+        if (rateControlEnabled) {
+            unsigned bitRate, frameTime;
+            if (!rateControl.IsOpen()) {
+                unsigned target = mediaFormat.GetOptionInteger(OpalVideoFormat::TargetBitRateKey);
+                rateControl.Open(target > 0 ? target : mediaFormat.GetOptionInteger(OpalVideoFormat::MaxBitRateKey),
+                                 mediaFormat.GetOptionInteger(OpalVideoFormat::FrameTimeKey));
+            }
+            else if (rateControl.GetUpdate(bitRate, frameTime)) {
+                PTRACE(4, "PLUGIN\tRate control now " << rateControl);
+                mediaFormat.SetOptionInteger(OpalVideoFormat::TargetBitRateKey, bitRate);
+                mediaFormat.SetOptionInteger(OpalVideoFormat::FrameTimeKey, frameTime);
+                UpdatePluginOptions(codec, context, mediaFormat);
+            }
+
+            // Frames grabbed sooner than the frame rate allows are dropped,
+            // with no marker so the RTP clock runs on to the next one sent
+            frameTime = rateControl.GetFrameTime();
+            if (lastFrameTick > 0 && frameTime > rateControl.GetBaseFrameTime() &&
+                (nowFrameTick - lastFrameTick)*90 < frameTime*9/10) {
+                length = 0;
+                dst.SetPayloadSize(0);
+                dst.SetMarker(FALSE);
+                return TRUE;
+            }
+        }
+
+        // Content is slides and screens, encoded at a low frame rate and
+        // skipped once a few frames have refined a picture that stays still
+        if (contentVideo) {
+            unsigned size = frameHeader->width*frameHeader->height*3/2;
+            PBoolean unchanged = contentPicture.GetSize() == (PINDEX)size &&
+                                 memcmp(contentPicture.GetPointer(), data, size) == 0;
+            if (unchanged)
+                contentRefines++;
+            else {
+                memcpy(contentPicture.GetPointer(size), data, size);
+                contentRefines = 0;
+            }
+
+            if (!sendIntra && lastFrameTick > 0 &&
+                ((nowFrameTick - lastFrameTick)*90 < contentFrameTime*9/10 ||
+                 (contentSkipUnchanged && unchanged && contentRefines > 3 && nowFrameTick - lastFrameTick < 2000))) {
+                length = 0;
+                dst.SetPayloadSize(0);
+                dst.SetMarker(FALSE);
+                return TRUE;
+            }
+        }
+
         lastFrameTimeRTP = (nowFrameTick - lastFrameTick)*90;
         lastFrameTick = nowFrameTick;
     }
@@ -1844,12 +2210,29 @@ PBoolean H323PluginVideoCodec::Read(BYTE * /*buffer*/, unsigned & length, RTP_Da
 
     fromLen = bufferSize;
     toLen = outputDataSize;
-    flags = sendIntra ? PluginCodec_CoderForceIFrame : 0;
 
+    // Every fast update since the last intra frame, from however many
+    // receivers share this encoder, is answered by one intra frame at most
+    // once an interval. The rest wait for it rather than each costing one.
+    PBoolean forceIntra = FALSE;
+    if (sendIntra && lastPacketSent && (lastIntraTick == 0 || nowFrameTick - lastIntraTick > FASTPICTUREINTERVAL)) {
+        if (fastUpdateRequests > 0) {
+            PTRACE(4, "PLUGIN\tAnswering " << fastUpdateRequests << " fast update request(s)");
+            fastUpdateRequests.SetValue(0);
+            EventCodecControl(codec, context, "on_fast_update", "");
+        }
+        lastIntraTick = nowFrameTick;
+        forceIntra = TRUE;
+    }
+    flags = forceIntra ? PluginCodec_CoderForceIFrame : 0;
+
+    PInt64 encodeStart = encodeLoad.IsOpen() ? H323MediaClock::GetMicroseconds() : 0;
     pluginRetVal = (codec->codecFunction)(codec, context,
                                         bufferRTP.GetPointer(), &fromLen,
                                         dst.GetPointer(), &toLen,
                                         &flags);
+    if (encodeLoad.IsOpen() && encodeLoad.AddEncodeTime(encodeStart, H323MediaClock::GetMicroseconds()))
+        SetCodecComplexity(codec, context, encodeLoad.GetComplexity());
 
     if (pluginRetVal == 0) {
         PTRACE(3,"PLUGIN\tError encoding frame from plugin " << codec->descr);
@@ -1861,6 +2244,11 @@ PBoolean H323PluginVideoCodec::Read(BYTE * /*buffer*/, unsigned & length, RTP_Da
         PTRACE(sendIntra ? 3 : 5,"PLUGIN\tSent I-Frame" << (sendIntra ? ", in response to VideoFastUpdate" : ""));
         sendIntra = false;
     }
+    else if (forceIntra && intraRefresh) {
+        // No intra frame is returned for a refresh spread over many frames
+        PTRACE(4, "PLUGIN\tStarted intra refresh in response to VideoFastUpdate");
+        sendIntra = false;
+    }
 
     if (toLen > 0)
         length = toLen - dst.GetHeaderSize();
@@ -1874,6 +2262,30 @@ PBoolean H323PluginVideoCodec::Read(BYTE * /*buffer*/, unsigned & length, RTP_Da
 
 PBoolean H323PluginVideoCodec::Open(H323Connection & connection) {
 
+    rateControlEnabled = direction == Encoder && connection.GetEndPoint().GetVideoRateControl();
+
+#ifdef H323_H239
+    if (direction == Encoder && logicalChannel != NULL &&
+        PIsDescendant(&logicalChannel->GetCapability(), H323CodecExtendedVideoCapability)) {
+        H323EndPoint & ep = connection.GetEndPoint();
+        contentVideo = TRUE;
+        contentFrameTime = ep.GetExtendedVideoFrameRate() > 0 ? 90000/ep.GetExtendedVideoFrameRate() : 0;
+        contentSkipUnchanged = ep.GetExtendedVideoSkipUnchanged();
+        PTRACE(4, "PLUGIN\tContent encoder at most " << ep.GetExtendedVideoFrameRate() << " fps"
+               << (contentSkipUnchanged ? ", skipping unchanged pictures" : ""));
+    }
+#endif
+
+    if (direction == Decoder && connection.GetEndPoint().GetVideoLoadShedding())
+        decodeLoad.Open(codec->sdpFormat != NULL ? codec->sdpFormat : "",
+                        &connection.GetEndPoint().GetVideoDecodeBudget());
+
+    if (direction == Encoder) {
+        OpenEncodeLoad(encodeLoad, codec, mediaFormat, connection);
+        if (encodeLoad.IsOpen())
+            SetCodecComplexity(codec, context, encodeLoad.GetComplexity());
+    }
+
 #ifdef H323_FRAMEBUFFER
     if (direction == Decoder && connection.HasVideoFrameBuffer())
         m_frameBuffer.SetCodec(this);
@@ -1893,7 +2305,7 @@ PBoolean H323PluginVideoCodec::Write(const BYTE * buffer, unsigned length, const
     } else
 #endif
     {
-        rtpInformation.m_recvTime = PTimer::Tick().GetMilliSeconds();
+        rtpInformation.m_recvTime = H323MediaClock::GetMilliseconds();
         rtpInformation.m_timeStamp = src.GetTimestamp();
         rtpInformation.m_clockRate = 90000;
         CalculateRTPSendTime(src.GetTimestamp(), rtpInformation.m_clockRate, rtpInformation.m_sendTime);
@@ -1941,22 +2353,37 @@ PBoolean H323PluginVideoCodec::WriteInternal(const BYTE * /*buffer*/, unsigned l
     return FALSE;
 #endif
 
-  bufferRTP.SetMinSize(outputDataSize);
   bytesPerFrame = outputDataSize;
 
 #ifdef H323_PACKET_TRACE
   CheckPacket(false,src);
 #endif
 
+  // Under load some pictures are not decoded at all
+  PBoolean timing = decodeLoad.IsOpen();
+  if (timing) {
+    decodeLoad.SetPriority(decodePriority);
+    if (!decodeLoad.StartPacket(src)) {
+      written = length;
+      return TRUE;
+    }
+    if (decodeLoad.TakeIntraRequest())
+      sendIntra = true;
+  }
+  PInt64 decodeStart = timing ? PTimer::Tick().GetMilliSeconds() : 0;
+
   fromLen = src.GetHeaderSize() + src.GetPayloadSize();
   toLen = bufferSize;
   flags=0;
 
   pluginRetVal = (codec->codecFunction)(codec, context,
                               (const BYTE *)src, &fromLen,
-                              bufferRTP.GetPointer(toLen), &toLen,
+                              GetDecodeBuffer(), &toLen,
                               &flags);
 
+  if (timing)
+    decodeLoad.AddDecodeTime(PTimer::Tick().GetMilliSeconds() - decodeStart);
+
   for(;;) {
       if (!pluginRetVal) {
         PTRACE(3,"PLUGIN\tError decoding frame from plugin " << codec->descr);
@@ -1974,14 +2401,17 @@ PBoolean H323PluginVideoCodec::WriteInternal(const BYTE * /*buffer*/, unsigned l
       }
 
       if (flags & PluginCodec_ReturnCoderLastFrame) {
-        PluginCodec_Video_FrameHeader * header = (PluginCodec_Video_FrameHeader *)(bufferRTP.GetPayloadPtr());
-        if (!header)
-            return false;
+        BYTE * buffer = decodedFrame->GetBuffer();
+        PluginCodec_Video_FrameHeader * header = (PluginCodec_Video_FrameHeader *)(buffer + PLUGIN_RTP_HEADER_SIZE);
 
         if (!SetFrameSize(header->width,header->height))
            return false;
 
-        if (!RenderFrame(OPAL_VIDEO_FRAME_DATA_PTR(header), &rtp))
+        decodedFrame->SetPicture((PINDEX)(OPAL_VIDEO_FRAME_DATA_PTR(header) - buffer),
+                                 header->width, header->height, src.GetTimestamp());
+        OnDecodedFrame(decodedFrame);
+
+        if (!RenderFrame(decodedFrame->GetData(), &rtp))
             return false;
 
         if(flags & PluginCodec_ReturnCoderMoreFrame) {
@@ -1989,7 +2419,7 @@ PBoolean H323PluginVideoCodec::WriteInternal(const BYTE * /*buffer*/, unsigned l
            flags=0;
            pluginRetVal = (codec->codecFunction)(codec, context,
                               (const BYTE *)0, &fromLen,
-                              bufferRTP.GetPointer(toLen), &toLen,
+                              GetDecodeBuffer(), &toLen,
                               &flags);
         } else
             break;
@@ -2058,8 +2488,8 @@ PBoolean H323PluginVideoCodec::SetFrameSize(int _width, int _height,int _sar_wid
     //    return FALSE;
     //}
 
-    mediaFormat.SetOptionInteger(OpalVideoFormat::FrameWidthOption,_width);
-    mediaFormat.SetOptionInteger(OpalVideoFormat::FrameHeightOption,_height);
+    mediaFormat.SetOptionInteger(OpalVideoFormat::FrameWidthKey,_width);
+    mediaFormat.SetOptionInteger(OpalVideoFormat::FrameHeightKey,_height);
     if (_width * _height > frameWidth * frameHeight)
         UpdatePluginOptions(codec,context,GetWritableMediaFormat());
 
@@ -2086,9 +2516,9 @@ PBoolean H323PluginVideoCodec::SetFrameSize(int _width, int _height,int _sar_wid
 
 unsigned H323PluginVideoCodec::GetVideoMode(void)
 {
-   if (mediaFormat.GetOptionBoolean(OpalVideoFormat::DynamicVideoQualityOption))
+   if (mediaFormat.GetOptionBoolean(OpalVideoFormat::DynamicVideoQualityKey))
       return H323VideoCodec::DynamicVideoQuality;
-   else if (mediaFormat.GetOptionBoolean(OpalVideoFormat::AdaptivePacketDelayOption))
+   else if (mediaFormat.GetOptionBoolean(OpalVideoFormat::AdaptivePacketDelayKey))
       return H323VideoCodec::AdaptivePacketDelay;
    else
       return H323VideoCodec::None;
@@ -2389,6 +2819,7 @@ class H323VideoPluginCapability : public H323VideoCapability,
         PopulateMediaFormatOptions(encoderCodec,GetWritableMediaFormat());
 
         rtpPayloadType = (RTP_DataFrame::PayloadTypes)(((_encoderCodec->flags & PluginCodec_RTPTypeMask) == PluginCodec_RTPTypeDynamic) ? RTP_DataFrame::DynamicBase : _encoderCodec->rtpPayload);
+        compareKeyValid = FALSE;
       }
 
 #if 0
@@ -2416,20 +2847,62 @@ class H323VideoPluginCapability : public H323VideoCapability,
     virtual unsigned GetSubType() const
     { return pluginSubType; }
 
+    /**The options looked at by Compare() and IsMatch() of the H.261 and
+       H.263 capabilities, so matching the capabilities of a TCS is a few
+       integer operations rather than option look ups.
+      */
+    struct CompareKey {
+      unsigned sizes;           ///< Bit per picture size with a valid MPI
+      PBoolean rfc2190;         ///< H.263 packetization
+      PBoolean rfc2429;         ///< H.263+ packetization
+      PBoolean explicitMatch;   ///< Only match the same packetization
+    };
+
+    /**Get the comparison key, worked out on first use after the media
+       format was last handed out for writing.
+      */
+    const CompareKey & GetCompareKey() const
+    {
+      if (!compareKeyValid) {
+        const OpalMediaFormat & fmt = GetMediaFormat();
+        compareKey.sizes = 0;
+        for (PINDEX i = 0; i < NumSizeBits; i++) {
+          if (IsValidMPI(fmt.GetOptionInteger(mpiKeys[i])))
+            compareKey.sizes |= 1 << i;
+        }
+        PString packetization = fmt.GetOptionString(PLUGINCODEC_MEDIA_PACKETIZATION);
+        compareKey.rfc2190 = packetization == "RFC2190";
+        compareKey.rfc2429 = packetization == "RFC2429";
+        compareKey.explicitMatch = fmt.GetOptionBoolean(H263_EXPLICIT_MATCH);
+        compareKeyValid = TRUE;
+      }
+      return compareKey;
+    }
+
+    // Reading the media format must not drop the comparison key
+    virtual const OpalMediaFormat & GetMediaFormat() const
+    { return PRemoveConst(H323VideoPluginCapability, this)->H323VideoCapability::GetWritableMediaFormat(); }
+
+    virtual OpalMediaFormat & GetWritableMediaFormat()
+    {
+      compareKeyValid = FALSE;
+      return H323VideoCapability::GetWritableMediaFormat();
+    }
+
 
     static PBoolean SetCommonOptions(OpalMediaFormat & mediaFormat, int frameWidth, int frameHeight, int frameRate)
     {
-        if (!mediaFormat.SetOptionInteger(OpalVideoFormat::FrameWidthOption, frameWidth)) {
+        if (!mediaFormat.SetOptionInteger(OpalVideoFormat::FrameWidthKey, frameWidth)) {
           // PTRACE(3,"PLUGIN Error setting " << OpalVideoFormat::FrameWidthOption << " to " << frameWidth);   BUG in PTLIB v2.11?  SH
            return FALSE;
         }
 
-        if (!mediaFormat.SetOptionInteger(OpalVideoFormat::FrameHeightOption, frameHeight)) {
+        if (!mediaFormat.SetOptionInteger(OpalVideoFormat::FrameHeightKey, frameHeight)) {
          //  PTRACE(3,"PLUGIN Error setting " << OpalVideoFormat::FrameHeightOption << " to " << frameHeight);  BUG in PTLIB v2.11?  SH
            return FALSE;
         }
 
-        if (!mediaFormat.SetOptionInteger(OpalVideoFormat::FrameTimeOption, (int)(OpalMediaFormat::VideoTimeUnits * 1000 * 100 * frameRate / 2997))){
+        if (!mediaFormat.SetOptionInteger(OpalVideoFormat::FrameTimeKey, (int)(OpalMediaFormat::VideoTimeUnits * 1000 * 100 * frameRate / 2997))){
          //  PTRACE(3,"PLUGIN Error setting " << OpalVideoFormat::FrameTimeOption << " to " << (int)(OpalMediaFormat::VideoTimeUnits * 100 * frameRate / 2997));  BUG in PTLIB v2.11? SH
            return FALSE;
         }
@@ -2484,8 +2957,8 @@ class H323VideoPluginCapability : public H323VideoCapability,
          fmt.SetOptionInteger(cif4MPI_tag,  cif4MPI );
          fmt.SetOptionInteger(cif16MPI_tag, cif16MPI);
 
-         fmt.SetOptionInteger(OpalVideoFormat::FrameWidthOption,w);
-         fmt.SetOptionInteger(OpalVideoFormat::FrameHeightOption,h);
+         fmt.SetOptionInteger(OpalVideoFormat::FrameWidthKey,w);
+         fmt.SetOptionInteger(OpalVideoFormat::FrameHeightKey,h);
          return true;
      }
 
@@ -2497,6 +2970,9 @@ class H323VideoPluginCapability : public H323VideoCapability,
 #if 0
     unsigned h323subType;   // only set if using capability without codec
 #endif
+
+    mutable CompareKey compareKey;
+    mutable PBoolean   compareKeyValid;
 };
 
 //////////////////////////////////////////////////////////////////////////////
@@ -2648,6 +3124,242 @@ PMutex & H323PluginCodecManager::GetMediaFormatMutex()
   return mutex;
 }
 
+/////////////////////////////////////////////////////////////////////////////
+
+struct H323PluginCodecContextPool
+{
+  H323PluginCodecContextPool() : size(0) { }
+
+  typedef std::vector<void *> Contexts;
+  typedef std::map<const PluginCodec_Definition *, Contexts> IdleMap;
+
+  PMutex   mutex;
+  unsigned size;
+  IdleMap  idle;
+};
+
+static H323PluginCodecContextPool & GetCodecContextPool()
+{
+  static H323PluginCodecContextPool pool;
+  return pool;
+}
+
+void H323PluginCodecManager::SetCodecContextPoolSize(unsigned size)
+{
+  H323PluginCodecContextPool & pool = GetCodecContextPool();
+  H323PluginCodecContextPool::IdleMap excess;
+
+  {
+    PWaitAndSignal m(pool.mutex);
+    pool.size = size;
+    for (H323PluginCodecContextPool::IdleMap::iterator r = pool.idle.begin(); r != pool.idle.end(); ++r) {
+      while (r->second.size() > size) {
+        excess[r->first].push_back(r->second.back());
+        r->second.pop_back();
+      }
+    }
+  }
+
+  for (H323PluginCodecContextPool::IdleMap::iterator r = excess.begin(); r != excess.end(); ++r) {
+    for (size_t i = 0; i < r->second.size(); i++)
+      (*r->first->destroyCodec)(r->first, r->second[i]);
+  }
+
+  PTRACE(3, "H323PLUGIN\tCodec context pool size set to " << size);
+}
+
+unsigned H323PluginCodecManager::GetCodecContextPoolSize()
+{
+  H323PluginCodecContextPool & pool = GetCodecContextPool();
+  PWaitAndSignal m(pool.mutex);
+  return pool.size;
+}
+
+void * H323PluginCodecManager::CreateCodecContext(const PluginCodec_Definition * codec)
+{
+  if (codec == NULL || codec->createCodec == NULL)
+    return NULL;
+
+  H323PluginCodecContextPool & pool = GetCodecContextPool();
+  {
+    PWaitAndSignal m(pool.mutex);
+    H323PluginCodecContextPool::IdleMap::iterator r = pool.idle.find(codec);
+    if (r != pool.idle.end() && !r->second.empty()) {
+      void * context = r->second.back();
+      r->second.pop_back();
+      PTRACE(5, "H323PLUGIN\tReusing " << codec->descr << " codec context");
+      return context;
+    }
+  }
+
+  return (*codec->createCodec)(codec);
+}
+
+void H323PluginCodecManager::DestroyCodecContext(const PluginCodec_Definition * codec, void * context)
+{
+  if (codec == NULL || codec->destroyCodec == NULL)
+    return;
+
+  H323PluginCodecContextPool & pool = GetCodecContextPool();
+  PluginCodec_ControlDefn * reset = context != NULL ? GetCodecControl(codec, RESET_CODEC_CONTROL) : NULL;
+  if (reset != NULL) {
+    PBoolean room;
+    {
+      PWaitAndSignal m(pool.mutex);
+      room = pool.idle[codec].size() < pool.size;
+    }
+
+    // Reset outside the lock, the codec may take a while over it
+    if (room && (*reset->control)(codec, context, RESET_CODEC_CONTROL, NULL, NULL) > 0) {
+      PWaitAndSignal m(pool.mutex);
+      H323PluginCodecContextPool::Contexts & contexts = pool.idle[codec];
+      if (contexts.size() < pool.size) {
+        contexts.push_back(context);
+        return;
+      }
+    }
+  }
+
+  (*codec->destroyCodec)(codec, context);
+}
+
+void H323PluginCodecManager::FlushCodecContexts(const PluginCodec_Definition * codec)
+{
+  H323PluginCodecContextPool & pool = GetCodecContextPool();
+  H323PluginCodecContextPool::IdleMap flushed;
+
+  {
+    PWaitAndSignal m(pool.mutex);
+    if (codec == NULL)
+      flushed.swap(pool.idle);
+    else {
+      H323PluginCodecContextPool::IdleMap::iterator r = pool.idle.find(codec);
+      if (r != pool.idle.end()) {
+        flushed[codec].swap(r->second);
+        pool.idle.erase(r);
+      }
+    }
+  }
+
+  for (H323PluginCodecContextPool::IdleMap::iterator r = flushed.begin(); r != flushed.end(); ++r) {
+    for (size_t i = 0; i < r->second.size(); i++)
+      (*r->first->destroyCodec)(r->first, r->second[i]);
+  }
+}
+
+static unsigned videoEncoderThreads = 0;
+
+void H323PluginCodecManager::SetVideoEncoderThreads(unsigned threads)
+{
+  videoEncoderThreads = threads;
+  PTRACE(3, "H323PLUGIN\tVideo encoder threads set to " << threads);
+}
+
+unsigned H323PluginCodecManager::GetVideoEncoderThreads()
+{
+  return videoEncoderThreads;
+}
+
+static PBoolean videoIntraRefresh = FALSE;
+
+void H323PluginCodecManager::SetVideoIntraRefresh(PBoolean enable)
+{
+  videoIntraRefresh = enable;
+  PTRACE(3, "H323PLUGIN\tVideo encoder intra refresh " << (enable ? "enabled" : "disabled"));
+}
+
+PBoolean H323PluginCodecManager::GetVideoIntraRefresh()
+{
+  return videoIntraRefresh;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+struct H323PluginCodecWarmUpList
+{
+  H323PluginCodecWarmUpList() : next(0), shutdown(false) { }
+
+  PReadWriteMutex mutex;     // Read while a codec is warmed up, write to change the list
+  std::vector<const PluginCodec_Definition *> codecs;
+  size_t next;               // Next codec to warm up, guarded by nextMutex
+  PMutex nextMutex;
+  bool   shutdown;
+};
+
+static H323PluginCodecWarmUpList & GetCodecWarmUpList()
+{
+  static H323PluginCodecWarmUpList list;
+  return list;
+}
+
+class H323PluginCodecWarmUpThread : public PThread
+{
+    PCLASSINFO(H323PluginCodecWarmUpThread, PThread);
+  public:
+    H323PluginCodecWarmUpThread()
+      : PThread(10000, AutoDeleteThread, LowPriority, "Codec Warm Up")
+    {
+      Resume();
+    }
+
+    void Main()
+    {
+      H323PluginCodecWarmUpList & list = GetCodecWarmUpList();
+      unsigned count = 0;
+
+      for (;;) {
+        // Codecs cannot be unregistered while the read lock is held
+        PReadWaitAndSignal m(list.mutex);
+        if (list.shutdown)
+          break;
+
+        const PluginCodec_Definition * codec;
+        {
+          PWaitAndSignal n(list.nextMutex);
+          if (list.next >= list.codecs.size())
+            break;
+          codec = list.codecs[list.next++];
+        }
+
+        void * context = H323PluginCodecManager::CreateCodecContext(codec);
+        if (context != NULL) {
+          H323PluginCodecManager::DestroyCodecContext(codec, context);
+          count++;
+        }
+        else {
+          PTRACE(2, "H323PLUGIN\tCould not warm up " << codec->descr);
+        }
+      }
+
+      PTRACE(4, "H323PLUGIN\tWarmed up " << count << " codecs");
+    }
+};
+
+void H323PluginCodecManager::WarmUpCodecs(unsigned threads)
+{
+  H323PluginCodecWarmUpList & list = GetCodecWarmUpList();
+
+  {
+    PWaitAndSignal n(list.nextMutex);
+    list.next = 0;
+  }
+
+  PTRACE(3, "H323PLUGIN\tWarming up codecs on " << threads << " threads");
+
+  while (threads-- > 0)
+    new H323PluginCodecWarmUpThread();
+}
+
+void H323PluginCodecManager::GetCodecDefinitions(std::vector<const PluginCodec_Definition *> & codecs)
+{
+  // The warm up list has every encoder and decoder registered, in pairs
+  H323PluginCodecWarmUpList & list = GetCodecWarmUpList();
+  PReadWaitAndSignal m(list.mutex);
+  codecs = list.codecs;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
 H323PluginCodecManager::H323PluginCodecManager(PPluginManager * _pluginMgr)
  : PPluginModuleManager(PLUGIN_CODEC_GET_CODEC_FN_STR, _pluginMgr), m_skipRedefinitions(false)
 {
@@ -2691,8 +3403,18 @@ H323PluginCodecManager::H323PluginCodecManager(PPluginManager * _pluginMgr)
     }
   }
 
+  // plugins that support it leave heavy initialisation to the first codec created
+  if (getenv("PTLIB_CODEC_LAZY_LOAD") != NULL) {
+    PTRACE(3, "H323PLUGIN\tPlugin codecs to load their libraries on first use");
+  }
+
   // cause the plugin manager to load all dynamic plugins
   pluginMgr->AddNotifier(PCREATE_NOTIFIER(OnLoadModule), TRUE);
+
+  // then optionally initialise the codecs in the background
+  char * warmup_threads = getenv("PTLIB_CODEC_WARMUP_THREADS");
+  if (warmup_threads != NULL && atoi(warmup_threads) > 0)
+    WarmUpCodecs(atoi(warmup_threads));
 }
 
 H323PluginCodecManager::~H323PluginCodecManager()
@@ -2701,8 +3423,20 @@ H323PluginCodecManager::~H323PluginCodecManager()
 
 void H323PluginCodecManager::OnShutdown()
 {
+  // stop the warm up before the plugins go
+  {
+    H323PluginCodecWarmUpList & list = GetCodecWarmUpList();
+    PWriteWaitAndSignal m(list.mutex);
+    list.shutdown = true;
+    list.codecs.clear();
+  }
+
+  // destroy the idle codec contexts while the plugins are still loaded
+  FlushCodecContexts();
+
   // unregister the plugin media formats
   OpalMediaFormatFactory::UnregisterAll();
+  OpalMediaFormatRegistry::Invalidate();
 
   // Unregister the codec factory
   OpalPluginCodecFactory::UnregisterAll();
@@ -2819,6 +3553,13 @@ void H323PluginCodecManager::RegisterCodecs(unsigned int count, void * _codecLis
           CreateCapabilityAndMediaFormat(&encoder, &decoder);
           found = TRUE;
 
+          {
+            H323PluginCodecWarmUpList & list = GetCodecWarmUpList();
+            PWriteWaitAndSignal m(list.mutex);
+            list.codecs.push_back(&encoder);
+            list.codecs.push_back(&decoder);
+          }
+
           PTRACE(5, "H323PLUGIN\tPlugin codec " << encoder.descr << " defined");
           break;
         }
@@ -2830,8 +3571,29 @@ void H323PluginCodecManager::RegisterCodecs(unsigned int count, void * _codecLis
   }
 }
 
-void H323PluginCodecManager::UnregisterCodecs(unsigned int /*count*/, void * /*codec*/)
+void H323PluginCodecManager::UnregisterCodecs(unsigned int count, void * _codecList)
 {
+  PluginCodec_Definition * codecList = (PluginCodec_Definition * )_codecList;
+
+  {
+    // waits for a warm up of one of these codecs to finish
+    H323PluginCodecWarmUpList & list = GetCodecWarmUpList();
+    PWriteWaitAndSignal m(list.mutex);
+    PWaitAndSignal n(list.nextMutex);
+    size_t i = 0;
+    while (i < list.codecs.size()) {
+      if (list.codecs[i] >= codecList && list.codecs[i] < codecList + count) {
+        list.codecs.erase(list.codecs.begin() + i);
+        if (i < list.next)
+          list.next--;
+      }
+      else
+        i++;
+    }
+  }
+
+  for (unsigned i = 0; i < count; i++)
+    FlushCodecContexts(&codecList[i]);
 }
 
 void H323PluginCodecManager::AddFormat(OpalMediaFormat * fmt)
@@ -3410,31 +4172,8 @@ PObject::Comparison H323H261PluginCapability::Compare(const PObject & obj) const
 
   const H323H261PluginCapability & other = (const H323H261PluginCapability &)obj;
 
-  const OpalMediaFormat & myFormat = GetMediaFormat();
-  int qcifMPI  = myFormat.GetOptionInteger(qcifMPI_tag);
-  int cifMPI   = myFormat.GetOptionInteger(cifMPI_tag);
-  int cif4MPI  = myFormat.GetOptionInteger(cif4MPI_tag);
-  int cif16MPI = myFormat.GetOptionInteger(cif16MPI_tag);
-
-  const OpalMediaFormat & otherFormat = other.GetMediaFormat();
-  int other_qcifMPI  = otherFormat.GetOptionInteger(qcifMPI_tag);
-  int other_cifMPI   = otherFormat.GetOptionInteger(cifMPI_tag);
-  int other_cif4MPI  = otherFormat.GetOptionInteger(cif4MPI_tag);
-  int other_cif16MPI = otherFormat.GetOptionInteger(cif16MPI_tag);
-
-  if ((IsValidMPI(qcifMPI) && IsValidMPI(other_qcifMPI)) ||
-      (IsValidMPI(cifMPI) && IsValidMPI(other_cifMPI)) ||
-      (IsValidMPI(cif4MPI) && IsValidMPI(other_cif4MPI)) ||
-      (IsValidMPI(cif16MPI) && IsValidMPI(other_cif16MPI)))
-           return EqualTo;
-
-  if ((!IsValidMPI(cif16MPI) && IsValidMPI(other_cif16MPI)) ||
-      (!IsValidMPI(cif4MPI) && IsValidMPI(other_cif4MPI)) ||
-      (!IsValidMPI(cifMPI) && IsValidMPI(other_cifMPI)) ||
-      (!IsValidMPI(qcifMPI) && IsValidMPI(other_qcifMPI)))
-    return LessThan;
-
-  return GreaterThan;
+  // H.261 has no SQCIF
+  return CompareSizes(GetCompareKey().sizes & ~SQCIFSizeBit, other.GetCompareKey().sizes & ~SQCIFSizeBit);
 }
 
 
@@ -3460,7 +4199,7 @@ PBoolean H323H261PluginCapability::OnSendingPDU(H245_VideoCapability & cap) cons
   }
 
   h261.m_temporalSpatialTradeOffCapability = fmt.GetOptionBoolean(h323_temporalSpatialTradeOffCapability_tag, FALSE);
-  h261.m_maxBitRate                        = (fmt.GetOptionInteger(OpalVideoFormat::MaxBitRateOption, 621700)+50)/100;
+  h261.m_maxBitRate                        = (fmt.GetOptionInteger(OpalVideoFormat::MaxBitRateKey, 621700)+50)/100;
   h261.m_stillImageTransmission            = fmt.GetOptionBoolean(h323_stillImageTransmission_tag, FALSE);
 
   return TRUE;
@@ -3479,7 +4218,7 @@ PBoolean H323H261PluginCapability::OnSendingPDU(H245_VideoMode & pdu) const
   mode.m_resolution.SetTag(qcifMPI > 0 ? H245_H261VideoMode_resolution::e_qcif
                                        : H245_H261VideoMode_resolution::e_cif);
 
-  mode.m_bitRate                = (fmt.GetOptionInteger(OpalVideoFormat::MaxBitRateOption, 621700) + 50) / 1000;
+  mode.m_bitRate                = (fmt.GetOptionInteger(OpalVideoFormat::MaxBitRateKey, 621700) + 50) / 1000;
   mode.m_stillImageTransmission = fmt.GetOptionBoolean(h323_stillImageTransmission_tag, FALSE);
 
   return TRUE;
@@ -3510,7 +4249,7 @@ PBoolean H323H261PluginCapability::OnReceivedPDU(const H245_VideoCapability & ca
       return FALSE;
   }
 
-  fmt.SetOptionInteger(OpalVideoFormat::MaxBitRateOption,          h261.m_maxBitRate*100);
+  fmt.SetOptionInteger(OpalVideoFormat::MaxBitRateKey,          h261.m_maxBitRate*100);
   fmt.SetOptionBoolean(h323_temporalSpatialTradeOffCapability_tag, h261.m_temporalSpatialTradeOffCapability);
   fmt.SetOptionBoolean(h323_stillImageTransmission_tag,            h261.m_stillImageTransmission);
 
@@ -3537,35 +4276,7 @@ PObject::Comparison H323H263PluginCapability::Compare(const PObject & obj) const
 
   const H323H263PluginCapability & other = (const H323H263PluginCapability &)obj;
 
-  const OpalMediaFormat & myFormat = GetMediaFormat();
-  int sqcifMPI = myFormat.GetOptionInteger(sqcifMPI_tag);
-  int qcifMPI  = myFormat.GetOptionInteger(qcifMPI_tag);
-  int cifMPI   = myFormat.GetOptionInteger(cifMPI_tag);
-  int cif4MPI  = myFormat.GetOptionInteger(cif4MPI_tag);
-  int cif16MPI = myFormat.GetOptionInteger(cif16MPI_tag);
-
-  const OpalMediaFormat & otherFormat = other.GetMediaFormat();
-  int other_sqcifMPI = otherFormat.GetOptionInteger(sqcifMPI_tag);
-  int other_qcifMPI  = otherFormat.GetOptionInteger(qcifMPI_tag);
-  int other_cifMPI   = otherFormat.GetOptionInteger(cifMPI_tag);
-  int other_cif4MPI  = otherFormat.GetOptionInteger(cif4MPI_tag);
-  int other_cif16MPI = otherFormat.GetOptionInteger(cif16MPI_tag);
-
-  if ((IsValidMPI(sqcifMPI) && IsValidMPI(other_sqcifMPI)) ||
-      (IsValidMPI(qcifMPI) && IsValidMPI(other_qcifMPI)) ||
-      (IsValidMPI(cifMPI) && IsValidMPI(other_cifMPI)) ||
-      (IsValidMPI(cif4MPI) && IsValidMPI(other_cif4MPI)) ||
-      (IsValidMPI(cif16MPI) && IsValidMPI(other_cif16MPI)))
-           return EqualTo;
-
-  if ((!IsValidMPI(cif16MPI) && IsValidMPI(other_cif16MPI)) ||
-      (!IsValidMPI(cif4MPI) && IsValidMPI(other_cif4MPI)) ||
-      (!IsValidMPI(cifMPI) && IsValidMPI(other_cifMPI)) ||
-      (!IsValidMPI(qcifMPI) && IsValidMPI(other_qcifMPI)) ||
-      (!IsValidMPI(sqcifMPI) && IsValidMPI(other_sqcifMPI)))
-    return LessThan;
-
-  return GreaterThan;
+  return CompareSizes(GetCompareKey().sizes, other.GetCompareKey().sizes);
 }
 
 PBoolean H323H263PluginCapability::IsMatch(const PASN_Choice & subTypePDU) const
@@ -3574,21 +4285,19 @@ PBoolean H323H263PluginCapability::IsMatch(const PASN_Choice & subTypePDU) const
       return false;
 
   const H245_H263VideoCapability & cap = (const H245_H263VideoCapability &)subTypePDU.GetObject();
-  const OpalMediaFormat & format = GetMediaFormat();
-  PString packetization = format.GetOptionString(PLUGINCODEC_MEDIA_PACKETIZATION);
-  PBoolean explicitMatch = format.GetOptionBoolean(H263_EXPLICIT_MATCH);
+  const CompareKey & key = GetCompareKey();
 
   // By the standard the method to distinguish H.263 and H.263+ is by the packetization element
   // however some endpoints do not include the packetization element so the common practise indicator
   // is the inclusion of the the h263Options field.
-  if (packetization == "RFC2429" && cap.HasOptionalField(H245_H263VideoCapability::e_h263Options))
+  if (key.rfc2429 && cap.HasOptionalField(H245_H263VideoCapability::e_h263Options))
       return true;
 
   // H.263 Exact Match..
-  if (packetization == "RFC2190" && !cap.HasOptionalField(H245_H263VideoCapability::e_h263Options))
+  if (key.rfc2190 && !cap.HasOptionalField(H245_H263VideoCapability::e_h263Options))
       return true;
 
-  return !explicitMatch;
+  return !key.explicitMatch;
 }
 
 static void SetTransmittedCap(const OpalMediaFormat & mediaFormat,
@@ -3704,7 +4413,7 @@ PBoolean H323H263PluginCapability::OnSendingPDU(H245_VideoCapability & cap) cons
   SetTransmittedCap(fmt, cap, cif4MPI_tag,  H245_H263VideoCapability::e_cif4MPI,  h263.m_cif4MPI,  H245_H263VideoCapability::e_slowCif4MPI,  h263.m_slowCif4MPI);
   SetTransmittedCap(fmt, cap, cif16MPI_tag, H245_H263VideoCapability::e_cif16MPI, h263.m_cif16MPI, H245_H263VideoCapability::e_slowCif16MPI, h263.m_slowCif16MPI);
 
-  h263.m_maxBitRate                        = (fmt.GetOptionInteger(OpalVideoFormat::MaxBitRateOption, 327600) + 50) / 100;
+  h263.m_maxBitRate                        = (fmt.GetOptionInteger(OpalVideoFormat::MaxBitRateKey, 327600) + 50) / 100;
   h263.m_temporalSpatialTradeOffCapability = fmt.GetOptionBoolean(h323_temporalSpatialTradeOffCapability_tag, FALSE);
   h263.m_unrestrictedVector                = fmt.GetOptionBoolean(h323_unrestrictedVector_tag, FALSE);
   h263.m_arithmeticCoding                  = fmt.GetOptionBoolean(h323_arithmeticCoding_tag, FALSE);
@@ -3753,7 +4462,7 @@ PBoolean H323H263PluginCapability::OnSendingPDU(H245_VideoMode & pdu) const
                 :(qcifMPI ? H245_H263VideoMode_resolution::e_qcif
             : H245_H263VideoMode_resolution::e_sqcif))));
 
-  mode.m_bitRate              = (fmt.GetOptionInteger(OpalVideoFormat::MaxBitRateOption, 327600) + 50) / 100;
+  mode.m_bitRate              = (fmt.GetOptionInteger(OpalVideoFormat::MaxBitRateKey, 327600) + 50) / 100;
   mode.m_unrestrictedVector   = fmt.GetOptionBoolean(h323_unrestrictedVector_tag, FALSE);
   mode.m_arithmeticCoding     = fmt.GetOptionBoolean(h323_arithmeticCoding_tag, FALSE);
   mode.m_advancedPrediction   = fmt.GetOptionBoolean(h323_advancedPrediction_tag, FALSE);
@@ -3891,7 +4600,7 @@ PBoolean H323H263PluginCapability::OnReceivedPDU(const H245_VideoCapability & ca
   if (!SetReceivedH263Cap(fmt, cap, cif16MPI_tag, H245_H263VideoCapability::e_cif16MPI, h263.m_cif16MPI, H245_H263VideoCapability::e_slowCif16MPI, h263.m_slowCif16MPI, CIF16_WIDTH, CIF16_HEIGHT, formatDefined))
     return FALSE;
 
-  if (!fmt.SetOptionInteger(OpalVideoFormat::MaxBitRateOption, h263.m_maxBitRate*100))
+  if (!fmt.SetOptionInteger(OpalVideoFormat::MaxBitRateKey, h263.m_maxBitRate*100))
     return FALSE;
 
   fmt.SetOptionBoolean(h323_unrestrictedVector_tag,      h263.m_unrestrictedVector);
@@ -4046,8 +4755,11 @@ void H323PluginCodecManager::Bootstrap()
 
 void H323PluginCodecManager::Reboot()
 {
+      FlushCodecContexts();
+
       // unregister the plugin media formats
       OpalMediaFormatFactory::UnregisterAll();
+      OpalMediaFormatRegistry::Invalidate();
 
       // Unregister the codec factory
       OpalPluginCodecFactory::UnregisterAll();
@@ -0,0 +1,650 @@
+/*
+ * h323procgroup.cxx
+ *
+ * Endpoint processes sharing one gatekeeper registration
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "h323procgroup.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#include "h323procgroup.h"
+#include "h323ep.h"
+#include "h323mediaclock.h"
+
+#include <ptclib/random.h>
+
+#define new PNEW
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323ProcessRelay::H323ProcessRelay(H323EndPoint & ep)
+  : endpoint(ep),
+    gatekeeper(NULL),
+    workerTimeToLive(30),
+    readThread(NULL),
+    nextSequenceNumber(PRandom::Number()%65536),
+    shutdown(FALSE)
+{
+}
+
+
+H323ProcessRelay::~H323ProcessRelay()
+{
+  Close();
+}
+
+
+PBoolean H323ProcessRelay::Open(const H323TransportAddress & address)
+{
+  Close();
+
+  PIPSocket::Address ip;
+  WORD port = H225_RAS::DefaultRasUdpPort;
+  if (!address.GetIpAndPort(ip, port, "udp")) {
+    PTRACE(1, "ProcRelay\tInvalid relay address " << address);
+    return FALSE;
+  }
+
+  if (ip.IsAny())
+    ip = PIPSocket::Address(127, 0, 0, 1);
+
+  if (!socket.Listen(ip, 0, port)) {
+    PTRACE(1, "ProcRelay\tCould not listen on " << ip << ':' << port << ": " << socket.GetErrorText());
+    return FALSE;
+  }
+
+  // The timeout only lets the thread see the shutdown
+  socket.SetReadTimeout(1000);
+  shutdown = FALSE;
+
+  readThread = PThread::Create(PCREATE_NOTIFIER(ReadMain), 0,
+                               PThread::NoAutoDeleteThread,
+                               PThread::HighPriority,
+                               "ProcRelay");
+
+  supervisor.SetNotifier(PCREATE_NOTIFIER(Supervise));
+  supervisor.RunContinuous(5000);
+
+  PTRACE(3, "ProcRelay\tRelaying RAS for worker processes on " << ip << ':' << port);
+  return TRUE;
+}
+
+
+void H323ProcessRelay::Close()
+{
+  supervisor.Stop();
+
+  if (readThread != NULL) {
+    shutdown = TRUE;
+    socket.Close();
+    PAssert(readThread->WaitForTermination(10000), "Process relay thread did not terminate");
+    delete readThread;
+    readThread = NULL;
+  }
+
+  PWaitAndSignal m(mutex);
+  workers.clear();
+  calls.clear();
+  toGatekeeper.clear();
+  toWorker.clear();
+}
+
+
+H323TransportAddress H323ProcessRelay::GetAddress() const
+{
+  PIPSocket::Address ip;
+  WORD port = 0;
+  if (!((PUDPSocket &)socket).GetLocalAddress(ip, port))
+    return H323TransportAddress();
+  return H323TransportAddress(ip, port);
+}
+
+
+PINDEX H323ProcessRelay::GetWorkerCount() const
+{
+  PWaitAndSignal m(mutex);
+  return workers.size();
+}
+
+
+PINDEX H323ProcessRelay::GetCallCount() const
+{
+  PWaitAndSignal m(mutex);
+  return calls.size();
+}
+
+
+void H323ProcessRelay::SetGatekeeper(H323ProcessGatekeeper * gk)
+{
+  PWaitAndSignal m(mutex);
+
+  gatekeeper = gk;
+
+  // Answers from another gatekeeper would not match
+  toGatekeeper.clear();
+}
+
+
+void H323ProcessRelay::OnWorkerRegistered(const H323TransportAddress & PTRACE_PARAM(worker))
+{
+  PTRACE(3, "ProcRelay\tWorker " << worker << " registered");
+}
+
+
+void H323ProcessRelay::OnWorkerRemoved(const H323TransportAddress & PTRACE_PARAM(worker))
+{
+  PTRACE(3, "ProcRelay\tWorker " << worker << " removed");
+}
+
+
+PString H323ProcessRelay::GetCallKey(const H225_CallIdentifier & id)
+{
+  return OpalGloballyUniqueID(id.m_guid).AsString();
+}
+
+
+#define SEQUENCE_NUMBER_CASE(tag, type) \
+    case H225_RasMessage::tag : \
+      return &((type &)pdu).m_requestSeqNum
+
+PASN_Integer * H323ProcessRelay::GetSequenceNumber(H323RasPDU & pdu)
+{
+  switch (pdu.GetTag()) {
+    SEQUENCE_NUMBER_CASE(e_admissionRequest,     H225_AdmissionRequest);
+    SEQUENCE_NUMBER_CASE(e_admissionConfirm,     H225_AdmissionConfirm);
+    SEQUENCE_NUMBER_CASE(e_admissionReject,      H225_AdmissionReject);
+    SEQUENCE_NUMBER_CASE(e_bandwidthRequest,     H225_BandwidthRequest);
+    SEQUENCE_NUMBER_CASE(e_bandwidthConfirm,     H225_BandwidthConfirm);
+    SEQUENCE_NUMBER_CASE(e_bandwidthReject,      H225_BandwidthReject);
+    SEQUENCE_NUMBER_CASE(e_disengageRequest,     H225_DisengageRequest);
+    SEQUENCE_NUMBER_CASE(e_disengageConfirm,     H225_DisengageConfirm);
+    SEQUENCE_NUMBER_CASE(e_disengageReject,      H225_DisengageReject);
+    SEQUENCE_NUMBER_CASE(e_locationRequest,      H225_LocationRequest);
+    SEQUENCE_NUMBER_CASE(e_locationConfirm,      H225_LocationConfirm);
+    SEQUENCE_NUMBER_CASE(e_locationReject,       H225_LocationReject);
+    SEQUENCE_NUMBER_CASE(e_infoRequest,          H225_InfoRequest);
+    SEQUENCE_NUMBER_CASE(e_infoRequestResponse,  H225_InfoRequestResponse);
+    SEQUENCE_NUMBER_CASE(e_infoRequestAck,       H225_InfoRequestAck);
+    SEQUENCE_NUMBER_CASE(e_infoRequestNak,       H225_InfoRequestNak);
+    SEQUENCE_NUMBER_CASE(e_requestInProgress,    H225_RequestInProgress);
+  }
+  return NULL;
+}
+
+#undef SEQUENCE_NUMBER_CASE
+
+
+PBoolean H323ProcessRelay::SendTo(H323RasPDU & pdu, const PIPSocket::Address & address, WORD port)
+{
+  PPER_Stream strm;
+  pdu.Encode(strm);
+  strm.CompleteEncoding();
+
+  if (socket.WriteTo(strm.GetPointer(), strm.GetSize(), address, port))
+    return TRUE;
+
+  PTRACE(2, "ProcRelay\tCould not send to worker " << address << ':' << port << ": " << socket.GetErrorText());
+  return FALSE;
+}
+
+
+PBoolean H323ProcessRelay::SendToWorker(H323RasPDU & pdu, const PString & worker)
+{
+  std::map<PString, Worker>::iterator it = workers.find(worker);
+  if (it == workers.end()) {
+    PTRACE(3, "ProcRelay\tWorker " << worker << " gone, " << pdu.GetTagName() << " dropped");
+    return FALSE;
+  }
+
+  return SendTo(pdu, it->second.address, it->second.port);
+}
+
+
+void H323ProcessRelay::ReadMain(PThread &, H323_INT)
+{
+  BYTE buffer[4096];
+
+  while (!shutdown) {
+    PIPSocket::Address address;
+    WORD port;
+    if (!socket.ReadFrom(buffer, sizeof(buffer), address, port)) {
+      if (!socket.IsOpen())
+        break;
+      continue;  // Timeout, or ICMP error of a worker gone
+    }
+
+    PPER_Stream strm(buffer, socket.GetLastReadCount());
+    H323RasPDU pdu;
+    if (!pdu.Decode(strm)) {
+      PTRACE(2, "ProcRelay\tUndecodable PDU from " << address << ':' << port);
+      continue;
+    }
+
+    OnWorkerPDU(pdu, address, port);
+  }
+
+  PTRACE(4, "ProcRelay\tRead thread ended");
+}
+
+
+void H323ProcessRelay::OnWorkerPDU(H323RasPDU & pdu, const PIPSocket::Address & address, WORD port)
+{
+  PString worker = H323TransportAddress(address, port);
+
+  PWaitAndSignal m(mutex);
+
+  H323RasPDU reply;
+
+  switch (pdu.GetTag()) {
+    case H225_RasMessage::e_gatekeeperRequest :
+    {
+      const H225_GatekeeperRequest & grq = pdu;
+      if (gatekeeper == NULL || !gatekeeper->IsRegistered())
+        reply.BuildGatekeeperReject(grq.m_requestSeqNum, H225_GatekeeperRejectReason::e_resourceUnavailable);
+      else {
+        H225_GatekeeperConfirm & gcf = reply.BuildGatekeeperConfirm(grq.m_requestSeqNum);
+        gcf.IncludeOptionalField(H225_GatekeeperConfirm::e_gatekeeperIdentifier);
+        gcf.m_gatekeeperIdentifier = gatekeeper->GetIdentifier();
+        GetAddress().SetPDU(gcf.m_rasAddress);
+      }
+      SendTo(reply, address, port);
+      return;
+    }
+
+    case H225_RasMessage::e_registrationRequest :
+    {
+      const H225_RegistrationRequest & rrq = pdu;
+      if (gatekeeper == NULL || !gatekeeper->IsRegistered()) {
+        reply.BuildRegistrationReject(rrq.m_requestSeqNum, H225_RegistrationRejectReason::e_resourceUnavailable);
+        SendTo(reply, address, port);
+        return;
+      }
+
+      H225_RegistrationConfirm & rcf = reply.BuildRegistrationConfirm(rrq.m_requestSeqNum);
+      rcf.m_callSignalAddress = rrq.m_callSignalAddress;
+      rcf.m_endpointIdentifier = gatekeeper->GetEndpointIdentifier().GetValue();
+      rcf.IncludeOptionalField(H225_RegistrationConfirm::e_gatekeeperIdentifier);
+      rcf.m_gatekeeperIdentifier = gatekeeper->GetIdentifier();
+      rcf.IncludeOptionalField(H225_RegistrationConfirm::e_timeToLive);
+      rcf.m_timeToLive = workerTimeToLive;
+      SendTo(reply, address, port);
+
+      Worker & info = workers[worker];
+      PBoolean isNew = info.lastSeen == 0;
+      info.address = address;
+      info.port = port;
+      info.lastSeen = H323MediaClock::GetMicroseconds();
+      if (isNew)
+        OnWorkerRegistered(worker);
+      return;
+    }
+
+    case H225_RasMessage::e_unregistrationRequest :
+    {
+      const H225_UnregistrationRequest & urq = pdu;
+      reply.BuildUnregistrationConfirm(urq.m_requestSeqNum);
+      SendTo(reply, address, port);
+      RemoveWorker(worker);
+      return;
+    }
+
+    case H225_RasMessage::e_infoRequestResponse :
+      // Either the answer to an IRQ of the gatekeeper, or unsolicited
+      if (OnWorkerResponse(pdu))
+        return;
+      // Fall through
+
+    case H225_RasMessage::e_admissionRequest :
+    case H225_RasMessage::e_bandwidthRequest :
+    case H225_RasMessage::e_disengageRequest :
+    case H225_RasMessage::e_locationRequest :
+      if (workers.find(worker) == workers.end()) {
+        PTRACE(2, "ProcRelay\t" << pdu.GetTagName() << " from unregistered worker " << worker);
+        return;
+      }
+      OnWorkerRequest(pdu, worker);
+      return;
+
+    default :
+      if (!OnWorkerResponse(pdu))
+        PTRACE(2, "ProcRelay\tUnexpected " << pdu.GetTagName() << " from worker " << worker);
+  }
+}
+
+
+void H323ProcessRelay::OnWorkerRequest(H323RasPDU & pdu, const PString & worker)
+{
+  if (gatekeeper == NULL) {
+    PTRACE(2, "ProcRelay\tNo gatekeeper, " << pdu.GetTagName() << " from worker " << worker << " dropped");
+    return;
+  }
+
+  PASN_Integer & sequenceNumber = *GetSequenceNumber(pdu);
+  unsigned forwarded = gatekeeper->AllocateSequenceNumber();
+
+  Pending & pending = toGatekeeper[forwarded];
+  pending.worker = worker;
+  pending.sequenceNumber = sequenceNumber;
+  pending.started = H323MediaClock::GetMicroseconds();
+  sequenceNumber = forwarded;
+
+  switch (pdu.GetTag()) {
+    case H225_RasMessage::e_admissionRequest :
+    {
+      const H225_AdmissionRequest & arq = pdu;
+      pending.call = GetCallKey(arq.m_callIdentifier);
+      Call & call = calls[pending.call];
+      call.worker = worker;
+      call.conferenceID = arq.m_conferenceID;
+      call.callIdentifier = arq.m_callIdentifier;
+      call.callReference = arq.m_callReferenceValue;
+      call.answerCall = arq.m_answerCall;
+      break;
+    }
+
+    case H225_RasMessage::e_disengageRequest :
+      calls.erase(GetCallKey(((const H225_DisengageRequest &)pdu).m_callIdentifier));
+      break;
+  }
+
+  if (!gatekeeper->ForwardPDU(pdu))
+    toGatekeeper.erase(forwarded);
+}
+
+
+PBoolean H323ProcessRelay::OnWorkerResponse(H323RasPDU & pdu)
+{
+  PASN_Integer * sequenceNumber = GetSequenceNumber(pdu);
+  if (sequenceNumber == NULL)
+    return FALSE;
+
+  std::map<unsigned, Pending>::iterator it = toWorker.find(*sequenceNumber);
+  if (it == toWorker.end())
+    return FALSE;
+
+  *sequenceNumber = it->second.sequenceNumber;
+  if (pdu.GetTag() != H225_RasMessage::e_requestInProgress)
+    toWorker.erase(it);
+
+  if (gatekeeper != NULL)
+    gatekeeper->ForwardPDU(pdu);
+  return TRUE;
+}
+
+
+PBoolean H323ProcessRelay::OnGatekeeperPDU(const H323RasPDU & pdu)
+{
+  PWaitAndSignal m(mutex);
+
+  switch (pdu.GetTag()) {
+    case H225_RasMessage::e_admissionConfirm :
+    case H225_RasMessage::e_admissionReject :
+    case H225_RasMessage::e_bandwidthConfirm :
+    case H225_RasMessage::e_bandwidthReject :
+    case H225_RasMessage::e_disengageConfirm :
+    case H225_RasMessage::e_disengageReject :
+    case H225_RasMessage::e_locationConfirm :
+    case H225_RasMessage::e_locationReject :
+    case H225_RasMessage::e_infoRequestAck :
+    case H225_RasMessage::e_infoRequestNak :
+    case H225_RasMessage::e_requestInProgress :
+    {
+      std::map<unsigned, Pending>::iterator it = toGatekeeper.find(pdu.GetSequenceNumber());
+      if (it == toGatekeeper.end())
+        return FALSE;  // Answer to the coordinator itself
+
+      H323RasPDU response(pdu);
+      *GetSequenceNumber(response) = it->second.sequenceNumber;
+      PString worker = it->second.worker;
+
+      if (pdu.GetTag() == H225_RasMessage::e_admissionReject)
+        calls.erase(it->second.call);
+      if (pdu.GetTag() != H225_RasMessage::e_requestInProgress)
+        toGatekeeper.erase(it);
+
+      // No worker waits for the DRQ sent for one that is gone
+      if (!worker.IsEmpty())
+        SendToWorker(response, worker);
+      return TRUE;
+    }
+
+    case H225_RasMessage::e_disengageRequest :
+    case H225_RasMessage::e_bandwidthRequest :
+    case H225_RasMessage::e_infoRequest :
+    {
+      PString key;
+      if (pdu.GetTag() == H225_RasMessage::e_disengageRequest)
+        key = GetCallKey(((const H225_DisengageRequest &)pdu).m_callIdentifier);
+      else if (pdu.GetTag() == H225_RasMessage::e_bandwidthRequest)
+        key = GetCallKey(((const H225_BandwidthRequest &)pdu).m_callIdentifier);
+      else {
+        const H225_InfoRequest & irq = pdu;
+        if (!irq.HasOptionalField(H225_InfoRequest::e_callIdentifier))
+          return FALSE;  // All calls, answered by the coordinator
+        key = GetCallKey(irq.m_callIdentifier);
+      }
+
+      std::map<PString, Call>::iterator call = calls.find(key);
+      if (call == calls.end())
+        return FALSE;
+
+      unsigned forwarded = nextSequenceNumber++ % 65536;
+      Pending & pending = toWorker[forwarded];
+      pending.worker = call->second.worker;
+      pending.sequenceNumber = pdu.GetSequenceNumber();
+      pending.started = H323MediaClock::GetMicroseconds();
+
+      H323RasPDU request(pdu);
+      *GetSequenceNumber(request) = forwarded;
+      SendToWorker(request, call->second.worker);
+
+      if (pdu.GetTag() == H225_RasMessage::e_disengageRequest)
+        calls.erase(call);
+      return TRUE;
+    }
+
+    default :
+      return FALSE;
+  }
+}
+
+
+void H323ProcessRelay::RemoveWorker(const PString & worker)
+{
+  std::map<PString, Worker>::iterator it = workers.find(worker);
+  if (it == workers.end())
+    return;
+
+  std::map<PString, Call>::iterator call = calls.begin();
+  while (call != calls.end()) {
+    if (call->second.worker == worker) {
+      Disengage(call->second);
+      calls.erase(call++);
+    }
+    else
+      ++call;
+  }
+
+  workers.erase(it);
+  OnWorkerRemoved(worker);
+}
+
+
+void H323ProcessRelay::Disengage(const Call & call)
+{
+  if (gatekeeper == NULL)
+    return;
+
+  PTRACE(3, "ProcRelay\tDisengaging call of worker " << call.worker << " that is gone");
+
+  unsigned sequenceNumber = gatekeeper->AllocateSequenceNumber();
+
+  H323RasPDU pdu;
+  H225_DisengageRequest & drq = pdu.BuildDisengageRequest(sequenceNumber);
+  drq.m_endpointIdentifier = gatekeeper->GetEndpointIdentifier().GetValue();
+  drq.m_conferenceID = call.conferenceID;
+  drq.m_callReferenceValue = call.callReference;
+  drq.m_disengageReason.SetTag(H225_DisengageReason::e_forcedDrop);
+  drq.IncludeOptionalField(H225_DisengageRequest::e_callIdentifier);
+  drq.m_callIdentifier = call.callIdentifier;
+  drq.IncludeOptionalField(H225_DisengageRequest::e_answeredCall);
+  drq.m_answeredCall = call.answerCall;
+
+  Pending & pending = toGatekeeper[sequenceNumber];
+  pending.sequenceNumber = sequenceNumber;
+  pending.started = H323MediaClock::GetMicroseconds();
+
+  gatekeeper->ForwardPDU(pdu);
+}
+
+
+void H323ProcessRelay::Supervise(PTimer &, H323_INT)
+{
+  PWaitAndSignal m(mutex);
+
+  PInt64 now = H323MediaClock::GetMicroseconds();
+  PInt64 lostAfter = (PInt64)workerTimeToLive*2000000;
+
+  PStringList lost;
+  for (std::map<PString, Worker>::iterator it = workers.begin(); it != workers.end(); ++it) {
+    if (now - it->second.lastSeen > lostAfter)
+      lost.AppendString(it->first);
+  }
+
+  for (PINDEX i = 0; i < lost.GetSize(); i++) {
+    PTRACE(2, "ProcRelay\tWorker " << lost[i] << " stopped refreshing its registration");
+    RemoveWorker(lost[i]);
+  }
+
+  // Requests never answered, by then both ends have given up
+  std::map<unsigned, Pending>::iterator it = toGatekeeper.begin();
+  while (it != toGatekeeper.end()) {
+    if (now - it->second.started > 60000000)
+      toGatekeeper.erase(it++);
+    else
+      ++it;
+  }
+
+  it = toWorker.begin();
+  while (it != toWorker.end()) {
+    if (now - it->second.started > 60000000)
+      toWorker.erase(it++);
+    else
+      ++it;
+  }
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323ProcessGatekeeper::H323ProcessGatekeeper(H323EndPoint & ep,
+                                             H323Transport * trans,
+                                             H323ProcessRelay & processRelay)
+  : H323Gatekeeper(ep, trans),
+    relay(processRelay)
+{
+  relay.SetGatekeeper(this);
+}
+
+
+H323ProcessGatekeeper::~H323ProcessGatekeeper()
+{
+  relay.SetGatekeeper(NULL);
+}
+
+
+PBoolean H323ProcessGatekeeper::HandleTransaction(const PASN_Object & rawPDU)
+{
+  if (relay.OnGatekeeperPDU((const H323RasPDU &)rawPDU))
+    return FALSE;
+
+  return H323Gatekeeper::HandleTransaction(rawPDU);
+}
+
+
+template <class PDU> static void PrepareTokens(H323RasPDU & pdu, PDU & message)
+{
+  message.m_tokens.SetSize(0);
+  message.m_cryptoTokens.SetSize(0);
+  message.RemoveOptionalField(PDU::e_tokens);
+  message.RemoveOptionalField(PDU::e_cryptoTokens);
+  pdu.Prepare(message.m_tokens, PDU::e_tokens, message.m_cryptoTokens, PDU::e_cryptoTokens);
+}
+
+
+PBoolean H323ProcessGatekeeper::ForwardPDU(H323RasPDU & pdu)
+{
+  if (PAssertNULL(transport) == NULL)
+    return FALSE;
+
+  // The worker tokens were made for the worker sequence number
+  pdu.SetAuthenticators(authenticators);
+
+  switch (pdu.GetTag()) {
+    case H225_RasMessage::e_admissionRequest :
+      PrepareTokens(pdu, (H225_AdmissionRequest &)pdu);
+      break;
+    case H225_RasMessage::e_bandwidthRequest :
+      PrepareTokens(pdu, (H225_BandwidthRequest &)pdu);
+      break;
+    case H225_RasMessage::e_bandwidthConfirm :
+      PrepareTokens(pdu, (H225_BandwidthConfirm &)pdu);
+      break;
+    case H225_RasMessage::e_bandwidthReject :
+      PrepareTokens(pdu, (H225_BandwidthReject &)pdu);
+      break;
+    case H225_RasMessage::e_disengageRequest :
+      PrepareTokens(pdu, (H225_DisengageRequest &)pdu);
+      break;
+    case H225_RasMessage::e_disengageConfirm :
+      PrepareTokens(pdu, (H225_DisengageConfirm &)pdu);
+      break;
+    case H225_RasMessage::e_disengageReject :
+      PrepareTokens(pdu, (H225_DisengageReject &)pdu);
+      break;
+    case H225_RasMessage::e_locationRequest :
+      PrepareTokens(pdu, (H225_LocationRequest &)pdu);
+      break;
+    case H225_RasMessage::e_infoRequestResponse :
+      PrepareTokens(pdu, (H225_InfoRequestResponse &)pdu);
+      break;
+  }
+
+  // Not WritePDU(), the worker has added its own H.460 features already
+  PWaitAndSignal mutex(pduWriteMutex);
+  return pdu.Write(*transport);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,446 @@
+/*
+ * h323resolver.cxx
+ *
+ * Caching DNS resolver for call parties
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "h323resolver.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#if P_DNS
+
+#include "ptlib_extras.h"
+#include "h323resolver.h"
+
+#include <ptclib/pdns.h>
+#include <ptclib/enum.h>
+
+#define new PNEW
+
+/* Number of cached answers above which expired ones are removed */
+#define RESOLVER_PRUNE_SIZE 1000
+
+/* Cached answers asked for at least this often are looked up again before
+   they expire */
+#define RESOLVER_HOT_HITS   2
+
+
+// PTLib containers share their contents on assignment, the cache keeps its own
+static void CopyResults(const PStringList & from, PStringList & to)
+{
+  to = PStringList();
+  for (PINDEX i = 0; i < from.GetSize(); i++)
+    to.AppendString(from[i]);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+// A Lookup() waiting on the same query in flight on another thread
+class H323DNSResolverWaiter : public PObject
+{
+    PCLASSINFO(H323DNSResolverWaiter, PObject);
+  public:
+    H323DNSResolverWaiter()
+      : found(FALSE)
+    {
+    }
+
+    PNotifier GetNotifier()
+    {
+      return PCREATE_NOTIFIER(OnAnswer);
+    }
+
+    PStringList results;
+    PBoolean    found;
+    PSyncPoint  answered;
+
+  protected:
+    PDECLARE_NOTIFIER(H323DNSResolver::Query, H323DNSResolverWaiter, OnAnswer);
+};
+
+
+void H323DNSResolverWaiter::OnAnswer(H323DNSResolver::Query & query, H323_INT)
+{
+  results = query.results;
+  found = query.found;
+  answered.Signal();
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323DNSResolver::H323DNSResolver(const PTimeInterval & ttl,
+                                 const PTimeInterval & negativeTtl,
+                                 PINDEX _maxWorkers)
+  : cacheTime(ttl),
+    negativeCacheTime(negativeTtl),
+    maxWorkers(_maxWorkers > 0 ? _maxWorkers : 1),
+    cacheHits(0),
+    cacheMisses(0),
+    prefetches(0),
+    idleWorkers(0),
+    stopping(FALSE),
+    queued(0, INT_MAX)
+{
+  PTRACE(3, "DNS\tCreated resolver, cache time " << cacheTime << ", negative " << negativeCacheTime);
+}
+
+
+H323DNSResolver::~H323DNSResolver()
+{
+  mutex.Wait();
+  stopping = TRUE;
+  std::vector<PThread *> threads = workers;
+  workers.clear();
+  std::list<Job> jobs = queue;
+  queue.clear();
+  mutex.Signal();
+
+  for (size_t i = 0; i < threads.size(); i++)
+    queued.Signal();
+  for (size_t i = 0; i < threads.size(); i++) {
+    threads[i]->WaitForTermination();
+    delete threads[i];
+  }
+
+  // Anything still queued is answered not found so callers are not left waiting
+  for (std::list<Job>::iterator it = jobs.begin(); it != jobs.end(); ++it)
+    Complete(MakeKey(it->type, it->name, it->service), FALSE, PStringList());
+
+  PTRACE(3, "DNS\tDeleted resolver, " << cacheHits << " hits, " << cacheMisses << " misses");
+}
+
+
+PString H323DNSResolver::MakeKey(QueryType type, const PString & name, const PString & service)
+{
+  // DNS names are not case sensitive
+  return PString(PString::Unsigned, type) + '\n' + service.ToLower() + '\n' + name.ToLower();
+}
+
+
+void H323DNSResolver::SetCacheTime(const PTimeInterval & ttl, const PTimeInterval & negativeTtl)
+{
+  PWaitAndSignal m(mutex);
+  cacheTime = ttl;
+  negativeCacheTime = negativeTtl;
+  cache.clear();
+}
+
+
+void H323DNSResolver::InvalidateAll()
+{
+  PWaitAndSignal m(mutex);
+  cache.clear();
+}
+
+
+PBoolean H323DNSResolver::FindCached(const PString & key, const Job & job, PStringList & results, PBoolean & found)
+{
+  // Called with the mutex held
+  CacheMap::iterator it = cache.find(key);
+  if (it == cache.end())
+    return FALSE;
+
+  PInt64 now = PTimer::Tick().GetMilliSeconds();
+  if (it->second.expires <= now) {
+    cache.erase(it);
+    return FALSE;
+  }
+
+  CacheEntry & entry = it->second;
+  cacheHits++;
+  entry.hits++;
+  CopyResults(entry.results, results);
+  found = entry.found;
+
+  // Renew a hot answer before it expires, at most once
+  if (entry.found && entry.hits >= RESOLVER_HOT_HITS && now >= entry.refreshTime &&
+      pending.find(key) == pending.end()) {
+    PTRACE(4, "DNS\tPrefetching " << job.service << job.name);
+    prefetches++;
+    entry.refreshTime = entry.expires;
+    pending[key];
+    Queue(job);
+  }
+
+  return TRUE;
+}
+
+
+void H323DNSResolver::Queue(const Job & job)
+{
+  // Called with the mutex held
+  queue.push_back(job);
+
+  if (idleWorkers == 0 && (PINDEX)workers.size() < maxWorkers)
+    workers.push_back(PThread::Create(PCREATE_NOTIFIER(WorkerMain), 0,
+                                      PThread::NoAutoDeleteThread,
+                                      PThread::NormalPriority,
+                                      "DNS Resolver:%x"));
+
+  queued.Signal();
+}
+
+
+PBoolean H323DNSResolver::Lookup(QueryType type,
+                                 const PString & name,
+                                 const PString & service,
+                                 PStringList & results)
+{
+  Job job;
+  job.type = type;
+  job.name = name;
+  job.service = service;
+  PString key = MakeKey(type, name, service);
+
+  mutex.Wait();
+
+  PBoolean found;
+  if (FindCached(key, job, results, found)) {
+    mutex.Signal();
+    PTRACE(4, "DNS\tCached " << service << name << (found ? " found" : " not found"));
+    return found;
+  }
+
+  PendingMap::iterator it = pending.find(key);
+  if (it != pending.end()) {
+    // Sent already, wait for that answer
+    H323DNSResolverWaiter waiter;
+    Query * query = new Query;
+    query->type = type;
+    query->name = name;
+    query->service = service;
+    query->notifier = waiter.GetNotifier();
+    query->found = FALSE;
+    it->second.push_back(query);
+    mutex.Signal();
+
+    waiter.answered.Wait();
+    results = waiter.results;
+    return waiter.found;
+  }
+
+  // Sent from this thread, later lookups of the same query wait on it
+  pending[key];
+  mutex.Signal();
+
+  PStringList answer;
+  found = Resolve(job, answer);
+  Complete(key, found, answer);
+
+  results = answer;
+  return found;
+}
+
+
+void H323DNSResolver::StartLookup(QueryType type,
+                                  const PString & name,
+                                  const PString & service,
+                                  const PNotifier & notifier)
+{
+  Query * query = new Query;
+  query->type = type;
+  query->name = name;
+  query->service = service;
+  query->notifier = notifier;
+  query->found = FALSE;
+
+  Job job;
+  job.type = type;
+  job.name = name;
+  job.service = service;
+  PString key = MakeKey(type, name, service);
+
+  mutex.Wait();
+
+  // A cached answer is given at once
+  if (FindCached(key, job, query->results, query->found)) {
+    mutex.Signal();
+    notifier(*query, query->found);
+    delete query;
+    return;
+  }
+
+  if (stopping) {
+    mutex.Signal();
+    notifier(*query, FALSE);
+    delete query;
+    return;
+  }
+
+  PendingMap::iterator it = pending.find(key);
+  if (it != pending.end())
+    it->second.push_back(query);
+  else {
+    pending[key].push_back(query);
+    Queue(job);
+  }
+
+  mutex.Signal();
+}
+
+
+PBoolean H323DNSResolver::Resolve(const Job & job, PStringList & results)
+{
+  PBoolean found = FALSE;
+
+  switch (job.type) {
+    case ENUMQuery :
+      {
+        PString str;
+        found = PDNS::ENUMLookup(job.name, job.service, str);
+        if (found)
+          results.AppendString(str);
+      }
+      break;
+
+    case SRVQuery :
+      found = PDNS::LookupSRV(job.name, job.service, results);
+      break;
+
+    case MXQuery :
+      {
+        PDNS::MXRecordList mxRecords;
+        found = PDNS::GetRecords(job.name, mxRecords);
+        if (found) {
+          PDNS::MXRecord * recPtr = mxRecords.GetFirst();
+          while (recPtr != NULL) {
+            results.AppendString(recPtr->hostAddress.AsString());
+            recPtr = mxRecords.GetNext();
+          }
+        }
+      }
+      break;
+
+    default :
+      break;
+  }
+
+  PTRACE(4, "DNS\tLooked up " << job.service << job.name << (found ? " found" : " not found"));
+  return found;
+}
+
+
+void H323DNSResolver::Complete(const PString & key, PBoolean found, const PStringList & results)
+{
+  std::list<Query *> waiting;
+
+  mutex.Wait();
+
+  cacheMisses++;
+
+  PInt64 now = PTimer::Tick().GetMilliSeconds();
+  PInt64 ttl = found ? cacheTime.GetMilliSeconds() : negativeCacheTime.GetMilliSeconds();
+
+  if (cache.size() >= RESOLVER_PRUNE_SIZE) {
+    CacheMap::iterator it = cache.begin();
+    while (it != cache.end()) {
+      if (it->second.expires <= now)
+        cache.erase(it++);
+      else
+        ++it;
+    }
+  }
+
+  if (ttl > 0 && !stopping) {
+    // A prefetch keeps the hit count, so the entry stays hot
+    CacheMap::iterator it = cache.find(key);
+    unsigned hits = it != cache.end() && found ? it->second.hits : 0;
+    CacheEntry & entry = cache[key];
+    CopyResults(results, entry.results);
+    entry.found = found;
+    entry.expires = now + ttl;
+    entry.refreshTime = now + ttl*3/4;
+    entry.hits = hits;
+  }
+  else
+    cache.erase(key);
+
+  PendingMap::iterator it = pending.find(key);
+  if (it != pending.end()) {
+    waiting.swap(it->second);
+    pending.erase(it);
+  }
+
+  mutex.Signal();
+
+  // Answered without the lock, a notifier may start another lookup
+  while (!waiting.empty()) {
+    Query * query = waiting.front();
+    waiting.pop_front();
+    CopyResults(results, query->results);
+    query->found = found;
+    query->notifier(*query, found);
+    delete query;
+  }
+}
+
+
+void H323DNSResolver::WorkerMain(PThread &, H323_INT)
+{
+  PTRACE(4, "DNS\tResolver worker started");
+
+  for (;;) {
+    mutex.Wait();
+    idleWorkers++;
+    mutex.Signal();
+
+    queued.Wait();
+
+    mutex.Wait();
+    idleWorkers--;
+    if (stopping || queue.empty()) {
+      PBoolean stop = stopping;
+      mutex.Signal();
+      if (stop)
+        break;
+      continue;
+    }
+    Job job = queue.front();
+    queue.pop_front();
+    mutex.Signal();
+
+    PStringList results;
+    PBoolean found = Resolve(job, results);
+    Complete(MakeKey(job.type, job.name, job.service), found, results);
+  }
+
+  PTRACE(4, "DNS\tResolver worker ended");
+}
+
+
+#endif // P_DNS
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -52,12 +52,16 @@ H323_RTP_Session::H323_RTP_Session(const H323Connection & conn)
 
 void H323_RTP_Session::OnTxStatistics(const RTP_Session & session) const
 {
+  if (session.GetPacketsSent() == 1)
+    connection.MarkCallTiming(H323CallTimeline::e_FirstRTPSent);
   //connection.OnRTPStatistics(session);
 }
 
 
 void H323_RTP_Session::OnRxStatistics(const RTP_Session & session) const
 {
+   if (session.GetPacketsReceived() == 1)
+     connection.MarkCallTiming(H323CallTimeline::e_FirstRTPReceived);
    connection.OnRTPStatistics(session);
 }
 
@@ -106,6 +110,9 @@ H323_RTP_UDP::H323_RTP_UDP(const H323Connection & conn,
   }
 #endif
 
+  rtp.SetBatchSize(endpoint.GetRTPBatchSize());
+  rtp.SetPortPool(endpoint.GetRTPPortPool());
+
   WORD firstPort = endpoint.GetRtpIpPortPair();
   WORD nextPort = firstPort;
   while (!rtp.Open(localAddress,
@@ -143,8 +150,18 @@ PBoolean H323_RTP_UDP::OnSendingPDU(const H323_RTPChannel & channel,
   param.IncludeOptionalField(H245_H2250LogicalChannelParameters::e_mediaGuaranteedDelivery);
   param.m_mediaGuaranteedDelivery = FALSE;
 
+  // multicast gives the group the media and reports are sent to
+  if (channel.GetDirection() != H323Channel::IsReceiver && rtp.IsMulticastTransmit()) {
+    param.IncludeOptionalField(H245_H2250LogicalChannelParameters::e_mediaChannel);
+    H323TransportAddress mediaAddress(rtp.GetMulticastGroup(), rtp.GetMulticastDataPort());
+    mediaAddress.SetPDU(param.m_mediaChannel);
+
+    param.IncludeOptionalField(H245_H2250LogicalChannelParameters::e_mediaControlChannel);
+    H323TransportAddress mediaControlAddress(rtp.GetMulticastGroup(), (WORD)(rtp.GetMulticastDataPort()+1));
+    mediaControlAddress.SetPDU(param.m_mediaControlChannel);
+  }
   // unicast must have mediaControlChannel
-  if (rtp.GetLocalDataPort() > 0) {  // if a valid Data port
+  else if (rtp.GetLocalDataPort() > 0) {  // if a valid Data port
       param.IncludeOptionalField(H245_H2250LogicalChannelParameters::e_mediaControlChannel);
       H323TransportAddress mediaControlAddress(rtp.GetLocalAddress(), rtp.GetLocalControlPort());
       mediaControlAddress.SetPDU(param.m_mediaControlChannel);
@@ -176,6 +193,20 @@ PBoolean H323_RTP_UDP::OnSendingPDU(const H323_RTPChannel & channel,
     param.m_dynamicRTPPayloadType = rtpPayloadType;
   }
 
+  // RFC 2198 redundancy, copies in the channel encoding carried in packets of the payload type given
+  if (channel.GetRedundancyLevel() > 0) {
+    param.IncludeOptionalField(H245_H2250LogicalChannelParameters::e_redundancyEncoding);
+    H245_RedundancyEncoding & redundancy = param.m_redundancyEncoding;
+    redundancy.m_redundancyEncodingMethod.SetTag(H245_RedundancyEncodingMethod::e_rtpAudioRedundancyEncoding);
+    redundancy.IncludeOptionalField(H245_RedundancyEncoding::e_rtpRedundancyEncoding);
+    redundancy.m_rtpRedundancyEncoding.IncludeOptionalField(H245_RedundancyEncoding_rtpRedundancyEncoding::e_secondary);
+    redundancy.m_rtpRedundancyEncoding.m_secondary.SetSize(1);
+    H245_RedundancyEncodingElement & element = redundancy.m_rtpRedundancyEncoding.m_secondary[0];
+    channel.GetCapability().OnSendingPDU(element.m_dataType);
+    element.IncludeOptionalField(H245_RedundancyEncodingElement::e_payloadType);
+    element.m_payloadType = channel.GetRedundancyPayloadType();
+  }
+
   // Set the media packetization field if have an option to describe it.
   if (codec != NULL) {
     param.m_mediaPacketization.SetTag(H245_H2250LogicalChannelParameters_mediaPacketization::e_rtpPayloadType);
@@ -227,8 +258,27 @@ PBoolean H323_RTP_UDP::ExtractTransport(const H245_TransportAddress & pdu,
                                     PBoolean isDataPort,
                                     unsigned & errorCode)
 {
+  if (pdu.GetTag() == H245_TransportAddress::e_multicastAddress) {
+    H323TransportAddress groupAddr = pdu;
+    PIPSocket::Address group;
+    WORD port = 0;
+    if (!connection.GetEndPoint().IsMulticastReceiveEnabled() ||
+        !groupAddr.GetIpAndPort(group, port) || !RTP_UDP::IsMulticastAddress(group)) {
+      PTRACE(1, "RTP_UDP\tMulticast not accepted: " << groupAddr);
+      errorCode = H245_OpenLogicalChannelReject_cause::e_multicastChannelNotAllowed;
+      return FALSE;
+    }
+
+    // The sender is learnt from the first packet, reports go back to it
+    if (!rtp.JoinMulticast(group, isDataPort ? port : (WORD)(port-1))) {
+      errorCode = H245_OpenLogicalChannelReject_cause::e_multicastChannelNotAllowed;
+      return FALSE;
+    }
+    return TRUE;
+  }
+
   if (pdu.GetTag() != H245_TransportAddress::e_unicastAddress) {
-    PTRACE(1, "RTP_UDP\tOnly unicast supported at this time");
+    PTRACE(1, "RTP_UDP\tOnly unicast and IPv4 multicast supported at this time");
     errorCode = H245_OpenLogicalChannelReject_cause::e_multicastChannelNotAllowed;
     return FALSE;
   }
@@ -280,6 +330,19 @@ PBoolean H323_RTP_UDP::OnReceivedPDU(H323_RTPChannel & channel,
   if (param.HasOptionalField(H245_H2250LogicalChannelParameters::e_dynamicRTPPayloadType))
     channel.SetDynamicRTPPayloadType(param.m_dynamicRTPPayloadType);
 
+  // Redundant packets are taken apart as read, ahead of the jitter buffer
+  if (channel.GetDirection() == H323Channel::IsReceiver &&
+      param.HasOptionalField(H245_H2250LogicalChannelParameters::e_redundancyEncoding)) {
+    const H245_RedundancyEncoding & redundancy = param.m_redundancyEncoding;
+    if (redundancy.m_redundancyEncodingMethod.GetTag() == H245_RedundancyEncodingMethod::e_rtpAudioRedundancyEncoding &&
+        redundancy.HasOptionalField(H245_RedundancyEncoding::e_rtpRedundancyEncoding) &&
+        redundancy.m_rtpRedundancyEncoding.m_secondary.GetSize() > 0 &&
+        redundancy.m_rtpRedundancyEncoding.m_secondary[0].HasOptionalField(H245_RedundancyEncodingElement::e_payloadType))
+      rtp.SetRedundantDecoding((RTP_DataFrame::PayloadTypes)(unsigned)redundancy.m_rtpRedundancyEncoding.m_secondary[0].m_payloadType);
+    else
+      PTRACE(2, "RTP_UDP\tIgnoring unsupported redundancy encoding for " << channel);
+  }
+
   H323Codec * codec = channel.GetCodec();
 
   if (codec != NULL &&
@@ -332,11 +395,14 @@ PBoolean H323_RTP_UDP::OnReceivedAckPDU(H323_RTPChannel & channel,
       if (!ExtractTransport(param.m_mediaControlChannel, FALSE, errorCode))
         return FALSE;
 
-      if (!channel.IsMediaTunneled() && !param.HasOptionalField(H245_H2250LogicalChannelAckParameters::e_mediaChannel)) {
-        PTRACE(1, "RTP_UDP\tNo mediaChannel specified");
-        return FALSE;
+      // A multicast sender has no use for where the receiver reads media
+      if (!param.HasOptionalField(H245_H2250LogicalChannelAckParameters::e_mediaChannel)) {
+        if (!rtp.IsMulticastTransmit()) {
+          PTRACE(1, "RTP_UDP\tNo mediaChannel specified");
+          return FALSE;
+        }
       }
-      if (!ExtractTransport(param.m_mediaChannel, TRUE, errorCode))
+      else if (!ExtractTransport(param.m_mediaChannel, TRUE, errorCode))
         return FALSE;
   }
 
@@ -0,0 +1,308 @@
+/*
+ * h323sigpool.cxx
+ *
+ * Pool of connected signalling transports to frequent peers
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "h323sigpool.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#include "h323ep.h"
+#include "h323sigpool.h"
+
+#define new PNEW
+
+/* Time after a failed connect to a peer before it is tried again (ms) */
+#define SIGPOOL_RETRY_TIME 5000
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+class H323SignallingPool::Thread : public PThread
+{
+    PCLASSINFO(Thread, PThread);
+  public:
+    Thread(H323SignallingPool & p)
+      : PThread(10000, NoAutoDeleteThread, LowPriority, "Signalling Pool"),
+        pool(p)
+    {
+      Resume();
+    }
+
+    void Main()
+    {
+      pool.Main();
+    }
+
+  protected:
+    H323SignallingPool & pool;
+};
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323SignallingPool::H323SignallingPool(H323EndPoint & ep)
+  : endpoint(ep),
+    idleTime(0, 20),
+    hits(0),
+    misses(0),
+    shutdown(FALSE)
+{
+  thread = new Thread(*this);
+
+  PTRACE(3, "SigPool\tCreated signalling pool");
+}
+
+
+H323SignallingPool::~H323SignallingPool()
+{
+  mutex.Wait();
+  shutdown = TRUE;
+  mutex.Signal();
+
+  wakeUp.Signal();
+  thread->WaitForTermination();
+  delete thread;
+
+  for (PeerList::iterator p = peers.begin(); p != peers.end(); ++p) {
+    for (std::list<Warm>::iterator w = p->warm.begin(); w != p->warm.end(); ++w)
+      delete w->transport;
+  }
+
+  PTRACE(3, "SigPool\tDeleted signalling pool, " << hits << " hits, " << misses << " misses");
+}
+
+
+H323SignallingPool::PeerList::iterator H323SignallingPool::FindPeer(const H323TransportAddress & address)
+{
+  // Called with the mutex held
+  PeerList::iterator p;
+  for (p = peers.begin(); p != peers.end(); ++p) {
+    if (p->address.IsEquivalent(address))
+      break;
+  }
+  return p;
+}
+
+
+void H323SignallingPool::AddPeer(const H323TransportAddress & address, PINDEX size)
+{
+  PWaitAndSignal m(mutex);
+
+  PeerList::iterator p = FindPeer(address);
+  if (p == peers.end()) {
+    p = peers.insert(peers.end(), Peer());
+    p->address = address;
+    p->connecting = 0;
+    p->retryTime = 0;
+  }
+  p->size = size;
+
+  PTRACE(3, "SigPool\tKeeping " << size << " transports to " << address);
+  wakeUp.Signal();
+}
+
+
+void H323SignallingPool::RemovePeer(const H323TransportAddress & address)
+{
+  std::list<Warm> warm;
+
+  mutex.Wait();
+  PeerList::iterator p = FindPeer(address);
+  if (p != peers.end()) {
+    warm.swap(p->warm);
+    peers.erase(p);
+  }
+  mutex.Signal();
+
+  for (std::list<Warm>::iterator w = warm.begin(); w != warm.end(); ++w)
+    delete w->transport;
+}
+
+
+H323Transport * H323SignallingPool::Acquire(const H323TransportAddress & address)
+{
+  std::list<Warm> stale;
+  H323Transport * transport = NULL;
+
+  mutex.Wait();
+
+  PeerList::iterator p = FindPeer(address);
+  if (p == peers.end()) {
+    mutex.Signal();
+    return NULL;
+  }
+
+  PInt64 now = PTimer::Tick().GetMilliSeconds();
+  while (!p->warm.empty()) {
+    Warm warm = p->warm.front();
+    p->warm.pop_front();
+    if (now - warm.connected < idleTime.GetMilliSeconds() && !IsStale(*warm.transport)) {
+      transport = warm.transport;
+      break;
+    }
+    stale.push_back(warm);
+  }
+
+  if (transport != NULL)
+    hits++;
+  else
+    misses++;
+
+  // Connect the replacement
+  wakeUp.Signal();
+  mutex.Signal();
+
+  for (std::list<Warm>::iterator w = stale.begin(); w != stale.end(); ++w)
+    delete w->transport;
+
+  PTRACE(4, "SigPool\t" << (transport != NULL ? "Connected" : "No") << " transport ready to " << address);
+  return transport;
+}
+
+
+PBoolean H323SignallingPool::IsStale(H323Transport & transport)
+{
+  PSocket * socket = dynamic_cast<PSocket *>(transport.GetReadChannel());
+  if (!transport.IsOpen() || socket == NULL)
+    return TRUE;
+
+  // Nothing is sent until the Setup, so a readable socket was closed
+  PSocket::SelectList readList;
+  readList += *socket;
+  return PSocket::Select(readList, 0) != PChannel::NoError || readList.GetSize() > 0;
+}
+
+
+H323Transport * H323SignallingPool::CreateTransport(const H323TransportAddress & address)
+{
+  H323Transport * transport = address.CreateTransport(endpoint);
+  if (transport == NULL)
+    return NULL;
+
+  if (transport->ConnectTo(address))
+    return transport;
+
+  PTRACE(2, "SigPool\tCould not connect to " << address << " - " << transport->GetErrorText());
+  delete transport;
+  return NULL;
+}
+
+
+void H323SignallingPool::Main()
+{
+  PTRACE(4, "SigPool\tPool thread started");
+
+  for (;;) {
+    PInt64 now = PTimer::Tick().GetMilliSeconds();
+    PInt64 idle = idleTime.GetMilliSeconds();
+    PInt64 next = -1;
+    H323TransportAddress due;
+    std::list<Warm> expired;
+
+    mutex.Wait();
+
+    if (shutdown) {
+      mutex.Signal();
+      break;
+    }
+
+    for (PeerList::iterator p = peers.begin(); p != peers.end(); ++p) {
+      // Replaced before the peer tires of them
+      std::list<Warm>::iterator w = p->warm.begin();
+      while (w != p->warm.end()) {
+        if (now - w->connected >= idle) {
+          expired.push_back(*w);
+          w = p->warm.erase(w);
+        }
+        else {
+          if (next < 0 || w->connected + idle < next)
+            next = w->connected + idle;
+          ++w;
+        }
+      }
+
+      if ((PINDEX)p->warm.size() + p->connecting >= p->size)
+        continue;
+      if (p->retryTime > now) {
+        if (next < 0 || p->retryTime < next)
+          next = p->retryTime;
+        continue;
+      }
+      if (due.IsEmpty()) {
+        due = p->address;
+        p->connecting++;
+      }
+    }
+
+    mutex.Signal();
+
+    for (std::list<Warm>::iterator w = expired.begin(); w != expired.end(); ++w)
+      delete w->transport;
+
+    // One at a time with the lock released, the handshakes may take seconds
+    if (!due.IsEmpty()) {
+      H323Transport * transport = CreateTransport(due);
+
+      mutex.Wait();
+      PeerList::iterator p = FindPeer(due);
+      if (p != peers.end()) {
+        p->connecting--;
+        if (transport != NULL) {
+          Warm warm;
+          warm.transport = transport;
+          warm.connected = PTimer::Tick().GetMilliSeconds();
+          p->warm.push_back(warm);
+          transport = NULL;
+        }
+        else
+          p->retryTime = PTimer::Tick().GetMilliSeconds() + SIGPOOL_RETRY_TIME;
+      }
+      mutex.Signal();
+
+      // Peer removed while connecting
+      delete transport;
+      continue;
+    }
+
+    if (next < 0)
+      wakeUp.Wait();
+    else if (next > now)
+      wakeUp.Wait(PTimeInterval(next - now));
+  }
+
+  PTRACE(4, "SigPool\tPool thread ended");
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,402 @@
+/*
+ * h323simulcast.cxx
+ *
+ * Simulcast of one captured video at several sizes and bit rates
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "h323simulcast.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#include "h323simulcast.h"
+
+#ifdef H323_VIDEO
+
+#include "codecs.h"
+
+#define new PNEW
+
+
+// Pictures of each layer kept for legs that are behind
+static const PINDEX MaxFramesKept = 8;
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323SimulcastReceiver::H323SimulcastReceiver()
+  : layer(P_MAX_INDEX),
+    maxTemporalId(UINT_MAX),
+    frameNumber(0),
+    packetIndex(0),
+    waitIntra(TRUE)
+{
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323VideoSimulcast::H323VideoSimulcast(H323VideoFramePool & framePool)
+  : pool(framePool),
+    scaler(framePool)
+{
+}
+
+
+H323VideoSimulcast::~H323VideoSimulcast()
+{
+  for (size_t i = 0; i < layers.size(); i++) {
+    PAssert(layers[i].receivers.empty(), "Simulcast deleted while a leg receives it");
+    delete layers[i].encoder;
+  }
+}
+
+
+PINDEX H323VideoSimulcast::AddLayer(H323VideoCodec * encoder, unsigned width, unsigned height, unsigned bitRate)
+{
+  if (PAssertNULL(encoder) == NULL)
+    return P_MAX_INDEX;
+
+  if (width == 0 || height == 0 || ((width | height) & 1) != 0) {
+    PTRACE(2, "Simulcast\tCannot encode a layer at " << width << 'x' << height);
+    delete encoder;
+    return P_MAX_INDEX;
+  }
+
+  if (bitRate > 0 && !encoder->SetMaxBitRate(bitRate))
+    PTRACE(2, "Simulcast\tEncoder of layer cannot be set to " << bitRate << "bps");
+
+  PWaitAndSignal m1(encodeMutex);
+  PWaitAndSignal m2(mutex);
+
+  Layer layer;
+  layer.encoder = encoder;
+  layer.width = width;
+  layer.height = height;
+  layer.svc = encoder->GetMediaFormat().Find("264") != P_MAX_INDEX;
+  layer.intraRequested = TRUE;
+  layer.frameCount = 0;
+  layers.push_back(layer);
+
+  PTRACE(3, "Simulcast\tAdded layer " << layers.size()-1 << ' ' << encoder->GetMediaFormat()
+         << ' ' << width << 'x' << height << " at " << bitRate << "bps");
+  return layers.size()-1;
+}
+
+
+PINDEX H323VideoSimulcast::GetLayerCount() const
+{
+  PWaitAndSignal m(mutex);
+  return layers.size();
+}
+
+
+PBoolean H323VideoSimulcast::GetLayerSize(PINDEX layer, unsigned & width, unsigned & height) const
+{
+  PWaitAndSignal m(mutex);
+
+  if (layer >= (PINDEX)layers.size())
+    return FALSE;
+
+  width = layers[layer].width;
+  height = layers[layer].height;
+  return TRUE;
+}
+
+
+PBoolean H323VideoSimulcast::Encode(const BYTE * picture, unsigned width, unsigned height, DWORD timestamp)
+{
+  PINDEX size = (PINDEX)(width*height*3/2);
+  H323VideoFrameRef frame = pool.Acquire(size);
+  memcpy(frame->GetBuffer(), picture, size);
+  frame->SetPicture(0, width, height, timestamp);
+  return Encode(frame);
+}
+
+
+PBoolean H323VideoSimulcast::Encode(const H323VideoFrameRef & picture)
+{
+  if (picture.IsNULL())
+    return FALSE;
+
+  PWaitAndSignal m(encodeMutex);
+
+  PBoolean ok = TRUE;
+
+  for (size_t i = 0; i < layers.size(); i++) {
+    Layer & layer = layers[i];
+
+    mutex.Wait();
+    PBoolean wanted = !layer.receivers.empty();
+    PBoolean intra = layer.intraRequested;
+    if (wanted)
+      layer.intraRequested = FALSE;
+    mutex.Signal();
+
+    if (!wanted)
+      continue;
+
+    H323VideoFrameRef scaled = scaler.Scale(picture, layer.width, layer.height);
+    if (scaled.IsNULL()) {
+      ok = FALSE;
+      continue;
+    }
+
+    Frame frame;
+    frame.intra = intra;
+    if (!layer.encoder->EncodePicture(scaled->GetData(), layer.width, layer.height, frame.intra, frame.packets)) {
+      PTRACE(2, "Simulcast\tEncoder of layer " << i << " failed");
+      mutex.Wait();
+      layer.intraRequested = intra;
+      mutex.Signal();
+      ok = FALSE;
+      continue;
+    }
+    frame.temporalId = layer.svc ? GetTemporalId(frame) : 0;
+
+    PTRACE_IF(4, frame.intra, "Simulcast\tIntra frame on layer " << i);
+
+    mutex.Wait();
+    frame.number = ++layer.frameCount;
+    layer.frames.push_back(frame);
+    if (layer.frames.size() > (size_t)MaxFramesKept)
+      layer.frames.pop_front();
+    for (size_t r = 0; r < layer.receivers.size(); r++)
+      layer.receivers[r]->newFrame.Signal();
+    mutex.Signal();
+  }
+
+  // The scaled copies go back to the pool for the next picture
+  scaler.Reset();
+
+  return ok;
+}
+
+
+PBoolean H323VideoSimulcast::Attach(H323SimulcastReceiver & receiver, PINDEX layer, unsigned maxTemporalId)
+{
+  PWaitAndSignal m(mutex);
+
+  if (layer >= (PINDEX)layers.size()) {
+    PTRACE(2, "Simulcast\tNo layer " << layer << " to send");
+    return FALSE;
+  }
+
+  receiver.maxTemporalId = maxTemporalId;
+  if (receiver.layer == layer)
+    return TRUE;
+
+  RemoveReceiver(receiver);
+  layers[layer].receivers.push_back(&receiver);
+
+  // Starts on the next intra frame of the layer, not on older pictures
+  receiver.layer = layer;
+  receiver.frameNumber = layers[layer].frameCount;
+  receiver.packetIndex = 0;
+  receiver.waitIntra = TRUE;
+  layers[layer].intraRequested = TRUE;
+
+  PTRACE(3, "Simulcast\tLeg receiving layer " << layer << ", " << layers[layer].receivers.size() << " in all");
+  return TRUE;
+}
+
+
+void H323VideoSimulcast::Detach(H323SimulcastReceiver & receiver)
+{
+  PWaitAndSignal m(mutex);
+  RemoveReceiver(receiver);
+}
+
+
+void H323VideoSimulcast::RemoveReceiver(H323SimulcastReceiver & receiver)
+{
+  if (receiver.layer >= (PINDEX)layers.size())
+    return;
+
+  std::vector<H323SimulcastReceiver *> & receivers = layers[receiver.layer].receivers;
+  for (size_t i = 0; i < receivers.size(); i++) {
+    if (receivers[i] == &receiver) {
+      receivers.erase(receivers.begin()+i);
+      break;
+    }
+  }
+
+  receiver.layer = P_MAX_INDEX;
+}
+
+
+void H323VideoSimulcast::RequestIntra(H323SimulcastReceiver & receiver)
+{
+  PWaitAndSignal m(mutex);
+
+  if (receiver.layer < (PINDEX)layers.size())
+    layers[receiver.layer].intraRequested = TRUE;
+}
+
+
+PBoolean H323VideoSimulcast::ReadPacket(H323SimulcastReceiver & receiver,
+                                        RTP_DataFrame & dst,
+                                        unsigned & length,
+                                        const PTimeInterval & timeout)
+{
+  for (PBoolean waited = FALSE; ; waited = TRUE) {
+    mutex.Wait();
+
+    if (receiver.layer >= (PINDEX)layers.size()) {
+      mutex.Signal();
+      return FALSE;
+    }
+
+    const Frame * frame = FindFrame(layers[receiver.layer], receiver);
+    if (frame != NULL) {
+      const PBYTEArray & packet = frame->packets[receiver.packetIndex++];
+      if (receiver.packetIndex >= (PINDEX)frame->packets.size())
+        receiver.packetIndex = 0;
+
+      dst.SetMinSize(packet.GetSize());
+      memcpy(dst.GetPointer(), (const BYTE *)packet, packet.GetSize());
+      length = packet.GetSize() - dst.GetHeaderSize();
+      mutex.Signal();
+      return TRUE;
+    }
+
+    mutex.Signal();
+
+    if (waited || !receiver.newFrame.Wait(timeout)) {
+      length = 0;
+      dst.SetPayloadSize(0);
+      dst.SetMarker(FALSE);
+      return TRUE;
+    }
+  }
+}
+
+
+const H323VideoSimulcast::Frame * H323VideoSimulcast::FindFrame(Layer & layer, H323SimulcastReceiver & receiver)
+{
+  size_t i;
+
+  // Go on with the picture being sent, if it is still kept
+  if (receiver.packetIndex > 0) {
+    for (i = 0; i < layer.frames.size(); i++) {
+      if (layer.frames[i].number == receiver.frameNumber)
+        return &layer.frames[i];
+    }
+
+    PTRACE(3, "Simulcast\tLeg lost the rest of a picture, waiting for an intra frame");
+    receiver.packetIndex = 0;
+    receiver.waitIntra = TRUE;
+    layer.intraRequested = TRUE;
+  }
+
+  for (i = 0; i < layer.frames.size(); i++) {
+    const Frame & frame = layer.frames[i];
+    if (frame.number <= receiver.frameNumber)
+      continue;
+
+    if (frame.number > receiver.frameNumber+1 && !receiver.waitIntra) {
+      PTRACE(3, "Simulcast\tLeg fell behind by " << (frame.number - receiver.frameNumber - 1)
+             << " pictures, waiting for an intra frame");
+      receiver.waitIntra = TRUE;
+      layer.intraRequested = TRUE;
+    }
+
+    receiver.frameNumber = frame.number;
+
+    if ((receiver.waitIntra && !frame.intra) ||
+        frame.temporalId > receiver.maxTemporalId ||
+        frame.packets.empty())
+      continue;
+
+    receiver.waitIntra = FALSE;
+    return &frame;
+  }
+
+  return NULL;
+}
+
+
+unsigned H323VideoSimulcast::GetTemporalId(const Frame & frame) const
+{
+  for (size_t i = 0; i < frame.packets.size(); i++) {
+    const BYTE * packet = frame.packets[i];
+    PINDEX size = frame.packets[i].GetSize();
+    if (size < 12)
+      continue;
+
+    PINDEX header = 12 + 4*(packet[0]&0x0f);
+    if ((packet[0]&0x10) != 0 && size >= header+4)
+      header += 4 + 4*((packet[header+2] << 8) | packet[header+3]);
+    if (size <= header)
+      continue;
+
+    int temporalId = GetH264TemporalId(packet+header, size-header);
+    if (temporalId >= 0)
+      return temporalId;
+  }
+
+  return 0;
+}
+
+
+int H323VideoSimulcast::GetH264TemporalId(const BYTE * payload, PINDEX size)
+{
+  if (size < 1)
+    return -1;
+
+  switch (payload[0]&0x1f) {
+    case 14 :   // Prefix NAL unit
+    case 20 :   // Coded slice extension
+    case 30 :   // PACSI, RFC 6190
+      // The extension is svc_extension_flag, idr_flag, priority_id, then
+      // no_inter_layer_pred_flag, dependency_id, quality_id, then
+      // temporal_id in the top three bits of its third byte
+      return size >= 4 ? (payload[3] >> 5) : -1;
+
+    case 24 :   // STAP-A, the first NAL unit after its size
+      return size > 3 ? GetH264TemporalId(payload+3, size-3) : -1;
+
+    case 28 :   // FU-A, the extension starts the first fragment
+      if (size >= 5 && (payload[1]&0x80) != 0) {
+        BYTE type = payload[1]&0x1f;
+        if (type == 14 || type == 20)
+          return payload[4] >> 5;
+      }
+      return -1;
+  }
+
+  return -1;
+}
+
+
+#endif // H323_VIDEO
+
+
+/////////////////////////////////////////////////////////////////////////////
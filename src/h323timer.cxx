@@ -0,0 +1,421 @@
+/*
+ * h323timer.cxx
+ *
+ * Timer wheel service for signalling and media timers
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "h323timer.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#include "h323timer.h"
+#include "h323mediaclock.h"
+
+#define new PNEW
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+class H323TimerService::Thread : public PThread
+{
+    PCLASSINFO(Thread, PThread);
+  public:
+    Thread(H323TimerService & svc, PThread::Priority priority)
+      : PThread(10000, NoAutoDeleteThread, priority, "H323 Timers"),
+        service(svc)
+    {
+      Resume();
+    }
+
+    void Main()
+    {
+      service.Main();
+    }
+
+  protected:
+    H323TimerService & service;
+};
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323Timer::H323Timer()
+  : service(H323TimerService::Current()),
+    resetTime(0),
+    continuous(FALSE),
+    expiry(0),
+    next(NULL),
+    prev(NULL),
+    slot(NULL)
+{
+}
+
+
+H323Timer::~H323Timer()
+{
+  service.Stop(*this, TRUE);
+}
+
+
+H323Timer & H323Timer::operator=(DWORD milliseconds)
+{
+  Start(milliseconds, FALSE);
+  return *this;
+}
+
+
+H323Timer & H323Timer::operator=(const PTimeInterval & interval)
+{
+  Start(interval.GetMilliSeconds(), FALSE);
+  return *this;
+}
+
+
+void H323Timer::RunContinuous(const PTimeInterval & interval)
+{
+  Start(interval.GetMilliSeconds(), TRUE);
+}
+
+
+void H323Timer::Stop(PBoolean wait)
+{
+  service.Stop(*this, wait);
+}
+
+
+PBoolean H323Timer::IsRunning() const
+{
+  PWaitAndSignal m(service.mutex);
+  return slot != NULL;
+}
+
+
+PTimeInterval H323Timer::GetRemaining() const
+{
+  PWaitAndSignal m(service.mutex);
+  if (slot == NULL)
+    return 0;
+
+  PInt64 remaining = expiry - H323MediaClock::GetMilliseconds();
+  return remaining > 0 ? remaining : 0;
+}
+
+
+void H323Timer::Start(PInt64 milliseconds, PBoolean runContinuous)
+{
+  service.Start(*this, milliseconds, runContinuous);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323TimerService::H323TimerService(PThread::Priority priority)
+  : expired(NULL),
+    firing(NULL),
+    currentTick(H323MediaClock::GetMilliseconds()),
+    nextWake(-1),
+    pendingCount(0),
+    expiryCount(0),
+    stopWaiters(0),
+    shutdown(FALSE),
+    firingDone(0, P_MAX_INDEX)
+{
+  for (PINDEX level = 0; level < WheelLevels; level++) {
+    for (PINDEX i = 0; i < WheelSlots; i++)
+      wheel[level][i] = NULL;
+  }
+
+  thread = new Thread(*this, priority);
+
+  PTRACE(3, "H323Timer\tCreated timer service");
+}
+
+
+H323TimerService::~H323TimerService()
+{
+  mutex.Wait();
+  shutdown = TRUE;
+  mutex.Signal();
+
+  wakeUp.Signal();
+  thread->WaitForTermination();
+  delete thread;
+
+  PWaitAndSignal m(mutex);
+  for (PINDEX level = 0; level < WheelLevels; level++) {
+    for (PINDEX i = 0; i < WheelSlots; i++) {
+      while (wheel[level][i] != NULL)
+        Unlink(*wheel[level][i]);
+    }
+  }
+  while (expired != NULL)
+    Unlink(*expired);
+  pendingCount = 0;
+
+  PTRACE(3, "H323Timer\tDeleted timer service, " << expiryCount << " expiries");
+}
+
+
+H323TimerService & H323TimerService::Current()
+{
+  static PMutex mutex;
+  static H323TimerService * current = NULL;
+
+  PWaitAndSignal m(mutex);
+  if (current == NULL)
+    current = new H323TimerService;
+  return *current;
+}
+
+
+void H323TimerService::Start(H323Timer & timer, PInt64 milliseconds, PBoolean continuous)
+{
+  PWaitAndSignal m(mutex);
+
+  if (timer.slot != NULL) {
+    if (timer.slot != &expired)
+      pendingCount--;
+    Unlink(timer);
+  }
+
+  timer.resetTime = milliseconds > 0 ? milliseconds : 0;
+  timer.continuous = continuous;
+
+  if (milliseconds <= 0 || shutdown)
+    return;
+
+  PInt64 now = H323MediaClock::GetMilliseconds();
+
+  // Wheel is idle so nothing depends on its current position
+  if (pendingCount == 0)
+    currentTick = now;
+
+  timer.expiry = now + milliseconds;
+  Insert(timer);
+  pendingCount++;
+
+  // Only disturb the service thread if it would sleep past this expiry
+  if (nextWake < 0 || timer.expiry < nextWake) {
+    nextWake = timer.expiry;
+    wakeUp.Signal();
+  }
+}
+
+
+void H323TimerService::Stop(H323Timer & timer, PBoolean wait)
+{
+  mutex.Wait();
+
+  if (timer.slot != NULL) {
+    if (timer.slot != &expired)
+      pendingCount--;
+    Unlink(timer);
+  }
+  timer.continuous = FALSE;
+
+  // Notifier running on the service thread, wait for it unless we are it
+  if (wait && firing == &timer && PThread::Current() != thread) {
+    stopWaiters++;
+    mutex.Signal();
+    firingDone.Wait();
+    return;
+  }
+
+  mutex.Signal();
+}
+
+
+void H323TimerService::Insert(H323Timer & timer)
+{
+  PInt64 due = timer.expiry > currentTick ? timer.expiry : currentTick;
+  PInt64 delta = due - currentTick;
+
+  H323Timer ** slot;
+  if (delta < WheelSlots)
+    slot = &wheel[0][due & (WheelSlots-1)];
+  else if (delta < ((PInt64)1 << (2*WheelBits)))
+    slot = &wheel[1][(due >> WheelBits) & (WheelSlots-1)];
+  else if (delta < ((PInt64)1 << (3*WheelBits)))
+    slot = &wheel[2][(due >> (2*WheelBits)) & (WheelSlots-1)];
+  else // Beyond the wheel, park in the furthest slot and cascade again later
+    slot = &wheel[2][((currentTick + ((PInt64)1 << (3*WheelBits)) - 1) >> (2*WheelBits)) & (WheelSlots-1)];
+
+  timer.slot = slot;
+  timer.prev = NULL;
+  timer.next = *slot;
+  if (timer.next != NULL)
+    timer.next->prev = &timer;
+  *slot = &timer;
+}
+
+
+void H323TimerService::Unlink(H323Timer & timer)
+{
+  if (timer.prev != NULL)
+    timer.prev->next = timer.next;
+  else
+    *timer.slot = timer.next;
+
+  if (timer.next != NULL)
+    timer.next->prev = timer.prev;
+
+  timer.next = timer.prev = NULL;
+  timer.slot = NULL;
+}
+
+
+void H323TimerService::Cascade(H323Timer ** slot)
+{
+  H323Timer * list = *slot;
+  *slot = NULL;
+  while (list != NULL) {
+    H323Timer * timer = list;
+    list = timer->next;
+    timer->next = timer->prev = NULL;
+    timer->slot = NULL;
+    Insert(*timer);
+  }
+}
+
+
+void H323TimerService::Advance(PInt64 now)
+{
+  while (currentTick < now && pendingCount > 0) {
+    currentTick++;
+
+    // Moved into a new block of a higher level, spread its entries down
+    if ((currentTick & (((PInt64)1 << (2*WheelBits))-1)) == 0)
+      Cascade(&wheel[2][(currentTick >> (2*WheelBits)) & (WheelSlots-1)]);
+    if ((currentTick & (WheelSlots-1)) == 0)
+      Cascade(&wheel[1][(currentTick >> WheelBits) & (WheelSlots-1)]);
+
+    H323Timer ** slot = &wheel[0][currentTick & (WheelSlots-1)];
+    H323Timer * list = *slot;
+    *slot = NULL;
+    while (list != NULL) {
+      H323Timer * timer = list;
+      list = timer->next;
+      timer->next = timer->prev = NULL;
+      timer->slot = NULL;
+      if (timer->expiry > currentTick)
+        Insert(*timer);
+      else {
+        // Queue for the notifier, still running until it is called
+        pendingCount--;
+        timer->slot = &expired;
+        timer->next = expired;
+        if (expired != NULL)
+          expired->prev = timer;
+        expired = timer;
+      }
+    }
+  }
+
+  if (pendingCount == 0)
+    currentTick = now;
+}
+
+
+PInt64 H323TimerService::GetNextExpiry() const
+{
+  if (pendingCount == 0)
+    return -1;
+
+  // Next cascade point bounds the search of the lowest level
+  PInt64 boundary = ((currentTick >> WheelBits) + 1) << WheelBits;
+  for (PInt64 tick = currentTick + 1; tick < boundary; tick++) {
+    if (wheel[0][tick & (WheelSlots-1)] != NULL)
+      return tick;
+  }
+  return boundary;
+}
+
+
+void H323TimerService::Main()
+{
+  PTRACE(3, "H323Timer\tTimer service thread started");
+
+  mutex.Wait();
+
+  while (!shutdown) {
+    Advance(H323MediaClock::GetMilliseconds());
+
+    while (expired != NULL && !shutdown) {
+      H323Timer * timer = expired;
+      Unlink(*timer);
+      expiryCount++;
+
+      if (timer->continuous) {
+        timer->expiry += timer->resetTime;
+        if (timer->expiry <= currentTick)
+          timer->expiry = currentTick + timer->resetTime;
+        Insert(*timer);
+        pendingCount++;
+      }
+
+      // Call without the mutex so the notifier may start and stop timers
+      PNotifier notifier = timer->notifier;
+      firing = timer;
+      mutex.Signal();
+
+      if (!notifier.IsNULL())
+        notifier(*timer, 0);
+
+      mutex.Wait();
+      firing = NULL;
+      while (stopWaiters > 0) {
+        stopWaiters--;
+        firingDone.Signal();
+      }
+    }
+
+    if (shutdown)
+      break;
+
+    PInt64 now = H323MediaClock::GetMilliseconds();
+    PInt64 next = nextWake = GetNextExpiry();
+    mutex.Signal();
+
+    if (next < 0)
+      wakeUp.Wait();
+    else if (next > now)
+      wakeUp.Wait(PTimeInterval(next - now));
+
+    mutex.Wait();
+  }
+
+  mutex.Signal();
+
+  PTRACE(3, "H323Timer\tTimer service thread ended");
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
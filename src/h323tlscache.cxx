@@ -0,0 +1,237 @@
+/*
+ * h323tlscache.cxx
+ *
+ * Cache of TLS sessions for resuming signalling handshakes
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "h323tlscache.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#ifdef H323_TLS
+
+#include "h323tlscache.h"
+
+extern "C" {
+#include <openssl/opensslv.h>
+#include <openssl/ssl.h>
+}
+
+#define new PNEW
+
+/* Names the sessions of the endpoint, a server only resumes its own */
+#define TLS_SESSION_ID_CONTEXT "H323Plus"
+
+// SSL ex_data slot of the peer a client connection belongs to
+static int TLSPeerIndex = -1;
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+class H323TLSSessionCache::Peer : public PObject
+{
+    PCLASSINFO(Peer, PObject);
+  public:
+    Peer(H323TLSSessionCache & c, const PString & k)
+      : cache(c), key(k)
+    {
+    }
+
+    H323TLSSessionCache & cache;
+    PString key;
+};
+
+
+// Called by OpenSSL as the connection is freed
+static void FreeTLSPeer(void *, void * ptr, CRYPTO_EX_DATA *, int, long, void *)
+{
+  delete (PObject *)ptr;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323TLSSessionCache::H323TLSSessionCache(PINDEX _maxPeers)
+  : maxPeers(_maxPeers > 0 ? _maxPeers : 1),
+    offered(0),
+    resumed(0)
+{
+}
+
+
+H323TLSSessionCache::~H323TLSSessionCache()
+{
+  RemoveAll();
+
+  PTRACE(3, "TLS\tDeleted session cache, " << offered << " offered, " << resumed << " resumed");
+}
+
+
+void H323TLSSessionCache::ConfigureContext(SSL_CTX * context, const PTimeInterval & lifetime)
+{
+  if (TLSPeerIndex < 0)
+    TLSPeerIndex = SSL_get_ex_new_index(0, NULL, NULL, NULL, FreeTLSPeer);
+
+  // The server keeps the sessions it issues IDs for, and tickets need no
+  // server state. Client sessions are passed to OnNewSession().
+  SSL_CTX_set_session_cache_mode(context, SSL_SESS_CACHE_SERVER | SSL_SESS_CACHE_CLIENT);
+  SSL_CTX_set_session_id_context(context, (const unsigned char *)TLS_SESSION_ID_CONTEXT,
+                                 sizeof(TLS_SESSION_ID_CONTEXT)-1);
+  SSL_CTX_set_timeout(context, lifetime.GetSeconds());
+  SSL_CTX_sess_set_new_cb(context, OnNewSession);
+}
+
+
+H323TLSSessionCache::Peer * H323TLSSessionCache::GetPeer(SSL * ssl)
+{
+  if (TLSPeerIndex < 0)
+    return NULL;
+  return (Peer *)SSL_get_ex_data(ssl, TLSPeerIndex);
+}
+
+
+void H323TLSSessionCache::PrepareClient(SSL * ssl, const PString & peer)
+{
+  if (TLSPeerIndex < 0 || ssl == NULL)
+    return;
+
+  // A connection prepared again belongs to the new peer
+  delete GetPeer(ssl);
+  SSL_set_ex_data(ssl, TLSPeerIndex, new Peer(*this, peer));
+
+  PWaitAndSignal m(mutex);
+
+  SessionMap::iterator it = sessions.find(peer);
+  if (it != sessions.end() && SSL_set_session(ssl, it->second)) {
+    offered++;
+    PTRACE(4, "TLS\tOffering session to resume with " << peer);
+  }
+}
+
+
+void H323TLSSessionCache::OnClientHandshake(SSL * ssl, PBoolean ok)
+{
+  Peer * peer = GetPeer(ssl);
+  if (peer == NULL)
+    return;
+
+  if (!ok) {
+    Remove(peer->key);
+    return;
+  }
+
+  // A full handshake has stored the new session already
+  if (SSL_session_reused(ssl)) {
+    PWaitAndSignal m(mutex);
+    resumed++;
+    PTRACE(4, "TLS\tResumed session with " << peer->key);
+  }
+}
+
+
+int H323TLSSessionCache::OnNewSession(SSL * ssl, SSL_SESSION * session)
+{
+  // Server connections and those not prepared are not kept
+  Peer * peer = GetPeer(ssl);
+  if (peer == NULL)
+    return 0;
+
+  peer->cache.Store(peer->key, session);
+  return 1;
+}
+
+
+void H323TLSSessionCache::Store(const PString & peer, SSL_SESSION * session)
+{
+  SSL_SESSION * old = NULL;
+
+  mutex.Wait();
+
+  SessionMap::iterator it = sessions.find(peer);
+  if (it != sessions.end()) {
+    old = it->second;
+    it->second = session;
+  }
+  else {
+    if ((PINDEX)sessions.size() >= maxPeers) {
+      old = sessions.begin()->second;
+      sessions.erase(sessions.begin());
+    }
+    sessions[peer] = session;
+  }
+
+  mutex.Signal();
+
+  if (old != NULL)
+    SSL_SESSION_free(old);
+
+  PTRACE(4, "TLS\tStored session of " << peer);
+}
+
+
+void H323TLSSessionCache::Remove(const PString & peer)
+{
+  SSL_SESSION * old = NULL;
+
+  mutex.Wait();
+  SessionMap::iterator it = sessions.find(peer);
+  if (it != sessions.end()) {
+    old = it->second;
+    sessions.erase(it);
+  }
+  mutex.Signal();
+
+  if (old != NULL) {
+    SSL_SESSION_free(old);
+    PTRACE(4, "TLS\tRemoved session of " << peer);
+  }
+}
+
+
+void H323TLSSessionCache::RemoveAll()
+{
+  SessionMap old;
+
+  mutex.Wait();
+  old.swap(sessions);
+  mutex.Signal();
+
+  for (SessionMap::iterator it = old.begin(); it != old.end(); ++it)
+    SSL_SESSION_free(it->second);
+}
+
+
+#endif // H323_TLS
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -37,6 +37,7 @@
 
 #include "h323ep.h"
 #include "h323pdu.h"
+#include "h323mediaclock.h"
 
 #include <ptclib/random.h>
 
@@ -94,7 +95,7 @@ PBoolean H323TransactionPDU::Read(H323Transport & transport)
 
 PBoolean H323TransactionPDU::Write(H323Transport & transport)
 {
-  PPER_Stream strm;
+  H323_PERStream strm;
   GetPDU().Encode(strm);
   strm.CompleteEncoding();
 
@@ -159,6 +160,16 @@ void H323Transactor::Construct()
   nextSequenceNumber = PRandom::Number()%65536;
   checkResponseCryptoTokens = TRUE;
   lastRequest = NULL;
+  workerThreads = 0;
+  backgroundWorker = NULL;
+  overloadLimit = 0;
+  ripThreshold = 1000;
+  queuedRequests = 0;
+  handleTime = 0;
+  shedRequests = 0;
+  responseCacheHits = 0;
+  asyncThread = NULL;
+  asyncStopping = FALSE;
 
   requests.DisallowDeleteObjects();
 }
@@ -167,6 +178,9 @@ void H323Transactor::Construct()
 H323Transactor::~H323Transactor()
 {
   StopChannel();
+
+  for (ResponseMap::iterator it = responses.begin(); it != responses.end(); ++it)
+    delete it->second;
 }
 
 
@@ -240,6 +254,9 @@ PBoolean H323Transactor::StartChannel()
   if (transport == NULL)
     return FALSE;
 
+  while (workers.GetSize() < workerThreads)
+    workers.Append(new Worker(*this, psprintf("Transactor Worker:%u", workers.GetSize()), PThread::NormalPriority));
+
   transport->AttachThread(PThread::Create(PCREATE_NOTIFIER(HandleTransactions), 0,
                                           PThread::NoAutoDeleteThread,
                                           PThread::NormalPriority,
@@ -250,11 +267,244 @@ PBoolean H323Transactor::StartChannel()
 
 void H323Transactor::StopChannel()
 {
+  StopAsyncRequests();
+
   if (transport != NULL) {
     transport->CleanUpOnTermination();
+    // Workers write through the transport, so must finish first
+    StopWorkers();
     delete transport;
     transport = NULL;
   }
+  else
+    StopWorkers();
+}
+
+
+void H323Transactor::StopWorkers()
+{
+  workers.RemoveAll();
+
+  delete backgroundWorker;
+  backgroundWorker = NULL;
+}
+
+
+void H323Transactor::HandleRequest(H323Transaction * transaction)
+{
+  if (workers.IsEmpty()) {
+    if (!transaction->HandlePDU())
+      delete transaction;
+    return;
+  }
+
+  RequestPriority priority = transaction->GetPriority();
+
+  if (overloadLimit > 0 && queuedRequests >= overloadLimit) {
+    // Make room by turning away the oldest request of the lowest priority
+    H323Transaction * shed = NULL;
+    for (int p = LowPriority; shed == NULL && p < priority; p++) {
+      for (PINDEX i = 0; shed == NULL && i < workers.GetSize(); i++)
+        shed = workers[i].Take((RequestPriority)p);
+      if (shed == NULL && backgroundWorker != NULL)
+        shed = backgroundWorker->Take((RequestPriority)p);
+    }
+
+    if (shed == NULL) {
+      ShedRequest(transaction);
+      return;
+    }
+    ShedRequest(shed);
+  }
+
+  Worker * chosen;
+  switch (transaction->GetQueue()) {
+    case BackgroundQueue :
+      // Only the read thread queues requests, so only it starts the worker
+      if (backgroundWorker == NULL)
+        backgroundWorker = new Worker(*this, "Transactor Background", PThread::LowPriority);
+      chosen = backgroundWorker;
+      break;
+
+    case ConcurrentQueue :
+      chosen = &workers[0];
+      for (PINDEX i = 1; i < workers.GetSize(); i++) {
+        if (workers[i].GetQueued(LowPriority) < chosen->GetQueued(LowPriority))
+          chosen = &workers[i];
+      }
+      break;
+
+    default : {
+      // Keep requests from the one endpoint on the one worker, in order
+      const PString & address = transaction->GetRequestAddress();
+      unsigned hash = 2166136261U;
+      for (PINDEX i = 0; i < address.GetLength(); i++)
+        hash = (hash ^ (BYTE)address[i]) * 16777619U;
+      chosen = &workers[hash % workers.GetSize()];
+    }
+  }
+
+  Worker & worker = *chosen;
+
+  // Stop the remote retrying a request that will wait long for the worker,
+  // the retries would only add to the overload
+  if (ripThreshold > 0) {
+    PInt64 wait = (worker.GetQueued(priority) + 1) * handleTime / 1000;
+    if (wait > ripThreshold.GetMilliSeconds() && transaction->CanSendEarlyRIP()) {
+      PTRACE(4, "Trans\tExpect " << wait << "ms wait for worker, sending RIP");
+      if (transaction->SendRIP(wait < 65535 ? (unsigned)wait : 65535))
+        endpoint.GetMetrics().transactionsDelayed.Add();
+    }
+  }
+
+  worker.Queue(transaction, priority);
+}
+
+
+void H323Transactor::ShedRequest(H323Transaction * transaction)
+{
+  PTRACE(3, "Trans\tOverloaded with " << queuedRequests << " requests queued,"
+            " turning away " << transaction->GetName() << " from " << transaction->GetRequestAddress());
+
+  shedRequests++;
+  endpoint.GetMetrics().transactionsShed.Add();
+
+  transaction->HandleOverload();
+  delete transaction;
+}
+
+
+void H323Transactor::OnRequestHandled(PInt64 waited, PInt64 handled)
+{
+  // Average over the last few dozen requests, workers racing only blur it
+  handleTime += (handled - handleTime)/16;
+
+  endpoint.GetMetrics().transactionQueueTime.Add(waited/1000);
+}
+
+
+H323Transactor::Worker::Worker(H323Transactor & trans, const PString & name, PThread::Priority priority)
+  : transactor(trans),
+    available(0, P_MAX_INDEX)
+{
+  stopping = FALSE;
+  thread = PThread::Create(PCREATE_NOTIFIER(Main), 0,
+                           PThread::NoAutoDeleteThread,
+                           priority,
+                           name);
+}
+
+
+H323Transactor::Worker::~Worker()
+{
+  mutex.Wait();
+  stopping = TRUE;
+  mutex.Signal();
+  available.Signal();
+
+  if (thread != NULL) {
+    PAssert(thread->WaitForTermination(10000), "Transactor worker did not terminate");
+    delete thread;
+  }
+
+  // Discard anything not yet handled
+  for (int p = LowPriority; p < NumPriorities; p++) {
+    while (!queues[p].empty()) {
+      delete queues[p].front().transaction;
+      queues[p].pop_front();
+      H323_ATOMIC_ADD64(&transactor.queuedRequests, -1);
+      transactor.endpoint.GetMetrics().transactionsQueued.Add(-1);
+    }
+  }
+}
+
+
+void H323Transactor::Worker::Queue(H323Transaction * transaction, RequestPriority priority)
+{
+  Queued entry;
+  entry.transaction = transaction;
+  entry.time = H323MediaClock::GetMicroseconds();
+
+  mutex.Wait();
+  queues[priority].push_back(entry);
+  mutex.Signal();
+
+  H323_ATOMIC_ADD64(&transactor.queuedRequests, 1);
+  transactor.endpoint.GetMetrics().transactionsQueued.Add(1);
+
+  available.Signal();
+}
+
+
+PINDEX H323Transactor::Worker::GetQueued(RequestPriority priority)
+{
+  PWaitAndSignal m(mutex);
+
+  PINDEX count = 0;
+  for (int p = priority; p < NumPriorities; p++)
+    count += queues[p].size();
+  return count;
+}
+
+
+H323Transaction * H323Transactor::Worker::Take(RequestPriority priority)
+{
+  PWaitAndSignal m(mutex);
+
+  if (queues[priority].empty())
+    return NULL;
+
+  // The semaphore count is left, the worker finds nothing for it
+  H323Transaction * transaction = queues[priority].front().transaction;
+  queues[priority].pop_front();
+
+  H323_ATOMIC_ADD64(&transactor.queuedRequests, -1);
+  transactor.endpoint.GetMetrics().transactionsQueued.Add(-1);
+  return transaction;
+}
+
+
+void H323Transactor::Worker::Main(PThread &, H323_INT)
+{
+  PTRACE(4, "Trans\tStarted worker thread");
+
+  for (;;) {
+    available.Wait();
+
+    mutex.Wait();
+    if (stopping) {
+      mutex.Signal();
+      break;
+    }
+    // Highest priority first, each in the order received
+    H323Transaction * transaction = NULL;
+    PInt64 queuedTime = 0;
+    for (int p = NumPriorities-1; p >= LowPriority; p--) {
+      if (!queues[p].empty()) {
+        transaction = queues[p].front().transaction;
+        queuedTime = queues[p].front().time;
+        queues[p].pop_front();
+        break;
+      }
+    }
+    mutex.Signal();
+
+    // Taken by overload control
+    if (transaction == NULL)
+      continue;
+
+    H323_ATOMIC_ADD64(&transactor.queuedRequests, -1);
+    transactor.endpoint.GetMetrics().transactionsQueued.Add(-1);
+
+    PInt64 start = H323MediaClock::GetMicroseconds();
+    PBoolean inProgress = transaction->HandlePDU();
+    transactor.OnRequestHandled(start - queuedTime, H323MediaClock::GetMicroseconds() - start);
+
+    if (!inProgress)
+      delete transaction;
+  }
+
+  PTRACE(4, "Trans\tEnded worker thread");
 }
 
 
@@ -265,6 +515,8 @@ void H323Transactor::HandleTransactions(PThread &, H323_INT)
 
   PTRACE(2, "Trans\tStarting listener thread on " << *transport);
 
+  endpoint.GetThreadAffinity(H323EndPoint::RASThreads).ApplyToCurrentThread();
+
   transport->SetReadTimeout(PMaxTimeInterval);
 
   PINDEX consecutiveErrors = 0;
@@ -277,8 +529,12 @@ void H323Transactor::HandleTransactions(PThread &, H323_INT)
       consecutiveErrors = 0;
       lastRequest = NULL;
       if (HandleTransaction(response->GetPDU()) && lastRequest) {
+        // The request may be gone as soon as its mutex is released
+        PBoolean asynchronous = lastRequest->asynchronous;
         lastRequest->responseHandled.Signal();
         lastRequest->responseMutex.Signal();
+        if (asynchronous)
+          asyncWakeUp.Signal();
       } 
     }
     else {
@@ -343,34 +599,60 @@ unsigned H323Transactor::GetNextSequenceNumber()
 
 void H323Transactor::AgeResponses()
 {
-  PTime now;
+  PInt64 now = PTimer::Tick().GetMilliSeconds();
 
   PWaitAndSignal mutex(pduWriteMutex);
 
-  for (PINDEX i = 0; i < responses.GetSize(); i++) {
-    const Response & response = responses[i];
-    if ((now - response.lastUsedTime) > response.retirementAge) {
-      PTRACE(4, "Trans\tRemoving cached response: " << response);
-      responses.RemoveAt(i--);
-    }
+  // Only the responses that have expired are visited
+  while (!responseExpiry.empty() && responseExpiry.begin()->first < now) {
+    Response * response = responseExpiry.begin()->second;
+    PTRACE(4, "Trans\tRemoving cached response: " << *response);
+    responseExpiry.erase(responseExpiry.begin());
+    responses.erase(*response);
+    delete response;
   }
 }
 
 
+H323Transactor::Response * H323Transactor::FindResponse(const H323TransportAddress & addr,
+                                                        unsigned seqNum)
+{
+  ResponseMap::iterator it = responses.find(Response(addr, seqNum));
+  return it != responses.end() ? it->second : NULL;
+}
+
+
+void H323Transactor::ScheduleResponseRetirement(Response & response)
+{
+  if (response.expiry != responseExpiry.end())
+    responseExpiry.erase(response.expiry);
+
+  PInt64 when = (response.lastUsedTime + response.retirementAge).GetMilliSeconds();
+  response.expiry = responseExpiry.insert(ResponseExpiryMap::value_type(when, &response));
+}
+
+
 PBoolean H323Transactor::SendCachedResponse(const H323TransactionPDU & pdu)
 {
   if (PAssertNULL(transport) == NULL)
     return FALSE;
 
-  Response key(transport->GetLastReceivedAddress(), pdu.GetSequenceNumber());
+  H323TransportAddress address = transport->GetLastReceivedAddress();
 
   PWaitAndSignal mutex(pduWriteMutex);
 
-  PINDEX idx = responses.GetValuesIndex(key);
-  if (idx != P_MAX_INDEX)
-    return responses[idx].SendCachedResponse(*transport);
+  Response * response = FindResponse(address, pdu.GetSequenceNumber());
+  if (response != NULL) {
+    responseCacheHits++;
+    PBoolean ok = response->SendCachedResponse(*transport);
+    ScheduleResponseRetirement(*response);
+    return ok;
+  }
 
-  responses.Append(new Response(key));
+  response = new Response(address, pdu.GetSequenceNumber());
+  response->expiry = responseExpiry.end();
+  responses[*response] = response;
+  ScheduleResponseRetirement(*response);
   return FALSE;
 }
 
@@ -384,10 +666,11 @@ PBoolean H323Transactor::WritePDU(H323TransactionPDU & pdu)
 
   PWaitAndSignal mutex(pduWriteMutex);
 
-  Response key(transport->GetLastReceivedAddress(), pdu.GetSequenceNumber());
-  PINDEX idx = responses.GetValuesIndex(key);
-  if (idx != P_MAX_INDEX)
-    responses[idx].SetPDU(pdu);
+  Response * response = FindResponse(transport->GetLastReceivedAddress(), pdu.GetSequenceNumber());
+  if (response != NULL) {
+    response->SetPDU(pdu);
+    ScheduleResponseRetirement(*response);
+  }
 
   return pdu.Write(*transport);
 }
@@ -430,6 +713,86 @@ PBoolean H323Transactor::WriteTo(H323TransactionPDU & pdu,
 }
 
 
+PBoolean H323Transactor::WriteResponse(H323TransactionPDU & pdu,
+                                      const H323TransportAddressArray & addresses,
+                                      const H323TransportAddress & requestAddress)
+{
+  if (PAssertNULL(transport) == NULL)
+    return FALSE;
+
+  OnSendingPDU(pdu.GetPDU());
+
+  PWaitAndSignal mutex(pduWriteMutex);
+
+  // The transport may have received other requests since this one, so the
+  // cached response is keyed by the address saved with the request.
+  Response * response = FindResponse(requestAddress, pdu.GetSequenceNumber());
+  if (response != NULL) {
+    response->SetPDU(pdu);
+    ScheduleResponseRetirement(*response);
+  }
+
+  H323TransportAddress oldAddress = transport->GetRemoteAddress();
+
+  PBoolean ok = FALSE;
+  if (addresses.IsEmpty()) {
+    if (transport->ConnectTo(requestAddress))
+      ok = pdu.Write(*transport);
+  }
+  else {
+    for (PINDEX i = 0; i < addresses.GetSize(); i++) {
+      if (transport->ConnectTo(addresses[i])) {
+        PTRACE(3, "Trans\tWrite address set to " << addresses[i]);
+        ok = pdu.Write(*transport);
+      }
+    }
+  }
+
+  transport->ConnectTo(oldAddress);
+
+  return ok;
+}
+
+
+PBoolean H323Transactor::WriteResponse(const PBYTEArray & data,
+                                       unsigned seqNum,
+                                       const H323TransportAddressArray & addresses,
+                                       const H323TransportAddress & requestAddress)
+{
+  if (PAssertNULL(transport) == NULL)
+    return FALSE;
+
+  PWaitAndSignal mutex(pduWriteMutex);
+
+  Response * response = FindResponse(requestAddress, seqNum);
+  if (response != NULL) {
+    response->SetData(data);
+    ScheduleResponseRetirement(*response);
+  }
+
+  H323TransportAddress oldAddress = transport->GetRemoteAddress();
+
+  PBoolean ok = FALSE;
+  if (addresses.IsEmpty()) {
+    if (transport->ConnectTo(requestAddress))
+      ok = transport->WritePDU(data);
+  }
+  else {
+    for (PINDEX i = 0; i < addresses.GetSize(); i++) {
+      if (transport->ConnectTo(addresses[i]))
+        ok = transport->WritePDU(data);
+    }
+  }
+
+  transport->ConnectTo(oldAddress);
+
+  PTRACE_IF(1, !ok, "Trans\tWrite of encoded response failed ("
+            << transport->GetErrorNumber(PChannel::LastWriteError)
+            << "): " << transport->GetErrorText(PChannel::LastWriteError));
+  return ok;
+}
+
+
 PBoolean H323Transactor::MakeRequest(Request & request)
 {
   PTRACE(3, "Trans\tMaking request: " << request.requestPDU.GetChoice().GetTagName());
@@ -450,6 +813,168 @@ PBoolean H323Transactor::MakeRequest(Request & request)
 }
 
 
+PBoolean H323Transactor::StartRequest(Request & request, const PNotifier & completed)
+{
+  PTRACE(3, "Trans\tStarting request: " << request.requestPDU.GetChoice().GetTagName());
+
+  OnSendingPDU(request.requestPDU.GetPDU());
+
+  request.completed = completed;
+  request.asynchronous = TRUE;
+  request.retry = 1;
+  request.responseResult = Request::AwaitingResponse;
+  // To avoid race condition with RIP must set timeout before sending the packet
+  request.whenResponseExpected = PTimer::Tick() + endpoint.GetRasRequestTimeout();
+
+  requestsMutex.Wait();
+  requests.SetAt(request.sequenceNumber, &request);
+  requestsMutex.Signal();
+
+  if (!WriteAsyncRequest(request)) {
+    requestsMutex.Wait();
+    requests.SetAt(request.sequenceNumber, NULL);
+    requestsMutex.Signal();
+    return FALSE;
+  }
+
+  PWaitAndSignal mutex(asyncMutex);
+
+  if (asyncThread == NULL) {
+    asyncStopping = FALSE;
+    asyncThread = PThread::Create(PCREATE_NOTIFIER(HandleAsyncRequests), 0,
+                                  PThread::NoAutoDeleteThread,
+                                  PThread::NormalPriority,
+                                  "TransAsync:%x");
+  }
+
+  asyncRequests.push_back(&request);
+  asyncWakeUp.Signal();
+  return TRUE;
+}
+
+
+PBoolean H323Transactor::WriteAsyncRequest(Request & request)
+{
+  PWaitAndSignal mutex(pduWriteMutex);
+  return transport != NULL && WriteTo(request.requestPDU, request.requestAddresses, FALSE);
+}
+
+
+void H323Transactor::CancelRequest(Request & request)
+{
+  request.responseMutex.Wait();
+  request.cancelled = TRUE;
+  request.responseMutex.Signal();
+
+  asyncWakeUp.Signal();
+}
+
+
+void H323Transactor::StopAsyncRequests()
+{
+  asyncMutex.Wait();
+  PThread * thread = asyncThread;
+  asyncThread = NULL;
+  asyncStopping = TRUE;
+  asyncMutex.Signal();
+
+  if (thread == NULL)
+    return;
+
+  asyncWakeUp.Signal();
+  thread->WaitForTermination();
+  delete thread;
+}
+
+
+void H323Transactor::HandleAsyncRequests(PThread &, H323_INT)
+{
+  PTRACE(4, "Trans\tStarted asynchronous request thread");
+
+  std::vector<Request *> finished;
+
+  for (;;) {
+    PTimeInterval now = PTimer::Tick();
+    PTimeInterval wait = PMaxTimeInterval;
+
+    asyncMutex.Wait();
+
+    PBoolean stop = asyncStopping;
+    std::vector<Request *>::iterator it = asyncRequests.begin();
+    while (it != asyncRequests.end()) {
+      Request & request = **it;
+      PBoolean done = stop;
+
+      request.responseMutex.Wait();
+      if (request.cancelled)
+        done = TRUE;
+      switch (request.responseResult) {
+        case Request::AwaitingResponse :
+          if (!done && request.whenResponseExpected <= now) {
+            PTRACE(1, "Trans\tTimeout on request seqnum=" << request.requestPDU.GetSequenceNumber()
+                   << ", try #" << request.retry << " of " << endpoint.GetRasRequestRetries());
+            if (request.retry < endpoint.GetRasRequestRetries()) {
+              request.retry++;
+              request.whenResponseExpected = now + endpoint.GetRasRequestTimeout();
+              done = !WriteAsyncRequest(request);
+            }
+            else
+              done = TRUE;
+          }
+          if (done)
+            request.responseResult = Request::NoResponseReceived;
+          break;
+
+        case Request::RequestInProgress :
+          // The RIP has moved the time the response is expected
+          request.responseResult = Request::AwaitingResponse;
+          break;
+
+        default :
+          done = TRUE;
+      }
+
+      if (!done && request.whenResponseExpected - now < wait)
+        wait = request.whenResponseExpected - now;
+      request.responseMutex.Signal();
+
+      if (done) {
+        finished.push_back(&request);
+        it = asyncRequests.erase(it);
+      }
+      else
+        ++it;
+    }
+
+    asyncMutex.Signal();
+
+    for (size_t i = 0; i < finished.size(); i++) {
+      Request & request = *finished[i];
+
+      requestsMutex.Wait();
+      requests.SetAt(request.sequenceNumber, NULL);
+      requestsMutex.Signal();
+
+      // Wait for the read thread to be finished with the request
+      request.responseMutex.Wait();
+      request.responseMutex.Signal();
+
+      PTRACE(4, "Trans\tCompleted request seqnum=" << request.sequenceNumber
+             << ", result=" << request.responseResult);
+      request.completed(request, request.responseResult == Request::ConfirmReceived);
+    }
+    finished.clear();
+
+    if (stop)
+      break;
+
+    asyncWakeUp.Wait(wait);
+  }
+
+  PTRACE(4, "Trans\tEnded asynchronous request thread");
+}
+
+
 PBoolean H323Transactor::CheckForResponse(unsigned reqTag, unsigned seqNum, const PASN_Choice * reason)
 {
   requestsMutex.Wait();
@@ -518,10 +1043,13 @@ PBoolean H323Transactor::CheckCryptoTokens(const H323TransactionPDU & pdu,
      the correct tokens, preventing a possible DOS attack.
    */
   if (lastRequest != NULL) {
+    PBoolean asynchronous = lastRequest->asynchronous;
     lastRequest->responseResult = Request::BadCryptoTokens;
     lastRequest->responseHandled.Signal();
     lastRequest->responseMutex.Signal();
     lastRequest = NULL;
+    if (asynchronous)
+      asyncWakeUp.Signal();
   }
 
   return FALSE;
@@ -532,7 +1060,7 @@ PBoolean H323Transactor::CheckCryptoTokens(const H323TransactionPDU & pdu,
 
 H323Transactor::Request::Request(unsigned seqNum, H323TransactionPDU & pdu)
  :  rejectReason(UINT_MAX), responseInfo(NULL), sequenceNumber(seqNum), requestPDU(pdu),
-    responseResult(NoResponseReceived), useAlternate(FALSE)
+    responseResult(NoResponseReceived), useAlternate(FALSE), asynchronous(FALSE), retry(0), cancelled(FALSE)
 {
 
 }
@@ -541,8 +1069,8 @@ H323Transactor::Request::Request(unsigned seqNum, H323TransactionPDU & pdu)
 H323Transactor::Request::Request(unsigned seqNum,
                                  H323TransactionPDU & pdu,
                                  const H323TransportAddressArray & addresses)
- : rejectReason(UINT_MAX), responseInfo(NULL), sequenceNumber(seqNum), requestPDU(pdu),
-   responseResult(NoResponseReceived), useAlternate(FALSE)
+ : rejectReason(UINT_MAX), responseInfo(NULL), requestAddresses(addresses), sequenceNumber(seqNum), requestPDU(pdu),
+   responseResult(NoResponseReceived), useAlternate(FALSE), asynchronous(FALSE), retry(0), cancelled(FALSE)
 {
 
 }
@@ -669,6 +1197,7 @@ void H323Transactor::Request::OnReceiveRIP(unsigned milliseconds)
 
 H323Transactor::Response::Response(const H323TransportAddress & addr, unsigned seqNum)
   : PString(addr),
+    lastUsedTime(PTimer::Tick()),
     retirementAge(ResponseRetirementAge)
 {
   sprintf("#%u", seqNum);
@@ -690,7 +1219,7 @@ void H323Transactor::Response::SetPDU(const H323TransactionPDU & pdu)
   if (replyPDU != NULL)
     replyPDU->DeletePDU();
   replyPDU = pdu.ClonePDU();
-  lastUsedTime = PTime();
+  lastUsedTime = PTimer::Tick();
 
   unsigned delay = pdu.GetRequestInProgressDelay();
   if (delay > 0)
@@ -698,6 +1227,19 @@ void H323Transactor::Response::SetPDU(const H323TransactionPDU & pdu)
 }
 
 
+void H323Transactor::Response::SetData(const PBYTEArray & data)
+{
+  PTRACE(4, "Trans\tAdding cached encoded response: " << *this);
+
+  if (replyPDU != NULL) {
+    replyPDU->DeletePDU();
+    replyPDU = NULL;
+  }
+  replyData = data;
+  lastUsedTime = PTimer::Tick();
+}
+
+
 PBoolean H323Transactor::Response::SendCachedResponse(H323Transport & transport)
 {
   PTRACE(3, "Trans\tSending cached response: " << *this);
@@ -708,11 +1250,17 @@ PBoolean H323Transactor::Response::SendCachedResponse(H323Transport & transport)
     replyPDU->Write(transport);
     transport.ConnectTo(oldAddress);
   }
+  else if (!replyData.IsEmpty()) {
+    H323TransportAddress oldAddress = transport.GetRemoteAddress();
+    transport.ConnectTo(Left(FindLast('#')));
+    transport.WritePDU(replyData);
+    transport.ConnectTo(oldAddress);
+  }
   else {
     PTRACE(2, "Trans\tRetry made by remote before sending response: " << *this);
   }
 
-  lastUsedTime = PTime();
+  lastUsedTime = PTimer::Tick();
   return TRUE;
 }
 
@@ -724,7 +1272,8 @@ H323Transaction::H323Transaction(H323Transactor & trans,
                                  H323TransactionPDU * conf,
                                  H323TransactionPDU * rej)
   : transactor(trans),
-    replyAddresses(trans.GetTransport().GetLastReceivedAddress()),
+    requestAddress(trans.GetTransport().GetLastReceivedAddress()),
+    replyAddresses(requestAddress),
     request(requestToCopy.ClonePDU())
 {
   confirm = conf;
@@ -794,10 +1343,50 @@ void H323Transaction::SlowHandler(PThread &, H323_INT)
 }
 
 
+H323Transactor::RequestPriority H323Transaction::GetPriority() const
+{
+  return H323Transactor::NormalPriority;
+}
+
+
+H323Transactor::RequestQueue H323Transaction::GetQueue() const
+{
+  return H323Transactor::OrderedQueue;
+}
+
+
+H323Transaction::Response H323Transaction::OnOverload()
+{
+  return Ignore;
+}
+
+
+PBoolean H323Transaction::CanSendEarlyRIP() const
+{
+  return canSendRIP;
+}
+
+
+PBoolean H323Transaction::SendRIP(unsigned delay)
+{
+  H323TransactionPDU * rip = CreateRIP(request->GetSequenceNumber(), delay);
+  PBoolean ok = WritePDU(*rip);
+  delete rip;
+  return ok;
+}
+
+
+void H323Transaction::HandleOverload()
+{
+  if (OnOverload() == Reject && reject != NULL)
+    WritePDU(*reject);
+}
+
+
 PBoolean H323Transaction::WritePDU(H323TransactionPDU & pdu)
 {
   pdu.SetAuthenticators(authenticators);
-  return transactor.WriteTo(pdu, replyAddresses, TRUE);
+  return transactor.WriteResponse(pdu, replyAddresses, requestAddress);
 }
 
 
@@ -824,6 +1413,10 @@ H323TransactionServer::H323TransactionServer(H323EndPoint & ep)
 {
   usingAllInterfaces = FALSE;
   monitorThread = NULL;
+  listenerWorkerThreads = 0;
+  listenerOverloadLimit = 0;
+  listenerSockets = 1;
+  listenerReadBatch = 0;
 }
 
 
@@ -886,7 +1479,7 @@ PBoolean H323TransactionServer::AddListener(const H323TransportAddress & interfa
       }
     }
     PTRACE(2, "H323\tAdding listener for " << interfaceName);
-    return AddListener(new H323TransportUDP(ownerEndPoint, addr, port));
+    return AddSharedListeners(addr, port);
   }
 
   if (!usingAllInterfaces) {
@@ -894,7 +1487,31 @@ PBoolean H323TransactionServer::AddListener(const H323TransportAddress & interfa
     usingAllInterfaces = TRUE;
   }
 
-  return AddListener(new H323TransportUDP(ownerEndPoint, PIPSocket::Address(PIPSocket::GetDefaultIpAny()), port));
+  return AddSharedListeners(PIPSocket::GetDefaultIpAny(), port);
+}
+
+
+PBoolean H323TransactionServer::AddSharedListeners(const PIPSocket::Address & addr, WORD port)
+{
+  PINDEX count = listenerSockets;
+  if (count > 1 && !H323ListenerSocket::IsReusePortAvailable()) {
+    PTRACE(2, "Trans\tCannot share port " << port << ", using one listener");
+    count = 1;
+  }
+
+  if (count <= 1)
+    return AddListener(new H323TransportUDP(ownerEndPoint, addr, port));
+
+  // The kernel spreads the peers over the sockets, each listener keeps
+  // the responses for retransmissions of its own peers
+  PINDEX started = 0;
+  for (PINDEX i = 0; i < count; i++) {
+    if (AddListener(new H323TransportUDP(ownerEndPoint, addr, port, 0, TRUE)))
+      started++;
+  }
+
+  PTRACE(3, "Trans\tStarted " << started << " of " << count << " listeners sharing " << addr << ':' << port);
+  return started > 0;
 }
 
 
@@ -908,6 +1525,9 @@ PBoolean H323TransactionServer::AddListener(H323Transport * transport)
     return FALSE;
   }
 
+  if (listenerReadBatch > 1 && PIsDescendant(transport, H323TransportUDP))
+    ((H323TransportUDP *)transport)->SetReadBatchSize(listenerReadBatch);
+
   return AddListener(CreateListener(transport));
 }
 
@@ -923,6 +1543,10 @@ PBoolean H323TransactionServer::AddListener(H323Transactor * listener)
   listeners.Append(listener);
   mutex.Signal();
 
+  if (listenerWorkerThreads > 0)
+    listener->SetWorkerThreads(listenerWorkerThreads);
+  if (listenerOverloadLimit > 0)
+    listener->SetOverloadLimit(listenerOverloadLimit);
   listener->StartChannel();
 
   return TRUE;
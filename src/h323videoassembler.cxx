@@ -0,0 +1,230 @@
+/*
+ * h323videoassembler.cxx
+ *
+ * Reordering and reassembly of received video pictures
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "h323videoassembler.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#include "h323videoassembler.h"
+
+#ifdef H323_VIDEO
+
+#define new PNEW
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323VideoAssembler::H323VideoAssembler(PINDEX _window)
+  : window(_window > 0 ? _window : 1),
+    started(FALSE),
+    nextSequence(0),
+    discarding(FALSE),
+    discardTimestamp(0),
+    droppedSinceTaken(0),
+    picturesCompleted(0),
+    picturesDropped(0),
+    packetsReordered(0),
+    packetsDiscarded(0)
+{
+}
+
+
+void H323VideoAssembler::Push(const RTP_DataFrame & frame)
+{
+  WORD sequenceNumber = frame.GetSequenceNumber();
+  if (!started) {
+    // Started a wrap up so sequence numbers before the first are below it
+    nextSequence = 0x10000 + sequenceNumber;
+    started = TRUE;
+  }
+
+  DWORD sequence = nextSequence + (short)(WORD)(sequenceNumber - (WORD)nextSequence);
+
+  if (discarding && frame.GetTimestamp() == discardTimestamp) {
+    // The rest of a dropped picture, moving past it unless packets of the
+    // next picture are already held before it
+    if (sequence >= nextSequence && (packets.empty() || packets.begin()->first > sequence))
+      nextSequence = sequence + 1;
+    packetsDiscarded++;
+    return;
+  }
+
+  if (sequence < nextSequence) {
+    PTRACE(4, "VideoAsm\tDiscarded late packet " << sequenceNumber);
+    packetsDiscarded++;
+    return;
+  }
+
+  // Far ahead is the source starting again rather than reordering
+  if (sequence - nextSequence > (DWORD)window*4) {
+    PTRACE(3, "VideoAsm\tSequence jumped from " << (WORD)nextSequence << " to " << sequenceNumber << ", restarting");
+    if (!packets.empty()) {
+      picturesDropped++;
+      droppedSinceTaken++;
+      packets.clear();
+    }
+    nextSequence = sequence;
+    discarding = FALSE;
+  }
+
+  if (packets.find(sequence) != packets.end()) {
+    packetsDiscarded++;
+    return;
+  }
+
+  if (!packets.empty() && sequence < packets.rbegin()->first)
+    packetsReordered++;
+
+  // The receive loop reads the next packet into the same frame
+  PINDEX size = frame.GetHeaderSize() + frame.GetPayloadSize();
+  RTP_DataFrame & copy = packets.insert(PacketMap::value_type(sequence, RTP_DataFrame(0))).first->second;
+  copy.SetMinSize(size);
+  memcpy(copy.GetPointer(), (const BYTE *)frame, size);
+  copy.SetPayloadSize(frame.GetPayloadSize());
+
+  Assemble();
+}
+
+
+void H323VideoAssembler::Assemble()
+{
+  while (!packets.empty()) {
+    PacketMap::iterator it = packets.begin();
+
+    if (it->first == nextSequence) {
+      // Look for the end of the picture in the packets without a gap
+      DWORD timestamp = it->second.GetTimestamp();
+      DWORD expected = nextSequence;
+      PBoolean complete = FALSE;
+      while (it != packets.end() && it->first == expected) {
+        if (it->second.GetTimestamp() != timestamp) {
+          PTRACE(4, "VideoAsm\tMarker lost before packet " << (WORD)expected);
+          complete = TRUE;
+          break;
+        }
+        expected++;
+        if (it->second.GetMarker()) {
+          complete = TRUE;
+          break;
+        }
+        ++it;
+      }
+
+      if (complete) {
+        while (!packets.empty() && packets.begin()->first < expected) {
+          ready.push_back(packets.begin()->second);
+          packets.erase(packets.begin());
+        }
+        nextSequence = expected;
+        discarding = FALSE;
+        picturesCompleted++;
+        continue;
+      }
+    }
+
+    // Give up on the oldest picture once a window of packets is past it
+    if (packets.rbegin()->first - nextSequence < (DWORD)window)
+      return;
+
+    DropOldest();
+  }
+}
+
+
+void H323VideoAssembler::DropOldest()
+{
+  DWORD timestamp = packets.begin()->second.GetTimestamp();
+  DWORD last = packets.begin()->first;
+  PBoolean marker = FALSE;
+  PINDEX count = 0;
+
+  while (!packets.empty() && packets.begin()->second.GetTimestamp() == timestamp) {
+    last = packets.begin()->first;
+    marker = packets.begin()->second.GetMarker();
+    packets.erase(packets.begin());
+    count++;
+  }
+
+  PTRACE(3, "VideoAsm\tDropped incomplete picture of " << count << " packets at sequence "
+         << (WORD)nextSequence << ", timestamp " << timestamp);
+
+  // Packets of the dropped picture may still be on the way
+  nextSequence = packets.empty() ? last + 1 : packets.begin()->first;
+  discarding = !marker;
+  discardTimestamp = timestamp;
+  packetsDiscarded += count;
+  picturesDropped++;
+  droppedSinceTaken++;
+}
+
+
+PBoolean H323VideoAssembler::Pop(RTP_DataFrame & frame)
+{
+  if (ready.empty())
+    return FALSE;
+
+  frame = ready.front();
+  ready.pop_front();
+  return TRUE;
+}
+
+
+unsigned H323VideoAssembler::TakeDroppedPictures()
+{
+  unsigned dropped = droppedSinceTaken;
+  droppedSinceTaken = 0;
+  return dropped;
+}
+
+
+void H323VideoAssembler::Reset()
+{
+  packets.clear();
+  ready.clear();
+  started = FALSE;
+  discarding = FALSE;
+}
+
+
+void H323VideoAssembler::PrintOn(ostream & strm) const
+{
+  strm << picturesCompleted << " pictures, " << picturesDropped << " dropped, "
+       << packetsReordered << " packets reordered, " << packetsDiscarded << " discarded";
+}
+
+
+#endif // H323_VIDEO
+
+
+/////////////////////////////////////////////////////////////////////////////
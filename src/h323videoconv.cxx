@@ -0,0 +1,822 @@
+/*
+ * h323videoconv.cxx
+ *
+ * Colour conversion and scaling of video pictures
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "h323videoconv.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#include "h323videoconv.h"
+
+#ifdef H323_VIDEO
+
+#ifndef H323_VIDEO_NO_SIMD
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define H323_VIDEO_SSE2 1
+#include <emmintrin.h>
+#if (defined(__GNUC__) && __GNUC__ >= 5) || defined(__clang__)
+#define H323_VIDEO_AVX2 1
+#include <immintrin.h>
+#endif
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define H323_VIDEO_NEON 1
+#include <arm_neon.h>
+#endif
+#endif // H323_VIDEO_NO_SIMD
+
+#define new PNEW
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+// Byte order of the packed RGB formats, green is always the middle byte
+struct RGBLayout {
+  unsigned bytesPerPixel;
+  unsigned redOffset;
+  unsigned blueOffset;
+};
+
+struct H323VideoConverter::KernelFunctions {
+  // dst = (line0*(256-fraction) + line1*fraction + 128) >> 8
+  void (*blendLine)(const BYTE * line0, const BYTE * line1, BYTE * dst, unsigned count, unsigned fraction);
+  // dst = average of each 2x2 block of the two lines, count output pixels
+  void (*halveLine)(const BYTE * line0, const BYTE * line1, BYTE * dst, unsigned count);
+  // Two lines of pixels to two Y lines and one U and V line
+  void (*yuy2Lines)(const BYTE * line0, const BYTE * line1, BYTE * y0, BYTE * y1, BYTE * u, BYTE * v, unsigned width);
+  void (*rgbLines)(const BYTE * line0, const BYTE * line1, BYTE * y0, BYTE * y1, BYTE * u, BYTE * v, unsigned width, const RGBLayout & layout);
+};
+
+
+// BT.601 studio swing in 8 bit fixed point, rounded. The offsets are folded
+// into the constant added so the sums are never negative, which the vector
+// kernels can then do in wrapping 16 bit arithmetic.
+#define RGB_Y(r, g, b) (BYTE)((  66*(r) + 129*(g) +  25*(b) + 0x1080) >> 8)
+#define RGB_U(r, g, b) (BYTE)(( -38*(r) -  74*(g) + 112*(b) + 0x8080) >> 8)
+#define RGB_V(r, g, b) (BYTE)(( 112*(r) -  94*(g) -  18*(b) + 0x8080) >> 8)
+
+
+static void BlendLine_(const BYTE * line0, const BYTE * line1, BYTE * dst, unsigned count, unsigned fraction)
+{
+  unsigned weight0 = 256 - fraction;
+  while (count-- > 0)
+    *dst++ = (BYTE)((*line0++ * weight0 + *line1++ * fraction + 128) >> 8);
+}
+
+
+static void HalveLine_(const BYTE * line0, const BYTE * line1, BYTE * dst, unsigned count)
+{
+  while (count-- > 0) {
+    *dst++ = (BYTE)((line0[0] + line0[1] + line1[0] + line1[1] + 2) >> 2);
+    line0 += 2;
+    line1 += 2;
+  }
+}
+
+
+static void YUY2Lines_(const BYTE * line0, const BYTE * line1, BYTE * y0, BYTE * y1, BYTE * u, BYTE * v, unsigned width)
+{
+  for (unsigned x = 0; x < width; x += 2) {
+    *y0++ = line0[0];
+    *y0++ = line0[2];
+    *y1++ = line1[0];
+    *y1++ = line1[2];
+    *u++ = (BYTE)((line0[1] + line1[1] + 1) >> 1);
+    *v++ = (BYTE)((line0[3] + line1[3] + 1) >> 1);
+    line0 += 4;
+    line1 += 4;
+  }
+}
+
+
+static void RGBLines_(const BYTE * line0, const BYTE * line1, BYTE * y0, BYTE * y1, BYTE * u, BYTE * v,
+                      unsigned width, const RGBLayout & layout)
+{
+  const unsigned bpp = layout.bytesPerPixel;
+  const unsigned ro = layout.redOffset;
+  const unsigned bo = layout.blueOffset;
+
+  for (unsigned x = 0; x < width; x += 2) {
+    *y0++ = RGB_Y(line0[ro], line0[1], line0[bo]);
+    *y0++ = RGB_Y(line0[bpp+ro], line0[bpp+1], line0[bpp+bo]);
+    *y1++ = RGB_Y(line1[ro], line1[1], line1[bo]);
+    *y1++ = RGB_Y(line1[bpp+ro], line1[bpp+1], line1[bpp+bo]);
+
+    // Chroma of the average colour of the 2x2 block
+    int r = (line0[ro] + line0[bpp+ro] + line1[ro] + line1[bpp+ro] + 2) >> 2;
+    int g = (line0[1]  + line0[bpp+1]  + line1[1]  + line1[bpp+1]  + 2) >> 2;
+    int b = (line0[bo] + line0[bpp+bo] + line1[bo] + line1[bpp+bo] + 2) >> 2;
+    *u++ = RGB_U(r, g, b);
+    *v++ = RGB_V(r, g, b);
+
+    line0 += 2*bpp;
+    line1 += 2*bpp;
+  }
+}
+
+
+// The horizontal pass of the bilinear scaling, positions in 16.16 fixed
+// point with pixel centres lined up between the two sizes
+static void ScaleLine(const BYTE * src, unsigned srcWidth, BYTE * dst, unsigned dstWidth)
+{
+  unsigned step = (srcWidth << 16) / dstWidth;
+  int position = (int)(step/2) - 0x8000;
+
+  for (unsigned x = 0; x < dstWidth; x++, position += step) {
+    if (position <= 0) {
+      *dst++ = src[0];
+      continue;
+    }
+
+    unsigned index = position >> 16;
+    if (index+1 >= srcWidth) {
+      *dst++ = src[srcWidth-1];
+      continue;
+    }
+
+    unsigned fraction = (position >> 8) & 0xff;
+    *dst++ = (BYTE)((src[index] * (256 - fraction) + src[index+1] * fraction + 128) >> 8);
+  }
+}
+
+
+static const H323VideoConverter::KernelFunctions ScalarFunctions = {
+  BlendLine_, HalveLine_, YUY2Lines_, RGBLines_
+};
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+// The products and sums of the vector kernels fit 16 bits unsigned, so they
+// are done on 16 bit lanes and are exactly those of the scalar code.
+
+#ifdef H323_VIDEO_SSE2
+
+static void BlendLineSSE2(const BYTE * line0, const BYTE * line1, BYTE * dst, unsigned count, unsigned fraction)
+{
+  const __m128i zero    = _mm_setzero_si128();
+  const __m128i weight0 = _mm_set1_epi16((short)(256 - fraction));
+  const __m128i weight1 = _mm_set1_epi16((short)fraction);
+  const __m128i half    = _mm_set1_epi16(128);
+
+  unsigned done = count & ~15u;
+  for (unsigned x = 0; x < done; x += 16) {
+    __m128i a = _mm_loadu_si128((const __m128i *)(line0+x));
+    __m128i b = _mm_loadu_si128((const __m128i *)(line1+x));
+    __m128i low  = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), weight0),
+                                 _mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), weight1));
+    __m128i high = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), weight0),
+                                 _mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), weight1));
+    low  = _mm_srli_epi16(_mm_add_epi16(low, half), 8);
+    high = _mm_srli_epi16(_mm_add_epi16(high, half), 8);
+    _mm_storeu_si128((__m128i *)(dst+x), _mm_packus_epi16(low, high));
+  }
+  BlendLine_(line0+done, line1+done, dst+done, count-done, fraction);
+}
+
+
+// Sums of each pair of bytes of both lines, 8 from 16 bytes of each
+static inline __m128i PairSums8_SSE2(__m128i a, __m128i b)
+{
+  const __m128i mask = _mm_set1_epi16(0x00FF);
+  return _mm_add_epi16(_mm_add_epi16(_mm_and_si128(a, mask), _mm_srli_epi16(a, 8)),
+                       _mm_add_epi16(_mm_and_si128(b, mask), _mm_srli_epi16(b, 8)));
+}
+
+
+static void HalveLineSSE2(const BYTE * line0, const BYTE * line1, BYTE * dst, unsigned count)
+{
+  const __m128i two = _mm_set1_epi16(2);
+
+  unsigned done = count & ~15u;
+  for (unsigned x = 0; x < done; x += 16) {
+    __m128i low  = PairSums8_SSE2(_mm_loadu_si128((const __m128i *)(line0+2*x)),
+                                  _mm_loadu_si128((const __m128i *)(line1+2*x)));
+    __m128i high = PairSums8_SSE2(_mm_loadu_si128((const __m128i *)(line0+2*x+16)),
+                                  _mm_loadu_si128((const __m128i *)(line1+2*x+16)));
+    low  = _mm_srli_epi16(_mm_add_epi16(low, two), 2);
+    high = _mm_srli_epi16(_mm_add_epi16(high, two), 2);
+    _mm_storeu_si128((__m128i *)(dst+x), _mm_packus_epi16(low, high));
+  }
+  HalveLine_(line0+2*done, line1+2*done, dst+done, count-done);
+}
+
+
+static void YUY2LinesSSE2(const BYTE * line0, const BYTE * line1, BYTE * y0, BYTE * y1, BYTE * u, BYTE * v, unsigned width)
+{
+  const __m128i mask = _mm_set1_epi16(0x00FF);
+  const __m128i zero = _mm_setzero_si128();
+
+  unsigned done = width & ~15u;
+  for (unsigned x = 0; x < done; x += 16) {
+    __m128i a0 = _mm_loadu_si128((const __m128i *)(line0+2*x));
+    __m128i a1 = _mm_loadu_si128((const __m128i *)(line0+2*x+16));
+    __m128i b0 = _mm_loadu_si128((const __m128i *)(line1+2*x));
+    __m128i b1 = _mm_loadu_si128((const __m128i *)(line1+2*x+16));
+
+    _mm_storeu_si128((__m128i *)(y0+x), _mm_packus_epi16(_mm_and_si128(a0, mask), _mm_and_si128(a1, mask)));
+    _mm_storeu_si128((__m128i *)(y1+x), _mm_packus_epi16(_mm_and_si128(b0, mask), _mm_and_si128(b1, mask)));
+
+    // U and V still interleaved, averaged across the lines
+    __m128i chroma = _mm_avg_epu8(_mm_packus_epi16(_mm_srli_epi16(a0, 8), _mm_srli_epi16(a1, 8)),
+                                  _mm_packus_epi16(_mm_srli_epi16(b0, 8), _mm_srli_epi16(b1, 8)));
+    _mm_storel_epi64((__m128i *)(u+x/2), _mm_packus_epi16(_mm_and_si128(chroma, mask), zero));
+    _mm_storel_epi64((__m128i *)(v+x/2), _mm_packus_epi16(_mm_srli_epi16(chroma, 8), zero));
+  }
+  YUY2Lines_(line0+2*done, line1+2*done, y0+done, y1+done, u+done/2, v+done/2, width-done);
+}
+
+
+// One channel of 8 pixels of four bytes, as 16 bit lanes
+static inline __m128i Channel8_SSE2(__m128i low, __m128i high, int shift)
+{
+  const __m128i mask = _mm_set1_epi32(0xFF);
+  return _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(low, shift), mask),
+                         _mm_and_si128(_mm_srli_epi32(high, shift), mask));
+}
+
+
+static inline __m128i RGBToY8_SSE2(__m128i r, __m128i g, __m128i b)
+{
+  __m128i y = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(66)),
+                                          _mm_mullo_epi16(g, _mm_set1_epi16(129))),
+                            _mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(25)),
+                                          _mm_set1_epi16(0x1080)));
+  return _mm_srli_epi16(y, 8);
+}
+
+
+// Sums of the channel over each 2x2 block, for 16 pixels of the two lines
+static inline __m128i BlockSums8_SSE2(__m128i line0a, __m128i line1a, __m128i line0b, __m128i line1b)
+{
+  const __m128i mask = _mm_set1_epi32(0xFFFF);
+  __m128i a = _mm_add_epi16(line0a, line1a);
+  __m128i b = _mm_add_epi16(line0b, line1b);
+  a = _mm_and_si128(_mm_add_epi16(a, _mm_srli_epi32(a, 16)), mask);
+  b = _mm_and_si128(_mm_add_epi16(b, _mm_srli_epi32(b, 16)), mask);
+  return _mm_packs_epi32(a, b);
+}
+
+
+static void RGBLinesSSE2(const BYTE * line0, const BYTE * line1, BYTE * y0, BYTE * y1, BYTE * u, BYTE * v,
+                         unsigned width, const RGBLayout & layout)
+{
+  if (layout.bytesPerPixel != 4) {
+    RGBLines_(line0, line1, y0, y1, u, v, width, layout);
+    return;
+  }
+
+  const int rs = layout.redOffset*8;
+  const int bs = layout.blueOffset*8;
+  const __m128i two = _mm_set1_epi16(2);
+  const __m128i zero = _mm_setzero_si128();
+
+  unsigned done = width & ~15u;
+  for (unsigned x = 0; x < done; x += 16) {
+    __m128i r[2][2], g[2][2], b[2][2];
+    const BYTE * lines[2] = { line0+4*x, line1+4*x };
+
+    for (int l = 0; l < 2; l++) {
+      __m128i p0 = _mm_loadu_si128((const __m128i *)(lines[l]));
+      __m128i p1 = _mm_loadu_si128((const __m128i *)(lines[l]+16));
+      __m128i p2 = _mm_loadu_si128((const __m128i *)(lines[l]+32));
+      __m128i p3 = _mm_loadu_si128((const __m128i *)(lines[l]+48));
+      r[l][0] = Channel8_SSE2(p0, p1, rs);
+      g[l][0] = Channel8_SSE2(p0, p1, 8);
+      b[l][0] = Channel8_SSE2(p0, p1, bs);
+      r[l][1] = Channel8_SSE2(p2, p3, rs);
+      g[l][1] = Channel8_SSE2(p2, p3, 8);
+      b[l][1] = Channel8_SSE2(p2, p3, bs);
+    }
+
+    _mm_storeu_si128((__m128i *)(y0+x), _mm_packus_epi16(RGBToY8_SSE2(r[0][0], g[0][0], b[0][0]),
+                                                         RGBToY8_SSE2(r[0][1], g[0][1], b[0][1])));
+    _mm_storeu_si128((__m128i *)(y1+x), _mm_packus_epi16(RGBToY8_SSE2(r[1][0], g[1][0], b[1][0]),
+                                                         RGBToY8_SSE2(r[1][1], g[1][1], b[1][1])));
+
+    __m128i ar = _mm_srli_epi16(_mm_add_epi16(BlockSums8_SSE2(r[0][0], r[1][0], r[0][1], r[1][1]), two), 2);
+    __m128i ag = _mm_srli_epi16(_mm_add_epi16(BlockSums8_SSE2(g[0][0], g[1][0], g[0][1], g[1][1]), two), 2);
+    __m128i ab = _mm_srli_epi16(_mm_add_epi16(BlockSums8_SSE2(b[0][0], b[1][0], b[0][1], b[1][1]), two), 2);
+
+    __m128i cu = _mm_add_epi16(_mm_sub_epi16(_mm_mullo_epi16(ab, _mm_set1_epi16(112)),
+                                             _mm_add_epi16(_mm_mullo_epi16(ar, _mm_set1_epi16(38)),
+                                                           _mm_mullo_epi16(ag, _mm_set1_epi16(74)))),
+                               _mm_set1_epi16((short)0x8080));
+    __m128i cv = _mm_add_epi16(_mm_sub_epi16(_mm_mullo_epi16(ar, _mm_set1_epi16(112)),
+                                             _mm_add_epi16(_mm_mullo_epi16(ag, _mm_set1_epi16(94)),
+                                                           _mm_mullo_epi16(ab, _mm_set1_epi16(18)))),
+                               _mm_set1_epi16((short)0x8080));
+    _mm_storel_epi64((__m128i *)(u+x/2), _mm_packus_epi16(_mm_srli_epi16(cu, 8), zero));
+    _mm_storel_epi64((__m128i *)(v+x/2), _mm_packus_epi16(_mm_srli_epi16(cv, 8), zero));
+  }
+  RGBLines_(line0+4*done, line1+4*done, y0+done, y1+done, u+done/2, v+done/2, width-done, layout);
+}
+
+
+static const H323VideoConverter::KernelFunctions SSE2Functions = {
+  BlendLineSSE2, HalveLineSSE2, YUY2LinesSSE2, RGBLinesSSE2
+};
+
+#endif // H323_VIDEO_SSE2
+
+
+#ifdef H323_VIDEO_AVX2
+
+#define H323_VIDEO_AVX2_TARGET __attribute__((target("avx2")))
+
+// Unpack and pack both work within each 128 bit lane so the order holds
+H323_VIDEO_AVX2_TARGET
+static void BlendLineAVX2(const BYTE * line0, const BYTE * line1, BYTE * dst, unsigned count, unsigned fraction)
+{
+  const __m256i zero    = _mm256_setzero_si256();
+  const __m256i weight0 = _mm256_set1_epi16((short)(256 - fraction));
+  const __m256i weight1 = _mm256_set1_epi16((short)fraction);
+  const __m256i half    = _mm256_set1_epi16(128);
+
+  unsigned done = count & ~31u;
+  for (unsigned x = 0; x < done; x += 32) {
+    __m256i a = _mm256_loadu_si256((const __m256i *)(line0+x));
+    __m256i b = _mm256_loadu_si256((const __m256i *)(line1+x));
+    __m256i low  = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(a, zero), weight0),
+                                    _mm256_mullo_epi16(_mm256_unpacklo_epi8(b, zero), weight1));
+    __m256i high = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(a, zero), weight0),
+                                    _mm256_mullo_epi16(_mm256_unpackhi_epi8(b, zero), weight1));
+    low  = _mm256_srli_epi16(_mm256_add_epi16(low, half), 8);
+    high = _mm256_srli_epi16(_mm256_add_epi16(high, half), 8);
+    _mm256_storeu_si256((__m256i *)(dst+x), _mm256_packus_epi16(low, high));
+  }
+  BlendLineSSE2(line0+done, line1+done, dst+done, count-done, fraction);
+}
+
+
+H323_VIDEO_AVX2_TARGET
+static inline __m256i PairSums16_AVX2(__m256i a, __m256i b)
+{
+  const __m256i mask = _mm256_set1_epi16(0x00FF);
+  return _mm256_add_epi16(_mm256_add_epi16(_mm256_and_si256(a, mask), _mm256_srli_epi16(a, 8)),
+                          _mm256_add_epi16(_mm256_and_si256(b, mask), _mm256_srli_epi16(b, 8)));
+}
+
+
+// The sums come out in the order of the source, so the pack across the two
+// halves needs the middle quarters swapped back
+H323_VIDEO_AVX2_TARGET
+static void HalveLineAVX2(const BYTE * line0, const BYTE * line1, BYTE * dst, unsigned count)
+{
+  const __m256i two = _mm256_set1_epi16(2);
+
+  unsigned done = count & ~31u;
+  for (unsigned x = 0; x < done; x += 32) {
+    __m256i low  = PairSums16_AVX2(_mm256_loadu_si256((const __m256i *)(line0+2*x)),
+                                   _mm256_loadu_si256((const __m256i *)(line1+2*x)));
+    __m256i high = PairSums16_AVX2(_mm256_loadu_si256((const __m256i *)(line0+2*x+32)),
+                                   _mm256_loadu_si256((const __m256i *)(line1+2*x+32)));
+    low  = _mm256_srli_epi16(_mm256_add_epi16(low, two), 2);
+    high = _mm256_srli_epi16(_mm256_add_epi16(high, two), 2);
+    _mm256_storeu_si256((__m256i *)(dst+x),
+                        _mm256_permute4x64_epi64(_mm256_packus_epi16(low, high), 0xD8));
+  }
+  HalveLineSSE2(line0+2*done, line1+2*done, dst+done, count-done);
+}
+
+
+static bool HasAVX2()
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") != 0;
+}
+
+
+static const H323VideoConverter::KernelFunctions AVX2Functions = {
+  BlendLineAVX2, HalveLineAVX2, YUY2LinesSSE2, RGBLinesSSE2
+};
+
+#endif // H323_VIDEO_AVX2
+
+
+#ifdef H323_VIDEO_NEON
+
+static void BlendLineNEON(const BYTE * line0, const BYTE * line1, BYTE * dst, unsigned count, unsigned fraction)
+{
+  const uint8x8_t weight0 = vdup_n_u8((uint8_t)(256 - fraction));
+  const uint8x8_t weight1 = vdup_n_u8((uint8_t)fraction);
+
+  unsigned done = count & ~15u;
+  for (unsigned x = 0; x < done; x += 16) {
+    uint8x16_t a = vld1q_u8(line0+x);
+    uint8x16_t b = vld1q_u8(line1+x);
+    uint16x8_t low  = vmlal_u8(vmull_u8(vget_low_u8(a), weight0), vget_low_u8(b), weight1);
+    uint16x8_t high = vmlal_u8(vmull_u8(vget_high_u8(a), weight0), vget_high_u8(b), weight1);
+    vst1q_u8(dst+x, vcombine_u8(vrshrn_n_u16(low, 8), vrshrn_n_u16(high, 8)));
+  }
+  BlendLine_(line0+done, line1+done, dst+done, count-done, fraction);
+}
+
+
+static void HalveLineNEON(const BYTE * line0, const BYTE * line1, BYTE * dst, unsigned count)
+{
+  unsigned done = count & ~15u;
+  for (unsigned x = 0; x < done; x += 16) {
+    uint16x8_t low  = vpadalq_u8(vpaddlq_u8(vld1q_u8(line0+2*x)),    vld1q_u8(line1+2*x));
+    uint16x8_t high = vpadalq_u8(vpaddlq_u8(vld1q_u8(line0+2*x+16)), vld1q_u8(line1+2*x+16));
+    vst1q_u8(dst+x, vcombine_u8(vrshrn_n_u16(low, 2), vrshrn_n_u16(high, 2)));
+  }
+  HalveLine_(line0+2*done, line1+2*done, dst+done, count-done);
+}
+
+
+static void YUY2LinesNEON(const BYTE * line0, const BYTE * line1, BYTE * y0, BYTE * y1, BYTE * u, BYTE * v, unsigned width)
+{
+  unsigned done = width & ~31u;
+  for (unsigned x = 0; x < done; x += 32) {
+    uint8x16x4_t a = vld4q_u8(line0+2*x);   // Y even, U, Y odd, V
+    uint8x16x4_t b = vld4q_u8(line1+2*x);
+
+    uint8x16x2_t ya, yb;
+    ya.val[0] = a.val[0];
+    ya.val[1] = a.val[2];
+    yb.val[0] = b.val[0];
+    yb.val[1] = b.val[2];
+    vst2q_u8(y0+x, ya);
+    vst2q_u8(y1+x, yb);
+
+    vst1q_u8(u+x/2, vrhaddq_u8(a.val[1], b.val[1]));
+    vst1q_u8(v+x/2, vrhaddq_u8(a.val[3], b.val[3]));
+  }
+  YUY2Lines_(line0+2*done, line1+2*done, y0+done, y1+done, u+done/2, v+done/2, width-done);
+}
+
+
+static inline uint8x16_t RGBToY16_NEON(uint8x16_t r, uint8x16_t g, uint8x16_t b)
+{
+  const uint16x8_t bias = vdupq_n_u16(0x1080);
+  uint16x8_t low  = vmlal_u8(vmlal_u8(vmull_u8(vget_low_u8(r), vdup_n_u8(66)),
+                                      vget_low_u8(g), vdup_n_u8(129)),
+                             vget_low_u8(b), vdup_n_u8(25));
+  uint16x8_t high = vmlal_u8(vmlal_u8(vmull_u8(vget_high_u8(r), vdup_n_u8(66)),
+                                      vget_high_u8(g), vdup_n_u8(129)),
+                             vget_high_u8(b), vdup_n_u8(25));
+  return vcombine_u8(vshrn_n_u16(vaddq_u16(low, bias), 8), vshrn_n_u16(vaddq_u16(high, bias), 8));
+}
+
+
+// Rounded average of the channel over each 2x2 block of the 16 pixels
+static inline uint16x8_t BlockAverage8_NEON(uint8x16_t line0, uint8x16_t line1)
+{
+  return vrshrq_n_u16(vpadalq_u8(vpaddlq_u8(line0), line1), 2);
+}
+
+
+static void RGBLinesNEON(const BYTE * line0, const BYTE * line1, BYTE * y0, BYTE * y1, BYTE * u, BYTE * v,
+                         unsigned width, const RGBLayout & layout)
+{
+  const unsigned bpp = layout.bytesPerPixel;
+  const unsigned ro = layout.redOffset;
+  const unsigned bo = layout.blueOffset;
+  const uint16x8_t bias = vdupq_n_u16(0x8080);
+
+  unsigned done = width & ~15u;
+  for (unsigned x = 0; x < done; x += 16) {
+    uint8x16_t c0[4], c1[4];
+    if (bpp == 4) {
+      uint8x16x4_t a = vld4q_u8(line0+4*x);
+      uint8x16x4_t b = vld4q_u8(line1+4*x);
+      for (int c = 0; c < 4; c++) {
+        c0[c] = a.val[c];
+        c1[c] = b.val[c];
+      }
+    }
+    else {
+      uint8x16x3_t a = vld3q_u8(line0+3*x);
+      uint8x16x3_t b = vld3q_u8(line1+3*x);
+      for (int c = 0; c < 3; c++) {
+        c0[c] = a.val[c];
+        c1[c] = b.val[c];
+      }
+    }
+
+    vst1q_u8(y0+x, RGBToY16_NEON(c0[ro], c0[1], c0[bo]));
+    vst1q_u8(y1+x, RGBToY16_NEON(c1[ro], c1[1], c1[bo]));
+
+    uint16x8_t r = BlockAverage8_NEON(c0[ro], c1[ro]);
+    uint16x8_t g = BlockAverage8_NEON(c0[1],  c1[1]);
+    uint16x8_t b = BlockAverage8_NEON(c0[bo], c1[bo]);
+
+    uint16x8_t cu = vmlsq_n_u16(vmlsq_n_u16(vmlaq_n_u16(bias, b, 112), r, 38), g, 74);
+    uint16x8_t cv = vmlsq_n_u16(vmlsq_n_u16(vmlaq_n_u16(bias, r, 112), g, 94), b, 18);
+    vst1_u8(u+x/2, vshrn_n_u16(cu, 8));
+    vst1_u8(v+x/2, vshrn_n_u16(cv, 8));
+  }
+  RGBLines_(line0+bpp*done, line1+bpp*done, y0+done, y1+done, u+done/2, v+done/2, width-done, layout);
+}
+
+
+static const H323VideoConverter::KernelFunctions NEONFunctions = {
+  BlendLineNEON, HalveLineNEON, YUY2LinesNEON, RGBLinesNEON
+};
+
+#endif // H323_VIDEO_NEON
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+static const H323VideoConverter::KernelFunctions * GetKernelFunctions(H323VideoConverter::Kernels kernel)
+{
+  switch (kernel) {
+#ifdef H323_VIDEO_SSE2
+    case H323VideoConverter::SSE2Kernel :
+      return &SSE2Functions;
+#endif
+#ifdef H323_VIDEO_AVX2
+    case H323VideoConverter::AVX2Kernel :
+      return &AVX2Functions;
+#endif
+#ifdef H323_VIDEO_NEON
+    case H323VideoConverter::NEONKernel :
+      return &NEONFunctions;
+#endif
+    default :
+      return &ScalarFunctions;
+  }
+}
+
+
+static const struct {
+  const char * format;
+  RGBLayout    layout;
+} RGBFormats[] = {
+  { "RGB32", { 4, 0, 2 } },
+  { "BGR32", { 4, 2, 0 } },
+  { "RGB24", { 3, 0, 2 } },
+  { "BGR24", { 3, 2, 0 } }
+};
+
+
+static const RGBLayout * FindRGBLayout(const PString & format)
+{
+  for (PINDEX i = 0; i < PARRAYSIZE(RGBFormats); i++) {
+    if (format == RGBFormats[i].format)
+      return &RGBFormats[i].layout;
+  }
+  return NULL;
+}
+
+
+H323VideoConverter::H323VideoConverter()
+  : kernel(GetBestKernel()),
+    functions(GetKernelFunctions(kernel))
+{
+}
+
+
+PBoolean H323VideoConverter::Convert(const PString & srcFormat, const BYTE * src, unsigned width, unsigned height, BYTE * dst)
+{
+  if (width == 0 || height == 0 || (width & 1) != 0 || (height & 1) != 0)
+    return FALSE;
+
+  if (srcFormat == "YUV420P") {
+    memcpy(dst, src, width*height*3/2);
+    return TRUE;
+  }
+
+  unsigned bytesPerPixel;
+  const RGBLayout * layout = FindRGBLayout(srcFormat);
+  if (layout != NULL)
+    bytesPerPixel = layout->bytesPerPixel;
+  else if (srcFormat == "YUY2" || srcFormat == "YUYV")
+    bytesPerPixel = 2;
+  else {
+    PTRACE(2, "Video\tCannot convert " << srcFormat << " to YUV420P");
+    return FALSE;
+  }
+
+  const unsigned stride = width*bytesPerPixel;
+  BYTE * y = dst;
+  BYTE * u = y + width*height;
+  BYTE * v = u + width*height/4;
+
+  for (unsigned line = 0; line < height; line += 2) {
+    if (layout != NULL)
+      functions->rgbLines(src, src+stride, y, y+width, u, v, width, *layout);
+    else
+      functions->yuy2Lines(src, src+stride, y, y+width, u, v, width);
+    src += 2*stride;
+    y += 2*width;
+    u += width/2;
+    v += width/2;
+  }
+
+  return TRUE;
+}
+
+
+PBoolean H323VideoConverter::Scale(const BYTE * src, unsigned srcWidth, unsigned srcHeight,
+                                   BYTE * dst, unsigned dstWidth, unsigned dstHeight)
+{
+  if (srcWidth == 0 || srcHeight == 0 || dstWidth == 0 || dstHeight == 0 ||
+      ((srcWidth | srcHeight | dstWidth | dstHeight) & 1) != 0)
+    return FALSE;
+
+  const unsigned srcLuma = srcWidth*srcHeight;
+  const unsigned dstLuma = dstWidth*dstHeight;
+
+  ScalePlane(src, srcWidth, srcHeight, dst, dstWidth, dstHeight);
+  ScalePlane(src+srcLuma, srcWidth/2, srcHeight/2, dst+dstLuma, dstWidth/2, dstHeight/2);
+  ScalePlane(src+srcLuma*5/4, srcWidth/2, srcHeight/2, dst+dstLuma*5/4, dstWidth/2, dstHeight/2);
+  return TRUE;
+}
+
+
+void H323VideoConverter::ScalePlane(const BYTE * src, unsigned srcWidth, unsigned srcHeight,
+                                    BYTE * dst, unsigned dstWidth, unsigned dstHeight)
+{
+  if (srcWidth == dstWidth && srcHeight == dstHeight) {
+    memcpy(dst, src, srcWidth*srcHeight);
+    return;
+  }
+
+  if (srcWidth == dstWidth*2 && srcHeight == dstHeight*2) {
+    for (unsigned y = 0; y < dstHeight; y++, src += 2*srcWidth, dst += dstWidth)
+      functions->halveLine(src, src+srcWidth, dst, dstWidth);
+    return;
+  }
+
+  BYTE * blended = lineBuffer.GetPointer(srcWidth);
+
+  unsigned step = (srcHeight << 16) / dstHeight;
+  int position = (int)(step/2) - 0x8000;
+
+  for (unsigned y = 0; y < dstHeight; y++, position += step, dst += dstWidth) {
+    unsigned index = position > 0 ? (position >> 16) : 0;
+    unsigned fraction = position > 0 ? ((position >> 8) & 0xff) : 0;
+    if (index+1 >= srcHeight) {
+      index = srcHeight-1;
+      fraction = 0;
+    }
+
+    const BYTE * line = src + index*srcWidth;
+    if (fraction != 0) {
+      // Blend straight into the picture if there is no horizontal pass
+      BYTE * out = srcWidth == dstWidth ? dst : blended;
+      functions->blendLine(line, line+srcWidth, out, srcWidth, fraction);
+      line = out;
+    }
+
+    if (srcWidth != dstWidth)
+      ScaleLine(line, srcWidth, dst, dstWidth);
+    else if (line != dst)
+      memcpy(dst, line, dstWidth);
+  }
+}
+
+
+PBoolean H323VideoConverter::IsFormatSupported(const PString & format)
+{
+  return format == "YUV420P" || format == "YUY2" || format == "YUYV" || FindRGBLayout(format) != NULL;
+}
+
+
+PBoolean H323VideoConverter::SetKernel(Kernels newKernel)
+{
+  if (!IsKernelAvailable(newKernel))
+    return FALSE;
+
+  kernel = newKernel;
+  functions = GetKernelFunctions(kernel);
+  PTRACE(4, "Video\tConverter using " << GetKernelName(kernel) << " kernel");
+  return TRUE;
+}
+
+
+H323VideoConverter::Kernels H323VideoConverter::GetBestKernel()
+{
+  static const Kernels order[] = { AVX2Kernel, NEONKernel, SSE2Kernel };
+  for (PINDEX i = 0; i < PARRAYSIZE(order); i++) {
+    if (IsKernelAvailable(order[i]))
+      return order[i];
+  }
+  return ScalarKernel;
+}
+
+
+PBoolean H323VideoConverter::IsKernelAvailable(Kernels kernel)
+{
+  switch (kernel) {
+    case ScalarKernel :
+      return TRUE;
+#ifdef H323_VIDEO_SSE2
+    case SSE2Kernel :
+      return TRUE;
+#endif
+#ifdef H323_VIDEO_AVX2
+    case AVX2Kernel :
+      return HasAVX2();
+#endif
+#ifdef H323_VIDEO_NEON
+    case NEONKernel :
+      return TRUE;
+#endif
+    default :
+      return FALSE;
+  }
+}
+
+
+const char * H323VideoConverter::GetKernelName(Kernels kernel)
+{
+  static const char * const names[NumKernels] = { "Scalar", "SSE2", "AVX2", "NEON" };
+  return kernel < NumKernels ? names[kernel] : "<Unknown>";
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323VideoScaler::H323VideoScaler(H323VideoFramePool & _pool)
+  : pool(_pool),
+    scaledCount(0),
+    sharedCount(0)
+{
+}
+
+
+H323VideoFrameRef H323VideoScaler::Scale(const H323VideoFrameRef & picture, unsigned width, unsigned height)
+{
+  if (picture.IsNULL())
+    return picture;
+
+  if (picture->GetWidth() == width && picture->GetHeight() == height)
+    return picture;
+
+  PWaitAndSignal m(mutex);
+
+  if (source != picture) {
+    // Holding the source keeps its buffer from being reused for another
+    // picture while the copies made from it are handed out
+    scaled.clear();
+    source = picture;
+  }
+
+  for (size_t i = 0; i < scaled.size(); i++) {
+    if (scaled[i]->GetWidth() == width && scaled[i]->GetHeight() == height) {
+      sharedCount++;
+      return scaled[i];
+    }
+  }
+
+  H323VideoFrameRef frame = pool.Acquire((PINDEX)(width*height*3/2));
+  if (!converter.Scale(picture->GetData(), picture->GetWidth(), picture->GetHeight(),
+                       frame->GetBuffer(), width, height)) {
+    PTRACE(2, "Video\tCannot scale " << picture->GetWidth() << 'x' << picture->GetHeight()
+           << " to " << width << 'x' << height);
+    return H323VideoFrameRef();
+  }
+
+  frame->SetPicture(0, width, height, picture->GetTimestamp());
+  scaled.push_back(frame);
+  scaledCount++;
+  return frame;
+}
+
+
+void H323VideoScaler::Reset()
+{
+  PWaitAndSignal m(mutex);
+  scaled.clear();
+  source.Release();
+}
+
+
+#endif // H323_VIDEO
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,217 @@
+/*
+ * h323videoframe.cxx
+ *
+ * Pooled buffers of decoded video pictures
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "h323videoframe.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#include "h323videoframe.h"
+
+#ifdef H323_VIDEO
+
+#define new PNEW
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323VideoFrame::H323VideoFrame(H323VideoFramePool & _pool, PINDEX size)
+  : pool(_pool),
+    buffer((BYTE *)malloc(size)),
+    bufferSize(size),
+    dataOffset(0),
+    width(0),
+    height(0),
+    timestamp(0),
+    references(0)
+{
+}
+
+
+H323VideoFrame::~H323VideoFrame()
+{
+  free(buffer);
+}
+
+
+void H323VideoFrame::SetPicture(PINDEX offset, unsigned _width, unsigned _height, DWORD _timestamp)
+{
+  dataOffset = offset;
+  width = _width;
+  height = _height;
+  timestamp = _timestamp;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323VideoFrameRef::H323VideoFrameRef(H323VideoFrame * _frame)
+  : frame(_frame)
+{
+  if (frame != NULL)
+    ++frame->references;
+}
+
+
+H323VideoFrameRef::H323VideoFrameRef(const H323VideoFrameRef & other)
+  : PObject(other),
+    frame(other.frame)
+{
+  if (frame != NULL)
+    ++frame->references;
+}
+
+
+H323VideoFrameRef::~H323VideoFrameRef()
+{
+  Release();
+}
+
+
+H323VideoFrameRef & H323VideoFrameRef::operator=(const H323VideoFrameRef & other)
+{
+  if (frame != other.frame) {
+    // Take the new reference before dropping the old one
+    if (other.frame != NULL)
+      ++other.frame->references;
+    Release();
+    frame = other.frame;
+  }
+  return *this;
+}
+
+
+PObject::Comparison H323VideoFrameRef::Compare(const PObject & obj) const
+{
+  PAssert(PIsDescendant(&obj, H323VideoFrameRef), PInvalidCast);
+  const H323VideoFrame * other = ((const H323VideoFrameRef &)obj).frame;
+  if (frame < other)
+    return LessThan;
+  if (frame > other)
+    return GreaterThan;
+  return EqualTo;
+}
+
+
+void H323VideoFrameRef::Release()
+{
+  if (frame == NULL)
+    return;
+
+  H323VideoFrame * old = frame;
+  frame = NULL;
+  if (--old->references == 0)
+    old->pool.Release(old);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323VideoFramePool::H323VideoFramePool(PINDEX _maxFree)
+  : maxFree(_maxFree),
+    inUse(0),
+    allocatedCount(0)
+{
+}
+
+
+H323VideoFramePool::~H323VideoFramePool()
+{
+  PAssert(inUse == 0, "Video frame pool deleted with frames in use");
+
+  for (FreeMap::iterator it = freeFrames.begin(); it != freeFrames.end(); ++it) {
+    for (size_t i = 0; i < it->second.size(); i++)
+      delete it->second[i];
+  }
+}
+
+
+H323VideoFramePool & H323VideoFramePool::GetDecoderPool()
+{
+  static H323VideoFramePool pool;
+  return pool;
+}
+
+
+H323VideoFrameRef H323VideoFramePool::Acquire(PINDEX size)
+{
+  H323VideoFrame * frame = NULL;
+
+  mutex.Wait();
+  FreeMap::iterator it = freeFrames.find(size);
+  if (it != freeFrames.end() && !it->second.empty()) {
+    frame = it->second.back();
+    it->second.pop_back();
+  }
+  else
+    allocatedCount++;
+  inUse++;
+  mutex.Signal();
+
+  if (frame == NULL) {
+    frame = new H323VideoFrame(*this, size);
+    PTRACE(4, "Video\tAllocated frame buffer of " << size << " bytes");
+  }
+
+  return H323VideoFrameRef(frame);
+}
+
+
+void H323VideoFramePool::Release(H323VideoFrame * frame)
+{
+  frame->SetPicture(0, 0, 0, 0);
+
+  mutex.Wait();
+  inUse--;
+  std::vector<H323VideoFrame *> & frames = freeFrames[frame->bufferSize];
+  if ((PINDEX)frames.size() < maxFree) {
+    frames.push_back(frame);
+    frame = NULL;
+  }
+  mutex.Signal();
+
+  delete frame;
+}
+
+
+PINDEX H323VideoFramePool::GetInUseCount() const
+{
+  PWaitAndSignal m(mutex);
+  return inUse;
+}
+
+
+#endif // H323_VIDEO
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,447 @@
+/*
+ * h323videoload.cxx
+ *
+ * Shedding of video decoding under processor load
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "h323videoload.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#include "h323videoload.h"
+
+#ifdef H323_VIDEO
+
+#define new PNEW
+
+
+static const PInt64   EvaluatePeriod  = 1000;   // Milliseconds
+static const unsigned OverloadPercent = 90;
+static const unsigned CalmPercent     = 60;
+static const unsigned CalmPeriods     = 3;
+static const unsigned FirstProbeWait  = 4;
+static const unsigned LastProbeWait   = 32;
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323VideoDecodeBudget::H323VideoDecodeBudget()
+  : budget(0)
+{
+}
+
+
+void H323VideoDecodeBudget::SetBudget(unsigned percent)
+{
+  PWaitAndSignal m(mutex);
+  budget = percent;
+  PTRACE(3, "VideoLoad\tDecode budget set to " << percent << '%');
+}
+
+
+unsigned H323VideoDecodeBudget::GetBudget() const
+{
+  PWaitAndSignal m(mutex);
+  return budget;
+}
+
+
+PBoolean H323VideoDecodeBudget::Report(const H323VideoDecodeLoad * decoder, unsigned load, int priority)
+{
+  PWaitAndSignal m(mutex);
+
+  Entry & entry = decoders[decoder];
+  entry.load = load;
+  entry.priority = priority;
+
+  if (budget == 0)
+    return FALSE;
+
+  // The decoders ranked before this one get their share first
+  unsigned total = load;
+  for (EntryMap::const_iterator it = decoders.begin(); it != decoders.end(); ++it) {
+    if (it->first != decoder &&
+        (it->second.priority > priority ||
+         (it->second.priority == priority &&
+          (it->second.load < load || (it->second.load == load && it->first < decoder)))))
+      total += it->second.load;
+  }
+
+  return total > budget;
+}
+
+
+void H323VideoDecodeBudget::Remove(const H323VideoDecodeLoad * decoder)
+{
+  PWaitAndSignal m(mutex);
+  decoders.erase(decoder);
+}
+
+
+unsigned H323VideoDecodeBudget::GetTotalLoad() const
+{
+  PWaitAndSignal m(mutex);
+
+  unsigned total = 0;
+  for (EntryMap::const_iterator it = decoders.begin(); it != decoders.end(); ++it)
+    total += it->second.load;
+  return total;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323VideoDecodeLoad::H323VideoDecodeLoad()
+  : format(UnknownFormat),
+    budget(NULL),
+    priority(0),
+    level(DecodeAll),
+    started(FALSE),
+    pictureTimestamp(0),
+    pictureType(UnknownPicture),
+    decodePicture(TRUE),
+    waitingForIntra(FALSE),
+    intraRequested(FALSE),
+    periodStart(0),
+    decodeTime(0),
+    picturesSeen(0),
+    picturesDecoded(0),
+    load(0),
+    calmPeriods(0),
+    probePeriods(0),
+    probeWait(FirstProbeWait),
+    picturesSkipped(0)
+{
+}
+
+
+H323VideoDecodeLoad::~H323VideoDecodeLoad()
+{
+  Close();
+}
+
+
+void H323VideoDecodeLoad::Open(const PString & sdpFormat, H323VideoDecodeBudget * _budget)
+{
+  Close();
+
+  format = GetFormat(sdpFormat);
+  budget = _budget;
+  level = DecodeAll;
+  started = FALSE;
+  waitingForIntra = FALSE;
+  intraRequested = FALSE;
+  periodStart = PTimer::Tick().GetMilliSeconds();
+  decodeTime = 0;
+  picturesSeen = picturesDecoded = 0;
+  load = 0;
+  calmPeriods = probePeriods = 0;
+  probeWait = FirstProbeWait;
+
+  PTRACE_IF(3, format == OtherFormat, "VideoLoad\tPicture types of " << sdpFormat
+            << " are not known, pictures are always decoded");
+}
+
+
+void H323VideoDecodeLoad::Close()
+{
+  if (budget != NULL)
+    budget->Remove(this);
+  budget = NULL;
+  format = UnknownFormat;
+}
+
+
+PBoolean H323VideoDecodeLoad::StartPacket(const RTP_DataFrame & frame)
+{
+  if (format == UnknownFormat)
+    return TRUE;
+
+  if (!started || frame.GetTimestamp() != pictureTimestamp) {
+    PInt64 now = PTimer::Tick().GetMilliSeconds();
+    if (now - periodStart >= EvaluatePeriod)
+      Evaluate(now);
+
+    started = TRUE;
+    pictureTimestamp = frame.GetTimestamp();
+    pictureType = UnknownPicture;
+    decodePicture = TRUE;
+    picturesSeen++;
+    picturesDecoded++;
+  }
+
+  // Packets before the type is known, such as parameter sets, are decoded
+  if (pictureType == UnknownPicture) {
+    pictureType = GetPictureType(format, frame);
+    if (pictureType != UnknownPicture)
+      Decide(pictureType);
+  }
+
+  return decodePicture;
+}
+
+
+void H323VideoDecodeLoad::Decide(PictureTypes type)
+{
+  if (type == IntraPicture) {
+    waitingForIntra = FALSE;
+    return;
+  }
+
+  switch (level) {
+    case DecodeAll :
+      decodePicture = !waitingForIntra;
+      break;
+
+    case SkipNonReference :
+      decodePicture = !waitingForIntra && type != NonReferencePicture;
+      break;
+
+    case DecodeIntraOnly :
+      decodePicture = FALSE;
+      break;
+  }
+
+  if (!decodePicture) {
+    // Skipping a picture others refer to leaves nothing to decode until
+    // the next intra picture
+    if (type == ReferencePicture)
+      waitingForIntra = TRUE;
+    picturesDecoded--;
+    picturesSkipped++;
+  }
+}
+
+
+void H323VideoDecodeLoad::Evaluate(PInt64 now)
+{
+  PInt64 elapsed = now - periodStart;
+
+  // The cost of each picture decoded, over the time between them all
+  if (picturesDecoded > 0 && picturesSeen > 0 && elapsed > 0)
+    load = (unsigned)(decodeTime * picturesSeen * 100 / (picturesDecoded * elapsed));
+
+  PBoolean over = load > OverloadPercent;
+  if (budget != NULL && budget->Report(this, load, priority))
+    over = TRUE;
+
+  Levels previous = level;
+
+  if (level == DecodeIntraOnly) {
+    if (++probePeriods >= probeWait) {
+      level = SkipNonReference;
+      probePeriods = 0;
+      probeWait = PMIN(probeWait*2, LastProbeWait);
+    }
+  }
+  else if (waitingForIntra) {
+    // Judged once decoding again from the intra picture
+  }
+  else if (over) {
+    level = (Levels)(level + 1);
+    calmPeriods = 0;
+    probePeriods = 0;
+  }
+  else if (level > DecodeAll) {
+    if (load >= CalmPercent)
+      calmPeriods = 0;
+    else if (++calmPeriods >= CalmPeriods) {
+      level = (Levels)(level - 1);
+      calmPeriods = 0;
+      if (level == DecodeAll)
+        probeWait = FirstProbeWait;
+    }
+  }
+
+  // Pictures skipped before are only made good by an intra picture
+  if (level < previous && waitingForIntra)
+    intraRequested = TRUE;
+
+  PTRACE_IF(3, level != previous, "VideoLoad\tDecode load " << load << "%"
+            << (over ? ", over" : "") << ", now " << *this);
+
+  periodStart = now;
+  decodeTime = 0;
+  picturesSeen = 0;
+  picturesDecoded = 0;
+}
+
+
+PBoolean H323VideoDecodeLoad::TakeIntraRequest()
+{
+  PBoolean requested = intraRequested;
+  intraRequested = FALSE;
+  return requested;
+}
+
+
+H323VideoDecodeLoad::Formats H323VideoDecodeLoad::GetFormat(const PString & sdpFormat)
+{
+  if (sdpFormat *= "h264")
+    return H264Format;
+  if (sdpFormat *= "h263")
+    return H263Format;
+  if ((sdpFormat *= "h263-1998") || (sdpFormat *= "h263-2000"))
+    return H263PlusFormat;
+  return OtherFormat;
+}
+
+
+H323VideoDecodeLoad::PictureTypes H323VideoDecodeLoad::GetPictureType(const PString & sdpFormat,
+                                                                      const RTP_DataFrame & frame)
+{
+  return GetPictureType(GetFormat(sdpFormat), frame);
+}
+
+
+static H323VideoDecodeLoad::PictureTypes GetH264NALType(BYTE header, BYTE type)
+{
+  switch (type) {
+    case 5 :  // IDR slice
+    case 7 :  // Sequence parameter set
+    case 8 :  // Picture parameter set
+      return H323VideoDecodeLoad::IntraPicture;
+
+    case 1 :  // Non IDR slice
+    case 2 :  // Slice data partitions
+    case 3 :
+    case 4 :
+      return (header & 0x60) != 0 ? H323VideoDecodeLoad::ReferencePicture
+                                  : H323VideoDecodeLoad::NonReferencePicture;
+  }
+  return H323VideoDecodeLoad::UnknownPicture;
+}
+
+
+static unsigned GetBits(const BYTE * data, unsigned start, unsigned count)
+{
+  unsigned value = 0;
+  for (unsigned bit = start; bit < start + count; bit++)
+    value = (value << 1) | ((data[bit/8] >> (7 - bit%8)) & 1);
+  return value;
+}
+
+
+H323VideoDecodeLoad::PictureTypes H323VideoDecodeLoad::GetPictureType(Formats format,
+                                                                      const RTP_DataFrame & frame)
+{
+  const BYTE * payload = frame.GetPayloadPtr();
+  PINDEX size = frame.GetPayloadSize();
+  if (size < 2)
+    return UnknownPicture;
+
+  switch (format) {
+    case H264Format :
+      switch (payload[0] & 0x1f) {
+        case 24 : { // STAP-A, the first aggregated unit that says
+          PINDEX offset = 1;
+          while (offset + 3 <= size) {
+            PINDEX length = (payload[offset] << 8) | payload[offset+1];
+            PictureTypes type = GetH264NALType(payload[offset+2], payload[offset+2] & 0x1f);
+            if (type != UnknownPicture)
+              return type;
+            offset += 2 + length;
+          }
+          return UnknownPicture;
+        }
+
+        case 28 : // FU-A and FU-B
+        case 29 :
+          return GetH264NALType(payload[0], payload[1] & 0x1f);
+      }
+      return GetH264NALType(payload[0], payload[0] & 0x1f);
+
+    case H263Format : {
+      // RFC 2190, the I bit is 0 for intra pictures
+      BYTE intra;
+      if ((payload[0] & 0x80) == 0)
+        intra = payload[1] & 0x10;
+      else if (size >= 8)
+        intra = payload[4] & 0x80;
+      else
+        return UnknownPicture;
+      return intra == 0 ? IntraPicture : ReferencePicture;
+    }
+
+    case H263PlusFormat : {
+      // RFC 4629, only the packet starting the picture has its header,
+      // without the first two zero bytes of the start code
+      if ((payload[0] & 0x04) == 0)
+        return UnknownPicture;
+      PINDEX offset = 2 + ((payload[0] & 0x02) != 0 ? 1 : 0) + (((payload[0] & 0x01) << 5) | (payload[1] >> 3));
+      if (offset + 6 > size)
+        return UnknownPicture;
+
+      const BYTE * header = payload + offset;
+      if (GetBits(header, 0, 6) != 0x20)
+        return UnknownPicture;
+
+      // PTYPE follows the 8 bit temporal reference
+      unsigned sourceFormat = GetBits(header, 19, 3);
+      if (sourceFormat != 7)
+        return GetBits(header, 22, 1) == 0 ? IntraPicture : ReferencePicture;
+
+      // PLUSPTYPE, with the optional part if UFEP is 001
+      unsigned ufep = GetBits(header, 22, 3);
+      unsigned pictureType = GetBits(header, ufep == 1 ? 43 : 25, 3);
+      switch (pictureType) {
+        case 0 :  // I
+        case 4 :  // EI
+          return IntraPicture;
+        case 3 :  // B
+          return NonReferencePicture;
+        case 1 :  // P
+        case 2 :  // Improved PB
+        case 5 :  // EP
+          return ReferencePicture;
+      }
+      return UnknownPicture;
+    }
+
+    default :
+      break;
+  }
+
+  return UnknownPicture;
+}
+
+
+void H323VideoDecodeLoad::PrintOn(ostream & strm) const
+{
+  static const char * const LevelNames[] = { "decoding all", "skipping non reference", "decoding intra only" };
+  strm << LevelNames[level] << ", " << picturesSkipped << " pictures skipped";
+}
+
+
+#endif // H323_VIDEO
+
+
+/////////////////////////////////////////////////////////////////////////////
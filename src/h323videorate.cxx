@@ -0,0 +1,205 @@
+/*
+ * h323videorate.cxx
+ *
+ * Video rate control from the RTCP reports of the remote
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "h323videorate.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#include "h323videorate.h"
+
+#define new PNEW
+
+
+static const unsigned VideoClockRate  = 90;     // Timestamp units a millisecond
+static const unsigned MinFrameRate    = 5;
+static const DWORD    JitterOveruse   = 30;     // Milliseconds over the floor
+static const DWORD    HighLoss        = 26;     // 10% of 256
+static const DWORD    LowLoss         = 5;      // 2% of 256
+static const PInt64   MaxReportGap    = 5000;   // Longest rise between reports
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323VideoRateController::H323VideoRateController()
+  : maxBitRate(0),
+    minBitRate(0),
+    baseFrameTime(0),
+    bitRate(0),
+    frameTime(0),
+    appliedBitRate(0),
+    appliedFrameTime(0),
+    holding(FALSE),
+    jitterFloor(0xffffffff),
+    lastJitter(0)
+{
+}
+
+
+void H323VideoRateController::Open(unsigned rate, unsigned time)
+{
+  PWaitAndSignal m(mutex);
+
+  maxBitRate = rate;
+  minBitRate = rate/8;
+  baseFrameTime = time > 0 ? time : 90000/30;
+  bitRate = appliedBitRate = rate;
+  frameTime = appliedFrameTime = baseFrameTime;
+  holding = FALSE;
+  jitterFloor = 0xffffffff;
+  lastJitter = 0;
+  lastReport = PTimer::Tick();
+
+  PTRACE(4, "VideoRate\tStarted at " << *this);
+}
+
+
+void H323VideoRateController::SetMaxBitRate(unsigned rate)
+{
+  PWaitAndSignal m(mutex);
+
+  if (maxBitRate == 0 || rate == 0)
+    return;
+
+  maxBitRate = rate;
+  minBitRate = rate/8;
+  if (bitRate > maxBitRate)
+    bitRate = maxBitRate;
+  UpdateFrameTime();
+
+  PTRACE(4, "VideoRate\tMaximum set to " << rate << ", now " << *this);
+}
+
+
+void H323VideoRateController::OnReceiverReport(const RTP_Session::ReceiverReport & report)
+{
+  PWaitAndSignal m(mutex);
+
+  if (maxBitRate == 0)
+    return;
+
+  PTimeInterval now = PTimer::Tick();
+  PInt64 elapsed = (now - lastReport).GetMilliSeconds();
+  lastReport = now;
+  if (elapsed > MaxReportGap)
+    elapsed = MaxReportGap;
+
+  DWORD loss = report.fractionLost;
+  DWORD jitter = report.jitter/VideoClockRate;
+
+  // The floor creeps up so a path that has settled at a higher jitter
+  // is not taken as congested for ever
+  if (jitter < jitterFloor)
+    jitterFloor = jitter;
+  else
+    jitterFloor += (jitter - jitterFloor)/16;
+  PBoolean overuse = jitter > jitterFloor + JitterOveruse && jitter > lastJitter;
+  lastJitter = jitter;
+
+  unsigned previous = bitRate;
+  if (loss > HighLoss) {
+    bitRate = (unsigned)((PUInt64)bitRate * (512 - loss) / 512);
+    holding = TRUE;
+  }
+  else if (overuse) {
+    bitRate = bitRate * 85 / 100;
+    holding = TRUE;
+  }
+  else if (holding)
+    holding = FALSE;
+  else if (loss < LowLoss)
+    bitRate += (unsigned)((PUInt64)bitRate * 8 * elapsed / 100000);
+
+  if (bitRate > maxBitRate)
+    bitRate = maxBitRate;
+  if (bitRate < minBitRate)
+    bitRate = minBitRate;
+  UpdateFrameTime();
+
+  PTRACE_IF(4, bitRate != previous, "VideoRate\tLoss " << loss*100/256 << "%, jitter "
+            << jitter << "ms" << (overuse ? " rising" : "") << ", now " << *this);
+}
+
+
+void H323VideoRateController::UpdateFrameTime()
+{
+  if (bitRate*2 >= maxBitRate) {
+    frameTime = baseFrameTime;
+    return;
+  }
+
+  frameTime = (unsigned)((PUInt64)baseFrameTime * maxBitRate / (2*(PUInt64)bitRate));
+  unsigned longest = PMAX(90000/MinFrameRate, baseFrameTime);
+  if (frameTime > longest)
+    frameTime = longest;
+}
+
+
+PBoolean H323VideoRateController::GetUpdate(unsigned & rate, unsigned & time)
+{
+  PWaitAndSignal m(mutex);
+
+  // Small moves are not worth reconfiguring the encoder for
+  unsigned rateMove = bitRate > appliedBitRate ? bitRate - appliedBitRate : appliedBitRate - bitRate;
+  unsigned timeMove = frameTime > appliedFrameTime ? frameTime - appliedFrameTime : appliedFrameTime - frameTime;
+  if ((PUInt64)rateMove*20 <= appliedBitRate && (PUInt64)timeMove*10 <= appliedFrameTime)
+    return FALSE;
+
+  rate = appliedBitRate = bitRate;
+  time = appliedFrameTime = frameTime;
+  return TRUE;
+}
+
+
+unsigned H323VideoRateController::GetBitRate() const
+{
+  PWaitAndSignal m(mutex);
+  return bitRate;
+}
+
+
+unsigned H323VideoRateController::GetFrameTime() const
+{
+  PWaitAndSignal m(mutex);
+  return frameTime;
+}
+
+
+void H323VideoRateController::PrintOn(ostream & strm) const
+{
+  strm << bitRate/1000 << "kb/s of " << maxBitRate/1000 << "kb/s at "
+       << (frameTime > 0 ? 90000/frameTime : 0) << "fps";
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
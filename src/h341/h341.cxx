@@ -59,16 +59,239 @@
 #include "h341/h341.h"
 #include "h341/h341_oid.h"
 
+/* Most variables a GetBulk response is allowed to hold */
+#define H341_MAX_BULK_VARS 500
+
+
+H323_H341Snapshot::H323_H341Snapshot()
+  : references(1)
+{
+}
+
+
+void H323_H341Snapshot::SetValue(const PString & oid, const PRFC1155_ObjectSyntax & value)
+{
+  ValueMap::iterator it = values.find(oid);
+  if (it != values.end())
+    it->second = value;
+  else
+    values.insert(ValueMap::value_type(oid, value));
+}
+
+
+PBoolean H323_H341Snapshot::GetValue(const PString & oid, PRFC1155_ObjectSyntax & value) const
+{
+  ValueMap::const_iterator it = values.find(oid);
+  if (it == values.end())
+    return FALSE;
+
+  value = it->second;
+  return TRUE;
+}
+
+
+PBoolean H323_H341Snapshot::GetNextValue(const PString & oid, PString & nextOid, PRFC1155_ObjectSyntax & value) const
+{
+  ValueMap::const_iterator it = values.upper_bound(oid);
+  if (it == values.end())
+    return FALSE;
+
+  nextOid = it->first;
+  value = it->second;
+  return TRUE;
+}
+
+
+bool H323_H341Snapshot::OIDLess::operator()(const PString & oid1, const PString & oid2) const
+{
+  const char * p1 = oid1;
+  const char * p2 = oid2;
+
+  for (;;) {
+    if (*p1 == '\0' || *p2 == '\0')
+      return *p1 == '\0' && *p2 != '\0';
+
+    char * end1;
+    char * end2;
+    unsigned long n1 = strtoul(p1, &end1, 10);
+    unsigned long n2 = strtoul(p2, &end2, 10);
+    if (end1 == p1 || end2 == p2)
+      return strcmp(p1, p2) < 0;   // Not dotted decimal
+    if (n1 != n2)
+      return n1 < n2;
+
+    p1 = *end1 == '.' ? end1+1 : end1;
+    p2 = *end2 == '.' ? end2+1 : end2;
+  }
+}
+
 
 H323_H341Server::H323_H341Server(WORD listenPort)
-: PSNMPServer(PIPSocket::GetDefaultIpAny(), listenPort)
+: PSNMPServer(PIPSocket::GetDefaultIpAny(), listenPort),
+  snapshot(NULL),
+  snapshotThread(NULL),
+  snapshotStop(FALSE)
 {
 
 }
 
 H323_H341Server::~H323_H341Server()
 {
+  StopSnapshots();
+}
+
+
+void H323_H341Server::StartSnapshots(const PTimeInterval & interval)
+{
+  StopSnapshots();
 
+  snapshotInterval = interval;
+  snapshotStop = FALSE;
+  PublishSnapshot();
+  snapshotThread = PThread::Create(PCREATE_NOTIFIER(SnapshotMain), 0,
+                                   PThread::NoAutoDeleteThread,
+                                   PThread::LowPriority,
+                                   "H341 Snapshot");
+}
+
+
+void H323_H341Server::StopSnapshots()
+{
+  if (snapshotThread != NULL) {
+    snapshotStop = TRUE;
+    snapshotWakeUp.Signal();
+    snapshotThread->WaitForTermination();
+    delete snapshotThread;
+    snapshotThread = NULL;
+  }
+
+  snapshotMutex.Wait();
+  const H323_H341Snapshot * old = snapshot;
+  snapshot = NULL;
+  snapshotMutex.Signal();
+
+  ReleaseSnapshot(old);
+}
+
+
+void H323_H341Server::SnapshotMain(PThread &, H323_INT)
+{
+  PTRACE(4, "H341\tSnapshot thread started, interval " << snapshotInterval);
+
+  for (;;) {
+    snapshotWakeUp.Wait(snapshotInterval);
+    if (snapshotStop)
+      break;
+    PublishSnapshot();
+  }
+
+  PTRACE(4, "H341\tSnapshot thread ended");
+}
+
+
+void H323_H341Server::PublishSnapshot()
+{
+  // Built without the lock, requests keep reading the previous snapshot
+  H323_H341Snapshot * newSnapshot = new H323_H341Snapshot;
+  OnBuildSnapshot(*newSnapshot);
+
+  snapshotMutex.Wait();
+  const H323_H341Snapshot * old = snapshot;
+  snapshot = newSnapshot;
+  snapshotMutex.Signal();
+
+  ReleaseSnapshot(old);
+
+  PTRACE(5, "H341\tPublished snapshot of " << newSnapshot->GetSize() << " values");
+}
+
+
+const H323_H341Snapshot * H323_H341Server::AcquireSnapshot() const
+{
+  PWaitAndSignal m(snapshotMutex);
+  if (snapshot != NULL)
+    ++snapshot->references;
+  return snapshot;
+}
+
+
+void H323_H341Server::ReleaseSnapshot(const H323_H341Snapshot * snapshot)
+{
+  if (snapshot != NULL && --snapshot->references == 0)
+    delete snapshot;
+}
+
+
+PBoolean H323_H341Server::GetNextFromSnapshot(const H323_H341Snapshot & snap,
+                                              PSNMP::BindingList & vars,
+                                              PSNMP::ErrorType & errCode)
+{
+  // The request is left as it was if any variable fails
+  PSNMP::BindingList response = vars;
+  for (PSNMP::BindingList::iterator Iter = response.begin(); Iter != response.end(); ++Iter) {
+    PString nextOid;
+    if (!snap.GetNextValue(Iter->first, nextOid, Iter->second)) {
+      PTRACE(4,"H341\tGetNext FAILED: End of MIB after " << Iter->first);
+      errCode = PSNMP::NoSuchName;
+      return FALSE;
+    }
+    Iter->first = nextOid;
+  }
+
+  vars = response;
+  return TRUE;
+}
+
+
+PBoolean H323_H341Server::OnGetBulkRequest(PINDEX /*reqID*/,
+                                           PINDEX nonRepeaters,
+                                           PINDEX maxRepetitions,
+                                           PSNMP::BindingList & vars,
+                                           PSNMP::ErrorType & errCode)
+{
+  const H323_H341Snapshot * snap = AcquireSnapshot();
+  if (snap == NULL) {
+    PTRACE(4,"H341\tGetBulk FAILED: No snapshot");
+    errCode = PSNMP::GenErr;
+    return FALSE;
+  }
+
+  PSNMP::BindingList response;
+  PSNMP::BindingList repeaters;
+
+  PINDEX i = 0;
+  for (PSNMP::BindingList::const_iterator Iter = vars.begin(); Iter != vars.end(); ++Iter, ++i) {
+    if (i >= nonRepeaters) {
+      repeaters.push_back(*Iter);
+      continue;
+    }
+    PSNMP::BindingList::value_type binding = *Iter;
+    if (snap->GetNextValue(Iter->first, binding.first, binding.second))
+      response.push_back(binding);
+  }
+
+  // Rows of successors, each row one value per repeating variable, until
+  // every variable reaches the end of the MIB
+  for (PINDEX row = 0; row < maxRepetitions && !repeaters.empty(); row++) {
+    PBoolean any = FALSE;
+    for (PSNMP::BindingList::iterator Iter = repeaters.begin(); Iter != repeaters.end(); ++Iter) {
+      if ((PINDEX)response.size() >= H341_MAX_BULK_VARS)
+        break;
+      PString nextOid;
+      if (!snap->GetNextValue(Iter->first, nextOid, Iter->second))
+        continue;
+      Iter->first = nextOid;
+      response.push_back(*Iter);
+      any = TRUE;
+    }
+    if (!any || (PINDEX)response.size() >= H341_MAX_BULK_VARS)
+      break;
+  }
+
+  ReleaseSnapshot(snap);
+
+  vars = response;
+  return TRUE;
 }
 
 
@@ -130,6 +353,24 @@ static PBoolean ValidateOID(H323_H341Server::messagetype reqType,
 
 PBoolean H323_H341Server::OnGetRequest(PINDEX /*reqID*/, PSNMP::BindingList & vars, PSNMP::ErrorType & errCode)
 {
+    const H323_H341Snapshot * snap = AcquireSnapshot();
+    if (snap != NULL) {
+      PSNMP::BindingList response = vars;
+      PBoolean ok = TRUE;
+      for (PSNMP::BindingList::iterator Iter = response.begin(); Iter != response.end(); ++Iter) {
+        if (!snap->GetValue(Iter->first, Iter->second)) {
+          PTRACE(4,"H341\tRequest FAILED: Attribute not found " << Iter->first);
+          errCode = PSNMP::NoSuchName;
+          ok = FALSE;
+          break;
+        }
+      }
+      ReleaseSnapshot(snap);
+      if (ok)
+        vars = response;
+      return ok;
+    }
+
 	messagetype reqType = H323_H341Server::e_request;
 	if (!ValidateOID(reqType,vars, errCode))
 		     return FALSE;
@@ -140,6 +381,13 @@ PBoolean H323_H341Server::OnGetRequest(PINDEX /*reqID*/, PSNMP::BindingList & va
 
 PBoolean H323_H341Server::OnGetNextRequest(PINDEX /*reqID*/, PSNMP::BindingList & vars, PSNMP::ErrorType & errCode)
 {
+    const H323_H341Snapshot * snap = AcquireSnapshot();
+    if (snap != NULL) {
+      PBoolean ok = GetNextFromSnapshot(*snap, vars, errCode);
+      ReleaseSnapshot(snap);
+      return ok;
+    }
+
 	messagetype reqType = H323_H341Server::e_nextrequest;
 	if (!ValidateOID(reqType,vars, errCode))
 		     return FALSE;
@@ -287,5 +287,361 @@ PBoolean H350_Session::GetAttribute(LDAP_Record & record,const PString & attrib,
 	return FALSE;
 }
 
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+/* Attributes a cached result is indexed by for invalidation */
+static const char * const H350_IndexAttributes[] = {
+  "commURI",
+  "h323Identityh323-ID",
+  "h323IdentitydialedDigits",
+  "h323Identityemail-ID",
+  "h323IdentityURL-ID",
+  "h323IdentitytransportID",
+  "h323IdentitypartyNumber"
+};
+
+/* Number of cached results above which expired ones are removed */
+#define H350_CACHE_PRUNE_SIZE 1000
+
+static PString H350_SearchKey(const PString & base, const PString & filter, const PStringArray & attributes)
+{
+  PStringStream key;
+  key << base << '\n' << filter << '\n' << setfill(',') << attributes;
+  return key;
+}
+
+H350_Client::H350_Client(const PString & _hostname, WORD _port,
+                         const PString & _who, const PString & _passwd,
+                         PLDAPSession::AuthenticationMethod _authMethod,
+                         PINDEX _maxSessions)
+  : hostname(_hostname),
+    port(_port),
+    who(_who),
+    passwd(_passwd),
+    authMethod(_authMethod),
+    maxSessions(_maxSessions > 0 ? _maxSessions : 1),
+    openSessions(0),
+    cacheTime(0, 60),
+    cacheHits(0),
+    cacheMisses(0),
+    idleWorkers(0),
+    stopping(FALSE),
+    queued(0, INT_MAX)
+{
+}
+
+
+H350_Client::~H350_Client()
+{
+  queueMutex.Wait();
+  stopping = TRUE;
+  std::vector<PThread *> threads = workers;
+  workers.clear();
+  queueMutex.Signal();
+
+  for (size_t i = 0; i < threads.size(); i++)
+    queued.Signal();
+  for (size_t i = 0; i < threads.size(); i++) {
+    threads[i]->WaitForTermination();
+    delete threads[i];
+  }
+
+  // Anything still queued is answered empty so callers are not left waiting
+  while (!queue.empty()) {
+    SearchRequest * request = queue.front();
+    queue.pop_front();
+    request->count = 0;
+    request->notifier(*request, 0);
+    delete request;
+  }
+
+  PWaitAndSignal m(sessionMutex);
+  while (!idleSessions.empty()) {
+    delete idleSessions.front();
+    idleSessions.pop_front();
+  }
+}
+
+
+H350_Session * H350_Client::AcquireSession()
+{
+  sessionMutex.Wait();
+  while (idleSessions.empty() && openSessions >= maxSessions) {
+    sessionMutex.Signal();
+    sessionAvailable.Wait();
+    sessionMutex.Wait();
+  }
+
+  if (!idleSessions.empty()) {
+    H350_Session * session = idleSessions.front();
+    idleSessions.pop_front();
+    sessionMutex.Signal();
+    return session;
+  }
+
+  // Opened and bound without the lock, other searches use the sessions already open
+  openSessions++;
+  sessionMutex.Signal();
+
+  H350_Session * session = new H350_Session;
+  if (session->Open(hostname, port) && (who.IsEmpty() || session->Login(who, passwd, authMethod))) {
+    PTRACE(3, "H350\tOpened directory session " << openSessions << " to " << hostname);
+    return session;
+  }
+
+  PTRACE(2, "H350\tCould not open directory session to " << hostname);
+  delete session;
+  ReleaseSession(NULL);
+  return NULL;
+}
+
+
+void H350_Client::ReleaseSession(H350_Session * session)
+{
+  sessionMutex.Wait();
+  if (session != NULL && session->IsOpen())
+    idleSessions.push_back(session);
+  else {
+    delete session;
+    openSessions--;
+  }
+  sessionMutex.Signal();
+
+  sessionAvailable.Signal();
+}
+
+
+int H350_Client::Search(const PString & base,
+                        const PString & filter,
+                        H350_Session::LDAP_RecordList & results,
+                        const PStringArray & attributes)
+{
+  PString key = H350_SearchKey(base, filter, attributes);
+  PInt64 now = PTimer::Tick().GetMilliSeconds();
+
+  if (cacheTime > 0) {
+    PWaitAndSignal m(cacheMutex);
+    CacheMap::iterator it = cache.find(key);
+    if (it != cache.end()) {
+      if (it->second.expires > now) {
+        cacheHits++;
+        results = it->second.results;
+        PTRACE(4, "H350\tCached search " << filter << " found " << it->second.count << " records");
+        return it->second.count;
+      }
+      RemoveCacheEntry(key);
+    }
+  }
+
+  H350_Session * session = AcquireSession();
+  if (session == NULL)
+    return 0;
+
+  H350_Session::LDAP_RecordList found;
+  int count = session->Search(base, filter, found, attributes);
+  PBoolean failed = session->GetErrorNumber() != 0;
+  if (failed) {
+    PTRACE(2, "H350\tSearch " << filter << " failed: " << session->GetErrorText());
+    session->Close();
+  }
+
+  std::vector<PString> indexKeys;
+  if (!failed && cacheTime > 0) {
+    for (H350_Session::LDAP_RecordList::iterator r = found.begin(); r != found.end(); ++r) {
+      for (PINDEX i = 0; i < PARRAYSIZE(H350_IndexAttributes); i++) {
+        PString value;
+        if (session->GetAttribute(r->second, H350_IndexAttributes[i], value) && !value.IsEmpty())
+          indexKeys.push_back((i == 0 ? "commURI=" : "h323Identity=") + value.Trim());
+      }
+    }
+  }
+
+  ReleaseSession(session);
+
+  results.insert(found.begin(), found.end());
+
+  if (failed || cacheTime == 0)
+    return count;
+
+  PWaitAndSignal m(cacheMutex);
+  cacheMisses++;
+
+  if (cache.size() >= H350_CACHE_PRUNE_SIZE) {
+    CacheMap::iterator it = cache.begin();
+    while (it != cache.end()) {
+      CacheMap::iterator next = it;
+      ++next;
+      if (it->second.expires <= now)
+        RemoveCacheEntry(it->first);
+      it = next;
+    }
+  }
+
+  RemoveCacheEntry(key);
+  CacheEntry & entry = cache[key];
+  entry.results = found;
+  entry.count = count;
+  entry.expires = PTimer::Tick().GetMilliSeconds() + cacheTime.GetMilliSeconds();
+  entry.indexKeys = indexKeys;
+  for (size_t i = 0; i < indexKeys.size(); i++)
+    cacheIndex.insert(std::pair<const PString, PString>(indexKeys[i], key));
+
+  if (count == 0)
+    emptyResults.insert(key);
+
+  return count;
+}
+
+
+void H350_Client::StartSearch(const PString & base,
+                              const PString & filter,
+                              const PNotifier & notifier,
+                              const PStringArray & attributes)
+{
+  SearchRequest * request = new SearchRequest;
+  request->base = base;
+  request->filter = filter;
+  request->attributes = attributes;
+  request->notifier = notifier;
+  request->count = 0;
+
+  // A cached result is answered at once
+  if (cacheTime > 0) {
+    PString key = H350_SearchKey(base, filter, attributes);
+    PInt64 now = PTimer::Tick().GetMilliSeconds();
+    cacheMutex.Wait();
+    CacheMap::iterator it = cache.find(key);
+    PBoolean hit = it != cache.end() && it->second.expires > now;
+    if (hit) {
+      cacheHits++;
+      request->results = it->second.results;
+      request->count = it->second.count;
+    }
+    cacheMutex.Signal();
+
+    if (hit) {
+      notifier(*request, request->count);
+      delete request;
+      return;
+    }
+  }
+
+  PWaitAndSignal m(queueMutex);
+
+  if (stopping) {
+    notifier(*request, 0);
+    delete request;
+    return;
+  }
+
+  queue.push_back(request);
+
+  if (idleWorkers == 0 && (PINDEX)workers.size() < maxSessions)
+    workers.push_back(PThread::Create(PCREATE_NOTIFIER(WorkerMain), 0,
+                                      PThread::NoAutoDeleteThread,
+                                      PThread::NormalPriority,
+                                      "H350 Search:%x"));
+
+  queued.Signal();
+}
+
+
+void H350_Client::WorkerMain(PThread &, H323_INT)
+{
+  PTRACE(4, "H350\tSearch worker started");
+
+  for (;;) {
+    queueMutex.Wait();
+    idleWorkers++;
+    queueMutex.Signal();
+
+    queued.Wait();
+
+    queueMutex.Wait();
+    idleWorkers--;
+    if (stopping || queue.empty()) {
+      PBoolean stop = stopping;
+      queueMutex.Signal();
+      if (stop)
+        break;
+      continue;
+    }
+    SearchRequest * request = queue.front();
+    queue.pop_front();
+    queueMutex.Signal();
+
+    request->count = Search(request->base, request->filter, request->results, request->attributes);
+    request->notifier(*request, request->count);
+    delete request;
+  }
+
+  PTRACE(4, "H350\tSearch worker ended");
+}
+
+
+void H350_Client::RemoveCacheEntry(const PString & key)
+{
+  CacheMap::iterator it = cache.find(key);
+  if (it == cache.end())
+    return;
+
+  for (size_t i = 0; i < it->second.indexKeys.size(); i++) {
+    std::multimap<PString, PString>::iterator idx = cacheIndex.lower_bound(it->second.indexKeys[i]);
+    while (idx != cacheIndex.end() && idx->first == it->second.indexKeys[i]) {
+      if (idx->second == key)
+        cacheIndex.erase(idx++);
+      else
+        ++idx;
+    }
+  }
+
+  emptyResults.erase(key);
+  cache.erase(it);
+}
+
+
+void H350_Client::Invalidate(const PString & indexKey)
+{
+  PWaitAndSignal m(cacheMutex);
+
+  std::vector<PString> keys;
+  std::multimap<PString, PString>::iterator idx = cacheIndex.lower_bound(indexKey);
+  for (; idx != cacheIndex.end() && idx->first == indexKey; ++idx)
+    keys.push_back(idx->second);
+
+  // A search that found nothing may find the new entry, if the filter names it
+  PString value = indexKey.Mid(indexKey.Find('=')+1);
+  for (std::set<PString>::iterator e = emptyResults.begin(); e != emptyResults.end(); ++e) {
+    if (e->Find(value) != P_MAX_INDEX)
+      keys.push_back(*e);
+  }
+
+  for (size_t i = 0; i < keys.size(); i++)
+    RemoveCacheEntry(keys[i]);
+
+  PTRACE(4, "H350\tInvalidated " << keys.size() << " cached searches for " << indexKey);
+}
+
+
+void H350_Client::InvalidateCommURI(const PString & uri)
+{
+  Invalidate("commURI=" + uri.Trim());
+}
+
+
+void H350_Client::InvalidateH323Identity(const PString & identity)
+{
+  Invalidate("h323Identity=" + identity.Trim());
+}
+
+
+void H350_Client::InvalidateAll()
+{
+  PWaitAndSignal m(cacheMutex);
+  cache.clear();
+  cacheIndex.clear();
+  emptyResults.clear();
+}
+
 
 #endif
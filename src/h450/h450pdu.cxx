@@ -384,7 +384,8 @@ void H450ServiceAPDU::ParseEndpointAddress(H4501_EndpointAddress& endpointAddres
 H450xDispatcher::H450xDispatcher(H323Connection & conn)
   : connection(conn)
 {
-  opcodeHandler.DisallowDeleteObjects();
+  for (PINDEX i = 0; i < MaxOpCode; i++)
+    opcodeHandler[i] = NULL;
 
   nextInvokeId = 0;
 }
@@ -395,10 +396,15 @@ void H450xDispatcher::AddOpCode(unsigned opcode, H450xHandler * handler)
   if (PAssertNULL(handler) == NULL)
     return;
 
+  if (opcode >= MaxOpCode) {
+    PAssertAlways(PInvalidParameter);
+    return;
+  }
+
   if (handlers.GetObjectsIndex(handler) == P_MAX_INDEX)
     handlers.Append(handler);
 
-  opcodeHandler.SetAt(opcode, handler);
+  opcodeHandler[opcode] = handler;
 }
 
 
@@ -504,7 +510,8 @@ PBoolean H450xDispatcher::OnReceivedInvoke(X880_Invoke & invoke, H4501_Interpret
   // Get the opcode
   if (invoke.m_opcode.GetTag() == X880_Code::e_local) {
     int opcode = ((PASN_Integer&) invoke.m_opcode).GetValue();
-    if (!opcodeHandler.Contains(opcode)) {
+    H450xHandler * handler = opcode >= 0 && opcode < MaxOpCode ? opcodeHandler[opcode] : NULL;
+    if (handler == NULL) {
       PTRACE(2, "H4501\tInvoke of unsupported local opcode:\n  " << invoke);
       if (interpretation.GetTag() != H4501_InterpretationApdu::e_discardAnyUnrecognizedInvokePdu)
         SendInvokeReject(invokeId, 1 /*X880_InvokeProblem::e_unrecognisedOperation*/);
@@ -512,7 +519,7 @@ PBoolean H450xDispatcher::OnReceivedInvoke(X880_Invoke & invoke, H4501_Interpret
         result = FALSE;
     }
     else
-      result = opcodeHandler[opcode].OnReceivedInvoke(opcode, invokeId, linkedId, argument);
+      result = handler->OnReceivedInvoke(opcode, invokeId, linkedId, argument);
   }
   else {
     if (interpretation.GetTag() != H4501_InterpretationApdu::e_discardAnyUnrecognizedInvokePdu)
@@ -118,12 +118,33 @@ PObject::Comparison H460_FeatureID::Compare(const PObject & obj) const
 {
   PAssert(PIsDescendant(&obj, H460_FeatureID), PInvalidCast);
 
-  const H460_FeatureID & id  = (const H460_FeatureID &)obj;
+  // The choice compares the tag and then the integer, OID values or GUID octets
+  return H225_GenericIdentifier::Compare(obj);
+}
 
-  if (id.IDString() == IDString())
-        return EqualTo;
-  else
-        return LessThan;
+PINDEX H460_FeatureID::HashFunction() const
+{
+    PINDEX hash = 0;
+
+    switch (GetFeatureType()) {
+       case H225_GenericIdentifier::e_standard:
+            hash = ((const PASN_Integer &)*this).GetValue();
+            break;
+       case H225_GenericIdentifier::e_oid: {
+            const PASN_ObjectId & obj = *this;
+            for (PINDEX i = 0; i < obj.GetSize(); i++)
+                hash += obj[i];
+            break;
+          }
+       case H225_GenericIdentifier::e_nonStandard: {
+            const PBYTEArray & guid = ((const H225_GloballyUniqueID &)*this).GetValue();
+            for (PINDEX i = 0; i < guid.GetSize(); i++)
+                hash += guid[i];
+            break;
+          }
+    }
+
+    return hash%23;
 }
 
 
@@ -559,10 +580,10 @@ PINDEX H460_FeatureTable::GetParameterIndex(const H460_FeatureID & id)
 {
     PINDEX i;
 
+    // Compare the parameter identifiers in place, without copying them
     for (i = 0; i < GetSize(); i++) {
-        H460_FeatureParameter & fparam = (*this)[i];
-        H460_FeatureID param = fparam.ID();
-        if (param == id)
+        const H225_GenericIdentifier & param = (*this)[i].m_id;
+        if (param.Compare(id) == EqualTo)
             return i;
     }
 
@@ -614,9 +635,9 @@ PBoolean H460_FeatureTable::ParameterIsUnique(const H460_FeatureID & id)
     PINDEX j = 0;
 
     for (i = 0; i < GetSize(); i++) {
-        H460_FeatureParameter & param = GetParameter(i);
+        const H225_GenericIdentifier & param = GetParameter(i).m_id;
 
-        if (param.ID() == id) {
+        if (param.Compare(id) == EqualTo) {
             j++;
         }
     }
@@ -800,8 +821,9 @@ H460_FeatureParameter & H460_Feature::Value(const H460_FeatureID & id)
 {
     if (HasOptionalField(e_parameters)) {
         H460_FeatureTable & Table = (H460_FeatureTable &)m_parameters;
-        if (Table.HasParameter(id))
-            return Table.GetParameter(id);
+        PINDEX num = Table.GetParameterIndex(id);
+        if (num < Table.GetSize())
+            return Table.GetParameter(num);
     }
     PAssertAlways("LOGIC ERROR: Must call <if (.Contains)> before .Value");
     return *(new H460_FeatureParameter());    // BUG: memory leak but is never called - SH
@@ -910,8 +932,16 @@ H460_Feature * H460_Feature::CreateFeature(const PString & featurename, int pduT
 
 PBoolean H460_Feature::FeatureList(int type, H460FeatureList & plist, H323EndPoint * ep, PPluginManager * pluginMgr)
 {
-  if (pluginMgr == NULL)
-    pluginMgr = &PPluginManager::GetPluginManager();
+  if (pluginMgr == NULL || pluginMgr == &PPluginManager::GetPluginManager()) {
+    const H460_FeatureCatalogue * catalogue = H460_FeatureCatalogue::Acquire(type);
+    for (PINDEX i = 0; i < catalogue->GetSize(); i++) {
+      const H460_FeatureCatalogue::Entry & entry = (*catalogue)[i];
+      if (ep == NULL || ep->OnFeatureInstance(type, entry.name))
+        plist.insert(pair<PString,H460_FeatureID*>(entry.name, new H460_FeatureID(entry.id)));
+    }
+    H460_FeatureCatalogue::Release(catalogue);
+    return (!plist.empty());
+  }
 
    PStringList featurelist = H460_Feature::GetFeatureNames(pluginMgr);
 
@@ -936,6 +966,128 @@ PBoolean H460_Feature::FeatureList(int type, H460FeatureList & plist, H323EndPoi
    return (!plist.empty());
 }
 
+/////////////////////////////////////////////////////////////////////
+
+class H460_FeatureCatalogueRefresh : public PObject
+{
+    PCLASSINFO(H460_FeatureCatalogueRefresh, PObject);
+  public:
+    H460_FeatureCatalogueRefresh()
+    {
+      PPluginManager::GetPluginManager().AddNotifier(PCREATE_NOTIFIER(OnPlugin));
+    }
+
+  protected:
+    PDECLARE_NOTIFIER(PDynaLink, H460_FeatureCatalogueRefresh, OnPlugin);
+};
+
+
+void H460_FeatureCatalogueRefresh::OnPlugin(PDynaLink &, H323_INT)
+{
+  H460_FeatureCatalogue::Refresh();
+}
+
+
+static PMutex & CatalogueMutex()
+{
+  static PMutex mutex;
+  return mutex;
+}
+
+
+typedef std::map<int, const H460_FeatureCatalogue *> H460_FeatureCatalogues;
+
+static H460_FeatureCatalogues & Catalogues()
+{
+  static H460_FeatureCatalogues catalogues;
+  return catalogues;
+}
+
+
+H460_FeatureCatalogue::H460_FeatureCatalogue(int _type, PPluginManager & pluginMgr)
+  : type(_type), references(1)
+{
+  // Ordered as FeatureList() orders them, which is the order features are loaded in
+  H460FeatureList plist;
+  std::map<PString, PDevicePluginServiceDescriptor *> descriptors;
+
+  PStringList featurelist = H460_Feature::GetFeatureNames(&pluginMgr);
+  for (PINDEX i = 0; i<featurelist.GetSize(); i++) {
+    PDevicePluginServiceDescriptor * desc =
+           (PDevicePluginServiceDescriptor *)pluginMgr.GetServiceDescriptor(featurelist[i], H460FeaturePluginBaseClass);
+
+    if (desc != NULL && desc->ValidateDeviceName(featurelist[i], type)) {
+        PString feat = featurelist[i].Left(3);
+        if (feat == "Std")             // Std feature
+            plist.insert(pair<PString,H460_FeatureID*>(featurelist[i], new H460_FeatureID(featurelist[i].Mid(3).AsInteger())));
+        else if (feat == "OID")        // OID feature
+            plist.insert(pair<PString,H460_FeatureID*>(featurelist[i], new H460_FeatureID(OpalOID(desc->GetDeviceNames(1)[0]))));
+        else                           // NonStd Feature
+            plist.insert(pair<PString,H460_FeatureID*>(featurelist[i], new H460_FeatureID(feat)));
+        descriptors[featurelist[i]] = desc;
+    }
+  }
+
+  entries.resize(plist.size());
+  PINDEX n = 0;
+  for (H460FeatureList::const_iterator it = plist.begin(); it != plist.end(); ++it, ++n) {
+    entries[n].name = it->first;
+    entries[n].id = *it->second;
+    entries[n].descriptor = descriptors[it->first];
+  }
+  DeleteFeatureList(plist);
+
+  PTRACE(4, "H460\tCatalogue of " << entries.size() << " features for type " << type);
+}
+
+
+const H460_FeatureCatalogue * H460_FeatureCatalogue::Acquire(int type)
+{
+  static H460_FeatureCatalogueRefresh refresh;
+
+  PWaitAndSignal m(CatalogueMutex());
+
+  H460_FeatureCatalogues::iterator it = Catalogues().find(type);
+  if (it == Catalogues().end())
+    it = Catalogues().insert(H460_FeatureCatalogues::value_type(type,
+                          new H460_FeatureCatalogue(type, PPluginManager::GetPluginManager()))).first;
+
+  ++it->second->references;
+  return it->second;
+}
+
+
+void H460_FeatureCatalogue::Release(const H460_FeatureCatalogue * catalogue)
+{
+  if (catalogue != NULL && --catalogue->references == 0)
+    delete catalogue;
+}
+
+
+void H460_FeatureCatalogue::Load(int type)
+{
+  Release(Acquire(type));
+}
+
+
+void H460_FeatureCatalogue::Refresh()
+{
+  PWaitAndSignal m(CatalogueMutex());
+
+  for (H460_FeatureCatalogues::iterator it = Catalogues().begin(); it != Catalogues().end(); ++it)
+    Release(it->second);
+  Catalogues().clear();
+
+  PTRACE(4, "H460\tFeature catalogues discarded");
+}
+
+
+H460_Feature * H460_FeatureCatalogue::CreateFeature(PINDEX i) const
+{
+  return (H460_Feature *)entries[i].descriptor->CreateInstance(type);
+}
+
+
 /////////////////////////////////////////////////////////////////////
 
 H460_FeatureStd::H460_FeatureStd(unsigned Identifier)
@@ -1116,6 +1268,8 @@ H460_FeatureSet::~H460_FeatureSet()
                 delete feat;
         }
     }
+    StdFeatureIndex.clear();
+    FeatureIndex.clear();
     Features.RemoveAll();
 }
 
@@ -1212,21 +1366,23 @@ PBoolean H460_FeatureSet::LoadFeatureSet(int inst, H323Connection * con)
   if ((ep) && (ep->FeatureSetDisabled()))
      return FALSE;
 
-  H460FeatureList featurelist;
-  H460_Feature::FeatureList(inst,featurelist,ep);
+  const H460_FeatureCatalogue * catalogue = H460_FeatureCatalogue::Acquire(inst);
+
+  for (PINDEX i = 0; i < catalogue->GetSize(); i++) {
+        const H460_FeatureCatalogue::Entry & entry = (*catalogue)[i];
+        if (ep && !ep->OnFeatureInstance(inst, entry.name))
+            continue;
 
-  	 H460FeatureList::const_iterator it = featurelist.begin();
-	 while (it != featurelist.end()) {
         H460_Feature * feat = NULL;
-        if (baseSet && baseSet->HasFeature(*it->second)) {
-            H460_Feature * tempfeat = baseSet->GetFeature(*it->second);
+        if (baseSet && baseSet->HasFeature(entry.id)) {
+            H460_Feature * tempfeat = baseSet->GetFeature(entry.id);
             if (tempfeat->GetFeaturePurpose() == H460_Feature::FeatureBaseAll)
                 feat = tempfeat;
             else {
                 feat = (H460_Feature*)(tempfeat->Clone());
             }
         } else {
-            feat = H460_Feature::CreateFeature(it->first,inst);
+            feat = catalogue->CreateFeature(i);
             if ((feat) && (ep))
                 feat->AttachEndPoint(ep);
         }
@@ -1236,12 +1392,11 @@ PBoolean H460_FeatureSet::LoadFeatureSet(int inst, H323Connection * con)
                 feat->AttachConnection(con);
 
            AddFeature(feat);
-           PTRACE(4, "H460\tLoaded Feature " << it->first);
+           PTRACE(4, "H460\tLoaded Feature " << entry.name);
         }
-        ++it;
-      }
+  }
 
-  DeleteFeatureList(featurelist);
+  H460_FeatureCatalogue::Release(catalogue);
   return TRUE;
 }
 
@@ -1265,8 +1420,11 @@ PBoolean H460_FeatureSet::AddFeature(H460_Feature * Nfeat)
 {
     PTRACE(4, "H460\tLoaded " << Nfeat->GetFeatureIDAsString());
 
-    return Features.SetAt(Nfeat->GetFeatureID(), Nfeat);
+    if (!Features.SetAt(Nfeat->GetFeatureID(), Nfeat))
+        return FALSE;
 
+    IndexFeature(Nfeat);
+    return TRUE;
 }
 
 void H460_FeatureSet::RemoveFeature(H460_FeatureID id)
@@ -1288,6 +1446,7 @@ void H460_FeatureSet::RemoveFeature(H460_FeatureID id)
     }
     PTRACE(4, info);
 
+    UnindexFeature(id);
     Features.RemoveAt(id);
 }
 
@@ -1420,8 +1579,9 @@ void H460_FeatureSet::ReadFeatureSetPDU(const H225_FeatureSet & fs, unsigned Mes
               H225_FeatureDescriptor & fd = fsn[i];
               ID = GetFeatureIDPDU(fd);
 
-              if (HasFeature(ID))
-                    ReadFeaturePDU(Features[ID],fd,MessageID);
+              H460_Feature * feat = FindFeature(ID);
+              if (feat != NULL)
+                    ReadFeaturePDU(*feat,fd,MessageID);
           }
       }
 
@@ -1432,8 +1592,9 @@ void H460_FeatureSet::ReadFeatureSetPDU(const H225_FeatureSet & fs, unsigned Mes
               H225_FeatureDescriptor & fd = fsd[i];
               ID = GetFeatureIDPDU(fd);
 
-              if (HasFeature(ID))
-                    ReadFeaturePDU(Features[ID],fd,MessageID);
+              H460_Feature * feat = FindFeature(ID);
+              if (feat != NULL)
+                    ReadFeaturePDU(*feat,fd,MessageID);
           }
       }
 
@@ -1444,8 +1605,9 @@ void H460_FeatureSet::ReadFeatureSetPDU(const H225_FeatureSet & fs, unsigned Mes
               H225_FeatureDescriptor & fd = fss[i];
               ID = GetFeatureIDPDU(fd);
 
-              if (HasFeature(ID))
-                    ReadFeaturePDU(Features[ID],fd,MessageID);
+              H460_Feature * feat = FindFeature(ID);
+              if (feat != NULL)
+                    ReadFeaturePDU(*feat,fd,MessageID);
           }
       }
 
@@ -1773,6 +1935,7 @@ void H460_FeatureSet::DisableAllFeatures(int msgtype)
         }
 
         while (!removelist.empty()) {
+            UnindexFeature(removelist.front());
             Features.RemoveAt(removelist.front());
             removelist.pop_front();
         }
@@ -1802,32 +1965,48 @@ void H460_FeatureSet::AttachBaseFeatureSet(H460_FeatureSet * _baseSet)
 
 PBoolean H460_FeatureSet::HasFeature(const H460_FeatureID & id)
 {
-    for (PINDEX i = 0; i < Features.GetSize(); i++) {
-       H460_Feature & feat = Features.GetDataAt(i);
-        if (feat.GetFeatureID() == id) {
-            return TRUE;
-        }
-    }
-    return FALSE;
+    return FindFeature(id) != NULL;
 }
 
 PBoolean H460_FeatureSet::SupportNonCallService(const H460_FeatureID & id) const
 {
-    for (PINDEX i = 0; i < Features.GetSize(); i++) {
-       H460_Feature & feat = Features.GetDataAt(i);
-        if (feat.GetFeatureID() == id) {
-            return feat.SupportNonCallService();
-        }
-    }
+    H460_Feature * feat = FindFeature(id);
+    if (feat != NULL)
+        return feat->SupportNonCallService();
     return FALSE;
 }
 
 H460_Feature * H460_FeatureSet::GetFeature(const H460_FeatureID & id)
 {
-    if (HasFeature(id))
-       return &Features[id];
+    return FindFeature(id);
+}
+
+H460_Feature * H460_FeatureSet::FindFeature(const H460_FeatureID & id) const
+{
+    if (id.GetFeatureType() == H225_GenericIdentifier::e_standard) {
+        std::map<unsigned, H460_Feature *>::const_iterator it = StdFeatureIndex.find((unsigned)id);
+        return it != StdFeatureIndex.end() ? it->second : NULL;
+    }
+
+    std::map<H460_FeatureID, H460_Feature *>::const_iterator it = FeatureIndex.find(id);
+    return it != FeatureIndex.end() ? it->second : NULL;
+}
+
+void H460_FeatureSet::IndexFeature(H460_Feature * feat)
+{
+    H460_FeatureID id = feat->GetFeatureID();
+    if (id.GetFeatureType() == H225_GenericIdentifier::e_standard)
+        StdFeatureIndex[(unsigned)id] = feat;
+    else
+        FeatureIndex[id] = feat;
+}
+
+void H460_FeatureSet::UnindexFeature(const H460_FeatureID & id)
+{
+    if (id.GetFeatureType() == H225_GenericIdentifier::e_standard)
+        StdFeatureIndex.erase((unsigned)id);
     else
-       return NULL;
+        FeatureIndex.erase(id);
 }
 
 #endif // H323_H460
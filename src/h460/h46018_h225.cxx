@@ -50,15 +50,24 @@
 #include <h323pdu.h>
 #include <h460/h46018_h225.h>
 #include <h460/h46018.h>
+#include "rtpbatch.h"
+#include "h323sigpool.h"
 #include <ptclib/random.h>
 #include <ptclib/cypher.h>
 
 #define H46019_KEEPALIVE_TIME       19   // Sec between keepalive messages
 #define H46019_KEEPALIVE_COUNT      3    // Number of probes per message
 #define H46019_KEEPALIVE_INTERVAL   100  // ms between each probe
+#define H46019_KEEPALIVE_SLOTS      256  // Slots of the keepalive timer wheel, each H46019_KEEPALIVE_INTERVAL
+#define H46019_MULTIPLEX_SPARES     16   // Receive buffers kept for reuse
+#define H46019_MULTIPLEX_BATCH      32   // Datagrams read per system call
+#define H46019_MULTIPLEX_SEND_BATCH 64   // Datagrams queued for one send system call
+#define H46018_SPARE_TIME           20000 // ms a call signalling channel opened ahead of an SCI is kept
 
 #define H46024A_MAX_PROBE_COUNT  15
 #define H46024A_PROBE_INTERVAL  200
+#define H46024B_CHECK_COUNT      3
+#define H46024_CHECK_PACE        20    // ms between checks to any of the candidates
 
 #if PTLIB_VER >= 2130
 PCREATE_NAT_PLUGIN(H46019, "H.460.19");
@@ -86,8 +95,8 @@ class H46018TransportThread : public PThread
     PBoolean    isConnected;
     H46018Transport * transport;
 
-    PDECLARE_NOTIFIER(PTimer, H46018TransportThread, KeepAlive);
-    PTimer    m_keepAlive;
+    PDECLARE_NOTIFIER(H323Timer, H46018TransportThread, KeepAlive);
+    H323Timer m_keepAlive;
     unsigned  m_keepAliveInterval;
 
     PTime   lastupdate;
@@ -110,7 +119,7 @@ H46018TransportThread::H46018TransportThread(H323EndPoint & ep, H46018Transport
 
 H46018TransportThread::~H46018TransportThread()
 {
-    m_keepAlive.Stop();
+    m_keepAlive.Stop(TRUE);
 }
 
 void H46018TransportThread::Main()
@@ -139,7 +148,7 @@ void H46018TransportThread::ConnectionEstablished()
      m_keepAlive.RunContinuous(m_keepAliveInterval * 1000);
 }
 
-void H46018TransportThread::KeepAlive(PTimer &, H323_INT)
+void H46018TransportThread::KeepAlive(H323Timer &, H323_INT)
 {
     // Send empty RFC1006 TPKT
     BYTE tpkt[4];
@@ -245,9 +254,7 @@ PBoolean H46018Transport::HandleH46018SignallingChannelPDU(PThread * thread)
     }
 
     PTRACE(3, "H46018\tCreated new connection: " << token);
-    connectionsMutex.Wait();
-    endpoint.GetConnections().SetAt(token, connection);
-    connectionsMutex.Signal();
+    endpoint.AddConnection(token, connection);
 
     connection->AttachSignalChannel(token, this, true);
 
@@ -367,12 +374,17 @@ H46018Handler::H46018Handler(H323EndPoint & ep)
 #endif
 
     SocketCreateThread = NULL;
+    m_keepAlive = NULL;
+    m_spare = NULL;
+    m_spareOpened = 0;
 }
 
 H46018Handler::~H46018Handler()
 {
     PTRACE(4, "H46018\tClosing H46018 Handler.");
     EP.GetNatMethods().RemoveMethod("H46019");
+    delete m_keepAlive;
+    delete m_spare;
 }
 
 void H46018Handler::SetTransportSecurity(const H323TransportSecurity & callSecurity)
@@ -418,15 +430,33 @@ void H46018Handler::SocketThread(PThread &,  H323_INT)
         return;
     }
 
-    H46018Transport * transport = new H46018Transport(EP, PIPSocket::Address::GetAny(m_address.GetIpVersion()));
-    transport->InitialiseSecurity(&m_callSecurity);
+    H323TransportSecurity security = m_callSecurity;
+    H323TransportAddress remote = m_address;
     if (m_callSecurity.IsTLSEnabled() && !m_callSecurity.GetRemoteTLSAddress().IsEmpty()) {
-        transport->SetRemoteAddress(m_callSecurity.GetRemoteTLSAddress());
+        remote = m_callSecurity.GetRemoteTLSAddress();
         m_callSecurity.Reset();
-    } else
-        transport->SetRemoteAddress(m_address);
+    }
+
+    // A channel opened ahead of the call only needs the initial PDU
+    PBoolean connected = false;
+    H46018Transport * transport = TakeSpareChannel(remote);
+    if (transport != NULL) {
+        connected = transport->InitialPDU(m_callId);
+        if (!connected) {
+            PTRACE(3, "H46018\tSpare channel to " << remote << " failed, connecting again");
+            delete transport;
+            transport = NULL;
+        }
+    }
 
-    if (transport->Connect(m_callId)) {
+    if (transport == NULL) {
+        transport = new H46018Transport(EP, PIPSocket::Address::GetAny(remote.GetIpVersion()));
+        transport->InitialiseSecurity(&security);
+        transport->SetRemoteAddress(remote);
+        connected = transport->Connect(m_callId);
+    }
+
+    if (connected) {
         PTRACE(3, "H46018\tConnected to " << transport->GetRemoteAddress());
         new H46018TransportThread(EP, transport);
         lastCallIdentifer = m_callId.AsString();
@@ -436,6 +466,53 @@ void H46018Handler::SocketThread(PThread &,  H323_INT)
 
     m_address = H323TransportAddress();
     m_callId = PString();
+
+    if (EP.IsH46018PreOpenSignalling())
+        OpenSpareChannel(remote, security);
+}
+
+H46018Transport * H46018Handler::TakeSpareChannel(const H323TransportAddress & address)
+{
+    PWaitAndSignal m(m_spareMutex);
+
+    H46018Transport * spare = m_spare;
+    m_spare = NULL;
+    if (spare == NULL)
+        return NULL;
+
+    if (!m_spareAddress.IsEquivalent(address) ||
+        PTimer::Tick().GetMilliSeconds() - m_spareOpened >= H46018_SPARE_TIME ||
+        H323SignallingPool::IsStale(*spare)) {
+        PTRACE(4, "H46018\tSpare channel to " << m_spareAddress << " not used");
+        delete spare;
+        return NULL;
+    }
+
+    PTRACE(4, "H46018\tUsing spare channel to " << address);
+    return spare;
+}
+
+void H46018Handler::OpenSpareChannel(const H323TransportAddress & address, const H323TransportSecurity & security)
+{
+    H46018Transport * spare = new H46018Transport(EP, PIPSocket::Address::GetAny(address.GetIpVersion()));
+    spare->InitialiseSecurity(&security);
+    spare->SetRemoteAddress(address);
+    if (!spare->PreOpen()) {
+        PTRACE(3, "H46018\tCould not open spare channel to " << address);
+        delete spare;
+        return;
+    }
+
+    PTRACE(4, "H46018\tOpened spare channel to " << address);
+
+    m_spareMutex.Wait();
+    H46018Transport * old = m_spare;
+    m_spare = spare;
+    m_spareAddress = address;
+    m_spareOpened = PTimer::Tick().GetMilliSeconds();
+    m_spareMutex.Signal();
+
+    delete old;
 }
 
 void H46018Handler::Enable()
@@ -455,6 +532,16 @@ H323EndPoint * H46018Handler::GetEndPoint()
     return &EP;
 }
 
+H46019KeepAlive & H46018Handler::GetKeepAlive()
+{
+    PWaitAndSignal m(m_keepAliveMutex);
+
+    if (m_keepAlive == NULL)
+        m_keepAlive = new H46019KeepAlive();
+
+    return *m_keepAlive;
+}
+
 #ifdef H323_H46019M
 void H46018Handler::EnableMultiplex(bool enable)
 {
@@ -484,8 +571,14 @@ PBoolean                      PNatMethod_H46019::multiplex=false;
 muxSocketMap                  PNatMethod_H46019::rtpSocketMap;
 muxPortMap                    PNatMethod_H46019::rtpPortMap;
 muxSocketMap                  PNatMethod_H46019::rtcpSocketMap;
+H46019MultiplexTable          PNatMethod_H46019::rtpSocketTable;
+H46019MultiplexTable          PNatMethod_H46019::rtcpSocketTable;
 PBoolean                      PNatMethod_H46019::muxShutdown;
-PMutex                        PNatMethod_H46019::muxMutex;
+H323ProfiledMutex             PNatMethod_H46019::muxMutex("PNatMethod_H46019::muxMutex");
+PINDEX                        PNatMethod_H46019::muxReadThreads = 1;
+std::vector<PUDPSocket *>     PNatMethod_H46019::muxShardSockets;
+std::vector<PThread *>        PNatMethod_H46019::muxShardThreads;
+std::vector<std::pair<PThread *, PUDPSocket *> > PNatMethod_H46019::muxRetiredShards;
 #endif
 
 PNatMethod_H46019::PNatMethod_H46019()
@@ -499,30 +592,26 @@ PNatMethod_H46019::PNatMethod_H46019()
 PNatMethod_H46019::~PNatMethod_H46019()
 {
 #ifdef H323_H46019M
-    PWaitAndSignal m(muxMutex);
-
-    if (IsMultiplexed()) {
-        muxShutdown = true;
-        EnableMultiplex(false);
+    {
+        PWaitAndSignal m(muxMutex);
 
-        m_readThread = NULL;
+        if (IsMultiplexed()) {
+            muxShutdown = true;
+            EnableMultiplex(false);
 
-        rtpSocketMap.clear();
-        rtpPortMap.clear();
-        rtcpSocketMap.clear();
+            m_readThread = NULL;
 
-        if (muxSockets.rtp) {
-            muxSockets.rtp->Close();
-            delete muxSockets.rtp;
-            muxSockets.rtp = NULL;
-        }
+            rtpSocketMap.clear();
+            rtpPortMap.clear();
+            rtcpSocketMap.clear();
+            rtpSocketTable.Clear();
+            rtcpSocketTable.Clear();
 
-        if (muxSockets.rtcp) {
-            muxSockets.rtcp->Close();
-            delete muxSockets.rtcp;
-            muxSockets.rtcp = NULL;
+            CloseMultiplexSockets();
         }
     }
+
+    JoinMultiplexShards();
 #endif
 }
 
@@ -601,7 +690,8 @@ PBoolean PNatMethod_H46019::CreateSocketPair(PUDPSocket * & socket1,
 #ifdef H323_H46019M
     if (info->GetRecvMultiplexID() > 0) {
         if (!multiplex) {
-           muxSockets.rtp = new H46019MultiplexSocket(true);
+           bool shared = muxReadThreads > 1;
+           muxSockets.rtp = new H46019MultiplexSocket(true, shared);
            muxSockets.rtcp = new H46019MultiplexSocket(false);
            muxPortInfo.currentPort = muxPortInfo.basePort-1;
             while ((!OpenSocket(*muxSockets.rtp, muxPortInfo, binding)) ||
@@ -610,12 +700,13 @@ PBoolean PNatMethod_H46019::CreateSocketPair(PUDPSocket * & socket1,
                 {
                     delete muxSockets.rtp;
                     delete muxSockets.rtcp;
-                    muxSockets.rtp = new H46019MultiplexSocket(true);    /// Data
+                    muxSockets.rtp = new H46019MultiplexSocket(true, shared);    /// Data
                     muxSockets.rtcp = new H46019MultiplexSocket(false);    /// Signal
                 }
                PTRACE(4, "H46019\tMultiplex UDP ports "
                      << muxSockets.rtp->GetPort() << '-' << muxSockets.rtcp->GetPort());
 
+              OpenMultiplexShards(binding);
               StartMultiplexListener();  // Start Multiplexing Listening thread;
               EnableMultiplex(true);
         }
@@ -810,9 +901,96 @@ void PNatMethod_H46019::StartMultiplexListener()
                                     PThread::AutoDeleteThread,
                                     PThread::NormalPriority,
                                     "GkMonitor:%x");
+
+  // Shard threads only read their own RTP socket, RTCP stays on the first
+  // and are joined before their sockets are deleted
+  for (PINDEX i = 0; i < (PINDEX)muxShardSockets.size(); i++)
+      muxShardThreads.push_back(PThread::Create(PCREATE_NOTIFIER(ReadThread), i+1,
+                                    PThread::NoAutoDeleteThread,
+                                    PThread::NormalPriority,
+                                    "H46019M:%x"));
+}
+
+void PNatMethod_H46019::SetMultiplexReadThreads(PINDEX count)
+{
+    muxReadThreads = count > 0 ? count : 1;
 }
 
-void PNatMethod_H46019::ReadThread(PThread &, H323_INT)
+PINDEX PNatMethod_H46019::GetMultiplexReadThreads()
+{
+    return muxReadThreads;
+}
+
+void PNatMethod_H46019::OpenMultiplexShards(const PIPSocket::Address & binding)
+{
+#ifdef SO_REUSEPORT
+    // NAT sub sockets cannot be shared
+    if (muxReadThreads < 2 || ((H46019MultiplexSocket *)muxSockets.rtp)->GetSubSocket() != NULL)
+        return;
+
+    WORD port = muxSockets.rtp->GetPort();
+    for (PINDEX i = 1; i < muxReadThreads; i++) {
+        H46019MultiplexSocket * shard = new H46019MultiplexSocket(true, true);
+        if (!shard->Listen(binding, 1, port)) {
+            PTRACE(2, "H46019M\tCould not share multiplex port " << port << ", using " << i << " read threads");
+            delete shard;
+            break;
+        }
+        shard->SetReadTimeout(500);
+        muxShardSockets.push_back(shard);
+    }
+
+    PTRACE(4, "H46019M\tMultiplex port " << port << " read by " << muxShardSockets.size()+1 << " threads");
+#else
+    PTRACE_IF(2, muxReadThreads > 1, "H46019M\tSO_REUSEPORT not available, using one read thread");
+#endif
+}
+
+void PNatMethod_H46019::CloseMultiplexSockets()
+{
+    if (muxSockets.rtp) {
+        muxSockets.rtp->Close();
+        delete muxSockets.rtp;
+        muxSockets.rtp = NULL;
+    }
+
+    if (muxSockets.rtcp) {
+        muxSockets.rtcp->Close();
+        delete muxSockets.rtcp;
+        muxSockets.rtcp = NULL;
+    }
+
+    // A shard thread may still be in ReadFrom() on its socket, and may be
+    // waiting for muxMutex, so the socket is only closed here. The thread
+    // is joined and the socket deleted by JoinMultiplexShards() once the
+    // mutex is released.
+    for (PINDEX i = 0; i < (PINDEX)muxShardSockets.size(); i++) {
+        muxShardSockets[i]->Close();
+        PThread * thread = i < (PINDEX)muxShardThreads.size() ? muxShardThreads[i] : NULL;
+        muxRetiredShards.push_back(std::pair<PThread *, PUDPSocket *>(thread, muxShardSockets[i]));
+    }
+    muxShardSockets.clear();
+    muxShardThreads.clear();
+}
+
+void PNatMethod_H46019::JoinMultiplexShards()
+{
+    std::vector<std::pair<PThread *, PUDPSocket *> > retired;
+    {
+        PWaitAndSignal m(muxMutex);
+        retired.swap(muxRetiredShards);
+    }
+
+    for (size_t i = 0; i < retired.size(); i++) {
+        if (retired[i].first != NULL) {
+            retired[i].first->WaitForTermination();
+            delete retired[i].first;
+        }
+        delete retired[i].second;
+    }
+}
+
+void PNatMethod_H46019::ReadThread(PThread &, H323_INT shard)
 {
     PINDEX bufferLen = 2000;
     RTP_MultiDataFrame buffer(bufferLen);
@@ -823,13 +1001,18 @@ void PNatMethod_H46019::ReadThread(PThread &, H323_INT)
     PUDPSocket * socket = NULL;
     H46019MultiplexSocket::MuxType socketRead;
 
-    PUDPSocket & dataSocket = *GetMultiplexReadSocket(true);
+    PUDPSocket & dataSocket = shard > 0 ? *muxShardSockets[shard-1] : *GetMultiplexReadSocket(true);
     PUDPSocket & ctrlSocket = *GetMultiplexReadSocket(false);
 
+    // The multiplexed RTP socket carries every call, so drain it in batches.
+    // Only when it is our own socket, NAT sub sockets may filter their reads.
+    RTP_DatagramBatch rtpBatch(shard > 0 || &dataSocket == GetMultiplexSocket(true) ? H46019_MULTIPLEX_BATCH : 1, bufferLen);
+
     int select = 0;
     while (!muxShutdown) {
+        // A shard only has its RTP socket, the read timeout checks for shutdown
         if (select == 0)
-            select = PIPSocket::Select(dataSocket, ctrlSocket);
+            select = (shard > 0 || rtpBatch.HasPending()) ? -1 : PIPSocket::Select(dataSocket, ctrlSocket);
 
         switch (select) {
         case -1:
@@ -849,10 +1032,18 @@ void PNatMethod_H46019::ReadThread(PThread &, H323_INT)
             continue;
     }
 
-    if (!muxShutdown && socket && socket->ReadFrom(buffer.GetPointer(), len, addr, port)) {
-        int actRead = socket->GetLastReadCount();
+    PBoolean readOk = false;
+    PINDEX actRead = 0;
+    if (!muxShutdown && socket) {
+        if (socketRead == H46019MultiplexSocket::e_rtp)
+            readOk = rtpBatch.ReadFrom(*socket, buffer.GetPointer(), len, addr, port, actRead);
+        else if ((readOk = socket->ReadFrom(buffer.GetPointer(), len, addr, port)))
+            actRead = socket->GetLastReadCount();
+    }
+
+    if (readOk) {
         int muxHeader = buffer.GetMultiHeaderSize();
-        std::map<unsigned, PUDPSocket*>::const_iterator it;
+        PUDPSocket * target = NULL;
         switch (socketRead) {
             case H46019MultiplexSocket::e_rtp:
             {
@@ -864,13 +1055,16 @@ void PNatMethod_H46019::ReadThread(PThread &, H323_INT)
                     }
                     // We have received a valid RTP UnMuxed Packet.
                     muxHeader = 0;  // Read from the first byte
+                    PWaitAndSignal m(muxMutex);
                     multiplexID = ResolveMuxIDFromSourceAddress(rtpSocketMap, rtpPortMap, addr, port);
                     } else {
                         multiplexID = buffer.GetMultiplexID();
                     }
 
-                    it = rtpSocketMap.find(multiplexID);
-                    if (it == rtpSocketMap.end()) {
+                    target = rtpSocketTable.Find(multiplexID);
+                    if (target == NULL) {
+                        // Slow path, search the sessions for one that matches
+                        PWaitAndSignal m(muxMutex);
                         unsigned badMUXid = multiplexID;
                         unsigned rightMUXid = 0;
                         unsigned detected = ResolveSession(rtpSocketMap, badMUXid, true, addr, port, rightMUXid);
@@ -878,12 +1072,12 @@ void PNatMethod_H46019::ReadThread(PThread &, H323_INT)
                             PTRACE(2, "H46019M\tReceived RTP packet with unknown MUX ID " << badMUXid << " " << addr << ":" << port);
                             continue;
                         }
-                        it = rtpSocketMap.find(detected);
-                        if (it == rtpSocketMap.end()) continue;
+                        target = rtpSocketTable.Find(detected);
+                        if (target == NULL) continue;
 
                         if (rightMUXid == 0) {
                             PTRACE(2, "H46019M\tERROR: Receive UnMultiplex Packet " << " " << addr << ":" << port);
-                            ((H46019UDPSocket *)it->second)->WriteMultiplexBuffer(buffer.GetPointer(), actRead, addr, port);
+                            ((H46019UDPSocket *)target)->WriteMultiplexBuffer(buffer.GetPointer(), actRead, addr, port);
                             continue;
                         }
                         PTRACE(2, "H46019M\tERROR: Recover Receive Multiplex Session " << rightMUXid  << " incorrectly sent as " << badMUXid);
@@ -892,8 +1086,8 @@ void PNatMethod_H46019::ReadThread(PThread &, H323_INT)
                 }
 
                 case H46019MultiplexSocket::e_rtcp:
-                    it = rtcpSocketMap.find(buffer.GetMultiplexID());
-                    if (it == rtcpSocketMap.end()) {
+                    target = rtcpSocketTable.Find(buffer.GetMultiplexID());
+                    if (target == NULL) {
                         PTRACE(2, "H46019M\tReceived RTCP packet with unknown MUX ID "
                                 << buffer.GetMultiplexID() << " " << addr << ":" << port);
                         continue;
@@ -904,7 +1098,7 @@ void PNatMethod_H46019::ReadThread(PThread &, H323_INT)
                     continue;
              }
 
-             ((H46019UDPSocket *)it->second)->WriteMultiplexBuffer(buffer.GetPointer()+muxHeader, actRead-muxHeader, addr, port);
+             ((H46019UDPSocket *)target)->WriteMultiplexBuffer(buffer.GetPointer()+muxHeader, actRead-muxHeader, addr, port);
              len = bufferLen;
          } else {
              if (muxShutdown) continue;
@@ -937,38 +1131,223 @@ void PNatMethod_H46019::ReadThread(PThread &, H323_INT)
 
 void PNatMethod_H46019::RegisterSocket(bool rtp, unsigned id, PUDPSocket * socket)
 {
-    if (rtp)
-       rtpSocketMap.insert(pair<unsigned, PUDPSocket*>(id,socket));
-    else
-       rtcpSocketMap.insert(pair<unsigned, PUDPSocket*>(id,socket));
+    PWaitAndSignal m(muxMutex);
+
+    if (rtp) {
+       if (rtpSocketMap.insert(pair<unsigned, PUDPSocket*>(id,socket)).second)
+           rtpSocketTable.Insert(id, socket);
+    } else {
+       if (rtcpSocketMap.insert(pair<unsigned, PUDPSocket*>(id,socket)).second)
+           rtcpSocketTable.Insert(id, socket);
+    }
 }
 
 void PNatMethod_H46019::UnregisterSocket(bool rtp, unsigned id)
 {
-    if (rtp) {
-        std::map<unsigned, PUDPSocket*>::iterator it = rtpSocketMap.find(id);
-        if (it != rtpSocketMap.end())
-             rtpSocketMap.erase(it);
-    } else {
-        std::map<unsigned, PUDPSocket*>::iterator it = rtcpSocketMap.find(id);
-        if (it != rtcpSocketMap.end())
-             rtcpSocketMap.erase(it);
+    {
+        PWaitAndSignal m(muxMutex);
+
+        if (rtp) {
+            std::map<unsigned, PUDPSocket*>::iterator it = rtpSocketMap.find(id);
+            if (it != rtpSocketMap.end())
+                 rtpSocketMap.erase(it);
+            rtpSocketTable.Remove(id);
+        } else {
+            std::map<unsigned, PUDPSocket*>::iterator it = rtcpSocketMap.find(id);
+            if (it != rtcpSocketMap.end())
+                 rtcpSocketMap.erase(it);
+            rtcpSocketTable.Remove(id);
+        }
+
+        if (rtp && rtpSocketMap.size() == 0) {
+            muxShutdown = true;
+            CloseMultiplexSockets();
+            EnableMultiplex(false);
+        }
+    }
+
+    JoinMultiplexShards();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
+static inline PINDEX MultiplexHash(unsigned id)
+{
+    // Multiplex IDs are handed out sequentially, spread them over the table
+    DWORD hash = id * 2654435761U;
+    return hash ^ (hash >> 16);
+}
+
+H46019MultiplexTable::Table::Table(PINDEX sz)
+  : size(sz), used(0), slots(new Slot[sz]), retired(NULL)
+{
+    for (PINDEX i = 0; i < size; i++) {
+        slots[i].sequence = 0;
+        slots[i].id = 0;
+        slots[i].socket = NULL;
     }
+}
+
+H46019MultiplexTable::Table::~Table()
+{
+    delete [] slots;
+    delete retired;
+}
+
+H46019MultiplexTable::H46019MultiplexTable(PINDEX size)
+  : table(NULL), live(0)
+{
+    PINDEX sz = 16;
+    while (sz < size)
+        sz <<= 1;
+    table = new Table(sz);
+}
+
+H46019MultiplexTable::~H46019MultiplexTable()
+{
+    delete table;
+}
+
+PUDPSocket * H46019MultiplexTable::Find(unsigned id) const
+{
+    if (id == 0)
+        return NULL;
+
+    const Table * current = table;
+    H323_MEMORY_BARRIER();
+
+    PINDEX mask = current->size-1;
+    PINDEX pos = MultiplexHash(id) & mask;
+    for (PINDEX probe = 0; probe < current->size; probe++, pos = (pos+1) & mask) {
+        const Slot & slot = current->slots[pos];
+        unsigned slotId;
+        PUDPSocket * socket;
+        DWORD sequence;
+        do {
+            do {
+                sequence = slot.sequence;
+            } while (sequence & 1);   // Writer is changing the slot
+            H323_MEMORY_BARRIER();
+            slotId = slot.id;
+            socket = slot.socket;
+            H323_MEMORY_BARRIER();
+        } while (slot.sequence != sequence);
+
+        if (slotId == id)
+            return socket;
+        if (slotId == 0)
+            break;     // End of the probe chain
+    }
+    return NULL;
+}
 
-    if (rtp && rtpSocketMap.size() == 0) {
-        muxShutdown = true;
-        if (muxSockets.rtp) {
-            muxSockets.rtp->Close();
-            delete muxSockets.rtp;
-            muxSockets.rtp = NULL;
+void H46019MultiplexTable::Write(Slot & slot, unsigned id, PUDPSocket * socket)
+{
+    slot.sequence++;
+    H323_MEMORY_BARRIER();
+    slot.id = id;
+    slot.socket = socket;
+    H323_MEMORY_BARRIER();
+    slot.sequence++;
+}
+
+void H46019MultiplexTable::Insert(unsigned id, PUDPSocket * socket)
+{
+    if (id == 0)
+        return;
+
+    if ((table->used+1)*4 > table->size*3)
+        Rebuild();
+
+    Table & current = *table;
+    PINDEX mask = current.size-1;
+    PINDEX pos = MultiplexHash(id) & mask;
+    PINDEX reuse = P_MAX_INDEX;
+    for (PINDEX probe = 0; probe < current.size; probe++, pos = (pos+1) & mask) {
+        Slot & slot = current.slots[pos];
+        if (slot.id == id) {
+            if (slot.socket == NULL)
+                live++;
+            Write(slot, id, socket);
+            return;
         }
-        if (muxSockets.rtcp) {
-            muxSockets.rtcp->Close();
-            delete muxSockets.rtcp;
-            muxSockets.rtcp = NULL;
+        if (slot.id == 0)
+            break;
+        if (slot.socket == NULL && reuse == P_MAX_INDEX)
+            reuse = pos;   // Removed entry, can be taken over
+    }
+
+    if (reuse == P_MAX_INDEX) {
+        reuse = pos;
+        current.used++;
+    }
+    Write(current.slots[reuse], id, socket);
+    live++;
+}
+
+void H46019MultiplexTable::Remove(unsigned id)
+{
+    if (id == 0)
+        return;
+
+    Table & current = *table;
+    PINDEX mask = current.size-1;
+    PINDEX pos = MultiplexHash(id) & mask;
+    for (PINDEX probe = 0; probe < current.size; probe++, pos = (pos+1) & mask) {
+        Slot & slot = current.slots[pos];
+        if (slot.id == 0)
+            return;
+        if (slot.id == id) {
+            if (slot.socket != NULL) {
+                Write(slot, id, NULL);
+                live--;
+            }
+            break;
         }
-        EnableMultiplex(false);
     }
+
+    if (live == 0)
+        Clear();
+}
+
+void H46019MultiplexTable::Clear()
+{
+    Table & current = *table;
+    for (PINDEX i = 0; i < current.size; i++) {
+        if (current.slots[i].id != 0)
+            Write(current.slots[i], 0, NULL);
+    }
+    current.used = 0;
+    live = 0;
+}
+
+void H46019MultiplexTable::Rebuild()
+{
+    // Compact if most entries were removed, otherwise grow
+    PINDEX size = table->size;
+    while (live*4 >= size)
+        size <<= 1;
+
+    Table * replacement = new Table(size);
+    PINDEX mask = size-1;
+    for (PINDEX i = 0; i < table->size; i++) {
+        const Slot & slot = table->slots[i];
+        if (slot.id == 0 || slot.socket == NULL)
+            continue;
+        PINDEX pos = MultiplexHash(slot.id) & mask;
+        while (replacement->slots[pos].id != 0)
+            pos = (pos+1) & mask;
+        replacement->slots[pos].id = slot.id;
+        replacement->slots[pos].socket = slot.socket;
+        replacement->used++;
+    }
+
+    // Readers may still be probing the old table, keep it until destruction
+    replacement->retired = table;
+    H323_MEMORY_BARRIER();
+    table = replacement;
+
+    PTRACE(4, "H46019M\tMultiplex table rebuilt with " << size << " slots for " << live << " sessions");
 }
 #endif
 
@@ -976,13 +1355,17 @@ void PNatMethod_H46019::UnregisterSocket(bool rtp, unsigned id)
 
 #ifdef H323_H46019M
 H46019MultiplexSocket::H46019MultiplexSocket()
- : m_subSocket(NULL), m_plexType(e_unknown)
+ : m_subSocket(NULL), m_plexType(e_unknown), m_reusePort(false),
+   m_queued(NULL), m_flushing(NULL), m_sending(false), m_sendCalls(0), m_sendDatagrams(0)
 {
+    CreateSendBatches();
 }
 
-H46019MultiplexSocket::H46019MultiplexSocket(bool rtp)
-: m_subSocket(NULL), m_plexType(rtp ? e_rtp : e_rtcp)
+H46019MultiplexSocket::H46019MultiplexSocket(bool rtp, bool reusePort)
+: m_subSocket(NULL), m_plexType(rtp ? e_rtp : e_rtcp), m_reusePort(reusePort),
+  m_queued(NULL), m_flushing(NULL), m_sending(false), m_sendCalls(0), m_sendDatagrams(0)
 {
+    CreateSendBatches();
 }
 
 H46019MultiplexSocket::~H46019MultiplexSocket()
@@ -991,6 +1374,25 @@ H46019MultiplexSocket::~H46019MultiplexSocket()
 
     if (m_subSocket)
         delete m_subSocket;
+
+    delete m_queued;
+    delete m_flushing;
+}
+
+void H46019MultiplexSocket::CreateSendBatches()
+{
+    // Two batches, so datagrams can be queued while the other is being sent
+    if (RTP_DatagramBatch::IsAvailable()) {
+        m_queued = new RTP_DatagramBatch(H46019_MULTIPLEX_SEND_BATCH);
+        m_flushing = new RTP_DatagramBatch(H46019_MULTIPLEX_SEND_BATCH);
+    }
+}
+
+void H46019MultiplexSocket::GetSendCounts(PUInt64 & calls, PUInt64 & datagrams) const
+{
+    PWaitAndSignal m(m_mutex);
+    calls = m_sendCalls;
+    datagrams = m_sendDatagrams;
 }
 
 H46019MultiplexSocket::MuxType H46019MultiplexSocket::GetMultiplexType() const
@@ -1029,12 +1431,57 @@ PBoolean H46019MultiplexSocket::ReadFrom(void *buf, PINDEX len, Address & addr,
 
 PBoolean H46019MultiplexSocket::WriteTo(const void *buf, PINDEX len, const Address & addr, WORD pt)
 {
-    PWaitAndSignal m(m_mutex);
+    // NAT sub sockets may wrap their writes, so they are sent one by one
+    if (m_subSocket || !m_queued) {
+        PWaitAndSignal m(m_mutex);
+        m_sendCalls++;
+        m_sendDatagrams++;
+        if (m_subSocket)
+            return m_subSocket->WriteTo(buf,len,addr,pt);
+        else
+            return PUDPSocket::WriteTo(buf,len,addr,pt);
+    }
 
-    if (m_subSocket)
-        return m_subSocket->WriteTo(buf,len,addr,pt);
-    else
+    m_queueMutex.Wait();
+
+    if (!m_queued->Queue(buf,len,addr,pt)) {
+        // Too large, or more queued than one call takes, so send it now
+        m_queueMutex.Signal();
+        PWaitAndSignal m(m_mutex);
+        m_sendCalls++;
+        m_sendDatagrams++;
         return PUDPSocket::WriteTo(buf,len,addr,pt);
+    }
+
+    // The thread already sending takes this datagram with the next batch
+    if (m_sending) {
+        m_queueMutex.Signal();
+        return true;
+    }
+
+    m_sending = true;
+    PBoolean ok = true;
+    while (m_queued->GetQueued() > 0) {
+        RTP_DatagramBatch * batch = m_queued;
+        m_queued = m_flushing;
+        m_flushing = batch;
+        m_queueMutex.Signal();
+
+        m_mutex.Wait();
+        m_sendCalls++;
+        m_sendDatagrams += batch->GetQueued();
+        if (!batch->Flush(*this)) {
+            PTRACE(2, "H46019M\tMultiplex send failed: " << GetErrorText(LastWriteError));
+            ok = false;
+        }
+        m_mutex.Signal();
+
+        m_queueMutex.Wait();
+    }
+    m_sending = false;
+    m_queueMutex.Signal();
+
+    return ok;
 }
 
 PBoolean H46019MultiplexSocket::Close()
@@ -1044,21 +1491,207 @@ PBoolean H46019MultiplexSocket::Close()
 
     return H323UDPSocket::Close();
 }
+
+PBoolean H46019MultiplexSocket::OpenSocket(int ipAdressFamily)
+{
+    if (!PUDPSocket::OpenSocket(ipAdressFamily))
+        return false;
+
+#ifdef SO_REUSEPORT
+    // Must be set before the bind for every socket sharing the port
+    if (m_reusePort && !SetOption(SO_REUSEPORT, 1)) {
+        PTRACE(2, "H46019M\tCould not set SO_REUSEPORT: " << GetErrorText());
+        return false;
+    }
+#endif
+    return true;
+}
 #endif
 
 /////////////////////////////////////////////////////////////////////////////////////////////
 
+class H46019KeepAlive::Thread : public PThread
+{
+    PCLASSINFO(Thread, PThread);
+  public:
+    Thread(H46019KeepAlive & service)
+      : PThread(10000, NoAutoDeleteThread, NormalPriority, "H46019 KeepAlive"),
+        m_service(service)
+    {
+        Resume();
+    }
+
+    void Main()
+    {
+        m_service.Main();
+    }
+
+  protected:
+    H46019KeepAlive & m_service;
+};
+
+H46019KeepAlive::H46019KeepAlive()
+: m_wheel(H46019_KEEPALIVE_SLOTS), m_tick(0), m_tickTime(0), m_generation(0),
+  m_pingCount(0), m_skipCount(0), m_shutdown(false)
+{
+    m_thread = new Thread(*this);
+    PTRACE(4, "H46019\tCreated keepalive service");
+}
+
+H46019KeepAlive::~H46019KeepAlive()
+{
+    m_mutex.Wait();
+    m_shutdown = true;
+    PTRACE_IF(2, !m_sockets.empty(), "H46019\tDeleting keepalive service with " << m_sockets.size() << " sockets");
+    m_mutex.Signal();
+
+    m_wakeUp.Signal();
+    m_thread->WaitForTermination();
+    delete m_thread;
+
+    PTRACE(4, "H46019\tDeleted keepalive service, " << m_pingCount << " pings sent " << m_skipCount << " skipped");
+}
+
+void H46019KeepAlive::AddSocket(H46019UDPSocket & socket, unsigned interval)
+{
+    PWaitAndSignal m(m_mutex);
+
+    if (m_sockets.find(&socket) != m_sockets.end())
+        return;
+
+    // The wheel stands still while empty, start it from now
+    PBoolean idle = m_sockets.empty();
+    if (idle)
+        m_tickTime = PTimer::Tick().GetMilliSeconds() + H46019_KEEPALIVE_INTERVAL;
+
+    Entry & entry = m_sockets[&socket];
+    entry.interval = interval > 0 ? interval : H46019_KEEPALIVE_TIME * 1000;
+    entry.initial = H46019_KEEPALIVE_COUNT;
+    Schedule(&socket, entry, 0);
+
+    PTRACE(5, "H46019\tAdded keepalive socket, " << m_sockets.size() << " sockets");
+
+    if (idle)
+        m_wakeUp.Signal();
+}
+
+void H46019KeepAlive::RemoveSocket(H46019UDPSocket & socket)
+{
+    PWaitAndSignal m(m_mutex);
+
+    // The slot entry is left to be discarded when the wheel reaches it
+    if (m_sockets.erase(&socket) == 0)
+        return;
+
+    PTRACE(5, "H46019\tRemoved keepalive socket, " << m_sockets.size() << " sockets");
+
+    // The thread may be sending a batch it took before the removal
+    PWaitAndSignal s(m_sendMutex);
+}
+
+void H46019KeepAlive::Schedule(H46019UDPSocket * socket, Entry & entry, unsigned delay)
+{
+    unsigned ticks = (delay + H46019_KEEPALIVE_INTERVAL - 1) / H46019_KEEPALIVE_INTERVAL;
+    if (ticks == 0)
+        ticks = 1;
+
+    entry.rounds = (ticks - 1) / H46019_KEEPALIVE_SLOTS;
+    entry.generation = ++m_generation;
+    m_wheel[(m_tick + ticks) % H46019_KEEPALIVE_SLOTS].push_back(Slot::value_type(socket, entry.generation));
+}
+
+void H46019KeepAlive::Tick()
+{
+    m_tick = (m_tick + 1) % H46019_KEEPALIVE_SLOTS;
+    m_tickTime += H46019_KEEPALIVE_INTERVAL;
+
+    // Entries rescheduled a whole turn ahead go back into this slot, so work on a copy
+    m_current.clear();
+    m_current.swap(m_wheel[m_tick]);
+
+    for (Slot::iterator it = m_current.begin(); it != m_current.end(); ++it) {
+        SocketMap::iterator s = m_sockets.find(it->first);
+        if (s == m_sockets.end() || s->second.generation != it->second)
+            continue;  // Removed, or rescheduled since
+
+        Entry & entry = s->second;
+        if (entry.rounds > 0) {
+            entry.rounds--;
+            m_wheel[m_tick].push_back(*it);
+            continue;
+        }
+
+        PBoolean initial = entry.initial > 0;
+        if (initial)
+            entry.initial--;
+        m_dueBatch.push_back(Batch::value_type(it->first, initial));
+        Schedule(it->first, entry, entry.initial > 0 ? H46019_KEEPALIVE_INTERVAL : entry.interval);
+    }
+}
+
+void H46019KeepAlive::Main()
+{
+    PTRACE(4, "H46019\tKeepalive thread started");
+
+    for (;;) {
+        PInt64 now = PTimer::Tick().GetMilliSeconds();
+        PInt64 next = -1;
+
+        m_mutex.Wait();
+
+        if (m_shutdown) {
+            m_mutex.Signal();
+            break;
+        }
+
+        // Too far behind to catch up slot by slot, lose the time rather than ping in a burst
+        if (now - m_tickTime > H46019_KEEPALIVE_SLOTS * H46019_KEEPALIVE_INTERVAL)
+            m_tickTime = now;
+
+        m_dueBatch.clear();
+        if (!m_sockets.empty()) {
+            while (m_tickTime <= now)
+                Tick();
+            next = m_tickTime;
+        }
+
+        // Taken before the wheel is released so RemoveSocket() waits for this batch
+        m_sendMutex.Wait();
+        m_mutex.Signal();
+
+        for (Batch::iterator it = m_dueBatch.begin(); it != m_dueBatch.end(); ++it) {
+            if (it->first->OnKeepAlive(it->second))
+                m_pingCount++;
+            else
+                m_skipCount++;
+        }
+
+        m_sendMutex.Signal();
+
+        PTRACE_IF(6, !m_dueBatch.empty(), "H46019\tKeepalive batch of " << m_dueBatch.size() << " sockets");
+
+        if (next < 0)
+            m_wakeUp.Wait();
+        else if (next > now)
+            m_wakeUp.Wait(PTimeInterval(next - now));
+    }
+
+    PTRACE(4, "H46019\tKeepalive thread ended");
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+
 H46019UDPSocket::H46019UDPSocket(H46018Handler & _handler, H323Connection::SessionInformation * info, bool _rtpSocket)
 : m_Handler(_handler), m_Session(info->GetSessionID()), m_Token(info->GetCallToken()),
   m_CallId(info->GetCallIdentifer()), m_CUI(info->GetCUI()),
-  keepport(0), keeppayload(0), keepTTL(0), keepseqno(0), keepStartTime(NULL), initialKeep(NULL),
+  keepport(0), keeppayload(0), keepTTL(0), keepseqno(0), keepStartTime(NULL), keepActive(false), keepMedia(false),
 #ifdef H323_H46019M
   m_recvMultiplexID(info->GetRecvMultiplexID()), m_sendMultiplexID(0), m_multiBuffer(0), m_shutDown(false),
 #endif
 #if defined(H323_H46024A) || defined(H323_H46024B)
   m_CUIrem(PString()), m_locAddr(PIPSocket::GetDefaultIpAny()),  m_locPort(0),
   m_remAddr(PIPSocket::GetDefaultIpAny()),  m_remPort(0), m_detAddr(PIPSocket::GetDefaultIpAny()),  m_detPort(0),
-  m_pendAddr(PIPSocket::GetDefaultIpAny()), m_pendPort(0), m_probes(0), SSRC(PRandom::Number()),
+  m_pendAddr(PIPSocket::GetDefaultIpAny()), m_pendPort(0), m_nextCandidate(0), SSRC(PRandom::Number()),
 #endif
   m_altAddr(PIPSocket::GetDefaultIpAny()), m_altPort(0), m_altMuxID(0),
 #ifdef H323_H46024A
@@ -1075,7 +1708,7 @@ H46019UDPSocket::H46019UDPSocket(H46018Handler & _handler, H323Connection::Sessi
 H46019UDPSocket::~H46019UDPSocket()
 {
     Close();
-    Keep.Stop();
+    StopKeepAlive();
     delete keepStartTime;
 
 #ifdef H323_H46019M
@@ -1085,8 +1718,8 @@ H46019UDPSocket::~H46019UDPSocket()
     }
 #endif
 
-#ifdef H323_H46024A
-    m_Probe.Stop();
+#if defined(H323_H46024A) || defined(H323_H46024B)
+    m_Probe.Stop(TRUE);
 #endif
 }
 
@@ -1131,24 +1764,24 @@ void H46019UDPSocket::InitialiseKeepAlive()
 {
     PWaitAndSignal m(PingMutex);
 
-    if (Keep.IsRunning()) {
+    if (keepActive) {
         PTRACE(6, "H46019UDP\t" << (rtpSocket ? "RTP" : "RTCP") << " ping already running.");
         return;
     }
 
     if (keepTTL > 0 && keepip.IsValid() && !keepip.IsLoopback() && !keepip.IsAny()) {
         keepseqno = 100;  // Some arbitrary number
-        keepStartTime = new PTime();
+        if (keepStartTime == NULL)
+            keepStartTime = new PTime();
 
         PTRACE(4, "H46019UDP\tStart " << (rtpSocket ? "RTP" : "RTCP") << " pinging "
                         << keepip << ":" << keepport << " every " << keepTTL << " secs.");
 
-        Keep.SetNotifier(PCREATE_NOTIFIER(Ping));
-        Keep.RunContinuous(keepTTL * 1000);   // This will fire at keepTTL sec time.
-
-        //  To start before keepTTL interval do a number of special probes to ensure the gatekeeper
-        //  is reached to allow media to flow properly.
-        initialKeep = PThread::Create(PCREATE_NOTIFIER(StartKeepAlives), 0, PThread::AutoDeleteThread, PThread::NormalPriority, "Initial KeepAlive Thread");
+        //  The service starts with a number of special probes to ensure the gatekeeper
+        //  is reached to allow media to flow properly, then pings every keepTTL secs.
+        keepMedia = false;
+        keepActive = true;
+        m_Handler.GetKeepAlive().AddSocket(*this, keepTTL * 1000);
 
     } else {
         PTRACE(2, "H46019UDP\t"  << (rtpSocket ? "RTP" : "RTCP") << " PING NOT Ready "
@@ -1156,21 +1789,30 @@ void H46019UDPSocket::InitialiseKeepAlive()
     }
 }
 
-void H46019UDPSocket::StartKeepAlives(PThread &,  H323_INT)
+void H46019UDPSocket::StopKeepAlive()
 {
-    // Send a number of keep alive probes to ensure at least one reaches the gatekeeper.
-    // This thread MUST terminate prior to Ping timer firing at keepTTL (default 19 sec).
-    PINDEX i=0;
-    while (i<H46019_KEEPALIVE_COUNT && Keep.IsRunning()) {
-        if (i>0) PThread::Sleep(H46019_KEEPALIVE_INTERVAL);
-        rtpSocket ? SendRTPPing(keepip, keepport) : SendRTCPPing();
-        i++;
-    }
+    if (!keepActive)  // Called on every packet from the keepalive address while waiting
+        return;
+
+    PWaitAndSignal m(PingMutex);
+
+    if (!keepActive)
+        return;
+
+    keepActive = false;
+    m_Handler.GetKeepAlive().RemoveSocket(*this);
 }
 
-void H46019UDPSocket::Ping(PTimer &,  H323_INT)
+PBoolean H46019UDPSocket::OnKeepAlive(bool initial)
 {
+    // Media to the keepalive address holds the pinhole open as well as a ping would
+    PBoolean skip = !initial && keepMedia;
+    keepMedia = false;
+    if (skip)
+        return false;
+
     rtpSocket ? SendRTPPing(keepip, keepport) : SendRTCPPing();
+    return true;
 }
 
 void H46019UDPSocket::SendRTPPing(const PIPSocket::Address & ip, const WORD & port, unsigned id)
@@ -1329,12 +1971,12 @@ PBoolean H46019UDPSocket::WriteMultiplexBuffer(const void * buf, PINDEX len, con
 {
     if (rtpSocket && len == 12) {  /// Filter out RTP keepAlive Packets
 #ifdef H323_H46024B
-        if (m_h46024b && addr == m_altAddr /*&& port == m_altPort*/) {
+        if (m_h46024b && PromoteCandidate(addr, port, true, true)) {
             PTRACE(4, "H46024B\ts:" << m_Session << (rtpSocket ? " RTP " : " RTCP ")
                 << "Switching to " << addr << ":" << port << " from " << m_remAddr << ":" << m_remPort);
             m_detAddr = addr;  m_detPort = port;
             SetProbeState(e_direct);
-            Keep.Stop();  // Stop the keepAlive Packets
+            StopKeepAlive();  // Stop the keepAlive Packets
             m_h46024b = false;
         }
 #endif
@@ -1344,10 +1986,15 @@ PBoolean H46019UDPSocket::WriteMultiplexBuffer(const void * buf, PINDEX len, con
     H46019MultiPacket packet;
         packet.fromAddr = addr;
         packet.fromPort = port;
-        packet.frame.SetSize(len);
-        memcpy(packet.frame.GetPointer(), buf, len);
+        packet.length = len;
 
     m_multiMutex.Wait();
+      if (!m_multSpares.empty()) {
+        packet.frame = m_multSpares.back();
+        m_multSpares.pop_back();
+      }
+      packet.frame.SetMinSize(len);
+      memcpy(packet.frame.GetPointer(), buf, len);
       m_multQueue.push(packet);
     m_multiMutex.Signal();
     m_multiBuffer++;
@@ -1377,9 +2024,11 @@ PBoolean H46019UDPSocket::ReadMultiplexBuffer(void * buf, PINDEX & len, Address
 
     addr = packet.fromAddr;
     port = packet.fromPort;
-    len = packet.frame.GetSize();
-    memcpy(buf, packet.frame.GetPointer(), len);
+    len = packet.length;
+    memcpy(buf, (const BYTE *)packet.frame, len);
 
+    if (m_multSpares.size() < H46019_MULTIPLEX_SPARES)
+      m_multSpares.push_back(packet.frame);
     m_multQueue.pop();
     m_multiMutex.Signal();
 
@@ -1520,6 +2169,10 @@ void H46019UDPSocket::SetAlternateAddresses(const H323TransportAddress & address
 
     if (!rtpSocket) {
         m_CUIrem = cui;
+        AddCandidate(m_altAddr, m_altPort, m_altMuxID, false);
+        // A probe that came before the CUI shows a path the remote can already reach us on
+        if (!m_pendAddr.IsAny())
+            AddCandidate(m_pendAddr, m_pendPort, m_altMuxID, false);
         if (GetProbeState() < e_idle) {
             SetProbeState(e_idle);
             StartProbe();
@@ -1563,9 +2216,7 @@ void H46019UDPSocket::StartProbe()
     PTRACE(4, "H46024A\ts: " << m_Session << " Starting direct connection probe.");
 
     SetProbeState(e_probing);
-    m_probes = 0;
-    m_Probe.SetNotifier(PCREATE_NOTIFIER(Probe));
-    m_Probe.RunContinuous(H46024A_PROBE_INTERVAL);
+    StartChecks();
 }
 
 void H46019UDPSocket::BuildProbe(RTP_ControlFrame & report, bool probing)
@@ -1589,43 +2240,11 @@ void H46019UDPSocket::BuildProbe(RTP_ControlFrame & report, bool probing)
     memcpy(report.GetPayloadPtr(), &data, sizeof(probe_packet));
 }
 
-void H46019UDPSocket::Probe(PTimer &,  H323_INT)
-{
-    m_probes++;
-
-    if (m_probes > H46024A_MAX_PROBE_COUNT) {
-        m_Probe.Stop();
-        return;
-    }
-
-    if (GetProbeState() != e_probing)
-        return;
-
-    RTP_ControlFrame report;
-    report.SetSize(4 + sizeof(probe_packet));
-    BuildProbe(report, true);
-
-     if (!WriteTo(report.GetPointer(),report.GetSize(), m_altAddr, m_altPort, m_altMuxID)) {
-        switch (GetErrorNumber()) {
-            case ECONNRESET :
-            case ECONNREFUSED :
-                PTRACE(2, "H46024A\t" << m_altAddr << ":" << m_altPort << " not ready.");
-                break;
-
-            default:
-                PTRACE(1, "H46024A\t" << m_altAddr << ":" << m_altPort
-                    << ", Write error on port ("
-                    << GetErrorNumber(PChannel::LastWriteError) << "): "
-                    << GetErrorText(PChannel::LastWriteError));
-        }
-    } else {
-        PTRACE(6, "H46024A\ts" << m_Session <<" RTCP Probe sent: " << m_altAddr << ":" << m_altPort);
-    }
-}
-
 void H46019UDPSocket::ProbeReceived(bool probe, const PIPSocket::Address & addr, WORD & port)
 {
     if (probe) {
+        if (!PromoteCandidate(addr, port, false))  //< The first path to answer is the one used
+            DropCandidates(false);
         m_Handler.H46024ADirect(true, m_Token);  //< Tell remote to wait for connection
     } else if (addr.IsValid() && !addr.IsLoopback() && !addr.IsAny()) {
         RTP_ControlFrame reply;
@@ -1653,7 +2272,149 @@ void H46019UDPSocket::H46024Adirect(bool starter)
     } else         // We wait for the remote to start channel
         SetProbeState(e_wait);
 
-    Keep.Stop();  // Stop the keepAlive Packets
+    StopKeepAlive();  // Stop the keepAlive Packets
+}
+#endif
+
+#if defined(H323_H46024A) || defined(H323_H46024B)
+void H46019UDPSocket::AddCandidate(const Address & addr, WORD port, unsigned muxID, bool annexB)
+{
+    if (!addr.IsValid() || addr.IsAny() || port == 0)
+        return;
+
+    PWaitAndSignal m(candidateMutex);
+
+    for (probe_candidates::const_iterator it = m_candidates.begin(); it != m_candidates.end(); ++it) {
+        if (it->annexB == annexB && it->addr == addr && it->port == port)
+            return;
+    }
+
+    probe_candidate candidate;
+    candidate.addr = addr;
+    candidate.port = port;
+    candidate.muxID = muxID;
+    candidate.annexB = annexB;
+    candidate.sent = 0;
+    candidate.lastSent = 0;
+    m_candidates.push_back(candidate);
+
+    PTRACE(4, "H46024\ts:" << m_Session << (rtpSocket ? " RTP " : " RTCP ") << "Candidate " << addr << ":" << port
+                << (annexB ? " Annex B" : " Annex A") << ", " << m_candidates.size() << " candidates");
+}
+
+PBoolean H46019UDPSocket::PromoteCandidate(const Address & addr, WORD port, bool annexB, bool anyPort)
+{
+    PWaitAndSignal m(candidateMutex);
+
+    for (probe_candidates::const_iterator it = m_candidates.begin(); it != m_candidates.end(); ++it) {
+        if (it->annexB == annexB && it->addr == addr && (anyPort || it->port == port)) {
+            m_altAddr = it->addr;
+            m_altPort = it->port;
+            m_altMuxID = it->muxID;
+            PTRACE(4, "H46024\ts:" << m_Session << (rtpSocket ? " RTP " : " RTCP ") << "Candidate " << addr << ":" << port
+                        << " answered, after " << it->sent << " checks");
+            DropCandidates(annexB);
+            return true;
+        }
+    }
+    return false;
+}
+
+void H46019UDPSocket::DropCandidates(bool annexB)
+{
+    PWaitAndSignal m(candidateMutex);
+
+    probe_candidates::iterator it = m_candidates.begin();
+    while (it != m_candidates.end()) {
+        if (it->annexB == annexB)
+            it = m_candidates.erase(it);
+        else
+            ++it;
+    }
+    m_nextCandidate = 0;
+}
+
+void H46019UDPSocket::StartChecks()
+{
+    PWaitAndSignal m(candidateMutex);
+
+    if (m_Probe.IsRunning())
+        return;
+
+    m_Probe.SetNotifier(PCREATE_NOTIFIER(Probe));
+    m_Probe.RunContinuous(H46024_CHECK_PACE);
+}
+
+void H46019UDPSocket::Probe(H323Timer &,  H323_INT)
+{
+    PWaitAndSignal m(candidateMutex);
+
+    // One check each tick, to the next candidate in turn that is due, so that
+    // all candidates are checked together without a burst of packets
+    PInt64 now = PTimer::Tick().GetMilliSeconds();
+    PINDEX count = m_candidates.size();
+    PBoolean pending = false;
+    for (PINDEX i = 0; i < count; ++i) {
+        PINDEX index = (m_nextCandidate + i) % count;
+        probe_candidate & candidate = m_candidates[index];
+        PINDEX maxChecks = candidate.annexB ? H46024B_CHECK_COUNT : H46024A_MAX_PROBE_COUNT;
+        PInt64 interval = candidate.annexB ? H46024_CHECK_PACE : H46024A_PROBE_INTERVAL;
+        if (candidate.sent >= maxChecks)
+            continue;
+
+        pending = true;
+        if (candidate.sent > 0 && now - candidate.lastSent < interval)
+            continue;
+
+        candidate.sent++;
+        candidate.lastSent = now;
+        m_nextCandidate = (index + 1) % count;
+        SendCheck(candidate);
+        return;
+    }
+
+    if (!pending) {
+        PTRACE(4, "H46024\ts:" << m_Session << (rtpSocket ? " RTP " : " RTCP ") << "Checks of " << count << " candidates finished");
+        m_Probe.Stop();
+    }
+}
+
+void H46019UDPSocket::SendCheck(const probe_candidate & candidate)
+{
+#ifdef H323_H46024B
+    if (candidate.annexB) {
+        // An empty RTP frame to the alternate address adds a mapping
+        // to the router to receive RTP from the remote
+        SendRTPPing(candidate.addr, candidate.port, candidate.muxID);
+        return;
+    }
+#endif
+
+#ifdef H323_H46024A
+    if (candidate.annexB || GetProbeState() != e_probing)
+        return;
+
+    RTP_ControlFrame report;
+    report.SetSize(4 + sizeof(probe_packet));
+    BuildProbe(report, true);
+
+    if (!WriteTo(report.GetPointer(),report.GetSize(), candidate.addr, candidate.port, candidate.muxID)) {
+        switch (GetErrorNumber()) {
+            case ECONNRESET :
+            case ECONNREFUSED :
+                PTRACE(2, "H46024A\t" << candidate.addr << ":" << candidate.port << " not ready.");
+                break;
+
+            default:
+                PTRACE(1, "H46024A\t" << candidate.addr << ":" << candidate.port
+                    << ", Write error on port ("
+                    << GetErrorNumber(PChannel::LastWriteError) << "): "
+                    << GetErrorText(PChannel::LastWriteError));
+        }
+    } else {
+        PTRACE(6, "H46024A\ts" << m_Session <<" RTCP Probe sent: " << candidate.addr << ":" << candidate.port);
+    }
+#endif
 }
 #endif
 
@@ -1673,13 +2434,13 @@ PBoolean H46019UDPSocket::ReadFrom(void * buf, PINDEX len, Address & addr, WORD
             m_remPort = port;
         }
 #if H323_H46024B
-        if (m_h46024b && addr == m_altAddr && port == m_altPort) {
+        if (m_h46024b && PromoteCandidate(addr, port, true)) {
             PTRACE(4, "H46024B\ts:" << m_Session << (rtpSocket ? " RTP " : " RTCP ")
                 << "Switching to " << addr << ":" << port << " from " << m_remAddr << ":" << m_remPort);
             m_detAddr = addr;
             m_detPort = port;
             SetProbeState(e_direct);
-            Keep.Stop();  // Stop the keepAlive Packets
+            StopKeepAlive();  // Stop the keepAlive Packets
             m_h46024b = false;
         }
 #endif
@@ -1703,7 +2464,7 @@ PBoolean H46019UDPSocket::ReadFrom(void * buf, PINDEX len, Address & addr, WORD
                 break;
             case e_wait:
                 if (addr == keepip) {// We got a keepalive ping...
-                     Keep.Stop();  // Stop the keepAlive Packets
+                     StopKeepAlive();  // Stop the keepAlive Packets
                 } else if ((addr == m_altAddr) && (port == m_altPort)) {
                     PTRACE(4, "H46024A\ts:" << m_Session << (rtpSocket ? " RTP " : " RTCP ")  << "Already sending direct!");
                     m_detAddr = addr;  m_detPort = port;
@@ -1732,6 +2493,9 @@ PBoolean H46019UDPSocket::ReadFrom(void * buf, PINDEX len, Address & addr, WORD
 
 PBoolean H46019UDPSocket::WriteTo(const void * buf, PINDEX len, const Address & addr, WORD port)
 {
+    if (keepActive && port == keepport && addr == keepip)
+        keepMedia = true;
+
     return WriteTo(buf, len, addr, port, 0);
 }
 
@@ -1801,7 +2565,8 @@ PBoolean H46019UDPSocket::ReceivedProbePacket(const RTP_ControlFrame & frame, bo
     else
         SetProbeState(e_verify_receiver);
 
-    m_Probe.Stop();
+    if (!probe)  // A reply promotes the candidate it came from in ProbeReceived()
+        DropCandidates(false);
     success = true;
 
     return true;
@@ -1814,21 +2579,17 @@ void H46019UDPSocket::H46024Bdirect(const H323TransportAddress & address, unsign
     if (GetProbeState() == e_direct)  // We might already be doing annex A
         return;
 
-    address.GetIpAndPort(m_altAddr, m_altPort);
-    m_altMuxID = muxID;
+    PIPSocket::Address addr;  WORD port = 0;
+    address.GetIpAndPort(addr, port);
 
-    PTRACE(6, " H46024b\ts: " << m_Session << " RTP Remote Alt: " << m_altAddr << ":" << m_altPort
-                            << " " << m_altMuxID);
+    PTRACE(6, " H46024b\ts: " << m_Session << " RTP Remote Alt: " << addr << ":" << port
+                            << " " << muxID);
 
     m_h46024b = true;
 
-    // Sending an empty RTP frame to the alternate address
-    // will add a mapping to the router to receive RTP from
-    // the remote
-   for (PINDEX i = 0; i < 3; i++) {
-       SendRTPPing(m_altAddr, m_altPort, m_altMuxID);
-       PThread::Sleep(10);
-   }
+    // Pinged alongside any other candidates, the first to send media back is used
+    AddCandidate(addr, port, muxID, true);
+    StartChecks();
 }
 
 #endif  // H323_H46024B
@@ -0,0 +1,365 @@
+/*
+ * h46019relay.cxx
+ *
+ * H.460.19 multiplexed media relay
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "h46019relay.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#ifdef H323_H46018
+
+#include "h460/h46019relay.h"
+#include "h323mediaclock.h"
+#include "rtpbatch.h"
+
+#include <ptclib/random.h>
+
+#define new PNEW
+
+#define H46019_RELAY_BATCH      32          // Datagrams per system call
+#define H46019_RELAY_BUFFER     2048        // Largest datagram relayed
+#define H46019_RELAY_RELATCH    30000000    // Microseconds of silence before a new source is taken
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H46019MediaRelay::Leg::Leg()
+  : peer(0),
+    remoteId(0)
+{
+  for (PINDEX i = 0; i < 2; i++) {
+    port[i] = 0;
+    lastSeen[i] = 0;
+    established[i] = FALSE;
+  }
+}
+
+
+H46019MediaRelay::H46019MediaRelay()
+  : port(0),
+    shutdown(FALSE),
+    nextId(PRandom::Number() | 1),
+    forwarded(0),
+    keepAlives(0),
+    dropped(0)
+{
+  sockets[0] = sockets[1] = NULL;
+  threads[0] = threads[1] = NULL;
+}
+
+
+H46019MediaRelay::~H46019MediaRelay()
+{
+  Close();
+}
+
+
+PBoolean H46019MediaRelay::Open(const PIPSocket::Address & iface, WORD rtpPort)
+{
+  Close();
+
+  if (rtpPort == 0 || rtpPort == 65535) {
+    PTRACE(1, "H46019R\tInvalid relay port " << rtpPort);
+    return FALSE;
+  }
+
+  for (PINDEX i = 0; i < 2; i++) {
+    sockets[i] = new PUDPSocket;
+    if (!sockets[i]->Listen(iface, 0, (WORD)(rtpPort+i), PSocket::CanReuseAddress)) {
+      PTRACE(1, "H46019R\tCould not listen on " << iface << ':' << rtpPort+i
+             << ": " << sockets[i]->GetErrorText());
+      Close();
+      return FALSE;
+    }
+    // The timeout only lets a batch waiting to be sent go out when idle
+    sockets[i]->SetReadTimeout(1000);
+  }
+
+  port = rtpPort;
+  shutdown = FALSE;
+
+  for (PINDEX i = 0; i < 2; i++)
+    threads[i] = PThread::Create(PCREATE_NOTIFIER(ReadThread), i,
+                                 PThread::NoAutoDeleteThread,
+                                 PThread::HighestPriority,
+                                 i == 0 ? "H46019R RTP" : "H46019R RTCP");
+
+  PTRACE(3, "H46019R\tRelaying multiplexed media on " << iface << ':' << port);
+  return TRUE;
+}
+
+
+void H46019MediaRelay::Close()
+{
+  shutdown = TRUE;
+
+  for (PINDEX i = 0; i < 2; i++) {
+    if (sockets[i] != NULL)
+      sockets[i]->Close();
+  }
+
+  for (PINDEX i = 0; i < 2; i++) {
+    if (threads[i] != NULL) {
+      PAssert(threads[i]->WaitForTermination(10000), "Media relay thread did not terminate");
+      delete threads[i];
+      threads[i] = NULL;
+    }
+    delete sockets[i];
+    sockets[i] = NULL;
+  }
+
+  port = 0;
+
+  PWaitAndSignal m(mutex);
+  legs.clear();
+}
+
+
+unsigned H46019MediaRelay::NextLocalId()
+{
+  // Zero is not a valid multiplexID
+  while (nextId == 0 || legs.find(nextId) != legs.end())
+    nextId++;
+  return nextId++;
+}
+
+
+PBoolean H46019MediaRelay::AddChannel(unsigned remoteIdA, unsigned remoteIdB,
+                                      unsigned & localIdA, unsigned & localIdB)
+{
+  PWaitAndSignal m(mutex);
+
+  localIdA = NextLocalId();
+  Leg & legA = legs[localIdA];
+  localIdB = NextLocalId();
+  Leg & legB = legs[localIdB];
+
+  legA.peer = localIdB;
+  legA.remoteId = remoteIdA;
+  legB.peer = localIdA;
+  legB.remoteId = remoteIdB;
+
+  PTRACE(4, "H46019R\tAdded channel " << localIdA << '/' << remoteIdA
+         << " <-> " << localIdB << '/' << remoteIdB);
+  return TRUE;
+}
+
+
+void H46019MediaRelay::RemoveChannel(unsigned localId)
+{
+  PBoolean ended[2][2] = { { FALSE, FALSE }, { FALSE, FALSE } };
+  unsigned ids[2] = { localId, 0 };
+
+  {
+    PWaitAndSignal m(mutex);
+
+    std::map<unsigned, Leg>::iterator it = legs.find(localId);
+    if (it == legs.end())
+      return;
+
+    ids[1] = it->second.peer;
+    for (PINDEX i = 0; i < 2; i++) {
+      ended[0][i] = it->second.established[i];
+      std::map<unsigned, Leg>::iterator peer = legs.find(ids[1]);
+      if (peer != legs.end())
+        ended[1][i] = peer->second.established[i];
+    }
+
+    legs.erase(ids[1]);
+    legs.erase(it);
+  }
+
+  PTRACE(4, "H46019R\tRemoved channel " << ids[0] << " <-> " << ids[1]);
+
+  for (PINDEX leg = 0; leg < 2; leg++) {
+    for (PINDEX i = 0; i < 2; i++) {
+      if (ended[leg][i])
+        OnFlowEnded(i > 0, ids[leg]);
+    }
+  }
+}
+
+
+PINDEX H46019MediaRelay::GetChannelCount() const
+{
+  PWaitAndSignal m(mutex);
+  return legs.size()/2;
+}
+
+
+void H46019MediaRelay::OnFlowEstablished(PBoolean, unsigned,
+                                         const PIPSocket::Address &, WORD,
+                                         const PIPSocket::Address &, WORD,
+                                         unsigned)
+{
+}
+
+
+void H46019MediaRelay::OnFlowEnded(PBoolean, unsigned)
+{
+}
+
+
+PBoolean H46019MediaRelay::Forward(PINDEX index, BYTE * buffer, PINDEX len,
+                                   const PIPSocket::Address & addr, WORD fromPort,
+                                   PIPSocket::Address & toAddr, WORD & toPort)
+{
+  // multiplexID then at least the fixed RTP header or an RTCP header
+  if (len < (index == 0 ? 16 : 12)) {
+    H323_ATOMIC_ADD64(&dropped, 1);
+    return FALSE;
+  }
+
+  unsigned localId = (buffer[0] << 24) | (buffer[1] << 16) | (buffer[2] << 8) | buffer[3];
+  PInt64 now = H323MediaClock::GetMicroseconds();
+
+  PBoolean keepAlive = FALSE;
+  if (index == 0) {
+    // An RTP keep-alive has no payload
+    const BYTE * rtp = buffer + 4;
+    PINDEX header = 12 + 4*(rtp[0] & 0x0f);
+    if ((rtp[0] & 0x10) != 0 && len >= 4+header+4)
+      header += 4 + 4*((rtp[header+2] << 8) | rtp[header+3]);
+    keepAlive = len <= 4+header;
+  }
+
+  unsigned toId;
+  PIPSocket::Address establishedFrom;
+  WORD establishedPort = 0;
+
+  {
+    PWaitAndSignal m(mutex);
+
+    std::map<unsigned, Leg>::iterator it = legs.find(localId);
+    if (it == legs.end()) {
+      H323_ATOMIC_ADD64(&dropped, 1);
+      return FALSE;
+    }
+
+    Leg & leg = it->second;
+    if (leg.port[index] != fromPort || leg.addr[index] != addr) {
+      // Only take a new source once the one before has gone quiet
+      if (leg.port[index] != 0 && now - leg.lastSeen[index] < H46019_RELAY_RELATCH) {
+        H323_ATOMIC_ADD64(&dropped, 1);
+        return FALSE;
+      }
+
+      PTRACE(4, "H46019R\t" << (index == 0 ? "RTP" : "RTCP") << " of " << localId
+             << " latched to " << addr << ':' << fromPort);
+      leg.addr[index] = addr;
+      leg.port[index] = fromPort;
+      leg.established[index] = FALSE;
+      std::map<unsigned, Leg>::iterator peer = legs.find(leg.peer);
+      if (peer != legs.end())
+        peer->second.established[index] = FALSE;
+    }
+    leg.lastSeen[index] = now;
+
+    if (keepAlive) {
+      H323_ATOMIC_ADD64(&keepAlives, 1);
+      return FALSE;
+    }
+
+    std::map<unsigned, Leg>::iterator peer = legs.find(leg.peer);
+    if (peer == legs.end() || peer->second.port[index] == 0) {
+      H323_ATOMIC_ADD64(&dropped, 1);
+      return FALSE;
+    }
+
+    toAddr = peer->second.addr[index];
+    toPort = peer->second.port[index];
+    toId = peer->second.remoteId;
+
+    if (!leg.established[index]) {
+      leg.established[index] = TRUE;
+      establishedFrom = addr;
+      establishedPort = fromPort;
+    }
+  }
+
+  buffer[0] = (BYTE)(toId >> 24);
+  buffer[1] = (BYTE)(toId >> 16);
+  buffer[2] = (BYTE)(toId >> 8);
+  buffer[3] = (BYTE)toId;
+
+  if (establishedPort != 0)
+    OnFlowEstablished(index > 0, localId, establishedFrom, establishedPort, toAddr, toPort, toId);
+
+  H323_ATOMIC_ADD64(&forwarded, 1);
+  return TRUE;
+}
+
+
+void H46019MediaRelay::ReadThread(PThread &, H323_INT index)
+{
+  PUDPSocket & socket = *sockets[index];
+
+  RTP_DatagramBatch readBatch(H46019_RELAY_BATCH, H46019_RELAY_BUFFER);
+  RTP_DatagramBatch sendBatch(H46019_RELAY_BATCH, H46019_RELAY_BUFFER);
+
+  BYTE buffer[H46019_RELAY_BUFFER];
+  PIPSocket::Address addr, toAddr;
+  WORD fromPort, toPort;
+  PINDEX len;
+
+  while (!shutdown) {
+    if (!readBatch.ReadFrom(socket, buffer, sizeof(buffer), addr, fromPort, len)) {
+      if (!socket.IsOpen())
+        break;
+      // Timeouts, and ICMP errors from an endpoint gone away
+      sendBatch.Flush(socket);
+      continue;
+    }
+
+    if (Forward(index, buffer, len, addr, fromPort, toAddr, toPort)) {
+      if (!sendBatch.Queue(buffer, len, toAddr, toPort)) {
+        sendBatch.Flush(socket);
+        socket.WriteTo(buffer, len, toAddr, toPort);
+      }
+    }
+
+    // Send when the next read would go to the socket
+    if ((!readBatch.HasPending() || sendBatch.IsFull()) && !sendBatch.Flush(socket)) {
+      PTRACE(4, "H46019R\tSend failed: " << socket.GetErrorText(PChannel::LastWriteError));
+    }
+  }
+
+  PTRACE(4, "H46019R\t" << (index == 0 ? "RTP" : "RTCP") << " relay thread ended");
+}
+
+
+#endif // H323_H46018
+
+
+/////////////////////////////////////////////////////////////////////////////
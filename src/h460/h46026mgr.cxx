@@ -50,6 +50,13 @@
 #define MAX_STACK_DESCRETION  REC_FRAME_TIME * 2
 #define FAST_UPDATE_INTERVAL  REC_FRAME_TIME * 3
 #define MAX_VIDEO_KBPS       384000.0
+#define MAX_BATCH_DELAY      10           // Pipe time one batched write may take (ms)
+#define MAX_AUDIO_DELAY      100          // Audio waiting this long means the pipe is blocked (ms)
+#define MAX_SOCKET_BACKLOG   50           // Pipe time the socket send buffer may hold (ms)
+#define MIN_PIPE_BPS         32000.0      // Floor of the estimated bandwidth
+#define FEEDBACK_INTERVAL    250          // Time over which the socket drain rate is measured (ms)
+#define FEEDBACK_GAIN        0.25         // Weight of a new drain rate in the estimate
+#define SCHEDULER_QUANTUM    512          // Bytes per round for each unit of weight
 
 
 #define PACKETDELAY(sz,mbps) \
@@ -266,6 +273,12 @@ H46026_MediaFrame::H46026_MediaFrame(const BYTE * data, PINDEX len)
 
 }
 
+H46026_MediaFrame::H46026_MediaFrame(const PBYTEArray & data)
+   : PBYTEArray(data)
+{
+
+}
+
 PBoolean H46026_MediaFrame::GetMarker() const
 {
     return (theArray[1]&0x80) != 0;
@@ -287,8 +300,136 @@ void H46026_MediaFrame::PrintInfo(ostream & strm) const
 
 //-------------------------------------------
 
+H46026SocketScheduler::H46026SocketScheduler()
+: m_count(0), m_active(0), m_credited(false)
+{
+    for (PINDEX i = 0; i < NumPriorities; ++i) {
+        m_weight[i] = 1;
+        m_deadline[i] = 0;
+        m_deficit[i] = 0;
+    }
+
+    SetWeight(socketOrder::Priority_Critical, 8);
+    SetWeight(socketOrder::Priority_Discretion, 4);
+    SetWeight(socketOrder::Priority_High, 4);
+    SetWeight(socketOrder::Priority_Low, 1);
+
+    // A video frame later than this is of no use to the far end
+    SetDeadline(socketOrder::Priority_Discretion, (unsigned)(MAX_STACK_DESCRETION));
+}
+
+int H46026SocketScheduler::Index(int priority)
+{
+    if (priority < socketOrder::Priority_Critical || priority > socketOrder::Priority_Low)
+        priority = socketOrder::Priority_High;
+    return priority - socketOrder::Priority_Critical;
+}
+
+void H46026SocketScheduler::SetWeight(int priority, unsigned weight)
+{
+    m_weight[Index(priority)] = weight > 0 ? weight : 1;
+}
+
+void H46026SocketScheduler::SetDeadline(int priority, unsigned ms)
+{
+    m_deadline[Index(priority)] = ms;
+}
+
+unsigned H46026SocketScheduler::GetDeadline(int priority) const
+{
+    return m_deadline[Index(priority)];
+}
+
+PINDEX H46026SocketScheduler::GetSize(int priority) const
+{
+    return m_queue[Index(priority)].size();
+}
+
+void H46026SocketScheduler::Push(const Message & msg)
+{
+    m_queue[Index(msg.second.priority)].push_back(msg);
+    m_count++;
+}
+
+int H46026SocketScheduler::Select()
+{
+    // Each queue in turn is credited its quantum and sends while the credit covers
+    // the next message. Unused credit carries to the next round unless the queue empties.
+    for (;;) {
+        std::deque<Message> & queue = m_queue[m_active];
+        if (!queue.empty()) {
+            if (!m_credited) {
+                m_deficit[m_active] += m_weight[m_active] * SCHEDULER_QUANTUM;
+                m_credited = true;
+            }
+            if (m_deficit[m_active] >= queue.front().first.GetSize())
+                return m_active;
+        } else
+            m_deficit[m_active] = 0;
+
+        m_active = (m_active + 1) % NumPriorities;
+        m_credited = false;
+    }
+}
+
+const H46026SocketScheduler::Message & H46026SocketScheduler::Front()
+{
+    return m_queue[Select()].front();
+}
+
+void H46026SocketScheduler::Pop()
+{
+    if (m_count == 0)
+        return;
+
+    int i = Select();
+    m_deficit[i] -= m_queue[i].front().first.GetSize();
+    m_queue[i].pop_front();
+    m_count--;
+    if (m_queue[i].empty())
+        m_deficit[i] = 0;
+}
+
+PInt64 H46026SocketScheduler::GetAge(int priority, PInt64 now) const
+{
+    const std::deque<Message> & queue = m_queue[Index(priority)];
+    return queue.empty() ? -1 : now - queue.front().second.packTime;
+}
+
+PINDEX H46026SocketScheduler::Drop(int priority, PInt64 now, PInt64 maxAge, std::vector<socketOrder::MessageHeader> & dropped)
+{
+    int i = Index(priority);
+    std::deque<Message> & queue = m_queue[i];
+
+    // Oldest first, so stop at the first still in time
+    PINDEX count = 0;
+    while (!queue.empty() && (maxAge < 0 || now - queue.front().second.packTime > maxAge)) {
+        dropped.push_back(queue.front().second);
+        queue.pop_front();
+        count++;
+    }
+
+    m_count -= count;
+    if (queue.empty())
+        m_deficit[i] = 0;
+    return count;
+}
+
+void H46026SocketScheduler::Clear()
+{
+    for (PINDEX i = 0; i < NumPriorities; ++i) {
+        m_queue[i].clear();
+        m_deficit[i] = 0;
+    }
+    m_count = 0;
+    m_credited = false;
+}
+
+//-------------------------------------------
+
 H46026ChannelManager::H46026ChannelManager()
-:  m_mbps(MAX_VIDEO_KBPS), m_socketPacketReady(false), m_currentPacketTime(0), m_pktCounter(0)
+:  m_mbps(MAX_VIDEO_KBPS), m_socketPacketReady(false), m_currentPacketTime(0), m_pktCounter(0),
+   m_feedbackTime(0), m_feedbackWritten(0), m_feedbackBacklog(0), m_feedbackCongested(false)
 {
 
     // Initialise the Information PDU RTP Message structure.
@@ -321,8 +462,7 @@ H46026ChannelManager::~H46026ChannelManager()
     PWaitAndSignal m(m_queueMutex);
 
     ClearBufferEntries(m_rtpBuffer, 0);
-    while (!m_socketQueue.empty())
-        m_socketQueue.pop();
+    m_socketQueue.Clear();
 }
 
  void H46026ChannelManager::RTPFrameIn(unsigned crv, PINDEX sessionId, PBoolean rtp, const PBYTEArray & data)
@@ -335,6 +475,23 @@ H46026ChannelManager::~H46026ChannelManager()
      m_mbps = double(bps);
  }
 
+ unsigned H46026ChannelManager::GetPipeBandwidth() const
+ {
+     return (unsigned)m_mbps;
+ }
+
+ void H46026ChannelManager::SetPriorityWeight(socketOrder::priority priority, unsigned weight)
+ {
+     PWaitAndSignal m(m_queueMutex);
+     m_socketQueue.SetWeight(priority, weight);
+ }
+
+ void H46026ChannelManager::SetPriorityDeadline(socketOrder::priority priority, unsigned ms)
+ {
+     PWaitAndSignal m(m_queueMutex);
+     m_socketQueue.SetDeadline(priority, ms);
+ }
+
 void H46026ChannelManager::BufferRelease(unsigned crv)
 {
     ClearBufferEntries(m_rtpBuffer, crv);
@@ -426,14 +583,23 @@ PBoolean H46026ChannelManager::PackageFrame(PBoolean rtp, unsigned crv, PacketTy
 
 PBoolean H46026ChannelManager::RTPFrameOut(unsigned crv, PacketTypes id, PINDEX sessionId, PBoolean rtp, PBYTEArray & data)
 {
-    return RTPFrameOut(crv, id, sessionId, rtp, data.GetPointer() , data.GetSize());
+    // The frame shares the callers buffer and the buffer is shared again
+    // when it is placed in the ASN, so the packet is never copied.
+    H46026_MediaFrame msg(data);
+    return MediaFrameOut(crv, id, sessionId, rtp, msg);
 }
 
 PBoolean H46026ChannelManager::RTPFrameOut(unsigned crv, PacketTypes id, PINDEX sessionId, PBoolean rtp, const BYTE * data, PINDEX len)
+{
+    H46026_MediaFrame msg(data, len);
+    return MediaFrameOut(crv, id, sessionId, rtp, msg);
+}
+
+PBoolean H46026ChannelManager::MediaFrameOut(unsigned crv, PacketTypes id, PINDEX sessionId, PBoolean rtp, const H46026_MediaFrame & msg)
 {
     PWaitAndSignal m(m_writeMutex);
 
-    H46026_MediaFrame msg(data, len);
+    PINDEX len = msg.GetSize();
     if (rtp) {
         H46026UDPBuffer * buffer = GetRTPBuffer(crv, sessionId);
         if (!buffer) return false;
@@ -476,30 +642,44 @@ PBoolean H46026ChannelManager::ProcessQueue()
 {
     PWaitAndSignal m(m_queueMutex);
 
-    if (m_socketQueue.size() == 0) {
+    if (m_socketQueue.IsEmpty()) {
         m_socketPacketReady = false;
         return true;
     }
 
     PInt64 nowTime = PTimer::Tick().GetMilliSeconds();
-    PInt64 stackTime = nowTime - m_socketQueue.top().second.packTime;
+    m_dropped.clear();
 
-    PBoolean dropPacket = ((m_socketQueue.top().second.priority == socketOrder::Priority_Discretion) &&
-            (stackTime > MAX_STACK_DESCRETION));
+    // Messages past their deadline would only arrive late
+    for (int p = socketOrder::Priority_Critical; p <= socketOrder::Priority_Low; ++p) {
+        unsigned deadline = m_socketQueue.GetDeadline(p);
+        if (deadline > 0)
+            m_socketQueue.Drop(p, nowTime, deadline, m_dropped);
+    }
 
-    if (dropPacket) {
+    // Audio held up means the pipe is blocked, give it the bandwidth queued video would use
+    PInt64 audioTime = m_socketQueue.GetAge(socketOrder::Priority_Critical, nowTime);
+    if (audioTime > MAX_AUDIO_DELAY && m_socketQueue.GetSize(socketOrder::Priority_Discretion) > 0) {
+        PTRACE(5,"H46026\tPossible pipe blockage detected. Audio delay " << audioTime << " Dropping video frames...");
+        m_socketQueue.Drop(socketOrder::Priority_Discretion, nowTime, -1, m_dropped);
+    }
 
-        PTRACE(5,"H46026\tPossible pipe blockage detected. Delay " << stackTime << " Dropping video frames...");
-        unsigned crv = m_socketQueue.top().second.crv;
-        PINDEX sessionId = m_socketQueue.top().second.sessionId;
-        while (m_socketQueue.size()>0 && m_socketQueue.top().second.priority == socketOrder::Priority_Discretion) {
-            m_socketQueue.pop();
+    if (!m_dropped.empty()) {
+        PTRACE(5,"H46026\tDropped " << m_dropped.size() << " late messages");
+        // One picture update for each video channel that lost frames
+        for (size_t i = 0; i < m_dropped.size(); ++i) {
+            if (m_dropped[i].priority != socketOrder::Priority_Discretion)
+                continue;
+            PBoolean done = false;
+            for (size_t j = 0; j < i && !done; ++j)
+                done = m_dropped[j].priority == socketOrder::Priority_Discretion &&
+                       m_dropped[j].crv == m_dropped[i].crv && m_dropped[j].sessionId == m_dropped[i].sessionId;
+            if (!done)
+                FastUpdatePictureRequired(m_dropped[i].crv, m_dropped[i].sessionId);
         }
-        FastUpdatePictureRequired(crv, sessionId);
-        // TODO: Flow Control based on the Time in the queue (stackTime) - SH
     }
 
-    m_socketPacketReady = (!m_socketQueue.empty());
+    m_socketPacketReady = !m_socketQueue.IsEmpty();
 
     return true;
 }
@@ -577,21 +757,166 @@ PBoolean H46026ChannelManager::SocketOut(BYTE * data, PINDEX & len)
 
     PBoolean gotPacket = false;
     m_queueMutex.Wait();
-        if (!m_socketQueue.empty()) {
-            PTRACE(6,"H46026\tSending #" << m_socketQueue.top().second.id << " delay " << m_socketQueue.top().second.delay << "ms");
-            m_currentPacketTime = nowTime + m_socketQueue.top().second.delay;
-            len = m_socketQueue.top().first.GetSize();
-            memcpy(data, (const BYTE *)m_socketQueue.top().first, len);
-            m_socketQueue.pop();
+        if (!m_socketQueue.IsEmpty()) {
+            const H46026SocketScheduler::Message & msg = m_socketQueue.Front();
+            len = msg.first.GetSize();
+            int delay = PacketDelay(len);
+            PTRACE(6,"H46026\tSending #" << msg.second.id << " delay " << delay << "ms");
+            m_currentPacketTime = nowTime + delay;
+            memcpy(data, (const BYTE *)msg.first, len);
+            m_socketQueue.Pop();
             gotPacket = true;
         } else {
             m_currentPacketTime = nowTime;
         }
+        m_socketPacketReady = !m_socketQueue.IsEmpty();
     m_queueMutex.Signal();
 
     return gotPacket;
 }
 
+PBoolean H46026ChannelManager::SocketOut(BYTE * data, PINDEX & len, const PTimeInterval & timeout)
+{
+    if (!WaitSocketOut(timeout))
+        return false;
+
+    return SocketOut(data, len);
+}
+
+PBoolean H46026ChannelManager::SocketOutBatch(BYTE * data, PINDEX size, PINDEX & len, const PTimeInterval & timeout)
+{
+    len = 0;
+    if (!WaitSocketOut(timeout))
+        return false;
+
+    PInt64 nowTime = PTimer::Tick().GetMilliSeconds();
+    PInt64 batchDelay = 0;
+    PINDEX count = 0;
+
+    PWaitAndSignal m(m_queueMutex);
+
+    while (!m_socketQueue.IsEmpty() && (count == 0 || batchDelay < MAX_BATCH_DELAY)) {
+        const H46026SocketScheduler::Message & msg = m_socketQueue.Front();
+        const PBYTEArray & pdu = msg.first;
+        PINDEX packetLength = pdu.GetSize() + 4;
+        if (len + packetLength > size) {
+            if (count > 0)
+                break;
+            PTRACE(2,"H46026\tDropping #" << msg.second.id << ", " << packetLength << " bytes too large for buffer");
+            m_socketQueue.Pop();
+            continue;
+        }
+
+        int delay = PacketDelay(pdu.GetSize());
+        PTRACE(6,"H46026\tSending #" << msg.second.id << " delay " << delay << "ms");
+        BYTE * tpkt = data + len;
+        tpkt[0] = 3;
+        tpkt[1] = 0;
+        tpkt[2] = (BYTE)(packetLength >> 8);
+        tpkt[3] = (BYTE)packetLength;
+        memcpy(tpkt+4, (const BYTE *)pdu, pdu.GetSize());
+
+        len += packetLength;
+        batchDelay += delay;
+        count++;
+        m_socketQueue.Pop();
+    }
+
+    // Keep any hold back set by SocketOutFeedback()
+    if (m_currentPacketTime < nowTime + batchDelay)
+        m_currentPacketTime = nowTime + batchDelay;
+    m_socketPacketReady = !m_socketQueue.IsEmpty();
+
+    PTRACE_IF(6, count > 1, "H46026\tBatched " << count << " messages, " << len << " bytes");
+    return count > 0;
+}
+
+void H46026ChannelManager::InterruptSocketOut()
+{
+    m_socketOutReady.Signal();
+}
+
+void H46026ChannelManager::SocketOutFeedback(PINDEX written, PINDEX backlog)
+{
+    if (backlog == P_MAX_INDEX)
+        return;
+
+    PInt64 nowTime = PTimer::Tick().GetMilliSeconds();
+
+    PWaitAndSignal m(m_queueMutex);
+
+    if (m_feedbackTime == 0) {
+        m_feedbackTime = nowTime;
+        m_feedbackBacklog = backlog;
+        return;
+    }
+
+    // Bytes left from earlier writes mean the pipe, not the sender, set the pace
+    m_feedbackWritten += written;
+    if (backlog > written)
+        m_feedbackCongested = true;
+
+    PInt64 elapsed = nowTime - m_feedbackTime;
+    if (elapsed >= FEEDBACK_INTERVAL) {
+        PINDEX drained = m_feedbackBacklog + m_feedbackWritten - backlog;
+        if (drained < 0)
+            drained = 0;
+        double bps = double(drained) * 8000.0 / double(elapsed);
+        if (m_feedbackCongested)
+            m_mbps += (bps - m_mbps) * FEEDBACK_GAIN;
+        else if (bps > m_mbps)
+            m_mbps = bps;   // Not congested, so the pipe is at least this fast
+        if (m_mbps < MIN_PIPE_BPS)
+            m_mbps = MIN_PIPE_BPS;
+
+        PTRACE(6,"H46026\tPipe drained " << (unsigned)bps << " bps" << (m_feedbackCongested ? " congested" : "")
+                  << ", estimate " << (unsigned)m_mbps << " bps");
+
+        m_feedbackTime = nowTime;
+        m_feedbackWritten = 0;
+        m_feedbackBacklog = backlog;
+        m_feedbackCongested = false;
+    }
+
+    // Hold messages back while the socket has more than a short time of the pipe queued,
+    // so they wait where the scheduler can still order and drop them
+    PInt64 backlogTime = PInt64(double(backlog) * 8000.0 / m_mbps);
+    if (backlogTime > MAX_SOCKET_BACKLOG) {
+        PInt64 holdTime = nowTime + backlogTime - MAX_SOCKET_BACKLOG;
+        if (m_currentPacketTime < holdTime)
+            m_currentPacketTime = holdTime;
+    }
+}
+
+int H46026ChannelManager::PacketDelay(PINDEX size) const
+{
+    return PACKETDELAY(size, m_mbps);
+}
+
+PBoolean H46026ChannelManager::WaitSocketOut(const PTimeInterval & timeout)
+{
+    PInt64 endTime = PTimer::Tick().GetMilliSeconds() + timeout.GetMilliSeconds();
+
+    for (;;) {
+        PInt64 nowTime = PTimer::Tick().GetMilliSeconds();
+        PBoolean ready = m_socketPacketReady;
+
+        // Data waiting, hold it back only as long as the pipe bandwidth needs
+        if (ready && m_currentPacketTime <= nowTime)
+            return true;
+
+        PInt64 wait = ready ? m_currentPacketTime - nowTime : endTime - nowTime;
+        if (nowTime + wait > endTime)
+            wait = endTime - nowTime;
+        if (wait <= 0)
+            return false;
+
+        // Woken with nothing queued is an interrupt
+        if (m_socketOutReady.Wait(PTimeInterval(wait)) && !ready && !m_socketPacketReady)
+            return false;
+    }
+}
+
 PBoolean H46026ChannelManager::WriteQueue(const Q931 & msg, const socketOrder::MessageHeader & prior)
 {
     PTRACE(6,"H46026\tPack #" << prior.id << " Type:" << msg.GetMessageTypeName());
@@ -603,10 +928,17 @@ PBoolean H46026ChannelManager::WriteQueue(const Q931 & msg, const socketOrder::M
 PBoolean H46026ChannelManager::WriteQueue(const PBYTEArray & data, const socketOrder::MessageHeader & prior)
 {
     m_queueMutex.Wait();
-     m_socketQueue.push(pair<PBYTEArray, socketOrder::MessageHeader>(data, prior) );
+     m_socketQueue.Push(H46026SocketScheduler::Message(data, prior));
     m_queueMutex.Signal();
 
-    return ProcessQueue();
+    PBoolean ok = ProcessQueue();
+
+    if (m_socketPacketReady) {
+        m_socketOutReady.Signal();
+        OnSocketOutReady();
+    }
+
+    return ok;
 }
 
 #endif // H323_H46026
@@ -202,6 +202,9 @@ void H460_FeatureOID1::OnReceiveAlerting_UUIE(const H225_FeatureDescriptor & pdu
          H323SignalPDU facilityPDU;
          facilityPDU.BuildFacility(*m_con, false,H225_FacilityReason::e_featureSetUpdate);
          m_con->WriteSignalPDU(facilityPDU);
+
+         // Send what was queued for the session opening
+         m_ep->IMSessionReady(callToken);
        }
     }
 }
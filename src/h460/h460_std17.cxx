@@ -52,6 +52,11 @@
 #include <ptclib/pdns.h>
 #include <ptclib/delaychan.h>
 
+#if defined(H323_H46026) && defined(P_LINUX)
+#include <sys/ioctl.h>
+#include <linux/sockios.h>
+#endif
+
 
 struct LookupRecord {
   PIPSocket::Address addr;
@@ -279,7 +284,127 @@ void H46017TransportThread::Main()
 
 ///////////////////////////////////////////////////////////////////////////////////////
 
+// Queue key of a message, the call reference and which side allocated it
+static unsigned SignalCallKey(const Q931 & q931)
+{
+    return (q931.GetCallReference() << 1) | (q931.IsFromDestination() ? 1 : 0);
+}
+
+H46017SignalDispatcher::H46017SignalDispatcher(H46017Transport & transport, PINDEX workers)
+  : m_transport(transport), m_queued(0), m_shutdown(false), m_available(0, INT_MAX)
+{
+    if (workers < 1)
+        workers = 1;
+
+    for (PINDEX i = 0; i < workers; ++i)
+        m_workers.push_back(PThread::Create(PCREATE_NOTIFIER(WorkerMain), 0,
+                    PThread::NoAutoDeleteThread,
+                    PThread::NormalPriority,
+                    "h46017signal:%x"));
+
+    PTRACE(4, "H46017\tStarted " << workers << " signalling workers");
+}
+
+H46017SignalDispatcher::~H46017SignalDispatcher()
+{
+    Close();
+
+    for (size_t i = 0; i < m_workers.size(); ++i) {
+        // A worker closing the transport cannot wait for itself
+        if (m_workers[i] == PThread::Current())
+            continue;
+        m_workers[i]->WaitForTermination();
+        delete m_workers[i];
+    }
+}
+
+void H46017SignalDispatcher::Dispatch(const H323SignalPDU & pdu)
+{
+    PWaitAndSignal m(m_mutex);
+
+    if (m_shutdown)
+        return;
+
+    unsigned key = SignalCallKey(pdu.GetQ931());
+    CallQueue & call = m_calls[key];
+    call.pdus.push(pdu);
+    m_queued++;
+
+    // A call being handled is put back in turn by its worker
+    if (!call.busy && call.pdus.size() == 1) {
+        m_ready.push_back(key);
+        m_available.Signal();
+    }
+}
+
+void H46017SignalDispatcher::Close()
+{
+    PWaitAndSignal m(m_mutex);
+
+    if (m_shutdown)
+        return;
+
+    m_shutdown = true;
+    m_calls.clear();
+    m_ready.clear();
+    m_queued = 0;
+
+    for (size_t i = 0; i < m_workers.size(); ++i)
+        m_available.Signal();
+}
+
+PINDEX H46017SignalDispatcher::GetQueuedCount() const
+{
+    PWaitAndSignal m(m_mutex);
+    return m_queued;
+}
+
+void H46017SignalDispatcher::WorkerMain(PThread &, H323_INT)
+{
+    H323SignalPDU pdu;
+    for (;;) {
+        m_available.Wait();
 
+        m_mutex.Wait();
+        if (m_shutdown) {
+            m_mutex.Signal();
+            break;
+        }
+        if (m_ready.empty()) {
+            m_mutex.Signal();
+            continue;
+        }
+
+        unsigned key = m_ready.front();
+        m_ready.pop_front();
+        CallQueue & call = m_calls[key];
+        pdu = call.pdus.front();
+        call.pdus.pop();
+        call.busy = true;
+        m_queued--;
+        m_mutex.Signal();
+
+        m_transport.HandleH46017SignallingPDU(pdu.GetQ931().GetCallReference(), pdu);
+
+        PWaitAndSignal m(m_mutex);
+        if (m_shutdown)
+            break;
+
+        CallQueue & done = m_calls[key];
+        done.busy = false;
+        if (done.pdus.empty())
+            m_calls.erase(key);
+        else {
+            // Go behind the other calls waiting so one busy call does not starve them
+            m_ready.push_back(key);
+            m_available.Signal();
+        }
+    }
+
+    PTRACE(4, "H46017\tSignalling worker ended");
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
 
 H46017Transport::H46017Transport(H323EndPoint & endpoint,
                                  PIPSocket::Address binding,
@@ -287,7 +412,7 @@ H46017Transport::H46017Transport(H323EndPoint & endpoint,
                 )
    : H323TransportTCP(endpoint, binding),
      ReadTimeOut(PMaxTimeInterval),
-     Feature(feat), remoteShutDown(false), closeTransport(false), m_signalProcess(NULL)
+     Feature(feat), remoteShutDown(false), closeTransport(false), m_dispatcher(NULL)
  #ifdef H323_H46026
      ,m_h46026tunnel(false), m_socketMgr(NULL), m_socketWrite(NULL)
 #endif
@@ -298,6 +423,7 @@ H46017Transport::H46017Transport(H323EndPoint & endpoint,
 H46017Transport::~H46017Transport()
 {
     Close();
+    delete m_dispatcher;
 }
 
 PBoolean FindH46017RAS(const H225_H323_UU_PDU & pdu, std::list<PBYTEArray> & ras)
@@ -422,43 +548,18 @@ PBoolean H46017Transport::HandleH46017RAS(const H323SignalPDU & pdu)
     return false;
 }
 
-// Unfortunately we have to put the signaling messages onto a separate thread
+// Unfortunately we have to put the signaling messages onto other threads
 // as the messages may block for several seconds.
 PBoolean H46017Transport::HandleH46017SignalPDU(H323SignalPDU & pdu)
 {
-    if (!m_signalProcess) {
-        m_signalProcess = PThread::Create(PCREATE_NOTIFIER(SignalProcess), 0,
-                    PThread::AutoDeleteThread,
-                    PThread::NormalPriority,
-                    "h46017signal:%x");
-    }
-    signalMutex.Wait();
-    recdpdu.push(pdu);
-    signalMutex.Signal();
-    msgRecd.Signal();
-    return true;
-}
+    PWaitAndSignal m(signalMutex);
 
-void H46017Transport::SignalProcess(PThread &, H323_INT)
-{
-    H323SignalPDU pdu;
-    PBoolean dataToProcess = false;
-    while (!closeTransport) {
-        msgRecd.Wait();
-        while (!closeTransport && !recdpdu.empty()) {
-            signalMutex.Wait();
-            if (!recdpdu.empty()) {
-                pdu = recdpdu.front();
-                dataToProcess = true;
-                recdpdu.pop();
-            }
-            signalMutex.Signal();
-            if (dataToProcess) {
-                HandleH46017SignallingPDU(pdu.GetQ931().GetCallReference(), pdu);
-                dataToProcess = false;
-            }
-        }
-    }
+    if (!m_dispatcher && !closeTransport)
+        m_dispatcher = new H46017SignalDispatcher(*this, endpoint.GetH46017SignalThreads());
+
+    if (m_dispatcher)
+        m_dispatcher->Dispatch(pdu);
+    return true;
 }
 
 PBoolean H46017Transport::HandleH46017SignallingPDU(unsigned crv, H323SignalPDU & pdu)
@@ -504,9 +605,7 @@ H323Connection * H46017Transport::HandleH46017SetupPDU(H323SignalPDU & pdu)
   }
 
   PTRACE(3, "H46017\tCreated new connection: " << callToken);
-  connectionsMutex.Wait();
-  endpoint.GetConnections().SetAt(callToken, connection);
-  connectionsMutex.Signal();
+  endpoint.AddConnection(callToken, connection);
 
   connection->AttachSignalChannel(callToken, this, TRUE);
 
@@ -579,12 +678,15 @@ PBoolean H46017Transport::Close()
 
    closeTransport = TRUE;
 
+#ifdef H323_H46026
+   if (m_socketMgr != NULL)
+       m_socketMgr->InterruptSocketOut();
+#endif
+
    signalMutex.Wait();
-   while (!recdpdu.empty()) {
-        recdpdu.pop();
-   }
+   if (m_dispatcher)
+       m_dispatcher->Close();
    signalMutex.Signal();
-   msgRecd.Signal();
 
    PTRACE(4, "H46017\tClosing H46017 NAT channel.");
    return H323TransportTCP::Close();
@@ -637,23 +739,28 @@ void H46017Transport::SetTunnel(H46026Tunnel * mgr)
     m_h46026tunnel = true;
 }
 
+// Bytes written to the socket not yet sent, P_MAX_INDEX if not known
+static PINDEX SocketBacklog(PChannel * channel)
+{
+#if defined(P_LINUX) && defined(SIOCOUTQ)
+    int pending = 0;
+    if (channel != NULL && channel->IsOpen() && ioctl(channel->GetHandle(), SIOCOUTQ, &pending) == 0)
+        return pending;
+#endif
+    return P_MAX_INDEX;
+}
+
 void H46017Transport::SocketWrite(PThread &, H323_INT)
 {
-    PBYTEArray tpkt(10004);  // 10K buffer with RFC1006 Header
-    tpkt[0] = 3;
-    tpkt[1] = 0;
+    PBYTEArray tpkt(32768);  // Several messages, each with its RFC1006 Header
 
+    // Blocks until a message is queued and the pipe bandwidth allows it, rather than polling
     PINDEX sz = 0;
-    int packetLength = 0;
     while (!closeTransport) {
-        if (m_socketMgr->SocketOut(tpkt.GetPointer()+4,sz)) {
-            packetLength = sz + 4;
-            tpkt[2] = (BYTE)(packetLength >> 8);
-            tpkt[3] = (BYTE)packetLength;
-            Write((const BYTE *)tpkt, packetLength);
-        } else {
-            PThread::Sleep(2);
-        }
+        // The send buffer backlog after each write paces the tunnel to the pipe
+        if (m_socketMgr->SocketOutBatch(tpkt.GetPointer(), tpkt.GetSize(), sz, 1000) &&
+            Write((const BYTE *)tpkt, sz))
+            m_socketMgr->SocketOutFeedback(sz, SocketBacklog(GetBaseWriteChannel()));
     }
     tpkt.SetSize(0);
     PTRACE(2,"H46017\tTunnel Write Thread ended");
@@ -813,6 +920,7 @@ PBoolean H46017RasTransport::Connect()
 
 PBoolean H46017RasTransport::Close()
 {
+    PWaitAndSignal m(recdMutex);
     if (!shutdown) {
        shutdown = true;
        msgRecd.Signal();
@@ -823,19 +931,29 @@ PBoolean H46017RasTransport::Close()
 
 PBoolean H46017RasTransport::ReceivedPDU(const PBYTEArray & pdu)
 {
-    recdpdu = pdu;
+    PWaitAndSignal m(recdMutex);
+    recdpdu.push(pdu);
     msgRecd.Signal();
     return true;
 }
 
 PBoolean H46017RasTransport::ReadPDU(PBYTEArray & pdu)
 {
-    msgRecd.Wait();
-    if (shutdown)
-      return false;
-
-    pdu = recdpdu;
-    return true;
+    for (;;) {
+        recdMutex.Wait();
+        if (shutdown) {
+            recdMutex.Signal();
+            return false;
+        }
+        if (!recdpdu.empty()) {
+            pdu = recdpdu.front();
+            recdpdu.pop();
+            recdMutex.Signal();
+            return true;
+        }
+        recdMutex.Signal();
+        msgRecd.Wait();
+    }
 }
 
 PBoolean H46017RasTransport::WritePDU(const PBYTEArray & pdu)
@@ -41,6 +41,7 @@
 
 #include <h323.h>
 #include "h460/h460_std23.h"
+#include "h323natcache.h"
 #include <ptclib/random.h>
 #include <ptclib/pdns.h>
 #ifdef H323_H46018
@@ -185,13 +186,27 @@ int recheckTime = 300000;    // 5 minutes
 void PNatMethod_H46024::MainMethod(PThread &,  H323_INT)
 {
 
+    H323NatDiscoveryCache * cache = feat->GetEndPoint()->GetNatDiscoveryCache();
+    PString cacheKey = "H46024 " + GetServer();
+
     while (natType == PSTUNClient::UnknownNat ||
                 natType == PSTUNClient::ConeNat) {
-        PSTUNClient::NatTypes testtype = NATTest();
+        // A test against the same server a short time ago, for an earlier registration, still holds
+        PSTUNClient::NatTypes testtype;
+        PIPSocket::Address extIP;
+        int cachedType = -1;
+        if (cache != NULL && cache->GetResult(cacheKey, cachedType, extIP) && cachedType >= 0) {
+            testtype = (PSTUNClient::NatTypes)cachedType;
+            PTRACE(4,"Std23\tSTUN Test result from cache: " << testtype);
+        } else {
+            testtype = NATTest();
+            if (GetExternalAddress(extIP) && cache != NULL && testtype != PSTUNClient::UnknownNat)
+                cache->SetResult(cacheKey, testtype, extIP);
+        }
+
         if (natType != testtype) {
             natType = testtype;
-            PIPSocket::Address extIP;
-            if (GetExternalAddress(extIP)) {
+            if (extIP.IsValid() && !extIP.IsAny()) {
                 feat->GetEndPoint()->NATMethodCallBack(GetName(),2,natType);
                 feat->OnNATTypeDetection(natType, extIP);
             }
@@ -259,6 +259,77 @@ PBoolean H460_FeatureStd9::OnSendInfoRequestResponseMessage(H225_FeatureDescript
 
 }
 
+static PASN_OctetString * FindRawReport(H225_GenericData & data)
+{
+    if (data.m_id.GetTag() != H225_GenericIdentifier::e_standard ||
+        (const PASN_Integer &)data.m_id != 9 ||
+        !data.HasOptionalField(H225_GenericData::e_parameters))
+        return NULL;
+
+    for (PINDEX i = 0; i < data.m_parameters.GetSize(); i++) {
+        H225_EnumeratedParameter & param = data.m_parameters[i];
+        if (param.m_id.GetTag() == H225_GenericIdentifier::e_standard &&
+            (const PASN_Integer &)param.m_id == 1 &&
+            param.HasOptionalField(H225_EnumeratedParameter::e_content) &&
+            param.m_content.GetTag() == H225_Content::e_raw)
+            return &(PASN_OctetString &)param.m_content;
+    }
+    return NULL;
+}
+
+void H460_FeatureStd9::MergeReports(H225_InfoRequestResponse & irr)
+{
+    if (!irr.HasOptionalField(H225_InfoRequestResponse::e_genericData))
+        return;
+
+    H225_ArrayOf_GenericData & data = irr.m_genericData;
+
+    // Nothing is decoded unless there are reports to merge
+    PINDEX candidates = 0;
+    for (PINDEX i = 0; i < data.GetSize(); i++) {
+        if (FindRawReport(data[i]) != NULL)
+            candidates++;
+    }
+    if (candidates < 2)
+        return;
+
+    PASN_OctetString * first = NULL;
+    PINDEX reports = 0;
+    H4609_QosMonitoringReportData merged;
+    merged.SetTag(H4609_QosMonitoringReportData::e_periodic);
+    H4609_ArrayOf_PerCallQoSReport & calls = ((H4609_PeriodicQoSMonReport &)merged).m_perCallInfo;
+
+    PINDEX i = 0;
+    while (i < data.GetSize()) {
+        PASN_OctetString * raw = FindRawReport(data[i]);
+        H4609_QosMonitoringReportData qosdata;
+        if (raw == NULL || !raw->DecodeSubType(qosdata) ||
+            qosdata.GetTag() != H4609_QosMonitoringReportData::e_periodic) {
+            i++;
+            continue;
+        }
+
+        H4609_ArrayOf_PerCallQoSReport & percall = ((H4609_PeriodicQoSMonReport &)qosdata).m_perCallInfo;
+        PINDEX size = calls.GetSize();
+        calls.SetSize(size + percall.GetSize());
+        for (PINDEX j = 0; j < percall.GetSize(); j++)
+            calls[size + j] = percall[j];
+        reports++;
+
+        if (first == NULL) {
+            first = raw;
+            i++;
+        }
+        else
+            data.RemoveAt(i);
+    }
+
+    if (reports > 1) {
+        first->EncodeSubType(merged);
+        PTRACE(5, "Std9\tMerged " << reports << " QoS reports of " << calls.GetSize() << " calls into one");
+    }
+}
+
 PBoolean H460_FeatureStd9::OnSendDisengagementRequestMessage(H225_FeatureDescriptor & pdu)
 {
    if (!m_qossupport)
@@ -1705,6 +1705,330 @@ void H323PresenceSubscription::AddGenericData(const H225_ArrayOf_GenericData & d
     }
 }
 
+///////////////////////////////////////////////////////////////////////
+
+H323PresenceEngine::H323PresenceEngine(const PTimeInterval & holdTime)
+: m_holdTime(holdTime), m_spliceChecked(0), m_encodeCount(0), m_elementCount(0)
+{
+    m_publishTimer.SetNotifier(PCREATE_NOTIFIER(OnPublishTimer));
+}
+
+H323PresenceEngine::~H323PresenceEngine()
+{
+    m_publishTimer.Stop();
+}
+
+void H323PresenceEngine::SetState(const H225_AliasAddress & presentity, const H323PresenceNotification & state)
+{
+    PWaitAndSignal m(m_mutex);
+
+    PString key = H323GetAliasAddressString(presentity);
+    Presentity & pres = m_presentities[key];
+    pres.m_alias = presentity;
+    pres.m_next = state;
+
+    // Later changes within the hold time replace this one
+    if (!pres.m_pending) {
+        pres.m_pending = true;
+        pres.m_pendingSince = PTimer::Tick().GetMilliSeconds();
+        m_pendingPresentities.insert(key);
+        if (!m_publishTimer.IsRunning())
+            m_publishTimer = m_holdTime;
+    }
+}
+
+unsigned H323PresenceEngine::GetVersion(const H225_AliasAddress & presentity) const
+{
+    PWaitAndSignal m(m_mutex);
+
+    PresentityMap::const_iterator it = m_presentities.find(H323GetAliasAddressString(presentity));
+    return it != m_presentities.end() ? it->second.m_version : 0;
+}
+
+void H323PresenceEngine::AddWatcher(const H225_AliasAddress & presentity, const H225_EndpointIdentifier & ep, const H225_AliasAddress & alias)
+{
+    PWaitAndSignal m(m_mutex);
+
+    PString key = H323GetAliasAddressString(presentity);
+    Presentity & pres = m_presentities[key];
+    pres.m_alias = presentity;
+
+    PString epKey = ep.GetValue();
+    if (!pres.m_endpoints.insert(epKey).second)
+        return;
+
+    Destination & dest = m_endpoints[epKey];
+    if (dest.m_watching++ == 0) {
+        dest.m_endpoint = ep;
+        dest.m_alias = alias;
+    }
+
+    // The watcher is sent the current state
+    if (pres.m_version > 0)
+        dest.m_waiting.insert(key);
+}
+
+void H323PresenceEngine::AddWatcher(const H225_AliasAddress & presentity, const H225_TransportAddress & gk)
+{
+    PWaitAndSignal m(m_mutex);
+
+    PString key = H323GetAliasAddressString(presentity);
+    Presentity & pres = m_presentities[key];
+    pres.m_alias = presentity;
+
+    PString gkKey = H323TransportAddress(gk);
+    if (!pres.m_gatekeepers.insert(gkKey).second)
+        return;
+
+    Destination & dest = m_gatekeepers[gkKey];
+    if (dest.m_watching++ == 0)
+        dest.m_gatekeeper = gk;
+
+    if (pres.m_version > 0)
+        dest.m_waiting.insert(key);
+}
+
+void H323PresenceEngine::Unwatch(Presentity & pres, const PString & key, DestinationMap & dests, bool endpoint)
+{
+    PString destKey = key;  // may refer to the entry erased
+    if (endpoint)
+        pres.m_endpoints.erase(destKey);
+    else
+        pres.m_gatekeepers.erase(destKey);
+
+    DestinationMap::iterator d = dests.find(destKey);
+    if (d == dests.end())
+        return;
+
+    d->second.m_waiting.erase(H323GetAliasAddressString(pres.m_alias));
+    if (--d->second.m_watching == 0)
+        dests.erase(d);
+}
+
+void H323PresenceEngine::RemoveWatcher(const H225_AliasAddress & presentity, const H225_EndpointIdentifier & ep)
+{
+    PWaitAndSignal m(m_mutex);
+
+    PresentityMap::iterator it = m_presentities.find(H323GetAliasAddressString(presentity));
+    if (it != m_presentities.end() && it->second.m_endpoints.find(ep.GetValue()) != it->second.m_endpoints.end())
+        Unwatch(it->second, ep.GetValue(), m_endpoints, true);
+}
+
+void H323PresenceEngine::RemoveWatcher(const H225_AliasAddress & presentity, const H225_TransportAddress & gk)
+{
+    PWaitAndSignal m(m_mutex);
+
+    PString gkKey = H323TransportAddress(gk);
+    PresentityMap::iterator it = m_presentities.find(H323GetAliasAddressString(presentity));
+    if (it != m_presentities.end() && it->second.m_gatekeepers.find(gkKey) != it->second.m_gatekeepers.end())
+        Unwatch(it->second, gkKey, m_gatekeepers, false);
+}
+
+void H323PresenceEngine::RemoveEndpoint(const H225_EndpointIdentifier & ep)
+{
+    PWaitAndSignal m(m_mutex);
+
+    PString epKey = ep.GetValue();
+    if (m_endpoints.find(epKey) == m_endpoints.end())
+        return;
+
+    for (PresentityMap::iterator it = m_presentities.begin(); it != m_presentities.end(); ++it) {
+        if (it->second.m_endpoints.find(epKey) != it->second.m_endpoints.end())
+            Unwatch(it->second, epKey, m_endpoints, true);
+    }
+    m_endpoints.erase(epKey);
+}
+
+void H323PresenceEngine::RemovePresentity(const H225_AliasAddress & presentity)
+{
+    PWaitAndSignal m(m_mutex);
+
+    PString key = H323GetAliasAddressString(presentity);
+    PresentityMap::iterator it = m_presentities.find(key);
+    if (it == m_presentities.end())
+        return;
+
+    Presentity & pres = it->second;
+    while (!pres.m_endpoints.empty())
+        Unwatch(pres, *pres.m_endpoints.begin(), m_endpoints, true);
+    while (!pres.m_gatekeepers.empty())
+        Unwatch(pres, *pres.m_gatekeepers.begin(), m_gatekeepers, false);
+
+    m_pendingPresentities.erase(key);
+    m_presentities.erase(it);
+}
+
+void H323PresenceEngine::Publish()
+{
+    list<H225_EndpointIdentifier> endpoints;
+    list<H225_TransportAddress> gatekeepers;
+
+    {
+        PWaitAndSignal m(m_mutex);
+
+        PInt64 now = PTimer::Tick().GetMilliSeconds();
+        PInt64 nextDue = -1;
+
+        std::set<PString>::iterator it = m_pendingPresentities.begin();
+        while (it != m_pendingPresentities.end()) {
+            Presentity & pres = m_presentities[*it];
+            PInt64 due = pres.m_pendingSince + m_holdTime.GetMilliSeconds();
+            if (due > now) {
+                if (nextDue < 0 || due < nextDue)
+                    nextDue = due;
+                ++it;
+                continue;
+            }
+
+            pres.m_pending = false;
+            PString key = *it;
+            m_pendingPresentities.erase(it++);
+
+            // Flapped back to where it was
+            if (pres.m_version > 0 && pres.m_next.Compare(pres.m_state) == EqualTo) {
+                PTRACE(5, "PRES\tState of " << key << " unchanged, not published");
+                continue;
+            }
+
+            pres.m_state = pres.m_next;
+            pres.m_version++;
+
+            PPER_Stream strm;
+            pres.m_state.Encode(strm);
+            strm.CompleteEncoding();
+            pres.m_encoded = strm;
+            m_encodeCount++;
+
+            std::set<PString>::const_iterator w;
+            for (w = pres.m_endpoints.begin(); w != pres.m_endpoints.end(); ++w) {
+                Destination & dest = m_endpoints[*w];
+                if (dest.m_waiting.empty())
+                    endpoints.push_back(dest.m_endpoint);
+                dest.m_waiting.insert(key);
+            }
+            for (w = pres.m_gatekeepers.begin(); w != pres.m_gatekeepers.end(); ++w) {
+                Destination & dest = m_gatekeepers[*w];
+                if (dest.m_waiting.empty())
+                    gatekeepers.push_back(dest.m_gatekeeper);
+                dest.m_waiting.insert(key);
+            }
+
+            PTRACE(4, "PRES\tPublished version " << pres.m_version << " of " << key << " to "
+                   << pres.m_endpoints.size() << " endpoints and " << pres.m_gatekeepers.size() << " gatekeepers");
+        }
+
+        if (nextDue >= 0)
+            m_publishTimer = PTimeInterval(nextDue - now);
+    }
+
+    for (list<H225_EndpointIdentifier>::iterator e = endpoints.begin(); e != endpoints.end(); ++e)
+        OnPending(*e);
+    for (list<H225_TransportAddress>::iterator g = gatekeepers.begin(); g != gatekeepers.end(); ++g)
+        OnPending(*g);
+}
+
+void H323PresenceEngine::OnPublishTimer(PTimer &, H323_INT)
+{
+    Publish();
+}
+
+void H323PresenceEngine::BuildElement(const Destination & dest, bool endpoint, const H323PresenceNotification * state, H460P_PresenceElement & element) const
+{
+    H460P_ArrayOf_PresenceMessage & msgs = element.m_message;
+    msgs.SetSize(1);
+    if (endpoint) {
+        msgs[0].SetTag(H460P_PresenceMessage::e_presenceNotify);
+        H460P_PresenceNotify & notify = msgs[0];
+        notify.m_alias = dest.m_alias;
+        if (state != NULL) {
+            notify.m_notification.SetSize(1);
+            notify.m_notification[0] = *state;
+        }
+    }
+    else {
+        msgs[0].SetTag(H460P_PresenceMessage::e_presenceAlert);
+        H460P_PresenceAlert & alert = msgs[0];
+        if (state != NULL) {
+            alert.m_notification.SetSize(1);
+            alert.m_notification[0] = *state;
+        }
+    }
+}
+
+PBoolean H323PresenceEngine::BuildElements(Destination & dest, bool endpoint, list<PASN_OctetString> & pdu)
+{
+    if (dest.m_waiting.empty())
+        return false;
+
+    // The element with no notification ends with the octet aligned count of
+    // notifications, zero, so the element with one is these octets with the
+    // count set to one followed by the notification encoded on its own.
+    if (dest.m_prefix.IsEmpty()) {
+        H460P_PresenceElement element;
+        BuildElement(dest, endpoint, NULL, element);
+        PPER_Stream strm;
+        element.Encode(strm);
+        strm.CompleteEncoding();
+        dest.m_prefix = strm;
+        if (dest.m_prefix.IsEmpty() || dest.m_prefix[dest.m_prefix.GetSize()-1] != 0)
+            m_spliceChecked = -1;
+        else
+            dest.m_prefix[dest.m_prefix.GetSize()-1] = 1;
+    }
+
+    for (std::set<PString>::const_iterator w = dest.m_waiting.begin(); w != dest.m_waiting.end(); ++w) {
+        PresentityMap::const_iterator it = m_presentities.find(*w);
+        if (it == m_presentities.end() || it->second.m_version == 0)
+            continue;
+        const Presentity & pres = it->second;
+
+        PASN_OctetString subPDU;
+        if (m_spliceChecked >= 0) {
+            PINDEX prefixSize = dest.m_prefix.GetSize();
+            BYTE * data = subPDU.GetPointer(prefixSize + pres.m_encoded.GetSize());
+            memcpy(data, dest.m_prefix, prefixSize);
+            memcpy(data + prefixSize, pres.m_encoded, pres.m_encoded.GetSize());
+        }
+
+        if (m_spliceChecked <= 0) {
+            H460P_PresenceElement element;
+            BuildElement(dest, endpoint, &pres.m_state, element);
+            PASN_OctetString encoded;
+            encoded.EncodeSubType(element);
+
+            // Check once the octets put together are the PDU encoded in full
+            if (m_spliceChecked == 0) {
+                m_spliceChecked = (encoded.GetValue() == subPDU.GetValue()) ? 1 : -1;
+                PTRACE_IF(2, m_spliceChecked < 0, "PRES\tPresence elements cannot be put together from encoded states, encoding each");
+            }
+            if (m_spliceChecked < 0)
+                subPDU = encoded;
+        }
+
+        pdu.push_back(subPDU);
+        m_elementCount++;
+    }
+
+    dest.m_waiting.clear();
+    return true;
+}
+
+PBoolean H323PresenceEngine::BuildPresenceElement(const H225_EndpointIdentifier & ep, list<PASN_OctetString> & pdu)
+{
+    PWaitAndSignal m(m_mutex);
+
+    DestinationMap::iterator it = m_endpoints.find(ep.GetValue());
+    return it != m_endpoints.end() && BuildElements(it->second, true, pdu);
+}
+
+PBoolean H323PresenceEngine::BuildPresenceElement(const H225_TransportAddress & gk, list<PASN_OctetString> & pdu)
+{
+    PWaitAndSignal m(m_mutex);
+
+    DestinationMap::iterator it = m_gatekeepers.find(H323TransportAddress(gk));
+    return it != m_gatekeepers.end() && BuildElements(it->second, false, pdu);
+}
+
 #endif
 
 
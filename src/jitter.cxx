@@ -39,6 +39,7 @@
 #include "openh323buildopts.h"
 
 #include "jitter.h"
+#include "h323mediaclock.h"
 
 #if defined(H323_RTP_AGGREGATE) || defined(H323_SIGNAL_AGGREGATE)
 #include <ptclib/sockagg.h>
@@ -61,6 +62,43 @@ jitter */
 jitter buffer target */
 #define DECREASE_JITTER_MIN_PACKETS 50
 
+/* Smallest and largest number of frames in a ring jitter buffer, these must
+be powers of two and well within the 16 bit RTP sequence number space */
+#define RING_MIN_SIZE 16
+#define RING_MAX_SIZE 4096
+
+/* Set in a ring slot tag when it holds a frame for the sequence number in the
+lower 16 bits */
+#define RING_SEQUENCE_FULL 0x10000
+
+/* Adaptive jitter buffer delay histogram, buckets of 5ms up to 640ms */
+#define ADAPTIVE_BUCKET_WIDTH 40
+#define ADAPTIVE_BUCKETS 128
+
+/* Percentage of packets the adaptive delay is to play in time */
+#define ADAPTIVE_PERCENTILE 95
+
+/* Packets counted before the histogram counts are halved */
+#define ADAPTIVE_HALF_LIFE 500
+
+/* Packets counted before the histogram sets the delay */
+#define ADAPTIVE_MIN_SAMPLES 50
+
+/* Frames played between each frame dropped to reduce the delay */
+#define ADAPTIVE_REDUCE_INTERVAL 10
+
+/* Frame time assumed until one is measured, and largest believed */
+#define ADAPTIVE_DEFAULT_FRAME 160
+#define ADAPTIVE_MAX_FRAME 8000
+
+/* Delay, as a multiple of the maximum, taken as a jump in the sender clock */
+#define ADAPTIVE_RESTART_FACTOR 4
+
+static inline int RingSequenceDiff(DWORD a, DWORD b)
+{
+  return (short)(WORD)(a - b);
+}
+
 
 
 #ifdef H323_JITTER_ANALYSER
@@ -153,7 +191,8 @@ RTP_JitterBuffer::RTP_JitterBuffer(RTP_Session & sess,
                                    unsigned minJitterDelay,
                                    unsigned maxJitterDelay,
                                    PINDEX stackSize)
-  : session(sess), jitterThread(NULL), jitterStackSize(stackSize)
+  : session(sess), bufferMutex("RTP_JitterBuffer::bufferMutex"), jitterThread(NULL), jitterStackSize(stackSize),
+    reactorDriven(FALSE), reactorMarkerWarning(FALSE), pullDriven(FALSE)
 {
   // Jitter buffer is a queue of frames waiting for playback, a list of
   // free frames, and a couple of place holders for the frame that is
@@ -166,6 +205,7 @@ RTP_JitterBuffer::RTP_JitterBuffer(RTP_Session & sess,
   maxJitterTime = maxJitterDelay;
   currentJitterTime = minJitterDelay;
   targetJitterTime = currentJitterTime;
+  syncDelay = 0;
 
   // Calculate number of frames to allocate, we make the assumption that the
   // smallest packet we can possibly get is 5ms long (assuming audio 8kHz unit).
@@ -175,6 +215,8 @@ RTP_JitterBuffer::RTP_JitterBuffer(RTP_Session & sess,
   currentDepth = 0;
   packetsTooLate = 0;
   bufferOverruns = 0;
+  framePoolHits = 0;
+  frameCopies = 0;
   consecutiveBufferOverruns = 0;
   maxConsecutiveMarkerBits = 10;
   consecutiveMarkerBits = 0;
@@ -223,22 +265,7 @@ RTP_JitterBuffer::RTP_JitterBuffer(RTP_Session & sess,
 
 RTP_JitterBuffer::~RTP_JitterBuffer()
 {
-  shuttingDown = TRUE;
-
-#ifdef H323_RTP_AGGREGATE
-  if (jitterThread == NULL) {
-    aggregratedHandle->Remove();
-    delete aggregratedHandle;  
-    aggregratedHandle = NULL;
-  } else 
-#endif
-  {
-    PTRACE(3, "RTP\tRemoving jitter buffer " << this << ' ' << jitterThread->GetThreadName());
-    //PAssert(jitterThread->WaitForTermination(10000), "Jitter buffer thread did not terminate");
-	jitterThread->WaitForTermination(3000);
-    delete jitterThread;
-    jitterThread = NULL;
-  }
+  StopReceive();
 
   bufferMutex.Wait();
 
@@ -268,6 +295,27 @@ RTP_JitterBuffer::~RTP_JitterBuffer()
 }
 
 
+void RTP_JitterBuffer::StopReceive()
+{
+  shuttingDown = TRUE;
+
+#ifdef H323_RTP_AGGREGATE
+  if (aggregratedHandle != NULL) {
+    aggregratedHandle->Remove();
+    delete aggregratedHandle;  
+    aggregratedHandle = NULL;
+  } else 
+#endif
+  if (jitterThread != NULL) {
+    PTRACE(3, "RTP\tRemoving jitter buffer " << this << ' ' << jitterThread->GetThreadName());
+    //PAssert(jitterThread->WaitForTermination(10000), "Jitter buffer thread did not terminate");
+	jitterThread->WaitForTermination(3000);
+    delete jitterThread;
+    jitterThread = NULL;
+  }
+}
+
+
 void RTP_JitterBuffer::SetDelay(unsigned minJitterDelay, unsigned maxJitterDelay)
 {
   if (shuttingDown && jitterThread != NULL) {
@@ -280,6 +328,7 @@ void RTP_JitterBuffer::SetDelay(unsigned minJitterDelay, unsigned maxJitterDelay
   maxJitterTime = maxJitterDelay;
   currentJitterTime = minJitterDelay;
   targetJitterTime = currentJitterTime;
+  syncDelay = 0;
 
   PINDEX newBufferSize = maxJitterTime/40+1;
   while (bufferSize < newBufferSize) {
@@ -309,6 +358,22 @@ void RTP_JitterBuffer::SetDelay(unsigned minJitterDelay, unsigned maxJitterDelay
       jitterThread->Restart();
     }
   }
+  else if ((reactorDriven || pullDriven) && shuttingDown) {
+    packetsTooLate = 0;
+    bufferOverruns = 0;
+    consecutiveBufferOverruns = 0;
+    consecutiveMarkerBits = 0;
+    consecutiveEarlyPacketStartTime = 0;
+    reactorMarkerWarning = FALSE;
+
+    shuttingDown = FALSE;
+    preBuffering = TRUE;
+
+    PTRACE(2, "RTP\tJitter buffer restarted on reactor:"
+              " size=" << bufferSize <<
+              " delay=" << minJitterTime << '-' << maxJitterTime << '/' << currentJitterTime <<
+              " (" << (currentJitterTime/8) << "ms)");
+  }
 
   bufferMutex.Signal();
 }
@@ -382,6 +447,7 @@ PBoolean RTP_JitterBuffer::PreRead(RTP_JitterBuffer::Entry * & currentReadFrame,
     freeFrames = freeFrames->next;
     if (freeFrames != NULL)
       freeFrames->prev = NULL;
+    framePoolHits++;
     PTRACE_IF(2, consecutiveBufferOverruns > 1,
               "RTP\tJitter buffer full, threw away "
               << consecutiveBufferOverruns << " oldest frames");
@@ -427,7 +493,14 @@ PBoolean RTP_JitterBuffer::OnRead(RTP_JitterBuffer::Entry * & currentReadFrame,
     return FALSE;
   }
 
-  currentReadFrame->tick = PTimer::Tick();
+  QueueFrame(currentReadFrame, markerWarning);
+  return TRUE;
+}
+
+
+void RTP_JitterBuffer::CheckMarker(RTP_JitterBuffer::Entry * currentReadFrame, PBoolean & markerWarning)
+{
+  currentReadFrame->tick = H323MediaClock::GetMicroseconds();
 
   if (consecutiveMarkerBits < maxConsecutiveMarkerBits) {
     if (currentReadFrame->GetMarker()) {
@@ -446,7 +519,13 @@ PBoolean RTP_JitterBuffer::OnRead(RTP_JitterBuffer::Entry * & currentReadFrame,
       PTRACE(3, "RTP\tEvery packet has Marker bit, ignoring them from this client!");
     }
   }
-  
+}
+
+
+void RTP_JitterBuffer::QueueFrame(RTP_JitterBuffer::Entry * currentReadFrame, PBoolean & markerWarning)
+{
+  CheckMarker(currentReadFrame, markerWarning);
+
 #ifdef H323_JITTER_ANALYSER
   analyser->In(currentReadFrame->GetTimestamp(), currentDepth, preBuffering ? "PreBuf" : "");
 #endif
@@ -454,6 +533,8 @@ PBoolean RTP_JitterBuffer::OnRead(RTP_JitterBuffer::Entry * & currentReadFrame,
   // Queue the frame for playing by the thread at other end of jitter buffer
   bufferMutex.Wait();
 
+  OnFrameArrival(*currentReadFrame);
+
   // Have been reading a frame, put it into the queue now, at correct position
   if (newestFrame == NULL)
     oldestFrame = newestFrame = currentReadFrame; // Was empty
@@ -486,10 +567,163 @@ PBoolean RTP_JitterBuffer::OnRead(RTP_JitterBuffer::Entry * & currentReadFrame,
   }
 
   currentDepth++;
+}
+
 
+PBoolean RTP_JitterBuffer::OnReactorData()
+{
+  if (shuttingDown)
+    return FALSE;
+
+  return ReceiveFrame(FALSE) != RTP_Session::e_AbortTransport;
+}
+
+
+RTP_Session::SendReceiveStatus RTP_JitterBuffer::ReceiveFrame(PBoolean poll)
+{
+  Entry * currentReadFrame;
+
+  bufferMutex.Wait();
+  PreRead(currentReadFrame, reactorMarkerWarning); // Releases bufferMutex
+
+  RTP_Session::SendReceiveStatus status = poll ? session.PollData(*currentReadFrame)
+                                               : session.ReadPendingData(*currentReadFrame);
+  if (status != RTP_Session::e_ProcessPacket) {
+    // Nothing usable was read, put the frame back on the free list
+    bufferMutex.Wait();
+    currentReadFrame->next = freeFrames;
+    if (freeFrames != NULL)
+      freeFrames->prev = currentReadFrame;
+    freeFrames = currentReadFrame;
+    bufferMutex.Signal();
+    return status;
+  }
+
+  QueueFrame(currentReadFrame, reactorMarkerWarning); // Acquires bufferMutex
+  bufferMutex.Signal();
+  return status;
+}
+
+
+PBoolean RTP_JitterBuffer::PullFrames()
+{
+  // Take everything waiting on the socket, bounded so a flood cannot hold
+  // up playout indefinitely.
+  for (PINDEX i = 0; i < bufferSize; i++) {
+    switch (ReceiveFrame(TRUE)) {
+      case RTP_Session::e_ProcessPacket :
+        break;
+      case RTP_Session::e_IgnorePacket :
+        return TRUE;
+      case RTP_Session::e_AbortTransport :
+        PTRACE(3, "RTP\tJitter buffer pull ended");
+        shuttingDown = TRUE;
+        return FALSE;
+    }
+  }
   return TRUE;
 }
 
+void RTP_JitterBuffer::AdaptTarget(Entry & writeFrame)
+{
+  // Calculate the jitter contribution of this frame
+  // - don't count if start of a talk burst
+  if (writeFrame.GetMarker()) {
+    lastWriteTimestamp = 0;
+    lastWriteTick = 0;
+  }
+
+  if (lastWriteTimestamp != 0 && lastWriteTick !=0) {
+    int thisJitter = 0;
+
+    if (writeFrame.GetTimestamp() < lastWriteTimestamp) {
+      //Not too sure how to handle this situation...
+      thisJitter = 0;
+    }
+    else if (writeFrame.tick < lastWriteTick) {
+      //Not too sure how to handle this situation either!
+      thisJitter = 0;
+    }
+    else {  
+      thisJitter = (int)((writeFrame.tick - lastWriteTick)*8/1000) +
+                   lastWriteTimestamp -
+                   writeFrame.GetTimestamp();
+    }
+
+    if (thisJitter < 0) thisJitter *=(-1);
+    thisJitter *=2; //currentJitterTime needs to be at least TWICE the maximum jitter
+
+    if (thisJitter > (int) currentJitterTime * LOWER_JITTER_MAX_PCNT / 100) {
+      targetJitterTime = currentJitterTime;
+      PTRACE(3, "RTP\tJitter buffer target realigned to current jitter buffer");
+      consecutiveEarlyPacketStartTime = H323MediaClock::GetTick();
+      jitterCalcPacketCount = 0;
+      jitterCalc = 0;
+    }
+    else {
+      if (thisJitter > (int) jitterCalc)
+        jitterCalc = thisJitter;
+      jitterCalcPacketCount++;
+
+      //If it's bigger than the target we're currently trying to set, adapt that target.
+      //Note: this will never make targetJitterTime larger than currentJitterTime due to
+      //previous if condition
+      if (thisJitter > (int) targetJitterTime * LOWER_JITTER_MAX_PCNT / 100) {
+        targetJitterTime = thisJitter * 100 / LOWER_JITTER_MAX_PCNT;
+        PTRACE(3, "RTP\tJitter buffer target size increased to "
+                   << targetJitterTime << " (" << (targetJitterTime/8) << "ms)");
+      }
+
+    }
+  }
+
+  lastWriteTimestamp = writeFrame.GetTimestamp();
+  lastWriteTick = writeFrame.tick;
+
+  if ((H323MediaClock::GetTick() - consecutiveEarlyPacketStartTime).GetInterval() > DECREASE_JITTER_PERIOD &&
+       jitterCalcPacketCount >= DECREASE_JITTER_MIN_PACKETS){
+    jitterCalc = jitterCalc * 100 / LOWER_JITTER_MAX_PCNT;
+    if (jitterCalc < targetJitterTime / 2) jitterCalc = targetJitterTime / 2;
+    if (jitterCalc < minJitterTime) jitterCalc = minJitterTime;
+    targetJitterTime = jitterCalc;
+    PTRACE(3, "RTP\tJitter buffer target size decreased to "
+               << targetJitterTime << " (" << (targetJitterTime/8) << "ms)");
+    jitterCalc = 0;
+    jitterCalcPacketCount = 0;
+    consecutiveEarlyPacketStartTime = H323MediaClock::GetTick();
+  }
+}
+
+
+void RTP_JitterBuffer::SetSyncDelay(DWORD delay)
+{
+  PWaitAndSignal mutex(bufferMutex);
+
+  DWORD baseJitterTime = minJitterTime - syncDelay;
+  if (baseJitterTime + delay > maxJitterTime)
+    delay = maxJitterTime > baseJitterTime ? maxJitterTime - baseJitterTime : 0;
+  if (delay == syncDelay)
+    return;
+
+  // A rise holds playout until the buffer has filled to it, a fall lets
+  // the target come down with it as soon as there is a chance
+  if (delay < syncDelay) {
+    DWORD fall = syncDelay - delay;
+    targetJitterTime = targetJitterTime > fall ? targetJitterTime - fall : 0;
+  }
+
+  syncDelay = delay;
+  minJitterTime = baseJitterTime + delay;
+  if (targetJitterTime < minJitterTime)
+    targetJitterTime = minJitterTime;
+  if (currentJitterTime < minJitterTime)
+    currentJitterTime = minJitterTime;
+
+  PTRACE(3, "RTP\tJitter buffer lip sync delay " << syncDelay << ", minimum now "
+         << minJitterTime << " (" << (minJitterTime/8) << "ms)");
+}
+
+
 void RTP_JitterBuffer::ResetFirstWrite()
 {
 	doneFirstWrite = FALSE;
@@ -500,6 +734,9 @@ PBoolean RTP_JitterBuffer::ReadData(DWORD timestamp, RTP_DataFrame & frame)
   if (shuttingDown)
     return FALSE;
 
+  if (pullDriven && !PullFrames())
+    return FALSE;
+
   /*Free the frame just written to codec, putting it back into
     the free list and clearing the parking spot for it.
    */
@@ -577,7 +814,7 @@ PBoolean RTP_JitterBuffer::ReadData(DWORD timestamp, RTP_DataFrame & frame)
     */
 
     // If oldest frame has not been in the buffer long enough, don't return anything yet
-    if ((PTimer::Tick() - oldestFrame->tick).GetInterval() * 8
+    if ((H323MediaClock::GetMicroseconds() - oldestFrame->tick)*8/1000
          < currentJitterTime / 2) {
 #ifdef H323_JITTER_ANALYSER
       analyser->Out(oldestTimestamp, currentDepth, "PreBuf");
@@ -594,7 +831,7 @@ PBoolean RTP_JitterBuffer::ReadData(DWORD timestamp, RTP_DataFrame & frame)
   PBoolean shortSilence = FALSE;
   if (consecutiveMarkerBits < maxConsecutiveMarkerBits) {
       if (oldestFrame->GetMarker() &&
-          (PTimer::Tick() - oldestFrame->tick).GetInterval()* 8 < currentJitterTime / 2)
+          (H323MediaClock::GetMicroseconds() - oldestFrame->tick)*8/1000 < currentJitterTime / 2)
         shortSilence = TRUE;
   }
   else if (timestamp < oldestTimestamp && timestamp > (newestTimestamp - currentJitterTime))
@@ -619,61 +856,7 @@ PBoolean RTP_JitterBuffer::ReadData(DWORD timestamp, RTP_DataFrame & frame)
   oldestFrame = currentWriteFrame->next;
   currentWriteFrame->next = NULL;
  
-  // Calculate the jitter contribution of this frame
-  // - don't count if start of a talk burst
-  if (currentWriteFrame->GetMarker()) {
-    lastWriteTimestamp = 0;
-    lastWriteTick = 0;
-  }
-
-  if (lastWriteTimestamp != 0 && lastWriteTick !=0) {
-    int thisJitter = 0;
-
-    if (currentWriteFrame->GetTimestamp() < lastWriteTimestamp) {
-      //Not too sure how to handle this situation...
-      thisJitter = 0;
-    }
-    else if (currentWriteFrame->tick < lastWriteTick) {
-      //Not too sure how to handle this situation either!
-      thisJitter = 0;
-    }
-    else {  
-      thisJitter = (currentWriteFrame->tick -
-                   lastWriteTick).GetInterval()*8 +
-                   lastWriteTimestamp -
-                   currentWriteFrame->GetTimestamp();
-    }
-
-    if (thisJitter < 0) thisJitter *=(-1);
-    thisJitter *=2; //currentJitterTime needs to be at least TWICE the maximum jitter
-
-    if (thisJitter > (int) currentJitterTime * LOWER_JITTER_MAX_PCNT / 100) {
-      targetJitterTime = currentJitterTime;
-      PTRACE(3, "RTP\tJitter buffer target realigned to current jitter buffer");
-      consecutiveEarlyPacketStartTime = PTimer::Tick();
-      jitterCalcPacketCount = 0;
-      jitterCalc = 0;
-    }
-    else {
-      if (thisJitter > (int) jitterCalc)
-        jitterCalc = thisJitter;
-      jitterCalcPacketCount++;
-
-      //If it's bigger than the target we're currently trying to set, adapt that target.
-      //Note: this will never make targetJitterTime larger than currentJitterTime due to
-      //previous if condition
-      if (thisJitter > (int) targetJitterTime * LOWER_JITTER_MAX_PCNT / 100) {
-        targetJitterTime = thisJitter * 100 / LOWER_JITTER_MAX_PCNT;
-        PTRACE(3, "RTP\tJitter buffer target size increased to "
-                   << targetJitterTime << " (" << (targetJitterTime/8) << "ms)");
-      }
-
-    }
-  }
-
-  lastWriteTimestamp = currentWriteFrame->GetTimestamp();
-  lastWriteTick = currentWriteFrame->tick;
-
+  AdaptTarget(*currentWriteFrame);
 
   if (oldestFrame == NULL)
     newestFrame = NULL;
@@ -683,7 +866,7 @@ PBoolean RTP_JitterBuffer::ReadData(DWORD timestamp, RTP_DataFrame & frame)
     // If exceeded current jitter buffer time delay:
     if ((newestTimestamp - currentWriteFrame->GetTimestamp()) > currentJitterTime) {
       PTRACE(4, "RTP\tJitter buffer length exceeded");
-      consecutiveEarlyPacketStartTime = PTimer::Tick();
+      consecutiveEarlyPacketStartTime = H323MediaClock::GetTick();
       jitterCalcPacketCount = 0;
       jitterCalc = 0;
       lastWriteTimestamp = 0;
@@ -714,7 +897,7 @@ PBoolean RTP_JitterBuffer::ReadData(DWORD timestamp, RTP_DataFrame & frame)
         }
         
         doneFirstWrite = TRUE;
-        frame = *currentWriteFrame;
+        HandOver(frame);
         return TRUE;
       }
 
@@ -725,6 +908,7 @@ PBoolean RTP_JitterBuffer::ReadData(DWORD timestamp, RTP_DataFrame & frame)
                << oldestFrame->GetTimestamp() << " < "
                << (newestTimestamp - maxJitterTime)
                << ") too late, throwing away");
+          H323_HOTTRACE(e_JitterLate, session.GetTraceTag(), currentWriteFrame->GetSequenceNumber());
 
           currentJitterTime = maxJitterTime;
         
@@ -759,18 +943,6 @@ PBoolean RTP_JitterBuffer::ReadData(DWORD timestamp, RTP_DataFrame & frame)
     }
   }
 
-  if ((PTimer::Tick() - consecutiveEarlyPacketStartTime).GetInterval() > DECREASE_JITTER_PERIOD &&
-       jitterCalcPacketCount >= DECREASE_JITTER_MIN_PACKETS){
-    jitterCalc = jitterCalc * 100 / LOWER_JITTER_MAX_PCNT;
-    if (jitterCalc < targetJitterTime / 2) jitterCalc = targetJitterTime / 2;
-    if (jitterCalc < minJitterTime) jitterCalc = minJitterTime;
-    targetJitterTime = jitterCalc;
-    PTRACE(3, "RTP\tJitter buffer target size decreased to "
-               << targetJitterTime << " (" << (targetJitterTime/8) << "ms)");
-    jitterCalc = 0;
-    jitterCalcPacketCount = 0;
-    consecutiveEarlyPacketStartTime = PTimer::Tick();
-  }
 
   /* If using immediate jitter reduction (rather than waiting for silence opportunities)
   then trash oldest frames as necessary to reduce the size of the jitter buffer */
@@ -810,10 +982,778 @@ PBoolean RTP_JitterBuffer::ReadData(DWORD timestamp, RTP_DataFrame & frame)
   }
 
   doneFirstWrite = TRUE;
-  frame = *currentWriteFrame;
+  HandOver(frame);
   return TRUE;
 }
 
+
+void RTP_JitterBuffer::HandOver(RTP_DataFrame & frame)
+{
+  /* Give the reader the buffer of the frame being written and keep the
+     readers old buffer in the parking spot, it goes back to the free list on
+     the next ReadData(). This stops the network side from having to un-share
+     (copy) the buffer when the entry is next reused.
+   */
+  DWORD delay = (DWORD)(H323MediaClock::GetMicroseconds() - currentWriteFrame->tick);
+  session.OnPlayout(delay, currentJitterTime*125);  // timestamp units are 8 per millisecond
+  H323_HOTTRACE(e_JitterPlayout, session.GetTraceTag(), delay/1000);
+
+  if (frame.GetSize() >= currentWriteFrame->GetSize())
+    frame.Swap(*currentWriteFrame);
+  else {
+    frame = *currentWriteFrame;
+    frameCopies++;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+
+RTP_RingJitterBuffer::RTP_RingJitterBuffer(RTP_Session & sess,
+                                           unsigned minJitterDelay,
+                                           unsigned maxJitterDelay,
+                                           PINDEX stackSize)
+  : RTP_JitterBuffer(sess, minJitterDelay, maxJitterDelay, stackSize)
+{
+  // The ring covers the maximum delay and is a power of two so a sequence
+  // number maps to its slot with a mask.
+  ringSize = RING_MIN_SIZE;
+  while (ringSize < bufferSize && ringSize < RING_MAX_SIZE)
+    ringSize <<= 1;
+
+  ring = new Entry * [ringSize];
+  tags = new DWORD[ringSize];
+
+  // Take over the frames the base class put on its free list
+  for (PINDEX i = 0; i < ringSize; i++) {
+    if (freeFrames != NULL) {
+      ring[i] = freeFrames;
+      freeFrames = freeFrames->next;
+    }
+    else
+      ring[i] = new Entry;
+    ring[i]->next = ring[i]->prev = NULL;
+    tags[i] = 0;
+  }
+
+  if (freeFrames != NULL) {
+    spareFrame = freeFrames;
+    freeFrames = freeFrames->next;
+  }
+  else
+    spareFrame = new Entry;
+  spareFrame->next = spareFrame->prev = NULL;
+
+  while (freeFrames != NULL) {
+    Entry * frame = freeFrames;
+    freeFrames = freeFrames->next;
+    delete frame;
+  }
+
+  latestSequence = 0;
+  latestTimestamp = 0;
+  haveLatest = FALSE;
+  flushRequest = FALSE;
+  framesIn = 0;
+
+  playoutSequence = 0;
+  playoutValid = FALSE;
+  framesOut = 0;
+
+  PTRACE(3, "RTP\tJitter buffer using ring of " << ringSize << " frames, obj=" << this);
+}
+
+
+RTP_RingJitterBuffer::~RTP_RingJitterBuffer()
+{
+  // Receive side must be stopped before the ring goes away
+  StopReceive();
+
+  for (PINDEX i = 0; i < ringSize; i++)
+    delete ring[i];
+  delete [] ring;
+  delete [] tags;
+  delete spareFrame;
+}
+
+
+void RTP_RingJitterBuffer::SetDelay(unsigned minJitterDelay, unsigned maxJitterDelay)
+{
+  if (shuttingDown && jitterThread != NULL) {
+    PAssert(jitterThread->WaitForTermination(10000), "Jitter buffer thread did not terminate");
+  }
+
+  // The ring cannot be resized while the receive side owns part of it
+  if (maxJitterDelay/40+1 > (unsigned)ringSize) {
+    PTRACE(2, "RTP\tJitter buffer ring of " << ringSize << " frames too small for delay "
+           << maxJitterDelay << ", limiting to " << ((ringSize-1)*40));
+    maxJitterDelay = (ringSize-1)*40;
+    if (minJitterDelay > maxJitterDelay)
+      minJitterDelay = maxJitterDelay;
+  }
+
+  minJitterTime = minJitterDelay;
+  maxJitterTime = maxJitterDelay;
+  currentJitterTime = minJitterDelay;
+  targetJitterTime = currentJitterTime;
+  syncDelay = 0;
+
+  PBoolean restart;
+  if (jitterThread != NULL)
+    restart = jitterThread->IsTerminated();
+  else
+    restart = (reactorDriven || pullDriven) && shuttingDown;
+
+  if (restart) {
+    packetsTooLate = 0;
+    bufferOverruns = 0;
+    consecutiveBufferOverruns = 0;
+    consecutiveMarkerBits = 0;
+    consecutiveEarlyPacketStartTime = 0;
+    reactorMarkerWarning = FALSE;
+
+    Flush();
+    shuttingDown = FALSE;
+
+    PTRACE(2, "RTP\tJitter buffer restarted:"
+              " size=" << ringSize <<
+              " delay=" << minJitterTime << '-' << maxJitterTime << '/' << currentJitterTime <<
+              " (" << (currentJitterTime/8) << "ms)");
+    if (jitterThread != NULL)
+      jitterThread->Restart();
+  }
+}
+
+
+PBoolean RTP_RingJitterBuffer::Init(Entry * & currentReadFrame, PBoolean & markerWarning)
+{
+  currentReadFrame = spareFrame;
+  markerWarning = FALSE;
+  return TRUE;
+}
+
+
+void RTP_RingJitterBuffer::DeInit(Entry * & /*currentReadFrame*/, PBoolean & /*markerWarning*/)
+{
+}
+
+
+PBoolean RTP_RingJitterBuffer::PreRead(Entry * & currentReadFrame, PBoolean & /*markerWarning*/)
+{
+  // Always read into the spare, it is exchanged with a ring slot on insert
+  currentReadFrame = spareFrame;
+  return TRUE;
+}
+
+
+PBoolean RTP_RingJitterBuffer::OnRead(Entry * & currentReadFrame, PBoolean & markerWarning, PBoolean loop)
+{
+  if (!session.ReadData(*currentReadFrame, loop)) {
+    shuttingDown = TRUE; // Flag to stop the reading side thread
+    PTRACE(3, "RTP\tJitter RTP receive thread ended");
+    return FALSE;
+  }
+
+  CheckMarker(currentReadFrame, markerWarning);
+  InsertFrame(currentReadFrame);
+  return TRUE;
+}
+
+
+RTP_Session::SendReceiveStatus RTP_RingJitterBuffer::ReceiveFrame(PBoolean poll)
+{
+  RTP_Session::SendReceiveStatus status = poll ? session.PollData(*spareFrame)
+                                               : session.ReadPendingData(*spareFrame);
+  if (status == RTP_Session::e_ProcessPacket) {
+    CheckMarker(spareFrame, reactorMarkerWarning);
+    InsertFrame(spareFrame);
+  }
+  return status;
+}
+
+
+void RTP_RingJitterBuffer::InsertFrame(Entry * currentReadFrame)
+{
+  // Playout side has not yet emptied the ring after an overrun
+  if (flushRequest)
+    return;
+
+  DWORD sequence = currentReadFrame->GetSequenceNumber();
+  DWORD timestamp = currentReadFrame->GetTimestamp();
+  PINDEX slot = sequence & (ringSize-1);
+  DWORD tag = tags[slot];
+
+  if (tag == (RING_SEQUENCE_FULL|sequence))
+    return; // Duplicate
+
+  PBoolean overrun = tag != 0;
+  if (!overrun && haveLatest) {
+    // Window is from the next frame to be played for one ring, or before
+    // playout starts, back one ring from the newest frame received.
+    if (playoutValid) {
+      int offset = RingSequenceDiff(sequence, playoutSequence);
+      if (offset < 0) {
+        packetsTooLate++;
+        H323_HOTTRACE(e_JitterLate, session.GetTraceTag(), sequence);
+        PTRACE(4, "RTP\tJitter buffer discarded late frame " << sequence);
+        return;
+      }
+      overrun = offset >= ringSize;
+    }
+    else if (RingSequenceDiff(sequence, latestSequence) <= -ringSize) {
+      packetsTooLate++;
+      H323_HOTTRACE(e_JitterLate, session.GetTraceTag(), sequence);
+      return;
+    }
+  }
+
+  if (overrun) {
+    bufferOverruns++;
+    consecutiveBufferOverruns++;
+    if (consecutiveBufferOverruns > MAX_BUFFER_OVERRUNS) {
+      PTRACE(2, "RTP\tJitter buffer continuously full, throwing away entire buffer.");
+      latestSequence = sequence;
+      latestTimestamp = timestamp;
+      H323_MEMORY_BARRIER();
+      flushRequest = TRUE;
+      consecutiveBufferOverruns = 0;
+    }
+    else {
+      PTRACE_IF(2, consecutiveBufferOverruns == 1,
+                "RTP\tJitter buffer full, throwing away frame (" << timestamp << ')');
+    }
+    return;
+  }
+
+  PTRACE_IF(2, consecutiveBufferOverruns > 1,
+            "RTP\tJitter buffer full, threw away " << consecutiveBufferOverruns << " frames");
+  consecutiveBufferOverruns = 0;
+
+#ifdef H323_JITTER_ANALYSER
+  analyser->In(timestamp, framesIn - framesOut, preBuffering ? "PreBuf" : "");
+#endif
+
+  // Exchange buffers with the free slot, then publish it. The tag must be
+  // visible before the newest sequence or the playout side may skip it.
+  Entry & entry = *ring[slot];
+  entry.Swap(*currentReadFrame);
+  entry.tick = currentReadFrame->tick;
+  framePoolHits++;
+
+  H323_MEMORY_BARRIER();
+  tags[slot] = RING_SEQUENCE_FULL|sequence;
+  framesIn++;
+  H323_MEMORY_BARRIER();
+
+  if (!haveLatest || RingSequenceDiff(sequence, latestSequence) > 0) {
+    latestTimestamp = timestamp;
+    latestSequence = sequence;
+    H323_MEMORY_BARRIER();
+    haveLatest = TRUE;
+  }
+}
+
+
+PBoolean RTP_RingJitterBuffer::FindOldest()
+{
+  if (!haveLatest)
+    return FALSE;
+
+  DWORD latest = latestSequence;
+  H323_MEMORY_BARRIER();
+
+  if (!playoutValid) {
+    playoutSequence = (latest - ringSize + 1) & 0xffff;
+    H323_MEMORY_BARRIER();
+    playoutValid = TRUE;
+  }
+
+  // Step over lost frames and any that arrived after their slot was passed
+  while (RingSequenceDiff(latest, playoutSequence) >= 0) {
+    PINDEX slot = playoutSequence & (ringSize-1);
+    DWORD tag = tags[slot];
+    if (tag == (RING_SEQUENCE_FULL|playoutSequence)) {
+      H323_MEMORY_BARRIER();
+      return TRUE;
+    }
+    if (tag != 0) {
+      tags[slot] = 0;
+      framesOut++;
+    }
+    playoutSequence = (playoutSequence + 1) & 0xffff;
+  }
+
+  return FALSE;
+}
+
+
+void RTP_RingJitterBuffer::ReleaseOldest()
+{
+  PINDEX slot = playoutSequence & (ringSize-1);
+  H323_MEMORY_BARRIER();
+  tags[slot] = 0;
+  framesOut++;
+  playoutSequence = (playoutSequence + 1) & 0xffff;
+}
+
+
+RTP_JitterBuffer::Entry * RTP_RingJitterBuffer::SkipOldest()
+{
+  ReleaseOldest();
+  currentDepth--;
+  return FindOldest() ? ring[playoutSequence & (ringSize-1)] : NULL;
+}
+
+
+void RTP_RingJitterBuffer::PlayOldest(RTP_DataFrame & frame)
+{
+  currentWriteFrame = ring[playoutSequence & (ringSize-1)];
+  HandOver(frame);
+  currentWriteFrame = NULL;
+  ReleaseOldest();
+}
+
+
+void RTP_RingJitterBuffer::Flush()
+{
+  playoutValid = FALSE;
+  H323_MEMORY_BARRIER();
+
+  for (PINDEX i = 0; i < ringSize; i++) {
+    if (tags[i] != 0) {
+      tags[i] = 0;
+      framesOut++;
+    }
+  }
+
+  H323_MEMORY_BARRIER();
+  flushRequest = FALSE;
+  preBuffering = TRUE;
+}
+
+
+PBoolean RTP_RingJitterBuffer::ReadData(DWORD timestamp, RTP_DataFrame & frame)
+{
+  if (shuttingDown)
+    return FALSE;
+
+  if (pullDriven && !PullFrames())
+    return FALSE;
+
+  if (flushRequest)
+    Flush();
+
+  // Default response is an empty frame, ie silence
+  frame.SetPayloadSize(0);
+
+  if (!FindOldest()) {
+    /*No data to play! We ran the buffer down to empty, restart buffer by
+      setting flag that will fill it again before returning any data.
+     */
+    preBuffering = TRUE;
+    currentJitterTime = targetJitterTime;
+
+#ifdef H323_JITTER_ANALYSER
+    analyser->Out(0, framesIn - framesOut, "Empty");
+#endif
+    return TRUE;
+  }
+
+  currentDepth = framesIn - framesOut;
+
+  Entry * writeFrame = ring[playoutSequence & (ringSize-1)];
+  DWORD oldestTimestamp = writeFrame->GetTimestamp();
+  DWORD newestTimestamp = latestTimestamp;
+
+  /* If there is an opportunity (due to silence in the buffer) to implement a desired
+  reduction in the size of the jitter buffer, effect it */
+
+  if (targetJitterTime < currentJitterTime &&
+      (newestTimestamp - oldestTimestamp) < currentJitterTime) {
+    currentJitterTime = ( targetJitterTime > (newestTimestamp - oldestTimestamp)) ?
+                          targetJitterTime : (newestTimestamp - oldestTimestamp);
+
+    PTRACE(3, "RTP\tJitter buffer size decreased to "
+           << currentJitterTime << " (" << (currentJitterTime/8) << "ms)");
+  }
+
+  if (preBuffering) {
+    // Reset jitter baseline
+    lastWriteTimestamp = 0;
+    lastWriteTick = 0;
+
+    // If oldest frame has not been in the buffer long enough, don't return anything yet
+    if ((H323MediaClock::GetMicroseconds() - writeFrame->tick)*8/1000 < currentJitterTime / 2) {
+#ifdef H323_JITTER_ANALYSER
+      analyser->Out(oldestTimestamp, currentDepth, "PreBuf");
+#endif
+      return TRUE;
+    }
+
+    preBuffering = FALSE;
+  }
+
+  //Handle short silence bursts in the middle of the buffer
+  // - if we think we're getting marker bit information, use that
+  PBoolean shortSilence = FALSE;
+  if (consecutiveMarkerBits < maxConsecutiveMarkerBits) {
+      if (writeFrame->GetMarker() &&
+          (H323MediaClock::GetMicroseconds() - writeFrame->tick)*8/1000 < currentJitterTime / 2)
+        shortSilence = TRUE;
+  }
+  else if (timestamp < oldestTimestamp && timestamp > (newestTimestamp - currentJitterTime))
+    shortSilence = TRUE;
+
+  if (shortSilence) {
+    // It is not yet time for something in the buffer
+#ifdef H323_JITTER_ANALYSER
+    analyser->Out(oldestTimestamp, currentDepth, "Wait");
+#endif
+    lastWriteTimestamp = 0;
+    lastWriteTick = 0;
+    return TRUE;
+  }
+
+  currentDepth--;
+#ifdef H323_JITTER_ANALYSER
+  analyser->Out(oldestTimestamp, currentDepth, timestamp >= oldestTimestamp ? "" : "Late");
+#endif
+
+  // Calculate the jitter contribution of this frame
+  // - don't count if start of a talk burst
+  if (writeFrame->GetMarker()) {
+    lastWriteTimestamp = 0;
+    lastWriteTick = 0;
+  }
+
+  if (lastWriteTimestamp != 0 && lastWriteTick !=0) {
+    int thisJitter = 0;
+
+    if (writeFrame->GetTimestamp() < lastWriteTimestamp || writeFrame->tick < lastWriteTick)
+      thisJitter = 0;
+    else
+      thisJitter = (int)((writeFrame->tick - lastWriteTick)*8/1000) +
+                   lastWriteTimestamp - writeFrame->GetTimestamp();
+
+    if (thisJitter < 0) thisJitter *=(-1);
+    thisJitter *=2; //currentJitterTime needs to be at least TWICE the maximum jitter
+
+    if (thisJitter > (int) currentJitterTime * LOWER_JITTER_MAX_PCNT / 100) {
+      targetJitterTime = currentJitterTime;
+      PTRACE(3, "RTP\tJitter buffer target realigned to current jitter buffer");
+      consecutiveEarlyPacketStartTime = H323MediaClock::GetTick();
+      jitterCalcPacketCount = 0;
+      jitterCalc = 0;
+    }
+    else {
+      if (thisJitter > (int) jitterCalc)
+        jitterCalc = thisJitter;
+      jitterCalcPacketCount++;
+
+      if (thisJitter > (int) targetJitterTime * LOWER_JITTER_MAX_PCNT / 100) {
+        targetJitterTime = thisJitter * 100 / LOWER_JITTER_MAX_PCNT;
+        PTRACE(3, "RTP\tJitter buffer target size increased to "
+                   << targetJitterTime << " (" << (targetJitterTime/8) << "ms)");
+      }
+    }
+  }
+
+  lastWriteTimestamp = writeFrame->GetTimestamp();
+  lastWriteTick = writeFrame->tick;
+
+  // If exceeded current jitter buffer time delay:
+  if (currentDepth > 0 && (newestTimestamp - writeFrame->GetTimestamp()) > currentJitterTime) {
+    PTRACE(4, "RTP\tJitter buffer length exceeded");
+    consecutiveEarlyPacketStartTime = H323MediaClock::GetTick();
+    jitterCalcPacketCount = 0;
+    jitterCalc = 0;
+    lastWriteTimestamp = 0;
+    lastWriteTick = 0;
+
+    // If we haven't yet written a frame, we get one free overrun
+    if (!doneFirstWrite) {
+      PTRACE(4, "RTP\tJitter buffer length exceed was prior to first write. Not increasing buffer size");
+      while (writeFrame != NULL && (newestTimestamp - writeFrame->GetTimestamp()) > currentJitterTime)
+        writeFrame = SkipOldest();
+
+      doneFirstWrite = TRUE;
+      if (writeFrame != NULL)
+        PlayOldest(frame);
+      return TRUE;
+    }
+
+    // See if exceeded maximum jitter buffer time delay, waste them if so
+    while (writeFrame != NULL && (newestTimestamp - writeFrame->GetTimestamp()) > maxJitterTime) {
+      PTRACE(4, "RTP\tJitter buffer oldest packet ("
+             << writeFrame->GetTimestamp() << " < "
+             << (newestTimestamp - maxJitterTime)
+             << ") too late, throwing away");
+      currentJitterTime = maxJitterTime;
+      writeFrame = SkipOldest();
+    }
+
+    if (writeFrame == NULL)
+      return TRUE;
+
+    // Now change the jitter time to cope with the new size
+    // unless already set to maxJitterTime
+    if (newestTimestamp - writeFrame->GetTimestamp() > currentJitterTime)
+      currentJitterTime = newestTimestamp - writeFrame->GetTimestamp();
+
+    targetJitterTime = currentJitterTime;
+    PTRACE(3, "RTP\tJitter buffer size increased to "
+           << currentJitterTime << " (" << (currentJitterTime/8) << "ms)");
+  }
+
+  if ((H323MediaClock::GetTick() - consecutiveEarlyPacketStartTime).GetInterval() > DECREASE_JITTER_PERIOD &&
+       jitterCalcPacketCount >= DECREASE_JITTER_MIN_PACKETS){
+    jitterCalc = jitterCalc * 100 / LOWER_JITTER_MAX_PCNT;
+    if (jitterCalc < targetJitterTime / 2) jitterCalc = targetJitterTime / 2;
+    if (jitterCalc < minJitterTime) jitterCalc = minJitterTime;
+    targetJitterTime = jitterCalc;
+    PTRACE(3, "RTP\tJitter buffer target size decreased to "
+               << targetJitterTime << " (" << (targetJitterTime/8) << "ms)");
+    jitterCalc = 0;
+    jitterCalcPacketCount = 0;
+    consecutiveEarlyPacketStartTime = H323MediaClock::GetTick();
+  }
+
+  /* If using immediate jitter reduction (rather than waiting for silence opportunities)
+  then trash frames as necessary to reduce the size of the jitter buffer. Only the
+  playout side may free frames, so these are the oldest rather than the newest. */
+  if (targetJitterTime < currentJitterTime && doJitterReductionImmediately) {
+    while (writeFrame != NULL && (newestTimestamp - writeFrame->GetTimestamp()) > targetJitterTime) {
+      writeFrame = SkipOldest();
+
+      // Reset jitter calculation baseline
+      lastWriteTimestamp = 0;
+      lastWriteTick = 0;
+    }
+
+    currentJitterTime = targetJitterTime;
+    PTRACE(3, "RTP\tJitter buffer size decreased to "
+        << currentJitterTime << " (" << (currentJitterTime/8) << "ms)");
+
+    if (writeFrame == NULL)
+      return TRUE;
+  }
+
+  doneFirstWrite = TRUE;
+  PlayOldest(frame);
+  return TRUE;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////
+
+RTP_AdaptiveJitterBuffer::RTP_AdaptiveJitterBuffer(RTP_Session & sess,
+                                                   unsigned minJitterDelay,
+                                                   unsigned maxJitterDelay,
+                                                   PINDEX stackSize)
+  : RTP_JitterBuffer(sess, minJitterDelay, maxJitterDelay, stackSize),
+    histogram(ADAPTIVE_BUCKETS),
+    lastArrivalSequence(0),
+    lastArrivalTimestamp(0),
+    haveLastArrival(FALSE),
+    frameTime(ADAPTIVE_DEFAULT_FRAME),
+    percentileDelay(0),
+    framesSinceReduction(0),
+    delayReductions(0),
+    timeStretch(FALSE),
+    stretchPending(FALSE),
+    stretchRequests(0)
+{
+  ResetHistogram();
+
+  PTRACE(3, "RTP\tAdaptive jitter buffer, " << ADAPTIVE_PERCENTILE << "th percentile of "
+         << ADAPTIVE_BUCKETS << " delays of " << (ADAPTIVE_BUCKET_WIDTH/8) << "ms");
+}
+
+
+void RTP_AdaptiveJitterBuffer::ResetHistogram()
+{
+  for (size_t i = 0; i < histogram.size(); i++)
+    histogram[i] = 0;
+  histogramTotal = 0;
+  arrivals = 0;
+  haveMinDelay = FALSE;
+}
+
+
+void RTP_AdaptiveJitterBuffer::OnFrameArrival(Entry & frame)
+{
+  DWORD timestamp = frame.GetTimestamp();
+  DWORD sequence = frame.GetSequenceNumber();
+
+  // Timestamp units per frame, from packets that follow on directly
+  if (haveLastArrival && (WORD)(sequence - lastArrivalSequence) == 1) {
+    DWORD step = timestamp - lastArrivalTimestamp;
+    if (step > 0 && step < ADAPTIVE_MAX_FRAME)
+      frameTime = step;
+  }
+  lastArrivalSequence = sequence;
+  lastArrivalTimestamp = timestamp;
+  haveLastArrival = TRUE;
+
+  // Transit time less the sender timestamp, only differences of it matter
+  int relative = (int)((DWORD)(frame.tick*8/1000) - timestamp);
+
+  if (!haveMinDelay || relative - minRelativeDelay < 0) {
+    minRelativeDelay = periodMinDelay = relative;
+    haveMinDelay = TRUE;
+  }
+  else if (relative - periodMinDelay < 0)
+    periodMinDelay = relative;
+
+  DWORD delay = relative - minRelativeDelay;
+  if (delay > ADAPTIVE_RESTART_FACTOR*maxJitterTime) {
+    // The sender timestamps jumped, start again from this packet
+    PTRACE(3, "RTP\tAdaptive jitter buffer delay jumped " << delay << ", restarting statistics");
+    ResetHistogram();
+    minRelativeDelay = periodMinDelay = relative;
+    haveMinDelay = TRUE;
+    delay = 0;
+  }
+
+  PINDEX bucket = delay/ADAPTIVE_BUCKET_WIDTH;
+  if (bucket >= (PINDEX)histogram.size())
+    bucket = histogram.size()-1;
+  histogram[bucket]++;
+  histogramTotal++;
+
+  // Age the counts, and let the baseline follow a drifting sender clock
+  if (++arrivals >= ADAPTIVE_HALF_LIFE) {
+    histogramTotal = 0;
+    for (size_t i = 0; i < histogram.size(); i++) {
+      histogram[i] /= 2;
+      histogramTotal += histogram[i];
+    }
+    arrivals = 0;
+    minRelativeDelay = periodMinDelay;
+    periodMinDelay = relative;
+  }
+}
+
+
+void RTP_AdaptiveJitterBuffer::AdaptTarget(Entry & writeFrame)
+{
+  if (histogramTotal < ADAPTIVE_MIN_SAMPLES)
+    return;
+
+  DWORD needed = histogramTotal*ADAPTIVE_PERCENTILE/100;
+  DWORD count = 0;
+  PINDEX bucket = 0;
+  while (bucket < (PINDEX)histogram.size()-1 && (count += histogram[bucket]) < needed)
+    bucket++;
+  percentileDelay = (bucket+1)*ADAPTIVE_BUCKET_WIDTH;
+
+  DWORD target = percentileDelay + frameTime;
+  if (target < minJitterTime)
+    target = minJitterTime;
+  if (target > maxJitterTime)
+    target = maxJitterTime;
+
+  if (target == targetJitterTime)
+    return;
+
+  PTRACE(4, "RTP\tAdaptive jitter buffer target " << (target > targetJitterTime ? "increased" : "decreased")
+         << " to " << target << " (" << (target/8) << "ms)");
+#ifdef H323_JITTER_ANALYSER
+  analyser->Out(writeFrame.GetTimestamp(), currentDepth, target > targetJitterTime ? "Grow" : "Shrink");
+#endif
+
+  targetJitterTime = target;
+
+  // A longer target takes effect at once, a shorter one as the buffer drains
+  if (targetJitterTime > currentJitterTime)
+    currentJitterTime = targetJitterTime;
+}
+
+
+PBoolean RTP_AdaptiveJitterBuffer::OnReduceDelay(DWORD /*excess*/)
+{
+  // An untaken request means the reader is not stretching, so drop a frame
+  if (!timeStretch || stretchPending)
+    return FALSE;
+
+  stretchPending = TRUE;
+  stretchRequests++;
+  return TRUE;
+}
+
+
+PBoolean RTP_AdaptiveJitterBuffer::TakeTimeStretchRequest()
+{
+  PWaitAndSignal mutex(bufferMutex);
+
+  PBoolean pending = stretchPending;
+  stretchPending = FALSE;
+  return pending;
+}
+
+
+PBoolean RTP_AdaptiveJitterBuffer::ReadData(DWORD timestamp, RTP_DataFrame & frame)
+{
+  if (!RTP_JitterBuffer::ReadData(timestamp, frame))
+    return FALSE;
+
+  // Nothing was played, a silence will do any reduction
+  if (frame.GetPayloadSize() == 0)
+    return TRUE;
+
+  PWaitAndSignal mutex(bufferMutex);
+
+  if (oldestFrame == NULL || targetJitterTime >= currentJitterTime) {
+    framesSinceReduction = 0;
+    return TRUE;
+  }
+
+  DWORD buffered = newestFrame->GetTimestamp() - frame.GetTimestamp();
+  if (buffered <= targetJitterTime + frameTime) {
+    currentJitterTime = buffered > targetJitterTime ? buffered : targetJitterTime;
+    return TRUE;
+  }
+
+  if (++framesSinceReduction < ADAPTIVE_REDUCE_INTERVAL)
+    return TRUE;
+  framesSinceReduction = 0;
+
+  if (OnReduceDelay(buffered - targetJitterTime))
+    return TRUE;
+
+  // Drop the next frame to play, unless it starts a talk burst
+  if (oldestFrame->GetMarker())
+    return TRUE;
+
+  Entry * wastedFrame = oldestFrame;
+  oldestFrame = oldestFrame->next;
+  if (oldestFrame != NULL)
+    oldestFrame->prev = NULL;
+  else
+    newestFrame = NULL;
+  currentDepth--;
+
+  wastedFrame->next = freeFrames;
+  if (freeFrames != NULL)
+    freeFrames->prev = wastedFrame;
+  freeFrames = wastedFrame;
+  delayReductions++;
+
+#ifdef H323_JITTER_ANALYSER
+  analyser->Out(wastedFrame->GetTimestamp(), currentDepth, "Reduce");
+#endif
+
+  // Keep the limit above what is left, or the next read takes it as an overrun
+  if (oldestFrame != NULL) {
+    buffered = newestFrame->GetTimestamp() - oldestFrame->GetTimestamp();
+    currentJitterTime = buffered > targetJitterTime ? buffered : targetJitterTime;
+  }
+
+  PTRACE(4, "RTP\tAdaptive jitter buffer dropped a frame, delay now "
+         << currentJitterTime << " (" << (currentJitterTime/8) << "ms)");
+  return TRUE;
+}
+
+
 /////////////////////////////////////////////////////////////////////////////////
 
 
@@ -823,7 +1763,7 @@ RTP_JitterBufferAnalyser::RTP_JitterBufferAnalyser()
 {
   inPos = outPos = 1;
   in[0].time = out[0].time = 0;
-  in[0].tick = out[0].tick = PTimer::Tick().GetMilliSeconds();
+  in[0].tick = out[0].tick = H323MediaClock::GetMilliseconds();
   in[0].depth = out[0].depth = 0;
 }
 
@@ -831,7 +1771,7 @@ RTP_JitterBufferAnalyser::RTP_JitterBufferAnalyser()
 void RTP_JitterBufferAnalyser::In(DWORD time, unsigned depth, const char * extra)
 {
   if (inPos < PARRAYSIZE(in)) {
-    in[inPos].tick = PTimer::Tick().GetMilliSeconds();
+    in[inPos].tick = H323MediaClock::GetMilliseconds();
     in[inPos].time = time;
     in[inPos].depth = depth;
     in[inPos++].extra = extra;
@@ -842,7 +1782,7 @@ void RTP_JitterBufferAnalyser::In(DWORD time, unsigned depth, const char * extra
 void RTP_JitterBufferAnalyser::Out(DWORD time, unsigned depth, const char * extra)
 {
   if (outPos < PARRAYSIZE(out)) {
-    out[outPos].tick = PTimer::Tick().GetMilliSeconds();
+    out[outPos].tick = H323MediaClock::GetMilliseconds();
     if (time == 0 && outPos > 0)
       out[outPos].time = out[outPos-1].time;
     else
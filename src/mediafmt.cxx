@@ -253,10 +253,34 @@ OPAL_MEDIA_FORMAT_DECLARE(OpalT120Format,
           825000,   // 100's bits/sec
           0,0,0,0)
 
+/////////////////////////////////////////////////////////////////////////////
+
+OpalMediaOptionKey::OpalMediaOptionKey(const char * _name)
+  : name(_name),
+    id(Intern(_name))
+{
+}
+
+
+unsigned OpalMediaOptionKey::Intern(const PString & name)
+{
+  // Interned names are never removed, so tables indexed by them stay valid
+  static PMutex mutex;
+  static std::map<PCaselessString, unsigned> ids;
+
+  PWaitAndSignal m(mutex);
+  unsigned & id = ids[name];
+  if (id == 0)
+    id = (unsigned)ids.size();
+  return id;
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
 
 OpalMediaOption::OpalMediaOption(const char * name, bool readOnly, MergeType merge)
   : m_name(name),
+    m_keyID(0),
     m_readOnly(readOnly),
     m_merge(merge)
 {
@@ -628,6 +652,8 @@ OpalMediaFormat::OpalMediaFormat()
   timeUnits = 0;
   codecBaseTime = 0;
   defaultSessionID = NonRTPSessionID;
+  optionTableValid = false;
+  optionsRevision = NextOptionsRevision();
 }
 
 
@@ -642,36 +668,12 @@ OpalMediaFormat::OpalMediaFormat(const char * search, PBoolean exact)
   timeUnits = 0;
   codecBaseTime = 0;
   defaultSessionID = NonRTPSessionID; 
+  optionTableValid = false;
+  optionsRevision = NextOptionsRevision();
 
-  // look for the media type in the factory. 
-  // Don't make a copy of the list - lock the list and use the raw data
-  if (exact) {
-    OpalMediaFormat * registeredFormat = OpalMediaFormatFactory::CreateInstance(search);
-    if (registeredFormat != NULL)
-      *this = *registeredFormat;
-  }
-  else {
-#if PTLIB_VER < 2110
-    PWaitAndSignal m(OpalMediaFormatFactory::GetMutex());
-    OpalMediaFormatFactory::KeyMap_T & keyMap = OpalMediaFormatFactory::GetKeyMap();
-    OpalMediaFormatFactory::KeyMap_T::const_iterator r;
-    for (r = keyMap.begin(); r != keyMap.end(); ++r) {
-      if (r->first.find(search) != std::string::npos) {
-        *this = *OpalMediaFormatFactory::CreateInstance(r->first);
-        break;
-      }
-    }
-#else
-    OpalMediaFormatFactory::KeyList_T keyList = OpalMediaFormatFactory::GetKeyList();
-    OpalMediaFormatFactory::KeyList_T::const_iterator r;
-    for (r = keyList.begin(); r != keyList.end(); ++r) {
-      if (r->find(search) != std::string::npos) {
-         *this = *OpalMediaFormatFactory::CreateInstance(*r);
-         break;
-      }
-    }
-#endif
-  }
+  // look for the media type in the index of the factory
+  if (search != NULL)
+    OpalMediaFormatRegistry::Find(search, exact, *this);
 }
 
 
@@ -694,6 +696,8 @@ OpalMediaFormat::OpalMediaFormat(const char * fullName,
   frameTime = ft;
   timeUnits = tu;
   codecBaseTime = ts;
+  optionTableValid = false;
+  optionsRevision = NextOptionsRevision();
 
   // assume non-dynamic payload types are correct and do not need deconflicting
   if (rtpPayloadType < RTP_DataFrame::DynamicBase || rtpPayloadType == RTP_DataFrame::IllegalPayloadType)
@@ -762,6 +766,8 @@ OpalMediaFormat & OpalMediaFormat::operator=(const OpalMediaFormat &format)
   *static_cast<PCaselessString *>(this) = *static_cast<const PCaselessString *>(&format);
   options = format.options;
   options.MakeUnique();
+  optionTableValid = false;
+  optionsRevision = format.optionsRevision;
   rtpPayloadType = format.rtpPayloadType;
   defaultSessionID = format.defaultSessionID;
   needsJitter = format.NeedsJitterBuffer();
@@ -776,18 +782,7 @@ OpalMediaFormat & OpalMediaFormat::operator=(const OpalMediaFormat &format)
 void OpalMediaFormat::GetRegisteredMediaFormats(OpalMediaFormat::List & list)
 {
   list.DisallowDeleteObjects();
-#if PTLIB_VER < 2110
-  PWaitAndSignal m(OpalMediaFormatFactory::GetMutex());
-  OpalMediaFormatFactory::KeyMap_T & keyMap = OpalMediaFormatFactory::GetKeyMap();
-  OpalMediaFormatFactory::KeyMap_T::const_iterator r;
-  for (r = keyMap.begin(); r != keyMap.end(); ++r)
-    list.Append(OpalMediaFormatFactory::CreateInstance(r->first));
-#else
-  OpalMediaFormatFactory::KeyList_T keyList = OpalMediaFormatFactory::GetKeyList();
-  OpalMediaFormatFactory::KeyList_T::iterator r;
-  for (r = keyList.begin(); r != keyList.end(); ++r)
-    list.Append(OpalMediaFormatFactory::CreateInstance(*r));
-#endif
+  OpalMediaFormatRegistry::GetFormats(list);
 }
 
 
@@ -799,10 +794,216 @@ OpalMediaFormat::List OpalMediaFormat::GetRegisteredMediaFormats()
 }
 
 
+unsigned OpalMediaFormat::GetFormatID() const
+{
+  return OpalMediaFormatRegistry::GetID(*this);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct MediaFormatIndex
+{
+  MediaFormatIndex() : built(-1) { }
+
+  typedef std::map<std::string, OpalMediaFormat *> FormatMap;
+
+  PReadWriteMutex  mutex;
+  PAtomicInteger   generation;   // Moved on by Invalidate()
+  long             built;        // Generation the index was built from
+  FormatMap        formats;      // Registered formats by name
+  FormatMap        searches;     // Partial name searches done, NULL if no match
+  std::map<std::string, unsigned> ids;  // Interned names, never removed
+  std::vector<std::string> names;       // Interned names by number - 1
+};
+
+MediaFormatIndex & GetMediaFormatIndex()
+{
+  static MediaFormatIndex index;
+  return index;
+}
+
+// Called with the write lock held
+void RebuildMediaFormatIndex(MediaFormatIndex & index)
+{
+  // A format created by the factory below may search the index itself
+  index.built = index.generation;
+  index.formats.clear();
+  index.searches.clear();
+
+#if PTLIB_VER < 2110
+  std::vector<std::string> keyList;
+  {
+    PWaitAndSignal m(OpalMediaFormatFactory::GetMutex());
+    OpalMediaFormatFactory::KeyMap_T & keyMap = OpalMediaFormatFactory::GetKeyMap();
+    OpalMediaFormatFactory::KeyMap_T::const_iterator k;
+    for (k = keyMap.begin(); k != keyMap.end(); ++k)
+      keyList.push_back(k->first);
+  }
+  std::vector<std::string>::const_iterator r;
+#else
+  OpalMediaFormatFactory::KeyList_T keyList = OpalMediaFormatFactory::GetKeyList();
+  OpalMediaFormatFactory::KeyList_T::const_iterator r;
+#endif
+  for (r = keyList.begin(); r != keyList.end(); ++r) {
+    OpalMediaFormat * fmt = OpalMediaFormatFactory::CreateInstance(*r);
+    if (fmt == NULL)
+      continue;
+    index.formats[*r] = fmt;
+    if (index.ids.find(*r) == index.ids.end()) {
+      index.names.push_back(*r);
+      index.ids[*r] = (unsigned)index.names.size();
+    }
+  }
+
+  PTRACE(4, "MediaFmt\tIndexed " << index.formats.size() << " media formats");
+}
+
+// Called with a lock held, returns FALSE if the index must be rebuilt first
+PBoolean MediaFormatIndexCurrent(MediaFormatIndex & index)
+{
+  return index.built == index.generation;
+}
+
+} // namespace
+
+
+PBoolean OpalMediaFormatRegistry::Find(const PString & search, PBoolean exact, OpalMediaFormat & format)
+{
+  MediaFormatIndex & index = GetMediaFormatIndex();
+  std::string key((const char *)search);
+
+  {
+    PReadWaitAndSignal m(index.mutex);
+    if (MediaFormatIndexCurrent(index)) {
+      MediaFormatIndex::FormatMap::const_iterator it;
+      if (exact) {
+        it = index.formats.find(key);
+        if (it == index.formats.end())
+          return FALSE;
+        format = *it->second;
+        return TRUE;
+      }
+      else {
+        it = index.searches.find(key);
+        if (it != index.searches.end()) {
+          if (it->second == NULL)
+            return FALSE;
+          format = *it->second;
+          return TRUE;
+        }
+      }
+    }
+  }
+
+  // Rebuild, or do and remember a new partial name search
+  {
+    PWriteWaitAndSignal m(index.mutex);
+    if (!MediaFormatIndexCurrent(index))
+      RebuildMediaFormatIndex(index);
+
+    OpalMediaFormat * match = NULL;
+    MediaFormatIndex::FormatMap::const_iterator it;
+    if (exact) {
+      it = index.formats.find(key);
+      if (it != index.formats.end())
+        match = it->second;
+    }
+    else {
+      for (it = index.formats.begin(); it != index.formats.end(); ++it) {
+        if (it->first.find(key) != std::string::npos) {
+          match = it->second;
+          break;
+        }
+      }
+      index.searches[key] = match;
+    }
+
+    if (match == NULL)
+      return FALSE;
+
+    format = *match;
+    return TRUE;
+  }
+}
+
+
+PBoolean OpalMediaFormatRegistry::Find(unsigned id, OpalMediaFormat & format)
+{
+  PString name = GetName(id);
+  return !name.IsEmpty() && Find(name, TRUE, format);
+}
+
+
+unsigned OpalMediaFormatRegistry::GetID(const PString & name)
+{
+  MediaFormatIndex & index = GetMediaFormatIndex();
+  std::string key((const char *)name);
+
+  {
+    PReadWaitAndSignal m(index.mutex);
+    if (MediaFormatIndexCurrent(index)) {
+      std::map<std::string, unsigned>::const_iterator it = index.ids.find(key);
+      return it != index.ids.end() ? it->second : (unsigned)UnknownID;
+    }
+  }
+
+  PWriteWaitAndSignal m(index.mutex);
+  if (!MediaFormatIndexCurrent(index))
+    RebuildMediaFormatIndex(index);
+  std::map<std::string, unsigned>::const_iterator it = index.ids.find(key);
+  return it != index.ids.end() ? it->second : (unsigned)UnknownID;
+}
+
+
+PString OpalMediaFormatRegistry::GetName(unsigned id)
+{
+  MediaFormatIndex & index = GetMediaFormatIndex();
+
+  // Names are interned for good, so the index need not be current
+  PReadWaitAndSignal m(index.mutex);
+  if (id == UnknownID || id > index.names.size())
+    return PString::Empty();
+  return index.names[id-1];
+}
+
+
+void OpalMediaFormatRegistry::GetFormats(OpalMediaFormat::List & list)
+{
+  MediaFormatIndex & index = GetMediaFormatIndex();
+
+  {
+    PReadWaitAndSignal m(index.mutex);
+    if (MediaFormatIndexCurrent(index)) {
+      MediaFormatIndex::FormatMap::const_iterator it;
+      for (it = index.formats.begin(); it != index.formats.end(); ++it)
+        list.Append(it->second);
+      return;
+    }
+  }
+
+  PWriteWaitAndSignal m(index.mutex);
+  if (!MediaFormatIndexCurrent(index))
+    RebuildMediaFormatIndex(index);
+  MediaFormatIndex::FormatMap::const_iterator it;
+  for (it = index.formats.begin(); it != index.formats.end(); ++it)
+    list.Append(it->second);
+}
+
+
+void OpalMediaFormatRegistry::Invalidate()
+{
+  ++GetMediaFormatIndex().generation;
+}
+
+
 bool OpalMediaFormat::Merge(const OpalMediaFormat & mediaFormat)
 {
   PWaitAndSignal m1(media_format_mutex);
   PWaitAndSignal m2(mediaFormat.media_format_mutex);
+  MakeOptionsUnique();
   for (PINDEX i = 0; i < options.GetSize(); i++) {
     OpalMediaOption * option = mediaFormat.FindOption(options[i].GetName());
     if (option != NULL && !options[i].Merge(*option))
@@ -828,7 +1029,7 @@ bool OpalMediaFormat::GetOptionValue(const PString & name, PString & value) cons
 bool OpalMediaFormat::SetOptionValue(const PString & name, const PString & value)
 {
   PWaitAndSignal m(media_format_mutex);
-  options.MakeUnique();
+  MakeOptionsUnique();
 
   OpalMediaOption * option = FindOption(name);
   if (option == NULL)
@@ -838,10 +1039,10 @@ bool OpalMediaFormat::SetOptionValue(const PString & name, const PString & value
 }
 
 
-bool OpalMediaFormat::GetOptionBoolean(const PString & name, bool dflt) const
+// The typed access shared by the look ups by name and by key
+
+static bool GetBooleanValue(OpalMediaOption * option, bool dflt)
 {
-  PWaitAndSignal m(media_format_mutex);
-  OpalMediaOption * option = FindOption(name);
   if (option == NULL)
     return dflt;
 
@@ -853,12 +1054,8 @@ bool OpalMediaFormat::GetOptionBoolean(const PString & name, bool dflt) const
 }
 
 
-bool OpalMediaFormat::SetOptionBoolean(const PString & name, bool value)
+static bool SetBooleanValue(OpalMediaOption * option, bool value)
 {
-  PWaitAndSignal m(media_format_mutex);
-  options.MakeUnique();
-
-  OpalMediaOption * option = FindOption(name);
   if (option == NULL)
     return false;
 
@@ -871,10 +1068,8 @@ bool OpalMediaFormat::SetOptionBoolean(const PString & name, bool value)
 }
 
 
-int OpalMediaFormat::GetOptionInteger(const PString & name, int dflt) const
+static int GetIntegerValue(OpalMediaOption * option, int dflt)
 {
-  PWaitAndSignal m(media_format_mutex);
-  OpalMediaOption * option = FindOption(name);
   if (option == NULL)
     return dflt;
 
@@ -890,12 +1085,8 @@ int OpalMediaFormat::GetOptionInteger(const PString & name, int dflt) const
 }
 
 
-bool OpalMediaFormat::SetOptionInteger(const PString & name, int value)
+static bool SetIntegerValue(OpalMediaOption * option, int value)
 {
-  PWaitAndSignal m(media_format_mutex);
-  options.MakeUnique();
-
-  OpalMediaOption * option = FindOption(name);
   if (option == NULL)
     return false;
 
@@ -915,6 +1106,66 @@ bool OpalMediaFormat::SetOptionInteger(const PString & name, int value)
 }
 
 
+bool OpalMediaFormat::GetOptionBoolean(const PString & name, bool dflt) const
+{
+  PWaitAndSignal m(media_format_mutex);
+  return GetBooleanValue(FindOption(name), dflt);
+}
+
+
+bool OpalMediaFormat::SetOptionBoolean(const PString & name, bool value)
+{
+  PWaitAndSignal m(media_format_mutex);
+  MakeOptionsUnique();
+  return SetBooleanValue(FindOption(name), value);
+}
+
+
+bool OpalMediaFormat::GetOptionBoolean(const OpalMediaOptionKey & key, bool dflt) const
+{
+  PWaitAndSignal m(media_format_mutex);
+  return GetBooleanValue(FindOption(key), dflt);
+}
+
+
+bool OpalMediaFormat::SetOptionBoolean(const OpalMediaOptionKey & key, bool value)
+{
+  PWaitAndSignal m(media_format_mutex);
+  MakeOptionsUnique();
+  return SetBooleanValue(FindOption(key), value);
+}
+
+
+int OpalMediaFormat::GetOptionInteger(const PString & name, int dflt) const
+{
+  PWaitAndSignal m(media_format_mutex);
+  return GetIntegerValue(FindOption(name), dflt);
+}
+
+
+bool OpalMediaFormat::SetOptionInteger(const PString & name, int value)
+{
+  PWaitAndSignal m(media_format_mutex);
+  MakeOptionsUnique();
+  return SetIntegerValue(FindOption(name), value);
+}
+
+
+int OpalMediaFormat::GetOptionInteger(const OpalMediaOptionKey & key, int dflt) const
+{
+  PWaitAndSignal m(media_format_mutex);
+  return GetIntegerValue(FindOption(key), dflt);
+}
+
+
+bool OpalMediaFormat::SetOptionInteger(const OpalMediaOptionKey & key, int value)
+{
+  PWaitAndSignal m(media_format_mutex);
+  MakeOptionsUnique();
+  return SetIntegerValue(FindOption(key), value);
+}
+
+
 double OpalMediaFormat::GetOptionReal(const PString & name, double dflt) const
 {
   PWaitAndSignal m(media_format_mutex);
@@ -933,7 +1184,7 @@ double OpalMediaFormat::GetOptionReal(const PString & name, double dflt) const
 bool OpalMediaFormat::SetOptionReal(const PString & name, double value)
 {
   PWaitAndSignal m(media_format_mutex);
-  options.MakeUnique();
+  MakeOptionsUnique();
 
   OpalMediaOption * option = FindOption(name);
   if (option == NULL)
@@ -966,7 +1217,7 @@ PINDEX OpalMediaFormat::GetOptionEnum(const PString & name, PINDEX dflt) const
 bool OpalMediaFormat::SetOptionEnum(const PString & name, PINDEX /* value */)
 {
   PWaitAndSignal m(media_format_mutex);
-  options.MakeUnique();
+  MakeOptionsUnique();
 
   OpalMediaOption * option = FindOption(name);
   if (option == NULL)
@@ -998,7 +1249,7 @@ PString OpalMediaFormat::GetOptionString(const PString & name, const PString & d
 bool OpalMediaFormat::SetOptionString(const PString & name, const PString & value)
 {
   PWaitAndSignal m(media_format_mutex);
-  options.MakeUnique();
+  MakeOptionsUnique();
 
   OpalMediaOption * option = FindOption(name);
   if (option == NULL)
@@ -1031,6 +1282,8 @@ bool OpalMediaFormat::AddOption(OpalMediaOption * option, PBoolean overwrite)
 
   options.MakeUnique();
   options.Append(option);
+  optionTableValid = false;
+  optionsRevision = NextOptionsRevision();
   return true;
 }
 
@@ -1047,6 +1300,46 @@ OpalMediaOption * OpalMediaFormat::FindOption(const PString & name) const
 }
 
 
+OpalMediaOption * OpalMediaFormat::FindOption(const OpalMediaOptionKey & key) const
+{
+  PWaitAndSignal m(media_format_mutex);
+
+  if (!optionTableValid) {
+    optionTable.clear();
+    for (PINDEX i = 0; i < options.GetSize(); i++) {
+      OpalMediaOption & option = options[i];
+      unsigned id = option.GetKeyID();
+      if (id >= optionTable.size())
+        optionTable.resize(id+1, NULL);
+      optionTable[id] = &option;
+    }
+    optionTableValid = true;
+  }
+
+  unsigned id = key.GetID();
+  return id < optionTable.size() ? optionTable[id] : NULL;
+}
+
+
+void OpalMediaFormat::MakeOptionsUnique()
+{
+  // A copy made here has new option objects, not the ones in the table
+  if (!options.MakeUnique())
+    optionTableValid = false;
+
+  // Called before every change to an option
+  optionsRevision = NextOptionsRevision();
+}
+
+
+unsigned OpalMediaFormat::NextOptionsRevision()
+{
+  // Formats are made during static initialisation, so not a file static
+  static PAtomicInteger revision;
+  return (unsigned)++revision;
+}
+
+
 bool OpalMediaFormat::SetRegisteredMediaFormat(const OpalMediaFormat & mediaFormat)
 {
 #if PTLIB_VER < 2110
@@ -1056,6 +1349,8 @@ bool OpalMediaFormat::SetRegisteredMediaFormat(const OpalMediaFormat & mediaForm
   if (registeredFormat == NULL)
     return false;
 
+  // Take the index write lock so no look up copies the format as it changes
+  PWriteWaitAndSignal m(GetMediaFormatIndex().mutex);
   *registeredFormat = mediaFormat;
   return true;
 }
@@ -1096,6 +1391,20 @@ const char * const OpalVideoFormat::ClockRateOption = "Clock Rate";
 const char * const OpalVideoFormat::EmphasisSpeedOption = "Emphasis Speed";
 const char * const OpalVideoFormat::MaxPayloadSizeOption = "Max Payload Size";
 
+const OpalMediaOptionKey OpalVideoFormat::FrameWidthKey(OpalVideoFormat::FrameWidthOption);
+const OpalMediaOptionKey OpalVideoFormat::FrameHeightKey(OpalVideoFormat::FrameHeightOption);
+const OpalMediaOptionKey OpalVideoFormat::EncodingQualityKey(OpalVideoFormat::EncodingQualityOption);
+const OpalMediaOptionKey OpalVideoFormat::TargetBitRateKey(OpalVideoFormat::TargetBitRateOption);
+const OpalMediaOptionKey OpalVideoFormat::DynamicVideoQualityKey(OpalVideoFormat::DynamicVideoQualityOption);
+const OpalMediaOptionKey OpalVideoFormat::AdaptivePacketDelayKey(OpalVideoFormat::AdaptivePacketDelayOption);
+const OpalMediaOptionKey OpalVideoFormat::NeedsJitterKey(OpalVideoFormat::NeedsJitterOption);
+const OpalMediaOptionKey OpalVideoFormat::MaxBitRateKey(OpalVideoFormat::MaxBitRateOption);
+const OpalMediaOptionKey OpalVideoFormat::MaxFrameSizeKey(OpalVideoFormat::MaxFrameSizeOption);
+const OpalMediaOptionKey OpalVideoFormat::FrameTimeKey(OpalVideoFormat::FrameTimeOption);
+const OpalMediaOptionKey OpalVideoFormat::ClockRateKey(OpalVideoFormat::ClockRateOption);
+const OpalMediaOptionKey OpalVideoFormat::EmphasisSpeedKey(OpalVideoFormat::EmphasisSpeedOption);
+const OpalMediaOptionKey OpalVideoFormat::MaxPayloadSizeKey(OpalVideoFormat::MaxPayloadSizeOption);
+
 OpalVideoFormat::OpalVideoFormat(const char * fullName,
                                  RTP_DataFrame::PayloadTypes rtpPayloadType,
                                  unsigned /*frameWidth*/,
@@ -1123,7 +1432,7 @@ PObject * OpalVideoFormat::Clone() const
 
 unsigned OpalVideoFormat::GetInitialBandwidth() const 
 { 
-	return GetOptionInteger(OpalVideoFormat::MaxBitRateOption); 
+	return GetOptionInteger(OpalVideoFormat::MaxBitRateKey); 
 }
 
 bool OpalVideoFormat::Merge(const OpalMediaFormat & mediaFormat)
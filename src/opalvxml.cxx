@@ -40,6 +40,7 @@
 #include <ptclib/delaychan.h>
 #include <ptclib/pwavfile.h>
 #include <ptclib/memfile.h>
+#include <ptclib/cypher.h>
 
 #endif
 
@@ -203,8 +204,72 @@ unsigned G7231_File_Codec::GetAverageSignalLevel()
 
 #ifdef P_VXML
 
+OpalVXMLPromptCache::OpalVXMLPromptCache(const PDirectory & dir)
+  : directory(dir)
+{
+  if (!directory.Exists() && !directory.Create())
+    PTRACE(2, "VXML\tCould not create prompt cache directory " << directory);
+}
+
+
+PFilePath OpalVXMLPromptCache::GetFilePath(const PString & text,
+                                           PTextToSpeech::TextType type,
+                                           const PString & voice) const
+{
+  PMessageDigest5::Code code;
+  PMessageDigest5::Encode(voice + '\n' + PString(PString::Unsigned, type) + '\n' + text, code);
+
+  // Hex rather than base64 so names are safe on case insensitive file systems
+  PString name;
+  const BYTE * bytes = (const BYTE *)&code;
+  for (PINDEX i = 0; i < (PINDEX)sizeof(code); i++)
+    name.sprintf("%02x", bytes[i]);
+
+  return directory + name + ".wav";
+}
+
+
+const OpalWAVPrompt * OpalVXMLPromptCache::Acquire(PTextToSpeech & tts,
+                                                   const PString & text,
+                                                   PTextToSpeech::TextType type,
+                                                   const PString & voice,
+                                                   const PString & format)
+{
+  PFilePath path = GetFilePath(text, type, voice);
+
+  if (!PFile::Exists(path)) {
+    // One render at a time, so sessions wanting the same text wait for it
+    PWaitAndSignal m(renderMutex);
+
+    if (!PFile::Exists(path)) {
+      // Rendered under another name so no one loads a partial file
+      PFilePath temp = path + ".tmp";
+
+      if (!voice.IsEmpty())
+        tts.SetVoice(voice);
+
+      PBoolean ok = tts.OpenFile(temp) && tts.Speak(text, type);
+      if (!tts.Close())
+        ok = FALSE;
+
+      if (!ok || !PFile::Move(temp, path, TRUE)) {
+        PTRACE(2, "VXML\tCould not render prompt \"" << text << "\" to " << path);
+        PFile::Remove(temp);
+        return NULL;
+      }
+
+      PTRACE(4, "VXML\tRendered prompt \"" << text << "\" to " << path);
+    }
+  }
+
+  return wavCache.Acquire(path, format);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
 OpalVXMLSession::OpalVXMLSession(H323Connection * _conn, PTextToSpeech * tts, PBoolean autoDelete)
-  : PVXMLSession(tts, autoDelete), conn(_conn)
+  : PVXMLSession(tts, autoDelete), conn(_conn), promptCache(NULL)
 {
 }
 
@@ -217,6 +282,75 @@ PBoolean OpalVXMLSession::Close()
 }
 
 
+void OpalVXMLSession::SetVoice(const PString & _voice)
+{
+  voice = _voice;
+
+  PTextToSpeech * tts = GetTextToSpeech();
+  if (tts != NULL && !voice.IsEmpty())
+    tts->SetVoice(voice);
+}
+
+
+PString OpalVXMLSession::GetChannelFormat()
+{
+  PString format;
+
+  PVXMLChannel * channel = GetAndLockVXMLChannel();
+  if (channel != NULL) {
+    format = channel->GetMediaFormat();
+    UnLockVXMLChannel();
+  }
+
+  return format;
+}
+
+
+PBoolean OpalVXMLSession::PlayPrompt(const OpalWAVPrompt * prompt, PINDEX repeat, PINDEX delay)
+{
+  // The session queue keeps its own copy, the prompt stays shared
+  PBYTEArray data(prompt->GetData(), prompt->GetSize());
+  OpalWAVPromptCache::Release(prompt);
+  return PlayData(data, repeat, delay);
+}
+
+
+PBoolean OpalVXMLSession::PlayText(const PString & text,
+                                   PTextToSpeech::TextType type,
+                                   PINDEX repeat,
+                                   PINDEX delay)
+{
+  PTextToSpeech * tts = GetTextToSpeech();
+  if (promptCache != NULL && tts != NULL) {
+    PString format = GetChannelFormat();
+    if (!format.IsEmpty()) {
+      const OpalWAVPrompt * prompt = promptCache->Acquire(*tts, text, type, voice, format);
+      if (prompt != NULL)
+        return PlayPrompt(prompt, repeat, delay);
+    }
+  }
+
+  return PVXMLSession::PlayText(text, type, repeat, delay);
+}
+
+
+PBoolean OpalVXMLSession::PlayFile(const PString & fn,
+                                   PINDEX repeat,
+                                   PINDEX delay,
+                                   PBoolean autoDelete)
+{
+  if (promptCache != NULL && !autoDelete) {
+    PString format = GetChannelFormat();
+    if (!format.IsEmpty()) {
+      const OpalWAVPrompt * prompt = promptCache->GetWAVCache().Acquire(fn, format);
+      if (prompt != NULL)
+        return PlayPrompt(prompt, repeat, delay);
+    }
+  }
+
+  return PVXMLSession::PlayFile(fn, repeat, delay, autoDelete);
+}
+
 
 
 #endif
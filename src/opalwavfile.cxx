@@ -39,6 +39,14 @@
 #else
 #include "codecs.h"
 #endif
+#include "h323pluginmgr.h"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 
 
@@ -171,3 +179,416 @@ PWAVFileConverterFactory::Worker<PWAVFileConverterALaw> ALawConverter(PWAVFile::
 
 ///////////////////////////////////////////////////////////////////////
 
+/////////////////////////////////////////////////////////////////////////////
+
+static DWORD GetLE32(const BYTE * ptr)
+{
+  return ptr[0] | (ptr[1] << 8) | (ptr[2] << 16) | ((DWORD)ptr[3] << 24);
+}
+
+static WORD GetLE16(const BYTE * ptr)
+{
+  return (WORD)(ptr[0] | (ptr[1] << 8));
+}
+
+
+OpalWAVPrompt::OpalWAVPrompt(const PFilePath & _filename, const PString & _format)
+  : filename(_filename),
+    format(_format),
+    data(NULL),
+    size(0),
+    frameSize(0),
+    sampleRate(8000),
+    mapping(NULL),
+    mappingSize(0),
+#ifdef _WIN32
+    mappingHandle(NULL),
+#endif
+    references(1)
+{
+}
+
+
+OpalWAVPrompt::~OpalWAVPrompt()
+{
+  Unmap();
+}
+
+
+PBoolean OpalWAVPrompt::Map()
+{
+#ifdef _WIN32
+  HANDLE handle = CreateFile(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (handle == INVALID_HANDLE_VALUE)
+    return FALSE;
+
+  mappingSize = (PINDEX)GetFileSize(handle, NULL);
+  mappingHandle = CreateFileMapping(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+  CloseHandle(handle);
+  if (mappingHandle == NULL)
+    return FALSE;
+
+  mapping = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+  if (mapping == NULL) {
+    CloseHandle(mappingHandle);
+    mappingHandle = NULL;
+    return FALSE;
+  }
+#else
+  int fd = ::open(filename, O_RDONLY);
+  if (fd < 0)
+    return FALSE;
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size == 0) {
+    ::close(fd);
+    return FALSE;
+  }
+
+  mappingSize = (PINDEX)info.st_size;
+  void * ptr = mmap(NULL, mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (ptr == MAP_FAILED)
+    return FALSE;
+  mapping = ptr;
+#endif
+
+  return TRUE;
+}
+
+
+void OpalWAVPrompt::Unmap()
+{
+  if (mapping == NULL)
+    return;
+
+#ifdef _WIN32
+  UnmapViewOfFile(mapping);
+  CloseHandle(mappingHandle);
+  mappingHandle = NULL;
+#else
+  munmap(mapping, mappingSize);
+#endif
+
+  mapping = NULL;
+  mappingSize = 0;
+}
+
+
+PBoolean OpalWAVPrompt::Load()
+{
+  // Read the whole file if it cannot be mapped
+  PBYTEArray fileData;
+  const BYTE * file;
+  PINDEX fileSize;
+  if (Map()) {
+    file = (const BYTE *)mapping;
+    fileSize = mappingSize;
+  }
+  else {
+    PFile in;
+    if (!in.Open(filename, PFile::ReadOnly)) {
+      PTRACE(2, "WAVPrompt\tCould not open " << filename << ": " << in.GetErrorText());
+      return FALSE;
+    }
+    fileSize = (PINDEX)in.GetLength();
+    if (!in.Read(fileData.GetPointer(fileSize), fileSize) || in.GetLastReadCount() != fileSize) {
+      PTRACE(2, "WAVPrompt\tCould not read " << filename);
+      return FALSE;
+    }
+    file = fileData;
+  }
+
+  if (fileSize < 12 || memcmp(file, "RIFF", 4) != 0 || memcmp(file+8, "WAVE", 4) != 0) {
+    PTRACE(2, "WAVPrompt\tNot a WAV file: " << filename);
+    return FALSE;
+  }
+
+  unsigned sourceFormat = 0;
+  unsigned channels = 0;
+  unsigned bitsPerSample = 0;
+  const BYTE * source = NULL;
+  PINDEX sourceSize = 0;
+
+  PINDEX pos = 12;
+  while (pos + 8 <= fileSize) {
+    const BYTE * chunk = file + pos;
+    PINDEX chunkSize = (PINDEX)GetLE32(chunk+4);
+    pos += 8;
+    if (chunkSize > fileSize - pos)
+      chunkSize = fileSize - pos;
+
+    if (memcmp(chunk, "fmt ", 4) == 0 && chunkSize >= 16) {
+      sourceFormat = GetLE16(chunk+8);
+      channels = GetLE16(chunk+10);
+      sampleRate = GetLE32(chunk+12);
+      bitsPerSample = GetLE16(chunk+22);
+    }
+    else if (memcmp(chunk, "data", 4) == 0) {
+      source = chunk+8;
+      sourceSize = chunkSize;
+    }
+
+    pos += chunkSize + (chunkSize&1);
+  }
+
+  if (source == NULL || channels != 1 ||
+      !(sourceFormat == PWAVFile::fmt_PCM && bitsPerSample == 16) &&
+      sourceFormat != PWAVFile::fmt_uLaw && sourceFormat != PWAVFile::fmt_ALaw) {
+    PTRACE(2, "WAVPrompt\tUnsupported WAV file " << filename << ", format " << sourceFormat
+           << ", " << channels << " channels, " << bitsPerSample << " bits");
+    return FALSE;
+  }
+
+  if (!Convert(sourceFormat, source, sourceSize))
+    return FALSE;
+
+  // Converted data no longer needs the file
+  if (data == (const BYTE *)converted)
+    Unmap();
+
+  PTRACE(3, "WAVPrompt\tLoaded " << filename << " as " << format << ", " << size << " bytes"
+         << (IsMapped() ? " mapped" : ""));
+  return TRUE;
+}
+
+
+PBoolean OpalWAVPrompt::Convert(unsigned sourceFormat, const BYTE * source, PINDEX sourceSize)
+{
+  PINDEX i;
+
+  PBoolean toPCM  = format == OPAL_PCM16;
+  PBoolean toULaw = format.NumCompare(OPAL_G711_ULAW_64K) == PObject::EqualTo;
+  PBoolean toALaw = format.NumCompare(OPAL_G711_ALAW_64K) == PObject::EqualTo;
+
+  if ((toPCM  && sourceFormat == PWAVFile::fmt_PCM) ||
+      (toULaw && sourceFormat == PWAVFile::fmt_uLaw) ||
+      (toALaw && sourceFormat == PWAVFile::fmt_ALaw)) {
+    // Already in the format, played straight from the file
+    data = source;
+    size = toPCM ? sourceSize&~1 : sourceSize;
+    if (mapping == NULL) {
+      memcpy(converted.GetPointer(size), source, size);
+      data = converted;
+    }
+    return TRUE;
+  }
+
+#ifdef H323_AUDIO_CODECS
+  // Everything else is converted through PCM
+  PBYTEArray pcmBuffer;
+  const short * pcm;
+  PINDEX samples;
+  if (sourceFormat == PWAVFile::fmt_PCM) {
+    pcm = (const short *)source;
+    samples = sourceSize/2;
+  }
+  else {
+    samples = sourceSize;
+    short * ptr = (short *)pcmBuffer.GetPointer(samples*2);
+    for (i = 0; i < samples; i++)
+      ptr[i] = sourceFormat == PWAVFile::fmt_uLaw ? H323_muLawCodec::DecodeSample(source[i])
+                                                  : H323_ALawCodec::DecodeSample(source[i]);
+    pcm = ptr;
+  }
+
+  if (toPCM) {
+    size = samples*2;
+    memcpy(converted.GetPointer(size), pcm, size);
+  }
+  else if (toULaw || toALaw) {
+    if (sampleRate != 8000) {
+      PTRACE(2, "WAVPrompt\t" << filename << " is " << sampleRate << " Hz, G.711 needs 8000");
+      return FALSE;
+    }
+    size = samples;
+    BYTE * ptr = converted.GetPointer(size);
+    for (i = 0; i < samples; i++)
+      ptr[i] = (BYTE)(toULaw ? H323_muLawCodec::EncodeSample(pcm[i]) : H323_ALawCodec::EncodeSample(pcm[i]));
+  }
+  else {
+    OpalFactoryCodec * encoder = H323PluginCodecManager::CreateCodec("L16|" + format);
+    if (encoder == NULL) {
+      PTRACE(2, "WAVPrompt\tNo encoder for " << format);
+      return FALSE;
+    }
+
+    unsigned samplesPerFrame = encoder->GetSamplesPerFrame();
+    frameSize = encoder->GetBytesPerFrame();
+    if (encoder->GetSampleRate() != sampleRate || samplesPerFrame == 0 || frameSize == 0) {
+      PTRACE(2, "WAVPrompt\t" << filename << " is " << sampleRate << " Hz, "
+             << format << " needs " << encoder->GetSampleRate());
+      delete encoder;
+      return FALSE;
+    }
+
+    // Whole frames only, the last one padded with silence
+    PINDEX frames = (samples + samplesPerFrame-1)/samplesPerFrame;
+    PBYTEArray frameIn(samplesPerFrame*2);
+    PBYTEArray frameOut(frameSize*2);
+    size = 0;
+    for (PINDEX f = 0; f < frames; f++) {
+      PINDEX count = PMIN((PINDEX)samplesPerFrame, samples - f*samplesPerFrame);
+      memset(frameIn.GetPointer(), 0, frameIn.GetSize());
+      memcpy(frameIn.GetPointer(), pcm + f*samplesPerFrame, count*2);
+
+      unsigned fromLen = samplesPerFrame*2;
+      unsigned toLen = frameOut.GetSize();
+      unsigned flags = 0;
+      if (!encoder->Encode(frameIn, &fromLen, frameOut.GetPointer(), &toLen, &flags) || toLen == 0) {
+        PTRACE(2, "WAVPrompt\tEncoder " << format << " failed on frame " << f);
+        delete encoder;
+        return FALSE;
+      }
+      memcpy(converted.GetPointer(size + toLen) + size, frameOut, toLen);
+      size += toLen;
+    }
+
+    delete encoder;
+  }
+
+  data = converted;
+  return TRUE;
+#else
+  PTRACE(2, "WAVPrompt\tNo codecs to convert " << filename << " to " << format);
+  return FALSE;
+#endif
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+OpalWAVPromptCache::OpalWAVPromptCache()
+{
+}
+
+
+OpalWAVPromptCache::~OpalWAVPromptCache()
+{
+  RemoveAll();
+}
+
+
+const OpalWAVPrompt * OpalWAVPromptCache::Acquire(const PFilePath & filename, const PString & format)
+{
+  PString key = filename + '|' + format;
+
+  PWaitAndSignal m(mutex);
+
+  PromptMap::iterator it = prompts.find(key);
+  if (it != prompts.end()) {
+    ++it->second->references;
+    return it->second;
+  }
+
+  // Loaded with the lock held so callers wanting the same prompt wait for it
+  OpalWAVPrompt * prompt = new OpalWAVPrompt(filename, format);
+  if (!prompt->Load()) {
+    delete prompt;
+    return NULL;
+  }
+
+  prompts[key] = prompt;
+  ++prompt->references;
+  return prompt;
+}
+
+
+void OpalWAVPromptCache::Release(const OpalWAVPrompt * prompt)
+{
+  if (prompt != NULL && --prompt->references == 0)
+    delete prompt;
+}
+
+
+void OpalWAVPromptCache::Remove(const PFilePath & filename)
+{
+  PWaitAndSignal m(mutex);
+
+  PString prefix = filename + '|';
+  PromptMap::iterator it = prompts.lower_bound(prefix);
+  while (it != prompts.end() && it->first.NumCompare(prefix) == PObject::EqualTo) {
+    Release(it->second);
+    prompts.erase(it++);
+  }
+}
+
+
+void OpalWAVPromptCache::RemoveAll()
+{
+  PWaitAndSignal m(mutex);
+
+  for (PromptMap::iterator it = prompts.begin(); it != prompts.end(); ++it)
+    Release(it->second);
+  prompts.clear();
+}
+
+
+PINDEX OpalWAVPromptCache::GetSize() const
+{
+  PWaitAndSignal m(mutex);
+  return prompts.size();
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+OpalWAVPromptChannel::OpalWAVPromptChannel(const OpalWAVPrompt * _prompt, PBoolean _loop)
+  : prompt(_prompt),
+    position(0),
+    loop(_loop)
+{
+}
+
+
+OpalWAVPromptChannel::~OpalWAVPromptChannel()
+{
+  Close();
+}
+
+
+PBoolean OpalWAVPromptChannel::Read(void * buf, PINDEX len)
+{
+  lastReadCount = 0;
+
+  if (prompt == NULL || prompt->GetSize() == 0)
+    return FALSE;
+
+  // Encoded prompts are read in whole frames
+  PINDEX frameSize = prompt->GetFrameSize();
+  if (frameSize > 0)
+    len -= len%frameSize;
+
+  BYTE * ptr = (BYTE *)buf;
+  while (lastReadCount < len) {
+    if (position >= prompt->GetSize()) {
+      if (!loop)
+        break;
+      position = 0;
+    }
+    PINDEX count = PMIN(len - lastReadCount, prompt->GetSize() - position);
+    memcpy(ptr + lastReadCount, prompt->GetData() + position, count);
+    lastReadCount += count;
+    position += count;
+  }
+
+  return lastReadCount > 0;
+}
+
+
+PBoolean OpalWAVPromptChannel::Write(const void *, PINDEX)
+{
+  lastWriteCount = 0;
+  return FALSE;
+}
+
+
+PBoolean OpalWAVPromptChannel::Close()
+{
+  OpalWAVPromptCache::Release(prompt);
+  prompt = NULL;
+  return TRUE;
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
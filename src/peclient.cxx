@@ -39,11 +39,14 @@
 #include "h323annexg.h"
 #include "h323pdu.h"
 
+#include <vector>
+
 #define new PNEW
 
 const unsigned ServiceRequestRetryTime       = 60;
 const unsigned ServiceRequestGracePeriod     = 10;
 const unsigned ServiceRelationshipTimeToLive = 60;
+const PINDEX   DescriptorUpdateBatchSize     = 20;
 
 ////////////////////////////////////////////////////////////////
 
@@ -130,6 +133,12 @@ void H501DescriptorUpdate::SetRejectReason(unsigned /*reasonCode*/)
 }
 
 
+H323Transactor::RequestQueue H501DescriptorUpdate::GetQueue() const
+{
+  return H323Transactor::BackgroundQueue;
+}
+
+
 H323Transaction::Response H501DescriptorUpdate::OnHandlePDU()
 {
   return peerElement.OnDescriptorUpdate(*this);
@@ -163,12 +172,57 @@ void H501AccessRequest::SetRejectReason(unsigned reasonCode)
 }
 
 
+H323Transactor::RequestPriority H501AccessRequest::GetPriority() const
+{
+  return H323Transactor::UrgentPriority;
+}
+
+
+H323Transactor::RequestQueue H501AccessRequest::GetQueue() const
+{
+  return H323Transactor::ConcurrentQueue;
+}
+
+
 H323Transaction::Response H501AccessRequest::OnHandlePDU()
 {
   return peerElement.OnAccessRequest(*this);
 }
 
 
+////////////////////////////////////////////////////////////////
+
+H501DescriptorIDRequest::H501DescriptorIDRequest(H323PeerElement & pe,
+                                                 const H501PDU & pdu)
+  : H501Transaction(pe, pdu, TRUE),
+    drq((H501_DescriptorIDRequest &)request->GetChoice().GetObject()),
+    dcf(((H501PDU &)confirm->GetPDU()).BuildDescriptorIDConfirmation(pdu.m_common.m_sequenceNumber)),
+    drj(((H501PDU &)reject->GetPDU()).BuildDescriptorIDRejection(pdu.m_common.m_sequenceNumber,
+                                                                 H501_DescriptorIDRejectionReason::e_undefined))
+{
+}
+
+
+#if PTRACING
+const char * H501DescriptorIDRequest::GetName() const
+{
+  return "DescriptorIDRequest";
+}
+#endif
+
+
+void H501DescriptorIDRequest::SetRejectReason(unsigned reasonCode)
+{
+  drj.m_reason.SetTag(reasonCode);
+}
+
+
+H323Transaction::Response H501DescriptorIDRequest::OnHandlePDU()
+{
+  return peerElement.OnDescriptorIDRequest(*this);
+}
+
+
 ////////////////////////////////////////////////////////////////
 
 H323PeerElement::H323PeerElement(H323EndPoint & ep, H323Transport * trans)
@@ -194,6 +248,10 @@ void H323PeerElement::Construct()
   localIdentifier   = endpoint.GetLocalUserName();
   basePeerOrdinal   = RemoteServiceRelationshipOrdinal;
 
+  descriptorTableVersion  = 1;
+  descriptorUpdateRunning = FALSE;
+
+  SetWorkerThreads(DefaultWorkerThreads);
   StartChannel();
 
   monitor = PThread::Create(PCREATE_NOTIFIER(MonitorMain), 0,
@@ -212,6 +270,14 @@ H323PeerElement::~H323PeerElement()
   }
 
   StopChannel();
+
+  PWaitAndSignal m(aliasMutex);
+  AliasKeyIndex * indexes[3] = { &transportAddressToDescriptorID, &specificAliasToDescriptorID, &wildcardAliasToDescriptorID };
+  for (PINDEX i = 0; i < 3; i++) {
+    for (AliasKeyIndex::iterator it = indexes[i]->begin(); it != indexes[i]->end(); ++it)
+      delete it->second;
+    indexes[i]->clear();
+  }
 }
 
 
@@ -289,8 +355,17 @@ void H323PeerElement::MonitorMain(PThread &,  H323_INT)
       }
     }
 
-    // if any descriptor needs updating, then spawn a thread to do it
+    // if any descriptor or new peer needs updating, then spawn a thread to do it
+    PBoolean needUpdate = FALSE;
     {
+      for (PSafePtr<H323PeerElementServiceRelationship> sr = GetFirstRemoteServiceRelationship(PSafeReadOnly); sr != NULL; sr++) {
+        if (sr->descriptorVersion == 0) {
+          needUpdate = TRUE;
+          break;
+        }
+      }
+    }
+    if (!needUpdate) {
       for (PSafePtr<H323PeerElementDescriptor> descriptor = GetFirstDescriptor(PSafeReadOnly); descriptor != NULL; descriptor++) {
         PWaitAndSignal m(localPeerListMutex);
         if (
@@ -300,11 +375,18 @@ void H323PeerElement::MonitorMain(PThread &,  H323_INT)
               !localServiceOrdinals.Contains(descriptor->creator)
              )
             ) {
-          PThread::Create(PCREATE_NOTIFIER(UpdateAllDescriptors), 0, PThread::AutoDeleteThread, PThread::NormalPriority, "PeerUpdater");
+          needUpdate = TRUE;
           break;
         }
       }
     }
+    if (needUpdate) {
+      PWaitAndSignal m(descriptorVersionMutex);
+      if (!descriptorUpdateRunning) {
+        descriptorUpdateRunning = TRUE;
+        PThread::Create(PCREATE_NOTIFIER(UpdateAllDescriptors), 0, PThread::AutoDeleteThread, PThread::NormalPriority, "PeerUpdater");
+      }
+    }
 
     // wait until just before the next expire time;
     PTimeInterval timeToWait = nextExpireTime - PTime();
@@ -331,12 +413,18 @@ void H323PeerElement::UpdateAllDescriptors(PThread &, H323_INT)
         (descriptor->state != H323PeerElementDescriptor::Deleted) &&
         (descriptor->creator >= RemoteServiceRelationshipOrdinal) && 
         !localServiceOrdinals.Contains(descriptor->creator)
-       )
-      descriptor->state = H323PeerElementDescriptor::Deleted;
+       ) {
+      PTRACE(4, "PeerElement\tDeleting descriptor " << descriptor->descriptorID << " of expired service relationship");
+      RemoveDescriptorInformation(descriptor->descriptorID, descriptor->addressTemplates);
+      MarkDescriptorChanged(*descriptor, H323PeerElementDescriptor::Deleted);
+    }
+  }
 
-    PTRACE(4, "PeerElement\tUpdating descriptor " << descriptor->descriptorID << " in state " << descriptor->state);
+  SendDescriptorChanges();
 
-    UpdateDescriptor(descriptor);
+  {
+    PWaitAndSignal m(descriptorVersionMutex);
+    descriptorUpdateRunning = FALSE;
   }
 
   monitorTickle.Signal();
@@ -542,12 +630,7 @@ H323PeerElement::Error H323PeerElement::ServiceRequestByAddr(const H323Transport
   PTRACE(2, "PeerElement\tNew service relationship established with " << peer << " - next update in " << replyBody.m_timeToLive);
   OnAddServiceRelationship(peer);
 
-  // mark all descriptors as needing an update
-  for (PSafePtr<H323PeerElementDescriptor> descriptor = GetFirstDescriptor(PSafeReadWrite); descriptor != NULL; descriptor++) {
-    if (descriptor->state == H323PeerElementDescriptor::Clean)
-      descriptor->state = H323PeerElementDescriptor::Dirty;
-  }
-
+  // the new peer is sent the descriptor table by the monitor thread, other peers are not affected
   monitorTickle.Signal();
   return Confirmed;
 }
@@ -696,8 +779,7 @@ H323Transaction::Response H323PeerElement::HandleServiceRequest(H501ServiceReque
 PBoolean H323PeerElement::OnReceiveServiceRequest(const H501PDU & pdu, const H501_ServiceRequest & /*pduBody*/)
 {
   H501ServiceRequest * info = new H501ServiceRequest(*this, pdu);
-  if (!info->HandlePDU())
-    delete info;
+  HandleRequest(info);
 
   return FALSE;
 }
@@ -852,14 +934,15 @@ PBoolean H323PeerElement::AddDescriptor(const OpalGloballyUniqueID & descriptorI
   {
     PWaitAndSignal m(aliasMutex);
     if (descriptor != NULL) {
-      RemoveDescriptorInformation(descriptor->addressTemplates);
-
       // only update if the update time is later than what we already have
       if (updateTime < descriptor->lastChanged) {
         PTRACE(4, "PeerElement\tNot updating descriptor " << descriptorID << " as " << updateTime << " < " << descriptor->lastChanged);
         return TRUE;
       }
 
+      RemoveDescriptorInformation(descriptorID, descriptor->addressTemplates);
+      descriptor->addressTemplates = addressTemplates;
+
     } else {
       add = TRUE;
       descriptor                   = CreateDescriptor(descriptorID);
@@ -870,36 +953,7 @@ PBoolean H323PeerElement::AddDescriptor(const OpalGloballyUniqueID & descriptorI
     descriptor->lastChanged = PTime();
 
     // add all patterns and transport addresses to secondary lookup tables
-    PINDEX i, j, k;
-    for (i = 0; i < descriptor->addressTemplates.GetSize(); i++) {
-      H501_AddressTemplate & addressTemplate = addressTemplates[i];
-
-      // add patterns for this descriptor
-      for (j = 0; j < addressTemplate.m_pattern.GetSize(); j++) {
-        H501_Pattern & pattern = addressTemplate.m_pattern[j];
-        switch (pattern.GetTag()) {
-          case H501_Pattern::e_specific:
-            specificAliasToDescriptorID.Append(CreateAliasKey((H225_AliasAddress &)pattern, descriptorID, i, FALSE));
-            break;
-          case H501_Pattern::e_wildcard:
-            wildcardAliasToDescriptorID.Append(CreateAliasKey((H225_AliasAddress &)pattern, descriptorID, i, TRUE));
-            break;
-          case H501_Pattern::e_range:
-            break;
-        }
-      }
-
-      // add transport addresses for this descriptor
-      H501_ArrayOf_RouteInformation & routeInfos = addressTemplate.m_routeInfo;
-      for (j = 0; j < routeInfos.GetSize(); j++) {
-        H501_ArrayOf_ContactInformation & contacts = routeInfos[j].m_contacts;
-        for (k = 0; k < contacts.GetSize(); k++) {
-          H501_ContactInformation & contact = contacts[k];
-          H225_AliasAddress & transportAddress = contact.m_transportAddress;
-          transportAddressToDescriptorID.Append(CreateAliasKey((H225_AliasAddress &)transportAddress, descriptorID, i));
-        }
-      }
-    }
+    AddDescriptorInformation(descriptorID, descriptor->addressTemplates);
   }
 
   if (!add)
@@ -909,13 +963,15 @@ PBoolean H323PeerElement::AddDescriptor(const OpalGloballyUniqueID & descriptorI
     OnNewDescriptor(*descriptor);
   }
 
+  MarkDescriptorChanged(*descriptor, H323PeerElementDescriptor::Dirty);
+
   // do the update now, or later
   if (now) {
-    PTRACE(2, "PeerElement\tDescriptor " << descriptorID << " added/updated");
-    UpdateDescriptor(descriptor, updateType);
-  } else if (descriptor->state != H323PeerElementDescriptor::Deleted) {
-    PTRACE(2, "PeerElement\tDescriptor " << descriptorID << " queued to be added");
-    descriptor->state = H323PeerElementDescriptor::Dirty;
+    PTRACE(2, "PeerElement\tDescriptor " << descriptorID << " " << (updateType == H501_UpdateInformation_updateType::e_added ? "added" : "updated"));
+    descriptor.SetSafetyMode(PSafeReference);
+    SendDescriptorChanges();
+  } else {
+    PTRACE(2, "PeerElement\tDescriptor " << descriptorID << " queued to be " << (add ? "added" : "updated"));
     monitorTickle.Signal();
   }
 
@@ -927,28 +983,110 @@ H323PeerElement::AliasKey * H323PeerElement::CreateAliasKey(const H225_AliasAddr
   return new AliasKey(alias, id, pos, wild);
 }
 
-void H323PeerElement::RemoveDescriptorInformation(const H501_ArrayOf_AddressTemplate & addressTemplates)
+PString H323PeerElement::GetAliasIndexKey(const H225_AliasAddress & alias, PBoolean wild)
+{
+  PString str = H323GetAliasAddressString(alias);
+
+  if (wild) {
+    switch (alias.GetTag()) {
+      case H225_AliasAddress::e_dialedDigits :
+      case H225_AliasAddress::e_partyNumber :
+        break;
+      default :
+        // domain wildcards may be written as "@domain" or "*.domain"
+        if (str.NumCompare("*.") == PObject::EqualTo)
+          str.Delete(0, 2);
+        else if (str.NumCompare("@") == PObject::EqualTo)
+          str.Delete(0, 1);
+    }
+  }
+
+  return PString(PString::Unsigned, alias.GetTag()) + ':' + str;
+}
+
+
+void H323PeerElement::AddAliasKey(AliasKeyIndex & index,
+                                  const H225_AliasAddress & alias,
+                                  const OpalGloballyUniqueID & id,
+                                  PINDEX pos,
+                                  PBoolean wild)
+{
+  index.insert(AliasKeyIndex::value_type(GetAliasIndexKey(alias, wild), CreateAliasKey(alias, id, pos, wild)));
+}
+
+
+void H323PeerElement::RemoveAliasKey(AliasKeyIndex & index,
+                                     const H225_AliasAddress & alias,
+                                     const OpalGloballyUniqueID & id,
+                                     PBoolean wild)
+{
+  std::pair<AliasKeyIndex::iterator, AliasKeyIndex::iterator> range = index.equal_range(GetAliasIndexKey(alias, wild));
+  AliasKeyIndex::iterator it = range.first;
+  while (it != range.second) {
+    if (it->second->id == id) {
+      delete it->second;
+      index.erase(it++);
+    }
+    else
+      ++it;
+  }
+}
+
+
+void H323PeerElement::AddDescriptorInformation(const OpalGloballyUniqueID & descriptorID,
+                                               const H501_ArrayOf_AddressTemplate & addressTemplates)
+{
+  PWaitAndSignal m(aliasMutex);
+  PINDEX i, j, k;
+
+  for (i = 0; i < addressTemplates.GetSize(); i++) {
+    const H501_AddressTemplate & addressTemplate = addressTemplates[i];
+
+    // add patterns for this descriptor
+    for (j = 0; j < addressTemplate.m_pattern.GetSize(); j++) {
+      const H501_Pattern & pattern = addressTemplate.m_pattern[j];
+      switch (pattern.GetTag()) {
+        case H501_Pattern::e_specific:
+          AddAliasKey(specificAliasToDescriptorID, (const H225_AliasAddress &)pattern, descriptorID, i, FALSE);
+          break;
+        case H501_Pattern::e_wildcard:
+          AddAliasKey(wildcardAliasToDescriptorID, (const H225_AliasAddress &)pattern, descriptorID, i, TRUE);
+          break;
+        case H501_Pattern::e_range:
+          break;
+      }
+    }
+
+    // add transport addresses for this descriptor
+    const H501_ArrayOf_RouteInformation & routeInfos = addressTemplate.m_routeInfo;
+    for (j = 0; j < routeInfos.GetSize(); j++) {
+      const H501_ArrayOf_ContactInformation & contacts = routeInfos[j].m_contacts;
+      for (k = 0; k < contacts.GetSize(); k++)
+        AddAliasKey(transportAddressToDescriptorID, contacts[k].m_transportAddress, descriptorID, i);
+    }
+  }
+}
+
+
+void H323PeerElement::RemoveDescriptorInformation(const OpalGloballyUniqueID & descriptorID,
+                                                  const H501_ArrayOf_AddressTemplate & addressTemplates)
 {
   PWaitAndSignal m(aliasMutex);
-  PINDEX i, j, k, idx;
+  PINDEX i, j, k;
 
   // remove all patterns and transport addresses for this descriptor
   for (i = 0; i < addressTemplates.GetSize(); i++) {
-    H501_AddressTemplate & addressTemplate = addressTemplates[i];
+    const H501_AddressTemplate & addressTemplate = addressTemplates[i];
 
     // remove patterns for this descriptor
     for (j = 0; j < addressTemplate.m_pattern.GetSize(); j++) {
-      H501_Pattern & pattern = addressTemplate.m_pattern[j];
+      const H501_Pattern & pattern = addressTemplate.m_pattern[j];
       switch (pattern.GetTag()) {
         case H501_Pattern::e_specific:
-          idx = specificAliasToDescriptorID.GetValuesIndex((H225_AliasAddress &)pattern);
-          if (idx != P_MAX_INDEX)
-            specificAliasToDescriptorID.RemoveAt(idx);
+          RemoveAliasKey(specificAliasToDescriptorID, (const H225_AliasAddress &)pattern, descriptorID, FALSE);
           break;
         case H501_Pattern::e_wildcard:
-          idx = wildcardAliasToDescriptorID.GetValuesIndex((H225_AliasAddress &)pattern);
-          if (idx != P_MAX_INDEX)
-            wildcardAliasToDescriptorID.RemoveAt(idx);
+          RemoveAliasKey(wildcardAliasToDescriptorID, (const H225_AliasAddress &)pattern, descriptorID, TRUE);
           break;
         case H501_Pattern::e_range:
           break;
@@ -956,20 +1094,89 @@ void H323PeerElement::RemoveDescriptorInformation(const H501_ArrayOf_AddressTemp
     }
 
     // remove transport addresses for this descriptor
-    H501_ArrayOf_RouteInformation & routeInfos = addressTemplate.m_routeInfo;
+    const H501_ArrayOf_RouteInformation & routeInfos = addressTemplate.m_routeInfo;
     for (j = 0; j < routeInfos.GetSize(); j++) {
-      H501_ArrayOf_ContactInformation & contacts = routeInfos[i].m_contacts;
-      for (k = 0; k < contacts.GetSize(); k++) {
-        H501_ContactInformation & contact = contacts[k];
-        H225_AliasAddress & transportAddress = contact.m_transportAddress;
-        idx = transportAddressToDescriptorID.GetValuesIndex(transportAddress);
-        if (idx != P_MAX_INDEX)
-          transportAddressToDescriptorID.RemoveAt(idx);
+      const H501_ArrayOf_ContactInformation & contacts = routeInfos[j].m_contacts;
+      for (k = 0; k < contacts.GetSize(); k++)
+        RemoveAliasKey(transportAddressToDescriptorID, contacts[k].m_transportAddress, descriptorID);
+    }
+  }
+}
+
+
+const H323PeerElement::AliasKey * H323PeerElement::FindAliasKey(const H225_AliasAddress & alias) const
+{
+  AliasKeyIndex::const_iterator it = specificAliasToDescriptorID.find(GetAliasIndexKey(alias));
+  if (it != specificAliasToDescriptorID.end())
+    return it->second;
+
+  if (wildcardAliasToDescriptorID.empty())
+    return NULL;
+
+  PString type = PString(PString::Unsigned, alias.GetTag()) + ':';
+  PString str = H323GetAliasAddressString(alias);
+
+  switch (alias.GetTag()) {
+    case H225_AliasAddress::e_dialedDigits :
+    case H225_AliasAddress::e_partyNumber :
+      // longest matching prefix
+      for (PINDEX len = str.GetLength(); len > 0; len--) {
+        it = wildcardAliasToDescriptorID.find(type + str.Left(len));
+        if (it != wildcardAliasToDescriptorID.end())
+          return it->second;
+      }
+      break;
+
+    default : {
+      it = wildcardAliasToDescriptorID.find(type + str);
+      if (it != wildcardAliasToDescriptorID.end())
+        return it->second;
+
+      // nearest matching domain
+      PINDEX at = str.Find('@');
+      if (at == P_MAX_INDEX)
+        break;
+      PString domain = str.Mid(at+1);
+      while (!domain.IsEmpty()) {
+        it = wildcardAliasToDescriptorID.find(type + domain);
+        if (it != wildcardAliasToDescriptorID.end())
+          return it->second;
+        PINDEX dot = domain.Find('.');
+        if (dot == P_MAX_INDEX)
+          break;
+        domain = domain.Mid(dot+1);
       }
     }
   }
+
+  return NULL;
 }
 
+
+PSafePtr<H323PeerElementDescriptor> H323PeerElement::FindDescriptor(const H225_AliasAddress & alias,
+                                                                    PINDEX & templateIndex,
+                                                                    PSafetyMode mode)
+{
+  OpalGloballyUniqueID descriptorID("");
+
+  {
+    PWaitAndSignal m(aliasMutex);
+    const AliasKey * key = FindAliasKey(alias);
+    if (key == NULL)
+      return NULL;
+    descriptorID = key->id;
+    templateIndex = key->pos;
+  }
+
+  PSafePtr<H323PeerElementDescriptor> descriptor = descriptors.FindWithLock(H323PeerElementDescriptor(descriptorID), mode);
+  if (descriptor != NULL && (descriptor->state == H323PeerElementDescriptor::Deleted ||
+                             templateIndex >= descriptor->addressTemplates.GetSize()))
+    return NULL;
+
+  return descriptor;
+}
+
+
 PBoolean H323PeerElement::DeleteDescriptor(const PString & str, PBoolean now)
 {
   H225_AliasAddress alias;
@@ -984,10 +1191,10 @@ PBoolean H323PeerElement::DeleteDescriptor(const H225_AliasAddress & alias, PBoo
   // find the descriptor ID for the descriptor
   {
     PWaitAndSignal m(aliasMutex);
-    PINDEX idx = specificAliasToDescriptorID.GetValuesIndex(alias);
-    if (idx == P_MAX_INDEX)
+    AliasKeyIndex::const_iterator it = specificAliasToDescriptorID.find(GetAliasIndexKey(alias));
+    if (it == specificAliasToDescriptorID.end())
       return FALSE;
-    descriptorID = ((AliasKey &)specificAliasToDescriptorID[idx]).id;
+    descriptorID = it->second->id;
   }
 
   return DeleteDescriptor(descriptorID, now);
@@ -1002,59 +1209,181 @@ PBoolean H323PeerElement::DeleteDescriptor(const OpalGloballyUniqueID & descript
 
   OnRemoveDescriptor(*descriptor);
 
-  RemoveDescriptorInformation(descriptor->addressTemplates);
+  RemoveDescriptorInformation(descriptorID, descriptor->addressTemplates);
+
+  // the descriptor is kept until every peer has been told it is deleted
+  MarkDescriptorChanged(*descriptor, H323PeerElementDescriptor::Deleted);
 
-  // delete the descriptor, or mark it as to be deleted
   if (now) {
     PTRACE(2, "PeerElement\tDescriptor " << descriptorID << " deleted");
-    UpdateDescriptor(descriptor, H501_UpdateInformation_updateType::e_deleted);
+    descriptor.SetSafetyMode(PSafeReference);
+    SendDescriptorChanges();
   } else {
     PTRACE(2, "PeerElement\tDescriptor for " << descriptorID << " queued to be deleted");
-    descriptor->state = H323PeerElementDescriptor::Deleted;
     monitorTickle.Signal();
   }
 
   return TRUE;
 }
 
+void H323PeerElement::MarkDescriptorChanged(H323PeerElementDescriptor & descriptor, H323PeerElementDescriptor::States state)
+{
+  PWaitAndSignal m(descriptorVersionMutex);
+  descriptor.state   = state;
+  descriptor.version = ++descriptorTableVersion;
+}
+
 PBoolean H323PeerElement::UpdateDescriptor(H323PeerElementDescriptor * descriptor)
 {
-  H501_UpdateInformation_updateType::Choices updateType = H501_UpdateInformation_updateType::e_changed;
-  switch (descriptor->state) {
-    case H323PeerElementDescriptor::Clean:
-      return TRUE;
-    
-    case H323PeerElementDescriptor::Dirty:
-      break;
+  if (descriptor->state == H323PeerElementDescriptor::Clean)
+    return TRUE;
 
-    case H323PeerElementDescriptor::Deleted:
-      updateType = H501_UpdateInformation_updateType::e_deleted;
-      break;
+  return SendDescriptorChanges();
+}
+
+PBoolean H323PeerElement::UpdateDescriptor(H323PeerElementDescriptor * descriptor, H501_UpdateInformation_updateType::Choices updateType)
+{
+  if (updateType == H501_UpdateInformation_updateType::e_deleted) {
+    RemoveDescriptorInformation(descriptor->descriptorID, descriptor->addressTemplates);
+    MarkDescriptorChanged(*descriptor, H323PeerElementDescriptor::Deleted);
   }
+  else if (descriptor->state != H323PeerElementDescriptor::Deleted)
+    MarkDescriptorChanged(*descriptor, H323PeerElementDescriptor::Dirty);
 
-  return UpdateDescriptor(descriptor, updateType);
+  return SendDescriptorChanges();
 }
 
-PBoolean H323PeerElement::UpdateDescriptor(H323PeerElementDescriptor * descriptor, H501_UpdateInformation_updateType::Choices updateType)
+PBoolean H323PeerElement::SendDescriptorChanges()
 {
-  if (updateType == H501_UpdateInformation_updateType::e_deleted)
-    descriptor->state = H323PeerElementDescriptor::Deleted;
-  else if (descriptor->state == H323PeerElementDescriptor::Deleted)
-    updateType = H501_UpdateInformation_updateType::e_deleted;
-  else if (descriptor->state == H323PeerElementDescriptor::Clean)
-    return TRUE;
-  else
-    descriptor->state = H323PeerElementDescriptor::Clean;
+  // take the service IDs first, as each relationship is locked again to record what it was sent
+  std::vector<OpalGloballyUniqueID> serviceIDs;
+  {
+    for (PSafePtr<H323PeerElementServiceRelationship> sr = GetFirstRemoteServiceRelationship(PSafeReadOnly); sr != NULL; sr++)
+      serviceIDs.push_back(sr->serviceID);
+  }
 
-  for (PSafePtr<H323PeerElementServiceRelationship> sr = GetFirstRemoteServiceRelationship(PSafeReadOnly); sr != NULL; sr++) {
-    PTRACE(4, "PeerElement\tUpdating descriptor " << descriptor->descriptorID << " for service ID " << sr->serviceID);
-    SendUpdateDescriptorByID(sr->serviceID, descriptor, updateType);
+  PBoolean allSent = TRUE;
+  for (size_t i = 0; i < serviceIDs.size(); i++) {
+    if (SendDescriptorChangesByID(serviceIDs[i]) == Confirmed)
+      continue;
+    PTRACE(3, "PeerElement\tDescriptor changes not sent for service ID " << serviceIDs[i] << ", will retry");
+    allSent = FALSE;
   }
 
-  if (descriptor->state == H323PeerElementDescriptor::Deleted)
-    descriptors.Remove(descriptor);
+  // find the oldest version any peer has
+  PUInt64 syncedVersion;
+  {
+    PWaitAndSignal m(descriptorVersionMutex);
+    syncedVersion = descriptorTableVersion;
+  }
+  {
+    for (PSafePtr<H323PeerElementServiceRelationship> sr = GetFirstRemoteServiceRelationship(PSafeReadOnly); sr != NULL; sr++) {
+      if (sr->descriptorVersion < syncedVersion)
+        syncedVersion = sr->descriptorVersion;
+    }
+  }
 
-  return TRUE;
+  // descriptors every peer has been sent are clean, deleted ones can now go
+  for (PSafePtr<H323PeerElementDescriptor> descriptor = GetFirstDescriptor(PSafeReadWrite); descriptor != NULL; descriptor++) {
+    PWaitAndSignal m(descriptorVersionMutex);
+    if (descriptor->state == H323PeerElementDescriptor::Clean || descriptor->version > syncedVersion)
+      continue;
+    if (descriptor->state == H323PeerElementDescriptor::Dirty)
+      descriptor->state = H323PeerElementDescriptor::Clean;
+    else
+      descriptors.Remove(descriptor);
+  }
+
+  return allSent;
+}
+
+H323PeerElement::Error H323PeerElement::SendDescriptorChangesByID(const OpalGloballyUniqueID & serviceID)
+{
+  PUInt64 peerVersion;
+  {
+    PSafePtr<H323PeerElementServiceRelationship> sr = remoteServiceRelationships.FindWithLock(H323PeerElementServiceRelationship(serviceID), PSafeReadOnly);
+    if (sr == NULL)
+      return NoServiceRelationship;
+    peerVersion = sr->descriptorVersion;
+  }
+
+  // every change up to this version is found by the scan below
+  PUInt64 tableVersion;
+  {
+    PWaitAndSignal m(descriptorVersionMutex);
+    tableVersion = descriptorTableVersion;
+  }
+
+  if (peerVersion >= tableVersion)
+    return Confirmed;
+
+  // a new peer may already have our descriptors from before a restart
+  std::map<PString, PString> peerDescriptors;
+  if (peerVersion == 0) {
+    H501PDU reply;
+    if (SendDescriptorIDRequestByID(serviceID, reply) == Confirmed) {
+      const H501_DescriptorIDConfirmation & replyBody = reply.m_body;
+      for (PINDEX i = 0; i < replyBody.m_descriptorInfo.GetSize(); i++)
+        peerDescriptors[OpalGloballyUniqueID(replyBody.m_descriptorInfo[i].m_descriptorID).AsString()] = replyBody.m_descriptorInfo[i].m_lastChanged;
+      PTRACE(3, "PeerElement\tPeer for service ID " << serviceID << " has " << peerDescriptors.size() << " descriptors");
+    }
+  }
+
+  H501_ArrayOf_UpdateInformation updates;
+  PINDEX sent = 0;
+  for (PSafePtr<H323PeerElementDescriptor> descriptor = GetFirstDescriptor(PSafeReadOnly); descriptor != NULL; descriptor++) {
+    H501_UpdateInformation_updateType::Choices updateType = H501_UpdateInformation_updateType::e_changed;
+    std::map<PString, PString>::const_iterator known = peerDescriptors.find(descriptor->descriptorID.AsString());
+
+    if (peerVersion != 0) {
+      // only what changed since the peer was last updated
+      if (descriptor->version <= peerVersion)
+        continue;
+      if (descriptor->state == H323PeerElementDescriptor::Deleted)
+        updateType = H501_UpdateInformation_updateType::e_deleted;
+    }
+    else if (descriptor->state == H323PeerElementDescriptor::Deleted) {
+      // a new peer only needs to hear of deletions it still has
+      if (known == peerDescriptors.end())
+        continue;
+      updateType = H501_UpdateInformation_updateType::e_deleted;
+    }
+    else if (known == peerDescriptors.end())
+      updateType = H501_UpdateInformation_updateType::e_added;
+    else if (known->second >= descriptor->lastChanged.AsString("yyyyMMddhhmmss", PTime::GMT))
+      continue;
+
+    PINDEX count = updates.GetSize();
+    updates.SetSize(count+1);
+    H501_UpdateInformation & info = updates[count];
+    info.m_descriptorInfo.SetTag(H501_UpdateInformation_descriptorInfo::e_descriptor);
+    info.m_updateType.SetTag(updateType);
+    descriptor->CopyTo(info.m_descriptorInfo);
+
+    if (count+1 >= DescriptorUpdateBatchSize) {
+      Error result = SendUpdateDescriptorsByID(serviceID, updates);
+      if (result != Confirmed)
+        return result;
+      sent += updates.GetSize();
+      updates.SetSize(0);
+    }
+  }
+
+  if (updates.GetSize() > 0) {
+    Error result = SendUpdateDescriptorsByID(serviceID, updates);
+    if (result != Confirmed)
+      return result;
+    sent += updates.GetSize();
+  }
+
+  PSafePtr<H323PeerElementServiceRelationship> sr = remoteServiceRelationships.FindWithLock(H323PeerElementServiceRelationship(serviceID), PSafeReadWrite);
+  if (sr == NULL)
+    return NoServiceRelationship;
+  if (sr->descriptorVersion < tableVersion)
+    sr->descriptorVersion = tableVersion;
+
+  PTRACE(3, "PeerElement\tSent " << sent << " descriptor changes to " << sr->peer << (peerVersion == 0 ? " for new service relationship" : ""));
+  return Confirmed;
 }
 
 ///////////////////////////////////////////////////////////
@@ -1090,6 +1419,30 @@ H323PeerElement::Error H323PeerElement::SendUpdateDescriptorByID(const OpalGloba
   return SendUpdateDescriptor(pdu, peer, descriptor, updateType);
 }
 
+H323PeerElement::Error H323PeerElement::SendUpdateDescriptorsByID(const OpalGloballyUniqueID & serviceID, 
+                                                           const H501_ArrayOf_UpdateInformation & updates)
+{
+  if (PAssertNULL(transport) == NULL)
+    return NoResponse;
+
+  H501PDU pdu;
+  H501_DescriptorUpdate & body = pdu.BuildDescriptorUpdate(GetNextSequenceNumber(), transport->GetLastReceivedAddress());
+  H323TransportAddress peer;
+
+  {
+    PSafePtr<H323PeerElementServiceRelationship> sr = remoteServiceRelationships.FindWithLock(H323PeerElementServiceRelationship(serviceID), PSafeReadOnly);
+    if (sr == NULL)
+      return NoServiceRelationship;
+
+    pdu.m_common.IncludeOptionalField(H501_MessageCommonInfo::e_serviceID);
+    pdu.m_common.m_serviceID = sr->serviceID;
+    peer = sr->peer;
+  }
+
+  body.m_updateInfo = updates;
+  return SendUpdateDescriptor(pdu, peer);
+}
+
 H323PeerElement::Error H323PeerElement::SendUpdateDescriptorByAddr(const H323TransportAddress & peer, 
                                                               H323PeerElementDescriptor * descriptor, 
                                                H501_UpdateInformation_updateType::Choices updateType)
@@ -1106,6 +1459,21 @@ H323PeerElement::Error H323PeerElement::SendUpdateDescriptor(H501PDU & pdu,
                                           const H323TransportAddress & peer, 
                                            H323PeerElementDescriptor * descriptor,
                             H501_UpdateInformation_updateType::Choices updateType)
+{
+  H501_DescriptorUpdate & body = pdu.m_body;
+
+  // add information
+  body.m_updateInfo.SetSize(1);
+  H501_UpdateInformation & info = body.m_updateInfo[0];
+  info.m_descriptorInfo.SetTag(H501_UpdateInformation_descriptorInfo::e_descriptor);
+  info.m_updateType.SetTag(updateType);
+  descriptor->CopyTo(info.m_descriptorInfo);
+
+  return SendUpdateDescriptor(pdu, peer);
+}
+
+H323PeerElement::Error H323PeerElement::SendUpdateDescriptor(H501PDU & pdu, 
+                                          const H323TransportAddress & peer)
 {
   if (PAssertNULL(transport) == NULL)
     return NoResponse;
@@ -1117,13 +1485,6 @@ H323PeerElement::Error H323PeerElement::SendUpdateDescriptor(H501PDU & pdu,
   PAssert(addrs.GetSize() > 0, "No interface addresses");
   H323SetAliasAddress(addrs[0], body.m_sender, H225_AliasAddress::e_transportID);
 
-  // add information
-  body.m_updateInfo.SetSize(1);
-  H501_UpdateInformation & info = body.m_updateInfo[0];
-  info.m_descriptorInfo.SetTag(H501_UpdateInformation_descriptorInfo::e_descriptor);
-  info.m_updateType.SetTag(updateType);
-  descriptor->CopyTo(info.m_descriptorInfo);
-
   // make the request
   Request request(pdu.GetSequenceNumber(), pdu, peer);
   if (MakeRequest(request))
@@ -1143,16 +1504,91 @@ H323PeerElement::Error H323PeerElement::SendUpdateDescriptor(H501PDU & pdu,
   return Rejected;
 }
 
-H323Transaction::Response H323PeerElement::OnDescriptorUpdate(H501DescriptorUpdate & /*info*/)
+H323Transaction::Response H323PeerElement::OnDescriptorUpdate(H501DescriptorUpdate & info)
 {
-  return H323Transaction::Ignore;
+  // only peers with a service relationship may change the descriptor table
+  if (!info.requestCommon.HasOptionalField(H501_MessageCommonInfo::e_serviceID))
+    return H323Transaction::Ignore;
+
+  OpalGloballyUniqueID serviceID(info.requestCommon.m_serviceID);
+  PSafePtr<H323PeerElementServiceRelationship> sr = localServiceRelationships.FindWithLock(H323PeerElementServiceRelationship(serviceID), PSafeReadOnly);
+  if (sr == NULL) {
+    PTRACE(2, "PeerElement\tIgnoring DescriptorUpdate with unknown service ID " << serviceID << " from " << info.GetReplyAddress());
+    return H323Transaction::Ignore;
+  }
+
+  for (PINDEX i = 0; i < info.du.m_updateInfo.GetSize(); i++)
+    ApplyDescriptorUpdate(sr->ordinal, info.du.m_updateInfo[i]);
+
+  info.confirmCommon.IncludeOptionalField(H501_MessageCommonInfo::e_serviceID);
+  info.confirmCommon.m_serviceID = sr->serviceID;
+  return H323Transaction::Confirm;
+}
+
+PBoolean H323PeerElement::ApplyDescriptorUpdate(const POrdinalKey & creator, const H501_UpdateInformation & update)
+{
+  OpalGloballyUniqueID descriptorID("");
+  if (update.m_descriptorInfo.GetTag() == H501_UpdateInformation_descriptorInfo::e_descriptor) {
+    const H501_Descriptor & body = update.m_descriptorInfo;
+    descriptorID = body.m_descriptorInfo.m_descriptorID;
+  }
+  else
+    descriptorID = (const H225_GloballyUniqueID &)update.m_descriptorInfo;
+
+  PSafePtr<H323PeerElementDescriptor> descriptor = descriptors.FindWithLock(H323PeerElementDescriptor(descriptorID), PSafeReadWrite);
+
+  // a peer may only change the descriptors it told us about
+  if (descriptor != NULL && descriptor->creator != creator) {
+    PTRACE(2, "PeerElement\tIgnoring update of descriptor " << descriptorID << " not sent by this peer");
+    return FALSE;
+  }
+
+  if (update.m_updateType.GetTag() == H501_UpdateInformation_updateType::e_deleted) {
+    if (descriptor == NULL)
+      return FALSE;
+    OnRemoveDescriptor(*descriptor);
+    RemoveDescriptorInformation(descriptorID, descriptor->addressTemplates);
+    descriptors.Remove(descriptor);
+    PTRACE(4, "PeerElement\tRemoved descriptor " << descriptorID << " sent by peer");
+    return TRUE;
+  }
+
+  if (update.m_descriptorInfo.GetTag() != H501_UpdateInformation_descriptorInfo::e_descriptor)
+    return FALSE;
+
+  const H501_Descriptor & body = update.m_descriptorInfo;
+
+  // learned descriptors are stored clean, so they are not sent on to other peers
+  PBoolean add = descriptor == NULL;
+  if (add) {
+    descriptor = CreateDescriptor(descriptorID);
+    descriptor->creator = creator;
+  }
+  else
+    RemoveDescriptorInformation(descriptorID, descriptor->addressTemplates);
+
+  descriptor->addressTemplates = body.m_templates;
+  if (body.HasOptionalField(H501_Descriptor::e_gatekeeperID))
+    descriptor->gatekeeperID = body.m_gatekeeperID;
+  descriptor->lastChanged = PTime();
+  descriptor->state = H323PeerElementDescriptor::Clean;
+  AddDescriptorInformation(descriptorID, descriptor->addressTemplates);
+
+  if (add) {
+    descriptors.Append(descriptor);
+    OnNewDescriptor(*descriptor);
+  }
+  else
+    OnUpdateDescriptor(*descriptor);
+
+  PTRACE(4, "PeerElement\t" << (add ? "Added" : "Updated") << " descriptor " << descriptorID << " sent by peer");
+  return TRUE;
 }
 
 PBoolean H323PeerElement::OnReceiveDescriptorUpdate(const H501PDU & pdu, const H501_DescriptorUpdate & /*pduBody*/)
 {
   H501DescriptorUpdate * info = new H501DescriptorUpdate(*this, pdu);
-  if (!info->HandlePDU())
-    delete info;
+  HandleRequest(info);
 
   return FALSE;
 }
@@ -1168,6 +1604,91 @@ PBoolean H323PeerElement::OnReceiveDescriptorUpdateACK(const H501PDU & pdu, cons
   return TRUE;
 }
 
+H323PeerElement::Error H323PeerElement::SendDescriptorIDRequestByID(const OpalGloballyUniqueID & serviceID, 
+                                                                                     H501PDU & confirmPDU)
+{
+  if (PAssertNULL(transport) == NULL)
+    return NoResponse;
+
+  H501PDU pdu;
+  pdu.BuildDescriptorIDRequest(GetNextSequenceNumber(), transport->GetLastReceivedAddress());
+  H323TransportAddress peer;
+
+  {
+    PSafePtr<H323PeerElementServiceRelationship> sr = remoteServiceRelationships.FindWithLock(H323PeerElementServiceRelationship(serviceID), PSafeReadOnly);
+    if (sr == NULL)
+      return NoServiceRelationship;
+
+    pdu.m_common.IncludeOptionalField(H501_MessageCommonInfo::e_serviceID);
+    pdu.m_common.m_serviceID = sr->serviceID;
+    peer = sr->peer;
+  }
+
+  Request request(pdu.GetSequenceNumber(), pdu, peer);
+  request.responseInfo = &confirmPDU;
+  if (MakeRequest(request))
+    return Confirmed;
+
+  switch (request.responseResult) {
+    case Request::NoResponseReceived :
+      PTRACE(2, "PeerElement\tDescriptorIDRequest to " << peer << " failed due to no response");
+      return NoResponse;
+
+    case Request::RejectReceived:
+      PTRACE(2, "PeerElement\tDescriptorIDRequest to " << peer << " rejected for reason " << request.rejectReason);
+      break;
+
+    default:
+      PTRACE(2, "PeerElement\tDescriptorIDRequest to " << peer << " refused with unknown response " << (int)request.responseResult);
+      break;
+  }
+
+  return Rejected;
+}
+
+H323Transaction::Response H323PeerElement::OnDescriptorIDRequest(H501DescriptorIDRequest & info)
+{
+  // only peers with a service relationship are answered
+  if (!info.requestCommon.HasOptionalField(H501_MessageCommonInfo::e_serviceID) ||
+      localServiceRelationships.FindWithLock(H323PeerElementServiceRelationship(OpalGloballyUniqueID(info.requestCommon.m_serviceID)),
+                                             PSafeReference) == NULL) {
+    info.SetRejectReason(H501_DescriptorIDRejectionReason::e_unknownServiceID);
+    return H323Transaction::Reject;
+  }
+
+  for (PSafePtr<H323PeerElementDescriptor> descriptor = GetFirstDescriptor(PSafeReadOnly); descriptor != NULL; descriptor++) {
+    if (descriptor->state == H323PeerElementDescriptor::Deleted)
+      continue;
+    PINDEX count = info.dcf.m_descriptorInfo.GetSize();
+    info.dcf.m_descriptorInfo.SetSize(count+1);
+    info.dcf.m_descriptorInfo[count].m_descriptorID = descriptor->descriptorID;
+    info.dcf.m_descriptorInfo[count].m_lastChanged  = descriptor->lastChanged.AsString("yyyyMMddhhmmss", PTime::GMT);
+  }
+
+  info.confirmCommon.IncludeOptionalField(H501_MessageCommonInfo::e_serviceID);
+  info.confirmCommon.m_serviceID = info.requestCommon.m_serviceID;
+  return H323Transaction::Confirm;
+}
+
+PBoolean H323PeerElement::OnReceiveDescriptorIDRequest(const H501PDU & pdu, const H501_DescriptorIDRequest & /*pduBody*/)
+{
+  H501DescriptorIDRequest * info = new H501DescriptorIDRequest(*this, pdu);
+  HandleRequest(info);
+
+  return FALSE;
+}
+
+PBoolean H323PeerElement::OnReceiveDescriptorIDConfirmation(const H501PDU & pdu, const H501_DescriptorIDConfirmation & pduBody)
+{
+  if (!H323_AnnexG::OnReceiveDescriptorIDConfirmation(pdu, pduBody))
+    return FALSE;
+
+  if (lastRequest->responseInfo != NULL)
+    *(H501PDU *)lastRequest->responseInfo = pdu;
+
+  return TRUE;
+}
+
 ///////////////////////////////////////////////////////////
 //
 // access request functions
@@ -1422,15 +1943,36 @@ H323PeerElement::Error H323PeerElement::SendAccessRequestByAddr(const H323Transp
 
 H323Transaction::Response H323PeerElement::OnAccessRequest(H501AccessRequest & info)
 {
-  info.SetRejectReason(H501_AccessRejectionReason::e_noServiceRelationship);
+  // only peers with a service relationship are answered
+  if (!info.requestCommon.HasOptionalField(H501_MessageCommonInfo::e_serviceID) ||
+      localServiceRelationships.FindWithLock(H323PeerElementServiceRelationship(OpalGloballyUniqueID(info.requestCommon.m_serviceID)),
+                                             PSafeReference) == NULL) {
+    info.SetRejectReason(H501_AccessRejectionReason::e_noServiceRelationship);
+    return H323Transaction::Reject;
+  }
+
+  // answer from the local descriptor table
+  const H225_ArrayOf_AliasAddress & destAliases = info.arq.m_destinationInfo.m_logicalAddresses;
+  for (PINDEX i = 0; i < destAliases.GetSize(); i++) {
+    PINDEX templateIndex;
+    PSafePtr<H323PeerElementDescriptor> descriptor = FindDescriptor(destAliases[i], templateIndex);
+    if (descriptor != NULL) {
+      PTRACE(4, "PeerElement\tAccessRequest for " << destAliases[i] << " matched descriptor " << descriptor->descriptorID);
+      info.acf.m_templates.SetSize(1);
+      info.acf.m_templates[0] = descriptor->addressTemplates[templateIndex];
+      info.acf.m_partialResponse = FALSE;
+      return H323Transaction::Confirm;
+    }
+  }
+
+  info.SetRejectReason(H501_AccessRejectionReason::e_noMatch);
   return H323Transaction::Reject;
 }
 
 PBoolean H323PeerElement::OnReceiveAccessRequest(const H501PDU & pdu, const H501_AccessRequest & /*pduBody*/)
 {
   H501AccessRequest * info = new H501AccessRequest(*this, pdu);
-  if (!info->HandlePDU())
-    delete info;
+  HandleRequest(info);
 
   return FALSE;
 }
@@ -99,6 +99,120 @@ static WORD fcstable[256] = {
 	0x7bc7, 0x6a4e, 0x58d5, 0x495c, 0x3de3, 0x2c6a, 0x1ef1, 0x0f78
 };
 
+/*
+ * Tables for slice-by-8 FCS calculation, fcstable is the first slice
+ */
+static WORD fcsSlices[8][256];
+
+/*
+ * Bit stuffing a whole octet at a time. Indexed by the count of consecutive
+ * one bits sent before it and the octet, the entry holds the bits to send,
+ * first bit in the most significant position, with a zero inserted after
+ * every five ones.
+ */
+struct Q922_StuffEntry {
+  WORD bits;
+  BYTE length;
+  BYTE ones;      // consecutive ones at the end
+};
+static Q922_StuffEntry stuffTable[5][256];
+
+/*
+ * Bit unstuffing eight received bits at a time. Indexed by the count of
+ * consecutive one bits received before them and the bits, first received
+ * in the most significant position. Stops early at a sixth one, part of a
+ * FLAG or ABORT sequence, in which case ones is 6.
+ */
+struct Q922_UnstuffEntry {
+  BYTE bits;      // decoded bits, first in the least significant position
+  BYTE count;     // number of decoded bits
+  BYTE used;      // number of received bits used
+  BYTE ones;
+};
+static Q922_UnstuffEntry unstuffTable[6][256];
+
+static BYTE reverseTable[256];
+
+static void Q922_Unstuff(BYTE ones, BYTE raw, unsigned rawBits, Q922_UnstuffEntry & entry)
+{
+  entry.bits = 0;
+  entry.count = 0;
+  entry.used = 0;
+
+  for (unsigned i = 0; i < rawBits; i++) {
+    BYTE bit = (BYTE)((raw >> (7-i)) & 0x01);
+    entry.used++;
+
+    if (bit) {
+      if (++ones == 6)
+        break;
+      entry.bits |= (BYTE)(1 << entry.count);
+      entry.count++;
+    } else {
+      // a zero after five ones was inserted by the sender, discard it
+      if (ones != 5)
+        entry.count++;
+      ones = 0;
+    }
+  }
+
+  entry.ones = ones;
+}
+
+static class Q922_Tables
+{
+  public:
+    Q922_Tables()
+    {
+      unsigned i, j;
+
+      for (i = 0; i < 256; i++)
+        fcsSlices[0][i] = fcstable[i];
+      for (j = 1; j < 8; j++) {
+        for (i = 0; i < 256; i++)
+          fcsSlices[j][i] = (WORD)((fcsSlices[j-1][i] >> 8) ^ fcstable[fcsSlices[j-1][i] & 0xff]);
+      }
+
+      for (i = 0; i < 256; i++) {
+        BYTE reversed = 0;
+        for (j = 0; j < 8; j++) {
+          if (i & (1 << j))
+            reversed |= (BYTE)(0x80 >> j);
+        }
+        reverseTable[i] = reversed;
+      }
+
+      // data is sent out with LSB first
+      for (unsigned ones = 0; ones < 5; ones++) {
+        for (i = 0; i < 256; i++) {
+          Q922_StuffEntry & entry = stuffTable[ones][i];
+          entry.bits = 0;
+          entry.length = 0;
+          BYTE count = (BYTE)ones;
+          for (j = 0; j < 8; j++) {
+            BYTE bit = (BYTE)((i >> j) & 0x01);
+            entry.bits = (WORD)((entry.bits << 1) | bit);
+            entry.length++;
+            if (!bit)
+              count = 0;
+            else if (++count == 5) {
+              entry.bits <<= 1;
+              entry.length++;
+              count = 0;
+            }
+          }
+          entry.ones = count;
+        }
+      }
+
+      for (unsigned ones = 0; ones < 6; ones++) {
+        for (i = 0; i < 256; i++)
+          Q922_Unstuff((BYTE)ones, (BYTE)i, 8, unstuffTable[ones][i]);
+      }
+    }
+} q922Tables;
+
+
 Q922_Frame::Q922_Frame(PINDEX size)
 : PBYTEArray(Q922_HEADER_SIZE + size)
 {
@@ -127,31 +241,70 @@ PBoolean Q922_Frame::Decode(const BYTE *data, PINDEX size)
 
   PINDEX octetIndex = 0;
   BYTE bitIndex = 7;
-  BYTE onesCounter = 0;
 
   if(!FindFlagEnd(data, size, octetIndex, bitIndex))
 	return FALSE;
 
+  // Unstuff eight received bits at a time, collecting the decoded bits
+  // until there is an octet. The last two octets decoded are held back as
+  // they are the FCS when the end flag follows.
+  PINDEX bitPosition = octetIndex*8 + (7-bitIndex);
+  PINDEX bitCount = size*8;
+  DWORD decoded = 0;
+  unsigned decodedBits = 0;
+  BYTE onesCounter = 0;
+  PINDEX decodedOctets = 0;
   BYTE firstOctet = 0;
   BYTE secondOctet = 0;
 
-  // read the two first octets
-  if(octetIndex >= size || DecodeByte(data, &firstOctet, octetIndex, bitIndex, onesCounter) != Q922_OK)
-    return FALSE;
-
-  if(octetIndex >= size || DecodeByte(data, &secondOctet, octetIndex, bitIndex, onesCounter) != Q922_OK)
-	return FALSE;
-
   PINDEX arrayIndex = 0;
-  while(octetIndex < size) {
+  while(bitPosition < bitCount) {
+
+    PINDEX index = bitPosition >> 3;
+    unsigned shift = 8 - (unsigned)(bitPosition & 7);
+    WORD window = (WORD)(data[index] << 8);
+    if(index+1 < size)
+      window |= data[index+1];
+    BYTE raw = (BYTE)(window >> shift);
+
+    Q922_UnstuffEntry entry;
+    if(bitCount - bitPosition >= 8)
+      entry = unstuffTable[onesCounter][raw];
+    else
+      Q922_Unstuff(onesCounter, raw, (unsigned)(bitCount - bitPosition), entry);
+
+    bitPosition += entry.used;
+    decoded |= (DWORD)entry.bits << decodedBits;
+    decodedBits += entry.count;
+    onesCounter = entry.ones;
+
+    while(decodedBits >= 8) {
+      if(decodedOctets >= 2) {
+        theArray[arrayIndex] = firstOctet;
+        arrayIndex++;
+
+	    // Q922-frames must not exceed an information field size of 260 octets
+        if(arrayIndex >= 260+Q922_HEADER_SIZE) {
+          return FALSE;
+	    }
+      }
 
-    BYTE decodedByte = 0;
-    BYTE result = DecodeByte(data, &decodedByte, octetIndex, bitIndex, onesCounter);
+      firstOctet = secondOctet;
+      secondOctet = (BYTE)decoded;
+      decodedOctets++;
 
-	if(result == Q922_ERROR) {
-	  return FALSE;
+      decoded >>= 8;
+      decodedBits -= 8;
+    }
+
+    if(onesCounter == 6) {
 
-	} else if(result == Q922_FLAG) {
+      // Either FLAG or ERROR, the FLAG is byte aligned AND has only 6 consecutive ones
+      if(bitPosition >= bitCount)
+        return FALSE;
+      BYTE bit = (BYTE)((data[bitPosition >> 3] >> (7 - (bitPosition & 7))) & 0x01);
+      if(bit || decodedBits != 6 || decodedOctets < 2)
+        return FALSE;
 
       // Found end flag
       // FCS is contained in firstOctet and secondOctet.
@@ -171,18 +324,7 @@ PBoolean Q922_Frame::Decode(const BYTE *data, PINDEX size)
       }
 
 	  return FALSE;
-	}
-
-    theArray[arrayIndex] = firstOctet;
-    arrayIndex++;
-
-    firstOctet = secondOctet;
-    secondOctet = decodedByte;
-
-	// Q922-frames must not exceed an information field size of 260 octets
-    if(arrayIndex >= 260+Q922_HEADER_SIZE) {
-      return FALSE;
-	}
+    }
   }
 
   return FALSE;
@@ -372,55 +514,6 @@ PBoolean Q922_Frame::FindFlagEnd(const BYTE *buffer,
   return FALSE;
 }
 
-BYTE Q922_Frame::DecodeByte(const BYTE *buffer,
-							BYTE *destination,
-							PINDEX & octetIndex,
-							BYTE & bitIndex,
-							BYTE & onesCounter)
-{
-  // decoded byte is copied to destination.
-  // returns Q922_OK if decoding succesful,
-  // returns Q922_FLAG if ending FLAG detected,
-  // returns Q922_ERROR if there was an error
-
-  BYTE decodedByte = 0x00;
-
-  PINDEX i;
-  for(i = 0; i < 8; i++) {
-
-	BYTE bit = DecodeBit(buffer, octetIndex, bitIndex);
-
-	if(bit) {
-      onesCounter++;
-
-      if(onesCounter == 6) {
-
-        // Either FLAG or ERROR
-        bit = DecodeBit(buffer, octetIndex, bitIndex);
-
-		if(i == 6 && !bit)  { // FLAG is byte aligned AND has only 6 consecutive ones
-          return Q922_FLAG;
-        } else {
-          return Q922_ERROR;
-        }
-      }
-
-    } else {
-	  if(onesCounter == 5) {
-	    // discard bit, read again
-		bit = DecodeBit(buffer, octetIndex, bitIndex);
-	  }
-
-      onesCounter = 0;
-    }
-
-    decodedByte |= (bit << i);
-  }
-
-  *destination = decodedByte;
-  return Q922_OK;
-}
-
 BYTE Q922_Frame::DecodeBit(const BYTE *buffer,
 						   PINDEX & octetIndex,
 						   BYTE & bitIndex)
@@ -441,30 +534,12 @@ void Q922_Frame::EncodeOctet(BYTE octet, BYTE *buffer,
 							 BYTE & bitIndex,
 							 BYTE & onesCounter) const
 {
-  // data is sent out with LSB first, so we need
-  // to reverse the bit direction.
-  // In addition, it is required to insert a zero
-  // bit after 5 consecutive ones to avoid FLAG emulation
-
-  PINDEX i;
-  for(i = 0; i < 8; i++) {
-    // reading one bit from the octet and write it to the buffer
-    BYTE bit = (BYTE)((octet >> i) & 0x01);
-
-    EncodeBit(bit, buffer, octetIndex, bitIndex);
-
-    if(bit) {
-      onesCounter++;
-
-      if(onesCounter == 5) {
-        // insert a zero bit
-        EncodeBit(0, buffer, octetIndex, bitIndex);
-        onesCounter = 0;
-      }
-    } else {
-      onesCounter = 0;
-    }
-  }
+  // data is sent out with LSB first, and a zero bit is
+  // inserted after 5 consecutive ones to avoid FLAG emulation,
+  // both done by the table
+  const Q922_StuffEntry & entry = stuffTable[onesCounter][octet];
+  EncodeBits(entry.bits, entry.length, buffer, octetIndex, bitIndex);
+  onesCounter = entry.ones;
 }
 
 void Q922_Frame::EncodeOctetNoEscape(BYTE octet,
@@ -474,36 +549,38 @@ void Q922_Frame::EncodeOctetNoEscape(BYTE octet,
 {
   // data is sent out with LSB first, so we need
   // to reverse the bit direction.
-
-  PINDEX i;
-  for(i = 0; i < 8; i++) {
-    // reating one bit from the octet and write it to the buffer
-    BYTE bit = (BYTE)((octet >> i) & 0x01);
-
-    EncodeBit(bit, buffer, octetIndex, bitIndex);
-  }
+  EncodeBits(reverseTable[octet], 8, buffer, octetIndex, bitIndex);
 }
 
-void Q922_Frame::EncodeBit(BYTE bit,
-						   BYTE *buffer,
-						   PINDEX & octetIndex,
-						   BYTE & bitIndex) const
+void Q922_Frame::EncodeBits(WORD bits,
+						    BYTE length,
+						    BYTE *buffer,
+						    PINDEX & octetIndex,
+						    BYTE & bitIndex) const
 {
-  if(bitIndex == 7) {
-    buffer[octetIndex] = 0;
-  }
+  // writing the bits, first in the most significant position,
+  // as many at a time as fit in the current octet
+  while(length > 0) {
+    BYTE count = (BYTE)(bitIndex+1);
+    if(count > length)
+      count = length;
+
+    if(bitIndex == 7) {
+      buffer[octetIndex] = 0;
+    }
 
-  // TODO: Clang Analysizer determines
-  // The left expression of the compound assignment is an uninitialized value. The computed value will also be garbage
-  buffer[octetIndex] |= ((bit & 0x01) << bitIndex);
+    length = (BYTE)(length - count);
+    BYTE chunk = (BYTE)((bits >> length) & ((1 << count) - 1));
+    buffer[octetIndex] |= (BYTE)(chunk << (bitIndex+1-count));
 
-  // adjusting bit/byte index
-  if(bitIndex == 0) {
-    octetIndex++;
-    bitIndex = 8;
+    // adjusting bit/byte index
+    if(bitIndex < count) {
+      octetIndex++;
+      bitIndex = 7;
+    } else {
+      bitIndex = (BYTE)(bitIndex - count);
+    }
   }
-
-  bitIndex--;
 }
 
 WORD Q922_Frame::CalculateFCS(const BYTE *data, PINDEX length) const
@@ -511,6 +588,17 @@ WORD Q922_Frame::CalculateFCS(const BYTE *data, PINDEX length) const
   // initial value of FCS is all ones.
   WORD fcs = 0xffff;
 
+  // eight octets at a time
+  while(length >= 8) {
+    fcs ^= (WORD)(data[0] | (data[1] << 8));
+    fcs = fcsSlices[7][fcs & 0xff] ^ fcsSlices[6][fcs >> 8] ^
+          fcsSlices[5][data[2]] ^ fcsSlices[4][data[3]] ^
+          fcsSlices[3][data[4]] ^ fcsSlices[2][data[5]] ^
+          fcsSlices[1][data[6]] ^ fcsSlices[0][data[7]];
+    data += 8;
+    length -= 8;
+  }
+
   while(length--) {
     fcs = (fcs >> 8) ^ fcstable[(fcs ^ *data++) & 0xff];
   }
@@ -165,6 +165,7 @@ Q931::Q931()
   messageType = NationalEscapeMsg;
   fromDestination = FALSE;
   callReference = 0;
+  ClearIEs();
 }
 
 
@@ -181,9 +182,10 @@ Q931 & Q931::operator=(const Q931 & other)
   protocolDiscriminator = other.protocolDiscriminator;
   messageType = other.messageType;
 
-  informationElements.RemoveAll();
-  for (PINDEX i = 0; i < other.informationElements.GetSize(); i++)
-    informationElements.SetAt(other.informationElements.GetKeyAt(i), new PBYTEArray(other.informationElements.GetDataAt(i)));
+  // The element data is shared until either side changes it
+  memcpy(informationElements, other.informationElements, sizeof(informationElements));
+  ieData = other.ieData;
+  ieUsed = other.ieUsed;
 
   return *this;
 }
@@ -194,7 +196,7 @@ void Q931::BuildFacility(int callRef, PBoolean fromDest)
   messageType = FacilityMsg;
   callReference = callRef;
   fromDestination = fromDest;
-  informationElements.RemoveAll();
+  ClearIEs();
   PBYTEArray data;
   SetIE(FacilityIE, data);
 }
@@ -205,7 +207,7 @@ void Q931::BuildInformation(int callRef, PBoolean fromDest)
   messageType = InformationMsg;
   callReference = callRef;
   fromDestination = fromDest;
-  informationElements.RemoveAll();
+  ClearIEs();
 }
 
 
@@ -218,7 +220,7 @@ void Q931::BuildProgress(int callRef,
   messageType = ProgressMsg;
   callReference = callRef;
   fromDestination = fromDest;
-  informationElements.RemoveAll();
+  ClearIEs();
   SetProgressIndicator(description, codingStandard, location);
 }
 
@@ -228,7 +230,7 @@ void Q931::BuildNotify(int callRef, PBoolean fromDest)
   messageType = NotifyMsg;
   callReference = callRef;
   fromDestination = fromDest;
-  informationElements.RemoveAll();
+  ClearIEs();
 }
 
 
@@ -237,7 +239,7 @@ void Q931::BuildSetupAcknowledge(int callRef)
   messageType = SetupAckMsg;
   callReference = callRef;
   fromDestination = TRUE;
-  informationElements.RemoveAll();
+  ClearIEs();
 }
 
 
@@ -246,7 +248,7 @@ void Q931::BuildCallProceeding(int callRef)
   messageType = CallProceedingMsg;
   callReference = callRef;
   fromDestination = TRUE;
-  informationElements.RemoveAll();
+  ClearIEs();
 }
 
 
@@ -255,7 +257,7 @@ void Q931::BuildAlerting(int callRef)
   messageType = AlertingMsg;
   callReference = callRef;
   fromDestination = TRUE;
-  informationElements.RemoveAll();
+  ClearIEs();
 }
 
 
@@ -267,7 +269,7 @@ void Q931::BuildSetup(int callRef)
   else
     callReference = callRef;
   fromDestination = FALSE;
-  informationElements.RemoveAll();
+  ClearIEs();
   SetBearerCapabilities(TransferSpeech, 1);
 }
 
@@ -277,7 +279,7 @@ void Q931::BuildConnect(int callRef)
   messageType = ConnectMsg;
   callReference = callRef;
   fromDestination = TRUE;
-  informationElements.RemoveAll();
+  ClearIEs();
   //SetBearerCapabilities(TransferSpeech, 1); <- Codian interop issue - SH
 }
 
@@ -286,7 +288,7 @@ void Q931::BuildConnectAck(int callRef, PBoolean fromDest)
   messageType = ConnectAckMsg;
   callReference = callRef;
   fromDestination = fromDest;
-  informationElements.RemoveAll();
+  ClearIEs();
 }
 
 
@@ -295,7 +297,7 @@ void Q931::BuildStatus(int callRef, PBoolean fromDest)
   messageType = StatusMsg;
   callReference = callRef;
   fromDestination = fromDest;
-  informationElements.RemoveAll();
+  ClearIEs();
   SetCallState(CallState_Active);
   // Cause field as per Q.850
   SetCause(StatusEnquiryResponse);
@@ -307,7 +309,7 @@ void Q931::BuildStatusEnquiry(int callRef, PBoolean fromDest)
   messageType = StatusEnquiryMsg;
   callReference = callRef;
   fromDestination = fromDest;
-  informationElements.RemoveAll();
+  ClearIEs();
 }
 
 
@@ -316,14 +318,14 @@ void Q931::BuildReleaseComplete(int callRef, PBoolean fromDest)
   messageType = ReleaseCompleteMsg;
   callReference = callRef;
   fromDestination = fromDest;
-  informationElements.RemoveAll();
+  ClearIEs();
 }
 
 
 PBoolean Q931::Decode(const PBYTEArray & data)
 {
   // Clear all existing data before reading new
-  informationElements.RemoveAll();
+  ClearIEs();
 
   if (data.GetSize() < 5) // Packet too short
     return FALSE;
@@ -344,17 +346,18 @@ PBoolean Q931::Decode(const PBYTEArray & data)
 
   messageType = (MsgTypes)data[2+callRefLen];
 
-  // Have preamble, start getting the informationElements into buffers
+  // Have preamble, the elements are views into one copy of the PDU
+  ieData = PBYTEArray((const BYTE *)data, data.GetSize());
   PINDEX offset = 3+callRefLen;
   while (offset < data.GetSize()) {
     // Get field discriminator
     int discriminator = data[offset++];
 
-    PBYTEArray * item = new PBYTEArray;
+    PINDEX len = 0;
 
     // For discriminator with high bit set there is no data
     if ((discriminator & 0x80) == 0) {
-      int len = data[offset++];
+      len = data[offset++];
 
       if (discriminator == UserUserIE) {
         // Special case of User-user field. See 7.2.2.31/H.225.0v4.
@@ -366,7 +369,7 @@ PBoolean Q931::Decode(const PBYTEArray & data)
 
         // before decrementing the length, make sure it is not zero
         if (len == 0) {
-          delete item;
+          ClearIEs();
           return FALSE;
         }
 
@@ -375,15 +378,19 @@ PBoolean Q931::Decode(const PBYTEArray & data)
       }
 
       if (offset + len > data.GetSize()) {
-        delete item;
+        ClearIEs();
         return FALSE;
       }
-
-      memcpy(item->GetPointer(len), (const BYTE *)data+offset, len);
-      offset += len;
     }
 
-    informationElements.SetAt(discriminator, item);
+    InformationElement & element = informationElements[discriminator];
+    if (element.offset == P_MAX_INDEX)
+      ieUsed += len;
+    else
+      ieUsed += len - element.length;
+    element.offset = offset;
+    element.length = len;
+    offset += len;
   }
 
   return TRUE;
@@ -394,10 +401,10 @@ PBoolean Q931::Encode(PBYTEArray & data) const
 {
   PINDEX totalBytes = 5;
   unsigned discriminator;
-  for (discriminator = 0; discriminator < 256; discriminator++) {
-    if (informationElements.Contains(discriminator)) {
+  for (discriminator = 0; discriminator < NumIECodes; discriminator++) {
+    if (informationElements[discriminator].offset != P_MAX_INDEX) {
       if (discriminator < 128)
-        totalBytes += informationElements[discriminator].GetSize() +
+        totalBytes += informationElements[discriminator].length +
                             (discriminator != UserUserIE ? 2 : 4);
       else
         totalBytes++;
@@ -421,10 +428,10 @@ PBoolean Q931::Encode(PBYTEArray & data) const
   // The following assures disciminators are in ascending value order
   // as required by Q931 specification
   PINDEX offset = 5;
-  for (discriminator = 0; discriminator < 256; discriminator++) {
-    if (informationElements.Contains(discriminator)) {
+  for (discriminator = 0; discriminator < NumIECodes; discriminator++) {
+    if (informationElements[discriminator].offset != P_MAX_INDEX) {
       if (discriminator < 128) {
-        int len = informationElements[discriminator].GetSize();
+        int len = informationElements[discriminator].length;
 
         if (discriminator != UserUserIE) {
           data[offset++] = (BYTE)discriminator;
@@ -440,7 +447,7 @@ PBoolean Q931::Encode(PBYTEArray & data) const
           data[offset++] = 5;
         }
 
-        memcpy(&data[offset], (const BYTE *)informationElements[discriminator], len);
+        memcpy(&data[offset], (const BYTE *)ieData + informationElements[discriminator].offset, len);
         offset += len;
       }
       else
@@ -463,18 +470,18 @@ void Q931::PrintOn(ostream & strm) const
        << setw(indent+7)  << "from = " << (fromDestination ? "destination" : "originator") << '\n'
        << setw(indent+14) << "messageType = " << GetMessageTypeName() << '\n';
 
-  for (unsigned discriminator = 0; discriminator < 256; discriminator++) {
-    if (informationElements.Contains(discriminator)) {
+  for (unsigned discriminator = 0; discriminator < NumIECodes; discriminator++) {
+    if (informationElements[discriminator].offset != P_MAX_INDEX) {
+      PBYTEArray value = GetIE((InformationElementCodes)discriminator);
       strm << setw(indent+4) << "IE: " << (InformationElementCodes)discriminator;
       if (discriminator == CauseIE) {
-        if (informationElements[discriminator].GetSize() > 1)
-          strm << " - " << (CauseValues)(informationElements[discriminator][1]&0x7f);
+        if (value.GetSize() > 1)
+          strm << " - " << (CauseValues)(value[1]&0x7f);
       }
       strm << " = {\n"
            << hex << setfill('0') << resetiosflags(ios::floatfield)
            << setprecision(indent+2) << setw(16);
 
-      PBYTEArray value = informationElements[discriminator];
       if (value.GetSize() <= 32 || (flags&ios::floatfield) != ios::fixed)
         strm << value;
       else {
@@ -583,27 +590,88 @@ unsigned Q931::GenerateCallReference()
 
 PBoolean Q931::HasIE(InformationElementCodes ie) const
 {
-  return informationElements.Contains(POrdinalKey(ie));
+  return (unsigned)ie < NumIECodes && informationElements[ie].offset != P_MAX_INDEX;
 }
 
 
 PBYTEArray Q931::GetIE(InformationElementCodes ie) const
 {
-  if (informationElements.Contains(POrdinalKey(ie)))
-    return informationElements[ie];
+  const BYTE * data;
+  PINDEX length;
+  if (GetIE(ie, data, length))
+    return PBYTEArray(data, length);
 
   return PBYTEArray();
 }
 
 
+PBoolean Q931::GetIE(InformationElementCodes ie, const BYTE * & data, PINDEX & length) const
+{
+  if (!HasIE(ie))
+    return FALSE;
+
+  data = (const BYTE *)ieData + informationElements[ie].offset;
+  length = informationElements[ie].length;
+  return TRUE;
+}
+
+
 void Q931::SetIE(InformationElementCodes ie, const PBYTEArray & userData)
 {
-  informationElements.SetAt(ie, new PBYTEArray(userData));
+  if ((unsigned)ie >= NumIECodes)
+    return;
+
+  RemoveIE(ie);
+
+  // Appended, the space of a replaced element is reclaimed by CompactIEs()
+  PINDEX length = userData.GetSize();
+  PINDEX offset = ieData.GetSize();
+  if (length > 0)
+    memcpy(ieData.GetPointer(offset + length) + offset, (const BYTE *)userData, length);
+
+  informationElements[ie].offset = offset;
+  informationElements[ie].length = length;
+  ieUsed += length;
 }
 
 void Q931::RemoveIE(InformationElementCodes ie)
 {
-  informationElements.RemoveAt(ie);
+  if (!HasIE(ie))
+    return;
+
+  ieUsed -= informationElements[ie].length;
+  informationElements[ie].offset = P_MAX_INDEX;
+  informationElements[ie].length = 0;
+
+  if (ieData.GetSize() > 2*ieUsed + 1024)
+    CompactIEs();
+}
+
+
+void Q931::ClearIEs()
+{
+  for (PINDEX i = 0; i < NumIECodes; i++) {
+    informationElements[i].offset = P_MAX_INDEX;
+    informationElements[i].length = 0;
+  }
+  ieData.SetSize(0);
+  ieUsed = 0;
+}
+
+
+void Q931::CompactIEs()
+{
+  PBYTEArray compacted(ieUsed);
+  PINDEX offset = 0;
+  for (PINDEX i = 0; i < NumIECodes; i++) {
+    InformationElement & element = informationElements[i];
+    if (element.offset == P_MAX_INDEX)
+      continue;
+    memcpy(compacted.GetPointer() + offset, (const BYTE *)ieData + element.offset, element.length);
+    element.offset = offset;
+    offset += element.length;
+  }
+  ieData = compacted;
 }
 
 unsigned Q931::SetBearerTransferRate(unsigned bitrate)
@@ -41,6 +41,17 @@ static const char RFC2833Table1Events[] = "0123456789*#ABCD!";
 #define new PNEW
 
 
+/* Time between the repeats of a tone being sent */
+#define RFC2833_REPEAT_INTERVAL 50
+
+/* Time between the end packets, and how many are sent */
+#define RFC2833_END_INTERVAL 20
+#define RFC2833_END_REPEATS 3
+
+/* Time without a packet before a received tone is ended */
+#define RFC2833_RECEIVE_TIMEOUT 150
+
+
 ///////////////////////////////////////////////////////////////////////////////
 
 OpalRFC2833Info::OpalRFC2833Info(char t, unsigned d, unsigned ts)
@@ -64,8 +75,11 @@ OpalRFC2833::OpalRFC2833(const PNotifier & rx)
 #pragma warning(default:4355)
 #endif
     payloadType(RTP_DataFrame::IllegalPayloadType), receiveComplete(true),
-    receivedTone(0), receivedDuration(0), receiveTimestamp(0), receiveTimer(0), transmitState(TransmitIdle),
-    transmitCode(0), transmitTimestamp(0), transmitTimer(0)
+    receivedTone(0), receivedDuration(0), receiveTimestamp(0), transmitState(TransmitIdle),
+    transmitCode(0), transmitTimestamp(0),
+    scheduler(NULL), transmitSession(NULL), transmitFrame(4),
+    receiveDeadline(0), transmitStartTick(0), transmitEndTick(0), nextTransmitTick(0),
+    transmitDuration(0), endRepeats(0)
 {
   PTRACE(3, "RFC2833\tHandler created");
 
@@ -74,12 +88,45 @@ OpalRFC2833::OpalRFC2833(const PNotifier & rx)
 }
 
 
+OpalRFC2833::~OpalRFC2833()
+{
+  SetScheduler(NULL);
+}
+
+
+void OpalRFC2833::SetScheduler(OpalRFC2833Scheduler * newScheduler)
+{
+  mutex.Wait();
+  OpalRFC2833Scheduler * oldScheduler = scheduler;
+  scheduler = newScheduler;
+  mutex.Signal();
+
+  // Outside the mutex as the scheduler thread may be calling in
+  if (oldScheduler != NULL && oldScheduler != newScheduler)
+    oldScheduler->Remove(*this);
+}
+
+
+void OpalRFC2833::SetTransmitSession(RTP_Session * session)
+{
+  // The scheduler writes holding the mutex, so it is done with the old one on return
+  PWaitAndSignal m(mutex);
+  transmitSession = session;
+}
+
+
 PBoolean OpalRFC2833::SendTone(char tone, unsigned duration)
 {
   if (!BeginTransmit(tone))
     return FALSE;
 
-  transmitTimer = duration;
+  PWaitAndSignal m(mutex);
+  if (scheduler != NULL) {
+    transmitEndTick = PTimer::Tick().GetMilliSeconds() + duration;
+    scheduler->Schedule(*this, transmitEndTick);
+  }
+  else
+    transmitTimer = duration;
   return TRUE;
 }
 
@@ -102,6 +149,8 @@ PBoolean OpalRFC2833::BeginTransmit(char tone)
   transmitCode = (BYTE)(theChar-RFC2833Table1Events);
   transmitState = TransmitActive;
   transmitTimestamp = 0;
+  transmitEndTick = 0;
+  endRepeats = 0;
   PTRACE(3, "RFC2833\tBegin transmit tone='" << tone << '\'');
   return TRUE;
 }
@@ -118,6 +167,12 @@ PBoolean OpalRFC2833::EndTransmit()
 
   transmitState = TransmitEnding;
   PTRACE(3, "RFC2833\tEnd transmit tone='" << RFC2833Table1Events[transmitCode] << '\'');
+
+  // Send the end packets now when the scheduler is sending the tone
+  if (scheduler != NULL && transmitSession != NULL && transmitTimestamp != 0) {
+    nextTransmitTick = PTimer::Tick().GetMilliSeconds();
+    scheduler->Schedule(*this, nextTransmitTick);
+  }
   return TRUE;
 }
 
@@ -170,10 +225,10 @@ void OpalRFC2833::ReceivedPacket(RTP_DataFrame & frame,  H323_INT)
     // Starting a new event.
     receiveTimestamp = timestamp;
     receiveComplete = FALSE;
-    receiveTimer = 150;
+    SetReceiveTimeout();
   }
   else {
-    receiveTimer = 150;
+    SetReceiveTimeout();
     if (receiveComplete) {
       PTRACE(3, "RFC2833\tIgnoring duplicate packet.");
       return;
@@ -187,13 +242,30 @@ void OpalRFC2833::ReceivedPacket(RTP_DataFrame & frame,  H323_INT)
 
   receiveComplete = TRUE;
   receiveTimer.Stop();
+  receiveDeadline = 0;
 
   PTRACE(3, "RFC2833\tReceived end tone=" << receivedTone << " duration=" << receivedDuration);
   OnEndReceive(receivedTone, receivedDuration, receiveTimestamp);
 }
 
 
-void OpalRFC2833::ReceiveTimeout(PTimer &,  H323_INT)
+void OpalRFC2833::SetReceiveTimeout()
+{
+  if (scheduler == NULL) {
+    receiveTimer = RFC2833_RECEIVE_TIMEOUT;
+    return;
+  }
+
+  PInt64 now = PTimer::Tick().GetMilliSeconds();
+  // Only moves later, so the scheduler is told once per tone
+  PBoolean first = receiveDeadline == 0;
+  receiveDeadline = now + RFC2833_RECEIVE_TIMEOUT;
+  if (first)
+    scheduler->Schedule(*this, receiveDeadline);
+}
+
+
+void OpalRFC2833::ReceiveTimeout(H323Timer &,  H323_INT)
 {
   PWaitAndSignal m(mutex);
 
@@ -217,6 +289,17 @@ void OpalRFC2833::TransmitPacket(RTP_DataFrame & frame,  H323_INT param)
 
   PWaitAndSignal m(mutex);
 
+  if (transmitState == TransmitIdle)
+    return;
+
+  if (scheduler != NULL && transmitSession != NULL && transmitTimestamp != 0) {
+    // The scheduler is sending the tone, hold back the audio until it ends
+    frame.SetPayloadSize(0);
+    if (param != 0)
+      *(PBoolean *)param = FALSE;
+    return;
+  }
+
   //frame.SetMarker(transmitTimestamp == 0);
 
   unsigned actualTimestamp = frame.GetTimestamp();
@@ -244,13 +327,259 @@ void OpalRFC2833::TransmitPacket(RTP_DataFrame & frame,  H323_INT param)
          << " code='" << RFC2833Table1Events[transmitCode] << "'"
             " duration=" << duration << ' '
          << (transmitState == TransmitIdle ? "ending" : "continuing"));
+
+  // Started on this packet, the scheduler sends the rest from the session
+  if (scheduler != NULL && transmitSession != NULL && transmitState != TransmitIdle) {
+    transmitStartTick = PTimer::Tick().GetMilliSeconds();
+    nextTransmitTick = transmitStartTick + RFC2833_REPEAT_INTERVAL;
+    if (transmitState == TransmitEnding)
+      nextTransmitTick = transmitStartTick + RFC2833_END_INTERVAL;
+    scheduler->Schedule(*this, nextTransmitTick);
+  }
+}
+
+
+PInt64 OpalRFC2833::OnScheduled(PInt64 now)
+{
+  PWaitAndSignal m(mutex);
+
+  PInt64 next = 0;
+
+  if (receiveDeadline != 0) {
+    if (now < receiveDeadline)
+      next = receiveDeadline;
+    else {
+      receiveDeadline = 0;
+      if (!receiveComplete) {
+        receiveComplete = TRUE;
+        PTRACE(3, "RFC2833\tTimeout tone=" << receivedTone << " duration=" << receivedDuration);
+        OnEndReceive(receivedTone, receivedDuration, receiveTimestamp);
+      }
+    }
+  }
+
+  if (transmitEndTick != 0 && transmitState == TransmitActive) {
+    if (now < transmitEndTick) {
+      if (next == 0 || transmitEndTick < next)
+        next = transmitEndTick;
+    }
+    else {
+      transmitEndTick = 0;
+      transmitState = TransmitEnding;
+      PTRACE(3, "RFC2833\tEnd transmit tone='" << RFC2833Table1Events[transmitCode] << '\'');
+      if (transmitTimestamp != 0)
+        nextTransmitTick = now;
+    }
+  }
+
+  if (transmitState != TransmitIdle && transmitTimestamp != 0 && transmitSession != NULL) {
+    if (now >= nextTransmitTick)
+      WriteEvent(now);
+    if (transmitState != TransmitIdle && (next == 0 || nextTransmitTick < next))
+      next = nextTransmitTick;
+  }
+
+  return next;
+}
+
+
+void OpalRFC2833::WriteEvent(PInt64 now)
+{
+  // The duration is frozen for the end packets
+  if (transmitState == TransmitActive || endRepeats == 0) {
+    PInt64 duration = (now - transmitStartTick)*8;
+    transmitDuration = duration > 0xffff ? 0xffff : (unsigned)duration;
+  }
+
+  transmitFrame.SetPayloadType(payloadType);
+  transmitFrame.SetTimestamp(transmitTimestamp);
+  transmitFrame.SetMarker(FALSE);
+  transmitFrame.SetPayloadSize(4);
+
+  BYTE * payload = transmitFrame.GetPayloadPtr();
+  payload[0] = transmitCode;
+  payload[1] = 7;  // Volume
+  if (transmitState == TransmitEnding)
+    payload[1] |= 0x80;
+  payload[2] = (BYTE)(transmitDuration>>8);
+  payload[3] = (BYTE) transmitDuration    ;
+
+  if (!transmitSession->PreWriteData(transmitFrame) || !transmitSession->WriteData(transmitFrame)) {
+    PTRACE(2, "RFC2833\tCould not send tone, ending it");
+    transmitState = TransmitIdle;
+    return;
+  }
+
+  PTRACE(4, "RFC2833\tSent packet: ts=" << transmitTimestamp
+         << " code='" << RFC2833Table1Events[transmitCode] << "'"
+            " duration=" << transmitDuration << ' '
+         << (transmitState == TransmitEnding ? "ending" : "continuing"));
+
+  if (transmitState == TransmitActive)
+    nextTransmitTick += RFC2833_REPEAT_INTERVAL;
+  else if (++endRepeats < RFC2833_END_REPEATS)
+    nextTransmitTick = now + RFC2833_END_INTERVAL;
+  else
+    transmitState = TransmitIdle;
+
+  // Do not send a burst to catch up after a stall
+  if (nextTransmitTick < now)
+    nextTransmitTick = now;
 }
 
 
-void OpalRFC2833::TransmitEnded(PTimer &,  H323_INT)
+void OpalRFC2833::TransmitEnded(H323Timer &,  H323_INT)
 {
   EndTransmit();
 }
 
 
+/////////////////////////////////////////////////////////////////////////////
+
+class OpalRFC2833Scheduler::Thread : public PThread
+{
+    PCLASSINFO(Thread, PThread);
+  public:
+    Thread(OpalRFC2833Scheduler & sched, PThread::Priority priority)
+      : PThread(10000, NoAutoDeleteThread, priority, "RFC2833 Events"),
+        scheduler(sched)
+    {
+      Resume();
+    }
+
+    void Main()
+    {
+      scheduler.Main();
+    }
+
+  protected:
+    OpalRFC2833Scheduler & scheduler;
+};
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+OpalRFC2833Scheduler::OpalRFC2833Scheduler(PThread::Priority priority)
+  : shutdown(FALSE)
+{
+  thread = new Thread(*this, priority);
+
+  PTRACE(3, "RFC2833\tCreated event scheduler");
+}
+
+
+OpalRFC2833Scheduler::~OpalRFC2833Scheduler()
+{
+  mutex.Wait();
+  shutdown = TRUE;
+  PTRACE_IF(2, !handlers.empty(), "RFC2833\tDeleting scheduler with " << handlers.size() << " handlers");
+  mutex.Signal();
+
+  wakeUp.Signal();
+  thread->WaitForTermination();
+  delete thread;
+
+  PTRACE(3, "RFC2833\tDeleted event scheduler");
+}
+
+
+void OpalRFC2833Scheduler::Schedule(OpalRFC2833 & handler, PInt64 due)
+{
+  PWaitAndSignal m(mutex);
+
+  PBoolean first = dueHandlers.empty() || due < dueHandlers.begin()->first;
+  if (Insert(handler, due) && first)
+    wakeUp.Signal();
+}
+
+
+PBoolean OpalRFC2833Scheduler::Insert(OpalRFC2833 & handler, PInt64 due)
+{
+  HandlerMap::iterator it = handlers.find(&handler);
+  if (it == handlers.end())
+    it = handlers.insert(HandlerMap::value_type(&handler, dueHandlers.end())).first;
+  else if (it->second != dueHandlers.end()) {
+    if (it->second->first <= due)
+      return FALSE;
+    dueHandlers.erase(it->second);
+  }
+
+  it->second = dueHandlers.insert(DueMap::value_type(due, &handler));
+  return TRUE;
+}
+
+
+void OpalRFC2833Scheduler::Remove(OpalRFC2833 & handler)
+{
+  PWaitAndSignal m(mutex);
+
+  HandlerMap::iterator it = handlers.find(&handler);
+  if (it != handlers.end()) {
+    if (it->second != dueHandlers.end())
+      dueHandlers.erase(it->second);
+    handlers.erase(it);
+  }
+
+  // The thread may be calling a batch it took before the removal
+  PWaitAndSignal c(callMutex);
+}
+
+
+void OpalRFC2833Scheduler::Main()
+{
+  PTRACE(3, "RFC2833\tEvent scheduler thread started");
+
+  for (;;) {
+    PInt64 now = PTimer::Tick().GetMilliSeconds();
+
+    mutex.Wait();
+
+    if (shutdown) {
+      mutex.Signal();
+      break;
+    }
+
+    // Taken off the due list while called, so one made due meanwhile is not lost
+    dueBatch.clear();
+    while (!dueHandlers.empty() && dueHandlers.begin()->first <= now) {
+      OpalRFC2833 * handler = dueHandlers.begin()->second;
+      handlers[handler] = dueHandlers.end();
+      dueHandlers.erase(dueHandlers.begin());
+      dueBatch.push_back(handler);
+    }
+
+    // Taken before the maps are released so Remove() waits for this batch
+    callMutex.Wait();
+    mutex.Signal();
+
+    nextDue.clear();
+    for (size_t i = 0; i < dueBatch.size(); i++) {
+      PInt64 next = dueBatch[i]->OnScheduled(now);
+      if (next != 0)
+        nextDue.push_back(std::pair<OpalRFC2833 *, PInt64>(dueBatch[i], next));
+    }
+
+    callMutex.Signal();
+
+    // Put back what is still pending, unless removed meanwhile
+    mutex.Wait();
+    for (size_t i = 0; i < nextDue.size(); i++) {
+      if (handlers.find(nextDue[i].first) != handlers.end())
+        Insert(*nextDue[i].first, nextDue[i].second);
+    }
+
+    PInt64 wake = dueHandlers.empty() ? -1 : dueHandlers.begin()->first;
+    mutex.Signal();
+
+    now = PTimer::Tick().GetMilliSeconds();
+    if (wake < 0)
+      wakeUp.Wait();
+    else if (wake > now)
+      wakeUp.Wait(PTimeInterval(wake - now));
+  }
+
+  PTRACE(3, "RFC2833\tEvent scheduler thread ended");
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
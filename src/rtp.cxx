@@ -49,6 +49,14 @@
 #include "jitter.h"
 #endif
 
+#include "rtpreactor.h"
+#include "rtpreport.h"
+#include "rtpportpool.h"
+#include "rtpbatch.h"
+#include "rtpred.h"
+#include "rtpnack.h"
+#include "h323mediaclock.h"
+
 #include <ptclib/random.h>
 
 #ifdef P_STUN
@@ -147,7 +155,7 @@ PINDEX RTP_DataFrame::GetHeaderSize() const
   PINDEX sz = MIN_HEADER_SIZE + 4*GetContribSrcCount();
 
   if (GetExtension())
-    sz += 4 + GetExtensionSize();
+    sz += 4 + 4*GetExtensionSize();
 
   return sz;
 }
@@ -203,6 +211,120 @@ BYTE * RTP_DataFrame::GetExtensionPtr() const
 }
 
 
+const BYTE * RTP_DataFrame::GetHeaderExtension(unsigned id, PINDEX & length) const
+{
+  if (GetExtensionType() != OneByteExtensionProfile)
+    return NULL;
+
+  const BYTE * ptr = GetExtensionPtr();
+  PINDEX size = 4*GetExtensionSize();
+  if (GetHeaderSize() > GetSize())
+    return NULL;
+
+  PINDEX pos = 0;
+  while (pos < size) {
+    if (ptr[pos] == 0) {   // Padding
+      pos++;
+      continue;
+    }
+
+    unsigned elementId = ptr[pos] >> 4;
+    PINDEX elementLength = (ptr[pos] & 0xf) + 1;
+    if (elementId == 15 || pos + 1 + elementLength > size)
+      break;
+
+    if (elementId == id) {
+      length = elementLength;
+      return ptr + pos + 1;
+    }
+
+    pos += 1 + elementLength;
+  }
+
+  return NULL;
+}
+
+
+PBoolean RTP_DataFrame::SetHeaderExtension(unsigned id, const BYTE * data, PINDEX length)
+{
+  if (id < 1 || id > 14 || length < 1 || length > 16)
+    return FALSE;
+
+  int type = GetExtensionType();
+  if (type >= 0 && type != OneByteExtensionProfile)
+    return FALSE;
+
+  // At most 14 elements of 17 bytes
+  BYTE elements[14*17];
+  PINDEX used = 0;
+
+  if (type == OneByteExtensionProfile) {
+    const BYTE * ptr = GetExtensionPtr();
+    PINDEX size = 4*GetExtensionSize();
+    PINDEX pos = 0;
+    while (pos < size) {
+      if (ptr[pos] == 0) {
+        pos++;
+        continue;
+      }
+
+      unsigned elementId = ptr[pos] >> 4;
+      PINDEX elementLength = (ptr[pos] & 0xf) + 1;
+      if (elementId == 15 || pos + 1 + elementLength > size)
+        break;
+
+      if (elementId != id) {
+        memcpy(elements + used, ptr + pos, 1 + elementLength);
+        used += 1 + elementLength;
+      }
+      pos += 1 + elementLength;
+    }
+  }
+
+  elements[used++] = (BYTE)((id << 4) | (length - 1));
+  memcpy(elements + used, data, length);
+  used += length;
+
+  PINDEX words = (used + 3)/4;
+  PINDEX base = MIN_HEADER_SIZE + 4*GetContribSrcCount();
+  PINDEX oldHeader = GetHeaderSize();
+  PINDEX newHeader = base + 4 + 4*words;
+
+  if (!SetMinSize(newHeader + payloadSize))
+    return FALSE;
+
+  if (newHeader != oldHeader)
+    memmove(theArray + newHeader, theArray + oldHeader, payloadSize);
+
+  SetExtension(TRUE);
+  *(PUInt16b *)&theArray[base] = (WORD)OneByteExtensionProfile;
+  *(PUInt16b *)&theArray[base + 2] = (WORD)words;
+  memcpy(theArray + base + 4, elements, used);
+  memset(theArray + base + 4 + used, 0, 4*words - used);
+  return TRUE;
+}
+
+
+PBoolean RTP_DataFrame::GetAudioLevel(unsigned id, unsigned & level, PBoolean & voice) const
+{
+  PINDEX length;
+  const BYTE * ptr = GetHeaderExtension(id, length);
+  if (ptr == NULL)
+    return FALSE;
+
+  voice = (ptr[0] & 0x80) != 0;
+  level = ptr[0] & 0x7f;
+  return TRUE;
+}
+
+
+PBoolean RTP_DataFrame::SetAudioLevel(unsigned id, unsigned level, PBoolean voice)
+{
+  BYTE value = (BYTE)((voice ? 0x80 : 0) | (level < 127 ? level : 127));
+  return SetHeaderExtension(id, &value, 1);
+}
+
+
 PBoolean RTP_DataFrame::SetPayloadSize(PINDEX sz)
 {
   if (sz == payloadSize)
@@ -220,6 +342,18 @@ PBoolean RTP_DataFrame::IsValid() const
    return (GetPayloadType() < RTP_DataFrame::IllegalPayloadType);
 }
 
+void RTP_DataFrame::Swap(RTP_DataFrame & other)
+{
+  // Reference assignments only, neither buffer is copied
+  PBYTEArray temp = other;
+  other.PBYTEArray::operator=(*this);
+  PBYTEArray::operator=(temp);
+
+  PINDEX sz = payloadSize;
+  payloadSize = other.payloadSize;
+  other.payloadSize = sz;
+}
+
 #if PTRACING
 static const char * const PayloadTypesNames[RTP_DataFrame::LastKnownPayloadType] = {
   "PCMU",
@@ -339,10 +473,29 @@ RTP_ControlFrame::RTP_ControlFrame(PINDEX sz)
 {
   compoundOffset = 0;
   compoundSize = 0;
+  packetSize = 0;
   theArray[0] = '\x80'; // Set version 2
 }
 
 
+void RTP_ControlFrame::Reset()
+{
+  // Padding after the SDES items must be zero, and may be where an earlier packet had data
+  memset(theArray, 0, GetSize());
+  compoundOffset = 0;
+  compoundSize = 0;
+  packetSize = 0;
+  theArray[0] = '\x80'; // Set version 2
+}
+
+
+void RTP_ControlFrame::SetPacketSize(PINDEX size)
+{
+  compoundOffset = 0;
+  packetSize = size;
+}
+
+
 void RTP_ControlFrame::SetCount(unsigned count)
 {
   PAssert(count < 32, PInvalidParameter);
@@ -371,10 +524,11 @@ void RTP_ControlFrame::SetPayloadSize(PINDEX sz)
 
 PBoolean RTP_ControlFrame::ReadNextCompound()
 {
+  PINDEX size = GetPacketSize();
   compoundOffset += GetPayloadSize()+4;
-  if (compoundOffset+4 > GetSize())
+  if (compoundOffset+4 > size)
     return FALSE;
-  return compoundOffset+GetPayloadSize()+4 <= GetSize();
+  return compoundOffset+GetPayloadSize()+4 <= size;
 }
 
 
@@ -523,14 +677,22 @@ RTP_Session::RTP_Session(
     lastSentSequenceNumber((WORD)PRandom::Number()), expectedSequenceNumber(0), lastSentTimestamp(0), lastSentPacketTime(0), lastReceivedPacketTime(0),
     lastRRSequenceNumber(0), consecutiveOutOfOrderPackets(0),
     packetsSent(0), octetsSent(0), packetsReceived(0), octetsReceived(0), packetsLost(0), packetsOutOfOrder(0), averageSendTime(0),
-    maximumSendTime(0), minimumSendTime(0), averageReceiveTime(0), maximumReceiveTime(0), minimumReceiveTime(0), jitterLevel(0), maximumJitterLevel(0),
+    maximumSendTime(0), minimumSendTime(0), averageReceiveTime(0), maximumReceiveTime(0), minimumReceiveTime(0),
     locAddress(PString()), remAddress(PString()), txStatisticsCount(0), rxStatisticsCount(0), averageSendTimeAccum(0), maximumSendTimeAccum(0),
-    minimumSendTimeAccum(0xffffffff), averageReceiveTimeAccum(0), maximumReceiveTimeAccum(0), minimumReceiveTimeAccum(0xffffffff), packetsLostSinceLastRR(0),
-    lastTransitTime(0), firstDataReceivedTime(0), avSyncData(false)
+    minimumSendTimeAccum(0xffffffff), packetsLostSinceLastRR(0),
+    firstDataReceivedTime(0), traceTag(0), reportFrame(256),
+    retransmitHistory(NULL), nackGenerator(NULL), nackFrame(64), mediaReactor(NULL), reportScheduler(NULL),
+    jitterPullMode(FALSE), avSyncData(false), receiverReportSequence(0)
 #ifdef H323_RTP_AGGREGATE
     ,aggregator(NULL)
 #endif
 {
+  memset(&qosSend, 0, sizeof(qosSend));
+  memset(&qosReceive, 0, sizeof(qosReceive));
+  memset(&rxStats, 0, sizeof(rxStats));
+  ResetReceiveInterval();
+  nextReportTime = 0;
+
   if (sessionID <= 0) {
       PTRACE(2,"RTP\tWARNING: Session ID <= 0 Invalid SessionID.");
   } else if (sessionID > 256) {
@@ -555,10 +717,20 @@ RTP_Session::~RTP_Session()
             "    averageReceiveTime= " << averageReceiveTime << "\n"
             "    maximumReceiveTime= " << maximumReceiveTime << "\n"
             "    minimumReceiveTime= " << minimumReceiveTime << "\n"
-            "    averageJitter     = " << (jitterLevel >> 7) << "\n"
-            "    maximumJitter     = " << (maximumJitterLevel >> 7)
+            "    averageJitter     = " << GetAvgJitterTime() << "\n"
+            "    maximumJitter     = " << GetMaxJitterTime()
             );
 
+#if PTRACING
+  if (PTrace::CanTrace(3) && (packetsSent != 0 || packetsReceived != 0)) {
+    Histograms histograms;
+    GetHistograms(histograms);
+    PTRACE(3, "RTP\tFinal histograms (us): Session " << sessionID << '\n' << histograms);
+  }
+#endif
+
+  SetReportScheduler(NULL);
+
   if (userData) {
     //userData->OnFinalStatistics(*this);  TODO fix sending end of call stats
     delete userData;
@@ -568,6 +740,47 @@ RTP_Session::~RTP_Session()
   if (jitter)
     delete jitter;
 #endif
+
+  delete retransmitHistory;
+  delete nackGenerator;
+}
+
+void RTP_Session::SetReportScheduler(RTP_ReportScheduler * scheduler)
+{
+  if (scheduler == reportScheduler)
+    return;
+
+  if (reportScheduler != NULL)
+    reportScheduler->RemoveSession(*this);
+
+  reportScheduler = scheduler;
+
+  if (reportScheduler != NULL)
+    reportScheduler->AddSession(*this);
+}
+
+void RTP_Session::SetRetransmission(RTP_DataFrame::PayloadTypes payloadType, PINDEX depth)
+{
+  delete retransmitHistory;
+  retransmitHistory = new RTP_RetransmitHistory(depth, payloadType);
+  PTRACE(3, "RTP\tSession " << sessionID << ", retransmitting lost packets as payload type " << payloadType);
+}
+
+void RTP_Session::SetNackGeneration(RTP_DataFrame::PayloadTypes payloadType)
+{
+  delete nackGenerator;
+  nackGenerator = new RTP_NackGenerator(payloadType);
+  PTRACE(3, "RTP\tSession " << sessionID << ", asking for lost packets, retransmitted as payload type " << payloadType);
+}
+
+unsigned RTP_Session::GetPacketsRetransmitted() const
+{
+  return retransmitHistory != NULL ? retransmitHistory->GetRetransmitted() : 0;
+}
+
+unsigned RTP_Session::GetPacketsRepaired() const
+{
+  return nackGenerator != NULL ? nackGenerator->GetRepaired() : 0;
 }
 
 void RTP_Session::SetSessionID(unsigned id)
@@ -618,10 +831,13 @@ void RTP_Session::SetUserData(RTP_UserData * data)
 
 void RTP_Session::SetJitterBufferSize(unsigned minJitterDelay,
                                       unsigned maxJitterDelay,
-                                      PINDEX stackSize)
+                                      PINDEX stackSize,
+                                      JitterBufferEngine engine)
 {
   if (minJitterDelay == 0 && maxJitterDelay == 0) {
 #ifdef H323_AUDIO_CODECS
+    if (mediaReactor != NULL)
+      mediaReactor->RemoveSession(*this);
     delete jitter;
     jitter = NULL;
 #endif
@@ -629,17 +845,30 @@ void RTP_Session::SetJitterBufferSize(unsigned minJitterDelay,
 #ifdef H323_AUDIO_CODECS
   else if (jitter != NULL) {
     jitter->SetDelay(minJitterDelay, maxJitterDelay);
+    // Channel has been reopened, put the session back into the reactor
+    if (jitter->IsReactorDriven())
+      mediaReactor->AddSession(*this);
   }
 #endif
   else {
     SetIgnoreOutOfOrderPackets(FALSE);
 #ifdef H323_AUDIO_CODECS
-    jitter = new RTP_JitterBuffer(*this, minJitterDelay, maxJitterDelay, stackSize);
-    jitter->Resume(
+    if (engine == e_RingJitterBuffer)
+      jitter = new RTP_RingJitterBuffer(*this, minJitterDelay, maxJitterDelay, stackSize);
+    else if (engine == e_AdaptiveJitterBuffer)
+      jitter = new RTP_AdaptiveJitterBuffer(*this, minJitterDelay, maxJitterDelay, stackSize);
+    else
+      jitter = new RTP_JitterBuffer(*this, minJitterDelay, maxJitterDelay, stackSize);
+    if (jitterPullMode)
+      jitter->SetPullDriven();
+    else if (mediaReactor != NULL && mediaReactor->AddSession(*this))
+      jitter->SetReactorDriven();
+    else
+      jitter->Resume(
 #ifdef H323_RTP_AGGREGATE
-      aggregator
+        aggregator
 #endif
-      );
+        );
 #endif
   }
 }
@@ -655,6 +884,39 @@ unsigned RTP_Session::GetJitterBufferSize() const
 }
 
 
+PBoolean RTP_Session::SetTimeStretch(PBoolean enable)
+{
+#ifdef H323_AUDIO_CODECS
+  RTP_AdaptiveJitterBuffer * adaptive = dynamic_cast<RTP_AdaptiveJitterBuffer *>(jitter);
+  if (adaptive != NULL) {
+    adaptive->SetTimeStretch(enable);
+    return TRUE;
+  }
+#endif
+  return FALSE;
+}
+
+
+PBoolean RTP_Session::TakeTimeStretchRequest()
+{
+#ifdef H323_AUDIO_CODECS
+  RTP_AdaptiveJitterBuffer * adaptive = dynamic_cast<RTP_AdaptiveJitterBuffer *>(jitter);
+  if (adaptive != NULL)
+    return adaptive->TakeTimeStretchRequest();
+#endif
+  return FALSE;
+}
+
+
+void RTP_Session::SetJitterSyncDelay(unsigned delay)
+{
+#ifdef H323_AUDIO_CODECS
+  if (jitter != NULL)
+    jitter->SetSyncDelay(delay);
+#endif
+}
+
+
 PBoolean RTP_Session::ReadBufferedData(DWORD timestamp, RTP_DataFrame & frame)
 {
 #ifdef H323_AUDIO_CODECS
@@ -670,6 +932,51 @@ PBoolean RTP_Session::PseudoRead(int & /*selectStatus*/)
     return false;
 }
 
+
+RTP_Session::SendReceiveStatus RTP_Session::ReadPendingData(RTP_DataFrame & frame)
+{
+  return ReadData(frame, FALSE) ? e_ProcessPacket : e_AbortTransport;
+}
+
+
+RTP_Session::SendReceiveStatus RTP_Session::PollData(RTP_DataFrame & /*frame*/)
+{
+  return e_IgnorePacket;
+}
+
+
+PBoolean RTP_Session::SetReactorDataHandler(const PNotifier & handler)
+{
+  if (mediaReactor == NULL)
+    return FALSE;
+
+#ifdef H323_AUDIO_CODECS
+  if (jitter != NULL)
+    return FALSE;
+#endif
+
+  // No call back may be running while the handler changes
+  mediaReactor->RemoveSession(*this);
+  reactorDataHandler = handler;
+
+  if (handler.IsNULL())
+    return TRUE;
+
+  if (mediaReactor->AddSession(*this)) {
+    PTRACE(4, "RTP\tSession " << sessionID << ", data handled by reactor");
+    return TRUE;
+  }
+
+  reactorDataHandler = PNotifier();
+  return FALSE;
+}
+
+
+PBoolean RTP_Session::OnReactorEvent(PBoolean /*dataReady*/)
+{
+  return FALSE;
+}
+
 bool RTP_Session::AVSyncData(SenderReport & sender)
 {
     if (avSyncData) {
@@ -681,6 +988,29 @@ bool RTP_Session::AVSyncData(SenderReport & sender)
     return false;
 }
 
+PBoolean RTP_Session::GetLatestReceiverReport(ReceiverReport & report, unsigned & sequence)
+{
+  PWaitAndSignal m(receiverReportMutex);
+  if (sequence == receiverReportSequence)
+    return FALSE;
+
+  report = latestReceiverReport;
+  sequence = receiverReportSequence;
+  return TRUE;
+}
+
+void RTP_Session::StoreReceiverReports(const ReceiverReportArray & reports)
+{
+  for (PINDEX i = 0; i < reports.GetSize(); i++) {
+    if (reports[i].sourceIdentifier == syncSourceOut) {
+      PWaitAndSignal m(receiverReportMutex);
+      latestReceiverReport = reports[i];
+      if (++receiverReportSequence == 0)
+        receiverReportSequence = 1;
+    }
+  }
+}
+
 void RTP_Session::SetTxStatisticsInterval(unsigned packets)
 {
   txStatisticsInterval = PMAX(packets, (unsigned)2);
@@ -695,9 +1025,15 @@ void RTP_Session::SetRxStatisticsInterval(unsigned packets)
 {
   rxStatisticsInterval = PMAX(packets, (unsigned)2);
   rxStatisticsCount = 0;
-  averageReceiveTimeAccum = 0;
-  maximumReceiveTimeAccum = 0;
-  minimumReceiveTimeAccum = 0xffffffff;
+  ResetReceiveInterval();
+}
+
+
+void RTP_Session::ResetReceiveInterval()
+{
+  rxStats.intervalSum = 0;
+  rxStats.intervalMax = 0;
+  rxStats.intervalMin = 0xffffffff;
 }
 
 
@@ -715,7 +1051,7 @@ void RTP_Session::AddReceiverReport(RTP_ControlFrame::ReceiverReport & receiver)
   receiver.last_seq = lastRRSequenceNumber;
   lastRRSequenceNumber = expectedSequenceNumber;
 
-  receiver.jitter = jitterLevel >> 4; // Allow for rounding protection bits
+  receiver.jitter = GetJitterLevel() >> 4; // Allow for rounding protection bits
 
   // The following have not been calculated yet.
   receiver.lsr = 0;
@@ -734,7 +1070,7 @@ void RTP_Session::AddReceiverReport(RTP_ControlFrame::ReceiverReport & receiver)
 
 RTP_Session::SendReceiveStatus RTP_Session::OnSendData(RTP_DataFrame & frame)
 {
-  PInt64 tick = PTimer::Tick().GetMilliSeconds();  // Timestamp set now
+  PInt64 tick = H323MediaClock::GetMilliseconds();  // Timestamp set now
 
   frame.SetSequenceNumber(++lastSentSequenceNumber);
   frame.SetSyncSource(syncSourceOut);
@@ -761,7 +1097,7 @@ RTP_Session::SendReceiveStatus RTP_Session::OnSendData(RTP_DataFrame & frame)
   if (userData && packetsSent == 1)
     userData->OnTxStatistics(*this);
 
-  if (!SendReport())
+  if (tick*1000 >= nextReportTime && !SendReport())
     return e_AbortTransport;
 
   if (txStatisticsCount < txStatisticsInterval)
@@ -777,6 +1113,8 @@ RTP_Session::SendReceiveStatus RTP_Session::OnSendData(RTP_DataFrame & frame)
   maximumSendTimeAccum = 0;
   minimumSendTimeAccum = 0xffffffff;
 
+  PublishSendQoS();
+
   PTRACE(2, "RTP\tTransmit statistics: "
             " packets=" << packetsSent <<
             " octets=" << octetsSent <<
@@ -802,12 +1140,15 @@ RTP_Session::SendReceiveStatus RTP_Session::OnReceiveData(const RTP_DataFrame &
   if (frame.GetPayloadType() > RTP_DataFrame::MaxPayloadType)
     return e_IgnorePacket; // Non fatal error, just ignore
 
-  PInt64 tick = PTimer::Tick().GetMilliSeconds();  // Get timestamp now
+  PInt64 tick = H323MediaClock::GetMicroseconds();  // Get timestamp now
 
   // Have not got SSRC yet, so grab it now
   if (syncSourceIn == 0)
     syncSourceIn = frame.GetSyncSource();
 
+  if (nackGenerator != NULL && frame.GetSyncSource() == syncSourceIn)
+    nackGenerator->OnReceived(frame.GetSequenceNumber(), frame.GetPayloadType());
+
   // Check packet sequence numbers
   if (packetsReceived == 0) {
     expectedSequenceNumber = (WORD)(frame.GetSequenceNumber() + 1);
@@ -848,24 +1189,25 @@ RTP_Session::SendReceiveStatus RTP_Session::OnReceiveData(const RTP_DataFrame &
       consecutiveOutOfOrderPackets = 0;
       // Only do statistics on packets after first received in talk burst
       if (!frame.GetMarker()) {
-        DWORD diff = tick - lastReceivedPacketTime;
-        averageReceiveTimeAccum += diff;
-        if (diff > maximumReceiveTimeAccum)
-          maximumReceiveTimeAccum = diff;
-        if (diff < minimumReceiveTimeAccum)
-          minimumReceiveTimeAccum = diff;
+        PInt64 elapsed = tick - lastReceivedPacketTime;
+        DWORD interval = elapsed < 0xffffffff ? (DWORD)elapsed : 0xffffffff;
+        rxStats.intervalSum += interval;
+        if (interval > rxStats.intervalMax)
+          rxStats.intervalMax = interval;
+        if (interval < rxStats.intervalMin)
+          rxStats.intervalMin = interval;
         rxStatisticsCount++;
 
-        // The following has the implicit assumption that something that has jitter
-        // is an audio codec and thus is in 8kHz timestamp units.
-        diff *= 8;
-        long variance = (long)diff - (long)lastTransitTime;
-        lastTransitTime = diff;
+        // The interarrival jitter of RFC 3550 A.8 in microseconds, times 16.
+        // Reports give it in 8kHz units, assuming what has jitter is audio.
+        long variance = (long)interval - (long)rxStats.lastInterval;
+        rxStats.lastInterval = interval;
         if (variance < 0)
           variance = -variance;
-        jitterLevel += variance - ((jitterLevel+8) >> 4);
-        if (jitterLevel > maximumJitterLevel)
-          maximumJitterLevel = jitterLevel;
+        rxStats.jitter += variance - ((rxStats.jitter+8) >> 4);
+        if (rxStats.jitter > rxStats.maximumJitter)
+          rxStats.maximumJitter = rxStats.jitter;
+        jitterHistogram.Record(variance);
       }
     }
     else if (sequenceNumber < expectedSequenceNumber) {
@@ -891,6 +1233,8 @@ RTP_Session::SendReceiveStatus RTP_Session::OnReceiveData(const RTP_DataFrame &
       packetsLostSinceLastRR += dropped;
       PTRACE(3, "RTP\tDropped " << dropped << " packet(s) at " << sequenceNumber
              << ", ssrc=" << syncSourceIn);
+      if (nackGenerator != NULL)
+        nackGenerator->OnLost(expectedSequenceNumber, dropped, tick);
       expectedSequenceNumber = (WORD)(sequenceNumber + 1);
       consecutiveOutOfOrderPackets = 0;
     }
@@ -907,10 +1251,18 @@ RTP_Session::SendReceiveStatus RTP_Session::OnReceiveData(const RTP_DataFrame &
   }
 
   // Call the statistics call-back on the first PDU with total count == 1
-  if (userData && packetsReceived == 1)
-    userData->OnRxStatistics(*this);
+  if (packetsReceived == 1) {
+    PublishReceiveQoS();
+    if (userData)
+      userData->OnRxStatistics(*this);
+  }
 
-  if (!SendReport())
+  if (nackGenerator != NULL && nackGenerator->BuildNack(nackFrame, syncSourceOut, syncSourceIn, tick) && !WriteControl(nackFrame))
+    return e_AbortTransport;
+
+  // The report deadline is checked here so the lock and timer of
+  // SendReport() are only taken when a report may be due
+  if (tick >= nextReportTime && !SendReport())
     return e_AbortTransport;
 
   if (rxStatisticsCount < rxStatisticsInterval)
@@ -918,13 +1270,12 @@ RTP_Session::SendReceiveStatus RTP_Session::OnReceiveData(const RTP_DataFrame &
 
   rxStatisticsCount = 0;
 
-  averageReceiveTime = averageReceiveTimeAccum/rxStatisticsInterval;
-  maximumReceiveTime = maximumReceiveTimeAccum;
-  minimumReceiveTime = minimumReceiveTimeAccum;
+  averageReceiveTime = (DWORD)(rxStats.intervalSum/1000/rxStatisticsInterval);
+  maximumReceiveTime = rxStats.intervalMax/1000;
+  minimumReceiveTime = rxStats.intervalMin/1000;
+  ResetReceiveInterval();
 
-  averageReceiveTimeAccum = 0;
-  maximumReceiveTimeAccum = 0;
-  minimumReceiveTimeAccum = 0xffffffff;
+  PublishReceiveQoS();
 
   PTRACE(2, "RTP\tReceive statistics: "
             " packets=" << packetsReceived <<
@@ -935,8 +1286,8 @@ RTP_Session::SendReceiveStatus RTP_Session::OnReceiveData(const RTP_DataFrame &
             " avgTime=" << averageReceiveTime <<
             " maxTime=" << maximumReceiveTime <<
             " minTime=" << minimumReceiveTime <<
-            " jitter=" << (jitterLevel >> 7) <<
-            " maxJitter=" << (maximumJitterLevel >> 7)
+            " jitter=" << GetAvgJitterTime() <<
+            " maxJitter=" << GetMaxJitterTime()
             );
 
   if (userData)
@@ -946,6 +1297,73 @@ RTP_Session::SendReceiveStatus RTP_Session::OnReceiveData(const RTP_DataFrame &
 }
 
 
+void RTP_Session::PublishSendQoS()
+{
+  // Only the send thread writes, the version is odd while it does
+  ++qosSendVersion;
+  qosSend.averageSendTime = averageSendTime;
+  qosSend.maximumSendTime = maximumSendTime;
+  ++qosSendVersion;
+}
+
+
+void RTP_Session::PublishReceiveQoS()
+{
+  // Only the receive thread writes, the version is odd while it does
+  ++qosReceiveVersion;
+  qosReceive.packetsReceived = packetsReceived;
+  qosReceive.octetsReceived = octetsReceived;
+  qosReceive.packetsLost = packetsLost;
+  qosReceive.averageReceiveTime = averageReceiveTime;
+  qosReceive.jitterLevel = GetJitterLevel();
+  qosReceive.maximumJitterLevel = GetMaximumJitterLevel();
+  ++qosReceiveVersion;
+}
+
+
+template <class T> static void ReadPublishedQoS(const PAtomicInteger & version, const T & published, T & copy)
+{
+  for (;;) {
+    long before = version;
+    if ((before & 1) == 0) {
+      copy = published;
+      if ((long)version == before)
+        return;
+    }
+    PThread::Yield();
+  }
+}
+
+
+PBoolean RTP_Session::GetQoSMeasures(QoSMeasures & measures) const
+{
+  SendQoS send;
+  ReceiveQoS receive;
+  ReadPublishedQoS(qosSendVersion, qosSend, send);
+  ReadPublishedQoS(qosReceiveVersion, qosReceive, receive);
+
+  measures.packetsReceived    = receive.packetsReceived;
+  measures.octetsReceived     = receive.octetsReceived;
+  measures.packetsLost        = receive.packetsLost;
+  measures.averageSendTime    = send.averageSendTime;
+  measures.maximumSendTime    = send.maximumSendTime;
+  measures.averageReceiveTime = receive.averageReceiveTime;
+  measures.jitter             = receive.jitterLevel>>7;
+  measures.maximumJitter      = receive.maximumJitterLevel>>7;
+  measures.lossRate           = 0;
+  measures.throughput         = 0;
+
+  if (receive.packetsReceived == 0)
+    return FALSE;
+
+  measures.lossRate = receive.packetsLost/receive.packetsReceived;
+  if (receive.averageReceiveTime > 0)
+    measures.throughput = (DWORD)((PUInt64)receive.octetsReceived*1000/
+                                  ((PUInt64)receive.packetsReceived*receive.averageReceiveTime));
+  return TRUE;
+}
+
+
 PBoolean RTP_Session::SendReport()
 {
   PWaitAndSignal mutex(reportMutex);
@@ -953,13 +1371,34 @@ PBoolean RTP_Session::SendReport()
   if (reportTimer.IsRunning())
     return TRUE;
 
-  // Have not got anything yet, do nothing
-  if (packetsSent == 0 && packetsReceived == 0) {
+  // The timer still runs so a read waiting on it wakes at the same rate
+  if (reportScheduler != NULL || (packetsSent == 0 && packetsReceived == 0)) {
+    // Have not got anything yet, do nothing
     reportTimer = reportTimeInterval;
+    nextReportTime = H323MediaClock::GetMicroseconds() + reportTimeInterval.GetMilliSeconds()*1000;
     return TRUE;
   }
 
-  RTP_ControlFrame report;
+  // Wait a fuzzy amount of time so things don't get into lock step
+  int interval = (int)reportTimeInterval.GetMilliSeconds();
+  int third = interval/3;
+  interval += PRandom::Number()%(2*third);
+  interval -= third;
+  reportTimer = interval;
+  nextReportTime = H323MediaClock::GetMicroseconds() + (PInt64)interval*1000;
+
+  return WriteReport(reportFrame);
+}
+
+
+PBoolean RTP_Session::WriteReport(RTP_ControlFrame & report)
+{
+  PWaitAndSignal mutex(reportMutex);
+
+  if (packetsSent == 0 && packetsReceived == 0)
+    return TRUE;
+
+  report.Reset();
 
   // No packets sent yet, so only send RR
   if (packetsSent == 0) {
@@ -1008,13 +1447,6 @@ PBoolean RTP_Session::SendReport()
   report.AddSourceDescriptionItem(sdes, RTP_ControlFrame::e_CNAME, canonicalName);
   report.AddSourceDescriptionItem(sdes, RTP_ControlFrame::e_TOOL, toolName);
 
-  // Wait a fuzzy amount of time so things don't get into lock step
-  int interval = (int)reportTimeInterval.GetMilliSeconds();
-  int third = interval/3;
-  interval += PRandom::Number()%(2*third);
-  interval -= third;
-  reportTimer = interval;
-
   return WriteControl(report);
 }
 
@@ -1133,6 +1565,25 @@ RTP_Session::SendReceiveStatus RTP_Session::OnReceiveControl(RTP_ControlFrame &
         }
         break;
 
+      case RTP_ControlFrame::e_TransportFeedback :
+        if (size < 8) {
+          PTRACE(2, "RTP\tTransportFeedback packet truncated");
+        }
+        else if (frame.GetCount() == RTP_ControlFrame::e_GenericNACK && retransmitHistory != NULL &&
+                 ((const PUInt32b *)payload)[1] == syncSourceOut) {
+          // Each entry is a lost packet and a mask of lost packets after it
+          for (unsigned offset = 8; offset+4 <= size; offset += 4) {
+            WORD pid = (WORD)((payload[offset] << 8) | payload[offset+1]);
+            WORD blp = (WORD)((payload[offset+2] << 8) | payload[offset+3]);
+            retransmitHistory->Request(pid);
+            for (unsigned bit = 0; bit < 16; bit++) {
+              if (blp & (1 << bit))
+                retransmitHistory->Request((WORD)(pid+bit+1));
+            }
+          }
+        }
+        break;
+
       case RTP_ControlFrame::e_ApplDefined :
         if (size >= 4) {
           PString str((const char *)(payload+4), 4);
@@ -1153,8 +1604,10 @@ RTP_Session::SendReceiveStatus RTP_Session::OnReceiveControl(RTP_ControlFrame &
 
 
 void RTP_Session::OnRxSenderReport(const SenderReport & PTRACE_PARAM(sender),
-                                   const ReceiverReportArray & PTRACE_PARAM(reports))
+                                   const ReceiverReportArray & reports)
 {
+  StoreReceiverReports(reports);
+
   if (userData)
      userData->OnRxSenderReport(sessionID,sender,reports);
 
@@ -1167,8 +1620,10 @@ void RTP_Session::OnRxSenderReport(const SenderReport & PTRACE_PARAM(sender),
 
 
 void RTP_Session::OnRxReceiverReport(DWORD PTRACE_PARAM(src),
-                                     const ReceiverReportArray & PTRACE_PARAM(reports))
+                                     const ReceiverReportArray & reports)
 {
+  StoreReceiverReports(reports);
+
 #if PTRACING
   PTRACE(3, "RTP\tOnReceiverReport: ssrc=" << src);
   for (PINDEX i = 0; i < reports.GetSize(); i++)
@@ -1256,6 +1711,76 @@ DWORD RTP_Session::GetPacketsTooLate() const
 }
 
 
+DWORD RTP_Session::GetBufferOverruns() const
+{
+  return
+#ifdef H323_AUDIO_CODECS
+    jitter != NULL ? jitter->GetBufferOverruns() :
+#endif
+  0;
+}
+
+
+DWORD RTP_Session::GetFramePoolHits() const
+{
+  return
+#ifdef H323_AUDIO_CODECS
+    jitter != NULL ? jitter->GetFramePoolHits() :
+#endif
+  0;
+}
+
+
+DWORD RTP_Session::GetFramePoolMisses() const
+{
+  return
+#ifdef H323_AUDIO_CODECS
+    jitter != NULL ? jitter->GetFramePoolMisses() :
+#endif
+  0;
+}
+
+
+void RTP_Session::GetHistograms(Histograms & histograms) const
+{
+  jitterHistogram.GetSnapshot(histograms.jitter);
+  jitterBufferHistogram.GetSnapshot(histograms.jitterBuffer);
+  playoutHistogram.GetSnapshot(histograms.playout);
+  encodeHistogram.GetSnapshot(histograms.encode);
+  decodeHistogram.GetSnapshot(histograms.decode);
+}
+
+
+void RTP_Session::OnPlayout(DWORD playoutDelay, DWORD bufferDelay)
+{
+  playoutHistogram.Record(playoutDelay);
+  jitterBufferHistogram.Record(bufferDelay);
+}
+
+
+void RTP_Session::Histograms::Merge(const Histograms & other, PBoolean receive, PBoolean transmit)
+{
+  if (receive) {
+    jitter.Merge(other.jitter);
+    jitterBuffer.Merge(other.jitterBuffer);
+    playout.Merge(other.playout);
+    decode.Merge(other.decode);
+  }
+  if (transmit)
+    encode.Merge(other.encode);
+}
+
+
+void RTP_Session::Histograms::PrintOn(ostream & strm) const
+{
+  strm << "    jitter       " << jitter << '\n'
+       << "    jitterBuffer " << jitterBuffer << '\n'
+       << "    playout      " << playout << '\n'
+       << "    encode       " << encode << '\n'
+       << "    decode       " << decode;
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
 
 RTP_SessionManager::RTP_SessionManager()
@@ -1383,7 +1908,7 @@ void RTP_SessionManager::Exit()
 
 /////////////////////////////////////////////////////////////////////////////
 
-static void SetMinBufferSize(PUDPSocket & sock, int buftype)
+void RTP_UDP::SetMinBufferSize(PUDPSocket & sock, int buftype)
 {
   int sz = 0;
   if (sock.GetOption(buftype, sz)) {
@@ -1409,8 +1934,10 @@ RTP_UDP::RTP_UDP(
   id),
     localAddress(0), localDataPort(0), localControlPort(0),
     remoteAddress(0), remoteDataPort(0), remoteControlPort(0),
-    remoteTransmitAddress(0), shutdownRead(false), shutdownWrite(false),
-    dataSocket(NULL), controlSocket(NULL),
+    remoteTransmitAddress(0), multicastGroup(0), multicastDataPort(0), joinedGroup(0),
+    shutdownRead(false), shutdownWrite(false),
+    dataSocket(NULL), controlSocket(NULL), portPool(NULL), pooledSockets(FALSE), pooledAddress(0),
+    batchSize(0), readBatch(NULL), writeBatch(NULL), queueWrites(FALSE), lastDataReadCount(0), redundantDecoder(NULL), retransmitFrame(1500), controlFrame(2048),
     appliedQOS(false), enableGQOS(false),
     remoteIsNAT(_remoteIsNAT), successiveWrongAddresses(0), mediaIsTunneled(_mediaTunneled)
 {
@@ -1420,13 +1947,59 @@ RTP_UDP::RTP_UDP(
 
 RTP_UDP::~RTP_UDP()
 {
+  // Make sure no reactor or report thread touches the sockets once they are gone
+  if (mediaReactor != NULL)
+    mediaReactor->RemoveSession(*this);
+  SetReportScheduler(NULL);
+
   Close(TRUE);
   Close(FALSE);
 
-  delete dataSocket;
+  delete readBatch;
+  delete writeBatch;
+  delete redundantDecoder;
+
+  DeleteSockets();
+}
+
+
+void RTP_UDP::DeleteSockets()
+{
+  if (pooledSockets && dataSocket != NULL && controlSocket != NULL)
+    portPool->Release(pooledAddress, dataSocket, controlSocket);
+  else {
+    delete dataSocket;
+    delete controlSocket;
+  }
+
   dataSocket = NULL;
-  delete controlSocket;
   controlSocket = NULL;
+  pooledSockets = FALSE;
+}
+
+
+PBoolean RTP_UDP::HasPendingData() const
+{
+  return (readBatch != NULL && readBatch->HasPending()) ||
+         (redundantDecoder != NULL && redundantDecoder->HasRecovered());
+}
+
+
+void RTP_UDP::SetRedundantDecoding(RTP_DataFrame::PayloadTypes type)
+{
+  delete redundantDecoder;
+  redundantDecoder = NULL;
+
+  if (type != RTP_DataFrame::IllegalPayloadType) {
+    redundantDecoder = new RTP_RedundantDecoder(type);
+    PTRACE(3, "RTP_UDP\tSession " << sessionID << ", redundant audio in payload type " << type);
+  }
+}
+
+
+unsigned RTP_UDP::GetRedundantRecoveredTotal() const
+{
+  return redundantDecoder != NULL ? redundantDecoder->GetRecoveredTotal() : 0;
 }
 
 
@@ -1499,10 +2072,7 @@ PBoolean RTP_UDP::Open(PIPSocket::Address _localAddress,
   localDataPort    = (WORD)(portBase&0xfffe);
   localControlPort = (WORD)(localDataPort + 1);
 
-  delete dataSocket;
-  delete controlSocket;
-  dataSocket = NULL;
-  controlSocket = NULL;
+  DeleteSockets();
 
 #if P_QOS
   PQoS * dataQos = NULL;
@@ -1541,7 +2111,24 @@ PBoolean RTP_UDP::Open(PIPSocket::Address _localAddress,
   }
 #endif
 
-  if (dataSocket == NULL || controlSocket == NULL) {
+  // A pre-opened pair is already bound and configured, unless QoS needs its own sockets
+  PBoolean plainSockets = TRUE;
+  PBoolean configured = FALSE;
+  if (dataSocket == NULL && controlSocket == NULL && portPool != NULL
+#if P_QOS
+      && rtpQos == NULL
+#endif
+#ifdef H323_RTP_AGGREGATE
+      && aggregator == NULL
+#endif
+      && portPool->Acquire(localAddress, dataSocket, controlSocket)) {
+    pooledSockets = TRUE;
+    pooledAddress = localAddress;
+    localDataPort = dataSocket->GetPort();
+    localControlPort = controlSocket->GetPort();
+    configured = tos == portPool->GetTypeOfService();
+  }
+  else if (dataSocket == NULL || controlSocket == NULL) {
 #if P_QOS
     dataSocket = new H323UDPSocket(dataQos);
     controlSocket = new H323UDPSocket(ctrlQos);
@@ -1559,18 +2146,29 @@ PBoolean RTP_UDP::Open(PIPSocket::Address _localAddress,
       localControlPort += 2;
     }
   }
+  else
+    plainSockets = FALSE;
 
-  // Set the IP Type Of Service field for prioritisation of media UDP packets
-  // through some Cisco routers and Linux boxes
-  if (!dataSocket->SetOption(IP_TOS, tos, IPPROTO_IP)) {
-    PTRACE(1, "RTP_UDP\tCould not set TOS field in IP header: " << dataSocket->GetErrorText());
+  // Plain sockets of our own, so they can be driven by the batch calls
+  if (plainSockets && batchSize > 0 && readBatch == NULL && RTP_DatagramBatch::IsAvailable()) {
+    readBatch = new RTP_DatagramBatch(batchSize);
+    writeBatch = new RTP_DatagramBatch(batchSize);
+    PTRACE(4, "RTP_UDP\tSession " << sessionID << ", batched I/O of " << batchSize << " datagrams");
   }
 
-  // Increase internal buffer size on media UDP sockets
-  SetMinBufferSize(*dataSocket,    SO_RCVBUF);
-  SetMinBufferSize(*dataSocket,    SO_SNDBUF);
-  SetMinBufferSize(*controlSocket, SO_RCVBUF);
-  SetMinBufferSize(*controlSocket, SO_SNDBUF);
+  if (!configured) {
+    // Set the IP Type Of Service field for prioritisation of media UDP packets
+    // through some Cisco routers and Linux boxes
+    if (!dataSocket->SetOption(IP_TOS, tos, IPPROTO_IP)) {
+      PTRACE(1, "RTP_UDP\tCould not set TOS field in IP header: " << dataSocket->GetErrorText());
+    }
+
+    // Increase internal buffer size on media UDP sockets
+    SetMinBufferSize(*dataSocket,    SO_RCVBUF);
+    SetMinBufferSize(*dataSocket,    SO_SNDBUF);
+    SetMinBufferSize(*controlSocket, SO_RCVBUF);
+    SetMinBufferSize(*controlSocket, SO_SNDBUF);
+  }
 
   shutdownRead = FALSE;
   shutdownWrite = FALSE;
@@ -1624,6 +2222,94 @@ PString RTP_UDP::GetLocalHostName()
 }
 
 
+PBoolean RTP_UDP::SetMulticastTransmit(const PIPSocket::Address & group, WORD dataPort, BYTE ttl, PBoolean loop)
+{
+  if (!IsMulticastAddress(group) || dataPort == 0 || dataSocket == NULL || controlSocket == NULL) {
+    PTRACE(1, "RTP_UDP\tSession " << sessionID << ", cannot send to multicast " << group << ':' << dataPort);
+    return FALSE;
+  }
+
+  PUDPSocket * sockets[2] = { dataSocket, controlSocket };
+  for (PINDEX i = 0; i < 2; i++) {
+    if (!sockets[i]->SetOption(IP_MULTICAST_TTL, ttl, IPPROTO_IP) ||
+        !sockets[i]->SetOption(IP_MULTICAST_LOOP, loop ? 1 : 0, IPPROTO_IP)) {
+      PTRACE(1, "RTP_UDP\tSession " << sessionID << ", could not set multicast options: "
+             << sockets[i]->GetErrorText());
+      return FALSE;
+    }
+
+    // Send from the interface of the session rather than the default route
+    if (localAddress.IsValid() && !localAddress.IsAny() && localAddress.GetVersion() == 4) {
+      struct in_addr iface = localAddress;
+      if (!sockets[i]->SetOption(IP_MULTICAST_IF, &iface, sizeof(iface), IPPROTO_IP))
+        PTRACE(2, "RTP_UDP\tSession " << sessionID << ", could not set multicast interface "
+               << localAddress << ": " << sockets[i]->GetErrorText());
+    }
+  }
+
+  multicastGroup = group;
+  multicastDataPort = dataPort;
+
+  PTRACE(3, "RTP_UDP\tSession " << sessionID << ", sending to multicast "
+         << group << ':' << dataPort << " ttl=" << (unsigned)ttl << (loop ? " loop" : ""));
+  return TRUE;
+}
+
+
+PBoolean RTP_UDP::JoinMulticast(const PIPSocket::Address & group, WORD dataPort)
+{
+  if (!IsMulticastAddress(group) || dataPort == 0) {
+    PTRACE(1, "RTP_UDP\tSession " << sessionID << ", cannot join multicast " << group << ':' << dataPort);
+    return FALSE;
+  }
+
+  if (joinedGroup == group && localDataPort == dataPort && dataSocket != NULL)
+    return TRUE;
+
+  // Pooled sockets are bound to the interface, give them back for our own
+  DeleteSockets();
+  delete readBatch;
+  readBatch = NULL;
+  delete writeBatch;
+  writeBatch = NULL;
+
+  dataSocket = new H323UDPSocket();
+  controlSocket = new H323UDPSocket();
+  joinedGroup = 0;
+
+  if (!dataSocket->Listen(PIPSocket::Address::GetAny(4), 1, dataPort, PSocket::CanReuseAddress) ||
+      !controlSocket->Listen(PIPSocket::Address::GetAny(4), 1, (WORD)(dataPort+1), PSocket::CanReuseAddress)) {
+    PTRACE(1, "RTP_UDP\tSession " << sessionID << ", could not bind multicast ports "
+           << dataPort << '-' << (dataPort+1) << ": " << dataSocket->GetErrorText());
+    return FALSE;
+  }
+
+  struct ip_mreq mreq;
+  mreq.imr_multiaddr = group;
+  if (localAddress.IsValid() && !localAddress.IsAny() && localAddress.GetVersion() == 4)
+    mreq.imr_interface = localAddress;
+  else
+    mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+
+  if (!dataSocket->SetOption(IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq), IPPROTO_IP) ||
+      !controlSocket->SetOption(IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq), IPPROTO_IP)) {
+    PTRACE(1, "RTP_UDP\tSession " << sessionID << ", could not join multicast "
+           << group << ": " << dataSocket->GetErrorText());
+    return FALSE;
+  }
+
+  SetMinBufferSize(*dataSocket,    SO_RCVBUF);
+  SetMinBufferSize(*controlSocket, SO_RCVBUF);
+
+  localDataPort = dataPort;
+  localControlPort = (WORD)(dataPort+1);
+  joinedGroup = group;
+
+  PTRACE(3, "RTP_UDP\tSession " << sessionID << ", joined multicast " << group << ':' << dataPort);
+  return TRUE;
+}
+
+
 PBoolean RTP_UDP::SetRemoteSocketInfo(PIPSocket::Address address, WORD port, PBoolean isDataPort)
 {
   if (remoteIsNAT) {
@@ -1683,7 +2369,9 @@ PBoolean RTP_UDP::ReadData(RTP_DataFrame & frame, PBoolean loop)
 #endif
     int selectStatus = 0;
 
-    if (!PseudoRead(selectStatus))
+    if (HasPendingData())
+       selectStatus = -1; // Still have datagrams from the last batch read, or recovered
+    else if (!PseudoRead(selectStatus))
        selectStatus = PSocket::Select(*dataSocket, *controlSocket, reportTimer);
 #ifdef H323_RTP_AGGREGATE
     unsigned duration = (unsigned)(PTime() - start).GetMilliSeconds();
@@ -1712,6 +2400,7 @@ PBoolean RTP_UDP::ReadData(RTP_DataFrame & frame, PBoolean loop)
       case -1 :
         switch (ReadDataPDU(frame)) {
           case e_ProcessPacket :
+            H323_HOTTRACE(e_RTPReadData, traceTag, frame.GetSequenceNumber());
             if (!shutdownRead)
               return TRUE;
           case e_IgnorePacket :
@@ -1752,7 +2441,16 @@ RTP_Session::SendReceiveStatus RTP_UDP::ReadDataOrControlPDU(PUDPSocket & socket
   PIPSocket::Address addr;
   WORD port;
 
-  if (socket.ReadFrom(frame.GetPointer(), frame.GetSize(), addr, port)) {
+  PBoolean ok;
+  if (fromDataChannel && readBatch != NULL)
+    ok = readBatch->ReadFrom(socket, frame.GetPointer(), frame.GetSize(), addr, port, lastDataReadCount);
+  else {
+    ok = socket.ReadFrom(frame.GetPointer(), frame.GetSize(), addr, port);
+    if (ok && fromDataChannel)
+      lastDataReadCount = socket.GetLastReadCount();
+  }
+
+  if (ok) {
     if (!mediaIsTunneled && ignoreOtherSources) {
 
       // If remote address never set from higher levels, then try and figure
@@ -1859,12 +2557,16 @@ RTP_Session::SendReceiveStatus RTP_UDP::ReadDataOrControlPDU(PUDPSocket & socket
 
 RTP_Session::SendReceiveStatus RTP_UDP::ReadDataPDU(RTP_DataFrame & frame)
 {
+  // Packets recovered from the last redundant packet go first
+  if (redundantDecoder != NULL && redundantDecoder->TakeRecovered(frame))
+    return e_ProcessPacket;
+
   SendReceiveStatus status = ReadDataOrControlPDU(*dataSocket, frame, TRUE);
   if (status != e_ProcessPacket)
     return status;
 
   // Check received PDU is big enough
-  PINDEX pduSize = dataSocket->GetLastReadCount();
+  PINDEX pduSize = lastDataReadCount;
   if (pduSize < RTP_DataFrame::MinHeaderSize || pduSize < frame.GetHeaderSize()) {
     PTRACE(2, "RTP_UDP\tSession " << sessionID
            << ", Received data packet too small: " << pduSize << " bytes");
@@ -1872,27 +2574,143 @@ RTP_Session::SendReceiveStatus RTP_UDP::ReadDataPDU(RTP_DataFrame & frame)
   }
 
   frame.SetPayloadSize(pduSize - frame.GetHeaderSize());
-  return OnReceiveData(frame,*this);
+
+  // A retransmission answering a NACK is put back as the packet it carries.
+  // It is late by nature, so does not go through the sequence checks.
+  if (nackGenerator != NULL && frame.GetPayloadType() == nackGenerator->GetPayloadType())
+    return nackGenerator->OnRetransmission(frame, syncSourceIn) ? e_ProcessPacket : e_IgnorePacket;
+
+  status = OnReceiveData(frame,*this);
+
+  if (status == e_ProcessPacket && redundantDecoder != NULL && !redundantDecoder->Decode(frame))
+    return e_IgnorePacket;
+
+  return status;
+}
+
+
+RTP_Session::SendReceiveStatus RTP_UDP::ReadPendingData(RTP_DataFrame & frame)
+{
+  return ReadDataPDU(frame);
+}
+
+
+RTP_Session::SendReceiveStatus RTP_UDP::PollData(RTP_DataFrame & frame)
+{
+  for (;;) {
+    if (shutdownRead) {
+      PTRACE(3, "RTP_UDP\tSession " << sessionID << ", Read shutdown.");
+      shutdownRead = FALSE;
+      return e_AbortTransport;
+    }
+
+    int selectStatus = 0;
+    if (HasPendingData())
+      selectStatus = -1;
+    else if (!PseudoRead(selectStatus))
+      selectStatus = PSocket::Select(*dataSocket, *controlSocket, 0);
+
+    switch (selectStatus) {
+      case -2 :
+        if (ReadControlPDU() == e_AbortTransport)
+          return e_AbortTransport;
+        break;
+
+      case -3 :
+        if (ReadControlPDU() == e_AbortTransport)
+          return e_AbortTransport;
+        // Then do -1 case
+
+      case -1 :
+        switch (ReadDataPDU(frame)) {
+          case e_ProcessPacket :
+            return e_ProcessPacket;
+          case e_IgnorePacket :
+            break;
+          case e_AbortTransport :
+            return e_AbortTransport;
+        }
+        break;
+
+      case 0 :
+        // Nothing waiting, a good time to see if a report is due
+        return SendReport() ? e_IgnorePacket : e_AbortTransport;
+
+      case PSocket::Interrupted:
+        PTRACE(3, "RTP_UDP\tSession " << sessionID << ", Interrupted.");
+        return e_AbortTransport;
+
+      default :
+        PTRACE(1, "RTP_UDP\tSession " << sessionID << ", Select error: "
+                << PChannel::GetErrorText((PChannel::Errors)selectStatus));
+        return e_AbortTransport;
+    }
+  }
+}
+
+
+PBoolean RTP_UDP::OnReactorEvent(PBoolean dataReady)
+{
+  SendReceiveStatus status;
+
+  if (shutdownRead) {
+    PTRACE(3, "RTP_UDP\tSession " << sessionID << ", Read shutdown.");
+    shutdownRead = FALSE;
+    status = e_AbortTransport;
+  }
+  else if (!dataReady)
+    status = ReadControlPDU();
+#ifdef H323_AUDIO_CODECS
+  else if (jitter != NULL) {
+    // Drain everything a batched read picked up, the socket may no longer
+    // be readable so the reactor would not call back for them.
+    do {
+      status = jitter->OnReactorData() ? e_ProcessPacket : e_AbortTransport;
+    } while (status != e_AbortTransport && HasPendingData());
+  }
+#endif
+  else if (!reactorDataHandler.IsNULL()) {
+    do {
+      status = ReadDataPDU(reactorFrame);
+      if (status == e_ProcessPacket)
+        reactorDataHandler(reactorFrame, 0);
+    } while (status != e_AbortTransport && HasPendingData());
+  }
+  else
+    status = e_AbortTransport;
+
+  if (status != e_AbortTransport)
+    return TRUE;
+
+#ifdef H323_AUDIO_CODECS
+  // Release the reader at the other end of the jitter buffer
+  if (jitter != NULL)
+    jitter->OnReactorClosed();
+#endif
+  if (!reactorDataHandler.IsNULL())
+    reactorDataHandler(reactorFrame, 1);
+  return FALSE;
 }
 
 
 RTP_Session::SendReceiveStatus RTP_UDP::ReadControlPDU()
 {
-  RTP_ControlFrame frame(2048);
+  // Only one thread reads a session, so one frame serves every read
+  controlFrame.SetPacketSize(0);
 
-  SendReceiveStatus status = ReadDataOrControlPDU(*controlSocket, frame, FALSE);
+  SendReceiveStatus status = ReadDataOrControlPDU(*controlSocket, controlFrame, FALSE);
   if (status != e_ProcessPacket)
     return status;
 
   PINDEX pduSize = controlSocket->GetLastReadCount();
-  if (pduSize < 4 || pduSize < 4+frame.GetPayloadSize()) {
+  if (pduSize < 4 || pduSize < 4+controlFrame.GetPayloadSize()) {
     PTRACE(2, "RTP_UDP\tSession " << sessionID
            << ", Received control packet too small: " << pduSize << " bytes");
     return e_IgnorePacket;
   }
 
-  frame.SetSize(pduSize);
-  return OnReceiveControl(frame);
+  controlFrame.SetPacketSize(pduSize);
+  return OnReceiveControl(controlFrame);
 }
 
 
@@ -1922,13 +2740,44 @@ PBoolean RTP_UDP::PreWriteData(RTP_DataFrame & frame)
 
 PBoolean RTP_UDP::WriteData(RTP_DataFrame & frame)
 {
+  if (retransmitHistory != NULL) {
+    // Retransmissions asked for go ahead of the next packet, they are late already
+    while (retransmitHistory->HasRequests() && retransmitHistory->TakeRetransmission(retransmitFrame)) {
+      if (!SendData(retransmitFrame))
+        return FALSE;
+    }
+    retransmitHistory->Store(frame);
+  }
+
+  return SendData(frame);
+}
+
+
+PBoolean RTP_UDP::SendData(RTP_DataFrame & frame)
+{
+  const PIPSocket::Address & sendAddress = multicastDataPort != 0 ? multicastGroup : remoteAddress;
+  WORD sendPort = multicastDataPort != 0 ? multicastDataPort : remoteDataPort;
+
   // Trying to send a PDU before we are set up!, check in PreWriteData() isn't enough
-  if (!mediaIsTunneled && (remoteAddress.IsAny() || !remoteAddress.IsValid() || remoteDataPort == 0)) {
+  if (!mediaIsTunneled && (sendAddress.IsAny() || !sendAddress.IsValid() || sendPort == 0)) {
     return true;
   }
 
+  if (queueWrites && writeBatch != NULL && dataSocket != NULL) {
+    if (writeBatch->Queue(frame.GetPointer(), frame.GetHeaderSize()+frame.GetPayloadSize(),
+                          sendAddress, sendPort)) {
+      if (!frame.GetMarker() && !writeBatch->IsFull())
+        return TRUE;
+      return FlushData();
+    }
+
+    // Did not fit, send what is queued so order is kept then this one directly
+    if (!FlushData())
+      return FALSE;
+  }
+
   while (dataSocket && !dataSocket->WriteTo(frame.GetPointer(),
-            frame.GetHeaderSize()+frame.GetPayloadSize(), remoteAddress, remoteDataPort)) {
+            frame.GetHeaderSize()+frame.GetPayloadSize(), sendAddress, sendPort)) {
 
     switch (dataSocket->GetErrorNumber()) {
       case ECONNRESET :
@@ -1949,15 +2798,57 @@ PBoolean RTP_UDP::WriteData(RTP_DataFrame & frame)
 }
 
 
+PBoolean RTP_UDP::FlushData()
+{
+  if (writeBatch == NULL || writeBatch->GetQueued() == 0 || dataSocket == NULL)
+    return TRUE;
+
+  if (writeBatch->Flush(*dataSocket))
+    return TRUE;
+
+  switch (dataSocket->GetErrorNumber()) {
+    case ECONNRESET :
+    case ECONNREFUSED :
+      PTRACE(2, "RTP_UDP\tSession " << sessionID << ", data port on remote not ready.");
+      return TRUE;
+
+    default:
+      PTRACE(1, "RTP_UDP\tSession " << sessionID
+             << ", Write error on data port ("
+             << dataSocket->GetErrorNumber(PChannel::LastWriteError) << "): "
+             << dataSocket->GetErrorText(PChannel::LastWriteError));
+      return FALSE;
+  }
+}
+
+
+void RTP_UDP::SetQueueWrites(PBoolean queue)
+{
+  if (!queue)
+    FlushData();
+  queueWrites = queue;
+}
+
+
+PINDEX RTP_UDP::GetQueuedWrites() const
+{
+  return writeBatch != NULL ? writeBatch->GetQueued() : 0;
+}
+
+
 PBoolean RTP_UDP::WriteControl(RTP_ControlFrame & frame)
 {
+  // Reports of a multicast sender go to the group, as RFC 3550 has it
+  const PIPSocket::Address & sendAddress = multicastDataPort != 0 ? multicastGroup : remoteAddress;
+  WORD sendPort = multicastDataPort != 0 ? (WORD)(multicastDataPort+1) : remoteControlPort;
+
   // Trying to send a PDU before we are set up!
-  if (!mediaIsTunneled && (remoteAddress.IsAny() || !remoteAddress.IsValid() || remoteControlPort == 0)) {
+  if (!mediaIsTunneled && (sendAddress.IsAny() || !sendAddress.IsValid() || sendPort == 0)) {
     return true;
   }
 
   while (!controlSocket->WriteTo(frame.GetPointer(), frame.GetCompoundSize(),
-                                remoteAddress, remoteControlPort)) {
+                                sendAddress, sendPort)) {
     switch (controlSocket->GetErrorNumber()) {
       case ECONNRESET :
       case ECONNREFUSED :
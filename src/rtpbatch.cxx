@@ -0,0 +1,257 @@
+/*
+ * rtpbatch.cxx
+ *
+ * Batched UDP datagram I/O for RTP
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "rtpbatch.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#include "rtpbatch.h"
+
+#include <vector>
+
+#if defined(P_LINUX)
+#include <sys/socket.h>
+#include <netinet/in.h>
+#ifdef MSG_WAITFORONE   // recvmmsg() and sendmmsg() present
+#define H323_BATCH_MMSG 1
+#endif
+#endif
+
+#define new PNEW
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+#ifdef H323_BATCH_MMSG
+
+struct RTP_DatagramBatch::Native
+{
+  Native(PINDEX count, PINDEX size)
+    : buffer(count*size), messages(count), vectors(count), addresses(count)
+  {
+    memset(&messages[0], 0, count*sizeof(struct mmsghdr));
+    for (PINDEX i = 0; i < count; i++) {
+      vectors[i].iov_base = buffer.GetPointer() + i*size;
+      vectors[i].iov_len = size;
+      messages[i].msg_hdr.msg_iov = &vectors[i];
+      messages[i].msg_hdr.msg_iovlen = 1;
+      messages[i].msg_hdr.msg_name = &addresses[i];
+      messages[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+    }
+  }
+
+  PBYTEArray                           buffer;
+  std::vector<struct mmsghdr>          messages;
+  std::vector<struct iovec>            vectors;
+  std::vector<struct sockaddr_storage> addresses;
+};
+
+
+static void FromSockAddr(const struct sockaddr_storage & sa, PIPSocket::Address & addr, WORD & port)
+{
+#if P_HAS_IPV6
+  if (sa.ss_family == AF_INET6) {
+    const struct sockaddr_in6 & sa6 = (const struct sockaddr_in6 &)sa;
+    addr = PIPSocket::Address(AF_INET6, sizeof(sa6), (struct sockaddr *)&sa6);
+    port = ntohs(sa6.sin6_port);
+    return;
+  }
+#endif
+  const struct sockaddr_in & sa4 = (const struct sockaddr_in &)sa;
+  addr = PIPSocket::Address(sa4.sin_addr);
+  port = ntohs(sa4.sin_port);
+}
+
+
+static socklen_t ToSockAddr(const PIPSocket::Address & addr, WORD port, struct sockaddr_storage & sa)
+{
+  memset(&sa, 0, sizeof(sa));
+#if P_HAS_IPV6
+  if (addr.GetVersion() == 6) {
+    struct sockaddr_in6 & sa6 = (struct sockaddr_in6 &)sa;
+    sa6.sin6_family = AF_INET6;
+    sa6.sin6_addr = addr;
+    sa6.sin6_port = htons(port);
+    return sizeof(sa6);
+  }
+#endif
+  struct sockaddr_in & sa4 = (struct sockaddr_in &)sa;
+  sa4.sin_family = AF_INET;
+  sa4.sin_addr = addr;
+  sa4.sin_port = htons(port);
+  return sizeof(sa4);
+}
+
+#else
+
+struct RTP_DatagramBatch::Native
+{
+  Native(PINDEX, PINDEX) { }
+};
+
+#endif // H323_BATCH_MMSG
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+RTP_DatagramBatch::RTP_DatagramBatch(PINDEX cnt, PINDEX sz)
+  : count(cnt > 0 ? cnt : 1),
+    size(sz),
+    readSide(NULL),
+    writeSide(NULL),
+    readIndex(0),
+    readCount(0),
+    writeCount(0)
+{
+  if (cnt > 1 && IsAvailable()) {
+    readSide = new Native(count, size);
+    writeSide = new Native(count, size);
+  }
+}
+
+
+RTP_DatagramBatch::~RTP_DatagramBatch()
+{
+  delete readSide;
+  delete writeSide;
+}
+
+
+PBoolean RTP_DatagramBatch::IsAvailable()
+{
+#ifdef H323_BATCH_MMSG
+  return TRUE;
+#else
+  return FALSE;
+#endif
+}
+
+
+PBoolean RTP_DatagramBatch::ReadFrom(PUDPSocket & socket,
+                                     void * buf,
+                                     PINDEX len,
+                                     PIPSocket::Address & addr,
+                                     WORD & port,
+                                     PINDEX & actual)
+{
+#ifdef H323_BATCH_MMSG
+  if (readSide != NULL) {
+    if (!HasPending()) {
+      for (PINDEX i = 0; i < count; i++)
+        readSide->messages[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+
+      int received = recvmmsg(socket.GetHandle(), &readSide->messages[0], count, MSG_DONTWAIT, NULL);
+      readIndex = 0;
+      readCount = received > 0 ? received : 0;
+    }
+
+    while (HasPending()) {
+      struct mmsghdr & msg = readSide->messages[readIndex];
+      PINDEX msgLen = msg.msg_len;
+      BYTE * data = (BYTE *)readSide->vectors[readIndex].iov_base;
+      PBoolean truncated = (msg.msg_hdr.msg_flags & MSG_TRUNC) != 0;
+      FromSockAddr(readSide->addresses[readIndex], addr, port);
+      readIndex++;
+
+      if (truncated || msgLen > len) {
+        PTRACE(2, "RTPBatch\tDiscarded " << msgLen << " byte datagram from " << addr << ':' << port << ", too large");
+        continue;
+      }
+
+      memcpy(buf, data, msgLen);
+      actual = msgLen;
+      return TRUE;
+    }
+  }
+#endif
+
+  // Nothing batched, use the normal socket read and its error handling
+  if (!socket.ReadFrom(buf, len, addr, port))
+    return FALSE;
+
+  actual = socket.GetLastReadCount();
+  return TRUE;
+}
+
+
+PBoolean RTP_DatagramBatch::Queue(const void * buf, PINDEX len, const PIPSocket::Address & addr, WORD port)
+{
+#ifdef H323_BATCH_MMSG
+  if (writeSide == NULL || IsFull() || len > size)
+    return FALSE;
+
+  struct mmsghdr & msg = writeSide->messages[writeCount];
+  memcpy(writeSide->vectors[writeCount].iov_base, buf, len);
+  writeSide->vectors[writeCount].iov_len = len;
+  msg.msg_hdr.msg_namelen = ToSockAddr(addr, port, writeSide->addresses[writeCount]);
+  writeCount++;
+  return TRUE;
+#else
+  return FALSE;
+#endif
+}
+
+
+PBoolean RTP_DatagramBatch::Flush(PUDPSocket & socket)
+{
+  PINDEX sent = 0;
+
+#ifdef H323_BATCH_MMSG
+  if (writeSide != NULL && writeCount > 0) {
+    int result = sendmmsg(socket.GetHandle(), &writeSide->messages[0], writeCount, MSG_DONTWAIT);
+    if (result > 0)
+      sent = result;
+  }
+
+  // Anything the kernel did not take goes the normal way, so errors are
+  // reported on the socket exactly as they would be without batching. It is
+  // PUDPSocket's own write, as a socket may feed its WriteTo() into a batch.
+  while (sent < writeCount) {
+    PIPSocket::Address addr;
+    WORD port;
+    FromSockAddr(writeSide->addresses[sent], addr, port);
+    if (!socket.PUDPSocket::WriteTo(writeSide->vectors[sent].iov_base, writeSide->vectors[sent].iov_len, addr, port)) {
+      writeCount = 0;
+      return FALSE;
+    }
+    sent++;
+  }
+#endif
+
+  writeCount = 0;
+  return TRUE;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,183 @@
+/*
+ * rtphist.cxx
+ *
+ * Fixed bucket histograms for media statistics
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "rtphist.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#include "rtphist.h"
+#include "h323mediaclock.h"
+
+#define new PNEW
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+RTP_Histogram::Snapshot::Snapshot()
+{
+  Clear();
+}
+
+
+void RTP_Histogram::Snapshot::Clear()
+{
+  memset(buckets, 0, sizeof(buckets));
+  count = 0;
+  maximum = 0;
+  total = 0;
+}
+
+
+void RTP_Histogram::Snapshot::Merge(const Snapshot & other)
+{
+  for (PINDEX i = 0; i < NumBuckets; i++)
+    buckets[i] += other.buckets[i];
+  count += other.count;
+  total += other.total;
+  if (other.maximum > maximum)
+    maximum = other.maximum;
+}
+
+
+DWORD RTP_Histogram::Snapshot::GetPercentile(double percent) const
+{
+  if (count == 0)
+    return 0;
+
+  // Rank of the value wanted, counting from one
+  double rank = count*percent/100.0;
+  DWORD wanted = rank < 1 ? 1 : (DWORD)rank;
+  if (wanted < rank)
+    wanted++;
+  if (wanted > count)
+    wanted = count;
+
+  DWORD seen = 0;
+  for (PINDEX i = 0; i < NumBuckets; i++) {
+    seen += buckets[i];
+    if (seen >= wanted) {
+      DWORD limit = GetBucketLimit(i);
+      return limit < maximum ? limit : maximum;
+    }
+  }
+
+  return maximum;
+}
+
+
+void RTP_Histogram::Snapshot::PrintOn(ostream & strm) const
+{
+  strm << "count=" << count
+       << " mean=" << GetMean()
+       << " p50=" << GetPercentile(50)
+       << " p90=" << GetPercentile(90)
+       << " p99=" << GetPercentile(99)
+       << " p99.9=" << GetPercentile(99.9)
+       << " max=" << maximum;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+RTP_Histogram::RTP_Histogram()
+  : maximum(0),
+    total(0)
+{
+  for (PINDEX i = 0; i < NumBuckets; i++)
+    buckets[i] = 0;
+}
+
+
+void RTP_Histogram::Record(DWORD value)
+{
+  PINDEX bucket = GetBucket(value);
+  buckets[bucket] = buckets[bucket] + 1;
+  total = total + value;
+  if (value > maximum)
+    maximum = value;
+}
+
+
+void RTP_Histogram::GetSnapshot(Snapshot & snapshot) const
+{
+  // The count is taken from the buckets copied, so it always agrees with
+  // the percentiles even if a value is being recorded while copying.
+  H323_MEMORY_BARRIER();
+  snapshot.count = 0;
+  for (PINDEX i = 0; i < NumBuckets; i++) {
+    snapshot.buckets[i] = buckets[i];
+    snapshot.count += snapshot.buckets[i];
+  }
+  snapshot.maximum = maximum;
+  snapshot.total = total;
+}
+
+
+PInt64 RTP_Histogram::GetMicroseconds(PInt64 start)
+{
+  // The media clock is monotonic, a change of the time of day cannot make
+  // a processing time negative
+  PInt64 now = H323MediaClock::GetMicroseconds();
+  if (start == 0)
+    return now;
+  return now - start;
+}
+
+
+PINDEX RTP_Histogram::GetBucket(DWORD value)
+{
+  if (value < SubBuckets)
+    return value;
+
+  unsigned msb = 31;
+  while ((value & (1u << msb)) == 0)
+    msb--;
+
+  return (msb - SubBucketBits + 1)*SubBuckets + ((value >> (msb - SubBucketBits)) & (SubBuckets-1));
+}
+
+
+DWORD RTP_Histogram::GetBucketLimit(PINDEX bucket)
+{
+  if (bucket < SubBuckets)
+    return bucket;
+
+  unsigned msb = bucket/SubBuckets + SubBucketBits - 1;
+  unsigned shift = msb - SubBucketBits;
+  DWORD lowest = (DWORD)(SubBuckets + bucket%SubBuckets) << shift;
+  return lowest + ((1u << shift) - 1);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
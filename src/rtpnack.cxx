@@ -0,0 +1,297 @@
+/*
+ * rtpnack.cxx
+ *
+ * Generic NACK and RTX retransmission for RTP
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "rtpnack.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#include "rtpnack.h"
+#include "h323mediaclock.h"
+
+#include <ptclib/random.h>
+
+#define new PNEW
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+RTP_RetransmitHistory::RTP_RetransmitHistory(PINDEX depth, RTP_DataFrame::PayloadTypes type)
+  : entries(depth > 0 ? depth : 1),
+    requestCount(0),
+    payloadType(type),
+    syncSource(PRandom::Number()),
+    sequenceNumber((WORD)PRandom::Number()),
+    requested(0),
+    retransmitted(0)
+{
+  requests.reserve(RTP_NackGenerator::MaxPending);
+}
+
+
+void RTP_RetransmitHistory::Store(const RTP_DataFrame & frame)
+{
+  PINDEX size = frame.GetHeaderSize() + frame.GetPayloadSize();
+
+  PWaitAndSignal m(mutex);
+
+  Entry & entry = entries[frame.GetSequenceNumber() % entries.size()];
+  entry.sequenceNumber = frame.GetSequenceNumber();
+  entry.valid = TRUE;
+  entry.lastSent = 0;
+  entry.frame.SetMinSize(size);
+  memcpy(entry.frame.GetPointer(), (const BYTE *)frame, size);
+  entry.frame.SetPayloadSize(frame.GetPayloadSize());
+}
+
+
+void RTP_RetransmitHistory::Request(WORD seq)
+{
+  PWaitAndSignal m(mutex);
+
+  requested++;
+
+  const Entry & entry = entries[seq % entries.size()];
+  if (!entry.valid || entry.sequenceNumber != seq) {
+    PTRACE(4, "RTP\tNACK for packet " << seq << " no longer kept");
+    return;
+  }
+
+  // The receiver asks again when its retry is due, not for every report
+  if (entry.lastSent != 0 && H323MediaClock::GetMicroseconds() - entry.lastSent < RTP_NackGenerator::RetryInterval/2)
+    return;
+
+  for (PINDEX i = 0; i < (PINDEX)requests.size(); i++) {
+    if (requests[i] == seq)
+      return;
+  }
+
+  if ((PINDEX)requests.size() < RTP_NackGenerator::MaxPending) {
+    requests.push_back(seq);
+    requestCount = requests.size();
+  }
+}
+
+
+PBoolean RTP_RetransmitHistory::TakeRetransmission(RTP_DataFrame & frame)
+{
+  PWaitAndSignal m(mutex);
+
+  while (!requests.empty()) {
+    WORD seq = requests.front();
+    requests.erase(requests.begin());
+    requestCount = requests.size();
+
+    Entry & entry = entries[seq % entries.size()];
+    if (!entry.valid || entry.sequenceNumber != seq)
+      continue;   // Overwritten since asked for
+
+    const RTP_DataFrame & original = entry.frame;
+    PINDEX size = original.GetPayloadSize();
+
+    // A plain header, then the original sequence number and payload
+    frame[0] = '\x80';   // Version 2, no padding, extension or contributing sources
+    frame.SetMarker(original.GetMarker());
+    frame.SetPayloadType(payloadType);
+    frame.SetSequenceNumber(sequenceNumber++);
+    frame.SetTimestamp(original.GetTimestamp());
+    frame.SetSyncSource(syncSource);
+    frame.SetPayloadSize(size + 2);
+    BYTE * payload = frame.GetPayloadPtr();
+    payload[0] = (BYTE)(seq >> 8);
+    payload[1] = (BYTE)seq;
+    memcpy(payload+2, original.GetPayloadPtr(), size);
+
+    entry.lastSent = H323MediaClock::GetMicroseconds();
+    retransmitted++;
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+RTP_NackGenerator::RTP_NackGenerator(RTP_DataFrame::PayloadTypes type)
+  : payloadType(type),
+    mediaPayloadType(RTP_DataFrame::IllegalPayloadType),
+    requested(0),
+    repaired(0)
+{
+  pending.reserve(MaxPending);
+}
+
+
+void RTP_NackGenerator::OnReceived(WORD sequenceNumber, RTP_DataFrame::PayloadTypes type)
+{
+  mediaPayloadType = type;
+
+  for (PINDEX i = 0; i < (PINDEX)pending.size(); i++) {
+    if (pending[i].sequenceNumber == sequenceNumber) {
+      pending.erase(pending.begin() + i);
+      return;
+    }
+  }
+}
+
+
+void RTP_NackGenerator::OnLost(WORD firstSequence, unsigned count, PInt64 now)
+{
+  // A long burst is better repaired by an intra frame than by retransmission
+  if (count > MaxPending) {
+    PTRACE(3, "RTP\tNot asking for " << count << " lost packets from " << firstSequence);
+    return;
+  }
+
+  for (unsigned i = 0; i < count; i++) {
+    if (pending.size() >= MaxPending)
+      pending.erase(pending.begin());
+    Pending loss;
+    loss.sequenceNumber = (WORD)(firstSequence + i);
+    loss.lost = now;
+    loss.lastSent = 0;
+    loss.sent = 0;
+    pending.push_back(loss);
+  }
+}
+
+
+PBoolean RTP_NackGenerator::BuildNack(RTP_ControlFrame & frame, DWORD senderSource, DWORD mediaSource, PInt64 now)
+{
+  if (pending.empty())
+    return FALSE;
+
+  // Give up on losses too old, or asked for enough, then collect those due
+  PINDEX due = 0;
+  for (PINDEX i = 0; i < (PINDEX)pending.size(); ) {
+    Pending & loss = pending[i];
+    if (now - loss.lost > MaxAge || (loss.sent >= MaxRequests && now - loss.lastSent > RetryInterval)) {
+      pending.erase(pending.begin() + i);
+      continue;
+    }
+    if (loss.sent < MaxRequests && (loss.lastSent == 0 || now - loss.lastSent >= RetryInterval))
+      due++;
+    i++;
+  }
+
+  if (due == 0)
+    return FALSE;
+
+  frame.Reset();
+
+  // An empty receiver report starts the compound packet
+  frame.SetPayloadType(RTP_ControlFrame::e_ReceiverReport);
+  frame.SetCount(0);
+  frame.SetPayloadSize(4);
+  *(PUInt32b *)frame.GetPayloadPtr() = senderSource;
+  frame.WriteNextCompound();
+
+  frame.SetPayloadType(RTP_ControlFrame::e_TransportFeedback);
+  frame.SetCount(RTP_ControlFrame::e_GenericNACK);
+  frame.SetPayloadSize(8 + 4*due);    // At most one entry per loss, trimmed below
+  PUInt32b * header = (PUInt32b *)frame.GetPayloadPtr();
+  header[0] = senderSource;
+  header[1] = mediaSource;
+  BYTE * fci = frame.GetPayloadPtr() + 8;
+
+  // Each entry covers a packet and a bit mask of the sixteen after it
+  PINDEX entries = 0;
+  for (PINDEX i = 0; i < (PINDEX)pending.size(); i++) {
+    Pending & loss = pending[i];
+    if (loss.sent >= MaxRequests || (loss.lastSent != 0 && now - loss.lastSent < RetryInterval))
+      continue;
+
+    PINDEX e;
+    for (e = 0; e < entries; e++) {
+      WORD pid = (WORD)((fci[e*4] << 8) | fci[e*4+1]);
+      WORD offset = (WORD)(loss.sequenceNumber - pid);
+      if (offset >= 1 && offset <= 16) {
+        WORD blp = (WORD)(((fci[e*4+2] << 8) | fci[e*4+3]) | (1 << (offset-1)));
+        fci[e*4+2] = (BYTE)(blp >> 8);
+        fci[e*4+3] = (BYTE)blp;
+        break;
+      }
+    }
+    if (e == entries) {
+      fci[entries*4]   = (BYTE)(loss.sequenceNumber >> 8);
+      fci[entries*4+1] = (BYTE)loss.sequenceNumber;
+      fci[entries*4+2] = 0;
+      fci[entries*4+3] = 0;
+      entries++;
+    }
+
+    loss.lastSent = now;
+    loss.sent++;
+    requested++;
+  }
+
+  frame.SetPayloadSize(8 + 4*entries);
+  PTRACE(4, "RTP\tSending NACK for " << due << " packets in " << entries << " entries");
+  return TRUE;
+}
+
+
+PBoolean RTP_NackGenerator::OnRetransmission(RTP_DataFrame & frame, DWORD mediaSource)
+{
+  PINDEX size = frame.GetPayloadSize();
+  if (size < 2 || mediaPayloadType == RTP_DataFrame::IllegalPayloadType)
+    return FALSE;
+
+  BYTE * payload = frame.GetPayloadPtr();
+  WORD seq = (WORD)((payload[0] << 8) | payload[1]);
+
+  PINDEX i;
+  for (i = 0; i < (PINDEX)pending.size(); i++) {
+    if (pending[i].sequenceNumber == seq)
+      break;
+  }
+  if (i == (PINDEX)pending.size())
+    return FALSE;   // Not waited for, or a second answer
+
+  pending.erase(pending.begin() + i);
+  repaired++;
+
+  memmove(payload, payload+2, size-2);
+  frame.SetPayloadSize(size-2);
+  frame.SetPayloadType(mediaPayloadType);
+  frame.SetSequenceNumber(seq);
+  frame.SetSyncSource(mediaSource);
+
+  PTRACE(4, "RTP\tRepaired packet " << seq << " by retransmission");
+  return TRUE;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
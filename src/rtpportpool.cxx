@@ -0,0 +1,346 @@
+/*
+ * rtpportpool.cxx
+ *
+ * Pool of pre-opened RTP socket pairs
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "rtpportpool.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#include "rtpportpool.h"
+#include "rtp.h"
+#include "h323ep.h"
+
+#include <vector>
+
+#define new PNEW
+
+/* Time before binding is tried again when the port range is exhausted */
+#define POOL_RETRY_INTERVAL 1000
+
+/* Largest datagram discarded from a pair leaving quarantine */
+#define POOL_DRAIN_SIZE 2048
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+class RTP_PortPool::Thread : public PThread
+{
+    PCLASSINFO(Thread, PThread);
+  public:
+    Thread(RTP_PortPool & _pool)
+      : PThread(10000, NoAutoDeleteThread, NormalPriority, "RTP Port Pool"),
+        pool(_pool)
+    {
+      Resume();
+    }
+
+    void Main()
+    {
+      pool.Main();
+    }
+
+  protected:
+    RTP_PortPool & pool;
+};
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+RTP_PortPool::RTP_PortPool(H323EndPoint & ep, PINDEX size, const PTimeInterval & quarantine)
+  : endpoint(ep),
+    poolSize(size),
+    quarantineTime(quarantine.GetMilliSeconds()),
+    typeOfService(ep.GetRtpIpTypeofService()),
+    hitCount(0),
+    missCount(0),
+    shutdown(FALSE)
+{
+  thread = new Thread(*this);
+
+  PTRACE(3, "RTPPool\tCreated port pool of " << poolSize << " pairs, quarantine " << quarantineTime << "ms");
+}
+
+
+RTP_PortPool::~RTP_PortPool()
+{
+  mutex.Wait();
+  shutdown = TRUE;
+  mutex.Signal();
+
+  wakeUp.Signal();
+  thread->WaitForTermination();
+  delete thread;
+
+  for (InterfaceMap::iterator it = interfaces.begin(); it != interfaces.end(); ++it) {
+    Interface & iface = it->second;
+    while (!iface.ready.empty()) {
+      delete iface.ready.front().data;
+      delete iface.ready.front().control;
+      iface.ready.pop_front();
+    }
+    while (!iface.quarantined.empty()) {
+      delete iface.quarantined.front().data;
+      delete iface.quarantined.front().control;
+      iface.quarantined.pop_front();
+    }
+  }
+
+  PTRACE(3, "RTPPool\tDeleted port pool, " << hitCount << " pairs taken, " << missCount << " misses");
+}
+
+
+void RTP_PortPool::AddInterface(const PIPSocket::Address & address)
+{
+  PWaitAndSignal m(mutex);
+
+  PString key = address.AsString();
+  if (interfaces.find(key) != interfaces.end())
+    return;
+
+  Interface & iface = interfaces[key];
+  iface.address = address;
+  iface.opening = 0;
+
+  PTRACE(4, "RTPPool\tAdded interface " << address);
+
+  wakeUp.Signal();
+}
+
+
+PBoolean RTP_PortPool::Acquire(const PIPSocket::Address & address, PUDPSocket * & dataSocket, PUDPSocket * & controlSocket)
+{
+  PWaitAndSignal m(mutex);
+
+  InterfaceMap::iterator it = interfaces.find(address.AsString());
+  if (it == interfaces.end()) {
+    missCount++;
+    AddInterface(address);
+    return FALSE;
+  }
+
+  Interface & iface = it->second;
+  if (iface.ready.empty()) {
+    missCount++;
+    wakeUp.Signal();
+    PTRACE(3, "RTPPool\tNo pair ready on " << address);
+    return FALSE;
+  }
+
+  dataSocket = iface.ready.front().data;
+  controlSocket = iface.ready.front().control;
+  iface.ready.pop_front();
+  hitCount++;
+
+  // Let the thread replace what was taken
+  wakeUp.Signal();
+
+  PTRACE(4, "RTPPool\tTook pair " << dataSocket->GetPort() << '-' << controlSocket->GetPort()
+         << " on " << address << ", " << iface.ready.size() << " left");
+  return TRUE;
+}
+
+
+void RTP_PortPool::Release(const PIPSocket::Address & address, PUDPSocket * dataSocket, PUDPSocket * controlSocket)
+{
+  PWaitAndSignal m(mutex);
+
+  InterfaceMap::iterator it = interfaces.find(address.AsString());
+  if (shutdown || it == interfaces.end() || !dataSocket->IsOpen() || !controlSocket->IsOpen()) {
+    delete dataSocket;
+    delete controlSocket;
+    return;
+  }
+
+  SocketPair pair;
+  pair.data = dataSocket;
+  pair.control = controlSocket;
+  pair.released = PTimer::Tick().GetMilliSeconds();
+
+  Interface & iface = it->second;
+  PBoolean first = iface.quarantined.empty();
+  iface.quarantined.push_back(pair);
+
+  PTRACE(4, "RTPPool\tReleased pair " << dataSocket->GetPort() << '-' << controlSocket->GetPort() << " on " << address);
+
+  if (first)
+    wakeUp.Signal();
+}
+
+
+PBoolean RTP_PortPool::OpenPair(const PIPSocket::Address & address, PUDPSocket * & data, PUDPSocket * & control)
+{
+  data = new H323UDPSocket();
+  control = new H323UDPSocket();
+
+  WORD firstPort = endpoint.GetRtpIpPortPair();
+  WORD port = firstPort;
+  while (!data->Listen(address, 1, port) || !control->Listen(address, 1, (WORD)(port+1))) {
+    data->Close();
+    control->Close();
+    port = endpoint.GetRtpIpPortPair();
+    if (port == firstPort) {
+      PTRACE(2, "RTPPool\tNo free port pair on " << address);
+      delete data;
+      delete control;
+      return FALSE;
+    }
+  }
+
+  if (!data->SetOption(IP_TOS, typeOfService, IPPROTO_IP)) {
+    PTRACE(1, "RTPPool\tCould not set TOS field in IP header: " << data->GetErrorText());
+  }
+
+  RTP_UDP::SetMinBufferSize(*data,    SO_RCVBUF);
+  RTP_UDP::SetMinBufferSize(*data,    SO_SNDBUF);
+  RTP_UDP::SetMinBufferSize(*control, SO_RCVBUF);
+  RTP_UDP::SetMinBufferSize(*control, SO_SNDBUF);
+
+  return TRUE;
+}
+
+
+void RTP_PortPool::Drain(PUDPSocket & socket)
+{
+  BYTE buffer[POOL_DRAIN_SIZE];
+  socket.SetReadTimeout(0);
+  while (socket.Read(buffer, sizeof(buffer)))
+    ;
+  socket.SetReadTimeout(PMaxTimeInterval);
+}
+
+
+void RTP_PortPool::Main()
+{
+  PTRACE(3, "RTPPool\tPort pool thread started");
+
+  std::vector<std::pair<PString, SocketPair> > recycle;
+  std::vector<std::pair<PString, PIPSocket::Address> > wanted;
+
+  for (;;) {
+    PInt64 now = PTimer::Tick().GetMilliSeconds();
+    PInt64 next = -1;
+
+    mutex.Wait();
+
+    if (shutdown) {
+      mutex.Signal();
+      break;
+    }
+
+    // Take the pairs out of quarantine and count what each interface is short of
+    recycle.clear();
+    wanted.clear();
+    for (InterfaceMap::iterator it = interfaces.begin(); it != interfaces.end(); ++it) {
+      Interface & iface = it->second;
+      while (!iface.quarantined.empty() && iface.quarantined.front().released + quarantineTime <= now) {
+        recycle.push_back(std::pair<PString, SocketPair>(it->first, iface.quarantined.front()));
+        iface.quarantined.pop_front();
+        iface.opening++;
+      }
+
+      if (!iface.quarantined.empty()) {
+        PInt64 due = iface.quarantined.front().released + quarantineTime;
+        if (next < 0 || due < next)
+          next = due;
+      }
+
+      while ((PINDEX)iface.ready.size() + iface.opening < poolSize) {
+        wanted.push_back(std::pair<PString, PIPSocket::Address>(it->first, iface.address));
+        iface.opening++;
+      }
+    }
+
+    mutex.Signal();
+
+    // Sockets are drained and bound without the lock so sessions are not held up
+    for (size_t i = 0; i < recycle.size(); i++) {
+      Drain(*recycle[i].second.data);
+      Drain(*recycle[i].second.control);
+    }
+
+    mutex.Wait();
+    for (size_t i = 0; i < recycle.size(); i++) {
+      Interface & iface = interfaces[recycle[i].first];
+      iface.opening--;
+      // Pairs beyond the pool size, left from a busy period, are closed
+      if ((PINDEX)iface.ready.size() < poolSize)
+        iface.ready.push_back(recycle[i].second);
+      else {
+        delete recycle[i].second.data;
+        delete recycle[i].second.control;
+      }
+    }
+    mutex.Signal();
+
+    PTRACE_IF(4, !recycle.empty(), "RTPPool\tRecycled " << recycle.size() << " pairs");
+
+    size_t opened = 0;
+    while (opened < wanted.size()) {
+      SocketPair pair;
+      if (!OpenPair(wanted[opened].second, pair.data, pair.control))
+        break;
+      pair.released = 0;
+
+      PWaitAndSignal m(mutex);
+      Interface & iface = interfaces[wanted[opened].first];
+      iface.ready.push_back(pair);
+      iface.opening--;
+      opened++;
+      if (shutdown)
+        break;
+    }
+
+    if (opened < wanted.size()) {
+      // Out of ports, give up the rest of this round and try again later
+      PWaitAndSignal m(mutex);
+      for (size_t i = opened; i < wanted.size(); i++)
+        interfaces[wanted[i].first].opening--;
+      PInt64 retry = PTimer::Tick().GetMilliSeconds() + POOL_RETRY_INTERVAL;
+      if (next < 0 || retry < next)
+        next = retry;
+    }
+
+    PTRACE_IF(4, opened > 0, "RTPPool\tOpened " << opened << " pairs");
+
+    now = PTimer::Tick().GetMilliSeconds();
+    if (next < 0)
+      wakeUp.Wait();
+    else if (next > now)
+      wakeUp.Wait(PTimeInterval(next - now));
+  }
+
+  PTRACE(3, "RTPPool\tPort pool thread ended");
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
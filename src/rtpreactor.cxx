@@ -0,0 +1,445 @@
+/*
+ * rtpreactor.cxx
+ *
+ * Shared event driven RTP media reactor
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "rtpreactor.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#include "rtpreactor.h"
+#include "rtp.h"
+
+#include <map>
+#include <set>
+
+#if defined(P_LINUX)
+#define H323_REACTOR_EPOLL 1
+#include <sys/epoll.h>
+#include <unistd.h>
+#elif defined(P_MACOSX) || defined(P_FREEBSD) || defined(P_OPENBSD) || defined(P_NETBSD)
+#define H323_REACTOR_KQUEUE 1
+#include <sys/types.h>
+#include <sys/event.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+#define new PNEW
+
+/* Maximum number of socket events collected by one wait call */
+#define REACTOR_MAX_EVENTS   64
+
+/* How often the worker checks its sessions for RTCP reports due (milliseconds) */
+#define REACTOR_REPORT_CHECK 250
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+class RTP_MediaReactor::Worker : public PThread
+{
+    PCLASSINFO(Worker, PThread);
+  public:
+    Worker(PINDEX index, PThread::Priority priority, PINDEX stackSize, const H323CPUSet & affinity);
+    ~Worker();
+
+    PBoolean IsOpen() const { return pollHandle >= 0; }
+    int GetCPU() const { return affinity.GetWorkerCPU(index); }
+    PBoolean Add(RTP_Session & session);
+    PBoolean Remove(RTP_Session & session);
+    PBoolean Contains(RTP_Session & session);
+    PINDEX GetLoad() const { return loadCount; }
+
+    void Main();
+
+  protected:
+    PBoolean Watch(int fd);
+    void Unwatch(int fd);
+    void Dispatch(int fd);
+    void DropSession(RTP_Session & session);
+    void CheckReports();
+
+    struct Registration {
+      RTP_Session * session;
+      PBoolean      isData;
+    };
+    std::map<int, Registration> handles;
+    std::set<RTP_Session *>     sessions;
+    PMutex                      dispatchMutex;
+    PAtomicInteger              loadCount;
+    PINDEX                      index;
+    H323CPUSet                  affinity;
+
+    int      pollHandle;
+    int      wakePipe[2];
+    PBoolean shutdown;
+};
+
+
+RTP_MediaReactor::Worker::Worker(PINDEX idx, PThread::Priority priority, PINDEX stackSize, const H323CPUSet & cpus)
+  : PThread(stackSize, NoAutoDeleteThread, priority, psprintf("RTP Reactor:%u", (unsigned)idx)),
+    loadCount(0), index(idx), affinity(cpus), pollHandle(-1), shutdown(FALSE)
+{
+  wakePipe[0] = wakePipe[1] = -1;
+
+#if defined(H323_REACTOR_EPOLL) || defined(H323_REACTOR_KQUEUE)
+#if defined(H323_REACTOR_EPOLL)
+  pollHandle = epoll_create(REACTOR_MAX_EVENTS);
+#else
+  pollHandle = kqueue();
+#endif
+  if (pollHandle < 0) {
+    PTRACE(1, "RTPReact\tCould not create event queue, errno=" << errno);
+    return;
+  }
+
+  if (pipe(wakePipe) != 0 || !Watch(wakePipe[0])) {
+    PTRACE(1, "RTPReact\tCould not create wake up pipe, errno=" << errno);
+    close(pollHandle);
+    pollHandle = -1;
+    return;
+  }
+
+  Resume();
+#endif
+}
+
+
+RTP_MediaReactor::Worker::~Worker()
+{
+#if defined(H323_REACTOR_EPOLL) || defined(H323_REACTOR_KQUEUE)
+  if (pollHandle >= 0) {
+    shutdown = TRUE;
+    char wake = 0;
+    if (write(wakePipe[1], &wake, 1) != 1) {
+      PTRACE(2, "RTPReact\tCould not wake worker " << GetThreadName());
+    }
+    WaitForTermination(5000);
+    close(pollHandle);
+  }
+
+  if (wakePipe[0] >= 0) {
+    close(wakePipe[0]);
+    close(wakePipe[1]);
+  }
+#endif
+}
+
+
+PBoolean RTP_MediaReactor::Worker::Watch(int fd)
+{
+#if defined(H323_REACTOR_EPOLL)
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.fd = fd;
+  return epoll_ctl(pollHandle, EPOLL_CTL_ADD, fd, &ev) == 0;
+#elif defined(H323_REACTOR_KQUEUE)
+  struct kevent ev;
+  EV_SET(&ev, fd, EVFILT_READ, EV_ADD, 0, 0, NULL);
+  return kevent(pollHandle, &ev, 1, NULL, 0, NULL) == 0;
+#else
+  return FALSE;
+#endif
+}
+
+
+void RTP_MediaReactor::Worker::Unwatch(int fd)
+{
+#if defined(H323_REACTOR_EPOLL)
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  epoll_ctl(pollHandle, EPOLL_CTL_DEL, fd, &ev);
+#elif defined(H323_REACTOR_KQUEUE)
+  struct kevent ev;
+  EV_SET(&ev, fd, EVFILT_READ, EV_DELETE, 0, 0, NULL);
+  kevent(pollHandle, &ev, 1, NULL, 0, NULL);
+#endif
+}
+
+
+PBoolean RTP_MediaReactor::Worker::Add(RTP_Session & session)
+{
+  int dataFd = (int)session.GetDataSocketHandle();
+  int controlFd = (int)session.GetControlSocketHandle();
+  if (dataFd < 0 || controlFd < 0)
+    return FALSE;
+
+  PWaitAndSignal m(dispatchMutex);
+
+  // Register before watching so the first event can always find its session
+  Registration reg;
+  reg.session = &session;
+  reg.isData = TRUE;
+  handles[dataFd] = reg;
+  reg.isData = FALSE;
+  handles[controlFd] = reg;
+
+  if (!Watch(dataFd) || !Watch(controlFd)) {
+    PTRACE(2, "RTPReact\tCould not watch session " << session.GetSessionID() << ", errno=" << errno);
+    Unwatch(dataFd);
+    Unwatch(controlFd);
+    handles.erase(dataFd);
+    handles.erase(controlFd);
+    return FALSE;
+  }
+
+  sessions.insert(&session);
+  ++loadCount;
+
+  PTRACE(4, "RTPReact\tSession " << session.GetSessionID() << " added to " << GetThreadName());
+  return TRUE;
+}
+
+
+PBoolean RTP_MediaReactor::Worker::Remove(RTP_Session & session)
+{
+  // Waiting on the dispatch mutex guarantees no call back is in progress
+  PWaitAndSignal m(dispatchMutex);
+
+  if (sessions.find(&session) == sessions.end())
+    return FALSE;
+
+  DropSession(session);
+  return TRUE;
+}
+
+
+PBoolean RTP_MediaReactor::Worker::Contains(RTP_Session & session)
+{
+  PWaitAndSignal m(dispatchMutex);
+  return sessions.find(&session) != sessions.end();
+}
+
+
+void RTP_MediaReactor::Worker::DropSession(RTP_Session & session)
+{
+  std::map<int, Registration>::iterator r = handles.begin();
+  while (r != handles.end()) {
+    if (r->second.session == &session) {
+      Unwatch(r->first);
+      handles.erase(r++);
+    }
+    else
+      ++r;
+  }
+
+  if (sessions.erase(&session) > 0)
+    --loadCount;
+
+  PTRACE(4, "RTPReact\tSession " << session.GetSessionID() << " removed from " << GetThreadName());
+}
+
+
+void RTP_MediaReactor::Worker::Dispatch(int fd)
+{
+  if (fd == wakePipe[0]) {
+    char buffer[16];
+    if (read(fd, buffer, sizeof(buffer)) < 0) {
+      PTRACE(2, "RTPReact\tWake up pipe read error, errno=" << errno);
+    }
+    return;
+  }
+
+  // A session removed earlier in the same batch simply has no entry any more
+  std::map<int, Registration>::iterator r = handles.find(fd);
+  if (r == handles.end())
+    return;
+
+  RTP_Session & session = *r->second.session;
+  if (!session.OnReactorEvent(r->second.isData))
+    DropSession(session);
+}
+
+
+void RTP_MediaReactor::Worker::CheckReports()
+{
+  std::set<RTP_Session *>::iterator s = sessions.begin();
+  while (s != sessions.end()) {
+    RTP_Session & session = **s++;
+    if (!session.SendReport()) {
+      PTRACE(2, "RTPReact\tSession " << session.GetSessionID() << " report failed");
+    }
+  }
+}
+
+
+void RTP_MediaReactor::Worker::Main()
+{
+  PTRACE(3, "RTPReact\tWorker thread started");
+
+  affinity.ApplyToCurrentThread(index);
+
+  PTimeInterval lastReportCheck = PTimer::Tick();
+
+  while (!shutdown) {
+    int fds[REACTOR_MAX_EVENTS];
+    int count = 0;
+
+#if defined(H323_REACTOR_EPOLL)
+    struct epoll_event events[REACTOR_MAX_EVENTS];
+    count = epoll_wait(pollHandle, events, REACTOR_MAX_EVENTS, REACTOR_REPORT_CHECK);
+    for (int i = 0; i < count; i++)
+      fds[i] = events[i].data.fd;
+#elif defined(H323_REACTOR_KQUEUE)
+    struct kevent events[REACTOR_MAX_EVENTS];
+    struct timespec timeout;
+    timeout.tv_sec = 0;
+    timeout.tv_nsec = REACTOR_REPORT_CHECK*1000000L;
+    count = kevent(pollHandle, NULL, 0, events, REACTOR_MAX_EVENTS, &timeout);
+    for (int i = 0; i < count; i++)
+      fds[i] = (int)events[i].ident;
+#endif
+
+    if (count < 0) {
+      if (errno == EINTR)
+        continue;
+      PTRACE(1, "RTPReact\tWait error, errno=" << errno);
+      break;
+    }
+
+    PWaitAndSignal m(dispatchMutex);
+
+    for (int i = 0; i < count; i++)
+      Dispatch(fds[i]);
+
+    PTimeInterval now = PTimer::Tick();
+    if ((now - lastReportCheck).GetMilliSeconds() >= REACTOR_REPORT_CHECK) {
+      lastReportCheck = now;
+      CheckReports();
+    }
+  }
+
+  PTRACE(3, "RTPReact\tWorker thread ended");
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+RTP_MediaReactor::RTP_MediaReactor(PINDEX threadCount, PThread::Priority priority, PINDEX stackSize,
+                                   const H323CPUSet & affinity)
+  : socketSteering(FALSE)
+{
+  if (!IsAvailable()) {
+    PTRACE(2, "RTPReact\tNo event mechanism on this platform, reactor disabled");
+    return;
+  }
+
+  for (PINDEX i = 0; i < threadCount; i++) {
+    Worker * worker = new Worker(i, priority, stackSize, affinity);
+    if (worker->IsOpen())
+      workers.push_back(worker);
+    else
+      delete worker;
+  }
+
+  PTRACE(3, "RTPReact\tCreated media reactor with " << workers.size() << " threads");
+}
+
+
+RTP_MediaReactor::~RTP_MediaReactor()
+{
+  PWaitAndSignal m(mutex);
+
+  for (size_t i = 0; i < workers.size(); i++)
+    delete workers[i];
+  workers.clear();
+
+  PTRACE(3, "RTPReact\tDeleted media reactor");
+}
+
+
+PBoolean RTP_MediaReactor::IsAvailable()
+{
+#if defined(H323_REACTOR_EPOLL) || defined(H323_REACTOR_KQUEUE)
+  return TRUE;
+#else
+  return FALSE;
+#endif
+}
+
+
+PBoolean RTP_MediaReactor::AddSession(RTP_Session & session)
+{
+  PWaitAndSignal m(mutex);
+
+  if (workers.empty())
+    return FALSE;
+
+  for (size_t i = 0; i < workers.size(); i++) {
+    if (workers[i]->Contains(session))
+      return TRUE;
+  }
+
+  Worker * best = workers[0];
+  for (size_t i = 1; i < workers.size(); i++) {
+    if (workers[i]->GetLoad() < best->GetLoad())
+      best = workers[i];
+  }
+
+  // Keep the session on the CPU its packets already arrive on
+  if (socketSteering) {
+    int cpu = H323CPUSet::GetSocketCPU((int)session.GetDataSocketHandle());
+    for (size_t i = 0; cpu >= 0 && i < workers.size(); i++) {
+      if (workers[i]->GetCPU() == cpu) {
+        PTRACE(4, "RTPReact\tSession " << session.GetSessionID() << " steered to CPU " << cpu);
+        best = workers[i];
+        break;
+      }
+    }
+  }
+
+  return best->Add(session);
+}
+
+
+void RTP_MediaReactor::RemoveSession(RTP_Session & session)
+{
+  PWaitAndSignal m(mutex);
+
+  for (size_t i = 0; i < workers.size(); i++) {
+    if (workers[i]->Remove(session))
+      break;
+  }
+}
+
+
+PINDEX RTP_MediaReactor::GetSessionCount() const
+{
+  PINDEX count = 0;
+  for (size_t i = 0; i < workers.size(); i++)
+    count += workers[i]->GetLoad();
+  return count;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,745 @@
+/*
+ * rtprecord.cxx
+ *
+ * Recording of RTP media to disk off the media threads
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "rtprecord.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#include "rtprecord.h"
+#include "h323pluginmgr.h"
+
+#include <algorithm>
+
+#define new PNEW
+
+/* Disk sector the block size is a multiple of */
+#define RECORD_SECTOR_SIZE 4096
+
+/* Size of the rtpdump header ahead of each packet */
+#define RTPDUMP_PACKET_HEADER 8
+
+/* Milliseconds of arrival time between capture index entries */
+#define CAPTURE_INDEX_INTERVAL 1000
+
+/* Longest gap in a capture filled with silence when rendered */
+#define CAPTURE_MAX_GAP 10
+
+static const char CaptureMagic[8] = { 'H', '3', '2', '3', 'C', 'A', 'P', '1' };
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+class RTP_RecordingWriter::Thread : public PThread
+{
+    PCLASSINFO(Thread, PThread);
+  public:
+    Thread(RTP_RecordingWriter & _writer)
+      : PThread(10000, NoAutoDeleteThread, NormalPriority, "RTP Recorder"),
+        writer(_writer)
+    {
+      Resume();
+    }
+
+    void Main()
+    {
+      writer.Main();
+    }
+
+  protected:
+    RTP_RecordingWriter & writer;
+};
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+RTP_Recording::RTP_Recording(RTP_RecordingWriter & _writer,
+                             const PFilePath & _filename,
+                             Format _format,
+                             PINDEX bufferSize)
+  : writer(_writer),
+    filename(_filename),
+    format(_format),
+#ifdef _MSC_VER
+#pragma warning(disable:4355)
+#endif
+    receiveHandler(PCREATE_NOTIFIER(ReceivedPacket)),
+#ifdef _MSC_VER
+#pragma warning(default:4355)
+#endif
+    payloadType(RTP_DataFrame::IllegalPayloadType),
+    lastPayloadSize(0),
+    startTick(0),
+    streamBytes(0),
+    nextIndexTime(0),
+    ringIn(0),
+    ringOut(0),
+    droppedCount(0),
+    file(NULL),
+    blockFill(0),
+    failed(FALSE),
+    flushing(FALSE),
+    closed(FALSE)
+{
+  unsigned size = RECORD_SECTOR_SIZE;
+  while (size < (unsigned)bufferSize)
+    size <<= 1;
+  ring.SetSize(size);
+  ringMask = size-1;
+
+  block.SetSize(writer.GetBlockSize());
+
+  // Room for an hour of index so the media thread does not allocate
+  if (format == Capture)
+    captureIndex.reserve(3600);
+
+  writer.AddRecording(*this);
+}
+
+
+RTP_Recording::~RTP_Recording()
+{
+  Close();
+}
+
+
+void RTP_Recording::ReceivedPacket(RTP_DataFrame & frame, H323_INT)
+{
+  PINDEX payloadSize = frame.GetPayloadSize();
+
+  if (payloadType == RTP_DataFrame::IllegalPayloadType) {
+    // Ignore packets until actually get something of jitter buffer
+    if (payloadSize == 0)
+      return;
+    payloadType = frame.GetPayloadType();
+    startTime = PTime();
+    startTick = PTimer::Tick().GetMilliSeconds();
+  }
+
+  if (format == RTPDump) {
+    if (payloadSize == 0)
+      return;
+
+    PINDEX packetSize = frame.GetHeaderSize() + payloadSize;
+    DWORD offset = (DWORD)(PTimer::Tick().GetMilliSeconds() - startTick);
+    BYTE header[RTPDUMP_PACKET_HEADER];
+    *(PUInt16b *)&header[0] = (WORD)(packetSize + RTPDUMP_PACKET_HEADER);
+    *(PUInt16b *)&header[2] = (WORD)packetSize;
+    *(PUInt32b *)&header[4] = offset;
+    Push(header, sizeof(header), frame.GetPointer(), packetSize);
+    return;
+  }
+
+  if (format == Capture) {
+    if (payloadSize == 0)
+      return;
+
+    DWORD arrival = (DWORD)(PTimer::Tick().GetMilliSeconds() - startTick);
+    BYTE header[RTP_CaptureReader::PacketHeaderSize];
+    *(PUInt16b *)&header[0] = (WORD)payloadSize;
+    header[2] = (BYTE)(frame.GetPayloadType() | (frame.GetMarker() ? 0x80 : 0));
+    header[3] = 0;
+    *(PUInt16b *)&header[4] = frame.GetSequenceNumber();
+    *(PUInt32b *)&header[6] = arrival;
+    *(PUInt32b *)&header[10] = frame.GetTimestamp();
+    *(PUInt32b *)&header[14] = frame.GetSyncSource();
+
+    PUInt64 position = RTP_CaptureReader::HeaderSize + streamBytes;
+    if (Push(header, sizeof(header), frame.GetPayloadPtr(), payloadSize) && arrival >= nextIndexTime) {
+      captureIndex.push_back(std::pair<DWORD, PUInt64>(arrival, position));
+      nextIndexTime = arrival - arrival%CAPTURE_INDEX_INTERVAL + CAPTURE_INDEX_INTERVAL;
+    }
+    return;
+  }
+
+  if (payloadType != frame.GetPayloadType())
+    return;
+
+  if (payloadSize > 0) {
+    if (Push(NULL, 0, frame.GetPayloadPtr(), payloadSize)) {
+      lastPayloadSize = payloadSize;
+      memcpy(lastFrame.GetPointer(lastPayloadSize), frame.GetPayloadPtr(), payloadSize);
+    }
+  }
+  else if (lastPayloadSize > 0)
+    Push(NULL, 0, lastFrame, lastPayloadSize);
+}
+
+
+PBoolean RTP_Recording::Push(const BYTE * header, PINDEX headerSize, const BYTE * data, PINDEX size)
+{
+  unsigned in = ringIn;
+  unsigned used = in - ringOut;
+  unsigned total = headerSize + size;
+  if (used + total > ringMask+1) {
+    PTRACE_IF(2, droppedCount == 0, "RTPRec\tBuffer full, dropping packets from " << filename);
+    droppedCount++;
+    return FALSE;
+  }
+
+  BYTE * buffer = ring.GetPointer();
+  const BYTE * pieces[2] = { header, data };
+  PINDEX sizes[2] = { headerSize, size };
+  for (PINDEX p = 0; p < 2; p++) {
+    PINDEX done = 0;
+    while (done < sizes[p]) {
+      unsigned pos = (in + done) & ringMask;
+      PINDEX chunk = PMIN(sizes[p] - done, (PINDEX)(ringMask+1 - pos));
+      memcpy(buffer + pos, pieces[p] + done, chunk);
+      done += chunk;
+    }
+    in += sizes[p];
+  }
+
+  // The data must be in the buffer before the writer can see it
+  H323_MEMORY_BARRIER();
+  ringIn = in;
+  streamBytes += total;
+
+  // Wake a writer once per block rather than on every packet
+  PINDEX blockSize = writer.GetBlockSize();
+  if (used < (unsigned)blockSize && used + total >= (unsigned)blockSize)
+    writer.WakeUp();
+
+  return TRUE;
+}
+
+
+PBoolean RTP_Recording::Flush(PBoolean all)
+{
+  unsigned in = ringIn;
+  H323_MEMORY_BARRIER();
+
+  const BYTE * buffer = ring;
+  PINDEX blockSize = block.GetSize();
+
+  while (ringOut != in) {
+    unsigned out = ringOut;
+    if (failed) {
+      ringOut = in;
+      return FALSE;
+    }
+
+    if (file == NULL && !OpenFile()) {
+      failed = TRUE;
+      continue;
+    }
+
+    unsigned pos = out & ringMask;
+    PINDEX chunk = PMIN((PINDEX)(in - out), blockSize - blockFill);
+    chunk = PMIN(chunk, (PINDEX)(ringMask+1 - pos));
+    memcpy(block.GetPointer() + blockFill, buffer + pos, chunk);
+    blockFill += chunk;
+
+    // Copied out before the media thread may use the space again
+    H323_MEMORY_BARRIER();
+    ringOut = out + chunk;
+
+    if (blockFill == blockSize) {
+      if (!WriteBlock(block, blockFill))
+        failed = TRUE;
+      blockFill = 0;
+    }
+  }
+
+  if (all && blockFill > 0 && !failed) {
+    if (!WriteBlock(block, blockFill))
+      failed = TRUE;
+    blockFill = 0;
+  }
+
+  return !failed;
+}
+
+
+PBoolean RTP_Recording::OpenFile()
+{
+  if (format == RTPDump) {
+    file = new PFile(filename, PFile::WriteOnly);
+    if (!file->IsOpen()) {
+      PTRACE(1, "RTPRec\tCould not open " << filename << ": " << file->GetErrorText());
+      return FALSE;
+    }
+
+    // rtpdump file header, the address of the sender is not known to a filter
+    PString id = "#!rtpplay1.0 0.0.0.0/0\n";
+    BYTE header[16];
+    memset(header, 0, sizeof(header));
+    *(PUInt32b *)&header[0] = (DWORD)startTime.GetTimeInSeconds();
+    *(PUInt32b *)&header[4] = (DWORD)startTime.GetMicrosecond();
+    if (!file->Write((const char *)id, id.GetLength()) || !file->Write(header, sizeof(header))) {
+      PTRACE(1, "RTPRec\tCould not write " << filename << ": " << file->GetErrorText(PChannel::LastWriteError));
+      return FALSE;
+    }
+
+    PTRACE(3, "RTPRec\tStarted recording RTP to " << filename);
+    return TRUE;
+  }
+
+  if (format == Capture) {
+    file = new PFile(filename, PFile::WriteOnly);
+    if (!file->IsOpen()) {
+      PTRACE(1, "RTPRec\tCould not open " << filename << ": " << file->GetErrorText());
+      return FALSE;
+    }
+
+    // The index count and offset are filled in by Close()
+    BYTE header[RTP_CaptureReader::HeaderSize];
+    memset(header, 0, sizeof(header));
+    memcpy(header, CaptureMagic, sizeof(CaptureMagic));
+    *(PUInt32b *)&header[8] = (DWORD)startTime.GetTimeInSeconds();
+    *(PUInt32b *)&header[12] = (DWORD)startTime.GetMicrosecond();
+    if (!file->Write(header, sizeof(header))) {
+      PTRACE(1, "RTPRec\tCould not write " << filename << ": " << file->GetErrorText(PChannel::LastWriteError));
+      return FALSE;
+    }
+
+    PTRACE(3, "RTPRec\tStarted capture of payload type " << payloadType << " to " << filename);
+    return TRUE;
+  }
+
+  static int SupportedTypes[] = {
+    PWAVFile::fmt_uLaw,
+    0, 0,
+    PWAVFile::fmt_GSM,
+    PWAVFile::fmt_VivoG7231,
+    0, 0, 0,
+    PWAVFile::fmt_ALaw,
+    0, 0,
+    PWAVFile::fmt_PCM
+  };
+
+  PWAVFile * wav = new PWAVFile;
+  file = wav;
+
+  if (payloadType >= PARRAYSIZE(SupportedTypes) || SupportedTypes[payloadType] == 0) {
+    PTRACE(1, "RTPRec\tUnsupported payload type: " << payloadType);
+    return FALSE;
+  }
+
+  if (!wav->SetFormat(SupportedTypes[payloadType])) {
+    PTRACE(1, "RTPRec\tCould not set WAV file format: " << SupportedTypes[payloadType]);
+    return FALSE;
+  }
+
+  if (!wav->Open(filename, PFile::WriteOnly)) {
+    PTRACE(1, "RTPRec\tCould not open WAV file " << filename << ": " << wav->GetErrorText());
+    return FALSE;
+  }
+
+  PTRACE(3, "RTPRec\tStarted recording payload type " << payloadType << " to " << filename);
+  return TRUE;
+}
+
+
+PBoolean RTP_Recording::WriteCaptureIndex()
+{
+  off_t indexOffset = file->GetPosition();
+
+  PBYTEArray entries(captureIndex.size()*RTP_CaptureReader::IndexEntrySize);
+  for (size_t i = 0; i < captureIndex.size(); i++) {
+    BYTE * entry = entries.GetPointer() + i*RTP_CaptureReader::IndexEntrySize;
+    *(PUInt32b *)&entry[0] = captureIndex[i].first;
+    *(PUInt32b *)&entry[4] = (DWORD)(captureIndex[i].second >> 32);
+    *(PUInt32b *)&entry[8] = (DWORD)captureIndex[i].second;
+  }
+
+  BYTE header[12];
+  *(PUInt32b *)&header[0] = (DWORD)captureIndex.size();
+  *(PUInt32b *)&header[4] = (DWORD)((PUInt64)indexOffset >> 32);
+  *(PUInt32b *)&header[8] = (DWORD)indexOffset;
+
+  if ((entries.GetSize() > 0 && !file->Write(entries, entries.GetSize())) ||
+      !file->SetPosition(20) || !file->Write(header, sizeof(header))) {
+    PTRACE(1, "RTPRec\tCould not write index of " << filename << ": " << file->GetErrorText(PChannel::LastWriteError));
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+
+PBoolean RTP_Recording::WriteBlock(const BYTE * data, PINDEX size)
+{
+  if (file->Write(data, size))
+    return TRUE;
+
+  PTRACE(1, "RTPRec\tError writing " << filename << ": " << file->GetErrorText(PChannel::LastWriteError));
+  return FALSE;
+}
+
+
+void RTP_Recording::Close()
+{
+  if (closed)
+    return;
+
+  // Once removed no writer thread has the recording, so it is flushed here
+  writer.RemoveRecording(*this);
+
+  if (Flush(TRUE) && format == Capture && file != NULL && file->IsOpen())
+    WriteCaptureIndex();
+
+  if (file != NULL) {
+    file->Close();
+    delete file;
+    file = NULL;
+  }
+
+  PTRACE(3, "RTPRec\tClosed recording " << filename << ", " << droppedCount << " packets dropped");
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+RTP_CaptureReader::RTP_CaptureReader()
+  : endOfPackets(0)
+{
+}
+
+
+PBoolean RTP_CaptureReader::Open(const PFilePath & filename)
+{
+  Close();
+
+  if (!file.Open(filename, PFile::ReadOnly)) {
+    PTRACE(2, "RTPRec\tCould not open capture " << filename << ": " << file.GetErrorText());
+    return FALSE;
+  }
+
+  BYTE header[HeaderSize];
+  if (!file.Read(header, sizeof(header)) || file.GetLastReadCount() != sizeof(header) ||
+      memcmp(header, CaptureMagic, sizeof(CaptureMagic)) != 0) {
+    PTRACE(2, "RTPRec\tNot a capture file: " << filename);
+    file.Close();
+    return FALSE;
+  }
+
+  startTime = PTime(*(PUInt32b *)&header[8], *(PUInt32b *)&header[12]);
+  DWORD count = *(PUInt32b *)&header[20];
+  PUInt64 indexOffset = ((PUInt64)(DWORD)*(PUInt32b *)&header[24] << 32) | (DWORD)*(PUInt32b *)&header[28];
+
+  if (indexOffset == 0) {
+    // Never closed, the packets run to the end of the file
+    endOfPackets = file.GetLength();
+    PTRACE(3, "RTPRec\tCapture " << filename << " has no index");
+  }
+  else {
+    endOfPackets = indexOffset;
+    PBYTEArray entries(count*IndexEntrySize);
+    if (file.SetPosition((off_t)indexOffset) && file.Read(entries.GetPointer(), entries.GetSize()) &&
+        file.GetLastReadCount() == entries.GetSize()) {
+      for (DWORD i = 0; i < count; i++) {
+        const BYTE * entry = (const BYTE *)entries + i*IndexEntrySize;
+        PUInt64 position = ((PUInt64)(DWORD)*(PUInt32b *)&entry[4] << 32) | (DWORD)*(PUInt32b *)&entry[8];
+        index.push_back(std::pair<DWORD, PUInt64>(*(PUInt32b *)&entry[0], position));
+      }
+    }
+    else {
+      PTRACE(2, "RTPRec\tCould not read index of " << filename);
+    }
+  }
+
+  file.SetPosition(HeaderSize);
+  return TRUE;
+}
+
+
+void RTP_CaptureReader::Close()
+{
+  file.Close();
+  index.clear();
+  endOfPackets = 0;
+}
+
+
+PBoolean RTP_CaptureReader::ReadPacket(RTP_DataFrame & frame, DWORD & arrival)
+{
+  if ((PUInt64)file.GetPosition() + PacketHeaderSize > endOfPackets)
+    return FALSE;
+
+  BYTE header[PacketHeaderSize];
+  if (!file.Read(header, sizeof(header)) || file.GetLastReadCount() != sizeof(header))
+    return FALSE;
+
+  PINDEX size = *(PUInt16b *)&header[0];
+  frame.SetPayloadSize(size);
+  frame.SetPayloadType((RTP_DataFrame::PayloadTypes)(header[2]&0x7f));
+  frame.SetMarker((header[2]&0x80) != 0);
+  frame.SetSequenceNumber(*(PUInt16b *)&header[4]);
+  arrival = *(PUInt32b *)&header[6];
+  frame.SetTimestamp(*(PUInt32b *)&header[10]);
+  frame.SetSyncSource(*(PUInt32b *)&header[14]);
+
+  // A packet cut short by a recording that was never closed is not returned
+  return size == 0 || (file.Read(frame.GetPayloadPtr(), size) && file.GetLastReadCount() == size);
+}
+
+
+PBoolean RTP_CaptureReader::Seek(const PTimeInterval & offset)
+{
+  DWORD target = (DWORD)offset.GetMilliSeconds();
+
+  // Start from the last index entry before the time and read on from there
+  PUInt64 position = HeaderSize;
+  for (size_t i = 0; i < index.size() && index[i].first <= target; i++)
+    position = index[i].second;
+
+  if (!file.SetPosition((off_t)position))
+    return FALSE;
+
+  RTP_DataFrame frame;
+  for (;;) {
+    off_t start = file.GetPosition();
+    DWORD arrival;
+    if (!ReadPacket(frame, arrival))
+      return FALSE;
+    if (arrival >= target)
+      return file.SetPosition(start);
+  }
+}
+
+
+PBoolean RTP_CaptureReader::RenderToWAV(const PFilePath & wavFile, const PString & mediaFormat)
+{
+  if (!file.SetPosition(HeaderSize))
+    return FALSE;
+
+  RTP_DataFrame frame;
+  DWORD arrival;
+  if (!ReadPacket(frame, arrival)) {
+    PTRACE(2, "RTPRec\tCapture is empty");
+    return FALSE;
+  }
+
+  OpalMediaFormat format(mediaFormat);
+  if (mediaFormat.IsEmpty()) {
+    OpalMediaFormat::List formats = H323PluginCodecManager::GetMediaFormats();
+    for (PINDEX i = 0; i < formats.GetSize(); i++) {
+      if (formats[i].GetPayloadType() == frame.GetPayloadType() && formats[i].GetDefaultSessionID() == OpalMediaFormat::DefaultAudioSessionID) {
+        format = formats[i];
+        break;
+      }
+    }
+  }
+
+  OpalFactoryCodec * decoder = format.IsEmpty() ? NULL : H323PluginCodecManager::CreateCodec(format + "|L16");
+  if (decoder == NULL) {
+    PTRACE(2, "RTPRec\tNo decoder for payload type " << frame.GetPayloadType() << " format \"" << format << '"');
+    return FALSE;
+  }
+
+  unsigned sampleRate = decoder->GetSampleRate() > 0 ? decoder->GetSampleRate() : 8000;
+  unsigned clockRate = format.GetTimeUnits() > 0 ? format.GetTimeUnits()*1000 : sampleRate;
+  unsigned bytesPerFrame = decoder->GetBytesPerFrame();
+  unsigned samplesPerFrame = decoder->GetSamplesPerFrame();
+
+  PWAVFile wav(PWAVFile::fmt_PCM);
+  wav.SetChannels(1);
+  wav.SetSampleRate(sampleRate);
+  wav.SetSampleSize(16);
+  if (!wav.Open(wavFile, PFile::WriteOnly)) {
+    PTRACE(2, "RTPRec\tCould not open WAV file " << wavFile << ": " << wav.GetErrorText());
+    delete decoder;
+    return FALSE;
+  }
+
+  RTP_DataFrame::PayloadTypes payloadType = frame.GetPayloadType();
+  PBYTEArray pcm;
+  PBYTEArray silence;
+  PBoolean first = TRUE;
+  DWORD nextTimestamp = 0;
+  PBoolean ok = TRUE;
+
+  do {
+    if (frame.GetPayloadType() != payloadType)
+      continue;
+
+    // Fill a gap in the timestamps with silence, skip a late or repeated packet
+    if (!first) {
+      int gap = (int)(frame.GetTimestamp() - nextTimestamp);
+      if (gap < 0)
+        continue;
+      if (gap > 0 && (unsigned)gap < clockRate*CAPTURE_MAX_GAP) {
+        PINDEX bytes = (PINDEX)((PUInt64)gap*sampleRate/clockRate)*2;
+        memset(silence.GetPointer(bytes), 0, bytes);
+        ok = wav.Write(silence, bytes);
+      }
+    }
+    first = FALSE;
+
+    const BYTE * payload = frame.GetPayloadPtr();
+    PINDEX remaining = frame.GetPayloadSize();
+    unsigned samples = 0;
+    while (ok && remaining > 0) {
+      unsigned fromLen = bytesPerFrame > 0 && bytesPerFrame < (unsigned)remaining ? bytesPerFrame : remaining;
+      unsigned toLen = (samplesPerFrame > 0 ? samplesPerFrame : fromLen)*2;
+      if (toLen < fromLen*2)
+        toLen = fromLen*2;   // Sample based codecs decode a whole packet at once
+      unsigned flags = 0;
+      unsigned consumed = fromLen;
+      if (!decoder->Encode(payload, &consumed, pcm.GetPointer(toLen), &toLen, &flags)) {
+        PTRACE(3, "RTPRec\tDecoder failed on packet " << frame.GetSequenceNumber());
+        break;
+      }
+      if (toLen > 0)
+        ok = wav.Write(pcm, toLen);
+      samples += toLen/2;
+      payload += fromLen;
+      remaining -= fromLen;
+    }
+
+    nextTimestamp = frame.GetTimestamp() + (DWORD)((PUInt64)samples*clockRate/sampleRate);
+  } while (ok && ReadPacket(frame, arrival));
+
+  if (!ok) {
+    PTRACE(2, "RTPRec\tError writing WAV file " << wavFile << ": " << wav.GetErrorText(PChannel::LastWriteError));
+  }
+
+  wav.Close();
+  delete decoder;
+  return ok;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+RTP_RecordingWriter::RTP_RecordingWriter(PINDEX threadCount, PINDEX size, const PTimeInterval & interval)
+  : blockSize((size + RECORD_SECTOR_SIZE-1)/RECORD_SECTOR_SIZE*RECORD_SECTOR_SIZE),
+    flushInterval(interval),
+    shutdown(FALSE),
+    wakeUp(0, INT_MAX)
+{
+  if (blockSize == 0)
+    blockSize = RECORD_SECTOR_SIZE;
+
+  for (PINDEX i = 0; i < (threadCount > 0 ? threadCount : 1); i++)
+    threads.push_back(new Thread(*this));
+
+  PTRACE(3, "RTPRec\tCreated writer with " << threads.size() << " threads, block size " << blockSize);
+}
+
+
+RTP_RecordingWriter::~RTP_RecordingWriter()
+{
+  mutex.Wait();
+  shutdown = TRUE;
+  PTRACE_IF(1, !recordings.empty(), "RTPRec\tWriter deleted with " << recordings.size() << " recordings open");
+  mutex.Signal();
+
+  for (size_t i = 0; i < threads.size(); i++)
+    wakeUp.Signal();
+  for (size_t i = 0; i < threads.size(); i++) {
+    threads[i]->WaitForTermination();
+    delete threads[i];
+  }
+}
+
+
+PINDEX RTP_RecordingWriter::GetRecordingCount() const
+{
+  PWaitAndSignal m(mutex);
+  return recordings.size();
+}
+
+
+void RTP_RecordingWriter::AddRecording(RTP_Recording & recording)
+{
+  PWaitAndSignal m(mutex);
+  recordings.push_back(&recording);
+}
+
+
+void RTP_RecordingWriter::RemoveRecording(RTP_Recording & recording)
+{
+  mutex.Wait();
+
+  recording.closed = TRUE;
+  while (recording.flushing) {
+    mutex.Signal();
+    flushed.Wait(100);
+    mutex.Wait();
+  }
+
+  recordings.remove(&recording);
+
+  mutex.Signal();
+}
+
+
+void RTP_RecordingWriter::Main()
+{
+  PTRACE(4, "RTPRec\tWriter thread started");
+
+  std::vector<RTP_Recording *> pending;
+
+  for (;;) {
+    wakeUp.Wait(flushInterval);
+
+    mutex.Wait();
+    if (shutdown) {
+      mutex.Signal();
+      break;
+    }
+    pending.assign(recordings.begin(), recordings.end());
+    mutex.Signal();
+
+    // Each recording with data waiting is taken by one thread at a time
+    for (size_t i = 0; i < pending.size(); i++) {
+      RTP_Recording * recording = pending[i];
+
+      mutex.Wait();
+      // Closed recordings are off the list and may be deleted already
+      PBoolean take = std::find(recordings.begin(), recordings.end(), recording) != recordings.end() &&
+                      !recording->flushing && recording->ringIn != recording->ringOut;
+      if (take)
+        recording->flushing = TRUE;
+      mutex.Signal();
+
+      if (!take)
+        continue;
+
+      recording->Flush(FALSE);
+
+      mutex.Wait();
+      recording->flushing = FALSE;
+      mutex.Signal();
+      flushed.Signal();
+    }
+  }
+
+  PTRACE(4, "RTPRec\tWriter thread ended");
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,277 @@
+/*
+ * rtpred.cxx
+ *
+ * RFC 2198 redundant audio for RTP
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "rtpred.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#include "rtpred.h"
+
+#define new PNEW
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+RTP_RedundantEncoder::RTP_RedundantEncoder(PINDEX lvl, RTP_DataFrame::PayloadTypes type)
+  : level(lvl < MaxLevel ? lvl : (PINDEX)MaxLevel),
+    payloadType(type),
+    newest(0),
+    count(0)
+{
+  for (PINDEX i = 0; i <= MaxLevel; i++)
+    history[i].data.SetSize(MaxBlockSize);
+  packet.SetPayloadSize((MaxLevel+1)*(MaxBlockSize+4));
+}
+
+
+RTP_DataFrame & RTP_RedundantEncoder::Encode(const RTP_DataFrame & frame)
+{
+  PINDEX size = frame.GetPayloadSize();
+  DWORD timestamp = frame.GetTimestamp();
+
+  // Earlier payloads that can still be described, oldest first
+  PINDEX blocks[MaxLevel];
+  PINDEX blockCount = 0;
+  PINDEX total = 1;
+  for (PINDEX i = count < level ? count : level; i > 0; i--) {
+    const Block & block = history[(newest + MaxLevel+1 - (i-1)) % (MaxLevel+1)];
+    DWORD offset = timestamp - block.timestamp;
+    if (offset > 0 && offset < 0x4000 && block.size > 0) {
+      blocks[blockCount++] = (newest + MaxLevel+1 - (i-1)) % (MaxLevel+1);
+      total += 4 + block.size;
+    }
+  }
+  total += size;
+
+  packet.SetMarker(frame.GetMarker());
+  packet.SetTimestamp(timestamp);
+  packet.SetPayloadType(payloadType);
+  packet.SetPayloadSize(total);
+
+  BYTE * ptr = packet.GetPayloadPtr();
+  for (PINDEX i = 0; i < blockCount; i++) {
+    const Block & block = history[blocks[i]];
+    DWORD offset = timestamp - block.timestamp;
+    ptr[0] = (BYTE)(0x80 | block.payloadType);
+    ptr[1] = (BYTE)(offset >> 6);
+    ptr[2] = (BYTE)(((offset & 0x3f) << 2) | (block.size >> 8));
+    ptr[3] = (BYTE)block.size;
+    ptr += 4;
+  }
+  *ptr++ = (BYTE)frame.GetPayloadType();
+
+  for (PINDEX i = 0; i < blockCount; i++) {
+    const Block & block = history[blocks[i]];
+    memcpy(ptr, (const BYTE *)block.data, block.size);
+    ptr += block.size;
+  }
+  memcpy(ptr, frame.GetPayloadPtr(), size);
+
+  // Keep this payload for the packets after, unless it can never be carried
+  if (level > 0) {
+    newest = (newest + 1) % (MaxLevel+1);
+    Block & block = history[newest];
+    block.payloadType = frame.GetPayloadType();
+    block.timestamp = timestamp;
+    block.size = size <= MaxBlockSize ? size : 0;
+    if (block.size > 0)
+      memcpy(block.data.GetPointer(), frame.GetPayloadPtr(), size);
+    if (count < MaxLevel+1)
+      count++;
+  }
+
+  return packet;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+RTP_RedundantDecoder::RTP_RedundantDecoder(RTP_DataFrame::PayloadTypes type)
+  : payloadType(type),
+    recoveredCount(0),
+    recoveredTotal(0),
+    started(FALSE),
+    highestSequence(0),
+    receivedMask(0)
+{
+  for (PINDEX i = 0; i < RTP_RedundantEncoder::MaxLevel; i++)
+    recovered[i].data.SetSize(RTP_RedundantEncoder::MaxBlockSize);
+}
+
+
+PBoolean RTP_RedundantDecoder::WasReceived(WORD sequenceNumber) const
+{
+  if (!started)
+    return FALSE;
+
+  WORD behind = (WORD)(highestSequence - sequenceNumber);
+  if (behind >= 0x8000)
+    return FALSE;   // Newer than any so far
+  if (behind >= 64)
+    return TRUE;    // Too old to be of use, treat as had
+  return (receivedMask & ((PUInt64)1 << behind)) != 0;
+}
+
+
+PBoolean RTP_RedundantDecoder::MarkReceived(WORD sequenceNumber)
+{
+  if (!started) {
+    started = TRUE;
+    highestSequence = sequenceNumber;
+    receivedMask = 1;
+    return TRUE;
+  }
+
+  WORD behind = (WORD)(highestSequence - sequenceNumber);
+  if (behind >= 0x8000) {
+    WORD ahead = (WORD)(sequenceNumber - highestSequence);
+    receivedMask = ahead < 64 ? (receivedMask << ahead) | 1 : 1;
+    highestSequence = sequenceNumber;
+    return TRUE;
+  }
+
+  if (behind >= 64)
+    return FALSE;
+
+  PUInt64 bit = (PUInt64)1 << behind;
+  if ((receivedMask & bit) != 0)
+    return FALSE;
+
+  receivedMask |= bit;
+  return TRUE;
+}
+
+
+PBoolean RTP_RedundantDecoder::Decode(RTP_DataFrame & frame)
+{
+  WORD sequenceNumber = frame.GetSequenceNumber();
+
+  if (frame.GetPayloadType() != payloadType)
+    return MarkReceived(sequenceNumber);
+
+  BYTE * payload = frame.GetPayloadPtr();
+  PINDEX size = frame.GetPayloadSize();
+
+  // Walk the block headers, four bytes each and one for the primary
+  PINDEX headers = 0;
+  PINDEX blockCount = 0;
+  PINDEX dataSize = 0;
+  while (headers < size && (payload[headers] & 0x80) != 0) {
+    if (headers + 4 > size)
+      break;
+    dataSize += ((payload[headers+2] & 0x03) << 8) | payload[headers+3];
+    headers += 4;
+    blockCount++;
+  }
+
+  if (headers >= size || headers + 1 + dataSize > size) {
+    PTRACE(2, "RTP\tMalformed redundant packet " << sequenceNumber << ", size " << size);
+    return FALSE;
+  }
+
+  BYTE primaryType = (BYTE)(payload[headers] & 0x7f);
+  const BYTE * data = payload + headers + 1;
+  DWORD timestamp = frame.GetTimestamp();
+
+  // Copies of packets that have not arrived, the last blockCount before this
+  recoveredCount = 0;
+  for (PINDEX i = 0; i < blockCount; i++) {
+    const BYTE * header = payload + i*4;
+    PINDEX length = ((header[2] & 0x03) << 8) | header[3];
+    WORD lostSequence = (WORD)(sequenceNumber - (blockCount - i));
+
+    if (i + RTP_RedundantEncoder::MaxLevel >= blockCount && length > 0 &&
+        !WasReceived(lostSequence) && MarkReceived(lostSequence)) {
+      Recovered & copy = recovered[recoveredCount++];
+      copy.payloadType = (RTP_DataFrame::PayloadTypes)(header[0] & 0x7f);
+      copy.sequenceNumber = lostSequence;
+      copy.timestamp = timestamp - ((header[1] << 6) | (header[2] >> 2));
+      copy.syncSource = frame.GetSyncSource();
+      copy.size = length;
+      memcpy(copy.data.GetPointer(), data, length);
+      recoveredTotal++;
+      PTRACE(4, "RTP\tRecovered packet " << lostSequence << " from redundant copy in " << sequenceNumber);
+    }
+
+    data += length;
+  }
+
+  if (!MarkReceived(sequenceNumber))
+    return FALSE;
+
+  // The primary payload becomes the packet
+  PINDEX primarySize = size - (data - payload);
+  memmove(payload, data, primarySize);
+  frame.SetPayloadSize(primarySize);
+  frame.SetPayloadType((RTP_DataFrame::PayloadTypes)primaryType);
+  return TRUE;
+}
+
+
+PBoolean RTP_RedundantDecoder::TakeRecovered(RTP_DataFrame & frame)
+{
+  if (recoveredCount == 0)
+    return FALSE;
+
+  Recovered & copy = recovered[0];
+
+  // A plain header, the copy has no CSRC list or extension
+  frame.SetExtension(FALSE);
+  frame[0] = (BYTE)(frame[0] & 0xf0);
+  frame.SetMarker(FALSE);
+  frame.SetPayloadType(copy.payloadType);
+  frame.SetSequenceNumber(copy.sequenceNumber);
+  frame.SetTimestamp(copy.timestamp);
+  frame.SetSyncSource(copy.syncSource);
+  frame.SetPayloadSize(copy.size);
+  memcpy(frame.GetPayloadPtr(), (const BYTE *)copy.data, copy.size);
+
+  // Few waiting, move the rest down keeping the buffers
+  for (PINDEX i = 1; i < recoveredCount; i++) {
+    Recovered & prev = recovered[i-1];
+    Recovered & next = recovered[i];
+    prev.payloadType = next.payloadType;
+    prev.sequenceNumber = next.sequenceNumber;
+    prev.timestamp = next.timestamp;
+    prev.syncSource = next.syncSource;
+    prev.size = next.size;
+    memcpy(prev.data.GetPointer(), (const BYTE *)next.data, next.size);
+  }
+  recoveredCount--;
+  return TRUE;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
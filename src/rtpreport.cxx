@@ -0,0 +1,210 @@
+/*
+ * rtpreport.cxx
+ *
+ * Central RTCP report scheduling
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "rtpreport.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#include "rtpreport.h"
+
+#define new PNEW
+
+/* e-3/2 from RFC 3550 6.3.1, scaled by 1000 */
+#define REPORT_COMPENSATION 1218
+
+/* RFC 3550 minimum, used for a session with no report interval set */
+#define REPORT_MIN_INTERVAL 5000
+
+/* Size of the shared report frame, an SR or RR with one report block and SDES */
+#define REPORT_FRAME_SIZE 256
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+class RTP_ReportScheduler::Thread : public PThread
+{
+    PCLASSINFO(Thread, PThread);
+  public:
+    Thread(RTP_ReportScheduler & sched, PThread::Priority priority)
+      : PThread(10000, NoAutoDeleteThread, priority, "RTCP Reports"),
+        scheduler(sched)
+    {
+      Resume();
+    }
+
+    void Main()
+    {
+      scheduler.Main();
+    }
+
+  protected:
+    RTP_ReportScheduler & scheduler;
+};
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+RTP_ReportScheduler::RTP_ReportScheduler(PThread::Priority priority)
+  : reportFrame(REPORT_FRAME_SIZE),
+    reportCount(0),
+    shutdown(FALSE)
+{
+  thread = new Thread(*this, priority);
+
+  PTRACE(3, "RTPReport\tCreated report scheduler");
+}
+
+
+RTP_ReportScheduler::~RTP_ReportScheduler()
+{
+  mutex.Wait();
+  shutdown = TRUE;
+  PTRACE_IF(2, !sessions.empty(), "RTPReport\tDeleting scheduler with " << sessions.size() << " sessions");
+  mutex.Signal();
+
+  wakeUp.Signal();
+  thread->WaitForTermination();
+  delete thread;
+
+  PTRACE(3, "RTPReport\tDeleted report scheduler, " << reportCount << " reports sent");
+}
+
+
+void RTP_ReportScheduler::AddSession(RTP_Session & session)
+{
+  PWaitAndSignal m(mutex);
+
+  if (sessions.find(&session) != sessions.end())
+    return;
+
+  // Spread new sessions over a whole interval so a burst of calls does not report in step
+  PInt64 interval = session.GetReportTimeInterval().GetMilliSeconds();
+  if (interval <= 0)
+    interval = REPORT_MIN_INTERVAL;
+  PInt64 due = PTimer::Tick().GetMilliSeconds() + PRandom::Number()%interval;
+
+  PBoolean first = dueSessions.empty() || due < dueSessions.begin()->first;
+  Schedule(session, due);
+
+  PTRACE(4, "RTPReport\tAdded session " << session.GetSessionID() << ", " << sessions.size() << " sessions");
+
+  if (first)
+    wakeUp.Signal();
+}
+
+
+void RTP_ReportScheduler::RemoveSession(RTP_Session & session)
+{
+  PWaitAndSignal m(mutex);
+
+  SessionMap::iterator it = sessions.find(&session);
+  if (it == sessions.end())
+    return;
+
+  dueSessions.erase(it->second);
+  sessions.erase(it);
+
+  PTRACE(4, "RTPReport\tRemoved session " << session.GetSessionID() << ", " << sessions.size() << " sessions");
+
+  // The thread may be sending a batch it took before the removal
+  PWaitAndSignal s(sendMutex);
+}
+
+
+PInt64 RTP_ReportScheduler::GetRandomisedInterval(const PTimeInterval & interval)
+{
+  PInt64 ms = interval.GetMilliSeconds();
+  if (ms <= 0)
+    ms = REPORT_MIN_INTERVAL;
+  return ms*(500 + PRandom::Number()%1001)/REPORT_COMPENSATION;
+}
+
+
+void RTP_ReportScheduler::Schedule(RTP_Session & session, PInt64 due)
+{
+  sessions[&session] = dueSessions.insert(DueMap::value_type(due, &session));
+}
+
+
+void RTP_ReportScheduler::Main()
+{
+  PTRACE(3, "RTPReport\tReport scheduler thread started");
+
+  for (;;) {
+    PInt64 now = PTimer::Tick().GetMilliSeconds();
+    PInt64 next = -1;
+
+    mutex.Wait();
+
+    if (shutdown) {
+      mutex.Signal();
+      break;
+    }
+
+    // Take every session that is due and set its next time before sending
+    dueBatch.clear();
+    while (!dueSessions.empty() && dueSessions.begin()->first <= now) {
+      RTP_Session * session = dueSessions.begin()->second;
+      dueSessions.erase(dueSessions.begin());
+      Schedule(*session, now + GetRandomisedInterval(session->GetReportTimeInterval()));
+      dueBatch.push_back(session);
+    }
+
+    if (!dueSessions.empty())
+      next = dueSessions.begin()->first;
+
+    // Taken before the maps are released so RemoveSession() waits for this batch
+    sendMutex.Wait();
+    mutex.Signal();
+
+    for (size_t i = 0; i < dueBatch.size(); i++) {
+      if (dueBatch[i]->WriteReport(reportFrame))
+        reportCount++;
+    }
+
+    sendMutex.Signal();
+
+    PTRACE_IF(5, !dueBatch.empty(), "RTPReport\tSent " << dueBatch.size() << " reports");
+
+    if (next < 0)
+      wakeUp.Wait();
+    else if (next > now)
+      wakeUp.Wait(PTimeInterval(next - now));
+  }
+
+  PTRACE(3, "RTPReport\tReport scheduler thread ended");
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,333 @@
+/*
+ * rtpsched.cxx
+ *
+ * Timer wheel based RTP transmit pacing
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "rtpsched.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#include "rtpsched.h"
+#include "h323mediaclock.h"
+
+#define new PNEW
+
+/* A stream more than this many periods behind is resynchronised */
+#define SCHED_MAX_LATE_PERIODS 4
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+class RTP_TransmitScheduler::Thread : public PThread
+{
+    PCLASSINFO(Thread, PThread);
+  public:
+    Thread(RTP_TransmitScheduler & sched, PThread::Priority priority)
+      : PThread(10000, NoAutoDeleteThread, priority, "RTP Pacer"),
+        scheduler(sched)
+    {
+      Resume();
+    }
+
+    void Main()
+    {
+      scheduler.Main();
+    }
+
+  protected:
+    RTP_TransmitScheduler & scheduler;
+};
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+RTP_TransmitScheduler::Stream::Stream(const PString & streamName)
+  : name(streamName),
+    deadline(0),
+    registered(TRUE),
+    lateCount(0),
+    next(NULL),
+    prev(NULL),
+    slot(NULL)
+{
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+RTP_TransmitScheduler::RTP_TransmitScheduler(PThread::Priority priority)
+  : currentTick(H323MediaClock::GetMilliseconds()),
+    nextWake(-1),
+    pendingCount(0),
+    streamCount(0),
+    shutdown(FALSE)
+{
+  for (PINDEX i = 0; i < InnerSlots; i++)
+    inner[i] = NULL;
+  for (PINDEX i = 0; i < OuterSlots; i++)
+    outer[i] = NULL;
+
+  thread = new Thread(*this, priority);
+
+  PTRACE(3, "RTPSched\tCreated transmit scheduler");
+}
+
+
+RTP_TransmitScheduler::~RTP_TransmitScheduler()
+{
+  mutex.Wait();
+  shutdown = TRUE;
+  mutex.Signal();
+
+  wakeUp.Signal();
+  thread->WaitForTermination();
+  delete thread;
+
+  // Release anything still waiting
+  PWaitAndSignal m(mutex);
+  for (PINDEX i = 0; i < InnerSlots; i++) {
+    while (inner[i] != NULL) {
+      Stream * stream = inner[i];
+      Unlink(*stream);
+      stream->wakeUp.Signal();
+    }
+  }
+  for (PINDEX i = 0; i < OuterSlots; i++) {
+    while (outer[i] != NULL) {
+      Stream * stream = outer[i];
+      Unlink(*stream);
+      stream->wakeUp.Signal();
+    }
+  }
+  pendingCount = 0;
+
+  PTRACE(3, "RTPSched\tDeleted transmit scheduler");
+}
+
+
+RTP_TransmitScheduler::Stream * RTP_TransmitScheduler::Register(const PString & name)
+{
+  PWaitAndSignal m(mutex);
+
+  streamCount++;
+  PTRACE(4, "RTPSched\tRegistered " << name << ", " << streamCount << " streams");
+  return new Stream(name);
+}
+
+
+void RTP_TransmitScheduler::Unregister(Stream * stream)
+{
+  if (stream == NULL)
+    return;
+
+  mutex.Wait();
+
+  if (stream->slot != NULL) {
+    Unlink(*stream);
+    pendingCount--;
+  }
+  stream->registered = FALSE;
+  streamCount--;
+
+  PTRACE(4, "RTPSched\tUnregistered " << stream->name << ", late=" << stream->lateCount
+         << ", " << streamCount << " streams");
+
+  mutex.Signal();
+
+  delete stream;
+}
+
+
+PBoolean RTP_TransmitScheduler::WaitDeadline(Stream & stream, unsigned periodMs)
+{
+  {
+    PWaitAndSignal m(mutex);
+
+    if (shutdown || !stream.registered)
+      return FALSE;
+
+    PInt64 now = H323MediaClock::GetMilliseconds();
+
+    // First frame, or too far behind to catch up, start again from now
+    if (stream.deadline == 0 || now - stream.deadline > (PInt64)periodMs*SCHED_MAX_LATE_PERIODS) {
+      PTRACE_IF(4, stream.deadline != 0, "RTPSched\t" << stream.name << " resynchronised, "
+                << (now - stream.deadline) << "ms late");
+      if (stream.deadline != 0)
+        stream.lateCount++;
+      stream.deadline = now;
+      return TRUE;
+    }
+
+    stream.deadline += periodMs;
+    if (stream.deadline <= now)
+      return TRUE;
+
+    // Wheel is idle so nothing depends on its current position
+    if (pendingCount == 0)
+      currentTick = now;
+
+    Insert(stream);
+    pendingCount++;
+
+    // Only disturb the scheduler thread if it would sleep past this deadline
+    if (nextWake < 0 || stream.deadline < nextWake) {
+      nextWake = stream.deadline;
+      wakeUp.Signal();
+    }
+  }
+
+  stream.wakeUp.Wait();
+
+  PWaitAndSignal m(mutex);
+  return stream.registered && !shutdown;
+}
+
+
+void RTP_TransmitScheduler::Insert(Stream & stream)
+{
+  PInt64 delta = stream.deadline - currentTick;
+
+  Stream ** slot;
+  if (delta < InnerSlots)
+    slot = &inner[stream.deadline & (InnerSlots-1)];
+  else if (delta < InnerSlots*OuterSlots)
+    slot = &outer[(stream.deadline >> InnerBits) & (OuterSlots-1)];
+  else // Beyond the wheel, park in the furthest slot and cascade again later
+    slot = &outer[((currentTick + InnerSlots*OuterSlots - 1) >> InnerBits) & (OuterSlots-1)];
+
+  stream.slot = slot;
+  stream.prev = NULL;
+  stream.next = *slot;
+  if (stream.next != NULL)
+    stream.next->prev = &stream;
+  *slot = &stream;
+}
+
+
+void RTP_TransmitScheduler::Unlink(Stream & stream)
+{
+  if (stream.prev != NULL)
+    stream.prev->next = stream.next;
+  else
+    *stream.slot = stream.next;
+
+  if (stream.next != NULL)
+    stream.next->prev = stream.prev;
+
+  stream.next = stream.prev = NULL;
+  stream.slot = NULL;
+}
+
+
+void RTP_TransmitScheduler::Advance(PInt64 now)
+{
+  while (currentTick < now && pendingCount > 0) {
+    currentTick++;
+
+    // Moved into a new outer slot, spread its entries over the inner wheel
+    if ((currentTick & (InnerSlots-1)) == 0) {
+      Stream ** slot = &outer[(currentTick >> InnerBits) & (OuterSlots-1)];
+      Stream * list = *slot;
+      *slot = NULL;
+      while (list != NULL) {
+        Stream * stream = list;
+        list = stream->next;
+        stream->next = stream->prev = NULL;
+        stream->slot = NULL;
+        Insert(*stream);
+      }
+    }
+
+    Stream ** slot = &inner[currentTick & (InnerSlots-1)];
+    Stream * list = *slot;
+    *slot = NULL;
+    while (list != NULL) {
+      Stream * stream = list;
+      list = stream->next;
+      stream->next = stream->prev = NULL;
+      stream->slot = NULL;
+      if (stream->deadline > currentTick)
+        Insert(*stream);
+      else {
+        pendingCount--;
+        stream->wakeUp.Signal();
+      }
+    }
+  }
+
+  if (pendingCount == 0)
+    currentTick = now;
+}
+
+
+PInt64 RTP_TransmitScheduler::GetNextExpiry() const
+{
+  if (pendingCount == 0)
+    return -1;
+
+  // Next cascade point bounds the search of the inner wheel
+  PInt64 boundary = ((currentTick >> InnerBits) + 1) << InnerBits;
+  for (PInt64 tick = currentTick + 1; tick < boundary; tick++) {
+    if (inner[tick & (InnerSlots-1)] != NULL)
+      return tick;
+  }
+  return boundary;
+}
+
+
+void RTP_TransmitScheduler::Main()
+{
+  PTRACE(3, "RTPSched\tTransmit scheduler thread started");
+
+  for (;;) {
+    PInt64 now = H323MediaClock::GetMilliseconds();
+    PInt64 next;
+
+    {
+      PWaitAndSignal m(mutex);
+      if (shutdown)
+        break;
+      Advance(now);
+      next = nextWake = GetNextExpiry();
+    }
+
+    if (next < 0)
+      wakeUp.Wait();
+    else if (next > now)
+      wakeUp.Wait(PTimeInterval(next - now));
+  }
+
+  PTRACE(3, "RTPSched\tTransmit scheduler thread ended");
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,569 @@
+/*
+ * sigreactor.cxx
+ *
+ * Shared event driven H.225/H.245 signalling reactor
+ *
+ * H323Plus Library
+ *
+ * Copyright (c) 2026 ISVO (Asia) Pte. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is derived from and used in conjunction with the
+ * H323Plus Project (www.h323plus.org/)
+ *
+ * The Initial Developer of the Original Code is ISVO (Asia) Pte. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Id$
+ *
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "sigreactor.h"
+#endif
+
+#include "openh323buildopts.h"
+
+#include "sigreactor.h"
+#include "transports.h"
+
+#include <map>
+
+#if defined(P_LINUX)
+#define H323_REACTOR_EPOLL 1
+#include <sys/epoll.h>
+#include <unistd.h>
+#elif defined(P_MACOSX) || defined(P_FREEBSD) || defined(P_OPENBSD) || defined(P_NETBSD)
+#define H323_REACTOR_KQUEUE 1
+#include <sys/types.h>
+#include <sys/event.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+#define new PNEW
+
+/* Maximum number of socket events collected by one wait call */
+#define REACTOR_MAX_EVENTS   64
+
+/* How often the worker checks its handles for read timeouts (milliseconds) */
+#define REACTOR_TIMEOUT_CHECK 250
+
+/* Space kept free in the receive buffer of a handle for each read */
+#define REACTOR_READ_SIZE    4096
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323SignallingHandle::H323SignallingHandle(H323Transport & t, H323Connection & c)
+  : transport(t),
+    connection(c),
+    bufferLen(0),
+    lastActivity(PTimer::Tick())
+{
+  // Take over anything the previous reader had already received
+  bufferLen = transport.ExtractReadAhead(buffer, 0);
+}
+
+
+PBoolean H323SignallingHandle::IsServiceable(H323Transport & transport)
+{
+  // Derived transports (H.460.17/18, GnuGk) filter what they read themselves
+  if (strcmp(transport.GetClass(), H323TransportTCP::Class()) != 0)
+    return FALSE;
+
+  if (transport.IsTransportSecure())
+    return FALSE;
+
+  PChannel * base = transport.GetBaseReadChannel();
+  return base != NULL && PIsDescendant(base, PIPSocket) && ((PIPSocket *)base)->IsOpen();
+}
+
+
+int H323SignallingHandle::GetHandle() const
+{
+  PChannel * base = transport.GetBaseReadChannel();
+  return base != NULL ? base->GetHandle() : -1;
+}
+
+
+PBoolean H323SignallingHandle::OnReadable()
+{
+  if (!transport.IsOpen())
+    return FALSE;
+
+  if (buffer.GetSize() - bufferLen < REACTOR_READ_SIZE)
+    buffer.SetSize(bufferLen + REACTOR_READ_SIZE);
+
+  // One read per event, the level triggered wait comes back for any more
+  PTimeInterval oldTimeout = transport.GetReadTimeout();
+  transport.SetReadTimeout(0);
+  PBoolean ok = transport.Read(buffer.GetPointer() + bufferLen, buffer.GetSize() - bufferLen);
+  PINDEX count = transport.GetLastReadCount();
+  transport.SetReadTimeout(oldTimeout);
+
+  if (!ok || count == 0) {
+    PChannel::Errors error = transport.GetErrorCode(PChannel::LastReadError);
+    if (error == PChannel::Timeout)
+      return TRUE;   // Spurious wake up, nothing there after all
+
+    // A clean close by the remote reads as no data and no error
+    if (error == PChannel::NoError)
+      transport.SetErrorValues(PChannel::NotOpen, 0, PChannel::LastReadError);
+
+    PBYTEArray empty;
+    HandlePDU(FALSE, empty);
+    return FALSE;
+  }
+
+  bufferLen += count;
+  lastActivity = PTimer::Tick();
+
+  return ProcessBuffer();
+}
+
+
+PBoolean H323SignallingHandle::ProcessBuffer()
+{
+  while (bufferLen > 0) {
+    PINDEX pduLen = bufferLen;
+    if (!transport.ExtractPDU(buffer, pduLen)) {
+      PTRACE(1, "SigReact\tInvalid TPKT received on " << transport);
+      PBYTEArray empty;
+      HandlePDU(FALSE, empty);
+      return FALSE;
+    }
+
+    // Not yet a complete PDU
+    if (pduLen <= 0)
+      break;
+
+    transport.SetErrorValues(PChannel::NoError, 0, PChannel::LastReadError);
+    PBYTEArray pdu((const BYTE *)buffer + 4, pduLen - 4);
+
+    bufferLen -= pduLen;
+    if (bufferLen > 0)
+      memmove(buffer.GetPointer(), (const BYTE *)buffer + pduLen, bufferLen);
+
+    if (!HandlePDU(TRUE, pdu))
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+
+PBoolean H323SignallingHandle::OnTick(const PTimeInterval & now)
+{
+  PTimeInterval timeout = transport.GetReadTimeout();
+  if (timeout == PMaxTimeInterval || now - lastActivity < timeout)
+    return TRUE;
+
+  lastActivity = now;
+  transport.SetErrorValues(PChannel::Timeout, 0, PChannel::LastReadError);
+
+  PBYTEArray empty;
+  return HandlePDU(FALSE, empty);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+class H323SignallingReactor::Worker : public PThread
+{
+    PCLASSINFO(Worker, PThread);
+  public:
+    Worker(PINDEX index, PINDEX stackSize, const H323CPUSet & affinity);
+    ~Worker();
+
+    PBoolean IsOpen() const { return pollHandle >= 0; }
+    PBoolean Add(H323SignallingHandle & handle);
+    PBoolean Remove(H323SignallingHandle & handle);
+    PBoolean Services(H323Connection & connection);
+    PINDEX GetLoad() const { return loadCount; }
+
+    void Main();
+
+  protected:
+    PBoolean Watch(int fd);
+    void Unwatch(int fd);
+    void Dispatch(int fd);
+    void DropHandle(int fd);
+    void CheckTimeouts();
+
+    std::map<int, H323SignallingHandle *> handles;
+    std::vector<int>                      pending;
+    PMutex                                dispatchMutex;
+    PAtomicInteger                        loadCount;
+    H323CPUSet                            affinity;
+
+    int      pollHandle;
+    int      wakePipe[2];
+    PBoolean shutdown;
+};
+
+
+H323SignallingReactor::Worker::Worker(PINDEX index, PINDEX stackSize, const H323CPUSet & cpus)
+  : PThread(stackSize, NoAutoDeleteThread, NormalPriority, psprintf("H323 Reactor:%u", (unsigned)index)),
+    loadCount(0), affinity(cpus), pollHandle(-1), shutdown(FALSE)
+{
+  wakePipe[0] = wakePipe[1] = -1;
+
+#if defined(H323_REACTOR_EPOLL) || defined(H323_REACTOR_KQUEUE)
+#if defined(H323_REACTOR_EPOLL)
+  pollHandle = epoll_create(REACTOR_MAX_EVENTS);
+#else
+  pollHandle = kqueue();
+#endif
+  if (pollHandle < 0) {
+    PTRACE(1, "SigReact\tCould not create event queue, errno=" << errno);
+    return;
+  }
+
+  if (pipe(wakePipe) != 0 || !Watch(wakePipe[0])) {
+    PTRACE(1, "SigReact\tCould not create wake up pipe, errno=" << errno);
+    close(pollHandle);
+    pollHandle = -1;
+    return;
+  }
+
+  Resume();
+#endif
+}
+
+
+H323SignallingReactor::Worker::~Worker()
+{
+#if defined(H323_REACTOR_EPOLL) || defined(H323_REACTOR_KQUEUE)
+  if (pollHandle >= 0) {
+    shutdown = TRUE;
+    char wake = 0;
+    if (write(wakePipe[1], &wake, 1) != 1) {
+      PTRACE(2, "SigReact\tCould not wake worker " << GetThreadName());
+    }
+    WaitForTermination(5000);
+    close(pollHandle);
+  }
+
+  if (wakePipe[0] >= 0) {
+    close(wakePipe[0]);
+    close(wakePipe[1]);
+  }
+#endif
+}
+
+
+PBoolean H323SignallingReactor::Worker::Watch(int fd)
+{
+#if defined(H323_REACTOR_EPOLL)
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.fd = fd;
+  return epoll_ctl(pollHandle, EPOLL_CTL_ADD, fd, &ev) == 0;
+#elif defined(H323_REACTOR_KQUEUE)
+  struct kevent ev;
+  EV_SET(&ev, fd, EVFILT_READ, EV_ADD, 0, 0, NULL);
+  return kevent(pollHandle, &ev, 1, NULL, 0, NULL) == 0;
+#else
+  return FALSE;
+#endif
+}
+
+
+void H323SignallingReactor::Worker::Unwatch(int fd)
+{
+#if defined(H323_REACTOR_EPOLL)
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  epoll_ctl(pollHandle, EPOLL_CTL_DEL, fd, &ev);
+#elif defined(H323_REACTOR_KQUEUE)
+  struct kevent ev;
+  EV_SET(&ev, fd, EVFILT_READ, EV_DELETE, 0, 0, NULL);
+  kevent(pollHandle, &ev, 1, NULL, 0, NULL);
+#endif
+}
+
+
+PBoolean H323SignallingReactor::Worker::Add(H323SignallingHandle & handle)
+{
+  int fd = handle.GetHandle();
+  if (fd < 0)
+    return FALSE;
+
+  PWaitAndSignal m(dispatchMutex);
+
+  // A socket closed without being removed leaves a stale entry for its number
+  if (handles.find(fd) != handles.end()) {
+    PTRACE(2, "SigReact\tReplacing stale handle for socket " << fd);
+    Unwatch(fd);
+    handles.erase(fd);
+    --loadCount;
+  }
+
+  // Register before watching so the first event can always find its handle
+  handles[fd] = &handle;
+
+  if (!Watch(fd)) {
+    PTRACE(2, "SigReact\tCould not watch socket " << fd << ", errno=" << errno);
+    handles.erase(fd);
+    return FALSE;
+  }
+
+  ++loadCount;
+
+  // Data already received will not make the socket readable again
+  if (handle.HasPending()) {
+    pending.push_back(fd);
+    char wake = 0;
+    if (write(wakePipe[1], &wake, 1) != 1) {
+      PTRACE(2, "SigReact\tCould not wake worker " << GetThreadName());
+    }
+  }
+
+  PTRACE(4, "SigReact\tSocket " << fd << " added to " << GetThreadName());
+  return TRUE;
+}
+
+
+PBoolean H323SignallingReactor::Worker::Remove(H323SignallingHandle & handle)
+{
+  // Waiting on the dispatch mutex guarantees no call back is in progress
+  PWaitAndSignal m(dispatchMutex);
+
+  for (std::map<int, H323SignallingHandle *>::iterator h = handles.begin(); h != handles.end(); ++h) {
+    if (h->second == &handle) {
+      DropHandle(h->first);
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+
+PBoolean H323SignallingReactor::Worker::Services(H323Connection & connection)
+{
+  PWaitAndSignal m(dispatchMutex);
+
+  for (std::map<int, H323SignallingHandle *>::iterator h = handles.begin(); h != handles.end(); ++h) {
+    if (&h->second->GetConnection() == &connection)
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+
+void H323SignallingReactor::Worker::DropHandle(int fd)
+{
+  Unwatch(fd);
+  if (handles.erase(fd) > 0)
+    --loadCount;
+
+  PTRACE(4, "SigReact\tSocket " << fd << " removed from " << GetThreadName());
+}
+
+
+void H323SignallingReactor::Worker::Dispatch(int fd)
+{
+  if (fd == wakePipe[0]) {
+    char buffer[16];
+    if (read(fd, buffer, sizeof(buffer)) < 0) {
+      PTRACE(2, "SigReact\tWake up pipe read error, errno=" << errno);
+    }
+
+    std::vector<int> handover;
+    handover.swap(pending);
+    for (size_t i = 0; i < handover.size(); i++) {
+      std::map<int, H323SignallingHandle *>::iterator h = handles.find(handover[i]);
+      if (h != handles.end() && !h->second->ProcessBuffer()) {
+        H323SignallingHandle & handle = *h->second;
+        DropHandle(handover[i]);
+        handle.OnClose();
+      }
+    }
+    return;
+  }
+
+  // A handle removed earlier in the same batch simply has no entry any more
+  std::map<int, H323SignallingHandle *>::iterator h = handles.find(fd);
+  if (h == handles.end())
+    return;
+
+  H323SignallingHandle & handle = *h->second;
+  if (!handle.OnReadable()) {
+    DropHandle(fd);
+    handle.OnClose();
+  }
+}
+
+
+void H323SignallingReactor::Worker::CheckTimeouts()
+{
+  PTimeInterval now = PTimer::Tick();
+
+  std::map<int, H323SignallingHandle *>::iterator h = handles.begin();
+  while (h != handles.end()) {
+    int fd = h->first;
+    H323SignallingHandle & handle = *h->second;
+    ++h;
+    if (!handle.OnTick(now)) {
+      DropHandle(fd);
+      handle.OnClose();
+      // The call back may have removed other handles of the same call
+      h = handles.upper_bound(fd);
+    }
+  }
+}
+
+
+void H323SignallingReactor::Worker::Main()
+{
+  PTRACE(3, "SigReact\tWorker thread started");
+
+  affinity.ApplyToCurrentThread();
+
+  PTimeInterval lastTimeoutCheck = PTimer::Tick();
+
+  while (!shutdown) {
+    int fds[REACTOR_MAX_EVENTS];
+    int count = 0;
+
+#if defined(H323_REACTOR_EPOLL)
+    struct epoll_event events[REACTOR_MAX_EVENTS];
+    count = epoll_wait(pollHandle, events, REACTOR_MAX_EVENTS, REACTOR_TIMEOUT_CHECK);
+    for (int i = 0; i < count; i++)
+      fds[i] = events[i].data.fd;
+#elif defined(H323_REACTOR_KQUEUE)
+    struct kevent events[REACTOR_MAX_EVENTS];
+    struct timespec timeout;
+    timeout.tv_sec = 0;
+    timeout.tv_nsec = REACTOR_TIMEOUT_CHECK*1000000L;
+    count = kevent(pollHandle, NULL, 0, events, REACTOR_MAX_EVENTS, &timeout);
+    for (int i = 0; i < count; i++)
+      fds[i] = (int)events[i].ident;
+#endif
+
+    if (count < 0) {
+      if (errno == EINTR)
+        continue;
+      PTRACE(1, "SigReact\tWait error, errno=" << errno);
+      break;
+    }
+
+    PWaitAndSignal m(dispatchMutex);
+
+    for (int i = 0; i < count; i++)
+      Dispatch(fds[i]);
+
+    PTimeInterval now = PTimer::Tick();
+    if ((now - lastTimeoutCheck).GetMilliSeconds() >= REACTOR_TIMEOUT_CHECK) {
+      lastTimeoutCheck = now;
+      CheckTimeouts();
+    }
+  }
+
+  PTRACE(3, "SigReact\tWorker thread ended");
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323SignallingReactor::H323SignallingReactor(PINDEX threadCount, PINDEX stackSize, const H323CPUSet & affinity)
+{
+  if (!IsAvailable()) {
+    PTRACE(2, "SigReact\tNo event mechanism on this platform, reactor disabled");
+    return;
+  }
+
+  for (PINDEX i = 0; i < threadCount; i++) {
+    Worker * worker = new Worker(i, stackSize, affinity);
+    if (worker->IsOpen())
+      workers.push_back(worker);
+    else
+      delete worker;
+  }
+
+  PTRACE(3, "SigReact\tCreated signalling reactor with " << workers.size() << " threads");
+}
+
+
+H323SignallingReactor::~H323SignallingReactor()
+{
+  PWaitAndSignal m(mutex);
+
+  for (size_t i = 0; i < workers.size(); i++)
+    delete workers[i];
+  workers.clear();
+
+  PTRACE(3, "SigReact\tDeleted signalling reactor");
+}
+
+
+PBoolean H323SignallingReactor::IsAvailable()
+{
+#if defined(H323_REACTOR_EPOLL) || defined(H323_REACTOR_KQUEUE)
+  return TRUE;
+#else
+  return FALSE;
+#endif
+}
+
+
+PBoolean H323SignallingReactor::AddHandle(H323SignallingHandle & handle)
+{
+  PWaitAndSignal m(mutex);
+
+  if (workers.empty())
+    return FALSE;
+
+  // Keep the channels of a call on one worker so its PDUs stay in order
+  for (size_t i = 0; i < workers.size(); i++) {
+    if (workers[i]->Services(handle.GetConnection()))
+      return workers[i]->Add(handle);
+  }
+
+  Worker * best = workers[0];
+  for (size_t i = 1; i < workers.size(); i++) {
+    if (workers[i]->GetLoad() < best->GetLoad())
+      best = workers[i];
+  }
+
+  return best->Add(handle);
+}
+
+
+void H323SignallingReactor::RemoveHandle(H323SignallingHandle & handle)
+{
+  PWaitAndSignal m(mutex);
+
+  for (size_t i = 0; i < workers.size(); i++) {
+    if (workers[i]->Remove(handle))
+      break;
+  }
+}
+
+
+PINDEX H323SignallingReactor::GetHandleCount() const
+{
+  PINDEX count = 0;
+  for (size_t i = 0; i < workers.size(); i++)
+    count += workers[i]->GetLoad();
+  return count;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -71,7 +71,6 @@ class T120_X224 : public X224 {
 class T120ConnectPDU : public MCS_ConnectMCSPDU {
     PCLASSINFO(T120ConnectPDU, MCS_ConnectMCSPDU);
   public:
-    PBoolean Read(H323Transport & transport);
     PBoolean Write(H323Transport & transport);
   protected:
     T120_X224 x224;
@@ -84,14 +83,14 @@ class T120ConnectPDU : public MCS_ConnectMCSPDU {
 
 PBoolean T120_X224::Read(H323Transport & transport)
 {
-  PBYTEArray rawData;
+  PBYTEArray & rawData = GetReadBuffer();
 
   if (!transport.ReadPDU(rawData)) {
     PTRACE(1, "T120\tRead of X224 failed: " << transport.GetErrorText());
     return FALSE;
   }
 
-  if (Decode(rawData)) {
+  if (!Decode(rawData)) {
     PTRACE(1, "T120\tDecode of PDU failed:\n  " << setprecision(2) << *this);
     return FALSE;
   }
@@ -123,38 +122,143 @@ PBoolean T120_X224::Write(H323Transport & transport)
 
 /////////////////////////////////////////////////////////////////////////////
 
-PBoolean T120ConnectPDU::Read(H323Transport & transport)
+PBoolean T120ConnectPDU::Write(H323Transport & transport)
 {
-  if (!x224.Read(transport))
+  PTRACE(4, "T120\tSending MCS Connect PDU:\n  " << setprecision(2) << *this);
+
+  PBER_Stream ber;
+  Encode(ber);
+  ber.CompleteEncoding();
+  x224.BuildData(ber);
+  return x224.Write(transport);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+OpalT120SendData::OpalT120SendData()
+  : mcsOffset(0),
+    userDataOffset(0)
+{
+}
+
+
+PBoolean OpalT120SendData::Parse(const X224 & x224)
+{
+  if (x224.GetCode() != X224::DataPDU)
     return FALSE;
 
-  // An X224 Data PDU...
-  if (x224.GetCode() != X224::DataPDU) {
-    PTRACE(1, "T120\tX224 must be data PDU");
+  const PBYTEArray & data = x224.GetPDU();
+  PINDEX offset = x224.GetDataPointer() - (const BYTE *)data;
+  PINDEX size = data.GetSize();
+
+  // Choice index in the top six bits, then the initiator and channel ID
+  // aligned in two bytes each, then the priority and segmentation bits
+  if (size < offset+7)
+    return FALSE;
+
+  unsigned type = data[offset] >> 2;
+  if (type < SendDataRequest || type > UniformSendDataIndication)
     return FALSE;
+
+  // User data length, in one byte or fourteen bits of two
+  PINDEX dataOffset = offset+6;
+  PINDEX length = data[dataOffset++];
+  if ((length&0x80) != 0) {
+    if ((length&0x40) != 0 || size < dataOffset+1)
+      return FALSE;
+    length = ((length&0x3f) << 8) | data[dataOffset++];
   }
 
-  // ... contains the T120 MCS PDU
-  PBER_Stream ber = x224.GetData();
-  if (!Decode(ber)) {
-    PTRACE(1, "T120\tDecode of PDU failed:\n  " << setprecision(2) << *this);
+  if (size != dataOffset+length) {
+    PTRACE(2, "T120\tSend data PDU of " << length << " bytes in " << (size-dataOffset));
     return FALSE;
   }
 
-  PTRACE(4, "T120\tReceived MCS Connect PDU:\n  " << setprecision(2) << *this);
+  tpdu = data;
+  mcsOffset = offset;
+  userDataOffset = dataOffset;
   return TRUE;
 }
 
 
-PBoolean T120ConnectPDU::Write(H323Transport & transport)
+PBoolean OpalT120SendData::Build(Types type,
+                                 unsigned initiator,
+                                 unsigned channelId,
+                                 unsigned priority,
+                                 unsigned segmentation,
+                                 const BYTE * userData,
+                                 PINDEX userDataSize)
 {
-  PTRACE(4, "T120\tSending MCS Connect PDU:\n  " << setprecision(2) << *this);
+  if (userDataSize > MaxUserDataSize || initiator < 1001 || initiator > 65535 || channelId > 65535)
+    return FALSE;
 
-  PBER_Stream ber;
-  Encode(ber);
-  ber.CompleteEncoding();
-  x224.BuildData(ber);
-  return x224.Write(transport);
+  mcsOffset = 3;
+  userDataOffset = mcsOffset + (userDataSize < 0x80 ? 7 : 8);
+
+  // A TPDU that was read or is being written elsewhere is left to it
+  if (!tpdu.IsUnique())
+    tpdu = PBYTEArray();
+  tpdu.SetSize(userDataOffset + userDataSize);
+  BYTE * ptr = tpdu.GetPointer();
+  ptr[0] = 2;
+  ptr[1] = X224::DataPDU;
+  ptr[2] = 0x80;
+
+  ptr += mcsOffset;
+  ptr[0] = (BYTE)(type << 2);
+  ptr[1] = (BYTE)((initiator-1001) >> 8);
+  ptr[2] = (BYTE)(initiator-1001);
+  ptr[3] = (BYTE)(channelId >> 8);
+  ptr[4] = (BYTE)channelId;
+  ptr[5] = (BYTE)(((priority&3) << 6) | ((segmentation&3) << 4));
+  if (userDataSize < 0x80)
+    ptr[6] = (BYTE)userDataSize;
+  else {
+    ptr[6] = (BYTE)(0x80 | (userDataSize >> 8));
+    ptr[7] = (BYTE)userDataSize;
+  }
+
+  if (userDataSize > 0)
+    memcpy(tpdu.GetPointer() + userDataOffset, userData, userDataSize);
+
+  return TRUE;
+}
+
+
+void OpalT120SendData::SetType(Types type)
+{
+  if (GetType() == type)
+    return;
+
+  tpdu.MakeUnique();
+  tpdu[mcsOffset] = (BYTE)((type << 2) | (tpdu[mcsOffset]&3));
+}
+
+
+PBoolean OpalT120SendData::Write(H323Transport & transport) const
+{
+  PTRACE(5, "T120\tWrite " << *this);
+
+  if (!transport.WritePDU(tpdu)) {
+    PTRACE(1, "T120\tWrite X224 PDU failed: " << transport.GetErrorText());
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+
+void OpalT120SendData::PrintOn(ostream & strm) const
+{
+  static const char * const TypeNames[] = { "SDrq", "SDin", "USrq", "USin" };
+
+  strm << TypeNames[GetType()-SendDataRequest]
+       << " initiator=" << GetInitiator()
+       << " channel=" << GetChannelId()
+       << " priority=" << GetDataPriority()
+       << " segmentation=" << GetSegmentation()
+       << " data=" << GetUserDataSize();
 }
 
 
@@ -183,13 +287,7 @@ PBoolean OpalT120Protocol::Originate(H323Transport & transport)
     return FALSE;
   }
 
-  T120ConnectPDU pdu;
-  while (pdu.Read(transport)) {
-    if (!HandleConnect(pdu))
-      return TRUE;
-  }
-
-  return FALSE;
+  return HandlePDUs(transport);
 }
 
 
@@ -209,13 +307,7 @@ PBoolean OpalT120Protocol::Answer(H323Transport & transport)
   if (!x224.Write(transport))
     return FALSE;
 
-  T120ConnectPDU pdu;
-  while (pdu.Read(transport)) {
-    if (!HandleConnect(pdu))
-      return TRUE;
-  }
-
-  return FALSE;
+  return HandlePDUs(transport);
 }
 
 
@@ -231,4 +323,70 @@ PBoolean OpalT120Protocol::HandleDomain(const MCS_DomainMCSPDU & /*pdu*/)
 }
 
 
+PBoolean OpalT120Protocol::HandleSendData(const OpalT120SendData & pdu)
+{
+  MCS_DomainMCSPDU domain;
+  PPER_Stream per(pdu.GetMCSPointer(), pdu.GetMCSSize());
+  if (!domain.Decode(per)) {
+    PTRACE(1, "T120\tDecode of " << pdu << " failed");
+    return TRUE;
+  }
+
+  return HandleDomain(domain);
+}
+
+
+PBoolean OpalT120Protocol::HandlePDUs(H323Transport & transport)
+{
+  // The buffer of each TPDU is read into again for the next one, unless a
+  // handler has kept a send data PDU referring to it
+  T120_X224 x224;
+
+  while (x224.Read(transport)) {
+    // Made for each TPDU, so one from the last does not hold on to the buffer
+    OpalT120SendData sendData;
+
+    // An X224 Data PDU...
+    if (x224.GetCode() != X224::DataPDU) {
+      PTRACE(1, "T120\tX224 must be data PDU");
+      return FALSE;
+    }
+
+    // ... contains the T120 MCS PDU, a connect PDU in BER with a high
+    // application tag, or a domain PDU in PER
+    if (x224.GetDataSize() > 0 && x224.GetDataPointer()[0] == 0x7f) {
+      MCS_ConnectMCSPDU pdu;
+      PBER_Stream ber(x224.GetDataPointer(), x224.GetDataSize());
+      if (!pdu.Decode(ber)) {
+        PTRACE(1, "T120\tDecode of PDU failed:\n  " << setprecision(2) << pdu);
+        return FALSE;
+      }
+
+      PTRACE(4, "T120\tReceived MCS Connect PDU:\n  " << setprecision(2) << pdu);
+      if (!HandleConnect(pdu))
+        return TRUE;
+    }
+    else if (sendData.Parse(x224)) {
+      PTRACE(5, "T120\tReceived " << sendData);
+      if (!HandleSendData(sendData))
+        return TRUE;
+    }
+    else {
+      MCS_DomainMCSPDU pdu;
+      PPER_Stream per(x224.GetDataPointer(), x224.GetDataSize());
+      if (!pdu.Decode(per)) {
+        PTRACE(1, "T120\tDecode of PDU failed:\n  " << setprecision(2) << pdu);
+        return FALSE;
+      }
+
+      PTRACE(4, "T120\tReceived MCS Domain PDU:\n  " << setprecision(2) << pdu);
+      if (!HandleDomain(pdu))
+        return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
@@ -109,6 +109,10 @@
 #define new PNEW
 
 
+/* Longest encoding with a two octet PER length */
+#define T38_MAX_IFP_SIZE 16383
+
+
 /////////////////////////////////////////////////////////////////////////////
 
 OpalT38Protocol::OpalT38Protocol()
@@ -120,6 +124,10 @@ OpalT38Protocol::OpalT38Protocol()
   lowSpeedRedundancy = 0;
   highSpeedRedundancy = 0;
   lastSentSequenceNumber = -1;
+  redundantIn = 0;
+  redundantCount = 0;
+  for (PINDEX i = 0; i < MaxRedundantIFPs; i++)
+    redundantIFPs[i].size = 0;
 }
 
 
@@ -164,21 +172,12 @@ PBoolean OpalT38Protocol::Originate()
 
 PBoolean OpalT38Protocol::WritePacket(const T38_IFPPacket & ifp)
 {
-  T38_UDPTLPacket udptl;
-
-  // If there are redundant frames saved from last time, put them in
-  if (!redundantIFPs.IsEmpty()) {
-    udptl.m_error_recovery.SetTag(T38_UDPTLPacket_error_recovery::e_secondary_ifp_packets);
-    T38_UDPTLPacket_error_recovery_secondary_ifp_packets & secondary = udptl.m_error_recovery;
-    secondary.SetSize(redundantIFPs.GetSize());
-    for (PINDEX i = 0; i < redundantIFPs.GetSize(); i++)
-      secondary[i].SetValue(redundantIFPs[i]);
-  }
+  PPER_Stream encoded;
 
   // Encode the current ifp, but need to do stupid things as there are two
   // versions of the ASN out there, completely incompatible.
   if (corrigendumASN || !ifp.HasOptionalField(T38_IFPPacket::e_data_field))
-    udptl.m_primary_ifp_packet.EncodeSubType(ifp);
+    ifp.Encode(encoded);
   else {
     T38_PreCorrigendum_IFPPacket old_ifp;
 
@@ -197,50 +196,120 @@ PBoolean OpalT38Protocol::WritePacket(const T38_IFPPacket & ifp)
       }
     }
 
-    udptl.m_primary_ifp_packet.PASN_OctetString::EncodeSubType(old_ifp);
+    old_ifp.Encode(encoded);
   }
-
-  lastSentSequenceNumber = (lastSentSequenceNumber + 1) & 0xffff;
-  udptl.m_seq_number = lastSentSequenceNumber;
-
-  PPER_Stream rawData;
-  udptl.Encode(rawData);
+  encoded.CompleteEncoding();
 
 #if PTRACING
   if (PTrace::CanTrace(4)) {
     PTRACE(4, "T38\tSending PDU:\n  "
-           << setprecision(2) << ifp << "\n "
-           << setprecision(2) << udptl << "\n "
-           << setprecision(2) << rawData);
+           << setprecision(2) << ifp);
   }
   else {
     PTRACE(3, "T38\tSending PDU:"
-              " seq=" << lastSentSequenceNumber <<
+              " seq=" << ((lastSentSequenceNumber + 1) & 0xffff) <<
               " type=" << ifp.m_type_of_msg.GetTagName());
   }
 #endif
 
-  if (!transport->WritePDU(rawData)) {
-    PTRACE(1, "T38\tWritePacket error: " << transport->GetErrorText());
-    return FALSE;
-  }
+  return WriteEncodedPacket(encoded, encoded.GetSize(), GetRedundancy(ifp));
+}
+
 
+PINDEX OpalT38Protocol::GetRedundancy(const T38_IFPPacket & ifp) const
+{
   // Calculate the level of redundency for this data phase
-  PINDEX maxRedundancy;
   if (ifp.m_type_of_msg.GetTag() == T38_Type_of_msg::e_t30_indicator)
-    maxRedundancy = indicatorRedundancy;
+    return indicatorRedundancy;
   else if ((T38_Type_of_msg_data)ifp.m_type_of_msg  == T38_Type_of_msg_data::e_v21)
-    maxRedundancy = lowSpeedRedundancy;
+    return lowSpeedRedundancy;
   else
-    maxRedundancy = highSpeedRedundancy;
+    return highSpeedRedundancy;
+}
+
+
+static PINDEX EncodeLength(BYTE * ptr, PINDEX length)
+{
+  // Aligned PER length determinant, octet aligned here
+  if (length < 128) {
+    ptr[0] = (BYTE)length;
+    return 1;
+  }
+
+  ptr[0] = (BYTE)(0x80 | (length >> 8));
+  ptr[1] = (BYTE)length;
+  return 2;
+}
 
-  // Push down the current ifp into redundant data
-  if (maxRedundancy > 0)
-    redundantIFPs.InsertAt(0, new PBYTEArray(udptl.m_primary_ifp_packet.GetValue()));
 
-  // Remove redundant data that are surplus to requirements
-  while (redundantIFPs.GetSize() > maxRedundancy)
-    redundantIFPs.RemoveAt(maxRedundancy);
+PBoolean OpalT38Protocol::WriteEncodedPacket(const BYTE * ifp, PINDEX size, PINDEX maxRedundancy)
+{
+  if (size > T38_MAX_IFP_SIZE) {
+    PTRACE(1, "T38\tWritePacket error: IFP of " << size << " octets too large");
+    return FALSE;
+  }
+
+  if (maxRedundancy > MaxRedundantIFPs)
+    maxRedundancy = MaxRedundantIFPs;
+
+  PWaitAndSignal mutex(writeMutex);
+
+  // The UDPTL packet is laid out directly from the encodings rather than
+  // building it as ASN objects:
+  //   seq-number        16 bits
+  //   primary-ifp       length, octets
+  //   error-recovery    choice bit 0 for secondary-ifp-packets, padded
+  //   secondary count   length, then for each packet length, octets
+  PINDEX needed = 2 + 2 + size + 1 + 2;
+  PINDEX i;
+  for (i = 0; i < redundantCount; i++)
+    needed += 2 + redundantIFPs[(redundantIn - 1 - i) % MaxRedundantIFPs].size;
+  if (datagram.GetSize() < needed)
+    datagram.SetSize(needed);
+
+  lastSentSequenceNumber = (lastSentSequenceNumber + 1) & 0xffff;
+
+  BYTE * ptr = datagram.GetPointer();
+  *ptr++ = (BYTE)(lastSentSequenceNumber >> 8);
+  *ptr++ = (BYTE)lastSentSequenceNumber;
+  ptr += EncodeLength(ptr, size);
+  memcpy(ptr, ifp, size);
+  ptr += size;
+  *ptr++ = 0;
+  ptr += EncodeLength(ptr, redundantCount);
+  for (i = 0; i < redundantCount; i++) {
+    EncodedIFP & secondary = redundantIFPs[(redundantIn - 1 - i) % MaxRedundantIFPs];
+    ptr += EncodeLength(ptr, secondary.size);
+    memcpy(ptr, secondary.data, secondary.size);
+    ptr += secondary.size;
+  }
+
+  // Written from the buffer in place, without copying it to the exact size
+  PINDEX length = ptr - datagram.GetPointer();
+  PBYTEArray rawData(datagram, length, FALSE);
+
+  PTRACE(5, "T38\tSending UDPTL seq=" << lastSentSequenceNumber
+         << " redundancy=" << redundantCount << " size=" << length);
+
+  if (!transport->WritePDU(rawData)) {
+    PTRACE(1, "T38\tWritePacket error: " << transport->GetErrorText());
+    return FALSE;
+  }
+
+  // Push down the current ifp into redundant data, and remove what is
+  // surplus to requirements
+  if (maxRedundancy > 0) {
+    EncodedIFP & current = redundantIFPs[redundantIn % MaxRedundantIFPs];
+    if (current.data.GetSize() < size)
+      current.data.SetSize(size);
+    memcpy(current.data.GetPointer(), ifp, size);
+    current.size = size;
+    redundantIn++;
+    if (redundantCount < maxRedundancy)
+      redundantCount++;
+  }
+  if (redundantCount > maxRedundancy)
+    redundantCount = maxRedundancy;
 
   return TRUE;
 }
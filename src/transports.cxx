@@ -41,6 +41,10 @@
 #include "h323pdu.h"
 #include "h323ep.h"
 #include "gkclient.h"
+#include "h323timer.h"
+#include "rtpbatch.h"
+
+#include <vector>
 
 #ifdef P_STUN
 #include <ptclib/pstun.h>
@@ -53,11 +57,25 @@
 #include <openssl/opensslv.h>
 #include <openssl/ssl.h>
 #include <openssl/err.h>
+#include "h323tlscache.h"
+#endif
+
+#ifndef P_VXWORKS
+#define H323_GATHER_WRITE 1
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
 #endif
 
 // TCP KeepAlive
 static int KeepAliveInterval = 19;
 
+// Accepted TLS handshakes queued for each thread of the handshake pool
+#define TLS_HANDSHAKE_QUEUE_PER_WORKER 16
+
+// Space kept free in the TPKT receive buffer for each read
+#define TPKT_READ_SIZE 4096
+
 class H225TransportThread : public PThread
 {
   PCLASSINFO(H225TransportThread, PThread)
@@ -65,6 +83,8 @@ class H225TransportThread : public PThread
   public:
     H225TransportThread(H323EndPoint & endpoint, H323Transport * transport);
 
+    H225TransportThread(H323EndPoint & endpoint, H225TransportThreadPool & pool);
+
     ~H225TransportThread();
 
     void ConnectionEstablished(PBoolean keepAlive);
@@ -75,9 +95,10 @@ class H225TransportThread : public PThread
     void Main();
 
     H323Transport * transport;
+    H225TransportThreadPool * pool;
 
-    PDECLARE_NOTIFIER(PTimer, H225TransportThread, KeepAlive);
-    PTimer    m_keepAlive;
+    PDECLARE_NOTIFIER(H323Timer, H225TransportThread, KeepAlive);
+    H323Timer m_keepAlive;
     PBoolean useKeepAlive;
 };
 
@@ -102,8 +123,76 @@ class H245TransportThread : public PThread
     PBoolean useAggregator;
 #endif
 
-    PDECLARE_NOTIFIER(PTimer, H245TransportThread, KeepAlive);
-    PTimer    m_keepAlive;
+    PDECLARE_NOTIFIER(H323Timer, H245TransportThread, KeepAlive);
+    H323Timer m_keepAlive;
+};
+
+
+// The connection attempts of one H323TransportTCP::ConnectAny(), shared with
+// the attempt threads, which may end after it has returned
+class H323TCPConnectRace : public PObject
+{
+  PCLASSINFO(H323TCPConnectRace, PObject)
+
+  public:
+    H323TCPConnectRace(PINDEX count)
+      : references(1), running(0), failures(0),
+        winner(P_MAX_INDEX), won(NULL), finished(FALSE),
+        errorCode(PChannel::NoError), errorNumber(0),
+        sockets(count, (PTCPSocket *)NULL)
+    {
+    }
+
+    void Release()
+    {
+      mutex.Wait();
+      PBoolean last = --references == 0;
+      mutex.Signal();
+      if (last)
+        delete this;
+    }
+
+    PMutex       mutex;
+    PSyncPoint   changed;       ///< Signalled as each attempt ends
+    PINDEX       references;
+    PINDEX       running;
+    PINDEX       failures;
+    PINDEX       winner;
+    PTCPSocket * won;
+    PBoolean     finished;      ///< Connections made after this are closed
+    PChannel::Errors errorCode; ///< Of the last attempt to fail
+    int          errorNumber;
+    std::vector<PTCPSocket *> sockets;  ///< Attempts still connecting
+};
+
+
+class H323TCPConnectAttempt : public PThread
+{
+  PCLASSINFO(H323TCPConnectAttempt, PThread)
+
+  public:
+    H323TCPConnectAttempt(H323EndPoint & ep,
+                          H323TCPConnectRace & r,
+                          PINDEX i,
+                          PTCPSocket * s,
+                          const PIPSocket::Address & local,
+                          const PIPSocket::Address & remote)
+      : PThread(10000, AutoDeleteThread, NormalPriority, "H225 Connect:%x"),
+        endpoint(ep), race(r), index(i), socket(s),
+        localAddress(local), remoteAddress(remote)
+    {
+      Resume();
+    }
+
+  protected:
+    void Main();
+
+    H323EndPoint       & endpoint;
+    H323TCPConnectRace & race;
+    PINDEX               index;
+    PTCPSocket         * socket;
+    PIPSocket::Address   localAddress;
+    PIPSocket::Address   remoteAddress;
 };
 
 
@@ -117,7 +206,21 @@ H225TransportThread::H225TransportThread(H323EndPoint & ep, H323Transport * t)
             AutoDeleteThread,
             NormalPriority,
             "H225 Answer:%0x"),
-    transport(t)
+    transport(t),
+    pool(NULL)
+{
+  useKeepAlive = ep.EnableH225KeepAlive();
+  Resume();
+}
+
+
+H225TransportThread::H225TransportThread(H323EndPoint & ep, H225TransportThreadPool & p)
+  : PThread(ep.GetSignallingThreadStackSize(),
+            AutoDeleteThread,
+            NormalPriority,
+            "H225 Answer:%0x"),
+    transport(NULL),
+    pool(&p)
 {
   useKeepAlive = ep.EnableH225KeepAlive();
   Resume();
@@ -127,7 +230,7 @@ H225TransportThread::H225TransportThread(H323EndPoint & ep, H323Transport * t)
 H225TransportThread::~H225TransportThread()
 {
     if (useKeepAlive)
-       m_keepAlive.Stop();
+       m_keepAlive.Stop(TRUE);
 }
 
 void H225TransportThread::ConnectionEstablished(PBoolean keepAlive)
@@ -147,14 +250,24 @@ void H225TransportThread::EnableKeepAlive()
 
 void H225TransportThread::Main()
 {
+  if (pool != NULL) {
+    // Pooled thread, wait for the listener to hand over a call
+    transport = pool->WaitForTransport();
+    pool = NULL;
+    if (transport == NULL)
+      return;
+  }
+
   PTRACE(3, "H225\tStarted incoming call thread");
 
+  transport->GetEndPoint().GetThreadAffinity(H323EndPoint::SignallingThreads).ApplyToCurrentThread();
+
   if (!transport->HandleFirstSignallingChannelPDU(this))
     delete transport;
 }
 
 
-void H225TransportThread::KeepAlive(PTimer &,  H323_INT)
+void H225TransportThread::KeepAlive(H323Timer &,  H323_INT)
 {
   // Send empty RFC1006 TPKT
   BYTE tpkt[4];
@@ -171,6 +284,244 @@ void H225TransportThread::KeepAlive(PTimer &,  H323_INT)
      transport->Write(tpkt, len);
 }
 
+/////////////////////////////////////////////////////////////////////////////
+
+H225TransportThreadPool::H225TransportThreadPool(H323EndPoint & ep, PINDEX sz)
+  : endpoint(ep),
+    size(sz),
+    available(0, P_MAX_INDEX),
+    idle(0),
+    pooled(0),
+    closing(FALSE)
+{
+  waiting.DisallowDeleteObjects();
+
+  PWaitAndSignal m(mutex);
+  for (PINDEX i = 0; i < size; i++)
+    Spawn();
+
+  PTRACE(3, "H225\tStarted pool of " << size << " signalling threads");
+}
+
+
+H225TransportThreadPool::~H225TransportThreadPool()
+{
+  mutex.Wait();
+  closing = TRUE;
+  PINDEX wake = idle;
+  idle = 0;
+  PBoolean wait = pooled > 0;
+  mutex.Signal();
+
+  while (wake-- > 0)
+    available.Signal();
+
+  // Threads still waiting reference the pool, so they must all leave first
+  if (wait)
+    stopped.Wait();
+}
+
+
+PBoolean H225TransportThreadPool::Dispatch(H323Transport * transport)
+{
+  PWaitAndSignal m(mutex);
+  if (closing || idle == 0)
+    return FALSE;
+
+  idle--;
+  waiting.Enqueue(transport);
+  available.Signal();
+  return TRUE;
+}
+
+
+void H225TransportThreadPool::Spawn()
+{
+  // Must be called with the mutex held
+  pooled++;
+  idle++;
+  new H225TransportThread(endpoint, *this);
+}
+
+
+H323Transport * H225TransportThreadPool::WaitForTransport()
+{
+  available.Wait();
+
+  mutex.Wait();
+  H323Transport * transport = NULL;
+  if (!waiting.IsEmpty()) {
+    transport = waiting.Dequeue();
+    // Start the replacement here so the listener never waits on a thread create
+    if (!closing)
+      Spawn();
+  }
+  PBoolean last = --pooled == 0 && closing;
+  mutex.Signal();
+
+  if (last)
+    stopped.Signal();
+
+  return transport;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+#ifdef H323_TLS
+
+static void StartSignallingThread(H323EndPoint & endpoint, H323Transport * transport);
+
+H323TLSHandshakePool::H323TLSHandshakePool(H323EndPoint & ep, PINDEX _maxWorkers)
+  : endpoint(ep),
+    maxWorkers(_maxWorkers > 0 ? _maxWorkers : 1),
+    idleWorkers(0),
+    stopping(FALSE),
+    queued(0, INT_MAX)
+{
+  PTRACE(3, "TLS\tHandshake pool of up to " << maxWorkers << " threads");
+}
+
+
+H323TLSHandshakePool::~H323TLSHandshakePool()
+{
+  mutex.Wait();
+  stopping = TRUE;
+  std::vector<PThread *> threads = workers;
+  workers.clear();
+  std::list<Job> jobs = queue;
+  queue.clear();
+  mutex.Signal();
+
+  for (size_t i = 0; i < threads.size(); i++)
+    queued.Signal();
+  for (size_t i = 0; i < threads.size(); i++) {
+    threads[i]->WaitForTermination();
+    delete threads[i];
+  }
+
+  // Nothing left queued is started
+  for (std::list<Job>::iterator it = jobs.begin(); it != jobs.end(); ++it) {
+    if (it->accepted != NULL)
+      delete it->accepted;
+    else {
+      *it->result = FALSE;
+      it->done->Signal();
+    }
+  }
+}
+
+
+void H323TLSHandshakePool::Queue(const Job & job)
+{
+  // Called with the mutex held
+  queue.push_back(job);
+
+  if (idleWorkers == 0 && (PINDEX)workers.size() < maxWorkers)
+    workers.push_back(PThread::Create(PCREATE_NOTIFIER(WorkerMain), 0,
+                                      PThread::NoAutoDeleteThread,
+                                      PThread::NormalPriority,
+                                      "TLS Handshake:%x"));
+
+  queued.Signal();
+}
+
+
+void H323TLSHandshakePool::Accept(H323Transport * transport)
+{
+  mutex.Wait();
+
+  // Past this the peers would time out waiting anyway, do not add to the storm
+  if (stopping || (PINDEX)queue.size() >= maxWorkers*TLS_HANDSHAKE_QUEUE_PER_WORKER) {
+    mutex.Signal();
+    PTRACE(2, "TLS\tHandshake queue full, connection from "
+           << transport->GetRemoteAddress() << " refused");
+    delete transport;
+    return;
+  }
+
+  Job job;
+  job.accepted = transport;
+  job.connecting = NULL;
+  job.done = NULL;
+  job.result = NULL;
+  Queue(job);
+
+  mutex.Signal();
+}
+
+
+PBoolean H323TLSHandshakePool::Connect(H323TransportTCP & transport)
+{
+  PSyncPoint done;
+  PBoolean result = FALSE;
+
+  mutex.Wait();
+  if (stopping) {
+    mutex.Signal();
+    return transport.HandshakeConnect();
+  }
+
+  Job job;
+  job.accepted = NULL;
+  job.connecting = &transport;
+  job.done = &done;
+  job.result = &result;
+  Queue(job);
+  mutex.Signal();
+
+  done.Wait();
+  return result;
+}
+
+
+void H323TLSHandshakePool::WorkerMain(PThread &, H323_INT)
+{
+  PTRACE(4, "TLS\tHandshake worker started");
+
+  for (;;) {
+    mutex.Wait();
+    idleWorkers++;
+    mutex.Signal();
+
+    queued.Wait();
+
+    mutex.Wait();
+    idleWorkers--;
+    if (stopping || queue.empty()) {
+      PBoolean stop = stopping;
+      mutex.Signal();
+      if (stop)
+        break;
+      continue;
+    }
+    Job job = queue.front();
+    queue.pop_front();
+    mutex.Signal();
+
+    if (job.connecting != NULL) {
+      *job.result = job.connecting->HandshakeConnect();
+      job.done->Signal();
+    }
+    else if (job.accepted->SecureAccept())
+      StartSignallingThread(endpoint, job.accepted);
+    else {
+      PTRACE(2, "TLS\tHandshake failed, connection from "
+             << job.accepted->GetRemoteAddress() << " not started");
+      delete job.accepted;
+    }
+  }
+
+#if (OPENSSL_VERSION_NUMBER < 0x10100000L) || defined(LIBRESSL_VERSION_NUMBER)
+  ERR_remove_thread_state(NULL);
+#endif
+
+  PTRACE(4, "TLS\tHandshake worker ended");
+}
+
+#endif // H323_TLS
+
+
 /////////////////////////////////////////////////////////////////////////////
 
 H245TransportThread::H245TransportThread(H323EndPoint & endpoint,
@@ -200,7 +551,7 @@ H245TransportThread::H245TransportThread(H323EndPoint & endpoint,
 
 H245TransportThread::~H245TransportThread()
 {
-  m_keepAlive.Stop();
+  m_keepAlive.Stop(TRUE);
 }
 
 
@@ -208,6 +559,8 @@ void H245TransportThread::Main()
 {
   PTRACE(3, "H245\tStarted thread");
 
+  connection.GetEndPoint().GetThreadAffinity(H323EndPoint::SignallingThreads).ApplyToCurrentThread();
+
   if (transport.AcceptControlChannel(connection)) {
 #ifdef H323_SIGNAL_AGGREGATE
     // if the endpoint is using signalling aggregation, we need to add this connection
@@ -219,12 +572,13 @@ void H245TransportThread::Main()
     }
 #endif
 
-    connection.HandleControlChannel();
+    if (!connection.ReactorControlChannel(&transport))
+      connection.HandleControlChannel();
   }
 }
 
 
-void H245TransportThread::KeepAlive(PTimer &,  H323_INT)
+void H245TransportThread::KeepAlive(H323Timer &,  H323_INT)
 {
   // Send empty RFC1006 TPKT
   BYTE tpkt[4];
@@ -247,6 +601,162 @@ void H245TransportThread::KeepAlive(PTimer &,  H323_INT)
 
 static const char IpPrefix[] = "ip$";
 
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323TransportAddressKey::H323TransportAddressKey()
+  : length(0),
+    port(0)
+{
+  memset(bytes, 0, sizeof(bytes));
+}
+
+
+H323TransportAddressKey::H323TransportAddressKey(const PIPSocket::Address & ip, WORD _port)
+{
+  BYTE addr[16];
+  PINDEX size = ip.IsValid() ? ip.GetSize() : 0;
+  for (PINDEX i = 0; i < size && i < (PINDEX)sizeof(addr); i++)
+    addr[i] = ip[i];
+  SetAddress(size, addr, _port);
+}
+
+
+H323TransportAddressKey::H323TransportAddressKey(const H225_TransportAddress & pdu)
+{
+  switch (pdu.GetTag()) {
+    case H225_TransportAddress::e_ipAddress :
+    {
+      const H225_TransportAddress_ipAddress & ip = pdu;
+      SetAddress(ip.m_ip.GetSize(), ip.m_ip.GetValue(), (WORD)ip.m_port);
+      break;
+    }
+#ifdef H323_IPV6
+    case H225_TransportAddress::e_ip6Address :
+    {
+      const H225_TransportAddress_ip6Address & ip = pdu;
+      SetAddress(ip.m_ip.GetSize(), ip.m_ip.GetValue(), (WORD)ip.m_port);
+      break;
+    }
+#endif
+    default :
+      SetAddress(0, NULL, 0);
+  }
+}
+
+
+H323TransportAddressKey::H323TransportAddressKey(const H245_TransportAddress & pdu)
+{
+  SetAddress(0, NULL, 0);
+
+  if (pdu.GetTag() != H245_TransportAddress::e_unicastAddress)
+    return;
+
+  const H245_UnicastAddress & unicast = pdu;
+  switch (unicast.GetTag()) {
+    case H245_UnicastAddress::e_iPAddress :
+    {
+      const H245_UnicastAddress_iPAddress & ip = unicast;
+      SetAddress(ip.m_network.GetSize(), ip.m_network.GetValue(), (WORD)ip.m_tsapIdentifier);
+      break;
+    }
+#ifdef H323_IPV6
+    case H245_UnicastAddress::e_iP6Address :
+    {
+      const H245_UnicastAddress_iP6Address & ip = unicast;
+      SetAddress(ip.m_network.GetSize(), ip.m_network.GetValue(), (WORD)ip.m_tsapIdentifier);
+      break;
+    }
+#endif
+    default :
+      break;
+  }
+}
+
+
+H323TransportAddressKey::H323TransportAddressKey(const H323TransportAddress & address)
+{
+  *this = address.GetKey();
+}
+
+
+void H323TransportAddressKey::SetAddress(PINDEX size, const BYTE * addr, WORD _port)
+{
+  memset(bytes, 0, sizeof(bytes));
+  if (size != 4 && size != 16) {
+    length = 0;
+    port = 0;
+    return;
+  }
+
+  length = (BYTE)size;
+  memcpy(bytes, addr, size);
+  port = _port;
+}
+
+
+PIPSocket::Address H323TransportAddressKey::GetIp() const
+{
+  if (length == 0)
+    return PIPSocket::Address();
+  return PIPSocket::Address(length, bytes);
+}
+
+
+unsigned H323TransportAddressKey::GetHash() const
+{
+  // FNV-1a over the address bytes then the port
+  unsigned hash = 2166136261U;
+  for (PINDEX i = 0; i < length; i++)
+    hash = (hash ^ bytes[i]) * 16777619U;
+  hash = (hash ^ (port >> 8)) * 16777619U;
+  hash = (hash ^ (port & 0xff)) * 16777619U;
+  return hash;
+}
+
+
+bool H323TransportAddressKey::operator==(const H323TransportAddressKey & other) const
+{
+  return length == other.length && port == other.port && memcmp(bytes, other.bytes, length) == 0;
+}
+
+
+bool H323TransportAddressKey::operator<(const H323TransportAddressKey & other) const
+{
+  if (length != other.length)
+    return length < other.length;
+  int diff = memcmp(bytes, other.bytes, length);
+  if (diff != 0)
+    return diff < 0;
+  return port < other.port;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+static PBoolean SplitAddress(const PString & addr, PString & host, PString & service);
+
+// A numeric host and port resolve to the same address every time
+static PBoolean IsNumericAddress(const PString & host, const PString & service)
+{
+  if (host.IsEmpty() || host == "*")
+    return FALSE;
+
+  if (!service.IsEmpty()) {
+    if (strspn(service, "0123456789") != (size_t)service.GetLength())
+      return FALSE;
+    unsigned port = service.AsUnsigned();
+    if (port == 0 || port > 65535)
+      return FALSE;
+  }
+
+  if (host[0] == '[')
+    return host[host.GetLength()-1] == ']';
+
+  return strspn(host, "0123456789.") == (size_t)host.GetLength();
+}
+
+
 H323TransportAddress::H323TransportAddress(const char * cstr)
   : PString(cstr), m_version(4), m_tls(false)
 {
@@ -292,7 +802,7 @@ H323TransportAddress::H323TransportAddress(const H225_TransportAddress & transpo
     case H225_TransportAddress::e_ipAddress :
     {
       const H225_TransportAddress_ipAddress & ip = transport;
-      *this = BuildIP(PIPSocket::Address(ip.m_ip.GetSize(), ip.m_ip.GetValue()), ip.m_port);
+      SetBinary(PIPSocket::Address(ip.m_ip.GetSize(), ip.m_ip.GetValue()), (WORD)ip.m_port);
       m_version = 4;
       break;
     }
@@ -300,7 +810,7 @@ H323TransportAddress::H323TransportAddress(const H225_TransportAddress & transpo
     case H225_TransportAddress::e_ip6Address :
     {
       const H225_TransportAddress_ip6Address & ip = transport;
-      *this = BuildIP(PIPSocket::Address(ip.m_ip.GetSize(), ip.m_ip.GetValue()), ip.m_port);
+      SetBinary(PIPSocket::Address(ip.m_ip.GetSize(), ip.m_ip.GetValue()), (WORD)ip.m_port);
       m_version = 6;
       break;
     }
@@ -321,7 +831,7 @@ H323TransportAddress::H323TransportAddress(const H245_TransportAddress & transpo
         case H245_UnicastAddress::e_iPAddress :
         {
           const H245_UnicastAddress_iPAddress & ip = unicast;
-          *this = BuildIP(PIPSocket::Address(ip.m_network.GetSize(), ip.m_network.GetValue()), ip.m_tsapIdentifier);
+          SetBinary(PIPSocket::Address(ip.m_network.GetSize(), ip.m_network.GetValue()), (WORD)ip.m_tsapIdentifier);
           m_version = 4;
           break;
         }
@@ -329,7 +839,7 @@ H323TransportAddress::H323TransportAddress(const H245_TransportAddress & transpo
         case H245_UnicastAddress::e_iP6Address :
         {
           const H245_UnicastAddress_iP6Address & ip = unicast;
-          *this = BuildIP(PIPSocket::Address(ip.m_network.GetSize(), ip.m_network.GetValue()), ip.m_tsapIdentifier);
+          SetBinary(PIPSocket::Address(ip.m_network.GetSize(), ip.m_network.GetValue()), (WORD)ip.m_tsapIdentifier);
           m_version = 6;
           break;
         }
@@ -337,6 +847,17 @@ H323TransportAddress::H323TransportAddress(const H245_TransportAddress & transpo
         default:
             break;
       }
+      break;
+    }
+    case H245_TransportAddress::e_multicastAddress :
+    {
+      const H245_MulticastAddress & multicast = transport;
+      if (multicast.GetTag() == H245_MulticastAddress::e_iPAddress) {
+        const H245_MulticastAddress_iPAddress & ip = multicast;
+        SetBinary(PIPSocket::Address(ip.m_network.GetSize(), ip.m_network.GetValue()), (WORD)ip.m_tsapIdentifier);
+        m_version = 4;
+      }
+      break;
     }
     default:
         break;
@@ -352,7 +873,40 @@ H323TransportAddress::H323TransportAddress(const PIPSocket::Address & ip, WORD p
 #else
    m_version = 4;
 #endif
-  *this = BuildIP(ip, port);
+  SetBinary(ip, port);
+}
+
+
+void H323TransportAddress::SetBinary(const PIPSocket::Address & ip, WORD port)
+{
+  // Formatted directly, the binary form needs no parsing back
+  PString::operator=(BuildIP(ip, port));
+
+  // The any address follows the default address family, so is not kept
+  if (ip.IsValid() && !ip.IsAny()) {
+    m_binary = H323TransportAddressKey(ip, port);
+    m_binaryOf = *this;
+  }
+}
+
+
+PBoolean H323TransportAddress::GetBinary(PIPSocket::Address & ip, WORD & port) const
+{
+  if (!m_binary.IsValid() || (const char *)m_binaryOf != theArray)
+    return FALSE;
+
+  ip = m_binary.GetIp();
+  if (m_binary.GetPort() != 0)
+    port = m_binary.GetPort();
+  return TRUE;
+}
+
+
+H323TransportAddressKey H323TransportAddress::GetKey() const
+{
+  if (!m_binary.IsValid() || (const char *)m_binaryOf != theArray)
+    return H323TransportAddressKey();
+  return m_binary;
 }
 
 
@@ -377,14 +931,20 @@ void H323TransportAddress::Validate()
          m_version = ip.GetVersion();
     }
 #endif
-    return;
   }
-
-  if (strncmp(theArray, IpPrefix, 3) == 0) {
+  else if (strncmp(theArray, IpPrefix, 3) != 0) {
+    *this = PString();
     return;
   }
 
-  *this = PString();
+  // Parsed once here rather than each time the address is used
+  PString host, service;
+  PIPSocket::Address ip;
+  if (SplitAddress(*this, host, service) && IsNumericAddress(host, service) &&
+      PIPSocket::GetHostAddress(host, ip) && ip.IsValid() && !ip.IsAny()) {
+    m_binary = H323TransportAddressKey(ip, (WORD)service.AsUnsigned());
+    m_binaryOf = *this;
+  }
 }
 
 
@@ -421,6 +981,18 @@ PBoolean H323TransportAddress::SetPDU(H245_TransportAddress & pdu) const
   PIPSocket::Address ip;
   WORD port = 0;
   if (GetIpAndPort(ip, port)) {
+    // Only IPv4 groups, the IPv6 multicast choice is not used
+    if (ip.GetVersion() == 4 && (ip.Byte1() & 0xf0) == 0xe0) {
+      pdu.SetTag(H245_TransportAddress::e_multicastAddress);
+      H245_MulticastAddress & multicast = pdu;
+      multicast.SetTag(H245_MulticastAddress::e_iPAddress);
+      H245_MulticastAddress_iPAddress & addr = multicast;
+      for (PINDEX i = 0; i < 4; i++)
+        addr.m_network[i] = ip[i];
+      addr.m_tsapIdentifier = port;
+      return TRUE;
+    }
+
     pdu.SetTag(H245_TransportAddress::e_unicastAddress);
 
     H245_UnicastAddress & unicast = pdu;
@@ -456,6 +1028,11 @@ PBoolean H323TransportAddress::IsEquivalent(const H323TransportAddress & address
   if (IsEmpty() || address.IsEmpty())
     return FALSE;
 
+  H323TransportAddressKey key1 = GetKey();
+  H323TransportAddressKey key2 = address.GetKey();
+  if (key1.IsValid() && key2.IsValid() && key1.GetPort() != 0 && key2.GetPort() != 0)
+    return key1 == key2;
+
   PIPSocket::Address ip1, ip2;
   WORD port1 = 65535, port2 = 65535;
   return GetIpAndPort(ip1, port1) &&
@@ -510,6 +1087,9 @@ PBoolean H323TransportAddress::GetIpAndPort(PIPSocket::Address & ip,
                                         WORD & port,
                                         const char * proto) const
 {
+  if (GetBinary(ip, port))
+    return TRUE;
+
   PString host, service;
   if (!SplitAddress(*this, host, service))
     return FALSE;
@@ -1045,11 +1625,30 @@ PBoolean H323Transport::OnSocketOpen()
     return true;
 }
 
+PBoolean H323Transport::ConnectAny(const H323TransportAddressArray & addresses)
+{
+  for (PINDEX i = 0; i < addresses.GetSize(); i++) {
+    if (ConnectTo(addresses[i]))
+      return TRUE;
+  }
+  return FALSE;
+}
+
 PBoolean H323Transport::IsOpen() const
 {
     return PIndirectChannel::IsOpen();
 }
 
+PBoolean H323Transport::WriteFrame(const BYTE * header, PINDEX headerLen, const BYTE * data, PINDEX dataLen)
+{
+  // Copy into one buffer so the frame still goes out in a single write
+  PBYTEArray frame(headerLen + dataLen);
+  memcpy(frame.GetPointer(), header, headerLen);
+  memcpy(frame.GetPointer() + headerLen, data, dataLen);
+  return Write((const BYTE *)frame, headerLen + dataLen);
+}
+
+
 PBoolean H323Transport::IsTransportSecure()
 {
     return m_secured;
@@ -1176,7 +1775,10 @@ PBoolean H323Transport::HandleFirstSignallingChannelPDU(PThread * thread)
 
     // All subsequent PDU's should wait forever
     SetReadTimeout(PMaxTimeInterval);
-    connection->HandleSignallingChannel();
+
+    // The thread may end here, it stays attached for the keep alive timer
+    if (!connection->ReactorSignalChannel(this))
+      connection->HandleSignallingChannel();
   }
   else {
     connection->ClearCall(H323Connection::EndedByTransportFail);
@@ -1277,6 +1879,34 @@ PBoolean H323Transport::DiscoverGatekeeper(H323Gatekeeper & /*gk*/,
 }
 
 
+/////////////////////////////////////////////////////////////////////////////
+
+PBoolean H323ListenerSocket::IsReusePortAvailable()
+{
+#ifdef SO_REUSEPORT
+  return TRUE;
+#else
+  return FALSE;
+#endif
+}
+
+
+PBoolean H323ListenerSocket::OpenSocket(int ipAdressFamily)
+{
+  if (!PTCPSocket::OpenSocket(ipAdressFamily))
+    return FALSE;
+
+#ifdef SO_REUSEPORT
+  // Must be set before the bind for every socket sharing the port
+  if (reusePort && !SetOption(SO_REUSEPORT, 1)) {
+    PTRACE(2, "H225\tCould not set SO_REUSEPORT: " << GetErrorText());
+    return FALSE;
+  }
+#endif
+  return TRUE;
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
 
 H323ListenerTCP::H323ListenerTCP(H323EndPoint & end,
@@ -1300,14 +1930,37 @@ H323ListenerTCP::~H323ListenerTCP()
 
 PBoolean H323ListenerTCP::Open()
 {
-  if (listener.Listen(localAddress, 100, 0,
-                      exclusiveListener ? PSocket::AddressIsExclusive
-                                        : PSocket::CanReuseAddress))
-    return TRUE;
+  PINDEX count = endpoint.GetSignallingAcceptors();
+  PBoolean shared = endpoint.GetSharedListeners();
+  if ((count > 1 || shared) && (exclusiveListener || !H323ListenerSocket::IsReusePortAvailable())) {
+    PTRACE(2, TypeAsString() << "\tCannot share port " << listener.GetPort() << ", using one acceptor");
+    count = 1;
+    shared = FALSE;
+  }
 
-  PTRACE(1, TypeAsString() << "\tListen on " << localAddress << ':' << listener.GetPort()
-         << " failed: " << listener.GetErrorText());
-  return FALSE;
+  // Other processes sharing the port need it set on this socket as well
+  listener.SetReusePort(count > 1 || shared);
+  if (!listener.Listen(localAddress, 100, 0,
+                       exclusiveListener ? PSocket::AddressIsExclusive
+                                         : PSocket::CanReuseAddress)) {
+    PTRACE(1, TypeAsString() << "\tListen on " << localAddress << ':' << listener.GetPort()
+           << " failed: " << listener.GetErrorText());
+    return FALSE;
+  }
+
+  // Each further acceptor gets its own socket on the same port
+  for (PINDEX i = 1; i < count; i++) {
+    H323ListenerSocket * socket = new H323ListenerSocket(listener.GetPort(), TRUE);
+    if (!socket->Listen(localAddress, 100, 0, PSocket::CanReuseAddress)) {
+      PTRACE(2, TypeAsString() << "\tListen on " << localAddress << ':' << listener.GetPort()
+             << " for acceptor " << i << " failed: " << socket->GetErrorText());
+      delete socket;
+      break;
+    }
+    extraListeners.Append(socket);
+  }
+
+  return TRUE;
 }
 
 
@@ -1315,11 +1968,21 @@ PBoolean H323ListenerTCP::Close()
 {
   PBoolean ok = listener.Close();
 
+  PINDEX i;
+  for (i = 0; i < extraListeners.GetSize(); i++)
+    extraListeners[i].Close();
+
   PAssert(PThread::Current() != this, PLogicError);
 
   if (!IsTerminated() && !IsSuspended())
     PAssert(WaitForTermination(10000), "Listener thread did not terminate");
 
+  for (i = 0; i < acceptors.GetSize(); i++)
+    PAssert(acceptors[i].WaitForTermination(10000), "Acceptor thread did not terminate");
+
+  acceptors.RemoveAll();
+  extraListeners.RemoveAll();
+
   return ok;
 }
 
@@ -1333,17 +1996,31 @@ H323Transport * H323ListenerTCP::CreateTransport(const PIPSocket::Address & addr
 
 H323Transport * H323ListenerTCP::Accept(const PTimeInterval & timeout)
 {
-  if (!listener.IsOpen())
+  return AcceptFrom(listener, timeout);
+}
+
+
+H323Transport * H323ListenerTCP::AcceptFrom(PTCPSocket & sock, const PTimeInterval & timeout, PBoolean offload)
+{
+  if (!sock.IsOpen())
     return NULL;
 
-  listener.SetReadTimeout(timeout); // Wait for remote connect
+  sock.SetReadTimeout(timeout); // Wait for remote connect
 
   PTRACE(4, TypeAsString() << "\tWaiting on socket accept on " << GetTransportAddress());
   PTCPSocket * socket = new PTCPSocket;
-  if (socket->Accept(listener)) {
+  if (socket->Accept(sock)) {
     unsigned m_version = GetTransportAddress().GetIpVersion();
     H323Transport * transport = CreateTransport(PIPSocket::Address::GetAny(m_version));
-    transport->FinaliseSecurity(socket);
+    PBoolean secure = transport->FinaliseSecurity(socket);
+#ifdef H323_TLS
+    H323TLSHandshakePool * handshakes = offload && secure ? endpoint.GetTLSHandshakePool() : NULL;
+    if (handshakes != NULL && transport->Open(socket)) {
+        // Back to accepting while the pool does the key exchange
+        handshakes->Accept(transport);
+        return NULL;
+    }
+#endif
     if (transport->Open(socket) && transport->SecureAccept()) {
         return transport;
     }
@@ -1355,7 +2032,7 @@ H323Transport * H323ListenerTCP::Accept(const PTimeInterval & timeout)
 
   if (socket->GetErrorCode() != PChannel::Interrupted) {
     PTRACE(1, TypeAsString() << "\tAccept error:" << socket->GetErrorText());
-    listener.Close();
+    sock.Close();
   }
 
   delete socket;
@@ -1393,10 +2070,36 @@ void H323ListenerTCP::Main()
 {
   PTRACE(2, TypeAsString() << "\tAwaiting " << TypeAsString() << " connections on port " << listener.GetPort());
 
+  acceptors.RemoveAll();
+  for (PINDEX i = 0; i < extraListeners.GetSize(); i++)
+    acceptors.Append(PThread::Create(PCREATE_NOTIFIER(AcceptorMain), i,
+                                     PThread::NoAutoDeleteThread,
+                                     PThread::NormalPriority,
+                                     "H225 Accept:%x"));
+
   while (listener.IsOpen()) {
-    H323Transport * transport = Accept(PMaxTimeInterval);
+    H323Transport * transport = AcceptFrom(listener, PMaxTimeInterval, TRUE);
+    if (transport != NULL)
+      StartTransport(transport);
+  }
+#ifdef P_SSL
+#if (OPENSSL_VERSION_NUMBER < 0x10100000L) || defined(LIBRESSL_VERSION_NUMBER)
+  ERR_remove_thread_state(NULL);
+#endif
+#endif
+}
+
+
+void H323ListenerTCP::AcceptorMain(PThread &, H323_INT index)
+{
+  H323ListenerSocket & socket = extraListeners[(PINDEX)index];
+
+  PTRACE(3, TypeAsString() << "\tAcceptor " << index+1 << " awaiting connections on port " << socket.GetPort());
+
+  while (socket.IsOpen()) {
+    H323Transport * transport = AcceptFrom(socket, PMaxTimeInterval, TRUE);
     if (transport != NULL)
-      new H225TransportThread(endpoint, transport);
+      StartTransport(transport);
   }
 #ifdef P_SSL
 #if (OPENSSL_VERSION_NUMBER < 0x10100000L) || defined(LIBRESSL_VERSION_NUMBER)
@@ -1405,6 +2108,20 @@ void H323ListenerTCP::Main()
 #endif
 }
 
+
+static void StartSignallingThread(H323EndPoint & endpoint, H323Transport * transport)
+{
+  H225TransportThreadPool * pool = endpoint.GetSignallingThreadPool();
+  if (pool == NULL || !pool->Dispatch(transport))
+    new H225TransportThread(endpoint, transport);
+}
+
+
+void H323ListenerTCP::StartTransport(H323Transport * transport)
+{
+  StartSignallingThread(endpoint, transport);
+}
+
 /////////////////////////////////////////////////////////////////////////////
 
 #ifdef H323_TLS
@@ -1536,6 +2253,8 @@ H323TransportTCP::H323TransportTCP(H323EndPoint & end,
 #endif
 {
   h245listener = NULL;
+  readAheadStart = 0;
+  readAheadLength = 0;
 
   // construct listener socket if required
   if (listen) {
@@ -1588,6 +2307,10 @@ PBoolean H323TransportTCP::OnSocketOpen()
 {
   PIPSocket * socket = (PIPSocket *)GetReadChannel();
 
+  // Anything read ahead belongs to a previous connection
+  readAheadStart = 0;
+  readAheadLength = 0;
+
   // Get name of the remote computer for information purposes
   if (!socket->GetPeerAddress(remoteAddress, remotePort)) {
     PTRACE(1, "H323TCP\tGetPeerAddress() failed: " << socket->GetErrorText());
@@ -1761,61 +2484,183 @@ PBoolean H323TransportTCP::ReadBlock(void * buf, PINDEX len)
 
 PBoolean H323TransportTCP::ReadPDU(PBYTEArray & pdu)
 {
-  // Make sure is a RFC1006 TPKT
-  switch (ReadChar()) {
-    case -1 :
-      return FALSE;
+  // Save timeout
+  PTimeInterval oldTimeout = GetReadTimeout();
+  PBoolean timeoutChanged = FALSE;
+  PBoolean ok = TRUE;
 
-    case 3 :  // Only support version 3
-      break;
+  for (;;) {
+    if (readAheadLength > 0) {
+      const BYTE * tpkt = (const BYTE *)readAhead + readAheadStart;
 
-    default :  // Unknown version number
-      return SetErrorValues(Miscellaneous, 0x41000000);
-  }
+      // Make sure is a RFC1006 TPKT, only support version 3
+      if (tpkt[0] != 3) {
+        readAheadLength = 0;
+        ok = SetErrorValues(Miscellaneous, 0x41000000);
+        break;
+      }
 
-  // Save timeout
-  PTimeInterval oldTimeout = GetReadTimeout();
+      if (readAheadLength >= 4) {
+        PINDEX packetLength = ((tpkt[2] << 8)|tpkt[3]);
+        if (packetLength < 4) {
+          PTRACE(1, "H323TCP\tDwarf PDU received (length " << packetLength << ")");
+          readAheadLength = 0;
+          ok = FALSE;
+          break;
+        }
+
+        // Whole PDU already received, no read needed at all
+        if (readAheadLength >= packetLength) {
+          pdu.SetSize(packetLength - 4);
+          if (packetLength > 4)
+            memcpy(pdu.GetPointer(), tpkt + 4, packetLength - 4);
+          readAheadStart += packetLength;
+          readAheadLength -= packetLength;
+          break;
+        }
+
+        if (readAhead.GetSize() < packetLength)
+          readAhead.SetSize(packetLength);
+      }
+    }
+
+    // Keep the partial PDU at the front so a single read can complete it
+    if (readAheadStart > 0) {
+      if (readAheadLength > 0)
+        memmove(readAhead.GetPointer(), (const BYTE *)readAhead + readAheadStart, readAheadLength);
+      readAheadStart = 0;
+    }
+    if (readAhead.GetSize() - readAheadLength < TPKT_READ_SIZE)
+      readAhead.SetSize(readAheadLength + TPKT_READ_SIZE);
 
-  // Should get all of PDU in 5 seconds or something is seriously wrong,
-  SetReadTimeout(5000);
+    // Should get all of PDU in 5 seconds or something is seriously wrong,
+    if (readAheadLength > 0 && !timeoutChanged) {
+      SetReadTimeout(5000);
+      timeoutChanged = TRUE;
+    }
 
-  // Get TPKT length
-  BYTE header[3];
-  PBoolean ok = ReadBlock(header, sizeof(header));
-  if (ok) {
-    PINDEX packetLength = ((header[1] << 8)|header[2]);
-    if (packetLength < 4) {
-      PTRACE(1, "H323TCP\tDwarf PDU received (length " << packetLength << ")");
+    // Take as much as has arrived, later PDU's stay buffered for the next call
+    if (!Read(readAhead.GetPointer() + readAheadLength, readAhead.GetSize() - readAheadLength) ||
+                                                                  lastReadCount == 0) {
       ok = FALSE;
-    } else {
-      packetLength -= 4;
-      ok = ReadBlock(pdu.GetPointer(packetLength), packetLength);
+      break;
     }
+    readAheadLength += lastReadCount;
   }
 
-  SetReadTimeout(oldTimeout);
+  if (readAheadLength == 0)
+    readAheadStart = 0;
+
+  if (timeoutChanged)
+    SetReadTimeout(oldTimeout);
 
   return ok;
 }
 
 
+PINDEX H323TransportTCP::ExtractReadAhead(PBYTEArray & buffer, PINDEX offset)
+{
+  PINDEX count = readAheadLength;
+  if (count > 0) {
+    if (buffer.GetSize() < offset + count)
+      buffer.SetSize(offset + count);
+    memcpy(buffer.GetPointer() + offset, (const BYTE *)readAhead + readAheadStart, count);
+  }
+
+  readAheadStart = 0;
+  readAheadLength = 0;
+  return count;
+}
+
+
 PBoolean H323TransportTCP::WritePDU(const PBYTEArray & pdu)
 {
-  // We copy the data into a new buffer so we can do a single write call. This
-  // is necessary as we have disabled the Nagle TCP delay algorithm to improve
+  // The header and PDU must go out in a single write call. This is
+  // necessary as we have disabled the Nagle TCP delay algorithm to improve
   // network performance.
 
   int packetLength = pdu.GetSize() + 4;
 
   // Send RFC1006 TPKT length
-  PBYTEArray tpkt(packetLength);
+  BYTE tpkt[4];
   tpkt[0] = 3;
   tpkt[1] = 0;
   tpkt[2] = (BYTE)(packetLength >> 8);
   tpkt[3] = (BYTE)packetLength;
-  memcpy(tpkt.GetPointer()+4, (const BYTE *)pdu, pdu.GetSize());
 
-  return Write((const BYTE *)tpkt, packetLength);
+  return WriteFrame(tpkt, sizeof(tpkt), pdu, pdu.GetSize());
+}
+
+
+PBoolean H323TransportTCP::WriteFrame(const BYTE * header, PINDEX headerLen, const BYTE * data, PINDEX dataLen)
+{
+#ifdef H323_GATHER_WRITE
+  PBoolean plainSocket = !m_secured;
+#ifdef H323_TLS
+#if PTLIB_VER < 2120
+  ssl_st * m_ssl = ssl;
+#endif
+  if (m_ssl != NULL)
+    plainSocket = FALSE;
+#endif
+
+  PChannel * base = GetBaseWriteChannel();
+  if (plainSocket && base != NULL && PIsDescendant(base, PIPSocket) && base->IsOpen()) {
+    PINDEX total = headerLen + dataLen;
+    PINDEX sent = 0;
+
+#ifdef _WIN32
+    WSABUF pieces[2];
+    pieces[0].buf = (char *)header;
+    pieces[0].len = headerLen;
+    pieces[1].buf = (char *)data;
+    pieces[1].len = dataLen;
+    DWORD count = 0;
+    if (WSASend(base->GetHandle(), pieces, 2, &count, 0, NULL, NULL) == 0)
+      sent = count;
+#else
+    struct iovec pieces[2];
+    pieces[0].iov_base = (void *)header;
+    pieces[0].iov_len = headerLen;
+    pieces[1].iov_base = (void *)data;
+    pieces[1].iov_len = dataLen;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = pieces;
+    msg.msg_iovlen = 2;
+
+    int flags = 0;
+#ifdef MSG_NOSIGNAL
+    flags |= MSG_NOSIGNAL;
+#endif
+    ssize_t count;
+    do {
+      count = sendmsg(base->GetHandle(), &msg, flags);
+    } while (count < 0 && errno == EINTR);
+
+    if (count > 0)
+      sent = count;
+    else if (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+      return ConvertOSError(-1, LastWriteError);
+#endif
+
+    // Anything the socket did not take goes the normal way, which waits
+    // for buffer space and reports errors as usual.
+    if (sent < headerLen && !Write(header + sent, headerLen - sent))
+      return FALSE;
+    if (sent < total) {
+      PINDEX done = sent > headerLen ? sent - headerLen : 0;
+      if (!Write(data + done, dataLen - done))
+        return FALSE;
+    }
+
+    lastWriteCount = total;
+    return TRUE;
+  }
+#endif
+
+  return H323Transport::WriteFrame(header, headerLen, data, dataLen);
 }
 
 PBoolean H323TransportTCP::FinaliseSecurity(PSocket * socket)
@@ -1832,12 +2677,52 @@ PBoolean H323TransportTCP::FinaliseSecurity(PSocket * socket)
     return false;
 }
 
+#ifdef H323_TLS
+void H323TransportTCP::OnSecureHandshake(ssl_st * tls, PBoolean client, PInt64 start, PBoolean ok)
+{
+    if (client) {
+        H323TLSSessionCache * sessions = endpoint.GetTLSSessionCache();
+        if (sessions != NULL)
+            sessions->OnClientHandshake(tls, ok);
+    }
+
+    if (!ok)
+        return;
+
+    PBoolean reused = SSL_session_reused(tls);
+    PInt64 elapsed = PTimer::Tick().GetMilliSeconds() - start;
+    PTRACE(3, "TLS\t" << (reused ? "Resumed" : "Full") << " handshake with "
+           << remoteAddress << ':' << remotePort << " took " << elapsed << "ms");
+
+    H323EndPointMetrics & metrics = endpoint.GetMetrics();
+    metrics.tlsHandshakes.Add();
+    if (reused)
+        metrics.tlsHandshakesResumed.Add();
+    metrics.tlsHandshakeTime.Add(elapsed);
+}
+#endif
+
 PBoolean H323TransportTCP::SecureConnect()
 {
+#ifdef H323_TLS
+    H323TLSHandshakePool * handshakes = endpoint.GetTLSHandshakePool();
+    if (handshakes != NULL)
+        return handshakes->Connect(*this);
+#endif
+    return HandshakeConnect();
+}
+
+PBoolean H323TransportTCP::HandshakeConnect()
+{
 #ifdef H323_TLS
 #if PTLIB_VER < 2120
     ssl_st * m_ssl = ssl;
 #endif
+    PInt64 start = PTimer::Tick().GetMilliSeconds();
+    H323TLSSessionCache * sessions = endpoint.GetTLSSessionCache();
+    if (sessions != NULL)
+        sessions->PrepareClient(m_ssl, remoteAddress.AsString() + ':' + PString(PString::Unsigned, remotePort));
+
     int ret = 0;
     do {
         ret = SSL_connect(m_ssl);
@@ -1851,6 +2736,7 @@ PBoolean H323TransportTCP::SecureConnect()
                     ERR_error_string(ERR_get_error(), msg);
                     PTRACE(1, "TLS\tTLS protocol error in SSL_connect(): " << err << " / " << msg);
                     SSL_shutdown(m_ssl);
+                    OnSecureHandshake(m_ssl, true, start, false);
                     return false;
                     break;
                 case SSL_ERROR_SYSCALL:
@@ -1865,6 +2751,7 @@ PBoolean H323TransportTCP::SecureConnect()
                             ERR_error_string(ERR_get_error(), msg);
                             PTRACE(1, "TLS\tTerminating connection: " << msg);
                             SSL_shutdown(m_ssl);
+                            OnSecureHandshake(m_ssl, true, start, false);
                             return false;
                     };
                     break;
@@ -1878,10 +2765,12 @@ PBoolean H323TransportTCP::SecureConnect()
                     ERR_error_string(ERR_get_error(), msg);
                     PTRACE(1, "TLS\tUnknown error in SSL_connect(): " << err << " / " << msg);
                     SSL_shutdown(m_ssl);
+                    OnSecureHandshake(m_ssl, true, start, false);
                     return false;
             }
         }
     } while (ret <= 0);
+    OnSecureHandshake(m_ssl, true, start, true);
 #endif
     return true;
 }
@@ -1892,8 +2781,12 @@ PBoolean H323TransportTCP::SecureAccept()
 #if PTLIB_VER < 2120
     ssl_st * m_ssl = ssl;
 #endif
-    if (m_ssl)
-        return PSSLChannel::Accept();
+    if (m_ssl) {
+        PInt64 start = PTimer::Tick().GetMilliSeconds();
+        PBoolean ok = PSSLChannel::Accept();
+        OnSecureHandshake(m_ssl, false, start, ok);
+        return ok;
+    }
 #endif
     return true;
 }
@@ -1949,6 +2842,158 @@ PBoolean H323TransportTCP::Connect()
   return OnOpen();
 }
 
+
+void H323TCPConnectAttempt::Main()
+{
+  PTRACE(4, "H323TCP\tConnecting to " << remoteAddress << ':' << socket->GetPort()
+         << ", address " << index+1);
+
+  socket->SetReadTimeout(endpoint.GetSignallingChannelConnectTimeout());
+
+  WORD localPort = endpoint.GetNextTCPPort();
+  WORD firstPort = localPort;
+  PBoolean connected;
+  for (;;) {
+    connected = socket->Connect(localAddress, localPort, remoteAddress);
+    if (connected)
+      break;
+
+    int errnum = socket->GetErrorNumber();
+    if (localPort == 0 || (errnum != EADDRINUSE && errnum != EADDRNOTAVAIL))
+      break;
+
+    localPort = endpoint.GetNextTCPPort();
+    if (localPort == firstPort)
+      break;
+  }
+
+  race.mutex.Wait();
+
+  race.sockets[index] = NULL;
+  if (connected && !race.finished && race.winner == P_MAX_INDEX) {
+    race.winner = index;
+    race.won = socket;
+    socket = NULL;
+  }
+  else if (!connected) {
+    PTRACE(2, "H323TCP\tCould not connect to " << remoteAddress << ':' << socket->GetPort()
+           << " - " << socket->GetErrorText());
+    race.failures++;
+    race.errorCode = socket->GetErrorCode();
+    race.errorNumber = socket->GetErrorNumber();
+  }
+  race.running--;
+
+  race.mutex.Signal();
+  race.changed.Signal();
+
+  // Lost, or abandoned once another was connected
+  delete socket;
+  race.Release();
+}
+
+
+PBoolean H323TransportTCP::ConnectAny(const H323TransportAddressArray & addresses)
+{
+  if (IsListening())
+    return TRUE;
+
+  std::vector<PIPSocket::Address> remoteAddresses;
+  std::vector<WORD> remotePorts;
+  for (PINDEX i = 0; i < addresses.GetSize(); i++) {
+    PIPSocket::Address ip;
+    WORD port = H323EndPoint::DefaultTcpPort;
+    if (addresses[i].GetIpAndPort(ip, port, "tcp")) {
+      remoteAddresses.push_back(ip);
+      remotePorts.push_back(port);
+    }
+  }
+
+  PINDEX count = remoteAddresses.size();
+  if (count < 2) {
+    if (count == 0)
+      return FALSE;
+    remoteAddress = remoteAddresses[0];
+    remotePort = remotePorts[0];
+    return Connect();
+  }
+
+  PTRACE(3, "H323TCP\tConnecting to the first of " << count << " addresses to answer");
+
+  H323TCPConnectRace * race = new H323TCPConnectRace(count);
+  const PTimeInterval & stagger = endpoint.GetSignallingConnectStagger();
+  PINDEX started = 0;
+  PINDEX failuresSeen = 0;
+  PBoolean startNext = TRUE;
+
+  race->mutex.Wait();
+  while (race->winner == P_MAX_INDEX) {
+    // The next address goes when the stagger is up or an attempt fails
+    if (race->failures > failuresSeen) {
+      failuresSeen = race->failures;
+      startNext = TRUE;
+    }
+    if (startNext && started < count) {
+      PTCPSocket * socket = new PTCPSocket(remotePorts[started]);
+      race->sockets[started] = socket;
+      race->running++;
+      race->references++;
+      new H323TCPConnectAttempt(endpoint, *race, started, socket, localAddress, remoteAddresses[started]);
+      started++;
+      startNext = FALSE;
+      continue;
+    }
+
+    if (started == count && race->running == 0)
+      break;
+
+    race->mutex.Signal();
+    if (started < count)
+      startNext = !race->changed.Wait(stagger);
+    else
+      race->changed.Wait();
+    race->mutex.Wait();
+  }
+
+  // Abandon the attempts still connecting, their threads clean up
+  race->finished = TRUE;
+  for (PINDEX i = 0; i < count; i++) {
+    if (race->sockets[i] != NULL)
+      race->sockets[i]->Close();
+  }
+
+  PTCPSocket * socket = race->won;
+  PINDEX winner = race->winner;
+  PChannel::Errors errorCode = race->errorCode;
+  int errorNumber = race->errorNumber;
+  race->mutex.Signal();
+  race->Release();
+
+  if (socket == NULL) {
+    PTRACE(1, "H323TCP\tCould not connect to any of " << count << " addresses");
+    return SetErrorValues(errorCode, errorNumber);
+  }
+
+  remoteAddress = remoteAddresses[winner];
+  remotePort = remotePorts[winner];
+  PTRACE(3, "H323TCP\tConnected to " << remoteAddress << ':' << remotePort
+         << ", address " << winner+1 << " of " << count);
+
+  socket->SetReadTimeout(PMaxTimeInterval);
+  Open(socket);
+
+  channelPointerMutex.StartRead();
+
+  if (FinaliseSecurity(socket) && !SecureConnect()) {
+    channelPointerMutex.EndRead();
+    return FALSE;
+  }
+
+  channelPointerMutex.EndRead();
+
+  return OnOpen();
+}
+
 H323Transport * H323TransportTCP::CreateControlChannel(H323Connection & connection)
 {
   H323TransportSecurity m_callSecurity;
@@ -2049,10 +3094,27 @@ static PBoolean ListenUDP(PUDPSocket & socket,
 }
 
 
+PBoolean H323DatagramSocket::OpenSocket(int ipAdressFamily)
+{
+  if (!PUDPSocket::OpenSocket(ipAdressFamily))
+    return FALSE;
+
+#ifdef SO_REUSEPORT
+  // Must be set before the bind for every socket sharing the port
+  if (reusePort && !SetOption(SO_REUSEPORT, 1)) {
+    PTRACE(2, "H323UDP\tCould not set SO_REUSEPORT: " << GetErrorText());
+    return FALSE;
+  }
+#endif
+  return TRUE;
+}
+
+
 H323TransportUDP::H323TransportUDP(H323EndPoint & ep,
                                    PIPSocket::Address binding,
                                    WORD local_port,
-                                   WORD remote_port)
+                                   WORD remote_port,
+                                   PBoolean reusePort)
 #ifdef H323_TLS
   : H323TransportIP(ep, binding, remote_port, ep.GetTransportContext())
 #else
@@ -2063,8 +3125,11 @@ H323TransportUDP::H323TransportUDP(H323EndPoint & ep,
     remotePort = H225_RAS::DefaultRasUdpPort; // For backward compatibility
 
   promiscuousReads = AcceptFromRemoteOnly;
+  lastReceivedPort = 0;
+  readBatch = NULL;
+  readBuffer.SetSize(10000);
 
-  PUDPSocket * udp = new PUDPSocket;
+  PUDPSocket * udp = new H323DatagramSocket(reusePort);
   ListenUDP(*udp, ep, binding, local_port);
 
   interfacePort = localPort = udp->GetPort();
@@ -2084,6 +3149,7 @@ H323TransportUDP::H323TransportUDP(H323EndPoint & ep,
 H323TransportUDP::~H323TransportUDP()
 {
   Close();
+  delete readBatch;
 }
 
 
@@ -2143,27 +3209,53 @@ PBoolean H323TransportUDP::ExtractPDU(const PBYTEArray & /*pdu*/, PINDEX & /*len
   return TRUE;
 }
 
-PBoolean H323TransportUDP::ReadPDU(PBYTEArray & pdu)
+void H323TransportUDP::SetReadBatchSize(PINDEX count)
 {
-  for (;;) {
-    if (!Read(pdu.GetPointer(10000), 10000)) {
-      pdu.SetSize(0);
-      return FALSE;
-    }
+  delete readBatch;
+  readBatch = count > 1 ? new RTP_DatagramBatch(count, readBuffer.GetSize()) : NULL;
+}
 
-    pdu.SetSize(GetLastReadCount());
 
+PBoolean H323TransportUDP::ReadPDU(PBYTEArray & pdu)
+{
+  for (;;) {
     PUDPSocket * socket = (PUDPSocket *)GetReadChannel();
+    PIPSocket::Address address;
+    WORD port;
+    PINDEX count;
 
+    // The batch reports the source itself, and leaves the interface to the
+    // single reads that can capture it
 #if PTLIB_VER < 2110
-    if (canGetInterface)
-      lastReceivedInterface = socket->GetLastReceiveToAddress();
+    if (readBatch != NULL && socket != NULL && !canGetInterface) {
+#else
+    if (readBatch != NULL && socket != NULL) {
 #endif
+      socket->SetReadTimeout(readTimeout);
+      if (!readBatch->ReadFrom(*socket, readBuffer.GetPointer(), readBuffer.GetSize(), address, port, count)) {
+        // The transaction loop looks at the error of the transport
+        SetErrorValues(socket->GetErrorCode(LastReadError), socket->GetErrorNumber(LastReadError), LastReadError);
+        pdu.SetSize(0);
+        return FALSE;
+      }
+      lastReadCount = count;
+    }
+    else {
+      if (!Read(readBuffer.GetPointer(), readBuffer.GetSize())) {
+        pdu.SetSize(0);
+        return FALSE;
+      }
 
-    PIPSocket::Address address;
-    WORD port;
+      count = GetLastReadCount();
+      socket = (PUDPSocket *)GetReadChannel();
+
+#if PTLIB_VER < 2110
+      if (canGetInterface)
+        lastReceivedInterface = socket->GetLastReceiveToAddress();
+#endif
 
-    socket->GetLastReceiveAddress(address, port);
+      socket->GetLastReceiveAddress(address, port);
+    }
 
     switch (promiscuousReads) {
       case AcceptFromRemoteOnly :
@@ -2178,19 +3270,23 @@ PBoolean H323TransportUDP::ReadPDU(PBYTEArray & pdu)
         goto accept;
 
       case AcceptFromLastReceivedOnly :
-        if (!lastReceivedAddress.IsEmpty()) {
-          PIPSocket::Address lastAddr;
-          WORD lastPort = 0;
-
-          if (lastReceivedAddress.GetIpAndPort(lastAddr, lastPort, "udp") &&
-             (lastAddr *= address) && lastPort == port)
-            goto accept;
-        }
+        if (lastReceivedPort != 0 && (lastReceivedIP *= address) && lastReceivedPort == port)
+          goto accept;
         break;
 
       default : //AcceptFromAny
       accept:
-        lastReceivedAddress = H323TransportAddress(address, port);
+        // Only the PDU is copied, the buffer is kept for the next read
+        memcpy(pdu.GetPointer(count), (const BYTE *)readBuffer, count);
+        pdu.SetSize(count);
+
+        // A listener mostly hears from the same peer in a row, so only build
+        // the address string when the source changes
+        if (port != lastReceivedPort || address != lastReceivedIP) {
+          lastReceivedIP = address;
+          lastReceivedPort = port;
+          lastReceivedAddress = H323TransportAddress(address, port);
+        }
         return TRUE;
     }
 
@@ -2224,6 +3320,10 @@ PBoolean H323TransportUDP::DiscoverGatekeeper(H323Gatekeeper & gk,
     // Skip over the H323Transport::Close to make sure PUDPSocket is deleted.
   PIndirectChannel::Close();
 
+  // Anything left in the batch came from the socket just closed
+  if (readBatch != NULL)
+    SetReadBatchSize(readBatch->GetCount());
+
   WORD destPort = H225_RAS::DefaultRasUdpPort;
   if (!address) {
     if (!address.GetIpAndPort(destAddr, destPort, "udp")) {
@@ -2488,16 +3588,12 @@ H323TransportAddress H323TransportUDP::GetLocalAddress() const
 
   // check for special case of local interface, which means the PDU came from the same machine
   H323TransportAddress taddr = H323TransportIP::GetLocalAddress();
-  if (!lastReceivedAddress.IsEmpty()) {
+  if (lastReceivedPort != 0) {
     PIPSocket::Address tipAddr;
     WORD tipPort = 0;
     taddr.GetIpAndPort(tipAddr, tipPort);
-    if (tipAddr == PIPSocket::Address(0)) {
-      PIPSocket::Address lastRxIPAddr;
-      lastReceivedAddress.GetIpAddress(lastRxIPAddr);
-      if (lastRxIPAddr != PIPSocket::Address())
-        taddr = H323TransportAddress(lastRxIPAddr, tipPort);
-    }
+    if (tipAddr == PIPSocket::Address(0) && lastReceivedIP != PIPSocket::Address())
+      taddr = H323TransportAddress(lastReceivedIP, tipPort);
   }
 
   return taddr;
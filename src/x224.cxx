@@ -80,6 +80,7 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 X224::X224()
+  : dataOffset(0)
 {
 }
 
@@ -102,22 +103,25 @@ void X224::PrintOn(ostream & strm) const
 
   char fillchar = strm.fill();
 
+  const BYTE * data = GetDataPointer();
+  PINDEX dataSize = GetDataSize();
+
   strm << '\n'
-       << setw(indent) << ' ' << "data: " << data.GetSize() << " bytes\n"
+       << setw(indent) << ' ' << "data: " << dataSize << " bytes\n"
        << hex;
 
   PINDEX i = 0;
-  while (i < data.GetSize()) {
+  while (i < dataSize) {
     strm << setfill(' ') << setw(indent) << ' ' << setfill('0');
     PINDEX j;
     for (j = 0; j < 16; j++)
-      if (i+j < data.GetSize())
+      if (i+j < dataSize)
         strm << setw(2) << (unsigned)data[i+j] << ' ';
       else
         strm << "   ";
     strm << "  ";
     for (j = 0; j < 16; j++) {
-      if (i+j < data.GetSize()) {
+      if (i+j < dataSize) {
         if (isprint(data[i+j]))
           strm << data[i+j];
         else
@@ -136,46 +140,65 @@ void X224::PrintOn(ostream & strm) const
 PBoolean X224::Decode(const PBYTEArray & rawData)
 {
   PINDEX packetLength = rawData.GetSize();
+  if (packetLength < 2) // No code
+    return FALSE;
 
   PINDEX headerLength = rawData[0];
-  if (packetLength < headerLength + 1) // Not enough bytes
+  if (headerLength < 1 || packetLength < headerLength + 1) // Not enough bytes
     return FALSE;
 
-  header.SetSize(headerLength);
-  memcpy(header.GetPointer(), (const BYTE *)rawData+1, headerLength);
+  if (&rawData != &pdu)
+    pdu = rawData;
+  dataOffset = headerLength + 1;
+  return TRUE;
+}
+
 
-  packetLength -= headerLength + 1;
-  data.SetSize(packetLength);
-  if (packetLength > 0)
-    memcpy(data.GetPointer(), (const BYTE *)rawData+headerLength+1, packetLength);
+PBoolean X224::Encode(PBYTEArray & rawData) const
+{
+  if (pdu.GetSize() < 2)
+    return FALSE;
 
+  rawData = pdu;
   return TRUE;
 }
 
 
-PBoolean X224::Encode(PBYTEArray & rawData) const
+PBYTEArray X224::GetData() const
 {
-  PINDEX headerLength = header.GetSize();
-  PINDEX dataLength = data.GetSize();
+  return PBYTEArray(GetDataPointer(), GetDataSize());
+}
 
-  if (!rawData.SetSize(headerLength + dataLength + 1))
-    return FALSE;
 
-  rawData[0] = (BYTE)headerLength;
-  memcpy(rawData.GetPointer() + 1, header, headerLength);
+PBYTEArray & X224::GetReadBuffer()
+{
+  if (!pdu.IsUnique())
+    pdu = PBYTEArray();
+  dataOffset = 0;
+  return pdu;
+}
 
-  if (dataLength > 0)
-    memcpy(rawData.GetPointer()+headerLength+1, data, dataLength);
 
-  return TRUE;
+BYTE * X224::SetHeader(BYTE code, PINDEX headerLength, PINDEX dataSize)
+{
+  // Only write over the buffer if no decoded data or encoded copy refers to it
+  PINDEX size = headerLength + 1 + dataSize;
+  if (pdu.IsUnique())
+    pdu.SetSize(size);
+  else
+    pdu = PBYTEArray(size);
+
+  BYTE * ptr = pdu.GetPointer();
+  ptr[0] = (BYTE)headerLength;
+  ptr[1] = code;
+  dataOffset = headerLength + 1;
+  return ptr;
 }
 
 
 void X224::BuildConnectRequest()
 {
-  data.SetSize(0);
-  header.SetSize(6);
-  header[0] = ConnectRequest;
+  BYTE * header = SetHeader(ConnectRequest, 6, 0) + 1;
   header[1] = 0;
   header[2] = 0x7b;
   header[3] = 2;
@@ -186,9 +209,7 @@ void X224::BuildConnectRequest()
 
 void X224::BuildConnectConfirm()
 {
-  data.SetSize(0);
-  header.SetSize(6);
-  header[0] = ConnectConfirm;
+  BYTE * header = SetHeader(ConnectConfirm, 6, 0) + 1;
   header[1] = 0;
   header[2] = 0x7b;
   header[3] = 2;
@@ -199,10 +220,16 @@ void X224::BuildConnectConfirm()
 
 void X224::BuildData(const PBYTEArray & d)
 {
-  header.SetSize(2);
-  header[0] = DataPDU;
+  BuildData(d, d.GetSize());
+}
+
+
+void X224::BuildData(const BYTE * d, PINDEX size)
+{
+  BYTE * header = SetHeader(DataPDU, 2, size) + 1;
   header[1] = 0x80;
-  data = d;
+  if (size > 0)
+    memcpy(header+2, d, size);
 }
 
 